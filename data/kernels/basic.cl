@@ -1185,16 +1185,9 @@ guide_laplacians(read_only image2d_t HF,
   // Last step of RGB reconstruct : add noise
   if((scale & LAST_SCALE) && salt && alpha > 0.f)
   {
-    // Init random number generator
-    unsigned int state[4] = { splitmix32(x + 1), splitmix32((x + 1) * (y + 3)), splitmix32(1337), splitmix32(666) };
-    xoshiro128plus(state);
-    xoshiro128plus(state);
-    xoshiro128plus(state);
-    xoshiro128plus(state);
-
     // Model noise on the max RGB
     const float4 sigma = out * noise_level;
-    float4 noise = dt_noise_generator_simd(DT_NOISE_POISSONIAN, out, sigma, state);
+    float4 noise = dt_noise_generator_simd(DT_NOISE_POISSONIAN, x, y, 1337, out, sigma);
 
     // Ensure the noise only brightens the image, since it's clipped
     noise = out + fabs(noise - out);
@@ -1475,6 +1468,43 @@ colorin_clipping (read_only image2d_t in, write_only image2d_t out, const int wi
   write_imagef (out, (int2)(x, y), pixel);
 }
 
+/* kernel for the plugin colorin: tetrahedral interpolation in a camera RGB -> XYZ table
+   sampled from the lcms2 transform of profiles without a usable matrix */
+kernel void
+colorin_clut (read_only image2d_t in, write_only image2d_t out, const int width, const int height,
+              global const float4 *clut, const int size, global const float *corr)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float4 corval = (const float4)(corr[0], corr[1], corr[2], corr[3]);
+  float4 pixel = corval * read_imagef(in, sampleri, (int2)(x, y));
+
+  const float4 v = clamp(pixel, 0.0f, 1.0f) * (float)(size - 1);
+  const int4 i = min(convert_int4(v), size - 2);
+  const float4 f = v - convert_float4(i);
+  const int stride[3] = { 1, size, size * size };
+  const float fr[3] = { f.x, f.y, f.z };
+
+  // walk from the lower to the upper corner along the axes sorted by falling fraction
+  int a = 0, b = 1, c = 2, t;
+  if(fr[a] < fr[b]) { t = a; a = b; b = t; }
+  if(fr[b] < fr[c]) { t = b; b = c; c = t; }
+  if(fr[a] < fr[b]) { t = a; a = b; b = t; }
+
+  const int base = i.x + size * (i.y + size * i.z);
+  const float4 c0 = clut[base];
+  const float4 c1 = clut[base + stride[a]];
+  const float4 c2 = clut[base + stride[a] + stride[b]];
+  const float4 c3 = clut[base + stride[a] + stride[b] + stride[c]];
+  const float4 xyz = (1.0f - fr[a]) * c0 + (fr[a] - fr[b]) * c1 + (fr[b] - fr[c]) * c2 + fr[c] * c3;
+
+  pixel.xyz = XYZ_to_Lab(xyz).xyz;
+  write_imagef (out, (int2)(x, y), pixel);
+}
+
 /* kernel for the tonecurve plugin. */
 kernel void
 tonecurve (read_only image2d_t in, write_only image2d_t out, const int width, const int height,
@@ -3915,3 +3945,23 @@ interpolation_copy(read_only image2d_t dev_in,
   write_imagef(dev_out, (int2)(ocol, orow), pix);
 }
 
+
+/* copy a region between images of different channel types, used for
+   images stored as half floats */
+kernel void
+convert_image(read_only image2d_t in,
+              write_only image2d_t out,
+              const int width,
+              const int height,
+              const int ix,
+              const int iy,
+              const int ox,
+              const int oy)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  write_imagef(out, (int2)(x + ox, y + oy), read_imagef(in, sampleri, (int2)(x + ix, y + iy)));
+}
@@ -0,0 +1,398 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  OpenCL port of the raw chromatic aberration correction in iop/cacorrect.c
+  (Emil Martinec, Ingo Weyrich, RawTherapee).
+
+  The cpu code works on overlapping 128x128 tiles with mirrored borders, here
+  all per pixel steps run on the full image and out-of-image reads are mirrored
+  the same way. A tile of the cpu code maps to a CA_TILE x CA_TILE block.
+*/
+
+#include "common.h"
+
+#define CA_TILE 112 // ts - 2 * border of the cpu code
+#define CA_EPS 1e-5f
+#define CA_EPS2 1e-10f
+
+static inline int _mirror(const int i, const int n)
+{
+  const int m = i < 0 ? -i : (i >= n ? 2 * (n - 1) - i : i);
+  return clamp(m, 0, n - 1);
+}
+
+static inline float _px(global const float *p, const int row, const int col, const int w, const int h)
+{
+  return p[mad24(_mirror(row, h), w, _mirror(col, w))];
+}
+
+// planes holding one value per red or blue site, (w + 1) / 2 wide
+static inline float _hp(global const float *p, const int row, const int col, const int w, const int h)
+{
+  return p[mad24(_mirror(row, h), (w + 1) / 2, _mirror(col, w) / 2)];
+}
+
+static inline float _interpolate(const float a, const float b, const float c)
+{
+  return a * (b - c) + c;
+}
+
+__kernel void cacorrect_populate(__read_only image2d_t in,
+                                 global float *raw,
+                                 const int w,
+                                 const int height,
+                                 const float scale)
+{
+  const int col = get_global_id(0);
+  const int row = get_global_id(1);
+  if(col >= w || row >= height) return;
+
+  raw[mad24(row, w, col)] = scale * read_imagef(in, sampleri, (int2)(col, row)).x;
+}
+
+__kernel void cacorrect_write_output(global const float *raw,
+                                     __write_only image2d_t out,
+                                     const int w,
+                                     const int height,
+                                     const int owidth,
+                                     const int oheight,
+                                     const int ox,
+                                     const int oy,
+                                     const float scale)
+{
+  const int col = get_global_id(0);
+  const int row = get_global_id(1);
+  if(col >= owidth || row >= oheight) return;
+
+  const int icol = col + ox;
+  const int irow = row + oy;
+  const float val = (icol < w && irow < height) ? scale * raw[mad24(irow, w, icol)] : 0.0f;
+  write_imagef(out, (int2)(col, row), (float4)(val, 0.0f, 0.0f, 0.0f));
+}
+
+// green at red and blue sites by a directional weighted average, green sites are copied
+__kernel void cacorrect_green(global const float *raw,
+                              global float *green,
+                              const int w,
+                              const int height,
+                              const unsigned int filters)
+{
+  const int col = get_global_id(0);
+  const int row = get_global_id(1);
+  if(col >= w || row >= height) return;
+
+  const int idx = mad24(row, w, col);
+  const float val = raw[idx];
+  if(FC(row, col, filters) & 1)
+  {
+    green[idx] = val;
+    return;
+  }
+
+  const float gu = _px(raw, row - 1, col, w, height);
+  const float gd = _px(raw, row + 1, col, w, height);
+  const float gl = _px(raw, row, col - 1, w, height);
+  const float gr = _px(raw, row, col + 1, w, height);
+
+  const float wtu = 1.0f / fsquare(CA_EPS + fabs(gd - gu) + fabs(val - _px(raw, row - 2, col, w, height))
+                                          + fabs(gu - _px(raw, row - 3, col, w, height)));
+  const float wtd = 1.0f / fsquare(CA_EPS + fabs(gu - gd) + fabs(val - _px(raw, row + 2, col, w, height))
+                                          + fabs(gd - _px(raw, row + 3, col, w, height)));
+  const float wtl = 1.0f / fsquare(CA_EPS + fabs(gr - gl) + fabs(val - _px(raw, row, col - 2, w, height))
+                                          + fabs(gl - _px(raw, row, col - 3, w, height)));
+  const float wtr = 1.0f / fsquare(CA_EPS + fabs(gl - gr) + fabs(val - _px(raw, row, col + 2, w, height))
+                                          + fabs(gr - _px(raw, row, col + 3, w, height)));
+
+  green[idx] = (wtu * gu + wtd * gd + wtl * gl + wtr * gr) / (wtu + wtd + wtl + wtr);
+}
+
+// high and low pass filters of the colour differences at red and blue sites
+__kernel void cacorrect_filters(global const float *raw,
+                                global const float *green,
+                                global float *rbhpfv,
+                                global float *rbhpfh,
+                                global float *rblpfv,
+                                global float *rblpfh,
+                                global float *grblpfv,
+                                global float *grblpfh,
+                                const int w,
+                                const int height,
+                                const unsigned int filters)
+{
+  const int col = get_global_id(0);
+  const int row = get_global_id(1);
+  if(col >= w || row >= height) return;
+  if(FC(row, col, filters) & 1) return;
+
+  const int idx = mad24(row, w, col);
+  const int hidx = mad24(row, (w + 1) / 2, col / 2);
+
+  const float g = green[idx];
+  const float c = raw[idx];
+  const float d = g - c;
+
+  const float dvm = _px(green, row - 4, col, w, height) - _px(raw, row - 4, col, w, height);
+  const float dvp = _px(green, row + 4, col, w, height) - _px(raw, row + 4, col, w, height);
+  const float dhm = _px(green, row, col - 4, w, height) - _px(raw, row, col - 4, w, height);
+  const float dhp = _px(green, row, col + 4, w, height) - _px(raw, row, col + 4, w, height);
+
+  rbhpfv[hidx] = fabs(fabs(d - dvp) + fabs(dvm - d) - fabs(dvm - dvp));
+  rbhpfh[hidx] = fabs(fabs(d - dhp) + fabs(dhm - d) - fabs(dhm - dhp));
+
+  const float glpfv = 0.25f * (2.0f * g + _px(green, row + 2, col, w, height) + _px(green, row - 2, col, w, height));
+  const float glpfh = 0.25f * (2.0f * g + _px(green, row, col + 2, w, height) + _px(green, row, col - 2, w, height));
+  const float clpfv = 0.25f * (2.0f * c + _px(raw, row + 2, col, w, height) + _px(raw, row - 2, col, w, height));
+  const float clpfh = 0.25f * (2.0f * c + _px(raw, row, col + 2, w, height) + _px(raw, row, col - 2, w, height));
+
+  rblpfv[hidx] = CA_EPS + fabs(glpfv - clpfv);
+  rblpfh[hidx] = CA_EPS + fabs(glpfh - clpfh);
+  grblpfv[hidx] = glpfv + clpfv;
+  grblpfh[hidx] = glpfh + clpfh;
+}
+
+// one work item per block: the CA shift minimizing the colour difference variance
+// and the block weight, laid out as blockshifts[block][colour][dir]
+__kernel void cacorrect_blocks(global const float *raw,
+                               global const float *green,
+                               global const float *rbhpfv,
+                               global const float *rbhpfh,
+                               global const float *rblpfv,
+                               global const float *rblpfh,
+                               global const float *grblpfv,
+                               global const float *grblpfh,
+                               global float *blockwt,
+                               global float *blockshifts,
+                               const int w,
+                               const int height,
+                               const unsigned int filters,
+                               const int blocks_h,
+                               const int blocks_v)
+{
+  const int bx = get_global_id(0);
+  const int by = get_global_id(1);
+  if(bx >= blocks_h || by >= blocks_v) return;
+
+  float coeff[2][3][2] = { { { 0.0f } } };
+
+  const int left = bx * CA_TILE;
+  const int rowmax = min(height, (by + 1) * CA_TILE);
+  const int colmax = min(w, (bx + 1) * CA_TILE);
+
+  for(int row = by * CA_TILE; row < rowmax; row++)
+  {
+    for(int col = left + (FC(row, left, filters) & 1); col < colmax; col += 2)
+    {
+      const int c = FC(row, col, filters) >> 1;
+      const float deltgrb = raw[mad24(row, w, col)] - green[mad24(row, w, col)];
+
+      // vertical
+      float gdiff = 0.3125f * (_px(green, row + 1, col, w, height) - _px(green, row - 1, col, w, height))
+                  + 0.09375f * (_px(green, row + 1, col + 1, w, height) - _px(green, row - 1, col + 1, w, height)
+                              + _px(green, row + 1, col - 1, w, height) - _px(green, row - 1, col - 1, w, height));
+      float gradwt = fabs(0.25f * _hp(rbhpfv, row, col, w, height)
+                          + 0.125f * (_hp(rbhpfv, row, col + 2, w, height) + _hp(rbhpfv, row, col - 2, w, height)))
+                     * (_hp(grblpfv, row - 2, col, w, height) + _hp(grblpfv, row + 2, col, w, height))
+                     / (CA_EPS + 0.1f * (_hp(grblpfv, row - 2, col, w, height) + _hp(grblpfv, row + 2, col, w, height))
+                        + _hp(rblpfv, row - 2, col, w, height) + _hp(rblpfv, row + 2, col, w, height));
+      coeff[0][0][c] += gradwt * deltgrb * deltgrb;
+      coeff[0][1][c] += gradwt * gdiff * deltgrb;
+      coeff[0][2][c] += gradwt * gdiff * gdiff;
+
+      // horizontal
+      gdiff = 0.3125f * (_px(green, row, col + 1, w, height) - _px(green, row, col - 1, w, height))
+            + 0.09375f * (_px(green, row + 1, col + 1, w, height) - _px(green, row + 1, col - 1, w, height)
+                        + _px(green, row - 1, col + 1, w, height) - _px(green, row - 1, col - 1, w, height));
+      gradwt = fabs(0.25f * _hp(rbhpfh, row, col, w, height)
+                    + 0.125f * (_hp(rbhpfh, row + 2, col, w, height) + _hp(rbhpfh, row - 2, col, w, height)))
+               * (_hp(grblpfh, row, col - 2, w, height) + _hp(grblpfh, row, col + 2, w, height))
+               / (CA_EPS + 0.1f * (_hp(grblpfh, row, col - 2, w, height) + _hp(grblpfh, row, col + 2, w, height))
+                  + _hp(rblpfh, row, col - 2, w, height) + _hp(rblpfh, row, col + 2, w, height));
+      coeff[1][0][c] += gradwt * deltgrb * deltgrb;
+      coeff[1][1][c] += gradwt * gdiff * deltgrb;
+      coeff[1][2][c] += gradwt * gdiff * gdiff;
+    }
+  }
+
+  const int block = mad24(by, blocks_h, bx);
+  // like the cpu code the weight of the last colour and direction wins
+  float wt = 0.0f;
+  for(int c = 0; c < 2; c++)
+  {
+    for(int dir = 0; dir < 2; dir++)
+    {
+      const bool valid = coeff[dir][2][c] > CA_EPS2;
+      blockshifts[4 * block + 2 * c + dir] = valid ? coeff[dir][1][c] / coeff[dir][2][c] : 17.0f;
+      wt = valid ? coeff[dir][2][c] / (CA_EPS + coeff[dir][0][c]) : 0.0f;
+    }
+  }
+  blockwt[block] = wt;
+}
+
+// apply the fitted per block shifts, laid out as shifts[block][colour][dir]
+__kernel void cacorrect_correct(global const float *raw,
+                                global const float *green,
+                                global float *out,
+                                global const float *shifts,
+                                const int w,
+                                const int height,
+                                const unsigned int filters,
+                                const int blocks_h)
+{
+  const int col = get_global_id(0);
+  const int row = get_global_id(1);
+  if(col >= w || row >= height) return;
+
+  const int idx = mad24(row, w, col);
+  const float val = raw[idx];
+  const int color = FC(row, col, filters);
+  if(color & 1)
+  {
+    out[idx] = val;
+    return;
+  }
+
+  const int block = mad24(row / CA_TILE, blocks_h, col / CA_TILE);
+  const float sv = shifts[4 * block + 2 * (color >> 1)];
+  const float sh = shifts[4 * block + 2 * (color >> 1) + 1];
+
+  int vfloor = (int)floor(sv);
+  int vceil = (int)ceil(sv);
+  if(sv < 0.0f)
+  {
+    const int tmp = vfloor;
+    vfloor = vceil;
+    vceil = tmp;
+  }
+  const float vfrac = fabs(sv - vfloor);
+
+  int hfloor = (int)floor(sh);
+  int hceil = (int)ceil(sh);
+  if(sh < 0.0f)
+  {
+    const int tmp = hfloor;
+    hfloor = hceil;
+    hceil = tmp;
+  }
+  const float hfrac = fabs(sh - hfloor);
+
+  const int dirv = sv > 0.0f ? 2 : -2;
+  const int dirh = sh > 0.0f ? 2 : -2;
+
+  // green at the CA shift point and the colour difference there, for this site
+  // and its three same colour neighbours towards the shift
+  float grbdiff[4];
+  float gshift[4];
+  for(int k = 0; k < 4; k++)
+  {
+    const int r = row - ((k & 2) ? dirv : 0);
+    const int c = col - ((k & 1) ? dirh : 0);
+    const float ginthfloor = _interpolate(hfrac, _px(green, r + vfloor, c + hceil, w, height),
+                                                 _px(green, r + vfloor, c + hfloor, w, height));
+    const float ginthceil = _interpolate(hfrac, _px(green, r + vceil, c + hceil, w, height),
+                                                _px(green, r + vceil, c + hfloor, w, height));
+    gshift[k] = _interpolate(vfrac, ginthceil, ginthfloor);
+    grbdiff[k] = gshift[k] - _px(raw, r, c, w, height);
+  }
+
+  const float g = green[idx];
+  const float grbdiffold = g - val;
+
+  // interpolate colour difference from optical R/B locations to grid locations
+  const float grbdiffinthfloor = _interpolate(0.5f * hfrac, grbdiff[1], grbdiff[0]);
+  const float grbdiffinthceil = _interpolate(0.5f * hfrac, grbdiff[3], grbdiff[2]);
+  float grbdiffint = _interpolate(0.5f * vfrac, grbdiffinthceil, grbdiffinthfloor);
+
+  float res = val;
+  const float RBint = g - grbdiffint;
+  if(fabs(RBint - val) < 0.25f * (RBint + val))
+  {
+    if(fabs(grbdiffold) > fabs(grbdiffint))
+      res = RBint;
+  }
+  else
+  {
+    // gradient weights using difference from G at CA shift points and G at grid points
+    const float p0 = 1.0f / (CA_EPS + fabs(g - gshift[0]));
+    const float p1 = 1.0f / (CA_EPS + fabs(g - gshift[1]));
+    const float p2 = 1.0f / (CA_EPS + fabs(g - gshift[2]));
+    const float p3 = 1.0f / (CA_EPS + fabs(g - gshift[3]));
+
+    grbdiffint = (p0 * grbdiff[0] + p1 * grbdiff[1] + p2 * grbdiff[2] + p3 * grbdiff[3])
+               / (p0 + p1 + p2 + p3);
+
+    if(fabs(grbdiffold) > fabs(grbdiffint))
+      res = g - grbdiffint;
+  }
+
+  // if colour difference interpolation overshot the correction, just desaturate
+  if(grbdiffold * grbdiffint < 0.0f)
+    res = g - 0.5f * (grbdiffold + grbdiffint);
+
+  out[idx] = res;
+}
+
+// per site ratio of uncorrected and corrected red/blue, on half size planes
+__kernel void cacorrect_avoidshift_factors(global const float *oldraw,
+                                           global const float *raw,
+                                           global float *redfactor,
+                                           global float *bluefactor,
+                                           const int w,
+                                           const int height,
+                                           const unsigned int filters)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  const int h_width = (w + 1) / 2;
+  if(x >= h_width || y >= (height + 1) / 2) return;
+
+  for(int i = 0; i < 2; i++)
+  {
+    for(int j = 0; j < 2; j++)
+    {
+      const int color = FC(2 * y + i, 2 * x + j, filters);
+      if(color & 1) continue;
+      // odd sizes: use the value of the preceding row or column
+      const int row = 2 * y + i < height ? 2 * y + i : 2 * y + i - 2;
+      const int col = 2 * x + j < w ? 2 * x + j : 2 * x + j - 2;
+      if(row < 0 || col < 0) continue;
+      const int idx = mad24(row, w, col);
+      global float *nongreen = color == 0 ? redfactor : bluefactor;
+      nongreen[mad24(y, h_width, x)] = clamp(oldraw[idx] / raw[idx], 0.5f, 2.0f);
+    }
+  }
+}
+
+__kernel void cacorrect_avoidshift_apply(global float *raw,
+                                         global const float *redfactor,
+                                         global const float *bluefactor,
+                                         const int w,
+                                         const int height,
+                                         const unsigned int filters)
+{
+  const int col = get_global_id(0);
+  const int row = get_global_id(1);
+  if(col >= w - 2 || row < 2 || row >= height - 2) return;
+
+  const int color = FC(row, col, filters);
+  if(color & 1) return;
+
+  global const float *nongreen = color == 0 ? redfactor : bluefactor;
+  raw[mad24(row, w, col)] *= nongreen[mad24(row / 2, (w + 1) / 2, col / 2)];
+}
+
@@ -0,0 +1,169 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common.h"
+#include "colorspace.h"
+
+// the tiled CLAHE of the legacy local contrast module, see src/iop/clahe.c
+
+#define BINS 256
+
+static inline int
+_tile_center(const int t, const int step, const int size)
+{
+  return min(t * step, size - 1);
+}
+
+kernel void
+clahe_zero(global int *hist, const int size)
+{
+  const int i = get_global_id(0);
+  if(i >= size) return;
+
+  hist[i] = 0;
+}
+
+kernel void
+clahe_bins(read_only image2d_t in, global int *bins, const int width, const int height)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float4 pixel = read_imagef(in, sampleri, (int2)(x, y));
+  const float pmax = clamp(fmax(pixel.x, fmax(pixel.y, pixel.z)), 0.0f, 1.0f);
+  const float pmin = clamp(fmin(pixel.x, fmin(pixel.y, pixel.z)), 0.0f, 1.0f);
+  bins[mad24(y, width, x)] = (int)((pmax + pmin) / 2.0f * (float)BINS + 0.5f);
+}
+
+// add each pixel to the histograms of all tile centers within rad
+kernel void
+clahe_histogram(global const int *bins, global int *hist, const int width, const int height,
+                const int rad, const int step, const int ntx, const int nty)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int b = bins[mad24(y, width, x)];
+  const int tx0 = max(0, (x - rad) / step);
+  const int tx1 = min(ntx - 1, (x + rad) / step + 1);
+  const int ty0 = max(0, (y - rad) / step);
+  const int ty1 = min(nty - 1, (y + rad) / step + 1);
+
+  for(int ty = ty0; ty <= ty1; ty++)
+  {
+    if(abs(y - _tile_center(ty, step, height)) > rad) continue;
+    for(int tx = tx0; tx <= tx1; tx++)
+    {
+      if(abs(x - _tile_center(tx, step, width)) > rad) continue;
+      atomic_inc(hist + mad24(ty, ntx, tx) * (BINS + 1) + b);
+    }
+  }
+}
+
+// clip the histogram of each tile and turn it into the mapping of its bins
+kernel void
+clahe_mapping(global int *hist, global float *map, const int width, const int height, const int rad,
+              const int step, const int ntx, const int nty, const float slope)
+{
+  const int tx = get_global_id(0);
+  const int ty = get_global_id(1);
+  if(tx >= ntx || ty >= nty) return;
+
+  const int cx = _tile_center(tx, step, width);
+  const int cy = _tile_center(ty, step, height);
+  const int n = (min(width, cx + rad + 1) - max(0, cx - rad)) * (min(height, cy + rad + 1) - max(0, cy - rad));
+  const int limit = (int)(slope * n / BINS + 0.5f);
+
+  global int *h = hist + mad24(ty, ntx, tx) * (BINS + 1);
+  global float *m = map + mad24(ty, ntx, tx) * (BINS + 1);
+
+  int ce = 0, ceb = 0;
+  do
+  {
+    ceb = ce;
+    ce = 0;
+    for(int b = 0; b <= BINS; b++)
+    {
+      const int d = h[b] - limit;
+      if(d > 0)
+      {
+        ce += d;
+        h[b] = limit;
+      }
+    }
+
+    const int d = (int)(ce / (float)(BINS + 1));
+    const int r = ce % (BINS + 1);
+    for(int b = 0; b <= BINS; b++) h[b] += d;
+
+    if(r != 0)
+    {
+      const int s = (int)(BINS / (float)r);
+      for(int b = 0; b <= BINS; b += s) h[b]++;
+    }
+  } while(ce != ceb);
+
+  int hmin = BINS;
+  for(int b = 0; b < hmin; b++)
+    if(h[b] != 0) hmin = b;
+
+  int cdfmax = 0;
+  for(int b = hmin; b <= BINS; b++) cdfmax += h[b];
+
+  const int cdfmin = h[hmin];
+  const float norm = cdfmax > cdfmin ? 1.0f / (cdfmax - cdfmin) : 0.0f;
+
+  int cdf = 0;
+  for(int b = 0; b <= BINS; b++)
+  {
+    if(b >= hmin) cdf += h[b];
+    m[b] = b < hmin ? 0.0f : (cdf - cdfmin) * norm;
+  }
+}
+
+// bilinear interpolation of the mappings of the surrounding tile centers
+kernel void
+clahe_apply(read_only image2d_t in, write_only image2d_t out, global const int *bins,
+            global const float *map, const int width, const int height, const int step, const int ntx,
+            const int nty)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int tx0 = x / step;
+  const int tx1 = min(tx0 + 1, ntx - 1);
+  const int ty0 = y / step;
+  const int ty1 = min(ty0 + 1, nty - 1);
+  const int cx0 = _tile_center(tx0, step, width);
+  const int cx1 = _tile_center(tx1, step, width);
+  const int cy0 = _tile_center(ty0, step, height);
+  const int cy1 = _tile_center(ty1, step, height);
+  const float fx = cx1 > cx0 ? (float)(x - cx0) / (cx1 - cx0) : 0.0f;
+  const float fy = cy1 > cy0 ? (float)(y - cy0) / (cy1 - cy0) : 0.0f;
+
+  global const float *m = map + bins[mad24(y, width, x)];
+  const float l0 = (1.0f - fx) * m[mad24(ty0, ntx, tx0) * (BINS + 1)] + fx * m[mad24(ty0, ntx, tx1) * (BINS + 1)];
+  const float l1 = (1.0f - fx) * m[mad24(ty1, ntx, tx0) * (BINS + 1)] + fx * m[mad24(ty1, ntx, tx1) * (BINS + 1)];
+
+  float4 hsl = RGB_2_HSL(read_imagef(in, sampleri, (int2)(x, y)));
+  hsl.z = (1.0f - fy) * l0 + fy * l1;
+  write_imagef(out, (int2)(x, y), HSL_2_RGB(hsl));
+}
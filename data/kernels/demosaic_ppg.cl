@@ -539,6 +539,89 @@ clip_and_zoom_demosaic_half_size(__read_only image2d_t in,
 }
 
 
+/**
+ * like clip_and_zoom_demosaic_half_size() but reading the unprocessed raw
+ * mosaic, the raw preparation, white balance and clipping of the modules
+ * before demosaic are applied on the fly to every sample.
+ */
+static inline float
+_raw_fused_sample(read_only image2d_t in, const int x, const int y,
+                  const int uint16, const int cx, const int cy,
+                  constant float *sub, constant float *div,
+                  constant float *mul, constant float *clip,
+                  const unsigned int filters)
+{
+  const float raw = uint16 ? (float)read_imageui(in, sampleri, (int2)(x + cx, y + cy)).x
+                           : read_imagef(in, sampleri, (int2)(x + cx, y + cy)).x;
+  const int p = (((y + cy) & 1) << 1) + ((x + cx) & 1);
+  const int c = FC(y, x, filters);
+  return fmin(clip[c], mul[c] * (raw - sub[p]) / div[p]);
+}
+
+kernel void
+clip_and_zoom_demosaic_half_size_raw(read_only image2d_t in,
+                                     write_only image2d_t out,
+                                     const int width,
+                                     const int height,
+                                     const int rin_wd,
+                                     const int rin_ht,
+                                     const float r_scale,
+                                     const unsigned int filters,
+                                     const int uint16,
+                                     const int cx,
+                                     const int cy,
+                                     constant float *sub,
+                                     constant float *div,
+                                     constant float *mul,
+                                     constant float *clip)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  float4 color = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
+  float weight = 0.0f;
+
+  const float px_footprint = 1.0f/r_scale;
+  const int samples = round(px_footprint/2.0f);
+
+  int trggbx = 0, trggby = 0;
+  if(FC(trggby, trggbx+1, filters) != 1) trggbx++;
+  if(FC(trggby, trggbx,   filters) != 0)
+  {
+    trggbx = (trggbx + 1)&1;
+    trggby++;
+  }
+  const int2 rggb = (int2)(trggbx, trggby);
+
+  const float2 f = (float2)(x * px_footprint, y * px_footprint);
+  int2 p = (int2)((int)f.x & ~1, (int)f.y & ~1);
+  const float2 d = (float2)((f.x - p.x)/2.0f, (f.y - p.y)/2.0f);
+
+  p += rggb;
+
+  for(int j=0;j<=samples+1;j++) for(int i=0;i<=samples+1;i++)
+  {
+    const int xx = p.x + 2*i;
+    const int yy = p.y + 2*j;
+
+    if(xx + 1 >= rin_wd || yy + 1 >= rin_ht) continue;
+
+    const float xfilter = (i == 0) ? 1.0f - d.x : ((i == samples+1) ? d.x : 1.0f);
+    const float yfilter = (j == 0) ? 1.0f - d.y : ((j == samples+1) ? d.y : 1.0f);
+
+    const float p1 = _raw_fused_sample(in, xx,   yy,   uint16, cx, cy, sub, div, mul, clip, filters);
+    const float p2 = _raw_fused_sample(in, xx+1, yy,   uint16, cx, cy, sub, div, mul, clip, filters);
+    const float p3 = _raw_fused_sample(in, xx,   yy+1, uint16, cx, cy, sub, div, mul, clip, filters);
+    const float p4 = _raw_fused_sample(in, xx+1, yy+1, uint16, cx, cy, sub, div, mul, clip, filters);
+    color += yfilter*xfilter*(float4)(p1, (p2+p3)*0.5f, p4, 0.0f);
+    weight += yfilter*xfilter;
+  }
+  color = (weight > 0.0f) ? fmax(0.0f, color)/weight : (float4)0.0f;
+  write_imagef (out, (int2)(x, y), color);
+}
+
 /**
  * fill greens pass of pattern pixel grouping.
  * in (float) or (float4).x -> out (float4)
@@ -311,7 +311,8 @@ build_mask(read_only image2d_t in, write_only image2d_t mask,
 
 kernel void
 inpaint_mask(write_only image2d_t inpainted, read_only image2d_t original,
-              read_only image2d_t mask, const int width, const int height)
+              read_only image2d_t mask, const int width, const int height,
+              const int x_offset, const int y_offset)
 {
   const int x = get_global_id(0);
   const int y = get_global_id(1);
@@ -323,13 +324,29 @@ inpaint_mask(write_only image2d_t inpainted, read_only image2d_t original,
 
   if(m)
   {
-    unsigned int state[4] = { splitmix32(x + 1), splitmix32((x + 1) * (y + 3)), splitmix32(1337), splitmix32(666) };
-    xoshiro128plus(state);
-    xoshiro128plus(state);
-    xoshiro128plus(state);
-    xoshiro128plus(state);
-    pix_out = fabs(gaussian_noise_simd(pix_in, pix_in, state));
+    pix_out = fabs(dt_noise_generator_simd(DT_NOISE_GAUSSIAN, x + x_offset, y + y_offset, 1337,
+                                           pix_in, pix_in));
   }
 
   write_imagef(inpainted, (int2)(x, y), pix_out);
 }
+
+// per row sums of the absolute change of one iteration and of its input, for the convergence check
+kernel void
+diffuse_residual(read_only image2d_t in, read_only image2d_t out, global float2 *rows,
+                 const int width, const int height)
+{
+  const int y = get_global_id(0);
+  if(y >= height) return;
+
+  float2 sum = (float2)0.0f;
+  for(int x = 0; x < width; x++)
+  {
+    const float4 pix_in = read_imagef(in, samplerA, (int2)(x, y));
+    const float4 pix_out = read_imagef(out, samplerA, (int2)(x, y));
+    const float4 diff = fabs(pix_out - pix_in);
+    const float4 norm = fabs(pix_in);
+    sum += (float2)(diff.x + diff.y + diff.z, norm.x + norm.y + norm.z);
+  }
+  rows[y] = sum;
+}
@@ -0,0 +1,151 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common.h"
+
+/*
+  Exact euclidean distance transform, see src/common/distance_transform.c.
+  The separable Felzenszwalb/Huttenlocher algorithm runs one work item per
+  column and then one per row of a grid that is optionally downscaled by an
+  integer factor for preview pipes.
+*/
+
+#define DT_DISTANCE_TRANSFORM_NONE 0
+#define DT_DISTANCE_TRANSFORM_MASK 1
+#define DT_DISTANCE_TRANSFORM_MAX 1e20f
+
+/*
+  1d squared distance transform of the n samples at f[q * stride], done in
+  place. z, v and g have the same stride and hold the parabola boundaries,
+  their vertices and the values at the vertices.
+*/
+static void
+_distance_transform_1d(global float *f, global float *z, global int *v, global float *g, const int n,
+                       const int stride)
+{
+  int k = 0;
+  v[0] = 0;
+  g[0] = f[0];
+  z[0] = -DT_DISTANCE_TRANSFORM_MAX;
+  z[stride] = DT_DISTANCE_TRANSFORM_MAX;
+  for(int q = 1; q < n; q++)
+  {
+    const float fq = f[q * stride];
+    const float qq = fq + (float)q * (float)q;
+    int vk = v[k * stride];
+    float s = qq - (g[k * stride] + (float)vk * (float)vk);
+    while(s <= z[k * stride] * (float)(2 * q - 2 * vk))
+    {
+      k--;
+      vk = v[k * stride];
+      s = qq - (g[k * stride] + (float)vk * (float)vk);
+    }
+    s /= (float)(2 * q - 2 * vk);
+    k++;
+    v[k * stride] = q;
+    g[k * stride] = fq;
+    z[k * stride] = s;
+    z[(k + 1) * stride] = DT_DISTANCE_TRANSFORM_MAX;
+  }
+
+  k = 0;
+  for(int q = 0; q < n; q++)
+  {
+    while(z[(k + 1) * stride] < (float)q) k++;
+    const float d = (float)(q - v[k * stride]);
+    f[q * stride] = d * d + g[k * stride];
+  }
+}
+
+// seed the grid from the input and transform along columns
+kernel void
+distance_transform_columns(read_only image2d_t in, global float *dist, global float *z, global int *v,
+                           global float *g, const int width, const int height, const int cwidth,
+                           const int cheight, const int scale, const float clip, const int mode)
+{
+  const int x = get_global_id(0);
+  if(x >= cwidth) return;
+
+  for(int y = 0; y < cheight; y++)
+  {
+    // a downscaled cell is a seed if any of its pixels is
+    float f = DT_DISTANCE_TRANSFORM_MAX;
+    for(int j = y * scale; j < min(height, (y + 1) * scale); j++)
+    {
+      for(int i = x * scale; i < min(width, (x + 1) * scale); i++)
+      {
+        const float val = read_imagef(in, samplerA, (int2)(i, j)).x;
+        f = fmin(f, mode == DT_DISTANCE_TRANSFORM_MASK ? (val < clip ? 0.0f : DT_DISTANCE_TRANSFORM_MAX) : val);
+      }
+    }
+    dist[mad24(y, cwidth, x)] = f;
+  }
+
+  _distance_transform_1d(dist + x, z + x, v + x, g + x, cheight, cwidth);
+}
+
+// transform along rows, take the root and keep the maximum of each row
+kernel void
+distance_transform_rows(global float *dist, global float *z, global int *v, global float *g,
+                        global float *rowmax, const int cwidth, const int cheight, const int scale)
+{
+  const int y = get_global_id(0);
+  if(y >= cheight) return;
+
+  global float *row = dist + mad24(y, cwidth, 0);
+  const int k = mad24(y, cwidth + 1, 0);
+  _distance_transform_1d(row, z + k, v + k, g + k, cwidth, 1);
+
+  float dmax = 0.0f;
+  for(int x = 0; x < cwidth; x++)
+  {
+    const float d = scale * sqrt(row[x]);
+    row[x] = d;
+    dmax = fmax(dmax, d);
+  }
+  rowmax[y] = dmax;
+}
+
+// write the distances, bilinear upsampling from a downscaled grid
+kernel void
+distance_transform_output(global const float *dist, write_only image2d_t out, const int width,
+                          const int height, const int cwidth, const int cheight, const int scale)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  float d;
+  if(scale == 1)
+    d = dist[mad24(y, cwidth, x)];
+  else
+  {
+    const float fx = clamp(((float)x + 0.5f) / scale - 0.5f, 0.0f, (float)(cwidth - 1));
+    const float fy = clamp(((float)y + 0.5f) / scale - 0.5f, 0.0f, (float)(cheight - 1));
+    const int x0 = (int)fx;
+    const int y0 = (int)fy;
+    const int x1 = min(x0 + 1, cwidth - 1);
+    const int y1 = min(y0 + 1, cheight - 1);
+    const float wx = fx - x0;
+    const float wy = fy - y0;
+    const float d0 = mix(dist[mad24(y0, cwidth, x0)], dist[mad24(y0, cwidth, x1)], wx);
+    const float d1 = mix(dist[mad24(y1, cwidth, x0)], dist[mad24(y1, cwidth, x1)], wx);
+    d = mix(d0, d1, wy);
+  }
+  write_imagef(out, (int2)(x, y), (float4)(d, 0.0f, 0.0f, 0.0f));
+}
@@ -122,3 +122,47 @@ dwt_init_buffer(global float4 *buffer, int width, int height)
 
   buffer[idx] = 0.f;
 }
+
+// single channel wavelet denoise, see dwt_denoise() in common/dwt.c
+
+// first, "vertical" pass, reflect rows beyond the borders
+kernel void
+dwt_denoise_vert_1ch(global float *out, global const float *in, const int width, const int height,
+                     const int vscale)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const int above = abs(y - vscale);
+  const int below = (y + vscale < height) ? (y + vscale) : 2 * (height - 1) - (y + vscale);
+
+  out[mad24(y, width, x)] = 2.f * in[mad24(y, width, x)] + in[mad24(above, width, x)]
+                            + in[mad24(below, width, x)];
+}
+
+// second, horizontal pass: overwrite details with coarse and accumulate
+// the part of the detail scale above the noise threshold
+kernel void
+dwt_denoise_horiz_1ch(global const float *coarse, global float *details, global float *accum,
+                      const int width, const int height, const int hscale, const float thold,
+                      const int first, const int last)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const int left = (x < hscale) ? hscale - x : x - hscale;
+  const int right = (x + hscale < width) ? x + hscale : 2 * width - 2 - (x + hscale);
+  const int idx = mad24(y, width, x);
+
+  const float hat = (2.f * coarse[idx] + coarse[mad24(y, width, left)] + coarse[mad24(y, width, right)]) / 16.f;
+  const float diff = details[idx] - hat;
+  const float sum = (first ? 0.f : accum[idx]) + fmax(diff - thold, 0.0f) + fmin(diff + thold, 0.0f);
+
+  // add the details to the residue to create the final denoised result
+  details[idx] = last ? hat + sum : hat;
+  accum[idx] = sum;
+}
@@ -1071,24 +1071,18 @@ filmic_show_mask(read_only image2d_t in, write_only image2d_t out,
 kernel void
 filmic_inpaint_noise(read_only image2d_t in, read_only image2d_t mask, write_only image2d_t out,
                      const int width, const int height, const float noise_level, const float threshold,
-                     const dt_noise_distribution_t noise_distribution)
+                     const dt_noise_distribution_t noise_distribution,
+                     const int x_offset, const int y_offset)
 {
   const unsigned int x = get_global_id(0);
   const unsigned int y = get_global_id(1);
 
   if(x >= width || y >= height) return;
 
-  // Init random number generator
-  unsigned int state[4] = { splitmix32(x + 1), splitmix32((x + 1) * (y + 3)), splitmix32(1337), splitmix32(666) };
-  xoshiro128plus(state);
-  xoshiro128plus(state);
-  xoshiro128plus(state);
-  xoshiro128plus(state);
-
-  // create noise
+  // create noise, seeded by the absolute pixel coordinates like the CPU path
   const float4 i = read_imagef(in, sampleri, (int2)(x, y));
   const float4 sigma = i * noise_level / threshold;
-  const float4 noise = dt_noise_generator_simd(noise_distribution, i, sigma, state);
+  const float4 noise = dt_noise_generator_simd(noise_distribution, x + x_offset, y + y_offset, 1337, i, sigma);
   const float weight = (read_imagef(mask, sampleri, (int2)(x, y))).x;
   const float4 o = fmax(i * (1.0f - weight) + weight * noise, 0.f);
   write_imagef(out, (int2)(x, y), o);
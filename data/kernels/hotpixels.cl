@@ -0,0 +1,130 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common.h"
+
+#define HOTPIXELS_BAYER 0
+#define HOTPIXELS_XTRANS 1
+#define HOTPIXELS_MONOCHROME 2
+
+/*
+  Detect hot pixels, see process_bayer(), process_xtrans() and
+  process_monochrome() in src/iop/hotpixels.c. fixed gets the
+  replacement value of a hot pixel and -1 otherwise.
+*/
+kernel void
+hotpixels_detect(read_only image2d_t in, global float *fixed, global int *count, const int width,
+                 const int height, const int mode, const float threshold, const float multiplier,
+                 const int min_neighbours, global const int (*const offsets)[6][4][2])
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int border = (mode == HOTPIXELS_MONOCHROME) ? 1 : 2;
+  const int k = mad24(y, width, x);
+  fixed[k] = -1.0f;
+  if(x < border || y < border || x >= width - border || y >= height - border) return;
+
+  const float pixel = read_imagef(in, sampleri, (int2)(x, y)).x;
+  if(!(pixel > threshold)) return;
+
+  const float mid = pixel * multiplier;
+  int found = 0;
+  float maxin = 0.0f;
+  for(int n = 0; n < 4; n++)
+  {
+    int2 offset;
+    if(mode == HOTPIXELS_XTRANS)
+      offset = (int2)(offsets[y % 6][x % 6][n][0], offsets[y % 6][x % 6][n][1]);
+    else
+    {
+      const int2 dir[4] = { (int2)(-1, 0), (int2)(0, -1), (int2)(1, 0), (int2)(0, 1) };
+      offset = border * dir[n];
+    }
+    const float other = read_imagef(in, sampleri, (int2)(x, y) + offset).x;
+    if(mid > other)
+    {
+      found++;
+      if(other > maxin) maxin = other;
+    }
+  }
+
+  if(found >= min_neighbours)
+  {
+    fixed[k] = maxin;
+    atomic_inc(count);
+  }
+}
+
+/*
+  Write the output. With markfixed the CPU code marks up to 10 sites left
+  and right of each fixed pixel with its value, row by row from left to
+  right, so the last write to a site comes from the rightmost fixed pixel
+  marking it to its left, else the site itself, else the rightmost fixed
+  pixel marking it to its right.
+*/
+kernel void
+hotpixels_write_output(read_only image2d_t in, write_only image2d_t out, global const float *fixed,
+                       const int width, const int height, const int mode, const int markfixed,
+                       const int rx, const int ry, global const unsigned char (*const xtrans)[6])
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int k = mad24(y, width, x);
+  const int step = (mode == HOTPIXELS_BAYER) ? 2 : 1;
+  const int start = (mode == HOTPIXELS_XTRANS) ? 2 : step;
+  float4 pixel = read_imagef(in, sampleri, (int2)(x, y));
+
+  if(markfixed)
+  {
+    const int c = FCxtrans(y + ry, x + rx, xtrans);
+    bool marked = false;
+    for(int i = 10 - (10 % step); i >= start && !marked; i -= step)
+    {
+      if(x + i >= width) continue;
+      if(mode == HOTPIXELS_XTRANS && FCxtrans(y + ry, x + i + rx, xtrans) != c) continue;
+      if(fixed[k + i] >= 0.0f)
+      {
+        pixel = (float4)(read_imagef(in, sampleri, (int2)(x + i, y)).x);
+        marked = true;
+      }
+    }
+    if(!marked && fixed[k] >= 0.0f)
+    {
+      pixel = (float4)(fixed[k]);
+      marked = true;
+    }
+    for(int i = start; i <= 10 && !marked; i += step)
+    {
+      if(x - i < 0) break;
+      if(mode == HOTPIXELS_XTRANS && FCxtrans(y + ry, x - i + rx, xtrans) != c) continue;
+      if(fixed[k - i] >= 0.0f)
+      {
+        pixel = (float4)(read_imagef(in, sampleri, (int2)(x - i, y)).x);
+        marked = true;
+      }
+    }
+  }
+  else if(fixed[k] >= 0.0f)
+    pixel = (float4)(fixed[k]);
+
+  write_imagef(out, (int2)(x, y), pixel);
+}
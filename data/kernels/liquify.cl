@@ -129,3 +129,56 @@ warp_kernel (read_only image2d_t in,
   Sxy = fmax(0.0f, Sxy / fmax(1e-7f, norm.x * norm.y));
   write_imagef (out, pos - roi_out_origin, Sxy);
 }
+
+// must match src/iop/liquify.c
+#define LIQUIFY_TILE 64
+#define LOOKUP_OVERSAMPLE 10
+#define DT_LIQUIFY_WARP_TYPE_LINEAR 0
+
+typedef struct {
+  float strength_x, strength_y;
+  float abs_strength;
+  int x, y;
+  int iradius;
+  int type;
+  int lut;
+  int table_size;
+} dt_liquify_cl_warp_t;
+
+/*
+  Rasterize the round stamps of all warps into the distortion map, see
+  apply_round_stamp() in src/iop/liquify.c. Each pixel only visits the
+  warps listed for its tile.
+*/
+kernel void
+liquify_map(global float2 *map, const int map_x, const int map_y, const int width, const int height,
+            global const dt_liquify_cl_warp_t *warps, global const float *lut,
+            global const int *tile_start, global const int *tile_warps, const int tiles_x)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int tile = mad24(y / LIQUIFY_TILE, tiles_x, x / LIQUIFY_TILE);
+  float2 sum = (float2)0.0f;
+
+  for(int i = tile_start[tile]; i < tile_start[tile + 1]; i++)
+  {
+    global const dt_liquify_cl_warp_t *w = warps + tile_warps[i];
+    const int dx = x + map_x - w->x;
+    const int dy = y + map_y - w->y;
+    if(abs(dx) > w->iradius || abs(dy) > w->iradius) continue;
+
+    const float dist = sqrt((float)(dx * dx) + (float)(dy * dy));
+    const int idist = (int)round(dist * LOOKUP_OVERSAMPLE);
+    if(idist >= w->table_size) continue;
+
+    const float l = lut[w->lut + idist];
+    if(w->type == DT_LIQUIFY_WARP_TYPE_LINEAR)
+      sum -= l * (float2)(w->strength_x, w->strength_y);
+    else
+      sum -= (w->abs_strength * l / w->iradius) * (float2)(dx, dy);
+  }
+
+  map[mad24(y, width, x)] = sum;
+}
@@ -0,0 +1,227 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common.h"
+
+/*
+  Rasterisation of drawn shapes, see src/develop/masks/brush.c, path.c and
+  group.c. The shapes are tessellated on the cpu, the kernels draw one
+  segment or one edge per work item into a linear float buffer. Masks are
+  positive so their float bits are ordered like ints, which lets the
+  segments be merged with atomic_max().
+*/
+
+// the bits of 1.0f, toggled by the edge-flag fill
+#define MASKS_ONE_BITS 0x3f800000
+
+#define GROUP_COMBINE_COPY 0
+#define GROUP_COMBINE_UNION 1
+#define GROUP_COMBINE_INTERSECTION 2
+#define GROUP_COMBINE_DIFFERENCE 3
+#define GROUP_COMBINE_SUM 4
+#define GROUP_COMBINE_EXCLUSION 5
+
+static inline void _masks_max(global float *buf, const int index, const float value)
+{
+  atomic_max((global volatile int *)(buf + index), as_int(fmax(value, 0.0f)));
+}
+
+kernel void
+masks_fill(global float *buf, const int npixels, const float value)
+{
+  const int k = get_global_id(0);
+  if(k >= npixels) return;
+  buf[k] = value;
+}
+
+kernel void
+masks_brush_falloff(global float *buf, global const int4 *segments, global const float2 *payload,
+                    const int count, const int bw, const int bh)
+{
+  const int n = get_global_id(0);
+  if(n >= count) return;
+
+  const int4 s = segments[n];
+  const float hardness = payload[n].x;
+  const float density = payload[n].y;
+
+  // segment length (increase by 1 to avoid division-by-zero special case handling)
+  const int l = (int)sqrt((float)((s.z - s.x) * (s.z - s.x) + (s.w - s.y) * (s.w - s.y))) + 1;
+  const int solid = hardness * l;
+
+  const float lx = (float)(s.z - s.x) / (float)l;
+  const float ly = (float)(s.w - s.y) / (float)l;
+
+  const int dx = lx <= 0 ? -1 : 1;
+  const int dy = ly <= 0 ? -1 : 1;
+
+  float fx = s.x;
+  float fy = s.y;
+
+  float op = density;
+  const float dop = density / (float)(l - solid);
+
+  for(int i = 0; i < l; i++)
+  {
+    const int x = fx;
+    const int y = fy;
+
+    fx += lx;
+    fy += ly;
+    if(i > solid) op -= dop;
+
+    if(x < 0 || x >= bw || y < 0 || y >= bh) continue;
+
+    const int index = y * bw + x;
+    _masks_max(buf, index, op);
+    // these ones are to avoid gaps due to int rounding
+    if(x + dx >= 0 && x + dx < bw) _masks_max(buf, index + dx, op);
+    if(y + dy >= 0 && y + dy < bh) _masks_max(buf, index + dy * bw, op);
+  }
+}
+
+kernel void
+masks_path_edges(global float *buf, global const float2 *points, const int count,
+                 const int width, const int height)
+{
+  const int i = get_global_id(0);
+  if(i >= count) return;
+
+  // the edge from the previous point of the closed polygon to this one
+  float2 p0 = points[i == 0 ? count - 1 : i - 1];
+  float2 p1 = points[i];
+  if(p0.y > p1.y)
+  {
+    const float2 tmp = p0;
+    p0 = p1;
+    p1 = tmp;
+  }
+
+  const float m = (p0.x - p1.x) / (p0.y - p1.y);
+
+  for(int yy = (int)ceil(p0.y); (float)yy < p1.y; yy++)
+  {
+    const float xcross = p0.x + m * (yy - p0.y);
+
+    int xx = floor(xcross);
+    if((float)xx + 0.5f <= xcross)
+      xx++;
+
+    if(xx < 0 || xx >= width || yy < 0 || yy >= height) continue;
+
+    atomic_xor((global volatile int *)(buf + yy * width + xx), MASKS_ONE_BITS);
+  }
+}
+
+kernel void
+masks_path_fill(global float *buf, const int width,
+                const int xmin, const int xmax, const int ymin, const int ymax)
+{
+  const int yy = ymin + get_global_id(0);
+  if(yy > ymax) return;
+
+  int state = 0;
+  for(int xx = xmin; xx <= xmax; xx++)
+  {
+    const int index = yy * width + xx;
+    if(buf[index] > 0.5f) state = !state;
+    if(state) buf[index] = 1.0f;
+  }
+}
+
+kernel void
+masks_path_falloff(global float *buf, global const int4 *segments, const int count,
+                   const int bw, const int bh)
+{
+  const int n = get_global_id(0);
+  if(n >= count) return;
+
+  const int4 s = segments[n];
+
+  // segment length
+  const int l = (int)sqrt((float)((s.z - s.x) * (s.z - s.x) + (s.w - s.y) * (s.w - s.y))) + 1;
+
+  const float lx = s.z - s.x;
+  const float ly = s.w - s.y;
+
+  const int dx = lx < 0 ? -1 : 1;
+  const int dy = ly < 0 ? -1 : 1;
+
+  for(int i = 0; i < l; i++)
+  {
+    const int x = (int)((float)i * lx / (float)l) + s.x;
+    const int y = (int)((float)i * ly / (float)l) + s.y;
+    const float op = 1.0f - (float)i / (float)l;
+
+    if(x >= 0 && x < bw && y >= 0 && y < bh)
+      _masks_max(buf, y * bw + x, op);
+    // these ones are to avoid gaps due to int rounding
+    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+      _masks_max(buf, y * bw + x + dx, op);
+    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+      _masks_max(buf, (y + dy) * bw + x, op);
+  }
+}
+
+kernel void
+masks_combine(global float *dest, global const float *shape, const int npixels,
+              const float opacity, const int inverted, const int mode)
+{
+  const int k = get_global_id(0);
+  if(k >= npixels) return;
+
+  const float mask = opacity * (inverted ? 1.0f - shape[k] : shape[k]);
+  const float b1 = dest[k];
+  float v;
+
+  switch(mode)
+  {
+    case GROUP_COMBINE_UNION:
+      v = fmax(b1, mask);
+      break;
+    case GROUP_COMBINE_INTERSECTION:
+      v = fmin(fmax(b1, 0.0f), fmax(mask, 0.0f));
+      break;
+    case GROUP_COMBINE_DIFFERENCE:
+      v = (b1 > 0.0f && mask > 0.0f) ? b1 * (1.0f - mask) : b1;
+      break;
+    case GROUP_COMBINE_SUM:
+      v = fmin(1.0f, b1 + mask);
+      break;
+    case GROUP_COMBINE_EXCLUSION:
+      v = (b1 > 0.0f && mask > 0.0f) ? fmax((1.0f - b1) * mask, b1 * (1.0f - mask)) : fmax(b1, mask);
+      break;
+    case GROUP_COMBINE_COPY:
+    default:
+      v = mask;
+      break;
+  }
+  dest[k] = v;
+}
+
+kernel void
+masks_output(global const float *buf, write_only image2d_t out,
+             const int width, const int height, const int inverted)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float v = buf[y * width + x];
+  write_imagef(out, (int2)(x, y), (float4)(inverted ? 1.0f - v : v, 0.0f, 0.0f, 0.0f));
+}
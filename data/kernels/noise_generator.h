@@ -16,7 +16,7 @@
    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-// This is the OpenCL translation of common/noise_generator.h
+// This is the OpenCL translation of develop/noise_generator.h
 
 
 typedef enum dt_noise_distribution_t
@@ -27,128 +27,72 @@ typedef enum dt_noise_distribution_t
 } dt_noise_distribution_t;
 
 
-static inline unsigned int splitmix32(const unsigned long seed)
-{
-  // fast random number generator
-  // reference : https://gist.github.com/imneme/6179748664e88ef3c34860f44309fc71
-  unsigned long result = (seed ^ (seed >> 33)) * 0x62a9d9ed799705f5ul;
-  result = (result ^ (result >> 28)) * 0xcb24d0a5c88c35b3ul;
-  return (unsigned int)(result >> 32);
-}
-
-
+// Counter-based random numbers: Philox4x32, see develop/noise_generator.h.
+// The integer stream and the uniform numbers are bit-identical to the CPU path.
+#define DT_NOISE_PHILOX_ROUNDS 7
+#define DT_NOISE_PHILOX_M0 0xD2511F53u
+#define DT_NOISE_PHILOX_M1 0xCD9E8D57u
+#define DT_NOISE_PHILOX_W0 0x9E3779B9u
+#define DT_NOISE_PHILOX_W1 0xBB67AE85u
 
-static inline unsigned rol32(const unsigned int x, const int k)
-{
-  return (x << k) | (x >> (32 - k));
-}
 
-
-static inline float xoshiro128plus(uint state[4])
+static inline float4 dt_noise_uniform4(const uint x, const uint y, const uint seed)
 {
-  // fast random number generator
-  // reference : http://prng.di.unimi.it/
-  const unsigned int result = state[0] + state[3];
-  const unsigned int t = state[1] << 9;
-
-  state[2] ^= state[0];
-  state[3] ^= state[1];
-  state[1] ^= state[2];
-  state[0] ^= state[3];
-
-  state[2] ^= t;
-  state[3] = rol32(state[3], 11);
-
-  return (float)(result >> 8) * 0x1.0p-24f; // take the first 24 bits and put them in mantissa
-}
-
-
-static inline float4 uniform_noise_simd(const float4 mu, const float4 sigma, uint state[4])
-{
-  const float4 noise = { xoshiro128plus(state), xoshiro128plus(state), xoshiro128plus(state), 0.f };
-  return mu + 2.0f * (noise - 0.5f) * sigma;
-}
+  // 4 uniform random numbers in [0 ; 1[ for the pixel (x, y)
+  uint4 c = (uint4)(x, y, 0u, 0u);
+  uint k0 = seed, k1 = 0u;
 
+  for(int r = 0; r < DT_NOISE_PHILOX_ROUNDS; r++)
+  {
+    const uint hi0 = mul_hi(DT_NOISE_PHILOX_M0, c.x);
+    const uint lo0 = DT_NOISE_PHILOX_M0 * c.x;
+    const uint hi1 = mul_hi(DT_NOISE_PHILOX_M1, c.z);
+    const uint lo1 = DT_NOISE_PHILOX_M1 * c.z;
+    c = (uint4)(hi1 ^ c.y ^ k0, lo1, hi0 ^ c.w ^ k1, lo0);
+    k0 += DT_NOISE_PHILOX_W0;
+    k1 += DT_NOISE_PHILOX_W1;
+  }
 
-static inline float4 gaussian_noise_simd(const float4 mu, const float4 sigma, uint state[4])
-{
-  // Create gaussian noise centered in mu of standard deviation sigma
-  // state should be initialized with xoshiro256_init() before calling and private in thread
-  // flip needs to be flipped every next iteration
-  // reference : https://en.wikipedia.org/wiki/Box%E2%80%93Muller_transform
-
-  float4 u1, u2;
-
-  u1.x = xoshiro128plus(state);
-  u1.y = xoshiro128plus(state);
-  u1.z = xoshiro128plus(state);
-
-  u2.x = xoshiro128plus(state);
-  u2.y = xoshiro128plus(state);
-  u2.z = xoshiro128plus(state);
-
-  u1 = fmax(u1, FLT_MIN);
-
-  const float4 flip = { 1.0f, 0.0f, 1.0f, 0.0f };
-  const float4 flip_comp = { 0.0f, 1.0f, 0.0f, 0.0f };
-
-  // flip is a 4×1 boolean mask
-  const float4 noise = flip * native_sqrt(-2.0f * native_log(u1)) * native_cos(2.f * M_PI_F * u2) +
-                       flip_comp * native_sqrt(-2.0f * native_log(u1)) * native_sin(2.f * M_PI_F * u2);
-  return noise * sigma + mu;
+  // take the first 24 bits and put them in mantissa
+  return convert_float4(c >> 8) * 0x1.0p-24f;
 }
 
 
-static inline float4 poisson_noise_simd(const float4 mu, const float4 sigma, uint state[4])
+static inline float4 _noise_box_muller(const float4 u)
 {
-  // create poissonian noise - It's just gaussian noise with Anscombe transform applied
-  float4 u1, u2;
-
-  // we need to generate the random numbers in this order to match CPU path.
-  u1.x = xoshiro128plus(state);
-  u2.x = xoshiro128plus(state);
-  u1.y = xoshiro128plus(state);
-  u2.y = xoshiro128plus(state);
-  u1.z = xoshiro128plus(state);
-  u2.z = xoshiro128plus(state);
-
-  u1 = fmax(u1, (float4)FLT_MIN);
-
-  const float4 flip = { 1.0f, 0.0f, 1.0f, 0.0f };
-  const float4 flip_comp = { 0.0f, 1.0f, 0.0f, 0.0f };
-
-  // flip is a 4×1 boolean mask
-  const float4 noise = flip * native_sqrt(-2.0f * native_log(u1)) * native_cos(2.f * M_PI_F * u2) +
-                       flip_comp * native_sqrt(-2.0f * native_log(u1)) * native_sin(2.f * M_PI_F * u2);
-
-  // now we have gaussian noise, then apply Anscombe transform to get poissonian one
-  const float4 r = noise * sigma + 2.0f * native_sqrt(fmax(mu + (3.f / 8.f), 0.0f));
-  return ((r * r - sigma * sigma) / (4.f)) - (3.f / 8.f);
+  // both outputs of each Box-Muller pair are used, like on CPU.
+  // We don't use the native_ functions here to stay as close as possible to the CPU path.
+  const float2 r = sqrt(-2.0f * log(fmax(u.even, FLT_MIN)));
+  const float2 theta = 2.f * M_PI_F * u.odd;
+  return (float4)(r.x * cos(theta.x), r.x * sin(theta.x), r.y * cos(theta.y), r.y * sin(theta.y));
 }
 
 
 static inline float4 dt_noise_generator_simd(const dt_noise_distribution_t distribution,
-                                             const float4 mu, const float4 param,
-                                             uint state[4])
+                                             const uint x, const uint y, const uint seed,
+                                             const float4 mu, const float4 param)
 {
-  // vector version
+  // vector version: noise centered in mu of parameter param for the 4 channels of pixel (x, y)
+  const float4 u = dt_noise_uniform4(x, y, seed);
 
   switch(distribution)
   {
     case(DT_NOISE_UNIFORM):
     default:
     {
-      return uniform_noise_simd(mu, param, state);
+      return mu + 2.0f * (u - 0.5f) * param;
     }
 
     case(DT_NOISE_GAUSSIAN):
     {
-      return gaussian_noise_simd(mu, param, state);
+      return _noise_box_muller(u) * param + mu;
     }
 
     case(DT_NOISE_POISSONIAN):
     {
-      return poisson_noise_simd(mu, param, state);
+      // poissonian noise is just gaussian noise with Anscombe transform applied
+      const float4 r = _noise_box_muller(u) * param + 2.0f * sqrt(fmax(mu + (3.f / 8.f), 0.0f));
+      return ((r * r - param * param) / (4.f)) - (3.f / 8.f);
     }
   }
 }
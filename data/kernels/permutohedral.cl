@@ -0,0 +1,336 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common.h"
+
+/*
+  5d (x, y, r, g, b) permutohedral lattice for the surface blur module,
+  following src/iop/Permutohedral.h. The lattice lives in an open
+  addressing hash table whose slots store the index of the splat entry
+  that created them, so the keys of occupied slots can be compared
+  without any locking: all keys are written by permutohedral_keys() before
+  permutohedral_splat() inserts them.
+*/
+
+#define PL_D 5
+
+static void
+atomic_add_f(global float *val, const float delta)
+{
+  union
+  {
+    float f;
+    unsigned int i;
+  }
+  old_val;
+  union
+  {
+    float f;
+    unsigned int i;
+  }
+  new_val;
+
+  global volatile unsigned int *ival = (global volatile unsigned int *)val;
+
+  do
+  {
+    old_val.i = atomic_add(ival, 0);
+    new_val.f = old_val.f + delta;
+  }
+  while(atomic_cmpxchg(ival, old_val.i, new_val.i) != old_val.i);
+}
+
+static inline unsigned int
+_pl_hash(const short *key)
+{
+  unsigned int k = 0;
+  for(int i = 0; i < PL_D; i++)
+  {
+    k += (unsigned int)key[i];
+    k *= 2531011u;
+  }
+  return k;
+}
+
+static inline bool
+_pl_key_equal(global const short *keys, const int entry, const short *key)
+{
+  for(int i = 0; i < PL_D; i++)
+    if(keys[PL_D * entry + i] != key[i]) return false;
+  return true;
+}
+
+// slot of an existing lattice point, or -1
+static inline int
+_pl_lookup(global const int *table, global const short *keys, const short *key, const unsigned int mask)
+{
+  unsigned int h = _pl_hash(key) & mask;
+  for(unsigned int probe = 0; probe <= mask; probe++)
+  {
+    const int owner = table[h];
+    if(owner < 0) return -1;
+    if(_pl_key_equal(keys, owner, key)) return h;
+    h = (h + 1) & mask;
+  }
+  return -1;
+}
+
+kernel void
+permutohedral_init(global int *table, global float4 *values, const int size)
+{
+  const int i = get_global_id(0);
+  if(i >= size) return;
+
+  table[i] = -1;
+  values[i] = (float4)0.0f;
+}
+
+/*
+  Find the enclosing simplex of each pixel and store the keys of its D+1
+  vertices and their barycentric weights, see PermutohedralLattice::splat().
+*/
+kernel void
+permutohedral_keys(read_only image2d_t in, global short *keys, global float *weights, const int width,
+                   const int height, const float sx, const float sy, const float sr, const float sg,
+                   const float sb)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float4 pixel = read_imagef(in, sampleri, (int2)(x, y));
+  const float position[PL_D] = { x * sx, y * sy, pixel.x * sr, pixel.y * sg, pixel.z * sb };
+
+  float scale_factor[PL_D];
+  for(int i = 0; i < PL_D; i++)
+    scale_factor[i] = (1.0f / sqrt((float)((i + 1) * (i + 2)))) * ((PL_D + 1) * sqrt(2.0f / 3.0f));
+
+  // first rotate position into the (d+1)-dimensional hyperplane
+  float elevated[PL_D + 1];
+  elevated[PL_D] = -PL_D * position[PL_D - 1] * scale_factor[PL_D - 1];
+  for(int i = PL_D - 1; i > 0; i--)
+    elevated[i] = elevated[i + 1] - i * position[i - 1] * scale_factor[i - 1]
+                  + (i + 2) * position[i] * scale_factor[i];
+  elevated[0] = elevated[1] + 2 * position[0] * scale_factor[0];
+
+  // greedily search for the closest zero-colored lattice point
+  const float scale = 1.0f / (PL_D + 1);
+  int greedy[PL_D + 1];
+  int sum = 0;
+  for(int i = 0; i <= PL_D; i++)
+  {
+    const float v = elevated[i] * scale;
+    const float up = ceil(v) * (PL_D + 1);
+    const float down = floor(v) * (PL_D + 1);
+    greedy[i] = (int)((up - elevated[i] < elevated[i] - down) ? up : down);
+    sum += greedy[i];
+  }
+  sum /= PL_D + 1;
+
+  // rank differential to find the permutation between this simplex and the canonical one
+  int rank[PL_D + 1] = { 0 };
+  for(int i = 0; i < PL_D; i++)
+    for(int j = i + 1; j <= PL_D; j++)
+      if(elevated[i] - greedy[i] < elevated[j] - greedy[j])
+        rank[i]++;
+      else
+        rank[j]++;
+
+  if(sum > 0)
+  {
+    for(int i = 0; i <= PL_D; i++)
+    {
+      if(rank[i] >= PL_D + 1 - sum)
+      {
+        greedy[i] -= PL_D + 1;
+        rank[i] += sum - (PL_D + 1);
+      }
+      else
+        rank[i] += sum;
+    }
+  }
+  else if(sum < 0)
+  {
+    for(int i = 0; i <= PL_D; i++)
+    {
+      if(rank[i] < -sum)
+      {
+        greedy[i] += PL_D + 1;
+        rank[i] += (PL_D + 1) + sum;
+      }
+      else
+        rank[i] += sum;
+    }
+  }
+
+  // barycentric coordinates
+  float barycentric[PL_D + 2] = { 0.0f };
+  for(int i = 0; i <= PL_D; i++)
+  {
+    barycentric[PL_D - rank[i]] += (elevated[i] - greedy[i]) * scale;
+    barycentric[PL_D + 1 - rank[i]] -= (elevated[i] - greedy[i]) * scale;
+  }
+  barycentric[0] += 1.0f + barycentric[PL_D + 1];
+
+  const int first = (PL_D + 1) * mad24(y, width, x);
+  for(int remainder = 0; remainder <= PL_D; remainder++)
+  {
+    // vertices of the canonical simplex, shifted and permuted into place
+    for(int i = 0; i < PL_D; i++)
+    {
+      const int canonical = (rank[i] <= PL_D - remainder) ? remainder : remainder - (PL_D + 1);
+      keys[PL_D * (first + remainder) + i] = (short)(greedy[i] + canonical);
+    }
+    weights[first + remainder] = barycentric[remainder];
+  }
+}
+
+/*
+  Insert the simplex vertices into the hash table and accumulate the
+  weighted pixel values there. error is raised if the table is full.
+*/
+kernel void
+permutohedral_splat(read_only image2d_t in, global const short *keys, global const float *weights,
+                    global int *table, global int *slots, global float4 *values, const int width,
+                    const int height, const unsigned int mask, global int *error)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float4 pixel = read_imagef(in, sampleri, (int2)(x, y));
+  const float4 value = (float4)(pixel.x, pixel.y, pixel.z, 1.0f);
+
+  const int first = (PL_D + 1) * mad24(y, width, x);
+  for(int remainder = 0; remainder <= PL_D; remainder++)
+  {
+    const int entry = first + remainder;
+    short key[PL_D];
+    for(int i = 0; i < PL_D; i++) key[i] = keys[PL_D * entry + i];
+
+    int slot = -1;
+    unsigned int h = _pl_hash(key) & mask;
+    for(unsigned int probe = 0; probe <= mask; probe++)
+    {
+      const int owner = atomic_cmpxchg(table + h, -1, entry);
+      if(owner < 0 || _pl_key_equal(keys, owner, key))
+      {
+        slot = h;
+        break;
+      }
+      h = (h + 1) & mask;
+    }
+    slots[entry] = slot;
+
+    if(slot < 0)
+    {
+      atomic_inc(error);
+      continue;
+    }
+
+    const float4 v = weights[entry] * value;
+    global float *dest = (global float *)(values + slot);
+    atomic_add_f(dest, v.x);
+    atomic_add_f(dest + 1, v.y);
+    atomic_add_f(dest + 2, v.z);
+    atomic_add_f(dest + 3, v.w);
+  }
+}
+
+// blur all lattice points along one of the D+1 axes, see PermutohedralLattice::blur()
+kernel void
+permutohedral_blur(global const int *table, global const short *keys, global const float4 *in,
+                   global float4 *out, const int size, const unsigned int mask, const int axis)
+{
+  const int h = get_global_id(0);
+  if(h >= size) return;
+
+  const int owner = table[h];
+  if(owner < 0) return;
+
+  short neighbor1[PL_D], neighbor2[PL_D];
+  for(int i = 0; i < PL_D; i++)
+  {
+    const short k = keys[PL_D * owner + i];
+    neighbor1[i] = k + 1;
+    neighbor2[i] = k - 1;
+  }
+  // the last coordinate is implied by the others
+  if(axis < PL_D)
+  {
+    neighbor1[axis] = keys[PL_D * owner + axis] - PL_D;
+    neighbor2[axis] = keys[PL_D * owner + axis] + PL_D;
+  }
+
+  const int s1 = _pl_lookup(table, keys, neighbor1, mask);
+  const int s2 = _pl_lookup(table, keys, neighbor2, mask);
+  const float4 vm1 = (s1 >= 0) ? in[s1] : (float4)0.0f;
+  const float4 vp1 = (s2 >= 0) ? in[s2] : (float4)0.0f;
+
+  out[h] = 0.25f * vm1 + 0.5f * in[h] + 0.25f * vp1;
+}
+
+// interpolate the output from the vertices of each pixel's simplex
+kernel void
+permutohedral_slice(write_only image2d_t out, global const float *weights, global const int *slots,
+                    global const float4 *values, const int width, const int height)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int first = (PL_D + 1) * mad24(y, width, x);
+  float4 sum = (float4)0.0f;
+  for(int remainder = 0; remainder <= PL_D; remainder++)
+    sum += weights[first + remainder] * values[slots[first + remainder]];
+
+  write_imagef(out, (int2)(x, y), sum / sum.w);
+}
+
+// the direct version for small radii, see process() in src/iop/bilateral.cc
+kernel void
+bilateral_direct(read_only image2d_t in, write_only image2d_t out, const int width, const int height,
+                 const int rad, global const float *m, const float4 isig2col)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float4 pixel = read_imagef(in, sampleri, (int2)(x, y));
+  if(x < rad || y < rad || x >= width - rad || y >= height - rad)
+  {
+    write_imagef(out, (int2)(x, y), pixel);
+    return;
+  }
+
+  const int wd = 2 * rad + 1;
+  float sumw = 0.0f;
+  float4 res = (float4)0.0f;
+  for(int l = -rad; l <= rad; l++)
+  {
+    for(int k = -rad; k <= rad; k++)
+    {
+      const float4 inp = read_imagef(in, sampleri, (int2)(x + k, y + l));
+      const float4 chandiff = (pixel - inp) * (pixel - inp) * isig2col;
+      const float w = m[(l + rad) * wd + k + rad] * exp(-(chandiff.x + chandiff.y + chandiff.z));
+      res += inp * w;
+      sumw += w;
+    }
+  }
+  write_imagef(out, (int2)(x, y), res / sumw);
+}
@@ -0,0 +1,151 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common.h"
+
+// sqrt() as a variance-stabilizing transform
+static inline float _vst(read_only image2d_t in, const int x, const int y)
+{
+  return sqrt(fmax(0.0f, read_imagef(in, sampleri, (int2)(x, y)).x));
+}
+
+// collect one of the R/G1/G2/B channels into a monochrome image
+kernel void
+rawdenoise_bayer_extract(read_only image2d_t in, global float *fimg, const int halfwidth,
+                         const int halfheight, const int rowoff, const int coloff)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= halfwidth || y >= halfheight) return;
+
+  fimg[mad24(y, halfwidth, x)] = _vst(in, 2 * x + coloff, 2 * y + rowoff);
+}
+
+// distribute the denoised data back out to the original channel, undoing the transform
+kernel void
+rawdenoise_bayer_restore(global const float *fimg, write_only image2d_t out, const int halfwidth,
+                         const int halfheight, const int rowoff, const int coloff)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= halfwidth || y >= halfheight) return;
+
+  const float d = fimg[mad24(y, halfwidth, x)];
+  write_imagef(out, (int2)(2 * x + coloff, 2 * y + rowoff), (float4)(d * d, 0.0f, 0.0f, 0.0f));
+}
+
+/*
+  Fill the X-Trans channel c with the value the CPU version ends up with.
+  The CPU code scatters each sensel of color c to its neighbours, row by
+  row and column by column, so here we look for the last of these writes:
+  the row above (green copies down, red/blue to all 8 neighbours), then
+  the current row and its border fixes, then the row below (red/blue copy
+  up) and its border fixes.
+*/
+kernel void
+rawdenoise_xtrans_extract(read_only image2d_t in, global float *fimg, const int width,
+                          const int height, const int c, const int rx, const int ry,
+                          global const unsigned char (*const xtrans)[6])
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int last = width - 1;
+  const int first = (c != 1) ? 1 : 0;
+  const int dxmax = (c != 1) ? 1 : 0;
+  float v = 0.5f;
+
+  // the loop over the row above: green copies down, red/blue to all neighbours
+  if(y > 0)
+  {
+    if(c == 1)
+    {
+      if(x < last && FCxtrans(y - 1 + ry, x + rx, xtrans) == c) v = _vst(in, x, y - 1);
+    }
+    else
+    {
+      for(int col = max(x - 1, first); col <= min(x + 1, last - 1); col++)
+        if(FCxtrans(y - 1 + ry, col + rx, xtrans) == c) v = _vst(in, col, y - 1);
+    }
+  }
+
+  // red/blue pixel in the first column of this row
+  if(x == 0 && c != 1 && FCxtrans(y + ry, rx, xtrans) == c) v = _vst(in, 0, y);
+
+  // the loop over this row: green copies to the right, red/blue to left and right
+  for(int col = max(x - 1, first); col <= min(x + dxmax, last - 1); col++)
+    if(FCxtrans(y + ry, col + rx, xtrans) == c) v = _vst(in, col, y);
+
+  // leftmost pixel filled in from a neighbour
+  if(x == 0 && FCxtrans(y + ry, rx, xtrans) != c)
+  {
+    if(y > 1 && FCxtrans(y - 1 + ry, rx, xtrans) == c)
+      v = _vst(in, 0, y - 1);
+    else if(FCxtrans(y + ry, 1 + rx, xtrans) == c)
+      v = _vst(in, 1, y);
+    else if(y > 1 && FCxtrans(y - 1 + ry, 1 + rx, xtrans) == c)
+      v = _vst(in, 1, y - 1);
+    else
+      v = _vst(in, 0, y);
+  }
+
+  // rightmost pixel
+  if(c != 1 && FCxtrans(y + ry, last + rx, xtrans) == c)
+  {
+    if(x >= last - 1) v = _vst(in, last, y);
+  }
+  else if(x == last && FCxtrans(y + ry, last + rx, xtrans) != c)
+  {
+    if(FCxtrans(y + ry, last - 1 + rx, xtrans) == c)
+      v = _vst(in, last - 1, y);
+    else if(y > 1 && FCxtrans(y - 1 + ry, last + rx, xtrans) == c)
+      v = _vst(in, last, y - 1);
+    else if(y > 1 && FCxtrans(y - 1 + ry, last - 1 + rx, xtrans) == c)
+      v = _vst(in, last - 1, y - 1);
+    else
+      v = _vst(in, last, y);
+  }
+
+  // the row below: red/blue copy to the row above
+  if(y + 1 < height && c != 1)
+  {
+    if(x <= 1 && FCxtrans(y + 1 + ry, rx, xtrans) == c) v = _vst(in, 0, y + 1);
+
+    for(int col = max(x - 1, first); col <= min(x + 1, last - 1); col++)
+      if(FCxtrans(y + 1 + ry, col + rx, xtrans) == c) v = _vst(in, col, y + 1);
+
+    if(x == last && FCxtrans(y + 1 + ry, last + rx, xtrans) == c) v = _vst(in, last, y + 1);
+  }
+
+  fimg[mad24(y, width, x)] = v;
+}
+
+kernel void
+rawdenoise_xtrans_restore(global const float *fimg, write_only image2d_t out, const int width,
+                          const int height, const int c, const int rx, const int ry,
+                          global const unsigned char (*const xtrans)[6])
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+  if(FCxtrans(y + ry, x + rx, xtrans) != c) return;
+
+  const float d = fimg[mad24(y, width, x)];
+  write_imagef(out, (int2)(x, y), (float4)(d * d, 0.0f, 0.0f, 0.0f));
+}
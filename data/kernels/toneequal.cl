@@ -0,0 +1,433 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Tone equalizer: luminance mask, the fast guided filter and the fast
+  exposure independent guided filter from common/fast_guided_filter.h and
+  common/eigf.h working on downscaled buffers, and the correction itself.
+*/
+
+#include "common.h"
+
+#define TONEEQ_MIN_FLOAT 1.52587890625e-05f // exp2f(-16.0f)
+#define TONEEQ_MIN_EV (-8.0f)
+#define TONEEQ_MAX_EV (0.0f)
+#define TONEEQ_PIXEL_CHAN 8
+
+// keep in sync with dt_iop_luminance_mask_method_t in common/luminance_mask.h
+typedef enum dt_iop_luminance_mask_method_t
+{
+  DT_TONEEQ_MEAN = 0,
+  DT_TONEEQ_LIGHTNESS,
+  DT_TONEEQ_VALUE,
+  DT_TONEEQ_NORM_1,
+  DT_TONEEQ_NORM_2,
+  DT_TONEEQ_NORM_POWER,
+  DT_TONEEQ_GEOMEAN,
+} dt_iop_luminance_mask_method_t;
+
+// Kahan summation algorithm
+#define Kahan_sum4(m, c, add)       \
+  {                                 \
+    const float4 t1 = (add) - (c);  \
+    const float4 t2 = (m) + t1;     \
+    c = (t2 - m) - t1;              \
+    m = t2;                         \
+  }
+
+static inline float _linear_contrast(const float pixel, const float fulcrum, const float contrast)
+{
+  return fmax((pixel - fulcrum) * contrast + fulcrum, TONEEQ_MIN_FLOAT);
+}
+
+__kernel void toneeq_luminance_mask(__read_only image2d_t in,
+                                    global float *luminance,
+                                    const int width,
+                                    const int height,
+                                    const int method,
+                                    const float exposure_boost,
+                                    const float fulcrum,
+                                    const float contrast_boost)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float4 pixel = read_imagef(in, sampleri, (int2)(x, y));
+  float lum;
+
+  switch(method)
+  {
+    case DT_TONEEQ_MEAN:
+      lum = (pixel.x + pixel.y + pixel.z) / 3.0f;
+      break;
+    case DT_TONEEQ_LIGHTNESS:
+      lum = (fmax(fmax(pixel.x, pixel.y), pixel.z) + fmin(fmin(pixel.x, pixel.y), pixel.z)) / 2.0f;
+      break;
+    case DT_TONEEQ_VALUE:
+      lum = fmax(fmax(pixel.x, pixel.y), pixel.z);
+      break;
+    case DT_TONEEQ_NORM_1:
+      lum = fabs(pixel.x) + fabs(pixel.y) + fabs(pixel.z);
+      break;
+    case DT_TONEEQ_NORM_POWER:
+    {
+      const float4 value = fabs(pixel);
+      const float4 square = value * value;
+      lum = (square.x * value.x + square.y * value.y + square.z * value.z)
+            / (square.x + square.y + square.z);
+      break;
+    }
+    case DT_TONEEQ_GEOMEAN:
+      lum = pow(fabs(pixel.x * pixel.y * pixel.z), 1.0f / 3.0f);
+      break;
+    case DT_TONEEQ_NORM_2:
+    default:
+      lum = sqrt(pixel.x * pixel.x + pixel.y * pixel.y + pixel.z * pixel.z);
+      break;
+  }
+
+  luminance[mad24(y, width, x)] = _linear_contrast(exposure_boost * lum, fulcrum, contrast_boost);
+}
+
+// same sampling as interpolate_bilinear() in common/fast_guided_filter.h
+static inline void _bilinear_nodes(const int i,
+                                   const int j,
+                                   const int width_in,
+                                   const int height_in,
+                                   const int width_out,
+                                   const int height_out,
+                                   int4 *idx,
+                                   float4 *wt)
+{
+  const float x_in = ((float)j / (float)width_out) * (float)width_in;
+  const float y_in = ((float)i / (float)height_out) * (float)height_in;
+
+  const int x_prev = min((int)floor(x_in), width_in - 1);
+  const int x_next = min((int)floor(x_in) + 1, width_in - 1);
+  const int y_prev = min((int)floor(y_in), height_in - 1);
+  const int y_next = min((int)floor(y_in) + 1, height_in - 1);
+
+  const float Dy_next = (float)y_next - y_in;
+  const float Dy_prev = 1.0f - Dy_next;
+  const float Dx_next = (float)x_next - x_in;
+  const float Dx_prev = 1.0f - Dx_next;
+
+  // NW, NE, SE, SW
+  *idx = (int4)(mad24(y_prev, width_in, x_prev), mad24(y_prev, width_in, x_next),
+                mad24(y_next, width_in, x_next), mad24(y_next, width_in, x_prev));
+  *wt = (float4)(Dy_next * Dx_next, Dy_next * Dx_prev, Dy_prev * Dx_prev, Dy_prev * Dx_next);
+}
+
+__kernel void toneeq_downsample(global const float *in,
+                                global float *out,
+                                const int width_in,
+                                const int height_in,
+                                const int width_out,
+                                const int height_out)
+{
+  const int j = get_global_id(0);
+  const int i = get_global_id(1);
+  if(j >= width_out || i >= height_out) return;
+
+  int4 idx;
+  float4 wt;
+  _bilinear_nodes(i, j, width_in, height_in, width_out, height_out, &idx, &wt);
+  out[mad24(i, width_out, j)] = wt.w * in[idx.w] + wt.z * in[idx.z] + wt.x * in[idx.x] + wt.y * in[idx.y];
+}
+
+__kernel void toneeq_quantize(global const float *in,
+                              global float *out,
+                              const int width,
+                              const int height,
+                              const float sampling,
+                              const float clip_min,
+                              const float clip_max)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int k = mad24(y, width, x);
+  if(sampling == 0.0f)
+    out[k] = in[k];
+  else
+    out[k] = clamp(exp2(floor(log2(in[k]) / sampling) * sampling), clip_min, clip_max);
+}
+
+// the four channels to analyse: guided filter { guide, mask, guide^2, guide * mask }
+// and eigf { guide, guide^2, mask, mask * guide }
+__kernel void toneeq_pack(global const float *guide,
+                          global const float *mask,
+                          global float4 *out,
+                          const int width,
+                          const int height,
+                          const int eigf)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int k = mad24(y, width, x);
+  const float g = guide[k];
+  const float m = mask[k];
+  out[k] = eigf ? (float4)(g, g * g, m, m * g) : (float4)(g, m, g * g, g * m);
+}
+
+// box mean over the window clipped to the image, rows then columns like dt_box_mean()
+__kernel void toneeq_box_mean_x(global const float4 *in,
+                                global float4 *out,
+                                const int width,
+                                const int height,
+                                const int radius)
+{
+  const int y = get_global_id(0);
+  if(y >= height) return;
+
+  global const float4 *row_in = in + y * width;
+  global float4 *row_out = out + y * width;
+
+  float4 m = 0.0f;
+  float4 c = 0.0f;
+  float n_box = 0.0f;
+  for(int i = 0; i < min(radius + 1, width); i++)
+  {
+    Kahan_sum4(m, c, row_in[i]);
+    n_box += 1.0f;
+  }
+  for(int i = 0; i < width; i++)
+  {
+    row_out[i] = m / n_box;
+    if(i - radius >= 0)
+    {
+      Kahan_sum4(m, c, -row_in[i - radius]);
+      n_box -= 1.0f;
+    }
+    if(i + radius + 1 < width)
+    {
+      Kahan_sum4(m, c, row_in[i + radius + 1]);
+      n_box += 1.0f;
+    }
+  }
+}
+
+__kernel void toneeq_box_mean_y(global const float4 *in,
+                                global float4 *out,
+                                const int width,
+                                const int height,
+                                const int radius)
+{
+  const int x = get_global_id(0);
+  if(x >= width) return;
+
+  float4 m = 0.0f;
+  float4 c = 0.0f;
+  float n_box = 0.0f;
+  for(int i = 0; i < min(radius + 1, height); i++)
+  {
+    Kahan_sum4(m, c, in[mad24(i, width, x)]);
+    n_box += 1.0f;
+  }
+  for(int i = 0; i < height; i++)
+  {
+    out[mad24(i, width, x)] = m / n_box;
+    if(i - radius >= 0)
+    {
+      Kahan_sum4(m, c, -in[mad24(i - radius, width, x)]);
+      n_box -= 1.0f;
+    }
+    if(i + radius + 1 < height)
+    {
+      Kahan_sum4(m, c, in[mad24(i + radius + 1, width, x)]);
+      n_box += 1.0f;
+    }
+  }
+}
+
+// guided filter: the a and b linear blending params from the box averaged moments
+__kernel void toneeq_gf_ab(global const float4 *moments,
+                           global float4 *ab,
+                           const int width,
+                           const int height,
+                           const float feathering)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int k = mad24(y, width, x);
+  const float4 v = moments[k];
+  const float d = fmax((v.z - v.x * v.x) + feathering, 1e-15f); // avoid division by 0.
+  const float a = (v.w - v.x * v.y) / d;
+  const float b = v.y - a * v.x;
+  ab[k] = (float4)(a, b, 0.0f, 0.0f);
+}
+
+__kernel void toneeq_gf_blend(global float *image,
+                              global const float4 *ab,
+                              const int width,
+                              const int height)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int k = mad24(y, width, x);
+  image[k] = fmax(image[k] * ab[k].x + ab[k].y, TONEEQ_MIN_FLOAT);
+}
+
+// upsample a and b and blend the full resolution mask
+__kernel void toneeq_gf_final(global float *image,
+                              global const float4 *ab,
+                              const int width,
+                              const int height,
+                              const int ds_width,
+                              const int ds_height,
+                              const int geomean)
+{
+  const int j = get_global_id(0);
+  const int i = get_global_id(1);
+  if(j >= width || i >= height) return;
+
+  int4 idx;
+  float4 wt;
+  _bilinear_nodes(i, j, ds_width, ds_height, width, height, &idx, &wt);
+  const float4 p = wt.w * ab[idx.w] + wt.z * ab[idx.z] + wt.x * ab[idx.x] + wt.y * ab[idx.y];
+
+  const int k = mad24(i, width, j);
+  const float blended = fmax(image[k] * p.x + p.y, TONEEQ_MIN_FLOAT);
+  image[k] = geomean ? sqrt(image[k] * blended) : blended;
+}
+
+// min and max of each row, the host reduces them for the gaussian clipping bounds
+__kernel void toneeq_minmax_rows(global const float4 *in,
+                                 global float4 *rowmin,
+                                 global float4 *rowmax,
+                                 const int width,
+                                 const int height)
+{
+  const int y = get_global_id(0);
+  if(y >= height) return;
+
+  float4 vmin = (float4)(10000000.0f);
+  float4 vmax = (float4)(0.0f);
+  for(int x = 0; x < width; x++)
+  {
+    const float4 v = in[mad24(y, width, x)];
+    vmin = fmin(vmin, v);
+    vmax = fmax(vmax, v);
+  }
+  rowmin[y] = vmin;
+  rowmax[y] = vmax;
+}
+
+// eigf: turn the gaussian averaged moments into variance and covariance
+__kernel void toneeq_eigf_variance(global float4 *av,
+                                   const int width,
+                                   const int height)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int k = mad24(y, width, x);
+  float4 v = av[k];
+  v.y -= v.x * v.x;
+  v.w -= v.x * v.z;
+  av[k] = v;
+}
+
+// eigf: upsample averages and variances and blend the full resolution mask
+__kernel void toneeq_eigf_blend(global float *image,
+                                global const float *mask,
+                                global const float4 *av,
+                                const int width,
+                                const int height,
+                                const int ds_width,
+                                const int ds_height,
+                                const float feathering,
+                                const int geomean)
+{
+  const int j = get_global_id(0);
+  const int i = get_global_id(1);
+  if(j >= width || i >= height) return;
+
+  int4 idx;
+  float4 wt;
+  _bilinear_nodes(i, j, ds_width, ds_height, width, height, &idx, &wt);
+  const float4 v = wt.w * av[idx.w] + wt.z * av[idx.z] + wt.x * av[idx.x] + wt.y * av[idx.y];
+
+  const int k = mad24(i, width, j);
+  const float pixel = image[k];
+  const float norm_g = fmax(v.x * pixel, 1e-6f);
+  const float norm_m = fmax(v.z * mask[k], 1e-6f);
+  const float normalized_var_guide = v.y / norm_g;
+  const float normalized_covar = v.w / sqrt(norm_g * norm_m);
+  const float a = normalized_covar / (normalized_var_guide + feathering);
+  const float b = v.z - a * v.x;
+  const float blended = fmax(pixel * a + b, TONEEQ_MIN_FLOAT);
+  image[k] = geomean ? sqrt(pixel * blended) : blended;
+}
+
+// radial-basis interpolation of the user curve, see apply_toneequalizer()
+__kernel void toneeq_apply(__read_only image2d_t in,
+                           __write_only image2d_t out,
+                           global const float *luminance,
+                           global const float *factors,
+                           const int width,
+                           const int height,
+                           const float gauss_denom)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float exposure = clamp(log2(luminance[mad24(y, width, x)]), TONEEQ_MIN_EV, TONEEQ_MAX_EV);
+
+  float result = 0.0f;
+  for(int i = 0; i < TONEEQ_PIXEL_CHAN; i++)
+  {
+    // centers split 8 EV into 7 evenly-spaced channels
+    const float radius = exposure - (-8.0f + 8.0f * i / 7.0f);
+    result += exp(-radius * radius / gauss_denom) * factors[i];
+  }
+  const float correction = clamp(result, 0.25f, 4.0f);
+
+  write_imagef(out, (int2)(x, y), correction * read_imagef(in, sampleri, (int2)(x, y)));
+}
+
+__kernel void toneeq_display_mask(__read_only image2d_t in,
+                                  __write_only image2d_t out,
+                                  global const float *luminance,
+                                  const int in_width,
+                                  const int out_width,
+                                  const int out_height,
+                                  const int offset_x,
+                                  const int offset_y)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= out_width || y >= out_height) return;
+
+  // normalize the mask intensity between -8 EV and 0 EV for clarity,
+  // and add a "gamma" 2.0 for better legibility in shadows
+  const float lum = luminance[mad24(y + offset_y, in_width, x + offset_x)];
+  const float intensity = sqrt(fmin(fmax(lum - 0.00390625f, 0.0f) / 0.99609375f, 1.0f));
+  const float alpha = read_imagef(in, sampleri, (int2)(x + offset_x, y + offset_y)).w;
+  write_imagef(out, (int2)(x, y), (float4)(intensity, intensity, intensity, alpha));
+}
@@ -9,7 +9,7 @@ Steps:
 1. Load raw file into Python bytes object
 2. Pass buffer to darktable (NO filename!)
 3. darktable decodes from buffer
-4. darktable exports to JPEG
+4. darktable develops and encodes to JPEG in memory
 5. Success! File never touched by darktable.
 """
 
@@ -93,16 +93,24 @@ def demo_buffer_export():
 
     print("Calling darktable with buffer (no filename given)...")
     print("  → darktable will decode RawSpeed from this buffer")
-    print("  → darktable will export to JPEG")
+    print("  → darktable will return the encoded JPEG")
     print("  → darktable will NEVER touch the filesystem for raw data")
 
+    out_buffer = ffi.new("uint8_t **")
+    out_size = ffi.new("size_t *")
+
     result = lib.dt_shim_export_from_buffer(
-        raw_buffer,              # Python bytes object → C uint8_t*
-        buffer_size,             # size_t
-        output_jpg.encode(),     # const char*
-        jpeg_quality,            # int
-        0,                       # max_width (0 = no limit)
-        0                        # max_height (0 = no limit)
+        ffi.from_buffer(raw_buffer),  # Python bytes object → C uint8_t*
+        buffer_size,                  # size_t
+        b"buffer.ARW",                # name, only the extension is used
+        ffi.NULL,                     # xmp packet (none: default history)
+        0,                            # xmp size
+        b"jpeg",                      # format: jpeg or tiff
+        jpeg_quality,                 # int
+        0,                            # max_width (0 = no limit)
+        0,                            # max_height (0 = no limit)
+        out_buffer,                   # encoded result
+        out_size
     )
 
     if result != 0:
@@ -119,15 +127,22 @@ def demo_buffer_export():
     print("STEP 4: Verify output")
     print("=" * 70)
 
-    if not os.path.exists(output_jpg):
-        print(f"✗ Output file not created: {output_jpg}")
+    output_size = out_size[0]
+    jpeg_bytes = bytes(ffi.buffer(out_buffer[0], output_size))
+    lib.dt_shim_free_buffer(out_buffer[0])
+
+    if not jpeg_bytes.startswith(b"\xff\xd8"):
+        print("✗ Result is not a JPEG stream")
         lib.dt_cleanup()
         return 4
 
-    output_size = os.path.getsize(output_jpg)
-    print(f"✓ Output file created: {output_jpg}")
+    print(f"✓ Encoded JPEG in memory")
     print(f"  Size: {output_size:,} bytes ({output_size/1024/1024:.2f} MB)")
 
+    # only the demo writes the result, darktable never did
+    with open(output_jpg, 'wb') as f:
+        f.write(jpeg_bytes)
+
     # ========================================================================
     # Step 5: Cleanup
     # ========================================================================
@@ -148,8 +163,8 @@ def demo_buffer_export():
     print("Proof that buffer-based export works:")
     print(f"  1. Python loaded raw file into memory buffer")
     print(f"  2. darktable decoded {buffer_size:,} bytes from buffer")
-    print(f"  3. darktable exported {output_size:,} byte JPEG")
-    print(f"  4. darktable NEVER accessed the original file")
+    print(f"  3. darktable returned a {output_size:,} byte JPEG in memory")
+    print(f"  4. darktable NEVER accessed the filesystem")
     print()
     print(f"Open the output: {output_jpg}")
     print()
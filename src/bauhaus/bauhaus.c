@@ -3359,6 +3359,28 @@ void dt_bauhaus_slider_set_log_curve(GtkWidget *widget)
 
 static gboolean _slider_value_change_dragging(gpointer data);
 
+// while dragging, changes are committed at most once per display frame
+// and a running preview pipe gets its average run time to finish, so
+// that it is not restarted before anything was shown
+static guint _slider_drag_interval(dt_bauhaus_widget_t *w)
+{
+  guint frame_ms = 1000 / 60;
+  GdkWindow *window = gtk_widget_get_window(GTK_WIDGET(w));
+  if(window)
+  {
+    GdkMonitor *monitor =
+      gdk_display_get_monitor_at_window(gdk_window_get_display(window), window);
+    const int refresh = monitor ? gdk_monitor_get_refresh_rate(monitor) : 0;
+    if(refresh > 0) frame_ms = MAX(1, 1000000 / refresh);
+  }
+
+  const dt_develop_t *dev = darktable.develop;
+  if(!w->module || !dev || !dev->preview_pipe || !dev->preview_pipe->processing)
+    return frame_ms;
+
+  return CLAMP(dev->preview_pipe->average_delay, frame_ms, 250);
+}
+
 static void _slider_value_change(dt_bauhaus_widget_t *w)
 {
   if(!GTK_IS_WIDGET(w)) return;
@@ -3394,7 +3416,8 @@ static void _slider_value_change(dt_bauhaus_widget_t *w)
     d->is_changed = 0;
 
     if(d->is_dragging)
-      d->timeout_handle = g_idle_add(_slider_value_change_dragging, w);
+      d->timeout_handle = g_timeout_add(_slider_drag_interval(w),
+                                        _slider_value_change_dragging, w);
   }
 }
 
@@ -3598,7 +3621,15 @@ static void _widget_button_release(GtkGestureSingle *gesture,
 
   dt_bauhaus_slider_data_t *d = &w->slider;
   if(gtk_gesture_single_get_current_button(gesture) == GDK_BUTTON_PRIMARY)
+  {
     d->is_dragging = 0;
+    // commit the final position right away instead of at the next interval
+    if(d->timeout_handle && d->timeout_handle != G_MAXUINT)
+    {
+      g_source_remove(d->timeout_handle);
+      _slider_value_change_dragging(w);
+    }
+  }
 }
 
 static void _widget_button_stopped(GtkGestureSingle *gesture,
@@ -1835,12 +1835,9 @@ static int parse_csv(dt_lut_t *self, const char *filename, double **target_L_ptr
   return N;
 }
 
-static int main_csv(dt_lut_t *self, int argc, char *argv[])
+static int main_csv(dt_lut_t *self, const char *filename_csv, const int num_patches,
+                    const char *filename_style)
 {
-  const char *filename_csv = argv[2];
-  const int num_patches = atoi(argv[3]);
-  const char *filename_style = argv[4];
-
   const int sparsity = num_patches + 4;
 
   // parse the csv
@@ -1869,6 +1866,11 @@ static int main_csv(dt_lut_t *self, int argc, char *argv[])
   // TODO: add command line options to control what modules to include
   export_style(self, filename_style, name, description, TRUE, TRUE, TRUE, TRUE);
 
+  free(self->tonecurve_encoded);
+  free(self->colorchecker_encoded);
+  self->tonecurve_encoded = NULL;
+  self->colorchecker_encoded = NULL;
+
   free(target_L);
   free(target_a);
   free(target_b);
@@ -1882,7 +1884,8 @@ static int main_csv(dt_lut_t *self, int argc, char *argv[])
 static void show_usage(const char *exe)
 {
   fprintf(stderr, "Usage: %s [<input Lab pfm file>] [<cht file>] [<reference cgats/it8 or Lab pfm file>]\n"
-                  "       %s --csv <csv file> <number patches> <output dtstyle file>\n",
+                  "       %s --csv <csv file> <number patches> <output dtstyle file>"
+                  " [<csv file> <number patches> <output dtstyle file> ...]\n",
           exe, exe);
 }
 
@@ -1907,10 +1910,18 @@ int main(int argc, char *argv[])
     show_usage(argv[0]);
   else if(argc >= 2 && !g_strcmp0(argv[1], "--csv"))
   {
-    if(argc != 5)
+    if(argc < 5 || (argc - 2) % 3)
       show_usage(argv[0]);
     else
-      res = main_csv(self, argc, argv);
+    {
+      // batch mode: one style for each triple of arguments
+      res = 0;
+      for(int k = 2; k < argc; k += 3)
+      {
+        if(argc > 5) fprintf(stderr, "processing `%s'\n", argv[k]);
+        res |= main_csv(self, argv[k], atoi(argv[k + 1]), argv[k + 2]);
+      }
+    }
   }
   else if(argc <= 4)
     res = main_gui(self, argc, argv);
@@ -115,17 +115,21 @@ static inline double compute_error(
   return err;
 }
 
-static inline int solve(double *As, double *w, double *v, const double *b, double *coeff, const int wd, const int s, const int S)
+static inline int decompose(double *As, double *w, double *v, const int wd, const int s, const int S)
 {
   // A'[wd][s+1] = u[wd][s+1] diag(w[s+1]) v[s+1][s+1]^t
-  //
+  dsvd(As, wd, s + 1, S, w, v); // As is wd x s+1 but row stride S.
+  return w[s] < 1e-3;           // if the smallest singular value becomes too small, we're done
+}
+
+// solve with the decomposition of As, which only depends on the chosen columns and
+// is thus shared by all channels.
+static inline void solve_decomposed(const double *As, const double *w, const double *v, const double *b,
+                                    double *coeff, const int wd, const int s, const int S, double *tmp)
+{
   // svd to solve for c:
   // A * c = b
   // A = u w v^t => A-1 = v 1/w u^t
-  dsvd(As, wd, s + 1, S, w, v); // As is wd x s+1 but row stride S.
-  if(w[s] < 1e-3)               // if the smallest singular value becomes too small, we're done
-    return 1;
-  double *tmp = malloc(sizeof(double) * S);
   for(int i = 0; i <= s; i++) // compute tmp = u^t * b
   {
     tmp[i] = 0.0;
@@ -138,6 +142,14 @@ static inline int solve(double *As, double *w, double *v, const double *b, doubl
     coeff[j] = 0.0;
     for(int i = 0; i <= s; i++) coeff[j] += v[j * (s + 1) + i] * tmp[i];
   }
+}
+
+static inline int __attribute__((__unused__)) solve(double *As, double *w, double *v, const double *b,
+                                                    double *coeff, const int wd, const int s, const int S)
+{
+  if(decompose(As, w, v, wd, s, S)) return 1;
+  double *tmp = malloc(sizeof(double) * S);
+  solve_decomposed(As, w, v, b, coeff, wd, s, S, tmp);
   free(tmp);
   return 0;
 }
@@ -204,6 +216,8 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
   double *w = malloc(sizeof(double) * S);
   double *v = malloc(sizeof(double) * S * S);
   double *As = calloc((size_t)wd * S, sizeof(double));
+  double *tmp = malloc(sizeof(double) * S);
+  double *dots = malloc(sizeof(double) * wd);
 
   // for rank from 0 to sparsity level
   int s = 0, patches = 0;
@@ -220,6 +234,8 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
       free(w);
       free(v);
       free(As);
+      free(tmp);
+      free(dots);
       free(norm);
       free(A);
       return sparsity;
@@ -230,12 +246,13 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
     // by searching over all three residuals
     double maxdot = 0.0;
     int maxcol = 0;
+#ifdef EXACT
     for(int t = 0; t < wd; t++)
     {
       double dot = 0.0;
       if(norm[t] > 0.0)
       {
-#ifdef EXACT // use full solve
+        // use full solve
         permutation[sparsity] = t;
         for(int ch = 0; ch < dim; ch++)
         {
@@ -251,6 +268,8 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
             free(w);
             free(v);
             free(As);
+            free(tmp);
+            free(dots);
             free(norm);
             free(A);
             return sparsity;
@@ -268,21 +287,36 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
         // compute error:
         const double err = compute_error(curve, target, r[0], r[1], r[2], wd, 0);
         dot = 1. / err; // searching for smallest error or largest dot
-#else                   // use dot product
+      }
+      dots[t] = dot;
+    }
+#else // use dot product, the candidates are independent
+    DT_OMP_FOR(shared(r))
+    for(int t = 0; t < wd; t++)
+    {
+      double dot = 0.0;
+      if(norm[t] > 0.0)
+      {
+        // A is symmetric, read column t as row t
+        const double *At = A + (size_t)t * wd;
         for(int ch = 0; ch < dim; ch++)
         {
           double chdot = 0.0;
-          for(int j = 0; j < wd; j++) chdot += A[j * wd + t] * r[ch][j];
+          for(int j = 0; j < wd; j++) chdot += At[j] * r[ch][j];
           dot += fabs(chdot);
         }
         dot *= norm[t];
-#endif
       }
-      // fprintf(stderr, "dot %d = %g\n", i, dot);
-      if(dot > maxdot)
+      dots[t] = dot;
+    }
+#endif
+    for(int t = 0; t < wd; t++)
+    {
+      // fprintf(stderr, "dot %d = %g\n", t, dots[t]);
+      if(dots[t] > maxdot)
       {
         maxcol = t;
-        maxdot = dot;
+        maxdot = dots[t];
       }
     }
 
@@ -318,6 +352,8 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
             free(w);
             free(v);
             free(As);
+            free(tmp);
+            free(dots);
             free(norm);
             free(A);
             return s;
@@ -378,33 +414,39 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
     double err = 1. / maxdot;
 #else
     const int sp = MIN(sparsity, S-1); // need to fix up for replacement
-    // solve linear least squares for sparse c for every output channel:
-    for(int ch = 0; ch < dim; ch++)
+    // solve linear least squares for sparse c for every output channel.
+    // the system is the same for all channels, decompose it once.
+    for(int i = 0; i <= sp; i++)
+      for(int j = 0; j < wd; j++) As[j * S + i] = A[j * wd + permutation[i]];
+
+    // on error, return last valid configuration
+    if(decompose(As, w, v, wd, sp, S))
     {
-      // re-init all of the previous columns in As since
-      // svd will destroy its contents:
-      for(int i = 0; i <= sp; i++)
-        for(int j = 0; j < wd; j++) As[j * S + i] = A[j * wd + permutation[i]];
+      free(r);
+      free(b);
+      free(w);
+      free(v);
+      free(As);
+      free(tmp);
+      free(dots);
+      free(norm);
+      free(A);
+      return sparsity;
+    }
 
-      // on error, return last valid configuration
-      if(solve(As, w, v, b[ch], coeff[ch], wd, sp, S))
-      {
-        free(r);
-        free(b);
-        free(w);
-        free(v);
-        free(As);
-        free(norm);
-        free(A);
-        return sparsity;
-      }
+    for(int ch = 0; ch < dim; ch++)
+    {
+      solve_decomposed(As, w, v, b[ch], coeff[ch], wd, sp, S, tmp);
 
       // compute new residual:
       // r = b - As c
+      const double *c = coeff[ch];
+      DT_OMP_FOR(shared(r, b))
       for(int j = 0; j < wd; j++)
       {
-        r[ch][j] = b[ch][j];
-        for(int i = 0; i <= sp; i++) r[ch][j] -= A[j * wd + permutation[i]] * coeff[ch][i];
+        double rj = b[ch][j];
+        for(int i = 0; i <= sp; i++) rj -= A[j * wd + permutation[i]] * c[i];
+        r[ch][j] = rj;
       }
     }
 
@@ -430,6 +472,8 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
   free(w);
   free(v);
   free(As);
+  free(tmp);
+  free(dots);
   free(norm);
   free(A);
   return -1;
@@ -22,6 +22,7 @@
 #include "common/collection.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
+#include "common/datetime.h"
 #include "common/debug.h"
 #include "common/exif.h"
 #include "common/file_location.h"
@@ -29,6 +30,7 @@
 #include "common/history.h"
 #include "common/image.h"
 #include "common/image_cache.h"
+#include "common/metrics.h"
 #include "common/points.h"
 #include "control/conf.h"
 #include "develop/imageop.h"
@@ -37,6 +39,7 @@
 #include "imageio/imageio_module.h"
 
 #include <inttypes.h>
+#include <json-glib/json-glib.h>
 #include <libintl.h>
 #include <limits.h>
 #include <sys/time.h>
@@ -130,12 +133,17 @@ static void show_help(const char *const restrict program_name)
   fprintf(stdout, "  --out-ext <ext>              Output extension\n");
   fprintf(stdout, "  --style <name>               Apply style\n");
   fprintf(stdout, "  --style-overwrite <0|1>      Override builtin style\n"); // Does NOT overWRITE...
+  fprintf(stdout, "  --skip-unchanged             Don't export again if the output is unchanged\n");
+  fprintf(stdout, "  --jobs <n>                   Export up to n images concurrently, as memory allows\n");
   fprintf(stdout, "  --apply-custom-presets <0|1> Apply custom presets\n");
   fprintf(stdout, "  --icc-type <type>            ICC profile type in Darktable database\n");
   fprintf(stdout, "  --icc-intent <intent>        ICC rendering intent\n");
   fprintf(stdout, "  --list-icc-types             List available ICC profile types\n");
   fprintf(stdout, "  --list-icc-intents           List available ICC rendering intents\n");
   fprintf(stdout, "  --icc-file <file>            Use custom ICC profile file instead of type\n");
+  fprintf(stdout, "  --metadata-only <file/dir>.. Print the EXIF data of the inputs as JSON lines, no export\n");
+  fprintf(stdout, "  --serve                      Read export jobs from stdin as JSON lines, print results,\n");
+  fprintf(stdout, "                               the other options are the defaults of the jobs\n");
 }
 
 // List ICC types for user.  Updating colorspaces.h's definition might really help this
@@ -247,6 +255,9 @@ typedef struct cli_config_t
   gboolean upscale;
   gboolean export_masks;
   gboolean style_overwrite;
+  gboolean skip_unchanged;
+  gboolean serve; // jobs come from stdin, the other options are their defaults
+  int jobs; // concurrent export pipes
   // String parameters point to argv.
   char *xmp_filename;
   char *style;
@@ -258,6 +269,37 @@ typedef struct cli_config_t
   dt_iop_color_intent_t icc_intent;
 } cli_config_t;
 
+// core_args_argv CLI defaults for dt_init.  Copied from original.
+// TODO: Verify these are still needed and perform their intended function.
+static void set_core_args(const int argc, char *const restrict argv[], const int core_args_start,
+                          const cli_config_t *config)
+{
+  int core_arg_count = (core_args_start != -1) ? argc - core_args_start : 0;
+  const int defaults_count = config->skip_unchanged ? 7 : 5;
+  core_args_argc = defaults_count + core_arg_count;
+  core_args_argv = malloc(sizeof(char *) * (core_args_argc + 1));
+  core_args_argv[0] = "darktable-cli";
+  core_args_argv[1] = "--library";
+  core_args_argv[2] = ":memory:";
+  core_args_argv[3] = "--conf";
+  core_args_argv[4] = "write_sidecar_files=never";
+  // not persisted, just for this run
+  if(config->skip_unchanged)
+  {
+    core_args_argv[5] = "--conf";
+    core_args_argv[6] = "plugins/imageio/skip_unchanged=TRUE";
+  }
+  // If --core is used, append user arguments. Otherwise, stick with the defaults.
+  if(core_args_start != -1)
+  {
+    for(int i = 0; i < core_arg_count; i++)
+    {
+      core_args_argv[defaults_count + i] = argv[core_args_start + i];
+    }
+  }
+  core_args_argv[core_args_argc] = NULL;
+}
+
 // Loose argument requirements require iterative evaluation of filename inputs.
 static void parse_args(const int argc, char *const restrict argv[], char **output_filename, GList **inputs,
                        cli_config_t *config)
@@ -351,6 +393,23 @@ static void parse_args(const int argc, char *const restrict argv[], char **outpu
       {
         config->style_overwrite = TRUE;
       }
+      else if(!strcmp(arg, "--skip-unchanged"))
+      {
+        config->skip_unchanged = TRUE;
+      }
+      else if(!strcmp(arg, "--serve"))
+      {
+        config->serve = TRUE;
+      }
+      else if(!strcmp(arg, "--jobs") && i + 1 < argc)
+      {
+        config->jobs = atoi(argv[++i]);
+        if(config->jobs < 1)
+        {
+          fprintf(stderr, "Error: --jobs needs a positive number\n");
+          exit(1);
+        }
+      }
       else if(!strcmp(arg, "--icc-type") && i + 1 < argc)
       {
         config->icc_type = parse_icc_type(argv[++i]);
@@ -448,6 +507,18 @@ static void parse_args(const int argc, char *const restrict argv[], char **outpu
     config->icc_type = DT_COLORSPACE_SRGB;
   }
 
+  // Server mode takes its inputs and outputs from stdin, the options are the job defaults.
+  if(config->serve)
+  {
+    if(pos_count > 0 || has_import_args)
+    {
+      fprintf(stderr, "Error: --serve reads inputs and outputs from stdin, not the command line\n");
+      exit(1);
+    }
+    set_core_args(argc, argv, core_args_start, config);
+    return;
+  }
+
   // Validation.
   if(!*output_filename)
   {
@@ -527,27 +598,7 @@ static void parse_args(const int argc, char *const restrict argv[], char **outpu
       }
     }
   }
-  // core_args_argv CLI defaults for dt_init.  Copied from original.
-  // TODO: Verify these are still needed and perform their intended function.
-  {
-    int core_arg_count = (core_args_start != -1) ? argc - core_args_start : 0;
-    core_args_argc = 5 + core_arg_count;
-    core_args_argv = malloc(sizeof(char *) * (core_args_argc + 1));
-    core_args_argv[0] = "darktable-cli";
-    core_args_argv[1] = "--library";
-    core_args_argv[2] = ":memory:";
-    core_args_argv[3] = "--conf";
-    core_args_argv[4] = "write_sidecar_files=never";
-    // If --core is used, append user arguments. Otherwise, stick with these first five.
-    if(core_args_start != -1)
-    {
-      for(int i = 0; i < core_arg_count; i++)
-      {
-        core_args_argv[5 + i] = argv[core_args_start + i];
-      }
-    }
-    core_args_argv[core_args_argc] = NULL;
-  }
+  set_core_args(argc, argv, core_args_start, config);
 }
 
 // Load the dt database.
@@ -610,40 +661,527 @@ static GList *cli_import_images(GList *file_list, const char *xmp_path, int *tot
   return id_list;
 }
 
+static JsonNode *cli_metadata_to_json(const char *path, const dt_image_t *img)
+{
+  JsonBuilder *builder = json_builder_new();
+  json_builder_begin_object(builder);
+  json_builder_set_member_name(builder, "path");
+  json_builder_add_string_value(builder, path);
+  char datetime[DT_DATETIME_LENGTH] = { 0 };
+  if(img->exif_datetime_taken)
+    dt_datetime_gtimespan_to_exif(datetime, sizeof(datetime), img->exif_datetime_taken);
+  json_builder_set_member_name(builder, "datetime");
+  json_builder_add_string_value(builder, datetime);
+  json_builder_set_member_name(builder, "maker");
+  json_builder_add_string_value(builder, img->camera_maker);
+  json_builder_set_member_name(builder, "model");
+  json_builder_add_string_value(builder, img->camera_model);
+  json_builder_set_member_name(builder, "lens");
+  json_builder_add_string_value(builder, img->exif_lens);
+  json_builder_set_member_name(builder, "width");
+  json_builder_add_int_value(builder, img->width);
+  json_builder_set_member_name(builder, "height");
+  json_builder_add_int_value(builder, img->height);
+  json_builder_set_member_name(builder, "orientation");
+  json_builder_add_int_value(builder, img->orientation);
+  json_builder_set_member_name(builder, "exposure");
+  json_builder_add_double_value(builder, img->exif_exposure);
+  json_builder_set_member_name(builder, "exposure_bias");
+  json_builder_add_double_value(builder, img->exif_exposure_bias);
+  json_builder_set_member_name(builder, "aperture");
+  json_builder_add_double_value(builder, img->exif_aperture);
+  json_builder_set_member_name(builder, "iso");
+  json_builder_add_double_value(builder, img->exif_iso);
+  json_builder_set_member_name(builder, "focal_length");
+  json_builder_add_double_value(builder, img->exif_focal_length);
+  json_builder_set_member_name(builder, "crop");
+  json_builder_add_double_value(builder, img->exif_crop);
+  if(dt_is_valid_colormatrix(img->d65_color_matrix[0]))
+  {
+    json_builder_set_member_name(builder, "d65_color_matrix");
+    json_builder_begin_array(builder);
+    for(int k = 0; k < 9; k++)
+      json_builder_add_double_value(builder, img->d65_color_matrix[k]);
+    json_builder_end_array(builder);
+  }
+  json_builder_end_object(builder);
+  JsonNode *node = json_builder_get_root(builder);
+  g_object_unref(builder);
+  return node;
+}
+
+// --metadata-only: read the EXIF data of every input in parallel, without
+// importing anything, and print one JSON object per line in input order.
+static int cli_metadata_only(const int argc, char *const restrict argv[])
+{
+  GList *image_files = NULL;
+  for(int i = 1; i < argc; i++)
+  {
+    if(!strcmp(argv[i], "--metadata-only")) continue;
+    if(g_file_test(argv[i], G_FILE_TEST_IS_DIR))
+      scan_directory_for_images(argv[i], &image_files);
+    else if(g_file_test(argv[i], G_FILE_TEST_EXISTS))
+      image_files = g_list_append(image_files, g_strdup(argv[i]));
+    else
+    {
+      fprintf(stderr, "Error: input file '%s' does not exist\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  const int count = g_list_length(image_files);
+  if(count == 0)
+  {
+    fprintf(stderr, "Error: no input files\n");
+    exit(1);
+  }
+
+  // exiv2 and the camera name normalisation need the core, not the library
+  char *init_argv[] = { "darktable-cli", "--library", ":memory:", "--conf", "write_sidecar_files=never", NULL };
+  if(dt_init(5, init_argv, FALSE, FALSE, NULL, NULL))
+  {
+    fprintf(stderr, "Error: failed to initialize darktable\n");
+    exit(1);
+  }
+
+  char **paths = g_new(char *, count);
+  int k = 0;
+  for(GList *iter = image_files; iter; iter = g_list_next(iter))
+    paths[k++] = iter->data;
+
+  dt_image_t *images = g_new(dt_image_t, count);
+  gboolean *failed = g_new0(gboolean, count);
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int i = 0; i < count; i++)
+  {
+    dt_image_init(&images[i]);
+    gchar *basename = g_path_get_basename(paths[i]);
+    g_strlcpy(images[i].filename, basename, sizeof(images[i].filename));
+    g_free(basename);
+    failed[i] = dt_exif_read_metadata_only(&images[i], paths[i]);
+  }
+
+  int errors = 0;
+  JsonGenerator *generator = json_generator_new();
+  for(int i = 0; i < count; i++)
+  {
+    if(failed[i])
+    {
+      fprintf(stderr, "Error: cannot read metadata of %s\n", paths[i]);
+      errors++;
+      continue;
+    }
+    JsonNode *node = cli_metadata_to_json(paths[i], &images[i]);
+    json_generator_set_root(generator, node);
+    gchar *line = json_generator_to_data(generator, NULL);
+    fprintf(stdout, "%s\n", line);
+    g_free(line);
+    json_node_unref(node);
+  }
+  g_object_unref(generator);
+
+  g_free(failed);
+  g_free(images);
+  g_free(paths);
+  g_list_free_full(image_files, g_free);
+  dt_cleanup();
+  return errors ? 1 : 0;
+}
+
+// Load output path into storage module.
+// Strip extension ONLY if we extracted it from filename (storage module will add it back)
+// If user specified --out-ext, keep full filename (allows double extensions like output.jpg.png)
+static void cli_set_storage_filename(dt_imageio_module_data_t *sdata, const char *output_filename,
+                                     const char *output_ext)
+{
+  const char *ext_from_filename = strrchr(output_filename, '.');
+  if(ext_from_filename && strlen(ext_from_filename) > 1 && strcmp(output_ext, (ext_from_filename + 1)) == 0)
+  {
+    // Strip extension since storage adds it back.
+    gchar *output_without_ext = g_strdup(output_filename);
+    gchar *last_dot = strrchr(output_without_ext, '.');
+    if(last_dot) *last_dot = '\0';
+    g_strlcpy((char *)sdata, output_without_ext, DT_MAX_PATH_FOR_PARAMS);
+    g_free(output_without_ext);
+  }
+  else
+  {
+    // No extension in filename or --out-ext passed.  Use exact filename.
+    g_strlcpy((char *)sdata, output_filename, DT_MAX_PATH_FOR_PARAMS); // output_filename rolls into sdata
+  }
+}
+
 // Export from id_list.
 // NOTE: To test rendering intents, use extreme ICC profiles or enable force_lcms2.
+static int cli_export_image(const dt_imgid_t imgid, dt_imageio_module_storage_t *storage,
+                            dt_imageio_module_data_t *sdata, dt_imageio_module_format_t *format,
+                            dt_imageio_module_data_t *fdata, gboolean high_quality, gboolean allow_upscale,
+                            gboolean masks, dt_colorspaces_color_profile_type_t icc_type, const char *icc_file,
+                            dt_iop_color_intent_t icc_intent, const int num, const int total_count)
+{
+  dt_export_metadata_t metadata;
+  metadata.flags = dt_lib_export_metadata_default_flags();
+  metadata.list = NULL;
+
+  // storage->store is the only way to avoid the GUI and is more direct.
+  // TODO: Since we're already hijacking, is there room for further streamlining?
+  const int export_result
+      = storage->store(storage, sdata, imgid, format, fdata, num, total_count, high_quality, allow_upscale,
+                       FALSE, 1.0, masks, icc_type, icc_file, icc_intent, &metadata);
+
+  // Note: Module handles stdout message for success.
+  if(export_result != 0)
+  {
+    fprintf(stderr, "Error: export failed for image ID %d\n", imgid);
+    return 1;
+  }
+  return 0;
+}
+
+// --jobs: the images are handed out to worker threads sharing the initialised core and caches.
+// A pipe only starts if its estimated memory fits next to the running ones, one always runs.
+#define CLI_EXPORT_BUFFERS 6 // full size 4 channel float buffers estimated per pipe
+
+typedef struct cli_export_t
+{
+  dt_imageio_module_storage_t *storage;
+  dt_imageio_module_format_t *format;
+  gboolean high_quality, allow_upscale, masks;
+  dt_colorspaces_color_profile_type_t icc_type;
+  const char *icc_file;
+  dt_iop_color_intent_t icc_intent;
+  int total_count;
+
+  dt_pthread_mutex_t lock;
+  pthread_cond_t finished;
+  GList *next;      // the image to export next
+  int num;
+  int errors;
+  int running;
+  size_t budget;    // memory all pipes may use together
+  size_t in_use;    // estimated memory of the running pipes
+} cli_export_t;
+
+// store() writes the export size into fdata and the variables into sdata, each worker has its own
+typedef struct cli_export_worker_t
+{
+  cli_export_t *e;
+  dt_imageio_module_data_t *sdata;
+  dt_imageio_module_data_t *fdata;
+} cli_export_worker_t;
+
+static size_t cli_export_memory(const dt_imgid_t imgid)
+{
+  // tiling keeps a pipe within the memory darktable gives to one pipe
+  const size_t pipe_max = dt_get_available_mem();
+  const dt_image_t *img = dt_image_cache_get(imgid, 'r');
+  const size_t pixels = img ? (size_t)img->width * img->height : 0;
+  dt_image_cache_read_release(img);
+  return pixels ? MIN(pipe_max, pixels * 4 * sizeof(float) * CLI_EXPORT_BUFFERS) : pipe_max;
+}
+
+static void *cli_export_worker(void *data)
+{
+  cli_export_worker_t *w = data;
+  cli_export_t *e = w->e;
+
+  dt_pthread_mutex_lock(&e->lock);
+  while(e->next)
+  {
+    const dt_imgid_t imgid = GPOINTER_TO_INT(e->next->data);
+    const int num = e->num++;
+    e->next = g_list_next(e->next);
+
+    dt_pthread_mutex_unlock(&e->lock);
+    const size_t need = cli_export_memory(imgid);
+    dt_pthread_mutex_lock(&e->lock);
+
+    while(e->running && e->in_use + need > e->budget)
+      dt_pthread_cond_wait(&e->finished, &e->lock);
+    e->running++;
+    e->in_use += need;
+    dt_pthread_mutex_unlock(&e->lock);
+
+    const int failed = cli_export_image(imgid, e->storage, w->sdata, e->format, w->fdata, e->high_quality,
+                                        e->allow_upscale, e->masks, e->icc_type, e->icc_file, e->icc_intent,
+                                        num, e->total_count);
+
+    dt_pthread_mutex_lock(&e->lock);
+    e->errors += failed;
+    e->running--;
+    e->in_use -= need;
+    pthread_cond_broadcast(&e->finished);
+  }
+  dt_pthread_mutex_unlock(&e->lock);
+  return NULL;
+}
+
 static int cli_export_images(GList *id_list, dt_imageio_module_storage_t *storage, dt_imageio_module_data_t *sdata,
                              dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata,
                              gboolean high_quality, gboolean allow_upscale, gboolean masks,
                              dt_colorspaces_color_profile_type_t icc_type, const char *icc_file,
-                             dt_iop_color_intent_t icc_intent, int total_count)
+                             dt_iop_color_intent_t icc_intent, int total_count, const int jobs)
+{
+  const int count = g_list_length(id_list);
+  const int nworkers = CLAMP(jobs, 1, MAX(count, 1));
+
+  if(nworkers == 1)
+  {
+    int export_errors = 0;
+    int num = 1;
+    for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
+      export_errors += cli_export_image(GPOINTER_TO_INT(iter->data), storage, sdata, format, fdata,
+                                        high_quality, allow_upscale, masks, icc_type, icc_file, icc_intent,
+                                        num, total_count);
+    return export_errors;
+  }
+
+  // the pipes together may use what is free now, but never less than one pipe
+  const size_t free_mem = dt_get_free_mem();
+  cli_export_t e = { .storage = storage, .format = format, .high_quality = high_quality,
+                     .allow_upscale = allow_upscale, .masks = masks, .icc_type = icc_type,
+                     .icc_file = icc_file, .icc_intent = icc_intent, .total_count = total_count,
+                     .next = id_list, .num = 1,
+                     .budget = MAX(free_mem ? free_mem : darktable.dtresources.total_memory / 2,
+                                   dt_get_available_mem()) };
+  dt_pthread_mutex_init(&e.lock, NULL);
+  pthread_cond_init(&e.finished, NULL);
+
+  // the calling thread is the first worker and uses the given parameters
+  cli_export_worker_t *workers = g_new0(cli_export_worker_t, nworkers);
+  pthread_t *threads = g_new(pthread_t, nworkers);
+  workers[0] = (cli_export_worker_t){ .e = &e, .sdata = sdata, .fdata = fdata };
+  int started = 0;
+  for(int k = 1; k < nworkers; k++)
+  {
+    cli_export_worker_t *w = &workers[k];
+    w->e = &e;
+    w->sdata = storage->get_params(storage);
+    w->fdata = format->get_params(format);
+    if(w->sdata && w->fdata)
+    {
+      g_strlcpy((char *)w->sdata, (char *)sdata, DT_MAX_PATH_FOR_PARAMS);
+      memcpy(w->fdata, fdata, sizeof(dt_imageio_module_data_t));
+      if(!dt_pthread_create(&threads[started], cli_export_worker, w)) started++;
+    }
+  }
+  dt_print(DT_DEBUG_PERF, "[dt-cli] exporting %d images with %d pipes, %zu MiB for all of them",
+           count, started + 1, e.budget / DT_MEGA);
+
+  cli_export_worker(&workers[0]);
+  for(int k = 0; k < started; k++)
+    dt_pthread_join(threads[k]);
+
+  for(int k = 1; k < nworkers; k++)
+  {
+    if(workers[k].sdata) storage->free_params(storage, workers[k].sdata);
+    if(workers[k].fdata) format->free_params(format, workers[k].fdata);
+  }
+  g_free(threads);
+  g_free(workers);
+  pthread_cond_destroy(&e.finished);
+  dt_pthread_mutex_destroy(&e.lock);
+
+  return e.errors;
+}
+
+static void cli_serve_reply(JsonGenerator *generator, const char *input, const char *output,
+                            const char *error, const double seconds)
+{
+  JsonBuilder *builder = json_builder_new();
+  json_builder_begin_object(builder);
+  json_builder_set_member_name(builder, "input");
+  json_builder_add_string_value(builder, input ? input : "");
+  json_builder_set_member_name(builder, "status");
+  json_builder_add_string_value(builder, error ? "error" : "ok");
+  if(error)
+  {
+    json_builder_set_member_name(builder, "message");
+    json_builder_add_string_value(builder, error);
+  }
+  else
+  {
+    json_builder_set_member_name(builder, "output");
+    json_builder_add_string_value(builder, output);
+  }
+  json_builder_set_member_name(builder, "seconds");
+  json_builder_add_double_value(builder, seconds);
+  json_builder_end_object(builder);
+
+  JsonNode *node = json_builder_get_root(builder);
+  json_generator_set_root(generator, node);
+  gchar *line = json_generator_to_data(generator, NULL);
+  fprintf(stdout, "%s\n", line);
+  fflush(stdout);
+  g_free(line);
+  json_node_unref(node);
+  g_object_unref(builder);
+}
+
+// {"metrics": true} is answered with the counters of the process in the Prometheus text format
+static void cli_serve_metrics(JsonGenerator *generator)
+{
+  gchar *metrics = dt_metrics_export();
+  JsonBuilder *builder = json_builder_new();
+  json_builder_begin_object(builder);
+  json_builder_set_member_name(builder, "status");
+  json_builder_add_string_value(builder, "ok");
+  json_builder_set_member_name(builder, "metrics");
+  json_builder_add_string_value(builder, metrics);
+  json_builder_end_object(builder);
+  g_free(metrics);
+
+  JsonNode *node = json_builder_get_root(builder);
+  json_generator_set_root(generator, node);
+  gchar *line = json_generator_to_data(generator, NULL);
+  fprintf(stdout, "%s\n", line);
+  fflush(stdout);
+  g_free(line);
+  json_node_unref(node);
+  g_object_unref(builder);
+}
+
+static const char *cli_serve_job(JsonObject *job, GHashTable *ext_map, const cli_config_t *defaults,
+                                 dt_imageio_module_storage_t *storage, dt_imageio_module_data_t *sdata)
+{
+  const char *input = json_object_get_string_member_with_default(job, "input", NULL);
+  const char *output = json_object_get_string_member_with_default(job, "output", NULL);
+  if(!input || !output) return "input and output are required";
+  if(!g_file_test(input, G_FILE_TEST_IS_REGULAR)) return "input file does not exist";
+
+  const char *xmp = json_object_get_string_member_with_default(job, "xmp", NULL);
+  const char *style = json_object_get_string_member_with_default(job, "style", defaults->style);
+  const int width = json_object_get_int_member_with_default(job, "width", defaults->width);
+  const int height = json_object_get_int_member_with_default(job, "height", defaults->height);
+  const gboolean hq = json_object_get_boolean_member_with_default(job, "hq", defaults->hq);
+
+  // format from the job, --out-ext or the output extension, as for the command line
+  const char *ext_from_filename = strrchr(output, '.');
+  const char *output_ext = json_object_get_string_member_with_default
+    (job, "format", defaults->output_ext ? defaults->output_ext
+                    : ext_from_filename && ext_from_filename[1] ? ext_from_filename + 1 : "jpg");
+  gchar *ext_lower = g_ascii_strdown(output_ext, -1);
+  const char *mapped = g_hash_table_lookup(ext_map, ext_lower);
+  g_free(ext_lower);
+  dt_imageio_module_format_t *format = dt_imageio_get_format_by_name(mapped ? mapped : output_ext);
+  if(!format) return "unknown format";
+
+  dt_imageio_module_data_t *fdata = format->get_params(format);
+  if(!fdata) return "format module failed to provide parameters";
+
+  cli_set_storage_filename(sdata, output, output_ext);
+  fdata->max_width = width;
+  fdata->max_height = height;
+  if(style)
+  {
+    g_strlcpy((char *)fdata->style, style, 128);
+    fdata->style_append = defaults->style_overwrite ? 0 : 1;
+  }
+
+  const char *error = NULL;
+  GList *file_list = g_list_append(NULL, (gpointer)input);
+  GList *id_list = cli_import_images(file_list, xmp, NULL);
+  g_list_free(file_list);
+  if(!id_list)
+    error = "cannot import image";
+  else
+  {
+    if(cli_export_images(id_list, storage, sdata, format, fdata, hq, defaults->upscale,
+                         defaults->export_masks, defaults->icc_type, defaults->icc_file,
+                         defaults->icc_intent, 1, 1))
+      error = "export failed";
+    // the next job for the same file must not see this history or xmp
+    dt_image_remove(GPOINTER_TO_INT(id_list->data));
+    g_list_free(id_list);
+  }
+
+  format->free_params(format, fdata);
+  return error;
+}
+
+// --serve: initialise the core once and export the jobs read from stdin, one JSON object per line
+//   {"input": "a.ARW", "output": "/tmp/a.jpg", "xmp": "a.ARW.xmp", "style": "name",
+//    "width": 1920, "height": 1080, "format": "jpg", "hq": true}
+// For each job one JSON line {"input", "status", "output" or "message", "seconds"} is written to
+// stdout, {"metrics": true} is answered with {"status", "metrics"}. The library, loaded modules, OpenCL kernels and caches stay warm between jobs.
+static int cli_serve(const cli_config_t *defaults)
 {
-  int export_errors = 0;
-  int num = 1;
+  if(dt_init(core_args_argc, core_args_argv, FALSE, defaults->apply_custom_presets, NULL, NULL))
+  {
+    fprintf(stderr, "Error: failed to initialize darktable\n");
+    exit(1);
+  }
 
-  for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
+  GHashTable *ext_map = fetch_module_names();
+  dt_imageio_module_storage_t *storage = dt_imageio_get_storage_by_name("disk");
+  dt_imageio_module_data_t *sdata = storage ? storage->get_params(storage) : NULL;
+  if(!sdata)
   {
-    const int imgid = GPOINTER_TO_INT(iter->data);
+    fprintf(stderr, "Error: failed to get disk storage module\n");
+    exit(1);
+  }
 
-    dt_export_metadata_t metadata;
-    metadata.flags = dt_lib_export_metadata_default_flags();
-    metadata.list = NULL;
+  fprintf(stderr, "ready, reading jobs from stdin\n");
 
-    // storage->store is the only way to avoid the GUI and is more direct.
-    // TODO: Since we're already hijacking, is there room for further streamlining?
-    int export_result
-        = storage->store(storage, sdata, imgid, format, fdata, num, total_count, high_quality, allow_upscale,
-                         FALSE, 1.0, masks, icc_type, icc_file, icc_intent, &metadata);
+  JsonParser *parser = json_parser_new();
+  JsonGenerator *generator = json_generator_new();
+  GString *line = g_string_new(NULL);
+  char chunk[4096];
+  int errors = 0;
+  while(fgets(chunk, sizeof(chunk), stdin))
+  {
+    g_string_append(line, chunk);
+    if(line->len && line->str[line->len - 1] != '\n' && !feof(stdin)) continue;
 
-    // Note: Module handles stdout message for success.
-    if(export_result != 0)
+    g_strstrip(line->str);
+    if(line->str[0])
     {
-      fprintf(stderr, "Error: export failed for image ID %d\n", imgid);
-      export_errors++;
+      dt_times_t start;
+      dt_get_times(&start);
+
+      const char *input = NULL;
+      const char *output = NULL;
+      const char *error = NULL;
+      GError *parse_error = NULL;
+      if(!json_parser_load_from_data(parser, line->str, -1, &parse_error))
+      {
+        error = "invalid JSON";
+        g_error_free(parse_error);
+      }
+      else if(!JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser)))
+        error = "job is not a JSON object";
+      else if(json_object_get_boolean_member_with_default
+              (json_node_get_object(json_parser_get_root(parser)), "metrics", FALSE))
+      {
+        cli_serve_metrics(generator);
+        g_string_truncate(line, 0);
+        continue;
+      }
+      else
+      {
+        JsonObject *job = json_node_get_object(json_parser_get_root(parser));
+        input = json_object_get_string_member_with_default(job, "input", NULL);
+        output = json_object_get_string_member_with_default(job, "output", NULL);
+        error = cli_serve_job(job, ext_map, defaults, storage, sdata);
+      }
+
+      dt_times_t end;
+      dt_get_times(&end);
+      if(error) errors++;
+      cli_serve_reply(generator, input, output, error, end.clock - start.clock);
     }
+    g_string_truncate(line, 0);
   }
 
-  return export_errors;
+  g_string_free(line, TRUE);
+  g_object_unref(generator);
+  g_object_unref(parser);
+
+  if(storage->finalize_store) storage->finalize_store(storage, sdata);
+  storage->free_params(storage, sdata);
+  g_hash_table_destroy(ext_map);
+  dt_cleanup();
+  return errors ? 1 : 0;
 }
 
 // Phase 1 cffi wrapper: Simple single-image processing function.
@@ -718,7 +1256,7 @@ int dt_cli_process_simple(const char *input_path, const char *output_path, int w
   // Export the image
   GList *id_list = g_list_append(NULL, GINT_TO_POINTER(imgid));
   int errors = cli_export_images(id_list, storage, sdata, format, fdata, TRUE, FALSE, FALSE,
-                                  DT_COLORSPACE_SRGB, NULL, DT_INTENT_PERCEPTUAL, 1);
+                                  DT_COLORSPACE_SRGB, NULL, DT_INTENT_PERCEPTUAL, 1, 1);
   g_list_free(id_list);
 
   // Cleanup
@@ -776,6 +1314,10 @@ int main(const int argc, char *const restrict argv[])
       list_icc_types();
       exit(0);
     }
+    else if(!strcmp(argv[i], "--metadata-only"))
+    {
+      exit(cli_metadata_only(argc, argv));
+    }
   }
   // Parse and cross fingers.
   char *output_filename = NULL;
@@ -785,12 +1327,21 @@ int main(const int argc, char *const restrict argv[])
   cli_config_t config = {
     .hq = TRUE,
     .apply_custom_presets = TRUE,
+    .jobs = 1,
     .icc_type = DT_COLORSPACE_NONE, // Must be explicit since NONE=-1, not 0
     .icc_intent = DT_INTENT_PERCEPTUAL,
     // Rest zero-initialized (FALSE/0/NULL)
   };
+
   parse_args(argc, argv, &output_filename, &inputs, &config);
 
+  if(config.serve)
+  {
+    const int res = cli_serve(&config);
+    free(core_args_argv);
+    exit(res);
+  }
+
   if(!inputs)
   {
     fprintf(stderr, "Error: no input files\n");
@@ -895,24 +1446,7 @@ int main(const int argc, char *const restrict argv[])
 
   // TODO: get_params() is gui agnostic. set_params() has some gui dependencies,
   // dt_bauhaus_combobox being the most obvious. This would be nice to avoid.
-  // Load output path into storage module.
-  // Strip extension ONLY if we extracted it from filename (storage module will add it back)
-  // If user specified --out-ext, keep full filename (allows double extensions like output.jpg.png)
-  const char *ext_from_filename = strrchr(output_filename, '.');
-  if(ext_from_filename && strlen(ext_from_filename) > 1 && strcmp(config.output_ext, (ext_from_filename + 1)) == 0)
-  {
-    // Strip extension since storage adds it back.
-    gchar *output_without_ext = g_strdup(output_filename);
-    gchar *last_dot = strrchr(output_without_ext, '.');
-    if(last_dot) *last_dot = '\0';
-    g_strlcpy((char *)sdata, output_without_ext, DT_MAX_PATH_FOR_PARAMS);
-    g_free(output_without_ext);
-  }
-  else
-  {
-    // No extension in filename or --out-ext passed.  Use exact filename.
-    g_strlcpy((char *)sdata, output_filename, DT_MAX_PATH_FOR_PARAMS); // output_filename rolls into sdata
-  }
+  cli_set_storage_filename(sdata, output_filename, config.output_ext);
   fdata->max_width = config.width;
   fdata->max_height = config.height;
   // TODO: Update test for real-world styles and overrides.
@@ -937,7 +1471,7 @@ int main(const int argc, char *const restrict argv[])
   // Export. Finally.
   int export_errors
       = cli_export_images(id_list, storage, sdata, format, fdata, config.hq, config.upscale, config.export_masks,
-                          config.icc_type, config.icc_file, config.icc_intent, total_files);
+                          config.icc_type, config.icc_file, config.icc_intent, total_files, config.jobs);
 
   if(export_errors > 0)
   {
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+Benchmark: N export sessions in one process
+
+Initializes darktable once and exports all test images from a pool of
+threads, each thread owning one dt_shim_session_t. The GIL is released
+during the C calls, so the sessions develop in parallel while sharing
+the caches and OpenCL programs of the single darktable instance.
+"""
+
+import glob
+import os
+import sys
+import threading
+import time
+from _dt_api import ffi, lib
+
+TEST_DATA_DIR = "/mnt/2t4/development/darktable/test_data"
+OUTPUT_DIR = "/tmp/dt_benchmark_threaded_sessions"
+OUTPUT_WIDTH = 1920
+OUTPUT_HEIGHT = 1080
+
+def init_darktable():
+    argv = [
+        ffi.new("char[]", b"darktable-benchmark"),
+        ffi.new("char[]", b"--library"),
+        ffi.new("char[]", b":memory:"),
+        ffi.new("char[]", b"--conf"),
+        ffi.new("char[]", b"write_sidecar_files=never"),
+    ]
+    argv_array = ffi.new("char*[]", argv)
+    return lib.dt_init(5, argv_array, False, True, ffi.NULL,
+                       b"/home/glen/Applications/Darktable/bin") == 0
+
+def worker(files, lock, results):
+    session = lib.dt_shim_session_new(b"jpeg", 95, OUTPUT_WIDTH, OUTPUT_HEIGHT,
+                                      ffi.NULL, 0)
+    if session == ffi.NULL:
+        return
+    out_buffer = ffi.new("uint8_t **")
+    out_size = ffi.new("size_t *")
+    try:
+        while True:
+            with lock:
+                if not files:
+                    break
+                path = files.pop()
+            with open(path, 'rb') as f:
+                raw = f.read()
+            name = os.path.basename(path)
+            t0 = time.perf_counter()
+            ret = lib.dt_shim_session_export_buffer(session, raw, len(raw),
+                                                    name.encode(),
+                                                    out_buffer, out_size)
+            elapsed = time.perf_counter() - t0
+            if ret == 0:
+                with open(os.path.join(OUTPUT_DIR, name + ".jpg"), 'wb') as f:
+                    f.write(ffi.buffer(out_buffer[0], out_size[0]))
+                lib.dt_shim_free_buffer(out_buffer[0])
+            with lock:
+                results.append((name, ret, elapsed))
+    finally:
+        lib.dt_shim_session_free(session)
+
+def main():
+    threads = int(sys.argv[1]) if len(sys.argv) > 1 else os.cpu_count()
+    files = sorted(glob.glob(os.path.join(TEST_DATA_DIR, "*.ARW")))
+    if not files:
+        print(f"no test images in {TEST_DATA_DIR}")
+        return 1
+    os.makedirs(OUTPUT_DIR, exist_ok=True)
+
+    if not init_darktable():
+        print("dt_init failed")
+        return 1
+
+    total_files = len(files)
+    lock = threading.Lock()
+    results = []
+    t0 = time.perf_counter()
+    pool = [threading.Thread(target=worker, args=(files, lock, results))
+            for _ in range(threads)]
+    for t in pool:
+        t.start()
+    for t in pool:
+        t.join()
+    wall = time.perf_counter() - t0
+
+    failed = [r for r in results if r[1] != 0]
+    print(f"{len(results)}/{total_files} images with {threads} sessions "
+          f"in {wall:.2f}s ({len(results) / wall:.2f} images/s)")
+    for name, ret, _ in failed:
+        print(f"  FAILED {name}: code {ret}")
+
+    lib.dt_cleanup()
+    return 1 if failed else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -136,18 +136,140 @@ ffibuilder.cdef("""
 
     int dt_shim_get_default_metadata_flags(void);
 
-    // Buffer-based export (NEW - Demo)
+    // Buffer-based export, result is encoded into *out_buffer
     int dt_shim_export_from_buffer(const uint8_t *raw_buffer,
                                     size_t buffer_size,
-                                    const char *output_path,
+                                    const char *name,
+                                    const uint8_t *xmp_buffer,
+                                    size_t xmp_size,
+                                    const char *format,
                                     int quality,
                                     int max_width,
-                                    int max_height);
+                                    int max_height,
+                                    uint8_t **out_buffer,
+                                    size_t *out_size);
+    void dt_shim_free_buffer(void *buffer);
+    char *dt_shim_get_metrics(void);
 
-    // Attach buffer to existing image
+    // Attach buffer to existing image, release(user_data) is called
+    // once darktable doesn't reference it anymore (NULL: buffer is copied)
+    typedef void (*dt_shim_release_fn)(void *user_data);
     void dt_shim_attach_buffer_to_image(dt_imgid_t imgid,
                                          const uint8_t *raw_buffer,
-                                         size_t buffer_size);
+                                         size_t buffer_size,
+                                         dt_shim_release_fn release,
+                                         void *user_data);
+    void dt_shim_detach_buffer_from_image(dt_imgid_t imgid);
+
+    // Warm export session, reuses develop and pixelpipe across images
+    typedef struct dt_shim_session_t dt_shim_session_t;
+    dt_shim_session_t *dt_shim_session_new(const char *format, int quality,
+                                           int max_width, int max_height,
+                                           const uint8_t *xmp_buffer,
+                                           size_t xmp_size);
+    int dt_shim_session_export_buffer(dt_shim_session_t *session,
+                                      const uint8_t *raw_buffer,
+                                      size_t buffer_size, const char *name,
+                                      uint8_t **out_buffer, size_t *out_size);
+    int dt_shim_session_export_batch(dt_shim_session_t *session, int count,
+                                     const uint8_t *const *raw_buffers,
+                                     const size_t *buffer_sizes,
+                                     const char *const *names,
+                                     uint8_t **out_buffers, size_t *out_sizes,
+                                     int *results);
+    typedef struct dt_shim_pixels_t {
+        void *data;
+        int width, height;
+        int channels;
+        int itemsize;
+        size_t stride;
+        const char *dtype;
+    } dt_shim_pixels_t;
+    int dt_shim_session_render_buffer(dt_shim_session_t *session,
+                                      const uint8_t *raw_buffer,
+                                      size_t buffer_size, const char *name,
+                                      dt_shim_pixels_t *pixels);
+    typedef struct dt_shim_rendition_t {
+        const char *format;
+        int quality;
+        int max_width;
+        int max_height;
+    } dt_shim_rendition_t;
+    int dt_shim_session_export_renditions(dt_shim_session_t *session,
+                                          const uint8_t *raw_buffer,
+                                          size_t buffer_size, const char *name,
+                                          int count,
+                                          const dt_shim_rendition_t *renditions,
+                                          uint8_t **out_buffers,
+                                          size_t *out_sizes, int *results);
+    #define DT_SHIM_TIMING_MAX_NODES 128
+    typedef struct dt_shim_node_timing_t {
+        char op[20];
+        int multi_priority;
+        double seconds;
+        int on_gpu;
+        int tiling;
+        int from_cache;
+        size_t host_bytes;
+        size_t device_bytes;
+        int64_t rss_delta;
+    } dt_shim_node_timing_t;
+    typedef struct dt_shim_timing_t {
+        double decode_seconds;
+        double develop_seconds;
+        double encode_seconds;
+        int cache_hits;
+        size_t cache_bytes;
+        size_t rss_peak_bytes;
+        int node_count;
+        dt_shim_node_timing_t nodes[DT_SHIM_TIMING_MAX_NODES];
+    } dt_shim_timing_t;
+    int dt_shim_session_get_timing(const dt_shim_session_t *session,
+                                   dt_shim_timing_t *timing);
+    void dt_shim_session_free(dt_shim_session_t *session);
+
+    // Asynchronous exports on darktable's export job queue
+    typedef struct dt_shim_future_t dt_shim_future_t;
+    typedef void (*dt_shim_done_fn)(dt_shim_future_t *future, void *user_data);
+    dt_shim_future_t *dt_shim_session_submit(dt_shim_session_t *session,
+                                             const uint8_t *raw_buffer,
+                                             size_t buffer_size,
+                                             const char *name,
+                                             dt_shim_done_fn done,
+                                             void *user_data);
+    int dt_shim_future_done(const dt_shim_future_t *future);
+    int dt_shim_future_wait(dt_shim_future_t *future, double timeout);
+    void dt_shim_future_cancel(dt_shim_future_t *future);
+    int dt_shim_future_result(dt_shim_future_t *future,
+                              uint8_t **out_buffer, size_t *out_size,
+                              dt_shim_timing_t *timing);
+    void dt_shim_future_free(dt_shim_future_t *future);
+
+    // Metadata only, files are never imported
+    typedef struct dt_shim_metadata_t {
+        int status;
+        int width, height;
+        int orientation;
+        char datetime[24];
+        char maker[64];
+        char model[64];
+        char lens[128];
+        float exposure;
+        float exposure_bias;
+        float aperture;
+        float iso;
+        float focal_length;
+        float focus_distance;
+        float crop;
+        float d65_color_matrix[9];
+    } dt_shim_metadata_t;
+    int dt_shim_read_metadata(const char *path, dt_shim_metadata_t *record);
+    int dt_shim_read_metadata_list(const char *const *paths, int count,
+                                   dt_shim_metadata_t *records);
+
+    extern "Python" void _dt_shim_release_buffer(void *user_data);
+    extern "Python" void _dt_shim_future_done(dt_shim_future_t *future,
+                                              void *user_data);
 """)
 
 # Specify the source for compilation
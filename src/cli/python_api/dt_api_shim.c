@@ -5,10 +5,22 @@
 */
 
 #include "dt_api_shim.h"
+#include "common/datetime.h"
+#include "common/exif.h"
 #include "common/film.h"
 #include "common/metadata_export.h"
+#include "common/metrics.h"
+#include "common/image.h"
 #include "common/image_cache.h"
+#include "common/iop_order.h"
+#include "common/mipmap_cache.h"
+#include "control/jobs.h"
+#include "develop/develop.h"
+#include "develop/imageop_math.h"
+#include "develop/pixelpipe_hb.h"
+#include "imageio/imageio_jpeg.h"
 #include <string.h>
+#include <tiffio.h>
 
 // ============================================================================
 // Format Module Wrappers
@@ -123,75 +135,1346 @@ int dt_shim_get_default_metadata_flags(void)
 }
 
 // ============================================================================
-// Buffer-based export (NEW - Demo)
+// Buffer-based export
 // ============================================================================
 
+// film roll holding all images imported from memory, it has no directory
+#define DT_SHIM_BUFFER_FILM "buffer://memory"
+
+typedef enum dt_shim_encoding_t
+{
+  DT_SHIM_ENCODE_JPEG = 0,
+  DT_SHIM_ENCODE_TIFF = 1,
+  // no encoding, sessions hand out the pipe output
+  DT_SHIM_PIXELS_UINT8 = 2,
+  DT_SHIM_PIXELS_UINT16 = 3,
+  DT_SHIM_PIXELS_FLOAT32 = 4,
+} dt_shim_encoding_t;
+
+// export "format" that encodes the pipe output into a memory buffer,
+// the same way dt_imageio_preview() captures a cairo surface.
+typedef struct _shim_memory_format_t
+{
+  dt_imageio_module_data_t head;
+  dt_shim_encoding_t encoding;
+  int quality;
+  uint8_t *out;
+  size_t out_size;
+} _shim_memory_format_t;
+
+// growing in-memory file for libtiff
+typedef struct _shim_tiff_memory_t
+{
+  GByteArray *data;
+  toff_t pos;
+} _shim_tiff_memory_t;
+
+static tsize_t _tiff_mem_read(thandle_t handle, tdata_t buf, tsize_t size)
+{
+  _shim_tiff_memory_t *m = (_shim_tiff_memory_t *)handle;
+  if(m->pos >= m->data->len) return 0;
+  const tsize_t n = MIN(size, (tsize_t)(m->data->len - m->pos));
+  memcpy(buf, m->data->data + m->pos, n);
+  m->pos += n;
+  return n;
+}
+
+static tsize_t _tiff_mem_write(thandle_t handle, tdata_t buf, tsize_t size)
+{
+  _shim_tiff_memory_t *m = (_shim_tiff_memory_t *)handle;
+  if(m->pos + size > m->data->len)
+    g_byte_array_set_size(m->data, m->pos + size);
+  memcpy(m->data->data + m->pos, buf, size);
+  m->pos += size;
+  return size;
+}
+
+static toff_t _tiff_mem_seek(thandle_t handle, toff_t off, int whence)
+{
+  _shim_tiff_memory_t *m = (_shim_tiff_memory_t *)handle;
+  switch(whence)
+  {
+    case SEEK_CUR:
+      m->pos += off;
+      break;
+    case SEEK_END:
+      m->pos = m->data->len + off;
+      break;
+    default:
+      m->pos = off;
+      break;
+  }
+  return m->pos;
+}
+
+static int _tiff_mem_close(thandle_t handle)
+{
+  return 0;
+}
+
+static toff_t _tiff_mem_size(thandle_t handle)
+{
+  return ((_shim_tiff_memory_t *)handle)->data->len;
+}
+
+static int _tiff_mem_map(thandle_t handle, tdata_t *base, toff_t *size)
+{
+  return 0;
+}
+
+static void _tiff_mem_unmap(thandle_t handle, tdata_t base, toff_t size)
+{
+}
+
+static int _shim_encode_tiff(_shim_memory_format_t *d, const uint16_t *in)
+{
+  const int width = d->head.width;
+  const int height = d->head.height;
+
+  _shim_tiff_memory_t m = { .data = g_byte_array_new(), .pos = 0 };
+  TIFF *tif = TIFFClientOpen("memory", "w", (thandle_t)&m,
+                             _tiff_mem_read, _tiff_mem_write, _tiff_mem_seek,
+                             _tiff_mem_close, _tiff_mem_size,
+                             _tiff_mem_map, _tiff_mem_unmap);
+  if(!tif)
+  {
+    g_byte_array_free(m.data, TRUE);
+    return 1;
+  }
+
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+  TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+  TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+  TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+  TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
+
+  int res = 0;
+  uint16_t *row = dt_alloc_align_type(uint16_t, (size_t)3 * width);
+  for(int y = 0; row && y < height && !res; y++)
+  {
+    const uint16_t *in_row = in + (size_t)4 * width * y;
+    for(int x = 0; x < width; x++)
+      for(int c = 0; c < 3; c++)
+        row[3 * x + c] = in_row[4 * x + c];
+    if(TIFFWriteScanline(tif, row, y, 0) == -1) res = 1;
+  }
+  if(!row) res = 1;
+  dt_free_align(row);
+  TIFFClose(tif);
+
+  if(res)
+  {
+    g_byte_array_free(m.data, TRUE);
+    return 1;
+  }
+
+  d->out_size = m.data->len;
+  d->out = g_byte_array_free(m.data, FALSE);
+  return 0;
+}
+
+static int _shim_encode_jpeg(_shim_memory_format_t *d, const uint8_t *in)
+{
+  const size_t capacity = (size_t)4 * d->head.width * d->head.height;
+  uint8_t *out = g_try_malloc(capacity);
+  if(!out) return 1;
+
+  const int length = dt_imageio_jpeg_compress(in, out, d->head.width, d->head.height,
+                                              d->quality);
+  if(length <= 0)
+  {
+    g_free(out);
+    return 1;
+  }
+
+  d->out = out;
+  d->out_size = length;
+  return 0;
+}
+
+static int _shim_memory_write_image(dt_imageio_module_data_t *data,
+                                    const char *filename,
+                                    const void *in,
+                                    const dt_colorspaces_color_profile_type_t over_type,
+                                    const char *over_filename,
+                                    void *exif,
+                                    const int exif_len,
+                                    const dt_imgid_t imgid,
+                                    const int num,
+                                    const int total,
+                                    dt_dev_pixelpipe_t *pipe,
+                                    const gboolean export_masks)
+{
+  _shim_memory_format_t *d = (_shim_memory_format_t *)data;
+  switch(d->encoding)
+  {
+    case DT_SHIM_ENCODE_JPEG:
+      return _shim_encode_jpeg(d, (const uint8_t *)in);
+    case DT_SHIM_ENCODE_TIFF:
+      return _shim_encode_tiff(d, (const uint16_t *)in);
+    default:
+      return 1;
+  }
+}
+
+static int _shim_memory_bpp(dt_imageio_module_data_t *data)
+{
+  switch(((_shim_memory_format_t *)data)->encoding)
+  {
+    case DT_SHIM_ENCODE_TIFF:
+    case DT_SHIM_PIXELS_UINT16:
+      return 16;
+    case DT_SHIM_PIXELS_FLOAT32:
+      return 32;
+    default:
+      return 8;
+  }
+}
+
+static int _shim_memory_levels(dt_imageio_module_data_t *data)
+{
+  const int bpp = _shim_memory_bpp(data);
+  return IMAGEIO_RGB
+    | (bpp == 32 ? IMAGEIO_FLOAT : bpp == 16 ? IMAGEIO_INT16 : IMAGEIO_INT8);
+}
+
+static const char *_shim_memory_mime(dt_imageio_module_data_t *data)
+{
+  // makes dt_imageio_export_with_flags() skip the tmpfile signals
+  return "memory";
+}
+
+static int _shim_memory_flags(dt_imageio_module_data_t *data)
+{
+  return FORMAT_FLAGS_NO_TMPFILE;
+}
+
+// all buffer images share one film roll, it must be created only once
+// even if several sessions start at the same time
+static dt_filmid_t _shim_buffer_film(void)
+{
+  dt_film_t film;
+  dt_pthread_mutex_lock(&darktable.import_threadsafe);
+  const dt_filmid_t filmid = dt_film_new(&film, DT_SHIM_BUFFER_FILM);
+  dt_pthread_mutex_unlock(&darktable.import_threadsafe);
+  return filmid;
+}
+
+static gboolean _shim_encoding_from_name(const char *format,
+                                         dt_shim_encoding_t *encoding)
+{
+  if(!format || !g_ascii_strcasecmp(format, "jpeg") || !g_ascii_strcasecmp(format, "jpg"))
+    *encoding = DT_SHIM_ENCODE_JPEG;
+  else if(!g_ascii_strcasecmp(format, "tiff") || !g_ascii_strcasecmp(format, "tif"))
+    *encoding = DT_SHIM_ENCODE_TIFF;
+  else if(!g_ascii_strcasecmp(format, "uint8"))
+    *encoding = DT_SHIM_PIXELS_UINT8;
+  else if(!g_ascii_strcasecmp(format, "uint16"))
+    *encoding = DT_SHIM_PIXELS_UINT16;
+  else if(!g_ascii_strcasecmp(format, "float32"))
+    *encoding = DT_SHIM_PIXELS_FLOAT32;
+  else
+    return FALSE;
+  return TRUE;
+}
+
 int dt_shim_export_from_buffer(const uint8_t *raw_buffer,
                                 size_t buffer_size,
-                                const char *output_path,
+                                const char *name,
+                                const uint8_t *xmp_buffer,
+                                size_t xmp_size,
+                                const char *format,
                                 int quality,
                                 int max_width,
-                                int max_height)
+                                int max_height,
+                                uint8_t **out_buffer,
+                                size_t *out_size)
 {
-  if(!raw_buffer || buffer_size == 0 || !output_path)
+  if(!raw_buffer || buffer_size == 0 || !out_buffer || !out_size)
   {
     dt_print(DT_DEBUG_ALWAYS,
              "[shim] export_from_buffer: invalid parameters");
     return 1;
   }
 
-  dt_print(DT_DEBUG_ALWAYS,
-           "[shim] Decoding %zu bytes from buffer...", buffer_size);
+  *out_buffer = NULL;
+  *out_size = 0;
 
-  dt_print(DT_DEBUG_ALWAYS,
-           "[shim] Creating temporary dt_image_t...");
+  dt_shim_encoding_t encoding;
+  if(!_shim_encoding_from_name(format, &encoding) || encoding >= DT_SHIM_PIXELS_UINT8)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[shim] export_from_buffer: unsupported format `%s'", format);
+    return 1;
+  }
 
-  // Create a temporary dt_image_t
-  dt_image_t img;
-  memset(&img, 0, sizeof(dt_image_t));
+  // the image only lives in the (in-memory) library for the time of
+  // the export, pixels are decoded from raw_buffer by the full mipmap.
+  const dt_filmid_t filmid = _shim_buffer_film();
+  if(!dt_is_valid_filmid(filmid))
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[shim] export_from_buffer: cannot create film roll");
+    return 2;
+  }
+
+  // the caller's memory is only valid for the time of this call, the
+  // image is removed below before returning
+  GBytes *bytes = g_bytes_new_static(raw_buffer, buffer_size);
+  const dt_imgid_t imgid =
+    dt_image_import_from_buffer(filmid, name ? name : "buffer.raw",
+                                bytes, xmp_buffer, xmp_size);
+  g_bytes_unref(bytes);
+  if(!dt_is_valid_imgid(imgid))
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[shim] export_from_buffer: cannot add image from %zu bytes buffer",
+             buffer_size);
+    return 2;
+  }
 
-  // Set minimal required fields
-  img.id = -1;  // Temporary image
-  g_strlcpy(img.filename, "buffer://memory", sizeof(img.filename));
-  img.exif_inited = TRUE;  // Skip EXIF reading for demo
+  dt_imageio_module_format_t fmt = { 0 };
+  fmt.mime = _shim_memory_mime;
+  fmt.levels = _shim_memory_levels;
+  fmt.bpp = _shim_memory_bpp;
+  fmt.flags = _shim_memory_flags;
+  fmt.write_image = _shim_memory_write_image;
 
-  dt_print(DT_DEBUG_ALWAYS,
-           "[shim] Calling dt_imageio_open_rawspeed_from_buffer...");
+  _shim_memory_format_t dat = { 0 };
+  dat.head.max_width = MAX(max_width, 0);
+  dat.head.max_height = MAX(max_height, 0);
+  dat.encoding = encoding;
+  dat.quality = CLAMP(quality, 5, 100);
 
-  // Decode from buffer (pass NULL for mbuf to skip pixel storage for demo)
-  // This will decode metadata and image properties without allocating mipmap cache
-  dt_imageio_retval_t decode_ret =
-      dt_imageio_open_rawspeed_from_buffer(&img, raw_buffer, buffer_size, NULL);
+  const gboolean failed = dt_imageio_export_with_flags
+    (imgid, "memory", &fmt, (dt_imageio_module_data_t *)&dat,
+     TRUE,   // ignore_exif, there is no file to read it back from
+     FALSE,  // display_byteorder
+     TRUE,   // high_quality
+     FALSE,  // upscale
+     FALSE, 1.0, FALSE, NULL,
+     FALSE,  // copy_metadata
+     FALSE,  // export_masks
+     DT_COLORSPACE_NONE, NULL, DT_INTENT_LAST, NULL, NULL, 1, 1, NULL, -1);
 
-  dt_print(DT_DEBUG_ALWAYS,
-           "[shim] Decode returned: %d", decode_ret);
+  // drop the image before the caller may free raw_buffer
+  dt_image_remove(imgid);
 
-  if(decode_ret != DT_IMAGEIO_OK)
+  if(failed || !dat.out)
   {
+    g_free(dat.out);
     dt_print(DT_DEBUG_ALWAYS,
-             "[shim] Failed to decode buffer: error %d", decode_ret);
-    return 2;
+             "[shim] export_from_buffer: export failed");
+    return 3;
+  }
+
+  dt_print(DT_DEBUG_IMAGEIO,
+           "[shim] exported %zu bytes buffer to %zu bytes %s (%dx%d)",
+           buffer_size, dat.out_size,
+           encoding == DT_SHIM_ENCODE_TIFF ? "TIFF" : "JPEG",
+           dat.head.width, dat.head.height);
+
+  *out_buffer = dat.out;
+  *out_size = dat.out_size;
+  return 0;
+}
+
+void dt_shim_free_buffer(void *buffer)
+{
+  g_free(buffer);
+}
+
+char *dt_shim_get_metrics(void)
+{
+  return dt_metrics_export();
+}
+
+// ============================================================================
+// Export sessions: keep develop and export pipe warm across images
+// ============================================================================
+
+struct dt_shim_session_t
+{
+  dt_develop_t dev;
+  dt_dev_pixelpipe_t pipe;
+  gboolean pipe_initialized;
+  _shim_memory_format_t format;
+  GBytes *xmp;        // history applied to every image, may be NULL
+  dt_filmid_t filmid;
+  GArray *node_stats; // filled by the pipe, see dt_dev_pixelpipe_t
+  dt_shim_timing_t timing; // of the last image
+
+  // futures waiting for the session, drained by one export job at a time
+  GMutex queue_lock;
+  GCond queue_cond;
+  GQueue pending;
+  gboolean queue_active;
+};
+
+// one image on its way through a session: load, develop, encode
+typedef struct _shim_session_item_t
+{
+  const uint8_t *raw_buffer;
+  size_t buffer_size;
+  const char *name;
+  dt_imgid_t imgid;
+  dt_mipmap_buffer_t buf;   // full mipmap, held until developed
+  void *pixels;             // 8 or 16 bit RGBx output of the pipe
+  gboolean own_pixels;
+  int width, height;
+  uint8_t *out;
+  size_t out_size;
+  dt_shim_timing_t timing;
+  int res;
+} _shim_session_item_t;
+
+typedef struct _shim_session_job_t
+{
+  dt_shim_session_t *session;
+  _shim_session_item_t *item;
+} _shim_session_job_t;
+
+// the pipe nodes can be kept if they were created for the very same
+// module instances, in the same order
+static gboolean _shim_same_modules(const dt_dev_pixelpipe_t *pipe,
+                                   const dt_develop_t *dev)
+{
+  const GList *p = pipe->iop;
+  const GList *d = dev->iop;
+  for(; p && d; p = g_list_next(p), d = g_list_next(d))
+    if(p->data != d->data) return FALSE;
+  return !p && !d;
+}
+
+// dt_dev_switch_image() frees all but the base module instances
+static gboolean _shim_has_instances(const dt_develop_t *dev)
+{
+  for(const GList *l = dev->iop; l; l = g_list_next(l))
+    if(((dt_iop_module_t *)l->data)->multi_priority > 0) return TRUE;
+  return FALSE;
+}
+
+static void _shim_session_item_cleanup(_shim_session_item_t *item)
+{
+  // a failed decode still holds the read lock of the slot, with buf NULL
+  dt_mipmap_cache_release(&item->buf);
+  if(dt_is_valid_imgid(item->imgid))
+    dt_image_remove(item->imgid);
+  item->imgid = NO_IMGID;
+  if(item->own_pixels)
+    dt_free_align(item->pixels);
+  item->pixels = NULL;
+  item->own_pixels = FALSE;
+}
+
+// add the buffer to the library and decode it into the full mipmap,
+// only touches shared, locked state so it can run beside a develop
+static void _shim_session_load(dt_shim_session_t *s,
+                               _shim_session_item_t *item)
+{
+  const double start = dt_get_wtime();
+  item->buf.size = DT_MIPMAP_NONE; // nothing to release yet
+  gsize xmp_size = 0;
+  const uint8_t *xmp = s->xmp ? g_bytes_get_data(s->xmp, &xmp_size) : NULL;
+  GBytes *bytes = g_bytes_new_static(item->raw_buffer, item->buffer_size);
+  item->imgid = dt_image_import_from_buffer(s->filmid,
+                                            item->name ? item->name : "buffer.raw",
+                                            bytes, xmp, xmp_size);
+  g_bytes_unref(bytes);
+  if(!dt_is_valid_imgid(item->imgid))
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[shim] session: cannot add image from %zu bytes buffer",
+             item->buffer_size);
+    item->res = 2;
+    return;
+  }
+
+  dt_mipmap_cache_get(&item->buf, item->imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  if(!item->buf.buf || !item->buf.width || !item->buf.height)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[shim] session: unable to decode image %d (status %d)",
+             item->imgid, item->buf.loader_status);
+    item->res = 2;
+  }
+  item->timing.decode_seconds = dt_get_wtime() - start;
+}
+
+static void _shim_session_collect_nodes(dt_shim_session_t *s,
+                                        _shim_session_item_t *item)
+{
+  dt_shim_timing_t *t = &item->timing;
+  t->node_count = MIN((int)s->node_stats->len, DT_SHIM_TIMING_MAX_NODES);
+  t->cache_hits = 0;
+  for(int k = 0; k < (int)s->node_stats->len; k++)
+  {
+    const dt_dev_pixelpipe_node_stats_t *n =
+      &g_array_index(s->node_stats, dt_dev_pixelpipe_node_stats_t, k);
+    if(n->from_cache) t->cache_hits++;
+    if(k >= t->node_count) continue;
+    g_strlcpy(t->nodes[k].op, n->op, sizeof(t->nodes[k].op));
+    t->nodes[k].multi_priority = n->multi_priority;
+    t->nodes[k].seconds = n->clock;
+    t->nodes[k].on_gpu = n->on_gpu;
+    t->nodes[k].tiling = n->tiling;
+    t->nodes[k].from_cache = n->from_cache;
+    t->nodes[k].host_bytes = n->host_bytes;
+    t->nodes[k].device_bytes = n->device_bytes;
+    t->nodes[k].rss_delta = n->rss_delta;
   }
+  t->cache_bytes = s->pipe.cache.allmem;
+  t->rss_peak_bytes = s->pipe.rss_peak;
+}
+
+// switch the session develop and pipe to a loaded item, up to the point
+// where the processed size of the image is known
+static void _shim_session_prepare(dt_shim_session_t *s,
+                                  _shim_session_item_t *item)
+{
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  // nodes of instances about to be freed must go first
+  if(s->pipe_initialized && _shim_has_instances(&s->dev))
+    dt_dev_pixelpipe_cleanup_nodes(&s->pipe);
+
+  dt_dev_switch_image(&s->dev, item->imgid);
+
+  dt_dev_pixelpipe_t *pipe = &s->pipe;
+  if(!s->pipe_initialized)
+  {
+    if(!dt_dev_pixelpipe_init_export(pipe, s->dev.image_storage.width,
+                                     s->dev.image_storage.height,
+                                     _shim_memory_levels(&s->format.head), FALSE))
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[shim] session: cannot allocate pipe");
+      dt_dev_pixelpipe_cleanup(pipe);
+      item->res = 3;
+      return;
+    }
+    // float output is display-referred in linear Rec.709, the output
+    // transform of the history (filmic, sigmoid...) has already run.
+    // the integer formats use the export profile of the history.
+    dt_dev_pixelpipe_set_icc(pipe,
+                             s->format.encoding == DT_SHIM_PIXELS_FLOAT32
+                             ? DT_COLORSPACE_LIN_REC709 : DT_COLORSPACE_NONE,
+                             NULL, DT_INTENT_LAST);
+    pipe->node_stats = s->node_stats;
+    s->pipe_initialized = TRUE;
+  }
+
+  dt_ioppr_resync_modules_order(&s->dev);
+  dt_dev_pixelpipe_set_input(pipe, &s->dev, (float *)item->buf.buf,
+                             item->buf.width, item->buf.height, item->buf.iscale);
+
+  // output of the previous image is of no use
+  dt_dev_pixelpipe_cache_flush(pipe);
+
+  const gboolean reuse_nodes = pipe->nodes && _shim_same_modules(pipe, &s->dev);
+  if(!reuse_nodes)
+  {
+    dt_dev_pixelpipe_cleanup_nodes(pipe);
+    dt_dev_pixelpipe_create_nodes(pipe, &s->dev);
+  }
+  // defaults depend on the image, so all pieces get their params again
+  dt_dev_pixelpipe_synch_all(pipe, &s->dev);
+
+  dt_dev_pixelpipe_get_dimensions(pipe, &s->dev, pipe->iwidth, pipe->iheight,
+                                  &pipe->processed_width, &pipe->processed_height);
+
+  dt_show_times_f(&start, "[shim session]", "preparing pipe (%s nodes)",
+                  reuse_nodes ? "reused" : "new");
+}
+
+// scale of the processed image fitting into max_width x max_height,
+// 0 leaves a side unbounded, never upscales
+static double _shim_session_scale(const dt_dev_pixelpipe_t *pipe,
+                                  const int max_width,
+                                  const int max_height)
+{
+  const double scalex = max_width > 0
+    ? fmin((double)max_width / (double)pipe->processed_width, 1.0) : 1.0;
+  const double scaley = max_height > 0
+    ? fmin((double)max_height / (double)pipe->processed_height, 1.0) : 1.0;
+  return fmin(scalex, scaley);
+}
+
+// run the prepared pipe, the float output stays in the pipe backbuf
+static float *_shim_session_process(dt_shim_session_t *s,
+                                    _shim_session_item_t *item,
+                                    const double scale)
+{
+  dt_dev_pixelpipe_t *pipe = &s->pipe;
+  const int width = floor(scale * pipe->processed_width);
+  const int height = floor(scale * pipe->processed_height);
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+  g_array_set_size(s->node_stats, 0);
+  dt_dev_pixelpipe_process_no_gamma(pipe, &s->dev, 0, 0, width, height, scale);
+  dt_show_times(&start, "[shim session] pixel pipeline processing");
+  _shim_session_collect_nodes(s, item);
+
+  item->width = width;
+  item->height = height;
+  if(!pipe->backbuf) item->res = 3;
+  return (float *)pipe->backbuf;
+}
+
+// convert float RGBx to the output depth, in may be out
+static void _shim_convert_pixels(const float *in,
+                                 void *out,
+                                 const size_t npixels,
+                                 const int bpp)
+{
+  if(bpp == 16)
+  {
+    uint16_t *buf16 = (uint16_t *)out;
+    for(size_t k = 0; k < npixels; k++)
+      for(int c = 0; c < 3; c++)
+        buf16[4 * k + c] = roundf(CLAMP(in[4 * k + c] * 0xffff, 0, 0xffff));
+  }
+  else if(bpp == 8)
+  {
+    uint8_t *buf8 = (uint8_t *)out;
+    for(size_t k = 0; k < npixels; k++)
+      for(int c = 0; c < 3; c++)
+        buf8[4 * k + c] = roundf(CLAMP(in[4 * k + c] * 0xff, 0, 0xff));
+  }
+  else if(out != in)
+    memcpy(out, in, npixels * 4 * sizeof(float));
+}
+
+// the decoded input and the image itself aren't needed anymore
+static void _shim_session_drop_input(_shim_session_item_t *item)
+{
+  dt_mipmap_cache_release(&item->buf);
+  dt_image_remove(item->imgid);
+  item->imgid = NO_IMGID;
+}
+
+// run the session pipe on a loaded item. The output stays in the pipe
+// backbuf unless copy is set, then it survives the next develop.
+static void _shim_session_develop(dt_shim_session_t *s,
+                                  _shim_session_item_t *item,
+                                  const gboolean copy)
+{
+  const double develop_start = dt_get_wtime();
+
+  _shim_session_prepare(s, item);
+  if(item->res) return;
 
-  dt_print(DT_DEBUG_ALWAYS,
-           "[shim] Successfully decoded from buffer: %dx%d, %s %s",
-           img.width, img.height, img.camera_maker, img.camera_model);
+  const double scale = _shim_session_scale(&s->pipe, s->format.head.max_width,
+                                           s->format.head.max_height);
+  float *outbuf = _shim_session_process(s, item, scale);
+  if(!outbuf) return;
 
-  dt_print(DT_DEBUG_ALWAYS,
-           "[shim] Demo complete - decode successful!");
-  dt_print(DT_DEBUG_ALWAYS,
-           "[shim] (Export to %s not yet implemented)", output_path);
+  // convert in place, like dt_imageio_export_with_flags() does
+  const size_t npixels = (size_t)item->width * item->height;
+  const int bpp = _shim_memory_bpp(&s->format.head);
+  _shim_convert_pixels(outbuf, outbuf, npixels, bpp);
 
+  if(copy)
+  {
+    const size_t size = npixels * 4 * (bpp / 8);
+    item->pixels = dt_alloc_aligned(size);
+    if(!item->pixels)
+    {
+      item->res = 3;
+      return;
+    }
+    memcpy(item->pixels, outbuf, size);
+    item->own_pixels = TRUE;
+  }
+  else
+    item->pixels = outbuf;
+
+  _shim_session_drop_input(item);
+  item->timing.develop_seconds = dt_get_wtime() - develop_start;
+}
+
+// only reads the session settings, safe beside a develop
+static void _shim_session_encode(dt_shim_session_t *s,
+                                 _shim_session_item_t *item)
+{
+  const double start = dt_get_wtime();
+  _shim_memory_format_t d = s->format;
+  d.head.width = item->width;
+  d.head.height = item->height;
+  d.out = NULL;
+  d.out_size = 0;
+  if(_shim_memory_write_image(&d.head, "memory", item->pixels, DT_COLORSPACE_NONE,
+                              NULL, NULL, 0, NO_IMGID, 1, 1, NULL, FALSE))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shim] session: encoding failed");
+    g_free(d.out);
+    dt_metrics_inc(DT_METRIC_EXPORT_ERRORS);
+    item->res = 3;
+    return;
+  }
+  item->out = d.out;
+  item->out_size = d.out_size;
+  item->timing.encode_seconds = dt_get_wtime() - start;
+  dt_metrics_inc(DT_METRIC_IMAGES_EXPORTED);
+}
+
+static void *_shim_session_load_job(void *data)
+{
+  _shim_session_job_t *job = (_shim_session_job_t *)data;
+  _shim_session_load(job->session, job->item);
+  return NULL;
+}
+
+static void *_shim_session_encode_job(void *data)
+{
+  _shim_session_job_t *job = (_shim_session_job_t *)data;
+  _shim_session_encode(job->session, job->item);
+  if(job->item->own_pixels)
+    dt_free_align(job->item->pixels);
+  job->item->pixels = NULL;
+  job->item->own_pixels = FALSE;
+  return NULL;
+}
+
+dt_shim_session_t *dt_shim_session_new(const char *format,
+                                       int quality,
+                                       int max_width,
+                                       int max_height,
+                                       const uint8_t *xmp_buffer,
+                                       size_t xmp_size)
+{
+  dt_shim_encoding_t encoding;
+  if(!_shim_encoding_from_name(format, &encoding))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shim] session_new: unsupported format `%s'", format);
+    return NULL;
+  }
+
+  const dt_filmid_t filmid = _shim_buffer_film();
+  if(!dt_is_valid_filmid(filmid))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shim] session_new: cannot create film roll");
+    return NULL;
+  }
+
+  dt_shim_session_t *s = g_malloc0(sizeof(dt_shim_session_t));
+  dt_dev_init(&s->dev, FALSE);
+  s->filmid = filmid;
+  s->format.encoding = encoding;
+  s->format.quality = CLAMP(quality, 5, 100);
+  s->format.head.max_width = MAX(max_width, 0);
+  s->format.head.max_height = MAX(max_height, 0);
+  s->xmp = xmp_buffer && xmp_size ? g_bytes_new(xmp_buffer, xmp_size) : NULL;
+  s->node_stats = g_array_new(FALSE, FALSE, sizeof(dt_dev_pixelpipe_node_stats_t));
+  g_mutex_init(&s->queue_lock);
+  g_cond_init(&s->queue_cond);
+  g_queue_init(&s->pending);
+  return s;
+}
+
+int dt_shim_session_export_buffer(dt_shim_session_t *s,
+                                  const uint8_t *raw_buffer,
+                                  size_t buffer_size,
+                                  const char *name,
+                                  uint8_t **out_buffer,
+                                  size_t *out_size)
+{
+  if(!s || !raw_buffer || buffer_size == 0 || !out_buffer || !out_size
+     || s->format.encoding >= DT_SHIM_PIXELS_UINT8)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shim] session_export_buffer: invalid parameters");
+    return 1;
+  }
+
+  *out_buffer = NULL;
+  *out_size = 0;
+
+  _shim_session_item_t item = { .raw_buffer = raw_buffer,
+                                .buffer_size = buffer_size,
+                                .name = name,
+                                .imgid = NO_IMGID };
+
+  _shim_session_load(s, &item);
+  if(!item.res) _shim_session_develop(s, &item, FALSE);
+  if(!item.res) _shim_session_encode(s, &item);
+  _shim_session_item_cleanup(&item);
+
+  s->timing = item.timing;
+  *out_buffer = item.out;
+  *out_size = item.out_size;
+  return item.res;
+}
+
+int dt_shim_session_export_batch(dt_shim_session_t *s,
+                                 int count,
+                                 const uint8_t *const *raw_buffers,
+                                 const size_t *buffer_sizes,
+                                 const char *const *names,
+                                 uint8_t **out_buffers,
+                                 size_t *out_sizes,
+                                 int *results)
+{
+  if(!s || count <= 0 || !raw_buffers || !buffer_sizes
+     || !out_buffers || !out_sizes || !results
+     || s->format.encoding >= DT_SHIM_PIXELS_UINT8)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shim] session_export_batch: invalid parameters");
+    return 1;
+  }
+
+  _shim_session_item_t *items = g_new0(_shim_session_item_t, count);
+  _shim_session_job_t *jobs = g_new(_shim_session_job_t, count);
+  for(int i = 0; i < count; i++)
+  {
+    items[i].raw_buffer = raw_buffers[i];
+    items[i].buffer_size = buffer_sizes[i];
+    items[i].name = names ? names[i] : NULL;
+    items[i].imgid = NO_IMGID;
+    if(!raw_buffers[i] || !buffer_sizes[i]) items[i].res = 1;
+    jobs[i].session = s;
+    jobs[i].item = &items[i];
+  }
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  // three stages with one image each: while image i is in the pipe,
+  // i+1 is decoded and i-1 is encoded by helper threads. Whenever a
+  // thread can't be started the stage runs inline.
+  pthread_t loader, encoder;
+  gboolean loading = FALSE, encoding = FALSE;
+  for(int i = 0; i < count; i++)
+  {
+    if(loading)
+      pthread_join(loader, NULL);
+    else if(!items[i].res)
+      _shim_session_load(s, &items[i]);
+
+    loading = i + 1 < count && !items[i + 1].res
+      && !dt_pthread_create(&loader, _shim_session_load_job, &jobs[i + 1]);
+
+    if(!items[i].res) _shim_session_develop(s, &items[i], TRUE);
+
+    if(encoding) pthread_join(encoder, NULL);
+    encoding = FALSE;
+    if(!items[i].res)
+    {
+      encoding = !dt_pthread_create(&encoder, _shim_session_encode_job, &jobs[i]);
+      if(!encoding) _shim_session_encode_job(&jobs[i]);
+    }
+  }
+  if(encoding) pthread_join(encoder, NULL);
+
+  int failed = 0;
+  for(int i = 0; i < count; i++)
+  {
+    _shim_session_item_cleanup(&items[i]);
+    out_buffers[i] = items[i].out;
+    out_sizes[i] = items[i].out_size;
+    results[i] = items[i].res;
+    if(items[i].res) failed++;
+  }
+  s->timing = items[count - 1].timing;
+
+  dt_show_times_f(&start, "[shim session]", "exported %d images, %d failed",
+                  count - failed, failed);
+
+  g_free(jobs);
+  g_free(items);
   return 0;
 }
 
+int dt_shim_session_render_buffer(dt_shim_session_t *s,
+                                  const uint8_t *raw_buffer,
+                                  size_t buffer_size,
+                                  const char *name,
+                                  dt_shim_pixels_t *pixels)
+{
+  if(!s || !raw_buffer || buffer_size == 0 || !pixels
+     || s->format.encoding < DT_SHIM_PIXELS_UINT8)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shim] session_render_buffer: invalid parameters");
+    return 1;
+  }
+
+  memset(pixels, 0, sizeof(dt_shim_pixels_t));
+
+  _shim_session_item_t item = { .raw_buffer = raw_buffer,
+                                .buffer_size = buffer_size,
+                                .name = name,
+                                .imgid = NO_IMGID };
+
+  // the pixels stay in the pipe backbuf, no copy
+  _shim_session_load(s, &item);
+  if(!item.res) _shim_session_develop(s, &item, FALSE);
+  if(!item.res)
+  {
+    const int bpp = _shim_memory_bpp(&s->format.head);
+    pixels->data = item.pixels;
+    pixels->width = item.width;
+    pixels->height = item.height;
+    pixels->channels = 4;
+    pixels->itemsize = bpp / 8;
+    pixels->stride = (size_t)4 * item.width * (bpp / 8);
+    pixels->dtype = bpp == 32 ? "float32" : bpp == 16 ? "uint16" : "uint8";
+  }
+  _shim_session_item_cleanup(&item);
+  s->timing = item.timing;
+  return item.res;
+}
+
+int dt_shim_session_export_renditions(dt_shim_session_t *s,
+                                     const uint8_t *raw_buffer,
+                                     size_t buffer_size,
+                                     const char *name,
+                                     int count,
+                                     const dt_shim_rendition_t *renditions,
+                                     uint8_t **out_buffers,
+                                     size_t *out_sizes,
+                                     int *results)
+{
+  if(!s || !raw_buffer || buffer_size == 0 || count <= 0 || !renditions
+     || !out_buffers || !out_sizes || !results
+     || s->format.encoding >= DT_SHIM_PIXELS_UINT8)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shim] session_export_renditions: invalid parameters");
+    return 1;
+  }
+
+  dt_shim_encoding_t *encodings = g_new(dt_shim_encoding_t, count);
+  for(int i = 0; i < count; i++)
+  {
+    out_buffers[i] = NULL;
+    out_sizes[i] = 0;
+    results[i] = 0;
+    if(!_shim_encoding_from_name(renditions[i].format, &encodings[i])
+       || encodings[i] >= DT_SHIM_PIXELS_UINT8)
+    {
+      dt_print(DT_DEBUG_ALWAYS,
+               "[shim] session_export_renditions: unsupported format `%s'",
+               renditions[i].format);
+      g_free(encodings);
+      return 1;
+    }
+  }
+
+  _shim_session_item_t item = { .raw_buffer = raw_buffer,
+                                .buffer_size = buffer_size,
+                                .name = name,
+                                .imgid = NO_IMGID };
+
+  _shim_session_load(s, &item);
+  const double develop_start = dt_get_wtime();
+  if(!item.res) _shim_session_prepare(s, &item);
+
+  // the pipe runs once for the largest rendition
+  double scale = 0.0;
+  float *base = NULL;
+  if(!item.res)
+  {
+    for(int i = 0; i < count; i++)
+      scale = fmax(scale, _shim_session_scale(&s->pipe, renditions[i].max_width,
+                                              renditions[i].max_height));
+    base = _shim_session_process(s, &item, scale);
+  }
+  if(base)
+  {
+    _shim_session_drop_input(&item);
+    item.timing.develop_seconds = dt_get_wtime() - develop_start;
+  }
+
+  // every rendition gets its own downscale of the display-referred
+  // output, its conversion and its encoding
+  const double encode_start = dt_get_wtime();
+  for(int i = 0; base && i < count; i++)
+  {
+    const double r_scale = _shim_session_scale(&s->pipe, renditions[i].max_width,
+                                               renditions[i].max_height);
+    const int width = MIN(item.width, (int)floor(r_scale * s->pipe.processed_width));
+    const int height = MIN(item.height, (int)floor(r_scale * s->pipe.processed_height));
+    const size_t npixels = (size_t)width * height;
+
+    _shim_memory_format_t d = { 0 };
+    d.encoding = encodings[i];
+    d.quality = CLAMP(renditions[i].quality, 5, 100);
+    d.head.width = width;
+    d.head.height = height;
+
+    float *scaled = base;
+    if(width != item.width || height != item.height)
+    {
+      scaled = dt_alloc_align_float(npixels * 4);
+      if(!scaled)
+      {
+        results[i] = 3;
+        continue;
+      }
+      const dt_iop_roi_t roi_in = { 0, 0, item.width, item.height, 1.0f };
+      const dt_iop_roi_t roi_out = { 0, 0, width, height, (float)(r_scale / scale) };
+      dt_iop_clip_and_zoom(scaled, base, &roi_out, &roi_in);
+    }
+
+    const int bpp = _shim_memory_bpp(&d.head);
+    void *pixels = dt_alloc_aligned(npixels * 4 * (bpp / 8));
+    if(pixels)
+    {
+      _shim_convert_pixels(scaled, pixels, npixels, bpp);
+      if(_shim_memory_write_image(&d.head, "memory", pixels, DT_COLORSPACE_NONE,
+                                  NULL, NULL, 0, NO_IMGID, 1, 1, NULL, FALSE))
+      {
+        dt_print(DT_DEBUG_ALWAYS,
+                 "[shim] session_export_renditions: encoding %dx%d failed", width, height);
+        g_free(d.out);
+        d.out = NULL;
+      }
+      dt_free_align(pixels);
+    }
+    if(scaled != base) dt_free_align(scaled);
+
+    out_buffers[i] = d.out;
+    out_sizes[i] = d.out ? d.out_size : 0;
+    results[i] = d.out ? 0 : 3;
+    dt_metrics_inc(d.out ? DT_METRIC_IMAGES_EXPORTED : DT_METRIC_EXPORT_ERRORS);
+  }
+  if(base)
+    item.timing.encode_seconds = dt_get_wtime() - encode_start;
+  else // nothing was rendered, every rendition failed
+    for(int i = 0; i < count; i++) results[i] = item.res;
+
+  _shim_session_item_cleanup(&item);
+  s->timing = item.timing;
+  g_free(encodings);
+  return item.res;
+}
+
+int dt_shim_session_get_timing(const dt_shim_session_t *s,
+                               dt_shim_timing_t *timing)
+{
+  if(!s || !timing) return 1;
+  *timing = s->timing;
+  return 0;
+}
+
+static void _shim_future_cancel_all(dt_shim_session_t *s);
+
+void dt_shim_session_free(dt_shim_session_t *s)
+{
+  if(!s) return;
+
+  _shim_future_cancel_all(s);
+  g_mutex_lock(&s->queue_lock);
+  while(s->queue_active)
+    g_cond_wait(&s->queue_cond, &s->queue_lock);
+  g_mutex_unlock(&s->queue_lock);
+  g_mutex_clear(&s->queue_lock);
+  g_cond_clear(&s->queue_cond);
+
+  if(s->pipe_initialized)
+    dt_dev_pixelpipe_cleanup(&s->pipe);
+  dt_dev_cleanup(&s->dev);
+  if(s->xmp) g_bytes_unref(s->xmp);
+  g_array_free(s->node_stats, TRUE);
+  g_free(s);
+}
+
 // ============================================================================
-// Attach buffer to image for export (Production API)
+// Asynchronous exports
+// ============================================================================
+
+#define DT_SHIM_CANCELLED 4
+
+struct dt_shim_future_t
+{
+  dt_shim_session_t *session;
+  const uint8_t *raw_buffer;
+  size_t buffer_size;
+  gchar *name;
+  dt_shim_done_fn done_cb;
+  void *user_data;
+
+  GMutex lock;
+  GCond cond;
+  gboolean queued;    // in the session's pending queue
+  gboolean has_result;
+  gboolean done;      // result set and callback returned
+  int res;
+  uint8_t *out;
+  size_t out_size;
+  dt_shim_timing_t timing;
+};
+
+static void _shim_future_complete(dt_shim_future_t *f,
+                                  const int res,
+                                  uint8_t *out,
+                                  const size_t out_size,
+                                  const dt_shim_timing_t *timing)
+{
+  g_mutex_lock(&f->lock);
+  f->res = res;
+  f->out = out;
+  f->out_size = out_size;
+  if(timing) f->timing = *timing;
+  f->has_result = TRUE;
+  g_mutex_unlock(&f->lock);
+
+  if(f->done_cb) f->done_cb(f, f->user_data);
+
+  g_mutex_lock(&f->lock);
+  f->done = TRUE;
+  g_cond_broadcast(&f->cond);
+  g_mutex_unlock(&f->lock);
+}
+
+// runs the futures of one session in order until none is left
+static int32_t _shim_session_queue_job_run(dt_job_t *job)
+{
+  dt_shim_session_t *s = dt_control_job_get_params(job);
+  while(TRUE)
+  {
+    g_mutex_lock(&s->queue_lock);
+    dt_shim_future_t *f = g_queue_pop_head(&s->pending);
+    if(!f)
+    {
+      s->queue_active = FALSE;
+      g_cond_broadcast(&s->queue_cond);
+      g_mutex_unlock(&s->queue_lock);
+      break;
+    }
+    f->queued = FALSE;
+    g_mutex_unlock(&s->queue_lock);
+
+    uint8_t *out = NULL;
+    size_t out_size = 0;
+    const int res = dt_shim_session_export_buffer(s, f->raw_buffer, f->buffer_size,
+                                                  f->name, &out, &out_size);
+    _shim_future_complete(f, res, out, out_size, &s->timing);
+  }
+  return 0;
+}
+
+dt_shim_future_t *dt_shim_session_submit(dt_shim_session_t *s,
+                                         const uint8_t *raw_buffer,
+                                         size_t buffer_size,
+                                         const char *name,
+                                         dt_shim_done_fn done,
+                                         void *user_data)
+{
+  if(!s || !raw_buffer || buffer_size == 0
+     || s->format.encoding >= DT_SHIM_PIXELS_UINT8)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shim] session_submit: invalid parameters");
+    return NULL;
+  }
+
+  dt_shim_future_t *f = g_malloc0(sizeof(dt_shim_future_t));
+  f->session = s;
+  f->raw_buffer = raw_buffer;
+  f->buffer_size = buffer_size;
+  f->name = g_strdup(name);
+  f->done_cb = done;
+  f->user_data = user_data;
+  g_mutex_init(&f->lock);
+  g_cond_init(&f->cond);
+
+  g_mutex_lock(&s->queue_lock);
+  g_queue_push_tail(&s->pending, f);
+  f->queued = TRUE;
+  const gboolean start = !s->queue_active;
+  s->queue_active = TRUE;
+  g_mutex_unlock(&s->queue_lock);
+
+  if(start)
+  {
+    dt_job_t *job = dt_control_job_create(&_shim_session_queue_job_run, "python export %p", (void *)s);
+    if(job)
+    {
+      dt_control_job_set_params(job, s, NULL);
+      // runs the job inline if the job system is stopped
+      dt_control_add_job(DT_JOB_QUEUE_USER_EXPORT, job);
+    }
+    else
+    {
+      _shim_future_cancel_all(s);
+      g_mutex_lock(&s->queue_lock);
+      s->queue_active = FALSE;
+      g_cond_broadcast(&s->queue_cond);
+      g_mutex_unlock(&s->queue_lock);
+    }
+  }
+  return f;
+}
+
+int dt_shim_future_done(const dt_shim_future_t *future)
+{
+  dt_shim_future_t *f = (dt_shim_future_t *)future;
+  if(!f) return 1;
+  g_mutex_lock(&f->lock);
+  const gboolean done = f->done;
+  g_mutex_unlock(&f->lock);
+  return done ? 1 : 0;
+}
+
+int dt_shim_future_wait(dt_shim_future_t *f, double timeout)
+{
+  if(!f) return 1;
+  const gint64 end = g_get_monotonic_time() + (gint64)(timeout * G_TIME_SPAN_SECOND);
+  g_mutex_lock(&f->lock);
+  while(!f->done)
+  {
+    if(timeout < 0.0)
+      g_cond_wait(&f->cond, &f->lock);
+    else if(!g_cond_wait_until(&f->cond, &f->lock, end))
+      break;
+  }
+  const gboolean done = f->done;
+  g_mutex_unlock(&f->lock);
+  return done ? 1 : 0;
+}
+
+void dt_shim_future_cancel(dt_shim_future_t *f)
+{
+  if(!f) return;
+  dt_shim_session_t *s = f->session;
+  g_mutex_lock(&s->queue_lock);
+  const gboolean queued = f->queued && g_queue_remove(&s->pending, f);
+  f->queued = FALSE;
+  g_mutex_unlock(&s->queue_lock);
+
+  if(queued)
+    _shim_future_complete(f, DT_SHIM_CANCELLED, NULL, 0, NULL);
+}
+
+static void _shim_future_cancel_all(dt_shim_session_t *s)
+{
+  GList *pending = NULL;
+  g_mutex_lock(&s->queue_lock);
+  dt_shim_future_t *f;
+  while((f = g_queue_pop_tail(&s->pending)))
+  {
+    f->queued = FALSE;
+    pending = g_list_prepend(pending, f);
+  }
+  g_mutex_unlock(&s->queue_lock);
+
+  for(GList *iter = pending; iter; iter = g_list_next(iter))
+    _shim_future_complete(iter->data, DT_SHIM_CANCELLED, NULL, 0, NULL);
+  g_list_free(pending);
+}
+
+int dt_shim_future_result(dt_shim_future_t *f,
+                          uint8_t **out_buffer,
+                          size_t *out_size,
+                          dt_shim_timing_t *timing)
+{
+  if(!f) return -1;
+  g_mutex_lock(&f->lock);
+  const int res = f->has_result ? f->res : -1;
+  if(f->has_result)
+  {
+    if(out_buffer)
+    {
+      *out_buffer = f->out;
+      f->out = NULL;
+    }
+    if(out_size) *out_size = f->out_size;
+    if(timing) *timing = f->timing;
+  }
+  g_mutex_unlock(&f->lock);
+  return res;
+}
+
+void dt_shim_future_free(dt_shim_future_t *f)
+{
+  if(!f) return;
+  dt_shim_future_cancel(f);
+  dt_shim_future_wait(f, -1.0);
+  g_free(f->out);
+  g_free(f->name);
+  g_mutex_clear(&f->lock);
+  g_cond_clear(&f->cond);
+  g_free(f);
+}
+
+// ============================================================================
+// Metadata only
+// ============================================================================
+
+int dt_shim_read_metadata(const char *path, dt_shim_metadata_t *record)
+{
+  memset(record, 0, sizeof(dt_shim_metadata_t));
+  record->status = 1;
+  if(!path) return record->status;
+
+  // never enters the image cache or the library
+  dt_image_t img;
+  dt_image_init(&img);
+  gchar *basename = g_path_get_basename(path);
+  g_strlcpy(img.filename, basename, sizeof(img.filename));
+  g_free(basename);
+
+  if(dt_exif_read_metadata_only(&img, path)) return record->status;
+
+  record->status = 0;
+  record->width = img.width;
+  record->height = img.height;
+  record->orientation = img.orientation;
+  if(img.exif_datetime_taken)
+    dt_datetime_gtimespan_to_exif(record->datetime, sizeof(record->datetime),
+                                  img.exif_datetime_taken);
+  g_strlcpy(record->maker, img.camera_maker, sizeof(record->maker));
+  g_strlcpy(record->model, img.camera_model, sizeof(record->model));
+  g_strlcpy(record->lens, img.exif_lens, sizeof(record->lens));
+  record->exposure = img.exif_exposure;
+  record->exposure_bias = img.exif_exposure_bias;
+  record->aperture = img.exif_aperture;
+  record->iso = img.exif_iso;
+  record->focal_length = img.exif_focal_length;
+  record->focus_distance = img.exif_focus_distance;
+  record->crop = img.exif_crop;
+  for(int k = 0; k < 9; k++)
+    record->d65_color_matrix[k] = img.d65_color_matrix[k];
+  // the invalid marker depends on the build flags
+  if(!dt_is_valid_colormatrix(img.d65_color_matrix[0]))
+    record->d65_color_matrix[0] = NAN;
+  return record->status;
+}
+
+int dt_shim_read_metadata_list(const char *const *paths,
+                               int count,
+                               dt_shim_metadata_t *records)
+{
+  if(!paths || !records || count <= 0) return 0;
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  int failed = 0;
+  // file sizes and layouts differ a lot, so balance dynamically
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic) reduction(+ : failed))
+  for(int i = 0; i < count; i++)
+    failed += dt_shim_read_metadata(paths[i], &records[i]) ? 1 : 0;
+
+  dt_show_times_f(&start, "[shim]", "read metadata of %d files, %d failed",
+                  count, failed);
+  return failed;
+}
+
+// ============================================================================
+// Attach buffer to image for export
 // ============================================================================
 
 void dt_shim_attach_buffer_to_image(dt_imgid_t imgid,
                                      const uint8_t *raw_buffer,
-                                     size_t buffer_size)
+                                     size_t buffer_size,
+                                     dt_shim_release_fn release,
+                                     void *user_data)
 {
   if(!raw_buffer || buffer_size == 0)
   {
@@ -200,23 +1483,23 @@ void dt_shim_attach_buffer_to_image(dt_imgid_t imgid,
     return;
   }
 
-  // Get writable image from cache
-  dt_image_t *img = dt_image_cache_get(imgid, 'w');
-  if(!img)
-  {
-    dt_print(DT_DEBUG_ALWAYS,
-             "[shim] attach_buffer: failed to get image %d", imgid);
-    return;
-  }
+  // without a release callback we can't know the lifetime of the
+  // caller's memory, so take a private copy
+  GBytes *bytes = release
+    ? g_bytes_new_with_free_func(raw_buffer, buffer_size, release, user_data)
+    : g_bytes_new(raw_buffer, buffer_size);
 
-  // TODO: Temporary hack - attaching buffer pointer directly
-  // WARNING: Buffer must remain valid for lifetime of export!
-  // Consider: copying buffer or reference counting
-  img->raw_buffer = raw_buffer;
-  img->raw_buffer_size = buffer_size;
+  dt_image_set_raw_buffer(imgid, bytes);
 
-  dt_print(DT_DEBUG_ALWAYS,
-           "[shim] Attached %zu byte buffer to image %d", buffer_size, imgid);
+  // the image cache holds its own reference now
+  g_bytes_unref(bytes);
 
-  dt_image_cache_write_release(img, DT_IMAGE_CACHE_RELAXED);
+  dt_print(DT_DEBUG_IMAGEIO,
+           "[shim] attached %zu byte buffer to image %d%s",
+           buffer_size, imgid, release ? "" : " (copied)");
+}
+
+void dt_shim_detach_buffer_from_image(dt_imgid_t imgid)
+{
+  dt_image_set_raw_buffer(imgid, NULL);
 }
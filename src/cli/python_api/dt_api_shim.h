@@ -72,22 +72,274 @@ void dt_shim_configure_export(dt_imageio_module_data_t *sdata,
 int dt_shim_get_default_metadata_flags(void);
 
 // ============================================================================
-// Buffer-based export (NEW - Demo)
+// Buffer-based export
 // ============================================================================
 
-// Export directly from memory buffer (no filename needed!)
+// Decode raw_buffer, develop it with the history from the optional XMP packet
+// and encode the result into memory, nothing is read from or written to disk.
+// name is only used for its extension (e.g. "image.ARW"), format is "jpeg" or
+// "tiff" (16 bit). On success *out_buffer must be freed with dt_shim_free_buffer().
 int dt_shim_export_from_buffer(const uint8_t *raw_buffer,
                                 size_t buffer_size,
-                                const char *output_path,
+                                const char *name,
+                                const uint8_t *xmp_buffer,
+                                size_t xmp_size,
+                                const char *format,
                                 int quality,
                                 int max_width,
-                                int max_height);
+                                int max_height,
+                                uint8_t **out_buffer,
+                                size_t *out_size);
 
-// Attach buffer to existing image (for production use)
-// TODO: Temporary API - should be integrated into import workflow
+// Free a buffer returned by the shim
+void dt_shim_free_buffer(void *buffer);
+
+// Counters of the running process in the Prometheus text format, see
+// common/metrics.h. Free with dt_shim_free_buffer().
+char *dt_shim_get_metrics(void);
+
+// Called once the last reference to an attached buffer is gone
+typedef void (*dt_shim_release_fn)(void *user_data);
+
+// Attach the file content to an image so that it is decoded from memory.
+// The buffer is shared without copying between the image cache, the mipmap
+// cache and the raw decoder, release(user_data) is called when the image is
+// evicted, removed or detached and no decode uses it anymore. With a NULL
+// release the buffer is copied once and the caller may free it right away.
 void dt_shim_attach_buffer_to_image(dt_imgid_t imgid,
                                      const uint8_t *raw_buffer,
-                                     size_t buffer_size);
+                                     size_t buffer_size,
+                                     dt_shim_release_fn release,
+                                     void *user_data);
+
+// Drop the image's reference to its attached buffer
+void dt_shim_detach_buffer_from_image(dt_imgid_t imgid);
+
+// A warm export session: the develop, its module instances and the export
+// pixelpipe with its cachelines are created once and reused by every image
+// exported through the session. Only the history (from the optional XMP
+// given at creation) and the pipe input change between images.
+//
+// Concurrency: a session must be used by one thread at a time, but any
+// number of sessions may export at the same time from different threads
+// of the same process. Each session owns its develop, pixelpipe and pipe
+// cache; the image and mipmap caches, the library, noise profiles and the
+// compiled OpenCL programs are shared and locked internally. All sessions
+// use the single OpenCL context of the process, a device is taken by a
+// pipe for the time of a run. Sessions that find no free device process on
+// the CPU unless the export device is mandatory ("+" in the export part of
+// opencl_device_priority), then they queue up and get the device in the
+// order they asked for it, for at most opencl_mandatory_timeout. Running
+// N sessions from threads of one process instead of N processes thus
+// keeps one context, one set of programs and one memory budget per
+// device. cffi releases the GIL for the whole
+// duration of each call, so Python threads calling
+// dt_shim_session_export_buffer() do run in parallel.
+typedef struct dt_shim_session_t dt_shim_session_t;
+
+// format is "jpeg" or "tiff" for the export calls, "uint8", "uint16" or
+// "float32" for dt_shim_session_render_buffer()
+dt_shim_session_t *dt_shim_session_new(const char *format,
+                                       int quality,
+                                       int max_width,
+                                       int max_height,
+                                       const uint8_t *xmp_buffer,
+                                       size_t xmp_size);
+
+// Same return codes and buffer ownership as dt_shim_export_from_buffer()
+int dt_shim_session_export_buffer(dt_shim_session_t *session,
+                                  const uint8_t *raw_buffer,
+                                  size_t buffer_size,
+                                  const char *name,
+                                  uint8_t **out_buffer,
+                                  size_t *out_size);
+
+// Export count buffers through the session, decoding image i+1 and
+// encoding image i-1 while image i is in the pixelpipe. names may be NULL.
+// Per image results[i] holds the dt_shim_session_export_buffer() return
+// code and out_buffers[i] / out_sizes[i] the encoded file, to be freed with
+// dt_shim_free_buffer(). Returns 1 for invalid parameters, 0 otherwise.
+int dt_shim_session_export_batch(dt_shim_session_t *session,
+                                 int count,
+                                 const uint8_t *const *raw_buffers,
+                                 const size_t *buffer_sizes,
+                                 const char *const *names,
+                                 uint8_t **out_buffers,
+                                 size_t *out_sizes,
+                                 int *results);
+
+// Pipe output of dt_shim_session_render_buffer(): height rows of stride
+// bytes, each holding width pixels of channels values of dtype. The
+// fourth channel is padding. All formats are display-referred, float32
+// in linear Rec.709, uint8 / uint16 in the output profile of the history.
+typedef struct dt_shim_pixels_t
+{
+  void *data;
+  int width, height;
+  int channels;
+  int itemsize;             // bytes per value
+  size_t stride;            // bytes per row
+  const char *dtype;        // "uint8", "uint16" or "float32", NumPy names
+} dt_shim_pixels_t;
+
+// Develop raw_buffer with a session created for the "uint8", "uint16" or
+// "float32" format and return the final pipe output without any copy, e.g.
+//   np.frombuffer(ffi.buffer(p.data, p.stride * p.height), p.dtype)
+//     .reshape(p.height, p.width, p.channels)
+// The pixels belong to the session and stay valid until its next call.
+// Returns the same codes as dt_shim_session_export_buffer().
+int dt_shim_session_render_buffer(dt_shim_session_t *session,
+                                  const uint8_t *raw_buffer,
+                                  size_t buffer_size,
+                                  const char *name,
+                                  dt_shim_pixels_t *pixels);
+
+// One output of dt_shim_session_export_renditions(): format is "jpeg" or
+// "tiff", a max size of 0 leaves that side unbounded.
+typedef struct dt_shim_rendition_t
+{
+  const char *format;
+  int quality;
+  int max_width;
+  int max_height;
+} dt_shim_rendition_t;
+
+// Export raw_buffer as count renditions with a single pipe run. The pipe
+// develops the image once at the size of the largest rendition, each
+// rendition is then downscaled from that display-referred output and
+// encoded on its own. results[i] holds 0 or 3 for a failed encode,
+// out_buffers[i] / out_sizes[i] the file, to be freed with
+// dt_shim_free_buffer(). Returns 1 for invalid parameters, otherwise the
+// dt_shim_session_export_buffer() code of the load and develop.
+int dt_shim_session_export_renditions(dt_shim_session_t *session,
+                                     const uint8_t *raw_buffer,
+                                     size_t buffer_size,
+                                     const char *name,
+                                     int count,
+                                     const dt_shim_rendition_t *renditions,
+                                     uint8_t **out_buffers,
+                                     size_t *out_sizes,
+                                     int *results);
+
+// Where the time of an image went, see dt_shim_session_get_timing().
+// Node times are wall clock of the module alone, OpenCL work included.
+#define DT_SHIM_TIMING_MAX_NODES 128
+
+typedef struct dt_shim_node_timing_t
+{
+  char op[20];
+  int multi_priority;
+  double seconds;           // 0 if from_cache
+  int on_gpu;
+  int tiling;
+  int from_cache;
+  size_t host_bytes;        // buffers and scratch asked for, untiled
+  size_t device_bytes;      // same for nodes run on the GPU
+  int64_t rss_delta;        // change of the resident memory of the process
+} dt_shim_node_timing_t;
+
+typedef struct dt_shim_timing_t
+{
+  double decode_seconds;    // library import and raw decode
+  double develop_seconds;   // pipe setup and processing
+  double encode_seconds;    // 0 for dt_shim_session_render_buffer()
+  int cache_hits;           // nodes taken from the pixelpipe cache
+  size_t cache_bytes;       // memory held by the pixelpipe cache
+  size_t rss_peak_bytes;    // highest resident memory during the develop
+  int node_count;           // valid entries in nodes
+  dt_shim_node_timing_t nodes[DT_SHIM_TIMING_MAX_NODES]; // in pipe order
+} dt_shim_timing_t;
+
+// Report on the last image of the previous export or render call, for
+// dt_shim_session_export_batch() that is the last image of the batch.
+// Returns 1 for invalid parameters, 0 otherwise.
+int dt_shim_session_get_timing(const dt_shim_session_t *session,
+                               dt_shim_timing_t *timing);
+
+// Queued futures are cancelled and a running one is waited for
+void dt_shim_session_free(dt_shim_session_t *session);
+
+// ============================================================================
+// Asynchronous exports
+// ============================================================================
+
+// dt_shim_session_submit() queues an export on darktable's export job
+// queue and returns at once, so the caller can do its own I/O or
+// inference meanwhile. The images of a session are exported one after
+// the other in submission order, by one worker at a time; submit to
+// several sessions to have them run in parallel, at most
+// export/concurrent_jobs at once. Don't call the blocking session
+// functions while futures of that session are pending.
+typedef struct dt_shim_future_t dt_shim_future_t;
+
+// Called from the worker thread once the export is done or cancelled.
+// dt_shim_future_result() may be called from it, dt_shim_future_free()
+// must not.
+typedef void (*dt_shim_done_fn)(dt_shim_future_t *future, void *user_data);
+
+// raw_buffer must stay valid until the future is done, name is copied.
+// done may be NULL. Returns NULL for invalid parameters.
+dt_shim_future_t *dt_shim_session_submit(dt_shim_session_t *session,
+                                         const uint8_t *raw_buffer,
+                                         size_t buffer_size,
+                                         const char *name,
+                                         dt_shim_done_fn done,
+                                         void *user_data);
+
+// 1 once the export is done and the done callback has returned
+int dt_shim_future_done(const dt_shim_future_t *future);
+
+// Wait at most timeout seconds, forever if negative. Returns
+// dt_shim_future_done().
+int dt_shim_future_wait(dt_shim_future_t *future, double timeout);
+
+// Cancel the export if it hasn't started, its result is then 4
+void dt_shim_future_cancel(dt_shim_future_t *future);
+
+// The dt_shim_session_export_buffer() return code, or 4 if cancelled.
+// The encoded file is handed over once, free it with
+// dt_shim_free_buffer(). Returns -1 while not done.
+int dt_shim_future_result(dt_shim_future_t *future,
+                          uint8_t **out_buffer,
+                          size_t *out_size,
+                          dt_shim_timing_t *timing);
+
+// Cancels or waits for the export, then frees the future and a result
+// not taken
+void dt_shim_future_free(dt_shim_future_t *future);
+
+// ============================================================================
+// Metadata only
+// ============================================================================
+
+// EXIF summary of a file, read without importing it
+typedef struct dt_shim_metadata_t
+{
+  int status;               // 0 ok, 1 unreadable or no EXIF
+  int width, height;
+  int orientation;          // dt_image_orientation_t
+  char datetime[24];        // EXIF format, empty if unknown
+  char maker[64];
+  char model[64];
+  char lens[128];
+  float exposure;
+  float exposure_bias;
+  float aperture;
+  float iso;
+  float focal_length;
+  float focus_distance;
+  float crop;
+  float d65_color_matrix[9]; // from DNGs, first value is NAN if absent
+} dt_shim_metadata_t;
+
+// Read the EXIF summary of one file. Returns record->status.
+int dt_shim_read_metadata(const char *path, dt_shim_metadata_t *record);
+
+// Read count files in parallel into records[count]. Returns the number of
+// files which could not be read.
+int dt_shim_read_metadata_list(const char *const *paths,
+                               int count,
+                               dt_shim_metadata_t *records);
 
 #ifdef __cplusplus
 }
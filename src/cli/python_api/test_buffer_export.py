@@ -16,6 +16,14 @@ from pathlib import Path
 # Import the generated Python API
 from _dt_api import ffi, lib
 
+# buffers shared with darktable, keyed by their cffi handle
+_pinned_buffers = {}
+
+@ffi.def_extern()
+def _dt_shim_release_buffer(user_data):
+    """Called by darktable once it doesn't reference a buffer anymore."""
+    _pinned_buffers.pop(user_data, None)
+
 def main():
     # Configuration
     input_file = "/mnt/2t4/development/darktable/test_data/test1.ARW"
@@ -89,12 +97,15 @@ def main():
         print(f"\n[TEST] Step 5: Attaching {len(raw_data):,} byte buffer to image...")
         print(f"[TEST] (Export will use this buffer instead of re-reading from disk)")
 
-        # Create a CFFI buffer from Python bytes
-        # IMPORTANT: raw_data must remain alive for the duration of export!
+        # Share the Python bytes without copying: the pin keeps raw_data
+        # alive until darktable releases its last reference
         buffer_ptr = ffi.from_buffer("uint8_t[]", raw_data)
+        pin = ffi.new_handle((raw_data, buffer_ptr))
+        _pinned_buffers[pin] = True
 
         # Attach buffer to the image
-        lib.dt_shim_attach_buffer_to_image(imgid, buffer_ptr, len(raw_data))
+        lib.dt_shim_attach_buffer_to_image(imgid, buffer_ptr, len(raw_data),
+                                           lib._dt_shim_release_buffer, pin)
 
         print(f"[TEST] Buffer attached to image {imgid}")
 
@@ -34,22 +34,43 @@ int main(int argc, char *arg[])
   dt_osx_prepare_environment();
 #endif
   int result = 1;
-  // only used to force-init opencl, so we want these options:
-  char *m_arg[] = { "-d", "opencl", "--library", ":memory:"};
+  // only used to force-init opencl and time the devices, so we want these
+  // options. the benchmark needs the programs built right away.
+  char *m_arg[] = { "-d", "opencl", "--library", ":memory:", "--conf", "opencl_background_compile=FALSE" };
+  // --precompile also provisions the kernel cache if OpenCL is switched off
+  char *p_arg[] = { "--conf", "opencl=TRUE" };
   const int m_argc = sizeof(m_arg) / sizeof(m_arg[0]);
-  char **argv = malloc(sizeof(arg[0]) * argc + sizeof(m_arg));
+  const int p_argc = sizeof(p_arg) / sizeof(p_arg[0]);
+  char **argv = malloc(sizeof(arg[0]) * argc + sizeof(m_arg) + sizeof(p_arg));
   if(!argv) goto end;
+  gboolean precompile = FALSE;
+  int k = 0;
   for(int i = 0; i < argc; i++)
-    argv[i] = arg[i];
+  {
+    if(!strcmp(arg[i], "--precompile"))
+      precompile = TRUE;
+    else
+      argv[k++] = arg[i];
+  }
   for(int i = 0; i < m_argc; i++)
-    argv[argc + i] = m_arg[i];
-  argc += m_argc;
-  if(dt_init(argc, argv, FALSE, FALSE, NULL, NULL)) // NULL applicationdir = auto-detect
+    argv[k++] = m_arg[i];
+  if(precompile)
+    for(int i = 0; i < p_argc; i++)
+      argv[k++] = p_arg[i];
+  if(dt_init(k, argv, FALSE, FALSE, NULL, NULL)) // NULL applicationdir = auto-detect
     goto end;
+#ifdef HAVE_OPENCL
+  // without a usable device nothing has been compiled
+  const gboolean compiled = darktable.opencl->inited;
+  // time all devices again, the automatic scheduling profile ranks them
+  dt_opencl_benchmark(TRUE);
+#else
+  const gboolean compiled = FALSE;
+#endif
   dt_cleanup();
   free(argv);
 
-  result = 0;
+  result = precompile && !compiled ? 1 : 0;
 end:
 
 #ifdef _WIN32
@@ -95,7 +95,7 @@ size_t dt_bilateral_memory_use(const int width,     // width of input image
   // OpenCL path needs two buffers
   return 2 * grid_size * sizeof(float);
 #else
-  return (grid_size + 3 * dt_get_num_threads() * b.size_x * b.size_z) * sizeof(float);
+  return grid_size * sizeof(float);
 #endif /* HAVE_OPENCL */
 }
 
@@ -120,7 +120,7 @@ size_t dt_bilateral_singlebuffer_size
   dt_bilateral_t b;
   dt_bilateral_grid_size(&b,width,height,100.0f,sigma_s,sigma_r);
   size_t grid_size = b.size_x * b.size_y * b.size_z;
-  return (grid_size + 3 * dt_get_num_threads() * b.size_x * b.size_z) * sizeof(float);
+  return grid_size * sizeof(float);
 }
 
 #ifndef HAVE_OPENCL
@@ -170,6 +170,30 @@ static size_t image_to_relgrid(const dt_bilateral_t *const b,
   return (xi * b->size_z) + zi;
 }
 
+// the first of the two grid rows image row j splats into
+static inline int image_to_gridrow(const dt_bilateral_t *const b,
+                                   const int j,
+                                   float *yf)
+{
+  float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
+  const int yi = MIN((int)y, b->size_y - 2);
+  *yf = y - yi;
+  return yi;
+}
+
+// the first image row whose first grid row is at least yi
+static int gridrow_to_image(const dt_bilateral_t *const b,
+                            const int yi)
+{
+  if(yi > (int)b->size_y - 2) return b->height;
+  float yf;
+  // start from the estimate and correct it for the rounding and clamping of image_to_gridrow()
+  int j = CLAMPS((int)(yi * b->sigma_s), 0, b->height);
+  while(j > 0 && image_to_gridrow(b, j - 1, &yf) >= yi) j--;
+  while(j < b->height && image_to_gridrow(b, j, &yf) < yi) j++;
+  return j;
+}
+
 dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
                                   const int height,    // height of input image
                                   const float sigma_s, // spatial sigma (blur pixel coords)
@@ -180,10 +204,7 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   dt_bilateral_grid_size(b,width,height,100.0f,sigma_s,sigma_r);
   b->width = width;
   b->height = height;
-  b->numslices = dt_get_num_threads();
-  b->sliceheight = (height + b->numslices - 1) / b->numslices;
-  b->slicerows = (b->size_y + b->numslices - 1) / b->numslices + 2;
-  b->buf = dt_calloc_align_float(b->size_x * b->size_z * b->numslices * b->slicerows);
+  b->buf = dt_calloc_align_float(b->size_x * b->size_y * b->size_z);
   if(!b->buf)
   {
     dt_print(DT_DEBUG_ALWAYS,
@@ -209,7 +230,6 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
 
   if(!buf) return;
   // splat into downsampled grid
-  const int nthreads = dt_get_num_threads();
   const size_t offsets[8] =
   {
     0,
@@ -222,70 +242,48 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
     oz + oy + ox
   };
 
-  DT_OMP_FOR()
-  for(int slice = 0; slice < b->numslices; slice++)
+  // Every image row splats into two adjacent grid rows, so the image rows whose first grid row is even
+  // never touch the same grid points as long as they are taken by grid row, and the same goes for the
+  // odd ones.  We splat the even and then the odd grid rows in parallel straight into the final grid, no
+  // per-thread copies nor merge needed.
+  for(int parity = 0; parity < 2; parity++)
   {
-    const int firstrow = slice * b->sliceheight;
-    const int lastrow = MIN((slice+1)*b->sliceheight,b->height);
-    // compute the first row of the final grid which this slice
-    // splats, and subtract that from the first row the current thread
-    // should use to get an offset
-    const int slice_offset = slice * b->slicerows - (int)(firstrow * b->sigma_s_inv);
-    // now iterate over the rows of the current horizontal slice
-    for(int j = firstrow; j < lastrow; j++)
+    DT_OMP_FOR()
+    for(int yi = parity; yi < (int)b->size_y - 1; yi += 2)
     {
-      float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
-      const int yi = MIN((int)y, b->size_y - 2);
-      const float yf = y - yi;
-      const size_t base = (size_t)(yi + slice_offset) * oy;
-      for(int i = 0; i < b->width; i++)
+      const int firstrow = gridrow_to_image(b, yi);
+      const int lastrow = gridrow_to_image(b, yi + 1);
+      const size_t base = (size_t)yi * oy;
+      for(int j = firstrow; j < lastrow; j++)
       {
-        size_t index = 4 * (j * b->width + i);
-        float xf, zf;
-        const float L = in[index];
-        // nearest neighbour splatting:
-        const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
-        // sum up payload here
-        const dt_aligned_pixel_t contrib =
-        {
-          // precompute the contributions along the first two dimensions:
-          (1.0f - xf) * (1.0f - yf) * 100.0f / sigma_s,
-          xf * (1.0f - yf) * 100.0f / sigma_s,
-          (1.0f - xf) * yf * 100.0f / sigma_s,
-          xf * yf * 100.0f / sigma_s
-        };
-        DT_OMP_SIMD(aligned(buf:64))
-        for(int k = 0; k < 4; k++)
+        float yf;
+        image_to_gridrow(b, j, &yf);
+        for(int i = 0; i < b->width; i++)
         {
-          buf[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
-          buf[grid_index + offsets[k+4]] += (contrib[k] * zf);
+          size_t index = 4 * ((size_t)j * b->width + i);
+          float xf, zf;
+          const float L = in[index];
+          // nearest neighbour splatting:
+          const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
+          // sum up payload here
+          const dt_aligned_pixel_t contrib =
+          {
+            // precompute the contributions along the first two dimensions:
+            (1.0f - xf) * (1.0f - yf) * 100.0f / sigma_s,
+            xf * (1.0f - yf) * 100.0f / sigma_s,
+            (1.0f - xf) * yf * 100.0f / sigma_s,
+            xf * yf * 100.0f / sigma_s
+          };
+          DT_OMP_SIMD(aligned(buf:64))
+          for(int k = 0; k < 4; k++)
+          {
+            buf[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
+            buf[grid_index + offsets[k+4]] += (contrib[k] * zf);
+          }
         }
       }
     }
   }
-
-  // merge the per-thread results into the final result
-  for(int slice = 1 ; slice < nthreads; slice++)
-  {
-    // compute the first row of the final grid which this slice splats
-    const int destrow = (int)(slice * b->sliceheight * b->sigma_s_inv);
-    float *dest = buf + destrow * oy;
-    // now iterate over the grid rows splatted for this slice
-    for(int j = slice * b->slicerows; j < (slice+1)*b->slicerows; j++)
-    {
-      float *src = buf + j * oy;
-      for(int i = 0; i < oy; i++)
-      {
-        dest[i] += src[i];
-      }
-      dest += oy;
-      // clear elements in the part of the buffer which holds the
-      // final result now that we've read the partial result, since
-      // we'll be adding to those locations later
-      if(j < b->size_y)
-        memset(buf + j*oy, '\0', sizeof(float) * oy);
-    }
-  }
 }
 
 DT_OMP_DECLARE_SIMD(aligned(buf:64))
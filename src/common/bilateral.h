@@ -24,7 +24,6 @@ typedef struct dt_bilateral_t
 {
   size_t size_x, size_y, size_z;
   int width, height;
-  int numslices, sliceheight, slicerows; //height--in input image, rows--in grid
   float sigma_s, sigma_r;
   float sigma_s_inv, sigma_r_inv;  // reciprocals of sigma_s and sigma_r to avoid divisions
   float *buf __attribute__((aligned(64)));
@@ -131,53 +131,13 @@ static void _store_scaled(float *const __restrict__ out,
     out[c] = in[c] / scale;
 }
 
-template<size_t N>
-static inline void _update_max(float m[N],
-                               const float *const __restrict__ base)
-{
-  DT_OMP_SIMD(aligned(m : 64))
-  for(size_t c = 0; c < N; c++)
-  {
-    m[c] = fmaxf(m[c], base[c]);
-  }
-}
-
-template<size_t N>
-static inline void _load_update_max(float *const __restrict__ out,
-                                    float m[N],
-                                    const float *const __restrict__ base)
-{
-  DT_OMP_SIMD(aligned(m : 64))
-  for(size_t c = 0; c < N; c++)
-  {
-    const float v = base[c];
-    out[c] = v;
-    m[c] = fmaxf(m[c], v);
-  }
-}
-
-template <size_t N>
-static inline void _update_min(float m[N], const float *const __restrict__ base)
-{
-  DT_OMP_SIMD(aligned(m : 64))
-  for(size_t c = 0; c < N; c++)
-  {
-    m[c] = fminf(m[c], base[c]);
-  }
-}
-
-template <size_t N>
-static inline void _load_update_min(float *const __restrict__ out,
-                                    float m[N],
+template <size_t N, bool is_max>
+static inline void _update_extremum(float m[N],
                                     const float *const __restrict__ base)
 {
   DT_OMP_SIMD(aligned(m : 64))
   for(size_t c = 0; c < N; c++)
-  {
-    const float v = base[c];
-    out[c] = v;
-    m[c] = fminf(m[c], v);
-  }
+    m[c] = is_max ? fmaxf(m[c], base[c]) : fminf(m[c], base[c]);
 }
 
 // invoked inside an OpenMP parallel for, so no need to parallelize
@@ -418,84 +378,6 @@ static inline void box_max_1d(const int N,
   }
 }
 
-// calculate the one-dimensional moving maximum on four adjacent columns over a window of size 2*w+1
-// input/output array 'buf' has stride 'stride' and we will write N consecutive elements every stride elements
-// (thus processing a cache line at a time if N==MAX_VECT)
-template <size_t N>
-static inline void _box_max_vert(const unsigned height,
-    float *const __restrict__ scratch,
-    float *const __restrict__ buf,
-    const size_t stride,
-    const unsigned w,
-    const size_t mask)
-{
-  float DT_ALIGNED_ARRAY m[N];
-  for(size_t i = 0; i < N; i++)
-     m[i] = -(FLT_MAX);
-  for(size_t i = 0; i < MIN(w + 1, height); i++)
-  {
-    PREFETCH_NTA(buf + stride*(i+24));
-    _load_update_max<N>(scratch + N * (i&mask),m, buf + stride*i);
-  }
-  for(size_t i = 0; i < height; i++)
-  {
-    PREFETCH_NTA(buf + stride*(i+24));
-    // store maximum of current window at center position
-    _store<N>(buf + stride * i, m);
-    // If the earliest member of the current window is the max, we need to
-    // rescan the window to determine the new maximum
-    if(i >= w)
-    {
-      _set<N>(m, -(FLT_MAX));  // reset max values to lowest possible
-      for(size_t j = i - w + 1; j < MIN(i + w + 1, height); j++)
-      {
-        _update_max<N>(m,scratch + N*(j&mask));
-      }
-    }
-    // if the window has not yet exceeded the end of the row/column, update the maximum value
-    const size_t n = i + w + 1;
-    if(n < height)
-    {
-      _load_update_max<N>(scratch + N * (n&mask), m, buf + stride * n);
-    }
-  }
-}
-
-// calculate the two-dimensional moving maximum over a box of size (2*w+1) x (2*w+1)
-// does the calculation in-place if input and output images are identical
-static void _box_max_1ch(float *const buf,
-                        const size_t height,
-                        const size_t width,
-                        const unsigned w)
-{
-  const size_t eff_height = _compute_effective_height(height, w);
-  const size_t scratch_size = MAX(width,MAX(height,MAX_VECT*eff_height));
-  size_t allocsize;
-  float *const __restrict__ scratch_buffers = dt_alloc_perthread_float(scratch_size, &allocsize);
-  if(scratch_buffers == NULL) return;
-
-  DT_OMP_FOR()
-  for(size_t row = 0; row < height; row++)
-  {
-    float *const __restrict__ scratch = (float*)dt_get_perthread(scratch_buffers,allocsize);
-    memcpy(scratch, buf + row * width, sizeof(float) * width);
-    box_max_1d(width, scratch, buf + row * width, w);
-  }
-  DT_OMP_FOR()
-  for(size_t col = 0; col < (width & ~(MAX_VECT-1)); col += MAX_VECT)
-  {
-    float *const __restrict__ scratch = (float*)dt_get_perthread(scratch_buffers,allocsize);
-    _box_max_vert<MAX_VECT>(height, scratch, buf + col, width, w, eff_height-1);
-  }
-  // handle the leftover 0..(MAX_VECT-1) columns, first in groups of four, then the final 0..3 singly
-  size_t col = width & ~(MAX_VECT-1);
-  for( ; col < (width & ~3); col += 4)
-    _box_max_vert<4>(height, scratch_buffers, buf + col, width, w, eff_height-1);
-  for( ; col < width; col++)
-    _box_max_vert<1>(height, scratch_buffers, buf + col, width, w, eff_height-1);
-  dt_free_align(scratch_buffers);
-}
-
 static inline float _window_min(const float *x, int n)
 {
   float m = FLT_MAX;
@@ -522,81 +404,134 @@ static inline void _box_min_1d(int N, const float *x, float *y, int w)
   }
 }
 
-// calculate the one-dimensional moving minimum on four adjacent columns over a window of size 2*w+1
+// calculate the one-dimensional moving maximum (or minimum) on N adjacent columns over a window of size
+// 2*w+1 with the van Herk/Gil-Werman algorithm: the column, padded by w rows at either end, is cut into
+// blocks of 2*w+1 rows so that the window centered on any row spans the tail of one block and the head of
+// the next.  A running extremum forward and one backward through each block then give every output with
+// three comparisons, whatever the radius and the data.
 // input/output array 'buf' has stride 'stride' and we will write N consecutive elements every stride elements
-// (thus processing a cache line at a time when N == MAX_VECT)
-template <size_t N>
-static inline void _box_min_vert(const unsigned height,
-    float *const __restrict__ scratch,
-    float *const __restrict__ buf,
-    const int stride,
-    const unsigned w,
-    const size_t mask)
+// (thus processing a cache line at a time if N==MAX_VECT), 'scratch' must hold N*height floats
+template <size_t N, bool is_max>
+static void _box_extremum_vert(const size_t height,
+                               float *const __restrict__ scratch,
+                               float *const __restrict__ buf,
+                               const size_t stride,
+                               const size_t w)
 {
+  const float init = is_max ? -(FLT_MAX) : FLT_MAX;
+  const size_t window = 2 * w + 1;
   float DT_ALIGNED_ARRAY m[N];
-  for(size_t i = 0; i < N; i++)
-     m[i] = FLT_MAX;
-  for(size_t i = 0; i < MIN(w + 1, height); i++)
-  {
-    PREFETCH_NTA(buf + stride*(i+24));
-    _load_update_min<N>(scratch + N*(i&mask), m, buf + stride*i);
-  }
-  for(size_t i = 0; i < height; i++)
-  {
-    PREFETCH_NTA(buf + stride*(i+24));
-    // store minimum of current window at center position
-    _store<N>(buf + i * stride, m);
-    // If the earliest member of the current window is the min, we need to
-    // rescan the window to determine the new minimum
-    if(i >= w)
+
+  // forward pass: the extremum from the start of the block up to padded row p, which is row p-w of the
+  // buffer.  Only the values for p >= 2*w are ever needed, they go to scratch[p - 2*w]
+  size_t pos = 0;
+  for(size_t p = 0; p < height + 2 * w; p++)
+  {
+    if(pos == 0) _set<N>(m, init);
+    if(p >= w && p < height + w)
+      _update_extremum<N,is_max>(m, buf + stride * (p - w));
+    if(p >= 2 * w)
+      _store<N>(scratch + N * (p - 2 * w), m);
+    if(++pos == window) pos = 0;
+  }
+
+  // backward pass: the extremum from padded row p down to the end of its block, starting from the end of
+  // the block holding the last row.  The window centered on row p of the buffer is the combination with
+  // the forward extremum at padded row p+2*w.  We read row p-w before writing row p, so all reads of a row
+  // happen before it gets overwritten.
+  const size_t last = (height - 1) / window * window + window - 1;
+  pos = window - 1;
+  _set<N>(m, init);
+  for(size_t p = last + 1; p-- > 0; )
+  {
+    if(p >= w && p < height + w)
+      _update_extremum<N,is_max>(m, buf + stride * (p - w));
+    if(p < height)
     {
-      _set<N>(m, FLT_MAX);  // reset min values to the highest possible
-      for(size_t j = i - w + 1; j < MIN(i + w + 1, height); j++)
-      {
-        _update_min<N>(m,scratch + N*(j&mask));
-      }
+      float *const __restrict__ out = buf + stride * p;
+      const float *const __restrict__ fwd = scratch + N * p;
+      DT_OMP_SIMD(aligned(m : 64))
+      for(size_t c = 0; c < N; c++)
+        out[c] = is_max ? fmaxf(m[c], fwd[c]) : fminf(m[c], fwd[c]);
     }
-    // if the window has not yet exceeded the end of the row/column, update the minimum value
-    const size_t n = i + w + 1;
-    if(n < height)
+    if(pos == 0)
     {
-      _load_update_min<N>(scratch + N * (n&mask), m, buf + stride * n);
+      _set<N>(m, init);
+      pos = window;
     }
+    pos--;
   }
 }
 
-// calculate the two-dimensional moving minimum over a box of size (2*w+1) x (2*w+1)
+// the horizontal passes of the min/max filters transpose a group of MAX_VECT rows into a block holding
+// MAX_VECT floats per column, so that _box_extremum_vert() handles them a cache line at a time
+static inline void _transpose_rows_in(float *const __restrict__ block,
+                                      const float *const __restrict__ buf,
+                                      const size_t width)
+{
+  for(size_t x = 0; x < width; x++)
+    for(size_t r = 0; r < MAX_VECT; r++)
+      block[MAX_VECT * x + r] = buf[r * width + x];
+}
+
+static inline void _transpose_rows_out(float *const __restrict__ buf,
+                                       const float *const __restrict__ block,
+                                       const size_t width)
+{
+  for(size_t r = 0; r < MAX_VECT; r++)
+    for(size_t x = 0; x < width; x++)
+      buf[r * width + x] = block[MAX_VECT * x + r];
+}
+
+// calculate the two-dimensional moving maximum (or minimum) over a box of size (2*w+1) x (2*w+1)
 // does the calculation in-place if input and output images are identical
-static void _box_min_1ch(float *const buf,
-                        const size_t height,
-                        const size_t width,
-                        const unsigned w)
+template <bool is_max>
+static void _box_extremum_1ch(float *const buf,
+                              const size_t height,
+                              const size_t width,
+                              const unsigned w)
 {
-  const size_t eff_height = _compute_effective_height(height, w);
-  const size_t scratch_size = MAX(width,MAX(height,MAX_VECT*eff_height));
+  // the rows are transposed in groups of MAX_VECT, followed by the forward pass of _box_extremum_vert
+  const size_t scratch_size = MAX_VECT * MAX(2 * width, height);
   size_t allocsize;
-  float *const __restrict__ scratch_buffers = dt_alloc_perthread_float(scratch_size,&allocsize);
+  float *const __restrict__ scratch_buffers = dt_alloc_perthread_float(scratch_size, &allocsize);
   if(scratch_buffers == NULL) return;
 
   DT_OMP_FOR()
-  for(size_t row = 0; row < height; row++)
+  for(size_t row = 0; row < height; row += MAX_VECT)
   {
     float *const __restrict__ scratch = (float*)dt_get_perthread(scratch_buffers,allocsize);
-    memcpy(scratch, buf + row * width, sizeof(float) * width);
-    _box_min_1d(width, scratch, buf + row * width, w);
+    if(row + MAX_VECT <= height)
+    {
+      _transpose_rows_in(scratch, buf + row * width, width);
+      _box_extremum_vert<MAX_VECT,is_max>(width, scratch + MAX_VECT * width, scratch, MAX_VECT, w);
+      _transpose_rows_out(buf + row * width, scratch, width);
+    }
+    else
+    {
+      // handle the leftover rows singly
+      for(size_t r = row; r < height; r++)
+      {
+        memcpy(scratch, buf + r * width, sizeof(float) * width);
+        if(is_max)
+          box_max_1d(width, scratch, buf + r * width, w);
+        else
+          _box_min_1d(width, scratch, buf + r * width, w);
+      }
+    }
   }
   DT_OMP_FOR()
   for(size_t col = 0; col < (width & ~(MAX_VECT-1)); col += MAX_VECT)
   {
     float *const __restrict__ scratch = (float*)dt_get_perthread(scratch_buffers,allocsize);
-    _box_min_vert<MAX_VECT>(height, scratch, buf + col, width, w, eff_height-1);
+    _box_extremum_vert<MAX_VECT,is_max>(height, scratch, buf + col, width, w);
   }
   // handle the leftover 0..(MAX_VECT-1) columns, first in groups of four, then the final 0..3 singly
   size_t col = width & ~(MAX_VECT-1);
   for( ; col < (width & ~3); col += 4)
-    _box_min_vert<4>(height, scratch_buffers, buf + col, width, w, eff_height-1);
+    _box_extremum_vert<4,is_max>(height, scratch_buffers, buf + col, width, w);
   for( ; col < width; col++)
-    _box_min_vert<1>(height, scratch_buffers, buf + col, width, w, eff_height-1);
+    _box_extremum_vert<1,is_max>(height, scratch_buffers, buf + col, width, w);
   dt_free_align(scratch_buffers);
 }
 
@@ -695,7 +630,7 @@ void dt_box_min(float *const buf,
                 const size_t radius)
 {
   if(ch == 1)
-    _box_min_1ch(buf, height, width, radius);
+    _box_extremum_1ch<false>(buf, height, width, radius);
   else
   //TODO: 4ch version if needed
     dt_unreachable_codepath();
@@ -709,7 +644,7 @@ void dt_box_max(float *const buf,
                 const size_t radius)
 {
   if(ch == 1)
-    _box_max_1ch(buf, height, width, radius);
+    _box_extremum_1ch<true>(buf, height, width, radius);
   else
   //TODO: 4ch version if needed
     dt_unreachable_codepath();
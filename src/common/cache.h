@@ -28,26 +28,41 @@ typedef struct dt_cache_entry_t
   void *data;
   size_t data_size;
   size_t cost;
-  GList *link;
+  GList link; // node in the lru list of its shard, no allocation per entry
   dt_pthread_rwlock_t lock;
   gboolean _lock_demoting;
   uint32_t key;
+  // how costly the entry is to regenerate, set by the user: the gc moves
+  // it back to the tail of the lru up to this many times before evicting it
+  uint8_t weight;
+  uint8_t _passes; // times it was spared since it was last used
 } dt_cache_entry_t;
 
 typedef void((*dt_cache_allocate_t)(void *userdata, dt_cache_entry_t *entry));
 typedef void((*dt_cache_cleanup_t)(void *userdata, dt_cache_entry_t *entry));
 
+// the cache is split into shards by key, each with its own lock, hash
+// table and lru list, so threads working on different images do not
+// serialise on one lock. the quota applies to the whole cache.
+#define DT_CACHE_SHARDS 16
+
+typedef struct dt_cache_shard_t
+{
+  dt_pthread_mutex_t lock;
+
+  size_t cost; // sum of the cost of the entries in this shard
+
+  GHashTable *hashtable; // stores (key, entry) pairs
+  GQueue lru;            // tail is most recently used, head is about to be kicked from cache.
+} dt_cache_shard_t;
+
 typedef struct dt_cache_t
 {
-  dt_pthread_mutex_t lock; // big fat lock. we're only expecting a couple hand full of cpu threads to use this concurrently.
+  dt_cache_shard_t shard[DT_CACHE_SHARDS];
 
   size_t entry_size; // cache line allocation
-  size_t cost;       // user supplied cost per cache line (bytes?)
   size_t cost_quota; // quota to try and meet. but don't use as hard limit.
 
-  GHashTable *hashtable; // stores (key, entry) pairs
-  GList *lru;            // last element is most recently used, first is about to be kicked from cache.
-
   // callback functions for cache misses/garbage collection
   dt_cache_allocate_t allocate;
   dt_cache_allocate_t cleanup;
@@ -61,6 +76,16 @@ void dt_cache_init(dt_cache_t *cache,
                    const size_t cost_quota);
 void dt_cache_cleanup(dt_cache_t *cache);
 
+// user supplied cost of all entries. not locked, only a snapshot
+// while other threads use the cache.
+static inline size_t dt_cache_cost(const dt_cache_t *cache)
+{
+  size_t cost = 0;
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+    cost += cache->shard[k].cost;
+  return cost;
+}
+
 static inline void dt_cache_set_allocate_callback(dt_cache_t *cache,
                                                   dt_cache_allocate_t allocate_cb,
                                                   void *allocate_data)
@@ -97,9 +122,9 @@ void dt_cache_release_with_caller(dt_cache_t *cache,
 gboolean dt_cache_contains(dt_cache_t *cache, const uint32_t key);
 // returns FALSE on success, TRUE if the key was not found.
 gboolean dt_cache_remove(dt_cache_t *cache, const uint32_t key);
-// removes from the tip of the lru list, until the fill ratio of the hashtable
+// removes from the tip of the lru lists, until the fill ratio of the cache
 // goes below the given parameter, in terms of the user defined cost measure.
-// will never lock and never fail, but sometimes not free memory (in case all
+// will never block and never fail, but sometimes not free memory (in case all
 // is locked)
 void dt_cache_gc(dt_cache_t *cache,
                  const float fill_ratio);
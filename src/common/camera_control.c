@@ -385,8 +385,16 @@ static void _camera_process_job(const dt_camctl_t *c,
           //if(color_space == DT_COLORSPACE_DISPLAY)
           //  color_space = DT_COLORSPACE_SRGB;
           // no embedded colorspace, assume is sRGB
-          uint8_t *const buffer =
-            (uint8_t *)dt_alloc_align_uint8(4 * jpg.width * jpg.height);
+          // frames are decoded into a second buffer which is only
+          // reallocated when the preview dimensions change
+          const size_t size = (size_t)4 * jpg.width * jpg.height;
+          if(cam->live_view_back_size != size)
+          {
+            dt_free_align(cam->live_view_back);
+            cam->live_view_back = (uint8_t *)dt_alloc_align_uint8(size);
+            cam->live_view_back_size = cam->live_view_back ? size : 0;
+          }
+          uint8_t *const buffer = cam->live_view_back;
           if(!buffer)
           {
             dt_print(DT_DEBUG_CAMCTL,
@@ -400,8 +408,10 @@ static void _camera_process_job(const dt_camctl_t *c,
           else
           {
             dt_pthread_mutex_lock(&cam->live_view_buffer_mutex);
-            // FIXME: don't need to alloc/dealloc if the image dimensions haven't changed
-            if(cam->live_view_buffer) dt_free_align(cam->live_view_buffer);
+            cam->live_view_back = cam->live_view_buffer;
+            cam->live_view_back_size = cam->live_view_buffer
+              ? (size_t)4 * cam->live_view_width * cam->live_view_height
+              : 0;
             cam->live_view_buffer = buffer;
             cam->live_view_width = jpg.width;
             cam->live_view_height = jpg.height;
@@ -719,6 +729,8 @@ static void dt_camctl_camera_destroy_struct(dt_camera_t *cam)
     dt_free_align(cam->live_view_buffer);
     cam->live_view_buffer = NULL; // just in case someone else is using this
   }
+  dt_free_align(cam->live_view_back);
+  cam->live_view_back = NULL;
   g_free(cam->model);
   g_free(cam->port);
   dt_pthread_mutex_destroy(&cam->jobqueue_lock);
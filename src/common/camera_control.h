@@ -98,6 +98,9 @@ typedef struct dt_camera_t
   /** The last preview image from the camera */
   uint8_t *live_view_buffer;
   int live_view_width, live_view_height;
+  /** The buffer the next preview is decoded into, swapped with the one above */
+  uint8_t *live_view_back;
+  size_t live_view_back_size;
   //dt_colorspaces_color_profile_type_t live_view_color_space;
   /** Rotation of live view, multiples of 90° */
   int32_t live_view_rotation;
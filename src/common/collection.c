@@ -90,6 +90,7 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
     collection->where_ext = g_strdupv(clone->where_ext);
     collection->query = g_strdup(clone->query);
     collection->query_no_group = g_strdup(clone->query_no_group);
+    collection->query_where = g_strdup(clone->query_where);
     collection->clone = 1;
     collection->count = clone->count;
     collection->count_no_group = clone->count_no_group;
@@ -116,6 +117,7 @@ void dt_collection_free(const dt_collection_t *collection)
 
   g_free(collection->query);
   g_free(collection->query_no_group);
+  g_free(collection->query_where);
   g_strfreev(collection->where_ext);
   g_free((dt_collection_t *)collection);
 }
@@ -186,6 +188,136 @@ void dt_collection_memory_update()
   g_free(ins_query);
 }
 
+// more changed images than this and the rebuild is cheaper than
+// closing the gaps one by one
+#define DT_COLLECTION_INCREMENTAL_MAX 1000
+
+// whether a change of the property on some images can leave them at
+// the same place in the sorted collection
+static gboolean _collection_keeps_order(const dt_collection_t *collection,
+                                        const dt_collection_properties_t property)
+{
+  const gboolean *sorts = collection->params.sorts;
+  if(sorts[DT_COLLECTION_SORT_CHANGE_TIMESTAMP]) return FALSE;
+
+  switch(property)
+  {
+    case DT_COLLECTION_PROP_RATING:
+    case DT_COLLECTION_PROP_RATING_RANGE:
+      return !sorts[DT_COLLECTION_SORT_RATING];
+    case DT_COLLECTION_PROP_COLORLABEL:
+      return !sorts[DT_COLLECTION_SORT_COLOR];
+    case DT_COLLECTION_PROP_TAG:
+      return !sorts[DT_COLLECTION_SORT_CUSTOM_ORDER];
+    case DT_COLLECTION_PROP_METADATA:
+      return !sorts[DT_COLLECTION_SORT_TITLE] && !sorts[DT_COLLECTION_SORT_DESCRIPTION];
+    case DT_COLLECTION_PROP_ASPECT_RATIO:
+      return !sorts[DT_COLLECTION_SORT_ASPECT_RATIO];
+    case DT_COLLECTION_PROP_GEOTAGGING:
+    case DT_COLLECTION_PROP_LOCAL_COPY:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+// re-test only the changed images, and the other images of their
+// groups, against the collection. images dropping out are removed from
+// memory.collected_images and the following rowids closed up, so the
+// positions stay contiguous. returns FALSE if the full rebuild is needed
+// because an image joins the collection.
+static gboolean _collection_memory_update_images(const dt_collection_t *collection,
+                                                 const gchar *imgs)
+{
+  if(!collection->query_where) return FALSE;
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+
+  // clang-format off
+  gchar *query = g_strdup_printf
+    ("SELECT 1 FROM main.images AS mi"
+     " WHERE mi.group_id IN (SELECT group_id FROM main.images WHERE id IN (%s))"
+     "   AND IFNULL((%s), 0)"
+     "   AND mi.id NOT IN (SELECT imgid FROM memory.collected_images)"
+     " LIMIT 1",
+     imgs, collection->query_where);
+  // clang-format on
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  const gboolean joins = sqlite3_step(stmt) == SQLITE_ROW;
+  sqlite3_finalize(stmt);
+  g_free(query);
+  if(joins) return FALSE;
+
+  // clang-format off
+  query = g_strdup_printf
+    ("SELECT rowid FROM memory.collected_images"
+     " WHERE imgid IN (SELECT mi.id FROM main.images AS mi"
+     "                 WHERE mi.group_id IN (SELECT group_id FROM main.images WHERE id IN (%s))"
+     "                   AND NOT IFNULL((%s), 0))"
+     " ORDER BY rowid",
+     imgs, collection->query_where);
+  // clang-format on
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  GArray *gone = g_array_new(FALSE, FALSE, sizeof(int));
+  while(sqlite3_step(stmt) == SQLITE_ROW && gone->len <= DT_COLLECTION_INCREMENTAL_MAX)
+  {
+    const int rowid = sqlite3_column_int(stmt, 0);
+    g_array_append_val(gone, rowid);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  const int count = gone->len;
+  if(count > DT_COLLECTION_INCREMENTAL_MAX)
+  {
+    g_array_free(gone, TRUE);
+    return FALSE;
+  }
+
+  if(count)
+  {
+    const int *rowids = (const int *)gone->data;
+    // the rows after the first gap are negated out of the way, then put
+    // back shifted by the number of gaps before them
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "DELETE FROM memory.collected_images WHERE rowid = ?1",
+                                -1, &stmt, NULL);
+    for(int k = 0; k < count; k++)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rowids[k]);
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "UPDATE memory.collected_images SET rowid = -rowid"
+                                " WHERE rowid > ?1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rowids[0]);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "UPDATE memory.collected_images SET rowid = -rowid - ?1"
+                                " WHERE rowid < -?2 AND rowid > ?3",
+                                -1, &stmt, NULL);
+    for(int k = 0; k < count; k++)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, k + 1);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, rowids[k]);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, k + 1 < count ? -rowids[k + 1] : G_MININT);
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+  }
+  g_array_free(gone, TRUE);
+
+  dt_print(DT_DEBUG_SQL, "[collection] %d images removed from memory.collected_images", count);
+  return TRUE;
+}
+
 static void _dt_collection_set_selq_pre_sort(const dt_collection_t *collection,
                                              char **selq_pre)
 {
@@ -371,6 +503,8 @@ int dt_collection_update(const dt_collection_t *collection)
                   (collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT)
                   ? " " LIMIT_QUERY : "");
   result = _dt_collection_store(collection, query, query_no_group);
+  g_free(collection->query_where);
+  ((dt_collection_t *)collection)->query_where = g_strdup(wq);
 
   /* free memory used */
   g_free(sq);
@@ -1678,7 +1812,7 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
             ("(mi.id IN (SELECT imgid FROM main.tagged_images"
              "           WHERE tagid IN (SELECT id FROM data.tags "
              "                           WHERE name = '%s'"
-             "                            OR SUBSTR(name, 1, LENGTH('%s') + 1) = '%s|')))",
+             "                            OR (name >= '%s|' AND name < '%s}'))))",
              escaped_text, escaped_text, escaped_text);
           // clang-format on
         }
@@ -1686,13 +1820,32 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
         {
           // ends with % or |%
           escaped_text[escaped_length - 1] = '\0';
-          // clang-format off
-          query = g_strdup_printf
-            ("(mi.id IN (SELECT imgid FROM main.tagged_images"
-             "           WHERE tagid IN (SELECT id FROM data.tags"
-             "                           WHERE SUBSTR(name, 1, LENGTH('%s')) = '%s')))",
-             escaped_text, escaped_text);
-          // clang-format on
+          const size_t prefix_length = escaped_length - 1;
+          if(prefix_length > 0 && escaped_text[prefix_length - 1] != '\'')
+          {
+            // the names starting with the prefix are those below the
+            // prefix with its last byte incremented, an index range
+            gchar *prefix_end = g_strdup(escaped_text);
+            prefix_end[prefix_length - 1]++;
+            // clang-format off
+            query = g_strdup_printf
+              ("(mi.id IN (SELECT imgid FROM main.tagged_images"
+               "           WHERE tagid IN (SELECT id FROM data.tags"
+               "                           WHERE name >= '%s' AND name < '%s')))",
+               escaped_text, prefix_end);
+            // clang-format on
+            g_free(prefix_end);
+          }
+          else
+          {
+            // clang-format off
+            query = g_strdup_printf
+              ("(mi.id IN (SELECT imgid FROM main.tagged_images"
+               "           WHERE tagid IN (SELECT id FROM data.tags"
+               "                           WHERE SUBSTR(name, 1, LENGTH('%s')) = '%s')))",
+               escaped_text, escaped_text);
+            // clang-format on
+          }
         }
         else
         {
@@ -1873,9 +2026,12 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
         query = g_strdup_printf("(focal_length %s %s)", operator, number1);
       else if(number1)
         // clang-format off
+        // the bare range lets sqlite use the index, the cast keeps the match
         query = g_strdup_printf
-          ("(CAST(focal_length AS INTEGER) = CAST(%s AS INTEGER))",
-           number1);
+          ("((focal_length > CAST(%s AS INTEGER) - 1)"
+           " AND (focal_length < CAST(%s AS INTEGER) + 1)"
+           " AND (CAST(focal_length AS INTEGER) = CAST(%s AS INTEGER)))",
+           number1, number1, number1);
         // clang-format on
       else
         query = g_strdup_printf("(focal_length LIKE '%%%s%%')", escaped_text);
@@ -1918,15 +2074,19 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
       {
         if(number1 && number2)
           // clang-format off
+          // the bare range lets sqlite use the index, the rounding keeps the match
           query = g_strdup_printf
-            ("((ROUND(aperture,1) >= %s) AND (ROUND(aperture,1) <= %s))",
-             number1, number2);
+            ("((aperture >= %s - 0.051) AND (aperture <= %s + 0.051)"
+             " AND (ROUND(aperture,1) >= %s) AND (ROUND(aperture,1) <= %s))",
+             number1, number2, number1, number2);
           // clang-format on
       }
       else if(operator && number1)
         query = g_strdup_printf("(ROUND(aperture,1) %s %s)", operator, number1);
       else if(number1)
-        query = g_strdup_printf("(ROUND(aperture,1) = %s)", number1);
+        query = g_strdup_printf("((aperture >= %s - 0.051) AND (aperture <= %s + 0.051)"
+                                " AND (ROUND(aperture,1) = %s))",
+                                number1, number1, number1);
       else
         query = g_strdup_printf("(ROUND(aperture,1) LIKE '%%%s%%')", escaped_text);
 
@@ -1954,9 +2114,10 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
         query = g_strdup_printf("(exposure %s %s)", operator, number1);
       else if(number1)
         // clang-format off
-        query = g_strdup_printf("(CASE WHEN exposure < 0.4 THEN ((exposure >= %s - 1.0/100000) AND  (exposure <= %s + 1.0/100000)) "
-                                "ELSE (ROUND(exposure,2) >= %s - 1.0/100000) AND (ROUND(exposure,2) <= %s + 1.0/100000) END)",
-                                number1, number1, number1, number1);
+        query = g_strdup_printf("((exposure >= %s - 0.0051) AND (exposure <= %s + 0.0051) AND "
+                                "(CASE WHEN exposure < 0.4 THEN ((exposure >= %s - 1.0/100000) AND  (exposure <= %s + 1.0/100000)) "
+                                "ELSE (ROUND(exposure,2) >= %s - 1.0/100000) AND (ROUND(exposure,2) <= %s + 1.0/100000) END))",
+                                number1, number1, number1, number1, number1, number1);
         // clang-format on
       else
         query = g_strdup_printf("(exposure LIKE '%%%s%%')", escaped_text);
@@ -2166,7 +2327,14 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
       case DT_COLLECTION_PROP_TEXTSEARCH: // text search
       {
         // clang-format off
-        if(g_strcmp0(escaped_text, "%%") != 0)
+        if(g_strcmp0(escaped_text, "%%") == 0)
+          break;
+        if(dt_database_has_text_search(darktable.db))
+          // the trigram index answers the substring match
+          query = g_strdup_printf
+            ("(mi.id IN (SELECT rowid FROM main.images_fts WHERE text LIKE '%s'))",
+             escaped_text);
+        else
           query = g_strdup_printf
             ("(mi.id IN (SELECT id FROM main.meta_data WHERE value LIKE '%s'"
              " UNION SELECT imgid AS id"
@@ -2522,6 +2690,7 @@ void dt_collection_update_query(const dt_collection_t *collection,
                                 GList *list)
 {
   int next = -1;
+  gchar *txt = NULL;
   if(!collection->clone && query_change == DT_COLLECTION_CHANGE_NEW_QUERY
      && darktable.gui)
   {
@@ -2537,7 +2706,6 @@ void dt_collection_update_query(const dt_collection_t *collection,
       // untouched imageid after the list we do this here
 
       // 1. create a string with all the imgids of the list to be used inside IN sql query
-      gchar *txt = NULL;
       int i = 0;
       for(GList *l = list; l; l = g_list_next(l))
       {
@@ -2593,7 +2761,6 @@ void dt_collection_update_query(const dt_collection_t *collection,
         sqlite3_finalize(stmt2);
         g_free(query);
       }
-      g_free(txt);
     }
   }
 
@@ -2676,13 +2843,22 @@ void dt_collection_update_query(const dt_collection_t *collection,
                                      // update will be made by a
                                      // signal handler
 
+  // the query is the same after a change of some images, only these
+  // may have to leave the collection
+  const gboolean incremental = txt
+                               && query_change == DT_COLLECTION_CHANGE_RELOAD
+                               && _collection_keeps_order(collection, changed_property);
+
   // remove from selected images where not in this query.
   sqlite3_stmt *stmt = NULL;
   const gchar *cquery = dt_collection_get_query_no_group(collection);
   if(cquery && cquery[0] != '\0')
   {
     gchar *complete_query = g_strdup_printf("DELETE FROM main.selected_images"
-                                            " WHERE imgid NOT IN (%s)", cquery);
+                                            " WHERE imgid NOT IN (%s)%s%s%s", cquery,
+                                            incremental ? " AND imgid IN (" : "",
+                                            incremental ? txt : "",
+                                            incremental ? ")" : "");
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                                 complete_query, -1, &stmt, NULL);
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
@@ -2702,7 +2878,8 @@ void dt_collection_update_query(const dt_collection_t *collection,
   /* raise signal of collection change, only if this is an original */
   if(!collection->clone)
   {
-    dt_collection_memory_update();
+    if(!incremental || !_collection_memory_update_images(collection, txt))
+      dt_collection_memory_update();
     DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_COLLECTION_CHANGED,
                             query_change, changed_property,
                             list, next);
@@ -2713,6 +2890,7 @@ void dt_collection_update_query(const dt_collection_t *collection,
         LUA_ASYNC_DONE);
 #endif
   }
+  g_free(txt);
 }
 
 gboolean dt_collection_has_property(const dt_collection_properties_t property)
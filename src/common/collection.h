@@ -159,6 +159,7 @@ typedef struct dt_collection_t
 {
   int clone;
   gchar *query, *query_no_group;
+  gchar *query_where; // the filter part of query on main.images AS mi
   gchar **where_ext;
   uint32_t count, count_no_group;
   uint32_t tagid;
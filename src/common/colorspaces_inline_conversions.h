@@ -334,7 +334,7 @@ static inline void dt_xyY_to_Luv(const dt_aligned_pixel_t xyY, dt_aligned_pixel_
 
   // We assume Yn == 1 == peak luminance
   const float threshold = cbf(6.0f / 29.0f);
-  Luv[0] = (uvY[2] <= threshold) ? cbf(29.0f / 3.0f) * uvY[2] : 116.0f * cbrtf(uvY[2]) - 16.f;
+  Luv[0] = (uvY[2] <= threshold) ? cbf(29.0f / 3.0f) * uvY[2] : 116.0f * cbrta_halleyf(cbrt_5f(uvY[2]), uvY[2]) - 16.f;
 
   const float D50[2] DT_ALIGNED_PIXEL = { 0.20915914598542354f, 0.488075320769787f };
   Luv[1] = 13.f * Luv[0] * (uvY[0] - D50[0]); // u*
@@ -347,8 +347,8 @@ static inline void dt_xyY_to_Luv(const dt_aligned_pixel_t xyY, dt_aligned_pixel_
 static inline void dt_Luv_to_Lch(const dt_aligned_pixel_t Luv, dt_aligned_pixel_t Lch)
 {
   Lch[0] = Luv[0];                 // L stays L
-  Lch[1] = hypotf(Luv[2], Luv[1]); // chroma radius
-  Lch[2] = atan2f(Luv[2], Luv[1]); // hue angle
+  Lch[1] = dt_fast_hypotf(Luv[2], Luv[1]); // chroma radius
+  Lch[2] = dt_fast_atan2f(Luv[2], Luv[1]); // hue angle
   Lch[2] = (Lch[2] < 0.f) ? 2.f * M_PI + Lch[2] : Lch[2]; // ensure angle is positive modulo 2 pi
 }
 
@@ -769,7 +769,7 @@ static inline void dt_RGB_2_HCV(const dt_aligned_pixel_t RGB, dt_aligned_pixel_t
 DT_OMP_DECLARE_SIMD()
 static inline void dt_Lab_2_LCH(const dt_aligned_pixel_t Lab, dt_aligned_pixel_t LCH)
 {
-  float var_H = atan2f(Lab[2], Lab[1]);
+  float var_H = dt_fast_atan2f(Lab[2], Lab[1]);
 
   if(var_H > 0.0f)
     var_H = var_H / (2.0f * M_PI_F);
@@ -777,7 +777,7 @@ static inline void dt_Lab_2_LCH(const dt_aligned_pixel_t Lab, dt_aligned_pixel_t
     var_H = 1.0f - fabsf(var_H) / (2.0f * M_PI_F);
 
   LCH[0] = Lab[0];
-  LCH[1] = hypotf(Lab[1], Lab[2]);
+  LCH[1] = dt_fast_hypotf(Lab[1], Lab[2]);
   LCH[2] = var_H;
 }
 
@@ -881,9 +881,9 @@ static inline void dt_XYZ_2_JzAzBz(const dt_aligned_pixel_t XYZ_D65, dt_aligned_
 DT_OMP_DECLARE_SIMD(aligned(JzAzBz, JzCzhz: 16))
 static inline void dt_JzAzBz_2_JzCzhz(const dt_aligned_pixel_t JzAzBz, dt_aligned_pixel_t JzCzhz)
 {
-  float var_H = atan2f(JzAzBz[2], JzAzBz[1]) / (2.0f * M_PI_F);
+  float var_H = dt_fast_atan2f(JzAzBz[2], JzAzBz[1]) / (2.0f * M_PI_F);
   JzCzhz[0] = JzAzBz[0];
-  JzCzhz[1] = hypotf(JzAzBz[1], JzAzBz[2]);
+  JzCzhz[1] = dt_fast_hypotf(JzAzBz[1], JzAzBz[2]);
   JzCzhz[2] = var_H >= 0.0f ? var_H : 1.0f + var_H;
 }
 
@@ -1130,7 +1130,7 @@ static inline void make_Ych(const float Y, const float c, const float h, dt_alig
 DT_OMP_DECLARE_SIMD(aligned(Ych: 16))
 static inline float get_hue_angle_from_Ych(const dt_aligned_pixel_t Ych)
 {
-  return atan2f(Ych[3], Ych[2]);
+  return dt_fast_atan2f(Ych[3], Ych[2]);
 }
 
 /*
@@ -1304,7 +1304,7 @@ static inline void dt_UCS_LUV_to_JCH(const float L_star, const float L_white, co
   // should be JCH[0] = powf(L_star / L_white), cz) but we treat only the case where cz = 1
   JCH[0] = L_star / L_white;
   JCH[1] = 15.932993652962535f * powf(L_star, 0.6523997524738018f) * powf(M2, 0.6007557017508491f) / L_white;
-  JCH[2] = atan2f(UV_star_prime[1], UV_star_prime[0]);
+  JCH[2] = dt_fast_atan2f(UV_star_prime[1], UV_star_prime[0]);
  }
 
 DT_OMP_DECLARE_SIMD(aligned(xyY, JCH: 16))
@@ -50,6 +50,8 @@
 #include "common/opencl.h"
 #include "common/points.h"
 #include "common/resource_limits.h"
+#include "common/styles.h"
+#include "common/trace.h"
 #include "common/undo.h"
 #include "common/gimp.h"
 #include "common/pfm.h"
@@ -60,8 +62,10 @@
 #include "control/jobs/film_jobs.h"
 #include "control/jobs/sidecar_jobs.h"
 #include "control/signal.h"
+#include "develop/analysis.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
+#include "develop/pixelpipe_cache.h"
 #include "gui/accelerators.h"
 #include "gui/workspace.h"
 #include "gui/gtk.h"
@@ -115,6 +119,10 @@
 #include <sys/varargs.h>
 #endif
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -516,6 +524,10 @@ static inline size_t _get_total_memory()
   }
   fclose(f);
   if(len > 0) free(line);
+  // a memory limit of our cgroup is what we really have
+  size_t limit, usage;
+  dt_get_cgroup_memory(&limit, &usage);
+  if(limit && limit / 1024lu < mem) mem = limit / 1024lu;
   return mem;
 #elif defined(__APPLE__) || defined(__DragonFly__) || defined(__FreeBSD__) || defined(__NetBSD__)            \
     || defined(__OpenBSD__)
@@ -542,6 +554,22 @@ static inline size_t _get_total_memory()
 #endif
 }
 
+static int _get_num_numa_nodes()
+{
+  int nodes = 0;
+#if defined(__linux__)
+  GDir *dir = g_dir_open("/sys/devices/system/node", 0, NULL);
+  if(dir)
+  {
+    const gchar *name;
+    while((name = g_dir_read_name(dir)))
+      if(g_str_has_prefix(name, "node") && g_ascii_isdigit(name[4])) nodes++;
+    g_dir_close(dir);
+  }
+#endif
+  return MAX(nodes, 1);
+}
+
 static size_t _get_mipmap_size()
 {
   dt_sys_resources_t *res = &darktable.dtresources;
@@ -753,6 +781,44 @@ void dt_stop_backthumbs_crawler(const gboolean wait)
   }
 }
 
+// the background database maintenance is checked for this often, in seconds
+#define DT_DB_MAINTENANCE_INTERVAL 300
+
+static guint _db_maintenance_source = 0;
+static gint _db_maintenance_running = 0;
+
+static int32_t _db_maintenance_job_run(dt_job_t *job)
+{
+  // short steps while nobody else needs the database, give up at the
+  // first user activity and try again on the next tick
+  int steps = 0;
+  while(dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED
+        && dt_get_wtime() > darktable.backthumbs.time
+        && dt_control_jobs_pending() <= 1
+        && dt_database_maintenance_step(darktable.db))
+  {
+    steps++;
+    g_usleep(50000);
+  }
+  if(steps)
+    dt_print(DT_DEBUG_SQL, "[db maintenance] %d background steps done", steps);
+  g_atomic_int_set(&_db_maintenance_running, 0);
+  return 0;
+}
+
+static gboolean _db_maintenance_timeout(gpointer data)
+{
+  if(g_atomic_int_compare_and_exchange(&_db_maintenance_running, 0, 1))
+  {
+    dt_job_t *job = dt_control_job_create(&_db_maintenance_job_run, "database maintenance");
+    if(job)
+      dt_control_add_job(DT_JOB_QUEUE_SYSTEM_BG, job);
+    else
+      g_atomic_int_set(&_db_maintenance_running, 0);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
 static char *_get_version_string(void)
 {
   const char *exiv2_version = EXV_PACKAGE_VERSION "\n";
@@ -902,6 +968,13 @@ char *version = g_strdup_printf(
   return version;
 }
 
+// report the duration of a startup phase with -d perf and restart the clock
+static void _init_phase_done(dt_times_t *phase, const char *name)
+{
+  dt_show_times_f(phase, "[dt_init]", "%s", name);
+  dt_get_perf_times(phase);
+}
+
 int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load_data, lua_State *L, const char *applicationdir)
 {
   const double start_wtime = dt_get_wtime();
@@ -942,9 +1015,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   dt_pthread_mutex_init(&darktable.plugin_threadsafe, NULL);
   dt_pthread_mutex_init(&darktable.dev_threadsafe, NULL);
   dt_pthread_mutex_init(&darktable.capabilities_threadsafe, NULL);
-  dt_pthread_mutex_init(&darktable.exiv2_threadsafe, NULL);
+  dt_pthread_mutex_init(&darktable.exiv2_threadsafe, &recursive_locking);
   dt_pthread_mutex_init(&darktable.readFile_mutex, NULL);
   dt_pthread_mutex_init(&darktable.metadata_threadsafe, NULL);
+  dt_pthread_mutex_init(&darktable.import_threadsafe, NULL);
+  dt_pthread_mutex_init(&darktable.iop_init_threadsafe, &recursive_locking);
   darktable.control = calloc(1, sizeof(dt_control_t));
 
   // database
@@ -1496,6 +1571,17 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   omp_set_dynamic(FALSE);
 #endif
 
+  darktable.num_numa_nodes = _get_num_numa_nodes();
+#ifdef _OPENMP
+  // first touch placement only pays off if the threads stay on their
+  // node, the openmp runtime takes the binding from the environment
+  if(darktable.num_numa_nodes > 1 && omp_get_proc_bind() == omp_proc_bind_false)
+    dt_print(DT_DEBUG_ALWAYS,
+             "[dt_init] %d NUMA nodes but openmp threads are not bound,"
+             " set OMP_PLACES=cores and OMP_PROC_BIND=close for better memory bandwidth",
+             darktable.num_numa_nodes);
+#endif
+
 #ifdef USE_LUA
   dt_lua_init_early(L);
 #endif
@@ -1595,6 +1681,10 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   g_slist_free_full(config_override, g_free);
 
+  dt_trace_init();
+  dt_dev_analysis_init();
+  dt_masks_raster_cache_init();
+
   // restore dbname & label (as set in call dt_dbsession_create) to
   // the one selected on the dialog ensuring that if the
   // darktablerc-* is not yet preset we won't store the default
@@ -1609,6 +1699,9 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
     darktable_splash_screen_create(NULL, FALSE);
   }
 
+  dt_times_t phase;
+  dt_get_perf_times(&phase);
+
   // detect cpu features and decide which codepaths to enable
   dt_codepaths_init();
 
@@ -1663,6 +1756,8 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
     return 1;
   }
 
+  _init_phase_done(&phase, "color profiles and library");
+
   darktable_splash_screen_set_progress(_("preparing database"));
   dt_upgrade_maker_model(darktable.db);
 
@@ -1811,6 +1906,8 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   heif_init(NULL);
 #endif
 
+  _init_phase_done(&phase, "tags, control, styles and image libraries");
+
   darktable_splash_screen_set_progress(_("starting OpenCL"));
   darktable.opencl = (dt_opencl_t *)calloc(1, sizeof(dt_opencl_t));
   if(init_gui)
@@ -1818,6 +1915,8 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   else
     dt_opencl_init(darktable.opencl, exclude_opencl, print_statistics);
 
+  _init_phase_done(&phase, "OpenCL");
+
   darktable.points = (dt_points_t *)calloc(1, sizeof(dt_points_t));
   dt_points_init(darktable.points, dt_get_num_threads());
 
@@ -1831,6 +1930,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   dt_image_cache_init();
 
   dt_mipmap_cache_init();
+  dt_dev_pixelpipe_shared_cache_init();
 
   // set up the list of exiv2 metadata
   dt_exif_set_exiv2_taglist();
@@ -1840,6 +1940,8 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   dt_metadata_init();
   dt_pthread_mutex_unlock(&darktable.metadata_threadsafe);
 
+  _init_phase_done(&phase, "noise profiles, caches and metadata");
+
   darktable_splash_screen_set_progress(_("synchronizing local copies"));
   dt_image_local_copy_synch();
 
@@ -1871,6 +1973,9 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
         !dt_gimpmode()
         && dt_get_num_threads() >= 4
         && !(dbfilename_from_command && !strcmp(dbfilename_from_command, ":memory:"));
+
+    _db_maintenance_source =
+      g_timeout_add_seconds(DT_DB_MAINTENANCE_INTERVAL, _db_maintenance_timeout, NULL);
   }
   else
     darktable.gui = NULL;
@@ -1887,9 +1992,12 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
     return 1;
   }
 
+  _init_phase_done(&phase, "local copies, gui and views");
+
   darktable_splash_screen_set_progress(_("loading processing modules"));
   darktable.imageio = (dt_imageio_t *)calloc(1, sizeof(dt_imageio_t));
   dt_imageio_init(darktable.imageio);
+  _init_phase_done(&phase, "imageio modules");
 
   // load default iop order
   darktable.iop_order_list = dt_ioppr_get_iop_order_list(0, FALSE);
@@ -1897,6 +2005,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable.iop_order_rules = dt_ioppr_get_iop_order_rules();
   // load the darkroom mode plugins once:
   dt_iop_load_modules_so();
+  _init_phase_done(&phase, init_gui ? "processing modules" : "processing modules (lazy init)");
   // check if all modules have a iop order assigned
   if(dt_ioppr_check_so_iop_order(darktable.iop, darktable.iop_order_list))
   {
@@ -1929,6 +2038,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
     // init the gui part of views
     darktable_splash_screen_set_progress(_("loading views"));
     dt_view_manager_gui_init(darktable.view_manager);
+    _init_phase_done(&phase, "utility modules and views");
   }
 
 /* init lua last, since it's user made stuff it must be in the real environment */
@@ -1937,6 +2047,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   // after the following Lua startup call, we can no longer use dt_gui_process_events() or we hang;
   // this also means no more calls to darktable_splash_screen_set_progress()
   dt_lua_init(darktable.lua_state.state, lua_command);
+  _init_phase_done(&phase, "Lua");
 #endif
 
   if(init_gui)
@@ -2088,6 +2199,11 @@ void dt_cleanup()
 //    darktable_exit_screen_create(NULL, FALSE);
 
   dt_stop_backthumbs_crawler(TRUE);
+  if(_db_maintenance_source)
+  {
+    g_source_remove(_db_maintenance_source);
+    _db_maintenance_source = 0;
+  }
 
   // last chance to ask user for any input...
 
@@ -2171,6 +2287,8 @@ void dt_cleanup()
 
   dt_image_cache_cleanup();
   dt_mipmap_cache_cleanup();
+  dt_dev_pixelpipe_shared_cache_cleanup();
+  dt_styles_cleanup();
 
   dt_colorspaces_cleanup(darktable.color_profiles);
   dt_conf_cleanup(darktable.conf);
@@ -2187,6 +2305,9 @@ void dt_cleanup()
   dt_opencl_cleanup(darktable.opencl);
   free(darktable.opencl);
   darktable.opencl = NULL;
+  dt_dev_analysis_cleanup();
+  dt_masks_raster_cache_cleanup();
+  dt_trace_cleanup();
 #ifdef HAVE_GPHOTO2
   dt_camctl_destroy((dt_camctl_t *)darktable.camctl);
   darktable.camctl = NULL;
@@ -2262,6 +2383,8 @@ void dt_cleanup()
   dt_pthread_mutex_destroy(&(darktable.exiv2_threadsafe));
   dt_pthread_mutex_destroy(&(darktable.readFile_mutex));
   dt_pthread_mutex_destroy(&(darktable.metadata_threadsafe));
+  dt_pthread_mutex_destroy(&(darktable.import_threadsafe));
+  dt_pthread_mutex_destroy(&(darktable.iop_init_threadsafe));
 
   dt_exif_cleanup();
 
@@ -2315,11 +2438,35 @@ void *dt_alloc_aligned(const size_t size)
   return ((char*)ptr) + alignment ;
 #else
   void *ptr = NULL;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // full image buffers in 2MB pages, faulted in and walked with a fraction
+  // of the tlb misses. freed with plain free() like any other.
+  if(aligned_size >= DT_HUGEPAGE_MIN_SIZE)
+  {
+    const size_t huge_size = dt_round_size(aligned_size, DT_HUGEPAGE_SIZE);
+    if(!posix_memalign(&ptr, DT_HUGEPAGE_SIZE, huge_size))
+    {
+      madvise(ptr, huge_size, MADV_HUGEPAGE);
+      return ptr;
+    }
+  }
+#endif
   if(posix_memalign(&ptr, alignment, aligned_size)) return NULL;
   return ptr;
 #endif
 }
 
+void dt_alloc_first_touch(void *buf, const size_t size)
+{
+  const size_t page = 4096;
+  if(!buf || darktable.num_numa_nodes < 2 || size < 512 * page) return;
+
+  const size_t pages = size / page;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < pages; k++)
+    ((volatile char *)buf)[k * page] = 0;
+}
+
 size_t dt_round_size(const size_t size, const size_t alignment)
 {
   // Round the size of a buffer to the closest higher multiple
@@ -2329,6 +2476,7 @@ size_t dt_round_size(const size_t size, const size_t alignment)
 #ifdef _WIN32
 void dt_free_align(void *mem)
 {
+  if(dt_scratch_pool && dt_scratch_pool_release(mem)) return;
   _aligned_free(mem);
 }
 #elif defined(_DEBUG)
@@ -2336,6 +2484,7 @@ void dt_free_align(void *mem)
 {
   // on a debug build, we deliberately offset the returned pointer
   // from dt_alloc_align, so eliminate the offset
+  if(dt_scratch_pool && dt_scratch_pool_release(mem)) return;
   if(mem)
   {
     short offset = ((short*)mem)[-1];
@@ -2395,6 +2544,31 @@ int dt_worker_threads()
   return wthreads;
 }
 
+/* The memory budget shrinks while the system or our cgroup stalls on memory, so the
+   pipes rather tile than push it into swapping or the oom killer. The scale is a
+   fraction val/1024 and is refreshed at most once per second.
+*/
+static size_t _memory_pressure_scale()
+{
+  static gint last_check = -1;
+  static gint scale = 1024;
+
+  const gint now = g_get_monotonic_time() / G_USEC_PER_SEC;
+  const gint last = g_atomic_int_get(&last_check);
+  if(now != last && g_atomic_int_compare_and_exchange(&last_check, last, now))
+  {
+    // no reduction up to 5% stall time, a quarter of the budget left at 35%
+    const float pressure = dt_get_memory_pressure();
+    const gint new_scale = 1024.0f * CLAMP(1.0f - (pressure - 5.0f) / 40.0f, 0.25f, 1.0f);
+    if(g_atomic_int_get(&scale) != new_scale)
+      dt_print(DT_DEBUG_MEMORY,
+               "[memory pressure] %.1f%% stall time, memory budget scaled to %i/1024",
+               pressure, new_scale);
+    g_atomic_int_set(&scale, new_scale);
+  }
+  return g_atomic_int_get(&scale);
+}
+
 size_t dt_get_available_mem()
 {
   dt_sys_resources_t *res = &darktable.dtresources;
@@ -2403,7 +2577,8 @@ size_t dt_get_available_mem()
     return res->refresource[4*(-level-1)] * DT_MEGA;
 
   const int fraction = res->fractions[4*level];
-  return MAX(512lu * DT_MEGA, res->total_memory / 1024lu * fraction);
+  const size_t budget = res->total_memory / 1024lu * fraction;
+  return MAX(512lu * DT_MEGA, budget / 1024lu * _memory_pressure_scale());
 }
 
 size_t dt_get_singlebuffer_mem()
@@ -2417,6 +2592,43 @@ size_t dt_get_singlebuffer_mem()
   return MAX(2lu * DT_MEGA, res->total_memory / 1024lu * fraction);
 }
 
+size_t dt_get_free_mem()
+{
+#if defined(__linux__)
+  FILE *f = g_fopen("/proc/meminfo", "rb");
+  if(!f) return 0;
+  size_t mem = 0;
+  char *line = NULL;
+  size_t len = 0;
+  while(getline(&line, &len, f) != -1)
+  {
+    if(!strncmp(line, "MemAvailable:", 13))
+    {
+      mem = atol(line + 13) * 1024lu;
+      break;
+    }
+  }
+  fclose(f);
+  if(len > 0) free(line);
+  // within a cgroup the free memory is bounded by its limit
+  size_t limit, usage;
+  dt_get_cgroup_memory(&limit, &usage);
+  if(limit)
+  {
+    const size_t cgroup_free = limit > usage ? limit - usage : 1;
+    mem = mem ? MIN(mem, cgroup_free) : cgroup_free;
+  }
+  return mem;
+#elif defined _WIN32
+  MEMORYSTATUSEX memInfo;
+  memInfo.dwLength = sizeof(MEMORYSTATUSEX);
+  GlobalMemoryStatusEx(&memInfo);
+  return memInfo.ullAvailPhys;
+#else
+  return 0;
+#endif
+}
+
 void dt_configure_runtime_performance(const int old, char *info)
 {
   const size_t threads = dt_get_num_procs();
@@ -2693,6 +2905,32 @@ void dt_print_mem_usage(char *info)
 #endif
 }
 
+size_t dt_get_resident_memory(void)
+{
+#if defined(__linux__)
+  // the second field of statm is the resident set in pages
+  FILE *f = g_fopen("/proc/self/statm", "r");
+  if(!f) return 0;
+  unsigned long pages_total = 0, pages_resident = 0;
+  const int found = fscanf(f, "%lu %lu", &pages_total, &pages_resident);
+  fclose(f);
+  return found == 2 ? (size_t)pages_resident * sysconf(_SC_PAGESIZE) : 0;
+#elif defined(__APPLE__)
+  struct task_basic_info t_info;
+  mach_msg_type_number_t t_info_count = TASK_BASIC_INFO_COUNT;
+  if(KERN_SUCCESS != task_info(mach_task_self(), TASK_BASIC_INFO, (task_info_t)&t_info, &t_info_count))
+    return 0;
+  return t_info.resident_size;
+#elif defined (_WIN32)
+  PROCESS_MEMORY_COUNTERS pmc;
+  if(!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return 0;
+  return pmc.WorkingSetSize;
+#else
+  return 0;
+#endif
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
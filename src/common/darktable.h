@@ -59,6 +59,7 @@
 #include <math.h>
 #include <sqlite3.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -269,6 +270,7 @@ struct dt_control_t;
 struct dt_develop_t;
 struct dt_mipmap_cache_t;
 struct dt_image_cache_t;
+struct dt_dev_pixelpipe_shared_cache_t;
 struct dt_lib_t;
 struct dt_conf_t;
 struct dt_points_t;
@@ -353,6 +355,7 @@ typedef struct darktable_t
 {
   dt_codepath_t codepath;
   int32_t num_openmp_threads;
+  int32_t num_numa_nodes;
 
   int32_t unmuted;
   GList *iop;
@@ -369,6 +372,7 @@ typedef struct darktable_t
   struct dt_gui_gtk_t *gui;
   struct dt_mipmap_cache_t *mipmap_cache;
   struct dt_image_cache_t *image_cache;
+  struct dt_dev_pixelpipe_shared_cache_t *pipe_shared_cache;
   struct dt_bauhaus_t *bauhaus;
   const struct dt_database_t *db;
   const struct dt_pwstorage_t *pwstorage;
@@ -389,6 +393,8 @@ typedef struct darktable_t
   dt_pthread_mutex_t exiv2_threadsafe;
   dt_pthread_mutex_t readFile_mutex;
   dt_pthread_mutex_t metadata_threadsafe;
+  dt_pthread_mutex_t import_threadsafe;
+  dt_pthread_mutex_t iop_init_threadsafe;
   char *progname;
   char *datadir;
   char *sharedir;
@@ -459,6 +465,8 @@ void dt_print_nts_ext(const char *msg, ...)
 int dt_worker_threads();
 size_t dt_get_available_mem();
 size_t dt_get_singlebuffer_mem();
+// memory currently available to new allocations on the host, 0 if unknown
+size_t dt_get_free_mem();
 
 void dt_dump_pfm_file(const char *pipe,
                       const void *data,
@@ -494,8 +502,19 @@ void dt_dump_pipe_diff_pfm(const char *mod,
                           const int ch,
                           const char *pipe);
 
+// buffers from this size on are aligned to and advised for transparent
+// huge pages where supported
+#define DT_HUGEPAGE_SIZE ((size_t)2 << 20)
+#define DT_HUGEPAGE_MIN_SIZE ((size_t)32 << 20)
+
 void *dt_alloc_aligned(const size_t size);
 
+// write to every page of a fresh buffer from the openmp threads with the
+// static schedule of the module loops, so on a multi-socket machine each
+// page lands on the node of the thread that will process it. no-op with a
+// single node and for small buffers.
+void dt_alloc_first_touch(void *buf, const size_t size);
+
 static inline void* dt_calloc_aligned(const size_t size)
 {
   void *buf = dt_alloc_aligned(size);
@@ -549,6 +568,15 @@ static inline gboolean dt_check_aligned(void *addr)
 
 size_t dt_round_size(const size_t size, const size_t alignment);
 
+// scratch buffer pool of the calling thread while an export pipe runs,
+// see dt_scratch_pool_begin() in common/imagebuf.h
+struct dt_scratch_pool_t;
+extern __thread struct dt_scratch_pool_t *dt_scratch_pool;
+// an aligned buffer from the active pool or plain dt_alloc_aligned() without one
+void *dt_scratch_pool_alloc(const size_t size);
+// takes back mem if it came from the active pool, returns FALSE if not
+gboolean dt_scratch_pool_release(void *mem);
+
 #ifdef _WIN32
 void dt_free_align(void *mem);
 #define dt_free_align_ptr dt_free_align
@@ -557,7 +585,11 @@ void dt_free_align(void *mem);
 void dt_free_align(void *mem);
 #define dt_free_align_ptr dt_free_align
 #else
-#define dt_free_align(A) free(A)
+static inline void dt_free_align(void *mem)
+{
+  if(!dt_scratch_pool || !dt_scratch_pool_release(mem))
+    free(mem);
+}
 #define dt_free_align_ptr free
 #endif
 
@@ -724,15 +756,41 @@ static inline int dt_get_thread_num()
 #define DT_INITHASH 5381
 #define DT_INVALID_HASH 0
 typedef uint64_t dt_hash_t;
+static inline uint64_t _dt_hash_round(const uint64_t hash, const uint64_t word)
+{
+  const uint64_t h = hash ^ (word * 0x9e3779b97f4a7c15ull);
+  return ((h << 31) | (h >> 33)) * 0xc2b2ae3d27d4eb4full;
+}
+
 static inline dt_hash_t dt_hash(dt_hash_t hash, const void *data, const size_t size)
 {
-  const uint8_t* str = (uint8_t*)data;
-  // Scramble bits in str to create an (hopefully) unique hash representing the state of str
-  // Dan Bernstein algo v2 http://www.cse.yorku.ca/~oz/hash.html
+  // Scramble bits in data to create an (hopefully) unique hash representing its state.
+  // Consumes 8 bytes per round and finishes with the murmur3 64-bit avalanche,
+  // so every input bit affects all bits of the result.
   // hash should be inited to DT_INITHASH if first run, or from a previous hash computed with this function.
-  for(size_t i = 0; i < size; i++)
-    hash = ((hash << 5) + hash) ^ str[i];
+  // The values are not stable between versions, only store them keyed by
+  // darktable_package_version.
+  const uint8_t *str = (const uint8_t *)data;
+  size_t i = 0;
+  for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+  {
+    uint64_t word;
+    memcpy(&word, str + i, sizeof(word));
+    hash = _dt_hash_round(hash, word);
+  }
+  if(i < size)
+  {
+    uint64_t word = 0;
+    memcpy(&word, str + i, size - i);
+    hash = _dt_hash_round(hash, word);
+  }
 
+  hash ^= size;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
   return hash;
 }
 
@@ -751,7 +809,8 @@ static inline void *dt_alloc_perthread(const size_t n,
   const size_t cache_lines = (alloc_size+DT_CACHELINE_BYTES-1)/DT_CACHELINE_BYTES;
   *padded_size = DT_CACHELINE_BYTES * cache_lines / objsize;
   const size_t total_bytes = DT_CACHELINE_BYTES * cache_lines * dt_get_num_threads();
-  return __builtin_assume_aligned(dt_alloc_aligned(total_bytes), DT_CACHELINE_BYTES);
+  void *buf = dt_scratch_pool ? dt_scratch_pool_alloc(total_bytes) : dt_alloc_aligned(total_bytes);
+  return __builtin_assume_aligned(buf, DT_CACHELINE_BYTES);
 }
 static inline void *dt_calloc_perthread(const size_t n,
                                         const size_t objsize,
@@ -881,6 +940,9 @@ static inline gboolean dt_slist_length_equal(GSList *l1, GSList *l2)
 // checks internally for DT_DEBUG_MEMORY
 void dt_print_mem_usage(char *info);
 
+// resident memory of the process in bytes, 0 if unknown on this platform
+size_t dt_get_resident_memory(void);
+
 // start/stop the backthumbs crawler
 void dt_start_backthumbs_crawler(void);
 void dt_stop_backthumbs_crawler(const gboolean wait);
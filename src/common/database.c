@@ -27,6 +27,7 @@
 #include "common/history.h"
 #include "common/metadata.h"
 #include "common/metadata.h"
+#include "common/trace.h"
 #ifdef HAVE_ICU
 #include "common/sqliteicu.h"
 #endif
@@ -51,11 +52,17 @@
 #define LAST_FULL_DATABASE_VERSION_DATA    10
 
 // You HAVE TO bump THESE versions whenever you add an update branches to _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 57
+#define CURRENT_DATABASE_VERSION_LIBRARY 61
 #define CURRENT_DATABASE_VERSION_DATA    13
 
 #define USE_NESTED_TRANSACTIONS
 #define MAX_NESTED_TRANSACTIONS 5
+
+// background maintenance: pages reclaimed per step, rows sampled per
+// index by ANALYZE and seconds between two statistics refreshes
+#define DT_DATABASE_VACUUM_CHUNK 256
+#define DT_DATABASE_ANALYSIS_LIMIT 400
+#define DT_DATABASE_OPTIMIZE_INTERVAL 3600.0
 /* transaction id */
 static dt_atomic_int _trxid;
 
@@ -72,6 +79,26 @@ typedef struct dt_database_t
   /* ondisk DB */
   sqlite3 *handle;
 
+  /* write-ahead log enabled, read-only connections can run beside handle */
+  gboolean wal;
+
+  /* main.images_fts is usable and kept current by the temp triggers */
+  gboolean text_search;
+
+  /* main.images_geo is usable and kept current by the temp triggers */
+  gboolean geo_index;
+
+  /* idle read-only connections and prepared statements of handle,
+     keyed by their sql to a list of idle copies */
+  dt_pthread_mutex_t pool_mutex;
+  GSList *readers;
+  GHashTable *statements;
+  /* statements of the pool currently handed out */
+  GHashTable *checked_out;
+
+  /* last statistics refresh of the background maintenance */
+  double optimize_time;
+
   gchar *error_message, *error_dbfilename;
   int error_other_pid;
 } dt_database_t;
@@ -83,6 +110,12 @@ static void _database_migrate_to_xdg_structure();
 /* delete old mipmaps files */
 static void _database_delete_mipmaps_files();
 
+/* set up the text search index and its triggers */
+static void _init_text_search(dt_database_t *db);
+
+/* set up the spatial index of the geotagged images and its triggers */
+static void _init_geo_index(dt_database_t *db);
+
 #define _SQLITE3_EXEC(a, b, c, d, e)                                                                         \
   if(sqlite3_exec(a, b, c, d, e) != SQLITE_OK)                                                               \
   {                                                                                                          \
@@ -455,6 +488,121 @@ end:
 // redefine this where needed
 #define FINALIZE
 
+// The history schema is plain sql: the library is also written by other
+// connections (sqlite3 cli, scripts, older builds) which don't know about
+// any function registered by darktable. The blobs are deduplicated through
+// an integer hash with a plain index, the blobs themselves are only
+// compared when the hash matches. A unique index on the blobs would store
+// each of them a second time.
+
+// clang-format off
+// hash of a params blob in plain sql: its length and 14 nibbles sampled
+// evenly over its content, good enough to keep the blob comparisons few
+#define _HISTORY_PARAMS_NIBBLE(blob, i)                                         \
+  "((instr('0123456789ABCDEF',"                                                \
+  " substr(hex(" blob "), 1 + " #i " * length(" blob ") / 7, 1)) - 1) << (4 * " #i "))"
+
+#define _HISTORY_PARAMS_HASH(blob)                                              \
+  "(((length(" blob ") & 127) << 56)"                                          \
+  " | " _HISTORY_PARAMS_NIBBLE(blob, 0) " | " _HISTORY_PARAMS_NIBBLE(blob, 1)  \
+  " | " _HISTORY_PARAMS_NIBBLE(blob, 2) " | " _HISTORY_PARAMS_NIBBLE(blob, 3)  \
+  " | " _HISTORY_PARAMS_NIBBLE(blob, 4) " | " _HISTORY_PARAMS_NIBBLE(blob, 5)  \
+  " | " _HISTORY_PARAMS_NIBBLE(blob, 6) " | " _HISTORY_PARAMS_NIBBLE(blob, 7)  \
+  " | " _HISTORY_PARAMS_NIBBLE(blob, 8) " | " _HISTORY_PARAMS_NIBBLE(blob, 9)  \
+  " | " _HISTORY_PARAMS_NIBBLE(blob, 10) " | " _HISTORY_PARAMS_NIBBLE(blob, 11) \
+  " | " _HISTORY_PARAMS_NIBBLE(blob, 12) " | " _HISTORY_PARAMS_NIBBLE(blob, 13) ")"
+
+// id of a history params blob in history_params, NULL for NULL
+#define _HISTORY_PARAMS_ID(blob)                                                \
+  "(SELECT id FROM history_params"                                             \
+  "  WHERE hash = " _HISTORY_PARAMS_HASH(blob) " AND data = " blob ")"
+
+// store the params blobs of NEW unless they are already there
+#define _HISTORY_PARAMS_STORE                                                   \
+  "  INSERT INTO history_params (hash, data)"                                  \
+  "   SELECT n.hash, n.params"                                                 \
+  "   FROM (SELECT params, " _HISTORY_PARAMS_HASH("params") " AS hash"         \
+  "         FROM (SELECT NEW.op_params AS params"                              \
+  "               UNION SELECT NEW.blendop_params)"                            \
+  "         WHERE params IS NOT NULL) AS n"                                    \
+  "   WHERE NOT EXISTS (SELECT 1 FROM history_params AS p"                     \
+  "                     WHERE p.hash = n.hash AND p.data = n.params);"
+
+#define _HISTORY_PARAMS_TABLE                                                   \
+  " (id INTEGER PRIMARY KEY, hash INTEGER, data BLOB)"
+
+#define _HISTORY_VIEW                                                           \
+  "CREATE VIEW main.history AS"                                                \
+  " SELECT h.imgid AS imgid, h.num AS num, h.module AS module,"                \
+  "        h.operation AS operation, p.data AS op_params, h.enabled AS enabled," \
+  "        b.data AS blendop_params, h.blendop_version AS blendop_version,"    \
+  "        h.multi_priority AS multi_priority, h.multi_name AS multi_name,"    \
+  "        h.multi_name_hand_edited AS multi_name_hand_edited"                 \
+  " FROM history_items AS h"                                                   \
+  " LEFT JOIN history_params AS p ON p.id = h.op_params_id"                    \
+  " LEFT JOIN history_params AS b ON b.id = h.blendop_params_id"
+
+// rows are identified by (imgid, num). renumbering a whole history
+// must go to history_items directly, one row at a time through the
+// view could transiently match two rows.
+#define _HISTORY_INSERT_TRIGGER                                                 \
+  "CREATE TRIGGER main.history_insert INSTEAD OF INSERT ON history"            \
+  " BEGIN"                                                                     \
+  _HISTORY_PARAMS_STORE                                                        \
+  "  INSERT INTO history_items"                                                \
+  "   VALUES (NEW.imgid, NEW.num, NEW.module, NEW.operation,"                  \
+  "           " _HISTORY_PARAMS_ID("NEW.op_params") ", NEW.enabled,"           \
+  "           " _HISTORY_PARAMS_ID("NEW.blendop_params") ", NEW.blendop_version," \
+  "           NEW.multi_priority, NEW.multi_name, NEW.multi_name_hand_edited);" \
+  " END"
+
+#define _HISTORY_UPDATE_TRIGGER                                                 \
+  "CREATE TRIGGER main.history_update INSTEAD OF UPDATE ON history"            \
+  " BEGIN"                                                                     \
+  _HISTORY_PARAMS_STORE                                                        \
+  "  UPDATE history_items"                                                     \
+  "   SET imgid = NEW.imgid, num = NEW.num, module = NEW.module,"              \
+  "       operation = NEW.operation,"                                          \
+  "       op_params_id = " _HISTORY_PARAMS_ID("NEW.op_params") ","             \
+  "       enabled = NEW.enabled,"                                              \
+  "       blendop_params_id = " _HISTORY_PARAMS_ID("NEW.blendop_params") ","   \
+  "       blendop_version = NEW.blendop_version, multi_priority = NEW.multi_priority," \
+  "       multi_name = NEW.multi_name, multi_name_hand_edited = NEW.multi_name_hand_edited" \
+  "   WHERE imgid = OLD.imgid AND num = OLD.num;"                              \
+  " END"
+
+#define _HISTORY_DELETE_TRIGGER                                                 \
+  "CREATE TRIGGER main.history_delete INSTEAD OF DELETE ON history"            \
+  " BEGIN"                                                                     \
+  "  DELETE FROM history_items WHERE imgid = OLD.imgid AND num = OLD.num;"     \
+  " END"
+// clang-format on
+
+// statements end up in the trace once they are done, with their run time
+static int _trace_statement(const unsigned type,
+                            void *ctx,
+                            void *p,
+                            void *x)
+{
+  if(type != SQLITE_TRACE_PROFILE) return 0;
+
+  const double end = dt_get_wtime();
+  const double seconds = 1e-9 * *(const sqlite3_int64 *)x;
+  const char *sql = sqlite3_sql((sqlite3_stmt *)p);
+  char name[96];
+  g_strlcpy(name, sql ? sql : "?", sizeof(name));
+  for(char *c = name; *c; c++)
+    if(g_ascii_isspace(*c)) *c = ' ';
+  dt_trace_span("sqlite", name, DT_TRACE_CPU, end - seconds, end, NULL);
+  return 0;
+}
+
+static void _trace_connection(sqlite3 *handle)
+{
+  if(dt_trace_enabled())
+    sqlite3_trace_v2(handle, SQLITE_TRACE_PROFILE, _trace_statement, NULL);
+}
+
 /* do the real migration steps, returns the version the db was converted to */
 static int _upgrade_library_schema_step(dt_database_t *db,
                                         const int version)
@@ -2967,6 +3115,97 @@ static int _upgrade_library_schema_step(dt_database_t *db,
              "[init] can't add `flash_tagvalue' column to images table in database\n");
     new_version = 57;
   }
+  else if(version == 57)
+  {
+    // the range filters and their min/max lookups
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_exposure_index ON images (exposure)",
+             "can't create index on `exposure'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_aperture_index ON images (aperture)",
+             "can't create index on `aperture'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_iso_index ON images (iso)",
+             "can't create index on `iso'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_focal_length_index ON images (focal_length)",
+             "can't create index on `focal_length'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_lens_id_index ON images (lens_id)",
+             "can't create index on `lens_id'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_import_timestamp_index ON images (import_timestamp)",
+             "can't create index on `import_timestamp'");
+    new_version = 58;
+  }
+  else if(version == 58)
+  {
+    // the params blobs of the history are stored once in history_params,
+    // addressed by their content, and history becomes a view over
+    // history_items. its triggers keep the sql of all readers and
+    // writers unchanged.
+    sqlite3_exec(db->handle, "PRAGMA foreign_keys = OFF", NULL, NULL, NULL);
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+    // clang-format off
+    TRY_EXEC("CREATE TABLE main.history_params" _HISTORY_PARAMS_TABLE,
+             "can't create table `history_params'");
+    TRY_EXEC("INSERT INTO main.history_params (hash, data)"
+             " SELECT " _HISTORY_PARAMS_HASH("params") ", params"
+             " FROM (SELECT op_params AS params FROM main.history WHERE op_params IS NOT NULL"
+             "       UNION"
+             "       SELECT blendop_params FROM main.history WHERE blendop_params IS NOT NULL)",
+             "can't populate table `history_params'");
+    TRY_EXEC("CREATE INDEX main.history_params_hash_index ON history_params (hash)",
+             "can't create index `history_params_hash_index'");
+
+    TRY_EXEC("CREATE TABLE main.history_items"
+             " (imgid INTEGER, num INTEGER, module INTEGER, operation VARCHAR(256),"
+             "  op_params_id INTEGER, enabled INTEGER, blendop_params_id INTEGER,"
+             "  blendop_version INTEGER, multi_priority INTEGER, multi_name VARCHAR(256),"
+             "  multi_name_hand_edited INTEGER,"
+             "  FOREIGN KEY(imgid) REFERENCES images(id) ON UPDATE CASCADE ON DELETE CASCADE)",
+             "can't create table `history_items'");
+    TRY_EXEC("INSERT INTO main.history_items"
+             " SELECT h.imgid, h.num, h.module, h.operation,"
+             "        " _HISTORY_PARAMS_ID("h.op_params") ","
+             "        h.enabled,"
+             "        " _HISTORY_PARAMS_ID("h.blendop_params") ","
+             "        h.blendop_version, h.multi_priority, h.multi_name, h.multi_name_hand_edited"
+             " FROM main.history AS h"
+             " ORDER BY h.rowid",
+             "can't populate table `history_items'");
+
+    TRY_EXEC("DROP TABLE main.history", "can't drop table `history'");
+    TRY_EXEC("CREATE INDEX main.history_imgid_op_index ON history_items (imgid, operation)",
+             "can't create index `history_imgid_op_index'");
+    TRY_EXEC("CREATE INDEX main.history_imgid_num_index ON history_items (imgid, num DESC)",
+             "can't create index `history_imgid_num_index'");
+
+    TRY_EXEC(_HISTORY_VIEW, "can't create view `history'");
+    TRY_EXEC(_HISTORY_INSERT_TRIGGER, "can't create trigger `history_insert'");
+    TRY_EXEC(_HISTORY_UPDATE_TRIGGER, "can't create trigger `history_update'");
+    TRY_EXEC(_HISTORY_DELETE_TRIGGER, "can't create trigger `history_delete'");
+    // clang-format on
+
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    sqlite3_exec(db->handle, "PRAGMA foreign_keys = ON", NULL, NULL, NULL);
+    new_version = 59;
+  }
+  else if(version == 59)
+  {
+    // content fingerprint of the image file, to find files which are
+    // already in the library under another path
+    TRY_EXEC("ALTER TABLE main.images ADD COLUMN fingerprint INTEGER",
+             "can't add `fingerprint' column to images table in database");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_fingerprint_index ON images (fingerprint)",
+             "can't create index on `fingerprint'");
+    new_version = 60;
+  }
+  else if(version == 60)
+  {
+    // deflicker statistics of the raw data, computed once per image
+    // and reused by the exposure module in all pipes
+    TRY_EXEC("CREATE TABLE main.deflicker_stats"
+             " (imgid INTEGER PRIMARY KEY, quantiles BLOB,"
+             "  FOREIGN KEY(imgid) REFERENCES images(id) ON UPDATE CASCADE ON DELETE CASCADE)",
+             "can't create table `deflicker_stats'");
+    new_version = 61;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -3480,6 +3719,14 @@ static void _create_library_schema(dt_database_t *db)
   sqlite3_exec(db->handle,
                "CREATE INDEX main.images_datetime_taken_nc ON images (datetime_taken)",
                NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.images_exposure_index ON images (exposure)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.images_aperture_index ON images (aperture)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.images_iso_index ON images (iso)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.images_focal_length_index ON images (focal_length)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.images_lens_id_index ON images (lens_id)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.images_import_timestamp_index ON images (import_timestamp)",
+               NULL, NULL, NULL);
 
   ////////////////////////////// selected_images
   sqlite3_exec(db->handle,
@@ -4155,6 +4402,33 @@ static void _ask_for_upgrade(const gchar *dbname,
   }
 }
 
+// the -wal and -shm files of filename, a restored or deleted database
+// must not get the log of the old one replayed
+static void _database_unlink_wal(const char *filename)
+{
+  gchar *wal = g_strconcat(filename, "-wal", NULL);
+  gchar *shm = g_strconcat(filename, "-shm", NULL);
+  g_unlink(wal);
+  g_unlink(shm);
+  g_free(wal);
+  g_free(shm);
+}
+
+// move the transactions still in the write-ahead log of filename into
+// the database file itself, so that copying the file copies them too
+static void _database_checkpoint_wal(const char *filename)
+{
+  gchar *wal = g_strconcat(filename, "-wal", NULL);
+  const gboolean has_wal = g_file_test(wal, G_FILE_TEST_EXISTS);
+  g_free(wal);
+  if(!has_wal) return;
+
+  sqlite3 *handle = NULL;
+  if(sqlite3_open_v2(filename, &handle, SQLITE_OPEN_READWRITE, NULL) == SQLITE_OK)
+    sqlite3_exec(handle, "PRAGMA wal_checkpoint(TRUNCATE)", NULL, NULL, NULL);
+  sqlite3_close(handle);
+}
+
 void dt_database_backup(const char *filename)
 {
   char *version = g_strdup(darktable_package_version);
@@ -4180,6 +4454,7 @@ void dt_database_backup(const char *filename)
     gboolean copy_status = TRUE;
     if(g_file_test(filename, G_FILE_TEST_EXISTS))
     {
+      _database_checkpoint_wal(filename);
       copy_status = g_file_copy(src, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, &gerror);
     }
     else
@@ -4334,6 +4609,9 @@ start:
   dt_database_t *db = g_malloc0(sizeof(dt_database_t));
   db->dbfilename_data = g_strdup(dbfilename_data);
   db->dbfilename_library = g_strdup(dbfilename_library);
+  dt_pthread_mutex_init(&db->pool_mutex, NULL);
+  db->statements = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  db->checked_out = g_hash_table_new(NULL, NULL);
 
   dt_atomic_set_int(&_trxid, 0);
 
@@ -4385,10 +4663,15 @@ start:
     g_free(db->dbfilename_data);
     g_free(db->lockfile_library);
     g_free(db->dbfilename_library);
+    g_hash_table_destroy(db->statements);
+    g_hash_table_destroy(db->checked_out);
+    dt_pthread_mutex_destroy(&db->pool_mutex);
     g_free(db);
     return NULL;
   }
 
+  _trace_connection(db->handle);
+
   /* attach a memory database to db connection for use with temporary tables
      used during instance life time, which is discarded on exit.
   */
@@ -4410,10 +4693,32 @@ start:
   }
   sqlite3_finalize(stmt);
 
-  // some sqlite3 config
-  sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  // some sqlite3 config. the page size must be set before switching to
+  // wal, it can't change afterwards.
   sqlite3_exec(db->handle, "PRAGMA page_size = 32768", NULL, NULL, NULL);
+  // free pages are given back in small chunks by the background
+  // maintenance. this applies to new databases, existing ones switch
+  // with their next full vacuum.
+  sqlite3_exec(db->handle, "PRAGMA main.auto_vacuum = INCREMENTAL", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "PRAGMA data.auto_vacuum = INCREMENTAL", NULL, NULL, NULL);
+  if(dt_conf_get_bool("database/write_ahead_log")
+     && g_strcmp0(dbfilename_library, ":memory:")
+     && g_strcmp0(dbfilename_data, ":memory:"))
+  {
+    // readers don't block the writer and the other way round, and a
+    // commit only appends to the log, so the normal sync level is cheap
+    gchar *mode = _get_pragma_string_val(db->handle, "main.journal_mode = WAL");
+    db->wal = !g_strcmp0(mode, "wal");
+    g_free(mode);
+    sqlite3_exec(db->handle, "PRAGMA data.journal_mode = WAL", NULL, NULL, NULL);
+  }
+  if(db->wal)
+    sqlite3_exec(db->handle, "PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+  else
+  {
+    sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
+    sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  }
 
   // WARNING: the foreign_keys pragma must not be used, the integrity of the
   // database rely on it.
@@ -4567,6 +4872,7 @@ start:
       dt_print(DT_DEBUG_ALWAYS, "[init] deleting `%s' on user request: %s",
                dbfilename_data,
                g_unlink(dbfilename_data) == 0 ? "ok" : "failed" );
+      _database_unlink_wal(dbfilename_data);
 
       if(resp == GTK_RESPONSE_ACCEPT && data_snap)
       {
@@ -4739,6 +5045,7 @@ start:
 
     dt_print(DT_DEBUG_ALWAYS, "[init] deleting `%s' on user request ...%s",
       dbfilename_library, g_unlink(dbfilename_library) == 0 ? "OK" : "failed");
+    _database_unlink_wal(dbfilename_library);
 
     if(resp == GTK_RESPONSE_ACCEPT && data_snap)
     {
@@ -4834,12 +5141,319 @@ start:
   }
 #endif
 
+  _init_text_search(db);
+  _init_geo_index(db);
+
 error:
   g_free(dbname);
 
   return db;
 }
 
+// the searchable text of the images which id matches the condition
+#define _TEXT_SEARCH_DOCUMENT(cond)                                                  \
+  "INSERT INTO main.images_fts (rowid, text)"                                        \
+  " SELECT i.id, IFNULL(i.filename, '') || char(31) || IFNULL(fr.folder, '')"        \
+  "              || char(31) || IFNULL(mk.name, '') || char(31) || IFNULL(md.name, '')" \
+  "              || char(31) || IFNULL((SELECT group_concat(value, char(31))"        \
+  "                                     FROM main.meta_data WHERE id = i.id), '')"   \
+  "              || char(31) || IFNULL((SELECT group_concat(t.name || char(31)"      \
+  "                                                || IFNULL(t.synonyms, ''), char(31))" \
+  "                                     FROM main.tagged_images AS ti"              \
+  "                                     JOIN data.tags AS t ON t.id = ti.tagid"     \
+  "                                     WHERE ti.imgid = i.id), '')"               \
+  "  FROM main.images AS i"                                                          \
+  "  LEFT JOIN main.film_rolls AS fr ON fr.id = i.film_id"                           \
+  "  LEFT JOIN main.makers AS mk ON mk.id = i.maker_id"                              \
+  "  LEFT JOIN main.models AS md ON md.id = i.model_id"                              \
+  "  WHERE " cond ";"
+
+#define _TEXT_SEARCH_REFRESH(cond)                                                   \
+  "DELETE FROM main.images_fts WHERE rowid IN (SELECT i.id FROM main.images AS i"    \
+  "                                            WHERE " cond ");"                     \
+  _TEXT_SEARCH_DOCUMENT(cond)
+
+// summary of the data the text search documents are made of: counts,
+// ids and text lengths. other writers of the library (older darktable,
+// scripts) don't run the temporary triggers, a summary differing from
+// the one stored with the sync mark tells the index is stale.
+#define _TEXT_SEARCH_FINGERPRINT                                                     \
+  "SELECT (SELECT count(*) || ':' || total(id) || ':' || total(length(filename))"    \
+  "               || ':' || total(film_id) || ':' || total(maker_id)"                \
+  "               || ':' || total(model_id) || ':' || IFNULL(max(change_timestamp), 0)" \
+  "        FROM main.images)"                                                        \
+  " || '/' || (SELECT count(*) || ':' || total(id) || ':' || total(key)"             \
+  "                   || ':' || total(length(value)) FROM main.meta_data)"           \
+  " || '/' || (SELECT count(*) || ':' || total(imgid) || ':' || total(tagid)"        \
+  "            FROM main.tagged_images)"                                             \
+  " || '/' || (SELECT count(*) || ':' || total(id) || ':' || total(length(name))"    \
+  "                   || ':' || total(length(synonyms)) FROM data.tags)"             \
+  " || '/' || (SELECT count(*) || ':' || total(id) || ':' || total(length(folder))"  \
+  "            FROM main.film_rolls)"
+
+// summary of the positions the geo index is built from, see
+// _TEXT_SEARCH_FINGERPRINT
+#define _GEO_INDEX_FINGERPRINT                                                       \
+  "SELECT count(*) || ':' || total(id) || ':' || total(longitude)"                   \
+  "       || ':' || total(latitude)"                                                 \
+  " FROM main.images WHERE longitude IS NOT NULL AND latitude IS NOT NULL"
+
+// the fingerprint of an index computed by query
+static gchar *_index_fingerprint(const dt_database_t *db,
+                                 const char *query)
+{
+  gchar *fingerprint = NULL;
+  sqlite3_stmt *stmt;
+  if(sqlite3_prepare_v2(db->handle, query, -1, &stmt, NULL) == SQLITE_OK
+     && sqlite3_step(stmt) == SQLITE_ROW)
+    fingerprint = g_strdup((const char *)sqlite3_column_text(stmt, 0));
+  sqlite3_finalize(stmt);
+  return fingerprint;
+}
+
+// is the index of the db_info key in sync with the tables it is built from?
+static gboolean _index_synced(const dt_database_t *db,
+                              const char *key,
+                              const char *fingerprint)
+{
+  gboolean synced = FALSE;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db->handle,
+                     "SELECT value FROM main.db_info WHERE key = ?1",
+                     -1, &stmt, NULL);
+  sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  if(fingerprint && sqlite3_step(stmt) == SQLITE_ROW)
+    synced = !g_strcmp0((const char *)sqlite3_column_text(stmt, 0), fingerprint);
+  sqlite3_finalize(stmt);
+  return synced;
+}
+
+static gboolean _index_mark_synced(const dt_database_t *db,
+                                   const char *key,
+                                   const char *fingerprint)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db->handle,
+                     "INSERT OR REPLACE INTO main.db_info (key, value) VALUES (?1, ?2)",
+                     -1, &stmt, NULL);
+  sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(stmt, 2, fingerprint, -1, SQLITE_TRANSIENT);
+  const gboolean ok = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+  return ok;
+}
+
+// the triggers kept the indexes in sync during the session, record the
+// fingerprints of the tables as they are left
+static void _index_mark_session_end(const dt_database_t *db)
+{
+  if(db->text_search)
+  {
+    gchar *fingerprint = _index_fingerprint(db, _TEXT_SEARCH_FINGERPRINT);
+    if(fingerprint) _index_mark_synced(db, "text_search", fingerprint);
+    g_free(fingerprint);
+  }
+  if(db->geo_index)
+  {
+    gchar *fingerprint = _index_fingerprint(db, _GEO_INDEX_FINGERPRINT);
+    if(fingerprint) _index_mark_synced(db, "geo_index", fingerprint);
+    g_free(fingerprint);
+  }
+}
+
+// one trigram document per image for the text search filter. the tags
+// are in the data database, so the triggers are temporary ones created
+// for every session, which may reference both. the sync mark in db_info
+// holds the fingerprint of the tables, a session without fts5 clears it,
+// and any write outside of darktable changes the fingerprint, the next
+// session with fts5 then rebuilds.
+static void _init_text_search(dt_database_t *db)
+{
+  if(sqlite3_exec(db->handle,
+                  "CREATE VIRTUAL TABLE IF NOT EXISTS main.images_fts"
+                  " USING fts5(text, tokenize = 'trigram')",
+                  NULL, NULL, NULL) != SQLITE_OK)
+  {
+    dt_print(DT_DEBUG_SQL, "[init] no fts5 trigram support, text search scans the tables");
+    sqlite3_exec(db->handle, "DELETE FROM main.db_info WHERE key = 'text_search'",
+                 NULL, NULL, NULL);
+    return;
+  }
+
+  gchar *fingerprint = _index_fingerprint(db, _TEXT_SEARCH_FINGERPRINT);
+  const gboolean synced = _index_synced(db, "text_search", fingerprint);
+
+  if(!synced)
+  {
+    const double start = dt_get_wtime();
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    const gboolean ok =
+      fingerprint
+      && sqlite3_exec(db->handle, "DELETE FROM main.images_fts", NULL, NULL, NULL) == SQLITE_OK
+      && sqlite3_exec(db->handle, _TEXT_SEARCH_DOCUMENT("1"), NULL, NULL, NULL) == SQLITE_OK
+      && _index_mark_synced(db, "text_search", fingerprint);
+    sqlite3_exec(db->handle, ok ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+    g_free(fingerprint);
+    if(!ok)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[init] can't build the text search index: %s",
+               sqlite3_errmsg(db->handle));
+      return;
+    }
+    dt_print(DT_DEBUG_SQL, "[init] text search index built in %.3fs", dt_get_wtime() - start);
+  }
+  else
+    g_free(fingerprint);
+
+  // clang-format off
+  const char *triggers[] =
+  {
+    "CREATE TEMP TRIGGER images_fts_insert AFTER INSERT ON main.images"
+    " BEGIN " _TEXT_SEARCH_DOCUMENT("i.id = NEW.id") " END",
+
+    "CREATE TEMP TRIGGER images_fts_update AFTER UPDATE OF filename, film_id, maker_id, model_id"
+    " ON main.images"
+    " WHEN NEW.filename IS NOT OLD.filename OR NEW.film_id IS NOT OLD.film_id"
+    "   OR NEW.maker_id IS NOT OLD.maker_id OR NEW.model_id IS NOT OLD.model_id"
+    " BEGIN " _TEXT_SEARCH_REFRESH("i.id = NEW.id") " END",
+
+    "CREATE TEMP TRIGGER images_fts_delete AFTER DELETE ON main.images"
+    " BEGIN DELETE FROM main.images_fts WHERE rowid = OLD.id; END",
+
+    "CREATE TEMP TRIGGER meta_data_fts_insert AFTER INSERT ON main.meta_data"
+    " BEGIN " _TEXT_SEARCH_REFRESH("i.id = NEW.id") " END",
+
+    "CREATE TEMP TRIGGER meta_data_fts_update AFTER UPDATE ON main.meta_data"
+    " BEGIN " _TEXT_SEARCH_REFRESH("i.id IN (OLD.id, NEW.id)") " END",
+
+    "CREATE TEMP TRIGGER meta_data_fts_delete AFTER DELETE ON main.meta_data"
+    " BEGIN " _TEXT_SEARCH_REFRESH("i.id = OLD.id") " END",
+
+    "CREATE TEMP TRIGGER tagged_images_fts_insert AFTER INSERT ON main.tagged_images"
+    " BEGIN " _TEXT_SEARCH_REFRESH("i.id = NEW.imgid") " END",
+
+    "CREATE TEMP TRIGGER tagged_images_fts_delete AFTER DELETE ON main.tagged_images"
+    " BEGIN " _TEXT_SEARCH_REFRESH("i.id = OLD.imgid") " END",
+
+    "CREATE TEMP TRIGGER tags_fts_update AFTER UPDATE OF name, synonyms ON data.tags"
+    " BEGIN " _TEXT_SEARCH_REFRESH("i.id IN (SELECT imgid FROM main.tagged_images"
+                                   "         WHERE tagid = NEW.id)") " END",
+
+    "CREATE TEMP TRIGGER film_rolls_fts_update AFTER UPDATE OF folder ON main.film_rolls"
+    " BEGIN " _TEXT_SEARCH_REFRESH("i.film_id = NEW.id") " END",
+  };
+  // clang-format on
+
+  for(size_t k = 0; k < G_N_ELEMENTS(triggers); k++)
+    if(sqlite3_exec(db->handle, triggers[k], NULL, NULL, NULL) != SQLITE_OK)
+    {
+      // without all triggers the index would go stale, drop the sync mark
+      dt_print(DT_DEBUG_ALWAYS, "[init] can't create text search trigger: %s",
+               sqlite3_errmsg(db->handle));
+      sqlite3_exec(db->handle, "DELETE FROM main.db_info WHERE key = 'text_search'",
+                   NULL, NULL, NULL);
+      return;
+    }
+
+  db->text_search = TRUE;
+}
+
+gboolean dt_database_has_text_search(const dt_database_t *db)
+{
+  return db && db->text_search;
+}
+
+#define _GEO_INDEX_ENTRY(img)                                                        \
+  "INSERT OR REPLACE INTO main.images_geo (id, min_lon, max_lon, min_lat, max_lat)"             \
+  " SELECT " img ".id, " img ".longitude, " img ".longitude,"                        \
+  "        " img ".latitude, " img ".latitude"
+
+// an r*tree over the positions of the geotagged images for the map view.
+// the coordinates are stored as 32bit floats rounded outwards, so the
+// index only narrows the bounding box scan, the exact test stays on
+// main.images. kept in sync the same way as the text search index,
+// with temporary triggers and a fingerprinted sync mark.
+static void _init_geo_index(dt_database_t *db)
+{
+  if(sqlite3_exec(db->handle,
+                  "CREATE VIRTUAL TABLE IF NOT EXISTS main.images_geo"
+                  " USING rtree(id, min_lon, max_lon, min_lat, max_lat)",
+                  NULL, NULL, NULL) != SQLITE_OK)
+  {
+    dt_print(DT_DEBUG_SQL, "[init] no r*tree support, the map scans the images");
+    sqlite3_exec(db->handle, "DELETE FROM main.db_info WHERE key = 'geo_index'",
+                 NULL, NULL, NULL);
+    return;
+  }
+
+  gchar *fingerprint = _index_fingerprint(db, _GEO_INDEX_FINGERPRINT);
+  const gboolean synced = _index_synced(db, "geo_index", fingerprint);
+
+  if(!synced)
+  {
+    const double start = dt_get_wtime();
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    const gboolean ok =
+      fingerprint
+      && sqlite3_exec(db->handle, "DELETE FROM main.images_geo", NULL, NULL, NULL) == SQLITE_OK
+      && sqlite3_exec(db->handle,
+                      _GEO_INDEX_ENTRY("i") " FROM main.images AS i"
+                      " WHERE i.longitude IS NOT NULL AND i.latitude IS NOT NULL",
+                      NULL, NULL, NULL) == SQLITE_OK
+      && _index_mark_synced(db, "geo_index", fingerprint);
+    sqlite3_exec(db->handle, ok ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+    g_free(fingerprint);
+    if(!ok)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[init] can't build the geo index: %s",
+               sqlite3_errmsg(db->handle));
+      return;
+    }
+    dt_print(DT_DEBUG_SQL, "[init] geo index built in %.3fs", dt_get_wtime() - start);
+  }
+  else
+    g_free(fingerprint);
+
+  // clang-format off
+  const char *triggers[] =
+  {
+    "CREATE TEMP TRIGGER images_geo_insert AFTER INSERT ON main.images"
+    " WHEN NEW.longitude IS NOT NULL AND NEW.latitude IS NOT NULL"
+    " BEGIN " _GEO_INDEX_ENTRY("NEW") "; END",
+
+    "CREATE TEMP TRIGGER images_geo_update AFTER UPDATE OF id, longitude, latitude"
+    " ON main.images"
+    " WHEN NEW.id IS NOT OLD.id"
+    "   OR NEW.longitude IS NOT OLD.longitude OR NEW.latitude IS NOT OLD.latitude"
+    " BEGIN"
+    "  DELETE FROM main.images_geo WHERE id = OLD.id;"
+    "  " _GEO_INDEX_ENTRY("NEW")
+    "   WHERE NEW.longitude IS NOT NULL AND NEW.latitude IS NOT NULL;"
+    " END",
+
+    "CREATE TEMP TRIGGER images_geo_delete AFTER DELETE ON main.images"
+    " BEGIN DELETE FROM main.images_geo WHERE id = OLD.id; END",
+  };
+  // clang-format on
+
+  for(size_t k = 0; k < G_N_ELEMENTS(triggers); k++)
+    if(sqlite3_exec(db->handle, triggers[k], NULL, NULL, NULL) != SQLITE_OK)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[init] can't create geo index trigger: %s",
+               sqlite3_errmsg(db->handle));
+      sqlite3_exec(db->handle, "DELETE FROM main.db_info WHERE key = 'geo_index'",
+                   NULL, NULL, NULL);
+      return;
+    }
+
+  db->geo_index = TRUE;
+}
+
+gboolean dt_database_has_geo_index(const dt_database_t *db)
+{
+  return db && db->geo_index;
+}
+
 void dt_upgrade_maker_model(const dt_database_t *db)
 {
   sqlite3_stmt *stmt;
@@ -4878,8 +5492,110 @@ void dt_upgrade_maker_model(const dt_database_t *db)
   sqlite3_finalize(stmt);
 }
 
+static void _database_pool_clear(const dt_database_t *db)
+{
+  dt_database_t *pool = (dt_database_t *)db;
+  dt_pthread_mutex_lock(&pool->pool_mutex);
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, pool->statements);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+    g_slist_free_full(value, (GDestroyNotify)sqlite3_finalize);
+  g_hash_table_remove_all(pool->statements);
+  g_slist_free_full(pool->readers, (GDestroyNotify)sqlite3_close);
+  pool->readers = NULL;
+  dt_pthread_mutex_unlock(&pool->pool_mutex);
+}
+
+sqlite3_stmt *dt_database_prepare_cached(const dt_database_t *db,
+                                         const char *sql)
+{
+  dt_database_t *pool = (dt_database_t *)db;
+  sqlite3_stmt *stmt = NULL;
+  dt_pthread_mutex_lock(&pool->pool_mutex);
+  GSList *idle = g_hash_table_lookup(pool->statements, sql);
+  if(idle)
+  {
+    stmt = idle->data;
+    g_hash_table_insert(pool->statements, g_strdup(sql), g_slist_delete_link(idle, idle));
+  }
+  else
+    DT_DEBUG_SQLITE3_PREPARE_V2(db->handle, sql, -1, &stmt, NULL);
+  if(stmt) g_hash_table_add(pool->checked_out, stmt);
+  dt_pthread_mutex_unlock(&pool->pool_mutex);
+
+  return stmt;
+}
+
+void dt_database_release_cached(const dt_database_t *db,
+                                sqlite3_stmt *stmt)
+{
+  if(!stmt) return;
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  dt_database_t *pool = (dt_database_t *)db;
+  dt_pthread_mutex_lock(&pool->pool_mutex);
+  g_hash_table_remove(pool->checked_out, stmt);
+  const char *sql = sqlite3_sql(stmt);
+  GSList *idle = g_hash_table_lookup(pool->statements, sql);
+  g_hash_table_insert(pool->statements, g_strdup(sql), g_slist_prepend(idle, stmt));
+  dt_pthread_mutex_unlock(&pool->pool_mutex);
+}
+
+sqlite3 *dt_database_reader_acquire(const dt_database_t *db)
+{
+  if(!db->wal) return db->handle;
+
+  dt_database_t *pool = (dt_database_t *)db;
+  sqlite3 *handle = NULL;
+  dt_pthread_mutex_lock(&pool->pool_mutex);
+  if(pool->readers)
+  {
+    handle = pool->readers->data;
+    pool->readers = g_slist_delete_link(pool->readers, pool->readers);
+  }
+  dt_pthread_mutex_unlock(&pool->pool_mutex);
+  if(handle) return handle;
+
+  if(sqlite3_open_v2(db->dbfilename_library, &handle, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+  {
+    sqlite3_close(handle);
+    return db->handle;
+  }
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(handle, "ATTACH DATABASE ?1 AS data", -1, &stmt, NULL);
+  sqlite3_bind_text(stmt, 1, db->dbfilename_data, -1, SQLITE_TRANSIENT);
+  const gboolean attached = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+  if(!attached)
+  {
+    sqlite3_close(handle);
+    return db->handle;
+  }
+  _trace_connection(handle);
+  dt_print(DT_DEBUG_SQL, "[db reader] opened a read-only connection");
+  return handle;
+}
+
+void dt_database_reader_release(const dt_database_t *db,
+                                sqlite3 *handle)
+{
+  if(!handle || handle == db->handle) return;
+
+  dt_database_t *pool = (dt_database_t *)db;
+  dt_pthread_mutex_lock(&pool->pool_mutex);
+  pool->readers = g_slist_prepend(pool->readers, handle);
+  dt_pthread_mutex_unlock(&pool->pool_mutex);
+}
+
 void dt_database_destroy(const dt_database_t *db)
 {
+  _index_mark_session_end(db);
+  _database_pool_clear(db);
+  g_hash_table_destroy(db->statements);
+  g_hash_table_destroy(db->checked_out);
+  dt_pthread_mutex_destroy(&((dt_database_t *)db)->pool_mutex);
   sqlite3_close(db->handle);
   if(db->lockfile_data)
   {
@@ -4965,21 +5681,47 @@ gboolean dt_database_get_lock_acquired(const dt_database_t *db)
 
 void dt_database_cleanup_busy_statements(const dt_database_t *db)
 {
-  sqlite3_stmt *stmt = NULL;
-  while( (stmt = sqlite3_next_stmt(db->handle, NULL)) != NULL)
+  _database_pool_clear(db);
+
+  // statements handed out by the pool are still owned by their caller
+  dt_database_t *pool = (dt_database_t *)db;
+  dt_pthread_mutex_lock(&pool->pool_mutex);
+  sqlite3_stmt *stmt = sqlite3_next_stmt(db->handle, NULL);
+  while(stmt)
   {
-    const char* sql = sqlite3_sql(stmt);
-    if(sqlite3_stmt_busy(stmt))
+    sqlite3_stmt *next = sqlite3_next_stmt(db->handle, stmt);
+    if(!g_hash_table_contains(pool->checked_out, stmt))
     {
-      dt_print(DT_DEBUG_SQL,
-               "[db busy stmt] non-finalized nor stepped through statement: '%s'",sql);
-      sqlite3_reset(stmt);
-    }
-    else {
-      dt_print(DT_DEBUG_SQL, "[db busy stmt] non-finalized statement: '%s'",sql);
+      const char* sql = sqlite3_sql(stmt);
+      if(sqlite3_stmt_busy(stmt))
+      {
+        dt_print(DT_DEBUG_SQL,
+                 "[db busy stmt] non-finalized nor stepped through statement: '%s'",sql);
+        sqlite3_reset(stmt);
+      }
+      else {
+        dt_print(DT_DEBUG_SQL, "[db busy stmt] non-finalized statement: '%s'",sql);
+      }
+      sqlite3_finalize(stmt);
     }
-    sqlite3_finalize(stmt);
+    stmt = next;
   }
+  dt_pthread_mutex_unlock(&pool->pool_mutex);
+}
+
+// drop the params blobs no history item refers to anymore
+static void _purge_history_params(const dt_database_t *db)
+{
+  // clang-format off
+  DT_DEBUG_SQLITE3_EXEC(db->handle,
+                        "DELETE FROM main.history_params"
+                        " WHERE id NOT IN (SELECT op_params_id FROM main.history_items"
+                        "                  WHERE op_params_id IS NOT NULL"
+                        "                  UNION"
+                        "                  SELECT blendop_params_id FROM main.history_items"
+                        "                  WHERE blendop_params_id IS NOT NULL)",
+                        NULL, NULL, NULL);
+  // clang-format on
 }
 
 #define ERRCHECK {if(err!=NULL) {dt_print(DT_DEBUG_SQL, "[db maintenance] maintenance error: '%s'",err); sqlite3_free(err); err=NULL;}}
@@ -4995,6 +5737,8 @@ void dt_database_perform_maintenance(const dt_database_t *db)
 
   const guint64 calc_pre_size = (main_pre_free_count*main_page_size) + (data_pre_free_count*data_page_size);
 
+  _purge_history_params(db);
+
   if(calc_pre_size == 0)
   {
     dt_print(DT_DEBUG_SQL,
@@ -5008,6 +5752,12 @@ void dt_database_perform_maintenance(const dt_database_t *db)
     return;
   }
 
+  // the vacuum also switches older databases to incremental mode, the
+  // background maintenance keeps them compact from then on
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA main.auto_vacuum = INCREMENTAL", NULL, NULL, &err);
+  ERRCHECK
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA data.auto_vacuum = INCREMENTAL", NULL, NULL, &err);
+  ERRCHECK
   DT_DEBUG_SQLITE3_EXEC(db->handle, "VACUUM data", NULL, NULL, &err);
   ERRCHECK
   DT_DEBUG_SQLITE3_EXEC(db->handle, "VACUUM main", NULL, NULL, &err);
@@ -5047,11 +5797,27 @@ static inline gboolean _is_mem_db(const dt_database_t *db)
   return !g_strcmp0(db->dbfilename_data, ":memory:") || !g_strcmp0(db->dbfilename_library, ":memory:");
 }
 
+// auto_vacuum mode of a schema, 2 is incremental
+static inline gboolean _is_incremental(const dt_database_t *db,
+                                       const char *schema)
+{
+  gchar *pragma = g_strdup_printf("%s.auto_vacuum", schema);
+  const int mode = _get_pragma_int_val(db->handle, pragma);
+  g_free(pragma);
+  return mode == 2;
+}
+
 gboolean dt_database_maybe_maintenance(const dt_database_t *db)
 {
   if(_is_mem_db(db))
     return FALSE;
 
+  // the free pages of incremental databases are reclaimed in the background
+  if(dt_conf_get_bool("database/background_maintenance")
+     && _is_incremental(db, "main")
+     && _is_incremental(db, "data"))
+    return FALSE;
+
   // checking free pages
   const int main_free_count = _get_pragma_int_val(db->handle, "main.freelist_count");
   const int main_page_count = _get_pragma_int_val(db->handle, "main.page_count");
@@ -5100,9 +5866,47 @@ void dt_database_optimize(const dt_database_t *db)
   // optimize should in most cases be no-op and have no noticeable downsides
   // this should be ran on every exit
   // see: https://www.sqlite.org/pragma.html#pragma_optimize
+  // the analysis limit keeps the statistics sampled on big libraries
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA analysis_limit = " G_STRINGIFY(DT_DATABASE_ANALYSIS_LIMIT),
+                        NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA optimize", NULL, NULL, NULL);
 }
 
+gboolean dt_database_maintenance_step(dt_database_t *db)
+{
+  if(_is_mem_db(db) || !dt_conf_get_bool("database/background_maintenance"))
+    return FALSE;
+
+  static const char *schemas[] = { "main", "data", NULL };
+  for(const char **schema = schemas; *schema; schema++)
+  {
+    gchar *pragma = g_strdup_printf("%s.freelist_count", *schema);
+    const int free_count = _get_pragma_int_val(db->handle, pragma);
+    g_free(pragma);
+
+    if(free_count > 0 && _is_incremental(db, *schema))
+    {
+      gchar *query = g_strdup_printf("PRAGMA %s.incremental_vacuum(%d)",
+                                     *schema, DT_DATABASE_VACUUM_CHUNK);
+      DT_DEBUG_SQLITE3_EXEC(db->handle, query, NULL, NULL, NULL);
+      g_free(query);
+      dt_print(DT_DEBUG_SQL, "[db maintenance] %s: %d free pages left",
+               *schema, MAX(0, free_count - DT_DATABASE_VACUUM_CHUNK));
+      return TRUE;
+    }
+  }
+
+  const double now = dt_get_wtime();
+  if(now - db->optimize_time > DT_DATABASE_OPTIMIZE_INTERVAL)
+  {
+    db->optimize_time = now;
+    _purge_history_params(db);
+    dt_database_optimize(db);
+    dt_print(DT_DEBUG_SQL, "[db maintenance] statistics refreshed");
+  }
+  return FALSE;
+}
+
 static void _print_backup_progress(int remaining, int total)
 {
   // TODO if we have closing splashpage - this can be used to advance progressbar :)
@@ -45,6 +45,9 @@ void dt_database_optimize(const struct dt_database_t *);
 /** conditionally perfrom db maintenance */
 gboolean dt_database_maybe_maintenance(const struct dt_database_t *db);
 void dt_database_perform_maintenance(const struct dt_database_t *db);
+/** one short step of the background maintenance: gives back a chunk of free
+    pages or refreshes the statistics. returns TRUE while there is more to do */
+gboolean dt_database_maintenance_step(struct dt_database_t *db);
 /** cleanup busy statements on closing dt, just before performing maintenance */
 void dt_database_cleanup_busy_statements(const struct dt_database_t *db);
 /** simply create db snapshot of both library and data */
@@ -57,6 +60,29 @@ char **dt_database_snaps_to_remove(const struct dt_database_t *db);
 gchar *dt_database_get_most_recent_snap(const char* db_filename);
 
 int32_t dt_database_last_insert_rowid(const struct dt_database_t *);
+
+/** main.images_fts holds the searchable text of every image, one trigram
+ * document of filename, folder, maker, model, metadata and tags */
+gboolean dt_database_has_text_search(const struct dt_database_t *db);
+
+/** main.images_geo is an r*tree over the positions of the geotagged images */
+gboolean dt_database_has_geo_index(const struct dt_database_t *db);
+
+/** a prepared statement for a constant sql string, reused instead of parsed
+ * again. give it back with dt_database_release_cached() instead of
+ * sqlite3_finalize(), it is then reset and its bindings cleared. */
+struct sqlite3_stmt *dt_database_prepare_cached(const struct dt_database_t *db,
+                                                const char *sql);
+void dt_database_release_cached(const struct dt_database_t *db,
+                                struct sqlite3_stmt *stmt);
+
+/** a read-only connection to the library and data databases for long
+ * queries of background threads, so they don't hold the main handle. it
+ * has no memory database and no custom functions. without write-ahead
+ * log this is the main handle. */
+struct sqlite3 *dt_database_reader_acquire(const struct dt_database_t *db);
+void dt_database_reader_release(const struct dt_database_t *db,
+                                struct sqlite3 *handle);
 // nested transactions support
 
 void dt_database_start_transaction(const struct dt_database_t *db);
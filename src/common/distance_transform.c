@@ -148,6 +148,94 @@ float dt_image_distance_transform(float *const src,
   return max_distance;
 }
 
+#ifdef HAVE_OPENCL
+dt_distance_transform_cl_global_t *dt_distance_transform_init_cl_global()
+{
+  dt_distance_transform_cl_global_t *g = malloc(sizeof(*g));
+  const int program = 47; // distance_transform.cl, from programs.conf
+  g->kernel_distance_transform_columns = dt_opencl_create_kernel(program, "distance_transform_columns");
+  g->kernel_distance_transform_rows = dt_opencl_create_kernel(program, "distance_transform_rows");
+  g->kernel_distance_transform_output = dt_opencl_create_kernel(program, "distance_transform_output");
+  return g;
+}
+
+void dt_distance_transform_free_cl_global(dt_distance_transform_cl_global_t *g)
+{
+  if(!g) return;
+  dt_opencl_free_kernel(g->kernel_distance_transform_columns);
+  dt_opencl_free_kernel(g->kernel_distance_transform_rows);
+  dt_opencl_free_kernel(g->kernel_distance_transform_output);
+  free(g);
+}
+
+cl_int dt_image_distance_transform_cl(const int devid,
+                                      cl_mem dev_in,
+                                      cl_mem dev_out,
+                                      const int width,
+                                      const int height,
+                                      const int scale,
+                                      const float clip,
+                                      const dt_distance_transform_t mode,
+                                      float *max_distance)
+{
+  if(max_distance) *max_distance = 0.0f;
+  if(mode != DT_DISTANCE_TRANSFORM_NONE && mode != DT_DISTANCE_TRANSFORM_MASK)
+  {
+    dt_print(DT_DEBUG_ALWAYS,"[dt_image_distance_transform_cl] called with unsupported mode %i", mode);
+    return DT_OPENCL_DEFAULT_ERROR;
+  }
+
+  const dt_distance_transform_cl_global_t *const g = darktable.opencl->distance_transform;
+  const int imode = mode;
+  const int cscale = MAX(1, scale);
+  const int cwidth = (width + cscale - 1) / cscale;
+  const int cheight = (height + cscale - 1) / cscale;
+  // the parabola scratch of the column pass is strided by cwidth, that of the row pass by cwidth + 1
+  const size_t scratch = (size_t)cwidth * cheight + MAX(cwidth, cheight);
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  float *rowmax = dt_alloc_align_float(cheight);
+  cl_mem dev_dist = dt_opencl_alloc_device_buffer(devid, sizeof(float) * cwidth * cheight);
+  cl_mem dev_z = dt_opencl_alloc_device_buffer(devid, sizeof(float) * scratch);
+  cl_mem dev_v = dt_opencl_alloc_device_buffer(devid, sizeof(int) * scratch);
+  cl_mem dev_g = dt_opencl_alloc_device_buffer(devid, sizeof(float) * scratch);
+  cl_mem dev_rowmax = dt_opencl_alloc_device_buffer(devid, sizeof(float) * cheight);
+  if(!rowmax || !dev_dist || !dev_z || !dev_v || !dev_g || !dev_rowmax) goto cleanup;
+
+  err = dt_opencl_enqueue_kernel_1d_args(devid, g->kernel_distance_transform_columns, cwidth,
+          CLARG(dev_in), CLARG(dev_dist), CLARG(dev_z), CLARG(dev_v), CLARG(dev_g),
+          CLARG(width), CLARG(height), CLARG(cwidth), CLARG(cheight), CLARG(cscale), CLARG(clip), CLARG(imode));
+  if(err != CL_SUCCESS) goto cleanup;
+
+  err = dt_opencl_enqueue_kernel_1d_args(devid, g->kernel_distance_transform_rows, cheight,
+          CLARG(dev_dist), CLARG(dev_z), CLARG(dev_v), CLARG(dev_g), CLARG(dev_rowmax),
+          CLARG(cwidth), CLARG(cheight), CLARG(cscale));
+  if(err != CL_SUCCESS) goto cleanup;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, g->kernel_distance_transform_output, width, height,
+          CLARG(dev_dist), CLARG(dev_out), CLARG(width), CLARG(height),
+          CLARG(cwidth), CLARG(cheight), CLARG(cscale));
+  if(err != CL_SUCCESS || !max_distance) goto cleanup;
+
+  err = dt_opencl_read_buffer_from_device(devid, rowmax, dev_rowmax, 0, sizeof(float) * cheight, TRUE);
+  if(err != CL_SUCCESS) goto cleanup;
+
+  float dmax = 0.0f;
+  for(int y = 0; y < cheight; y++)
+    dmax = fmaxf(dmax, rowmax[y]);
+  *max_distance = dmax;
+
+cleanup:
+  dt_opencl_release_mem_object(dev_dist);
+  dt_opencl_release_mem_object(dev_z);
+  dt_opencl_release_mem_object(dev_v);
+  dt_opencl_release_mem_object(dev_g);
+  dt_opencl_release_mem_object(dev_rowmax);
+  dt_free_align(rowmax);
+  return err;
+}
+#endif
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
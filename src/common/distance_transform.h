@@ -16,6 +16,10 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#pragma once
+
+#include "common/opencl.h"
+
 typedef enum dt_distance_transform_t
 {
   DT_DISTANCE_TRANSFORM_NONE = 0,
@@ -25,6 +29,32 @@ typedef enum dt_distance_transform_t
 #define DT_DISTANCE_TRANSFORM_MAX (1e20)
 float dt_image_distance_transform(float *const src, float *const out, const size_t width, const size_t height, const float clip, const dt_distance_transform_t mode);
 
+#ifdef HAVE_OPENCL
+typedef struct dt_distance_transform_cl_global_t
+{
+  int kernel_distance_transform_columns;
+  int kernel_distance_transform_rows;
+  int kernel_distance_transform_output;
+} dt_distance_transform_cl_global_t;
+
+dt_distance_transform_cl_global_t *dt_distance_transform_init_cl_global(void);
+void dt_distance_transform_free_cl_global(dt_distance_transform_cl_global_t *g);
+
+/* the OpenCL version of dt_image_distance_transform() from the 1-ch image dev_in into dev_out,
+   which may be the same image. With scale > 1 the transform runs on a grid downscaled by that
+   factor and is upsampled bilinearly afterwards, an approximation good enough for preview pipes.
+   The maximum distance is returned in max_distance if that is not NULL. */
+cl_int dt_image_distance_transform_cl(const int devid,
+                                      cl_mem dev_in,
+                                      cl_mem dev_out,
+                                      const int width,
+                                      const int height,
+                                      const int scale,
+                                      const float clip,
+                                      const dt_distance_transform_t mode,
+                                      float *max_distance);
+#endif
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -162,6 +162,7 @@ dt_dlopencl_t *dt_dlopencl_init(const char *name)
     success = success && dt_gmodule_symbol(module, "clEnqueueCopyBufferToImage",
                                            (void (**)(void)) & ocl->symbols->dt_clEnqueueCopyBufferToImage);
     success = success && dt_gmodule_symbol(module, "clFinish", (void (**)(void)) & ocl->symbols->dt_clFinish);
+    success = success && dt_gmodule_symbol(module, "clFlush", (void (**)(void)) & ocl->symbols->dt_clFlush);
     success = success && dt_gmodule_symbol(module, "clEnqueueReadBuffer",
                                            (void (**)(void)) & ocl->symbols->dt_clEnqueueReadBuffer);
     success = success && dt_gmodule_symbol(module, "clReleaseMemObject",
@@ -204,6 +205,8 @@ dt_dlopencl_t *dt_dlopencl_init(const char *name)
                                            (void (**)(void)) & ocl->symbols->dt_clGetMemObjectInfo);
     success = success && dt_gmodule_symbol(module, "clGetImageInfo",
                                            ((void (**)(void)) & ocl->symbols->dt_clGetImageInfo));
+    success = success && dt_gmodule_symbol(module, "clGetSupportedImageFormats",
+                                           ((void (**)(void)) & ocl->symbols->dt_clGetSupportedImageFormats));
   }
 
   ocl->have_opencl = success;
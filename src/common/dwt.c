@@ -533,6 +533,8 @@ dt_dwt_cl_global_t *dt_dwt_init_cl_global()
   g->kernel_dwt_hat_transform_col = dt_opencl_create_kernel(program, "dwt_hat_transform_col");
   g->kernel_dwt_hat_transform_row = dt_opencl_create_kernel(program, "dwt_hat_transform_row");
   g->kernel_dwt_init_buffer = dt_opencl_create_kernel(program, "dwt_init_buffer");
+  g->kernel_dwt_denoise_vert_1ch = dt_opencl_create_kernel(program, "dwt_denoise_vert_1ch");
+  g->kernel_dwt_denoise_horiz_1ch = dt_opencl_create_kernel(program, "dwt_denoise_horiz_1ch");
   return g;
 }
 
@@ -546,6 +548,8 @@ void dt_dwt_free_cl_global(dt_dwt_cl_global_t *g)
   dt_opencl_free_kernel(g->kernel_dwt_hat_transform_col);
   dt_opencl_free_kernel(g->kernel_dwt_hat_transform_row);
   dt_opencl_free_kernel(g->kernel_dwt_init_buffer);
+  dt_opencl_free_kernel(g->kernel_dwt_denoise_vert_1ch);
+  dt_opencl_free_kernel(g->kernel_dwt_denoise_horiz_1ch);
 
   free(g);
 }
@@ -874,6 +878,46 @@ cl_int dwt_decompose_cl(dwt_params_cl_t *p, _dwt_layer_func_cl layer_func)
   return dwt_wavelet_decompose_cl(p->image, p, layer_func);
 }
 
+cl_int dwt_denoise_cl(const int devid,
+                      cl_mem img,
+                      const int width,
+                      const int height,
+                      const int bands,
+                      const float *const noise)
+{
+  const dt_dwt_cl_global_t *const g = darktable.opencl->dwt;
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  const size_t size = sizeof(float) * width * height;
+  cl_mem accum = dt_opencl_alloc_device_buffer(devid, size);
+  cl_mem interm = dt_opencl_alloc_device_buffer(devid, size);
+  if(accum == NULL || interm == NULL) goto cleanup;
+
+  err = CL_SUCCESS;
+  for(int lev = 0; lev < bands; lev++)
+  {
+    const int first = lev == 0;
+    const int last = (lev+1) == bands;
+    const int vscale = MIN(1 << lev, height);
+    const int hscale = MIN(1 << lev, width);
+    const float thold = noise[lev];
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, g->kernel_dwt_denoise_vert_1ch, width, height,
+      CLARG(interm), CLARG(img), CLARG(width), CLARG(height), CLARG(vscale));
+    if(err != CL_SUCCESS) goto cleanup;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, g->kernel_dwt_denoise_horiz_1ch, width, height,
+      CLARG(interm), CLARG(img), CLARG(accum), CLARG(width), CLARG(height), CLARG(hscale),
+      CLARG(thold), CLARG(first), CLARG(last));
+    if(err != CL_SUCCESS) goto cleanup;
+  }
+
+cleanup:
+  dt_opencl_release_mem_object(accum);
+  dt_opencl_release_mem_object(interm);
+  return err;
+}
+
 #endif
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
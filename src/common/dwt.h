@@ -107,6 +107,8 @@ typedef struct dt_dwt_cl_global_t
   int kernel_dwt_hat_transform_col;
   int kernel_dwt_hat_transform_row;
   int kernel_dwt_init_buffer;
+  int kernel_dwt_denoise_vert_1ch;
+  int kernel_dwt_denoise_horiz_1ch;
 } dt_dwt_cl_global_t;
 
 typedef struct dwt_params_cl_t
@@ -140,6 +142,10 @@ int dt_dwt_first_scale_visible_cl(dwt_params_cl_t *p);
 
 cl_int dwt_decompose_cl(dwt_params_cl_t *p, _dwt_layer_func_cl layer_func);
 
+/* GPU version of dwt_denoise() on a single channel buffer */
+cl_int dwt_denoise_cl(const int devid, cl_mem img, const int width, const int height,
+                      const int bands, const float *const noise);
+
 #endif
 
 #endif
@@ -22,6 +22,7 @@
 #include <errno.h>
 #include <exiv2/types.hpp>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <sqlite3.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -35,8 +36,10 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <list>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 
 // avoid error reported when including exiv2.hpp on macOS (XCode 15.2)
 #pragma GCC diagnostic push
@@ -79,6 +82,8 @@ using namespace std;
 #include "imageio/imageio_jpeg.h"
 
 #define DT_XMP_EXIF_VERSION 5
+// layout of the binary history packet in Xmp.darktable.history_packet
+#define DT_XMP_HISTORY_PACKET_VERSION 1
 
 #if EXIV2_TEST_VERSION(0,28,0)
 #define AnyError Error
@@ -375,11 +380,14 @@ static const char *_exif_get_exiv2_tag_type(const char *tagname)
   return NULL;
 }
 
-// Exiv2's readMetadata is not thread safe in 0.26. So we lock it.
-// Since readMetadata might throw an exception we wrap it into
+// Since 0.27 Exiv2 reads separate images concurrently, only its XMP
+// toolkit is not thread safe. That one is serialized by the lock given
+// to Exiv2::XmpParser::initialize() in dt_exif_init(), so parallel reads
+// only wait for each other while parsing XMP packets. Writing keeps the
+// global lock, which is recursive for the XMP lock to nest in it.
+// Since writeMetadata might throw an exception we wrap it into
 // some C++ magic to make sure we unlock in all cases. Well, actually
 // not magic but basic RAII.
-// FIXME: Check again once we rely on 0.27.
 class Lock
 {
 public:
@@ -389,7 +397,6 @@ public:
 
 #define read_metadata_threadsafe(image)                       \
 {                                                             \
-  Lock lock;                                                  \
   image->readMetadata();                                      \
 }
 
@@ -399,6 +406,171 @@ public:
   image->writeMetadata();                                     \
 }
 
+// The files opened last are kept mapped and parsed for a little while:
+// importing reads the metadata, checks the embedded preview for mono
+// content, extracts it for the thumbnail and may then decode the raw,
+// each of which used to open and parse the file again.
+#define DT_EXIF_FILES_KEPT 4
+#define DT_EXIF_FILES_TIMEOUT 30.0
+
+typedef struct _exif_file_t
+{
+  std::string path;
+  time_t mtime;
+  goffset size;
+  GMappedFile *map;
+  std::unique_ptr<Exiv2::Image> image;
+  double last_used;
+} _exif_file_t;
+
+// the files not in use, most recently used first. A file in use is
+// taken out of the list so that its exiv2 image is never shared.
+static std::list<_exif_file_t *> _exif_files;
+static dt_pthread_mutex_t _exif_files_lock;
+
+static void _exif_file_free(_exif_file_t *file)
+{
+  file->image.reset();
+  g_mapped_file_unref(file->map);
+  delete file;
+}
+
+static inline gboolean _exif_file_matches(const _exif_file_t *file,
+                                          const char *path,
+                                          const GStatBuf *st)
+{
+  return file->mtime == st->st_mtime
+    && file->size == (goffset)st->st_size
+    && file->path == path;
+}
+
+// called with _exif_files_lock held
+static void _exif_files_expire(const double now)
+{
+  for(auto it = _exif_files.begin(); it != _exif_files.end();)
+  {
+    if(now - (*it)->last_used > DT_EXIF_FILES_TIMEOUT)
+    {
+      _exif_file_free(*it);
+      it = _exif_files.erase(it);
+    }
+    else
+      ++it;
+  }
+}
+
+// take the parsed file out of the list or open it. returns NULL if it
+// can't be mapped, callers then let exiv2 read it the usual way.
+static _exif_file_t *_exif_file_open(const char *path)
+{
+  GStatBuf st;
+  if(!dt_conf_get_bool("raw_loader_mmap") || g_stat(path, &st) || st.st_size <= 0)
+    return NULL;
+
+  _exif_file_t *file = NULL;
+  dt_pthread_mutex_lock(&_exif_files_lock);
+  _exif_files_expire(dt_get_wtime());
+  for(auto it = _exif_files.begin(); it != _exif_files.end(); ++it)
+  {
+    if(_exif_file_matches(*it, path, &st))
+    {
+      file = *it;
+      _exif_files.erase(it);
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&_exif_files_lock);
+  if(file) return file;
+
+  GMappedFile *map = g_mapped_file_new(path, FALSE, NULL);
+  if(!map) return NULL;
+
+  file = new _exif_file_t();
+  file->path = path;
+  file->mtime = st.st_mtime;
+  file->size = st.st_size;
+  file->map = map;
+  try
+  {
+    // exiv2 reads the mapping in place, it is only copied on write
+    file->image = std::unique_ptr<Exiv2::Image>(Exiv2::ImageFactory::open
+      ((const Exiv2::byte *)g_mapped_file_get_contents(map), g_mapped_file_get_length(map)));
+    assert(file->image.get() != 0);
+    read_metadata_threadsafe(file->image);
+  }
+  catch(...)
+  {
+    _exif_file_free(file);
+    throw;
+  }
+  return file;
+}
+
+static void _exif_file_release(_exif_file_t *file)
+{
+  file->last_used = dt_get_wtime();
+  dt_pthread_mutex_lock(&_exif_files_lock);
+  _exif_files.push_front(file);
+  while(_exif_files.size() > DT_EXIF_FILES_KEPT)
+  {
+    _exif_file_free(_exif_files.back());
+    _exif_files.pop_back();
+  }
+  dt_pthread_mutex_unlock(&_exif_files_lock);
+}
+
+// an exiv2 image with its metadata read, shared with the other readers
+// of the same file when possible
+class ExifFile
+{
+public:
+  explicit ExifFile(const char *path) : file(_exif_file_open(path))
+  {
+    if(!file)
+    {
+      own = std::unique_ptr<Exiv2::Image>(Exiv2::ImageFactory::open(WIDEN(path)));
+      assert(own.get() != 0);
+      read_metadata_threadsafe(own);
+    }
+  }
+  ~ExifFile() { if(file) _exif_file_release(file); }
+  ExifFile(const ExifFile &) = delete;
+  ExifFile &operator=(const ExifFile &) = delete;
+  Exiv2::Image *get() const { return file ? file->image.get() : own.get(); }
+
+private:
+  _exif_file_t *file;
+  std::unique_ptr<Exiv2::Image> own;
+};
+
+GMappedFile *dt_exif_get_mapped_file(const char *path)
+{
+  GStatBuf st;
+  if(g_stat(path, &st)) return NULL;
+
+  GMappedFile *map = NULL;
+  dt_pthread_mutex_lock(&_exif_files_lock);
+  for(const _exif_file_t *file : _exif_files)
+  {
+    if(_exif_file_matches(file, path, &st))
+    {
+      map = g_mapped_file_ref(file->map);
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&_exif_files_lock);
+  return map;
+}
+
+void dt_exif_release_files(void)
+{
+  dt_pthread_mutex_lock(&_exif_files_lock);
+  for(_exif_file_t *file : _exif_files)
+    _exif_file_free(file);
+  _exif_files.clear();
+  dt_pthread_mutex_unlock(&_exif_files_lock);
+}
+
 static void _exif_import_tags(dt_image_t *img, Exiv2::XmpData::iterator &pos);
 
 static void _read_xmp_timestamps(Exiv2::XmpData &xmpData,
@@ -431,7 +603,7 @@ const char *dt_xmp_keys[]
         "Xmp.darktable.change_timestamp",     "Xmp.darktable.export_timestamp",
         "Xmp.darktable.print_timestamp",      "Xmp.darktable.version_name",
         "Xmp.darktable.harmony_guide_type",   "Xmp.darktable.harmony_guide_rotation",
-        "Xmp.darktable.harmony_guide_width" };
+        "Xmp.darktable.harmony_guide_width",  "Xmp.darktable.history_packet" };
 
 // The number of XmpBag XmpSeq keys that dt uses
 static const guint dt_xmp_keys_n = G_N_ELEMENTS(dt_xmp_keys);
@@ -858,14 +1030,54 @@ static bool _exif_decode_iptc_data(dt_image_t *img,
   }
 }
 
+// Exiv2::ExifData::findKey() is a linear scan building the key string
+// of every datum it passes. With the maker notes of a raw file that is
+// thousands of strings for each of the ~100 tags we look for, so while
+// decoding the tags are indexed by key once. Scopes nest, an inner one
+// on the same data reuses the outer index.
+struct _exif_index_t
+{
+  explicit _exif_index_t(const Exiv2::ExifData &exifData);
+  ~_exif_index_t();
+
+  const Exiv2::ExifData *data;
+  _exif_index_t *outer;
+  std::unordered_map<std::string, Exiv2::ExifData::const_iterator> tags;
+};
+
+static thread_local _exif_index_t *_exif_index = nullptr;
+
+_exif_index_t::_exif_index_t(const Exiv2::ExifData &exifData)
+  : data(&exifData), outer(_exif_index)
+{
+  if(outer && outer->data == data) return;
+  tags.reserve(exifData.count());
+  // emplace() keeps the first datum of a key, as findKey() does
+  for(auto it = exifData.begin(); it != exifData.end(); ++it)
+    tags.emplace(it->key(), it);
+  _exif_index = this;
+}
+
+_exif_index_t::~_exif_index_t()
+{
+  if(_exif_index == this) _exif_index = outer;
+}
+
 static bool _exif_read_exif_tag(Exiv2::ExifData &exifData,
                                 Exiv2::ExifData::const_iterator *pos,
                                 string key)
 {
   try
   {
-    return (*pos = exifData.findKey(Exiv2::ExifKey(key)))
-      != exifData.end() && (*pos)->size();
+    const Exiv2::ExifKey exifkey(key);
+    if(_exif_index && _exif_index->data == &exifData)
+    {
+      const auto it = _exif_index->tags.find(exifkey.key());
+      *pos = it != _exif_index->tags.end() ? it->second : exifData.end();
+    }
+    else
+      *pos = exifData.findKey(exifkey);
+    return *pos != exifData.end() && (*pos)->size();
   }
   catch(const Exiv2::AnyError &e)
   {
@@ -1268,12 +1480,12 @@ void dt_exif_img_check_additional_tags(dt_image_t *img,
 {
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(filename)));
-    assert(image.get() != 0);
-    read_metadata_threadsafe(image);
+    const ExifFile file(filename);
+    Exiv2::Image *image = file.get();
     Exiv2::ExifData &exifData = image->exifData();
     if(!exifData.empty())
     {
+      const _exif_index_t index(exifData);
       _check_usercrop(exifData, img);
       _check_dng_opcodes(exifData, img);
       _check_lens_correction_data(exifData, img);
@@ -1387,6 +1599,7 @@ static bool _exif_decode_exif_data(dt_image_t *img, Exiv2::ExifData &exifData)
 {
   try
   {
+    const _exif_index_t index(exifData);
     // List of tag names taken from Exiv2's printSummary() in actions.cpp
     Exiv2::ExifData::const_iterator pos;
 
@@ -1590,7 +1803,9 @@ static bool _exif_decode_exif_data(dt_image_t *img, Exiv2::ExifData &exifData)
       }
     }
 
-    if(_check_usercrop(exifData, img))
+    // an image which is not in the library (dt_exif_read_metadata_only())
+    // must not get the tag, dt_tag_attach() would use the act-on images
+    if(_check_usercrop(exifData, img) && dt_is_valid_imgid(img->id))
     {
       img->flags |= DT_IMAGE_HAS_ADDITIONAL_EXIF_TAGS;
       guint tagid = 0;
@@ -2462,9 +2677,8 @@ gboolean dt_exif_get_thumbnail(const char *path,
 {
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
-    assert(image.get() != 0);
-    read_metadata_threadsafe(image);
+    const ExifFile file(path);
+    Exiv2::Image *image = file.get();
 
     // Get a list of preview images available in the image. The list is sorted
     // by the preview image pixel size, starting with the smallest preview.
@@ -2533,52 +2747,114 @@ gboolean dt_exif_read(dt_image_t *img,
 
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
+    bool res = true;
+    bool check_mono = false;
+    {
+      const ExifFile file(path);
+      Exiv2::Image *image = file.get();
+
+      // EXIF metadata
+      Exiv2::ExifData &exifData = image->exifData();
+      if(!exifData.empty())
+      {
+        res = _exif_decode_exif_data(img, exifData);
+        check_mono = dt_conf_get_bool("ui/detect_mono_exif");
+      }
+      else
+        img->exif_inited = TRUE;
+
+      // These get overwritten by IPTC and XMP. Is that how it should work?
+      dt_exif_apply_default_metadata(img);
+
+      // IPTC metadata.
+      Exiv2::IptcData &iptcData = image->iptcData();
+      if(!iptcData.empty()) res = _exif_decode_iptc_data(img, iptcData) && res;
+
+      // XMP metadata.
+      Exiv2::XmpData &xmpData = image->xmpData();
+      if(!xmpData.empty())
+        res = _exif_decode_xmp_data(img, xmpData, -1, true) && res;
+
+      // Initialize size - don't wait for full raw to be loaded to get this
+      // information. If use_embedded_thumbnail is set, it will take a
+      // change in development history to have this information.
+      img->height = image->pixelHeight();
+      img->width = image->pixelWidth();
+    }
+
+    // done once the file is released, the preview reuses it
+    if(check_mono)
+    {
+      const int oldflags =
+        dt_image_monochrome_flags(img)
+        | (img->flags & DT_IMAGE_MONOCHROME_WORKFLOW);
+      if(dt_imageio_has_mono_preview(path))
+        img->flags |= (DT_IMAGE_MONOCHROME_PREVIEW
+                       | DT_IMAGE_MONOCHROME_WORKFLOW);
+      else
+        img->flags &= ~(DT_IMAGE_MONOCHROME_PREVIEW
+                        | DT_IMAGE_MONOCHROME_WORKFLOW);
+
+      if(oldflags != (dt_image_monochrome_flags(img)
+                      | (img->flags & DT_IMAGE_MONOCHROME_WORKFLOW)))
+        dt_imageio_update_monochrome_workflow_tag(img->id,
+                                                  dt_image_monochrome_flags(img));
+    }
+
+    return res ? FALSE : TRUE;
+  }
+  catch(const Exiv2::AnyError &e)
+  {
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[exiv2 dt_exif_read] %s: %s",
+             path,
+             e.what());
+    return TRUE;
+  }
+}
+
+gboolean dt_exif_read_from_buffer(dt_image_t *img,
+                                  const uint8_t *data,
+                                  const size_t size)
+{
+  if(!img || !data || size == 0)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[dt_exif_read_from_buffer] invalid parameters");
+    return TRUE;
+  }
+
+  try
+  {
+    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(data, size));
     assert(image.get() != 0);
     read_metadata_threadsafe(image);
     bool res = true;
 
-    // EXIF metadata
+    // EXIF metadata, including the tags not cached in the database
+    // which dt_exif_img_check_additional_tags() reads from a file
     Exiv2::ExifData &exifData = image->exifData();
     if(!exifData.empty())
     {
+      const _exif_index_t index(exifData);
       res = _exif_decode_exif_data(img, exifData);
-      if(dt_conf_get_bool("ui/detect_mono_exif"))
-      {
-        const int oldflags =
-          dt_image_monochrome_flags(img)
-          | (img->flags & DT_IMAGE_MONOCHROME_WORKFLOW);
-        if(dt_imageio_has_mono_preview(path))
-          img->flags |= (DT_IMAGE_MONOCHROME_PREVIEW
-                         | DT_IMAGE_MONOCHROME_WORKFLOW);
-        else
-          img->flags &= ~(DT_IMAGE_MONOCHROME_PREVIEW
-                          | DT_IMAGE_MONOCHROME_WORKFLOW);
-
-        if(oldflags != (dt_image_monochrome_flags(img)
-                        | (img->flags & DT_IMAGE_MONOCHROME_WORKFLOW)))
-          dt_imageio_update_monochrome_workflow_tag(img->id,
-                                                    dt_image_monochrome_flags(img));
-      }
+      _check_usercrop(exifData, img);
+      _check_dng_opcodes(exifData, img);
+      _check_lens_correction_data(exifData, img);
+      _check_linear_response_limit(exifData, img);
+      _check_highlight_preservation(exifData, img);
     }
     else
       img->exif_inited = TRUE;
 
-    // These get overwritten by IPTC and XMP. Is that how it should work?
     dt_exif_apply_default_metadata(img);
 
-    // IPTC metadata.
     Exiv2::IptcData &iptcData = image->iptcData();
     if(!iptcData.empty()) res = _exif_decode_iptc_data(img, iptcData) && res;
 
-    // XMP metadata.
     Exiv2::XmpData &xmpData = image->xmpData();
     if(!xmpData.empty())
       res = _exif_decode_xmp_data(img, xmpData, -1, true) && res;
 
-    // Initialize size - don't wait for full raw to be loaded to get this
-    // information. If use_embedded_thumbnail is set, it will take a
-    // change in development history to have this information.
     img->height = image->pixelHeight();
     img->width = image->pixelWidth();
 
@@ -2587,13 +2863,57 @@ gboolean dt_exif_read(dt_image_t *img,
   catch(const Exiv2::AnyError &e)
   {
     dt_print(DT_DEBUG_IMAGEIO,
-             "[exiv2 dt_exif_read] %s: %s",
-             path,
+             "[exiv2 dt_exif_read_from_buffer] %s: %s",
+             img->filename,
              e.what());
     return TRUE;
   }
 }
 
+gboolean dt_exif_read_metadata_only(dt_image_t *img,
+                                    const char *path)
+{
+  GError *error = NULL;
+  GMappedFile *file = g_mapped_file_new(path, FALSE, &error);
+  if(!file)
+  {
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[exiv2 dt_exif_read_metadata_only] %s: %s",
+             path, error->message);
+    g_error_free(error);
+    return TRUE;
+  }
+
+  // exiv2 reads the mapped file in place, so only the pages holding
+  // the metadata, usually at the start of the file, are ever read
+  const uint8_t *data = (const uint8_t *)g_mapped_file_get_contents(file);
+  const size_t size = g_mapped_file_get_length(file);
+  gboolean res = TRUE;
+  try
+  {
+    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(data, size));
+    assert(image.get() != 0);
+    read_metadata_threadsafe(image);
+
+    Exiv2::ExifData &exifData = image->exifData();
+    if(!exifData.empty())
+      res = _exif_decode_exif_data(img, exifData) ? FALSE : TRUE;
+
+    img->height = image->pixelHeight();
+    img->width = image->pixelWidth();
+  }
+  catch(const Exiv2::AnyError &e)
+  {
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[exiv2 dt_exif_read_metadata_only] %s: %s",
+             path, e.what());
+    res = TRUE;
+  }
+
+  g_mapped_file_unref(file);
+  return res;
+}
+
 int dt_exif_write_blob(uint8_t *blob,
                        uint32_t size,
                        const char *path,
@@ -3872,6 +4192,151 @@ skip:
   return history_entries;
 }
 
+/* The history packet holds the masks and the history stack of a
+   sidecar as one compressed binary entry, so reading it does not need
+   to walk the XMP arrays of every history item. All values are int32,
+   strings and blobs are stored as length followed by the bytes:
+
+   packet version
+   number of masks, then for each mask:
+     num, id, type, version, nb, name, points, source
+   number of history items, then for each item:
+     num, modversion, enabled, multi_priority, multi_name_hand_edited,
+     blendop_version, operation, multi_name, params, blendop params
+*/
+typedef struct dt_history_packet_t
+{
+  const unsigned char *pos;
+  const unsigned char *end;
+  gboolean ok;
+} dt_history_packet_t;
+
+static int32_t _packet_get_int(dt_history_packet_t *p)
+{
+  int32_t v = 0;
+  if(p->end - p->pos < (ptrdiff_t)sizeof(v))
+    p->ok = FALSE;
+  else
+  {
+    memcpy(&v, p->pos, sizeof(v));
+    p->pos += sizeof(v);
+  }
+  return v;
+}
+
+static unsigned char *_packet_get_blob(dt_history_packet_t *p,
+                                       int *len)
+{
+  const int32_t n = _packet_get_int(p);
+  *len = 0;
+  if(n < 0 || n > p->end - p->pos)
+  {
+    p->ok = FALSE;
+    return NULL;
+  }
+  if(!p->ok || n == 0) return NULL;
+
+  unsigned char *blob = (unsigned char *)malloc(n);
+  if(!blob)
+  {
+    p->ok = FALSE;
+    return NULL;
+  }
+  memcpy(blob, p->pos, n);
+  p->pos += n;
+  *len = n;
+  return blob;
+}
+
+static char *_packet_get_string(dt_history_packet_t *p)
+{
+  int len = 0;
+  unsigned char *blob = _packet_get_blob(p, &len);
+  char *str = g_strndup((const char *)blob, len);
+  free(blob);
+  return str;
+}
+
+// reads the masks and the history stack from a history packet,
+// returns FALSE if it is malformed
+static gboolean _read_history_packet(const std::string &value,
+                                     const char *filename,
+                                     const int version,
+                                     GList **history_entries,
+                                     GList **mask_entries)
+{
+  int len = 0;
+  unsigned char *data = dt_exif_xmp_decode(value.c_str(), value.size(), &len);
+  if(!data) return FALSE;
+
+  dt_history_packet_t p = { data, data + len, TRUE };
+  GList *masks = NULL;
+  GList *history = NULL;
+
+  if(_packet_get_int(&p) != DT_XMP_HISTORY_PACKET_VERSION)
+    p.ok = FALSE;
+
+  const int32_t num_masks = _packet_get_int(&p);
+  for(int32_t k = 0; p.ok && k < num_masks; k++)
+  {
+    mask_entry_t *entry = (mask_entry_t *)calloc(1, sizeof(mask_entry_t));
+    if(!entry)
+    {
+      p.ok = FALSE;
+      break;
+    }
+    masks = g_list_prepend(masks, entry);
+    entry->version = version;
+    entry->mask_num = _packet_get_int(&p);
+    entry->mask_id = _packet_get_int(&p);
+    entry->mask_type = _packet_get_int(&p);
+    entry->mask_version = _packet_get_int(&p);
+    entry->mask_nb = _packet_get_int(&p);
+    entry->mask_name = _packet_get_string(&p);
+    entry->mask_points = _packet_get_blob(&p, &entry->mask_points_len);
+    entry->mask_src = _packet_get_blob(&p, &entry->mask_src_len);
+  }
+
+  const int32_t num_history = _packet_get_int(&p);
+  for(int32_t k = 0; p.ok && k < num_history; k++)
+  {
+    history_entry_t *entry = (history_entry_t *)calloc(1, sizeof(history_entry_t));
+    if(!entry)
+    {
+      p.ok = FALSE;
+      break;
+    }
+    history = g_list_prepend(history, entry);
+    entry->iop_order = -1.0;
+    entry->num = _packet_get_int(&p);
+    entry->modversion = _packet_get_int(&p);
+    entry->enabled = _packet_get_int(&p) == 1;
+    entry->multi_priority = _packet_get_int(&p);
+    entry->multi_name_hand_edited = _packet_get_int(&p) == 1;
+    entry->blendop_version = _packet_get_int(&p);
+    entry->operation = _packet_get_string(&p);
+    entry->multi_name = _packet_get_string(&p);
+    entry->params = _packet_get_blob(&p, &entry->params_len);
+    entry->blendop_params = _packet_get_blob(&p, &entry->blendop_params_len);
+    entry->have_operation = entry->have_params = entry->have_modversion = TRUE;
+  }
+  free(data);
+
+  if(!p.ok)
+  {
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[exif] error: reading history packet from '%s' failed",
+             filename);
+    g_list_free_full(masks, _free_mask_entry);
+    g_list_free_full(history, _free_history_entry);
+    return FALSE;
+  }
+
+  *mask_entries = g_list_reverse(masks);
+  *history_entries = g_list_reverse(history);
+  return TRUE;
+}
+
 static void _add_mask_entry_to_db(const dt_imgid_t imgid,
                                   mask_entry_t *entry)
 {
@@ -3997,23 +4462,20 @@ static gboolean _image_altered_deprecated(const dt_imgid_t imgid)
   return altered;
 }
 
-// Need a write lock on *img (non-const) to write stars (and soon color labels).
-gboolean dt_exif_xmp_read(dt_image_t *img,
-                          const char *filename,
-                          const gboolean history_only)
+// reads the XMP packet from data if given, otherwise from the sidecar
+// filename. filename is then only used for messages.
+static gboolean _exif_xmp_read(dt_image_t *img,
+                               const char *filename,
+                               const uint8_t *data,
+                               const size_t size,
+                               const gboolean history_only)
 {
-  if(!img)
-  {
-    dt_print(DT_DEBUG_ALWAYS, "[dt_exif_xmp_read] failed as no img was provided for '%s'", filename);
-    return TRUE;
-  }
-  // Exclude pfm to avoid stupid errors on the console
-  const char *c = filename + strlen(filename) - 4;
-  if(c >= filename && !strcmp(c, ".pfm")) return TRUE;
   try
   {
     // Read XMP sidecar
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(filename)));
+    std::unique_ptr<Exiv2::Image> image(data
+                                        ? Exiv2::ImageFactory::open(data, size)
+                                        : Exiv2::ImageFactory::open(WIDEN(filename)));
     assert(image.get() != 0);
     read_metadata_threadsafe(image);
     Exiv2::XmpData &xmpData = image->xmpData();
@@ -4134,11 +4596,20 @@ gboolean dt_exif_xmp_read(dt_image_t *img,
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
+    // A compact history packet replaces the history and mask arrays
+    GList *packet_entries = NULL;
+    const gboolean has_packet =
+      xmp_version >= 3
+      && (pos = xmpData.findKey(Exiv2::XmpKey("Xmp.darktable.history_packet")))
+         != xmpData.end()
+      && _read_history_packet(pos->toString(), filename, xmp_version,
+                              &packet_entries, &mask_entries_v3);
+
     // Read the masks from the file first so we can add them to the db
     // while reading history entries.
     if(xmp_version < 3)
       mask_entries = _read_masks(xmpData, filename, xmp_version);
-    else
+    else if(!has_packet)
       mask_entries_v3 = _read_masks_v3(xmpData, filename, xmp_version);
 
     // Now add all masks that are not used for cloning. Keeping them might be useful.
@@ -4178,6 +4649,10 @@ gboolean dt_exif_xmp_read(dt_image_t *img,
       if(!history_entries) // didn't work? try super old version with rdf:Bag
         history_entries = _read_history_v1(xmpPacket, filename, 1);
     }
+    else if(has_packet)
+    {
+      history_entries = packet_entries;
+    }
     else if(xmp_version == 2
             || xmp_version == 3
             || xmp_version == 4
@@ -4441,7 +4916,7 @@ gboolean dt_exif_xmp_read(dt_image_t *img,
         // Make room for mask_manager entry
         DT_DEBUG_SQLITE3_PREPARE_V2
           (dt_database_get(darktable.db),
-           "UPDATE main.history SET num = num + 1 WHERE imgid = ?1", -1,
+           "UPDATE main.history_items SET num = num + 1 WHERE imgid = ?1", -1,
            &stmt, NULL);
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, img->id);
         sqlite3_step(stmt);
@@ -4630,23 +5105,92 @@ gboolean dt_exif_xmp_read(dt_image_t *img,
   return FALSE;
 }
 
-// add history metadata to XmpData
+// Need a write lock on *img (non-const) to write stars (and soon color labels).
+gboolean dt_exif_xmp_read(dt_image_t *img,
+                          const char *filename,
+                          const gboolean history_only)
+{
+  if(!img)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[dt_exif_xmp_read] failed as no img was provided for '%s'", filename);
+    return TRUE;
+  }
+  // Exclude pfm to avoid stupid errors on the console
+  const char *c = filename + strlen(filename) - 4;
+  if(c >= filename && !strcmp(c, ".pfm")) return TRUE;
+  return _exif_xmp_read(img, filename, NULL, 0, history_only);
+}
+
+gboolean dt_exif_xmp_read_from_buffer(dt_image_t *img,
+                                      const uint8_t *data,
+                                      const size_t size,
+                                      const gboolean history_only)
+{
+  if(!img || !data || size == 0)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[dt_exif_xmp_read_from_buffer] invalid parameters");
+    return TRUE;
+  }
+  return _exif_xmp_read(img, "(buffer)", data, size, history_only);
+}
+
+static void _packet_put_int(GByteArray *packet,
+                            const int32_t value)
+{
+  g_byte_array_append(packet, (const guint8 *)&value, sizeof(value));
+}
+
+static void _packet_put_blob(GByteArray *packet,
+                             const void *data,
+                             const int32_t len)
+{
+  _packet_put_int(packet, data ? len : 0);
+  if(data && len > 0)
+    g_byte_array_append(packet, (const guint8 *)data, len);
+}
+
+static void _packet_put_string(GByteArray *packet,
+                               const char *str)
+{
+  _packet_put_blob(packet, str, str ? strlen(str) : 0);
+}
+
+// overwrite the count reserved at offset
+static void _packet_set_count(GByteArray *packet,
+                              const guint offset,
+                              const int32_t count)
+{
+  memcpy(packet->data + offset, &count, sizeof(count));
+}
+
+// add history metadata to XmpData, as arrays or as one compact packet
 static void _set_xmp_dt_history(Exiv2::XmpData &xmpData,
                                 const dt_imgid_t imgid,
-                                int history_end)
+                                int history_end,
+                                const gboolean compact)
 {
   sqlite3_stmt *stmt;
 
   // Masks:
   char key[1024];
 
+  GByteArray *packet = compact ? g_byte_array_new() : NULL;
+  guint count_offset = 0;
+  if(packet)
+  {
+    _packet_put_int(packet, DT_XMP_HISTORY_PACKET_VERSION);
+    count_offset = packet->len;
+    _packet_put_int(packet, 0);
+  }
+
   // Masks history:
   int num = 1;
 
   // Create an array:
   Exiv2::XmpTextValue tvm("");
   tvm.setXmpArrayType(Exiv2::XmpValue::xaSeq);
-  xmpData.add(Exiv2::XmpKey("Xmp.darktable.masks_history"), &tvm);
+  if(!packet)
+    xmpData.add(Exiv2::XmpKey("Xmp.darktable.masks_history"), &tvm);
   // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2(
       dt_database_get(darktable.db),
@@ -4664,10 +5208,25 @@ static void _set_xmp_dt_history(Exiv2::XmpData &xmpData,
     const int32_t mask_type = sqlite3_column_int(stmt, 2);
     const char *mask_name = (const char *)sqlite3_column_text(stmt, 3);
     const int32_t mask_version = sqlite3_column_int(stmt, 4);
+    const int32_t mask_nb = sqlite3_column_int(stmt, 6);
+
+    if(packet)
+    {
+      _packet_put_int(packet, mask_num);
+      _packet_put_int(packet, mask_id);
+      _packet_put_int(packet, mask_type);
+      _packet_put_int(packet, mask_version);
+      _packet_put_int(packet, mask_nb);
+      _packet_put_string(packet, mask_name);
+      _packet_put_blob(packet, sqlite3_column_blob(stmt, 5), sqlite3_column_bytes(stmt, 5));
+      _packet_put_blob(packet, sqlite3_column_blob(stmt, 7), sqlite3_column_bytes(stmt, 7));
+      num++;
+      continue;
+    }
+
     int32_t len = sqlite3_column_bytes(stmt, 5);
     char *mask_d =
       dt_exif_xmp_encode((const unsigned char *)sqlite3_column_blob(stmt, 5), len, NULL);
-    const int32_t mask_nb = sqlite3_column_int(stmt, 6);
     len = sqlite3_column_bytes(stmt, 7);
     char *mask_src =
       dt_exif_xmp_encode((const unsigned char *)sqlite3_column_blob(stmt, 7), len, NULL);
@@ -4704,13 +5263,21 @@ static void _set_xmp_dt_history(Exiv2::XmpData &xmpData,
   }
   sqlite3_finalize(stmt);
 
+  if(packet)
+  {
+    _packet_set_count(packet, count_offset, num - 1);
+    count_offset = packet->len;
+    _packet_put_int(packet, 0);
+  }
+
   // History stack:
   num = 1;
 
   // Create an array:
   Exiv2::XmpTextValue tv("");
   tv.setXmpArrayType(Exiv2::XmpValue::xaSeq);
-  xmpData.add(Exiv2::XmpKey("Xmp.darktable.history"), &tv);
+  if(!packet)
+    xmpData.add(Exiv2::XmpKey("Xmp.darktable.history"), &tv);
   // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2(
       dt_database_get(darktable.db),
@@ -4739,6 +5306,22 @@ static void _set_xmp_dt_history(Exiv2::XmpData &xmpData,
 
     if(!operation) continue; // no op is fatal.
 
+    if(packet)
+    {
+      _packet_put_int(packet, hist_num);
+      _packet_put_int(packet, modversion);
+      _packet_put_int(packet, enabled);
+      _packet_put_int(packet, multi_priority);
+      _packet_put_int(packet, multi_name_hand_edited);
+      _packet_put_int(packet, blendop_version);
+      _packet_put_string(packet, operation);
+      _packet_put_string(packet, multi_name);
+      _packet_put_blob(packet, params_blob, params_len);
+      _packet_put_blob(packet, blendop_blob, blendop_params_len);
+      num++;
+      continue;
+    }
+
     char *params = dt_exif_xmp_encode((const unsigned char *)params_blob, params_len, NULL);
 
     snprintf(key, sizeof(key),
@@ -4786,6 +5369,18 @@ static void _set_xmp_dt_history(Exiv2::XmpData &xmpData,
   }
 
   sqlite3_finalize(stmt);
+
+  if(packet)
+  {
+    _packet_set_count(packet, count_offset, num - 1);
+    // always compressed, the packet is only read by darktable
+    char *value = dt_exif_xmp_encode_internal(packet->data, packet->len, NULL, TRUE);
+    if(value)
+      xmpData["Xmp.darktable.history_packet"] = value;
+    free(value);
+    g_byte_array_free(packet, TRUE);
+  }
+
   if(history_end == -1)
     history_end = num - 1;
   else
@@ -5159,7 +5754,8 @@ static void _exif_xmp_read_data(Exiv2::XmpData &xmpData,
     xmpData["Xmp.darktable.auto_presets_applied"] = 1;
   else
     xmpData["Xmp.darktable.auto_presets_applied"] = 0;
-  _set_xmp_dt_history(xmpData, imgid, history_end);
+  _set_xmp_dt_history(xmpData, imgid, history_end,
+                      dt_conf_get_bool("compact_xmp_history"));
 
   // We need to read the iop-order list
   xmpData["Xmp.darktable.iop_order_version"] = iop_order_version;
@@ -5322,7 +5918,7 @@ static void _exif_xmp_read_data_export(Exiv2::XmpData &xmpData,
       xmpData["Xmp.darktable.auto_presets_applied"] = 1;
     else
       xmpData["Xmp.darktable.auto_presets_applied"] = 0;
-    _set_xmp_dt_history(xmpData, imgid, history_end);
+    _set_xmp_dt_history(xmpData, imgid, history_end, FALSE);
 
     // We need to read the iop-order list
     xmpData["Xmp.darktable.iop_order_version"] = iop_order_version;
@@ -6182,8 +6778,19 @@ static void _exif_log_handler(const int log_level,
   }
 }
 
+static void _exif_xmp_lock(void *data, bool lock)
+{
+  dt_pthread_mutex_t *mutex = (dt_pthread_mutex_t *)data;
+  if(lock)
+    dt_pthread_mutex_lock(mutex);
+  else
+    dt_pthread_mutex_unlock(mutex);
+}
+
 void dt_exif_init()
 {
+  dt_pthread_mutex_init(&_exif_files_lock, NULL);
+
   // Preface the Exiv2 messages with "[exiv2] "
   Exiv2::LogMsg::setHandler(&_exif_log_handler);
 
@@ -6191,7 +6798,7 @@ void dt_exif_init()
   Exiv2::enableBMFF();
   #endif
 
-  Exiv2::XmpParser::initialize();
+  Exiv2::XmpParser::initialize(_exif_xmp_lock, &darktable.exiv2_threadsafe);
 
   // This has to stay with the old url (namespace already propagated outside dt).
   Exiv2::XmpProperties::registerNs("http://darktable.sf.net/", "darktable");
@@ -6219,6 +6826,8 @@ void dt_exif_init()
 
 void dt_exif_cleanup()
 {
+  dt_exif_release_files();
+  dt_pthread_mutex_destroy(&_exif_files_lock);
   Exiv2::XmpParser::terminate();
 }
 
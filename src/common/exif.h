@@ -84,6 +84,15 @@ gboolean dt_exif_read(dt_image_t *img, const char *path);
     returns TRUE in case of an error */
 gboolean dt_exif_read_from_blob(dt_image_t *img, uint8_t *blob, const int size);
 
+/** read metadata from an in-memory copy of a complete image file, as dt_exif_read() does for a path,
+    including the additional tags not cached in the database. returns TRUE in case of an error */
+gboolean dt_exif_read_from_buffer(dt_image_t *img, const uint8_t *data, const size_t size);
+
+/** read the EXIF data of a file into an image struct which is not in the library: nothing is
+    written to the database and no tags or metadata are attached. the file is memory mapped so
+    that only the metadata is read. returns TRUE in case of an error */
+gboolean dt_exif_read_metadata_only(dt_image_t *img, const char *path);
+
 /** write exif to blob, return length in bytes. blob will be allocated by the function. sRGB should be true
  * if sRGB colorspace is used as output. */
 int dt_exif_read_blob(uint8_t **blob, const char *path, const dt_imgid_t imgid, const gboolean sRGB, const int out_width,
@@ -112,12 +121,23 @@ char *dt_exif_xmp_read_string(const dt_imgid_t imgid);
 /** read xmp sidecar file. Returns TRUE in case of any error*/
 gboolean dt_exif_xmp_read(dt_image_t *img, const char *filename, const gboolean history_only);
 
+/** same as dt_exif_xmp_read() but the XMP packet is given as an in-memory buffer. Returns TRUE in case of any error*/
+gboolean dt_exif_xmp_read_from_buffer(dt_image_t *img, const uint8_t *data, const size_t size,
+                                      const gboolean history_only);
+
 /** apply default import metadata */
 void dt_exif_apply_default_metadata(dt_image_t *img);
 
 /** fetch largest exif thumbnail jpg bytestream into buffer. Returns TRUE in case of any error */
 gboolean dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char **mime_type);
 
+/** the mapping of a file recently opened by the metadata readers, to be shared with the raw
+    loaders. returns a new reference, or NULL if the file is not kept open */
+GMappedFile *dt_exif_get_mapped_file(const char *path);
+
+/** close the files kept open by the metadata readers, before they get moved or deleted */
+void dt_exif_release_files(void);
+
 /** thread safe init and cleanup. */
 void dt_exif_init();
 void dt_exif_cleanup();
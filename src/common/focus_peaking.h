@@ -73,10 +73,11 @@ static inline void _get_indices(const size_t i,
   index[7] = lower_line + right_row;      // south east
 }
 
-static inline void dt_focuspeaking(cairo_t *cr,
-                                   const int buf_width,
-                                   const int buf_height,
-                                   uint8_t *const restrict image)
+// compute the focus-peaking overlay of an 8-bit image as a premultiplied
+// ARGB32 buffer of the same size, to be freed with dt_free_align()
+static inline uint8_t *dt_focuspeaking_overlay(const int buf_width,
+                                               const int buf_height,
+                                               const uint8_t *const restrict image)
 {
   float *const restrict luma = dt_alloc_align_float((size_t)buf_width * buf_height);
   uint8_t *const restrict focus_peaking = dt_alloc_align_uint8(buf_width * buf_height * 4);
@@ -193,6 +194,16 @@ static inline void dt_focuspeaking(cairo_t *cr,
       }
     }
 
+  dt_free_align(luma);
+  dt_free_align(luma_ds);
+  return focus_peaking;
+}
+
+static inline void dt_focuspeaking_draw(cairo_t *cr,
+                                        const int buf_width,
+                                        const int buf_height,
+                                        uint8_t *const restrict focus_peaking)
+{
   // draw the focus peaking overlay
   cairo_save(cr);
   cairo_rectangle(cr, 0, 0, buf_width, buf_height);
@@ -208,8 +219,15 @@ static inline void dt_focuspeaking(cairo_t *cr,
 
   // cleanup
   cairo_surface_destroy(surface);
-  dt_free_align(luma);
-  dt_free_align(luma_ds);
+}
+
+static inline void dt_focuspeaking(cairo_t *cr,
+                                   const int buf_width,
+                                   const int buf_height,
+                                   uint8_t *const restrict image)
+{
+  uint8_t *focus_peaking = dt_focuspeaking_overlay(buf_width, buf_height, image);
+  dt_focuspeaking_draw(cr, buf_width, buf_height, focus_peaking);
   dt_free_align(focus_peaking);
 }
 
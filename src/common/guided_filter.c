@@ -271,6 +271,200 @@ void guided_filter(const float *const guide,
   }
 }
 
+void dt_guided_filter_plan_free(dt_guided_filter_plan_t *plan)
+{
+  dt_free_align(plan->stats);
+  memset(plan, 0, sizeof(*plan));
+}
+
+// box means of the guide and of its products, then turned into the inverse of the regularized
+// covariance, so that the later solve of the 3x3 system is a matrix-vector product
+static gboolean _guided_filter_plan_build(dt_guided_filter_plan_t *plan,
+                                          const float *const guide,
+                                          const int width,
+                                          const int height,
+                                          const int ch,
+                                          const int w,
+                                          const float sqrt_eps,
+                                          const float guide_weight)
+{
+#define STAT_MEAN_R 0
+#define STAT_MEAN_G 1
+#define STAT_MEAN_B 2
+#define VAR_RR 3
+#define VAR_RG 4
+#define VAR_RB 5
+#define VAR_GG 6
+#define VAR_GB 7
+#define VAR_BB 8
+  float *const restrict stats = dt_alloc_align_float((size_t)9 * width * height);
+  size_t scratch_sz;
+  float *const restrict scratch = dt_alloc_perthread_float(9 * dt_round_size(width, 16), &scratch_sz);
+  if(!stats || !scratch)
+  {
+    dt_free_align(stats);
+    dt_free_align(scratch);
+    return FALSE;
+  }
+
+  DT_OMP_FOR()
+  for(int j = 0; j < height; j++)
+  {
+    float *const restrict row = stats + (size_t)9 * j * width;
+    for(int i = 0; i < width; i++)
+    {
+      const float *pixel_ = guide + (size_t)ch * (i + (size_t)j * width);
+      const float r = pixel_[0] * guide_weight;
+      const float g = pixel_[1] * guide_weight;
+      const float b = pixel_[2] * guide_weight;
+      float *const restrict px = row + 9 * i;
+      px[STAT_MEAN_R] = r;
+      px[STAT_MEAN_G] = g;
+      px[STAT_MEAN_B] = b;
+      px[VAR_RR] = r * r;
+      px[VAR_RG] = r * g;
+      px[VAR_RB] = r * b;
+      px[VAR_GG] = g * g;
+      px[VAR_GB] = g * b;
+      px[VAR_BB] = b * b;
+    }
+    dt_box_mean_horizontal(row, width, 9|BOXFILTER_KAHAN_SUM, w, dt_get_perthread(scratch, scratch_sz));
+  }
+  dt_free_align(scratch);
+  dt_box_mean_vertical(stats, height, width, 9|BOXFILTER_KAHAN_SUM, w);
+
+  const float eps = sqrt_eps * sqrt_eps;
+  DT_OMP_FOR()
+  for(size_t i = 0; i < (size_t)width * height; i++)
+  {
+    float *const px = stats + 9 * i;
+    const float guide_r = px[STAT_MEAN_R];
+    const float guide_g = px[STAT_MEAN_G];
+    const float guide_b = px[STAT_MEAN_B];
+    const float Sigma_0_0 = px[VAR_RR] - (guide_r * guide_r) + eps;
+    const float Sigma_0_1 = px[VAR_RG] - (guide_r * guide_g);
+    const float Sigma_0_2 = px[VAR_RB] - (guide_r * guide_b);
+    const float Sigma_1_1 = px[VAR_GG] - (guide_g * guide_g) + eps;
+    const float Sigma_1_2 = px[VAR_GB] - (guide_g * guide_b);
+    const float Sigma_2_2 = px[VAR_BB] - (guide_b * guide_b) + eps;
+    const float det0 = Sigma_0_0 * (Sigma_1_1 * Sigma_2_2 - Sigma_1_2 * Sigma_1_2)
+      - Sigma_0_1 * (Sigma_0_1 * Sigma_2_2 - Sigma_0_2 * Sigma_1_2)
+      + Sigma_0_2 * (Sigma_0_1 * Sigma_1_2 - Sigma_0_2 * Sigma_1_1);
+    // a singular system gives a = 0 and b = mean of the input, as in _guided_filter_tiling()
+    const float idet = (fabsf(det0) > 4.f * FLT_EPSILON) ? 1.0f / det0 : 0.0f;
+    px[VAR_RR] = idet * (Sigma_1_1 * Sigma_2_2 - Sigma_1_2 * Sigma_1_2);
+    px[VAR_RG] = idet * (Sigma_0_2 * Sigma_1_2 - Sigma_0_1 * Sigma_2_2);
+    px[VAR_RB] = idet * (Sigma_0_1 * Sigma_1_2 - Sigma_0_2 * Sigma_1_1);
+    px[VAR_GG] = idet * (Sigma_0_0 * Sigma_2_2 - Sigma_0_2 * Sigma_0_2);
+    px[VAR_GB] = idet * (Sigma_0_1 * Sigma_0_2 - Sigma_0_0 * Sigma_1_2);
+    px[VAR_BB] = idet * (Sigma_0_0 * Sigma_1_1 - Sigma_0_1 * Sigma_0_1);
+  }
+
+  plan->width = width;
+  plan->height = height;
+  plan->w = w;
+  plan->sqrt_eps = sqrt_eps;
+  plan->guide_weight = guide_weight;
+  plan->stats = stats;
+  return TRUE;
+}
+
+// the input-dependent part: two 4-channel box filters instead of the 13 + 4 channels of
+// _guided_filter_tiling()
+static gboolean _guided_filter_plan_apply(const dt_guided_filter_plan_t *plan,
+                                          const float *const guide,
+                                          const float *const in,
+                                          float *const out,
+                                          const int ch,
+                                          const float min,
+                                          const float max)
+{
+  const size_t size = (size_t)plan->width * plan->height;
+  const float guide_weight = plan->guide_weight;
+  const float *const restrict stats = plan->stats;
+  float *const restrict a_b = dt_alloc_align_float(4 * size);
+  if(!a_b) return FALSE;
+
+#define INP_COV_R 1
+#define INP_COV_G 2
+#define INP_COV_B 3
+  DT_OMP_FOR()
+  for(size_t i = 0; i < size; i++)
+  {
+    const float *pixel = guide + ch * i;
+    const float input = in[i];
+    a_b[4*i+INP_MEAN] = input;
+    a_b[4*i+INP_COV_R] = guide_weight * pixel[0] * input;
+    a_b[4*i+INP_COV_G] = guide_weight * pixel[1] * input;
+    a_b[4*i+INP_COV_B] = guide_weight * pixel[2] * input;
+  }
+  dt_box_mean(a_b, plan->height, plan->width, 4|BOXFILTER_KAHAN_SUM, plan->w, 1);
+
+  DT_OMP_FOR()
+  for(size_t i = 0; i < size; i++)
+  {
+    const float *const px = stats + 9 * i;
+    float *const ab = a_b + 4 * i;
+    const float inp_mean = ab[INP_MEAN];
+    const float cov_r = ab[INP_COV_R] - px[STAT_MEAN_R] * inp_mean;
+    const float cov_g = ab[INP_COV_G] - px[STAT_MEAN_G] * inp_mean;
+    const float cov_b = ab[INP_COV_B] - px[STAT_MEAN_B] * inp_mean;
+    const float a_r_ = px[VAR_RR] * cov_r + px[VAR_RG] * cov_g + px[VAR_RB] * cov_b;
+    const float a_g_ = px[VAR_RG] * cov_r + px[VAR_GG] * cov_g + px[VAR_GB] * cov_b;
+    const float a_b_ = px[VAR_RB] * cov_r + px[VAR_GB] * cov_g + px[VAR_BB] * cov_b;
+    ab[A_RED] = a_r_;
+    ab[A_GREEN] = a_g_;
+    ab[A_BLUE] = a_b_;
+    ab[B] = inp_mean - a_r_ * px[STAT_MEAN_R] - a_g_ * px[STAT_MEAN_G] - a_b_ * px[STAT_MEAN_B];
+  }
+  dt_box_mean(a_b, plan->height, plan->width, 4|BOXFILTER_KAHAN_SUM, plan->w, 1);
+
+  DT_OMP_FOR()
+  for(size_t i = 0; i < size; i++)
+  {
+    const float *pixel = guide + ch * i;
+    const float *px_ab = a_b + 4 * i;
+    float res = guide_weight * (px_ab[A_RED] * pixel[0] + px_ab[A_GREEN] * pixel[1] + px_ab[A_BLUE] * pixel[2]);
+    res += px_ab[B];
+    out[i] = CLAMP(res, min, max);
+  }
+  dt_free_align(a_b);
+  return TRUE;
+}
+
+void guided_filter_planned(dt_guided_filter_plan_t *plan,
+                           const dt_hash_t guide_hash,
+                           const float *const guide,
+                           const float *const in,
+                           float *const out,
+                           const int width,
+                           const int height,
+                           const int ch,
+                           const int w,
+                           const float sqrt_eps,
+                           const float guide_weight,
+                           const float min,
+                           const float max)
+{
+  assert(ch >= 3);
+  assert(w >= 1);
+
+  const gboolean reuse = plan->stats && guide_hash != DT_INVALID_HASH && plan->hash == guide_hash
+                         && plan->width == width && plan->height == height && plan->w == w
+                         && plan->sqrt_eps == sqrt_eps && plan->guide_weight == guide_weight;
+  if(!reuse)
+  {
+    dt_guided_filter_plan_free(plan);
+    if(guide_hash != DT_INVALID_HASH
+       && _guided_filter_plan_build(plan, guide, width, height, ch, w, sqrt_eps, guide_weight))
+      plan->hash = guide_hash;
+  }
+
+  // without a plan, fall back to the tiled version which needs less memory
+  if(!plan->stats || !_guided_filter_plan_apply(plan, guide, in, out, ch, min, max))
+    guided_filter(guide, in, out, width, height, ch, w, sqrt_eps, guide_weight, min, max);
+}
+
 #ifdef HAVE_OPENCL
 
 dt_guided_filter_cl_global_t *dt_guided_filter_init_cl_global()
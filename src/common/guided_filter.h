@@ -55,6 +55,29 @@ static inline void copy_gray_image(gray_image img1, gray_image img2)
 void guided_filter(const float *guide, const float *in, float *out, int width, int height, int ch, int w,
                    float sqrt_eps, float guide_weight, float min, float max);
 
+// box means of the guide and the inverse of its regularized covariance for one window size,
+// eps and guide weight. only depend on the guide, so the caller can keep them for filtering
+// other inputs with the same guide.
+typedef struct dt_guided_filter_plan_t
+{
+  dt_hash_t hash;          // hash of the guide the plan was built from
+  int width;
+  int height;
+  int w;
+  float sqrt_eps;
+  float guide_weight;
+  float *stats;            // 9 floats per pixel (allocated via dt_alloc_align)
+} dt_guided_filter_plan_t;
+
+void dt_guided_filter_plan_free(dt_guided_filter_plan_t *plan);
+
+// guided_filter() taking the guide statistics from plan if it was built for guide_hash with the
+// same parameters, else they are computed and kept in plan. The plan covers the whole image
+// instead of tiles, use it for the screen pipes only.
+void guided_filter_planned(dt_guided_filter_plan_t *plan, const dt_hash_t guide_hash, const float *guide,
+                           const float *in, float *out, int width, int height, int ch, int w, float sqrt_eps,
+                           float guide_weight, float min, float max);
+
 #ifdef HAVE_OPENCL
 
 typedef struct dt_guided_filter_cl_global_t
@@ -34,9 +34,9 @@
  * but subtract them I2 = I0 - I1, where I0 is the sample image to be
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
- * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation
+ * for small stamps and multigrid V-cycles of it for large ones, see
+ * _heal_multigrid().
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -45,11 +45,10 @@
  */
 
 
-// Subtract bottom from top and store in result as a float; separate 'red' and 'black' pixels into
-// two contiguous regions
-static void _heal_sub(const float *const top_buffer, const float *const bottom_buffer,
-                      float *const restrict red_buffer, float *const restrict black_buffer,
-                      const size_t width, const size_t height)
+// Separate the 'red' and 'black' pixels of the difference image into two contiguous regions
+static void _heal_split(const float *const restrict diff_buffer,
+                        float *const restrict red_buffer, float *const restrict black_buffer,
+                        const size_t width, const size_t height)
 {
   // how many red or black pixels per line?  For consistency, we need the larger of the two, so round up
   const size_t res_stride = 4 * ((width + 1) / 2);
@@ -67,8 +66,8 @@ static void _heal_sub(const float *const top_buffer, const float *const bottom_b
       const size_t idx = 4 * (row * width + 2*col);
       for_each_channel(c)
       {
-        buf1[4*col + c] = top_buffer[idx + c] - bottom_buffer[idx + c];
-        buf2[4*col + c] = top_buffer[idx+4 + c] - bottom_buffer[idx+4 + c];
+        buf1[4*col + c] = diff_buffer[idx + c];
+        buf2[4*col + c] = diff_buffer[idx+4 + c];
       }
     }
     if(width & 1)
@@ -79,7 +78,7 @@ static void _heal_sub(const float *const top_buffer, const float *const bottom_b
       const size_t idx = 4 * (row * width + (width-1));
       for_each_channel(c)
       {
-        buf1[4*res_idx + c] = top_buffer[idx + c] - bottom_buffer[idx + c];
+        buf1[4*res_idx + c] = diff_buffer[idx + c];
         buf2[4*res_idx + c] = 0.0f;
       }
     }
@@ -91,10 +90,9 @@ static void _heal_sub(const float *const top_buffer, const float *const bottom_b
   memset(black_buffer + (height+1)*res_stride, 0, res_stride * sizeof(float));
 }
 
-// Add first to second and store in result, re-interleaving the 'red' and 'black' pixels
-static void _heal_add(const float *const restrict red_buffer, const float *const black_buffer,
-                      const float *const restrict second_buffer, float *const restrict result_buffer,
-                      const size_t width, const size_t height)
+// Store the 'red' and 'black' pixels back into the difference image, re-interleaving them
+static void _heal_merge(const float *const restrict red_buffer, const float *const black_buffer,
+                        float *const restrict diff_buffer, const size_t width, const size_t height)
 {
   // how many red or black pixels per line?  For consistency, we need the larger of the two, so round up, then
   // add one to ensure a padding pixel on the right
@@ -113,8 +111,8 @@ static void _heal_add(const float *const restrict red_buffer, const float *const
       const size_t idx = 4 * (row * width + 2*col);
       for_each_channel(c)
       {
-        result_buffer[idx + c] = buf1[4*col + c] + second_buffer[idx + c];
-        result_buffer[idx + 4 + c] = buf2[4*col + c] + second_buffer[idx + 4 + c];
+        diff_buffer[idx + c] = buf1[4*col + c];
+        diff_buffer[idx + 4 + c] = buf2[4*col + c];
       }
     }
     if(width & 1)
@@ -123,7 +121,7 @@ static void _heal_add(const float *const restrict red_buffer, const float *const
       const size_t res_idx = (width-1)/2;
       const size_t idx = 4 * (row * width + (width-1));
       for_each_channel(c)
-        result_buffer[idx + c] = buf1[4*res_idx + c] + second_buffer[idx + c];
+        diff_buffer[idx + c] = buf1[4*res_idx + c];
     }
   }
 }
@@ -346,6 +344,299 @@ cleanup:
 }
 
 
+/* Multigrid solver for large stamps
+ *
+ * SOR needs O(n) iterations to remove the smooth part of the error and for large stamps
+ * stalls on float rounding before it meets its exit criterion, so those run into max_iter.
+ * Instead we do V-cycles of red/black Gauss-Seidel smoothing with the residual of each level
+ * solved as correction on a half-size grid, which converges in a few cycles regardless of
+ * the stamp size.
+ *
+ * All levels solve a * x - (sum of the neighbors) = rhs on their masked pixels, a being the
+ * number of neighbors inside the image. The finest level is the laplace equation on the
+ * difference image (rhs = 0), unmasked pixels are Dirichlet conditions at the finest level and
+ * zero for all coarser ones. A coarse pixel is masked only if all of its 2x2 fine pixels are,
+ * else the coarse problems overestimate the corrections near the border of the stamp and the
+ * cycles diverge. The coarse rhs is the sum of the fine residuals and corrections are upsampled
+ * bilinearly.
+ */
+
+// levels of the multigrid pyramid get no smaller than this
+#define HEAL_MULTIGRID_MIN_SIZE 16
+#define HEAL_MULTIGRID_MAX_LEVELS 16
+
+typedef struct _heal_level_t
+{
+  float *x;           // solution, 4 channels
+  float *rhs;         // right-hand side, 4 channels, NULL for zero
+  const float *mask;
+  size_t width;
+  size_t height;
+} _heal_level_t;
+
+// sweeps of red/black Gauss-Seidel with over-relaxation omega
+static void _heal_mg_smooth(const _heal_level_t *const l, const float omega, const int sweeps)
+{
+  float *const restrict x = l->x;
+  const float *const restrict rhs = l->rhs;
+  const float *const restrict mask = l->mask;
+  const size_t width = l->width;
+  const size_t height = l->height;
+
+  for(int sweep = 0; sweep < sweeps; sweep++)
+  {
+    for(size_t parity = 0; parity < 2; parity++)
+    {
+      DT_OMP_FOR()
+      for(size_t row = 0; row < height; row++)
+      {
+        for(size_t col = (row + parity) & 1; col < width; col += 2)
+        {
+          const size_t k = row * width + col;
+          if(!mask[k]) continue;
+          dt_aligned_pixel_t sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+          if(rhs) copy_pixel(sum, rhs + 4*k);
+          float a = 0.0f;
+          if(row > 0)
+          {
+            for_each_channel(c) sum[c] += x[4*(k - width) + c];
+            a += 1.0f;
+          }
+          if(row + 1 < height)
+          {
+            for_each_channel(c) sum[c] += x[4*(k + width) + c];
+            a += 1.0f;
+          }
+          if(col > 0)
+          {
+            for_each_channel(c) sum[c] += x[4*(k - 1) + c];
+            a += 1.0f;
+          }
+          if(col + 1 < width)
+          {
+            for_each_channel(c) sum[c] += x[4*(k + 1) + c];
+            a += 1.0f;
+          }
+          if(a == 0.0f) continue;
+          for_each_channel(c) x[4*k + c] += omega * (sum[c] / a - x[4*k + c]);
+        }
+      }
+    }
+  }
+}
+
+// store the residual of level l in res and return its sum of squares
+static float _heal_mg_residual(const _heal_level_t *const l, float *const restrict res)
+{
+  const float *const restrict x = l->x;
+  const float *const restrict rhs = l->rhs;
+  const float *const restrict mask = l->mask;
+  const size_t width = l->width;
+  const size_t height = l->height;
+  float err = 0.0f;
+
+  DT_OMP_FOR(reduction(+ : err))
+  for(size_t row = 0; row < height; row++)
+  {
+    for(size_t col = 0; col < width; col++)
+    {
+      const size_t k = row * width + col;
+      dt_aligned_pixel_t r = { 0.0f, 0.0f, 0.0f, 0.0f };
+      if(mask[k])
+      {
+        if(rhs) copy_pixel(r, rhs + 4*k);
+        float a = 0.0f;
+        if(row > 0)
+        {
+          for_each_channel(c) r[c] += x[4*(k - width) + c];
+          a += 1.0f;
+        }
+        if(row + 1 < height)
+        {
+          for_each_channel(c) r[c] += x[4*(k + width) + c];
+          a += 1.0f;
+        }
+        if(col > 0)
+        {
+          for_each_channel(c) r[c] += x[4*(k - 1) + c];
+          a += 1.0f;
+        }
+        if(col + 1 < width)
+        {
+          for_each_channel(c) r[c] += x[4*(k + 1) + c];
+          a += 1.0f;
+        }
+        for_each_channel(c) r[c] -= a * x[4*k + c];
+        err += r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+      }
+      copy_pixel(res + 4*k, r);
+    }
+  }
+  return err;
+}
+
+// sum 2x2 blocks of the fine residual into the coarse rhs and clear the coarse solution
+static void _heal_mg_restrict(const float *const restrict res, const _heal_level_t *const fine,
+                              const _heal_level_t *const coarse)
+{
+  DT_OMP_FOR()
+  for(size_t row = 0; row < coarse->height; row++)
+  {
+    for(size_t col = 0; col < coarse->width; col++)
+    {
+      dt_aligned_pixel_t sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for(size_t y = 2*row; y < MIN(2*row + 2, fine->height); y++)
+        for(size_t x = 2*col; x < MIN(2*col + 2, fine->width); x++)
+          for_each_channel(c) sum[c] += res[4*(y * fine->width + x) + c];
+      const size_t k = row * coarse->width + col;
+      copy_pixel(coarse->rhs + 4*k, sum);
+      for_each_channel(c) coarse->x[4*k + c] = 0.0f;
+    }
+  }
+}
+
+// add the bilinearly upsampled coarse correction to the masked fine pixels
+static void _heal_mg_prolong(const _heal_level_t *const coarse, const _heal_level_t *const fine)
+{
+  const size_t cwidth = coarse->width;
+  const size_t cheight = coarse->height;
+  const float *const restrict e = coarse->x;
+
+  DT_OMP_FOR()
+  for(size_t row = 0; row < fine->height; row++)
+  {
+    const float fy = CLAMPS(0.5f * row - 0.25f, 0.0f, cheight - 1);
+    const size_t y0 = fy;
+    const size_t y1 = MIN(y0 + 1, cheight - 1);
+    const float wy = fy - y0;
+    for(size_t col = 0; col < fine->width; col++)
+    {
+      const size_t k = row * fine->width + col;
+      if(!fine->mask[k]) continue;
+      const float fx = CLAMPS(0.5f * col - 0.25f, 0.0f, cwidth - 1);
+      const size_t x0 = fx;
+      const size_t x1 = MIN(x0 + 1, cwidth - 1);
+      const float wx = fx - x0;
+      const float *const e00 = e + 4 * (y0 * cwidth + x0);
+      const float *const e01 = e + 4 * (y0 * cwidth + x1);
+      const float *const e10 = e + 4 * (y1 * cwidth + x0);
+      const float *const e11 = e + 4 * (y1 * cwidth + x1);
+      for_each_channel(c)
+        fine->x[4*k + c] += (1.0f - wy) * ((1.0f - wx) * e00[c] + wx * e01[c])
+                            + wy * ((1.0f - wx) * e10[c] + wx * e11[c]);
+    }
+  }
+}
+
+static void _heal_mg_vcycle(_heal_level_t *const levels, const int lev, const int nlevels,
+                            float *const restrict res)
+{
+  const _heal_level_t *const l = levels + lev;
+  if(lev == nlevels - 1)
+  {
+    // the coarsest level is small enough to solve it by brute force
+    _heal_mg_smooth(l, 1.7f, 4 * MAX(l->width, l->height));
+    return;
+  }
+
+  _heal_mg_smooth(l, 1.0f, 2);
+  _heal_mg_residual(l, res);
+  _heal_mg_restrict(res, l, l + 1);
+  _heal_mg_vcycle(levels, lev + 1, nlevels, res);
+  _heal_mg_prolong(l + 1, l);
+  _heal_mg_smooth(l, 1.0f, 2);
+}
+
+// Solve the laplace equation on the difference image by multigrid V-cycles, returns FALSE if the
+// stamp is too small or memory is short for that; then the SOR loop has to do it.
+static gboolean _heal_multigrid(float *const restrict diff_buffer, const float *const restrict mask,
+                                const size_t width, const size_t height, const int max_iter)
+{
+  _heal_level_t levels[HEAL_MULTIGRID_MAX_LEVELS] = { { 0 } };
+  levels[0] = (_heal_level_t){ .x = diff_buffer, .rhs = NULL, .mask = mask, .width = width, .height = height };
+  int nlevels = 1;
+  while(nlevels < HEAL_MULTIGRID_MAX_LEVELS
+        && levels[nlevels - 1].width >= 2 * HEAL_MULTIGRID_MIN_SIZE
+        && levels[nlevels - 1].height >= 2 * HEAL_MULTIGRID_MIN_SIZE)
+  {
+    levels[nlevels].width = (levels[nlevels - 1].width + 1) / 2;
+    levels[nlevels].height = (levels[nlevels - 1].height + 1) / 2;
+    nlevels++;
+  }
+  if(nlevels == 1) return FALSE;
+
+  gboolean success = FALSE;
+  float *const restrict res = dt_alloc_align_float(4 * width * height);
+  if(res == NULL) goto cleanup;
+
+  for(int lev = 1; lev < nlevels; lev++)
+  {
+    _heal_level_t *const l = levels + lev;
+    const _heal_level_t *const f = l - 1;
+    l->x = dt_alloc_align_float(4 * l->width * l->height);
+    l->rhs = dt_alloc_align_float(4 * l->width * l->height);
+    float *const cmask = dt_alloc_align_float(l->width * l->height);
+    l->mask = cmask;
+    if(l->x == NULL || l->rhs == NULL || cmask == NULL) goto cleanup;
+
+    DT_OMP_FOR()
+    for(size_t row = 0; row < l->height; row++)
+    {
+      for(size_t col = 0; col < l->width; col++)
+      {
+        float m = 1.0f;
+        for(size_t y = 2*row; y < MIN(2*row + 2, f->height); y++)
+          for(size_t x = 2*col; x < MIN(2*col + 2, f->width); x++)
+            m = fminf(m, f->mask[y * f->width + x] ? 1.0f : 0.0f);
+        cmask[row * l->width + col] = m;
+      }
+    }
+  }
+
+  // same convergence criterion as the SOR loop, and a V-cycle costs about as much as 8 SOR iterations
+  const float epsilon = (0.1 / 255);
+  const int max_cycles = MAX(1, max_iter / 8);
+  for(int cycle = 0; cycle < max_cycles; cycle++)
+  {
+    _heal_mg_vcycle(levels, 0, nlevels, res);
+    if(_heal_mg_residual(levels, res) < epsilon * epsilon) break;
+  }
+  success = TRUE;
+
+cleanup:
+  if(!success) dt_print(DT_DEBUG_ALWAYS, "_heal_multigrid: error allocating memory for healing");
+  for(int lev = 1; lev < nlevels; lev++)
+  {
+    if(levels[lev].x) dt_free_align(levels[lev].x);
+    if(levels[lev].rhs) dt_free_align(levels[lev].rhs);
+    if(levels[lev].mask) dt_free_align((float *)levels[lev].mask);
+  }
+  if(res) dt_free_align(res);
+  return success;
+}
+
+// Solve the laplace equation with successive over-relaxation for the difference image.
+static void _heal_sor(float *const restrict diff_buffer, const float *const restrict mask,
+                      const size_t width, const size_t height, const int max_iter)
+{
+  const size_t subwidth = 4 * ((width+1)/2);  // round up to be able to handle odd widths
+  float *const restrict red_buffer = dt_alloc_align_float(subwidth * (height + 2));
+  float *const restrict black_buffer = dt_alloc_align_float(subwidth * (height + 2));
+  if(red_buffer == NULL || black_buffer == NULL)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "_heal_sor: error allocating memory for healing");
+    goto cleanup;
+  }
+
+  _heal_split(diff_buffer, red_buffer, black_buffer, width, height);
+  _heal_laplace_loop(red_buffer, black_buffer, width, height, mask, max_iter);
+  _heal_merge(red_buffer, black_buffer, diff_buffer, width, height);
+
+cleanup:
+  if(red_buffer) dt_free_align(red_buffer);
+  if(black_buffer) dt_free_align(black_buffer);
+}
+
 /* Original Algorithm Design:
  *
  * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
@@ -359,26 +650,27 @@ void dt_heal(const float *const src_buffer, float *dest_buffer, const float *con
     dt_print(DT_DEBUG_ALWAYS, "dt_heal: full-color image required");
     return;
   }
-  const size_t subwidth = 4 * ((width+1)/2);  // round up to be able to handle odd widths
-  float *const restrict red_buffer = dt_alloc_align_float(subwidth * (height + 2));
-  float *const restrict black_buffer = dt_alloc_align_float(subwidth * (height + 2));
-  if(red_buffer == NULL || black_buffer == NULL)
+  const size_t npixels = (size_t)width * height;
+  float *const restrict diff_buffer = dt_alloc_align_float(4 * npixels);
+  if(diff_buffer == NULL)
   {
     dt_print(DT_DEBUG_ALWAYS, "dt_heal: error allocating memory for healing");
-    goto cleanup;
+    return;
   }
 
-  /* subtract pattern from image and store the result split by 'red' and 'black' positions  */
-  _heal_sub(dest_buffer, src_buffer, red_buffer, black_buffer, width, height);
+  /* subtract pattern from image, solve and add the solution back */
+  DT_OMP_FOR()
+  for(size_t k = 0; k < 4 * npixels; k++)
+    diff_buffer[k] = dest_buffer[k] - src_buffer[k];
 
-  _heal_laplace_loop(red_buffer, black_buffer, width, height, mask_buffer, max_iter);
+  if(!_heal_multigrid(diff_buffer, mask_buffer, width, height, max_iter))
+    _heal_sor(diff_buffer, mask_buffer, width, height, max_iter);
 
-  /* add solution to original image and store in dest */
-  _heal_add(red_buffer, black_buffer, src_buffer, dest_buffer, width, height);
+  DT_OMP_FOR()
+  for(size_t k = 0; k < 4 * npixels; k++)
+    dest_buffer[k] = src_buffer[k] + diff_buffer[k];
 
-cleanup:
-  if(red_buffer) dt_free_align(red_buffer);
-  if(black_buffer) dt_free_align(black_buffer);
+  dt_free_align(diff_buffer);
 }
 
 #ifdef HAVE_OPENCL
@@ -1287,7 +1287,7 @@ void dt_history_compress_on_image(const dt_imgid_t imgid)
     {
       // make room for mask manager history entry
       DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-        "UPDATE main.history SET num=num+1 WHERE imgid = ?1", -1, &stmt, NULL);
+        "UPDATE main.history_items SET num=num+1 WHERE imgid = ?1", -1, &stmt, NULL);
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
       sqlite3_step(stmt);
       sqlite3_finalize(stmt);
@@ -1426,7 +1426,7 @@ gboolean dt_history_compress(const dt_imgid_t imgid)
           // step by step set the correct num
           DT_DEBUG_SQLITE3_PREPARE_V2
             (dt_database_get(darktable.db),
-             "UPDATE main.history"
+             "UPDATE main.history_items"
              " SET num = ?3"
              " WHERE imgid = ?1 AND num = ?2",
              -1, &stmt4, NULL);
@@ -1444,7 +1444,7 @@ gboolean dt_history_compress(const dt_imgid_t imgid)
     // update history end
     dt_image_set_history_end(imgid, done);
 
-    dt_image_write_sidecar_file(imgid);
+    dt_image_synch_xmp(imgid);
   }
   dt_unlock_image(imgid);
   dt_history_hash_write_from_history(imgid, DT_HISTORY_HASH_CURRENT);
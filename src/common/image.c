@@ -37,6 +37,7 @@
 #include "control/jobs.h"
 #include "control/jobs/sidecar_jobs.h"
 #include "develop/lightroom.h"
+#include "develop/pixelpipe_cache.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_rawspeed.h"
 #include "imageio/imageio_libraw.h"
@@ -653,6 +654,7 @@ static void _pop_undo(gpointer user_data,
   {
     int i = 0;
 
+    dt_image_cache_write_back_begin();
     for(GList *list = (GList *)data; list; list = g_list_next(list))
     {
       dt_undo_geotag_t *undogeotag = list->data;
@@ -664,6 +666,7 @@ static void _pop_undo(gpointer user_data,
       *imgs = g_list_prepend(*imgs, GINT_TO_POINTER(undogeotag->imgid));
       i++;
     }
+    dt_image_cache_write_back_end();
     if(i > 1)
       dt_control_log((action == DT_ACTION_UNDO)
                      ? ngettext("geo-location undone for %d image",
@@ -678,6 +681,7 @@ static void _pop_undo(gpointer user_data,
   {
     int i = 0;
 
+    dt_image_cache_write_back_begin();
     for(GList *list = (GList *)data; list; list = g_list_next(list))
     {
       dt_undo_datetime_t *undodatetime = list->data;
@@ -688,6 +692,7 @@ static void _pop_undo(gpointer user_data,
       *imgs = g_list_prepend(*imgs, GINT_TO_POINTER(undodatetime->imgid));
       i++;
     }
+    dt_image_cache_write_back_end();
     if(i > 1)
       dt_control_log((action == DT_ACTION_UNDO)
                      ? ngettext("date/time undone for %d image",
@@ -743,6 +748,7 @@ static void _image_set_location(GList *imgs,
                                 GList **undo,
                                 const gboolean undo_on)
 {
+  dt_image_cache_write_back_begin();
   for(GList *images = imgs; images; images = g_list_next(images))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(images->data);
@@ -760,6 +766,7 @@ static void _image_set_location(GList *imgs,
 
     _set_location(imgid, geoloc);
   }
+  dt_image_cache_write_back_end();
 }
 
 void dt_image_set_locations(const GList *imgs,
@@ -805,6 +812,7 @@ static void _image_set_images_locations(const GList *img,
                                         const gboolean undo_on)
 {
   int i = 0;
+  dt_image_cache_write_back_begin();
   for(GList *imgs = (GList *)img; imgs; imgs = g_list_next(imgs))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(imgs->data);
@@ -823,6 +831,7 @@ static void _image_set_images_locations(const GList *img,
     _set_location(imgid, geoloc);
     i++;
   }
+  dt_image_cache_write_back_end();
 }
 
 void dt_image_set_images_locations(const GList *imgs,
@@ -1585,6 +1594,7 @@ void dt_image_remove(const dt_imgid_t imgid)
 
   // also clear all thumbnails in mipmap_cache.
   dt_mipmap_cache_remove(imgid);
+  dt_dev_pixelpipe_shared_cache_remove_image(imgid);
 
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_IMAGE_REMOVED, imgid, 0);
 }
@@ -1786,6 +1796,59 @@ static int _image_read_duplicates(const uint32_t id,
   return count_xmps_processed;
 }
 
+// part of the file going into the content fingerprint. It holds the
+// headers with the exif data, capture time and camera serial included.
+#define DT_IMAGE_FINGERPRINT_BYTES (1 << 20)
+
+// content fingerprint of an image file: its size and the first
+// DT_IMAGE_FINGERPRINT_BYTES, hashed in 64 bit words
+static dt_hash_t _image_fingerprint(const char *filename)
+{
+  GStatBuf st;
+  if(g_stat(filename, &st) || st.st_size <= 0)
+    return DT_INVALID_HASH;
+
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return DT_INVALID_HASH;
+
+  const size_t bytes = MIN((size_t)st.st_size, DT_IMAGE_FINGERPRINT_BYTES);
+  const size_t words = (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+  uint64_t *buf = g_try_malloc0(words * sizeof(uint64_t));
+  const gboolean ok = buf && fread(buf, 1, bytes, f) == bytes;
+  fclose(f);
+
+  dt_hash_t hash = DT_INVALID_HASH;
+  if(ok)
+  {
+    // FNV-1a on words, with an extra shift so high bits feed back
+    hash = 0xcbf29ce484222325ull ^ (uint64_t)st.st_size;
+    for(size_t k = 0; k < words; k++)
+    {
+      hash ^= buf[k];
+      hash *= 0x100000001b3ull;
+      hash ^= hash >> 29;
+    }
+    if(hash == DT_INVALID_HASH) hash = DT_INITHASH;
+  }
+  g_free(buf);
+  return hash;
+}
+
+static dt_imgid_t _image_get_id_by_fingerprint(const dt_hash_t fingerprint)
+{
+  dt_imgid_t id = NO_IMGID;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "SELECT id FROM main.images WHERE fingerprint = ?1 LIMIT 1",
+     -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 1, (sqlite3_int64)fingerprint);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+    id = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  return id;
+}
+
 static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
                                          const char *filename,
                                          const gboolean override_ignore_nonraws,
@@ -1860,6 +1923,25 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
     return id;
   }
 
+  // the same content may be in the library under another path, for
+  // example when importing a backup of a memory card
+  const dt_hash_t fingerprint = _image_fingerprint(normalized_filename);
+  if(fingerprint != DT_INVALID_HASH
+     && dt_conf_get_bool("ui_last/import_skip_duplicates"))
+  {
+    const dt_imgid_t other_id = _image_get_id_by_fingerprint(fingerprint);
+    if(dt_is_valid_imgid(other_id))
+    {
+      dt_print(DT_DEBUG_CONTROL,
+               "[image_import_internal] skipping `%s', same content as image %d",
+               normalized_filename, other_id);
+      g_free(imgfname);
+      g_free(ext);
+      g_free(normalized_filename);
+      return NO_IMGID;
+    }
+  }
+
   dt_set_backthumb_time(0.0);
   // also need to set the no-legacy bit, to make sure we get the right presets (new ones)
   uint32_t flags = dt_conf_get_int("ui_last/import_initial_rating");
@@ -1886,9 +1968,10 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   DT_DEBUG_SQLITE3_PREPARE_V2
     (dt_database_get(darktable.db),
      "INSERT INTO main.images (id, film_id, filename, flags, version, "
-     "                         max_version, history_end, position, import_timestamp)"
+     "                         max_version, history_end, position, import_timestamp,"
+     "                         fingerprint)"
      " SELECT NULL, ?1, ?2, ?3, 0, 0, 0,"
-     "        (IFNULL(MAX(position),0) & 0xFFFFFFFF00000000)  + (1 << 32), ?4"
+     "        (IFNULL(MAX(position),0) & 0xFFFFFFFF00000000)  + (1 << 32), ?4, ?5"
      " FROM images",
      -1, &stmt, NULL);
   // clang-format on
@@ -1897,6 +1980,9 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, imgfname, -1, SQLITE_TRANSIENT);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, flags);
   DT_DEBUG_SQLITE3_BIND_INT64(stmt, 4, dt_datetime_now_to_gtimespan());
+  // left NULL if the file could not be read
+  if(fingerprint != DT_INVALID_HASH)
+    DT_DEBUG_SQLITE3_BIND_INT64(stmt, 5, (sqlite3_int64)fingerprint);
 
   rc = sqlite3_step(stmt);
   if(rc != SQLITE_DONE)
@@ -2087,6 +2173,100 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   return id;
 }
 
+dt_imgid_t dt_image_import_from_buffer(const dt_filmid_t film_id,
+                                       const char *name,
+                                       GBytes *buffer,
+                                       const uint8_t *xmp,
+                                       const size_t xmp_size)
+{
+  if(!name || !buffer || g_bytes_get_size(buffer) == 0)
+    return NO_IMGID;
+
+  // the name only gives the image type (from its extension) and a
+  // label in the database, it is never opened.
+  const char *extension = g_strrstr(name, ".");
+  uint32_t flags = DT_IMAGE_NO_LEGACY_PRESETS;
+  if(extension)
+    flags |= dt_imageio_get_type_from_extension(extension);
+
+  sqlite3_stmt *stmt;
+  // the new id is read back with last_insert_rowid() which is per
+  // connection, so no other import may insert in between.
+  dt_pthread_mutex_lock(&darktable.import_threadsafe);
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "INSERT INTO main.images (id, film_id, filename, flags, version, "
+     "                         max_version, history_end, position, import_timestamp)"
+     " SELECT NULL, ?1, ?2, ?3, 0, 0, 0,"
+     "        (IFNULL(MAX(position),0) & 0xFFFFFFFF00000000)  + (1 << 32), ?4"
+     " FROM images",
+     -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, name, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, flags);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 4, dt_datetime_now_to_gtimespan());
+
+  const int rc = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if(rc != SQLITE_DONE)
+  {
+    dt_pthread_mutex_unlock(&darktable.import_threadsafe);
+    dt_print(DT_DEBUG_ALWAYS,
+             "[image_import_from_buffer] sqlite3 error %d for `%s'", rc, name);
+    return NO_IMGID;
+  }
+
+  // the same name may be used by several buffers, so don't look it up
+  const dt_imgid_t id =
+    (dt_imgid_t)sqlite3_last_insert_rowid(dt_database_get(darktable.db));
+  dt_pthread_mutex_unlock(&darktable.import_threadsafe);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "UPDATE main.images SET group_id = ?1 WHERE id = ?1",
+     -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  dt_image_t *img = dt_image_cache_get(id, 'w');
+  if(img)
+  {
+    img->group_id = id;
+    img->raw_buffer = g_bytes_ref(buffer);
+
+    gsize buffer_size = 0;
+    const uint8_t *data = g_bytes_get_data(buffer, &buffer_size);
+    if(dt_exif_read_from_buffer(img, data, buffer_size))
+      img->exif_inited = FALSE;
+
+    if(xmp && xmp_size > 0)
+      dt_exif_xmp_read_from_buffer(img, xmp, xmp_size, FALSE);
+  }
+  // write through to db, never to a sidecar as there is no file
+  dt_image_cache_write_release(img, DT_IMAGE_CACHE_RELAXED);
+
+  dt_mipmap_cache_remove(id);
+
+  return id;
+}
+
+void dt_image_set_raw_buffer(const dt_imgid_t imgid, GBytes *buffer)
+{
+  dt_image_t *img = dt_image_cache_get(imgid, 'w');
+  if(!img) return;
+
+  if(img->raw_buffer) g_bytes_unref(img->raw_buffer);
+  img->raw_buffer = buffer ? g_bytes_ref(buffer) : NULL;
+
+  dt_image_cache_write_release(img, DT_IMAGE_CACHE_RELAXED);
+
+  // the full buffer must be decoded again from the new content
+  dt_mipmap_cache_remove_at_size(imgid, DT_MIPMAP_FULL);
+}
+
 dt_imgid_t dt_image_get_id_full_path(const gchar *filename)
 {
   dt_imgid_t id = NO_IMGID;
@@ -2175,7 +2355,6 @@ void dt_image_init(dt_image_t *img)
   img->exif_inited = FALSE;
   img->camera_missing_sample = FALSE;
   img->raw_buffer = NULL;
-  img->raw_buffer_size = 0;
   dt_datetime_exif_to_img(img, "");
   memset(img->exif_maker, 0, sizeof(img->exif_maker));
   memset(img->exif_model, 0, sizeof(img->exif_model));
@@ -2261,6 +2440,7 @@ gboolean _move_extra_file(const gchar *oldFilePath, const gchar *newFolder, cons
   g_strlcat(newFilePath, oldExtension, sizeof(newFilePath));
   GFile *oldFile = g_file_new_for_path(oldFilePath);
   GFile *newFile = g_file_new_for_path(newFilePath);
+  dt_exif_release_files();
   const gboolean moveSuccess = g_file_move(oldFile, newFile, 0, NULL, NULL, NULL, NULL);
   g_free(oldFilename);
   g_free(oldExtension);
@@ -2329,7 +2509,8 @@ gboolean dt_image_rename(const dt_imgid_t imgid,
     // get current local copy if any
     _image_local_copy_full_path(imgid, copysrcpath, sizeof(copysrcpath));
 
-    // move image
+    // move image, a file still mapped can't be moved on Windows
+    dt_exif_release_files();
     GError *moveError = NULL;
     gboolean moveStatus = g_file_move(old, new, 0, NULL, NULL, NULL, &moveError);
 
@@ -2591,7 +2772,8 @@ dt_imgid_t dt_image_copy_rename(const dt_imgid_t imgid,
          "   raw_black, raw_maximum, orientation,"
          "   longitude, latitude, altitude, color_matrix, colorspace, version, max_version,"
          "   position, aspect_ratio, exposure_bias,"
-         "   whitebalance_id, flash_id, exposure_program_id, metering_mode_id, flash_tagvalue)"
+         "   whitebalance_id, flash_id, exposure_program_id, metering_mode_id, flash_tagvalue,"
+         "   fingerprint)"
          " SELECT NULL, group_id, ?1 as film_id, width, height, ?2 as filename,"
          "        maker_id, model_id, lens_id,"
          "        exposure, aperture, iso, focal_length, focus_distance, datetime_taken,"
@@ -2599,7 +2781,8 @@ dt_imgid_t dt_image_copy_rename(const dt_imgid_t imgid,
          "        orientation, longitude, latitude, altitude,"
          "        color_matrix, colorspace, -1, -1,"
          "        ?3, aspect_ratio, exposure_bias,"
-         "        whitebalance_id, flash_id, exposure_program_id, metering_mode_id, flash_tagvalue"
+         "        whitebalance_id, flash_id, exposure_program_id, metering_mode_id, flash_tagvalue,"
+         "        fingerprint"
          " FROM main.images"
          " WHERE id = ?4",
         -1, &stmt, NULL);
@@ -3102,6 +3285,7 @@ static void _image_set_datetimes(const GList *img,
                                  const gboolean undo_on)
 {
   int i = 0;
+  dt_image_cache_write_back_begin();
   for(GList *imgs = (GList *)img; imgs; imgs = g_list_next(imgs))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(imgs->data);
@@ -3121,6 +3305,7 @@ static void _image_set_datetimes(const GList *img,
     _set_datetime(imgid, datetime->dt);
     i++;
   }
+  dt_image_cache_write_back_end();
 }
 
 void dt_image_set_datetimes(const GList *imgs,
@@ -3147,6 +3332,7 @@ static void _image_set_datetime(const GList *img,
                                 GList **undo,
                                 const gboolean undo_on)
 {
+  dt_image_cache_write_back_begin();
   for(GList *imgs = (GList *)img; imgs;  imgs = g_list_next(imgs))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(imgs->data);
@@ -3163,6 +3349,7 @@ static void _image_set_datetime(const GList *img,
 
     _set_datetime(imgid, datetime);
   }
+  dt_image_cache_write_back_end();
 }
 
 void dt_image_set_datetime(const GList *imgs,
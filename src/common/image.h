@@ -357,11 +357,11 @@ typedef struct dt_image_t
   /* result of attempting to load the image, needed to be able to report why the image can't be displayed */
   dt_imageio_retval_t load_status;
 
-  /* Buffer-based loading support (for pre-loaded raw data) */
-  // TODO: This is a temporary hack for buffer-based input.
-  // Consider: separate buffer management system or loader plugin architecture
-  const uint8_t *raw_buffer;      // Pre-loaded raw file data (NULL = use filename)
-  size_t raw_buffer_size;          // Size of buffer in bytes
+  /* in-memory content of the image file (NULL = use filename). the
+     image cache entry owns one reference which is dropped on eviction,
+     anyone holding a copy of this struct beyond the cache lock must
+     take its own reference. */
+  GBytes *raw_buffer;
 } dt_image_t;
 
 // should be in datetime.h, workaround to solve cross references
@@ -459,6 +459,16 @@ dt_imgid_t dt_image_import(dt_filmid_t film_id,
 dt_imgid_t dt_image_import_lua(const dt_filmid_t film_id,
                                const char *filename,
                                const gboolean override_ignore_nonraws);
+/** adds an image whose file content is held in memory to the data base and image cache.
+ * name is only used for its extension. the image cache takes its own reference on buffer,
+ * released when the image is evicted or removed. if given, the xmp packet provides the history. */
+dt_imgid_t dt_image_import_from_buffer(const dt_filmid_t film_id,
+                                       const char *name,
+                                       GBytes *buffer,
+                                       const uint8_t *xmp,
+                                       const size_t xmp_size);
+/** attaches the in-memory file content to an image in the cache, replacing a previous one. */
+void dt_image_set_raw_buffer(const dt_imgid_t imgid, GBytes *buffer);
 /** removes the given image from the database. */
 void dt_image_remove(const dt_imgid_t imgid);
 /** duplicates the given image in the database with the duplicate
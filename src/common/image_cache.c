@@ -22,172 +22,193 @@
 #include "common/exif.h"
 #include "common/image.h"
 #include "common/datetime.h"
+#include "common/file_location.h"
+#include "common/grealpath.h"
 #include "control/conf.h"
 #include "develop/develop.h"
 
+#include <glib/gstdio.h>
 #include <sqlite3.h>
 #include <inttypes.h>
 
+// clang-format off
+#define DT_IMAGE_CACHE_SELECT \
+  "SELECT mi.id, group_id, film_id, width, height, filename," \
+  "       mk.name, md.name, ln.name," \
+  "       exposure, aperture, iso, focal_length, datetime_taken, flags," \
+  "       crop, orientation, focus_distance, raw_parameters," \
+  "       longitude, latitude, altitude, color_matrix, colorspace, version," \
+  "       raw_black, raw_maximum, aspect_ratio, exposure_bias," \
+  "       import_timestamp, change_timestamp, export_timestamp, print_timestamp," \
+  "       output_width, output_height, cm.maker, cm.model, cm.alias," \
+  "       wb.name, fl.name, ep.name, mm.name, flash_tagvalue" \
+  "  FROM main.images AS mi" \
+  "       LEFT JOIN main.cameras AS cm ON cm.id = mi.camera_id" \
+  "       LEFT JOIN main.makers AS mk ON mk.id = mi.maker_id" \
+  "       LEFT JOIN main.models AS md ON md.id = mi.model_id" \
+  "       LEFT JOIN main.lens AS ln ON ln.id = mi.lens_id" \
+  "       LEFT JOIN main.whitebalance AS wb ON wb.id = mi.whitebalance_id" \
+  "       LEFT JOIN main.flash AS fl ON fl.id = mi.flash_id" \
+  "       LEFT JOIN main.exposure_program AS ep ON ep.id = mi.exposure_program_id" \
+  "       LEFT JOIN main.metering_mode AS mm ON mm.id = mi.metering_mode_id"
+// clang-format on
+
+static void _image_cache_read_row(dt_image_t *img,
+                                  sqlite3_stmt *stmt)
+{
+  img->id = sqlite3_column_int(stmt, 0);
+  img->group_id = sqlite3_column_int(stmt, 1);
+  img->film_id = sqlite3_column_int(stmt, 2);
+  img->p_width = img->width = sqlite3_column_int(stmt, 3);
+  img->p_height = img->height = sqlite3_column_int(stmt, 4);
+  img->crop_x = img->crop_y = img->crop_right = img->crop_bottom = 0;
+  img->filename[0] = img->exif_maker[0] = img->exif_model[0] = img->exif_lens[0] = '\0';
+  dt_datetime_exif_to_img(img, "");
+  char *str;
+  str = (char *)sqlite3_column_text(stmt, 5);
+  if(str) g_strlcpy(img->filename, str, sizeof(img->filename));
+  str = (char *)sqlite3_column_text(stmt, 6);
+  if(str) g_strlcpy(img->exif_maker, str, sizeof(img->exif_maker));
+  str = (char *)sqlite3_column_text(stmt, 7);
+  if(str) g_strlcpy(img->exif_model, str, sizeof(img->exif_model));
+  str = (char *)sqlite3_column_text(stmt, 8);
+  if(str) g_strlcpy(img->exif_lens, str, sizeof(img->exif_lens));
+  img->exif_exposure = sqlite3_column_double(stmt, 9);
+  img->exif_aperture = sqlite3_column_double(stmt, 10);
+  img->exif_iso = sqlite3_column_double(stmt, 11);
+  img->exif_focal_length = sqlite3_column_double(stmt, 12);
+  img->exif_datetime_taken = sqlite3_column_int64(stmt, 13);
+  img->flags = sqlite3_column_int(stmt, 14);
+  img->loader = LOADER_UNKNOWN;
+  img->exif_crop = sqlite3_column_double(stmt, 15);
+  img->orientation = sqlite3_column_int(stmt, 16);
+  img->exif_focus_distance = sqlite3_column_double(stmt, 17);
+  if(img->exif_focus_distance >= 0 && img->orientation >= 0) img->exif_inited = TRUE;
+  uint32_t tmp = sqlite3_column_int(stmt, 18);
+  memcpy(&img->legacy_flip, &tmp, sizeof(dt_image_raw_parameters_t));
+  if(sqlite3_column_type(stmt, 19) == SQLITE_FLOAT)
+    img->geoloc.longitude = sqlite3_column_double(stmt, 19);
+  else
+    img->geoloc.longitude = NAN;
+  if(sqlite3_column_type(stmt, 20) == SQLITE_FLOAT)
+    img->geoloc.latitude = sqlite3_column_double(stmt, 20);
+  else
+    img->geoloc.latitude = NAN;
+  if(sqlite3_column_type(stmt, 21) == SQLITE_FLOAT)
+    img->geoloc.elevation = sqlite3_column_double(stmt, 21);
+  else
+    img->geoloc.elevation = NAN;
+  const void *color_matrix = sqlite3_column_blob(stmt, 22);
+  if(color_matrix)
+    memcpy(img->d65_color_matrix, color_matrix, sizeof(img->d65_color_matrix));
+  else
+    dt_mark_colormatrix_invalid(&img->d65_color_matrix[0]);
+  g_free(img->profile);
+  img->profile = NULL;
+  img->profile_size = 0;
+  img->colorspace = sqlite3_column_int(stmt, 23);
+  img->version = sqlite3_column_int(stmt, 24);
+  img->raw_black_level = sqlite3_column_int(stmt, 25);
+  for(uint8_t i = 0; i < 4; i++) img->raw_black_level_separate[i] = 0;
+  img->raw_white_point = sqlite3_column_int(stmt, 26);
+  if(sqlite3_column_type(stmt, 27) == SQLITE_FLOAT)
+    img->aspect_ratio = sqlite3_column_double(stmt, 27);
+  else
+    img->aspect_ratio = 0.0;
+  if(sqlite3_column_type(stmt, 28) == SQLITE_FLOAT)
+    img->exif_exposure_bias = sqlite3_column_double(stmt, 28);
+  else
+    img->exif_exposure_bias = DT_EXIF_TAG_UNINITIALIZED;
+  img->import_timestamp = sqlite3_column_int64(stmt, 29);
+  img->change_timestamp = sqlite3_column_int64(stmt, 30);
+  img->export_timestamp = sqlite3_column_int64(stmt, 31);
+  img->print_timestamp = sqlite3_column_int64(stmt, 32);
+  img->final_width = sqlite3_column_int(stmt, 33);
+  img->final_height = sqlite3_column_int(stmt, 34);
+
+  // normalized camera names
+  str = (char *)sqlite3_column_text(stmt, 35);
+  if(str) g_strlcpy(img->camera_maker, str, sizeof(img->camera_maker));
+  char *str2 = (char *)sqlite3_column_text(stmt, 36);
+  if(str2) g_strlcpy(img->camera_model, str2, sizeof(img->camera_model));
+  g_snprintf(img->camera_makermodel, sizeof(img->camera_makermodel), "%s %s", str, str2);
+  str = (char *)sqlite3_column_text(stmt, 37);
+  if(str) g_strlcpy(img->camera_alias, str, sizeof(img->camera_alias));
+
+  str = (char *)sqlite3_column_text(stmt, 38);
+  if(str) g_strlcpy(img->exif_whitebalance, str, sizeof(img->exif_whitebalance));
+  str = (char *)sqlite3_column_text(stmt, 39);
+  if(str) g_strlcpy(img->exif_flash, str, sizeof(img->exif_flash));
+  str = (char *)sqlite3_column_text(stmt, 40);
+  if(str) g_strlcpy(img->exif_exposure_program, str, sizeof(img->exif_exposure_program));
+  str = (char *)sqlite3_column_text(stmt, 41);
+  if(str) g_strlcpy(img->exif_metering_mode, str, sizeof(img->exif_metering_mode));
+
+  img->exif_flash_tagvalue = sqlite3_column_int(stmt, 42);
+
+  dt_color_harmony_get(img->id, &img->color_harmony_guide);
+
+  // buffer size? colorspace?
+  if(img->flags & DT_IMAGE_LDR)
+  {
+    img->buf_dsc.channels = 4;
+    img->buf_dsc.datatype = TYPE_FLOAT;
+    img->buf_dsc.cst = IOP_CS_RGB;
+  }
+  else if(img->flags & DT_IMAGE_HDR)
+  {
+    if(img->flags & DT_IMAGE_RAW)
+    {
+      img->buf_dsc.channels = 1;
+      img->buf_dsc.datatype = TYPE_FLOAT;
+      img->buf_dsc.cst = IOP_CS_RAW;
+    }
+    else
+    {
+      img->buf_dsc.channels = 4;
+      img->buf_dsc.datatype = TYPE_FLOAT;
+      img->buf_dsc.cst = IOP_CS_RGB;
+    }
+  }
+  else
+  {
+    // raw
+    img->buf_dsc.channels = 1;
+    img->buf_dsc.datatype = TYPE_UINT16;
+    img->buf_dsc.cst = IOP_CS_RAW;
+  }
+}
+
 static void _image_cache_allocate(void *data,
                                   dt_cache_entry_t *entry)
 {
+  dt_image_cache_t *cache = (dt_image_cache_t *)data;
   entry->cost = sizeof(dt_image_t);
 
-  dt_image_t *img = g_malloc0(sizeof(dt_image_t));
+  // loaded ahead from the last session?
+  dt_pthread_mutex_lock(&cache->warm_mutex);
+  dt_image_t *img = cache->warm
+    ? g_hash_table_lookup(cache->warm, GINT_TO_POINTER(entry->key))
+    : NULL;
+  if(img) g_hash_table_steal(cache->warm, GINT_TO_POINTER(entry->key));
+  dt_pthread_mutex_unlock(&cache->warm_mutex);
+  if(img)
+  {
+    entry->data = img;
+    img->cache_entry = entry;
+    return;
+  }
+
+  img = g_malloc0(sizeof(dt_image_t));
   dt_image_init(img);
   entry->data = img;
   // load stuff from db and store in cache:
-  sqlite3_stmt *stmt;
-  // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
-      "SELECT mi.id, group_id, film_id, width, height, filename,"
-      "       mk.name, md.name, ln.name,"
-      "       exposure, aperture, iso, focal_length, datetime_taken, flags,"
-      "       crop, orientation, focus_distance, raw_parameters,"
-      "       longitude, latitude, altitude, color_matrix, colorspace, version,"
-      "       raw_black, raw_maximum, aspect_ratio, exposure_bias,"
-      "       import_timestamp, change_timestamp, export_timestamp, print_timestamp,"
-      "       output_width, output_height, cm.maker, cm.model, cm.alias,"
-      "       wb.name, fl.name, ep.name, mm.name, flash_tagvalue"
-      "  FROM main.images AS mi"
-      "       LEFT JOIN main.cameras AS cm ON cm.id = mi.camera_id"
-      "       LEFT JOIN main.makers AS mk ON mk.id = mi.maker_id"
-      "       LEFT JOIN main.models AS md ON md.id = mi.model_id"
-      "       LEFT JOIN main.lens AS ln ON ln.id = mi.lens_id"
-      "       LEFT JOIN main.whitebalance AS wb ON wb.id = mi.whitebalance_id"
-      "       LEFT JOIN main.flash AS fl ON fl.id = mi.flash_id"
-      "       LEFT JOIN main.exposure_program AS ep ON ep.id = mi.exposure_program_id"
-      "       LEFT JOIN main.metering_mode AS mm ON mm.id = mi.metering_mode_id"
-      "  WHERE mi.id = ?1",
-      -1, &stmt, NULL);
-  // clang-format on
+  sqlite3_stmt *stmt = dt_database_prepare_cached(darktable.db,
+                                                  DT_IMAGE_CACHE_SELECT " WHERE mi.id = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, entry->key);
 
   if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    img->id = sqlite3_column_int(stmt, 0);
-    img->group_id = sqlite3_column_int(stmt, 1);
-    img->film_id = sqlite3_column_int(stmt, 2);
-    img->p_width = img->width = sqlite3_column_int(stmt, 3);
-    img->p_height = img->height = sqlite3_column_int(stmt, 4);
-    img->crop_x = img->crop_y = img->crop_right = img->crop_bottom = 0;
-    img->filename[0] = img->exif_maker[0] = img->exif_model[0] = img->exif_lens[0] = '\0';
-    dt_datetime_exif_to_img(img, "");
-    char *str;
-    str = (char *)sqlite3_column_text(stmt, 5);
-    if(str) g_strlcpy(img->filename, str, sizeof(img->filename));
-    str = (char *)sqlite3_column_text(stmt, 6);
-    if(str) g_strlcpy(img->exif_maker, str, sizeof(img->exif_maker));
-    str = (char *)sqlite3_column_text(stmt, 7);
-    if(str) g_strlcpy(img->exif_model, str, sizeof(img->exif_model));
-    str = (char *)sqlite3_column_text(stmt, 8);
-    if(str) g_strlcpy(img->exif_lens, str, sizeof(img->exif_lens));
-    img->exif_exposure = sqlite3_column_double(stmt, 9);
-    img->exif_aperture = sqlite3_column_double(stmt, 10);
-    img->exif_iso = sqlite3_column_double(stmt, 11);
-    img->exif_focal_length = sqlite3_column_double(stmt, 12);
-    img->exif_datetime_taken = sqlite3_column_int64(stmt, 13);
-    img->flags = sqlite3_column_int(stmt, 14);
-    img->loader = LOADER_UNKNOWN;
-    img->exif_crop = sqlite3_column_double(stmt, 15);
-    img->orientation = sqlite3_column_int(stmt, 16);
-    img->exif_focus_distance = sqlite3_column_double(stmt, 17);
-    if(img->exif_focus_distance >= 0 && img->orientation >= 0) img->exif_inited = TRUE;
-    uint32_t tmp = sqlite3_column_int(stmt, 18);
-    memcpy(&img->legacy_flip, &tmp, sizeof(dt_image_raw_parameters_t));
-    if(sqlite3_column_type(stmt, 19) == SQLITE_FLOAT)
-      img->geoloc.longitude = sqlite3_column_double(stmt, 19);
-    else
-      img->geoloc.longitude = NAN;
-    if(sqlite3_column_type(stmt, 20) == SQLITE_FLOAT)
-      img->geoloc.latitude = sqlite3_column_double(stmt, 20);
-    else
-      img->geoloc.latitude = NAN;
-    if(sqlite3_column_type(stmt, 21) == SQLITE_FLOAT)
-      img->geoloc.elevation = sqlite3_column_double(stmt, 21);
-    else
-      img->geoloc.elevation = NAN;
-    const void *color_matrix = sqlite3_column_blob(stmt, 22);
-    if(color_matrix)
-      memcpy(img->d65_color_matrix, color_matrix, sizeof(img->d65_color_matrix));
-    else
-      dt_mark_colormatrix_invalid(&img->d65_color_matrix[0]);
-    g_free(img->profile);
-    img->profile = NULL;
-    img->profile_size = 0;
-    img->colorspace = sqlite3_column_int(stmt, 23);
-    img->version = sqlite3_column_int(stmt, 24);
-    img->raw_black_level = sqlite3_column_int(stmt, 25);
-    for(uint8_t i = 0; i < 4; i++) img->raw_black_level_separate[i] = 0;
-    img->raw_white_point = sqlite3_column_int(stmt, 26);
-    if(sqlite3_column_type(stmt, 27) == SQLITE_FLOAT)
-      img->aspect_ratio = sqlite3_column_double(stmt, 27);
-    else
-      img->aspect_ratio = 0.0;
-    if(sqlite3_column_type(stmt, 28) == SQLITE_FLOAT)
-      img->exif_exposure_bias = sqlite3_column_double(stmt, 28);
-    else
-      img->exif_exposure_bias = DT_EXIF_TAG_UNINITIALIZED;
-    img->import_timestamp = sqlite3_column_int64(stmt, 29);
-    img->change_timestamp = sqlite3_column_int64(stmt, 30);
-    img->export_timestamp = sqlite3_column_int64(stmt, 31);
-    img->print_timestamp = sqlite3_column_int64(stmt, 32);
-    img->final_width = sqlite3_column_int(stmt, 33);
-    img->final_height = sqlite3_column_int(stmt, 34);
-
-    // normalized camera names
-    str = (char *)sqlite3_column_text(stmt, 35);
-    if(str) g_strlcpy(img->camera_maker, str, sizeof(img->camera_maker));
-    char *str2 = (char *)sqlite3_column_text(stmt, 36);
-    if(str2) g_strlcpy(img->camera_model, str2, sizeof(img->camera_model));
-    g_snprintf(img->camera_makermodel, sizeof(img->camera_makermodel), "%s %s", str, str2);
-    str = (char *)sqlite3_column_text(stmt, 37);
-    if(str) g_strlcpy(img->camera_alias, str, sizeof(img->camera_alias));
-
-    str = (char *)sqlite3_column_text(stmt, 38);
-    if(str) g_strlcpy(img->exif_whitebalance, str, sizeof(img->exif_whitebalance));
-    str = (char *)sqlite3_column_text(stmt, 39);
-    if(str) g_strlcpy(img->exif_flash, str, sizeof(img->exif_flash));
-    str = (char *)sqlite3_column_text(stmt, 40);
-    if(str) g_strlcpy(img->exif_exposure_program, str, sizeof(img->exif_exposure_program));
-    str = (char *)sqlite3_column_text(stmt, 41);
-    if(str) g_strlcpy(img->exif_metering_mode, str, sizeof(img->exif_metering_mode));
-
-    img->exif_flash_tagvalue = sqlite3_column_int(stmt, 42);
-
-    dt_color_harmony_get(entry->key, &img->color_harmony_guide);
-
-    // buffer size? colorspace?
-    if(img->flags & DT_IMAGE_LDR)
-    {
-      img->buf_dsc.channels = 4;
-      img->buf_dsc.datatype = TYPE_FLOAT;
-      img->buf_dsc.cst = IOP_CS_RGB;
-    }
-    else if(img->flags & DT_IMAGE_HDR)
-    {
-      if(img->flags & DT_IMAGE_RAW)
-      {
-        img->buf_dsc.channels = 1;
-        img->buf_dsc.datatype = TYPE_FLOAT;
-        img->buf_dsc.cst = IOP_CS_RAW;
-      }
-      else
-      {
-        img->buf_dsc.channels = 4;
-        img->buf_dsc.datatype = TYPE_FLOAT;
-        img->buf_dsc.cst = IOP_CS_RGB;
-      }
-    }
-    else
-    {
-      // raw
-      img->buf_dsc.channels = 1;
-      img->buf_dsc.datatype = TYPE_UINT16;
-      img->buf_dsc.cst = IOP_CS_RAW;
-    }
-  }
+    _image_cache_read_row(img, stmt);
   else
   {
     img->id = NO_IMGID;
@@ -195,7 +216,7 @@ static void _image_cache_allocate(void *data,
              "[image_cache_allocate] failed to open image %" PRIu32 " from database: %s",
              entry->key, sqlite3_errmsg(dt_database_get(darktable.db)));
   }
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
   img->cache_entry = entry; // init backref
   // could downgrade lock write->read on entry->lock if we were using
   // concurrencykit..
@@ -204,12 +225,133 @@ static void _image_cache_allocate(void *data,
 static void _image_cache_deallocate(void *data, dt_cache_entry_t *entry)
 {
   dt_image_t *img = entry->data;
+  if(img->raw_buffer) g_bytes_unref(img->raw_buffer);
   g_free(img->profile);
   g_list_free_full(img->dng_gain_maps, g_free);
   g_free(img);
   entry->data = NULL;
 }
 
+// the ids of the most recently used images are saved on exit and their
+// rows loaded back in a few batched queries on the next start. only ids
+// are kept, the data always comes from the library.
+#define DT_IMAGE_CACHE_WARM_MAGIC 0x57434944u // "DICW"
+#define DT_IMAGE_CACHE_WARM_BATCH 500
+
+static gchar *_image_cache_warm_filename(void)
+{
+  const gchar *dbfilename = dt_database_get_path(darktable.db);
+  if(!dbfilename || !strcmp(dbfilename, ":memory:")) return NULL;
+
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  gchar *abspath = g_realpath(dbfilename);
+  gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, abspath ? abspath : dbfilename, -1);
+  gchar *filename = g_strdup_printf("%s/images-%s.warm", cachedir, hash);
+  g_free(hash);
+  g_free(abspath);
+  return filename;
+}
+
+static void _image_cache_warm_load(dt_image_cache_t *cache,
+                                   const int max)
+{
+  gchar *filename = _image_cache_warm_filename();
+  if(!filename) return;
+
+  gchar *data = NULL;
+  gsize length = 0;
+  const gboolean found = g_file_get_contents(filename, &data, &length, NULL);
+  g_free(filename);
+  if(!found) return;
+
+  const uint32_t *header = (const uint32_t *)data;
+  const int32_t *ids = (const int32_t *)(data + 2 * sizeof(uint32_t));
+  if(length < 2 * sizeof(uint32_t)
+     || header[0] != DT_IMAGE_CACHE_WARM_MAGIC
+     || length != 2 * sizeof(uint32_t) + (gsize)header[1] * sizeof(int32_t))
+  {
+    g_free(data);
+    return;
+  }
+
+  const double start = dt_get_wtime();
+  const int count = MIN((int)header[1], max);
+  cache->warm = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+  for(int b = 0; b < count; b += DT_IMAGE_CACHE_WARM_BATCH)
+  {
+    GString *list = g_string_new(NULL);
+    for(int k = b; k < MIN(count, b + DT_IMAGE_CACHE_WARM_BATCH); k++)
+      g_string_append_printf(list, "%s%d", k > b ? "," : "", ids[k]);
+
+    sqlite3_stmt *stmt;
+    gchar *query = g_strdup_printf(DT_IMAGE_CACHE_SELECT " WHERE mi.id IN (%s)", list->str);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      dt_image_t *img = g_malloc0(sizeof(dt_image_t));
+      dt_image_init(img);
+      _image_cache_read_row(img, stmt);
+      g_hash_table_insert(cache->warm, GINT_TO_POINTER(img->id), img);
+    }
+    sqlite3_finalize(stmt);
+    g_free(query);
+    g_string_free(list, TRUE);
+  }
+  g_free(data);
+
+  dt_print(DT_DEBUG_CACHE, "[image_cache] loaded %u images of the last session in %.3fs",
+           g_hash_table_size(cache->warm), dt_get_wtime() - start);
+}
+
+static void _image_cache_warm_save(dt_image_cache_t *cache,
+                                   const int max)
+{
+  gchar *filename = _image_cache_warm_filename();
+  if(!filename) return;
+  if(max <= 0)
+  {
+    g_unlink(filename);
+    g_free(filename);
+    return;
+  }
+
+  // no global lru order across the shards, take the newest of each
+  GArray *ids = g_array_new(FALSE, FALSE, sizeof(int32_t));
+  const int per_shard = (max + DT_CACHE_SHARDS - 1) / DT_CACHE_SHARDS;
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+  {
+    dt_cache_shard_t *shard = &cache->cache.shard[k];
+    dt_pthread_mutex_lock(&shard->lock);
+    int n = 0;
+    for(GList *l = shard->lru.tail; l && n < per_shard; l = g_list_previous(l))
+    {
+      const dt_cache_entry_t *entry = l->data;
+      const dt_image_t *img = entry->data;
+      if(!img || !dt_is_valid_imgid(img->id)) continue;
+      g_array_append_val(ids, img->id);
+      n++;
+    }
+    dt_pthread_mutex_unlock(&shard->lock);
+  }
+
+  const uint32_t header[2] = { DT_IMAGE_CACHE_WARM_MAGIC, ids->len };
+  FILE *f = g_fopen(filename, "wb");
+  if(!f
+     || fwrite(header, sizeof(header), 1, f) != 1
+     || fwrite(ids->data, sizeof(int32_t), ids->len, f) != ids->len)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[image_cache] could not write `%s'", filename);
+    if(f) fclose(f);
+    g_unlink(filename);
+  }
+  else
+    fclose(f);
+
+  g_array_free(ids, TRUE);
+  g_free(filename);
+}
+
 void dt_image_cache_init()
 {
   dt_image_cache_t *cache = darktable.image_cache = calloc(1, sizeof(dt_image_cache_t));
@@ -224,6 +366,10 @@ void dt_image_cache_init()
   dt_cache_init(&cache->cache, sizeof(dt_image_t), max_mem);
   dt_cache_set_allocate_callback(&cache->cache, &_image_cache_allocate, cache);
   dt_cache_set_cleanup_callback(&cache->cache, &_image_cache_deallocate, cache);
+  dt_pthread_mutex_init(&cache->warm_mutex, NULL);
+
+  const int warm = MIN(dt_conf_get_int("cache_image_warm_start"), num / 2);
+  if(warm > 0) _image_cache_warm_load(cache, warm);
 
   dt_print(DT_DEBUG_CACHE, "[image_cache] has %d entries", num);
 }
@@ -234,10 +380,13 @@ void dt_image_cache_cleanup()
   if(!cache) return;
   dt_print(DT_DEBUG_CACHE,
            "[image cache cleaup report] fill %.2f/%.2f MB (%.2f%%)",
-           cache->cache.cost / (1024.0 * 1024.0),
+           dt_cache_cost(&cache->cache) / (1024.0 * 1024.0),
            cache->cache.cost_quota / (1024.0 * 1024.0),
-           (float)cache->cache.cost / (float)cache->cache.cost_quota);
+           (float)dt_cache_cost(&cache->cache) / (float)cache->cache.cost_quota);
+  _image_cache_warm_save(cache, dt_conf_get_int("cache_image_warm_start"));
   dt_cache_cleanup(&cache->cache);
+  if(cache->warm) g_hash_table_destroy(cache->warm);
+  dt_pthread_mutex_destroy(&cache->warm_mutex);
   free(cache);
   darktable.image_cache = NULL;
 }
@@ -291,50 +440,17 @@ void dt_image_cache_read_release(const dt_image_t *img)
   if(cache) dt_cache_release(&cache->cache, img->cache_entry);
 }
 
-// drops the write privileges on an image struct.
-// this triggers a write-through to sql, and if
-// a) mode == DT_IMAGE_CACHE_SAFE
-// b) sidecar writing is desired via conf setting
-// also to xmp sidecar files.
-void dt_image_cache_write_release_info(dt_image_t *img,
-                                       const dt_image_cache_write_mode_t mode,
-                                       const char *info)
+static void _image_cache_write_db(const dt_image_t *img,
+                                  const char *info)
 {
-  if(!img)  // nothing to release
-    return;
-
-  dt_image_cache_t *cache = darktable.image_cache;
-  assert(cache);
-
-  if(!dt_is_valid_imgid(img->id))
-  {
-    dt_cache_release(&cache->cache, img->cache_entry);
-    dt_print(DT_DEBUG_ALWAYS,
-             "[image_cache_write_release] from `%s`. FATAL invalid image id %d",
-             info, img->id);
-    return;
-  }
-
-  const double start = dt_get_debug_wtime();
   union {
       struct dt_image_raw_parameters_t s;
       uint32_t u;
   } flip;
 
-  if(img->aspect_ratio < .0001)
-  {
-    if(img->orientation < ORIENTATION_SWAP_XY)
-      img->aspect_ratio = (float )img->width / (float )(MAX(1, img->height));
-    else
-      img->aspect_ratio = (float )img->height / (float )(MAX(1, img->width));
-  }
-
-  img->aspect_ratio = dt_usable_aspect(img->aspect_ratio);
-
-  sqlite3_stmt *stmt;
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
      "UPDATE main.images"
      " SET width = ?1, height = ?2, filename = ?3,"
      "     maker_id = ?4, model_id = ?5, lens_id = ?6, camera_id = ?35,"
@@ -348,8 +464,7 @@ void dt_image_cache_write_release_info(dt_image_t *img,
      "     print_timestamp = ?31, output_width = ?32, output_height = ?33,"
      "     whitebalance_id = ?36, flash_id = ?37,"
      "     exposure_program_id = ?38, metering_mode_id = ?39, flash_tagvalue = ?41"
-     " WHERE id = ?40",
-     -1, &stmt, NULL);
+     " WHERE id = ?40");
 
   const int32_t maker_id = dt_image_get_camera_maker_id(img->exif_maker);
   const int32_t model_id = dt_image_get_camera_model_id(img->exif_model);
@@ -423,10 +538,141 @@ void dt_image_cache_write_release_info(dt_image_t *img,
              rc,
              sqlite3_errmsg(dt_database_get(darktable.db)),
              img->id);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
+}
+
+// write releases of a thread inside dt_image_cache_write_back_begin/end
+// are kept here, one per image, and written in one transaction. the queue
+// is flushed early when it grows, so the images still are in the cache
+// (and not reloaded from the stale database rows) when released again.
+#define DT_IMAGE_CACHE_WRITE_BACK_MAX 1000
+
+typedef struct _write_back_t
+{
+  dt_image_t img; // without the pointers owned by the cache entry
+  gboolean xmp;
+} _write_back_t;
+
+static __thread int _write_back_depth = 0;
+static __thread GHashTable *_write_back_pending = NULL;
+
+static void _write_back_flush(void)
+{
+  if(!_write_back_pending) return;
+  const guint count = g_hash_table_size(_write_back_pending);
+  if(!count) return;
+
+  const double start = dt_get_debug_wtime();
+  GList *xmps = NULL;
+  dt_database_start_transaction(darktable.db);
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, _write_back_pending);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+  {
+    const _write_back_t *wb = value;
+    _image_cache_write_db(&wb->img, "write back");
+    if(wb->xmp) xmps = g_list_prepend(xmps, GINT_TO_POINTER(wb->img.id));
+  }
+  dt_database_release_transaction(darktable.db);
+  g_hash_table_remove_all(_write_back_pending);
+
+  // the sidecars are written by the background job if it runs
+  dt_image_synch_xmps(xmps);
+  g_list_free(xmps);
+
+  dt_print(DT_DEBUG_CACHE, "[image_cache] wrote back %u images in %.3fs",
+           count, dt_get_debug_wtime() - start);
+}
+
+static void _write_back_queue(const dt_image_t *img,
+                              const dt_image_cache_write_mode_t mode)
+{
+  if(!_write_back_pending)
+    _write_back_pending = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+
+  _write_back_t *wb = g_hash_table_lookup(_write_back_pending, GINT_TO_POINTER(img->id));
+  if(!wb)
+  {
+    wb = g_malloc0(sizeof(_write_back_t));
+    g_hash_table_insert(_write_back_pending, GINT_TO_POINTER(img->id), wb);
+  }
+  wb->img = *img;
+  wb->img.profile = NULL;
+  wb->img.dng_gain_maps = NULL;
+  wb->img.raw_buffer = NULL;
+  wb->img.cache_entry = NULL;
+  wb->xmp |= mode == DT_IMAGE_CACHE_SAFE;
+
+  if(g_hash_table_size(_write_back_pending) >= DT_IMAGE_CACHE_WRITE_BACK_MAX)
+    _write_back_flush();
+}
+
+void dt_image_cache_write_back_begin(void)
+{
+  _write_back_depth++;
+}
 
-  if(mode == DT_IMAGE_CACHE_SAFE)
-    dt_image_synch_xmp(img->id);
+void dt_image_cache_write_back_end(void)
+{
+  if(_write_back_depth <= 0)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[image_cache] write back end without begin");
+    return;
+  }
+  if(--_write_back_depth == 0)
+  {
+    _write_back_flush();
+    g_clear_pointer(&_write_back_pending, g_hash_table_destroy);
+  }
+}
+
+// drops the write privileges on an image struct.
+// this triggers a write-through to sql, and if
+// a) mode == DT_IMAGE_CACHE_SAFE
+// b) sidecar writing is desired via conf setting
+// also to xmp sidecar files.
+void dt_image_cache_write_release_info(dt_image_t *img,
+                                       const dt_image_cache_write_mode_t mode,
+                                       const char *info)
+{
+  if(!img)  // nothing to release
+    return;
+
+  dt_image_cache_t *cache = darktable.image_cache;
+  assert(cache);
+
+  if(!dt_is_valid_imgid(img->id))
+  {
+    dt_cache_release(&cache->cache, img->cache_entry);
+    dt_print(DT_DEBUG_ALWAYS,
+             "[image_cache_write_release] from `%s`. FATAL invalid image id %d",
+             info, img->id);
+    return;
+  }
+
+  const double start = dt_get_debug_wtime();
+  if(img->aspect_ratio < .0001)
+  {
+    if(img->orientation < ORIENTATION_SWAP_XY)
+      img->aspect_ratio = (float )img->width / (float )(MAX(1, img->height));
+    else
+      img->aspect_ratio = (float )img->height / (float )(MAX(1, img->width));
+  }
+
+  img->aspect_ratio = dt_usable_aspect(img->aspect_ratio);
+
+  if(_write_back_depth > 0)
+  {
+    // coalesced and written by dt_image_cache_write_back_end()
+    _write_back_queue(img, mode);
+  }
+  else
+  {
+    _image_cache_write_db(img, info);
+    if(mode == DT_IMAGE_CACHE_SAFE)
+      dt_image_synch_xmp(img->id);
+  }
 
   dt_cache_release(&cache->cache, img->cache_entry);
 
@@ -448,7 +694,11 @@ void dt_image_cache_write_release(dt_image_t *img, const dt_image_cache_write_mo
 void dt_image_cache_remove(const dt_imgid_t imgid)
 {
   dt_image_cache_t *cache = darktable.image_cache;
-  if(cache) dt_cache_remove(&cache->cache, imgid);
+  if(!cache) return;
+  dt_pthread_mutex_lock(&cache->warm_mutex);
+  if(cache->warm) g_hash_table_remove(cache->warm, GINT_TO_POINTER(imgid));
+  dt_pthread_mutex_unlock(&cache->warm_mutex);
+  dt_cache_remove(&cache->cache, imgid);
 }
 
 /* set timestamps */
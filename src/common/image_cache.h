@@ -26,6 +26,11 @@ G_BEGIN_DECLS
 typedef struct dt_image_cache_t
 {
   dt_cache_t cache;
+
+  // images of the last session loaded ahead at startup, taken over by
+  // the cache on their first get
+  dt_pthread_mutex_t warm_mutex;
+  GHashTable *warm; // imgid -> dt_image_t
 }
 dt_image_cache_t;
 
@@ -68,6 +73,13 @@ void dt_image_cache_write_release_info(dt_image_t *img,
                                        const dt_image_cache_write_mode_t mode,
                                        const char *info);
 
+// write releases of this thread until the matching end are coalesced per
+// image and written to the database in one transaction, and the sidecars
+// of the DT_IMAGE_CACHE_SAFE ones are then queued. use around loops writing
+// many images. calls can be nested.
+void dt_image_cache_write_back_begin(void);
+void dt_image_cache_write_back_end(void);
+
 // remove the image from the cache
 void dt_image_cache_remove(const dt_imgid_t imgid);
 
@@ -22,6 +22,167 @@
 static size_t parallel_imgop_minimum = 500000;
 static size_t parallel_imgop_maxthreads = 4;
 
+// a thread's pool keeps up to this many buffers between images
+#define DT_SCRATCH_POOL_SLOTS 32
+
+typedef struct _scratch_slot_t
+{
+  void *mem;
+  size_t size;
+  gboolean busy;
+  uint32_t generation; // the image the buffer was last handed out for
+} _scratch_slot_t;
+
+typedef struct dt_scratch_pool_t
+{
+  _scratch_slot_t slot[DT_SCRATCH_POOL_SLOTS];
+  int count;
+  int depth;
+  uint32_t generation;
+  size_t keep; // idle bytes kept, during and between runs
+  size_t idle; // bytes of the idle buffers
+  uint64_t reused, allocated;
+} dt_scratch_pool_t;
+
+__thread dt_scratch_pool_t *dt_scratch_pool = NULL;
+
+static void _scratch_pool_free(gpointer data)
+{
+  dt_scratch_pool_t *pool = data;
+  for(int k = 0; k < pool->count; k++)
+    if(!pool->slot[k].busy) dt_free_align(pool->slot[k].mem);
+  free(pool);
+}
+
+// free an idle buffer and give its slot to the last one
+static void _scratch_pool_drop(dt_scratch_pool_t *pool, const int k)
+{
+  pool->idle -= pool->slot[k].size;
+  dt_free_align(pool->slot[k].mem);
+  pool->slot[k] = pool->slot[--pool->count];
+}
+
+// the pool of this thread, kept while it is not active and freed on thread exit
+static GPrivate _thread_pool = G_PRIVATE_INIT(_scratch_pool_free);
+
+void dt_scratch_pool_begin(const size_t keep)
+{
+  dt_scratch_pool_t *pool = g_private_get(&_thread_pool);
+  if(!pool)
+  {
+    pool = calloc(1, sizeof(dt_scratch_pool_t));
+    if(!pool) return;
+    g_private_set(&_thread_pool, pool);
+  }
+
+  if(pool->depth == 0) pool->keep = keep;
+  pool->depth++;
+  dt_scratch_pool = pool;
+}
+
+void dt_scratch_pool_end(void)
+{
+  dt_scratch_pool_t *pool = g_private_get(&_thread_pool);
+  if(!pool || --pool->depth > 0) return;
+  dt_scratch_pool = NULL;
+
+  // buffers still busy escaped the pool, forget them. idle buffers not
+  // needed by this image, or beyond the budget, are freed so the pool
+  // follows the working set.
+  int keep = 0;
+  size_t kept = 0;
+  for(int k = 0; k < pool->count; k++)
+  {
+    _scratch_slot_t *slot = &pool->slot[k];
+    if(slot->busy) continue;
+    if(slot->generation != pool->generation || kept + slot->size > pool->keep)
+    {
+      dt_free_align(slot->mem);
+      continue;
+    }
+    kept += slot->size;
+    pool->slot[keep++] = *slot;
+  }
+  pool->count = keep;
+  pool->idle = kept;
+
+  dt_print(DT_DEBUG_MEMORY, "[dt_scratch_pool_end] keeping %i buffers, %" PRIu64 " reused, %" PRIu64 " allocated",
+           pool->count, pool->reused, pool->allocated);
+  pool->generation++;
+}
+
+void *dt_scratch_pool_alloc(const size_t size)
+{
+  dt_scratch_pool_t *pool = dt_scratch_pool;
+  if(!pool)
+  {
+    void *mem = dt_alloc_aligned(size);
+    dt_alloc_first_touch(mem, size);
+    return mem;
+  }
+
+  // best fitting idle buffer not wasting more than a quarter
+  int best = -1;
+  for(int k = 0; k < pool->count; k++)
+  {
+    const _scratch_slot_t *slot = &pool->slot[k];
+    if(!slot->busy && slot->size >= size && slot->size <= size + size / 4
+       && (best < 0 || slot->size < pool->slot[best].size))
+      best = k;
+  }
+  if(best >= 0)
+  {
+    pool->slot[best].busy = TRUE;
+    pool->slot[best].generation = pool->generation;
+    pool->idle -= pool->slot[best].size;
+    pool->reused++;
+    return pool->slot[best].mem;
+  }
+
+  // all slots taken, make room by freeing an idle buffer that didn't fit
+  if(pool->count == DT_SCRATCH_POOL_SLOTS)
+  {
+    for(int k = 0; k < pool->count; k++)
+    {
+      if(!pool->slot[k].busy)
+      {
+        _scratch_pool_drop(pool, k);
+        break;
+      }
+    }
+  }
+
+  void *mem = dt_alloc_aligned(size);
+  dt_alloc_first_touch(mem, size);
+  if(mem && pool->count < DT_SCRATCH_POOL_SLOTS)
+  {
+    pool->slot[pool->count++] = (_scratch_slot_t){ mem, size, TRUE, pool->generation };
+    pool->allocated++;
+  }
+  return mem;
+}
+
+gboolean dt_scratch_pool_release(void *mem)
+{
+  dt_scratch_pool_t *pool = dt_scratch_pool;
+  if(!pool || !mem) return FALSE;
+
+  for(int k = 0; k < pool->count; k++)
+  {
+    if(pool->slot[k].mem == mem && pool->slot[k].busy)
+    {
+      // idle buffers are counted against the keep budget, beyond it they
+      // are freed right away
+      pool->slot[k].busy = FALSE;
+      pool->idle += pool->slot[k].size;
+      if(pool->idle > pool->keep)
+        _scratch_pool_drop(pool, k);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
 // Allocate one or more buffers as detailed in the given parameters.
 // If any allocation fails, free all of them, set the module's trouble
 // flag, and return FALSE.
@@ -89,12 +250,17 @@ gboolean dt_iop_alloc_image_buffers(struct dt_iop_module_t *const module,
     if(size & DT_IMGSZ_PERTHREAD)
     {
       *bufptr = dt_alloc_perthread_float(nfloats,paddedsize);
+      // the thread slices are in order, so the static page split of the
+      // first touch puts each slice close to its thread. a pooled buffer
+      // got that when it was allocated.
+      if(!dt_scratch_pool)
+        dt_alloc_first_touch(*bufptr, *paddedsize * dt_get_num_threads() * sizeof(float));
       if((size & DT_IMGSZ_CLEARBUF) && *bufptr)
         memset(*bufptr, 0, *paddedsize * dt_get_num_threads() * sizeof(float));
     }
     else
     {
-      *bufptr = dt_alloc_align_float(nfloats);
+      *bufptr = dt_scratch_pool_alloc(nfloats * sizeof(float));
       if((size & DT_IMGSZ_CLEARBUF) && *bufptr)
         memset(*bufptr, 0, nfloats * sizeof(float));
     }
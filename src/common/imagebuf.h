@@ -22,12 +22,15 @@
 G_BEGIN_DECLS
 
 // Allocate a 64-byte aligned buffer for an image of the given dimensions and channels.
+// The pages are first touched in parallel for NUMA placement.
 // The return value must be freed with dt_free_align().
 static inline float *__restrict__ dt_iop_image_alloc(const size_t width,
                                                      const size_t height,
                                                      const size_t ch)
 {
-  return dt_alloc_align_float(width * height * ch);
+  float *buf = dt_alloc_align_float(width * height * ch);
+  dt_alloc_first_touch(buf, width * height * ch * sizeof(float));
+  return buf;
 }
 
 // Allocate one or more buffers as detailed in the given parameters.
@@ -41,6 +44,15 @@ static inline float *__restrict__ dt_iop_image_alloc(const size_t width,
 gboolean dt_iop_alloc_image_buffers(struct dt_iop_module_t *const module,
                                     const struct dt_iop_roi_t *const roi_in,
                                     const struct dt_iop_roi_t *const roi_out, ...);
+
+// While a pipe runs on a thread, the buffers of dt_iop_alloc_image_buffers() and
+// dt_alloc_perthread() come from a per-thread pool and dt_free_align() returns them
+// there, so the next run reuses them instead of allocating again. Idle buffers never
+// exceed the keep bytes given to the outermost begin, returning one beyond that frees
+// it. Calls nest, the outermost end also frees the pooled buffers the run didn't use.
+void dt_scratch_pool_begin(const size_t keep);
+void dt_scratch_pool_end(void);
+
 // Optional flags to add to size request.  Default is to allocate N channels per pixel according to
 // the dimensions of roi_out
 #define DT_IMGSZ_CH_MASK    0x000FFFF  // isolate just the number of floats per pixel
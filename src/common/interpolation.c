@@ -24,6 +24,7 @@
 #include <assert.h>
 #include <glib.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -1008,6 +1009,35 @@ static gboolean _prepare_resampling_plan(const dt_interpolation_t *itor,
   return FALSE;
 }
 
+/** Number of rows of the ring of horizontally resampled input lines
+ *
+ * The horizontal pass over an input line is the same for all the output
+ * lines it contributes to, so the resamplers below run it once per line
+ * into a per-thread ring of lines, indexed by input line modulo the ring
+ * size. The ring has to hold all the lines of any vertical window at once.
+ */
+static int _resampling_ring_rows(const int *const vlength,
+                                 const int *const vindex,
+                                 const int *const vmeta,
+                                 const int out)
+{
+  int rows = 1;
+  for(int oy = 0; oy < out; oy++)
+  {
+    const int vl = vlength[vmeta[3 * oy + 0]];
+    const int *const lines = vindex + vmeta[3 * oy + 2];
+    int first = INT_MAX;
+    int last = INT_MIN;
+    for(int iy = 0; iy < vl; iy++)
+    {
+      first = MIN(first, lines[iy]);
+      last = MAX(last, lines[iy]);
+    }
+    if(vl > 0) rows = MAX(rows, last - first + 1);
+  }
+  return rows;
+}
+
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
@@ -1030,6 +1060,10 @@ void dt_interpolation_resample(const dt_interpolation_t *itor,
   int *vlength = NULL;
   float *vkernel = NULL;
   int *vmeta = NULL;
+  float *ring = NULL;
+  int *ringtags = NULL;
+  size_t ring_padded = 0;
+  size_t tags_padded = 0;
 
   const size_t in_stride_floats = roi_in->width * 4;
   const size_t out_stride_floats = roi_out->width * 4;
@@ -1086,75 +1120,79 @@ void dt_interpolation_resample(const dt_interpolation_t *itor,
                               &vlength, &vkernel, &vindex, &vmeta))
     goto exit;
 
+  // one ring of horizontally resampled lines per thread, followed by the
+  // accumulator of the output line
+  const int ringrows = _resampling_ring_rows(vlength, vindex, vmeta, roi_out->height);
+  ring = dt_alloc_perthread_float((ringrows + 1) * out_stride_floats, &ring_padded);
+  ringtags = dt_alloc_perthread(ringrows, sizeof(int), &tags_padded);
+  if(!ring || !ringtags)
+    goto exit;
+  for(size_t k = 0; k < tags_padded * dt_get_num_threads(); k++)
+    ringtags[k] = -1;
+
   dt_get_perf_times(&mid);
 
   // Process each output line
   DT_OMP_FOR()
   for(size_t oy = 0; oy < (size_t)roi_out->height; oy++)
   {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
-
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
+    float *const lines = dt_get_perthread(ring, ring_padded);
+    int *const tags = dt_get_perthread(ringtags, tags_padded);
+    float *const vs = lines + (size_t)ringrows * out_stride_floats;
 
-    // Number of lines contributing to the output line
-    int vl = vlength[vlidx++]; // V(ertical) L(ength)
+    // Number of lines contributing to the output line, their indexes and taps
+    const int vl = vlength[vmeta[3 * oy + 0]];
+    const float *const vtaps = vkernel + vmeta[3 * oy + 1];
+    const int *const vlines = vindex + vmeta[3 * oy + 2];
 
-    // Process each output column
-    for(size_t ox = 0; ox < (size_t)roi_out->width; ox++)
+    memset(vs, 0, sizeof(float) * out_stride_floats);
+    for(int iy = 0; iy < vl; iy++)
     {
-      // This will hold the resulting pixel
-      dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-      // Number of horizontal samples contributing to the output
-      int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for(size_t iy = 0; iy < vl; iy++)
+      // This is our input line, resample it horizontally unless the ring
+      // already holds it
+      const int line = vlines[iy];
+      const int slot = line % ringrows;
+      float *const vhs = lines + (size_t)slot * out_stride_floats;
+      if(tags[slot] != line)
       {
-        // This is our input line
-        size_t baseidx_vindex = (size_t)vindex[viidx++] * in_stride_floats;
-
-        dt_aligned_pixel_t vhs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-        for(size_t ix = 0; ix < hl; ix++)
+        tags[slot] = line;
+        const float *const i = in + (size_t)line * in_stride_floats;
+        int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
+        for(size_t ox = 0; ox < (size_t)roi_out->width; ox++)
         {
-          // Apply the precomputed filter kernel
-          const size_t baseidx = baseidx_vindex + (size_t)hindex[hkidx] * 4;
-          const float htap = hkernel[hkidx++];
-          dt_aligned_pixel_t tmp;
-          copy_pixel(tmp, in + baseidx);
-          for_each_channel(c, aligned(tmp,vhs:16))
-            vhs[c] += tmp[c] * htap;
+          // Number of horizontal samples contributing to the output
+          const int hl = hlength[ox]; // H(orizontal) L(ength)
+          dt_aligned_pixel_t hs = { 0.0f, 0.0f, 0.0f, 0.0f };
+          for(int ix = 0; ix < hl; ix++)
+          {
+            // Apply the precomputed filter kernel
+            const float htap = hkernel[hkidx];
+            dt_aligned_pixel_t tmp;
+            copy_pixel(tmp, i + (size_t)hindex[hkidx++] * 4);
+            for_each_channel(c, aligned(tmp,hs:16))
+              hs[c] += tmp[c] * htap;
+          }
+          copy_pixel(vhs + ox * 4, hs);
         }
-
-        // Accumulate contribution from this line
-        const float vtap = vkernel[vkidx++];
-        for_each_channel(c, aligned(vhs,vs:16)) vs[c] += vhs[c] * vtap;
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
       }
 
-      // Output pixel is ready
-      const size_t baseidx = (size_t)oy * out_stride_floats + (size_t)ox * 4;
+      // Accumulate contribution from this line
+      const float vtap = vtaps[iy];
+      DT_OMP_SIMD()
+      for(size_t k = 0; k < out_stride_floats; k++)
+        vs[k] += vhs[k] * vtap;
+    }
 
+    // Output line is ready
+    float *const o = out + (size_t)oy * out_stride_floats;
+    for(size_t ox = 0; ox < (size_t)roi_out->width; ox++)
+    {
       // Clip negative RGB that may be produced by Lanczos undershooting
       // Negative RGB are invalid values no matter the RGB space (light is positive)
       dt_aligned_pixel_t pixel;
       for_each_channel(c, aligned(vs:16))
-        pixel[c] = MAX(vs[c], 0.f);
-      copy_pixel_nontemporal(out + baseidx, pixel);
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hkidx += hl;
+        pixel[c] = MAX(vs[ox * 4 + c], 0.f);
+      copy_pixel_nontemporal(o + ox * 4, pixel);
     }
   }
   dt_omploop_sfence();
@@ -1165,6 +1203,8 @@ exit:
    * allocated. */
   dt_free_align(hlength);
   dt_free_align(vlength);
+  dt_free_align(ring);
+  dt_free_align(ringtags);
   _show_2_times(&start, &mid, "resample_plain");
 }
 
@@ -1450,6 +1490,10 @@ void dt_interpolation_resample_1c(const dt_interpolation_t *itor,
   int *vlength = NULL;
   float *vkernel = NULL;
   int *vmeta = NULL;
+  float *ring = NULL;
+  int *ringtags = NULL;
+  size_t ring_padded = 0;
+  size_t tags_padded = 0;
 
   dt_times_t start = { 0 }, mid = { 0 };
   dt_get_perf_times(&start);
@@ -1510,71 +1554,73 @@ void dt_interpolation_resample_1c(const dt_interpolation_t *itor,
     goto exit;
   }
 
+  // one ring of horizontally resampled lines per thread, followed by the
+  // accumulator of the output line, see _resampling_ring_rows()
+  const size_t out_width = roi_out->width;
+  const int ringrows = _resampling_ring_rows(vlength, vindex, vmeta, roi_out->height);
+  ring = dt_alloc_perthread_float((ringrows + 1) * out_width, &ring_padded);
+  ringtags = dt_alloc_perthread(ringrows, sizeof(int), &tags_padded);
+  if(!ring || !ringtags)
+  {
+    error = TRUE;
+    goto exit;
+  }
+  for(size_t k = 0; k < tags_padded * dt_get_num_threads(); k++)
+    ringtags[k] = -1;
+
   dt_get_perf_times(&mid);
 
   // Process each output line
   DT_OMP_FOR()
   for(int oy = 0; oy < roi_out->height; oy++)
   {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
-
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
-    int hiidx = 0; // H(orizontal) I(ndex) I(n)d(e)x
+    float *const lines = dt_get_perthread(ring, ring_padded);
+    int *const tags = dt_get_perthread(ringtags, tags_padded);
+    float *const vs = lines + (size_t)ringrows * out_width;
 
-    // Number of lines contributing to the output line
-    int vl = vlength[vlidx++]; // V(ertical) L(ength)
+    // Number of lines contributing to the output line, their indexes and taps
+    const int vl = vlength[vmeta[3 * oy + 0]];
+    const float *const vtaps = vkernel + vmeta[3 * oy + 1];
+    const int *const vlines = vindex + vmeta[3 * oy + 2];
 
-    // Process each output column
-    for(int ox = 0; ox < roi_out->width; ox++)
+    memset(vs, 0, sizeof(float) * out_width);
+    for(int iy = 0; iy < vl; iy++)
     {
-      // This will hold the resulting pixel
-      float vs = 0.0f;
-
-      // Number of horizontal samples contributing to the output
-      const int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for(int iy = 0; iy < vl; iy++)
+      // This is our input line, resample it horizontally unless the ring
+      // already holds it
+      const int line = vlines[iy];
+      const int slot = line % ringrows;
+      float *const vhs = lines + (size_t)slot * out_width;
+      if(tags[slot] != line)
       {
-        // This is our input line
-        const float *i = (float *)((char *)in + in_stride * vindex[viidx++]);
-
-        float vhs = 0.0f;
-
-        for(int ix = 0; ix < hl; ix++)
+        tags[slot] = line;
+        const float *i = (float *)((char *)in + in_stride * line);
+        int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
+        for(int ox = 0; ox < roi_out->width; ox++)
         {
-          // Apply the precomputed filter kernel
-          const size_t baseidx = (size_t)hindex[hiidx++];
-          const float htap = hkernel[hkidx++];
-          vhs += i[baseidx] * htap;
+          // Number of horizontal samples contributing to the output
+          const int hl = hlength[ox]; // H(orizontal) L(ength)
+          float hs = 0.0f;
+          for(int ix = 0; ix < hl; ix++)
+          {
+            // Apply the precomputed filter kernel
+            const size_t baseidx = (size_t)hindex[hkidx];
+            const float htap = hkernel[hkidx++];
+            hs += i[baseidx] * htap;
+          }
+          vhs[ox] = hs;
         }
-
-        // Accumulate contribution from this line
-        const float vtap = vkernel[vkidx++];
-        vs += vhs * vtap;
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
-        hiidx -= hl;
       }
 
-      // Output pixel is ready
-      float *o = (float *)((char *)out + (size_t)oy * out_stride
-                           + (size_t)ox * sizeof(float));
-      *o = vs;
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hiidx += hl;
-      hkidx += hl;
+      // Accumulate contribution from this line
+      const float vtap = vtaps[iy];
+      DT_OMP_SIMD()
+      for(size_t ox = 0; ox < out_width; ox++)
+        vs[ox] += vhs[ox] * vtap;
     }
+
+    // Output line is ready
+    memcpy((char *)out + (size_t)oy * out_stride, vs, sizeof(float) * out_width);
   }
 
   exit:
@@ -1587,6 +1633,8 @@ void dt_interpolation_resample_1c(const dt_interpolation_t *itor,
    * allocated. */
   dt_free_align(hlength);
   dt_free_align(vlength);
+  dt_free_align(ring);
+  dt_free_align(ringtags);
   _show_2_times(&start, &mid, "resample_1c_plain");
 }
 
@@ -855,6 +855,57 @@ int dt_ioppr_get_iop_order(GList *iop_order_list,
   return iop_order;
 }
 
+static void _ioppr_index_key(char *key,
+                             const size_t size,
+                             const char *op_name,
+                             const int multi_priority)
+{
+  if(multi_priority == -1)
+    g_strlcpy(key, op_name, size);
+  else
+    snprintf(key, size, "%s %d", op_name, multi_priority);
+}
+
+GHashTable *dt_ioppr_iop_order_index_new(GList *iop_order_list)
+{
+  GHashTable *index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  for(GList *l = iop_order_list; l; l = g_list_next(l))
+  {
+    dt_iop_order_entry_t *entry = l->data;
+    char key[64];
+
+    // keep the first match as dt_ioppr_get_iop_order_link() does, for
+    // the given instance and for any instance (-1)
+    _ioppr_index_key(key, sizeof(key), entry->operation, entry->instance);
+    if(!g_hash_table_contains(index, key))
+      g_hash_table_insert(index, g_strdup(key), entry);
+
+    _ioppr_index_key(key, sizeof(key), entry->operation, -1);
+    if(!g_hash_table_contains(index, key))
+      g_hash_table_insert(index, g_strdup(key), entry);
+  }
+
+  return index;
+}
+
+int dt_ioppr_get_iop_order_indexed(GHashTable *index,
+                                   const char *op_name,
+                                   const int multi_priority)
+{
+  char key[64];
+  _ioppr_index_key(key, sizeof(key), op_name, multi_priority);
+  const dt_iop_order_entry_t *const order_entry = g_hash_table_lookup(index, key);
+
+  if(order_entry)
+    return order_entry->o.iop_order;
+
+  dt_print(DT_DEBUG_ALWAYS,
+           "cannot get iop-order for %s instance %d",
+           op_name, multi_priority);
+  return INT_MAX;
+}
+
 int dt_ioppr_get_iop_order_last(GList *iop_order_list,
                                 const char *op_name)
 {
@@ -1265,6 +1316,7 @@ void dt_ioppr_resync_modules_order(dt_develop_t *dev)
 
   // and reset all module iop_order
 
+  GHashTable *index = dt_ioppr_iop_order_index_new(dev->iop_order_list);
   GList *modules = dev->iop;
   while(modules)
   {
@@ -1275,11 +1327,11 @@ void dt_ioppr_resync_modules_order(dt_develop_t *dev)
     // be removed (non visible)
     // _lib_modulegroups_update_iop_visibility.
     if(mod->iop_order != INT_MAX)
-      mod->iop_order = dt_ioppr_get_iop_order(dev->iop_order_list,
-                                              mod->op, mod->multi_priority);
+      mod->iop_order = dt_ioppr_get_iop_order_indexed(index, mod->op, mod->multi_priority);
 
     modules = next;
   }
+  g_hash_table_destroy(index);
 
   dev->iop = g_list_sort(dev->iop, dt_sort_iop_by_order);
 }
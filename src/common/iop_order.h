@@ -200,6 +200,13 @@ GList *dt_ioppr_get_multiple_instances_iop_order_list(dt_imgid_t imgid, gboolean
 int dt_ioppr_get_iop_order(GList *iop_order_list,
                            const char *op_name,
                            const int multi_priority);
+/** returns a lookup table of the entries of iop_order_list, to be freed with
+    g_hash_table_destroy(). it must not be used after the list is changed. */
+GHashTable *dt_ioppr_iop_order_index_new(GList *iop_order_list);
+/** same as dt_ioppr_get_iop_order() using an index from dt_ioppr_iop_order_index_new() */
+int dt_ioppr_get_iop_order_indexed(GHashTable *index,
+                                   const char *op_name,
+                                   const int multi_priority);
 /** returns the last (max) iop_order from iop_order_list list with operation = op_name */
 int dt_ioppr_get_iop_order_last(GList *iop_order_list,
                                 const char *op_name);
@@ -160,6 +160,46 @@ static inline void _convolve_14641_vert(dt_aligned_pixel_t conv, const float *in
   }
 }
 
+// one row of gauss_reduce(), base points to the first of the five fine rows
+static inline void _gauss_reduce_row(
+    const float *base,
+    float *const out,
+    const size_t wd,
+    const size_t cw)
+{
+  // prime the vertical axis
+  static const dt_aligned_pixel_t kernel = { 1.0f, 4.0f, 6.0f, 4.0f };
+  dt_aligned_pixel_t left;
+  _convolve_14641_vert(left,base,wd);
+  for(size_t col=0; col<cw-3; col += 2)
+  {
+    // convolve the next four pixel wide vertical slice
+    base += 4;
+    dt_aligned_pixel_t right;
+    _convolve_14641_vert(right,base,wd);
+    // horizontal pass, generate two output values from convolving with 1 4 6 4 1
+    // the first uses pixels 0-4, the second uses 2-6
+    dt_aligned_pixel_t conv;
+    for_four_channels(c)
+      conv[c] = left[c] * kernel[c];
+    out[col] = (conv[0] + conv[1] + conv[2] + conv[3] + right[0]) / 256.0f;
+    out[col+1] = (left[2] + 4*(left[3]+right[1]) + 6.0f*right[0] + right[2]) / 256.0f;
+    // shift to next pair of output columns (four input columns)
+    copy_pixel(left, right);
+  }
+  // handle the left-over pixel if the output size is odd
+  if(cw % 2)
+  {
+    base += 4;
+    // convolve the right-most column
+    float right = base[0] + 4.0f*(base[wd]+base[3*wd]) + 6.0f*base[2*wd] + base[4*wd];
+    dt_aligned_pixel_t conv;
+    for_four_channels(c)
+      conv[c] = left[c] * kernel[c];
+    out[cw-3] = (conv[0] + conv[1] + conv[2] + conv[3] + right) / 256.0f;
+  }
+}
+
 static inline void gauss_reduce(
     const float *const input, // fine input buffer
     float *const coarse,      // coarse scale, blurred input buf
@@ -172,41 +212,7 @@ static inline void gauss_reduce(
   // is greater than the time needed to do it sequentially
   DT_OMP_FOR(if(ch*cw>2000))
   for(size_t j=1;j<ch-1;j++)
-  {
-    const float *base = input + 2*(j-1)*wd;
-    float *const out = coarse + j*cw + 1;
-    // prime the vertical axis
-    static const dt_aligned_pixel_t kernel = { 1.0f, 4.0f, 6.0f, 4.0f };
-    dt_aligned_pixel_t left;
-    _convolve_14641_vert(left,base,wd);
-    for(size_t col=0; col<cw-3; col += 2)
-    {
-      // convolve the next four pixel wide vertical slice
-      base += 4;
-      dt_aligned_pixel_t right;
-      _convolve_14641_vert(right,base,wd);
-      // horizontal pass, generate two output values from convolving with 1 4 6 4 1
-      // the first uses pixels 0-4, the second uses 2-6
-      dt_aligned_pixel_t conv;
-      for_four_channels(c)
-        conv[c] = left[c] * kernel[c];
-      out[col] = (conv[0] + conv[1] + conv[2] + conv[3] + right[0]) / 256.0f;
-      out[col+1] = (left[2] + 4*(left[3]+right[1]) + 6.0f*right[0] + right[2]) / 256.0f;
-      // shift to next pair of output columns (four input columns)
-      copy_pixel(left, right);
-    }
-    // handle the left-over pixel if the output size is odd
-    if(cw % 2)
-    {
-      base += 4;
-      // convolve the right-most column
-      float right = base[0] + 4.0f*(base[wd]+base[3*wd]) + 6.0f*base[2*wd] + base[4*wd];
-      dt_aligned_pixel_t conv;
-      for_four_channels(c)
-        conv[c] = left[c] * kernel[c];
-      out[cw-3] = (conv[0] + conv[1] + conv[2] + conv[3] + right) / 256.0f;
-    }
-  }
+    _gauss_reduce_row(input + 2*(j-1)*wd, coarse + j*cw + 1, wd, cw);
   dt_omploop_sfence();
   ll_fill_boundary1(coarse, cw, ch);
 }
@@ -342,9 +348,36 @@ static inline float curve_scalar(
   return val;
 }
 
-void apply_curve(
+// row j of the curve applied to the padded input, padding replicated from the inner pixels
+static inline void _curve_row(
     float *const out,
     const float *const in,
+    const int j,
+    const uint32_t w,
+    const uint32_t h,
+    const uint32_t padding,
+    const float g,
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity)
+{
+  const float *in2 = in + (size_t)CLAMPS(j, (int)padding, (int)(h-padding-1))*w;
+  for(uint32_t i=padding;i<w-padding;i++)
+    out[i] = curve_scalar(in2[i], g, sigma, shadows, highlights, clarity);
+  for(int i=0;i<padding;i++)   out[i] = out[padding];
+  for(int i=w-padding;i<w;i++) out[i] = out[w-padding-1];
+}
+
+// coarse rows per block of _apply_curve_reduce()
+#define LL_REDUCE_BLOCK 16
+
+// gauss_reduce() of the curved input without storing the curved fine level: each block
+// of coarse rows only curves the 2 * LL_REDUCE_BLOCK + 3 fine rows it needs into a
+// per-thread buffer. FALSE if out of memory.
+static gboolean _apply_curve_reduce(
+    float *const coarse,
+    const float *const in,
     const uint32_t w,
     const uint32_t h,
     const uint32_t padding,
@@ -354,18 +387,30 @@ void apply_curve(
     const float highlights,
     const float clarity)
 {
+  const size_t cw = (w-1)/2+1, ch = (h-1)/2+1;
+  const size_t nblocks = (ch - 2 + LL_REDUCE_BLOCK - 1) / LL_REDUCE_BLOCK;
+  size_t padded_size;
+  // the row convolution may read a few floats past the last row
+  float *const rows = dt_alloc_perthread_float((size_t)(2 * LL_REDUCE_BLOCK + 3) * w + 4, &padded_size);
+  if(!rows) return FALSE;
+
   DT_OMP_FOR()
-  for(uint32_t j=padding;j<h-padding;j++)
+  for(size_t blk=0;blk<nblocks;blk++)
   {
-    const float *in2  = in  + j*w + padding;
-    float *out2 = out + j*w + padding;
-    for(uint32_t i=padding;i<w-padding;i++)
-      (*out2++) = curve_scalar(*(in2++), g, sigma, shadows, highlights, clarity);
-    out2 = out + j*w;
-    for(int i=0;i<padding;i++)   out2[i] = out2[padding];
-    for(int i=w-padding;i<w;i++) out2[i] = out2[w-padding-1];
+    float *const fine = dt_get_perthread(rows, padded_size);
+    const size_t j0 = 1 + blk * LL_REDUCE_BLOCK;
+    const size_t j1 = MIN(j0 + LL_REDUCE_BLOCK, ch-1);
+    // coarse row j needs fine rows 2(j-1) .. 2(j-1)+4
+    const int first = 2*(j0-1);
+    const int nrows = 2*(j1-j0) + 3;
+    for(int r=0;r<nrows;r++)
+      _curve_row(fine + (size_t)r*w, in, first+r, w, h, padding, g, sigma, shadows, highlights, clarity);
+    for(size_t j=j0;j<j1;j++)
+      _gauss_reduce_row(fine + (size_t)2*(j-j0)*w, coarse + j*cw + 1, w, cw);
   }
-  pad_by_replication(out, w, h, padding);
+  dt_free_align(rows);
+  ll_fill_boundary1(coarse, cw, ch);
+  return TRUE;
 }
 
 void local_laplacian_internal(
@@ -377,7 +422,9 @@ void local_laplacian_internal(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b)
+    local_laplacian_boundary_t *b,
+    local_laplacian_pyramid_t *pyr,
+    const dt_hash_t input_hash)
 {
   if(wd <= 1 || ht <= 1) return;
 
@@ -389,26 +436,47 @@ void local_laplacian_internal(
   const int max_supp = 1<<last_level;
   int w, h;
   float *padded[max_levels] = {0};
-  if(b && b->mode == 2)
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
-  else
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
 
-  // allocate pyramid pointers for padded input
-  gboolean success = padded[0] != NULL;
-  for(int l=1;l<=last_level;l++)
+  // the input pyramid can be kept unless it is padded from or handed to the preview
+  if(pyr && b && b->mode != 0) pyr = NULL;
+  const gboolean reuse = pyr && input_hash != DT_INVALID_HASH && pyr->hash == input_hash
+                         && pyr->wd == wd && pyr->ht == ht && pyr->num_levels == last_level + 1;
+  if(pyr && !reuse) local_laplacian_pyramid_free(pyr);
+
+  gboolean success = TRUE;
+  if(reuse)
   {
-    padded[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
-    if(!padded[l])
+    w = pyr->pwd;
+    h = pyr->pht;
+    for(int l=0;l<=last_level;l++) padded[l] = pyr->padded[l];
+  }
+  else
+  {
+    if(b && b->mode == 2)
+      padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
+    else
+      padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+
+    // allocate pyramid pointers for padded input
+    success = padded[0] != NULL;
+    for(int l=1;l<=last_level;l++)
     {
-      success = FALSE;
-      break;
+      padded[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+      if(!padded[l])
+      {
+        success = FALSE;
+        break;
+      }
     }
   }
 
+  // the finest output level is only needed inside the roi and assembled into out directly,
+  // unless it is handed out for the preview
+  const gboolean full_finest = (b && b->mode == 1) || last_level == 0;
+
   // allocate pyramid pointers for output
   float *output[max_levels] = {0};
-  for(int l=0;l<=last_level;l++)
+  for(int l=full_finest ? 0 : 1;l<=last_level;l++)
   {
     output[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
     if(!output[l])
@@ -425,7 +493,7 @@ void local_laplacian_internal(
     // declared below.  So just free whatever we've allocated and return.
     for(int l = 0; l <= last_level; l++)
     {
-      dt_free_align(padded[l]);
+      if(!reuse) dt_free_align(padded[l]);
       dt_free_align(output[l]);
     }
     // copy the input buffer to the output so that we at least get a
@@ -435,10 +503,27 @@ void local_laplacian_internal(
     return;
   }
 
-  // create gauss pyramid of padded input, write coarse directly to output
-  for(int l=1;l<last_level;l++)
-    gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-  gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+  // create gauss pyramid of padded input, the coarsest level is the start of the output
+  if(!reuse)
+  {
+    for(int l=1;l<=last_level;l++)
+      gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
+  }
+  memcpy(output[last_level], padded[last_level],
+         sizeof(float) * dl(w,last_level) * dl(h,last_level));
+
+  // hand the pyramid over to the cache
+  const gboolean keep = pyr && input_hash != DT_INVALID_HASH;
+  if(keep && !reuse)
+  {
+    pyr->hash = input_hash;
+    pyr->wd = wd;
+    pyr->ht = ht;
+    pyr->pwd = w;
+    pyr->pht = h;
+    pyr->num_levels = last_level + 1;
+    for(int l=0;l<=last_level;l++) pyr->padded[l] = padded[l];
+  }
 
   // evenly sample brightness [0,1]:
   float gamma[num_gamma] = {0.0f};
@@ -446,9 +531,10 @@ void local_laplacian_internal(
   // for(int k=0;k<num_gamma;k++) gamma[k] = k/(num_gamma-1.0f);
 
   // allocate memory for intermediate laplacian pyramids
+  // the finest level of the curved images isn't stored, it is cheap to compute from padded[0]
   float *buf[num_gamma][max_levels] = {{0}};
   for(int k=0;k<num_gamma;k++)
-    for(int l=0;l<=last_level;l++)
+    for(int l=1;l<=last_level;l++)
     {
       buf[k][l] = dt_alloc_align_float((size_t)dl(w,l)*dl(h,l));
       if(!buf[k][l])
@@ -464,12 +550,17 @@ void local_laplacian_internal(
   // the paper says remapping only level 3 not 0 does the trick, too
   // (but i really like the additional octave of sharpness we get,
   // willing to pay the cost).
-  for(int k=0;k<num_gamma;k++)
-  { // process images
-    apply_curve(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
-
-    // create gaussian pyramids
-    for(int l=1;l<=last_level;l++)
+  // with a single level there is nothing to remap
+  for(int k=0;k<num_gamma && last_level > 0;k++)
+  { // process images and create gaussian pyramids
+    if(!_apply_curve_reduce(buf[k][1], padded[0], w, h, max_supp, gamma[k],
+                            sigma, shadows, highlights, clarity))
+    {
+      for(size_t p = 0; p < (size_t)4 * wd * ht; p++)
+        out[p] = input[p];
+      goto cleanup;
+    }
+    for(int l=2;l<=last_level;l++)
       gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
   }
 
@@ -534,7 +625,7 @@ void local_laplacian_internal(
   }
 
   // assemble output pyramid coarse to fine
-  for(int l=last_level-1;l >= 0; l--)
+  for(int l=last_level-1;l >= (full_finest ? 0 : 1); l--)
   {
     const int pw = dl(w,l), ph = dl(h,l);
 
@@ -548,22 +639,62 @@ void local_laplacian_internal(
       for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
       int lo = hi-1;
       const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
-      const float l0 = ll_laplacian(buf[lo][l+1], buf[lo][l], i, j, pw, ph);
-      const float l1 = ll_laplacian(buf[hi][l+1], buf[hi][l], i, j, pw, ph);
+      float l0, l1;
+      if(l == 0)
+      {
+        // buf[][0] is the curve applied to padded[0], for the inner pixels
+        // which are the only ones used in the end
+        l0 = curve_scalar(v, gamma[lo], sigma, shadows, highlights, clarity)
+             - ll_expand_gaussian(buf[lo][1], CLAMPS(i, 1, ((pw-1)&~1)-1), CLAMPS(j, 1, ((ph-1)&~1)-1), pw, ph);
+        l1 = curve_scalar(v, gamma[hi], sigma, shadows, highlights, clarity)
+             - ll_expand_gaussian(buf[hi][1], CLAMPS(i, 1, ((pw-1)&~1)-1), CLAMPS(j, 1, ((ph-1)&~1)-1), pw, ph);
+      }
+      else
+      {
+        l0 = ll_laplacian(buf[lo][l+1], buf[lo][l], i, j, pw, ph);
+        l1 = ll_laplacian(buf[hi][l+1], buf[hi][l], i, j, pw, ph);
+      }
       output[l][j*pw+i] += l0 * (1.0f-a) + l1 * a;
-      // we could do this to save on memory (no need for finest buf[][]).
-      // unfortunately it results in a quite noticeable loss of sharpness, i think
-      // the extra level is worth it.
-      // else if(l == 0) // use finest scale from input to not amplify noise (and use less memory)
-      //   output[l][j*pw+i] += ll_laplacian(padded[l+1], padded[l], i, j, pw, ph);
     }
   }
-  DT_OMP_FOR(collapse(2))
-  for(int j=0;j<ht;j++) for(int i=0;i<wd;i++)
+  if(full_finest)
   {
-    out[4*(j*wd+i)+0] = 100.0f * output[0][(j+max_supp)*w+max_supp+i]; // [0,1] -> L
-    out[4*(j*wd+i)+1] = input[4*(j*wd+i)+1]; // copy original colour channels
-    out[4*(j*wd+i)+2] = input[4*(j*wd+i)+2];
+    DT_OMP_FOR(collapse(2))
+    for(int j=0;j<ht;j++) for(int i=0;i<wd;i++)
+    {
+      out[4*(j*wd+i)+0] = 100.0f * output[0][(j+max_supp)*w+max_supp+i]; // [0,1] -> L
+      out[4*(j*wd+i)+1] = input[4*(j*wd+i)+1]; // copy original colour channels
+      out[4*(j*wd+i)+2] = input[4*(j*wd+i)+2];
+    }
+  }
+  else
+  {
+    // finest level for the inner pixels only, the expanded coarse level is clamped like
+    // the boundary filled by gauss_expand()
+    DT_OMP_FOR()
+    for(int j=0;j<ht;j++)
+    {
+      const int pj = j+max_supp;
+      const int cj = CLAMPS(pj, 1, ((h-1)&~1)-1);
+      for(int i=0;i<wd;i++)
+      {
+        const int pi = i+max_supp;
+        const int ci = CLAMPS(pi, 1, ((w-1)&~1)-1);
+        const float v = padded[0][(size_t)pj*w+pi];
+        int hi = 1;
+        for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
+        int lo = hi-1;
+        const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
+        const float l0 = curve_scalar(v, gamma[lo], sigma, shadows, highlights, clarity)
+                         - ll_expand_gaussian(buf[lo][1], ci, cj, w, h);
+        const float l1 = curve_scalar(v, gamma[hi], sigma, shadows, highlights, clarity)
+                         - ll_expand_gaussian(buf[hi][1], ci, cj, w, h);
+        const float o = ll_expand_gaussian(output[1], ci, cj, w, h) + (l0 * (1.0f-a) + l1 * a);
+        out[4*(j*wd+i)+0] = 100.0f * o; // [0,1] -> L
+        out[4*(j*wd+i)+1] = input[4*(j*wd+i)+1]; // copy original colour channels
+        out[4*(j*wd+i)+2] = input[4*(j*wd+i)+2];
+      }
+    }
   }
   if(b && b->mode == 1)
   { // output the buffers for later re-use
@@ -579,7 +710,7 @@ void local_laplacian_internal(
 cleanup:
   for(int l=0;l<max_levels;l++)
   {
-    if(!b || b->mode != 1 || l)   dt_free_align(padded[l]);
+    if(!keep && (!b || b->mode != 1 || l)) dt_free_align(padded[l]);
     if(!b || b->mode != 1)        dt_free_align(output[l]);
     for(int k=0; k<num_gamma;k++) dt_free_align(buf[k][l]);
   }
@@ -596,8 +727,12 @@ size_t local_laplacian_memory_use(const int width,     // width of input image
 
   size_t memory_use = 0;
 
+  // padded input, the output and curved images from the second level on
   for(int l=0;l<num_levels;l++)
-    memory_use += sizeof(float) * (2 + num_gamma) * dl(paddwd, l) * dl(paddht, l);
+    memory_use += sizeof(float) * (l ? 2 + num_gamma : 1) * dl(paddwd, l) * dl(paddht, l);
+
+  // curved rows of a block per thread, see _apply_curve_reduce()
+  memory_use += sizeof(float) * (2 * LL_REDUCE_BLOCK + 3) * paddwd * dt_get_num_threads();
 
   return memory_use;
 }
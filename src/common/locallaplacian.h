@@ -45,6 +45,28 @@ void local_laplacian_boundary_free(
   memset(b, 0, sizeof(*b));
 }
 
+// gaussian pyramid of the padded input, only depends on the input buffer.
+// kept by the caller so repeated runs on the same input with other
+// parameters skip building it again.
+typedef struct local_laplacian_pyramid_t
+{
+  dt_hash_t hash;          // hash of the input the pyramid was built from
+  int wd;                  // input width
+  int ht;                  // input height
+  int pwd;                 // padded width
+  int pht;                 // padded height
+  int num_levels;          // number of levels in padded
+  float *padded[30];       // the pyramid (allocated via dt_alloc_align)
+}
+local_laplacian_pyramid_t;
+
+void local_laplacian_pyramid_free(
+    local_laplacian_pyramid_t *p)
+{
+  for(int l=0;l<p->num_levels;l++) dt_free_align(p->padded[l]);
+  memset(p, 0, sizeof(*p));
+}
+
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -55,7 +77,10 @@ void local_laplacian_internal(
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
     // the following is just needed for clipped roi with boundary conditions from coarse buffer (can be 0)
-    local_laplacian_boundary_t *b);
+    local_laplacian_boundary_t *b,
+    // cache of the input pyramid for input_hash, not used with boundary conditions (can be 0)
+    local_laplacian_pyramid_t *pyr,
+    const dt_hash_t input_hash);
 
 void local_laplacian(
     const float *const input,   // input buffer in some Labx or yuvx format
@@ -66,9 +91,11 @@ void local_laplacian(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b) // can be 0
+    local_laplacian_boundary_t *b, // can be 0
+    local_laplacian_pyramid_t *pyr, // can be 0
+    const dt_hash_t input_hash)
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b, pyr, input_hash);
 }
 
 size_t local_laplacian_memory_use(const int width,      // width of input image
@@ -375,6 +375,25 @@ static inline float dt_fast_hypotf(const float x,
   return sqrtf(x * x + y * y);
 }
 
+// a vectorizable approximation of atan2f(), absolute error below 2e-6
+// radians. atan2f(0, 0) gives 0, infinities and NaNs are not handled.
+DT_OMP_DECLARE_SIMD()
+static inline float dt_fast_atan2f(const float y,
+                                   const float x)
+{
+  const float ax = fabsf(x);
+  const float ay = fabsf(y);
+  // atan() of the ratio in [0, 1] from an odd minimax polynomial
+  const float a = fminf(ax, ay) / fmaxf(fmaxf(ax, ay), 1e-30f);
+  const float s = a * a;
+  float r = (((((-0.01172120f * s + 0.05265332f) * s - 0.11643287f) * s
+               + 0.19354346f) * s - 0.33262347f) * s + 0.99997726f) * a;
+  // unfold the octants
+  r = (ay > ax) ? 0.5f * M_PI_F - r : r;
+  r = (x < 0.0f) ? M_PI_F - r : r;
+  return copysignf(r, y);
+}
+
 // fast approximation of expf()
 /****** if you change this function, you need to make the same change
  * in data/kernels/{basecurve,basic}.cl ***/
@@ -0,0 +1,156 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/metrics.h"
+#include "common/darktable.h"
+#include "common/mipmap_cache.h"
+#include "control/jobs.h"
+
+int64_t dt_metrics_counters[DT_METRIC_LAST] = { 0 };
+
+static const struct
+{
+  const char *name;
+  const char *help;
+} _counters[DT_METRIC_LAST] = {
+  [DT_METRIC_IMAGES_EXPORTED] = { "images_exported_total", "images exported" },
+  [DT_METRIC_EXPORT_ERRORS] = { "export_errors_total", "exports that failed" },
+  [DT_METRIC_PIPE_RUNS] = { "pipe_runs_total", "pixelpipe runs of all pipe types" },
+  [DT_METRIC_TILED_NODES] = { "tiled_nodes_total", "pipe nodes processed with tiling" },
+  [DT_METRIC_OPENCL_FALLBACKS] = { "opencl_fallbacks_total",
+                                   "pipe nodes that failed on OpenCL and were processed on CPU" },
+  [DT_METRIC_OPENCL_RESTARTS] = { "opencl_restarts_total",
+                                  "pipes started over on CPU after OpenCL errors" },
+  [DT_METRIC_PIPE_CACHE_TESTS] = { "pipe_cache_lookups_total", "pixelpipe cache lookups" },
+  [DT_METRIC_PIPE_CACHE_HITS] = { "pipe_cache_hits_total", "pixelpipe cache lookups that hit" },
+};
+
+// upper bounds in seconds of the module time histogram buckets, the last
+// bucket is +Inf
+static const double _bounds[] = { 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+                                  0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0 };
+#define DT_METRICS_BUCKETS (G_N_ELEMENTS(_bounds) + 1)
+
+typedef struct _histogram_t
+{
+  int64_t buckets[DT_METRICS_BUCKETS]; // not cumulative
+  int64_t sum_us;
+} _histogram_t;
+
+// op -> _histogram_t, entries live as long as the process
+static GHashTable *_modules = NULL;
+static GMutex _modules_lock;
+
+void dt_metrics_observe_module(const char *op, const double seconds)
+{
+  g_mutex_lock(&_modules_lock);
+  if(!_modules)
+    _modules = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  _histogram_t *h = g_hash_table_lookup(_modules, op);
+  if(!h)
+  {
+    h = g_new0(_histogram_t, 1);
+    g_hash_table_insert(_modules, g_strdup(op), h);
+  }
+  g_mutex_unlock(&_modules_lock);
+
+  int b = 0;
+  while(b < G_N_ELEMENTS(_bounds) && seconds > _bounds[b]) b++;
+  __atomic_fetch_add(&h->buckets[b], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&h->sum_us, (int64_t)(1e6 * seconds), __ATOMIC_RELAXED);
+}
+
+static void _append_module(gpointer key, gpointer value, gpointer user_data)
+{
+  const _histogram_t *h = value;
+  GString *out = user_data;
+  int64_t count = 0;
+  for(int b = 0; b < DT_METRICS_BUCKETS; b++)
+  {
+    count += __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED);
+    if(b < G_N_ELEMENTS(_bounds))
+      g_string_append_printf(out, "darktable_module_seconds_bucket{module=\"%s\",le=\"%g\"} %" PRId64 "\n",
+                             (const char *)key, _bounds[b], count);
+    else
+      g_string_append_printf(out, "darktable_module_seconds_bucket{module=\"%s\",le=\"+Inf\"} %" PRId64 "\n",
+                             (const char *)key, count);
+  }
+  g_string_append_printf(out, "darktable_module_seconds_sum{module=\"%s\"} %.6f\n",
+                         (const char *)key, 1e-6 * __atomic_load_n(&h->sum_us, __ATOMIC_RELAXED));
+  g_string_append_printf(out, "darktable_module_seconds_count{module=\"%s\"} %" PRId64 "\n",
+                         (const char *)key, count);
+}
+
+static void _append_header(GString *out, const char *name, const char *type, const char *help)
+{
+  g_string_append_printf(out, "# HELP darktable_%s %s\n# TYPE darktable_%s %s\n",
+                         name, help, name, type);
+}
+
+gchar *dt_metrics_export(void)
+{
+  GString *out = g_string_new(NULL);
+
+  for(int k = 0; k < DT_METRIC_LAST; k++)
+  {
+    _append_header(out, _counters[k].name, "counter", _counters[k].help);
+    g_string_append_printf(out, "darktable_%s %" PRId64 "\n", _counters[k].name,
+                           __atomic_load_n(&dt_metrics_counters[k], __ATOMIC_RELAXED));
+  }
+
+  _append_header(out, "module_seconds", "histogram", "processing time of the pipe nodes per module");
+  g_mutex_lock(&_modules_lock);
+  if(_modules) g_hash_table_foreach(_modules, _append_module, out);
+  g_mutex_unlock(&_modules_lock);
+
+  const dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(cache)
+  {
+    static const char *const stats[] = { "hits", "misses", "evictions" };
+    for(int s = 0; s < G_N_ELEMENTS(stats); s++)
+    {
+      gchar *name = g_strdup_printf("mipmap_cache_%s_total", stats[s]);
+      _append_header(out, name, "counter", "mipmap cache statistics per level");
+      for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_NONE; mip++)
+      {
+        const long int value = s == 0 ? cache->stats[mip].hits
+                             : s == 1 ? cache->stats[mip].misses
+                                      : cache->stats[mip].evictions;
+        g_string_append_printf(out, "darktable_%s{level=\"%d\"} %ld\n", name, mip, value);
+      }
+      g_free(name);
+    }
+  }
+
+  static const char *const queues[DT_JOB_QUEUE_MAX] =
+    { "user_fg", "system_fg", "user_bg", "user_export", "system_bg" };
+  _append_header(out, "job_queue_length", "gauge", "jobs waiting per queue");
+  for(dt_job_queue_t q = DT_JOB_QUEUE_USER_FG; q < DT_JOB_QUEUE_MAX; q++)
+    g_string_append_printf(out, "darktable_job_queue_length{queue=\"%s\"} %zu\n",
+                           queues[q], dt_control_jobs_queue_length(q));
+  _append_header(out, "jobs_pending", "gauge", "jobs queued or running");
+  g_string_append_printf(out, "darktable_jobs_pending %d\n", dt_control_jobs_pending());
+
+  return g_string_free(out, FALSE);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,69 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <inttypes.h>
+
+G_BEGIN_DECLS
+
+/*
+  counters for long running headless use (darktable-cli --serve, the
+  Python API), exported in the Prometheus text format. updating a counter
+  is a relaxed atomic add, reading them never stops the subsystems.
+*/
+
+typedef enum dt_metric_t
+{
+  DT_METRIC_IMAGES_EXPORTED = 0, // images written by dt_imageio_export*()
+  DT_METRIC_EXPORT_ERRORS,       // exports that failed
+  DT_METRIC_PIPE_RUNS,           // pixelpipe runs, of all pipe types
+  DT_METRIC_TILED_NODES,         // nodes processed with tiling
+  DT_METRIC_OPENCL_FALLBACKS,    // nodes that failed on OpenCL and ran on CPU
+  DT_METRIC_OPENCL_RESTARTS,     // pipes started over on CPU after OpenCL errors
+  DT_METRIC_PIPE_CACHE_TESTS,    // pixelpipe cache lookups
+  DT_METRIC_PIPE_CACHE_HITS,     // of those, found in the cache
+  DT_METRIC_LAST
+} dt_metric_t;
+
+extern int64_t dt_metrics_counters[DT_METRIC_LAST];
+
+static inline void dt_metrics_add(const dt_metric_t metric, const int64_t value)
+{
+  __atomic_fetch_add(&dt_metrics_counters[metric], value, __ATOMIC_RELAXED);
+}
+
+static inline void dt_metrics_inc(const dt_metric_t metric)
+{
+  dt_metrics_add(metric, 1);
+}
+
+/** record the processing time of one pipe node in the histogram of its module */
+void dt_metrics_observe_module(const char *op, const double seconds);
+
+/** all metrics in the Prometheus text exposition format, g_free() the result */
+gchar *dt_metrics_export(void);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -23,12 +23,16 @@
 #include "common/file_location.h"
 #include "common/grealpath.h"
 #include "common/image_cache.h"
+#include "common/mipmap_pack.h"
+#include "common/trace.h"
 #include "control/conf.h"
+#include "control/control.h"
 #include "control/jobs.h"
 #include "develop/imageop_math.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_jpeg.h"
 #include "imageio/imageio_module.h"
+#include "imageio/qoi.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -63,7 +67,12 @@ typedef enum dt_mipmap_buffer_dsc_flags
 {
   DT_MIPMAP_BUFFER_DSC_FLAG_NONE = 0,
   DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE = 1 << 0,
-  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1
+  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1,
+  // embedded preview standing in until the pipe has rendered the thumbnail,
+  // never written to the disk cache
+  DT_MIPMAP_BUFFER_DSC_FLAG_PROVISIONAL = 1 << 2,
+  // just allocated, the first get is a miss rather than a hit
+  DT_MIPMAP_BUFFER_DSC_FLAG_FRESH = 1 << 3
 } dt_mipmap_buffer_dsc_flags;
 
 // the embedded Exif data to tag thumbnails as sRGB or AdobeRGB
@@ -389,7 +398,8 @@ static void _init_8(uint8_t *buf,
                     float *iscale,
                     dt_colorspaces_color_profile_type_t *color_space,
                     const dt_imgid_t imgid,
-                    const dt_mipmap_size_t size);
+                    const dt_mipmap_size_t size,
+                    gboolean *provisional);
 
 // callback for the imageio core to allocate memory.
 // only needed for _F and _FULL buffers, as they change size
@@ -416,6 +426,7 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
     entry->data_size = 0;
 
     entry->data = dt_alloc_aligned(buffer_size);
+    dt_alloc_first_touch(entry->data, buffer_size);
 
     if(!entry->data)
     {
@@ -455,6 +466,109 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
   return dsc + 1;
 }
 
+// compressed tier: a thumbnail leaving mip_thumbs is QOI encoded, which
+// is lossless and fast enough to decode on the next hit instead of going
+// through the jpeg disk cache or the pipe.
+typedef struct _mipmap_packed_t
+{
+  GList link;
+  uint32_t key;
+  uint32_t width, height;
+  float iscale;
+  dt_colorspaces_color_profile_type_t color_space;
+  int size;
+  void *data;
+} _mipmap_packed_t;
+
+static void _mipmap_packed_drop(dt_mipmap_cache_t *cache,
+                                _mipmap_packed_t *p)
+{
+  g_hash_table_remove(cache->packed, GUINT_TO_POINTER(p->key));
+  g_queue_unlink(&cache->packed_lru, &p->link);
+  cache->packed_size -= sizeof(*p) + p->size;
+  free(p->data);
+  g_free(p);
+}
+
+static void _mipmap_packed_store(dt_mipmap_cache_t *cache,
+                                 const uint32_t key,
+                                 const dt_mipmap_buffer_dsc_t *dsc)
+{
+  if(!cache->packed_quota) return;
+
+  const qoi_desc desc = { .width = dsc->width, .height = dsc->height,
+                          .channels = 4, .colorspace = QOI_SRGB };
+  int size = 0;
+  void *data = qoi_encode(dsc + 1, &desc, &size);
+  if(!data) return;
+
+  _mipmap_packed_t *p = g_malloc(sizeof(_mipmap_packed_t));
+  p->link = (GList){ .data = p };
+  p->key = key;
+  p->width = dsc->width;
+  p->height = dsc->height;
+  p->iscale = dsc->iscale;
+  p->color_space = dsc->color_space;
+  p->size = size;
+  p->data = data;
+
+  dt_pthread_mutex_lock(&cache->packed_mutex);
+  _mipmap_packed_t *old = g_hash_table_lookup(cache->packed, GUINT_TO_POINTER(key));
+  if(old) _mipmap_packed_drop(cache, old);
+  g_hash_table_insert(cache->packed, GUINT_TO_POINTER(key), p);
+  g_queue_push_tail_link(&cache->packed_lru, &p->link);
+  cache->packed_size += sizeof(*p) + size;
+  while(cache->packed_size > cache->packed_quota && cache->packed_lru.head)
+    _mipmap_packed_drop(cache, cache->packed_lru.head->data);
+  dt_pthread_mutex_unlock(&cache->packed_mutex);
+}
+
+// move a packed thumbnail back into the working set
+static gboolean _mipmap_packed_take(dt_mipmap_cache_t *cache,
+                                    const uint32_t key,
+                                    dt_mipmap_buffer_dsc_t *dsc)
+{
+  if(!cache->packed_quota) return FALSE;
+
+  dt_pthread_mutex_lock(&cache->packed_mutex);
+  _mipmap_packed_t *p = g_hash_table_lookup(cache->packed, GUINT_TO_POINTER(key));
+  if(p)
+  {
+    g_hash_table_remove(cache->packed, GUINT_TO_POINTER(key));
+    g_queue_unlink(&cache->packed_lru, &p->link);
+    cache->packed_size -= sizeof(*p) + p->size;
+  }
+  dt_pthread_mutex_unlock(&cache->packed_mutex);
+  if(!p) return FALSE;
+
+  const dt_mipmap_size_t mip = _get_size(key);
+  qoi_desc desc;
+  uint8_t *pixels = p->width <= cache->max_width[mip] && p->height <= cache->max_height[mip]
+    ? qoi_decode(p->data, p->size, &desc, 4)
+    : NULL;
+  if(pixels)
+  {
+    memcpy(dsc + 1, pixels, (size_t)4 * p->width * p->height);
+    dsc->width = p->width;
+    dsc->height = p->height;
+    dsc->iscale = p->iscale;
+    dsc->color_space = p->color_space;
+    free(pixels);
+  }
+  free(p->data);
+  g_free(p);
+  return pixels != NULL;
+}
+
+static void _mipmap_packed_remove(dt_mipmap_cache_t *cache,
+                                  const uint32_t key)
+{
+  dt_pthread_mutex_lock(&cache->packed_mutex);
+  _mipmap_packed_t *p = g_hash_table_lookup(cache->packed, GUINT_TO_POINTER(key));
+  if(p) _mipmap_packed_drop(cache, p);
+  dt_pthread_mutex_unlock(&cache->packed_mutex);
+}
+
 // callback for the cache backend to initialize payload pointers
 static void _mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
 {
@@ -518,15 +632,54 @@ static void _mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
   int loaded_from_disk = 0;
   if(mip < DT_MIPMAP_F)
   {
-    if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
+    if(mip < DT_MIPMAP_8 && _mipmap_packed_take(cache, entry->key, dsc))
+    {
+      dt_print(DT_DEBUG_CACHE,
+               "[mipmap_cache] grab mip %d for ID=%d from compressed cache", mip,
+               _get_imgid(entry->key));
+      loaded_from_disk = 1;
+    }
+    else if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
                               || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
     {
       // try and load from disk, if successful set flag
+      const dt_imgid_t imgid = _get_imgid(entry->key);
+      dt_mipmap_pack_t *pack = cache->pack[mip];
+      size_t packed_len = 0;
+      dt_colorspaces_color_profile_type_t packed_color_space = DT_COLORSPACE_NONE;
+      const uint8_t *packed = pack
+        ? dt_mipmap_pack_get(pack, imgid, &packed_len, &packed_color_space)
+        : NULL;
       char filename[PATH_MAX] = {0};
       snprintf(filename, sizeof(filename), "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip,
-               _get_imgid(entry->key));
-      FILE *f = g_fopen(filename, "rb");
-      if(f)
+               imgid);
+      FILE *f = packed ? NULL : g_fopen(filename, "rb");
+      if(packed)
+      {
+        // the jpeg is decoded straight from the mapping
+        dt_imageio_jpeg_t jpg;
+        if(dt_imageio_jpeg_decompress_header(packed, packed_len, &jpg)
+           || jpg.width > cache->max_width[mip] || jpg.height > cache->max_height[mip]
+           || dt_imageio_jpeg_decompress(&jpg, (uint8_t *)entry->data + sizeof(*dsc)))
+        {
+          dt_print(DT_DEBUG_ALWAYS,
+                   "[mipmap_cache] failed to decompress packed thumbnail for ID=%d!", imgid);
+          dt_mipmap_pack_release(pack);
+          dt_mipmap_pack_remove(pack, imgid);
+        }
+        else
+        {
+          dt_mipmap_pack_release(pack);
+          dt_print(DT_DEBUG_CACHE,
+                   "[mipmap_cache] grab mip %d for ID=%d from disk cache", mip, imgid);
+          dsc->width = jpg.width;
+          dsc->height = jpg.height;
+          dsc->iscale = 1.0f;
+          dsc->color_space = packed_color_space;
+          loaded_from_disk = 1;
+        }
+      }
+      else if(f)
       {
         uint8_t *blob = 0;
         fseek(f, 0, SEEK_END);
@@ -571,6 +724,8 @@ read_error:
   if(!loaded_from_disk)
     dsc->flags = DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
   else dsc->flags = 0;
+  dsc->flags |= DT_MIPMAP_BUFFER_DSC_FLAG_FRESH;
+  __sync_fetch_and_add(&cache->stats[mip].misses, 1);
 
   // cost is just flat one for the buffer, as the buffers might have different sizes,
   // to make sure quota is meaningful.
@@ -588,6 +743,10 @@ static void _mipmap_cache_unlink_ondisk_thumbnail(void *data,
 {
   dt_mipmap_cache_t *cache = (dt_mipmap_cache_t *)data;
 
+  _mipmap_packed_remove(cache, _get_key(imgid, mip));
+  if(mip <= DT_MIPMAP_8 && cache->pack[mip])
+    dt_mipmap_pack_remove(cache->pack[mip], imgid);
+
   // also remove jpg backing (always try to do that, in case user just temporarily switched it off,
   // to avoid inconsistencies.
   // if(dt_conf_get_bool("cache_disk_backend"))
@@ -599,28 +758,69 @@ static void _mipmap_cache_unlink_ondisk_thumbnail(void *data,
   }
 }
 
+static void _mipmap_pack_thumbnail(const dt_mipmap_cache_t *cache,
+                                   dt_mipmap_pack_t *pack,
+                                   const dt_imgid_t imgid,
+                                   const dt_mipmap_buffer_dsc_t *dsc)
+{
+  // first check the disk isn't full
+  struct statvfs vfsbuf;
+  if(statvfs(cache->cachedir, &vfsbuf)
+     || ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20) < 100)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[mipmap_cache] not enough free space to write thumbnail for ID=%d", imgid);
+    return;
+  }
+
+  const size_t capacity = (size_t)4 * dsc->width * dsc->height;
+  uint8_t *jpg = dt_alloc_aligned(capacity);
+  if(!jpg) return;
+  const int cache_quality = dt_conf_get_int("database_cache_quality");
+  const int len = dt_imageio_jpeg_compress((const uint8_t *)(dsc + 1), jpg, dsc->width, dsc->height,
+                                           MIN(100, MAX(10, cache_quality)));
+  // the color space goes into the record instead of an exif block
+  if(len > 1)
+    dt_mipmap_pack_write(pack, imgid, jpg, len, dsc->color_space);
+  dt_free_align(jpg);
+}
+
 static void _mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
 {
   dt_mipmap_cache_t *cache = (dt_mipmap_cache_t *)data;
   const dt_mipmap_size_t mip = _get_size(entry->key);
+  if(!(((dt_mipmap_buffer_dsc_t *)entry->data)->flags & DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE))
+    __sync_fetch_and_add(&cache->stats[mip].evictions, 1);
   if(mip < DT_MIPMAP_F)
   {
     dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)entry->data;
     // don't write skulls:
     if(dsc->width > 8 && dsc->height > 8)
     {
+      if(mip < DT_MIPMAP_8
+         && !(dsc->flags & (DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE
+                            | DT_MIPMAP_BUFFER_DSC_FLAG_PROVISIONAL
+                            | DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE)))
+        _mipmap_packed_store(cache, entry->key, dsc);
+
       if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE)
       {
         _mipmap_cache_unlink_ondisk_thumbnail(data, _get_imgid(entry->key), mip);
       }
-      else if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
+      else if(cache->cachedir[0] && !(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_PROVISIONAL) && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
                                      || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
       {
         // serialize to disk
+        dt_mipmap_pack_t *pack = cache->pack[mip];
         char filename[PATH_MAX] = {0};
         snprintf(filename, sizeof(filename), "%s.d/%d", cache->cachedir, mip);
-        const int mkd = g_mkdir_with_parents(filename, 0750);
-        if(!mkd)
+        if(pack)
+        {
+          // as below, don't replace a thumbnail already on disk
+          if(!dt_mipmap_pack_contains(pack, _get_imgid(entry->key)))
+            _mipmap_pack_thumbnail(cache, pack, _get_imgid(entry->key), dsc);
+        }
+        else if(!g_mkdir_with_parents(filename, 0750))
         {
           snprintf(filename, sizeof(filename), "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip,
                    _get_imgid(entry->key));
@@ -689,6 +889,18 @@ void dt_mipmap_cache_init()
   darktable.mipmap_cache = cache;
 
   _mipmap_cache_get_filename(cache->cachedir, sizeof(cache->cachedir));
+  if(cache->cachedir[0])
+  {
+    for(dt_mipmap_size_t k = DT_MIPMAP_0; k <= DT_MIPMAP_8; k++)
+    {
+      char filename[PATH_MAX] = { 0 };
+      snprintf(filename, sizeof(filename), "%s.d/%d.pack", cache->cachedir, (int)k);
+      cache->pack[k] = dt_mipmap_pack_open(filename);
+    }
+  }
+  dt_pthread_mutex_init(&cache->upgrade_mutex, NULL);
+  cache->upgrade_pending = g_hash_table_new(NULL, NULL);
+  dt_atomic_set_int(&cache->upgrading, NO_IMGID);
   // make sure static memory is initialized
   dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)_mipmap_cache_static_dead_image;
   _dead_image_f((dt_mipmap_buffer_t *)(dsc + 1));
@@ -744,7 +956,15 @@ void dt_mipmap_cache_init()
   cache->mip_full.stats_fetches = 0;
   cache->mip_full.stats_standin = 0;
 
-  dt_cache_init(&cache->mip_thumbs.cache, 0, max_mem);
+  // part of the thumbnail budget can hold compressed thumbnails instead
+  const int packed_share = CLAMP(dt_conf_get_int("cache_memory_compressed"), 0, 90);
+  cache->packed_quota = max_mem / 100 * packed_share;
+  cache->packed_size = 0;
+  cache->packed = g_hash_table_new(NULL, NULL);
+  g_queue_init(&cache->packed_lru);
+  dt_pthread_mutex_init(&cache->packed_mutex, NULL);
+
+  dt_cache_init(&cache->mip_thumbs.cache, 0, max_mem - cache->packed_quota);
   dt_cache_set_allocate_callback(&cache->mip_thumbs.cache, _mipmap_cache_allocate_dynamic, cache);
   dt_cache_set_cleanup_callback(&cache->mip_thumbs.cache, _mipmap_cache_deallocate_dynamic, cache);
 
@@ -773,9 +993,20 @@ void dt_mipmap_cache_cleanup()
   dt_mipmap_cache_t *cache = darktable.mipmap_cache;
   if(!cache) return;
 
+  // no point in compressing what is freed right after
+  cache->packed_quota = 0;
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
+  while(cache->packed_lru.head)
+    _mipmap_packed_drop(cache, cache->packed_lru.head->data);
+  g_hash_table_destroy(cache->packed);
+  dt_pthread_mutex_destroy(&cache->packed_mutex);
+  // the thumbnails evicted above have been written by now
+  for(dt_mipmap_size_t k = DT_MIPMAP_0; k <= DT_MIPMAP_8; k++)
+    dt_mipmap_pack_close(cache->pack[k]);
+  g_hash_table_destroy(cache->upgrade_pending);
+  dt_pthread_mutex_destroy(&cache->upgrade_mutex);
   darktable.mipmap_cache = NULL;
   free(cache);
 }
@@ -785,15 +1016,15 @@ void dt_mipmap_cache_print()
   dt_mipmap_cache_t *cache = darktable.mipmap_cache;
   if(!cache) return;
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] thumbs fill %.2f/%.2f MB (%.2f%%)",
-           cache->mip_thumbs.cache.cost / (1024.0 * 1024.0),
+           dt_cache_cost(&cache->mip_thumbs.cache) / (1024.0 * 1024.0),
            cache->mip_thumbs.cache.cost_quota / (1024.0 * 1024.0),
-           100.0f * (float)cache->mip_thumbs.cache.cost / (float)cache->mip_thumbs.cache.cost_quota);
+           100.0f * (float)dt_cache_cost(&cache->mip_thumbs.cache) / (float)cache->mip_thumbs.cache.cost_quota);
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] float fill %"PRIu32"/%"PRIu32" slots (%.2f%%)",
-           (uint32_t)cache->mip_f.cache.cost, (uint32_t)cache->mip_f.cache.cost_quota,
-           100.0f * (float)cache->mip_f.cache.cost / (float)cache->mip_f.cache.cost_quota);
+           (uint32_t)dt_cache_cost(&cache->mip_f.cache), (uint32_t)cache->mip_f.cache.cost_quota,
+           100.0f * (float)dt_cache_cost(&cache->mip_f.cache) / (float)cache->mip_f.cache.cost_quota);
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] full  fill %"PRIu32"/%"PRIu32" slots (%.2f%%)",
-           (uint32_t)cache->mip_full.cache.cost, (uint32_t)cache->mip_full.cache.cost_quota,
-           100.0f * (float)cache->mip_full.cache.cost / (float)cache->mip_full.cache.cost_quota);
+           (uint32_t)dt_cache_cost(&cache->mip_full.cache), (uint32_t)cache->mip_full.cache.cost_quota,
+           100.0f * (float)dt_cache_cost(&cache->mip_full.cache) / (float)cache->mip_full.cache.cost_quota);
 
   uint64_t sum = 0;
   uint64_t sum_fetches = 0;
@@ -826,6 +1057,36 @@ void dt_mipmap_cache_print()
            100.0 * cache->mip_full.stats_standin / (float)sum_standins,
            100.0 * cache->mip_full.stats_fetches / (float)sum_fetches,
            100.0 * cache->mip_full.stats_requests / (float)sum);
+
+  dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] level |     hits |   misses | evictions | avg fetch");
+  for(dt_mipmap_size_t k = DT_MIPMAP_0; k < DT_MIPMAP_NONE; k++)
+  {
+    const dt_mipmap_cache_stats_t *st = &cache->stats[k];
+    if(!st->hits && !st->misses) continue;
+    dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] %5s | %8ld | %8ld | %9ld | %6.1fms",
+             dt_mipmap_cache_level_name(k),
+             st->hits, st->misses, st->evictions,
+             st->misses ? st->fetch_ms / (double)st->misses : 0.0);
+  }
+}
+
+const char *dt_mipmap_cache_level_name(const dt_mipmap_size_t mip)
+{
+  static const char *names[DT_MIPMAP_NONE] =
+    { "mip0", "mip1", "mip2", "mip3", "mip4", "mip5", "mip6", "mip7", "mip8", "float", "full" };
+  return mip >= DT_MIPMAP_0 && mip < DT_MIPMAP_NONE ? names[mip] : "none";
+}
+
+void dt_mipmap_cache_get_stats(const dt_mipmap_size_t mip,
+                               dt_mipmap_cache_stats_t *stats)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(!cache || mip < DT_MIPMAP_0 || mip >= DT_MIPMAP_NONE)
+  {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+  *stats = cache->stats[mip];
 }
 
 static gboolean _raise_signal_mipmap_updated(gpointer user_data)
@@ -834,6 +1095,75 @@ static gboolean _raise_signal_mipmap_updated(gpointer user_data)
   return FALSE; // only call once
 }
 
+/* two-tier thumbnails: the small mips of imported images are served from
+   the embedded preview at once, this job renders them with the pipe once
+   darktable is idle and replaces the provisional ones.
+*/
+static int32_t _upgrade_thumbs_job_run(dt_job_t *job)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  int upgraded = 0;
+  while(dt_control_running())
+  {
+    // wait for user inactivity and for all other jobs to be done
+    if(dt_get_wtime() < darktable.backthumbs.time || dt_control_jobs_pending() > 1)
+    {
+      g_usleep(250000);
+      continue;
+    }
+
+    dt_pthread_mutex_lock(&cache->upgrade_mutex);
+    GHashTableIter iter;
+    gpointer key_ptr = NULL;
+    g_hash_table_iter_init(&iter, cache->upgrade_pending);
+    const gboolean found = g_hash_table_iter_next(&iter, &key_ptr, NULL);
+    if(found) g_hash_table_iter_remove(&iter);
+    else cache->upgrade_running = FALSE;
+    dt_pthread_mutex_unlock(&cache->upgrade_mutex);
+    if(!found) break;
+
+    const uint32_t key = GPOINTER_TO_UINT(key_ptr);
+    const dt_imgid_t imgid = _get_imgid(key);
+    const dt_mipmap_size_t mip = _get_size(key);
+
+    // render it, the new buffer raises DT_SIGNAL_DEVELOP_MIPMAP_UPDATED
+    dt_atomic_set_int(&cache->upgrading, imgid);
+    dt_mipmap_cache_evict_at_size(imgid, mip);
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(&buf, imgid, mip, DT_MIPMAP_BLOCKING, 'r');
+    dt_mipmap_cache_release(&buf);
+    dt_atomic_set_int(&cache->upgrading, NO_IMGID);
+    upgraded++;
+  }
+
+  dt_pthread_mutex_lock(&cache->upgrade_mutex);
+  cache->upgrade_running = FALSE;
+  dt_pthread_mutex_unlock(&cache->upgrade_mutex);
+
+  dt_print(DT_DEBUG_CACHE, "[mipmap_cache] %d provisional thumbnails rendered", upgraded);
+  return 0;
+}
+
+static void _queue_upgrade(dt_mipmap_cache_t *cache, const uint32_t key)
+{
+  dt_pthread_mutex_lock(&cache->upgrade_mutex);
+  g_hash_table_add(cache->upgrade_pending, GUINT_TO_POINTER(key));
+  const gboolean start = !cache->upgrade_running;
+  cache->upgrade_running = TRUE;
+  dt_pthread_mutex_unlock(&cache->upgrade_mutex);
+
+  if(start)
+  {
+    dt_job_t *job = dt_control_job_create(&_upgrade_thumbs_job_run, "render provisional thumbnails");
+    if(!job || dt_control_add_job(DT_JOB_QUEUE_SYSTEM_BG, job))
+    {
+      dt_pthread_mutex_lock(&cache->upgrade_mutex);
+      cache->upgrade_running = FALSE;
+      dt_pthread_mutex_unlock(&cache->upgrade_mutex);
+    }
+  }
+}
+
 static dt_mipmap_cache_one_t *_get_cache(dt_mipmap_cache_t *cache,
                                          const dt_mipmap_size_t mip)
 {
@@ -848,6 +1178,267 @@ static dt_mipmap_cache_one_t *_get_cache(dt_mipmap_cache_t *cache,
   }
 }
 
+// decoded sensor data of raw files, kept on disk so repeated exports
+// skip the decoder. the uncompressed mip payload follows this header.
+#define DT_MIPMAP_RAW_CACHE_MAGIC 0xD7AA01
+#define DT_MIPMAP_RAW_CACHE_FLAGS (DT_IMAGE_LDR | DT_IMAGE_RAW | DT_IMAGE_HDR \
+                                   | DT_IMAGE_S_RAW | DT_IMAGE_4BAYER | DT_IMAGE_MONOCHROME)
+
+typedef struct _raw_disk_header_t
+{
+  uint32_t magic;
+  uint32_t header_size;
+  uint64_t payload_size;
+  int32_t width, height;
+  int32_t crop_x, crop_y, crop_right, crop_bottom;
+  int32_t flags;
+  dt_image_loader_t loader;
+  dt_iop_buffer_dsc_t buf_dsc;
+  uint16_t raw_black_level;
+  uint16_t raw_black_level_separate[4];
+  uint32_t raw_white_point;
+  uint32_t fuji_rotation_pos;
+  float pixel_aspect_ratio;
+  dt_aligned_pixel_t wb_coeffs;
+  float adobe_XYZ_to_CAM[4][3];
+  gboolean camera_missing_sample;
+  char camera_maker[64];
+  char camera_model[64];
+  char camera_alias[64];
+  char camera_makermodel[128];
+  char exif_maker[64];
+  char exif_model[64];
+} _raw_disk_header_t;
+
+G_LOCK_DEFINE_STATIC(_raw_disk_prune);
+
+// the entry is keyed by path, size, mtime and inode of the file and the
+// darktable version, as a newer decoder might crop or scale differently.
+static gboolean _raw_disk_path(const dt_mipmap_cache_t *cache,
+                               const char *filename,
+                               char *path,
+                               const size_t size)
+{
+  GStatBuf st;
+  if(!cache->cachedir[0] || g_stat(filename, &st)) return FALSE;
+
+  gchar *id = g_strdup_printf("%s|%" G_GINT64_FORMAT "|%" G_GINT64_FORMAT "|%" G_GUINT64_FORMAT "|%s",
+                              filename, (gint64)st.st_size, (gint64)st.st_mtime,
+                              (guint64)st.st_ino, darktable_package_version);
+  gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, id, -1);
+  snprintf(path, size, "%s.d/raw/%s.dtraw", cache->cachedir, hash);
+  g_free(hash);
+  g_free(id);
+  return TRUE;
+}
+
+static size_t _raw_disk_payload_size(const dt_image_t *img)
+{
+  return (size_t)img->width * img->height * dt_iop_buffer_dsc_to_bpp(&img->buf_dsc);
+}
+
+// returns TRUE if there is no usable entry, the caller decodes then
+static gboolean _raw_disk_read(dt_image_t *img,
+                               const char *filename,
+                               const char *path,
+                               dt_mipmap_buffer_t *buf)
+{
+  FILE *f = g_fopen(path, "rb");
+  if(!f) return TRUE;
+
+  _raw_disk_header_t h;
+  gboolean error = fread(&h, sizeof(h), 1, f) != 1
+    || h.magic != DT_MIPMAP_RAW_CACHE_MAGIC
+    || h.header_size != sizeof(h);
+
+  if(!error)
+  {
+    // the raw loaders read the exif data on their own, so do we
+    if(!img->exif_inited) (void)dt_exif_read(img, filename);
+
+    img->width = h.width;
+    img->height = h.height;
+    img->crop_x = h.crop_x;
+    img->crop_y = h.crop_y;
+    img->crop_right = h.crop_right;
+    img->crop_bottom = h.crop_bottom;
+    img->p_width = img->width - img->crop_x - img->crop_right;
+    img->p_height = img->height - img->crop_y - img->crop_bottom;
+    img->flags = (img->flags & ~DT_MIPMAP_RAW_CACHE_FLAGS) | (h.flags & DT_MIPMAP_RAW_CACHE_FLAGS);
+    img->loader = h.loader;
+    img->buf_dsc = h.buf_dsc;
+    img->raw_black_level = h.raw_black_level;
+    memcpy(img->raw_black_level_separate, h.raw_black_level_separate, sizeof(h.raw_black_level_separate));
+    img->raw_white_point = h.raw_white_point;
+    img->fuji_rotation_pos = h.fuji_rotation_pos;
+    img->pixel_aspect_ratio = h.pixel_aspect_ratio;
+    copy_pixel(img->wb_coeffs, h.wb_coeffs);
+    memcpy(img->adobe_XYZ_to_CAM, h.adobe_XYZ_to_CAM, sizeof(h.adobe_XYZ_to_CAM));
+    img->camera_missing_sample = h.camera_missing_sample;
+    g_strlcpy(img->camera_maker, h.camera_maker, sizeof(img->camera_maker));
+    g_strlcpy(img->camera_model, h.camera_model, sizeof(img->camera_model));
+    g_strlcpy(img->camera_alias, h.camera_alias, sizeof(img->camera_alias));
+    g_strlcpy(img->camera_makermodel, h.camera_makermodel, sizeof(img->camera_makermodel));
+    g_strlcpy(img->exif_maker, h.exif_maker, sizeof(img->exif_maker));
+    g_strlcpy(img->exif_model, h.exif_model, sizeof(img->exif_model));
+
+    const size_t payload = _raw_disk_payload_size(img);
+    void *out = payload == h.payload_size ? dt_mipmap_cache_alloc(buf, img) : NULL;
+    error = !out || fread(out, 1, payload, f) != payload;
+  }
+  fclose(f);
+
+  if(error)
+  {
+    dt_print(DT_DEBUG_CACHE, "[mipmap_cache] dropping unusable raw cache entry '%s'", path);
+    g_unlink(path);
+    return TRUE;
+  }
+
+  // the modification time orders the entries for pruning
+  g_utime(path, NULL);
+  return FALSE;
+}
+
+// drop the least recently used entries until the cache fits its size cap
+static void _raw_disk_prune(const dt_mipmap_cache_t *cache)
+{
+  const int64_t limit = (int64_t)dt_conf_get_int("cache_disk_backend_raw_size") << 20;
+  char dirname[PATH_MAX] = { 0 };
+  snprintf(dirname, sizeof(dirname), "%s.d/raw", cache->cachedir);
+
+  G_LOCK(_raw_disk_prune);
+  GDir *dir = g_dir_open(dirname, 0, NULL);
+  if(!dir)
+  {
+    G_UNLOCK(_raw_disk_prune);
+    return;
+  }
+
+  typedef struct { gchar *path; int64_t size; gint64 mtime; } _entry_t;
+  GArray *entries = g_array_new(FALSE, FALSE, sizeof(_entry_t));
+  int64_t total = 0;
+  const gchar *name;
+  while((name = g_dir_read_name(dir)))
+  {
+    if(!g_str_has_suffix(name, ".dtraw")) continue;
+    GStatBuf st;
+    gchar *path = g_build_filename(dirname, name, NULL);
+    if(g_stat(path, &st))
+    {
+      g_free(path);
+      continue;
+    }
+    const _entry_t e = { path, (int64_t)st.st_size, (gint64)st.st_mtime };
+    g_array_append_val(entries, e);
+    total += e.size;
+  }
+  g_dir_close(dir);
+
+  for(guint round = 0; total > limit && entries->len; round++)
+  {
+    // find the oldest, there are rarely more than a few to drop
+    guint oldest = 0;
+    for(guint k = 1; k < entries->len; k++)
+      if(g_array_index(entries, _entry_t, k).mtime < g_array_index(entries, _entry_t, oldest).mtime)
+        oldest = k;
+    _entry_t *e = &g_array_index(entries, _entry_t, oldest);
+    g_unlink(e->path);
+    total -= e->size;
+    g_free(e->path);
+    g_array_remove_index_fast(entries, oldest);
+  }
+
+  for(guint k = 0; k < entries->len; k++)
+    g_free(g_array_index(entries, _entry_t, k).path);
+  g_array_free(entries, TRUE);
+  G_UNLOCK(_raw_disk_prune);
+}
+
+static void _raw_disk_write(const dt_mipmap_cache_t *cache,
+                            const dt_image_t *img,
+                            const char *path,
+                            const dt_mipmap_buffer_t *buf)
+{
+  _raw_disk_header_t h = { 0 };
+  h.magic = DT_MIPMAP_RAW_CACHE_MAGIC;
+  h.header_size = sizeof(h);
+  h.payload_size = _raw_disk_payload_size(img);
+  h.width = img->width;
+  h.height = img->height;
+  h.crop_x = img->crop_x;
+  h.crop_y = img->crop_y;
+  h.crop_right = img->crop_right;
+  h.crop_bottom = img->crop_bottom;
+  h.flags = img->flags;
+  h.loader = img->loader;
+  h.buf_dsc = img->buf_dsc;
+  h.raw_black_level = img->raw_black_level;
+  memcpy(h.raw_black_level_separate, img->raw_black_level_separate, sizeof(h.raw_black_level_separate));
+  h.raw_white_point = img->raw_white_point;
+  h.fuji_rotation_pos = img->fuji_rotation_pos;
+  h.pixel_aspect_ratio = img->pixel_aspect_ratio;
+  copy_pixel(h.wb_coeffs, img->wb_coeffs);
+  memcpy(h.adobe_XYZ_to_CAM, img->adobe_XYZ_to_CAM, sizeof(h.adobe_XYZ_to_CAM));
+  h.camera_missing_sample = img->camera_missing_sample;
+  g_strlcpy(h.camera_maker, img->camera_maker, sizeof(h.camera_maker));
+  g_strlcpy(h.camera_model, img->camera_model, sizeof(h.camera_model));
+  g_strlcpy(h.camera_alias, img->camera_alias, sizeof(h.camera_alias));
+  g_strlcpy(h.camera_makermodel, img->camera_makermodel, sizeof(h.camera_makermodel));
+  g_strlcpy(h.exif_maker, img->exif_maker, sizeof(h.exif_maker));
+  g_strlcpy(h.exif_model, img->exif_model, sizeof(h.exif_model));
+
+  gchar *dirname = g_path_get_dirname(path);
+  g_mkdir_with_parents(dirname, 0750);
+  g_free(dirname);
+
+  // write under a temporary name, concurrent workers only ever see complete entries
+  gchar *tmp = g_strdup_printf("%s.XXXXXX", path);
+  const int fd = g_mkstemp(tmp);
+  FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+  gboolean error = !f;
+  if(f)
+  {
+    error = fwrite(&h, sizeof(h), 1, f) != 1
+      || fwrite(buf->buf, 1, h.payload_size, f) != h.payload_size;
+    error |= fclose(f) != 0;
+  }
+  else if(fd >= 0)
+    close(fd);
+
+  if(error || g_rename(tmp, path))
+  {
+    dt_print(DT_DEBUG_CACHE, "[mipmap_cache] could not write raw cache entry '%s'", path);
+    g_unlink(tmp);
+  }
+  else
+    _raw_disk_prune(cache);
+  g_free(tmp);
+}
+
+// weight of a freshly generated buffer in the cache lru, see dt_cache_entry_t.
+// one more gc pass it survives per 4x the time it took, starting at 25ms.
+static uint8_t _regen_weight(const dt_mipmap_cache_t *cache,
+                             const dt_mipmap_size_t mip,
+                             const dt_mipmap_buffer_dsc_t *dsc,
+                             const double seconds)
+{
+  // thumbnails kept on eviction come back cheaply from there
+  if(mip < DT_MIPMAP_8
+     && !(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_PROVISIONAL)
+     && (cache->packed_quota
+         || (cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend"))))
+    return 0;
+  if(mip == DT_MIPMAP_8
+     && cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend_full"))
+    return 0;
+
+  uint8_t weight = 0;
+  for(double t = 0.025; seconds > t && weight < 4; t *= 4.0)
+    weight++;
+  return weight;
+}
+
 void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
                                     const dt_imgid_t imgid,
                                     const dt_mipmap_size_t mip,
@@ -914,10 +1505,8 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     if(!cache->cachedir[0]) return;
     if(mip > DT_MIPMAP_FULL || mip < DT_MIPMAP_0)
       return;
-    char filename[PATH_MAX] = {0};
-    snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
     // don't attempt to load if disk cache doesn't exist
-    if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
+    if(!dt_mipmap_cache_has_disk_thumbnail(imgid, mip)) return;
     dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
   }
   else if(flags == DT_MIPMAP_BLOCKING)
@@ -930,10 +1519,17 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)entry->data;
     buf->cache_entry = entry;
 
+    // still write locked by the allocation if fresh
+    if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_FRESH)
+      dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_FRESH;
+    else
+      __sync_fetch_and_add(&cache->stats[mip].hits, 1);
+
     gboolean mipmap_generated = FALSE;
     if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE)
     {
       mipmap_generated = TRUE;
+      const double start = dt_get_wtime();
 
       __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_fetches), 1);
       // dt_print(DT_DEBUG_ALWAYS, "[mipmap cache get] now initializing buffer for img %u mip %d!", imgid, mip);
@@ -946,6 +1542,9 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
         dt_image_t DT_ALIGNED_ARRAY buffered_image;
         const dt_image_t *cimg = dt_image_cache_get(imgid, 'r');
         buffered_image = *cimg;
+        // keep the in-memory file alive while decoding, the image
+        // might be evicted from the cache meanwhile
+        if(buffered_image.raw_buffer) g_bytes_ref(buffered_image.raw_buffer);
         // dt_image_t *img = dt_image_cache_write_get(cimg);
         // dt_image_cache_write_release(img, DT_IMAGE_CACHE_RELAXED);
         dt_image_cache_read_release(cimg);
@@ -960,7 +1559,29 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
         buf->width = buf->height = 0;
         buf->iscale = 0.0f;
         buf->color_space = DT_COLORSPACE_NONE; // TODO: does the full buffer need to know this?
-        dt_imageio_retval_t ret = dt_imageio_open(&buffered_image, filename, buf); // TODO: color_space?
+        char raw_path[PATH_MAX] = { 0 };
+        const gboolean raw_disk = dt_conf_get_bool("cache_disk_backend_raw")
+          && !buffered_image.raw_buffer
+          && _raw_disk_path(cache, filename, raw_path, sizeof(raw_path));
+        dt_imageio_retval_t ret = DT_IMAGEIO_OK;
+        if(!raw_disk || _raw_disk_read(&buffered_image, filename, raw_path, buf))
+        {
+          const double decode_start = dt_get_wtime();
+          ret = dt_imageio_open(&buffered_image, filename, buf); // TODO: color_space?
+          if(dt_trace_enabled())
+          {
+            char detail[48];
+            snprintf(detail, sizeof(detail), "ID=%d, loader %d", imgid, buffered_image.loader);
+            dt_trace_span("io", "decode", DT_TRACE_CPU, decode_start, dt_get_wtime(), detail);
+          }
+          if(raw_disk && ret == DT_IMAGEIO_OK
+             && (buffered_image.loader == LOADER_RAWSPEED || buffered_image.loader == LOADER_LIBRAW)
+             && (buffered_image.flags & (DT_IMAGE_RAW | DT_IMAGE_S_RAW))
+             && !buffered_image.profile)
+            _raw_disk_write(cache, &buffered_image, raw_path, buf);
+        }
+        else
+          dt_print(DT_DEBUG_CACHE, "[mipmap_cache] full buffer of ID=%d read from '%s'", imgid, raw_path);
         buf->loader_status = ret;
         // might have been reallocated:
         ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
@@ -969,7 +1590,10 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
         {
           // swap back new image data:
           dt_image_t *img = dt_image_cache_get(imgid, 'w');
+          // the cache entry keeps its own reference to the file content
+          GBytes *raw_buffer = img->raw_buffer;
           *img = buffered_image;
+          img->raw_buffer = raw_buffer;
           img->load_status = DT_IMAGEIO_OK;
           // dt_print(DT_DEBUG_ALWAYS, "[mipmap read get] initializing full buffer img %u with %u %u -> %d %d (%p)",
           // imgid, data[0], data[1], img->width, img->height, data);
@@ -996,6 +1620,7 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
           // don't write xmp for this (we only changed db stuff):
           dt_image_cache_write_release(img, DT_IMAGE_CACHE_RELAXED);
         }
+        if(buffered_image.raw_buffer) g_bytes_unref(buffered_image.raw_buffer);
       }
       else if(mip == DT_MIPMAP_F)
       {
@@ -1006,10 +1631,29 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
       {
         // 8-bit thumbs
         ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(dt_mipmap_buffer_dsc_t));
-        _init_8((uint8_t *)(dsc + 1), &dsc->width, &dsc->height, &dsc->iscale, &buf->color_space, imgid, mip);
+        gboolean provisional = FALSE;
+        _init_8((uint8_t *)(dsc + 1), &dsc->width, &dsc->height, &dsc->iscale, &buf->color_space,
+                imgid, mip, &provisional);
+        if(provisional)
+        {
+          dsc->flags |= DT_MIPMAP_BUFFER_DSC_FLAG_PROVISIONAL;
+          _queue_upgrade(cache, key);
+        }
+        else
+          dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_PROVISIONAL;
       }
       dsc->color_space = buf->color_space;
       dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
+
+      const double elapsed = dt_get_wtime() - start;
+      __sync_fetch_and_add(&cache->stats[mip].fetch_ms, (long int)(1000.0 * elapsed));
+      if(dt_trace_enabled())
+      {
+        char detail[32];
+        snprintf(detail, sizeof(detail), "ID=%d mip %d", imgid, mip);
+        dt_trace_span("cache", "mipmap miss", DT_TRACE_CPU, start, start + elapsed, detail);
+      }
+      entry->weight = _regen_weight(cache, mip, dsc, elapsed);
     }
 
     // image cache is leaving the write lock in place in case the image has been newly allocated.
@@ -1120,13 +1764,15 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
       if(buf->buf && buf->width > 0 && buf->height > 0)
       {
         if(mip != k) __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_standin), 1);
+        else __sync_fetch_and_add(&cache->stats[mip].hits, 1);
         return;
       }
       // didn't succeed the first time? prefetch for later!
-      if(mip == k)
+      // the request is repeated as long as the thumbnail is shown.
+      if(mip == k && mip <= DT_MIPMAP_FULL)
       {
         __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_near_match), 1);
-        dt_mipmap_cache_get(buf, imgid, mip, DT_MIPMAP_PREFETCH, 'r');
+        dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, dt_image_thumbnail_job_create(imgid, mip));
       }
     }
     // couldn't find a smaller thumb, try larger ones only now (these will be slightly slower due to cairo rescaling):
@@ -1144,13 +1790,8 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_misses), 1);
     // in case we don't even have a disk cache for our requested thumbnail,
     // prefetch at least mip0, in case we have that in the disk caches:
-    if(cache->cachedir[0])
-    {
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
-        dt_mipmap_cache_get(0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
-    }
+    if(dt_mipmap_cache_has_disk_thumbnail(imgid, mip))
+      dt_mipmap_cache_get(0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
     // nothing found :(
     buf->buf = NULL;
     buf->imgid = NO_IMGID;
@@ -1437,7 +2078,8 @@ static void _init_8(uint8_t *buf,
                     float *iscale,
                     dt_colorspaces_color_profile_type_t *color_space,
                     const dt_imgid_t imgid,
-                    const dt_mipmap_size_t size)
+                    const dt_mipmap_size_t size,
+                    gboolean *provisional)
 {
   *iscale = 1.0f;
   const uint32_t wd = *width, ht = *height;
@@ -1465,7 +2107,13 @@ static void _init_8(uint8_t *buf,
 
   const char *min = dt_conf_get_string_const("plugins/lighttable/thumbnail_raw_min_level");
   const dt_mipmap_size_t min_s = dt_mipmap_cache_get_min_mip_from_pref(min);
-  const gboolean use_embedded = (size <= min_s);
+  // with two-tier thumbnails the small mips come from the embedded
+  // preview first and are rendered by the pipe later
+  const gboolean quick = size > min_s
+    && size <= DT_MIPMAP_2
+    && dt_conf_get_bool("plugins/lighttable/thumbnail_two_tier")
+    && dt_atomic_get_int(&darktable.mipmap_cache->upgrading) != imgid;
+  const gboolean use_embedded = (size <= min_s) || quick;
 
   if(!altered && use_embedded && !incompatible)
   {
@@ -1484,6 +2132,11 @@ static void _init_8(uint8_t *buf,
       dt_imageio_jpeg_t jpg;
       if(!dt_imageio_jpeg_read_header(filename, &jpg))
       {
+        // no need to decode more than the thumbnail size
+        if(orientation & ORIENTATION_SWAP_XY)
+          dt_imageio_jpeg_set_scale(&jpg, ht, wd);
+        else
+          dt_imageio_jpeg_set_scale(&jpg, wd, ht);
         uint8_t *tmp = dt_alloc_align_uint8((size_t)jpg.width * jpg.height * 4);
         *color_space = dt_imageio_jpeg_read_color_space(&jpg);
         if(!dt_imageio_jpeg_read(&jpg, tmp))
@@ -1501,7 +2154,9 @@ static void _init_8(uint8_t *buf,
     {
       uint8_t *tmp = 0;
       int32_t thumb_width, thumb_height;
-      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, color_space);
+      const gboolean swap = orientation & ORIENTATION_SWAP_XY;
+      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, color_space,
+                                       swap ? ht : wd, swap ? wd : ht);
       if(!res)
       {
         // if the thumbnail is not large enough, we compute one
@@ -1528,6 +2183,7 @@ static void _init_8(uint8_t *buf,
         dt_free_align(tmp);
       }
     }
+    *provisional = !res && quick;
   }
 
   if(res)
@@ -1607,6 +2263,20 @@ dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace()
   return DT_COLORSPACE_DISPLAY;
 }
 
+gboolean dt_mipmap_cache_has_disk_thumbnail(const dt_imgid_t imgid,
+                                            const dt_mipmap_size_t mip)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(!cache || !cache->cachedir[0] || mip < DT_MIPMAP_0 || mip > DT_MIPMAP_8)
+    return FALSE;
+  if(cache->pack[mip] && dt_mipmap_pack_contains(cache->pack[mip], imgid))
+    return TRUE;
+
+  char filename[PATH_MAX] = {0};
+  snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
+  return dt_util_test_image_file(filename);
+}
+
 void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid,
                                      const dt_imgid_t src_imgid)
 {
@@ -1620,6 +2290,17 @@ void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid,
   {
     for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_F; mip++)
     {
+      dt_mipmap_pack_t *pack = cache->pack[mip];
+      size_t len = 0;
+      dt_colorspaces_color_profile_type_t color_space = DT_COLORSPACE_NONE;
+      const uint8_t *blob = pack ? dt_mipmap_pack_get(pack, src_imgid, &len, &color_space) : NULL;
+      if(blob)
+      {
+        dt_mipmap_pack_write(pack, dst_imgid, blob, len, color_space);
+        dt_mipmap_pack_release(pack);
+        continue;
+      }
+
       // try and load from disk, if successful set flag
       char srcpath[PATH_MAX] = {0};
       char dstpath[PATH_MAX] = {0};
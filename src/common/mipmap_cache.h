@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "common/atomic.h"
 #include "common/cache.h"
 #include "common/colorspaces.h"
 #include "common/image.h"
@@ -88,6 +89,15 @@ typedef struct dt_mipmap_cache_one_t
   long int stats_standin;    // texture used as stand-in
 } dt_mipmap_cache_one_t;
 
+// per level counters, the ones above are per cache
+typedef struct dt_mipmap_cache_stats_t
+{
+  long int hits;      // served from memory at the requested level
+  long int misses;    // had to be read from disk or generated
+  long int evictions; // dropped from memory to make room
+  long int fetch_ms;  // time spent generating the misses
+} dt_mipmap_cache_stats_t;
+
 typedef struct dt_mipmap_cache_t
 {
   // real width and height are stored per element
@@ -102,6 +112,24 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+
+  dt_mipmap_cache_stats_t stats[DT_MIPMAP_NONE];
+
+  // provisional thumbnails waiting to be rendered by the pipe
+  dt_pthread_mutex_t upgrade_mutex;
+  GHashTable *upgrade_pending;
+  gboolean upgrade_running;
+  dt_atomic_int upgrading; // image being rendered right now
+
+  // packed disk thumbnails per level, the per-file jpegs next to them are
+  // still read for caches written by older versions
+  struct dt_mipmap_pack_t *pack[DT_MIPMAP_8 + 1];
+
+  // thumbnails evicted from mip_thumbs, kept QOI compressed in memory
+  dt_pthread_mutex_t packed_mutex;
+  GHashTable *packed;   // key -> packed thumbnail
+  GQueue packed_lru;    // head is dropped first
+  size_t packed_size, packed_quota;
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
@@ -112,6 +140,11 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img);
 void dt_mipmap_cache_init(void);
 void dt_mipmap_cache_cleanup(void);
 void dt_mipmap_cache_print(void);
+// "mip0" ... "mip8", "float", "full"
+const char *dt_mipmap_cache_level_name(const dt_mipmap_size_t mip);
+// a snapshot of the counters of one level
+void dt_mipmap_cache_get_stats(const dt_mipmap_size_t mip,
+                               dt_mipmap_cache_stats_t *stats);
 
 // get a buffer and lock according to mode ('r' or 'w').
 // see dt_mipmap_get_flags_t for explanation of the exact
@@ -149,6 +182,9 @@ dt_mipmap_size_t dt_mipmap_cache_get_matching_size(const int32_t width, const in
 // returns the colorspace to use for created thumbnails, takes config into account
 dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace(void);
 
+// TRUE if the disk cache holds a thumbnail of the image at this size
+gboolean dt_mipmap_cache_has_disk_thumbnail(const dt_imgid_t imgid, const dt_mipmap_size_t mip);
+
 // copy over thumbnails. used by file operation that copies raw files, to speed up thumbnail generation.
 // only copies over the jpg backend on disk, doesn't directly affect the in-memory cache.
 void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid, const dt_imgid_t src_imgid);
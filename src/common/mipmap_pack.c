@@ -0,0 +1,328 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/mipmap_pack.h"
+#include "common/dtpthread.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DT_MIPMAP_PACK_MAGIC 0x504d5444u // "DTMP"
+
+// compact on open once this much of the file is dead
+#define DT_MIPMAP_PACK_MIN_DEAD (16 << 20)
+
+// every thumbnail is a record followed by its jpeg data
+typedef struct _pack_record_t
+{
+  uint32_t magic;
+  int32_t imgid;
+  uint32_t size; // payload bytes, 0 marks a removal
+  int32_t color_space;
+} _pack_record_t;
+
+typedef struct _pack_entry_t
+{
+  uint64_t offset; // of the payload
+  uint32_t size;
+  int32_t color_space;
+} _pack_entry_t;
+
+struct dt_mipmap_pack_t
+{
+  gchar *filename;
+
+  // index, appends and file size
+  dt_pthread_mutex_t mutex;
+  GHashTable *index; // imgid -> _pack_entry_t
+  FILE *f;
+  uint64_t end;
+  uint64_t dead;
+
+  // readers of the mapping against remapping after appends
+  dt_pthread_rwlock_t map_lock;
+  GMappedFile *map;
+  uint64_t mapped;
+};
+
+static void _pack_drop(dt_mipmap_pack_t *pack,
+                       const dt_imgid_t imgid)
+{
+  _pack_entry_t *e = g_hash_table_lookup(pack->index, GINT_TO_POINTER(imgid));
+  if(!e) return;
+  pack->dead += sizeof(_pack_record_t) + e->size;
+  g_hash_table_remove(pack->index, GINT_TO_POINTER(imgid));
+}
+
+// rebuild the index from the records, cutting off a record left
+// incomplete by a crash
+static gboolean _pack_scan(dt_mipmap_pack_t *pack)
+{
+  FILE *f = g_fopen(pack->filename, "r+b");
+  if(!f) return TRUE;
+
+  fseeko(f, 0, SEEK_END);
+  const uint64_t length = ftello(f);
+  fseeko(f, 0, SEEK_SET);
+
+  uint64_t offset = 0;
+  _pack_record_t r;
+  while(offset + sizeof(r) <= length && fread(&r, sizeof(r), 1, f) == 1)
+  {
+    if(r.magic != DT_MIPMAP_PACK_MAGIC
+       || offset + sizeof(r) + r.size > length)
+      break;
+
+    _pack_drop(pack, r.imgid);
+    if(r.size)
+    {
+      _pack_entry_t *e = g_malloc(sizeof(_pack_entry_t));
+      e->offset = offset + sizeof(r);
+      e->size = r.size;
+      e->color_space = r.color_space;
+      g_hash_table_insert(pack->index, GINT_TO_POINTER(r.imgid), e);
+    }
+    else
+      pack->dead += sizeof(r);
+
+    offset += sizeof(r) + r.size;
+    if(fseeko(f, offset, SEEK_SET)) break;
+  }
+
+  if(offset < length)
+  {
+    dt_print(DT_DEBUG_CACHE, "[mipmap_pack] dropping %" PRIu64 " broken bytes at the end of `%s'",
+             length - offset, pack->filename);
+    if(ftruncate(fileno(f), offset)) offset = length;
+  }
+  fclose(f);
+  pack->end = offset;
+  return FALSE;
+}
+
+// rewrite the live records into a new file
+static void _pack_compact(dt_mipmap_pack_t *pack)
+{
+  GMappedFile *map = g_mapped_file_new(pack->filename, FALSE, NULL);
+  if(!map) return;
+  const uint8_t *data = (const uint8_t *)g_mapped_file_get_contents(map);
+
+  gchar *tmp = g_strdup_printf("%s.tmp", pack->filename);
+  FILE *f = g_fopen(tmp, "wb");
+  gboolean error = !f;
+
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, pack->index);
+  while(!error && g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const _pack_entry_t *e = value;
+    const _pack_record_t r = { DT_MIPMAP_PACK_MAGIC, GPOINTER_TO_INT(key), e->size, e->color_space };
+    error = fwrite(&r, sizeof(r), 1, f) != 1
+         || fwrite(data + e->offset, 1, e->size, f) != e->size;
+  }
+  if(f) error |= fclose(f) != 0;
+  g_mapped_file_unref(map);
+
+  if(error || g_rename(tmp, pack->filename))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] could not compact `%s'", pack->filename);
+    g_unlink(tmp);
+  }
+  else
+  {
+    dt_print(DT_DEBUG_CACHE, "[mipmap_pack] compacted `%s', %" PRIu64 " bytes dropped",
+             pack->filename, pack->dead);
+    g_hash_table_remove_all(pack->index);
+    pack->dead = 0;
+    _pack_scan(pack);
+  }
+  g_free(tmp);
+}
+
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *filename)
+{
+  gchar *dirname = g_path_get_dirname(filename);
+  g_mkdir_with_parents(dirname, 0750);
+  g_free(dirname);
+
+  FILE *f = g_fopen(filename, "ab");
+  if(!f)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] could not open `%s'", filename);
+    return NULL;
+  }
+  fclose(f);
+
+  dt_mipmap_pack_t *pack = g_malloc0(sizeof(dt_mipmap_pack_t));
+  pack->filename = g_strdup(filename);
+  pack->index = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+  dt_pthread_mutex_init(&pack->mutex, NULL);
+  dt_pthread_rwlock_init(&pack->map_lock, NULL);
+
+  if(_pack_scan(pack))
+  {
+    dt_mipmap_pack_close(pack);
+    return NULL;
+  }
+
+  if(pack->dead > DT_MIPMAP_PACK_MIN_DEAD && pack->dead > pack->end / 2)
+    _pack_compact(pack);
+
+  pack->f = g_fopen(filename, "ab");
+  if(!pack->f)
+  {
+    dt_mipmap_pack_close(pack);
+    return NULL;
+  }
+
+  dt_print(DT_DEBUG_CACHE, "[mipmap_pack] `%s' holds %u thumbnails",
+           filename, g_hash_table_size(pack->index));
+  return pack;
+}
+
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack)
+{
+  if(!pack) return;
+  if(pack->f) fclose(pack->f);
+  if(pack->map) g_mapped_file_unref(pack->map);
+  g_hash_table_destroy(pack->index);
+  dt_pthread_mutex_destroy(&pack->mutex);
+  dt_pthread_rwlock_destroy(&pack->map_lock);
+  g_free(pack->filename);
+  g_free(pack);
+}
+
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack,
+                                 const dt_imgid_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->mutex);
+  const gboolean found = g_hash_table_contains(pack->index, GINT_TO_POINTER(imgid));
+  dt_pthread_mutex_unlock(&pack->mutex);
+  return found;
+}
+
+const uint8_t *dt_mipmap_pack_get(dt_mipmap_pack_t *pack,
+                                  const dt_imgid_t imgid,
+                                  size_t *size,
+                                  dt_colorspaces_color_profile_type_t *color_space)
+{
+  dt_pthread_mutex_lock(&pack->mutex);
+  const _pack_entry_t *found = g_hash_table_lookup(pack->index, GINT_TO_POINTER(imgid));
+  const _pack_entry_t e = found ? *found : (_pack_entry_t){ 0 };
+  dt_pthread_mutex_unlock(&pack->mutex);
+  if(!found) return NULL;
+
+  const uint64_t needed = e.offset + e.size;
+  dt_pthread_rwlock_rdlock(&pack->map_lock);
+  if(pack->mapped < needed)
+  {
+    // the record was appended after the file was mapped
+    dt_pthread_rwlock_unlock(&pack->map_lock);
+    dt_pthread_rwlock_wrlock(&pack->map_lock);
+    if(pack->mapped < needed)
+    {
+      if(pack->map) g_mapped_file_unref(pack->map);
+      pack->map = g_mapped_file_new(pack->filename, FALSE, NULL);
+      pack->mapped = pack->map ? g_mapped_file_get_length(pack->map) : 0;
+    }
+    dt_pthread_rwlock_unlock(&pack->map_lock);
+    dt_pthread_rwlock_rdlock(&pack->map_lock);
+    if(pack->mapped < needed)
+    {
+      dt_pthread_rwlock_unlock(&pack->map_lock);
+      return NULL;
+    }
+  }
+
+  *size = e.size;
+  *color_space = e.color_space;
+  return (const uint8_t *)g_mapped_file_get_contents(pack->map) + e.offset;
+}
+
+void dt_mipmap_pack_release(dt_mipmap_pack_t *pack)
+{
+  dt_pthread_rwlock_unlock(&pack->map_lock);
+}
+
+static gboolean _pack_append(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t imgid,
+                             const uint8_t *data,
+                             const size_t size,
+                             const dt_colorspaces_color_profile_type_t color_space)
+{
+  const _pack_record_t r = { DT_MIPMAP_PACK_MAGIC, imgid, size, color_space };
+  const gboolean error = fwrite(&r, sizeof(r), 1, pack->f) != 1
+                      || (size && fwrite(data, 1, size, pack->f) != size)
+                      || fflush(pack->f);
+  if(error)
+  {
+    // cut off the partial record, records appended after it would be
+    // lost when the next open stops scanning there
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] could not write to `%s'", pack->filename);
+    clearerr(pack->f);
+    if(fflush(pack->f) || ftruncate(fileno(pack->f), pack->end)
+       || fseeko(pack->f, pack->end, SEEK_SET))
+      pack->end = ftello(pack->f);
+    return TRUE;
+  }
+
+  _pack_drop(pack, imgid);
+  if(size)
+  {
+    _pack_entry_t *e = g_malloc(sizeof(_pack_entry_t));
+    e->offset = pack->end + sizeof(r);
+    e->size = size;
+    e->color_space = color_space;
+    g_hash_table_insert(pack->index, GINT_TO_POINTER(imgid), e);
+  }
+  else
+    pack->dead += sizeof(r);
+  pack->end += sizeof(r) + size;
+  return FALSE;
+}
+
+gboolean dt_mipmap_pack_write(dt_mipmap_pack_t *pack,
+                              const dt_imgid_t imgid,
+                              const uint8_t *data,
+                              const size_t size,
+                              const dt_colorspaces_color_profile_type_t color_space)
+{
+  if(!size || size > UINT32_MAX) return TRUE;
+  dt_pthread_mutex_lock(&pack->mutex);
+  const gboolean error = _pack_append(pack, imgid, data, size, color_space);
+  dt_pthread_mutex_unlock(&pack->mutex);
+  return error;
+}
+
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack,
+                           const dt_imgid_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->mutex);
+  if(g_hash_table_contains(pack->index, GINT_TO_POINTER(imgid)))
+    _pack_append(pack, imgid, NULL, 0, DT_COLORSPACE_NONE);
+  dt_pthread_mutex_unlock(&pack->mutex);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
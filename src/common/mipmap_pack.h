@@ -0,0 +1,59 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/colorspaces.h"
+#include "common/darktable.h"
+#include <glib.h>
+
+// a packed store of the disk thumbnails of one mip level: one append-only
+// file of records, memory mapped for reading, with an in-memory index by
+// image id. a removed or replaced thumbnail leaves a dead record, which is
+// dropped when the file is compacted on open.
+typedef struct dt_mipmap_pack_t dt_mipmap_pack_t;
+
+// open or create the pack, NULL if the file cannot be used
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *filename);
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack);
+
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack,
+                                 const dt_imgid_t imgid);
+
+// returns the thumbnail data in the mapping, or NULL. the pack stays read
+// locked until dt_mipmap_pack_release() when data is returned.
+const uint8_t *dt_mipmap_pack_get(dt_mipmap_pack_t *pack,
+                                  const dt_imgid_t imgid,
+                                  size_t *size,
+                                  dt_colorspaces_color_profile_type_t *color_space);
+void dt_mipmap_pack_release(dt_mipmap_pack_t *pack);
+
+// append a thumbnail, replacing the one of the image if any. TRUE on error.
+gboolean dt_mipmap_pack_write(dt_mipmap_pack_t *pack,
+                              const dt_imgid_t imgid,
+                              const uint8_t *data,
+                              const size_t size,
+                              const dt_colorspaces_color_profile_type_t color_space);
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack,
+                           const dt_imgid_t imgid);
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -90,6 +90,19 @@ static int scatter(
   return scale * ((abs_i1 * abs_i1 * abs_i1 + 7.0 * abs_i1 * sqrt(abs_i2)) * sign(index1) * scattering / 6.0 + index1);
 }
 
+// order patches by increasing distance from the pixel being denoised
+static int patch_distance_cmp(const void *a, const void *b)
+{
+  const patch_t *const pa = (const patch_t *)a;
+  const patch_t *const pb = (const patch_t *)b;
+  const int da = pa->rows * pa->rows + pa->cols * pa->cols;
+  const int db = pb->rows * pb->rows + pb->cols * pb->cols;
+  if(da != db) return da - db;
+  // break ties by position so the order does not depend on the sort implementation
+  if(pa->rows != pb->rows) return pa->rows - pb->rows;
+  return pa->cols - pb->cols;
+}
+
 // allocate and fill an array of patch definitions
 static struct patch_t* define_patches(
         const dt_nlmeans_param_t *const params,
@@ -128,6 +141,10 @@ static struct patch_t* define_patches(
       patch_num++;
     }
   }
+  // with early exit, the closest patches have to come first so that stopping early still
+  //   compares the most likely matches
+  if(params->early_exit > 0.0f)
+    qsort(patches, n_patches, sizeof(patch_t), patch_distance_cmp);
   *max_shift = shift;
   return patches;
 }
@@ -273,6 +290,25 @@ static void init_column_sums(
 }
 
 
+// check whether all pixels of a slice already gathered enough weight to consider the slice flat
+static gboolean slice_is_flat(
+        const float *const outbuf,
+        const int width,
+        const int chunk_top,
+        const int chunk_bot,
+        const int chunk_left,
+        const int chunk_right,
+        const float min_weight)
+{
+  for(int row = chunk_top; row < chunk_bot; row++)
+  {
+    const float *const out = outbuf + (size_t)4 * width * row;
+    for(int col = chunk_left; col < chunk_right; col++)
+      if(out[4*col+3] < min_weight) return FALSE;
+  }
+  return TRUE;
+}
+
 // determine the height of the horizontal slice each thread will process
 static int compute_slice_height(const int height)
 {
@@ -321,8 +357,11 @@ static int compute_slice_width(const int width)
   return sl_width;
 }
 
+// how often to check whether a slice is flat enough to stop searching early
+#define EARLY_EXIT_INTERVAL 8
+
 __DT_CLONE_TARGETS__
-void nlmeans_denoise(
+float nlmeans_denoise(
         const float *const inbuf,
         float *const outbuf,
         const dt_iop_roi_t *const roi_in,
@@ -355,7 +394,9 @@ void nlmeans_denoise(
   float *const restrict scratch_buf = dt_alloc_perthread_float(scratch_size, &padded_scratch_size);
   const int chk_height = compute_slice_height(roi_out->height);
   const int chk_width = compute_slice_width(roi_out->width);
-  DT_OMP_FOR(collapse(2))
+  const float min_weight = params->early_exit * num_patches;
+  size_t compared = 0;
+  DT_OMP_FOR(collapse(2) reduction(+ : compared))
   for(int chunk_top = 0 ; chunk_top < roi_out->height; chunk_top += chk_height)
   {
     for(int chunk_left = 0; chunk_left < roi_out->width; chunk_left += chk_width)
@@ -374,8 +415,14 @@ void nlmeans_denoise(
         memset(outbuf + 4*(i*roi_out->width+chunk_left), '\0', sizeof(float) * 4 * (chunk_right-chunk_left));
       }
       // cycle through all of the patches over our slice of the image
-      for(int p = 0; p < num_patches; p++)
+      int p;
+      for(p = 0; p < num_patches; p++)
       {
+        // stop searching once all pixels of a flat slice found plenty of matching patches
+        if(min_weight > 0.0f && p > 0 && p % EARLY_EXIT_INTERVAL == 0
+           && slice_is_flat(outbuf, roi_out->width, chunk_top, chunk_bot, chunk_left, chunk_right, min_weight))
+          break;
+
         // retrieve info about the current patch
         const patch_t *patch = &patches[p];
         // skip any rows where the patch center would be above top of RoI or below bottom of RoI
@@ -502,6 +549,7 @@ void nlmeans_denoise(
           }
         }
       }
+      compared += p;
       if(skip_blend)
       {
         // normalize the pixels
@@ -539,7 +587,11 @@ void nlmeans_denoise(
   // clean up: free the work space
   dt_free_align(patches);
   dt_free_align(scratch_buf);
-  return;
+
+  const int full_patches = (2 * params->search_radius + 1) * (2 * params->search_radius + 1);
+  const size_t slices = (size_t)((roi_out->height + chk_height - 1) / chk_height)
+                        * ((roi_out->width + chk_width - 1) / chk_width);
+  return (float)compared / (float)(full_patches * slices);
 }
 
 /**************************************************************/
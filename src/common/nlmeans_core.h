@@ -30,6 +30,7 @@ struct dt_nlmeans_param_t
   int patch_radius;	// radius of patches which are compared, 1..4
   int search_radius;	// radius around a pixel in which to compare patches (default = 7)
   int decimate;         // set to 1 to search only half the patches in the neighborhood (default = 0)
+  float early_exit;     // stop searching a slice once all its pixels gathered this share of the patches' weight (default = 0, search all)
   const float* const norm; // array of four per-channel weight factors
   dt_dev_pixelpipe_type_t pipetype;
   int kernel_init;	// CL: initialization (runs once)
@@ -40,7 +41,8 @@ struct dt_nlmeans_param_t
 };
 typedef struct dt_nlmeans_param_t dt_nlmeans_param_t;
 
-void nlmeans_denoise(const float *const inbuf, float *const outbuf,
+// returns the share of the patch comparisons of a full, undecimated search which were actually done
+float nlmeans_denoise(const float *const inbuf, float *const outbuf,
                      const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                      const dt_nlmeans_param_t *const params);
 
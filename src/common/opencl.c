@@ -21,6 +21,7 @@
 #include "common/opencl.h"
 #include "common/bilateralcl.h"
 #include "common/darktable.h"
+#include "common/distance_transform.h"
 #include "common/dlopencl.h"
 #include "common/dwt.h"
 #include "common/file_location.h"
@@ -32,6 +33,7 @@
 #include "common/nvidia_gpus.h"
 #include "common/opencl_drivers_blacklist.h"
 #include "common/tea.h"
+#include "common/trace.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "develop/blend.h"
@@ -68,6 +70,13 @@ static gboolean _opencl_build_program(const int dev,
                                       char *md5sum,
                                       const gboolean loaded_cached);
 
+static void _opencl_build_program_background(const int dev,
+                                             const int prog,
+                                             const char *programname,
+                                             const char *binname,
+                                             const char *cachedir,
+                                             const char *md5sum);
+
 static char *_ascii_str_canonical(const char *in, char *out, int maxlen);
 
 static char *_strsep(char **stringp, const char *delim);
@@ -446,6 +455,28 @@ gboolean dt_opencl_read_device_config(const int devid)
   return !existing_device || !safety_ok;
 }
 
+// can the device hold RGBA images with half float channels?
+static gboolean _opencl_half_images_supported(dt_opencl_t *cl, const int dev)
+{
+  cl_uint num = 0;
+  if((cl->dlocl->symbols->dt_clGetSupportedImageFormats)
+       (cl->dev[dev].context, CL_MEM_READ_WRITE, CL_MEM_OBJECT_IMAGE2D, 0, NULL, &num) != CL_SUCCESS
+     || num == 0)
+    return FALSE;
+
+  cl_image_format *formats = g_new(cl_image_format, num);
+  gboolean supported = FALSE;
+  if((cl->dlocl->symbols->dt_clGetSupportedImageFormats)
+       (cl->dev[dev].context, CL_MEM_READ_WRITE, CL_MEM_OBJECT_IMAGE2D, num, formats, NULL) == CL_SUCCESS)
+  {
+    for(cl_uint k = 0; k < num && !supported; k++)
+      supported = formats[k].image_channel_order == CL_RGBA
+               && formats[k].image_channel_data_type == CL_HALF_FLOAT;
+  }
+  g_free(formats);
+  return supported;
+}
+
 // returns 0 if all ok or an error if we failed to init this device
 static gboolean _opencl_device_init(dt_opencl_t *cl,
                                     const int dev,
@@ -476,6 +507,7 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   cl->dev[dev].platform = NULL;
   cl->dev[dev].device_version = NULL;
   cl->dev[dev].cname = NULL;
+  cl->dev[dev].cdriver = NULL;
   cl->dev[dev].options = NULL;
   cl->dev[dev].cflags = NULL;
   cl->dev[dev].memory_in_use = 0;
@@ -492,6 +524,18 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   cl->dev[dev].clroundup_wd = 16;
   cl->dev[dev].clroundup_ht = 16;
   cl->dev[dev].advantage = 0.0f;
+  cl->dev[dev].gpu_costs = NULL;
+  cl->dev[dev].transfer_queue = NULL;
+  cl->dev[dev].half_images = FALSE;
+  memset(cl->dev[dev].program_pending, 0, sizeof(cl->dev[dev].program_pending));
+  memset(cl->dev[dev].pool, 0, sizeof(cl->dev[dev].pool));
+  cl->dev[dev].pool_idle = 0;
+  cl->dev[dev].pool_peak = 0;
+  cl->dev[dev].pool_clock = 0;
+  cl->dev[dev].pool_hits = 0;
+  cl->dev[dev].pool_misses = 0;
+  cl->dev[dev].transfer_cost = 0.0f;
+  cl->dev[dev].transfer_runs = 0;
   cl->dev[dev].use_events = TRUE;
   cl->dev[dev].event_handles = 128;
   cl->dev[dev].asyncmode = FALSE;
@@ -883,7 +927,7 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   // create a command queue for first device the context reported
   cl->dev[dev].cmd_queue = (cl->dlocl->symbols->dt_clCreateCommandQueue)(
       cl->dev[dev].context, devid,
-      (darktable.unmuted & DT_DEBUG_PERF)
+      (darktable.unmuted & DT_DEBUG_PERF) || dt_trace_enabled()
       ? CL_QUEUE_PROFILING_ENABLE
       : 0,
       &err);
@@ -895,6 +939,19 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
     goto end;
   }
 
+  // a failing transfer queue is not fatal, tiling will use synchronous transfers
+  cl->dev[dev].transfer_queue = (cl->dlocl->symbols->dt_clCreateCommandQueue)(
+      cl->dev[dev].context, devid, 0, &err);
+  if(err != CL_SUCCESS)
+  {
+    dt_print_nts(DT_DEBUG_OPENCL,
+                 "   *** could not create transfer queue *** %s\n", cl_errstr(err));
+    cl->dev[dev].transfer_queue = NULL;
+    err = CL_SUCCESS;
+  }
+
+  cl->dev[dev].half_images = _opencl_half_images_supported(cl, dev);
+
   dt_loc_get_user_cache_dir(dtcache, PATH_MAX * sizeof(char));
 
   int len = MIN(strlen(fullname),1024 * sizeof(char));;
@@ -910,6 +967,7 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   for(int i = 0; i < len; i++)
     if(isalnum(driverversion[i])) drvversion[j++] = driverversion[i];
   drvversion[j] = 0;
+  cl->dev[dev].cdriver = strdup(drvversion);
   snprintf(cachedir, PATH_MAX * sizeof(char),
            "%s" G_DIR_SEPARATOR_S "cached_v%d_kernels_for_%s_%s",
     dtcache, DT_OPENCL_KERNELS, alnum_fullname, drvversion);
@@ -992,8 +1050,11 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
     dt_conf_save(darktable.conf);
   }
 
-  // now load all darktable cl kernels.
-  // TODO: compile as a job?
+  // now load all darktable cl kernels. Cached binaries are built right
+  // here, compiling from source is done in the background unless the
+  // locale must be switched, modules use the CPU until it has finished.
+  const gboolean background = dt_conf_get_bool("opencl_background_compile")
+                              && !dt_conf_key_exists("opencl_force_c_locale");
   double tstart = dt_get_debug_wtime();
   FILE *f = g_fopen(filename, "rb");
   if(f)
@@ -1052,9 +1113,15 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
                "[dt_opencl_device_init] testing program `%s' ..", programname);
       gboolean loaded_cached;
       char md5sum[33];
-      if(_opencl_load_program(dev, prog, programname, filename, binname, cachedir,
-                              md5sum, includemd5, &loaded_cached)
-         && _opencl_build_program(dev, prog, binname, cachedir, md5sum, loaded_cached))
+      const gboolean loaded =
+        _opencl_load_program(dev, prog, programname, filename, binname, cachedir,
+                             md5sum, includemd5, &loaded_cached);
+      if(loaded && !loaded_cached && background)
+      {
+        _opencl_build_program_background(dev, prog, programname, binname, cachedir, md5sum);
+      }
+      else if(loaded
+              && _opencl_build_program(dev, prog, binname, cachedir, md5sum, loaded_cached))
       {
         dt_print(DT_DEBUG_OPENCL,
                  "[dt_opencl_device_init] failed to compile program `%s'!",
@@ -1083,6 +1150,13 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   res = FALSE;
 
 end:
+  // a failed device slot gets reused, so wait for its pending builds
+  if(res && cl->build_pool)
+  {
+    g_thread_pool_free(cl->build_pool, FALSE, TRUE);
+    cl->build_pool = NULL;
+  }
+
   // we always write the device config to keep track of disabled devices
   dt_opencl_write_device_config(dev);
 
@@ -1115,11 +1189,18 @@ void dt_opencl_init(dt_opencl_t *cl,
                     const gboolean print_statistics)
 {
   dt_pthread_mutex_init(&cl->lock, NULL);
+  g_queue_init(&cl->lock_waiters);
   cl->inited = FALSE;
   cl->enabled = FALSE;
   cl->stopped = FALSE;
   cl->error_count = 0;
   cl->print_statistics = print_statistics;
+  cl->cost_model = dt_conf_get_bool("opencl_cost_model");
+  cl->cpu_costs = NULL;
+  cl->use_pool = dt_conf_get_bool("opencl_memory_pool");
+  cl->build_pool = NULL;
+  cl->half_float = dt_conf_get_bool("opencl_half_float");
+  cl->kernel_convert_image = -1;
 
   // we might want to show an opencl error
   char *logerror = NULL;
@@ -1463,6 +1544,12 @@ finally:
     cl->heal = dt_heal_init_cl_global();
     cl->colorspaces = dt_colorspaces_init_cl_global();
     cl->guided_filter = dt_guided_filter_init_cl_global();
+    cl->distance_transform = dt_distance_transform_init_cl_global();
+    cl->masks = dt_masks_init_cl_global();
+    cl->kernel_convert_image = dt_opencl_create_kernel(2, "convert_image");
+
+    // a new device or driver gets its kernel suite timed once
+    dt_opencl_benchmark(FALSE);
 
     char checksum[64];
     snprintf(checksum, sizeof(checksum), "%u", cl->crc);
@@ -1506,6 +1593,11 @@ finally:
   }
   else // initialization failed
   {
+    if(cl->build_pool)
+    {
+      g_thread_pool_free(cl->build_pool, FALSE, TRUE);
+      cl->build_pool = NULL;
+    }
     for(int i = 0; cl->dev && i < cl->num_devs; i++)
     {
       dt_pthread_mutex_destroy(&cl->dev[i].lock);
@@ -1523,6 +1615,8 @@ finally:
       }
 
       (cl->dlocl->symbols->dt_clReleaseCommandQueue)(cl->dev[i].cmd_queue);
+      if(cl->dev[i].transfer_queue)
+        (cl->dlocl->symbols->dt_clReleaseCommandQueue)(cl->dev[i].transfer_queue);
       (cl->dlocl->symbols->dt_clReleaseContext)(cl->dev[i].context);
 
       if(cl->dev[i].use_events)
@@ -1535,6 +1629,7 @@ finally:
       free((void *)(cl->dev[i].device_version));
       free((void *)(cl->dev[i].platform));
       free((void *)(cl->dev[i].cname));
+      free((void *)(cl->dev[i].cdriver));
       free((void *)(cl->dev[i].options));
       free((void *)(cl->dev[i].cflags));
     }
@@ -1551,6 +1646,13 @@ finally:
 
 void dt_opencl_cleanup(dt_opencl_t *cl)
 {
+  // wait for background builds still running
+  if(cl->build_pool)
+  {
+    g_thread_pool_free(cl->build_pool, FALSE, TRUE);
+    cl->build_pool = NULL;
+  }
+
   if(cl->inited)
   {
     dt_develop_blend_free_cl_global(cl->blendop);
@@ -1561,9 +1663,20 @@ void dt_opencl_cleanup(dt_opencl_t *cl)
     dt_heal_free_cl_global(cl->heal);
     dt_colorspaces_free_cl_global(cl->colorspaces);
     dt_guided_filter_free_cl_global(cl->guided_filter);
+    dt_distance_transform_free_cl_global(cl->distance_transform);
+    dt_masks_free_cl_global(cl->masks);
+    dt_opencl_free_kernel(cl->kernel_convert_image);
 
     for(int i = 0; i < cl->num_devs; i++)
     {
+      if(cl->print_statistics && cl->dev[i].pool_hits + cl->dev[i].pool_misses)
+        dt_print_nts(DT_DEBUG_OPENCL,
+                     " [opencl_summary_statistics] device '%s' id=%d:"
+                     " memory pool %d hits, %d misses, peak %.1f MB\n",
+                     cl->dev[i].fullname, i, cl->dev[i].pool_hits, cl->dev[i].pool_misses,
+                     (float)cl->dev[i].pool_peak / DT_MEGA);
+      cl->use_pool = FALSE;
+      dt_opencl_pool_flush(i);
       dt_pthread_mutex_destroy(&cl->dev[i].lock);
       for(int k = 0; k < DT_OPENCL_MAX_KERNELS; k++)
         if(cl->dev[i].kernel_used[k])
@@ -1624,8 +1737,11 @@ void dt_opencl_cleanup(dt_opencl_t *cl)
       free((void *)(cl->dev[i].device_version));
       free((void *)(cl->dev[i].platform));
       free((void *)(cl->dev[i].cname));
+      free((void *)(cl->dev[i].cdriver));
       free((void *)(cl->dev[i].options));
       free((void *)(cl->dev[i].cflags));
+      if(cl->dev[i].gpu_costs)
+        g_hash_table_destroy(cl->dev[i].gpu_costs);
     }
     free(cl->dev_priority_image);
     free(cl->dev_priority_preview);
@@ -1641,6 +1757,8 @@ void dt_opencl_cleanup(dt_opencl_t *cl)
     free(cl->dlocl);
   }
 
+  if(cl->cpu_costs)
+    g_hash_table_destroy(cl->cpu_costs);
   free(cl->dev);
   dt_pthread_mutex_destroy(&cl->lock);
 }
@@ -1973,6 +2091,13 @@ static void _opencl_update_priorities(const char *configstr)
                cl->mandatory[3], cl->mandatory[4]);
 }
 
+static void _opencl_lock_dequeue(dt_opencl_t *cl, int *waiter)
+{
+  dt_pthread_mutex_lock(&cl->lock);
+  g_queue_remove(&cl->lock_waiters, waiter);
+  dt_pthread_mutex_unlock(&cl->lock);
+}
+
 int dt_opencl_lock_device(const int pipetype)
 {
   dt_opencl_t *cl = darktable.opencl;
@@ -2022,22 +2147,51 @@ int dt_opencl_lock_device(const int pipetype)
   {
     const int usec = 5000;
     const int nloop = (heavy ? 10 : 1) * MAX(0, dt_conf_get_int("opencl_mandatory_timeout"));
+    int ndevs = 0;
+    while(priority[ndevs] != DT_DEVICE_CPU) ndevs++;
+
+    /* pipes waiting for a mandatory device queue up and get the devices
+       in the order they asked for them. Only the first ndevs waiters try
+       to lock, a pipe without mandatory device does not overtake them.
+    */
+    int waiter;
+    gboolean queued = FALSE;
 
     // check for free opencl device repeatedly if mandatory is TRUE,
     // else give up after first try
     for(int n = 0; n < nloop; n++)
     {
-      const int *prio = priority;
+      dt_pthread_mutex_lock(&cl->lock);
+      if(mandatory && !queued)
+      {
+        g_queue_push_tail(&cl->lock_waiters, &waiter);
+        queued = TRUE;
+      }
+      const int ahead = queued
+        ? g_queue_index(&cl->lock_waiters, &waiter)
+        : g_queue_get_length(&cl->lock_waiters);
+      dt_pthread_mutex_unlock(&cl->lock);
+
+      // all devices are promised to waiting pipes, a pipe not queueing
+      // for a mandatory device falls back to the CPU without a lock
+      if(!queued && ahead >= ndevs)
+      {
+        dt_print(DT_DEBUG_OPENCL,
+                 "[opencl_lock_device] %d pipes waiting for %d devices, fallback to CPU",
+                 ahead, ndevs);
+        free(priority);
+        return DT_DEVICE_CPU;
+      }
 
-      while(*prio != DT_DEVICE_CPU)
+      for(const int *prio = priority; ahead < ndevs && *prio != DT_DEVICE_CPU; prio++)
       {
         if(!dt_pthread_mutex_BAD_trylock(&cl->dev[*prio].lock))
         {
           const int devid = *prio;
+          if(queued) _opencl_lock_dequeue(cl, &waiter);
           free(priority);
           return devid;
         }
-        prio++;
       }
 
       if(!mandatory)
@@ -2048,6 +2202,7 @@ int dt_opencl_lock_device(const int pipetype)
 
       dt_iop_nap(usec);
     }
+    if(queued) _opencl_lock_dequeue(cl, &waiter);
     dt_print(DT_DEBUG_OPENCL,
              "[opencl_lock_device] reached opencl_mandatory_timeout trying"
              " to lock mandatory device, fallback to CPU\n");
@@ -2077,6 +2232,13 @@ void dt_opencl_unlock_device(const int devid)
     dt_pthread_mutex_BAD_unlock(&cl->dev[devid].lock);
 }
 
+gboolean dt_opencl_trylock_device(const int devid)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!_cldev_running(devid)) return FALSE;
+  return !dt_pthread_mutex_BAD_trylock(&cl->dev[devid].lock);
+}
+
 static FILE *_fopen_stat(const char *filename, struct stat *st)
 {
   FILE *f = g_fopen(filename, "rb");
@@ -2378,9 +2540,12 @@ static gboolean _opencl_build_program(const int dev,
   // would fail parsing certain numerical constants if locale is
   // different from "C".  we save the current locale, set locale to
   // "C", and restore the previous setting after OpenCL is initialized
-  char *locale = strdup(setlocale(LC_ALL, NULL));
+  char *locale = NULL;
   if(dt_conf_key_exists("opencl_force_c_locale"))
+  {
+    locale = strdup(setlocale(LC_ALL, NULL));
     setlocale(LC_ALL, "C");
+  }
 
   dt_opencl_t *cl = darktable.opencl;
   cl_program program = cl->dev[dev].program[prog];
@@ -2496,13 +2661,12 @@ static gboolean _opencl_build_program(const int dev,
     {
       if(cl->dev[dev].devid == devices[i])
       {
-        char dup[PATH_MAX] = { 0 };
-        g_strlcpy(dup, binname, sizeof(dup));
-        char *bname = basename(dup);
-
         // save opencl compiled binary as md5sum-named file
         char filename[PATH_MAX] = { 0 };
 #if defined(_WIN32)
+        char dup[PATH_MAX] = { 0 };
+        g_strlcpy(dup, binname, sizeof(dup));
+        char *bname = basename(dup);
         snprintf(filename, sizeof(filename), "%s" G_DIR_SEPARATOR_S "%s.%s",
                  cachedir, bname, md5sum);
 #else
@@ -2516,12 +2680,10 @@ static gboolean _opencl_build_program(const int dev,
         fclose(f);
 
 #if !defined(_WIN32)
-        // create link (e.g. basic.cl.bin -> f1430102c53867c162bb60af6c163328)
-        char cwd[PATH_MAX] = { 0 };
-        if(!getcwd(cwd, sizeof(cwd))) goto ret;
-        if(chdir(cachedir) != 0) goto ret;
-        if(symlink(md5sum, bname) != 0) goto ret;
-        if(chdir(cwd) != 0) goto ret;
+        // create link (e.g. basic.cl.bin -> f1430102c53867c162bb60af6c163328),
+        // the relative target avoids changing the working directory which
+        // is not safe for builds in the background
+        if(symlink(md5sum, binname) != 0) goto ret;
 #endif //!defined(_WIN32)
       }
     }
@@ -2542,6 +2704,70 @@ static gboolean _opencl_build_program(const int dev,
   return err != CL_SUCCESS;
 }
 
+typedef struct _opencl_build_job_t
+{
+  int dev;
+  int prog;
+  char md5sum[33];
+  gchar *programname;
+  gchar *binname;
+  gchar *cachedir;
+} _opencl_build_job_t;
+
+static void _opencl_build_job_run(gpointer data,
+                                   gpointer user_data)
+{
+  _opencl_build_job_t *job = data;
+  dt_opencl_t *cl = darktable.opencl;
+  double tstart = dt_get_debug_wtime();
+
+  if(_opencl_build_program(job->dev, job->prog, job->binname, job->cachedir,
+                           job->md5sum, FALSE))
+    dt_print(DT_DEBUG_OPENCL,
+             "[opencl_build_program] failed to compile program `%s' for '%s' id=%d,"
+             " affected modules use the CPU",
+             job->programname, cl->dev[job->dev].fullname, job->dev);
+  else
+  {
+    g_atomic_int_set(&cl->dev[job->dev].program_pending[job->prog], FALSE);
+    dt_print(DT_DEBUG_OPENCL,
+             "[opencl_build_program] compiled program `%s' for '%s' id=%d in %.3fs",
+             job->programname, cl->dev[job->dev].fullname, job->dev,
+             dt_get_lap_time(&tstart));
+  }
+
+  g_free(job->programname);
+  g_free(job->binname);
+  g_free(job->cachedir);
+  free(job);
+}
+
+static void _opencl_build_program_background(const int dev,
+                                             const int prog,
+                                             const char *programname,
+                                             const char *binname,
+                                             const char *cachedir,
+                                             const char *md5sum)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->build_pool)
+    cl->build_pool = g_thread_pool_new(_opencl_build_job_run, NULL,
+                                       MAX(1, dt_get_num_procs() / 2), FALSE, NULL);
+
+  _opencl_build_job_t *job = calloc(1, sizeof(_opencl_build_job_t));
+  job->dev = dev;
+  job->prog = prog;
+  g_strlcpy(job->md5sum, md5sum, sizeof(job->md5sum));
+  job->programname = g_strdup(programname);
+  job->binname = g_strdup(binname);
+  job->cachedir = g_strdup(cachedir);
+
+  g_atomic_int_set(&cl->dev[dev].program_pending[prog], TRUE);
+  dt_print(DT_DEBUG_OPENCL | DT_DEBUG_VERBOSE,
+           "[opencl_build_program] compiling program `%s' in the background", programname);
+  g_thread_pool_push(cl->build_pool, job, NULL);
+}
+
 int dt_opencl_create_kernel(const int prog,
                             const char *name)
 {
@@ -2574,6 +2800,8 @@ static gboolean _check_kernel(const int dev,
 
   const int prog = cl->program_saved[kernel];
   if(prog < 0 || prog >= DT_OPENCL_MAX_PROGRAMS) return FALSE;
+  // still compiling, try again later
+  if(g_atomic_int_get(&cl->dev[dev].program_pending[prog])) return FALSE;
   dt_pthread_mutex_lock(&cl->lock);
 
   if(!cl->dev[dev].kernel_used[kernel]
@@ -2882,6 +3110,20 @@ int dt_opencl_read_host_from_device_raw(const int devid,
   if(!_cldev_running(devid))
     return DT_OPENCL_NODEVICE;
 
+  // the host always sees full floats, convert half images on the device
+  if(dt_opencl_image_is_half(device))
+  {
+    cl_mem tmp = dt_opencl_alloc_device(devid, region[0], region[1], 4 * sizeof(float));
+    if(tmp == NULL) return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    const size_t zero[] = { 0, 0, 0 };
+    cl_int err = _opencl_convert_image(devid, device, tmp, origin, zero, region);
+    if(err == CL_SUCCESS)
+      err = dt_opencl_read_host_from_device_raw(devid, host, tmp, zero, region,
+                                                rowpitch, blocking);
+    dt_opencl_release_mem_object(tmp);
+    return err;
+  }
+
   cl_event *eventp = _opencl_events_get_slot(devid, "[Read Image (from device to host)]");
 
   const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueReadImage)
@@ -2969,6 +3211,21 @@ int dt_opencl_write_host_to_device_raw(const int devid,
   if(!_cldev_running(devid))
     return DT_OPENCL_NODEVICE;
 
+  if(dt_opencl_image_is_half(device))
+  {
+    cl_mem tmp = dt_opencl_alloc_device(devid, region[0], region[1], 4 * sizeof(float));
+    if(tmp == NULL) return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    const size_t zero[] = { 0, 0, 0 };
+    cl_int err = dt_opencl_write_host_to_device_raw(devid, host, tmp, zero, region,
+                                                    rowpitch, blocking);
+    if(err == CL_SUCCESS)
+      err = _opencl_convert_image(devid, tmp, device, zero, origin, region);
+    if(err == CL_SUCCESS && blocking)
+      err = dt_opencl_finish(devid) ? CL_SUCCESS : DT_OPENCL_PROCESS_CL;
+    dt_opencl_release_mem_object(tmp);
+    return err;
+  }
+
   cl_event *eventp = _opencl_events_get_slot(devid, "[Write Image (from host to device)]");
   const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueWriteImage)
     (darktable.opencl->dev[devid].cmd_queue,
@@ -2983,6 +3240,88 @@ int dt_opencl_write_host_to_device_raw(const int devid,
   return err;
 }
 
+gboolean dt_opencl_has_transfer_queue(const int devid)
+{
+  return _cldev_running(devid) && darktable.opencl->dev[devid].transfer_queue != NULL;
+}
+
+int dt_opencl_transfer_async(const int devid,
+                             void *host,
+                             void *device,
+                             const size_t *origin,
+                             const size_t *region,
+                             const int rowpitch,
+                             const gboolean to_device,
+                             cl_event *event)
+{
+  if(!dt_opencl_has_transfer_queue(devid))
+    return DT_OPENCL_NODEVICE;
+
+  dt_opencl_t *cl = darktable.opencl;
+  cl_command_queue queue = cl->dev[devid].transfer_queue;
+  cl_int err = to_device
+    ? (cl->dlocl->symbols->dt_clEnqueueWriteImage)
+        (queue, device, CL_FALSE, origin, region, rowpitch, 0, host, 0, NULL, event)
+    : (cl->dlocl->symbols->dt_clEnqueueReadImage)
+        (queue, device, CL_FALSE, origin, region, rowpitch, 0, host, 0, NULL, event);
+  if(err == CL_SUCCESS)
+    err = (cl->dlocl->symbols->dt_clFlush)(queue);
+
+  if(err != CL_SUCCESS)
+    dt_print(DT_DEBUG_OPENCL,
+             "[dt_opencl_transfer_async] could not %s device '%s' id=%d: %s",
+             to_device ? "write to" : "read from",
+             cl->dev[devid].fullname, devid, cl_errstr(err));
+  _check_clmem_err(devid, err);
+  return err;
+}
+
+int dt_opencl_wait_event(const int devid,
+                         cl_event event)
+{
+  if(!_cldev_running(devid) || !event)
+    return DT_OPENCL_NODEVICE;
+
+  dt_opencl_t *cl = darktable.opencl;
+  const cl_int err = (cl->dlocl->symbols->dt_clWaitForEvents)(1, &event);
+  (cl->dlocl->symbols->dt_clReleaseEvent)(event);
+  if(err != CL_SUCCESS)
+    dt_print(DT_DEBUG_OPENCL,
+             "[dt_opencl_wait_event] reported %s for device '%s' id=%d",
+             cl_errstr(err), cl->dev[devid].fullname, devid);
+  return err;
+}
+
+int dt_opencl_flush(const int devid)
+{
+  if(!_cldev_running(devid))
+    return DT_OPENCL_NODEVICE;
+  return (darktable.opencl->dlocl->symbols->dt_clFlush)(darktable.opencl->dev[devid].cmd_queue);
+}
+
+/* copy a region between images of different channel types like half and
+   full float, clEnqueueCopyImage requires identical formats */
+static cl_int _opencl_convert_image(const int devid,
+                                    cl_mem src,
+                                    cl_mem dst,
+                                    const size_t *orig_src,
+                                    const size_t *orig_dst,
+                                    const size_t *region)
+{
+  const int kernel = darktable.opencl->kernel_convert_image;
+  if(kernel < 0) return DT_OPENCL_NODEVICE;
+
+  const int width = region[0];
+  const int height = region[1];
+  const int ix = orig_src[0];
+  const int iy = orig_src[1];
+  const int ox = orig_dst[0];
+  const int oy = orig_dst[1];
+  return dt_opencl_enqueue_kernel_2d_args(devid, kernel, width, height,
+                                          CLARG(src), CLARG(dst), CLARG(width), CLARG(height),
+                                          CLARG(ix), CLARG(iy), CLARG(ox), CLARG(oy));
+}
+
 int dt_opencl_enqueue_copy_image(const int devid,
                                  cl_mem src,
                                  cl_mem dst,
@@ -2993,6 +3332,9 @@ int dt_opencl_enqueue_copy_image(const int devid,
   if(!_cldev_running(devid))
     return DT_OPENCL_NODEVICE;
 
+  if(dt_opencl_image_is_half(src) != dt_opencl_image_is_half(dst))
+    return _opencl_convert_image(devid, src, dst, orig_src, orig_dst, region);
+
   cl_event *eventp = _opencl_events_get_slot(devid, "[Copy Image (on device)]");
   const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueCopyImage)
     (darktable.opencl->dev[devid].cmd_queue, src, dst, orig_src, orig_dst,
@@ -3199,6 +3541,148 @@ void *dt_opencl_copy_host_to_device_rowpitch(const int devid,
 }
 
 
+/* the pool keeps released read-write images and buffers per device.
+   images are reused for identical dimensions and format only, buffers
+   are allocated in size buckets so they can be reused for all requests
+   of the same bucket. the pool holds at most an eighth of the device's
+   available memory; that memory is not reported as available. */
+
+static size_t _pool_bucket_size(const size_t size)
+{
+  // buckets in steps of 1/8 of the next lower power of two
+  size_t step = 1;
+  while(step <= size / 16) step <<= 1;
+  return (size + step - 1) / step * step;
+}
+
+static int _opencl_get_mem_context_id(const cl_mem mem);
+
+static void _pool_evict(dt_opencl_device_t *dev,
+                        dt_opencl_pool_entry_t *entry)
+{
+  dev->pool_idle -= entry->size;
+  (darktable.opencl->dlocl->symbols->dt_clReleaseMemObject)(entry->mem);
+  memset(entry, 0, sizeof(dt_opencl_pool_entry_t));
+}
+
+void dt_opencl_pool_flush(const int devid)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->inited || devid < 0 || devid >= cl->num_devs) return;
+
+  dt_pthread_mutex_lock(&cl->lock);
+  dt_opencl_device_t *dev = &cl->dev[devid];
+  for(int k = 0; k < DT_OPENCL_POOL_SLOTS; k++)
+    if(dev->pool[k].mem)
+      _pool_evict(dev, &dev->pool[k]);
+  dt_pthread_mutex_unlock(&cl->lock);
+}
+
+// take a matching object from the pool, bpp == 0 for buffers
+static cl_mem _pool_take(const int devid,
+                         const int width,
+                         const int height,
+                         const int bpp,
+                         const gboolean half,
+                         const size_t size)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->use_pool) return NULL;
+
+  cl_mem mem = NULL;
+  dt_pthread_mutex_lock(&cl->lock);
+  dt_opencl_device_t *dev = &cl->dev[devid];
+  for(int k = 0; k < DT_OPENCL_POOL_SLOTS && !mem; k++)
+  {
+    dt_opencl_pool_entry_t *entry = &dev->pool[k];
+    if(entry->mem
+       && entry->bpp == bpp
+       && entry->half == half
+       && (bpp ? entry->width == width && entry->height == height
+               : entry->size == size))
+    {
+      mem = entry->mem;
+      dev->pool_idle -= entry->size;
+      memset(entry, 0, sizeof(dt_opencl_pool_entry_t));
+    }
+  }
+  if(mem)
+    dev->pool_hits++;
+  else
+    dev->pool_misses++;
+  dt_pthread_mutex_unlock(&cl->lock);
+  return mem;
+}
+
+// put a released object into the pool, returns FALSE if it was not taken
+static gboolean _pool_put(cl_mem mem)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->use_pool) return FALSE;
+
+  cl_mem_flags flags = 0;
+  cl_mem_object_type type = 0;
+  if((cl->dlocl->symbols->dt_clGetMemObjectInfo)
+       (mem, CL_MEM_FLAGS, sizeof(flags), &flags, NULL) != CL_SUCCESS
+     || (cl->dlocl->symbols->dt_clGetMemObjectInfo)
+       (mem, CL_MEM_TYPE, sizeof(type), &type, NULL) != CL_SUCCESS
+     || flags != CL_MEM_READ_WRITE
+     || (type != CL_MEM_OBJECT_IMAGE2D && type != CL_MEM_OBJECT_BUFFER))
+    return FALSE;
+
+  const int devid = _opencl_get_mem_context_id(mem);
+  if(devid < 0) return FALSE;
+
+  dt_opencl_pool_entry_t entry = { .mem = mem, .size = dt_opencl_get_mem_object_size(mem) };
+  if(type == CL_MEM_OBJECT_IMAGE2D)
+  {
+    entry.width = dt_opencl_get_image_width(mem);
+    entry.height = dt_opencl_get_image_height(mem);
+    entry.bpp = dt_opencl_get_image_element_size(mem);
+    entry.half = dt_opencl_image_is_half(mem);
+    if(!entry.width || !entry.height || !entry.bpp) return FALSE;
+  }
+  else if(entry.size != _pool_bucket_size(entry.size))
+    return FALSE;
+
+  dt_pthread_mutex_lock(&cl->lock);
+  dt_opencl_device_t *dev = &cl->dev[devid];
+  const size_t limit = dev->used_available / 8;
+  gboolean taken = FALSE;
+  if(entry.size <= limit && !dev->clmem_error)
+  {
+    // make room by evicting the oldest entries
+    while(TRUE)
+    {
+      dt_opencl_pool_entry_t *free_slot = NULL;
+      dt_opencl_pool_entry_t *oldest = NULL;
+      for(int k = 0; k < DT_OPENCL_POOL_SLOTS; k++)
+      {
+        dt_opencl_pool_entry_t *e = &dev->pool[k];
+        if(!e->mem)
+        {
+          if(!free_slot) free_slot = e;
+        }
+        else if(!oldest || e->used < oldest->used)
+          oldest = e;
+      }
+      if(free_slot && dev->pool_idle + entry.size <= limit)
+      {
+        entry.used = ++dev->pool_clock;
+        *free_slot = entry;
+        dev->pool_idle += entry.size;
+        dev->pool_peak = MAX(dev->pool_peak, dev->pool_idle);
+        taken = TRUE;
+        break;
+      }
+      if(!oldest) break;
+      _pool_evict(dev, oldest);
+    }
+  }
+  dt_pthread_mutex_unlock(&cl->lock);
+  return taken;
+}
+
 void dt_opencl_release_mem_object(cl_mem mem)
 {
   if(!darktable.opencl->inited)
@@ -3212,6 +3696,9 @@ void dt_opencl_release_mem_object(cl_mem mem)
 
   dt_opencl_memory_statistics(DT_DEVICE_CPU, mem, OPENCL_MEMORY_SUB);
 
+  if(_pool_put(mem))
+    return;
+
   (darktable.opencl->dlocl->symbols->dt_clReleaseMemObject)(mem);
 }
 
@@ -3259,6 +3746,47 @@ int dt_opencl_unmap_mem_object(const int devid,
   return err;
 }
 
+static cl_mem _opencl_alloc_image(const int devid,
+                                  const int width,
+                                  const int height,
+                                  const int bpp,
+                                  const cl_image_format fmt)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  cl_int err = CL_SUCCESS;
+  cl_mem dev = _pool_take(devid, width, height, bpp,
+                          fmt.image_channel_data_type == CL_HALF_FLOAT, 0);
+  if(dev)
+  {
+    dt_opencl_memory_statistics(devid, dev, OPENCL_MEMORY_ADD);
+    return dev;
+  }
+
+  const cl_image_desc desc = (cl_image_desc)
+        {CL_MEM_OBJECT_IMAGE2D, width, height, 0, 0, 0, 0, 0, 0, NULL};
+
+  dev = (cl->dlocl->symbols->dt_clCreateImage)
+    (cl->dev[devid].context, CL_MEM_READ_WRITE, &fmt, &desc, NULL, &err);
+
+  // memory held in the pool might be what is missing
+  if(err == CL_MEM_OBJECT_ALLOCATION_FAILURE && cl->dev[devid].pool_idle)
+  {
+    dt_opencl_pool_flush(devid);
+    dev = (cl->dlocl->symbols->dt_clCreateImage)
+      (cl->dev[devid].context, CL_MEM_READ_WRITE, &fmt, &desc, NULL, &err);
+  }
+
+  if(err != CL_SUCCESS)
+    dt_print(DT_DEBUG_OPENCL,
+             "[opencl alloc_device] could not alloc img buffer on device '%s' id=%d: %s",
+             cl->dev[devid].fullname, devid, cl_errstr(err));
+
+  _check_clmem_err(devid, err);
+  dt_opencl_memory_statistics(devid, dev, OPENCL_MEMORY_ADD);
+
+  return dev;
+}
+
 void *dt_opencl_alloc_device(const int devid,
                              const int width,
                              const int height,
@@ -3271,7 +3799,6 @@ void *dt_opencl_alloc_device(const int devid,
   if(cl->dev[devid].max_image_width < width || cl->dev[devid].max_image_height < height)
     return NULL;
 
-  cl_int err = CL_SUCCESS;
   cl_image_format fmt;
   // guess pixel format from bytes per pixel
   if(bpp == 4 * sizeof(float))
@@ -3287,24 +3814,28 @@ void *dt_opencl_alloc_device(const int devid,
   else
     return NULL;
 
-  const cl_image_desc desc = (cl_image_desc)
-        {CL_MEM_OBJECT_IMAGE2D, width, height, 0, 0, 0, 0, 0, 0, NULL};
-
-  cl_mem dev = (cl->dlocl->symbols->dt_clCreateImage)
-    (cl->dev[devid].context, CL_MEM_READ_WRITE, &fmt, &desc, NULL, &err);
+  return _opencl_alloc_image(devid, width, height, bpp, fmt);
+}
 
-  if(err != CL_SUCCESS)
-    dt_print(DT_DEBUG_OPENCL,
-             "[opencl alloc_device] could not alloc img buffer on device '%s' id=%d: %s",
-             cl->dev[devid].fullname, devid, cl_errstr(err));
+void *dt_opencl_alloc_device_half(const int devid,
+                                  const int width,
+                                  const int height)
+{
+  if(!_cldev_running(devid))
+    return NULL;
 
-  _check_clmem_err(devid, err);
-  dt_opencl_memory_statistics(devid, dev, OPENCL_MEMORY_ADD);
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->half_float || !cl->dev[devid].half_images)
+    return NULL;
+  if(cl->dev[devid].max_image_width < width || cl->dev[devid].max_image_height < height)
+    return NULL;
 
-  return dev;
+  return _opencl_alloc_image(devid, width, height, 4 * sizeof(uint16_t),
+                             (cl_image_format){ CL_RGBA, CL_HALF_FLOAT });
 }
 
 
+
 void *dt_opencl_alloc_device_use_host_pointer(const int devid,
                                               const int width,
                                               const int height,
@@ -3364,9 +3895,28 @@ void *dt_opencl_alloc_device_buffer(const int devid,
     return NULL;
   cl_int err = CL_SUCCESS;
 
-  cl_mem buf = (cl->dlocl->symbols->dt_clCreateBuffer)
+  // pooled buffers are allocated with the size of their bucket
+  const size_t bucket = _pool_bucket_size(size);
+  const size_t alloc = cl->use_pool && bucket <= cl->dev[devid].max_mem_alloc
+    ? bucket : size;
+  cl_mem buf = alloc == bucket ? _pool_take(devid, 0, 0, 0, FALSE, bucket) : NULL;
+  if(buf)
+  {
+    dt_opencl_memory_statistics(devid, buf, OPENCL_MEMORY_ADD);
+    return buf;
+  }
+
+  buf = (cl->dlocl->symbols->dt_clCreateBuffer)
     (cl->dev[devid].context,
-     CL_MEM_READ_WRITE, size, NULL, &err);
+     CL_MEM_READ_WRITE, alloc, NULL, &err);
+
+  if(err == CL_MEM_OBJECT_ALLOCATION_FAILURE && cl->dev[devid].pool_idle)
+  {
+    dt_opencl_pool_flush(devid);
+    buf = (cl->dlocl->symbols->dt_clCreateBuffer)
+      (cl->dev[devid].context,
+       CL_MEM_READ_WRITE, alloc, NULL, &err);
+  }
   if(err != CL_SUCCESS || buf == NULL)
     dt_print(DT_DEBUG_OPENCL,
              "[opencl alloc_device_buffer] could not allocate cl buffer on device '%s' id=%d: %s",
@@ -3470,6 +4020,17 @@ int dt_opencl_get_image_element_size(const cl_mem mem)
   return (err == CL_SUCCESS) ? (int)size : 0;
 }
 
+gboolean dt_opencl_image_is_half(const cl_mem mem)
+{
+  if(mem == NULL) return FALSE;
+
+  cl_image_format fmt;
+  const cl_int err = (darktable.opencl->dlocl->symbols->dt_clGetImageInfo)
+    (mem, CL_IMAGE_FORMAT, sizeof(fmt), &fmt, NULL);
+
+  return err == CL_SUCCESS && fmt.image_channel_data_type == CL_HALF_FLOAT;
+}
+
 void *dt_opencl_duplicate_image(const int devid, const cl_mem src)
 {
   const int width = dt_opencl_get_image_width(src);
@@ -3478,7 +4039,9 @@ void *dt_opencl_duplicate_image(const int devid, const cl_mem src)
   if(width < 1 || height < 1 || el < sizeof(uint16_t))
     return NULL;
 
-  cl_mem new = dt_opencl_alloc_device(devid, width, height, el);
+  cl_mem new = dt_opencl_image_is_half(src)
+    ? dt_opencl_alloc_device_half(devid, width, height)
+    : dt_opencl_alloc_device(devid, width, height, el);
   if(new == NULL) return NULL;
 
   size_t origin[]   = { 0, 0, 0 };
@@ -3503,7 +4066,9 @@ void dt_opencl_dump_pipe_pfm(const char* mod,
 
   const int width = dt_opencl_get_image_width(img);
   const int height = dt_opencl_get_image_height(img);
-  const int element_size = dt_opencl_get_image_element_size(img);
+  const int element_size = dt_opencl_image_is_half(img)
+    ? 4 * sizeof(float)
+    : dt_opencl_get_image_element_size(img);
   float *data = dt_alloc_aligned((size_t)width * height * element_size);
   if(data)
   {
@@ -3600,7 +4165,9 @@ void dt_opencl_check_tuning(const int devid)
 cl_ulong dt_opencl_get_device_available(const int devid)
 {
   if(!darktable.opencl->inited || devid < 0) return 0;
-  return darktable.opencl->dev[devid].used_available;
+  const dt_opencl_device_t *dev = &darktable.opencl->dev[devid];
+  // the memory held unused in the pool is not available
+  return dev->used_available - MIN(dev->pool_idle, dev->used_available);
 }
 
 static cl_ulong _opencl_get_device_memalloc(const int devid)
@@ -3632,6 +4199,10 @@ gboolean dt_opencl_image_fits_device(const int devid,
 
   if(_opencl_get_device_memalloc(devid) < required)
     return FALSE;
+  // give up the pool before forcing tiling
+  if(dt_opencl_get_device_available(devid) < total
+     && cl->dev[devid].used_available >= total)
+    dt_opencl_pool_flush(devid);
   if(dt_opencl_get_device_available(devid) < total)
     return FALSE;
   // We know here that total memory fits and if so the buffersize will
@@ -3639,6 +4210,99 @@ gboolean dt_opencl_image_fits_device(const int devid,
   return TRUE;
 }
 
+// number of samples required per module before the cost model is used
+#define DT_OPENCL_COST_MIN_RUNS 3
+// weight of a new sample in the running average
+#define DT_OPENCL_COST_WEIGHT 0.25f
+
+typedef struct dt_opencl_cost_t
+{
+  float seconds; // per megapixel
+  int runs;
+} dt_opencl_cost_t;
+
+static void _cost_update(float *avg, int *runs, const float sample)
+{
+  *avg = (*runs == 0) ? sample : *avg + DT_OPENCL_COST_WEIGHT * (sample - *avg);
+  (*runs)++;
+}
+
+void dt_opencl_cost_record(const int devid,
+                           const char *op,
+                           const size_t pixels,
+                           const double seconds)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->cost_model || !op || pixels == 0 || seconds <= 0.0) return;
+  if(devid >= 0 && !_cldev_running(devid)) return;
+
+  dt_pthread_mutex_lock(&cl->lock);
+  GHashTable **table = devid < 0 ? &cl->cpu_costs : &cl->dev[devid].gpu_costs;
+  if(!*table)
+    *table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  dt_opencl_cost_t *cost = g_hash_table_lookup(*table, op);
+  if(!cost)
+  {
+    cost = g_malloc0(sizeof(dt_opencl_cost_t));
+    g_hash_table_insert(*table, g_strdup(op), cost);
+  }
+  _cost_update(&cost->seconds, &cost->runs, seconds * 1e6 / pixels);
+  dt_pthread_mutex_unlock(&cl->lock);
+}
+
+void dt_opencl_cost_record_transfer(const int devid,
+                                    const size_t bytes,
+                                    const double seconds)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->cost_model || !_cldev_running(devid) || bytes == 0 || seconds <= 0.0) return;
+
+  dt_pthread_mutex_lock(&cl->lock);
+  _cost_update(&cl->dev[devid].transfer_cost, &cl->dev[devid].transfer_runs,
+               seconds * (1024.0 * 1024.0) / bytes);
+  dt_pthread_mutex_unlock(&cl->lock);
+}
+
+gboolean dt_opencl_cost_prefer_cpu(const int devid,
+                                   const char *op,
+                                   const size_t pixels,
+                                   const size_t bytes,
+                                   const gboolean input_on_gpu)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->cost_model || !op || !_cldev_running(devid)) return FALSE;
+
+  gboolean prefer_cpu = FALSE;
+  dt_pthread_mutex_lock(&cl->lock);
+  const dt_opencl_device_t *dev = &cl->dev[devid];
+  const dt_opencl_cost_t *cpu = cl->cpu_costs
+    ? g_hash_table_lookup(cl->cpu_costs, op) : NULL;
+  const dt_opencl_cost_t *gpu = dev->gpu_costs
+    ? g_hash_table_lookup(dev->gpu_costs, op) : NULL;
+
+  if(cpu && gpu
+     && cpu->runs >= DT_OPENCL_COST_MIN_RUNS
+     && gpu->runs >= DT_OPENCL_COST_MIN_RUNS
+     && dev->transfer_runs >= DT_OPENCL_COST_MIN_RUNS)
+  {
+    // a module processed on CPU with the input on the device requires
+    // a download, one processed on the device with input in host memory
+    // an upload. The output is assumed to stay where it was produced.
+    const float mpix = pixels / 1e6f;
+    const float transfer = dev->transfer_cost * bytes / (1024.0f * 1024.0f);
+    const float cost_cpu = cpu->seconds * mpix + (input_on_gpu ? transfer : 0.0f);
+    const float cost_gpu = gpu->seconds * mpix + (input_on_gpu ? 0.0f : transfer);
+    prefer_cpu = cost_cpu < cost_gpu;
+    if(prefer_cpu)
+      dt_print(DT_DEBUG_OPENCL | DT_DEBUG_PERF,
+               "[opencl_cost_model] prefer CPU for `%s' (dev=%i, CPU %.4fs, GPU %.4fs)",
+               op, devid, cost_cpu, cost_gpu);
+  }
+  dt_pthread_mutex_unlock(&cl->lock);
+  return prefer_cpu;
+}
+
 /** round size to a multiple of the value given in the device specifig
  * config parameter clroundup_wd/ht */
 int dt_opencl_dev_roundup_width(int size,
@@ -3691,6 +4355,12 @@ void dt_opencl_update_settings(void)
   if(!cl->inited) return;
 
   cl->enabled = dt_conf_get_bool("opencl");
+  cl->cost_model = dt_conf_get_bool("opencl_cost_model");
+  cl->use_pool = dt_conf_get_bool("opencl_memory_pool");
+  cl->half_float = dt_conf_get_bool("opencl_half_float");
+  if(!cl->use_pool)
+    for(int devid = 0; devid < cl->num_devs; devid++)
+      dt_opencl_pool_flush(devid);
   cl->stopped = FALSE;
   cl->error_count = 0;
 
@@ -3701,6 +4371,209 @@ void dt_opencl_update_settings(void)
            "[opencl_update_settings] scheduling profile set to %s", pstr);
 }
 
+// size and rounds of the benchmark kernel suite
+#define DT_OPENCL_BENCH_WIDTH 2048
+#define DT_OPENCL_BENCH_HEIGHT 1536
+#define DT_OPENCL_BENCH_ROUNDS 3
+
+typedef struct _opencl_bench_kernels_t
+{
+  int ppg_green;
+  int colorcorrection;
+} _opencl_bench_kernels_t;
+
+static cl_int _opencl_benchmark_round(const int devid,
+                                      const _opencl_bench_kernels_t *k,
+                                      float *raw,
+                                      float *rgba,
+                                      cl_mem dev_raw,
+                                      cl_mem dev_a,
+                                      cl_mem dev_b,
+                                      dt_gaussian_cl_t *g)
+{
+  const int width = DT_OPENCL_BENCH_WIDTH;
+  const int height = DT_OPENCL_BENCH_HEIGHT;
+  const uint32_t filters = 0x94949494; // RGGB
+
+  // raw data in, as for the input of a pipe
+  cl_int err = dt_opencl_write_host_to_device(devid, raw, dev_raw, width, height, sizeof(float));
+  if(err != CL_SUCCESS) return err;
+
+  // demosaic
+  dt_opencl_local_buffer_t locopt
+    = (dt_opencl_local_buffer_t){ .xoffset = 2*3, .xfactor = 1, .yoffset = 2*3, .yfactor = 1,
+                                  .cellsize = sizeof(float) * 1, .overhead = 0,
+                                  .sizex = 1 << 8, .sizey = 1 << 8 };
+  if(!dt_opencl_local_buffer_opt(devid, k->ppg_green, &locopt))
+    return CL_INVALID_WORK_DIMENSION;
+  const size_t sizes[3] = { ROUNDUP(width, locopt.sizex), ROUNDUP(height, locopt.sizey), 1 };
+  const size_t local[3] = { locopt.sizex, locopt.sizey, 1 };
+  dt_opencl_set_kernel_args(devid, k->ppg_green, 0,
+    CLARG(dev_raw), CLARG(dev_a), CLARG(width), CLARG(height), CLARG(filters),
+    CLLOCAL(sizeof(float) * (locopt.sizex + 2*3) * (locopt.sizey + 2*3)));
+  err = dt_opencl_enqueue_kernel_2d_with_local(devid, k->ppg_green, sizes, local);
+  if(err != CL_SUCCESS) return err;
+
+  // blur
+  err = dt_gaussian_blur_cl(g, dev_a, dev_b);
+  if(err != CL_SUCCESS) return err;
+
+  // colour conversion
+  const float saturation = 1.1f;
+  const float scale = 0.9f;
+  const float a_base = 0.1f;
+  const float b_base = -0.1f;
+  err = dt_opencl_enqueue_kernel_2d_args(devid, k->colorcorrection, width, height,
+          CLARG(dev_b), CLARG(dev_a), CLARG(width), CLARG(height),
+          CLARG(saturation), CLARG(scale), CLARG(a_base), CLARG(scale), CLARG(b_base));
+  if(err != CL_SUCCESS) return err;
+
+  // and the result back to the host
+  return dt_opencl_copy_device_to_host(devid, rgba, dev_a, width, height, 4 * sizeof(float));
+}
+
+// seconds for DT_OPENCL_BENCH_ROUNDS of the suite, 0 if it failed
+static float _opencl_benchmark_device(const int devid,
+                                      const _opencl_bench_kernels_t *k)
+{
+  const int width = DT_OPENCL_BENCH_WIDTH;
+  const int height = DT_OPENCL_BENCH_HEIGHT;
+  float seconds = 0.0f;
+
+  float *raw = dt_alloc_align_float((size_t)width * height);
+  float *rgba = dt_alloc_align_float((size_t)4 * width * height);
+  cl_mem dev_raw = dt_opencl_alloc_device(devid, width, height, sizeof(float));
+  cl_mem dev_a = dt_opencl_alloc_device(devid, width, height, 4 * sizeof(float));
+  cl_mem dev_b = dt_opencl_alloc_device(devid, width, height, 4 * sizeof(float));
+  const float max[4] = { INFINITY, INFINITY, INFINITY, INFINITY };
+  const float min[4] = { -INFINITY, -INFINITY, -INFINITY, -INFINITY };
+  dt_gaussian_cl_t *g = dt_gaussian_init_cl(devid, width, height, 4, max, min, 4.0f, DT_IOP_GAUSSIAN_ZERO);
+  if(!raw || !rgba || !dev_raw || !dev_a || !dev_b || !g) goto end;
+
+  // some noisy raw data
+  uint32_t state = 1;
+  for(size_t i = 0; i < (size_t)width * height; i++)
+  {
+    state = state * 1664525u + 1013904223u;
+    raw[i] = (float)(state >> 8) / (float)(1 << 24);
+  }
+
+  // the first round builds and uploads everything once
+  if(_opencl_benchmark_round(devid, k, raw, rgba, dev_raw, dev_a, dev_b, g) != CL_SUCCESS
+     || !dt_opencl_finish(devid))
+    goto end;
+
+  const double start = dt_get_wtime();
+  cl_int err = CL_SUCCESS;
+  for(int r = 0; r < DT_OPENCL_BENCH_ROUNDS && err == CL_SUCCESS; r++)
+    err = _opencl_benchmark_round(devid, k, raw, rgba, dev_raw, dev_a, dev_b, g);
+  if(err == CL_SUCCESS && dt_opencl_finish(devid))
+    seconds = dt_get_wtime() - start;
+
+end:
+  dt_gaussian_free_cl(g);
+  dt_opencl_release_mem_object(dev_raw);
+  dt_opencl_release_mem_object(dev_a);
+  dt_opencl_release_mem_object(dev_b);
+  dt_free_align(raw);
+  dt_free_align(rgba);
+  return seconds;
+}
+
+void dt_opencl_benchmark(const gboolean force)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->inited) return;
+
+  _opencl_bench_kernels_t k = { .ppg_green = dt_opencl_create_kernel(0, "ppg_demosaic_green"),
+                                .colorcorrection = dt_opencl_create_kernel(2, "colorcorrection") };
+  gboolean measured = FALSE;
+
+  for(int devid = 0; devid < cl->num_devs; devid++)
+  {
+    dt_opencl_device_t *dev = &cl->dev[devid];
+    if(dev->disabled) continue;
+
+    // results are only valid for the driver they were taken with
+    gchar key[256] = { 0 };
+    g_snprintf(key, 254, "%s%s_%s_benchmark", DT_CLDEVICE_HEAD, dev->cname,
+               dev->cdriver ? dev->cdriver : "");
+    if(!force && dt_conf_key_not_empty(key))
+    {
+      dev->benchmark = fmaxf(0.0f, g_ascii_strtod(dt_conf_get_string_const(key), NULL));
+      if(dev->benchmark > 0.0f) continue;
+    }
+
+    // kernels still compiled in the background are timed on a later start
+    if(!dt_opencl_trylock_device(devid)) continue;
+    dev->benchmark = _opencl_benchmark_device(devid, &k);
+    dt_opencl_unlock_device(devid);
+
+    dt_print(DT_DEBUG_OPENCL,
+             "[dt_opencl_benchmark] '%s' id=%d: %.3f sec for %d rounds of the kernel suite%s",
+             dev->fullname, devid, dev->benchmark, DT_OPENCL_BENCH_ROUNDS,
+             dev->benchmark > 0.0f ? "" : " (failed)");
+    if(dev->benchmark > 0.0f)
+    {
+      gchar dat[64];
+      g_ascii_formatd(dat, sizeof(dat), "%.4f", dev->benchmark);
+      dt_conf_set_string(key, dat);
+      measured = TRUE;
+    }
+  }
+
+  dt_opencl_free_kernel(k.ppg_green);
+  dt_opencl_free_kernel(k.colorcorrection);
+
+  if(measured && cl->scheduling_profile == OPENCL_PROFILE_AUTOMATIC)
+    _opencl_apply_scheduling_profile(OPENCL_PROFILE_AUTOMATIC);
+}
+
+static int _opencl_benchmark_compare(gconstpointer a,
+                                     gconstpointer b)
+{
+  const dt_opencl_t *cl = darktable.opencl;
+  const float ta = cl->dev[*(const int *)a].benchmark;
+  const float tb = cl->dev[*(const int *)b].benchmark;
+  // devices without a result go last, in their original order
+  if(ta > 0.0f && tb > 0.0f && ta != tb) return ta < tb ? -1 : 1;
+  if((ta > 0.0f) != (tb > 0.0f)) return ta > 0.0f ? -1 : 1;
+  return *(const int *)a - *(const int *)b;
+}
+
+// priority string of the 'automatic' profile: full, export and
+// thumbnail pipes take the fastest device first, the previews the
+// second fastest so they run in parallel, or the CPU if there is only
+// one device.
+static gchar *_opencl_benchmark_priorities(void)
+{
+  const dt_opencl_t *cl = darktable.opencl;
+  const int num = cl->num_devs;
+  int *ranked = g_new(int, MAX(num, 1));
+  for(int i = 0; i < num; i++) ranked[i] = i;
+  qsort(ranked, num, sizeof(int), _opencl_benchmark_compare);
+
+  GString *all = g_string_new(NULL);
+  for(int i = 0; i < num; i++)
+    g_string_append_printf(all, "%s%d", i ? "," : "", ranked[i]);
+
+  GString *preview = g_string_new(NULL);
+  if(num > 1)
+    for(int i = 1; i < num; i++)
+      g_string_append_printf(preview, "%s%d", i > 1 ? "," : "", ranked[i]);
+  else
+    g_string_append_printf(preview, "!%d", ranked[0]);
+
+  gchar *priorities = g_strdup_printf("%s/%s/%s/%s/%s",
+                                      all->str, preview->str, all->str, all->str, preview->str);
+  g_string_free(all, TRUE);
+  g_string_free(preview, TRUE);
+  g_free(ranked);
+
+  dt_print(DT_DEBUG_OPENCL, "[opencl_benchmark_priorities] '%s'", priorities);
+  return priorities;
+}
+
 /** read scheduling profile for config variables */
 static dt_opencl_scheduling_profile_t _opencl_get_scheduling_profile(void)
 {
@@ -3713,6 +4586,8 @@ static dt_opencl_scheduling_profile_t _opencl_get_scheduling_profile(void)
     profile = OPENCL_PROFILE_MULTIPLE_GPUS;
   else if(!strcmp(pstr, "very fast GPU"))
     profile = OPENCL_PROFILE_VERYFAST_GPU;
+  else if(!strcmp(pstr, "automatic"))
+    profile = OPENCL_PROFILE_AUTOMATIC;
 
   return profile;
 }
@@ -3742,6 +4617,15 @@ static void _opencl_apply_scheduling_profile(dt_opencl_scheduling_profile_t prof
       _opencl_update_priorities("+*/+*/+*/+*/+*");
       _opencl_set_synchronization_timeout(0);
       break;
+    case OPENCL_PROFILE_AUTOMATIC:
+    {
+      gchar *priorities = _opencl_benchmark_priorities();
+      _opencl_update_priorities(priorities);
+      g_free(priorities);
+      _opencl_set_synchronization_timeout
+        (dt_conf_get_int("pixelpipe_synchronization_timeout"));
+      break;
+    }
     case OPENCL_PROFILE_DEFAULT:
     default:
       _opencl_update_priorities(dt_conf_get_string_const("opencl_device_priority"));
@@ -3806,6 +4690,7 @@ static cl_event *_opencl_events_get_slot(const int devid,
     {
       (*eventtags)[*numevents - 1].tag[0] = '\0';
     }
+    (*eventtags)[*numevents - 1].queued = dt_trace_enabled() ? dt_get_wtime() : 0.0;
 
     (*totalevents)++;
     return (*eventlist) + *numevents - 1;
@@ -3852,6 +4737,7 @@ static cl_event *_opencl_events_get_slot(const int devid,
   {
     (*eventtags)[*numevents - 1].tag[0] = '\0';
   }
+  (*eventtags)[*numevents - 1].queued = dt_trace_enabled() ? dt_get_wtime() : 0.0;
 
   (*totalevents)++;
   *maxeventslot = MAX(*maxeventslot, *numevents - 1);
@@ -4028,6 +4914,34 @@ static void _opencl_events_profiling(const int devid,
   free(tags);
 }
 
+/** write the event to the trace. Device timestamps are mapped to the
+    host clock via the host time the command was enqueued. */
+static void _opencl_trace_event(const int devid,
+                                cl_event event,
+                                const dt_opencl_eventtag_t *eventtag,
+                                const cl_ulong start,
+                                const cl_ulong end)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  cl_ulong queued, submit;
+  if(eventtag->queued <= 0.0
+     || (cl->dlocl->symbols->dt_clGetEventProfilingInfo)
+          (event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &queued, NULL) != CL_SUCCESS
+     || (cl->dlocl->symbols->dt_clGetEventProfilingInfo)
+          (event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &submit, NULL) != CL_SUCCESS)
+    return;
+
+  char detail[64];
+  snprintf(detail, sizeof(detail), "queued->submit %.3fms, submit->start %.3fms",
+           (submit - queued) * 1e-6, (start - submit) * 1e-6);
+  dt_trace_span("opencl",
+                eventtag->tag[0] ? eventtag->tag : "<?>",
+                devid,
+                eventtag->queued + (start - queued) * 1e-9,
+                eventtag->queued + (end - queued) * 1e-9,
+                detail);
+}
+
 /** Wait for events in eventlist to terminate, check for return status
     and profiling info of events.  If "reset" is TRUE report summary
     info (would be CL_COMPLETE or last error code) and print profiling
@@ -4084,9 +4998,10 @@ cl_int dt_opencl_events_flush(const int devid,
     else
       (*totalsuccess)++;
 
-    if(darktable.unmuted & DT_DEBUG_PERF)
+    if((darktable.unmuted & DT_DEBUG_PERF) || dt_trace_enabled())
     {
-      // get profiling info of event (only if darktable was called with '-d perf')
+      // get profiling info of event (only if darktable was called with
+      // '-d perf' or a trace is written)
       cl_ulong start;
       cl_ulong end;
       cl_int errs = (cl->dlocl->symbols->dt_clGetEventProfilingInfo)(
@@ -4097,6 +5012,8 @@ cl_int dt_opencl_events_flush(const int devid,
       if(errs == CL_SUCCESS && erre == CL_SUCCESS)
       {
         (*eventtags)[k].timelapsed = end - start;
+        if(dt_trace_enabled())
+          _opencl_trace_event(devid, (*eventlist)[k], &(*eventtags)[k], start, end);
       }
       else
       {
@@ -85,7 +85,8 @@ typedef enum dt_opencl_scheduling_profile_t
 {
   OPENCL_PROFILE_DEFAULT,
   OPENCL_PROFILE_MULTIPLE_GPUS,
-  OPENCL_PROFILE_VERYFAST_GPU
+  OPENCL_PROFILE_VERYFAST_GPU,
+  OPENCL_PROFILE_AUTOMATIC
 } dt_opencl_scheduling_profile_t;
 
 /**
@@ -95,6 +96,7 @@ typedef struct dt_opencl_eventtag_t
 {
   cl_int retval;
   cl_ulong timelapsed;
+  double queued; // host time the command was enqueued, for traces
   char tag[DT_OPENCL_EVENTNAMELENGTH];
 } dt_opencl_eventtag_t;
 
@@ -103,6 +105,20 @@ typedef struct dt_opencl_eventtag_t
  * to support multi-gpu and mixed systems with cpu support,
  * we encapsulate devices and use separate command queues.
  */
+// number of released buffers and images kept per device for reuse
+#define DT_OPENCL_POOL_SLOTS 32
+
+typedef struct dt_opencl_pool_entry_t
+{
+  cl_mem mem;
+  size_t size;
+  int width;
+  int height;
+  int bpp;          // 0 for plain buffers
+  gboolean half;    // image stored as CL_HALF_FLOAT
+  uint64_t used;    // age for eviction
+} dt_opencl_pool_entry_t;
+
 typedef struct dt_opencl_device_t
 {
   dt_pthread_mutex_t lock;
@@ -117,6 +133,8 @@ typedef struct dt_opencl_device_t
   cl_program program[DT_OPENCL_MAX_PROGRAMS];
   cl_kernel kernel[DT_OPENCL_MAX_KERNELS];
   gboolean program_used[DT_OPENCL_MAX_PROGRAMS];
+  // set while a program is compiled in the background or if that failed
+  gint program_pending[DT_OPENCL_MAX_PROGRAMS];
   gboolean kernel_used[DT_OPENCL_MAX_KERNELS];
   cl_event *eventlist;
   dt_opencl_eventtag_t *eventtags;
@@ -133,6 +151,8 @@ typedef struct dt_opencl_device_t
   const char *platform;
   const char *device_version;
   const char *cname;
+  // driver version without non-alphanumeric chars
+  const char *cdriver;
   const char *options;
   const char *cflags;
   cl_int summary;
@@ -212,6 +232,32 @@ typedef struct dt_opencl_device_t
   uint32_t exceptions;
 
   float advantage;
+
+  // second command queue used for host<->device transfers overlapping
+  // with kernels in cmd_queue, NULL if not available
+  cl_command_queue transfer_queue;
+
+  // RGBA images with CL_HALF_FLOAT channels are supported
+  gboolean half_images;
+
+  // released device buffers and images kept for reuse, protected by
+  // the global lock. pool_idle is the memory held there unused.
+  dt_opencl_pool_entry_t pool[DT_OPENCL_POOL_SLOTS];
+  size_t pool_idle;
+  size_t pool_peak;
+  uint64_t pool_clock;
+  int pool_hits;
+  int pool_misses;
+
+  // measured per-module processing cost on this device, keyed by
+  // module op, see dt_opencl_cost_prefer_cpu()
+  GHashTable *gpu_costs;
+  // measured host<->device transfer cost in seconds per MB
+  float transfer_cost;
+  int transfer_runs;
+
+  // seconds for the kernel suite of dt_opencl_benchmark(), 0 if not measured
+  float benchmark;
 } dt_opencl_device_t;
 
 struct dt_bilateral_cl_global_t;
@@ -220,6 +266,8 @@ struct dt_dwt_cl_global_t; // wavelet decompose
 struct dt_heal_cl_global_t; // healing
 struct dt_colorspaces_cl_global_t; // colorspaces transform
 struct dt_guided_filter_cl_global_t;
+struct dt_distance_transform_cl_global_t;
+struct dt_masks_cl_global_t;
 
 /**
  * main struct, stored in darktable.opencl.
@@ -236,8 +284,20 @@ typedef struct dt_opencl_t
   int error_count;
   int opencl_synchronization_timeout;
   dt_opencl_scheduling_profile_t scheduling_profile;
+  // use measured module timings to decide between CPU and GPU per module
+  gboolean cost_model;
+  GHashTable *cpu_costs;
+  // keep released device memory in a per-device pool
+  gboolean use_pool;
+  // programs not available as cached binaries are compiled by this pool
+  GThreadPool *build_pool;
+  // store intermediates of modules flagged IOP_FLAGS_HALF_FLOAT as half floats
+  gboolean half_float;
+  int kernel_convert_image;
   uint32_t crc;
   int mandatory[5];
+  // pipes waiting in dt_opencl_lock_device() for a mandatory device, in order
+  GQueue lock_waiters;
   int *dev_priority_image;
   int *dev_priority_preview;
   int *dev_priority_preview2;
@@ -273,6 +333,12 @@ typedef struct dt_opencl_t
   // global kernels for guided filter.
   struct dt_guided_filter_cl_global_t *guided_filter;
 
+  // global kernels for the distance transform.
+  struct dt_distance_transform_cl_global_t *distance_transform;
+
+  // global kernels for drawn masks.
+  struct dt_masks_cl_global_t *masks;
+
   // saved kernel info for deferred initialisation
   int program_saved[DT_OPENCL_MAX_KERNELS];
   const char *name_saved[DT_OPENCL_MAX_KERNELS];
@@ -326,6 +392,9 @@ int dt_opencl_lock_device(const int pipetype);
 /** done with your command queue. */
 void dt_opencl_unlock_device(const int dev);
 
+/** locks the given device if it is currently unused, returns TRUE on success */
+gboolean dt_opencl_trylock_device(const int devid);
+
 /** inits a kernel. returns the index or -1 if fail. */
 int dt_opencl_create_kernel(const int program,
                             const char *name);
@@ -450,6 +519,28 @@ int dt_opencl_read_host_from_device_raw(const int devid,
                                         const int rowpitch,
                                         const int blocking);
 
+/** non-blocking image transfer on the device's transfer queue, so it
+    can overlap with kernels running in the main command queue. *event
+    must be waited for via dt_opencl_wait_event() */
+int dt_opencl_transfer_async(const int devid,
+                             void *host,
+                             void *device,
+                             const size_t *origin,
+                             const size_t *region,
+                             const int rowpitch,
+                             const gboolean to_device,
+                             cl_event *event);
+
+/** blocks until the event has completed and releases it */
+int dt_opencl_wait_event(const int devid,
+                         cl_event event);
+
+/** submit all commands enqueued so far to the device without waiting */
+int dt_opencl_flush(const int devid);
+
+/** tests for a second command queue available for async transfers */
+gboolean dt_opencl_has_transfer_queue(const int devid);
+
 int dt_opencl_write_host_to_device(const int devid,
                                    void *host,
                                    void *device,
@@ -515,6 +606,12 @@ void *dt_opencl_alloc_device(const int devid,
                              const int height,
                              const int bpp);
 
+/** allocates an RGBA image with half float channels, NULL if half float
+    intermediates are disabled or not supported by the device */
+void *dt_opencl_alloc_device_half(const int devid,
+                                  const int width,
+                                  const int height);
+
 void *dt_opencl_alloc_device_use_host_pointer(const int devid,
                                               const int width,
                                               const int height,
@@ -585,6 +682,9 @@ int dt_opencl_get_image_height(cl_mem mem);
 
 int dt_opencl_get_image_element_size(cl_mem mem);
 
+/** TRUE if the image is stored with half float channels */
+gboolean dt_opencl_image_is_half(cl_mem mem);
+
 void *dt_opencl_duplicate_image(const int devid, const cl_mem src);
 
 void dt_opencl_dump_pipe_pfm(const char* mod,
@@ -607,6 +707,9 @@ gboolean dt_opencl_image_fits_device(const int devid,
 /** get available memory for the device */
 cl_ulong dt_opencl_get_device_available(const int devid);
 
+/** release all unused buffers and images kept in the device's pool */
+void dt_opencl_pool_flush(const int devid);
+
 /** check tuning settings and available memory for the device */
 void dt_opencl_check_tuning(const int devid);
 
@@ -645,6 +748,32 @@ gboolean dt_opencl_avoid_atomics(const int devid);
 void dt_opencl_micro_nap(const int devid);
 gboolean dt_opencl_use_pinned_memory(const int devid);
 
+/** time demosaic, blur, colour conversion and transfer kernels on all
+    devices. results are kept per device and driver version, only
+    devices without one are measured unless force is set. the
+    'automatic' scheduling profile ranks the devices by them. */
+void dt_opencl_benchmark(const gboolean force);
+
+/** record the measured time for processing a module on CPU (devid < 0)
+    or on the given device */
+void dt_opencl_cost_record(const int devid,
+                           const char *op,
+                           const size_t pixels,
+                           const double seconds);
+/** record the measured time for a host<->device transfer */
+void dt_opencl_cost_record_transfer(const int devid,
+                                    const size_t bytes,
+                                    const double seconds);
+/** use the recorded costs to check if processing the module on CPU
+    is expected to be faster than on the device. The transfer costs
+    from and to the device memory are included depending on where the
+    input currently lives. */
+gboolean dt_opencl_cost_prefer_cpu(const int devid,
+                                   const char *op,
+                                   const size_t pixels,
+                                   const size_t bytes,
+                                   const gboolean input_on_gpu);
+
 G_END_DECLS
 
 #else
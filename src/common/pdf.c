@@ -269,26 +269,46 @@ static size_t _pdf_stream_encoder_ASCIIHex(dt_pdf_t *pdf, const unsigned char *d
 }
 
 // using zlib we get quite small files, but it's slow
+// deflate through a small buffer, the compressed stream is never held in memory as a whole
 static size_t _pdf_stream_encoder_Flate(dt_pdf_t *pdf, const unsigned char *data, size_t len)
 {
-  int result;
-  uLongf destLen = compressBound(len);
-  unsigned char *buffer = malloc(destLen);
-  if(!buffer)
+  unsigned char buffer[1 << 16];
+  z_stream zs = { 0 };
+  if(deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK)
     return 0;
-  
-  result = compress(buffer, &destLen, data, len);
 
-  if(result != Z_OK)
+  size_t stream_size = 0;
+  int result = Z_OK;
+  zs.next_in = (Bytef *)data;
+  do
   {
-    free(buffer);
-    return 0;
-  }
-
-  fwrite(buffer, 1, destLen, pdf->fd);
+    // avail_in is only an uInt
+    const size_t chunk = MIN(len, (size_t)1 << 30);
+    zs.avail_in = chunk;
+    len -= chunk;
+    const int flush = len ? Z_NO_FLUSH : Z_FINISH;
+    do
+    {
+      zs.next_out = buffer;
+      zs.avail_out = sizeof(buffer);
+      result = deflate(&zs, flush);
+      if(result == Z_STREAM_ERROR)
+      {
+        deflateEnd(&zs);
+        return 0;
+      }
+      const size_t have = sizeof(buffer) - zs.avail_out;
+      if(fwrite(buffer, 1, have, pdf->fd) != have)
+      {
+        deflateEnd(&zs);
+        return 0;
+      }
+      stream_size += have;
+    } while(zs.avail_out == 0);
+  } while(len);
 
-  free(buffer);
-  return destLen;
+  deflateEnd(&zs);
+  return result == Z_STREAM_END ? stream_size : 0;
 }
 
 static size_t _pdf_write_stream(dt_pdf_t *pdf, dt_pdf_stream_encoder_t encoder, const unsigned char *data, size_t len)
@@ -65,36 +65,44 @@ int dt_apply_printer_profile(void **in, uint32_t width, uint32_t height, int bpp
     return 1;
   }
 
-  void *out = malloc((size_t)3 * width * height);
-  if(!out)
+  /* the 8bit output is never larger than the input, so bands of rows are
+     transformed into a small scratch buffer and written back over the
+     input rows already consumed. the image is not held twice in memory.
+  */
+  const size_t in_stride = (size_t)3 * (bpp == 8 ? 1 : 2) * width;
+  const size_t out_stride = (size_t)3 * width;
+  const int band = MAX(1, MIN(height, ((size_t)16 << 20) / MAX(1, out_stride)));
+  uint8_t *scratch = malloc(out_stride * band);
+  if(!scratch)
   {
+    cmsDeleteTransform(hTransform);
     dt_print(DT_DEBUG_ALWAYS, "unable to allocate buffer for printer-proofed image");
     return 1;
   }
 
-  if(bpp == 8)
+  uint8_t *const buf = (uint8_t *)*in;
+  for(int row = 0; row < (int)height; row += band)
   {
-    const uint8_t *ptr_in = (uint8_t *)*in;
-    uint8_t *ptr_out = (uint8_t *)out;
+    const int rows = MIN(band, (int)height - row);
 
     DT_OMP_FOR(shared(hTransform))
-    for(int k=0; k<height; k++)
-      cmsDoTransform(hTransform, (const void *)&ptr_in[k*width*3], (void *)&ptr_out[k*width*3], width);
-  }
-  else
-  {
-    const uint16_t *ptr_in = (uint16_t *)*in;
-    uint8_t *ptr_out = (uint8_t *)out;
+    for(int k = 0; k < rows; k++)
+      cmsDoTransform(hTransform,
+                     (const void *)&buf[(row + k) * in_stride],
+                     (void *)&scratch[k * out_stride], width);
 
-    DT_OMP_FOR(shared(hTransform))
-    for(int k=0; k<height; k++)
-      cmsDoTransform(hTransform, (const void *)&ptr_in[k*width*3], (void *)&ptr_out[k*width*3], width);
+    // only this band's and earlier input rows are overwritten
+    memcpy(&buf[row * out_stride], scratch, rows * out_stride);
   }
+  free(scratch);
 
   cmsDeleteTransform(hTransform);
 
-  free(*in);
-  *in = out;
+  if(bpp != 8)
+  {
+    void *out = realloc(*in, out_stride * height);
+    if(out) *in = out;
+  }
 
   return 0;
 }
@@ -81,12 +81,14 @@ static void _pop_undo(gpointer user_data, dt_undo_type_t type, dt_undo_data_t da
 {
   if(type == DT_UNDO_RATINGS)
   {
+    dt_image_cache_write_back_begin();
     for(GList *list = (GList *)data; list; list = g_list_next(list))
     {
       dt_undo_ratings_t *ratings = list->data;
       _ratings_apply_to_image(ratings->imgid, (action == DT_ACTION_UNDO) ? ratings->before : ratings->after);
       *imgs = g_list_prepend(*imgs, GINT_TO_POINTER(ratings->imgid));
     }
+    dt_image_cache_write_back_end();
     dt_collection_hint_message(darktable.collection);
   }
 }
@@ -145,6 +147,7 @@ static void _ratings_apply(const GList *imgs,
     dt_gui_process_events();
   }
 
+  dt_image_cache_write_back_begin();
   for(const GList *images = imgs; images; images = g_list_next(images))
   {
     const dt_imgid_t image_id = GPOINTER_TO_INT(images->data);
@@ -175,6 +178,7 @@ static void _ratings_apply(const GList *imgs,
 
     _ratings_apply_to_image(image_id, new_rating);
   }
+  dt_image_cache_write_back_end();
 }
 
 void dt_ratings_apply_on_list(const GList *img,
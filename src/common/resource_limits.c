@@ -26,7 +26,11 @@
 #include <stdint.h>       // for uintmax_t
 #include <stdio.h>        // for fprintf, stderr
 #include <string.h>       // for strerror
+#include <stdlib.h>       // for strtoull, strtof
 #include <inttypes.h>
+#if defined(__linux__)
+#include <pthread.h>      // for pthread_once
+#endif
 
 #ifdef _WIN32
 #include "win/rlimit.h"
@@ -77,6 +81,87 @@ void dt_set_rlimits()
   dt_set_rlimits_stack();
 }
 
+#if defined(__linux__)
+static char _cgroup_dir[1024] = { 0 };
+static pthread_once_t _cgroup_once = PTHREAD_ONCE_INIT;
+
+static void _find_cgroup_dir()
+{
+  // cgroup v2 has a single "0::/path" line, the v1 hierarchies are not supported
+  FILE *f = fopen("/proc/self/cgroup", "r");
+  if(!f) return;
+  char line[1024];
+  while(fgets(line, sizeof(line), f))
+  {
+    if(strncmp(line, "0::", 3)) continue;
+    line[strcspn(line, "\n")] = '\0';
+    snprintf(_cgroup_dir, sizeof(_cgroup_dir), "/sys/fs/cgroup%s", line + 3);
+    break;
+  }
+  fclose(f);
+}
+
+static FILE *_open_cgroup_file(const char *name)
+{
+  pthread_once(&_cgroup_once, _find_cgroup_dir);
+  if(!_cgroup_dir[0]) return NULL;
+  char path[1100];
+  snprintf(path, sizeof(path), "%s/%s", _cgroup_dir, name);
+  return fopen(path, "r");
+}
+
+static size_t _read_cgroup_value(const char *name)
+{
+  FILE *f = _open_cgroup_file(name);
+  if(!f) return 0;
+  char value[64] = { 0 };
+  // "max" means no limit
+  const size_t res = fgets(value, sizeof(value), f) && strncmp(value, "max", 3)
+    ? strtoull(value, NULL, 10)
+    : 0;
+  fclose(f);
+  return res;
+}
+
+static float _read_pressure(FILE *f)
+{
+  float avg10 = 0.0f;
+  char line[256];
+  while(fgets(line, sizeof(line), f))
+  {
+    const char *val = strstr(line, "avg10=");
+    if(!strncmp(line, "some", 4) && val)
+    {
+      avg10 = strtof(val + 6, NULL);
+      break;
+    }
+  }
+  fclose(f);
+  return avg10;
+}
+#endif
+
+void dt_get_cgroup_memory(size_t *limit, size_t *usage)
+{
+#if defined(__linux__)
+  *limit = _read_cgroup_value("memory.max");
+  *usage = *limit ? _read_cgroup_value("memory.current") : 0;
+#else
+  *limit = *usage = 0;
+#endif
+}
+
+float dt_get_memory_pressure()
+{
+#if defined(__linux__)
+  FILE *f = _open_cgroup_file("memory.pressure");
+  if(!f) f = fopen("/proc/pressure/memory", "r");
+  return f ? _read_pressure(f) : 0.0f;
+#else
+  return 0.0f;
+#endif
+}
+
 
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
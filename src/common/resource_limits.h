@@ -18,8 +18,17 @@
 
 #pragma once
 
+#include <stddef.h>
+
 void dt_set_rlimits();
 
+/** memory limit and usage of the cgroup (v2) darktable runs in, both are 0 if unknown or unlimited */
+void dt_get_cgroup_memory(size_t *limit, size_t *usage);
+
+/** percentage of the last 10 seconds some task stalled waiting for memory, taken from the
+    pressure stall information of our cgroup or the whole system. 0 if not available. */
+float dt_get_memory_pressure();
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -75,6 +75,18 @@ typedef struct
   gboolean in_plugin;
 } StyleData;
 
+// styles compiled for export, kept for the session and dropped whenever
+// a style is created, updated, imported or deleted
+static GHashTable *_compiled_styles = NULL; // name -> dt_style_template_t
+static GMutex _compiled_styles_lock;
+
+static void _styles_compiled_invalidate(void)
+{
+  g_mutex_lock(&_compiled_styles_lock);
+  if(_compiled_styles) g_hash_table_remove_all(_compiled_styles);
+  g_mutex_unlock(&_compiled_styles_lock);
+}
+
 void dt_style_free(gpointer data)
 {
   dt_style_t *style = (dt_style_t *)data;
@@ -467,6 +479,7 @@ void dt_styles_update(const char *name,
 
   dt_gui_style_content_dialog("", -1);
 
+  _styles_compiled_invalidate();
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_STYLE_CHANGED);
 
   g_free(desc);
@@ -553,6 +566,7 @@ void dt_styles_create_from_style(const char *name,
     dt_styles_save_to_file(newname, NULL, FALSE);
 
     dt_control_log(_("style named '%s' successfully created"), newname);
+    _styles_compiled_invalidate();
     DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_STYLE_CHANGED);
   }
 }
@@ -638,6 +652,7 @@ gboolean dt_styles_create_from_image(const char *name,
     /* backup style to disk */
     dt_styles_save_to_file(name, NULL, FALSE);
 
+    _styles_compiled_invalidate();
     DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_STYLE_CHANGED);
     return TRUE;
   }
@@ -659,339 +674,539 @@ void dt_styles_create_from_list(const GList *list)
   if(!selected) dt_control_log(_("no image selected!"));
 }
 
-void dt_styles_apply_style_item(dt_develop_t *dev,
-                                dt_style_item_t *style_item,
-                                GList **modules_used,
-                                const gboolean append)
+// set the params and blend params of module from the style item, converting
+// them from older versions if needed. returns FALSE if they cannot be used.
+static gboolean _style_item_to_module(dt_iop_module_t *module,
+                                      const dt_style_item_t *style_item,
+                                      gboolean *autoinit)
 {
-  // get any instance of the same operation so we can copy it
-  dt_iop_module_t *mod_src =
-    dt_iop_get_module_by_op_priority(dev->iop, style_item->operation, -1);
+  gboolean do_merge = TRUE;
 
-  if(mod_src)
+  // TODO: this is copied from dt_dev_read_history_ext(), maybe do a helper with this?
+  if(style_item->blendop_params
+     && (style_item->blendop_version == dt_develop_blend_version())
+     && (style_item->blendop_params_size == sizeof(dt_develop_blend_params_t)))
+  {
+    memcpy(module->blend_params, style_item->blendop_params,
+           sizeof(dt_develop_blend_params_t));
+  }
+  else if(style_item->blendop_params
+          && dt_develop_blend_legacy_params(module, style_item->blendop_params,
+                                            style_item->blendop_version,
+                                            module->blend_params, dt_develop_blend_version(),
+                                            style_item->blendop_params_size) == FALSE)
   {
-    dt_iop_module_t *module = calloc(1, sizeof(dt_iop_module_t));
+    // do nothing
+  }
+  else
+  {
+    memcpy(module->blend_params, module->default_blendop_params,
+           sizeof(dt_develop_blend_params_t));
+  }
 
-    if(module)
-      module->dev = dev;
+  *autoinit = FALSE;
+
+  if(style_item->params_size != 0
+     && (module->version() != style_item->module_version
+         || module->params_size != style_item->params_size
+         || strcmp(style_item->operation, module->op)))
+  {
+    const int legacy_ret =
+      dt_iop_legacy_params
+      (module,
+       style_item->params, style_item->params_size, style_item->module_version,
+       &module->params, module->version());
 
-    if(!module || dt_iop_load_module(module, mod_src->so, dev))
+    if(legacy_ret == 1)
     {
-      module = NULL;
       dt_print(DT_DEBUG_ALWAYS,
-               "[dt_styles_apply_style_item] can't load module %s %s",
-               style_item->operation,
-               style_item->multi_name);
+               "[dt_styles_apply_style_item] module `%s' version mismatch:"
+               " history is %d, darktable is %d",
+               module->op, style_item->module_version, module->version());
+      dt_control_log(_("module `%s' version mismatch: %d != %d"), module->op,
+                     module->version(), style_item->module_version);
+
+      do_merge = FALSE;
+    }
+    else if(legacy_ret == -1)
+    {
+      // auto-init module
+      *autoinit = TRUE;
     }
     else
     {
-      gboolean do_merge = TRUE;
+      if(dt_iop_module_is(module->so, "spots") && style_item->module_version == 1)
+      {
+        // FIXME: not sure how to handle this here...
+        // quick and dirty hack to handle spot removal legacy_params
+        /* memcpy(module->blend_params, module->blend_params,
+                  sizeof(dt_develop_blend_params_t));
+           memcpy(module->blend_params, module->default_blendop_params,
+                  sizeof(dt_develop_blend_params_t)); */
+      }
+    }
 
-      module->instance = mod_src->instance;
-      module->multi_priority = style_item->multi_priority;
-      module->iop_order = style_item->iop_order;
+    /*
+     * Fix for flip iop: previously it was not always needed, but it might be
+     * in history stack as "orientation (off)", but now we always want it
+     * by default, so if it is disabled, enable it, and replace params with
+     * default_params. if user want to, he can disable it.
+     */
+    if(dt_iop_module_is(module->so, "flip")
+       && !module->enabled
+       && labs(style_item->module_version) == 1)
+    {
+      memcpy(module->params, module->default_params, module->params_size);
+      module->enabled = TRUE;
+    }
+  }
+  else
+  {
+    if(style_item->params_size == 0)
+    {
+      /* an auto-init module, we cannot handle this here as we
+         don't have the image's default parameters. This parameter
+         must be set when loading history in the darkroom. */
+      *autoinit = TRUE;
+    }
+    else
+      memcpy(module->params, style_item->params, style_item->params_size);
+  }
 
-      module->enabled = style_item->enabled;
-      g_strlcpy(module->multi_name, style_item->multi_name, sizeof(module->multi_name));
-      module->multi_name_hand_edited = style_item->multi_name_hand_edited;
+  return do_merge;
+}
 
-      // TODO: this is copied from dt_dev_read_history_ext(), maybe do a helper with this?
-      if(style_item->blendop_params
-         && (style_item->blendop_version == dt_develop_blend_version())
-         && (style_item->blendop_params_size == sizeof(dt_develop_blend_params_t)))
-      {
-        memcpy(module->blend_params, style_item->blendop_params,
-               sizeof(dt_develop_blend_params_t));
-      }
-      else if(style_item->blendop_params
-              && dt_develop_blend_legacy_params(module, style_item->blendop_params,
-                                                style_item->blendop_version,
-                                                module->blend_params, dt_develop_blend_version(),
-                                                style_item->blendop_params_size) == FALSE)
-      {
-        // do nothing
-      }
-      else
-      {
-        memcpy(module->blend_params, module->default_blendop_params,
-               sizeof(dt_develop_blend_params_t));
-      }
+// load a new instance of the operation of style_item, NULL if not available
+static dt_iop_module_t *_style_item_load_module(dt_develop_t *dev,
+                                                const dt_style_item_t *style_item)
+{
+  // get any instance of the same operation so we can copy it
+  dt_iop_module_t *mod_src =
+    dt_iop_get_module_by_op_priority(dev->iop, style_item->operation, -1);
 
-      gboolean autoinit = FALSE;
+  if(!mod_src) return NULL;
 
-      if(style_item->params_size != 0
-         && (module->version() != style_item->module_version
-             || module->params_size != style_item->params_size
-             || strcmp(style_item->operation, module->op)))
-      {
-        const int legacy_ret =
-          dt_iop_legacy_params
-          (module,
-           style_item->params, style_item->params_size, style_item->module_version,
-           &module->params, module->version());
+  dt_iop_module_t *module = calloc(1, sizeof(dt_iop_module_t));
 
-        if(legacy_ret == 1)
-        {
-          dt_print(DT_DEBUG_ALWAYS,
-                   "[dt_styles_apply_style_item] module `%s' version mismatch:"
-                   " history is %d, darktable is %d",
-                   module->op, style_item->module_version, module->version());
-          dt_control_log(_("module `%s' version mismatch: %d != %d"), module->op,
-                         module->version(), style_item->module_version);
-
-          do_merge = FALSE;
-        }
-        else if(legacy_ret == -1)
-        {
-          // auto-init module
-          autoinit = TRUE;
-        }
-        else
-        {
-          if(dt_iop_module_is(module->so, "spots") && style_item->module_version == 1)
-          {
-            // FIXME: not sure how to handle this here...
-            // quick and dirty hack to handle spot removal legacy_params
-            /* memcpy(module->blend_params, module->blend_params,
-                      sizeof(dt_develop_blend_params_t));
-               memcpy(module->blend_params, module->default_blendop_params,
-                      sizeof(dt_develop_blend_params_t)); */
-          }
-        }
+  if(module)
+    module->dev = dev;
 
-        /*
-         * Fix for flip iop: previously it was not always needed, but it might be
-         * in history stack as "orientation (off)", but now we always want it
-         * by default, so if it is disabled, enable it, and replace params with
-         * default_params. if user want to, he can disable it.
-         */
-        if(dt_iop_module_is(module->so, "flip")
-           && !module->enabled
-           && labs(style_item->module_version) == 1)
-        {
-          memcpy(module->params, module->default_params, module->params_size);
-          module->enabled = TRUE;
-        }
+  if(!module || dt_iop_load_module(module, mod_src->so, dev))
+  {
+    free(module);
+    dt_print(DT_DEBUG_ALWAYS,
+             "[dt_styles_apply_style_item] can't load module %s %s",
+             style_item->operation,
+             style_item->multi_name);
+    return NULL;
+  }
+
+  module->instance = mod_src->instance;
+  module->multi_priority = style_item->multi_priority;
+  module->iop_order = style_item->iop_order;
+
+  module->enabled = style_item->enabled;
+  g_strlcpy(module->multi_name, style_item->multi_name, sizeof(module->multi_name));
+  module->multi_name_hand_edited = style_item->multi_name_hand_edited;
+
+  return module;
+}
+
+void dt_styles_apply_style_item(dt_develop_t *dev,
+                                dt_style_item_t *style_item,
+                                GList **modules_used,
+                                const gboolean append)
+{
+  dt_iop_module_t *module = _style_item_load_module(dev, style_item);
+
+  if(module)
+  {
+    gboolean autoinit = FALSE;
+
+    if(_style_item_to_module(module, style_item, &autoinit))
+      dt_history_merge_module_into_history
+        (dev, NULL, module, modules_used, append, autoinit);
+
+    dt_iop_cleanup_module(module);
+    free(module);
+  }
+}
+
+struct dt_style_template_t
+{
+  int32_t id;
+  gchar *name;
+  GList *items;     // dt_style_item_t in the order they are applied
+  GList *iop_list;  // module order of the style, NULL if it has none
+  guint tagid;      // darktable|style|<name>, created on first use
+  gboolean compiled; // items converted to the current module versions
+};
+
+static dt_style_item_t *_style_item_dup(const dt_style_item_t *item)
+{
+  dt_style_item_t *dup = malloc(sizeof(dt_style_item_t));
+  memcpy(dup, item, sizeof(dt_style_item_t));
+  dup->name = g_strdup(item->name);
+  dup->operation = g_strdup(item->operation);
+  dup->multi_name = g_strdup(item->multi_name);
+  dup->params = item->params_size ? malloc(item->params_size) : NULL;
+  if(dup->params) memcpy(dup->params, item->params, item->params_size);
+  dup->blendop_params = malloc(item->blendop_params_size);
+  memcpy(dup->blendop_params, item->blendop_params, item->blendop_params_size);
+  return dup;
+}
+
+// convert the template items once to the current module and blend
+// versions, so that applying them is a plain copy for every image
+static void _styles_template_compile(dt_style_template_t *t, dt_develop_t *dev)
+{
+  if(t->compiled) return;
+  t->compiled = TRUE;
+
+  GList *l = t->items;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    dt_style_item_t *item = l->data;
+
+    // the orientation fix in _style_item_to_module() takes the defaults
+    // of the image, leave those items to be converted per image.
+    const gboolean image_dependent =
+      !strcmp(item->operation, "flip") && !item->enabled && labs(item->module_version) == 1;
+
+    dt_iop_module_t *module = image_dependent ? NULL : _style_item_load_module(dev, item);
+    if(module)
+    {
+      gboolean autoinit = FALSE;
+      if(!_style_item_to_module(module, item, &autoinit))
+      {
+        // cannot be converted, it would be skipped on every image
+        t->items = g_list_delete_link(t->items, l);
+        dt_style_item_free(item);
       }
       else
       {
-        if(style_item->params_size == 0)
+        free(item->params);
+        item->params = NULL;
+        item->params_size = 0;
+        if(!autoinit)
         {
-          /* an auto-init module, we cannot handle this here as we
-             don't have the image's default parameters. This parameter
-             must be set when loading history in the darkroom. */
-          autoinit = TRUE;
+          item->params_size = module->params_size;
+          item->params = malloc(module->params_size);
+          memcpy(item->params, module->params, module->params_size);
         }
-        else
-          memcpy(module->params, style_item->params, style_item->params_size);
+        item->module_version = module->version();
+        item->enabled = module->enabled;
+
+        free(item->blendop_params);
+        item->blendop_params_size = sizeof(dt_develop_blend_params_t);
+        item->blendop_params = malloc(sizeof(dt_develop_blend_params_t));
+        memcpy(item->blendop_params, module->blend_params, sizeof(dt_develop_blend_params_t));
+        item->blendop_version = dt_develop_blend_version();
       }
 
-      if(do_merge)
-        dt_history_merge_module_into_history
-          (dev, NULL, module, modules_used, append, autoinit);
-    }
-
-    if(module)
-    {
       dt_iop_cleanup_module(module);
       free(module);
     }
+    l = next;
   }
+
+  dt_print(DT_DEBUG_PARAMS, "[styles] compiled `%s', %d items",
+           t->name, g_list_length(t->items));
 }
 
-void _styles_apply_to_image_ext(const char *name,
-                                const gboolean duplicate,
-                                const gboolean overwrite,
-                                const dt_imgid_t imgid,
-                                const gboolean undo)
+dt_style_template_t *dt_styles_template_new(const char *name)
 {
+  const int style_id = dt_styles_get_id_by_name(name);
+  if(style_id == 0) return NULL;
+
+  dt_style_template_t *t = g_malloc0(sizeof(dt_style_template_t));
+  t->id = style_id;
+  t->name = g_strdup(name);
+  t->iop_list = dt_styles_module_order_list(name);
+
   sqlite3_stmt *stmt;
+  // go through all entries in style
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "SELECT num, module, operation, op_params, enabled,"
+     "       blendop_params, blendop_version, multi_priority,"
+     "       multi_name, multi_name_hand_edited"
+     " FROM data.style_items WHERE styleid=?1 "
+     " ORDER BY operation, multi_priority",
+     -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, style_id);
 
-  const int style_id = dt_styles_get_id_by_name(name);
+  GList *si_list = NULL;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_style_item_t *style_item = malloc(sizeof(dt_style_item_t));
+
+    style_item->num = sqlite3_column_int(stmt, 0);
+    style_item->selimg_num = 0;
+    style_item->enabled = sqlite3_column_int(stmt, 4);
+    style_item->multi_priority = sqlite3_column_int(stmt, 7);
+    style_item->name = NULL;
+    style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
+    style_item->multi_name_hand_edited = sqlite3_column_int(stmt, 9);
+    // see dt_iop_get_instance_name() for why multi_name is handled this way
+    style_item->multi_name =
+      g_strdup((style_item->multi_priority > 0 || style_item->multi_name_hand_edited)
+               ? (char *)sqlite3_column_text(stmt, 8)
+               : "");
+    style_item->module_version = sqlite3_column_int(stmt, 1);
+    style_item->blendop_version = sqlite3_column_int(stmt, 6);
+    style_item->params_size = sqlite3_column_bytes(stmt, 3);
+    style_item->params = (void *)malloc(style_item->params_size);
+    memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3),
+           style_item->params_size);
+    style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
+    style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
+    memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5),
+           style_item->blendop_params_size);
+    style_item->iop_order = 0;
+
+    si_list = g_list_prepend(si_list, style_item);
+  }
+  sqlite3_finalize(stmt);
+  si_list = g_list_reverse(si_list); // list was built in reverse order, so un-reverse it
 
-  if(style_id != 0)
+  t->items = si_list;
+  return t;
+}
+
+void dt_styles_template_free(dt_style_template_t *t)
+{
+  if(!t) return;
+  g_list_free_full(t->items, dt_style_item_free);
+  g_list_free_full(t->iop_list, g_free);
+  g_free(t->name);
+  g_free(t);
+}
+
+static gint _style_item_sort_num(gconstpointer a, gconstpointer b)
+{
+  const dt_style_item_t *ia = a;
+  const dt_style_item_t *ib = b;
+  return ia->num - ib->num;
+}
+
+GList *dt_styles_get_compiled_item_list(const char *name, dt_develop_t *dev)
+{
+  g_mutex_lock(&_compiled_styles_lock);
+
+  if(!_compiled_styles)
+    _compiled_styles = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify)dt_styles_template_free);
+
+  dt_style_template_t *t = g_hash_table_lookup(_compiled_styles, name);
+  if(!t)
   {
-    dt_imgid_t newimgid = NO_IMGID;
+    t = dt_styles_template_new(name);
+    if(t) g_hash_table_insert(_compiled_styles, g_strdup(name), t);
+  }
 
-    /* check if we should make a duplicate before applying style */
-    if(duplicate)
+  GList *result = NULL;
+  if(t)
+  {
+    _styles_template_compile(t, dev);
+    for(const GList *l = t->items; l; l = g_list_next(l))
     {
-      newimgid = dt_image_duplicate(imgid);
-      if(dt_is_valid_imgid(newimgid))
-      {
-        if(overwrite)
-          dt_history_delete_on_image_ext(newimgid, FALSE, TRUE);
-        else
-          dt_history_copy_and_paste_on_image(imgid, newimgid, FALSE, NULL, TRUE, TRUE, TRUE);
-      }
+      const dt_style_item_t *item = l->data;
+      if(strcmp(item->operation, "mask_manager"))
+        result = g_list_prepend(result, _style_item_dup(item));
     }
-    else
-      newimgid = imgid;
-
-    // now deal with the history
-    GList *modules_used = NULL;
+  }
 
-    dt_develop_t _dev_dest = { 0 };
+  g_mutex_unlock(&_compiled_styles_lock);
 
-    dt_develop_t *dev_dest = &_dev_dest;
+  // same order as dt_styles_get_item_list()
+  return g_list_sort(result, _style_item_sort_num);
+}
 
-    dt_dev_init(dev_dest, FALSE);
+void dt_styles_cleanup(void)
+{
+  g_mutex_lock(&_compiled_styles_lock);
+  if(_compiled_styles) g_hash_table_destroy(_compiled_styles);
+  _compiled_styles = NULL;
+  g_mutex_unlock(&_compiled_styles_lock);
+}
 
-    dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
-    dev_dest->image_storage.id = imgid;
+static void _styles_apply_template(dt_style_template_t *t,
+                                   const gboolean duplicate,
+                                   const gboolean overwrite,
+                                   const dt_imgid_t imgid,
+                                   const gboolean undo)
+{
+  dt_imgid_t newimgid = NO_IMGID;
 
-    // now let's deal with the iop-order (possibly merging style & target lists)
-    GList *iop_list = dt_styles_module_order_list(name);
-    if(iop_list)
+  /* check if we should make a duplicate before applying style */
+  if(duplicate)
+  {
+    newimgid = dt_image_duplicate(imgid);
+    if(dt_is_valid_imgid(newimgid))
     {
-      // the style has an iop-order, we need to merge the multi-instance from target image
-      // get target image iop-order list:
-      GList *img_iop_order_list = dt_ioppr_get_iop_order_list(newimgid, FALSE);
-      // get multi-instance modules if any:
-      GList *mi = dt_ioppr_extract_multi_instances_list(img_iop_order_list);
-      // if some where found merge them with the style list
-      if(mi) iop_list = dt_ioppr_merge_multi_instance_iop_order_list(iop_list, mi);
-      // finally we have the final list for the image
-      dt_ioppr_write_iop_order_list(iop_list, newimgid);
-      g_list_free_full(iop_list, g_free);
-      g_list_free_full(img_iop_order_list, g_free);
-      g_list_free_full(mi, g_free);
+      if(overwrite)
+        dt_history_delete_on_image_ext(newimgid, FALSE, TRUE);
+      else
+        dt_history_copy_and_paste_on_image(imgid, newimgid, FALSE, NULL, TRUE, TRUE, TRUE);
     }
+  }
+  else
+    newimgid = imgid;
 
-    dt_dev_read_history_ext(dev_dest, newimgid, TRUE);
+  // now deal with the history
+  GList *modules_used = NULL;
 
-    dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image ");
+  dt_develop_t _dev_dest = { 0 };
 
-    dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
+  dt_develop_t *dev_dest = &_dev_dest;
 
-    dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 1");
+  dt_dev_init(dev_dest, FALSE);
 
-    dt_print(DT_DEBUG_IOPORDER | DT_DEBUG_PIPE,
-             "[styles_apply_to_image_ext] Apply `%s' on ID=%i, history size %i",
-             name, newimgid, dev_dest->history_end);
+  dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
+  dev_dest->image_storage.id = imgid;
 
-    // go through all entries in style
-    // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
-       "SELECT num, module, operation, op_params, enabled,"
-       "       blendop_params, blendop_version, multi_priority,"
-       "       multi_name, multi_name_hand_edited"
-       " FROM data.style_items WHERE styleid=?1 "
-       " ORDER BY operation, multi_priority",
-       -1, &stmt, NULL);
-    // clang-format on
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, style_id);
+  _styles_template_compile(t, dev_dest);
 
-    GList *si_list = NULL;
-    while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      dt_style_item_t *style_item = malloc(sizeof(dt_style_item_t));
-
-      style_item->num = sqlite3_column_int(stmt, 0);
-      style_item->selimg_num = 0;
-      style_item->enabled = sqlite3_column_int(stmt, 4);
-      style_item->multi_priority = sqlite3_column_int(stmt, 7);
-      style_item->name = NULL;
-      style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
-      style_item->multi_name_hand_edited = sqlite3_column_int(stmt, 9);
-      // see dt_iop_get_instance_name() for why multi_name is handled this way
-      style_item->multi_name =
-        g_strdup((style_item->multi_priority > 0 || style_item->multi_name_hand_edited)
-                 ? (char *)sqlite3_column_text(stmt, 8)
-                 : "");
-      style_item->module_version = sqlite3_column_int(stmt, 1);
-      style_item->blendop_version = sqlite3_column_int(stmt, 6);
-      style_item->params_size = sqlite3_column_bytes(stmt, 3);
-      style_item->params = (void *)malloc(style_item->params_size);
-      memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3),
-             style_item->params_size);
-      style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
-      style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
-      memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5),
-             style_item->blendop_params_size);
-      style_item->iop_order = 0;
-
-      si_list = g_list_prepend(si_list, style_item);
-    }
-    sqlite3_finalize(stmt);
-    si_list = g_list_reverse(si_list); // list was built in reverse order, so un-reverse it
+  // now let's deal with the iop-order (possibly merging style & target lists)
+  if(t->iop_list)
+  {
+    GList *iop_list = dt_ioppr_iop_order_copy_deep(t->iop_list);
+    // the style has an iop-order, we need to merge the multi-instance from target image
+    // get target image iop-order list:
+    GList *img_iop_order_list = dt_ioppr_get_iop_order_list(newimgid, FALSE);
+    // get multi-instance modules if any:
+    GList *mi = dt_ioppr_extract_multi_instances_list(img_iop_order_list);
+    // if some where found merge them with the style list
+    if(mi) iop_list = dt_ioppr_merge_multi_instance_iop_order_list(iop_list, mi);
+    // finally we have the final list for the image
+    dt_ioppr_write_iop_order_list(iop_list, newimgid);
+    g_list_free_full(iop_list, g_free);
+    g_list_free_full(img_iop_order_list, g_free);
+    g_list_free_full(mi, g_free);
+  }
 
-    dt_ioppr_update_for_style_items(dev_dest, si_list, FALSE);
+  dt_dev_read_history_ext(dev_dest, newimgid, TRUE);
 
-    for(GList *l = si_list; l; l = g_list_next(l))
-    {
-      dt_style_item_t *style_item = l->data;
-      dt_styles_apply_style_item(dev_dest, style_item, &modules_used, FALSE);
-    }
+  dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image ");
 
-    g_list_free_full(si_list, dt_style_item_free);
+  dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
 
-    dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 2");
+  dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 1");
 
-    dt_undo_lt_history_t *hist = NULL;
-    if(undo)
-    {
-      hist = dt_history_snapshot_item_init();
-      hist->imgid = newimgid;
-      dt_history_snapshot_undo_create
-        (hist->imgid, &hist->before, &hist->before_history_end);
-    }
+  dt_print(DT_DEBUG_IOPORDER | DT_DEBUG_PIPE,
+           "[styles_apply_to_image_ext] Apply `%s' on ID=%i, history size %i",
+           t->name, newimgid, dev_dest->history_end);
 
-    // write history and forms to db
-    dt_dev_write_history_ext(dev_dest, newimgid);
+  // the items get the multi-priority and iop-order of this image, work on a copy
+  GList *si_list = NULL;
+  for(const GList *l = t->items; l; l = g_list_next(l))
+    si_list = g_list_prepend(si_list, _style_item_dup(l->data));
+  si_list = g_list_reverse(si_list); // list was built in reverse order, so un-reverse it
 
-    if(undo)
-    {
-      dt_history_snapshot_undo_create(hist->imgid, &hist->after, &hist->after_history_end);
-      dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
-      dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)hist,
-                     dt_history_snapshot_undo_pop,
-                     dt_history_snapshot_undo_lt_history_data_free);
-      dt_undo_end_group(darktable.undo);
-    }
+  dt_ioppr_update_for_style_items(dev_dest, si_list, FALSE);
+
+  for(GList *l = si_list; l; l = g_list_next(l))
+  {
+    dt_style_item_t *style_item = l->data;
+    dt_styles_apply_style_item(dev_dest, style_item, &modules_used, FALSE);
+  }
+
+  g_list_free_full(si_list, dt_style_item_free);
+
+  dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 2");
+
+  dt_undo_lt_history_t *hist = NULL;
+  if(undo)
+  {
+    hist = dt_history_snapshot_item_init();
+    hist->imgid = newimgid;
+    dt_history_snapshot_undo_create
+      (hist->imgid, &hist->before, &hist->before_history_end);
+  }
 
-    dt_dev_cleanup(dev_dest);
+  // write history and forms to db
+  dt_dev_write_history_ext(dev_dest, newimgid);
 
-    g_list_free(modules_used);
+  if(undo)
+  {
+    dt_history_snapshot_undo_create(hist->imgid, &hist->after, &hist->after_history_end);
+    dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
+    dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)hist,
+                   dt_history_snapshot_undo_pop,
+                   dt_history_snapshot_undo_lt_history_data_free);
+    dt_undo_end_group(darktable.undo);
+  }
+
+  dt_dev_cleanup(dev_dest);
 
-    /* add tag */
-    guint tagid = 0;
+  g_list_free(modules_used);
+
+  /* add tag */
+  if(!t->tagid)
+  {
     gchar ntag[512] = { 0 };
-    gchar *local_name = dt_util_localize_segmented_name(name, FALSE);
+    gchar *local_name = dt_util_localize_segmented_name(t->name, FALSE);
     g_snprintf(ntag, sizeof(ntag), "darktable|style|%s", local_name);
     g_free(local_name);
+    if(!dt_tag_new(ntag, &t->tagid)) t->tagid = 0;
+  }
+  if(t->tagid) dt_tag_attach(t->tagid, newimgid, FALSE, FALSE);
 
-    if(dt_tag_new(ntag, &tagid)) dt_tag_attach(tagid, newimgid, FALSE, FALSE);
-    if(dt_tag_new("darktable|changed", &tagid))
-    {
-      dt_tag_attach(tagid, newimgid, FALSE, FALSE);
-      dt_image_cache_set_change_timestamp(imgid);
-    }
+  guint tagid = 0;
+  if(dt_tag_new("darktable|changed", &tagid))
+  {
+    dt_tag_attach(tagid, newimgid, FALSE, FALSE);
+    dt_image_cache_set_change_timestamp(imgid);
+  }
 
-    /* if current image in develop reload history */
-    if(dt_dev_is_current_image(darktable.develop, newimgid))
-    {
-      dt_dev_reload_history_items(darktable.develop);
-      dt_dev_modulegroups_set(darktable.develop,
-                              dt_dev_modulegroups_get(darktable.develop));
-    }
+  /* if current image in develop reload history */
+  if(dt_dev_is_current_image(darktable.develop, newimgid))
+  {
+    dt_dev_reload_history_items(darktable.develop);
+    dt_dev_modulegroups_set(darktable.develop,
+                            dt_dev_modulegroups_get(darktable.develop));
+  }
 
-    /* remove old obsolete thumbnails */
-    dt_mipmap_cache_remove(newimgid);
-    dt_image_update_final_size(newimgid);
+  /* remove old obsolete thumbnails */
+  dt_mipmap_cache_remove(newimgid);
+  dt_image_update_final_size(newimgid);
 
-    /* update the aspect ratio. recompute only if really needed for performance reasons */
-    if(darktable.collection->params.sorts[DT_COLLECTION_SORT_ASPECT_RATIO])
-      dt_image_set_aspect_ratio(newimgid, TRUE);
-    else
-      dt_image_reset_aspect_ratio(newimgid, TRUE);
+  /* update the aspect ratio. recompute only if really needed for performance reasons */
+  if(darktable.collection->params.sorts[DT_COLLECTION_SORT_ASPECT_RATIO])
+    dt_image_set_aspect_ratio(newimgid, TRUE);
+  else
+    dt_image_reset_aspect_ratio(newimgid, TRUE);
+
+  /* update xmp file */
+  dt_image_synch_xmp(newimgid);
+
+  /* redraw center view to update visible mipmaps */
+  DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, newimgid);
+}
 
-    /* update xmp file */
-    dt_image_synch_xmp(newimgid);
+void dt_styles_apply_template_to_image(dt_style_template_t *t,
+                                       const gboolean duplicate,
+                                       const gboolean overwrite,
+                                       const dt_imgid_t imgid)
+{
+  if(t) _styles_apply_template(t, duplicate, overwrite, imgid, TRUE);
+}
 
-    /* redraw center view to update visible mipmaps */
-    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, newimgid);
+static void _styles_apply_to_image_ext(const char *name,
+                                       const gboolean duplicate,
+                                       const gboolean overwrite,
+                                       const dt_imgid_t imgid,
+                                       const gboolean undo)
+{
+  dt_style_template_t *t = dt_styles_template_new(name);
+  if(t)
+  {
+    _styles_apply_template(t, duplicate, overwrite, imgid, undo);
+    dt_styles_template_free(t);
   }
 }
 
@@ -1061,6 +1276,8 @@ void dt_styles_delete_by_name_adv(const char *name, const gboolean raise, const
       dt_action_rename(old, NULL);
     }
 
+    _styles_compiled_invalidate();
+
     if(raise)
       DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_STYLE_CHANGED);
   }
@@ -1671,6 +1888,7 @@ void dt_styles_import_from_file(const char *style_path)
   dt_styles_style_data_free(style, TRUE);
   fclose(style_file);
 
+  _styles_compiled_invalidate();
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_STYLE_CHANGED);
 }
 
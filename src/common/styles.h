@@ -102,6 +102,27 @@ void dt_styles_apply_to_image(const char *name,
                               const gboolean overwrite,
                               const dt_imgid_t imgid);
 
+/** a style read once from the database, to apply it to many images */
+typedef struct dt_style_template_t dt_style_template_t;
+
+/** read the named style, NULL if it does not exist */
+dt_style_template_t *dt_styles_template_new(const char *name);
+void dt_styles_template_free(dt_style_template_t *t);
+
+/** same as dt_styles_apply_to_image() with a style read beforehand */
+void dt_styles_apply_template_to_image(dt_style_template_t *t,
+                                       const gboolean duplicate,
+                                       const gboolean overwrite,
+                                       const dt_imgid_t imgid);
+
+/** get a copy of the items of a named style as for dt_styles_get_item_list(), with
+    the params already converted to the current module versions. the style is read
+    and converted once, using the modules of dev, and kept for the session. */
+GList *dt_styles_get_compiled_item_list(const char *name, dt_develop_t *dev);
+
+/** drop the styles kept by dt_styles_get_compiled_item_list() */
+void dt_styles_cleanup(void);
+
 /** applies the style to the currently edited image in the darkroom.
     does nothing if not called with a proper dev struct initialized */
 void dt_styles_apply_to_dev(const char *name, const dt_imgid_t imgid);
@@ -789,9 +789,10 @@ uint32_t dt_tag_get_attached(const dt_imgid_t imgid,
                     : (imgnb == 0)
                       ? DT_TS_NO_IMAGE
                       : DT_TS_SOME_IMAGES;
-      *result = g_list_append(*result, t);
+      *result = g_list_prepend(*result, t);
       count++;
     }
+    *result = g_list_reverse(*result);
     sqlite3_finalize(stmt);
     g_free(query);
   }
@@ -833,9 +834,10 @@ static uint32_t _tag_get_attached_export(const dt_imgid_t imgid,
     t->leave = t->leave ? t->leave + 1 : t->tag;
     t->flags = sqlite3_column_int(stmt, 2);
     t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 3));
-    *result = g_list_append(*result, t);
+    *result = g_list_prepend(*result, t);
     count++;
   }
+  *result = g_list_reverse(*result);
   sqlite3_finalize(stmt);
 
   return count;
@@ -1297,9 +1299,10 @@ uint32_t dt_tag_get_suggestions(GList **result)
                 (imgnb == 0) ? DT_TS_NO_IMAGE : DT_TS_SOME_IMAGES;
     t->flags = sqlite3_column_int(stmt, 4);
     t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 5));
-    *result = g_list_append(*result, t);
+    *result = g_list_prepend(*result, t);
     count++;
   }
+  *result = g_list_reverse(*result);
 
   sqlite3_finalize(stmt);
 
@@ -1319,7 +1322,10 @@ void dt_tag_count_tags_images(const gchar *keyword,
   *img_count = 0;
 
   if(!keyword) return;
+  // '}' follows '|', so the descendants of keyword are the names in
+  // [keyword|, keyword}) and can be read off the tags name index
   gchar *keyword_expr = g_strdup_printf("%s|", keyword);
+  gchar *keyword_end = g_strdup_printf("%s}", keyword);
 
   /* Only select tags that are equal or child to the one we are looking for once. */
   // clang-format off
@@ -1327,15 +1333,17 @@ void dt_tag_count_tags_images(const gchar *keyword,
                               "INSERT INTO memory.similar_tags (tagid)"
                               "  SELECT id"
                               "    FROM data.tags"
-                              "    WHERE name = ?1 OR SUBSTR(name, 1, LENGTH(?2)) = ?2",
+                              "    WHERE name = ?1 OR (name >= ?2 AND name < ?3)",
                               -1, &stmt, NULL);
   // clang-format on
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, keyword, -1, SQLITE_TRANSIENT);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, keyword_expr, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, keyword_end, -1, SQLITE_TRANSIENT);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
   g_free(keyword_expr);
+  g_free(keyword_end);
 
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "SELECT COUNT(DISTINCT tagid) FROM memory.similar_tags",
@@ -1368,7 +1376,10 @@ void dt_tag_get_tags_images(const gchar *keyword,
   sqlite3_stmt *stmt;
 
   if(!keyword) return;
+  // '}' follows '|', so the descendants of keyword are the names in
+  // [keyword|, keyword}) and can be read off the tags name index
   gchar *keyword_expr = g_strdup_printf("%s|", keyword);
+  gchar *keyword_end = g_strdup_printf("%s}", keyword);
 
 /* Only select tags that are equal or child to the one we are looking for once. */
   // clang-format off
@@ -1376,15 +1387,17 @@ void dt_tag_get_tags_images(const gchar *keyword,
                               "INSERT INTO memory.similar_tags (tagid)"
                               "  SELECT id"
                               "  FROM data.tags"
-                              "  WHERE name = ?1 OR SUBSTR(name, 1, LENGTH(?2)) = ?2",
+                              "  WHERE name = ?1 OR (name >= ?2 AND name < ?3)",
                               -1, &stmt, NULL);
   // clang-format on
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, keyword, -1, SQLITE_TRANSIENT);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, keyword_expr, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, keyword_end, -1, SQLITE_TRANSIENT);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
   g_free(keyword_expr);
+  g_free(keyword_end);
 
   // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
@@ -1400,8 +1413,9 @@ void dt_tag_get_tags_images(const gchar *keyword,
     dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
     t->id = sqlite3_column_int(stmt, 0);
     t->tag = g_strdup((char *)sqlite3_column_text(stmt, 1));
-    *tag_list = g_list_append((*tag_list), t);
+    *tag_list = g_list_prepend(*tag_list, t);
   }
+  *tag_list = g_list_reverse(*tag_list);
   sqlite3_finalize(stmt);
   // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
@@ -1413,8 +1427,9 @@ void dt_tag_get_tags_images(const gchar *keyword,
   // clang-format on
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
-    *img_list = g_list_append((*img_list), GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+    *img_list = g_list_prepend(*img_list, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
   }
+  *img_list = g_list_reverse(*img_list);
   sqlite3_finalize(stmt);
 
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
@@ -1504,9 +1519,10 @@ uint32_t dt_tag_get_with_usage(GList **result)
                 (imgnb == 0) ? DT_TS_NO_IMAGE : DT_TS_SOME_IMAGES;
     t->flags = sqlite3_column_int(stmt, 4);
     t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 5));
-    *result = g_list_append(*result, t);
+    *result = g_list_prepend(*result, t);
     count++;
   }
+  *result = g_list_reverse(*result);
 
   sqlite3_finalize(stmt);
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
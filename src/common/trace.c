@@ -0,0 +1,182 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/trace.h"
+#include "common/darktable.h"
+#include "control/conf.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+// pids used for grouping the tracks in the viewer
+#define DT_TRACE_PID_CPU 1
+#define DT_TRACE_PID_OPENCL 2
+
+// a thread writes its buffered events to the file once they exceed this
+#define DT_TRACE_FLUSH_BYTES (64 * 1024)
+
+// events of one thread, appended to without locking
+typedef struct _trace_buffer_t
+{
+  GString *events;
+  int tid;
+} _trace_buffer_t;
+
+static FILE *_trace_file = NULL;
+static dt_pthread_mutex_t _trace_lock;
+static double _trace_start = 0.0;
+static int _trace_threads = 0;
+// all buffers of live threads, protected by _trace_lock
+static GList *_trace_buffers = NULL;
+
+static void _write_buffer(_trace_buffer_t *b)
+{
+  if(_trace_file && b->events->len)
+    fwrite(b->events->str, 1, b->events->len, _trace_file);
+  g_string_truncate(b->events, 0);
+}
+
+// the thread is exiting, its events go to the file now
+static void _buffer_free(gpointer data)
+{
+  _trace_buffer_t *b = data;
+  dt_pthread_mutex_lock(&_trace_lock);
+  _write_buffer(b);
+  _trace_buffers = g_list_remove(_trace_buffers, b);
+  dt_pthread_mutex_unlock(&_trace_lock);
+  g_string_free(b->events, TRUE);
+  g_free(b);
+}
+
+static GPrivate _trace_buffer_key = G_PRIVATE_INIT(_buffer_free);
+
+static _trace_buffer_t *_get_buffer(void)
+{
+  _trace_buffer_t *b = g_private_get(&_trace_buffer_key);
+  if(b) return b;
+
+  b = g_new0(_trace_buffer_t, 1);
+  b->events = g_string_sized_new(DT_TRACE_FLUSH_BYTES + 1024);
+  dt_pthread_mutex_lock(&_trace_lock);
+  b->tid = ++_trace_threads;
+  _trace_buffers = g_list_prepend(_trace_buffers, b);
+  dt_pthread_mutex_unlock(&_trace_lock);
+  g_private_set(&_trace_buffer_key, b);
+
+  g_string_append_printf(b->events, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                         "\"name\":\"thread_name\",\"args\":{\"name\":\"thread %d\"}}",
+                         DT_TRACE_PID_CPU, b->tid, b->tid);
+  return b;
+}
+
+static void _append_escaped(GString *events, const char *str)
+{
+  for(const char *c = str; c && *c; c++)
+  {
+    if(*c == '"' || *c == '\\')
+    {
+      g_string_append_c(events, '\\');
+      g_string_append_c(events, *c);
+    }
+    else if((unsigned char)*c >= 0x20)
+      g_string_append_c(events, *c);
+  }
+}
+
+void dt_trace_init(void)
+{
+  const char *filename = dt_conf_get_string_const("debug_trace_file");
+  if(!filename || !filename[0]) return;
+
+  _trace_file = g_fopen(filename, "wb");
+  if(!_trace_file)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[dt_trace_init] can't open trace file `%s'", filename);
+    return;
+  }
+  dt_pthread_mutex_init(&_trace_lock, NULL);
+  _trace_start = dt_get_wtime();
+  fprintf(_trace_file, "{\"traceEvents\":[\n"
+          "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"CPU\"}},\n"
+          "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"OpenCL\"}}",
+          DT_TRACE_PID_CPU, DT_TRACE_PID_OPENCL);
+  dt_print(DT_DEBUG_ALWAYS, "[dt_trace_init] writing trace to `%s'", filename);
+}
+
+void dt_trace_cleanup(void)
+{
+  if(!_trace_file) return;
+
+  // the buffers stay registered, threads still alive free them on exit
+  dt_pthread_mutex_lock(&_trace_lock);
+  for(GList *l = _trace_buffers; l; l = g_list_next(l))
+    _write_buffer(l->data);
+  fprintf(_trace_file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  fclose(_trace_file);
+  _trace_file = NULL;
+  dt_pthread_mutex_unlock(&_trace_lock);
+}
+
+gboolean dt_trace_enabled(void)
+{
+  return _trace_file != NULL;
+}
+
+void dt_trace_span(const char *category,
+                   const char *name,
+                   const int device,
+                   const double start,
+                   const double end,
+                   const char *detail)
+{
+  if(!_trace_file) return;
+
+  _trace_buffer_t *b = _get_buffer();
+  GString *events = b->events;
+  const gboolean cpu = device < 0;
+
+  g_string_append(events, ",\n{\"ph\":\"X\",\"cat\":\"");
+  _append_escaped(events, category);
+  g_string_append(events, "\",\"name\":\"");
+  _append_escaped(events, name);
+  g_string_append_printf(events, "\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                         cpu ? DT_TRACE_PID_CPU : DT_TRACE_PID_OPENCL,
+                         cpu ? b->tid : device,
+                         (start - _trace_start) * 1e6,
+                         MAX(0.0, end - start) * 1e6);
+  if(detail)
+  {
+    g_string_append(events, ",\"args\":{\"detail\":\"");
+    _append_escaped(events, detail);
+    g_string_append(events, "\"}");
+  }
+  g_string_append_c(events, '}');
+
+  if(events->len > DT_TRACE_FLUSH_BYTES)
+  {
+    dt_pthread_mutex_lock(&_trace_lock);
+    _write_buffer(b);
+    dt_pthread_mutex_unlock(&_trace_lock);
+  }
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,64 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+  timeline of control jobs, pixelpipe nodes, tiles, OpenCL commands,
+  image decoding and encoding, mipmap cache misses and SQLite statements
+  written as Chrome trace event JSON (viewable in Perfetto or
+  chrome://tracing). enabled by setting the conf key "debug_trace_file"
+  to a filename, e.g. via --conf debug_trace_file=/tmp/dt_trace.json
+
+  events are buffered per thread and written in chunks, so recording a
+  span takes no lock.
+*/
+
+// use the CPU thread track for dt_trace_span()
+#define DT_TRACE_CPU -1
+
+/** open the trace file if requested in the config */
+void dt_trace_init(void);
+
+/** finish and close the trace file */
+void dt_trace_cleanup(void);
+
+/** TRUE if a trace is being written */
+gboolean dt_trace_enabled(void);
+
+/** add a span with start and end in seconds as from dt_get_wtime(). It
+    goes to the calling thread's track for DT_TRACE_CPU, otherwise to the
+    track of the given OpenCL device. detail may be NULL. */
+void dt_trace_span(const char *category,
+                   const char *name,
+                   const int device,
+                   const double start,
+                   const double end,
+                   const char *detail);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -21,6 +21,7 @@
 #include "common/darktable.h"
 #include "common/image.h"
 #include "common/image_cache.h"
+#include "control/conf.h"
 #include "control/control.h"
 #include <glib.h>   // for GList, gpointer, g_list_prepend
 #include <stdlib.h> // for NULL, malloc, free
@@ -34,6 +35,7 @@ typedef struct dt_undo_item_t
   dt_undo_type_t type;
   dt_undo_data_t data;
   double ts;
+  size_t size;
   gboolean is_group;
   void (*undo)(gpointer user_data,
                dt_undo_type_t type,
@@ -49,6 +51,7 @@ dt_undo_t *dt_undo_init(void)
   udata->undo_list = NULL;
   udata->redo_list = NULL;
   udata->disable_next = FALSE;
+  udata->memory = 0;
 
   pthread_mutexattr_t recursive_locking;
   pthread_mutexattr_init(&recursive_locking);
@@ -83,10 +86,55 @@ static void _free_undo_data(void *p)
   free(item);
 }
 
+static void _undo_free_item(dt_undo_t *self, dt_undo_item_t *item)
+{
+  self->memory -= MIN(self->memory, item->size);
+  _free_undo_data(item);
+}
+
+static void _undo_free_list(dt_undo_t *self, GList *list)
+{
+  for(GList *l = list; l; l = g_list_next(l))
+    _undo_free_item(self, l->data);
+  g_list_free(list);
+}
+
+// drop the oldest undo records, a group at a time, until the sized
+// records fit into darkroom/undo/memory_limit. the newest record is always kept.
+static void _undo_trim(dt_undo_t *self)
+{
+  const size_t limit = (size_t)MAX(1, dt_conf_get_int("darkroom/undo/memory_limit")) << 20;
+  if(self->memory <= limit) return;
+
+  const size_t before = self->memory;
+  int dropped = 0;
+  GList *l = g_list_last(self->undo_list);
+  while(self->memory > limit && l && l != self->undo_list)
+  {
+    // a group is recorded between two markers, the oldest one is last
+    const gboolean is_group = ((dt_undo_item_t *)l->data)->is_group;
+    int markers = 0;
+    do
+    {
+      GList *prev = g_list_previous(l);
+      dt_undo_item_t *item = l->data;
+      if(item->is_group) markers++;
+      self->undo_list = g_list_delete_link(self->undo_list, l);
+      _undo_free_item(self, item);
+      dropped++;
+      l = prev;
+    } while(is_group && markers < 2 && l && l != self->undo_list);
+  }
+
+  dt_print(DT_DEBUG_UNDO, "[undo] dropped %d oldest records, %zu -> %zu bytes",
+           dropped, before, self->memory);
+}
+
 static void _undo_record(dt_undo_t *self,
                          gpointer user_data,
                          const dt_undo_type_t type,
                          const dt_undo_data_t data,
+                         const size_t size,
                          const gboolean is_group,
                          void (*undo)(gpointer user_data,
                                       const dt_undo_type_t type,
@@ -115,14 +163,19 @@ static void _undo_record(dt_undo_t *self,
     item->undo      = undo;
     item->free_data = free_data;
     item->ts        = dt_get_wtime();
+    item->size      = size;
     item->is_group  = is_group;
 
     self->undo_list = g_list_prepend(self->undo_list, (gpointer)item);
+    self->memory += size;
 
     // recording an undo data, invalidate all the redo
-    g_list_free_full(self->redo_list, _free_undo_data);
+    _undo_free_list(self, self->redo_list);
     self->redo_list = NULL;
 
+    // never cut into a group being recorded
+    if(self->group == DT_UNDO_NONE) _undo_trim(self);
+
     dt_print(DT_DEBUG_UNDO, "[undo] record for type %d (length %d)%s",
              type, g_list_length(self->undo_list),
              disable_next ? ", disable next": "");
@@ -142,7 +195,7 @@ void dt_undo_start_group(dt_undo_t *self,
     dt_print(DT_DEBUG_UNDO, "[undo] start group for type %d", type);
     self->group = type;
     self->group_indent = 1;
-    _undo_record(self, NULL, type, NULL, TRUE, NULL, NULL);
+    _undo_record(self, NULL, type, NULL, 0, TRUE, NULL, NULL);
   }
   else
     self->group_indent++;
@@ -157,9 +210,10 @@ void dt_undo_end_group(dt_undo_t *self)
   self->group_indent--;
   if(self->group_indent == 0)
   {
-    _undo_record(self, NULL, self->group, NULL, TRUE, NULL, NULL);
+    _undo_record(self, NULL, self->group, NULL, 0, TRUE, NULL, NULL);
     dt_print(DT_DEBUG_UNDO, "[undo] end group for type %d", self->group);
     self->group = DT_UNDO_NONE;
+    _undo_trim(self);
   }
   UNLOCK;
 }
@@ -175,7 +229,22 @@ void dt_undo_record(dt_undo_t *self,
                                  GList **imgs),
                     void (*free_data)(gpointer data))
 {
-  _undo_record(self, user_data, type, data, FALSE, undo, free_data);
+  _undo_record(self, user_data, type, data, 0, FALSE, undo, free_data);
+}
+
+void dt_undo_record_sized(dt_undo_t *self,
+                          gpointer user_data,
+                          dt_undo_type_t type,
+                          dt_undo_data_t data,
+                          const size_t size,
+                          void (*undo)(gpointer user_data,
+                                       const dt_undo_type_t type,
+                                       const dt_undo_data_t item,
+                                       const dt_undo_action_t action,
+                                       GList **imgs),
+                          void (*free_data)(gpointer data))
+{
+  _undo_record(self, user_data, type, data, size, FALSE, undo, free_data);
 }
 
 gint _images_list_cmp(gconstpointer a, gconstpointer b)
@@ -306,7 +375,7 @@ void dt_undo_do_undo(dt_undo_t *self, const uint32_t filter)
   dt_gui_cursor_clear_busy();
 }
 
-static void _undo_clear_list(GList **list, const uint32_t filter)
+static void _undo_clear_list(dt_undo_t *self, GList **list, const uint32_t filter)
 {
   // check for first item that is matching the given pattern
 
@@ -319,7 +388,7 @@ static void _undo_clear_list(GList **list, const uint32_t filter)
     {
       //  remove this element
       *list = g_list_remove(*list, item);
-      _free_undo_data((void *)item);
+      _undo_free_item(self, item);
     }
   };
 
@@ -332,10 +401,11 @@ void dt_undo_clear(dt_undo_t *self, uint32_t filter)
   if(!self) return;
 
   LOCK;
-  _undo_clear_list(&self->undo_list, filter);
-  _undo_clear_list(&self->redo_list, filter);
+  _undo_clear_list(self, &self->undo_list, filter);
+  _undo_clear_list(self, &self->redo_list, filter);
   self->undo_list = NULL;
   self->redo_list = NULL;
+  self->memory = 0;
   self->disable_next = FALSE;
   UNLOCK;
 }
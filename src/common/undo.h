@@ -61,6 +61,7 @@ typedef struct dt_undo_t
   int group_indent;
   dt_pthread_mutex_t mutex;
   gboolean disable_next;
+  size_t memory; // bytes of the sized records in both lists
 } dt_undo_t;
 
 dt_undo_t *dt_undo_init(void);
@@ -83,6 +84,21 @@ void dt_undo_record(dt_undo_t *self,
                                  GList **imgs),
                     void (*free_data)(gpointer data));
 
+// same as dt_undo_record() for data using about size bytes. when the
+// sized records exceed darkroom/undo/memory_limit the oldest undo records are
+// dropped.
+void dt_undo_record_sized(dt_undo_t *self,
+                          gpointer user_data,
+                          const dt_undo_type_t type,
+                          const dt_undo_data_t data,
+                          const size_t size,
+                          void (*undo)(gpointer user_data,
+                                       const dt_undo_type_t type,
+                                       const dt_undo_data_t item,
+                                       const dt_undo_action_t action,
+                                       GList **imgs),
+                          void (*free_data)(gpointer data));
+
 //  undo an element which correspond to filter. filter here is expected to be
 //  a set of dt_undo_type_t.
 void dt_undo_do_undo(dt_undo_t *self, const uint32_t filter);
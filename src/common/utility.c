@@ -965,50 +965,30 @@ char *dt_read_file(const char *const filename,
   return NULL;
 }
 
-void dt_copy_file(const char *const sourcefile,
-                  const char *destination)
+gboolean dt_copy_file(const char *const sourcefile,
+                      const char *destination)
 {
-  char *content = NULL;
-  FILE *fin = g_fopen(sourcefile, "rb");
-  FILE *fout = g_fopen(destination, "wb");
-
-  if(fin && fout)
+  /* g_file_copy() clones the file where the filesystem supports reflinks
+     and otherwise copies in the kernel (copy_file_range, splice) where
+     available, the data never has to pass through a buffer of ours.
+  */
+  GFile *src = g_file_new_for_path(sourcefile);
+  GFile *dest = g_file_new_for_path(destination);
+  GError *gerror = NULL;
+
+  const gboolean copied =
+    g_file_copy(src, dest, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &gerror);
+  if(!copied)
   {
-    fseek(fin, 0, SEEK_END);
-    const size_t filesize = ftell(fin);
-    rewind(fin);
-
-    content = (char *)g_try_malloc_n(filesize, sizeof(char));
-    if(content == NULL)
-    {
-      dt_print(DT_DEBUG_ALWAYS,
-               "[dt_copy_file] failure to allocate memory for copying file '%s'",
-               sourcefile);
-      goto END;
-    }
-    if(fread(content, sizeof(char), filesize, fin) != filesize)
-    {
-      dt_print(DT_DEBUG_ALWAYS,
-               "[dt_copy_file] error reading file '%s' for copying",
-               sourcefile);
-      goto END;
-    }
-    if(fwrite(content, sizeof(char), filesize, fout) != filesize)
-    {
-      dt_print(DT_DEBUG_ALWAYS,
-               "[dt_copy_file] error writing file '%s' during copying",
-               destination);
-      goto END;
-    }
+    dt_print(DT_DEBUG_ALWAYS,
+             "[dt_copy_file] error copying '%s' to '%s': %s",
+             sourcefile, destination, gerror ? gerror->message : "");
+    g_clear_error(&gerror);
   }
 
-END:
-  if(fout != NULL)
-    fclose(fout);
-  if(fin != NULL)
-    fclose(fin);
-
-  g_free(content);
+  g_object_unref(dest);
+  g_object_unref(src);
+  return copied;
 }
 
 void dt_copy_resource_file(const char *src,
@@ -135,9 +135,9 @@ gchar *dt_util_format_exposure(const float exposuretime);
 char *dt_read_file(const char *filename,
                    size_t *filesize);
 
-// copy the contents of the given file to a new file
-void dt_copy_file(const char *src,
-                  const char *dst);
+// copy the contents of the given file to a new file, returns FALSE on error
+gboolean dt_copy_file(const char *src,
+                      const char *dst);
 
 // copy the contents of a file in dt's data directory to a new file
 void dt_copy_resource_file(const char *src,
@@ -182,7 +182,8 @@ typedef struct dt_control_t
   dt_atomic_int quitting;
   dt_atomic_int pending_jobs;
   gboolean cups_started;
-  gboolean export_scheduled;
+  dt_atomic_int export_scheduled; // number of running DT_JOB_QUEUE_USER_EXPORT jobs
+  dt_atomic_int busy_workers, busy_res; // jobs running on the shared and reserved workers
   dt_pthread_mutex_t queue_mutex, cond_mutex;
   pthread_cond_t cond;
   int32_t num_threads;
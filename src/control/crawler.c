@@ -110,55 +110,219 @@ static void _set_modification_time(char *filename,
 #define FAST_UPDATE 0.2
 #define SLOW_UPDATE 1.0
 
-GList *dt_control_crawler_run(void)
+typedef struct _crawler_image_t
 {
-  sqlite3_stmt *stmt, *inner_stmt;
-  GList *result = NULL;
-  const gboolean look_for_xmp = dt_image_get_xmp_mode() != DT_WRITE_XMP_NEVER;
+  dt_imgid_t id;
+  time_t timestamp;
+  int version, flags, new_flags;
+  const char *filename;
+  gboolean missing;
+  time_t timestamp_xmp; // 0 if there is no sidecar
+} _crawler_image_t;
+
+typedef struct _crawler_folder_t
+{
+  const char *folder;
+  _crawler_image_t *images;
+  int count;
+} _crawler_folder_t;
 
-  int total_images = 1;
-  // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.images", -1, &stmt, 0);
-  // clang-format on
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+typedef struct _crawler_t
+{
+  gboolean look_for_xmp;
+  gint done;
+} _crawler_t;
+
+// the directory listing is compared against the database names, which
+// may not have the same normalization or case as on disk
+static gchar *_name_key(const char *name)
+{
+  gchar *key = g_utf8_normalize(name, -1, G_NORMALIZE_DEFAULT);
+  if(!key) return g_strdup(name);
+#if defined(_WIN32) || defined(__APPLE__)
+  gchar *folded = g_utf8_casefold(key, -1);
+  g_free(key);
+  return folded;
+#else
+  return key;
+#endif
+}
+
+static gboolean _listed(GHashTable *names, const char *name)
+{
+  gchar *key = _name_key(name);
+  const gboolean found = g_hash_table_contains(names, key);
+  g_free(key);
+  return found;
+}
+
+static gboolean _listed_extra(GHashTable *names,
+                              const char *filename,
+                              const char *lower,
+                              const char *upper)
+{
+  const char *dot = strrchr(filename, '.');
+  const int len = dot ? dot - filename : strlen(filename);
+  gchar *name = g_strdup_printf("%.*s.%s", len, filename, lower);
+  gboolean found = _listed(names, name);
+  if(!found)
+  {
+    g_free(name);
+    name = g_strdup_printf("%.*s.%s", len, filename, upper);
+    found = _listed(names, name);
+  }
+  g_free(name);
+  return found;
+}
+
+static time_t _xmp_timestamp(const char *xmp_path)
+{
+  // on Windows the encoding might not be UTF8
+  gchar *xmp_path_locale = dt_util_normalize_path(xmp_path);
+  int stat_res = -1;
+#ifdef _WIN32
+  // UTF8 paths fail in this context, but converting to UTF16 works
+  struct _stati64 statbuf;
+  if(xmp_path_locale) // in Windows dt_util_normalize_path returns
+                      // NULL if file does not exist
+  {
+    wchar_t *wfilename = g_utf8_to_utf16(xmp_path_locale, -1, NULL, NULL, NULL);
+    stat_res = _wstati64(wfilename, &statbuf);
+    g_free(wfilename);
+  }
+#else
+  struct stat statbuf;
+  stat_res = stat(xmp_path_locale, &statbuf);
+#endif
+  g_free(xmp_path_locale);
+  return stat_res ? 0 : statbuf.st_mtime; // TODO: shall we report these?
+}
+
+// one directory listing answers which of the images, sidecars and
+// extra files exist, so only the sidecars found are stat()ed
+static void _crawl_folder(gpointer data, gpointer user_data)
+{
+  _crawler_folder_t *folder = data;
+  _crawler_t *crawler = user_data;
+
+  GHashTable *names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  GDir *dir = g_dir_open(folder->folder, 0, NULL);
+  if(dir)
   {
-    total_images = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    const gchar *name;
+    while((name = g_dir_read_name(dir)))
+      g_hash_table_add(names, _name_key(name));
+    g_dir_close(dir);
   }
 
+  for(int k = 0; k < folder->count; k++)
+  {
+    _crawler_image_t *img = &folder->images[k];
+
+    // if the image is missing we ignore it.
+    img->missing = !_listed(names, img->filename);
+    if(img->missing) continue;
+
+    // no need to look for xmp files if none get written anyway.
+    if(crawler->look_for_xmp)
+    {
+      gchar xmp_name[PATH_MAX] = { 0 };
+      g_strlcpy(xmp_name, img->filename, sizeof(xmp_name));
+      dt_image_path_append_version_no_db(img->version, xmp_name, sizeof(xmp_name));
+      g_strlcat(xmp_name, ".xmp", sizeof(xmp_name));
+      if(_listed(names, xmp_name))
+      {
+        gchar *xmp_path = g_build_filename(folder->folder, xmp_name, NULL);
+        img->timestamp_xmp = _xmp_timestamp(xmp_path);
+        g_free(xmp_path);
+      }
+    }
+
+    // check if the image has associated files (.txt, .wav)
+    // TODO: decide if we want to remove the flag for images that lost
+    // their extra file. currently we do (the else cases)
+    img->new_flags = img->flags;
+    if(_listed_extra(names, img->filename, "txt", "TXT"))
+      img->new_flags |= DT_IMAGE_HAS_TXT;
+    else
+      img->new_flags &= ~DT_IMAGE_HAS_TXT;
+    if(_listed_extra(names, img->filename, "wav", "WAV"))
+      img->new_flags |= DT_IMAGE_HAS_WAV;
+    else
+      img->new_flags &= ~DT_IMAGE_HAS_WAV;
+  }
+
+  g_hash_table_destroy(names);
+  g_atomic_int_add(&crawler->done, folder->count);
+}
+
+GList *dt_control_crawler_run(void)
+{
+  sqlite3_stmt *stmt, *inner_stmt;
+  GList *result = NULL;
+  _crawler_t crawler = { .look_for_xmp = dt_image_get_xmp_mode() != DT_WRITE_XMP_NEVER,
+                         .done = 0 };
+
+  // read all images first, the folders are then crawled in parallel
   // clang-format off
   sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "SELECT i.id, write_timestamp, version,"
-                     "       folder || '" G_DIR_SEPARATOR_S "' || filename, flags"
+                     "SELECT i.id, write_timestamp, version, folder, filename, flags, f.id"
                      " FROM main.images i, main.film_rolls f"
                      " ON i.film_id = f.id"
                      " ORDER BY f.id, filename",
                      -1, &stmt, NULL);
-  sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
-                     &inner_stmt, NULL);
   // clang-format on
 
-  // let's wrap this into a transaction, it might make it a little faster.
-  dt_database_start_transaction(darktable.db);
+  GStringChunk *strings = g_string_chunk_new(4096);
+  GArray *images = g_array_new(FALSE, TRUE, sizeof(_crawler_image_t));
+  GArray *folders = g_array_new(FALSE, TRUE, sizeof(_crawler_folder_t));
+  int last_film = -1;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int film = sqlite3_column_int(stmt, 6);
+    if(film != last_film)
+    {
+      const _crawler_folder_t folder =
+        { .folder = g_string_chunk_insert(strings, (const char *)sqlite3_column_text(stmt, 3)),
+          .count = 0 };
+      g_array_append_val(folders, folder);
+      last_film = film;
+    }
+    g_array_index(folders, _crawler_folder_t, folders->len - 1).count++;
+
+    const int flags = sqlite3_column_int(stmt, 5);
+    const _crawler_image_t img =
+      { .id = sqlite3_column_int(stmt, 0),
+        .timestamp = sqlite3_column_int64(stmt, 1),
+        .version = sqlite3_column_int(stmt, 2),
+        .filename = g_string_chunk_insert(strings, (const char *)sqlite3_column_text(stmt, 4)),
+        .flags = flags,
+        .new_flags = flags };
+    g_array_append_val(images, img);
+  }
+  sqlite3_finalize(stmt);
 
-  int image_count = 0;
+  const int total_images = images->len;
   const double start_time = dt_get_wtime();
   // set the "previous update" time to 10ms after a notional previous
   // update to ensure visibility of the first update (which might not
   // appear when done with zero delay) while minimizing the delay
   double last_time = start_time - (FAST_UPDATE-0.01);
 
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  GThreadPool *pool = g_thread_pool_new(_crawl_folder, &crawler,
+                                        dt_get_num_threads(), FALSE, NULL);
+  int first = 0;
+  for(guint k = 0; k < folders->len; k++)
   {
-    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
-    const time_t timestamp = sqlite3_column_int64(stmt, 1);
-    const int version = sqlite3_column_int(stmt, 2);
-    const gchar *image_path = (char *)sqlite3_column_text(stmt, 3);
-    int flags = sqlite3_column_int(stmt, 4);
-    ++image_count;
+    _crawler_folder_t *folder = &g_array_index(folders, _crawler_folder_t, k);
+    folder->images = &g_array_index(images, _crawler_image_t, first);
+    first += folder->count;
+    g_thread_pool_push(pool, folder, NULL);
+  }
 
+  int image_count;
+  while((image_count = g_atomic_int_get(&crawler.done)) < total_images)
+  {
     // update the progress message - five times per second for first four seconds, then once per second
     const double curr_time = dt_get_wtime();
     if(curr_time >= last_time + ((curr_time - start_time > 4.0) ? SLOW_UPDATE : FAST_UPDATE))
@@ -169,132 +333,75 @@ GList *dt_control_crawler_run(void)
                                                    curr_time - start_time);
       last_time = curr_time;
     }
+    g_usleep(10000);
+  }
+  g_thread_pool_free(pool, FALSE, TRUE);
 
-    // if the image is missing we ignore it.
-    if(!g_file_test(image_path, G_FILE_TEST_EXISTS))
-    {
-      dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing", image_path, id);
-      continue;
-    }
+  // clang-format off
+  sqlite3_prepare_v2(dt_database_get(darktable.db),
+                     "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
+                     &inner_stmt, NULL);
+  // clang-format on
 
-    // no need to look for xmp files if none get written anyway.
-    if(look_for_xmp)
+  // let's wrap this into a transaction, it might make it a little faster.
+  dt_database_start_transaction(darktable.db);
+
+  for(guint k = 0; k < folders->len; k++)
+  {
+    const _crawler_folder_t *folder = &g_array_index(folders, _crawler_folder_t, k);
+    for(int n = 0; n < folder->count; n++)
     {
-      // construct the xmp filename for this image
-      gchar xmp_path[PATH_MAX] = { 0 };
-      g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
-      dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
-      size_t len = strlen(xmp_path);
-      if(len + 4 >= PATH_MAX) continue;
-      xmp_path[len++] = '.';
-      xmp_path[len++] = 'x';
-      xmp_path[len++] = 'm';
-      xmp_path[len++] = 'p';
-      xmp_path[len] = '\0';
-
-      // on Windows the encoding might not be UTF8
-      gchar *xmp_path_locale = dt_util_normalize_path(xmp_path);
-      int stat_res = -1;
-#ifdef _WIN32
-      // UTF8 paths fail in this context, but converting to UTF16 works
-      struct _stati64 statbuf;
-      if(xmp_path_locale) // in Windows dt_util_normalize_path returns
-                          // NULL if file does not exist
+      const _crawler_image_t *img = &folder->images[n];
+      gchar *image_path = g_build_filename(folder->folder, img->filename, NULL);
+
+      if(img->missing)
       {
-        wchar_t *wfilename = g_utf8_to_utf16(xmp_path_locale, -1, NULL, NULL, NULL);
-        stat_res = _wstati64(wfilename, &statbuf);
-        g_free(wfilename);
+        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing", image_path, img->id);
+        g_free(image_path);
+        continue;
       }
- #else
-      struct stat statbuf;
-      stat_res = stat(xmp_path_locale, &statbuf);
-#endif
-      g_free(xmp_path_locale);
-      if(stat_res) continue; // TODO: shall we report these?
 
-      // step 1: check if the xmp is newer than our db entry
-      if(timestamp + MAX_TIME_SKEW < statbuf.st_mtime)
+      // check if the xmp is newer than our db entry
+      if(img->timestamp_xmp && img->timestamp + MAX_TIME_SKEW < img->timestamp_xmp)
       {
+        gchar xmp_path[PATH_MAX] = { 0 };
+        g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
+        dt_image_path_append_version_no_db(img->version, xmp_path, sizeof(xmp_path));
+        g_strlcat(xmp_path, ".xmp", sizeof(xmp_path));
+
         dt_control_crawler_result_t *item = malloc(sizeof(dt_control_crawler_result_t));
-        item->id = id;
-        item->timestamp_xmp = statbuf.st_mtime;
-        item->timestamp_db = timestamp;
-        item->image_path = g_strdup(image_path);
+        item->id = img->id;
+        item->timestamp_xmp = img->timestamp_xmp;
+        item->timestamp_db = img->timestamp;
+        item->image_path = image_path;
         item->xmp_path = g_strdup(xmp_path);
+        image_path = NULL;
 
         result = g_list_prepend(result, item);
         dt_print(DT_DEBUG_CONTROL,
-                 "[crawler] `%s' (id: %d) is a newer XMP file", xmp_path, id);
+                 "[crawler] `%s' (id: %d) is a newer XMP file", xmp_path, img->id);
       }
       // older timestamps are the case for all images after the db
       // upgrade. better not report these
-    }
-
-    // step 2: check if the image has associated files (.txt, .wav)
-    size_t len = strlen(image_path);
-    const char *c = image_path + len;
-    while((c > image_path) && (*c != '.')) c--;
-    len = c - image_path + 1;
-
-    char *extra_path = calloc(len + 3 + 1, sizeof(char));
-    if(extra_path)
-    {
-      g_strlcpy(extra_path, image_path, len + 1);
-
-      extra_path[len] = 't';
-      extra_path[len + 1] = 'x';
-      extra_path[len + 2] = 't';
-      gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-
-      if(!has_txt)
-      {
-        extra_path[len] = 'T';
-        extra_path[len + 1] = 'X';
-        extra_path[len + 2] = 'T';
-        has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-      }
-
-      extra_path[len] = 'w';
-      extra_path[len + 1] = 'a';
-      extra_path[len + 2] = 'v';
-      gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
 
-      if(!has_wav)
+      if(img->flags != img->new_flags)
       {
-        extra_path[len] = 'W';
-        extra_path[len + 1] = 'A';
-        extra_path[len + 2] = 'V';
-        has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-      }
-
-      // TODO: decide if we want to remove the flag for images that lost
-      // their extra file. currently we do (the else cases)
-      int new_flags = flags;
-      if(has_txt)
-        new_flags |= DT_IMAGE_HAS_TXT;
-      else
-        new_flags &= ~DT_IMAGE_HAS_TXT;
-      if(has_wav)
-        new_flags |= DT_IMAGE_HAS_WAV;
-      else
-        new_flags &= ~DT_IMAGE_HAS_WAV;
-      if(flags != new_flags)
-      {
-        sqlite3_bind_int(inner_stmt, 1, new_flags);
-        sqlite3_bind_int(inner_stmt, 2, id);
+        sqlite3_bind_int(inner_stmt, 1, img->new_flags);
+        sqlite3_bind_int(inner_stmt, 2, img->id);
         sqlite3_step(inner_stmt);
         sqlite3_reset(inner_stmt);
         sqlite3_clear_bindings(inner_stmt);
       }
-
-      free(extra_path);
+      g_free(image_path);
     }
   }
 
   dt_database_release_transaction(darktable.db);
 
-  sqlite3_finalize(stmt);
   sqlite3_finalize(inner_stmt);
+  g_array_free(folders, TRUE);
+  g_array_free(images, TRUE);
+  g_string_chunk_free(strings);
 
   return g_list_reverse(result); // list was built in reverse order, so un-reverse it
 }
@@ -913,7 +1020,10 @@ static int _update_all_thumbs(const dt_mipmap_size_t max_mip)
   int updated = 0;
   sqlite3_stmt *stmt;
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+  // the walk over the library runs for a long time, keep it off the
+  // connection the ui writes through
+  sqlite3 *reader = dt_database_reader_acquire(darktable.db);
+  DT_DEBUG_SQLITE3_PREPARE_V2(reader,
                               "SELECT id, import_timestamp, change_timestamp"
                               " FROM main.images"
                               " WHERE thumb_timestamp < import_timestamp"
@@ -940,6 +1050,7 @@ static int _update_all_thumbs(const dt_mipmap_size_t max_mip)
     }
   }
   sqlite3_finalize(stmt);
+  dt_database_reader_release(darktable.db, reader);
 
   if(updated)
     dt_print(DT_DEBUG_CACHE,
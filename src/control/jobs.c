@@ -16,6 +16,8 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "common/trace.h"
+#include "control/conf.h"
 #include "control/jobs.h"
 #include "control/control.h"
 
@@ -54,8 +56,16 @@ typedef struct _dt_job_t
   char description[DT_CONTROL_DESCRIPTION_LEN];
   dt_view_type_flags_t view_creator;
   gboolean is_synchronous;
+
+  GList *successors; // _dt_job_successor_t, queued once this job finished
 } _dt_job_t;
 
+typedef struct _dt_job_successor_t
+{
+  dt_job_queue_t queue;
+  _dt_job_t *job;
+} _dt_job_successor_t;
+
 /** check if two jobs are to be considered equal. a simple memcmp won't work since the mutexes probably won't
    match
     we don't want to compare result, priority or state since these will change during the course of
@@ -81,6 +91,7 @@ static void _control_job_set_state(_dt_job_t *job,
                                     dt_job_state_t state)
 {
   if(!job) return;
+  GList *successors = NULL;
   dt_pthread_mutex_lock(&job->state_mutex);
   if(state >= DT_JOB_STATE_FINISHED  && job->state != DT_JOB_STATE_RUNNING && job->progress)
   {
@@ -88,9 +99,74 @@ static void _control_job_set_state(_dt_job_t *job,
     job->progress = NULL;
   }
   job->state = state;
+  if(state >= DT_JOB_STATE_FINISHED)
+  {
+    successors = job->successors;
+    job->successors = NULL;
+  }
   /* pass state change to callback */
   if(job->state_changed_cb) job->state_changed_cb(job, state);
   dt_pthread_mutex_unlock(&job->state_mutex);
+
+  // the successors only run after a job that did run to its end
+  for(GList *iter = successors; iter; iter = g_list_next(iter))
+  {
+    _dt_job_successor_t *next = iter->data;
+    if(state == DT_JOB_STATE_FINISHED && dt_control_running())
+      dt_control_add_job(next->queue, next->job);
+    else
+    {
+      _control_job_set_state(next->job, DT_JOB_STATE_DISCARDED);
+      dt_control_job_dispose(next->job);
+    }
+  }
+  g_list_free_full(successors, free);
+}
+
+void dt_control_job_add_successor(_dt_job_t *job,
+                                  const dt_job_queue_t queue,
+                                  _dt_job_t *next)
+{
+  if(!next) return;
+
+  dt_job_state_t state = DT_JOB_STATE_DISPOSED;
+  if(job)
+  {
+    dt_pthread_mutex_lock(&job->state_mutex);
+    state = job->state;
+    if(state < DT_JOB_STATE_FINISHED)
+    {
+      _dt_job_successor_t *succ = malloc(sizeof(_dt_job_successor_t));
+      succ->queue = queue;
+      succ->job = next;
+      job->successors = g_list_append(job->successors, succ);
+    }
+    dt_pthread_mutex_unlock(&job->state_mutex);
+  }
+
+  if(state == DT_JOB_STATE_FINISHED)
+    dt_control_add_job(queue, next);
+  else if(state > DT_JOB_STATE_FINISHED)
+  {
+    _control_job_set_state(next, DT_JOB_STATE_DISCARDED);
+    dt_control_job_dispose(next);
+  }
+}
+
+// a duplicate about to be discarded leaves its successors to the job
+// kept, unless that one is already done. called under the queue mutex,
+// so nothing gets queued here.
+static void _control_job_move_successors(_dt_job_t *from,
+                                         _dt_job_t *to)
+{
+  if(!from->successors) return;
+  dt_pthread_mutex_lock(&to->state_mutex);
+  if(to->state < DT_JOB_STATE_FINISHED)
+  {
+    to->successors = g_list_concat(to->successors, from->successors);
+    from->successors = NULL;
+  }
+  dt_pthread_mutex_unlock(&to->state_mutex);
 }
 
 dt_job_state_t dt_control_job_get_state(_dt_job_t *job)
@@ -196,6 +272,18 @@ static void _control_job_print(_dt_job_t *job, const char *info, const char *err
 }
 
 
+// run the job's code, with a span in the trace if one is written
+static int32_t _control_job_call(_dt_job_t *job)
+{
+  if(!dt_trace_enabled()) return job->execute(job);
+
+  const double start = dt_get_wtime();
+  const int32_t result = job->execute(job);
+  dt_trace_span("job", job->description, DT_TRACE_CPU, start, dt_get_wtime(),
+                _queuename(job->queue));
+  return result;
+}
+
 static __thread int32_t threadid = -1;
 // As threadid is `per thread` we don't have to use atomics
 static inline int32_t _control_get_threadid()
@@ -208,6 +296,20 @@ static inline int32_t _control_get_threadid_res()
   return threadid > -1 ? threadid : DT_CTL_WORKER_RESERVED;
 }
 
+// set in the threads of the shared worker pool
+static __thread gboolean shared_worker = FALSE;
+
+int dt_control_worker_threads_share(void)
+{
+  const int cores = dt_get_num_threads();
+  dt_control_t *control = darktable.control;
+  if(!shared_worker || !control) return cores;
+
+  const int busy = dt_atomic_get_int(&control->busy_workers)
+                 + dt_atomic_get_int(&control->busy_res);
+  return MAX(1, cores / MAX(1, busy));
+}
+
 void dt_control_job_cancel(_dt_job_t *job)
 {
   _control_job_set_state(job, DT_JOB_STATE_CANCELLED);
@@ -238,7 +340,9 @@ static gboolean _control_run_job_res(dt_control_t *control, int32_t res)
     _control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
     /* execute job */
-    job->result = job->execute(job);
+    dt_atomic_add_int(&control->busy_res, 1);
+    job->result = _control_job_call(job);
+    dt_atomic_sub_int(&control->busy_res, 1);
 
     _control_job_set_state(job, DT_JOB_STATE_FINISHED);
     _control_job_print(job, "run_job-", "", res);
@@ -248,6 +352,21 @@ static gboolean _control_run_job_res(dt_control_t *control, int32_t res)
   return FALSE;
 }
 
+// the first export always runs. further ones need a free slot out of
+// export/concurrent_jobs, keeping one worker for everything else, and
+// the share of the pipe memory budget they get must actually be free.
+static gboolean _control_export_slot_free(dt_control_t *control)
+{
+  const int running = dt_atomic_get_int(&control->export_scheduled);
+  if(running == 0) return TRUE;
+
+  const int max_jobs = MIN(dt_conf_get_int("export/concurrent_jobs"), control->num_threads - 1);
+  if(running >= max_jobs) return FALSE;
+
+  const size_t free_mem = dt_get_free_mem();
+  return free_mem == 0 || free_mem >= dt_get_available_mem() / (running + 1);
+}
+
 static _dt_job_t *_control_schedule_job(dt_control_t *control)
 {
   /*
@@ -270,7 +389,7 @@ static _dt_job_t *_control_schedule_job(dt_control_t *control)
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
     if(control->queues[i] == NULL) continue;
-    if(control->export_scheduled && i == DT_JOB_QUEUE_USER_EXPORT) continue;
+    if(i == DT_JOB_QUEUE_USER_EXPORT && !_control_export_slot_free(control)) continue;
     _dt_job_t *_job = (_dt_job_t *)control->queues[i]->data;
     if(_job->priority > max_priority)
     {
@@ -294,7 +413,7 @@ static _dt_job_t *_control_schedule_job(dt_control_t *control)
   GList **queue = &control->queues[winner_queue];
   *queue = g_list_delete_link(*queue, *queue);
   control->queue_length[winner_queue]--;
-  if(winner_queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = TRUE;
+  if(winner_queue == DT_JOB_QUEUE_USER_EXPORT) dt_atomic_add_int(&control->export_scheduled, 1);
 
   // and place it in scheduled job array (for job deduping)
   control->job[_control_get_threadid()] = job;
@@ -318,7 +437,7 @@ static void _control_job_execute(_dt_job_t *job)
   _control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
   /* execute job */
-  job->result = job->execute(job);
+  job->result = _control_job_call(job);
 
   _control_job_set_state(job, DT_JOB_STATE_FINISHED);
   _control_job_print(job, "run_job-", "", DT_CTL_WORKER_RESERVED + _control_get_threadid());
@@ -333,14 +452,21 @@ static gboolean _control_run_job(dt_control_t *control)
   /* change state to running */
   dt_pthread_mutex_lock(&job->wait_mutex);
   if(dt_control_job_get_state(job) == DT_JOB_STATE_QUEUED)
+  {
+    dt_atomic_add_int(&control->busy_workers, 1);
+#ifdef _OPENMP
+    omp_set_num_threads(dt_control_worker_threads_share());
+#endif
     _control_job_execute(job);
+    dt_atomic_sub_int(&control->busy_workers, 1);
+  }
 
   dt_pthread_mutex_unlock(&job->wait_mutex);
 
   // remove the job from scheduled job array (for job deduping)
   dt_pthread_mutex_lock(&control->queue_mutex);
   control->job[_control_get_threadid()] = NULL;
-  if(job->queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = FALSE;
+  if(job->queue == DT_JOB_QUEUE_USER_EXPORT) dt_atomic_sub_int(&control->export_scheduled, 1);
   dt_pthread_mutex_unlock(&control->queue_mutex);
 
   // and free it
@@ -430,9 +556,12 @@ gboolean dt_control_add_job(dt_job_queue_t queue_id, _dt_job_t *job)
       {
         _control_job_print(other_job, "add_job", "found job already in scheduled:", -1);
 
+        _control_job_move_successors(job, other_job);
         dt_pthread_mutex_unlock(&control->queue_mutex);
 
-        _control_job_set_state(job, DT_JOB_STATE_DISCARDED);
+        // successors left over follow the equal job that already finished
+        _control_job_set_state(job, job->successors ? DT_JOB_STATE_FINISHED
+                                                    : DT_JOB_STATE_DISCARDED);
         dt_control_job_dispose(job);
         dt_atomic_sub_int(&control->pending_jobs, 1);
 
@@ -447,6 +576,16 @@ gboolean dt_control_add_job(dt_job_queue_t queue_id, _dt_job_t *job)
       if(_control_job_equal(job, other_job))
       {
         _control_job_print(other_job, "add_job", "found job already in queue", -1);
+        _control_job_move_successors(job, other_job);
+
+        // only the compared part of the params is equal, the newer
+        // request carries the current state of what is beyond it
+        void *params = other_job->params;
+        dt_job_destroy_callback params_destroy = other_job->params_destroy;
+        other_job->params = job->params;
+        other_job->params_destroy = job->params_destroy;
+        job->params = params;
+        job->params_destroy = params_destroy;
 
         *queue = g_list_delete_link(*queue, iter);
         length--;
@@ -556,6 +695,7 @@ static void *_control_work(void *ptr)
   worker_thread_parameters_t *params = (worker_thread_parameters_t *)ptr;
   dt_control_t *control = params->self;
   threadid = params->threadid;
+  shared_worker = TRUE;
   char name[16] = {0};
   snprintf(name, sizeof(name), "worker %d", threadid);
   dt_pthread_setname(name);
@@ -668,6 +808,17 @@ int dt_control_jobs_pending()
     pending--;
   return pending;
 }
+
+size_t dt_control_jobs_queue_length(const dt_job_queue_t queue)
+{
+  dt_control_t *control = darktable.control;
+  if(!control || queue >= DT_JOB_QUEUE_MAX) return 0;
+
+  dt_pthread_mutex_lock(&control->queue_mutex);
+  const size_t length = control->queue_length[queue];
+  dt_pthread_mutex_unlock(&control->queue_mutex);
+  return length;
+}
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
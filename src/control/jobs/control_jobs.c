@@ -46,6 +46,7 @@
 #include "gui/gtk.h"
 #include "gui/hist_dialog.h"
 
+#include <fcntl.h>
 #include <gio/gio.h>
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -132,6 +133,9 @@ static _images_job_data_t* _dup_images_job_data_t(_images_job_data_t *data)
   return d;
 }
 
+// number of images whose history changes share one database transaction
+#define HISTORY_BATCH_SIZE 64
+
 static inline gboolean _job_cancelled(dt_job_t *job)
 {
   return dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED;
@@ -402,6 +406,9 @@ typedef struct dt_control_merge_hdr_t
 
   // 0 - ok; 1 - errors, abort
   gboolean abort;
+
+  // the brackets are exported in parallel, their accumulation is serialized
+  dt_pthread_mutex_t lock;
 } dt_control_merge_hdr_t;
 
 typedef struct dt_control_merge_hdr_format_t
@@ -445,6 +452,63 @@ static float _envelope(const float xx)
   }
 }
 
+// exposure calibration of a bracket, returns the factor scaling the raw
+// values to the scene and the about proportional photon count
+static float _control_merge_hdr_cal(const dt_image_t *image,
+                                    float *photoncnt)
+{
+  // if no valid exif data can be found, assume peleng fisheye at
+  // f/16, 8mm, with half of the light lost in the system => f/22
+  const float eap = image->exif_aperture > 0.0f ? image->exif_aperture : 22.0f;
+  const float efl = image->exif_focal_length > 0.0f ? image->exif_focal_length : 8.0f;
+  const float rad = .5f * efl / eap;
+  const float aperture = M_PI * rad * rad;
+  const float iso = image->exif_iso > 0.0f ? image->exif_iso : 100.0f;
+  const float exp = image->exif_exposure > 0.0f ? image->exif_exposure : 1.0f;
+  // about proportional to how many photons we can expect from this shot:
+  if(photoncnt) *photoncnt = 100.0f * aperture * exp / iso;
+  return 100.0f / (aperture * exp * iso);
+}
+
+static inline void _control_merge_hdr_pixel(float *const pixel,
+                                            float *const weight,
+                                            const float in,
+                                            const float w,
+                                            const float M,
+                                            const float m,
+                                            const float cal,
+                                            const float offset,
+                                            const float saturation,
+                                            const float whitelevel)
+{
+  if(M + offset >= saturation)
+  {
+    if(*weight <= 0.0f)
+    { // only consider saturated pixels in case we have nothing better:
+      if(*weight == 0 || m < -*weight)
+      {
+        if(m + offset >= saturation)
+          *pixel = 1.0f; // let's admit we were completely clipped, too
+        else
+          *pixel = in * cal / whitelevel;
+        *weight = -m; // could use -cal here, but m is per pixel and
+                      // safer for varying illumination conditions
+      }
+    }
+    // else silently ignore, others have filled in a better color here already
+  }
+  else
+  {
+    if(*weight <= 0.0)
+    { // cleanup potentially blown highlights from earlier images
+      *pixel = 0.0f;
+      *weight = 0.0f;
+    }
+    *pixel += w * in * cal;
+    *weight += w;
+  }
+}
+
 static int _control_merge_hdr_process(dt_imageio_module_data_t *datai,
                                         const char *filename,
                                         const void *const ivoid,
@@ -466,9 +530,15 @@ static int _control_merge_hdr_process(dt_imageio_module_data_t *datai,
   const dt_image_t image = *img;
   dt_image_cache_read_release(img);
 
+  dt_pthread_mutex_lock(&d->lock);
+  if(d->abort)
+  {
+    dt_pthread_mutex_unlock(&d->lock);
+    return 1;
+  }
+
   if(!d->pixels)
   {
-    d->first_imgid = imgid;
     d->first_filter = dt_rawspeed_crop_dcraw_filters(image.buf_dsc.filters, image.crop_x, image.crop_y);
     // sensor layout is just passed on to be written to dng.
     // we offset it to the crop of the image here, so we don't
@@ -509,6 +579,7 @@ static int _control_merge_hdr_process(dt_imageio_module_data_t *datai,
   {
     dt_control_log(_("unable to allocate memory for HDR merge"));
     d->abort = TRUE;
+    dt_pthread_mutex_unlock(&d->lock);
     return 1;
   }
 
@@ -518,6 +589,7 @@ static int _control_merge_hdr_process(dt_imageio_module_data_t *datai,
   {
     dt_control_log(_("exposure bracketing only works on raw images."));
     d->abort = TRUE;
+    dt_pthread_mutex_unlock(&d->lock);
     return 1;
   }
   else if(datai->width != d->wd
@@ -526,50 +598,42 @@ static int _control_merge_hdr_process(dt_imageio_module_data_t *datai,
   {
     dt_control_log(_("images have to be of same size and orientation!"));
     d->abort = TRUE;
+    dt_pthread_mutex_unlock(&d->lock);
     return 1;
   }
 
-  // if no valid exif data can be found, assume peleng fisheye at
-  // f/16, 8mm, with half of the light lost in the system => f/22
-  const float eap = image.exif_aperture > 0.0f ? image.exif_aperture : 22.0f;
-  const float efl = image.exif_focal_length > 0.0f ? image.exif_focal_length : 8.0f;
-  const float rad = .5f * efl / eap;
-  const float aperture = M_PI * rad * rad;
-  const float iso = image.exif_iso > 0.0f ? image.exif_iso : 100.0f;
-  const float exp = image.exif_exposure > 0.0f ? image.exif_exposure : 1.0f;
-  const float cal = 100.0f / (aperture * exp * iso);
-  // about proportional to how many photons we can expect from this shot:
-  const float photoncnt = 100.0f * aperture * exp / iso;
-  float saturation = 1.0f;
-  d->whitelevel = fmaxf(d->whitelevel, saturation * cal);
-  DT_OMP_FOR(collapse(2))
-  for(int y = 0; y < d->ht; y++)
-    for(int x = 0; x < d->wd; x++)
+  float photoncnt = 0.0f;
+  const float cal = _control_merge_hdr_cal(&image, &photoncnt);
+  const float saturation = 1.0f;
+  // need some safety margin due to upsampling and 16-bit quantization + dithering?
+  const float offset = 3000.0f / (float)UINT16_MAX;
+  const float *const in = (const float *)ivoid;
+  const int wd = d->wd;
+  const int ht = d->ht;
+
+  // the envelope is the same for the pixels of a 2x2 block, so work on blocks
+  DT_OMP_FOR()
+  for(int yy = 0; yy < ht; yy += 2)
+  {
+    for(int xx = 0; xx < wd; xx += 2)
     {
-      // read unclamped raw value with subtracted black and rescaled
-      // to 1.0 saturation.  this is the output of the rawprepare iop.
-      const float in = ((float *)ivoid)[x + d->wd * y];
       // weights based on siggraph 12 poster zijian zhu, zhengguo li,
       // susanto rahardja, pasi fraenti 2d denoising factor for high
       // dynamic range imaging
       float w = photoncnt;
 
-      // need some safety margin due to upsampling and 16-bit quantization + dithering?
-      float offset = 3000.0f / (float)UINT16_MAX;
-
       // cannot do an envelope based on single pixel values here, need
       // to get maximum value of all color channels. to find that, go
       // through the pattern block (we conservatively do a 3x3 for
       // bayer or xtrans):
-      int xx = x & ~1, yy = y & ~1;
       float M = 0.0f, m = FLT_MAX;
-      if(xx < d->wd - 2 && yy < d->ht - 2)
+      if(xx < wd - 2 && yy < ht - 2)
       {
-        for(int i = 0; i < 3; i++)
-          for(int j = 0; j < 3; j++)
+        for(int j = 0; j < 3; j++)
+          for(int i = 0; i < 3; i++)
           {
-            M = MAX(M, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
-            m = MIN(m, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
+            M = MAX(M, in[xx + i + (size_t)wd * (yy + j)]);
+            m = MIN(m, in[xx + i + (size_t)wd * (yy + j)]);
           }
         // move envelope a little to allow non-zero weight even for
         // clipped regions.  this is because even if the 2x2 block is
@@ -579,48 +643,89 @@ static int _control_merge_hdr_process(dt_imageio_module_data_t *datai,
         w *= d->epsw + _envelope((M + offset) / saturation);
       }
 
-      if(M + offset >= saturation)
-      {
-        if(d->weight[x + d->wd * y] <= 0.0f)
-        { // only consider saturated pixels in case we have nothing better:
-          if(d->weight[x + d->wd * y] == 0 || m < -d->weight[x + d->wd * y])
-          {
-            if(m + offset >= saturation)
-              d->pixels[x + d->wd * y] = 1.0f; // let's admit we were completely clipped, too
-            else
-              d->pixels[x + d->wd * y] = in * cal / d->whitelevel;
-            d->weight[x + d->wd * y]
-                = -m; // could use -cal here, but m is per pixel and
-                      // safer for varying illumination conditions
-          }
-        }
-        // else silently ignore, others have filled in a better color here already
-      }
-      else
-      {
-        if(d->weight[x + d->wd * y] <= 0.0)
-        { // cleanup potentially blown highlights from earlier images
-          d->pixels[x + d->wd * y] = 0.0f;
-          d->weight[x + d->wd * y] = 0.0f;
+      // read unclamped raw value with subtracted black and rescaled
+      // to 1.0 saturation.  this is the output of the rawprepare iop.
+      for(int y = yy; y < MIN(yy + 2, ht); y++)
+        for(int x = xx; x < MIN(xx + 2, wd); x++)
+        {
+          const size_t k = x + (size_t)wd * y;
+          _control_merge_hdr_pixel(d->pixels + k, d->weight + k, in[k], w, M, m,
+                                   cal, offset, saturation, d->whitelevel);
         }
-        d->pixels[x + d->wd * y] += w * in * cal;
-        d->weight[x + d->wd * y] += w;
-      }
     }
+  }
 
+  dt_pthread_mutex_unlock(&d->lock);
   return 0;
 }
 
+typedef struct _control_merge_hdr_worker_t
+{
+  dt_job_t *job;
+  dt_control_merge_hdr_t *d;
+  dt_imageio_module_format_t *format;
+  GList *next; // the bracket to export next, protected by d->lock
+  int num;
+  int done;
+  int total;
+} _control_merge_hdr_worker_t;
+
+static void *_control_merge_hdr_worker(void *data)
+{
+  _control_merge_hdr_worker_t *w = data;
+  dt_control_merge_hdr_t *d = w->d;
+
+  // the format data gets the export size, each worker needs its own
+  dt_control_merge_hdr_format_t dat =
+    (dt_control_merge_hdr_format_t){.parent = { 0 }, .d = d };
+
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&d->lock);
+    GList *t = d->abort ? NULL : w->next;
+    w->next = g_list_next(t);
+    const int num = w->num++;
+    dt_pthread_mutex_unlock(&d->lock);
+    if(!t) break;
+
+    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
+    dt_imageio_export_with_flags(imgid, "unused", w->format, (dt_imageio_module_data_t *)&dat,
+                                 TRUE, FALSE, TRUE, TRUE, FALSE, 1.0,
+                                 FALSE, "pre:rawprepare", FALSE,
+                                 FALSE, DT_COLORSPACE_NONE, NULL, DT_INTENT_LAST, NULL,
+                                 NULL, num, w->total, NULL, -1);
+
+    /* update the progress bar */
+    dt_pthread_mutex_lock(&d->lock);
+    w->done++;
+    dt_control_job_set_progress(w->job, (double)w->done / (w->total + 1));
+    dt_pthread_mutex_unlock(&d->lock);
+  }
+  return NULL;
+}
+
 static int32_t _control_merge_hdr_job_run(dt_job_t *job)
 {
   dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
   GList *t = params->index;
   const guint total = g_list_length(t);
-  double fraction = 0;
   dt_control_job_set_progress_message(job, ngettext("merging %d image",
                                                     "merging %d images", total), total);
 
   dt_control_merge_hdr_t d = (dt_control_merge_hdr_t){.epsw = 1e-8f, .abort = FALSE };
+  dt_pthread_mutex_init(&d.lock, NULL);
+  // the merged image takes the exif data of the first bracket
+  d.first_imgid = t ? GPOINTER_TO_INT(t->data) : NO_IMGID;
+
+  // the white level is known from the exif data of all brackets before
+  // merging, so the result does not depend on the order they come in
+  for(GList *l = t; l; l = g_list_next(l))
+  {
+    const dt_image_t *img = dt_image_cache_get(GPOINTER_TO_INT(l->data), 'r');
+    if(!img) continue;
+    d.whitelevel = fmaxf(d.whitelevel, _control_merge_hdr_cal(img, NULL));
+    dt_image_cache_read_release(img);
+  }
 
   dt_imageio_module_format_t buf = (dt_imageio_module_format_t)
     {.mime = _control_merge_hdr_mime,
@@ -628,30 +733,21 @@ static int32_t _control_merge_hdr_job_run(dt_job_t *job)
      .bpp = _control_merge_hdr_bpp,
      .write_image = _control_merge_hdr_process };
 
-  dt_control_merge_hdr_format_t dat =
-    (dt_control_merge_hdr_format_t){.parent = { 0 }, .d = &d };
-
-  int num = 1;
-  while(t)
-  {
-    if(d.abort) goto end;
-
-    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    dt_imageio_export_with_flags(imgid, "unused", &buf, (dt_imageio_module_data_t *)&dat,
-                                 TRUE, FALSE, TRUE, TRUE, FALSE, 1.0,
-                                 FALSE, "pre:rawprepare", FALSE,
-                                 FALSE, DT_COLORSPACE_NONE, NULL, DT_INTENT_LAST, NULL,
-                                 NULL, num, total, NULL, -1);
-
-    t = g_list_next(t);
-
-    /* update the progress bar */
-    fraction += 1.0 / (total + 1);
-    dt_control_job_set_progress(job, fraction);
-    num++;
-  }
-
-  if(d.abort) goto end;
+  // the brackets are decoded by as many pipes as concurrent exports are
+  // allowed, the accumulation into the merged buffer takes turns
+  _control_merge_hdr_worker_t w = { .job = job, .d = &d, .format = &buf,
+                                    .next = t, .num = 1, .total = total };
+  const int nworkers = CLAMP(dt_conf_get_int("export/concurrent_jobs"), 1, MAX(1, (int)total));
+  pthread_t *workers = g_new(pthread_t, nworkers);
+  int started = 0;
+  for(int k = 1; k < nworkers; k++)
+    if(!dt_pthread_create(&workers[started], _control_merge_hdr_worker, &w)) started++;
+  _control_merge_hdr_worker(&w);
+  for(int k = 0; k < started; k++)
+    dt_pthread_join(workers[k]);
+  g_free(workers);
+
+  if(d.abort || !d.pixels) goto end;
 
 // normalize by white level to make clipping at 1.0 work as expected
 
@@ -708,6 +804,7 @@ static int32_t _control_merge_hdr_job_run(dt_job_t *job)
 end:
   free(d.pixels);
   free(d.weight);
+  dt_pthread_mutex_destroy(&d.lock);
 
   return 0;
 }
@@ -1124,6 +1221,9 @@ static _dt_delete_status_t delete_file_from_disk
   GFile *gfile = g_file_new_for_path(filename);
   int send_to_trash = dt_conf_get_bool("send_to_trash");
 
+  // a file still mapped can't be deleted on Windows
+  dt_exif_release_files();
+
   while(delete_status == _DT_DELETE_STATUS_UNKNOWN)
   {
     gboolean delete_success = FALSE;
@@ -1607,10 +1707,16 @@ static int32_t _control_paste_history_job_run(dt_job_t *job)
   dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
   double prev_time = 0;
   GList *to_synch = NULL;
+  guint done = 0;
   for( ; t && !_job_cancelled(job); t = g_list_next(t))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
     if(!dt_is_valid_imgid(imgid)) continue;
+    if(done++ % HISTORY_BATCH_SIZE == 0)
+    {
+      if(done > 1) dt_database_release_transaction(darktable.db);
+      dt_database_start_transaction(darktable.db);
+    }
     // paste the copied history onto the current image, unless it's
     // the one being edited in darkroom
     if(_safe_history_job_on_imgid(job, imgid))
@@ -1628,6 +1734,7 @@ static int32_t _control_paste_history_job_run(dt_job_t *job)
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   }
+  if(done) dt_database_release_transaction(darktable.db);
   dt_undo_end_group(darktable.undo);
 
   dt_collection_update_query(darktable.collection,
@@ -1757,11 +1864,26 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
 
   const gboolean is_overwrite = style_data->overwrite;
 
+  // read the styles once for all the images
+  GList *templates = NULL;
+  for(GList *style = styles; style; style = g_list_next(style))
+  {
+    dt_style_template_t *tmpl = dt_styles_template_new((const char *)style->data);
+    if(tmpl) templates = g_list_prepend(templates, tmpl);
+  }
+  templates = g_list_reverse(templates);
+
   double prev_time = 0;
+  guint done = 0;
   for(GList *t = imgs ; t && !_job_cancelled(job); t = g_list_next(t))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
     if(!dt_is_valid_imgid(imgid)) continue;
+    if(done++ % HISTORY_BATCH_SIZE == 0)
+    {
+      if(done > 1) dt_database_release_transaction(darktable.db);
+      dt_database_start_transaction(darktable.db);
+    }
 
     dt_undo_lt_history_t *hist = NULL;
     if(is_overwrite && g_list_is_singleton(styles))
@@ -1775,9 +1897,9 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
     if(is_overwrite && !duplicate)
       dt_history_delete_on_image_ext(imgid, FALSE, TRUE);
 
-    for(GList *style = styles; style; style = g_list_next(style))
+    for(GList *tmpl = templates; tmpl; tmpl = g_list_next(tmpl))
     {
-      dt_styles_apply_to_image((const char*)style->data, duplicate, is_overwrite, imgid);
+      dt_styles_apply_template_to_image(tmpl->data, duplicate, is_overwrite, imgid);
     }
 
     if(is_overwrite && g_list_is_singleton(styles))
@@ -1790,9 +1912,11 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   }
+  if(done) dt_database_release_transaction(darktable.db);
   dt_undo_end_group(darktable.undo);
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
 
+  g_list_free_full(templates, (GDestroyNotify)dt_styles_template_free);
   g_list_free(imgs);
   g_list_free_full(styles, g_free);
   g_free(params->data);
@@ -1915,6 +2039,12 @@ static int32_t _control_export_job_run(dt_job_t *job)
     dt_control_job_set_progress_message(job, _("exporting %d / %d to %s"),
                                              num, total, mstorage->name(mstorage));
 
+    // let a worker decode the next image while this one is developed
+    // and encoded, without running jobs it would only be loaded earlier
+    if(t && dt_control_running())
+      dt_mipmap_cache_get(NULL, GPOINTER_TO_INT(t->data),
+                          DT_MIPMAP_FULL, DT_MIPMAP_PREFETCH, 'r');
+
     // check if image still exists:
     const dt_image_t *image = dt_image_cache_get(imgid, 'r');
     if(image)
@@ -2907,6 +3037,43 @@ static int _control_import_image_insitu(const char *filename,
   return filmid;
 }
 
+// files are prefetched this far ahead of the one being imported
+#define IMPORT_PREFETCH_AHEAD 32
+// number of in-situ imports sharing one database transaction
+#define IMPORT_BATCH_SIZE 64
+// part of each file the metadata readers are likely to look at
+#define IMPORT_PREFETCH_BYTES (1 << 20)
+
+static void _prefetch_file(const char *filename, const size_t bytes)
+{
+  const int fd = g_open(filename, O_RDONLY, 0);
+  if(fd < 0) return;
+#ifdef POSIX_FADV_WILLNEED
+  posix_fadvise(fd, 0, bytes, POSIX_FADV_WILLNEED);
+#else
+  char buf[64 * 1024];
+  for(size_t done = 0; done < bytes; )
+  {
+    const ssize_t n = read(fd, buf, sizeof(buf));
+    if(n <= 0) break;
+    done += n;
+  }
+#endif
+  close(fd);
+}
+
+// thread pool worker: start reading the headers of an image and its
+// sidecar while the images before it go into the database
+static void _import_prefetch(gpointer data, gpointer user_data)
+{
+  const char *filename = data;
+  _prefetch_file(filename, IMPORT_PREFETCH_BYTES);
+  gchar *xmp = g_strconcat(filename, ".xmp", NULL);
+  if(g_file_test(xmp, G_FILE_TEST_EXISTS))
+    _prefetch_file(xmp, IMPORT_PREFETCH_BYTES);
+  g_free(xmp);
+}
+
 static int _sort_filename(gchar *a, gchar *b)
 {
   return g_strcmp0(a, b);
@@ -2986,8 +3153,30 @@ static int32_t _control_import_job_run(dt_job_t *job)
   double update_interval = INIT_UPDATE_INTERVAL;
   char *prev_filename = NULL;
   char *prev_output = NULL;
-  for(GList *img = t; img && !_job_cancelled(job); img = g_list_next(img))
+
+  /* in-situ imports are staged: a thread pool reads ahead the files
+     while this thread inserts the images in batched transactions.
+     exiv2 is serialized anyway so the metadata is still parsed here.
+  */
+  GThreadPool *prefetch = !data->session && total > 1
+    ? g_thread_pool_new(_import_prefetch, NULL, dt_get_num_threads(), FALSE, NULL)
+    : NULL;
+  GList *ahead = t;
+  guint queued = 0;
+  guint done = 0;
+  gboolean in_transaction = FALSE;
+
+  for(GList *img = t; img && !_job_cancelled(job); img = g_list_next(img), done++)
   {
+    for(; prefetch && ahead && queued < done + IMPORT_PREFETCH_AHEAD; ahead = g_list_next(ahead), queued++)
+      g_thread_pool_push(prefetch, ahead->data, NULL);
+
+    if(prefetch && !in_transaction)
+    {
+      dt_database_start_transaction(darktable.db);
+      in_transaction = TRUE;
+    }
+
     if(data->session)
     {
       filmid = _control_import_image_copy((char *)img->data,
@@ -3020,6 +3209,11 @@ static int32_t _control_import_job_run(dt_job_t *job)
                                             &last_coll_update, &update_interval);
     if(filmid != -1)
       cntr++;
+    if(in_transaction && (done + 1) % IMPORT_BATCH_SIZE == 0)
+    {
+      dt_database_release_transaction(darktable.db);
+      in_transaction = FALSE;
+    }
     fraction += 1.0 / total;
     const double currtime  = dt_get_wtime();
     if(currtime - last_prog_update > PROGRESS_UPDATE_INTERVAL)
@@ -3031,6 +3225,11 @@ static int32_t _control_import_job_run(dt_job_t *job)
       g_usleep(100);
     }
   }
+  if(in_transaction)
+    dt_database_release_transaction(darktable.db);
+  // drop what is still queued, the file names are freed with the job
+  if(prefetch)
+    g_thread_pool_free(prefetch, TRUE, TRUE);
   g_free(prev_output);
 
   dt_control_log(ngettext("imported %d image", "imported %d images", cntr), cntr);
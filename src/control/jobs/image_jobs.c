@@ -1,6 +1,6 @@
 /*
     This file is part of darktable,
-    Copyright (C) 2010-2024 darktable developers.
+    Copyright (C) 2010-2025 darktable developers.
 
     darktable is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -20,16 +20,36 @@
 #include "common/darktable.h"
 #include "common/image_cache.h"
 
+#include <stddef.h>
+
 typedef struct dt_image_load_t
 {
   dt_imgid_t imgid;
   dt_mipmap_size_t mip;
+  // not compared for the de-duplication of queued loads
+  int generation; // of the prefetch, 0 for plain loads
+  int viewport;   // of the thumbnails, 0 for plain loads
 } dt_image_load_t;
 
+// bumped to drop all the prefetches still queued
+static dt_atomic_int _prefetch_generation = 1;
+
+// bumped when the thumbnails move, to drop the loads of those gone
+static dt_atomic_int _viewport_generation = 1;
+
 static int32_t _image_load_job_run(dt_job_t *job)
 {
   dt_image_load_t *params = dt_control_job_get_params(job);
 
+  if(params->generation
+     && params->generation != dt_atomic_get_int(&_prefetch_generation))
+    return 0;
+
+  // thumbnails still shown ask again, with the current viewport
+  if(params->viewport
+     && params->viewport != dt_atomic_get_int(&_viewport_generation))
+    return 0;
+
   // hook back into mipmap_cache:
   dt_mipmap_buffer_t buf;
   dt_mipmap_cache_get(&buf, params->imgid, params->mip, DT_MIPMAP_BLOCKING, 'r');
@@ -56,12 +76,41 @@ dt_job_t *dt_image_load_job_create(dt_imgid_t id, dt_mipmap_size_t mip)
     dt_control_job_dispose(job);
     return NULL;
   }
-  dt_control_job_set_params_with_size(job, params, sizeof(dt_image_load_t), free);
+  dt_control_job_set_params_with_size(job, params,
+                                      offsetof(dt_image_load_t, generation), free);
   params->imgid = id;
   params->mip = mip;
   return job;
 }
 
+dt_job_t *dt_image_prefetch_job_create(dt_imgid_t id, dt_mipmap_size_t mip)
+{
+  dt_job_t *job = dt_image_load_job_create(id, mip);
+  if(!job) return NULL;
+  dt_image_load_t *params = dt_control_job_get_params(job);
+  params->generation = dt_atomic_get_int(&_prefetch_generation);
+  return job;
+}
+
+void dt_image_prefetch_cancel(void)
+{
+  dt_atomic_add_int(&_prefetch_generation, 1);
+}
+
+dt_job_t *dt_image_thumbnail_job_create(dt_imgid_t id, dt_mipmap_size_t mip)
+{
+  dt_job_t *job = dt_image_load_job_create(id, mip);
+  if(!job) return NULL;
+  dt_image_load_t *params = dt_control_job_get_params(job);
+  params->viewport = dt_atomic_get_int(&_viewport_generation);
+  return job;
+}
+
+void dt_image_thumbnail_jobs_supersede(void)
+{
+  dt_atomic_add_int(&_viewport_generation, 1);
+}
+
 typedef struct dt_image_import_t
 {
   dt_filmid_t film_id;
@@ -24,6 +24,13 @@
 #include <inttypes.h>
 
 dt_job_t *dt_image_load_job_create(dt_imgid_t imgid, dt_mipmap_size_t mip);
+// a load that is dropped if dt_image_prefetch_cancel() is called before it runs
+dt_job_t *dt_image_prefetch_job_create(dt_imgid_t imgid, dt_mipmap_size_t mip);
+void dt_image_prefetch_cancel(void);
+// a load for a thumbnail on screen, dropped if dt_image_thumbnail_jobs_supersede()
+// is called before it runs. the thumbnails still shown then ask for it again.
+dt_job_t *dt_image_thumbnail_job_create(dt_imgid_t imgid, dt_mipmap_size_t mip);
+void dt_image_thumbnail_jobs_supersede(void);
 
 dt_job_t *dt_image_import_job_create(dt_filmid_t filmid, const char *filename);
 
@@ -45,69 +45,108 @@ static void _unlock_pending_queue()
 }
 #endif /* !_OPENMP */
 
+// an image is written once it has not been enqueued again for this
+// many seconds, so a burst of edits ends in one sidecar write
+#define SIDECAR_SYNCH_DELAY 1.0
+// how often the pending images are collected
+#define SIDECAR_FETCH_INTERVAL 0.25
+// sidecars written in a row before giving others a chance to run
+#define SIDECAR_WRITE_BATCH 8
+
+static GSList *_fetch_pending()
+{
+  GSList *new_imgs = NULL;
+#ifdef _OPENMP
+#pragma omp atomic capture
+  { new_imgs = pending_images; pending_images = NULL ; }
+#else
+  // don't have atomics, so use locks instead
+  _lock_pending_queue();
+  new_imgs = pending_images;
+  pending_images = NULL;
+  _unlock_pending_queue();
+#endif
+  return new_imgs;
+}
+
 static int32_t _control_write_sidecars_job_run(dt_job_t *job)
 {
-  GSList *imgs = NULL;
-  GHashTable *enqueued = g_hash_table_new(g_direct_hash, g_direct_equal);
+  // image id -> time at which its sidecar is due
+  GHashTable *due = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
 
   double prev_fetch = 0;
+  gboolean stopping = FALSE;
   // keep going until explicitly cancelled or darktable shuts down AND all writes have finished
-  while(imgs || (dt_control_running() && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED))
+  while(!stopping || g_hash_table_size(due))
   {
-    GSList *new_imgs = NULL;
-    double curr_fetch = dt_get_wtime();
-    // grab any pending images and add them to the list of images to be synchronized
-    if(curr_fetch > prev_fetch + 0.25)
+    if(!stopping
+       && (!dt_control_running()
+           || dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED))
+    {
+      // from now on sidecars are written by whoever enqueues them,
+      // what is queued already is written below
+      background_running = FALSE;
+      stopping = TRUE;
+    }
+
+    const double curr_fetch = dt_get_wtime();
+    // grab any pending images. Enqueuing an image again postpones its write.
+    if(stopping || curr_fetch > prev_fetch + SIDECAR_FETCH_INTERVAL)
     {
       prev_fetch = curr_fetch;
-#ifdef _OPENMP
-#pragma omp atomic capture
-      { new_imgs = pending_images; pending_images = NULL ; }
-#else
-      // don't have atomics, so use locks instead
-      _lock_pending_queue();
-      new_imgs = pending_images;
-      pending_images = NULL;
-      _unlock_pending_queue();
-#endif
-      if(new_imgs)
+      GSList *new_imgs = _fetch_pending();
+      for(GSList *imglist = new_imgs; imglist; imglist = g_slist_next(imglist))
       {
-        // add the new images to the queue being processed if they are not already on the queue
-        GSList *to_add = NULL;
-        for(GSList *imglist = new_imgs; imglist; imglist = g_slist_next(imglist))
-        {
-          if(!g_hash_table_contains(enqueued,GINT_TO_POINTER(imglist->data)))
-          {
-            to_add = g_slist_prepend(to_add, imglist->data);
-            g_hash_table_insert(enqueued, GINT_TO_POINTER(imglist->data), GINT_TO_POINTER(imglist->data));
-          }
-        }
-        imgs = g_slist_concat(imgs, to_add);
-        g_slist_free(new_imgs);
+        double *when = g_new(double, 1);
+        *when = curr_fetch + SIDECAR_SYNCH_DELAY;
+        g_hash_table_replace(due, imglist->data, when);
       }
+      g_slist_free(new_imgs);
     }
-    // synchronize the first few images on the queue
-    for(int i = 0; imgs && i < 3; i++)
-    {
-      dt_imgid_t imgid = GPOINTER_TO_INT(imgs->data);
-      dt_image_write_sidecar_file(imgid);
-      // remove the head of the image queue
-      g_hash_table_remove(enqueued, GINT_TO_POINTER(imgid));
-      imgs = g_slist_delete_link(imgs, imgs);
-    }
-    if(imgs) // do we have more images already queued?
+
+    // write the sidecars which are due, or all of them on shutdown
+    const double now = dt_get_wtime();
+    double next_due = now + 1.0;
+    GList *ready = NULL;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, due);
+    while(g_hash_table_iter_next(&iter, &key, &value))
     {
-      // give others a chance to run by sleeping 10ms; avoids apparent
-      // hangs when trying to switch views
-      g_usleep(10000);
+      const double when = *(double *)value;
+      if(stopping || when <= now)
+        ready = g_list_prepend(ready, key);
+      else
+        next_due = MIN(next_due, when);
     }
-    else
+
+    int written = 0;
+    for(GList *img = ready; img; img = g_list_next(img))
     {
-      // we currently have nothing to do, so wait 1 second before checking for more work
-      g_usleep(1000000);
+      if(written == SIDECAR_WRITE_BATCH && !stopping)
+      {
+        // leave the rest for the next round
+        next_due = now;
+        break;
+      }
+      dt_image_write_sidecar_file(GPOINTER_TO_INT(img->data));
+      g_hash_table_remove(due, img->data);
+      written++;
     }
+    g_list_free(ready);
+
+    if(stopping)
+      continue;
+
+    // give others a chance to run by sleeping at least 10ms; avoids
+    // apparent hangs when trying to switch views. With nothing due,
+    // wait until the next image is or new ones may have come in.
+    const double wait = g_hash_table_size(due)
+      ? MIN(next_due - dt_get_wtime(), SIDECAR_FETCH_INTERVAL)
+      : 1.0;
+    g_usleep(MAX(wait, 0.01) * 1e6);
   }
-  g_hash_table_destroy(enqueued);
+  g_hash_table_destroy(due);
   return 0;
 }
 
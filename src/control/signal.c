@@ -45,6 +45,7 @@ typedef struct dt_signal_description
   GType *param_types;
   GCallback destructor;
   gboolean synchronous;
+  gboolean coalesce; // a raise equal to one still pending is dropped
 } dt_signal_description;
 
 
@@ -102,9 +103,9 @@ static dt_signal_description _signal_description[DT_SIGNAL_COUNT] = {
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
 
   [DT_SIGNAL_CONTROL_REDRAW_ALL] = { "dt-control-redraw-all",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
   [DT_SIGNAL_CONTROL_REDRAW_CENTER] = { "dt-control-redraw-center",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_VIEWMANAGER_VIEW_CHANGED] = { "dt-viewmanager-view-changed",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 2, pointer_2arg, NULL, FALSE },
@@ -147,7 +148,7 @@ static dt_signal_description _signal_description[DT_SIGNAL_COUNT] = {
   [DT_SIGNAL_DEVELOP_INITIALIZE] = { "dt-develop-initialized",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
   [DT_SIGNAL_DEVELOP_MIPMAP_UPDATED] = { "dt-develop-mipmap-updated",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__UINT, 1, uint_arg, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__UINT, 1, uint_arg, NULL, FALSE, TRUE },
   [DT_SIGNAL_DEVELOP_PREVIEW_PIPE_FINISHED] = { "dt-develop-preview-pipe-finished",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
   [DT_SIGNAL_DEVELOP_PREVIEW2_PIPE_FINISHED] = { "dt-develop-preview2-pipe-finished",
@@ -189,13 +190,13 @@ static dt_signal_description _signal_description[DT_SIGNAL_COUNT] = {
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
 
   [DT_SIGNAL_CONTROL_NAVIGATION_REDRAW] = { "dt-control-navigation-redraw",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_CONTROL_LOG_REDRAW] = { "dt-control-log-redraw",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_CONTROL_TOAST_REDRAW] = { "dt-control-toast-redraw",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_CONTROL_PICKERDATA_READY] = { "dt-control-pickerdata-ready",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 2, pointer_2arg, NULL, FALSE },
@@ -253,11 +254,23 @@ typedef struct _signal_param_t
   GValue *instance_and_params;
   guint signal_id;
   guint n_params;
+  gint64 pending; // key in _pending of a coalesced raise, -1 if not
 } _signal_param_t;
 
+// the coalesced raises queued and not yet emitted, keyed by signal and uint param
+static GMutex _pending_mutex;
+static GHashTable *_pending = NULL;
+
 static gboolean _signal_raise(gpointer user_data)
 {
   _signal_param_t *params = (_signal_param_t *)user_data;
+  if(params->pending >= 0)
+  {
+    // a raise from now on queues again, it may see a newer state
+    g_mutex_lock(&_pending_mutex);
+    g_hash_table_remove(_pending, &params->pending);
+    g_mutex_unlock(&_pending_mutex);
+  }
   g_signal_emitv(params->instance_and_params, params->signal_id, 0, NULL);
   for(int i = 0; i <= params->n_params; i++) g_value_unset(&params->instance_and_params[i]);
   free(params->instance_and_params);
@@ -363,9 +376,36 @@ void dt_control_signal_raise(const dt_control_signal_t *ctlsig, dt_signal_t sign
   params->instance_and_params = instance_and_params;
   params->signal_id = g_signal_lookup(_signal_description[signal].name, _signal_type);
   params->n_params = signal_description->n_params;
+  params->pending = -1;
 
   if(!signal_description->synchronous)
   {
+    if(signal_description->coalesce)
+    {
+      // workers raise these for every thumbnail or redraw they finish,
+      // one emission per distinct signal and param is enough
+      const guint arg = signal_description->n_params ? g_value_get_uint(&instance_and_params[1]) : 0;
+      const gint64 key = ((gint64)signal << 32) | arg;
+      g_mutex_lock(&_pending_mutex);
+      if(!_pending) _pending = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+      const gboolean queued = g_hash_table_contains(_pending, &key);
+      if(!queued)
+      {
+        gint64 *pending = g_new(gint64, 1);
+        *pending = key;
+        g_hash_table_add(_pending, pending);
+      }
+      g_mutex_unlock(&_pending_mutex);
+
+      if(queued)
+      {
+        for(int i = 0; i <= params->n_params; i++) g_value_unset(&instance_and_params[i]);
+        free(instance_and_params);
+        free(params);
+        return;
+      }
+      params->pending = key;
+    }
     g_main_context_invoke_full(NULL, G_PRIORITY_HIGH_IDLE, _signal_raise, params, NULL);
   }
   else
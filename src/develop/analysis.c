@@ -0,0 +1,134 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "develop/analysis.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// results are small, a few dozen cover the modules and pipes of some images
+#define DT_DEV_ANALYSIS_ENTRIES 32
+
+typedef struct dt_dev_analysis_entry_t
+{
+  dt_hash_t hash;
+  size_t size;
+  void *data;
+} dt_dev_analysis_entry_t;
+
+static dt_pthread_mutex_t _analysis_lock;
+
+// most recently used first, protected by _analysis_lock
+static GList *_analysis_entries = NULL;
+
+static void _free_entry(gpointer data)
+{
+  dt_dev_analysis_entry_t *entry = data;
+  free(entry->data);
+  free(entry);
+}
+
+void dt_dev_analysis_init(void)
+{
+  dt_pthread_mutex_init(&_analysis_lock, NULL);
+  _analysis_entries = NULL;
+}
+
+void dt_dev_analysis_cleanup(void)
+{
+  dt_pthread_mutex_lock(&_analysis_lock);
+  g_list_free_full(_analysis_entries, _free_entry);
+  _analysis_entries = NULL;
+  dt_pthread_mutex_unlock(&_analysis_lock);
+  dt_pthread_mutex_destroy(&_analysis_lock);
+}
+
+// call with _analysis_lock held
+static GList *_find_entry(const dt_hash_t hash)
+{
+  for(GList *l = _analysis_entries; l; l = g_list_next(l))
+  {
+    const dt_dev_analysis_entry_t *entry = l->data;
+    if(entry->hash == hash) return l;
+  }
+  return NULL;
+}
+
+gboolean dt_dev_analysis_get(const dt_hash_t hash, void *data, const size_t size)
+{
+  if(hash == DT_INVALID_HASH) return FALSE;
+
+  gboolean found = FALSE;
+  dt_pthread_mutex_lock(&_analysis_lock);
+  GList *l = _find_entry(hash);
+  if(l)
+  {
+    const dt_dev_analysis_entry_t *entry = l->data;
+    if(entry->size == size)
+    {
+      memcpy(data, entry->data, size);
+      found = TRUE;
+    }
+    _analysis_entries = g_list_remove_link(_analysis_entries, l);
+    _analysis_entries = g_list_concat(l, _analysis_entries);
+  }
+  dt_pthread_mutex_unlock(&_analysis_lock);
+  return found;
+}
+
+void dt_dev_analysis_set(const dt_hash_t hash, const void *data, const size_t size)
+{
+  if(hash == DT_INVALID_HASH) return;
+
+  void *copy = malloc(size);
+  if(!copy) return;
+  memcpy(copy, data, size);
+
+  dt_pthread_mutex_lock(&_analysis_lock);
+  GList *l = _find_entry(hash);
+  if(l)
+  {
+    _free_entry(l->data);
+    _analysis_entries = g_list_delete_link(_analysis_entries, l);
+  }
+
+  dt_dev_analysis_entry_t *entry = malloc(sizeof(dt_dev_analysis_entry_t));
+  if(entry)
+  {
+    entry->hash = hash;
+    entry->size = size;
+    entry->data = copy;
+    _analysis_entries = g_list_prepend(_analysis_entries, entry);
+  }
+  else
+    free(copy);
+
+  if(g_list_length(_analysis_entries) > DT_DEV_ANALYSIS_ENTRIES)
+  {
+    GList *last = g_list_last(_analysis_entries);
+    _free_entry(last->data);
+    _analysis_entries = g_list_delete_link(_analysis_entries, last);
+  }
+  dt_pthread_mutex_unlock(&_analysis_lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,53 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+G_BEGIN_DECLS
+
+/*
+  small cache for statistics computed from the input of a module, like
+  the illuminant detected by color calibration. entries are keyed by a
+  hash that should start from dt_dev_pixelpipe_piece_hash() of the
+  analyzed input and include everything else the result depends on, so
+  gui helpers and all pipes, headless ones included, share a result as
+  long as the input doesn't change. the least recently used entries are
+  dropped first.
+*/
+
+/** set up the cache, called once at startup */
+void dt_dev_analysis_init(void);
+
+/** free all entries */
+void dt_dev_analysis_cleanup(void);
+
+/** copy the stored result of hash into data, FALSE if there is none of that size */
+gboolean dt_dev_analysis_get(const dt_hash_t hash, void *data, const size_t size);
+
+/** store a result for hash, replacing an older one */
+void dt_dev_analysis_set(const dt_hash_t hash, const void *data, const size_t size);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
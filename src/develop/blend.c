@@ -528,6 +528,56 @@ void dt_develop_blend_process(dt_iop_module_t *self,
   // get the clipped opacity value  0 - 1
   const float opacity = CLIP(d->opacity / 100.0f);
 
+  // a parametric mask that is neither combined with drawn shapes nor refined, post-processed,
+  // displayed or kept as raster mask is only needed row by row, generate and apply it in one pass
+  const gboolean with_drawn = mode_drawn && !(self->flags() & IOP_FLAGS_NO_MASKS);
+  if(!uniform && !raster && !with_drawn
+     && post_operations_size == 0
+     && feqf(d->details, 0.0f, 1e-6f)
+     && request_mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE
+     && !dt_iop_piece_is_raster_mask_used(piece, BLEND_RASTER_ID))
+  {
+    const float fill = (d->mask_combine & DEVELOP_COMBINE_INCL) ? 0.0f : 1.0f;
+    gboolean done = FALSE;
+    switch(blend_csp)
+    {
+      case DEVELOP_BLEND_CS_LAB:
+        done = dt_develop_blendif_lab_make_mask_and_blend(piece, (const float *const restrict)ivoid,
+                                                          (float *const restrict)ovoid,
+                                                          roi_in, roi_out, fill);
+        break;
+      case DEVELOP_BLEND_CS_RGB_DISPLAY:
+        done = dt_develop_blendif_rgb_hsl_make_mask_and_blend(piece, (const float *const restrict)ivoid,
+                                                              (float *const restrict)ovoid,
+                                                              roi_in, roi_out, fill);
+        break;
+      case DEVELOP_BLEND_CS_RGB_SCENE:
+        done = dt_develop_blendif_rgb_jzczhz_make_mask_and_blend(piece, (const float *const restrict)ivoid,
+                                                                 (float *const restrict)ovoid,
+                                                                 roi_in, roi_out, fill);
+        break;
+      case DEVELOP_BLEND_CS_RAW:
+        done = dt_develop_blendif_raw_make_mask_and_blend(piece, (const float *const restrict)ivoid,
+                                                          (float *const restrict)ovoid,
+                                                          roi_in, roi_out, fill);
+        break;
+      default:
+        break;
+    }
+
+    if(done)
+    {
+      dt_print_pipe(DT_DEBUG_PIPE,
+         "blend fused",
+         piece->pipe, self, DT_DEVICE_CPU, roi_in, roi_out, "%s, %s%s",
+         dt_iop_colorspace_to_name(cst),
+         _develop_blend_colorspace_to_str(blend_csp),
+         rois_equal ? "" : ", roi differ");
+      dt_iop_piece_clear_raster(piece, NULL);
+      return;
+    }
+  }
+
   // allocate space for blend mask used by roi_out
   float *const restrict _mask = dt_alloc_align_float(obuffsize);
   if(!_mask)
@@ -795,6 +845,7 @@ static void _refine_with_detail_mask_cl(dt_iop_module_t *self,
        "no detail data available", piece->pipe, self, devid, roi_in, roi_out);
     return;
   }
+  dt_dev_wait_scharr_mask(p);
   const int iwidth  = p->scharr.roi.width;
   const int iheight = p->scharr.roi.height;
 
@@ -1096,18 +1147,31 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
   {
     const gboolean inverted = (d->mask_combine & DEVELOP_COMBINE_MASKS_POS);
     gboolean form_ok = FALSE;
+    // the drawn mask is rendered straight into dev_mask_2 unless the
+    // detail refinement needs it on the host
+    gboolean form_on_device = FALSE;
     // get the drawn mask if there is one
     dt_masks_form_t *form = dt_masks_get_from_id_ext(piece->pipe->forms, d->mask_id);
 
     // we blend with a drawn and/or parametric mask
     if(form && mode_drawn && !(self->flags() & IOP_FLAGS_NO_MASKS))
     {
-      form_ok = dt_masks_group_render_roi(self, piece, form, roi_out, mask);
-
-      if(inverted)
+      if(feqf(d->details, 0.0f, 1e-6f))
       {
-        // if we have a mask and this flag is set -> invert the mask
-        dt_iop_image_invert(mask, 1.0f, owidth, oheight, 1); //mask[k] = 1.0f - mask[k]
+        err = dt_masks_group_render_roi_cl(self, piece, form, roi_out, devid,
+                                           dev_mask_2, inverted, &form_ok);
+        if(err != CL_SUCCESS) goto error;
+        form_on_device = TRUE;
+      }
+      else
+      {
+        form_ok = dt_masks_group_render_roi(self, piece, form, roi_out, mask);
+
+        if(inverted)
+        {
+          // if we have a mask and this flag is set -> invert the mask
+          dt_iop_image_invert(mask, 1.0f, owidth, oheight, 1); //mask[k] = 1.0f - mask[k]
+        }
       }
     }
     else if(mode_parametric && !(self->flags() & IOP_FLAGS_NO_MASKS))
@@ -1132,10 +1196,13 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
        inverted ? ", inverted" : "",
        rois_equal ? "" : ", roi differ");
 
-    _refine_with_detail_mask_cl(self, piece, mask, roi_in, roi_out, d->details, devid);
+    if(!form_on_device)
+    {
+      _refine_with_detail_mask_cl(self, piece, mask, roi_in, roi_out, d->details, devid);
 
-    err = dt_opencl_write_host_to_device(devid, mask, dev_mask_2, owidth, oheight, sizeof(float));
-    if(err != CL_SUCCESS) goto error;
+      err = dt_opencl_write_host_to_device(devid, mask, dev_mask_2, owidth, oheight, sizeof(float));
+      if(err != CL_SUCCESS) goto error;
+    }
 
     // The following call to clFinish() works around a bug in some OpenCL
     // drivers (namely AMD).
@@ -459,6 +459,38 @@ void dt_develop_blendif_rgb_jzczhz_make_mask(dt_dev_pixelpipe_iop_t *piece,
                                              const dt_iop_roi_t *const roi_out,
                                              float *const mask);
 
+/** fused mask generation and blending for parametric masks without drawn shapes, mask refinement or
+ *  mask display; mask_fill is the value the drawn mask would have been filled with. Returns FALSE if
+ *  the per-thread buffers could not be allocated, the caller then needs to use the two-pass path.
+ */
+gboolean dt_develop_blendif_raw_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                    const float *const a,
+                                                    float *const b,
+                                                    const dt_iop_roi_t *const roi_in,
+                                                    const dt_iop_roi_t *const roi_out,
+                                                    const float mask_fill);
+
+gboolean dt_develop_blendif_lab_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                    const float *const a,
+                                                    float *const b,
+                                                    const dt_iop_roi_t *const roi_in,
+                                                    const dt_iop_roi_t *const roi_out,
+                                                    const float mask_fill);
+
+gboolean dt_develop_blendif_rgb_hsl_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                        const float *const a,
+                                                        float *const b,
+                                                        const dt_iop_roi_t *const roi_in,
+                                                        const dt_iop_roi_t *const roi_out,
+                                                        const float mask_fill);
+
+gboolean dt_develop_blendif_rgb_jzczhz_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                           const float *const a,
+                                                           float *const b,
+                                                           const dt_iop_roi_t *const roi_in,
+                                                           const dt_iop_roi_t *const roi_out,
+                                                           const float mask_fill);
+
 /** color blending operators */
 
 void dt_develop_blendif_raw_blend(dt_dev_pixelpipe_iop_t *piece,
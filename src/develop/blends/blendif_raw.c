@@ -446,6 +446,60 @@ void dt_develop_blendif_raw_blend(dt_dev_pixelpipe_iop_t *piece,
   }
 }
 
+gboolean dt_develop_blendif_raw_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                    const float *const restrict a,
+                                                    float *const restrict b,
+                                                    const dt_iop_roi_t *const roi_in,
+                                                    const dt_iop_roi_t *const roi_out,
+                                                    const float mask_fill)
+{
+  const dt_develop_blend_params_t *const d = piece->blendop_data;
+
+  if(piece->colors != 1) return TRUE;
+
+  const int xoffs = roi_out->x - roi_in->x;
+  const int yoffs = roi_out->y - roi_in->y;
+  const int iwidth = roi_in->width;
+  const int owidth = roi_out->width;
+  const int oheight = roi_out->height;
+
+  // without a drawn mask the raw mask is the same for all pixels
+  const float global_opacity = fminf(fmaxf(0.0f, (d->opacity / 100.0f)), 1.0f);
+  const float opacity = global_opacity * ((d->mask_combine & DEVELOP_COMBINE_INV) ? 1.0f - mask_fill : mask_fill);
+
+  _blend_row_func *const blend = _choose_blend_func(d->blend_mode);
+  const gboolean reverse = (d->blend_mode & DEVELOP_BLEND_REVERSE) == DEVELOP_BLEND_REVERSE;
+
+  // one row of mask and one row of copied output per thread
+  const size_t row_size = dt_round_size(owidth, 16);
+  size_t padded_size;
+  float *const restrict rows = dt_alloc_perthread_float(2 * row_size, &padded_size);
+  if(!rows) return FALSE;
+
+  DT_OMP_FOR()
+  for(size_t y = 0; y < oheight; y++)
+  {
+    float *const restrict mask = dt_get_perthread(rows, padded_size);
+    float *const restrict tmp = mask + row_size;
+    const size_t a_start = (y + yoffs) * iwidth + xoffs;
+    const size_t b_start = y * owidth;
+
+    for(size_t x = 0; x < owidth; x++)
+    {
+      mask[x] = opacity;
+      tmp[x] = b[b_start + x];
+    }
+
+    if(reverse)
+      blend(tmp, a + a_start, b + b_start, mask, owidth);
+    else
+      blend(a + a_start, tmp, b + b_start, mask, owidth);
+  }
+
+  dt_free_align(rows);
+  return TRUE;
+}
+
 // tools/update_modelines.sh
 // remove-trailing-space on;
 // clang-format off
@@ -229,6 +229,57 @@ static void _blendif_combine_channels(const float *const restrict pixels,
   }
 }
 
+// compute one row of the parametric mask on top of the drawn mask and apply the global opacity
+static inline void _blendif_make_mask_row(const float *const restrict a,
+                                          const float *const restrict b,
+                                          float *const restrict mask,
+                                          float *const restrict temp_mask,
+                                          const size_t stride,
+                                          const unsigned int blendif,
+                                          const float *const restrict parameters,
+                                          const dt_iop_order_iccprofile_info_t *const restrict profile,
+                                          const unsigned int mask_inclusive,
+                                          const unsigned int mask_inversed,
+                                          const float global_opacity)
+{
+  // initialize the parametric mask
+  DT_OMP_SIMD(aligned(temp_mask:64))
+  for(size_t x = 0; x < stride; x++) temp_mask[x] = 1.0f;
+
+  // combine channels
+  _blendif_combine_channels(a, temp_mask, stride, blendif, parameters, profile);
+  _blendif_combine_channels(b, temp_mask, stride, blendif >> DEVELOP_BLENDIF_GRAY_out,
+                            parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out, profile);
+
+  // apply global opacity
+  if(mask_inclusive)
+  {
+    if(mask_inversed)
+    {
+      DT_OMP_SIMD(aligned(temp_mask:64))
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - mask[x]) * temp_mask[x];
+    }
+    else
+    {
+      DT_OMP_SIMD(aligned(temp_mask:64))
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - (1.0f - mask[x]) * temp_mask[x]);
+    }
+  }
+  else
+  {
+    if(mask_inversed)
+    {
+      DT_OMP_SIMD(aligned(temp_mask:64))
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - mask[x] * temp_mask[x]);
+    }
+    else
+    {
+      DT_OMP_SIMD(aligned(temp_mask:64))
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * mask[x] * temp_mask[x];
+    }
+  }
+}
+
 void dt_develop_blendif_rgb_hsl_make_mask(dt_dev_pixelpipe_iop_t *piece,
                                           const float *const restrict a,
                                           const float *const restrict b,
@@ -296,72 +347,35 @@ void dt_develop_blendif_rgb_hsl_make_mask(dt_dev_pixelpipe_iop_t *piece,
                                                                     DEVELOP_BLEND_CS_RGB_DISPLAY);
     const dt_iop_order_iccprofile_info_t *profile = use_profile ? &blend_profile : NULL;
 
-    // allocate space for a temporary mask buffer to split the computation of every channel
-    float *const restrict temp_mask = dt_alloc_align_float(buffsize);
-    if(!temp_mask)
+    // allocate one row of temporary mask per thread to split the computation of every channel
+    size_t padded_width;
+    float *const restrict temp_rows = dt_alloc_perthread_float(owidth, &padded_width);
+    if(!temp_rows)
     {
       return;
     }
 
     DT_OMP_PRAGMA(parallel default(none)
-                  dt_omp_firstprivate(temp_mask, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs, buffsize,
+                  dt_omp_firstprivate(temp_rows, padded_width, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs,
                                       blendif, profile, parameters, mask_inclusive, mask_inversed, global_opacity))
     {
       // flush denormals to zero to avoid performance penalty if there are a lot of zero values in the mask
       const int oldMode = dt_mm_enable_flush_zero();
+      float *const restrict temp_mask = dt_get_perthread(temp_rows, padded_width);
 
-      // initialize the parametric mask
-      DT_OMP_PRAGMA(for simd schedule(static) aligned(temp_mask:64))
-      for(size_t x = 0; x < buffsize; x++) temp_mask[x] = 1.0f;
-
-      // combine channels
-      DT_OMP_PRAGMA(for schedule(static))
-      for(size_t y = 0; y < oheight; y++)
-      {
-        const size_t start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(a + start, temp_mask + (y * owidth), owidth, blendif, parameters, profile);
-      }
       DT_OMP_PRAGMA(for schedule(static))
       for(size_t y = 0; y < oheight; y++)
       {
-        const size_t start = (y * owidth) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(b + start, temp_mask + (y * owidth), owidth, blendif >> DEVELOP_BLENDIF_GRAY_out,
-                                  parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out,
-                                  profile);
-      }
-
-      // apply global opacity
-      if(mask_inclusive)
-      {
-        if(mask_inversed)
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x]) * temp_mask[x];
-        }
-        else
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - (1.0f - mask[x]) * temp_mask[x]);
-        }
-      }
-      else
-      {
-        if(mask_inversed)
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x] * temp_mask[x]);
-        }
-        else
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * mask[x] * temp_mask[x];
-        }
+        const size_t a_start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
+        const size_t b_start = (y * owidth) * DT_BLENDIF_RGB_CH;
+        _blendif_make_mask_row(a + a_start, b + b_start, mask + y * owidth, temp_mask, owidth, blendif,
+                               parameters, profile, mask_inclusive, mask_inversed, global_opacity);
       }
 
       dt_mm_restore_flush_zero(oldMode);
     }
 
-    dt_free_align(temp_mask);
+    dt_free_align(temp_rows);
   }
 }
 
@@ -1359,6 +1373,97 @@ void dt_develop_blendif_rgb_hsl_blend(dt_dev_pixelpipe_iop_t *piece,
   }
 }
 
+gboolean dt_develop_blendif_rgb_hsl_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                        const float *const restrict a,
+                                                        float *const restrict b,
+                                                        const dt_iop_roi_t *const roi_in,
+                                                        const dt_iop_roi_t *const roi_out,
+                                                        const float mask_fill)
+{
+  const dt_develop_blend_params_t *const d = piece->blendop_data;
+
+  if(piece->colors != DT_BLENDIF_RGB_CH) return TRUE;
+
+  const int xoffs = roi_out->x - roi_in->x;
+  const int yoffs = roi_out->y - roi_in->y;
+  const int iwidth = roi_in->width;
+  const int owidth = roi_out->width;
+  const int oheight = roi_out->height;
+
+  const unsigned int any_channel_active = d->blendif & DEVELOP_BLENDIF_RGB_MASK;
+  const unsigned int mask_inclusive = d->mask_combine & DEVELOP_COMBINE_INCL;
+  const unsigned int mask_inversed = d->mask_combine & DEVELOP_COMBINE_INV;
+  const unsigned int blendif = d->blendif ^ (mask_inclusive ? DEVELOP_BLENDIF_RGB_MASK << 16 : 0);
+  const unsigned int canceling_channel = (blendif >> 16) & ~blendif & DEVELOP_BLENDIF_RGB_MASK;
+  const float global_opacity = clamp_simd(d->opacity / 100.0f);
+
+  // same cases as in make_mask, the mask is uniform unless all conditional channels need to be processed
+  gboolean conditional = FALSE;
+  float uniform_opacity = global_opacity * (mask_inversed ? 1.0f - mask_fill : mask_fill);
+  dt_iop_order_iccprofile_info_t blend_profile;
+  gboolean use_profile = FALSE;
+  if(!(d->mask_mode & DEVELOP_MASK_CONDITIONAL) || (!canceling_channel && !any_channel_active))
+  {
+    // mask is not conditional
+  }
+  else if(canceling_channel || !any_channel_active)
+  {
+    uniform_opacity = ((mask_inversed == 0) ^ (mask_inclusive == 0)) ? global_opacity : 0.0f;
+  }
+  else
+  {
+    use_profile = dt_develop_blendif_init_masking_profile(piece, &blend_profile, DEVELOP_BLEND_CS_RGB_DISPLAY);
+    conditional = TRUE;
+  }
+
+  float parameters[DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
+  if(conditional) dt_develop_blendif_process_parameters(parameters, d);
+  const dt_iop_order_iccprofile_info_t *const profile = use_profile ? &blend_profile : NULL;
+
+  _blend_row_func *const blend = _choose_blend_func(d->blend_mode);
+  const gboolean reverse = (d->blend_mode & DEVELOP_BLEND_REVERSE) == DEVELOP_BLEND_REVERSE;
+  const gboolean copy_mask = piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK;
+
+  // one row of mask and one row of temporary mask per thread
+  const size_t row_size = dt_round_size(owidth, 16);
+  size_t padded_size;
+  float *const restrict mask_rows = dt_alloc_perthread_float(2 * row_size, &padded_size);
+  if(!mask_rows) return FALSE;
+
+  DT_OMP_FOR()
+  for(size_t y = 0; y < oheight; y++)
+  {
+    float *const restrict mask = dt_get_perthread(mask_rows, padded_size);
+    float *const restrict temp_mask = mask + row_size;
+    const size_t a_start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
+    const size_t b_start = y * owidth * DT_BLENDIF_RGB_CH;
+
+    if(conditional)
+    {
+      // flush denormals to zero to avoid performance penalty if there are a lot of zero values in the mask
+      const int oldMode = dt_mm_enable_flush_zero();
+      for(size_t x = 0; x < owidth; x++) mask[x] = mask_fill;
+      _blendif_make_mask_row(a + a_start, b + b_start, mask, temp_mask, owidth, blendif, parameters, profile,
+                             mask_inclusive, mask_inversed, global_opacity);
+      dt_mm_restore_flush_zero(oldMode);
+    }
+    else
+    {
+      for(size_t x = 0; x < owidth; x++) mask[x] = uniform_opacity;
+    }
+
+    if(reverse)
+      blend(b + b_start, a + a_start, b + b_start, mask, owidth);
+    else
+      blend(a + a_start, b + b_start, b + b_start, mask, owidth);
+
+    if(copy_mask) _copy_mask(a + a_start, b + b_start, owidth * DT_BLENDIF_RGB_CH);
+  }
+
+  dt_free_align(mask_rows);
+  return TRUE;
+}
+
 // tools/update_modelines.sh
 // remove-trailing-space on;
 // clang-format off
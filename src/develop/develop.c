@@ -51,6 +51,8 @@
 #endif
 
 #define DT_DEV_AVERAGE_DELAY_COUNT 5
+// scale divisor of the coarse pass of progressive darkroom rendering
+#define DT_DEV_COARSE_FACTOR 4
 
 void dt_dev_init(dt_develop_t *dev,
                  const gboolean gui_attached)
@@ -283,6 +285,20 @@ static void _dev_average_delay_update(const dt_times_t *start,
                      - *average_delay / DT_DEV_AVERAGE_DELAY_COUNT);
 }
 
+// signalled when the darkroom's full pipe got valid or a new image is
+// to be prerendered, see _dev_prerender_job_run()
+static GMutex _prerender_lock;
+static GCond _prerender_cond;
+static uint32_t _prerender_wakeups;
+
+static void _dev_prerender_wakeup(void)
+{
+  g_mutex_lock(&_prerender_lock);
+  _prerender_wakeups++;
+  g_cond_broadcast(&_prerender_cond);
+  g_mutex_unlock(&_prerender_lock);
+}
+
 void dt_dev_process_image_job(dt_develop_t *dev,
                               dt_dev_viewport_t *port,
                               dt_dev_pixelpipe_t *pipe,
@@ -396,6 +412,11 @@ restart:
   const gboolean changing = (pipe->changed != DT_DEV_PIPE_UNCHANGED) || initial;
   const gboolean port_loading = port && pipe->loading;
   const gboolean require_zoom_test = (pipe->changed & ~DT_DEV_PIPE_ZOOMED) || initial;
+  // a pure pan or zoom might be handled by updating the exposed region only
+  const gboolean only_moved = port && !port_loading && !require_zoom_test
+                              && pipe->changed == DT_DEV_PIPE_ZOOMED;
+  const gboolean params_changed = !port_loading
+    && (pipe->changed & (DT_DEV_PIPE_TOP_CHANGED | DT_DEV_PIPE_REMOVE | DT_DEV_PIPE_SYNCH));
   initial = FALSE; // don't enforce dt_dev_pixelpipe_change() for restarts
 
   /* dt_dev_pixelpipe_change()
@@ -442,11 +463,37 @@ restart:
   const int x = port ? CLAMP(pipe_width  * (.5 + zoom_x) - wd / 2, 0, pipe_width  - wd) : 0;
   const int y = port ? CLAMP(pipe_height * (.5 + zoom_y) - ht / 2, 0, pipe_height - ht) : 0;
 
+  // a slow full pipe first renders at a reduced scale after parameter changes,
+  // a newer change stops the refinement below like any other run
+  const int progressive_ms = dt_conf_get_int("darkroom/ui/progressive_ms");
+  if(port == &dev->full
+     && params_changed
+     && progressive_ms > 0
+     && pipe->average_delay > progressive_ms
+     && wd >= 64 * DT_DEV_COARSE_FACTOR
+     && ht >= 64 * DT_DEV_COARSE_FACTOR)
+  {
+    pipe->coarse = TRUE;
+    const gboolean coarse_problem =
+      dt_dev_pixelpipe_process(pipe, dev,
+                               x / DT_DEV_COARSE_FACTOR, y / DT_DEV_COARSE_FACTOR,
+                               wd / DT_DEV_COARSE_FACTOR, ht / DT_DEV_COARSE_FACTOR,
+                               scale / DT_DEV_COARSE_FACTOR, devid);
+    dt_print_pipe(DT_DEBUG_PIPE, "coarse pass", pipe, NULL, devid, NULL, NULL,
+                  "%s", coarse_problem ? "problem" : "success");
+    if(!coarse_problem && port->widget)
+      dt_control_queue_redraw_widget(port->widget);
+  }
+
   dt_get_times(&start);
 
   // keep error status of dt_dev_pixelpipe_process() for easy log code && check
   // for safe dt_control_queue_redraw_widget
-  const gboolean problem = dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale, devid);
+  const gboolean problem =
+    (only_moved && !dt_dev_pixelpipe_process_moved(pipe, dev, x, y, wd, ht, scale, devid))
+    ? FALSE
+    : dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale, devid);
+  pipe->coarse = FALSE;
   const dt_dev_pixelpipe_stopper_t shutdown = dt_atomic_get_int(&pipe->shutdown);
   if(problem || shutdown)
     dt_print(DT_DEBUG_PIPE, "dt_dev_pixelpipe_process %dx%d x=%d y=%d %s%s",
@@ -504,6 +551,9 @@ restart:
   dt_control_busy_leave();
   dt_pthread_mutex_unlock(&pipe->mutex);
 
+  if(darktable.develop && pipe == darktable.develop->full.pipe)
+    _dev_prerender_wakeup();
+
   const gboolean signalling = dev->gui_attached && !dev->gui_leaving && signal != -1;
 
   if(port) // reminder: only the preview pipe is called without a port
@@ -657,6 +707,81 @@ void dt_dev_load_image(dt_develop_t *dev,
   dt_unlock_image(imgid);
 }
 
+void dt_dev_switch_image(dt_develop_t *dev,
+                         const dt_imgid_t imgid)
+{
+  if(!dev->iop)
+  {
+    dt_dev_load_image(dev, imgid);
+    return;
+  }
+
+  dt_lock_image(imgid);
+
+  while(dev->history)
+  {
+    dt_dev_free_history_item(((dt_dev_history_item_t *)dev->history->data));
+    dev->history = g_list_delete_link(dev->history, dev->history);
+  }
+
+  _dt_dev_load_raw(dev, imgid);
+
+  dt_pthread_mutex_lock(&darktable.dev_threadsafe);
+
+  // same as when changing image in darkroom: the base instance of
+  // each module is kept with the new image defaults, all others are
+  // dropped and the history read below will create them again.
+  for(GList *modules = g_list_last(dev->iop); modules; )
+  {
+    dt_iop_module_t *module = modules->data;
+    GList *prev = g_list_previous(modules);
+
+    int base_multi_priority = 0;
+    for(const GList *l = dev->iop; l; l = g_list_next(l))
+    {
+      const dt_iop_module_t *mod = l->data;
+      if(dt_iop_module_is(module->so, mod->op))
+        base_multi_priority = MIN(base_multi_priority, mod->multi_priority);
+    }
+
+    if(module->multi_priority == base_multi_priority)
+    {
+      module->iop_order =
+        dt_ioppr_get_iop_order(dev->iop_order_list, module->op, module->multi_priority);
+      module->multi_priority = 0;
+      module->multi_name[0] = '\0';
+      dt_iop_reload_defaults(module);
+    }
+    else
+    {
+      dev->iop = g_list_delete_link(dev->iop, modules);
+      dt_iop_cleanup_module(module);
+      free(module);
+    }
+    modules = prev;
+  }
+  dev->iop = g_list_sort(dev->iop, dt_sort_iop_by_order);
+
+  while(dev->alliop)
+  {
+    dt_iop_cleanup_module((dt_iop_module_t *)dev->alliop->data);
+    free(dev->alliop->data);
+    dev->alliop = g_list_delete_link(dev->alliop, dev->alliop);
+  }
+  g_list_free_full(dev->forms, (void (*)(void *))dt_masks_free_form);
+  dev->forms = NULL;
+  g_list_free_full(dev->allforms, (void (*)(void *))dt_masks_free_form);
+  dev->allforms = NULL;
+
+  dev->first_load = TRUE;
+  dt_dev_read_history_ext(dev, dev->image_storage.id, FALSE);
+  dev->first_load = FALSE;
+
+  dt_pthread_mutex_unlock(&darktable.dev_threadsafe);
+
+  dt_unlock_image(imgid);
+}
+
 void dt_dev_configure(dt_dev_viewport_t *port)
 {
   int32_t tb = 0;
@@ -1244,6 +1369,7 @@ void dt_dev_pop_history_items_ext(dt_develop_t *dev, const int32_t cnt)
   dev->history_end = cnt;
 
   // reset gui params for all modules
+  GHashTable *order_index = dt_ioppr_iop_order_index_new(dev->iop_order_list);
   for(GList *modules = dev->iop; modules; modules = g_list_next(modules))
   {
     dt_iop_module_t *module = modules->data;
@@ -1253,19 +1379,39 @@ void dt_dev_pop_history_items_ext(dt_develop_t *dev, const int32_t cnt)
 
     if(module->multi_priority == 0)
       module->iop_order =
-        dt_ioppr_get_iop_order(dev->iop_order_list, module->op, module->multi_priority);
+        dt_ioppr_get_iop_order_indexed(order_index, module->op, module->multi_priority);
     else
     {
       module->iop_order = INT_MAX;
     }
   }
+  g_hash_table_destroy(order_index);
+
+  // only the last item of each module up to cnt decides its state. find
+  // them first so params and blend params (which scan all modules for
+  // raster masks) are committed once per module, not once per item.
+  GHashTable *last_items = g_hash_table_new(NULL, NULL);
+  GList *history = dev->history;
+  for(int i = 0; i < cnt && history; i++)
+  {
+    dt_dev_history_item_t *hist = history->data;
+    g_hash_table_insert(last_items, hist->module, hist);
+    history = g_list_next(history);
+  }
 
   // go through history and set gui params
   GList *forms = NULL;
-  GList *history = dev->history;
+  history = dev->history;
   for(int i = 0; i < cnt && history; i++)
   {
     dt_dev_history_item_t *hist = history->data;
+    if(hist->forms) forms = hist->forms;
+    if(g_hash_table_lookup(last_items, hist->module) != hist)
+    {
+      history = g_list_next(history);
+      continue;
+    }
+
     if(hist->module->params_size == 0)
       memcpy(hist->module->params, hist->module->default_params, hist->module->params_size);
     else
@@ -1275,11 +1421,11 @@ void dt_dev_pop_history_items_ext(dt_develop_t *dev, const int32_t cnt)
     hist->module->iop_order = hist->iop_order;
     hist->module->enabled = hist->enabled;
     g_strlcpy(hist->module->multi_name, hist->multi_name, sizeof(hist->module->multi_name));
-    if(hist->forms) forms = hist->forms;
     hist->module->multi_name_hand_edited = hist->multi_name_hand_edited;
 
     history = g_list_next(history);
   }
+  g_hash_table_destroy(last_items);
 
   dt_ioppr_resync_modules_order(dev);
 
@@ -1561,6 +1707,8 @@ static gboolean _dev_auto_apply_presets(dt_develop_t *dev)
     return FALSE;
   }
 
+  dt_iop_init_presets_lazy();
+
   //  get current workflow and image characteristics
 
   const gboolean is_scene_referred = dt_is_scene_referred();
@@ -1862,7 +2010,7 @@ static void _dev_merge_history(dt_develop_t *dev,
       // for the preset/default iops that will be *prepended* into the
       // history.
       DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                  "UPDATE main.history SET num=num+?1 WHERE imgid=?2",
+                                  "UPDATE main.history_items SET num=num+?1 WHERE imgid=?2",
                                   -1, &stmt, NULL);
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, cnt);
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
@@ -2057,6 +2205,12 @@ void dt_dev_read_history_ext(dt_develop_t *dev,
   dt_iop_module_t *channelmixerrgb = NULL;
   dt_iop_module_t *temperature = NULL;
 
+  // the order list does not change while reading, look the rows up in an
+  // index and collect the items in reverse, long histories would be
+  // quadratic otherwise
+  GHashTable *order_index = dt_ioppr_iop_order_index_new(dev->iop_order_list);
+  GList *read_history = NULL;
+
   // Strip rows from DB lookup. One row == One module in history
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -2090,7 +2244,7 @@ void dt_dev_read_history_ext(dt_develop_t *dev,
     }
 
     const int iop_order =
-      dt_ioppr_get_iop_order(dev->iop_order_list, module_name, multi_priority);
+      dt_ioppr_get_iop_order_indexed(order_index, module_name, multi_priority);
     if(iop_order == INT_MAX)
     {
       dt_print(DT_DEBUG_PIPE | DT_DEBUG_UNDO,
@@ -2303,10 +2457,13 @@ void dt_dev_read_history_ext(dt_develop_t *dev,
     if(hist->module->default_enabled && hist->module->hide_enable_button)
       hist->enabled = TRUE;
 
-    dev->history = g_list_append(dev->history, hist);
+    read_history = g_list_prepend(read_history, hist);
     dev->history_end++;
   }
   sqlite3_finalize(stmt);
+  g_hash_table_destroy(order_index);
+
+  dev->history = g_list_concat(dev->history, g_list_reverse(read_history));
 
   // Both modules are actives and found on the history stack, let's
   // again reload the defaults to ensure the whiteblance is properly
@@ -3562,6 +3719,83 @@ void dt_dev_image(const dt_imgid_t imgid,
   dt_dev_cleanup(&dev);
 }
 
+// the image the latest prerender request was made for
+static dt_atomic_int _prerender_imgid;
+
+static int32_t _dev_prerender_job_run(dt_job_t *job)
+{
+  const dt_imgid_t imgid = GPOINTER_TO_INT(dt_control_job_get_params(job));
+  dt_develop_t *ddev = darktable.develop;
+
+  // let the darkroom finish the shown image first, for at most 10s. The
+  // status is written under the pipe mutex, which is held while it runs.
+  dt_dev_pixelpipe_t *full = ddev->full.pipe;
+  const gint64 end = g_get_monotonic_time() + 10 * G_TIME_SPAN_SECOND;
+  gboolean timeout = FALSE;
+  while(!timeout && dt_atomic_get_int(&_prerender_imgid) == imgid)
+  {
+    g_mutex_lock(&_prerender_lock);
+    const uint32_t wakeups = _prerender_wakeups;
+    g_mutex_unlock(&_prerender_lock);
+
+    dt_pthread_mutex_lock(&full->mutex);
+    const gboolean valid = full->status == DT_DEV_PIXELPIPE_VALID;
+    dt_pthread_mutex_unlock(&full->mutex);
+    if(valid) break;
+
+    g_mutex_lock(&_prerender_lock);
+    while(!timeout && wakeups == _prerender_wakeups)
+      timeout = !g_cond_wait_until(&_prerender_cond, &_prerender_lock, end);
+    g_mutex_unlock(&_prerender_lock);
+  }
+
+  // a newer request, left darkroom or not enough memory for a second image
+  const size_t freemem = dt_get_free_mem();
+  if(dt_atomic_get_int(&_prerender_imgid) != imgid
+     || dt_view_get_current() != DT_VIEW_DARKROOM
+     || ddev->image_storage.id == imgid
+     || (freemem && freemem < dt_get_available_mem()))
+    return 0;
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  /* a cached full pipe in the darkroom viewport. Its own cache is gone after this
+     but the full mipmap and, if enabled, the shared pipe cache lines up to colorin
+     are warm when the image is opened.
+  */
+  dt_develop_t dev;
+  dt_dev_init(&dev, TRUE);
+  dev.gui_attached = FALSE;
+  dt_dev_pixelpipe_t *pipe = dev.full.pipe;
+  dt_dev_load_image(&dev, imgid);
+
+  dev.full = ddev->full;
+  dev.full.pipe = pipe;
+  dev.full.widget = NULL;
+
+  dt_dev_process_image_job(&dev, &dev.full, pipe, -1, DT_DEVICE_NONE);
+  dt_dev_cleanup(&dev);
+
+  dt_show_times_f(&start, "[dev_prerender_image]", "image %i", imgid);
+  return 0;
+}
+
+void dt_dev_prerender_image(const dt_imgid_t imgid)
+{
+  if(!dt_is_valid_imgid(imgid)
+     || !dt_conf_get_bool("darkroom/ui/prerender_next")
+     || (dt_get_available_mem() / DT_MEGA) <= 3000lu)
+    return;
+
+  dt_atomic_set_int(&_prerender_imgid, imgid);
+  _dev_prerender_wakeup();
+  dt_job_t *job = dt_control_job_create(&_dev_prerender_job_run, "prerender image %i", imgid);
+  if(!job) return;
+  dt_control_job_set_params(job, GINT_TO_POINTER(imgid), NULL);
+  dt_control_add_job(DT_JOB_QUEUE_SYSTEM_BG, job);
+}
+
 gboolean dt_dev_equal_chroma(const float *f, const double *d)
 {
   return feqf(f[0], (float)d[0], 0.00001f)
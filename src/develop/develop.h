@@ -372,6 +372,12 @@ void dt_dev_load_image(dt_develop_t *dev,
                        const dt_imgid_t imgid);
 void dt_dev_reload_image(dt_develop_t *dev,
                          const dt_imgid_t imgid);
+/** load another image into a develop without gui, keeping the
+    instantiated base modules and only resetting them to the new image
+    defaults before its history is read. falls back to
+    dt_dev_load_image() if no image was loaded yet. */
+void dt_dev_switch_image(dt_develop_t *dev,
+                         const dt_imgid_t imgid);
 /** checks if provided imgid is the image currently in develop */
 gboolean dt_dev_is_current_image(const dt_develop_t *dev,
                                  const dt_imgid_t imgid);
@@ -620,6 +626,12 @@ void dt_dev_image(const dt_imgid_t imgid,
                   const int devid,
                   const gboolean finalscale);
 
+/*
+ * load and process an image in the background like the darkroom would, so the
+ * mipmap and shared pipe caches are warm when it is opened next.
+ * a later call supersedes pending ones.
+ */
+void dt_dev_prerender_image(const dt_imgid_t imgid);
 
 gboolean dt_dev_equal_chroma(const float *f, const double *d);
 void dt_dev_reset_chroma(dt_develop_t *dev);
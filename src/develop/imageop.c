@@ -342,11 +342,43 @@ int dt_iop_load_module_so(void *m, const char *libname, const char *module_name)
                module_name);
   }
 
-  if(module->init_global)
-    module->init_global(module);
+  // without gui, see _iop_init_global_lazy()
+  if(darktable.gui)
+  {
+    if(module->init_global)
+      module->init_global(module);
+    module->init_state = 2;
+  }
   return 0;
 }
 
+// a headless export only runs a few modules. every develop instantiates
+// all of them, so without gui the global data (mostly OpenCL kernels)
+// is set up the first time an instance of the module is committed
+// enabled into a pipe, see dt_iop_commit_params(), or for modules with
+// IOP_FLAGS_GLOBAL_DEFAULTS when its defaults are reloaded.
+static void _iop_init_global_lazy(dt_iop_module_t *module)
+{
+  dt_iop_module_so_t *so = module->so;
+  if(g_atomic_int_get(&so->init_state) != 2)
+  {
+    dt_pthread_mutex_lock(&darktable.iop_init_threadsafe);
+    if(g_atomic_int_get(&so->init_state) == 0)
+    {
+      g_atomic_int_set(&so->init_state, 1);
+      dt_times_t start;
+      dt_get_perf_times(&start);
+      if(so->init_global)
+        so->init_global(so);
+      dt_show_times_f(&start, "[iop_init_lazy]", "global data of `%s'", so->op);
+      g_atomic_int_set(&so->init_state, 2);
+    }
+    dt_pthread_mutex_unlock(&darktable.iop_init_threadsafe);
+  }
+  // instances created before init_global() still point to NULL
+  module->global_data = so->data;
+}
+
 gboolean dt_iop_load_module_by_so(dt_iop_module_t *module,
                                   dt_iop_module_so_t *so,
                                   dt_develop_t *dev)
@@ -1299,6 +1331,8 @@ void dt_iop_reload_defaults(dt_iop_module_t *module)
     // repeatedly here)
     if(module->dev)
     {
+      if(module->flags() & IOP_FLAGS_GLOBAL_DEFAULTS)
+        _iop_init_global_lazy(module);
       module->reload_defaults(module);
       dt_print(DT_DEBUG_PARAMS,
                "[dt_iop_reload_defaults] defaults reloaded for %s", module->op);
@@ -1605,6 +1639,30 @@ static void _init_presets(dt_iop_module_so_t *module_so)
   sqlite3_finalize(stmt);
 }
 
+// built-in presets: 0 pending, 1 running, 2 done. without gui they are
+// only created once a develop auto-applies presets to a new image.
+static gint _presets_state = 0;
+
+void dt_iop_init_presets_lazy(void)
+{
+  if(g_atomic_int_get(&_presets_state) == 2) return;
+
+  // recursive: _init_presets() instantiates modules to upgrade
+  // legacy presets.
+  dt_pthread_mutex_lock(&darktable.iop_init_threadsafe);
+  if(g_atomic_int_get(&_presets_state) == 0)
+  {
+    g_atomic_int_set(&_presets_state, 1);
+    dt_times_t start;
+    dt_get_perf_times(&start);
+    for(GList *iop = darktable.iop; iop; iop = g_list_next(iop))
+      _init_presets(iop->data);
+    dt_show_times(&start, "[iop_init_lazy] presets of all modules");
+    g_atomic_int_set(&_presets_state, 2);
+  }
+  dt_pthread_mutex_unlock(&darktable.iop_init_threadsafe);
+}
+
 static void _iop_preferences_changed(gpointer instance, gpointer self)
 {
   // reload presets if they are based on the actual workflow which
@@ -1616,7 +1674,7 @@ static void _iop_preferences_changed(gpointer instance, gpointer self)
   {
     dt_iop_module_so_t *mod = iop->data;
 
-    if(mod->pref_based_presets)
+    if(mod->pref_based_presets && g_atomic_int_get(&_presets_state) == 2)
     {
       sqlite3_stmt *stmt;
       // first delete auto built-in presets for this module
@@ -1661,6 +1719,9 @@ static void _init_module_so(void *m)
 {
   dt_iop_module_so_t *module = (dt_iop_module_so_t *)m;
 
+  // without gui presets are created by dt_iop_init_presets_lazy()
+  if(!darktable.gui) return;
+
   _init_presets(module);
 
   // do not init accelerators if there is no gui
@@ -1741,6 +1802,9 @@ void dt_iop_load_modules_so(void)
     ("/plugins", sizeof(dt_iop_module_so_t),
      dt_iop_load_module_so, _init_module_so, NULL);
 
+  if(darktable.gui)
+    g_atomic_int_set(&_presets_state, 2);
+
   DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_PREFERENCES_CHANGE,
                             _iop_preferences_changed, darktable.iop);
 
@@ -1837,7 +1901,7 @@ void dt_iop_unload_modules_so()
   while(darktable.iop)
   {
     dt_iop_module_so_t *module = darktable.iop->data;
-    if(module->cleanup_global)
+    if(module->cleanup_global && module->init_state == 2)
       module->cleanup_global(module);
     if(module->module)
       g_module_close(module->module);
@@ -2169,6 +2233,9 @@ void dt_iop_commit_params(dt_iop_module_t *module,
     }
   }
 
+  if(piece->enabled)
+    _iop_init_global_lazy(module);
+
   module->commit_params(module, params, pipe, piece);
 
   dt_hash_t phash = DT_INVALID_HASH;
@@ -3593,6 +3660,7 @@ void dt_iop_piece_set_raster(dt_dev_pixelpipe_iop_t *piece,
   // Note: technically we don't need the roi_in here at all; provided as we later want more work to be done here
   // possibly changing a rastermask to something else
   const gboolean new = g_hash_table_replace(piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID), mask);
+  dt_dev_clear_distorted_raster_masks(piece->pipe, piece);
 
   // If we place a raster mask we must invalidate the following cachelines
   if(!new)
@@ -3606,6 +3674,7 @@ void dt_iop_piece_set_raster(dt_dev_pixelpipe_iop_t *piece,
 
 void dt_iop_piece_clear_raster(dt_dev_pixelpipe_iop_t *piece, float *mask)
 {
+  dt_dev_clear_distorted_raster_masks(piece->pipe, piece);
   if(g_hash_table_remove(piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID)))
   {
     dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MASKS,
@@ -104,7 +104,10 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_CROP_EXPOSER = 1 << 16,      // offers crop exposing
   IOP_FLAGS_EXPAND_ROI_IN = 1 << 17,     // we might have to take special care about roi expansion
   IOP_FLAGS_WRITE_DETAILS = 1 << 18,     // provides the scharr mask used by details
-  IOP_FLAGS_WRITE_RASTER = 1 << 19       // modules not supporting blending might still advertise a raster mask
+  IOP_FLAGS_WRITE_RASTER = 1 << 19,      // modules not supporting blending might still advertise a raster mask
+  IOP_FLAGS_POINTWISE = 1 << 20,         // process() only maps pixels to pixels at the same place, so cheaply it can run on row strips
+  IOP_FLAGS_HALF_FLOAT = 1 << 21,        // process_cl() only accesses its images via read_imagef/write_imagef, so they may hold half floats
+  IOP_FLAGS_GLOBAL_DEFAULTS = 1 << 22    // reload_defaults() needs the global data, without gui it is set up before
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -135,6 +138,21 @@ enum
   DT_ACTION_ELEMENT_INSTANCE = 5,
 };
 
+/** the processing from the raw mosaic up to demosaic as one per-pixel
+    transform, composed by the raw_pointwise() of the modules on the way:
+    out = MIN(clip[c], mul[c] * (in - sub[p]) / div[p]) with p the position
+    in the 2x2 block and c the CFA color. */
+typedef struct dt_iop_raw_pointwise_t
+{
+  gboolean prepared;        // set by the module normalizing the raw data
+  gboolean uint16;          // raw input stored as uint16, else float
+  int crop_x, crop_y;       // position of the mosaic in the raw input
+  float sub[4];
+  float div[4];
+  dt_aligned_pixel_t mul;
+  dt_aligned_pixel_t clip;
+} dt_iop_raw_pointwise_t;
+
 /** part of the module which only contains the cached dlopen stuff. */
 typedef struct dt_iop_module_so_t
 {
@@ -163,6 +181,9 @@ typedef struct dt_iop_module_so_t
   gboolean have_introspection;
   // contains preset which are depending on preference (workflow)
   gboolean pref_based_presets;
+  // init_global(): 0 pending, 1 running, 2 done. without gui it is
+  // deferred until an instance is first committed enabled.
+  gint init_state;
 } dt_iop_module_so_t;
 
 typedef struct dt_iop_module_t
@@ -308,6 +329,8 @@ typedef struct dt_action_target_t
 
 /** loads and inits the modules in the plugins/ directory. */
 void dt_iop_load_modules_so(void);
+/** without gui, creates the built-in presets of all modules on first call. */
+void dt_iop_init_presets_lazy(void);
 /** cleans up the dlopen refs. */
 void dt_iop_unload_modules_so(void);
 /** load a module for a given .so */
@@ -264,6 +264,16 @@ typedef struct dt_masks_functions_t
                       struct dt_masks_form_t *const form,
                       const dt_iop_roi_t *roi,
                       float *buffer);
+#ifdef HAVE_OPENCL
+  // optional, draws the shape on the device into a zeroed float buffer
+  cl_int (*get_mask_roi_cl)(const dt_iop_module_t *const fmodule,
+                            const dt_dev_pixelpipe_iop_t *const piece,
+                            struct dt_masks_form_t *const form,
+                            const dt_iop_roi_t *roi,
+                            const int devid,
+                            cl_mem buffer,
+                            gboolean *ok);
+#endif
   int (*get_area)(const dt_iop_module_t *const module,
                   const dt_dev_pixelpipe_iop_t *const piece,
                   struct dt_masks_form_t *const form,
@@ -508,6 +518,55 @@ int dt_masks_group_render_roi(dt_iop_module_t *module,
                               const dt_iop_roi_t *roi,
                               float *buffer);
 
+#ifdef HAVE_OPENCL
+typedef struct dt_masks_cl_global_t
+{
+  int kernel_masks_fill;
+  int kernel_masks_brush_falloff;
+  int kernel_masks_path_edges;
+  int kernel_masks_path_fill;
+  int kernel_masks_path_falloff;
+  int kernel_masks_combine;
+  int kernel_masks_output;
+} dt_masks_cl_global_t;
+
+dt_masks_cl_global_t *dt_masks_init_cl_global(void);
+void dt_masks_free_cl_global(dt_masks_cl_global_t *g);
+
+/** draw the group into the float image dev_mask, inverted if asked.
+ * shapes with get_mask_roi_cl() are drawn by the device, the others are
+ * rendered on the cpu and uploaded. form_ok is set like the result of
+ * dt_masks_group_render_roi() */
+cl_int dt_masks_group_render_roi_cl(dt_iop_module_t *module,
+                                    dt_dev_pixelpipe_iop_t *piece,
+                                    dt_masks_form_t *form,
+                                    const dt_iop_roi_t *roi,
+                                    const int devid,
+                                    cl_mem dev_mask,
+                                    const gboolean inverted,
+                                    gboolean *form_ok);
+#endif
+
+/** cache of the rendered shapes of groups, shared by all pipes. a form
+ * changed in a group only invalidates its own raster */
+void dt_masks_raster_cache_init(void);
+void dt_masks_raster_cache_cleanup(void);
+/** hash of everything the raster of a single (non group) form depends
+ * on, DT_INVALID_HASH if it can't be cached */
+dt_hash_t dt_masks_raster_hash(const dt_dev_pixelpipe_iop_t *piece,
+                               dt_masks_form_t *form,
+                               const dt_iop_roi_t *roi);
+/** copy the cached raster into a zeroed buffer, FALSE if there is none */
+gboolean dt_masks_raster_cache_get(const dt_hash_t hash,
+                                   float *const buffer,
+                                   const int width,
+                                   const int height);
+/** store a rendered raster for hash */
+void dt_masks_raster_cache_set(const dt_hash_t hash,
+                               const float *const buffer,
+                               const int width,
+                               const int height);
+
 // returns current masks version
 int dt_masks_version(void);
 
@@ -695,6 +754,16 @@ void dt_masks_calculate_source_pos_value(const dt_masks_form_gui_t *gui,
                                          const int adding);
 
 /** detail mask support */
+// the scharr mask in two steps, a luminance buffer and the gradient of it
+float *dt_masks_calc_scharr_luminance(struct dt_dev_pixelpipe_t *pipe,
+                                      float *src,
+                                      const int width,
+                                      const int height,
+                                      const gboolean rawmode);
+void dt_masks_calc_scharr_gradient(float *mask,
+                                   const float *tmp,
+                                   const int width,
+                                   const int height);
 float *dt_masks_calc_scharr_mask(struct dt_dev_pixelpipe_t *pipe,
                                  float *src,
                                  const int width,
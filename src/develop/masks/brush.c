@@ -3036,17 +3036,19 @@ static inline void _brush_falloff_roi(float *buffer,
   }
 }
 
-// build a stamp which can be combined with other shapes in the same group
-// prerequisite: 'buffer' is all zeros
-static int _brush_get_mask_roi(const dt_iop_module_t *const module,
-                               const dt_dev_pixelpipe_iop_t *const piece,
-                               dt_masks_form_t *const form,
-                               const dt_iop_roi_t *roi,
-                               float *buffer)
+// get the falloff segments of the brush within roi, shared by the cpu
+// and the OpenCL rasterisers. each segment is 4 ints (p0, p1) with 2
+// floats (hardness, density) of payload. count is 0 if the brush lies
+// outside of roi.
+static int _brush_get_falloff_roi(const dt_iop_module_t *const module,
+                                  const dt_dev_pixelpipe_iop_t *const piece,
+                                  dt_masks_form_t *const form,
+                                  const dt_iop_roi_t *roi,
+                                  int **segments,
+                                  float **segments_payload,
+                                  int *count)
 {
-  if(!module) return 0;
-  double start = dt_get_debug_wtime();
-  double start2 = start;
+  double start2 = dt_get_debug_wtime();
 
   const int px = roi->x;
   const int py = roi->y;
@@ -3054,6 +3056,10 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module,
   const int height = roi->height;
   const float scale = roi->scale;
 
+  *segments = NULL;
+  *segments_payload = NULL;
+  *count = 0;
+
   // we get buffers for all points
   float *points = NULL, *border = NULL, *payload = NULL;
 
@@ -3111,8 +3117,20 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module,
     return 1;
   }
 
-  // now we fill the falloff
-  DT_OMP_FOR()
+  const int nb = MAX(border_count - _nb_ctrl_point(nb_corner), 0);
+  int *seg = dt_alloc_align_int((size_t)4 * nb);
+  float *seg_payload = dt_alloc_align_float((size_t)2 * nb);
+  if(!seg || !seg_payload)
+  {
+    dt_free_align(seg);
+    dt_free_align(seg_payload);
+    dt_free_align(points);
+    dt_free_align(border);
+    dt_free_align(payload);
+    return 0;
+  }
+
+  int n = 0;
   for(int i = _nb_ctrl_point(nb_corner); i < border_count; i++)
   {
     const int p0[] = { points[i * 2], points[i * 2 + 1] };
@@ -3122,13 +3140,55 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module,
        || MIN(p0[1], p1[1]) >= height)
       continue;
 
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
+    seg[4 * n] = p0[0];
+    seg[4 * n + 1] = p0[1];
+    seg[4 * n + 2] = p1[0];
+    seg[4 * n + 3] = p1[1];
+    seg_payload[2 * n] = payload[i * 2];
+    seg_payload[2 * n + 1] = payload[i * 2 + 1];
+    n++;
   }
 
   dt_free_align(points);
   dt_free_align(border);
   dt_free_align(payload);
 
+  *segments = seg;
+  *segments_payload = seg_payload;
+  *count = n;
+  return 1;
+}
+
+// build a stamp which can be combined with other shapes in the same group
+// prerequisite: 'buffer' is all zeros
+static int _brush_get_mask_roi(const dt_iop_module_t *const module,
+                               const dt_dev_pixelpipe_iop_t *const piece,
+                               dt_masks_form_t *const form,
+                               const dt_iop_roi_t *roi,
+                               float *buffer)
+{
+  if(!module) return 0;
+  double start = dt_get_debug_wtime();
+  double start2 = start;
+
+  const int width = roi->width;
+  const int height = roi->height;
+
+  int *segments = NULL;
+  float *payload = NULL;
+  int count = 0;
+  if(!_brush_get_falloff_roi(module, piece, form, roi, &segments, &payload, &count))
+    return 0;
+
+  // now we fill the falloff
+  DT_OMP_FOR()
+  for(int i = 0; i < count; i++)
+    _brush_falloff_roi(buffer, segments + 4 * i, segments + 4 * i + 2,
+                       width, height, payload[i * 2], payload[i * 2 + 1]);
+
+  dt_free_align(segments);
+  dt_free_align(payload);
+
   dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
            "[masks %s] brush set falloff took %0.04f sec", form->name,
            dt_get_lap_time(&start2));
@@ -3139,6 +3199,67 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module,
   return 1;
 }
 
+#ifdef HAVE_OPENCL
+// same as _brush_get_mask_roi() but the stamps are drawn by the device
+// into the zeroed float buffer dev_buffer
+static cl_int _brush_get_mask_roi_cl(const dt_iop_module_t *const module,
+                                     const dt_dev_pixelpipe_iop_t *const piece,
+                                     dt_masks_form_t *const form,
+                                     const dt_iop_roi_t *roi,
+                                     const int devid,
+                                     cl_mem dev_buffer,
+                                     gboolean *ok)
+{
+  *ok = FALSE;
+  if(!module) return CL_SUCCESS;
+  double start = dt_get_debug_wtime();
+
+  const int width = roi->width;
+  const int height = roi->height;
+
+  int *segments = NULL;
+  float *payload = NULL;
+  int count = 0;
+  if(!_brush_get_falloff_roi(module, piece, form, roi, &segments, &payload, &count))
+    return CL_SUCCESS;
+
+  cl_int err = CL_SUCCESS;
+  cl_mem dev_segments = NULL;
+  cl_mem dev_payload = NULL;
+  if(count > 0)
+  {
+    err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    dev_segments = dt_opencl_alloc_device_buffer(devid, sizeof(int) * 4 * count);
+    dev_payload = dt_opencl_alloc_device_buffer(devid, sizeof(float) * 2 * count);
+    if(!dev_segments || !dev_payload) goto cleanup;
+
+    err = dt_opencl_write_buffer_to_device(devid, segments, dev_segments, 0,
+                                           sizeof(int) * 4 * count, FALSE);
+    if(err != CL_SUCCESS) goto cleanup;
+    err = dt_opencl_write_buffer_to_device(devid, payload, dev_payload, 0,
+                                           sizeof(float) * 2 * count, TRUE);
+    if(err != CL_SUCCESS) goto cleanup;
+
+    err = dt_opencl_enqueue_kernel_1d_args(devid, darktable.opencl->masks->kernel_masks_brush_falloff,
+                                           count, CLARG(dev_buffer), CLARG(dev_segments),
+                                           CLARG(dev_payload), CLARG(count),
+                                           CLARG(width), CLARG(height));
+  }
+
+  dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+           "[masks %s] brush fill device buffer took %0.04f sec", form->name,
+           dt_get_lap_time(&start));
+
+cleanup:
+  *ok = (err == CL_SUCCESS);
+  dt_opencl_release_mem_object(dev_segments);
+  dt_opencl_release_mem_object(dev_payload);
+  dt_free_align(segments);
+  dt_free_align(payload);
+  return err;
+}
+#endif
+
 static GSList *_brush_setup_mouse_actions(const struct dt_masks_form_t *const form)
 {
   GSList *lm = NULL;
@@ -3308,6 +3429,9 @@ const dt_masks_functions_t dt_masks_functions_brush = {
   .get_points_border = _brush_get_points_border,
   .get_mask = _brush_get_mask,
   .get_mask_roi = _brush_get_mask_roi,
+#ifdef HAVE_OPENCL
+  .get_mask_roi_cl = _brush_get_mask_roi_cl,
+#endif
   .get_area = _brush_get_area,
   .get_source_area = _brush_get_source_area,
   .mouse_moved = _brush_events_mouse_moved,
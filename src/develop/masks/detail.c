@@ -104,23 +104,16 @@
   hanno@schwalm-bremen.de 21/04/29
 */
 
-float *dt_masks_calc_scharr_mask(dt_dev_pixelpipe_t *pipe,
-                                 float *const restrict src,
-                                 const int width,
-                                 const int height,
-                                 const gboolean rawmode)
+float *dt_masks_calc_scharr_luminance(dt_dev_pixelpipe_t *pipe,
+                                      float *const restrict src,
+                                      const int width,
+                                      const int height,
+                                      const gboolean rawmode)
 {
-  float *mask = dt_iop_image_alloc(width, height, 1);
   float *tmp = dt_iop_image_alloc(width, height, 1);
+  if(!tmp) return NULL;
 
   const size_t msize = (size_t)width * height;
-  if(!tmp || !mask)
-  {
-    dt_free_align(tmp);
-    dt_free_align(mask);
-    return NULL;
-  }
-
   const gboolean wboff = !pipe->dsc.temperature.enabled || !rawmode;
   const dt_aligned_pixel_t wb = { wboff ? 1.0f : pipe->dsc.temperature.coeffs[0],
                                   wboff ? 1.0f : pipe->dsc.temperature.coeffs[1],
@@ -136,7 +129,14 @@ float *dt_masks_calc_scharr_mask(dt_dev_pixelpipe_t *pipe,
     // add a gamma. sqrtf should make noise variance the same for all image
     tmp[idx] = sqrtf(val / 3.0f);
   }
+  return tmp;
+}
 
+void dt_masks_calc_scharr_gradient(float *const restrict mask,
+                                   const float *const restrict tmp,
+                                   const int width,
+                                   const int height)
+{
   DT_OMP_FOR()
   for(size_t row = 0; row < height; row++)
   {
@@ -150,6 +150,23 @@ float *dt_masks_calc_scharr_mask(dt_dev_pixelpipe_t *pipe,
       mask[row * width + col] = CLIP(gradient_magnitude / 16.0f);
     }
   }
+}
+
+float *dt_masks_calc_scharr_mask(dt_dev_pixelpipe_t *pipe,
+                                 float *const restrict src,
+                                 const int width,
+                                 const int height,
+                                 const gboolean rawmode)
+{
+  float *mask = dt_iop_image_alloc(width, height, 1);
+  float *tmp = mask ? dt_masks_calc_scharr_luminance(pipe, src, width, height, rawmode) : NULL;
+  if(!tmp)
+  {
+    dt_free_align(mask);
+    return NULL;
+  }
+
+  dt_masks_calc_scharr_gradient(mask, tmp, width, height);
   dt_free_align(tmp);
   return mask;
 }
@@ -188,6 +205,7 @@ float *dt_masks_calc_detail_mask(dt_dev_pixelpipe_iop_t *piece,
 
   if(!details->data)
     return NULL;
+  dt_dev_wait_scharr_mask(pipe);
 
   const size_t msize = (size_t) details->roi.width * details->roi.height;
   float *tmp = dt_alloc_align_float(msize);
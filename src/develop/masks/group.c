@@ -655,7 +655,18 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
       // ensure that we start with a zeroed buffer regardless of what
       // was previously written into 'bufs'
       memset(bufs, 0, npixels*sizeof(float));
-      const int ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
+
+      // reuse the raster of an unchanged shape, whatever pipe rendered it
+      const dt_hash_t raster_hash = dt_masks_raster_hash(piece, sel, roi);
+      int ok = dt_masks_raster_cache_get(raster_hash, bufs, width, height);
+      if(ok)
+        dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+                 "[masks %d] cached shape %d", nb_ok, fpt->formid);
+      else
+      {
+        ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
+        if(ok) dt_masks_raster_cache_set(raster_hash, bufs, width, height);
+      }
       const float op = fpt->opacity;
       const int state = fpt->state;
 
@@ -749,6 +760,174 @@ int dt_masks_group_render_roi(dt_iop_module_t *module,
   return ok;
 }
 
+#ifdef HAVE_OPENCL
+// the ways a shape is combined into its group, see _group_get_mask_roi()
+typedef enum _group_combine_t
+{
+  GROUP_COMBINE_COPY = 0,
+  GROUP_COMBINE_UNION = 1,
+  GROUP_COMBINE_INTERSECTION = 2,
+  GROUP_COMBINE_DIFFERENCE = 3,
+  GROUP_COMBINE_SUM = 4,
+  GROUP_COMBINE_EXCLUSION = 5
+} _group_combine_t;
+
+static _group_combine_t _group_combine_mode(const int state)
+{
+  if(state & DT_MASKS_STATE_UNION) return GROUP_COMBINE_UNION;
+  if(state & DT_MASKS_STATE_INTERSECTION) return GROUP_COMBINE_INTERSECTION;
+  if(state & DT_MASKS_STATE_DIFFERENCE) return GROUP_COMBINE_DIFFERENCE;
+  if(state & DT_MASKS_STATE_SUM) return GROUP_COMBINE_SUM;
+  if(state & DT_MASKS_STATE_EXCLUSION) return GROUP_COMBINE_EXCLUSION;
+  return GROUP_COMBINE_COPY;
+}
+
+dt_masks_cl_global_t *dt_masks_init_cl_global(void)
+{
+  dt_masks_cl_global_t *g = malloc(sizeof(dt_masks_cl_global_t));
+  const int program = 48; // masks.cl, from programs.conf
+  g->kernel_masks_fill = dt_opencl_create_kernel(program, "masks_fill");
+  g->kernel_masks_brush_falloff = dt_opencl_create_kernel(program, "masks_brush_falloff");
+  g->kernel_masks_path_edges = dt_opencl_create_kernel(program, "masks_path_edges");
+  g->kernel_masks_path_fill = dt_opencl_create_kernel(program, "masks_path_fill");
+  g->kernel_masks_path_falloff = dt_opencl_create_kernel(program, "masks_path_falloff");
+  g->kernel_masks_combine = dt_opencl_create_kernel(program, "masks_combine");
+  g->kernel_masks_output = dt_opencl_create_kernel(program, "masks_output");
+  return g;
+}
+
+void dt_masks_free_cl_global(dt_masks_cl_global_t *g)
+{
+  if(!g) return;
+  dt_opencl_free_kernel(g->kernel_masks_fill);
+  dt_opencl_free_kernel(g->kernel_masks_brush_falloff);
+  dt_opencl_free_kernel(g->kernel_masks_path_edges);
+  dt_opencl_free_kernel(g->kernel_masks_path_fill);
+  dt_opencl_free_kernel(g->kernel_masks_path_falloff);
+  dt_opencl_free_kernel(g->kernel_masks_combine);
+  dt_opencl_free_kernel(g->kernel_masks_output);
+  free(g);
+}
+
+cl_int dt_masks_group_render_roi_cl(dt_iop_module_t *module,
+                                    dt_dev_pixelpipe_iop_t *piece,
+                                    dt_masks_form_t *form,
+                                    const dt_iop_roi_t *roi,
+                                    const int devid,
+                                    cl_mem dev_mask,
+                                    const gboolean inverted,
+                                    gboolean *form_ok)
+{
+  *form_ok = FALSE;
+  if(!form) return CL_SUCCESS;
+
+  double start = dt_get_debug_wtime();
+  const dt_masks_cl_global_t *const g = darktable.opencl->masks;
+  const int width = roi->width;
+  const int height = roi->height;
+  const int npixels = width * height;
+  const float zero = 0.0f;
+  int nb_ok = 0;
+
+  // a single shape is drawn like a group of one
+  dt_masks_point_group_t single = { .formid = form->formid,
+                                    .parentid = NO_MASKID,
+                                    .state = DT_MASKS_STATE_USE,
+                                    .opacity = 1.0f };
+  GList *fpts = (form->type & DT_MASKS_GROUP) ? form->points : NULL;
+  dt_masks_point_group_t *fpt = fpts ? fpts->data : &single;
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  float *bufs = NULL;
+  cl_mem dev_dest = dt_opencl_alloc_device_buffer(devid, sizeof(float) * npixels);
+  cl_mem dev_shape = dt_opencl_alloc_device_buffer(devid, sizeof(float) * npixels);
+  if(!dev_dest || !dev_shape) goto cleanup;
+
+  err = dt_opencl_enqueue_kernel_1d_args(devid, g->kernel_masks_fill, npixels,
+                                         CLARG(dev_dest), CLARG(npixels), CLARG(zero));
+  if(err != CL_SUCCESS) goto cleanup;
+
+  while(fpt)
+  {
+    dt_masks_form_t *sel = (form->type & DT_MASKS_GROUP)
+      ? dt_masks_get_from_id(module->dev, fpt->formid)
+      : form;
+
+    if(sel)
+    {
+      err = dt_opencl_enqueue_kernel_1d_args(devid, g->kernel_masks_fill, npixels,
+                                             CLARG(dev_shape), CLARG(npixels), CLARG(zero));
+      if(err != CL_SUCCESS) goto cleanup;
+
+      gboolean ok = FALSE;
+      if(sel->functions && sel->functions->get_mask_roi_cl)
+      {
+        err = sel->functions->get_mask_roi_cl(module, piece, sel, roi, devid, dev_shape, &ok);
+        if(err != CL_SUCCESS) goto cleanup;
+      }
+      else
+      {
+        // no device version for this shape, render it on the cpu
+        if(!bufs) bufs = dt_alloc_align_float(npixels);
+        if(!bufs)
+        {
+          err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+          goto cleanup;
+        }
+        memset(bufs, 0, sizeof(float) * npixels);
+
+        const dt_hash_t raster_hash = dt_masks_raster_hash(piece, sel, roi);
+        ok = dt_masks_raster_cache_get(raster_hash, bufs, width, height);
+        if(!ok)
+        {
+          ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
+          if(ok) dt_masks_raster_cache_set(raster_hash, bufs, width, height);
+        }
+        if(ok)
+        {
+          err = dt_opencl_write_buffer_to_device(devid, bufs, dev_shape, 0,
+                                                 sizeof(float) * npixels, TRUE);
+          if(err != CL_SUCCESS) goto cleanup;
+        }
+      }
+
+      if(ok)
+      {
+        const int mode = _group_combine_mode(fpt->state);
+        const int invert_shape = (fpt->state & DT_MASKS_STATE_INVERSE) ? 1 : 0;
+        const float op = fpt->opacity;
+        err = dt_opencl_enqueue_kernel_1d_args(devid, g->kernel_masks_combine, npixels,
+                                               CLARG(dev_dest), CLARG(dev_shape), CLARG(npixels),
+                                               CLARG(op), CLARG(invert_shape), CLARG(mode));
+        if(err != CL_SUCCESS) goto cleanup;
+        nb_ok++;
+      }
+    }
+
+    fpts = fpts ? g_list_next(fpts) : NULL;
+    fpt = fpts ? fpts->data : NULL;
+  }
+
+  const int invert = inverted ? 1 : 0;
+  err = dt_opencl_enqueue_kernel_2d_args(devid, g->kernel_masks_output, width, height,
+                                         CLARG(dev_dest), CLARG(dev_mask),
+                                         CLARG(width), CLARG(height), CLARG(invert));
+  if(err != CL_SUCCESS) goto cleanup;
+
+  *form_ok = nb_ok != 0;
+
+  dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+           "[masks] render all masks on device took %0.04f sec",
+           dt_get_lap_time(&start));
+
+cleanup:
+  dt_opencl_release_mem_object(dev_dest);
+  dt_opencl_release_mem_object(dev_shape);
+  dt_free_align(bufs);
+  return err;
+}
+#endif
+
 static GSList *_group_setup_mouse_actions(const dt_masks_form_t *const form)
 {
   GSList *lm = NULL;
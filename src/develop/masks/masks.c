@@ -2797,6 +2797,199 @@ void dt_masks_line_stroke(cairo_t *cr,
 
 #include "detail.c"
 
+// rendered shapes are kept for all pipes of all images, the least recently
+// used ones are dropped first when the cache grows above this size in bytes.
+#define DT_MASKS_RASTER_CACHE_SIZE ((size_t)128 << 20)
+
+typedef struct dt_masks_raster_entry_t
+{
+  dt_hash_t hash;
+  int width;
+  int height;
+  // only the rows from row to row + rows - 1 have non-zero pixels
+  int row;
+  int rows;
+  float *data;
+} dt_masks_raster_entry_t;
+
+static dt_pthread_mutex_t _raster_lock;
+
+// most recently used first, protected by _raster_lock
+static GList *_raster_entries = NULL;
+static size_t _raster_size = 0;
+
+static void _raster_free_entry(gpointer data)
+{
+  dt_masks_raster_entry_t *entry = data;
+  dt_free_align(entry->data);
+  free(entry);
+}
+
+void dt_masks_raster_cache_init(void)
+{
+  dt_pthread_mutex_init(&_raster_lock, NULL);
+  _raster_entries = NULL;
+  _raster_size = 0;
+}
+
+void dt_masks_raster_cache_cleanup(void)
+{
+  dt_pthread_mutex_lock(&_raster_lock);
+  g_list_free_full(_raster_entries, _raster_free_entry);
+  _raster_entries = NULL;
+  _raster_size = 0;
+  dt_pthread_mutex_unlock(&_raster_lock);
+  dt_pthread_mutex_destroy(&_raster_lock);
+}
+
+dt_hash_t dt_masks_raster_hash(const dt_dev_pixelpipe_iop_t *piece,
+                               dt_masks_form_t *form,
+                               const dt_iop_roi_t *roi)
+{
+  if(!form || (form->type & DT_MASKS_GROUP)) return DT_INVALID_HASH;
+
+  dt_hash_t hash = dt_masks_group_hash(DT_INITHASH, form);
+
+  // the shape is distorted by all the modules up to and including the
+  // one it is used in, see dt_dev_distort_transform_plus(). we don't
+  // use dt_dev_hash_distort_plus() as it takes the history lock, which
+  // we must not do from within the pipe.
+  const dt_dev_pixelpipe_t *pipe = piece->pipe;
+  gboolean found = FALSE;
+  for(const GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *p = nodes->data;
+    if(p->enabled && p->module->operation_tags() & IOP_TAG_DISTORT)
+      hash = dt_hash(hash, &p->hash, sizeof(p->hash));
+    if(p == piece)
+    {
+      found = TRUE;
+      break;
+    }
+  }
+  if(!found) return DT_INVALID_HASH;
+
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+  hash = dt_hash(hash, &roi->x, sizeof(roi->x));
+  hash = dt_hash(hash, &roi->y, sizeof(roi->y));
+  hash = dt_hash(hash, &roi->width, sizeof(roi->width));
+  hash = dt_hash(hash, &roi->height, sizeof(roi->height));
+  hash = dt_hash(hash, &roi->scale, sizeof(roi->scale));
+  return hash;
+}
+
+// call with _raster_lock held
+static GList *_raster_find_entry(const dt_hash_t hash)
+{
+  for(GList *l = _raster_entries; l; l = g_list_next(l))
+  {
+    const dt_masks_raster_entry_t *entry = l->data;
+    if(entry->hash == hash) return l;
+  }
+  return NULL;
+}
+
+gboolean dt_masks_raster_cache_get(const dt_hash_t hash,
+                                   float *const buffer,
+                                   const int width,
+                                   const int height)
+{
+  if(hash == DT_INVALID_HASH) return FALSE;
+
+  gboolean found = FALSE;
+  dt_pthread_mutex_lock(&_raster_lock);
+  GList *l = _raster_find_entry(hash);
+  if(l)
+  {
+    const dt_masks_raster_entry_t *entry = l->data;
+    if(entry->width == width && entry->height == height)
+    {
+      if(entry->rows)
+        memcpy(buffer + (size_t)entry->row * width, entry->data,
+               sizeof(float) * entry->rows * width);
+      found = TRUE;
+    }
+    _raster_entries = g_list_remove_link(_raster_entries, l);
+    _raster_entries = g_list_concat(l, _raster_entries);
+  }
+  dt_pthread_mutex_unlock(&_raster_lock);
+  return found;
+}
+
+void dt_masks_raster_cache_set(const dt_hash_t hash,
+                               const float *const buffer,
+                               const int width,
+                               const int height)
+{
+  if(hash == DT_INVALID_HASH) return;
+
+  // most shapes cover a small part of the roi, only keep the rows they touch
+  int first = height;
+  int last = -1;
+  for(int row = 0; row < height; row++)
+  {
+    const float *const line = buffer + (size_t)row * width;
+    for(int col = 0; col < width; col++)
+    {
+      if(line[col] != 0.0f)
+      {
+        if(first == height) first = row;
+        last = row;
+        break;
+      }
+    }
+  }
+
+  const int rows = last - first + 1;
+  const size_t size = sizeof(float) * MAX(rows, 0) * width;
+  // a single huge shape, as in an export, would only flush the cache
+  if(size > DT_MASKS_RASTER_CACHE_SIZE / 4) return;
+
+  dt_masks_raster_entry_t *entry = malloc(sizeof(dt_masks_raster_entry_t));
+  if(!entry) return;
+  entry->hash = hash;
+  entry->width = width;
+  entry->height = height;
+  entry->row = rows > 0 ? first : 0;
+  entry->rows = MAX(rows, 0);
+  entry->data = NULL;
+  if(rows > 0)
+  {
+    entry->data = dt_alloc_align_float((size_t)rows * width);
+    if(!entry->data)
+    {
+      free(entry);
+      return;
+    }
+    memcpy(entry->data, buffer + (size_t)first * width, size);
+  }
+
+  dt_pthread_mutex_lock(&_raster_lock);
+  GList *l = _raster_find_entry(hash);
+  if(l)
+  {
+    const dt_masks_raster_entry_t *old = l->data;
+    _raster_size -= sizeof(float) * old->rows * old->width;
+    _raster_free_entry(l->data);
+    _raster_entries = g_list_delete_link(_raster_entries, l);
+  }
+
+  _raster_entries = g_list_prepend(_raster_entries, entry);
+  _raster_size += size;
+
+  while(_raster_size > DT_MASKS_RASTER_CACHE_SIZE)
+  {
+    GList *oldest = g_list_last(_raster_entries);
+    const dt_masks_raster_entry_t *old = oldest->data;
+    _raster_size -= sizeof(float) * old->rows * old->width;
+    _raster_free_entry(oldest->data);
+    _raster_entries = g_list_delete_link(_raster_entries, oldest);
+  }
+  dt_pthread_mutex_unlock(&_raster_lock);
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
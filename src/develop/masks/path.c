@@ -3557,8 +3557,8 @@ static int _path_crop_to_roi(float *path,
 
 /** we write a falloff segment respecting limits of buffer */
 static void _path_falloff_roi(float *buffer,
-                              int *p0,
-                              int *p1,
+                              const int *p0,
+                              const int *p1,
                               const int bw,
                               const int bh)
 {
@@ -3590,15 +3590,39 @@ static void _path_falloff_roi(float *buffer,
   }
 }
 
-// build a stamp which can be combined with other shapes in the same group
-// prerequisite: 'buffer' is all zeros
-static int _path_get_mask_roi(const dt_iop_module_t *const module,
-                              const dt_dev_pixelpipe_iop_t *const piece,
-                              dt_masks_form_t *const form,
-                              const dt_iop_roi_t *roi,
-                              float *buffer)
+// what has to be drawn of a path within roi, shared by the cpu and the
+// OpenCL rasterisers
+typedef struct _path_raster_t
 {
-  if(!module) return 0;
+  // roi lies completely within the path
+  gboolean encircles;
+  // the path cropped to roi for the edge-flag fill, NULL if there is no
+  // fill. the polygon is made of the points from edges_start to edges_count - 1
+  float *edges;
+  int edges_start;
+  int edges_count;
+  // the part of roi the plain fill needs to scan
+  int xmin, xmax, ymin, ymax;
+  // the feather segments, 4 ints (p0, p1) each
+  int *falloff;
+  int falloff_count;
+} _path_raster_t;
+
+static void _path_raster_free(_path_raster_t *r)
+{
+  dt_free_align(r->edges);
+  dt_free_align(r->falloff);
+  r->edges = NULL;
+  r->falloff = NULL;
+}
+
+static int _path_get_raster_roi(const dt_iop_module_t *const module,
+                                const dt_dev_pixelpipe_iop_t *const piece,
+                                dt_masks_form_t *const form,
+                                const dt_iop_roi_t *roi,
+                                _path_raster_t *r)
+{
+  memset(r, 0, sizeof(_path_raster_t));
   double start = dt_get_debug_wtime();
   double start2 = 0.0;
 
@@ -3771,86 +3795,20 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
 
     if(path_encircles_roi)
     {
-      // roi lies completely within path
-      for(size_t k = 0; k < (size_t)width * height; k++)
-        buffer[k] = 1.0f;
+      r->encircles = TRUE;
+      dt_free_align(cpoints);
     }
     else
     {
-      // all other cases
-
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = _nb_wctrl_points(nb_corner); i < points_count; i++)
-      {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
-
-        if(ystart > yend)
-        {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
-
-        // we don't need special handling of ystart==yend
-        // as following loop will take care
-        const float m = (xstart - xend) / (ystart - yend);
-
-        for(int yy = (int)ceilf(ystart);
-            (float)yy < yend;
-            yy++) // this would normally never touch the last roi line
-                  // => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
-
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross)
-            xx++;
-
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
-
-          const size_t index = (size_t)yy * width + xx;
-
-          buffer[index] = 1.0f - buffer[index];
-        }
-      }
-
-      dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
-               "[masks %s] path_fill draw path took %0.04f sec", form->name,
-               dt_get_lap_time(&start2));
-
-      // we fill the inside plain
+      r->edges = cpoints;
+      r->edges_start = _nb_wctrl_points(nb_corner);
+      r->edges_count = points_count;
       // we don't need to deal with parts of shape outside of roi
-      const int xxmin = MAX(xmin, 0);
-      const int xxmax = MIN(xmax, width - 1);
-      const int yymin = MAX(ymin, 0);
-      const int yymax = MIN(ymax, height - 1);
-
-      DT_OMP_FOR(num_threads(MIN(8, dt_get_num_threads())))
-      for(int yy = yymin; yy <= yymax; yy++)
-      {
-        int state = 0;
-        for(int xx = xxmin; xx <= xxmax; xx++)
-        {
-          const size_t index = (size_t)yy * width + xx;
-          const float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
-        }
-      }
-
-      dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
-               "[masks %s] path_fill fill plain took %0.04f sec", form->name,
-               dt_get_lap_time(&start2));
+      r->xmin = MAX(xmin, 0);
+      r->xmax = MIN(xmax, width - 1);
+      r->ymin = MAX(ymin, 0);
+      r->ymax = MIN(ymax, height - 1);
     }
-    dt_free_align(cpoints);
   }
 
   // deal with feather if it does not lie outside of roi
@@ -3861,6 +3819,7 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
     {
       dt_free_align(points);
       dt_free_align(border);
+      _path_raster_free(r);
       return 0;
     }
 
@@ -3916,19 +3875,134 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
       }
     }
 
+    r->falloff = dpoints;
+    r->falloff_count = dindex / 4;
+  }
+
+  dt_free_align(points);
+  dt_free_align(border);
+
+  dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+           "[masks %s] path raster setup took %0.04f sec", form->name,
+           dt_get_lap_time(&start));
+
+  return 1;
+}
+
+// build a stamp which can be combined with other shapes in the same group
+// prerequisite: 'buffer' is all zeros
+static int _path_get_mask_roi(const dt_iop_module_t *const module,
+                              const dt_dev_pixelpipe_iop_t *const piece,
+                              dt_masks_form_t *const form,
+                              const dt_iop_roi_t *roi,
+                              float *buffer)
+{
+  if(!module) return 0;
+  double start = dt_get_debug_wtime();
+  double start2 = start;
+
+  const int width = roi->width;
+  const int height = roi->height;
+
+  _path_raster_t r;
+  if(!_path_get_raster_roi(module, piece, form, roi, &r)) return 0;
+
+  if(r.encircles)
+  {
+    // roi lies completely within path
+    for(size_t k = 0; k < (size_t)width * height; k++)
+      buffer[k] = 1.0f;
+  }
+  else if(r.edges)
+  {
+    const float *const cpoints = r.edges;
+    const int points_count = r.edges_count;
+
+    // edge-flag polygon fill: we write all the point around the path into the buffer
+    float xlast = cpoints[(points_count - 1) * 2];
+    float ylast = cpoints[(points_count - 1) * 2 + 1];
+
+    for(int i = r.edges_start; i < points_count; i++)
+    {
+      float xstart = xlast;
+      float ystart = ylast;
+
+      float xend = xlast = cpoints[i * 2];
+      float yend = ylast = cpoints[i * 2 + 1];
+
+      if(ystart > yend)
+      {
+        float tmp;
+        tmp = ystart, ystart = yend, yend = tmp;
+        tmp = xstart, xstart = xend, xend = tmp;
+      }
+
+      // we don't need special handling of ystart==yend
+      // as following loop will take care
+      const float m = (xstart - xend) / (ystart - yend);
+
+      for(int yy = (int)ceilf(ystart);
+          (float)yy < yend;
+          yy++) // this would normally never touch the last roi line
+                // => see _path_crop_to_roi() in _path_get_raster_roi()
+      {
+        const float xcross = xstart + m * (yy - ystart);
+
+        int xx = floorf(xcross);
+        if((float)xx + 0.5f <= xcross)
+          xx++;
+
+        if(xx < 0 || xx >= width || yy < 0 || yy >= height)
+          continue; // sanity check just to be on the safe side
+
+        const size_t index = (size_t)yy * width + xx;
+
+        buffer[index] = 1.0f - buffer[index];
+      }
+    }
+
+    dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+             "[masks %s] path_fill draw path took %0.04f sec", form->name,
+             dt_get_lap_time(&start2));
+
+    // we fill the inside plain
+    const int xxmin = r.xmin;
+    const int xxmax = r.xmax;
+    const int yymin = r.ymin;
+    const int yymax = r.ymax;
+
+    DT_OMP_FOR(num_threads(MIN(8, dt_get_num_threads())))
+    for(int yy = yymin; yy <= yymax; yy++)
+    {
+      int state = 0;
+      for(int xx = xxmin; xx <= xxmax; xx++)
+      {
+        const size_t index = (size_t)yy * width + xx;
+        const float v = buffer[index];
+        if(v > 0.5f) state = !state;
+        if(state) buffer[index] = 1.0f;
+      }
+    }
+
+    dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+             "[masks %s] path_fill fill plain took %0.04f sec", form->name,
+             dt_get_lap_time(&start2));
+  }
+
+  // deal with feather if it does not lie outside of roi
+  if(r.falloff)
+  {
+    const int *const dpoints = r.falloff;
     DT_OMP_FOR()
-    for(int n = 0; n < dindex; n += 4)
+    for(int n = 0; n < 4 * r.falloff_count; n += 4)
       _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, height);
 
-    dt_free_align(dpoints);
-
     dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
              "[masks %s] path_fill fill falloff took %0.04f sec", form->name,
              dt_get_lap_time(&start2));
   }
 
-  dt_free_align(points);
-  dt_free_align(border);
+  _path_raster_free(&r);
 
   dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
            "[masks %s] path fill buffer took %0.04f sec", form->name,
@@ -3937,6 +4011,93 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
   return 1;
 }
 
+#ifdef HAVE_OPENCL
+// same as _path_get_mask_roi() but the fill and the feather are drawn
+// by the device into the zeroed float buffer dev_buffer
+static cl_int _path_get_mask_roi_cl(const dt_iop_module_t *const module,
+                                    const dt_dev_pixelpipe_iop_t *const piece,
+                                    dt_masks_form_t *const form,
+                                    const dt_iop_roi_t *roi,
+                                    const int devid,
+                                    cl_mem dev_buffer,
+                                    gboolean *ok)
+{
+  *ok = FALSE;
+  if(!module) return CL_SUCCESS;
+  double start = dt_get_debug_wtime();
+
+  const int width = roi->width;
+  const int height = roi->height;
+  const dt_masks_cl_global_t *const g = darktable.opencl->masks;
+
+  _path_raster_t r;
+  if(!_path_get_raster_roi(module, piece, form, roi, &r)) return CL_SUCCESS;
+
+  cl_int err = CL_SUCCESS;
+  cl_mem dev_edges = NULL;
+  cl_mem dev_falloff = NULL;
+
+  if(r.encircles)
+  {
+    const int npixels = width * height;
+    const float one = 1.0f;
+    err = dt_opencl_enqueue_kernel_1d_args(devid, g->kernel_masks_fill, npixels,
+                                           CLARG(dev_buffer), CLARG(npixels), CLARG(one));
+    if(err != CL_SUCCESS) goto cleanup;
+  }
+  else if(r.edges)
+  {
+    const int count = r.edges_count - r.edges_start;
+    err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    dev_edges = dt_opencl_alloc_device_buffer(devid, sizeof(float) * 2 * count);
+    if(!dev_edges) goto cleanup;
+    err = dt_opencl_write_buffer_to_device(devid, r.edges + 2 * r.edges_start, dev_edges, 0,
+                                           sizeof(float) * 2 * count, TRUE);
+    if(err != CL_SUCCESS) goto cleanup;
+
+    err = dt_opencl_enqueue_kernel_1d_args(devid, g->kernel_masks_path_edges, count,
+                                           CLARG(dev_buffer), CLARG(dev_edges), CLARG(count),
+                                           CLARG(width), CLARG(height));
+    if(err != CL_SUCCESS) goto cleanup;
+
+    if(r.ymax >= r.ymin && r.xmax >= r.xmin)
+    {
+      const int rows = r.ymax - r.ymin + 1;
+      err = dt_opencl_enqueue_kernel_1d_args(devid, g->kernel_masks_path_fill, rows,
+                                             CLARG(dev_buffer), CLARG(width),
+                                             CLARG(r.xmin), CLARG(r.xmax), CLARG(r.ymin), CLARG(r.ymax));
+      if(err != CL_SUCCESS) goto cleanup;
+    }
+  }
+
+  if(r.falloff && r.falloff_count > 0)
+  {
+    err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    dev_falloff = dt_opencl_alloc_device_buffer(devid, sizeof(int) * 4 * r.falloff_count);
+    if(!dev_falloff) goto cleanup;
+    err = dt_opencl_write_buffer_to_device(devid, r.falloff, dev_falloff, 0,
+                                           sizeof(int) * 4 * r.falloff_count, TRUE);
+    if(err != CL_SUCCESS) goto cleanup;
+
+    err = dt_opencl_enqueue_kernel_1d_args(devid, g->kernel_masks_path_falloff, r.falloff_count,
+                                           CLARG(dev_buffer), CLARG(dev_falloff), CLARG(r.falloff_count),
+                                           CLARG(width), CLARG(height));
+    if(err != CL_SUCCESS) goto cleanup;
+  }
+
+  dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+           "[masks %s] path fill device buffer took %0.04f sec", form->name,
+           dt_get_lap_time(&start));
+
+cleanup:
+  *ok = (err == CL_SUCCESS);
+  dt_opencl_release_mem_object(dev_edges);
+  dt_opencl_release_mem_object(dev_falloff);
+  _path_raster_free(&r);
+  return err;
+}
+#endif
+
 static GSList *_path_setup_mouse_actions(const dt_masks_form_t *const form)
 {
   GSList *lm = NULL;
@@ -4137,6 +4298,9 @@ const dt_masks_functions_t dt_masks_functions_path = {
   .get_points_border = _path_get_points_border,
   .get_mask = _path_get_mask,
   .get_mask_roi = _path_get_mask_roi,
+#ifdef HAVE_OPENCL
+  .get_mask_roi_cl = _path_get_mask_roi_cl,
+#endif
   .get_area = _path_get_area,
   .get_source_area = _path_get_source_area,
   .mouse_moved = _path_events_mouse_moved,
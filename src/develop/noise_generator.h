@@ -15,7 +15,9 @@
    You should have received a copy of the GNU General Public License
    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
+#pragma once
 
+#include "common/math.h"
 #include "develop/openmp_maths.h"
 
 
@@ -27,241 +29,140 @@ typedef enum dt_noise_distribution_t
 } dt_noise_distribution_t;
 
 
-DT_OMP_DECLARE_SIMD()
-static inline uint32_t splitmix32(const uint64_t seed)
+// Counter-based random numbers: Philox4x32.
+// Reference: Salmon, Moraes, Dror, Shaw, "Parallel random numbers: as easy as 1, 2, 3", SC 2011.
+// The output is a pure function of the counter (the pixel coordinates) and the key (the seed),
+// so the noise of a pixel does not depend on the thread count, the tiling or the device.
+// 7 rounds are enough to pass BigCrush, we don't need the 10 of the paper's default.
+// Keep this in sync with data/kernels/noise_generator.h, both paths yield the same bits.
+#define DT_NOISE_PHILOX_ROUNDS 7
+#define DT_NOISE_PHILOX_M0 0xD2511F53u
+#define DT_NOISE_PHILOX_M1 0xCD9E8D57u
+#define DT_NOISE_PHILOX_W0 0x9E3779B9u
+#define DT_NOISE_PHILOX_W1 0xBB67AE85u
+
+
+DT_OMP_DECLARE_SIMD(uniform(seed) aligned(out:16))
+static inline void dt_noise_uniform4(const uint32_t x,
+                                     const uint32_t y,
+                                     const uint32_t seed,
+                                     dt_aligned_pixel_t out)
 {
-  // fast random number generator
-  // reference: http://prng.di.unimi.it/splitmix64.c
-  uint64_t result = (seed ^ (seed >> 33)) * 0x62a9d9ed799705f5ul;
-  result = (result ^ (result >> 28)) * 0xcb24d0a5c88c35b3ul;
-  return (uint32_t)(result >> 32);
-}
-
-
-DT_OMP_DECLARE_SIMD(uniform(k))
-static inline uint32_t rol32(const uint32_t x, const int k)
-{
-  return (x << k) | (x >> (32 - k));
-}
-
+  // 4 uniform random numbers in [0 ; 1[ for the pixel (x, y)
+  uint32_t c0 = x, c1 = y, c2 = 0u, c3 = 0u;
+  uint32_t k0 = seed, k1 = 0u;
 
-DT_OMP_DECLARE_SIMD(aligned(state:64))
-static inline float xoshiro128plus(uint32_t state[4])
-{
-  // fast random number generator
-  // reference: http://prng.di.unimi.it/
-  const unsigned int result = state[0] + state[3];
-  const unsigned int t = state[1] << 9;
-
-  state[2] ^= state[0];
-  state[3] ^= state[1];
-  state[1] ^= state[2];
-  state[0] ^= state[3];
-
-  state[2] ^= t;
-  state[3] = rol32(state[3], 11);
+  for(int r = 0; r < DT_NOISE_PHILOX_ROUNDS; r++)
+  {
+    const uint64_t p0 = (uint64_t)DT_NOISE_PHILOX_M0 * c0;
+    const uint64_t p1 = (uint64_t)DT_NOISE_PHILOX_M1 * c2;
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)p1;
+    c3 = (uint32_t)p0;
+    k0 += DT_NOISE_PHILOX_W0;
+    k1 += DT_NOISE_PHILOX_W1;
+  }
 
   // take the first 24 bits and put them in mantissa
-  return (float)(result >> 8) * 0x1.0p-24f;
+  out[0] = (float)(c0 >> 8) * 0x1.0p-24f;
+  out[1] = (float)(c1 >> 8) * 0x1.0p-24f;
+  out[2] = (float)(c2 >> 8) * 0x1.0p-24f;
+  out[3] = (float)(c3 >> 8) * 0x1.0p-24f;
 }
 
 
-DT_OMP_DECLARE_SIMD(uniform(sigma) aligned(state:64))
-static inline float uniform_noise(const float mu, const float sigma, uint32_t state[4])
+DT_OMP_DECLARE_SIMD(aligned(u, out:16))
+static inline void _noise_box_muller(const dt_aligned_pixel_t u, dt_aligned_pixel_t out)
 {
-  return mu + 2.0f * (xoshiro128plus(state) - 0.5f) * sigma;
-}
-
-
-DT_OMP_DECLARE_SIMD(uniform(sigma) aligned(state:64))
-static inline float gaussian_noise(const float mu,
-                                   const float sigma,
-                                   const int flip,
-                                   uint32_t state[4])
-{
-  // Create gaussian noise centered in mu of standard deviation sigma.
-  // state should be initialized with xoshiro256_init() before calling and private in thread.
-  // flip needs to be flipped every next iteration.
+  // Both outputs of each Box-Muller pair are used, so the 4 uniform numbers
+  // of one Philox draw give the 4 gaussian numbers of one pixel.
   // Reference: https://en.wikipedia.org/wiki/Box%E2%80%93Muller_transform
-
-  const float u1 = fmaxf(xoshiro128plus(state), FLT_MIN);
-  const float u2 = xoshiro128plus(state);
-  const float noise = (flip) ? sqrtf(-2.0f * logf(u1)) * cosf(2.f * M_PI * u2) :
-                               sqrtf(-2.0f * logf(u1)) * sinf(2.f * M_PI * u2);
-  return noise * sigma + mu;
+  const float r0 = sqrtf(-2.0f * logf(fmaxf(u[0], FLT_MIN)));
+  const float r1 = sqrtf(-2.0f * logf(fmaxf(u[2], FLT_MIN)));
+  out[0] = r0 * cosf(2.f * M_PI_F * u[1]);
+  out[1] = r0 * sinf(2.f * M_PI_F * u[1]);
+  out[2] = r1 * cosf(2.f * M_PI_F * u[3]);
+  out[3] = r1 * sinf(2.f * M_PI_F * u[3]);
 }
 
 
-DT_OMP_DECLARE_SIMD(uniform(sigma) aligned(state:64))
-static inline float poisson_noise(const float mu,
-                                  const float sigma,
-                                  const int flip,
-                                  uint32_t state[4])
-{
-  // Create poissonian noise - it's just gaussian noise with Anscombe transform applied.
-  const float u1 = fmaxf(xoshiro128plus(state), FLT_MIN);
-  const float u2 = xoshiro128plus(state);
-  const float noise = (flip) ? sqrtf(-2.0f * logf(u1)) * cosf(2.f * M_PI * u2) :
-                               sqrtf(-2.0f * logf(u1)) * sinf(2.f * M_PI * u2);
-  const float r = noise * sigma + 2.0f * sqrtf(fmaxf(mu + 3.f / 8.f, 0.0f));
-  return (r * r - sigma * sigma) / 4.f - 3.f / 8.f;
-}
-
-
-DT_OMP_DECLARE_SIMD(uniform(distribution, param) aligned(state:64))
-static inline float dt_noise_generator(const dt_noise_distribution_t distribution,
-                                       const float mu,
-                                       const float param,
-                                       const int flip,
-                                       uint32_t state[4])
+DT_OMP_DECLARE_SIMD(
+  uniform(distribution, seed)
+  aligned(mu, param, out:16))
+static inline void dt_noise_generator_simd(const dt_noise_distribution_t distribution,
+                                           const uint32_t x,
+                                           const uint32_t y,
+                                           const uint32_t seed,
+                                           const dt_aligned_pixel_t mu,
+                                           const dt_aligned_pixel_t param,
+                                           dt_aligned_pixel_t out)
 {
-  // scalar version
+  // vector version: noise centered in mu of parameter param for the 4 channels of pixel (x, y)
+  dt_aligned_pixel_t u;
+  dt_noise_uniform4(x, y, seed, u);
 
   switch(distribution)
   {
     case(DT_NOISE_UNIFORM):
     default:
-      return uniform_noise(mu, param, state);
+    {
+      for_four_channels(c)
+        out[c] = mu[c] + 2.0f * (u[c] - 0.5f) * param[c];
+      break;
+    }
 
     case(DT_NOISE_GAUSSIAN):
-      return gaussian_noise(mu, param, flip, state);
+    {
+      dt_aligned_pixel_t noise;
+      _noise_box_muller(u, noise);
+      for_four_channels(c)
+        out[c] = noise[c] * param[c] + mu[c];
+      break;
+    }
 
     case(DT_NOISE_POISSONIAN):
-      return poisson_noise(mu, param, flip, state);
-  }
-}
-
-
-DT_OMP_DECLARE_SIMD(
-  uniform(sigma)
-  aligned(state:64)
-  aligned(mu, sigma, out:16))
-static inline void uniform_noise_simd(const dt_aligned_pixel_t mu,
-                                      const dt_aligned_pixel_t sigma,
-                                      uint32_t state[4],
-                                      dt_aligned_pixel_t out)
-{
-  const dt_aligned_pixel_t noise = { xoshiro128plus(state),
-                                     xoshiro128plus(state),
-                                     xoshiro128plus(state) };
-
-  for_each_channel(c)
-    out[c] = mu[c] + 2.0f * (noise[c] - 0.5f) * sigma[c];
-}
-
-
-DT_OMP_DECLARE_SIMD(
-  uniform(sigma)
-  aligned(state:64)
-  aligned(mu, sigma, flip, out:16))
-static inline void gaussian_noise_simd(const dt_aligned_pixel_t mu,
-                                       const dt_aligned_pixel_t sigma,
-                                       const int flip[4],
-                                       uint32_t state[4],
-                                       dt_aligned_pixel_t out)
-{
-  // Create gaussian noise centered in mu of standard deviation sigma.
-  // state should be initialized with xoshiro256_init() before calling and private in thread.
-  // flip needs to be flipped every next iteration.
-  // Reference: https://en.wikipedia.org/wiki/Box%E2%80%93Muller_transform
-
-  dt_aligned_pixel_t u1 = { 0.f };
-  dt_aligned_pixel_t u2 = { 0.f };
-
-  #pragma unroll
-  for(size_t c = 0; c < 3; c++)
-    u1[c] = fmaxf(xoshiro128plus(state), FLT_MIN);
-
-  #pragma unroll
-  for(size_t c = 0; c < 3; c++)
-    u2[c] = xoshiro128plus(state);
-
-  dt_aligned_pixel_t noise = { 0.f };
-
-  for_each_channel(c)
-  {
-    noise[c] = (flip[c]) ? sqrtf(-2.0f * logf(u1[c])) * cosf(2.f * M_PI * u2[c]) :
-                           sqrtf(-2.0f * logf(u1[c])) * sinf(2.f * M_PI * u2[c]);
-  }
-
-  for_each_channel(c)
-    out[c] = noise[c] * sigma[c] + mu[c];
-}
-
-
-DT_OMP_DECLARE_SIMD(
-  uniform(sigma)
-  aligned(state:64)
-  aligned(mu, sigma, flip, out:16))
-static inline void poisson_noise_simd(const dt_aligned_pixel_t mu,
-                                      const dt_aligned_pixel_t sigma,
-                                      const int flip[4],
-                                      uint32_t state[4],
-                                      dt_aligned_pixel_t out)
-{
-  // Create poissonian noise - it's just gaussian noise with Anscombe transform applied.
-  dt_aligned_pixel_t u1 = { 0.f };
-  dt_aligned_pixel_t u2 = { 0.f };
-
-  #pragma unroll
-  for(size_t c = 0; c < 3; c++)
-  {
-    u1[c] = fmaxf(xoshiro128plus(state), FLT_MIN);
-    u2[c] = xoshiro128plus(state);
-  }
-
-  dt_aligned_pixel_t noise = { 0.f };
-
-  for_each_channel(c)
-  {
-    noise[c] = (flip[c]) ? sqrtf(-2.0f * logf(u1[c])) * cosf(2.f * M_PI * u2[c]) :
-                           sqrtf(-2.0f * logf(u1[c])) * sinf(2.f * M_PI * u2[c]);
-  }
-
-  // Now we have gaussian noise, then apply Anscombe transform to get poissonian one.
-  dt_aligned_pixel_t r = { 0.f };
-
-  #pragma unroll
-  for_each_channel(c)
-  {
-    r[c] = noise[c] * sigma[c] + 2.0f * sqrtf(fmaxf(mu[c] + 3.f / 8.f, 0.0f));
-    out[c] = (r[c] * r[c] - sigma[c] * sigma[c]) / 4.f - 3.f / 8.f;
+    {
+      // poissonian noise is just gaussian noise with Anscombe transform applied
+      dt_aligned_pixel_t noise;
+      _noise_box_muller(u, noise);
+      for_four_channels(c)
+      {
+        const float r = noise[c] * param[c] + 2.0f * sqrtf(fmaxf(mu[c] + 3.f / 8.f, 0.0f));
+        out[c] = (r * r - param[c] * param[c]) / 4.f - 3.f / 8.f;
+      }
+      break;
+    }
   }
 }
 
 
-DT_OMP_DECLARE_SIMD(
-  uniform(distribution, param)
-  aligned(state:64)
-  aligned(mu, param, flip, out:16))
-static inline void dt_noise_generator_simd(const dt_noise_distribution_t distribution,
-                                           const dt_aligned_pixel_t mu,
-                                           const dt_aligned_pixel_t param,
-                                           const int flip[4],
-                                           uint32_t state[4],
-                                           dt_aligned_pixel_t out)
+DT_OMP_DECLARE_SIMD(uniform(distribution, param, seed))
+static inline float dt_noise_generator(const dt_noise_distribution_t distribution,
+                                       const uint32_t x,
+                                       const uint32_t y,
+                                       const uint32_t seed,
+                                       const float mu,
+                                       const float param)
 {
-  // vector version
+  // scalar version, this is the first channel of dt_noise_generator_simd()
+  dt_aligned_pixel_t u;
+  dt_noise_uniform4(x, y, seed, u);
 
   switch(distribution)
   {
     case(DT_NOISE_UNIFORM):
     default:
-    {
-      uniform_noise_simd(mu, param, state, out);
-      break;
-    }
+      return mu + 2.0f * (u[0] - 0.5f) * param;
 
     case(DT_NOISE_GAUSSIAN):
-    {
-      gaussian_noise_simd(mu, param, flip, state, out);
-      break;
-    }
+      return sqrtf(-2.0f * logf(fmaxf(u[0], FLT_MIN))) * cosf(2.f * M_PI_F * u[1]) * param + mu;
 
     case(DT_NOISE_POISSONIAN):
     {
-      poisson_noise_simd(mu, param, flip, state, out);
-      break;
+      const float noise = sqrtf(-2.0f * logf(fmaxf(u[0], FLT_MIN))) * cosf(2.f * M_PI_F * u[1]);
+      const float r = noise * param + 2.0f * sqrtf(fmaxf(mu + 3.f / 8.f, 0.0f));
+      return (r * r - param * param) / 4.f - 3.f / 8.f;
     }
   }
 }
@@ -17,6 +17,12 @@
 */
 
 #include "develop/pixelpipe_cache.h"
+#include "common/color_picker.h"
+#include "common/file_location.h"
+#include "common/image.h"
+#include "common/iop_order.h"
+#include "common/metrics.h"
+#include "control/conf.h"
 #include "develop/format.h"
 #include "develop/pixelpipe.h"
 #include "libs/lib.h"
@@ -28,6 +34,23 @@ static inline int _to_mb(size_t m)
   return (int)((m + 0x80000lu) / 0x400lu / 0x400lu);
 }
 
+// number of pipe runs between adaptations of an adaptive cache
+#define DT_PIPECACHE_ADAPT_RUNS 8
+
+// allocates the line arrays of cache as one block for the given number of entries
+static gboolean _cache_alloc_lines(dt_dev_pixelpipe_cache_t *cache, const int entries)
+{
+  const size_t csize = sizeof(void *) + sizeof(size_t) + sizeof(dt_iop_buffer_dsc_t) + 2*sizeof(int32_t) + sizeof(uint64_t);
+  cache->data = (void **) calloc(entries, csize);
+  if(!cache->data) return FALSE;
+  cache->size = (size_t *)((void *)cache->data + entries * sizeof(void *));
+  cache->dsc = (dt_iop_buffer_dsc_t *)((void *)cache->size + entries * sizeof(size_t));
+  cache->hash = (dt_hash_t *)((void *)cache->dsc + entries * sizeof(dt_iop_buffer_dsc_t));
+  cache->used = (int32_t *)((void *)cache->hash + entries * sizeof(dt_hash_t));
+  cache->ioporder = (int32_t *)((void *)cache->used + entries * sizeof(int32_t));
+  return TRUE;
+}
+
 gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
                                      const int entries,
                                      const size_t size,
@@ -37,17 +60,26 @@ gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
 
   cache->entries = entries;
   cache->allmem = cache->hits = cache->calls = cache->tests = 0;
+  cache->evicted_lines = cache->evicted_mem = 0;
   cache->memlimit = limit;
 
-  const size_t csize = sizeof(void *) + sizeof(size_t) + sizeof(dt_iop_buffer_dsc_t) + 2*sizeof(int32_t) + sizeof(uint64_t);
-  cache->data = (void **) calloc(entries, csize);
-  cache->size = (size_t *)((void *)cache->data + entries * sizeof(void *));
-  cache->dsc = (dt_iop_buffer_dsc_t *)((void *)cache->size + entries * sizeof(size_t));
-  cache->hash = (dt_hash_t *)((void *)cache->dsc + entries * sizeof(dt_iop_buffer_dsc_t));
-  cache->used = (int32_t *)((void *)cache->hash + entries * sizeof(dt_hash_t));
-  cache->ioporder = (int32_t *)((void *)cache->used + entries * sizeof(int32_t));
+  // only caches keeping history within a memory limit are adapted
+  cache->adaptive = entries > DT_PIPECACHE_MIN && limit && !size
+                    && dt_conf_get_bool("pixelpipe_cache_adaptive");
+  cache->min_entries = entries;
+  cache->max_entries = 4 * entries;
+  cache->min_memlimit = limit;
+  cache->max_memlimit = MAX(limit, dt_get_available_mem() / 2);
+  cache->adapt_runs = 0;
+  cache->adapt_tests = cache->adapt_hits = 0;
+  cache->adapt_evicted_lines = cache->adapt_evicted_mem = 0;
 
-  for(int k = 0; k < entries; k++)
+  // an adaptive cache gets the arrays for max_entries right away, they
+  // never move while the gui thread invalidates lines
+  const int lines = cache->adaptive ? cache->max_entries : entries;
+  _cache_alloc_lines(cache, lines);
+
+  for(int k = 0; k < lines; k++)
   {
     cache->hash[k] = DT_INVALID_HASH;
     cache->used[k] = 64 + k;
@@ -61,6 +93,7 @@ gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
     cache->data[k] = (void *)dt_alloc_aligned(size);
     if(!cache->data[k])
       goto alloc_memory_fail;
+    dt_alloc_first_touch(cache->data[k], size);
 
     cache->allmem += size;
   }
@@ -180,12 +213,14 @@ gboolean dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_t *pipe,
 
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
   cache->tests++;
+  dt_metrics_inc(DT_METRIC_PIPE_CACHE_TESTS);
   // search for hash in cache and make the sizes are identical
   for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
   {
     if((cache->size[k] == size) && (cache->hash[k] == hash))
     {
       cache->hits++;
+      dt_metrics_inc(DT_METRIC_PIPE_CACHE_HITS);
       return TRUE;
     }
   }
@@ -320,6 +355,12 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
   // Otherwise, get an old/free cacheline and allocate required size.
   // Check both for free and non-matching (and grow or shrink buffer).
   const int cline = _get_cacheline(pipe);
+  if(cache->entries > DT_PIPECACHE_MIN
+     && !pipe->mask_display
+     && !pipe->nocache
+     && cache->data[cline]
+     && cache->hash[cline] != DT_INVALID_HASH)
+    cache->evicted_lines++;
 
   if(((cache->entries == DT_PIPECACHE_MIN) && (cache->size[cline] < size))
      || ((cache->entries > DT_PIPECACHE_MIN) && (cache->size[cline] != size)))
@@ -329,6 +370,7 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
     cache->data[cline] = (void *)dt_alloc_aligned(size);
     if(cache->data[cline])
     {
+      dt_alloc_first_touch(cache->data[cline], size);
       cache->size[cline] = size;
       cache->allmem += size;
     }
@@ -385,6 +427,18 @@ void dt_dev_pixelpipe_cache_invalidate_later(dt_dev_pixelpipe_t *pipe,
   const gboolean bcache = pipe->bcache_data != NULL && pipe->bcache_hash != DT_INVALID_HASH;
   pipe->bcache_hash = DT_INVALID_HASH;
 
+  // statistics read from buffers of the invalidated modules must be collected again
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = nodes->data;
+    if(piece->module->iop_order >= order)
+    {
+      piece->histogram_hash = DT_INVALID_HASH;
+      piece->picker_hash[PIXELPIPE_PICKER_INPUT] = DT_INVALID_HASH;
+      piece->picker_hash[PIXELPIPE_PICKER_OUTPUT] = DT_INVALID_HASH;
+    }
+  }
+
   if(invalidated || bcache)
     dt_print_pipe(DT_DEBUG_PIPE,
     order ? "pipecache invalidate" : "pipecache flush",
@@ -445,6 +499,71 @@ static void _cline_stats(dt_dev_pixelpipe_cache_t *cache)
   }
 }
 
+// resize within the arrays allocated for max_entries. Nothing is moved or
+// reallocated as the gui thread may invalidate lines at the same time,
+// valid lines beyond a shrunk cache are freed.
+static void _cache_set_entries(dt_dev_pixelpipe_cache_t *cache, const int entries)
+{
+  const int old_entries = cache->entries;
+  cache->entries = MIN(entries, cache->max_entries);
+  for(int k = cache->entries; k < old_entries; k++)
+    if(cache->data[k]) _free_cacheline(cache, k);
+
+  if(cache->lastline >= cache->entries) cache->lastline = 0;
+}
+
+static void _cache_adapt(dt_dev_pixelpipe_t *pipe)
+{
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  if(!cache->adaptive || ++cache->adapt_runs < DT_PIPECACHE_ADAPT_RUNS) return;
+
+  const uint64_t tests = cache->tests - cache->adapt_tests;
+  const uint64_t hits = cache->hits - cache->adapt_hits;
+  const uint64_t evicted_lines = cache->evicted_lines - cache->adapt_evicted_lines;
+  const uint64_t evicted_mem = cache->evicted_mem - cache->adapt_evicted_mem;
+  cache->adapt_runs = 0;
+  cache->adapt_tests = cache->tests;
+  cache->adapt_hits = cache->hits;
+  cache->adapt_evicted_lines = cache->evicted_lines;
+  cache->adapt_evicted_mem = cache->evicted_mem;
+  if(!tests) return;
+
+  const double hitrate = (double)hits / tests;
+  const size_t step = MAX(64lu * DT_MEGA, cache->memlimit / 4);
+  const size_t freemem = dt_get_free_mem();
+  const int32_t old_entries = cache->entries;
+  const size_t old_memlimit = cache->memlimit;
+
+  _cline_stats(cache);
+  if(freemem && freemem < 2 * step)
+  {
+    // the system runs short of memory, give some back
+    cache->memlimit = MAX(cache->min_memlimit, cache->memlimit - MIN(step, cache->memlimit));
+  }
+  else if(hitrate < 0.9 && (evicted_lines || evicted_mem))
+  {
+    // we lost valid lines that might have been hit later
+    if(evicted_mem)
+      cache->memlimit = MIN(cache->max_memlimit, cache->memlimit + step);
+    if(evicted_lines)
+      _cache_set_entries(cache, MIN(cache->max_entries, cache->entries + cache->min_entries / 2));
+  }
+  else if(!evicted_lines && !evicted_mem)
+  {
+    // no pressure, slowly return to the initial size
+    if(cache->allmem < cache->memlimit / 2)
+      cache->memlimit = MAX(cache->min_memlimit, cache->memlimit - MIN(step, cache->memlimit));
+    if(cache->lused < (cache->entries - DT_PIPECACHE_MIN) / 2)
+      _cache_set_entries(cache, MAX(cache->min_entries, cache->entries - cache->min_entries / 2));
+  }
+
+  if(old_entries != cache->entries || old_memlimit != cache->memlimit)
+    dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MEMORY, "pipe cache adapt", pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
+      "hits/test=%.3f, evicted lines=%" PRIu64 " mem=%iMB, free %iMB. %i -> %i lines, limit %iMB -> %iMB",
+      hitrate, evicted_lines, _to_mb(evicted_mem), _to_mb(freemem),
+      old_entries, cache->entries, _to_mb(old_memlimit), _to_mb(cache->memlimit));
+}
+
 void dt_dev_pixelpipe_cache_checkmem(dt_dev_pixelpipe_t *pipe)
 {
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
@@ -453,6 +572,8 @@ void dt_dev_pixelpipe_cache_checkmem(dt_dev_pixelpipe_t *pipe)
   // alternating buffers so no cleanup
   if(cache->entries == DT_PIPECACHE_MIN) return;
 
+  _cache_adapt(pipe);
+
   // We always free cachelines marked as not valid
   size_t freed = 0;
   size_t freed_invalid = 0;
@@ -467,7 +588,9 @@ void dt_dev_pixelpipe_cache_checkmem(dt_dev_pixelpipe_t *pipe)
     const int k = _get_oldest_cacheline(cache, DT_CACHETEST_USED);
     if(k == 0) break;
 
-    freed += _free_cacheline(cache, k);
+    const size_t bytes = _free_cacheline(cache, k);
+    freed += bytes;
+    cache->evicted_mem += bytes;
   }
 
   _cline_stats(cache);
@@ -488,6 +611,427 @@ void dt_dev_pixelpipe_cache_report(dt_dev_pixelpipe_t *pipe)
     _to_mb(cache->allmem), _to_mb(cache->memlimit),
     (double)(cache->hits) / fmax(1.0, pipe->runs),
     (double)(cache->hits) / fmax(1.0, cache->tests));
+
+  dt_print(DT_DEBUG_PIPE | DT_DEBUG_MEMORY,
+    "[pipe cache stats] {\"pipe\": \"%s\", \"runs\": %" PRIu64 ", \"entries\": %i,"
+    " \"important\": %u, \"used\": %u, \"invalid\": %u,"
+    " \"allmem\": %zu, \"memlimit\": %zu, \"tests\": %" PRIu64 ", \"hits\": %" PRIu64 ","
+    " \"evicted_lines\": %" PRIu64 ", \"evicted_mem\": %" PRIu64 ", \"adaptive\": %s}",
+    dt_dev_pixelpipe_type_to_str(pipe->type), pipe->runs, cache->entries,
+    cache->limportant, cache->lused, cache->linvalid,
+    cache->allmem, cache->memlimit, cache->tests, cache->hits,
+    cache->evicted_lines, cache->evicted_mem, cache->adaptive ? "true" : "false");
+}
+
+// one line of the shared cache, linked into the lru queue by link
+typedef struct _shared_line_t
+{
+  dt_hash_t hash;
+  dt_imgid_t imgid;
+  size_t size;
+  void *data;
+  dt_iop_buffer_dsc_t dsc;
+  GList link;
+} _shared_line_t;
+
+typedef struct dt_dev_pixelpipe_shared_cache_t
+{
+  dt_pthread_mutex_t lock;
+  GHashTable *lines;  // hash -> _shared_line_t
+  GQueue lru;         // most recently used first
+  size_t allmem;
+  size_t memlimit;
+  uint64_t tests;
+  uint64_t hits;
+  // second level on disk, only for the demosaic and colorin outputs
+  gchar *diskdir;
+  size_t disklimit;
+  uint64_t diskhits;
+} dt_dev_pixelpipe_shared_cache_t;
+
+// file of a second level line, followed by size bytes
+typedef struct _disk_line_header_t
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t size;
+  dt_iop_buffer_dsc_t dsc;
+} _disk_line_header_t;
+
+#define DT_PIPECACHE_DISK_VERSION 1
+
+void dt_dev_pixelpipe_shared_cache_init(void)
+{
+  darktable.pipe_shared_cache = NULL;
+  const size_t limit = (size_t)MAX(0, dt_conf_get_int("pixelpipe_shared_cache_mb")) * DT_MEGA;
+  const size_t disklimit = (size_t)MAX(0, dt_conf_get_int("pixelpipe_disk_cache_mb")) * DT_MEGA;
+  if(!limit && !disklimit) return;
+
+  dt_dev_pixelpipe_shared_cache_t *sc = g_malloc0(sizeof(dt_dev_pixelpipe_shared_cache_t));
+  dt_pthread_mutex_init(&sc->lock, NULL);
+  sc->lines = g_hash_table_new(g_int64_hash, g_int64_equal);
+  g_queue_init(&sc->lru);
+  sc->memlimit = limit;
+
+  if(disklimit)
+  {
+    char cachedir[PATH_MAX] = { 0 };
+    dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+    sc->diskdir = g_build_filename(cachedir, "pixelpipe", NULL);
+    if(g_mkdir_with_parents(sc->diskdir, 0750))
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[pixelpipe_shared_cache] can't create `%s'", sc->diskdir);
+      g_free(sc->diskdir);
+      sc->diskdir = NULL;
+    }
+    else
+      sc->disklimit = disklimit;
+  }
+  darktable.pipe_shared_cache = sc;
+  dt_print(DT_DEBUG_PIPE | DT_DEBUG_MEMORY, "[pixelpipe_shared_cache] limit %iMB, disk %iMB",
+           _to_mb(limit), _to_mb(sc->disklimit));
+}
+
+static void _shared_line_remove(dt_dev_pixelpipe_shared_cache_t *sc, _shared_line_t *line)
+{
+  g_hash_table_remove(sc->lines, &line->hash);
+  g_queue_unlink(&sc->lru, &line->link);
+  sc->allmem -= line->size;
+  dt_free_align(line->data);
+  g_free(line);
+}
+
+void dt_dev_pixelpipe_shared_cache_cleanup(void)
+{
+  dt_dev_pixelpipe_shared_cache_t *sc = darktable.pipe_shared_cache;
+  if(!sc) return;
+
+  dt_print(DT_DEBUG_PIPE | DT_DEBUG_MEMORY,
+           "[pixelpipe_shared_cache] %u lines, %iMB. hits/test=%.3f, disk hits %" PRIu64,
+           g_queue_get_length(&sc->lru), _to_mb(sc->allmem),
+           (double)(sc->hits) / fmax(1.0, sc->tests), sc->diskhits);
+
+  while(!g_queue_is_empty(&sc->lru))
+    _shared_line_remove(sc, g_queue_peek_tail_link(&sc->lru)->data);
+  g_hash_table_destroy(sc->lines);
+  dt_pthread_mutex_destroy(&sc->lock);
+  g_free(sc->diskdir);
+  g_free(sc);
+  darktable.pipe_shared_cache = NULL;
+}
+
+gboolean dt_dev_pixelpipe_shared_cache_wanted(dt_dev_pixelpipe_t *pipe,
+                                              const dt_iop_module_t *module)
+{
+  /* Only the raw stages up to colorin are shared, they are the expensive ones
+     and identical for all exports of an image. The details mask is written by
+     demosaic while processing so pipes wanting it can't skip that.
+  */
+  return darktable.pipe_shared_cache
+    && module
+    && (pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE)
+    && !pipe->nocache
+    && !pipe->want_detail_mask
+    && module->iop_order <= dt_ioppr_get_iop_order(pipe->iop_order_list, "colorin", 0);
+}
+
+// the pipe hash doesn't cover the input buffer, pipes of one image may use
+// different mipmaps
+static dt_hash_t _shared_hash(const dt_dev_pixelpipe_t *pipe, const dt_hash_t hash)
+{
+  const float input[3] = { pipe->iwidth, pipe->iheight, pipe->iscale };
+  return dt_hash(hash, input, sizeof(input));
+}
+
+static gboolean _disk_stage(const dt_dev_pixelpipe_shared_cache_t *sc,
+                            const dt_iop_module_t *module)
+{
+  return sc->disklimit
+    && (dt_iop_module_is(module->so, "demosaic") || dt_iop_module_is(module->so, "colorin"));
+}
+
+/* Image ids don't survive a library and buffers have no file, so lines on disk
+   are keyed by the source file, its size and mtime and the darktable version
+   which might have changed any algorithm. Returns NULL if there is no file.
+*/
+static gchar *_disk_line_path(const dt_dev_pixelpipe_shared_cache_t *sc,
+                              const dt_dev_pixelpipe_t *pipe,
+                              const dt_hash_t key)
+{
+  char filename[PATH_MAX] = { 0 };
+  gboolean from_cache = FALSE;
+  dt_image_full_path(pipe->image.id, filename, sizeof(filename), &from_cache);
+
+  GStatBuf st;
+  if(!filename[0] || g_stat(filename, &st)) return NULL;
+
+  const int64_t fileinfo[2] = { st.st_size, st.st_mtime };
+  dt_hash_t hash = dt_hash(key, filename, strlen(filename));
+  hash = dt_hash(hash, fileinfo, sizeof(fileinfo));
+  hash = dt_hash(hash, darktable_package_version, strlen(darktable_package_version));
+
+  char name[32];
+  snprintf(name, sizeof(name), "%016" PRIx64 ".pc", hash);
+  return g_build_filename(sc->diskdir, name, NULL);
+}
+
+static gboolean _disk_read(const dt_dev_pixelpipe_shared_cache_t *sc,
+                           dt_dev_pixelpipe_t *pipe,
+                           const dt_hash_t hash,
+                           const dt_hash_t key,
+                           const size_t size,
+                           void **data,
+                           dt_iop_buffer_dsc_t **dsc,
+                           const dt_iop_module_t *module)
+{
+  gchar *path = _disk_line_path(sc, pipe, key);
+  FILE *f = path ? g_fopen(path, "rb") : NULL;
+  if(!f)
+  {
+    g_free(path);
+    return FALSE;
+  }
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  _disk_line_header_t header;
+  gboolean hit = fread(&header, sizeof(header), 1, f) == 1
+    && !memcmp(header.magic, "dtpc", 4)
+    && header.version == DT_PIPECACHE_DISK_VERSION
+    && header.size == size;
+  if(hit)
+  {
+    dt_dev_pixelpipe_cache_get(pipe, hash, size, data, dsc, module, FALSE);
+    hit = *data && fread(*data, size, 1, f) == 1;
+    if(hit)
+      **dsc = header.dsc;
+    else if(*data)
+      dt_dev_pixelpipe_invalidate_cacheline(pipe, *data);
+  }
+  fclose(f);
+
+  // mtime is the age for eviction
+  if(hit) g_utime(path, NULL);
+  g_free(path);
+
+  if(hit)
+    dt_show_times_f(&start, "[pixelpipe_shared_cache]", "read %iMB of `%s' from disk",
+                    _to_mb(size), module->op);
+  return hit;
+}
+
+typedef struct _disk_file_t
+{
+  gchar *path;
+  size_t size;
+  time_t mtime;
+} _disk_file_t;
+
+static gint _sort_by_mtime(gconstpointer a, gconstpointer b)
+{
+  const _disk_file_t *fa = a;
+  const _disk_file_t *fb = b;
+  return fa->mtime < fb->mtime ? -1 : fa->mtime > fb->mtime;
+}
+
+static void _disk_file_free(gpointer data)
+{
+  _disk_file_t *file = data;
+  g_free(file->path);
+  g_free(file);
+}
+
+// delete the oldest lines until the files fit into the limit
+static void _disk_evict(const dt_dev_pixelpipe_shared_cache_t *sc)
+{
+  GDir *dir = g_dir_open(sc->diskdir, 0, NULL);
+  if(!dir) return;
+
+  GList *files = NULL;
+  size_t used = 0;
+  const gchar *name;
+  while((name = g_dir_read_name(dir)))
+  {
+    if(!g_str_has_suffix(name, ".pc")) continue;
+    _disk_file_t *file = g_malloc0(sizeof(_disk_file_t));
+    file->path = g_build_filename(sc->diskdir, name, NULL);
+    GStatBuf st;
+    if(g_stat(file->path, &st))
+    {
+      _disk_file_free(file);
+      continue;
+    }
+    file->size = st.st_size;
+    file->mtime = st.st_mtime;
+    used += file->size;
+    files = g_list_prepend(files, file);
+  }
+  g_dir_close(dir);
+
+  files = g_list_sort(files, _sort_by_mtime);
+  for(GList *l = files; l && used > sc->disklimit; l = g_list_next(l))
+  {
+    const _disk_file_t *file = l->data;
+    if(!g_unlink(file->path))
+      used -= file->size;
+  }
+  g_list_free_full(files, _disk_file_free);
+}
+
+static void _disk_write(const dt_dev_pixelpipe_shared_cache_t *sc,
+                        const dt_dev_pixelpipe_t *pipe,
+                        const dt_hash_t key,
+                        const size_t size,
+                        const void *data,
+                        const dt_iop_buffer_dsc_t *dsc)
+{
+  if(size + sizeof(_disk_line_header_t) > sc->disklimit) return;
+
+  gchar *path = _disk_line_path(sc, pipe, key);
+  if(!path || g_file_test(path, G_FILE_TEST_EXISTS))
+  {
+    g_free(path);
+    return;
+  }
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  // write to a private name first, readers must never see a partial line
+  gchar *tmp = g_strdup_printf("%s.%p", path, (void *)pipe);
+  FILE *f = g_fopen(tmp, "wb");
+  gboolean ok = f != NULL;
+  if(ok)
+  {
+    _disk_line_header_t header = { .magic = { 'd', 't', 'p', 'c' },
+                                   .version = DT_PIPECACHE_DISK_VERSION,
+                                   .size = size,
+                                   .dsc = *dsc };
+    ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(data, size, 1, f) == 1;
+    ok = !fclose(f) && ok;
+  }
+  if(ok) ok = !g_rename(tmp, path);
+  if(!ok) g_unlink(tmp);
+
+  if(ok)
+  {
+    _disk_evict(sc);
+    dt_show_times_f(&start, "[pixelpipe_shared_cache]", "wrote %iMB to disk",
+                    _to_mb(size));
+  }
+  g_free(tmp);
+  g_free(path);
+}
+
+gboolean dt_dev_pixelpipe_shared_cache_get(dt_dev_pixelpipe_t *pipe,
+                                           const dt_hash_t hash,
+                                           const size_t size,
+                                           void **data,
+                                           dt_iop_buffer_dsc_t **dsc,
+                                           const dt_iop_module_t *module)
+{
+  dt_dev_pixelpipe_shared_cache_t *sc = darktable.pipe_shared_cache;
+  if(!sc || hash == DT_INVALID_HASH) return FALSE;
+
+  const dt_hash_t key = _shared_hash(pipe, hash);
+  gboolean hit = FALSE;
+
+  dt_pthread_mutex_lock(&sc->lock);
+  sc->tests++;
+  _shared_line_t *line = g_hash_table_lookup(sc->lines, &key);
+  if(line && line->size == size)
+  {
+    // the line might be evicted by another pipe once we unlock
+    dt_dev_pixelpipe_cache_get(pipe, hash, size, data, dsc, module, FALSE);
+    if(*data)
+    {
+      memcpy(*data, line->data, size);
+      **dsc = line->dsc;
+      g_queue_unlink(&sc->lru, &line->link);
+      g_queue_push_head_link(&sc->lru, &line->link);
+      sc->hits++;
+      hit = TRUE;
+    }
+  }
+  dt_pthread_mutex_unlock(&sc->lock);
+
+  if(!hit && _disk_stage(sc, module)
+     && _disk_read(sc, pipe, hash, key, size, data, dsc, module))
+  {
+    dt_pthread_mutex_lock(&sc->lock);
+    sc->diskhits++;
+    dt_pthread_mutex_unlock(&sc->lock);
+    hit = TRUE;
+  }
+
+  if(hit)
+    dt_print_pipe(DT_DEBUG_PIPE, "shared cache HIT",
+                  pipe, module, DT_DEVICE_NONE, NULL, NULL, "hash=%" PRIx64, hash);
+  return hit;
+}
+
+void dt_dev_pixelpipe_shared_cache_put(dt_dev_pixelpipe_t *pipe,
+                                       const dt_hash_t hash,
+                                       const size_t size,
+                                       const void *data,
+                                       const dt_iop_buffer_dsc_t *dsc,
+                                       const dt_iop_module_t *module)
+{
+  dt_dev_pixelpipe_shared_cache_t *sc = darktable.pipe_shared_cache;
+  if(!sc || !data || hash == DT_INVALID_HASH) return;
+
+  const dt_hash_t key = _shared_hash(pipe, hash);
+  if(_disk_stage(sc, module))
+    _disk_write(sc, pipe, key, size, data, dsc);
+  if(size > sc->memlimit) return;
+
+  dt_pthread_mutex_lock(&sc->lock);
+  const gboolean known = g_hash_table_contains(sc->lines, &key);
+  dt_pthread_mutex_unlock(&sc->lock);
+  if(known) return;
+
+  // copy outside of the lock, other pipes may want to read meanwhile
+  _shared_line_t *line = g_malloc0(sizeof(_shared_line_t));
+  line->data = dt_alloc_aligned(size);
+  if(!line->data)
+  {
+    g_free(line);
+    return;
+  }
+  memcpy(line->data, data, size);
+  line->hash = key;
+  line->imgid = pipe->image.id;
+  line->size = size;
+  line->dsc = *dsc;
+  line->link.data = line;
+
+  dt_pthread_mutex_lock(&sc->lock);
+  _shared_line_t *old = g_hash_table_lookup(sc->lines, &key);
+  if(old) _shared_line_remove(sc, old);
+  g_hash_table_insert(sc->lines, &line->hash, line);
+  g_queue_push_head_link(&sc->lru, &line->link);
+  sc->allmem += size;
+  while(sc->allmem > sc->memlimit)
+    _shared_line_remove(sc, g_queue_peek_tail_link(&sc->lru)->data);
+  dt_pthread_mutex_unlock(&sc->lock);
+}
+
+void dt_dev_pixelpipe_shared_cache_remove_image(const dt_imgid_t imgid)
+{
+  dt_dev_pixelpipe_shared_cache_t *sc = darktable.pipe_shared_cache;
+  if(!sc) return;
+
+  dt_pthread_mutex_lock(&sc->lock);
+  GList *l = sc->lru.head;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    _shared_line_t *line = l->data;
+    if(line->imgid == imgid) _shared_line_remove(sc, line);
+    l = next;
+  }
+  dt_pthread_mutex_unlock(&sc->lock);
 }
 
 // clang-format off
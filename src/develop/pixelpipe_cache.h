@@ -22,6 +22,7 @@
 
 struct dt_dev_pixelpipe_t;
 struct dt_iop_buffer_dsc_t;
+struct dt_iop_module_t;
 struct dt_iop_roi_t;
 
 /**
@@ -49,6 +50,14 @@ typedef struct dt_dev_pixelpipe_cache_t
   uint32_t lused;
   uint32_t linvalid;
   uint32_t limportant;
+  uint64_t evicted_lines;  // valid lines recycled for a new buffer
+  uint64_t evicted_mem;    // bytes of valid lines freed to stay below memlimit
+  // runtime adaptation of entries and memlimit within the given bounds
+  gboolean adaptive;
+  int32_t min_entries, max_entries;
+  size_t min_memlimit, max_memlimit;
+  uint32_t adapt_runs;
+  uint64_t adapt_tests, adapt_hits, adapt_evicted_lines, adapt_evicted_mem;
 } dt_dev_pixelpipe_cache_t;
 
 typedef enum dt_dev_pixelpipe_cache_test_t
@@ -92,10 +101,42 @@ void dt_dev_pixelpipe_important_cacheline(const struct dt_dev_pixelpipe_t *pipe,
 /** mark the given cache line as invalid or to be ignored */
 void dt_dev_pixelpipe_invalidate_cacheline(const struct dt_dev_pixelpipe_t *pipe, const void *data);
 
-/** print out cache lines/hashes and do a cache cleanup */
+/** print out cache lines/hashes and do a cache cleanup.
+  The report also prints a single line of json prefixed by [pipe cache stats] for scripts.
+  checkmem adapts line count and memlimit of adaptive caches from the hit rate, evictions
+  and free system memory every few runs.
+*/
 void dt_dev_pixelpipe_cache_report(struct dt_dev_pixelpipe_t *pipe);
 void dt_dev_pixelpipe_cache_checkmem(struct dt_dev_pixelpipe_t *pipe);
 
+/** process-wide cache of early pipe stages shared by all pipes of all images.
+  Lines are keyed by the pipe cache hash plus the input dimensions and are evicted
+  least recently used first. Enabled by a non-zero pixelpipe_shared_cache_mb.
+  With a non-zero pixelpipe_disk_cache_mb the demosaic and colorin outputs are also
+  kept in the cache dir, so later runs of darktable can start from them.
+*/
+void dt_dev_pixelpipe_shared_cache_init(void);
+void dt_dev_pixelpipe_shared_cache_cleanup(void);
+
+/** TRUE if the output of module in pipe may be taken from or stored into the shared cache */
+gboolean dt_dev_pixelpipe_shared_cache_wanted(struct dt_dev_pixelpipe_t *pipe,
+                                              const struct dt_iop_module_t *module);
+
+/** on a hit, copies the shared line into a fresh cacheline of pipe returned in data and dsc */
+gboolean dt_dev_pixelpipe_shared_cache_get(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash,
+                                           const size_t size, void **data,
+                                           struct dt_iop_buffer_dsc_t **dsc,
+                                           const struct dt_iop_module_t *module);
+
+/** stores a copy of a processed output in host memory and possibly on disk */
+void dt_dev_pixelpipe_shared_cache_put(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash,
+                                       const size_t size, const void *data,
+                                       const struct dt_iop_buffer_dsc_t *dsc,
+                                       const struct dt_iop_module_t *module);
+
+/** drops all lines of an image, its id might be given to another one */
+void dt_dev_pixelpipe_shared_cache_remove_image(const dt_imgid_t imgid);
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -22,6 +22,8 @@
 #include "common/opencl.h"
 #include "common/iop_order.h"
 #include "common/imagebuf.h"
+#include "common/metrics.h"
+#include "common/trace.h"
 #include "control/control.h"
 #include "control/signal.h"
 #include "develop/blend.h"
@@ -248,6 +250,10 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
   pipe->backbuf = NULL;
   pipe->backbuf_scale = 0.0f;
   memset(pipe->backbuf_zoom_pos, 0, sizeof(dt_dev_zoom_pos_t));
+  pipe->backbuf_x = pipe->backbuf_y = 0;
+  pipe->coarse = FALSE;
+  pipe->strip_out = NULL;
+  pipe->strip_stride = 0;
   pipe->output_imgid = NO_IMGID;
 
   memset(&pipe->scharr, 0, sizeof(dt_dev_detail_mask_t));
@@ -277,13 +283,19 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
   pipe->runs = 0;
   pipe->bcache_data = NULL;
   pipe->bcache_hash = DT_INVALID_HASH;
+  pipe->node_stats = NULL;
+  pipe->host_downloads = pipe->host_uploads = 0;
   return dt_dev_pixelpipe_cache_init(pipe, entries, size, memlimit);
 }
 
 size_t dt_get_available_pipe_mem(const dt_dev_pixelpipe_t *pipe)
 {
   const size_t allmem = dt_get_available_mem();
-  return MAX(DT_MEGA, allmem / (pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL ? 3 : 1));
+  // concurrent export jobs share the budget
+  const int exports = pipe->type & DT_DEV_PIXELPIPE_EXPORT && darktable.control
+    ? MAX(1, dt_atomic_get_int(&darktable.control->export_scheduled))
+    : 1;
+  return MAX(DT_MEGA, allmem / (pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL ? 3 : exports));
 }
 
 static void get_output_format(dt_iop_module_t *module,
@@ -757,21 +769,43 @@ static void _dump_pipe_pfm_diff(const char *mod,
   dt_free_align(mixed);
 }
 
-// helper to get per module histogram
-static void _histogram_collect(dt_dev_pixelpipe_iop_t *piece,
-                               const void *pixel,
-                               const dt_iop_roi_t *roi,
-                               uint32_t **histogram,
-                               uint32_t *histogram_max)
+// the statistics of a module input or output only change with the
+// buffer, identified by its pixelpipe cache hash, and with what is
+// collected from it. In masking mode the hash does not describe the
+// buffer content, there are no reusable statistics then.
+static inline gboolean _pipe_stats_cacheable(const dt_dev_pixelpipe_t *pipe)
 {
-  dt_dev_histogram_collection_params_t histogram_params = piece->histogram_params;
+  return pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE
+      && !pipe->nocache;
+}
 
-  dt_histogram_roi_t histogram_roi;
+static dt_hash_t _histogram_hash(dt_dev_pixelpipe_iop_t *piece,
+                                 const dt_dev_histogram_collection_params_t *params,
+                                 const dt_iop_colorspace_type_t cst,
+                                 const dt_iop_roi_t *roi)
+{
+  if(!_pipe_stats_cacheable(piece->pipe))
+    return DT_INVALID_HASH;
+
+  const dt_iop_module_t *module = piece->module;
+  dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi, FALSE);
+  hash = dt_hash(hash, params->roi, sizeof(dt_histogram_roi_t));
+  hash = dt_hash(hash, &params->bins_count, sizeof(params->bins_count));
+  hash = dt_hash(hash, &cst, sizeof(cst));
+  hash = dt_hash(hash, &module->histogram_cst, sizeof(module->histogram_cst));
+  return dt_hash(hash, &module->histogram_middle_grey, sizeof(module->histogram_middle_grey));
+}
 
-  // if the current module does did not specified its own ROI, use the full ROI
-  if(histogram_params.roi == NULL)
+// if the current module did not specify its own ROI, use the full ROI
+static void _histogram_params(dt_dev_pixelpipe_iop_t *piece,
+                              const dt_iop_roi_t *roi,
+                              dt_dev_histogram_collection_params_t *histogram_params,
+                              dt_histogram_roi_t *histogram_roi)
+{
+  *histogram_params = piece->histogram_params;
+  if(histogram_params->roi == NULL)
   {
-    histogram_roi = (dt_histogram_roi_t){
+    *histogram_roi = (dt_histogram_roi_t){
       .width = roi->width,
       .height = roi->height,
       .crop_x = 0,
@@ -780,12 +814,43 @@ static void _histogram_collect(dt_dev_pixelpipe_iop_t *piece,
       .crop_bottom = 0
     };
 
-    histogram_params.roi = &histogram_roi;
+    histogram_params->roi = histogram_roi;
   }
+}
+
+static inline gboolean _histogram_valid(const dt_dev_pixelpipe_iop_t *piece,
+                                        const dt_hash_t hash,
+                                        uint32_t *const *histogram)
+{
+  const gboolean valid = *histogram
+    && hash != DT_INVALID_HASH
+    && hash == piece->histogram_hash;
+  if(valid)
+    dt_print_pipe(DT_DEBUG_PIPE,
+                  "histogram: from cache",
+                  piece->pipe, piece->module, DT_DEVICE_NONE, NULL, NULL);
+  return valid;
+}
+
+// helper to get per module histogram
+static void _histogram_collect(dt_dev_pixelpipe_iop_t *piece,
+                               const void *pixel,
+                               const dt_iop_roi_t *roi,
+                               uint32_t **histogram,
+                               uint32_t *histogram_max)
+{
+  dt_dev_histogram_collection_params_t histogram_params;
+  dt_histogram_roi_t histogram_roi;
+  _histogram_params(piece, roi, &histogram_params, &histogram_roi);
 
   const dt_iop_colorspace_type_t cst =
     piece->module->input_colorspace(piece->module, piece->pipe, piece);
 
+  const dt_hash_t hash = _histogram_hash(piece, &histogram_params, cst, roi);
+  if(_histogram_valid(piece, hash, histogram))
+    return;
+
+  piece->histogram_hash = hash;
   dt_histogram_helper(&histogram_params, &piece->histogram_stats, cst,
                       piece->module->histogram_cst,
                       pixel, histogram, histogram_max,
@@ -808,6 +873,18 @@ static void _histogram_collect_cl(const int devid,
                                   float *buffer,
                                   const size_t bufsize)
 {
+  dt_dev_histogram_collection_params_t histogram_params;
+  dt_histogram_roi_t histogram_roi;
+  _histogram_params(piece, roi, &histogram_params, &histogram_roi);
+
+  const dt_iop_colorspace_type_t cst =
+    piece->module->input_colorspace(piece->module, piece->pipe, piece);
+
+  // an unchanged input does not need to be copied from the device again
+  const dt_hash_t hash = _histogram_hash(piece, &histogram_params, cst, roi);
+  if(_histogram_valid(piece, hash, histogram))
+    return;
+
   float *tmpbuf = NULL;
   float *pixel = NULL;
 
@@ -826,28 +903,7 @@ static void _histogram_collect_cl(const int devid,
     return;
   }
 
-  dt_dev_histogram_collection_params_t histogram_params = piece->histogram_params;
-
-  dt_histogram_roi_t histogram_roi;
-
-  // if the current module does did not specified its own ROI, use the full ROI
-  if(histogram_params.roi == NULL)
-  {
-    histogram_roi = (dt_histogram_roi_t){
-      .width = roi->width,
-      .height = roi->height,
-      .crop_x = 0,
-      .crop_y = 0,
-      .crop_right = 0,
-      .crop_bottom = 0
-    };
-
-    histogram_params.roi = &histogram_roi;
-  }
-
-  const dt_iop_colorspace_type_t cst =
-    piece->module->input_colorspace(piece->module, piece->pipe, piece);
-
+  piece->histogram_hash = hash;
   dt_histogram_helper(&histogram_params, &piece->histogram_stats,
                       cst, piece->module->histogram_cst,
                       pixel, histogram, histogram_max,
@@ -859,6 +915,56 @@ static void _histogram_collect_cl(const int devid,
 #endif
 
 
+static dt_hash_t _picker_hash(dt_dev_pixelpipe_iop_t *piece,
+                              const dt_iop_buffer_dsc_t *dsc,
+                              const dt_iop_roi_t *roi,
+                              const int *const box,
+                              const dt_iop_colorspace_type_t image_cst,
+                              const dt_pixelpipe_picker_source_t picker_source)
+{
+  if(!_pipe_stats_cacheable(piece->pipe))
+    return DT_INVALID_HASH;
+
+  const dt_iop_colorspace_type_t picker_cst =
+    dt_iop_color_picker_get_active_cst(piece->module);
+  const gboolean denoise = darktable.lib->proxy.colorpicker.primary_sample->denoise;
+  dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi,
+                                               picker_source == PIXELPIPE_PICKER_OUTPUT);
+  hash = dt_hash(hash, box, 4 * sizeof(int));
+  hash = dt_hash(hash, &dsc->channels, sizeof(dsc->channels));
+  hash = dt_hash(hash, &dsc->filters, sizeof(dsc->filters));
+  hash = dt_hash(hash, &image_cst, sizeof(image_cst));
+  hash = dt_hash(hash, &picker_cst, sizeof(picker_cst));
+  return dt_hash(hash, &denoise, sizeof(denoise));
+}
+
+// reuse the statistics of the previous run if they were read from the same data
+static gboolean _picker_from_cache(dt_dev_pixelpipe_iop_t *piece,
+                                   const dt_hash_t hash,
+                                   const dt_pixelpipe_picker_source_t picker_source,
+                                   lib_colorpicker_stats pick)
+{
+  if(hash == DT_INVALID_HASH || hash != piece->picker_hash[picker_source])
+    return FALSE;
+
+  memcpy(pick, piece->picker_stats[picker_source], sizeof(lib_colorpicker_stats));
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_PICKER,
+                picker_source == PIXELPIPE_PICKER_INPUT
+                  ? "pixelpipe IN picker"
+                  : "pixelpipe OUT picker",
+                piece->pipe, piece->module, DT_DEVICE_NONE, NULL, NULL, "from cache");
+  return TRUE;
+}
+
+static void _picker_to_cache(dt_dev_pixelpipe_iop_t *piece,
+                             const dt_hash_t hash,
+                             const dt_pixelpipe_picker_source_t picker_source,
+                             lib_colorpicker_stats pick)
+{
+  memcpy(piece->picker_stats[picker_source], pick, sizeof(lib_colorpicker_stats));
+  piece->picker_hash[picker_source] = hash;
+}
+
 // color picking for module
 // FIXME: make called with: lib_colorpicker_sample_statistics pick
 static void _pixelpipe_picker(dt_iop_module_t *module,
@@ -879,7 +985,11 @@ static void _pixelpipe_picker(dt_iop_module_t *module,
     dt_color_picker_box(module, roi,
                         darktable.lib->proxy.colorpicker.primary_sample,
                         picker_source, box);
-  if(!nobox)
+  const dt_hash_t hash = nobox
+    ? DT_INVALID_HASH
+    : _picker_hash(piece, dsc, roi, box, image_cst, picker_source);
+
+  if(!nobox && !_picker_from_cache(piece, hash, picker_source, pick))
   {
     const dt_iop_order_iccprofile_info_t *const profile =
       dt_ioppr_get_pipe_current_profile_info(module, piece->pipe);
@@ -903,6 +1013,7 @@ static void _pixelpipe_picker(dt_iop_module_t *module,
                            darktable.lib->proxy.colorpicker.primary_sample->denoise,
                            pick, image_cst,
                            dt_iop_color_picker_get_active_cst(module), profile);
+    _picker_to_cache(piece, hash, picker_source, pick);
   }
 
   for_four_channels(k)
@@ -953,6 +1064,21 @@ static void _pixelpipe_picker_cl(const int devid,
     return;
   }
 
+  lib_colorpicker_stats pick;
+
+  // an unchanged box is not read from the device again
+  const dt_hash_t hash = _picker_hash(piece, dsc, roi, box, image_cst, picker_source);
+  if(_picker_from_cache(piece, hash, picker_source, pick))
+  {
+    for_four_channels(k)
+    {
+      picked_color_min[k] = pick[DT_PICK_MIN][k];
+      picked_color_max[k] = pick[DT_PICK_MAX][k];
+      picked_color[k] = pick[DT_PICK_MEAN][k];
+    }
+    return;
+  }
+
   const size_t origin[3] = { box[0], box[1], 0 };
   const size_t region[3] = { box[2] - box[0], box[3] - box[1], 1 };
 
@@ -1004,8 +1130,6 @@ static void _pixelpipe_picker_cl(const int devid,
   box[2] = region[0];
   box[3] = region[1];
 
-  lib_colorpicker_stats pick;
-
   const dt_iop_order_iccprofile_info_t *const profile =
     dt_ioppr_get_pipe_current_profile_info(module, piece->pipe);
 
@@ -1013,6 +1137,7 @@ static void _pixelpipe_picker_cl(const int devid,
                          darktable.lib->proxy.colorpicker.primary_sample->denoise,
                          pick, image_cst,
                          dt_iop_color_picker_get_active_cst(module), profile);
+  _picker_to_cache(piece, hash, picker_source, pick);
 
   for_four_channels(k)
   {
@@ -1246,6 +1371,11 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
   if(dt_pipe_shutdown(pipe))
     return TRUE;
 
+#ifdef _OPENMP
+  // jobs started or finished meanwhile change our share of the cores
+  omp_set_num_threads(dt_control_worker_threads_share());
+#endif
+
   // the data buffers must always have an alignment to DT_CACHELINE_BYTES
   if(!dt_check_aligned(input) || !dt_check_aligned(*output))
   {
@@ -1531,6 +1661,726 @@ static inline gboolean _skip_piece_on_tags(const dt_dev_pixelpipe_iop_t *piece)
           && (piece->pipe->type & DT_DEV_PIXELPIPE_BASIC);
 }
 
+static dt_dev_pixelpipe_node_stats_t *_add_node_stats(dt_dev_pixelpipe_t *pipe,
+                                                      const dt_iop_module_t *module,
+                                                      const double clock,
+                                                      const dt_pixelpipe_flow_t pixelpipe_flow,
+                                                      const gboolean from_cache)
+{
+  dt_dev_pixelpipe_node_stats_t stats = { .multi_priority = module->multi_priority,
+                                          .clock = clock,
+                                          .on_gpu = (pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU) != 0,
+                                          .tiling = (pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING) != 0,
+                                          .from_cache = from_cache };
+  g_strlcpy(stats.op, module->op, sizeof(stats.op));
+  g_array_append_val(pipe->node_stats, stats);
+  return &g_array_index(pipe->node_stats, dt_dev_pixelpipe_node_stats_t,
+                        pipe->node_stats->len - 1);
+}
+
+static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
+                                           dt_develop_t *dev,
+                                           void **output,
+                                           void **cl_mem_output,
+                                           dt_iop_buffer_dsc_t **out_format,
+                                           const dt_iop_roi_t *roi_out,
+                                           GList *modules,
+                                           GList *pieces,
+                                           const int pos);
+
+// strip height such that all threads work on a strip that stays in their caches
+#define DT_PIPE_STRIP_BYTES_PER_THREAD (512 * 1024)
+
+typedef struct _fused_node_t
+{
+  dt_iop_module_t *module;
+  dt_dev_pixelpipe_iop_t *piece;
+  int pos;
+  dt_iop_buffer_dsc_t dsc;  // pipe->dsc as the module saw it on the first strip
+  double clock;
+} _fused_node_t;
+
+// can this piece be part of a fused run of point-wise modules?
+static gboolean _piece_fusable(dt_dev_pixelpipe_t *pipe,
+                               dt_iop_module_t *module,
+                               dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_develop_blend_params_t *bp = piece->blendop_data;
+  return (module->flags() & IOP_FLAGS_POINTWISE)
+    && (pipe->type & DT_DEV_PIXELPIPE_EXPORT)
+    && pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE
+    && !(bp && bp->mask_mode != DEVELOP_MASK_DISABLED)
+    && !(piece->request_histogram & DT_REQUEST_ON)
+    && !dt_dev_pixelpipe_shared_cache_wanted(pipe, module)
+#ifdef HAVE_OPENCL
+    && !_opencl_pipe_isok(pipe)
+#endif
+    && !darktable.dump_pfm_pipe
+    && !darktable.bench_module
+    && !(darktable.unmuted & DT_DEBUG_NAN);
+}
+
+/* Consecutive point-wise modules ending with module are run back to back on
+   row strips, only the output of the last one is a full buffer. Returns TRUE
+   on shutdown or error like _dev_pixelpipe_process_rec(), *fused tells if
+   the run did happen.
+*/
+static gboolean _dev_pixelpipe_process_fused(dt_dev_pixelpipe_t *pipe,
+                                             dt_develop_t *dev,
+                                             void **output,
+                                             dt_iop_buffer_dsc_t **out_format,
+                                             const dt_iop_roi_t *roi_out,
+                                             GList *modules,
+                                             GList *pieces,
+                                             const int pos,
+                                             const dt_hash_t hash,
+                                             const size_t bufsize,
+                                             gboolean *fused)
+{
+  *fused = FALSE;
+
+  // collect the run backwards, skipped pieces in between are left out
+  GList *nodes = NULL;
+  GList *first_m = modules, *first_p = pieces;
+  int first_pos = pos;
+  int npos = pos;
+  for(GList *m = modules, *p = pieces; m && p;
+      m = g_list_previous(m), p = g_list_previous(p), npos--)
+  {
+    dt_dev_pixelpipe_iop_t *piece = p->data;
+    if(m != modules && _skip_piece_on_tags(piece)) continue;
+    if(!_piece_fusable(pipe, m->data, piece)) break;
+
+    _fused_node_t *node = g_malloc0(sizeof(_fused_node_t));
+    node->module = m->data;
+    node->piece = piece;
+    node->pos = npos;
+    nodes = g_list_prepend(nodes, node);
+    first_m = m;
+    first_p = p;
+    first_pos = npos;
+  }
+
+  const int count = g_list_length(nodes);
+  if(count < 2)
+  {
+    g_list_free_full(nodes, g_free);
+    return FALSE;
+  }
+  *fused = TRUE;
+
+  for(GList *n = nodes; n; n = g_list_next(n))
+  {
+    _fused_node_t *node = n->data;
+    node->piece->processed_roi_in = node->piece->processed_roi_out = *roi_out;
+  }
+
+  void *input = NULL;
+  void *cl_mem_input = NULL;
+  dt_iop_buffer_dsc_t _input_format = { 0 };
+  dt_iop_buffer_dsc_t *input_format = &_input_format;
+  if(_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, roi_out,
+                                g_list_previous(first_m),
+                                g_list_previous(first_p), first_pos - 1))
+  {
+    g_list_free_full(nodes, g_free);
+    return TRUE;
+  }
+
+  const dt_iop_module_t *last = modules->data;
+  dt_dev_pixelpipe_cache_get(pipe, hash, bufsize, output, out_format, last, FALSE);
+
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(input_format);
+  const size_t bpp = 4 * sizeof(float);
+  // anything but full color pixels goes through as one strip
+  const int rows = in_bpp == bpp
+    ? CLAMP(DT_PIPE_STRIP_BYTES_PER_THREAD * dt_get_num_threads() / (bpp * width), 1, height)
+    : height;
+
+  float *strips[2] = { dt_alloc_align_float((size_t)4 * width * rows),
+                       count > 2 ? dt_alloc_align_float((size_t)4 * width * rows) : NULL };
+  // input converted to the first module's colorspace, see below
+  float *converted = NULL;
+  gboolean err = !*output || !strips[0] || (count > 2 && !strips[1]);
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  const dt_iop_order_iccprofile_info_t *const work_profile =
+    (input_format->cst != IOP_CS_RAW)
+      ? dt_ioppr_get_pipe_work_profile_info(pipe)
+      : NULL;
+
+  dt_print_pipe(DT_DEBUG_PIPE,
+                "process fused", pipe, last, DT_DEVICE_CPU, roi_out, roi_out,
+                "%d modules from `%s', %d strips of %d rows",
+                count, ((_fused_node_t *)nodes->data)->module->op,
+                (height + rows - 1) / rows, rows);
+
+  for(int y = 0; y < height && !err; y += rows)
+  {
+    dt_iop_roi_t strip = *roi_out;
+    strip.y += y;
+    strip.height = MIN(rows, height - y);
+
+    float *in = (float *)input + (size_t)y * width * in_bpp / sizeof(float);
+    int cst = input_format->cst;
+    int k = 0;
+    for(GList *n = nodes; n; n = g_list_next(n), k++)
+    {
+      _fused_node_t *node = n->data;
+      dt_iop_module_t *module = node->module;
+      dt_dev_pixelpipe_iop_t *piece = node->piece;
+      float *out = n->next ? strips[k & 1] : (float *)*output + (size_t)4 * y * width;
+
+      // the modules may change pipe->dsc while processing, every strip has to
+      // start from the same state
+      if(y == 0)
+      {
+        piece->dsc_in = k ? pipe->dsc : *input_format;
+        piece->dsc_out = piece->dsc_in;
+        module->output_format(module, pipe, piece, &piece->dsc_out);
+        pipe->dsc = node->dsc = piece->dsc_out;
+        module->position = node->pos;
+      }
+      else
+        pipe->dsc = node->dsc;
+
+      const int cst_to = module->input_colorspace(module, pipe, piece);
+      if(k == 0 && cst != cst_to && in_bpp == bpp)
+      {
+        // the input is the upstream cacheline, it must stay in the colorspace
+        // of its descriptor so the conversion goes to a private strip
+        if(!converted) converted = dt_alloc_align_float((size_t)4 * width * rows);
+        if(!converted)
+        {
+          err = TRUE;
+          break;
+        }
+        dt_ioppr_transform_image_colorspace(module, in, converted, width, strip.height,
+                                            cst, cst_to, &cst, work_profile);
+        in = converted;
+      }
+      else
+        dt_ioppr_transform_image_colorspace(module, in, in, width, strip.height,
+                                            cst, cst_to, &cst, work_profile);
+
+      const double clock = dt_get_wtime();
+      module->process(module, piece, in, out, &strip, &strip);
+      node->clock += dt_get_wtime() - clock;
+
+      pipe->dsc.cst = cst = module->output_colorspace(module, pipe, piece);
+      piece->dsc_out = pipe->dsc;
+      in = out;
+
+      if(dt_pipe_shutdown(pipe))
+      {
+        err = TRUE;
+        break;
+      }
+    }
+  }
+
+  dt_free_align(strips[0]);
+  dt_free_align(strips[1]);
+  dt_free_align(converted);
+
+  if(!err)
+  {
+    **out_format = pipe->dsc;
+    dt_show_times_f(&start, "[dev_pixelpipe]", "[%s] processed %d fused modules up to `%s%s' on CPU",
+                    dt_dev_pixelpipe_type_to_str(pipe->type), count,
+                    last->op, dt_iop_get_instance_id(last));
+    if(pipe->node_stats)
+      for(GList *n = nodes; n; n = g_list_next(n))
+      {
+        const _fused_node_t *node = n->data;
+        _add_node_stats(pipe, node->module, node->clock, PIXELPIPE_FLOW_PROCESSED_ON_CPU, FALSE);
+      }
+  }
+  else if(*output)
+    dt_dev_pixelpipe_invalidate_cacheline(pipe, *output);
+
+  g_list_free_full(nodes, g_free);
+  return err || _module_pipe_stop(pipe, input);
+}
+
+typedef struct _tile_group_node_t
+{
+  dt_iop_module_t *module;
+  dt_dev_pixelpipe_iop_t *piece;
+  int pos;
+  dt_develop_tiling_t tiling;
+  dt_iop_buffer_dsc_t dsc;  // pipe->dsc as the module saw it on the first tile
+  double clock;
+} _tile_group_node_t;
+
+// can this piece be part of a tile group, a run of modules processed tile by tile?
+static gboolean _piece_tile_groupable(dt_dev_pixelpipe_t *pipe,
+                                      dt_iop_module_t *module,
+                                      dt_dev_pixelpipe_iop_t *piece,
+                                      const dt_iop_roi_t *roi)
+{
+  const dt_develop_blend_params_t *bp = piece->blendop_data;
+  if(!((module->flags() & IOP_FLAGS_ALLOW_TILING)
+       && (pipe->type & DT_DEV_PIXELPIPE_EXPORT)
+       && pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE
+       && !(bp && bp->mask_mode != DEVELOP_MASK_DISABLED)
+       && !(piece->request_histogram & DT_REQUEST_ON)
+       && !dt_dev_pixelpipe_shared_cache_wanted(pipe, module)
+#ifdef HAVE_OPENCL
+       && !_opencl_pipe_isok(pipe)
+#endif
+       && !darktable.dump_pfm_pipe
+       && !darktable.bench_module
+       && !(darktable.unmuted & DT_DEBUG_NAN)
+       && module->input_colorspace(module, pipe, piece) != IOP_CS_RAW))
+    return FALSE;
+
+  // just like pixel to pixel tiling this needs modules keeping the roi
+  dt_iop_roi_t roi_in = *roi;
+  module->modify_roi_in(module, piece, roi, &roi_in);
+  return !memcmp(&roi_in, roi, sizeof(dt_iop_roi_t));
+}
+
+/* Consecutive tileable modules ending with module, at least one of them too large for
+   the host memory, run tile by tile through the whole group. The tiles carry the overlap
+   of all modules, only the output of the last one is a full buffer. Returns TRUE on
+   shutdown or error like _dev_pixelpipe_process_rec(), *grouped tells if the run did happen.
+*/
+static gboolean _dev_pixelpipe_process_tile_group(dt_dev_pixelpipe_t *pipe,
+                                                  dt_develop_t *dev,
+                                                  void **output,
+                                                  dt_iop_buffer_dsc_t **out_format,
+                                                  const dt_iop_roi_t *roi_out,
+                                                  GList *modules,
+                                                  GList *pieces,
+                                                  const int pos,
+                                                  const dt_hash_t hash,
+                                                  const size_t bufsize,
+                                                  gboolean *grouped)
+{
+  *grouped = FALSE;
+  const size_t bpp = 4 * sizeof(float);
+
+  // collect the group backwards, skipped pieces in between are left out
+  GList *nodes = NULL;
+  GList *first_m = modules, *first_p = pieces;
+  int first_pos = pos;
+  int npos = pos;
+  gboolean too_large = FALSE;
+  for(GList *m = modules, *p = pieces; m && p;
+      m = g_list_previous(m), p = g_list_previous(p), npos--)
+  {
+    dt_iop_module_t *module = m->data;
+    dt_dev_pixelpipe_iop_t *piece = p->data;
+    if(m != modules && _skip_piece_on_tags(piece)) continue;
+    if(!_piece_tile_groupable(pipe, module, piece, roi_out)) break;
+
+    _tile_group_node_t *node = g_malloc0(sizeof(_tile_group_node_t));
+    node->module = module;
+    node->piece = piece;
+    node->pos = npos;
+    module->tiling_callback(module, piece, roi_out, roi_out, &node->tiling);
+    too_large |= !dt_tiling_piece_fits_host_memory(piece, roi_out->width, roi_out->height, bpp,
+                                                   node->tiling.factor, node->tiling.overhead);
+    nodes = g_list_prepend(nodes, node);
+    first_m = m;
+    first_p = p;
+    first_pos = npos;
+  }
+
+  const int count = g_list_length(nodes);
+  int width = roi_out->width;
+  int height = roi_out->height;
+  int overlap = 0;
+  gboolean planned = FALSE;
+  if(count > 1 && too_large)
+  {
+    dt_develop_tiling_t *tilings = g_new(dt_develop_tiling_t, count);
+    int k = 0;
+    for(GList *n = nodes; n; n = g_list_next(n), k++)
+      tilings[k] = ((_tile_group_node_t *)n->data)->tiling;
+    planned = dt_tiling_plan_group(pipe, tilings, count, roi_out, bpp, &width, &height, &overlap);
+    g_free(tilings);
+  }
+  // without a real split the modules rather tile on their own
+  if(!planned || (width >= roi_out->width && height >= roi_out->height))
+  {
+    g_list_free_full(nodes, g_free);
+    return FALSE;
+  }
+  *grouped = TRUE;
+
+  for(GList *n = nodes; n; n = g_list_next(n))
+  {
+    _tile_group_node_t *node = n->data;
+    node->piece->processed_roi_in = node->piece->processed_roi_out = *roi_out;
+  }
+
+  void *input = NULL;
+  void *cl_mem_input = NULL;
+  dt_iop_buffer_dsc_t _input_format = { 0 };
+  dt_iop_buffer_dsc_t *input_format = &_input_format;
+  if(_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, roi_out,
+                                g_list_previous(first_m),
+                                g_list_previous(first_p), first_pos - 1))
+  {
+    g_list_free_full(nodes, g_free);
+    return TRUE;
+  }
+
+  const dt_iop_module_t *last = modules->data;
+  dt_dev_pixelpipe_cache_get(pipe, hash, bufsize, output, out_format, last, FALSE);
+
+  const size_t full_wd = roi_out->width;
+  const int tile_wd = width - 2 * overlap > 0 ? width - 2 * overlap : 1;
+  const int tile_ht = height - 2 * overlap > 0 ? height - 2 * overlap : 1;
+  const int tiles_x = width < roi_out->width ? ceilf(roi_out->width / (float)tile_wd) : 1;
+  const int tiles_y = height < roi_out->height ? ceilf(roi_out->height / (float)tile_ht) : 1;
+
+  float *tiles[2] = { dt_alloc_align_float((size_t)4 * width * height),
+                      dt_alloc_align_float((size_t)4 * width * height) };
+  gboolean err = !*output || !tiles[0] || !tiles[1]
+    || dt_iop_buffer_dsc_to_bpp(input_format) != bpp;
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  const dt_iop_order_iccprofile_info_t *const work_profile =
+    dt_ioppr_get_pipe_work_profile_info(pipe);
+
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_TILING,
+                "process tile group", pipe, last, DT_DEVICE_CPU, roi_out, roi_out,
+                "%d modules from `%s', %dx%d tiles with max dimensions %dx%d and overlap %d",
+                count, ((_tile_group_node_t *)nodes->data)->module->op,
+                tiles_x, tiles_y, width, height, overlap);
+
+  pipe->tiling = TRUE;
+  gboolean first_tile = TRUE;
+  for(size_t tx = 0; tx < tiles_x && !err; tx++)
+  {
+    const size_t wd = tx * tile_wd + width > roi_out->width ? roi_out->width - tx * tile_wd : width;
+    for(size_t ty = 0; ty < tiles_y && !err; ty++)
+    {
+      const size_t ht = ty * tile_ht + height > roi_out->height ? roi_out->height - ty * tile_ht : height;
+
+      /* no need to process end-tiles that are smaller than the total overlap area */
+      if((wd <= 2 * overlap && tx > 0) || (ht <= 2 * overlap && ty > 0)) continue;
+
+      const dt_iop_roi_t troi = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht,
+                                  wd, ht, roi_out->scale };
+      const size_t offs = 4 * ((ty * tile_ht) * full_wd + tx * tile_wd);
+
+      float *in = tiles[0];
+      DT_OMP_FOR()
+      for(size_t j = 0; j < ht; j++)
+        memcpy(in + 4 * j * wd, (float *)input + offs + 4 * j * full_wd, sizeof(float) * 4 * wd);
+
+      int cst = input_format->cst;
+      int k = 0;
+      for(GList *n = nodes; n; n = g_list_next(n), k++)
+      {
+        _tile_group_node_t *node = n->data;
+        dt_iop_module_t *module = node->module;
+        dt_dev_pixelpipe_iop_t *piece = node->piece;
+        float *out = tiles[(k + 1) & 1];
+
+        // the modules may change pipe->dsc while processing, every tile has to
+        // start from the same state
+        if(first_tile)
+        {
+          piece->dsc_in = k ? pipe->dsc : *input_format;
+          piece->dsc_out = piece->dsc_in;
+          module->output_format(module, pipe, piece, &piece->dsc_out);
+          pipe->dsc = node->dsc = piece->dsc_out;
+          module->position = node->pos;
+        }
+        else
+          pipe->dsc = node->dsc;
+
+        const int cst_to = module->input_colorspace(module, pipe, piece);
+        dt_ioppr_transform_image_colorspace(module, in, in, wd, ht,
+                                            cst, cst_to, &cst, work_profile);
+
+        const double clock = dt_get_wtime();
+        module->process(module, piece, in, out, &troi, &troi);
+        node->clock += dt_get_wtime() - clock;
+
+        pipe->dsc.cst = cst = module->output_colorspace(module, pipe, piece);
+        piece->dsc_out = pipe->dsc;
+        in = out;
+
+        if(dt_pipe_shutdown(pipe))
+        {
+          err = TRUE;
+          break;
+        }
+      }
+      first_tile = FALSE;
+      if(err) break;
+
+      /* only copy back the "good" part of the tile */
+      const size_t ox = tx > 0 ? overlap : 0;
+      const size_t oy = ty > 0 ? overlap : 0;
+      float *const restrict out = (float *)*output + offs;
+      DT_OMP_FOR()
+      for(size_t j = oy; j < ht; j++)
+        memcpy(out + 4 * (j * full_wd + ox), in + 4 * (j * wd + ox), sizeof(float) * 4 * (wd - ox));
+    }
+  }
+  pipe->tiling = FALSE;
+
+  dt_free_align(tiles[0]);
+  dt_free_align(tiles[1]);
+
+  if(!err)
+  {
+    **out_format = pipe->dsc;
+    dt_show_times_f(&start, "[dev_pixelpipe]", "[%s] processed a tile group of %d modules up to `%s%s' on CPU",
+                    dt_dev_pixelpipe_type_to_str(pipe->type), count,
+                    last->op, dt_iop_get_instance_id(last));
+    if(pipe->node_stats)
+      for(GList *n = nodes; n; n = g_list_next(n))
+      {
+        const _tile_group_node_t *node = n->data;
+        _add_node_stats(pipe, node->module, node->clock,
+                        PIXELPIPE_FLOW_PROCESSED_ON_CPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING, FALSE);
+      }
+  }
+  else if(*output)
+    dt_dev_pixelpipe_invalidate_cacheline(pipe, *output);
+
+  g_list_free_full(nodes, g_free);
+  return err || _module_pipe_stop(pipe, input);
+}
+
+#ifdef HAVE_OPENCL
+// can this piece take part in a fused raw run on the GPU?
+static gboolean _piece_raw_fusable(dt_dev_pixelpipe_t *pipe,
+                                   dt_iop_module_t *module,
+                                   dt_dev_pixelpipe_iop_t *piece,
+                                   const dt_iop_roi_t *roi_in,
+                                   const dt_iop_roi_t *roi_out)
+{
+  const dt_develop_blend_params_t *bp = piece->blendop_data;
+  return module->raw_pointwise
+    && piece->process_cl_ready
+    && !(bp && bp->mask_mode != DEVELOP_MASK_DISABLED)
+    && !(piece->request_histogram & DT_REQUEST_ON)
+    && !dt_dev_pixelpipe_shared_cache_wanted(pipe, module)
+    && module->raw_pointwise(module, piece, NULL, roi_in, roi_out);
+}
+
+/* In preview and thumbnail pipes the modules from the raw mosaic up to a
+   downscaling demosaic are run as one kernel reading the raw data, none of
+   the full size mosaic buffers in between is written. Returns TRUE on
+   shutdown or error like _dev_pixelpipe_process_rec(), *fused tells if the
+   run did happen.
+*/
+static gboolean _dev_pixelpipe_process_raw_fused_cl(dt_dev_pixelpipe_t *pipe,
+                                                    dt_develop_t *dev,
+                                                    void **output,
+                                                    void **cl_mem_output,
+                                                    dt_iop_buffer_dsc_t **out_format,
+                                                    const dt_iop_roi_t *roi_out,
+                                                    GList *modules,
+                                                    GList *pieces,
+                                                    const int pos,
+                                                    const dt_hash_t hash,
+                                                    const size_t bufsize,
+                                                    gboolean *fused)
+{
+  *fused = FALSE;
+  dt_iop_module_t *last = modules->data;
+  if(!last->process_raw_fused_cl
+     || !_opencl_pipe_isok(pipe)
+     || !(pipe->type & (DT_DEV_PIXELPIPE_PREVIEW | DT_DEV_PIXELPIPE_THUMBNAIL))
+     || pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE
+     || !dt_conf_get_bool("opencl_fused_raw_preview"))
+    return FALSE;
+
+  // collect the run backwards, every module but the first keeps the roi
+  dt_iop_roi_t roi = *roi_out;
+  dt_iop_roi_t mosaic = { 0 };
+  GList *nodes = NULL;
+  gboolean valid = FALSE;
+  int npos = pos;
+  for(GList *m = modules, *p = pieces; m && p;
+      m = g_list_previous(m), p = g_list_previous(p), npos--)
+  {
+    dt_iop_module_t *module = m->data;
+    dt_dev_pixelpipe_iop_t *piece = p->data;
+    if(m != modules && _skip_piece_on_tags(piece)) continue;
+
+    dt_iop_roi_t roi_in;
+    module->modify_roi_in(module, piece, &roi, &roi_in);
+    if(m == modules)
+      mosaic = roi_in;
+    else if(!dt_iop_module_is(module->so, "rawprepare")
+            && memcmp(&roi, &roi_in, sizeof(dt_iop_roi_t)))
+      break;
+
+    if(!_piece_raw_fusable(pipe, module, piece, &roi_in, &roi)) break;
+
+    _fused_node_t *node = g_malloc0(sizeof(_fused_node_t));
+    node->module = module;
+    node->piece = piece;
+    node->pos = npos;
+    piece->processed_roi_in = roi_in;
+    piece->processed_roi_out = roi;
+    nodes = g_list_prepend(nodes, node);
+    roi = roi_in;
+
+    // the run has to start with the module normalizing the raw data
+    if(dt_iop_module_is(module->so, "rawprepare"))
+    {
+      valid = TRUE;
+      break;
+    }
+  }
+
+  if(!valid || g_list_length(nodes) < 2)
+  {
+    g_list_free_full(nodes, g_free);
+    return FALSE;
+  }
+
+  const _fused_node_t *first = nodes->data;
+  GList *first_m = g_list_find(pipe->iop, first->module);
+  GList *first_p = g_list_find(pipe->nodes, first->piece);
+
+  void *input = NULL;
+  void *cl_mem_input = NULL;
+  dt_iop_buffer_dsc_t _input_format = { 0 };
+  dt_iop_buffer_dsc_t *input_format = &_input_format;
+  if(_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, &roi,
+                                g_list_previous(first_m),
+                                g_list_previous(first_p), first->pos - 1))
+  {
+    g_list_free_full(nodes, g_free);
+    return TRUE;
+  }
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  const int devid = pipe->devid;
+  const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(input_format);
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  if(cl_mem_input == NULL)
+  {
+    cl_mem_input = dt_opencl_alloc_device(devid, roi.width, roi.height, in_bpp);
+    if(cl_mem_input
+       && dt_opencl_write_host_to_device(devid, input, cl_mem_input,
+                                         roi.width, roi.height, in_bpp) == CL_SUCCESS)
+      pipe->host_uploads++;
+    else
+    {
+      dt_opencl_release_mem_object(cl_mem_input);
+      cl_mem_input = NULL;
+    }
+  }
+  cl_mem cl_mem_out = cl_mem_input
+    ? dt_opencl_alloc_device(devid, roi_out->width, roi_out->height, 4 * sizeof(float))
+    : NULL;
+
+  // compose the transform, every module updates pipe->dsc as it would do
+  const dt_iop_buffer_dsc_t dsc_saved = pipe->dsc;
+  dt_iop_raw_pointwise_t op = { .prepared = FALSE };
+  for_four_channels(c)
+  {
+    op.mul[c] = 1.0f;
+    op.clip[c] = FLT_MAX;
+  }
+  gboolean composed = cl_mem_out != NULL;
+  int k = 0;
+  for(GList *n = nodes; n && composed; n = g_list_next(n), k++)
+  {
+    _fused_node_t *node = n->data;
+    dt_iop_module_t *module = node->module;
+    dt_dev_pixelpipe_iop_t *piece = node->piece;
+    piece->dsc_in = k ? pipe->dsc : *input_format;
+    piece->dsc_out = piece->dsc_in;
+    module->output_format(module, pipe, piece, &piece->dsc_out);
+    pipe->dsc = piece->dsc_out;
+    module->position = node->pos;
+    composed = module->raw_pointwise(module, piece, &op,
+                                     &piece->processed_roi_in, &piece->processed_roi_out);
+    piece->dsc_out = pipe->dsc;
+  }
+
+  if(composed)
+    err = last->process_raw_fused_cl(last, pieces->data, cl_mem_input, cl_mem_out, &mosaic, roi_out, &op);
+
+  dt_opencl_release_mem_object(cl_mem_input);
+  if(err != CL_SUCCESS)
+  {
+    // leave it to the modules one by one
+    dt_print_pipe(DT_DEBUG_OPENCL | DT_DEBUG_PIPE,
+                  "fused raw failed", pipe, last, devid, &mosaic, roi_out, "%s",
+                  composed ? cl_errstr(err) : "not supported");
+    dt_opencl_release_mem_object(cl_mem_out);
+    pipe->dsc = dsc_saved;
+    g_list_free_full(nodes, g_free);
+    return FALSE;
+  }
+  *fused = TRUE;
+
+  dt_dev_pixelpipe_cache_get(pipe, hash, bufsize, output, out_format, last, FALSE);
+  *cl_mem_output = cl_mem_out;
+  **out_format = pipe->dsc;
+
+  dt_print_pipe(DT_DEBUG_PIPE,
+                "process fused raw", pipe, last, devid, &mosaic, roi_out,
+                "%d modules from `%s'", g_list_length(nodes), first->module->op);
+  dt_show_times_f(&start, "[dev_pixelpipe]", "[%s] processed %d fused raw modules up to `%s%s' on GPU",
+                  dt_dev_pixelpipe_type_to_str(pipe->type), g_list_length(nodes),
+                  last->op, dt_iop_get_instance_id(last));
+  if(pipe->node_stats)
+    for(GList *n = nodes; n; n = g_list_next(n))
+    {
+      const _fused_node_t *node = n->data;
+      _add_node_stats(pipe, node->module, dt_get_wtime() - start.clock,
+                      PIXELPIPE_FLOW_PROCESSED_ON_GPU, FALSE);
+    }
+
+  g_list_free_full(nodes, g_free);
+  return _module_pipe_stop(pipe, input);
+}
+#endif // HAVE_OPENCL
+
+#ifdef HAVE_OPENCL
+/* may the RGBA output of module be kept in a half float image? Both the
+   module and the next enabled one must work on half floats, any other
+   reader still gets full floats but pays for a conversion. */
+static gboolean _half_float_output(dt_dev_pixelpipe_t *pipe,
+                                   dt_iop_module_t *module,
+                                   GList *modules,
+                                   GList *pieces,
+                                   const size_t bpp)
+{
+  if(!darktable.opencl->half_float
+     || bpp != 4 * sizeof(float)
+     || !(module->flags() & IOP_FLAGS_HALF_FLOAT)
+     || pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE
+     || dt_dev_pixelpipe_shared_cache_wanted(pipe, module))
+    return FALSE;
+
+  for(GList *m = g_list_next(modules), *p = g_list_next(pieces);
+      m && p;
+      m = g_list_next(m), p = g_list_next(p))
+  {
+    const dt_dev_pixelpipe_iop_t *next = p->data;
+    if(next->enabled)
+      return (((dt_iop_module_t *)m->data)->flags() & IOP_FLAGS_HALF_FLOAT) != 0;
+  }
+  return FALSE;
+}
+#endif
+
 // recursive helper for process, returns TRUE in case of unfinished work or error
 static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                                            dt_develop_t *dev,
@@ -1628,12 +2478,30 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     dt_print_pipe(DT_DEBUG_PIPE,
                   "pipe data: from cache",
                   pipe, module, DT_DEVICE_NONE, &roi_in, NULL);
+    if(pipe->node_stats && module)
+      _add_node_stats(pipe, module, 0.0, PIXELPIPE_FLOW_NONE, TRUE);
     // we're done! as colorpicker/scopes only work on gamma iop
     // input -- which is unavailable via cache -- there's no need to
     // run these
     return FALSE;
   }
 
+  // another pipe might have done the raw stages of this image already
+  const gboolean shared_cache = dt_dev_pixelpipe_shared_cache_wanted(pipe, module);
+  if(shared_cache
+     && dt_dev_pixelpipe_shared_cache_get(pipe, hash, bufsize, output, out_format, module))
+  {
+    if(dt_pipe_shutdown(pipe))
+      return TRUE;
+
+    dt_print_pipe(DT_DEBUG_PIPE,
+                  "pipe data: from shared cache",
+                  pipe, module, DT_DEVICE_NONE, &roi_in, NULL);
+    if(pipe->node_stats)
+      _add_node_stats(pipe, module, 0.0, PIXELPIPE_FLOW_NONE, TRUE);
+    return FALSE;
+  }
+
   // 2) if history changed or exit event, abort processing?
   // preview pipe: abort on all but zoom events (same buffer anyways)
   // if image has changed, stop now.
@@ -1758,6 +2626,40 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   // 3b) recurse and obtain output array in &input
 
+  // tileable modules of an export that are too large for the memory may run
+  // tile by tile through a whole group
+  if(_piece_tile_groupable(pipe, module, piece, roi_out))
+  {
+    gboolean grouped = FALSE;
+    const gboolean stop = _dev_pixelpipe_process_tile_group(pipe, dev, output, out_format, roi_out,
+                                                            modules, pieces, pos, hash, bufsize,
+                                                            &grouped);
+    if(grouped) return stop;
+  }
+
+  // point-wise modules of an export may run fused on strips
+  if(_piece_fusable(pipe, module, piece))
+  {
+    gboolean fused = FALSE;
+    const gboolean stop = _dev_pixelpipe_process_fused(pipe, dev, output, out_format, roi_out,
+                                                       modules, pieces, pos, hash, bufsize,
+                                                       &fused);
+    if(fused) return stop;
+  }
+
+#ifdef HAVE_OPENCL
+  // the raw end of preview pipes may run fused on the GPU
+  if(module->process_raw_fused_cl)
+  {
+    gboolean fused = FALSE;
+    const gboolean stop = _dev_pixelpipe_process_raw_fused_cl(pipe, dev, output, cl_mem_output,
+                                                              out_format, roi_out, modules,
+                                                              pieces, pos, hash, bufsize,
+                                                              &fused);
+    if(fused || stop) return stop;
+  }
+#endif
+
   // get region of interest which is needed in input
   if(dt_pipe_shutdown(pipe))
     return TRUE;
@@ -1815,8 +2717,22 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   gboolean important_cl = FALSE;
 
+#ifdef HAVE_OPENCL
+  const gboolean cost_model = darktable.opencl->cost_model;
+#else
+  const gboolean cost_model = FALSE;
+#endif
+  // host<->device transfers measured for the cost model
+  double transfer_time = 0.0;
+
   dt_times_t start;
-  dt_get_perf_times(&start);
+  const gboolean trace = dt_trace_enabled();
+  if(pipe->node_stats || cost_model || trace)
+    dt_get_times(&start);
+  else
+    dt_get_perf_times(&start);
+  const size_t rss_start = pipe->node_stats ? dt_get_resident_memory() : 0;
+  const double node_start = dt_get_wtime();
 
   dt_pixelpipe_flow_t pixelpipe_flow =
     (PIXELPIPE_FLOW_NONE | PIXELPIPE_FLOW_HISTOGRAM_NONE);
@@ -1942,10 +2858,18 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
       dt_opencl_image_fits_device(pipe->devid, m_width, m_height,
                                   m_bpp, tiling.factor_cl, tiling.overhead);
 
+    // why the module runs on CPU, reported for the host transfers
+    const char *cpu_reason = !module->process_cl ? "no OpenCL code"
+                           : !piece->process_cl_ready ? "OpenCL not ready"
+                           : "no OpenCL in preview";
+
     if(possible_cl && !fits_on_device)
     {
       if(!_piece_may_tile(piece))
+      {
         possible_cl = FALSE;
+        cpu_reason = "can't tile";
+      }
 
       const float advantage = darktable.opencl->dev[pipe->devid].advantage;
       if(possible_cl && (advantage > 0.0f))
@@ -1962,10 +2886,23 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                    dt_dev_pixelpipe_type_to_str(pipe->type), module->op, pipe->devid,
                    advantage, tilemem_cl / 1e9, tilemem_cpu / 1e9);
           possible_cl = FALSE;
+          cpu_reason = "CPU tiling advantage";
         }
       }
     }
 
+    /* measured costs might show the CPU to be faster, including the
+       transfer of the input from or to the device */
+    if(possible_cl && fits_on_device
+       && dt_opencl_cost_prefer_cpu(pipe->devid, module->op,
+                                    (size_t)roi_out->width * roi_out->height,
+                                    (size_t)roi_in.width * roi_in.height * in_bpp,
+                                    valid_input_on_gpu_only))
+    {
+      possible_cl = FALSE;
+      cpu_reason = "cost model";
+    }
+
     if(possible_cl)
     {
       const int cst_from = input_cst_cl;
@@ -1990,6 +2927,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
           if(success_opencl)
           {
+            const double tstart = cost_model ? dt_get_wtime() : 0.0;
             if(dt_opencl_write_host_to_device(pipe->devid, input, cl_mem_input,
                                               roi_in.width, roi_in.height, in_bpp) != CL_SUCCESS)
             {
@@ -1999,6 +2937,22 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                             "couldn't copy image to OpenCL device");
               success_opencl = FALSE;
             }
+            else
+            {
+              pipe->host_uploads++;
+              if(pipe->host_downloads)
+                dt_print_pipe(DT_DEBUG_OPENCL | DT_DEBUG_PIPE,
+                              "host transfer", pipe, module, pipe->devid, &roi_in, roi_out,
+                              "back to device");
+            }
+
+            if(success_opencl && cost_model)
+            {
+              transfer_time = dt_get_wtime() - tstart;
+              dt_opencl_cost_record_transfer(pipe->devid,
+                                             (size_t)roi_in.width * roi_in.height * in_bpp,
+                                             transfer_time);
+            }
           }
         }
 
@@ -2011,8 +2965,12 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
         /* try to allocate GPU memory for output */
         if(success_opencl)
         {
-          *cl_mem_output = dt_opencl_alloc_device(pipe->devid,
-                                                  roi_out->width, roi_out->height, bpp);
+          *cl_mem_output = _half_float_output(pipe, module, modules, pieces, bpp)
+            ? dt_opencl_alloc_device_half(pipe->devid, roi_out->width, roi_out->height)
+            : NULL;
+          if(*cl_mem_output == NULL)
+            *cl_mem_output = dt_opencl_alloc_device(pipe->devid,
+                                                    roi_out->width, roi_out->height, bpp);
           if(*cl_mem_output == NULL)
           {
             dt_print_pipe(DT_DEBUG_OPENCL | DT_DEBUG_PIPE,
@@ -2618,6 +3576,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
       else
       {
         /* Bad luck, opencl failed. Let's clean up and fall back to cpu module */
+        dt_metrics_inc(DT_METRIC_OPENCL_FALLBACKS);
         dt_print_pipe(DT_DEBUG_OPENCL,
            "pipe aborts", pipe, module, pipe->devid, &roi_in, roi_out, "%s",
                 "couldn't run module on GPU, falling back to CPU");
@@ -2646,6 +3605,11 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
           else
             input_format->cst = input_cst_cl;
 
+          pipe->host_downloads++;
+          dt_print_pipe(DT_DEBUG_OPENCL | DT_DEBUG_PIPE,
+                        "host transfer", pipe, module, pipe->devid, &roi_in, roi_out,
+                        "CPU fallback");
+
           /* this is a good place to release event handles as we
              anyhow need to move from gpu to cpu here */
           dt_opencl_finish(pipe->devid);
@@ -2669,6 +3633,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
       /* cleanup unneeded opencl buffer, and copy back to CPU buffer */
       if(cl_mem_input != NULL)
       {
+        const double tstart = cost_model ? dt_get_wtime() : 0.0;
         if(dt_opencl_copy_device_to_host(pipe->devid, input, cl_mem_input,
                                          roi_in.width, roi_in.height,
                                          in_bpp) != CL_SUCCESS)
@@ -2683,6 +3648,21 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
         else
           input_format->cst = input_cst_cl;
 
+        /* the following modules upload the output again if they can
+           run on the device, so this module is a CPU island */
+        pipe->host_downloads++;
+        dt_print_pipe(DT_DEBUG_OPENCL | DT_DEBUG_PIPE,
+                      "host transfer", pipe, module, pipe->devid, &roi_in, roi_out,
+                      "%s", cpu_reason);
+
+        if(cost_model)
+        {
+          transfer_time = dt_get_wtime() - tstart;
+          dt_opencl_cost_record_transfer(pipe->devid,
+                                         (size_t)roi_in.width * roi_in.height * in_bpp,
+                                         transfer_time);
+        }
+
         /* this is a good place to release event handles as we anyhow
            need to move from gpu to cpu here */
         dt_opencl_finish(pipe->devid);
@@ -2745,6 +3725,55 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
           ? "GPU"
           : pixelpipe_flow & PIXELPIPE_FLOW_BLENDED_ON_CPU ? "CPU" : "");
 
+  dt_metrics_observe_module(module->op, dt_get_wtime() - node_start);
+  if(pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING)
+    dt_metrics_inc(DT_METRIC_TILED_NODES);
+
+  if(pipe->node_stats)
+  {
+    dt_dev_pixelpipe_node_stats_t *stats =
+      _add_node_stats(pipe, module, dt_get_wtime() - start.clock, pixelpipe_flow, FALSE);
+    const size_t m_bytes = (size_t)MAX(roi_in.width, roi_out->width)
+      * MAX(roi_in.height, roi_out->height) * MAX(in_bpp, bpp);
+    if(stats->on_gpu)
+      stats->device_bytes = tiling.factor_cl * m_bytes + tiling.overhead;
+    else
+      stats->host_bytes = tiling.factor * m_bytes + tiling.overhead;
+    const size_t rss = dt_get_resident_memory();
+    stats->rss_delta = (int64_t)rss - (int64_t)rss_start;
+    pipe->rss_peak = MAX(pipe->rss_peak, rss);
+  }
+
+  if(trace)
+  {
+    const gboolean on_gpu = pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU;
+    char name[64];
+    char detail[64];
+    snprintf(name, sizeof(name), "%s%s", module->op, dt_iop_get_instance_id(module));
+    snprintf(detail, sizeof(detail), "%s pipe, %s%s",
+             dt_dev_pixelpipe_type_to_str(pipe->type),
+             on_gpu ? "GPU" : "CPU",
+             pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING ? ", tiled" : "");
+    dt_trace_span("pixelpipe", name, on_gpu ? pipe->devid : DT_TRACE_CPU,
+                  start.clock, dt_get_wtime(), detail);
+  }
+
+#ifdef HAVE_OPENCL
+  /* feed the cost model with untiled runs only, tiling overhead would
+     spoil the per-pixel timing. In async mode the device time is hidden. */
+  if(cost_model && !(pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING))
+  {
+    const double seconds = dt_get_wtime() - start.clock - transfer_time;
+    const size_t pixels = (size_t)roi_out->width * roi_out->height;
+    if(pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_CPU)
+      dt_opencl_cost_record(-1, module->op, pixels, seconds);
+    else if((pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU)
+            && (!darktable.opencl->dev[pipe->devid].asyncmode
+                || (pipe->type & DT_DEV_PIXELPIPE_EXPORT)))
+      dt_opencl_cost_record(pipe->devid, module->op, pixels, seconds);
+  }
+#endif
+
   // in case we get this buffer from the cache in the future, cache some stuff:
   **out_format = piece->dsc_out = pipe->dsc;
 
@@ -2785,6 +3814,13 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     }
   }
 
+  // only host memory can be shared, data kept on the device stays private
+  if(shared_cache
+     && *cl_mem_output == NULL
+     && !pipe->nocache
+     && !dt_pipe_shutdown(pipe))
+    dt_dev_pixelpipe_shared_cache_put(pipe, hash, bufsize, *output, *out_format, module);
+
   // warn on NaN or infinity
   if((darktable.unmuted & DT_DEBUG_NAN)
      && !dt_iop_module_is(module->so, "gamma"))
@@ -2991,18 +4027,52 @@ static gboolean _dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe
   return ret;
 }
 
-gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
-                                  dt_develop_t *dev,
-                                  const int x,
-                                  const int y,
-                                  const int width,
-                                  const int height,
-                                  const float scale,
-                                  const int devid)
+// JSON lines for capacity planning: one per node, then one for the run.
+// The peaks are per node as the pipe keeps only the buffers of
+// neighbouring nodes alive.
+static void _print_memory_report(const dt_dev_pixelpipe_t *pipe,
+                                 const size_t rss_start)
+{
+  const GArray *node_stats = pipe->node_stats;
+  const char *type = dt_dev_pixelpipe_type_to_str(pipe->type);
+  size_t host_peak = 0, device_peak = 0;
+  for(guint k = 0; node_stats && k < node_stats->len; k++)
+  {
+    const dt_dev_pixelpipe_node_stats_t *n =
+      &g_array_index(node_stats, dt_dev_pixelpipe_node_stats_t, k);
+    host_peak = MAX(host_peak, n->host_bytes);
+    device_peak = MAX(device_peak, n->device_bytes);
+    dt_print(DT_DEBUG_MEMORY,
+             "[memory] {\"pipe\":\"%s\",\"image\":%d,\"op\":\"%s\",\"instance\":%d,"
+             "\"on\":\"%s\",\"tiling\":%s,\"cached\":%s,"
+             "\"host_bytes\":%zu,\"device_bytes\":%zu,\"rss_delta\":%" PRId64 "}",
+             type, pipe->image.id, n->op, n->multi_priority, n->on_gpu ? "gpu" : "cpu",
+             n->tiling ? "true" : "false", n->from_cache ? "true" : "false",
+             n->host_bytes, n->device_bytes, n->rss_delta);
+  }
+  const size_t rss_end = dt_get_resident_memory();
+  dt_print(DT_DEBUG_MEMORY,
+           "[memory] {\"pipe\":\"%s\",\"image\":%d,\"width\":%d,\"height\":%d,"
+           "\"host_peak\":%zu,\"device_peak\":%zu,\"cache_bytes\":%zu,"
+           "\"rss_start\":%zu,\"rss_end\":%zu,\"rss_peak\":%zu}",
+           type, pipe->image.id, pipe->final_width, pipe->final_height,
+           host_peak, device_peak, pipe->cache.allmem,
+           rss_start, rss_end, MAX(pipe->rss_peak, rss_end));
+}
+
+static gboolean _dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
+                                       dt_develop_t *dev,
+                                       const int x,
+                                       const int y,
+                                       const int width,
+                                       const int height,
+                                       const float scale,
+                                       const int devid)
 {
   pipe->processing = TRUE;
   pipe->nocache = (pipe->type & DT_DEV_PIXELPIPE_IMAGE) != 0;
   pipe->runs++;
+  dt_metrics_inc(DT_METRIC_PIPE_RUNS);
   pipe->opencl_enabled = dt_opencl_running();
 
   // if devid is a valid CL device we don't lock it as the caller has done so already
@@ -3015,6 +4085,7 @@ gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
     dt_dev_pixelpipe_cache_checkmem(pipe);
 
   if(pipe->devid > DT_DEVICE_CPU) dt_opencl_events_reset(pipe->devid);
+  pipe->host_downloads = pipe->host_uploads = 0;
 
   dt_iop_roi_t roi = (dt_iop_roi_t){ x, y, width, height, scale };
   pipe->final_width = width;
@@ -3033,9 +4104,19 @@ gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
   GList *modules = g_list_last(pipe->iop);
   GList *pieces = g_list_last(pipe->nodes);
 
+  // -d memory reports the nodes of this run, collected as for callers
+  // asking for node_stats
+  GArray *memory_stats = NULL;
+  if((darktable.unmuted & DT_DEBUG_MEMORY) && !pipe->node_stats)
+    memory_stats = pipe->node_stats =
+      g_array_new(FALSE, FALSE, sizeof(dt_dev_pixelpipe_node_stats_t));
+  const size_t rss_start = pipe->node_stats ? dt_get_resident_memory() : 0;
+  pipe->rss_peak = rss_start;
+
 // re-entry point: in case of late opencl errors we start all over
 // again with opencl-support disabled
 restart:
+  if(memory_stats) g_array_set_size(memory_stats, 0);
 
   // check if we should obsolete caches
   if(pipe->cache_obsolete) dt_dev_pixelpipe_cache_flush(pipe);
@@ -3123,6 +4204,7 @@ restart:
     dt_dev_pixelpipe_cache_flush(pipe);
     dt_dev_pixelpipe_change(pipe, dev);
 
+    dt_metrics_inc(DT_METRIC_OPENCL_RESTARTS);
     dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_OPENCL,
       "pipe restarting on CPU", pipe, NULL, old_devid, &roi, &roi, "ID=%i",
       pipe->image.id);
@@ -3137,6 +4219,14 @@ restart:
     pipe->forms = NULL;
   }
 
+  if(darktable.unmuted & DT_DEBUG_MEMORY)
+    _print_memory_report(pipe, rss_start);
+  if(memory_stats)
+  {
+    g_array_free(memory_stats, TRUE);
+    pipe->node_stats = NULL;
+  }
+
   if(pipe->devid > DT_DEVICE_CPU)
   {
     if(!claimed) // only unlock if locked above
@@ -3151,6 +4241,17 @@ restart:
     return TRUE;
   }
 
+  // a strip of an incremental update goes to the caller's buffer
+  if(pipe->strip_out && (pipe->type & DT_DEV_PIXELPIPE_SCREEN))
+  {
+    for(int row = 0; row < height; row++)
+      memcpy(pipe->strip_out + (size_t)4 * row * pipe->strip_stride,
+             (uint8_t *)buf + (size_t)4 * row * width,
+             sizeof(uint8_t) * 4 * width);
+    pipe->processing = FALSE;
+    return FALSE;
+  }
+
   // terminate
   dt_pthread_mutex_lock(&pipe->backbuf_mutex);
   pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(&roi, pipe, pos);
@@ -3170,6 +4271,8 @@ restart:
       memcpy(pipe->backbuf, buf, sizeof(uint8_t) * 4 * width * height);
       pipe->backbuf_scale = scale;
       for(int i = 0; i < 6; i++) pipe->backbuf_zoom_pos[i] = pts[i] * pipe->iscale;
+      pipe->backbuf_x = x;
+      pipe->backbuf_y = y;
       pipe->output_imgid = pipe->image.id;
     }
   }
@@ -3183,14 +4286,145 @@ restart:
     dt_dev_pixelpipe_cache_report(pipe);
 
   dt_print_pipe(DT_DEBUG_PIPE, "pipe finished",
-                pipe, NULL, old_devid, &roi, &roi, "ID=%i",
-                pipe->image.id);
+                pipe, NULL, old_devid, &roi, &roi, "ID=%i, host transfers %i down %i up",
+                pipe->image.id, pipe->host_downloads, pipe->host_uploads);
   dt_print_mem_usage("after pixelpipe process");
 
   pipe->processing = FALSE;
   return FALSE;
 }
 
+// the darkroom pipes keep this many 4 channel buffers of their output
+// size in the scratch pool between runs
+#define DT_PIPE_SCRATCH_SCREEN_BUFFERS 4
+
+gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
+                                  dt_develop_t *dev,
+                                  const int x,
+                                  const int y,
+                                  const int width,
+                                  const int height,
+                                  const float scale,
+                                  const int devid)
+{
+  // exports of a batch run the same modules on same sized images, so
+  // their scratch buffers are kept for the next image. the darkroom
+  // pipes rerun the same modules on every edit, they keep what a few
+  // buffers of their output size take.
+  const gboolean pooled = (pipe->type & (DT_DEV_PIXELPIPE_EXPORT | DT_DEV_PIXELPIPE_SCREEN)) != 0;
+  const size_t keep = (pipe->type & DT_DEV_PIXELPIPE_EXPORT)
+    ? SIZE_MAX
+    : DT_PIPE_SCRATCH_SCREEN_BUFFERS * 4 * sizeof(float) * width * height;
+  if(pooled) dt_scratch_pool_begin(keep);
+  const gboolean ret = _dev_pixelpipe_process(pipe, dev, x, y, width, height, scale, devid);
+  if(pooled) dt_scratch_pool_end();
+  return ret;
+}
+
+gboolean dt_dev_pixelpipe_process_moved(dt_dev_pixelpipe_t *pipe,
+                                        dt_develop_t *dev,
+                                        const int x,
+                                        const int y,
+                                        const int width,
+                                        const int height,
+                                        const float scale,
+                                        const int devid)
+{
+  // color pickers sample the processed area so they need the full view
+  if(!(pipe->type & DT_DEV_PIXELPIPE_SCREEN)
+     || darktable.lib->proxy.colorpicker.picker_proxy
+     || !dt_conf_get_bool("darkroom/ui/incremental_pan"))
+    return TRUE;
+
+  const guint pos = g_list_length(pipe->iop);
+  uint8_t *out = NULL;
+  int dx = 0, dy = 0;
+
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  dx = x - pipe->backbuf_x;
+  dy = y - pipe->backbuf_y;
+  // the old backbuffer is only valid if the hash of its roi is unchanged
+  // with the current pipe parameters
+  const dt_iop_roi_t old_roi = { pipe->backbuf_x, pipe->backbuf_y, width, height, scale };
+  const gboolean reusable = pipe->backbuf
+    && pipe->output_imgid == pipe->image.id
+    && pipe->backbuf_width == width
+    && pipe->backbuf_height == height
+    && feqf(pipe->backbuf_scale, scale, 1e-6f)
+    && (dx || dy)
+    && abs(dx) < width / 2
+    && abs(dy) < height / 2
+    && pipe->backbuf_hash == dt_dev_pixelpipe_cache_hash(&old_roi, pipe, pos);
+
+  // part of the new view that is covered by the old one
+  const int c0 = MAX(0, -dx), c1 = MIN(width, width - dx);
+  const int r0 = MAX(0, -dy), r1 = MIN(height, height - dy);
+
+  if(reusable)
+    out = g_malloc(sizeof(uint8_t) * 4 * width * height);
+  if(out)
+  {
+    for(int row = r0; row < r1; row++)
+      memcpy(out + (size_t)4 * (row * width + c0),
+             pipe->backbuf + (size_t)4 * ((row + dy) * width + c0 + dx),
+             sizeof(uint8_t) * 4 * (c1 - c0));
+  }
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+
+  if(!out) return TRUE;
+
+  // the newly exposed region is a vertical band over the full height and a
+  // horizontal band over the columns in between
+  dt_iop_roi_t strips[2];
+  int nstrips = 0;
+  if(c0 > 0)
+    strips[nstrips++] = (dt_iop_roi_t){ 0, 0, c0, height, scale };
+  else if(c1 < width)
+    strips[nstrips++] = (dt_iop_roi_t){ c1, 0, width - c1, height, scale };
+  if(r0 > 0)
+    strips[nstrips++] = (dt_iop_roi_t){ c0, 0, c1 - c0, r0, scale };
+  else if(r1 < height)
+    strips[nstrips++] = (dt_iop_roi_t){ c0, r1, c1 - c0, height - r1, scale };
+
+  for(int k = 0; k < nstrips; k++)
+  {
+    const dt_iop_roi_t *strip = &strips[k];
+    pipe->strip_out = out + (size_t)4 * (strip->y * width + strip->x);
+    pipe->strip_stride = width;
+    const gboolean problem = dt_dev_pixelpipe_process(pipe, dev,
+                                                      x + strip->x, y + strip->y,
+                                                      strip->width, strip->height,
+                                                      scale, devid);
+    pipe->strip_out = NULL;
+    if(problem)
+    {
+      g_free(out);
+      return TRUE;
+    }
+  }
+
+  const dt_iop_roi_t roi = { x, y, width, height, scale };
+  const float zx = (x + 0.5f * width) / scale, zy = (y + 0.5f * height) / scale;
+  dt_dev_zoom_pos_t pts = { zx, zy, zx + 1000.f, zy, zx, zy + 1000.f };
+  dt_dev_distort_backtransform_plus(dev, pipe, 0.0f, DT_DEV_TRANSFORM_DIR_ALL_GEOMETRY, pts, 3);
+
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  g_free(pipe->backbuf);
+  pipe->backbuf = out;
+  pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(&roi, pipe, pos);
+  for(int i = 0; i < 6; i++) pipe->backbuf_zoom_pos[i] = pts[i] * pipe->iscale;
+  pipe->backbuf_x = x;
+  pipe->backbuf_y = y;
+  pipe->final_width = width;
+  pipe->final_height = height;
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+
+  dt_print_pipe(DT_DEBUG_PIPE, "pipe moved",
+                pipe, NULL, devid, &old_roi, &roi, "ID=%i, %i strips",
+                pipe->image.id, nstrips);
+  return FALSE;
+}
+
 void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe,
                                      dt_develop_t *dev,
                                      const int width_in,
@@ -3273,8 +4507,74 @@ static inline gboolean _empty_finalscale(const dt_dev_pixelpipe_iop_t *piece)
    The functions returns a pointer the the mask data or NULL if none was available.
    Also the boolean at free_mask is set to TRUE if mask has been somehow transformed,
    all callers must check this flag and de-allocate after usage (dt_free_align).
+
+   Distorted masks are owned by the pipe and shared: the result of the last distorting
+   module is kept per source mask, a consumer further down the pipe continues from there
+   instead of distorting the full mask again, consumers behind the same modules get the very
+   same buffer. As those are never handed over free_mask stays FALSE.
 */
 
+typedef struct _distorted_raster_t
+{
+  const dt_dev_pixelpipe_iop_t *source;
+  dt_mask_id_t id;
+  const float *source_mask; // the mask of source the distortion started from
+  const dt_dev_pixelpipe_iop_t *last; // the last distorting piece applied
+  dt_hash_t hash;                     // of all distortions applied
+  float *mask;
+  dt_iop_roi_t roi;
+} _distorted_raster_t;
+
+static void _distorted_raster_free(_distorted_raster_t *shared)
+{
+  dt_free_align(shared->mask);
+  g_free(shared);
+}
+
+void dt_dev_clear_distorted_raster_masks(dt_dev_pixelpipe_t *pipe,
+                                         const dt_dev_pixelpipe_iop_t *source)
+{
+  GList *iter = pipe->distorted_raster_masks;
+  while(iter)
+  {
+    GList *next = g_list_next(iter);
+    _distorted_raster_t *shared = iter->data;
+    if(!source || shared->source == source)
+    {
+      _distorted_raster_free(shared);
+      pipe->distorted_raster_masks = g_list_delete_link(pipe->distorted_raster_masks, iter);
+    }
+    iter = next;
+  }
+}
+
+static _distorted_raster_t *_find_distorted_raster(dt_dev_pixelpipe_t *pipe,
+                                                   const dt_dev_pixelpipe_iop_t *source,
+                                                   const dt_mask_id_t id)
+{
+  for(GList *iter = pipe->distorted_raster_masks; iter; iter = g_list_next(iter))
+  {
+    _distorted_raster_t *shared = iter->data;
+    if(shared->source == source && shared->id == id) return shared;
+  }
+  return NULL;
+}
+
+static inline gboolean _distorts_raster_mask(const dt_dev_pixelpipe_iop_t *piece)
+{
+  return !_skip_piece_on_tags(piece)
+      && piece->module->distort_mask
+      && !_empty_finalscale(piece);
+}
+
+static inline dt_hash_t _distorted_raster_hash(dt_hash_t hash,
+                                               const dt_dev_pixelpipe_iop_t *piece)
+{
+  hash = dt_hash(hash, &piece->hash, sizeof(piece->hash));
+  hash = dt_hash(hash, &piece->processed_roi_in, sizeof(dt_iop_roi_t));
+  return dt_hash(hash, &piece->processed_roi_out, sizeof(dt_iop_roi_t));
+}
+
 float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
                               const dt_iop_module_t *raster_mask_source,
                               const dt_mask_id_t raster_mask_id,
@@ -3332,6 +4632,7 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
   // we found the raster_mask source piece and can proceed further
 
   float *raster_mask = NULL;
+  gboolean distorted = FALSE;
   dt_iop_roi_t *final_roi = &piece->processed_roi_out;
 
   const dt_develop_mask_mode_t maskmode = source_piece->enabled ? source_piece->module->blend_params->mask_mode : DEVELOP_MASK_DISABLED;
@@ -3343,6 +4644,7 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
   if(!source_piece->enabled || !source_writing)
   {
     const gboolean deleted = g_hash_table_remove(source_piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID));
+    dt_dev_clear_distorted_raster_masks(piece->pipe, source_piece);
     dt_print_pipe(DT_DEBUG_PIPE,
                     "no raster mask",
                     piece->pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
@@ -3368,12 +4670,44 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
     {
       dt_print_pipe(DT_DEBUG_VERBOSE, "source raster mask",
                 piece->pipe, source_piece->module, DT_DEVICE_NONE, &source_piece->processed_roi_in, &source_piece->processed_roi_out);
-      for(GList *iter = g_list_next(source_iter); iter; iter = g_list_next(iter))
+      _distorted_raster_t *shared = _find_distorted_raster(piece->pipe, source_piece, raster_mask_id);
+      if(shared && shared->source_mask != raster_mask) shared->last = NULL;
+
+      // find out if a previous consumer already distorted the mask along the same way
+      GList *resume = g_list_next(source_iter);
+      dt_hash_t hash = DT_INITHASH;
+      if(shared && shared->last)
+      {
+        for(GList *iter = g_list_next(source_iter); iter; iter = g_list_next(iter))
+        {
+          dt_dev_pixelpipe_iop_t *it_piece = iter->data;
+          if(_distorts_raster_mask(it_piece))
+            hash = _distorted_raster_hash(hash, it_piece);
+
+          if(it_piece == shared->last)
+          {
+            if(hash == shared->hash)
+            {
+              raster_mask = shared->mask;
+              final_roi = &shared->roi;
+              distorted = TRUE;
+              // nothing left to do if the target itself was the last distortion
+              resume = target_module && it_piece->module == target_module ? NULL : g_list_next(iter);
+            }
+            break;
+          }
+          if(target_module && it_piece->module == target_module)
+            break;
+        }
+        if(!distorted) hash = DT_INITHASH;
+      }
+
+      for(GList *iter = resume; iter; iter = g_list_next(iter))
       {
         dt_dev_pixelpipe_iop_t *it_piece = iter->data;
         if(!_skip_piece_on_tags(it_piece))
         {
-          if(it_piece->module->distort_mask && !_empty_finalscale(it_piece))
+          if(_distorts_raster_mask(it_piece))
           {
             dt_iop_roi_t *roi = &it_piece->processed_roi_in;
             dt_iop_roi_t *roo = &it_piece->processed_roi_out;
@@ -3385,13 +4719,27 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
                               piece->pipe, it_piece->module, DT_DEVICE_NONE, roi, roo);
               it_piece->module->distort_mask(it_piece->module, it_piece, raster_mask, tmp, roi, roo);
 
-              if(*free_mask)
-                dt_free_align(raster_mask);
-              else
-                *free_mask = TRUE;
+              // the new result replaces the shared one, possibly the one we just distorted
+              if(!shared)
+              {
+                shared = g_malloc0(sizeof(_distorted_raster_t));
+                shared->source = source_piece;
+                shared->id = raster_mask_id;
+                piece->pipe->distorted_raster_masks =
+                  g_list_prepend(piece->pipe->distorted_raster_masks, shared);
+              }
+              dt_free_align(shared->mask);
+              hash = _distorted_raster_hash(hash, it_piece);
+              shared->source_mask = g_hash_table_lookup(source_piece->raster_masks,
+                                                        GINT_TO_POINTER(raster_mask_id));
+              shared->last = it_piece;
+              shared->hash = hash;
+              shared->mask = tmp;
+              shared->roi = *roo;
 
               raster_mask = tmp;
-              final_roi = roo;
+              final_roi = &shared->roi;
+              distorted = TRUE;
             }
             else
             {
@@ -3420,27 +4768,60 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
                 piece->pipe, target_module, DT_DEVICE_NONE, NULL, NULL,
                 "from module `%s%s'%s %ix%i",
                 raster_mask_source->op, dt_iop_get_instance_id(raster_mask_source),
-                *free_mask ? ", distorted to" : "",
+                distorted ? ", distorted to" : "",
                 final_roi->width, final_roi->height);
 
   if(correct)
     return raster_mask;
 
 failure:
-  if(*free_mask)
-  {
-    dt_free_align(raster_mask);
-    *free_mask = FALSE;
-  }
   return NULL;
 }
 
+void dt_dev_wait_scharr_mask(dt_dev_pixelpipe_t *pipe)
+{
+  if(!pipe->scharr.pending) return;
+  pthread_join(pipe->scharr.worker, NULL);
+  pipe->scharr.pending = FALSE;
+}
+
 void dt_dev_clear_scharr_mask(dt_dev_pixelpipe_t *pipe)
 {
+  dt_dev_wait_scharr_mask(pipe);
   if(pipe->scharr.data) dt_free_align(pipe->scharr.data);
   memset(&pipe->scharr, 0, sizeof(dt_dev_detail_mask_t));
 }
 
+static void _scharr_gradient(dt_dev_detail_mask_t *details)
+{
+  dt_masks_calc_scharr_gradient(details->data, details->luminance,
+                                details->roi.width, details->roi.height);
+  dt_free_align(details->luminance);
+  details->luminance = NULL;
+}
+
+static void *_scharr_gradient_job(void *data)
+{
+#ifdef _OPENMP
+  // the pipe goes on meanwhile, leave it most of the cores
+  omp_set_num_threads(MAX(1, dt_get_num_threads() / 4));
+#endif
+  _scharr_gradient((dt_dev_detail_mask_t *)data);
+  return NULL;
+}
+
+// the consumers of the details mask all sit behind the writing piece; if that one downscales
+// its input the mask is computed at its output size right away, saving the full sized buffer
+// and the distortion through the writing piece for every consumer
+static inline gboolean _scharr_at_output(const dt_dev_pixelpipe_iop_t *piece,
+                                         const dt_iop_roi_t *const roi)
+{
+  const dt_iop_roi_t *const roo = &piece->processed_roi_out;
+  return roo->scale < roi->scale
+      && roo->width < roi->width
+      && roo->height < roi->height;
+}
+
 gboolean dt_dev_write_scharr_mask(dt_dev_pixelpipe_iop_t *piece,
                                   float *const restrict src,
                                   const dt_iop_roi_t *const roi,
@@ -3450,17 +4831,44 @@ gboolean dt_dev_write_scharr_mask(dt_dev_pixelpipe_iop_t *piece,
   dt_dev_clear_scharr_mask(p);
   if(p->tiling) goto error;
 
-  float *mask = dt_masks_calc_scharr_mask(p, src, roi->width, roi->height, rawmode);
-  if(!mask) goto error;
+  const gboolean at_output = _scharr_at_output(piece, roi);
+  const dt_iop_roi_t *const mroi = at_output ? &piece->processed_roi_out : roi;
+  float *scaled = at_output ? dt_iop_image_alloc(mroi->width, mroi->height, 4) : NULL;
+  if(at_output)
+  {
+    if(!scaled) goto error;
+    dt_iop_clip_and_zoom_roi(scaled, src, mroi, roi);
+  }
+
+  // src belongs to the module, so only the luminance is taken from it now.
+  // The gradient of that private copy is done by a worker thread while the
+  // pipe runs the next modules, readers of scharr.data wait for it.
+  float *mask = dt_iop_image_alloc(mroi->width, mroi->height, 1);
+  float *lum = mask
+    ? dt_masks_calc_scharr_luminance(p, at_output ? scaled : src, mroi->width, mroi->height, rawmode)
+    : NULL;
+  dt_free_align(scaled);
+  if(!lum)
+  {
+    dt_free_align(mask);
+    goto error;
+  }
 
   p->scharr.data = mask;
-  memcpy(&p->scharr.roi, roi, sizeof(dt_iop_roi_t));
+  p->scharr.luminance = lum;
+  p->scharr.at_output = at_output;
+  memcpy(&p->scharr.roi, mroi, sizeof(dt_iop_roi_t));
 
   p->scharr.hash = dt_hash(DT_INITHASH, &p->scharr.roi, sizeof(dt_iop_roi_t));
 
+  p->scharr.pending = !dt_pthread_create(&p->scharr.worker, _scharr_gradient_job, &p->scharr);
+  if(!p->scharr.pending)
+    _scharr_gradient(&p->scharr);
+
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_VERBOSE, "write scharr mask CPU",
-                p, NULL, DT_DEVICE_CPU, NULL, NULL, "(%ix%i)",
-                roi->width, roi->height);
+                p, NULL, DT_DEVICE_CPU, NULL, NULL, "(%ix%i)%s%s",
+                mroi->width, mroi->height, at_output ? " at output size" : "",
+                p->scharr.pending ? " in background" : "");
   return FALSE;
 
  error:
@@ -3482,10 +4890,13 @@ int dt_dev_write_scharr_mask_cl(dt_dev_pixelpipe_iop_t *piece,
   if(p->tiling)
     return DT_OPENCL_PROCESS_CL;
 
-  const int width = roi->width;
-  const int height = roi->height;
+  const gboolean at_output = _scharr_at_output(piece, roi);
+  const dt_iop_roi_t *const mroi = at_output ? &piece->processed_roi_out : roi;
+  const int width = mroi->width;
+  const int height = mroi->height;
   const int devid = p->devid;
 
+  cl_mem scaled = NULL;
   cl_mem out = NULL;
   cl_mem tmp = NULL;
   float *mask = NULL;
@@ -3496,6 +4907,16 @@ int dt_dev_write_scharr_mask_cl(dt_dev_pixelpipe_iop_t *piece,
   tmp = dt_opencl_alloc_device_buffer(devid, sizeof(float) * width * height);
   if((mask == NULL) || (tmp == NULL) || (out == NULL)) goto error;
 
+  // downscale on the device, only the reduced mask is read back
+  if(at_output)
+  {
+    err = DT_OPENCL_DEFAULT_ERROR;
+    scaled = dt_opencl_alloc_device(devid, width, height, sizeof(float) * 4);
+    if(scaled == NULL) goto error;
+    err = dt_iop_clip_and_zoom_roi_cl(devid, scaled, in, mroi, roi);
+    if(err != CL_SUCCESS) goto error;
+  }
+
   const gboolean wboff = !p->dsc.temperature.enabled || !rawmode;
 
   const dt_aligned_pixel_t wb =
@@ -3505,7 +4926,7 @@ int dt_dev_write_scharr_mask_cl(dt_dev_pixelpipe_iop_t *piece,
 
   err = dt_opencl_enqueue_kernel_2d_args(devid,
      darktable.opencl->blendop->kernel_calc_Y0_mask, width, height,
-     CLARG(tmp), CLARG(in), CLARG(width), CLARG(height),
+     CLARG(tmp), CLARG(at_output ? scaled : in), CLARG(width), CLARG(height),
      CLARG(wb[0]), CLARG(wb[1]), CLARG(wb[2]));
   if(err != CL_SUCCESS) goto error;
 
@@ -3519,13 +4940,14 @@ int dt_dev_write_scharr_mask_cl(dt_dev_pixelpipe_iop_t *piece,
   if(err != CL_SUCCESS) goto error;
 
   p->scharr.data = mask;
-  memcpy(&p->scharr.roi, roi, sizeof(dt_iop_roi_t));
+  p->scharr.at_output = at_output;
+  memcpy(&p->scharr.roi, mroi, sizeof(dt_iop_roi_t));
 
   p->scharr.hash = dt_hash(DT_INITHASH, &p->scharr.roi, sizeof(dt_iop_roi_t));
 
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_VERBOSE, "write scharr mask CL",
-                p, NULL, devid, NULL, NULL, "(%ix%i)",
-                width, height);
+                p, NULL, devid, NULL, NULL, "(%ix%i)%s",
+                width, height, at_output ? " at output size" : "");
 
   error:
   if(err != CL_SUCCESS)
@@ -3533,8 +4955,10 @@ int dt_dev_write_scharr_mask_cl(dt_dev_pixelpipe_iop_t *piece,
     dt_print_pipe(DT_DEBUG_ALWAYS,
                   "couldn't write scharr mask CL", p, NULL, devid, NULL, NULL,
                   "%s", cl_errstr(err));
+    dt_free_align(mask);
     dt_dev_clear_scharr_mask(p);
   }
+  dt_opencl_release_mem_object(scaled);
   dt_opencl_release_mem_object(out);
   dt_opencl_release_mem_object(tmp);
   return err;
@@ -3579,7 +5003,9 @@ float *dt_dev_distort_detail_mask(dt_dev_pixelpipe_iop_t *piece,
 
   float *resmask = src;
   float *inmask  = src;
-  for(GList *iter = source_iter; iter; iter = g_list_next(iter))
+  // a mask written at output size already passed its source piece
+  GList *first = pipe->scharr.at_output ? g_list_next(source_iter) : source_iter;
+  for(GList *iter = first; iter; iter = g_list_next(iter))
   {
     dt_dev_pixelpipe_iop_t *it_piece = iter->data;
     if(!_skip_piece_on_tags(it_piece))
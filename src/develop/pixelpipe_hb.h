@@ -44,6 +44,12 @@ typedef struct dt_dev_pixelpipe_iop_t
   uint32_t *histogram; // pointer to histogram data; histogram_bins_count bins with 4 channels each
   dt_dev_histogram_stats_t histogram_stats; // stats of captured histogram
   uint32_t histogram_max[4];                // maximum levels in histogram, one per channel
+  dt_hash_t histogram_hash;                 // input buffer and parameters the histogram was collected for
+
+  // colour picker statistics of the last run for input and output
+  // buffers, reused as long as buffer, box and colorspaces are unchanged
+  dt_hash_t picker_hash[2];
+  dt_aligned_pixel_t picker_stats[2][3];   // mean, min and max
 
   float iscale;                   // input actually just downscaled buffer? iscale*iwidth = actual width
   int iwidth, iheight;            // width and height of input buffer
@@ -95,8 +101,30 @@ typedef struct dt_dev_detail_mask_t
   dt_iop_roi_t roi;
   dt_hash_t hash;
   float *data;
+  // while pending, worker computes data from luminance
+  pthread_t worker;
+  gboolean pending;
+  float *luminance;
+  // data has the output size of the writing piece instead of the input size
+  gboolean at_output;
 } dt_dev_detail_mask_t;
 
+// per-node record appended to pipe->node_stats while processing
+typedef struct dt_dev_pixelpipe_node_stats_t
+{
+  dt_dev_operation_t op;
+  int multi_priority;
+  double clock;         // wall time spent in the node, 0 for cache hits
+  gboolean on_gpu;
+  gboolean tiling;
+  gboolean from_cache;
+  // memory the module asks for through its tiling callback, untiled: input
+  // and output buffers plus scratch, on the host or the device it ran on
+  size_t host_bytes;
+  size_t device_bytes;
+  int64_t rss_delta;    // change of the resident memory of the process
+} dt_dev_pixelpipe_node_stats_t;
+
 /**
  * this encapsulates the pixelpipe.
  * a develop module will need several of these:
@@ -144,7 +172,14 @@ typedef struct dt_dev_pixelpipe_t
   int backbuf_width, backbuf_height;
   float backbuf_scale;
   dt_dev_zoom_pos_t backbuf_zoom_pos;
+  int backbuf_x, backbuf_y;
+  // the backbuffer holds a reduced scale pass that is being refined
+  gboolean coarse;
   dt_hash_t backbuf_hash;
+  // if set, the output of a screen pipe is written here with a row stride of
+  // strip_stride pixels instead of replacing the backbuffer
+  uint8_t *strip_out;
+  int strip_stride;
   dt_pthread_mutex_t mutex, backbuf_mutex, busy_mutex;
   int final_width, final_height;
 
@@ -200,9 +235,20 @@ typedef struct dt_dev_pixelpipe_t
   GList *forms;
   // the masks generated in the pipe for later reusal are inside dt_dev_pixelpipe_iop_t
   gboolean store_all_raster_masks;
+  // raster masks distorted for consumers further down the pipe, shared by all of them
+  GList *distorted_raster_masks;
   // module blending cache
   float *bcache_data;
   dt_hash_t bcache_hash;
+  // if not NULL, a GArray of dt_dev_pixelpipe_node_stats_t owned by the
+  // caller that gets one record per node processed or taken from cache
+  GArray *node_stats;
+  // highest resident memory sampled after a node of the last run, only
+  // measured while node_stats is set
+  size_t rss_peak;
+  // host<->device transfers of input data in the last run
+  int host_downloads;
+  int host_uploads;
 } dt_dev_pixelpipe_t;
 
 struct dt_develop_t;
@@ -295,6 +341,17 @@ gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
                              const int height,
                              const float scale,
                              const int devid);
+// update the backbuffer of a screen pipe after a pan at unchanged scale and size by
+// processing only the newly exposed region. returns TRUE if that was not possible
+// and a full dt_dev_pixelpipe_process() is required.
+gboolean dt_dev_pixelpipe_process_moved(dt_dev_pixelpipe_t *pipe,
+                                   struct dt_develop_t *dev,
+                                   const int x,
+                                   const int y,
+                                   const int width,
+                                   const int height,
+                                   const float scale,
+                                   const int devid);
 // convenience method that does not gamma-compress the image.
 gboolean dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe,
                                       struct dt_develop_t *dev,
@@ -315,8 +372,13 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
                               const dt_mask_id_t raster_mask_id,
                               const struct dt_iop_module_t *target_module,
                               gboolean *free_mask);
+// drop the shared distorted copies of the raster masks of source, or of all raster masks if source is NULL
+void dt_dev_clear_distorted_raster_masks(dt_dev_pixelpipe_t *pipe,
+                                         const dt_dev_pixelpipe_iop_t *source);
 // some helper functions related to the details mask interface
 void dt_dev_clear_scharr_mask(dt_dev_pixelpipe_t *pipe);
+// the CPU mask is finished in the background, wait before reading scharr.data
+void dt_dev_wait_scharr_mask(dt_dev_pixelpipe_t *pipe);
 
 gboolean dt_dev_write_scharr_mask(dt_dev_pixelpipe_iop_t *piece,
                                   float *const rgb,
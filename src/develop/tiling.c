@@ -18,6 +18,8 @@
 
 #include "develop/tiling.h"
 #include "common/opencl.h"
+#include "common/trace.h"
+#include "control/conf.h"
 #include "control/control.h"
 #include "develop/blend.h"
 #include "develop/pixelpipe.h"
@@ -570,6 +572,120 @@ static int _fit_output_to_input_roi(dt_iop_module_t *self,
 
 
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
+/* add the processing of one tile to the trace. For OpenCL this covers
+   enqueueing only, the kernels show up as their own spans. */
+static void _tiling_trace_tile(const dt_iop_module_t *self,
+                               const int devid,
+                               const size_t tx,
+                               const size_t ty,
+                               const double start)
+{
+  char name[64];
+  char detail[32];
+  snprintf(name, sizeof(name), "%s%s tile", self->op, dt_iop_get_instance_id(self));
+  snprintf(detail, sizeof(detail), "tile (%zu,%zu)", tx, ty);
+  dt_trace_span("tiling", name, devid, start, dt_get_wtime(), detail);
+}
+
+/* plan the tile dimensions for pixel to pixel tiling.
+   Every grid of tiles fitting into max_pixels is rated by the pixels a worker has to process
+   including the overlap plus a fixed cost per tile. Long strips waste overlap just like tiny
+   tiles do, so the cheapest grid is usually made of rather square tiles. If several workers
+   share the tiles (devices splitting an export) the rating also counts the rounds of tiles
+   each worker gets, evenly distributable grids are preferred then.
+   Returns FALSE if no grid within the sane number of tiles fits. */
+static gboolean _tiling_plan_ptp(const int full_wd,
+                                 const int full_ht,
+                                 const int max_wd,
+                                 const int max_ht,
+                                 const float max_pixels,
+                                 const int overlap,
+                                 const int walign,
+                                 const int halign,
+                                 const int workers,
+                                 int *width,
+                                 int *height)
+{
+  // launching, copying and synchronizing a tile roughly costs as much as processing this many pixels
+  const double tile_cost = 256.0 * 256.0;
+  double best = -1.0;
+
+  for(int tx = 1; tx <= full_wd; tx++)
+  {
+    const int wd = tx == 1
+      ? full_wd
+      : walign * ((full_wd / tx + (full_wd % tx != 0) + 2 * overlap + walign - 1) / walign);
+    if(tx > 1 && wd - 2 * overlap <= 0) break;
+    if(wd > max_wd || (tx > 1 && wd >= full_wd)) continue;
+
+    const int max_h = (int)fminf((float)max_ht, max_pixels / wd);
+    int ht = full_ht;
+    int ty = 1;
+    if(max_h < full_ht)
+    {
+      ht = (max_h / halign) * halign;
+      if(ht - 2 * overlap <= 0) continue;
+      ty = (full_ht + ht - 2 * overlap - 1) / (ht - 2 * overlap);
+      // even out the rows of tiles
+      ht = MIN(ht, halign * ((full_ht / ty + (full_ht % ty != 0) + 2 * overlap + halign - 1) / halign));
+    }
+
+    const int tiles_x = tx == 1 ? 1 : (full_wd + wd - 2 * overlap - 1) / (wd - 2 * overlap);
+    const int tiles_y = ty == 1 ? 1 : (full_ht + ht - 2 * overlap - 1) / (ht - 2 * overlap);
+    const double tiles = (double)tiles_x * tiles_y;
+    if(tiles > _maximum_number_tiles()) continue;
+
+    const double rounds = ceil(tiles / workers);
+    const double cost = rounds * ((double)wd * ht + tile_cost);
+    if(best < 0.0 || cost < best)
+    {
+      best = cost;
+      *width = wd;
+      *height = ht;
+    }
+  }
+  return best >= 0.0;
+}
+
+gboolean dt_tiling_plan_group(const dt_dev_pixelpipe_t *pipe,
+                              const dt_develop_tiling_t *tilings,
+                              const int count,
+                              const dt_iop_roi_t *const roi,
+                              const int bpp,
+                              int *width,
+                              int *height,
+                              int *overlap)
+{
+  float factor = 1.0f;
+  float maxbuf = 1.0f;
+  size_t overhead = 0;
+  unsigned int xyalign = 1;
+  int total_overlap = 0;
+  for(int k = 0; k < count; k++)
+  {
+    factor = fmaxf(factor, tilings[k].factor);
+    maxbuf = fmaxf(maxbuf, tilings[k].maxbuf);
+    overhead = MAX(overhead, tilings[k].overhead);
+    xyalign = _lcm(xyalign, _lcm(MAX(tilings[k].xalign, 1), MAX(tilings[k].yalign, 1)));
+    // every module of the group eats its own overlap from the tile
+    total_overlap += tilings[k].overlap;
+  }
+
+  *overlap = total_overlap % xyalign != 0 ? (total_overlap / xyalign + 1) * xyalign : total_overlap;
+
+  /* the full sized input and output of the group stay allocated, the tiles
+     pass from module to module in two more buffers */
+  float available = dt_get_available_pipe_mem(pipe);
+  available = fmaxf(available - 2.0f * roi->width * roi->height * bpp - overhead, 0.0f);
+  const float singlebuffer = fmaxf(available / (factor + 2.0f), dt_get_singlebuffer_mem());
+
+  *width = roi->width;
+  *height = roi->height;
+  return _tiling_plan_ptp(roi->width, roi->height, roi->width, roi->height,
+                          singlebuffer / ((float)bpp * maxbuf), *overlap, xyalign, xyalign, 1,
+                          width, height);
+}
+
 static void _default_process_tiling_ptp(dt_iop_module_t *self,
                                         dt_dev_pixelpipe_iop_t *piece,
                                         const void *const ivoid,
@@ -624,42 +740,6 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
   const float maxbuf = fmaxf(tiling.maxbuf, 1.0f);
   singlebuffer = fmaxf(available / factor, singlebuffer);
 
-  int width = roi_in->width;
-  int height = roi_in->height;
-
-  /* shrink tile size in case it would exceed singlebuffer size */
-  if((float)width * height * max_bpp * maxbuf > singlebuffer)
-  {
-    const float scale = singlebuffer / ((float)width * height * max_bpp * maxbuf);
-
-    /* TODO: can we make this more efficient to minimize total overlap between tiles? */
-    if(width < height && scale >= 0.333f)
-    {
-      height = floorf(height * scale);
-    }
-    else if(height <= width && scale >= 0.333f)
-    {
-      width = floorf(width * scale);
-    }
-    else
-    {
-      width = floorf(width * sqrtf(scale));
-      height = floorf(height * sqrtf(scale));
-    }
-    dt_print(DT_DEBUG_TILING | DT_DEBUG_VERBOSE,
-             "[default_process_tiling_ptp] buffer exceeds singlebuffer, corrected to %dx%d",
-             width, height);
-  }
-
-  /* make sure we have a reasonably effective tile dimension. if not try square tiles */
-  if(3 * tiling.overlap > width || 3 * tiling.overlap > height)
-  {
-    width = height = floorf(sqrtf((float)width * height));
-    dt_print(DT_DEBUG_TILING | DT_DEBUG_VERBOSE,
-             "[default_process_tiling_roi] use squares because of overlap, corrected to %dx%d",
-             width, height);
-  }
-
   /* Alignment rules: we need to make sure that alignment requirements of module are fulfilled.
      Modules will report alignment requirements via xalign and yalign within tiling_callback().
      Typical use case is demosaic where Bayer pattern requires alignment to a multiple of 2 in x and y
@@ -671,14 +751,24 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
 
   assert(xyalign != 0);
 
-  /* properly align tile width and height by making them smaller if needed */
-  if(width < roi_in->width) width = (width / xyalign) * xyalign;
-  if(height < roi_in->height) height = (height / xyalign) * xyalign;
-
-  /* also make sure that overlap follows alignment rules by making it wider when needed */
+  /* make sure that overlap follows alignment rules by making it wider when needed */
   const int overlap = tiling.overlap % xyalign != 0 ? (tiling.overlap / xyalign + 1) * xyalign
                                                     : tiling.overlap;
 
+  /* choose the tile dimensions within the singlebuffer size */
+  int width = roi_in->width;
+  int height = roi_in->height;
+  if(!_tiling_plan_ptp(roi_in->width, roi_in->height, roi_in->width, roi_in->height,
+                       singlebuffer / ((float)max_bpp * maxbuf), overlap, xyalign, xyalign, 1,
+                       &width, &height))
+  {
+    dt_print(DT_DEBUG_TILING,
+             "[default_process_tiling_ptp] [%s] gave up tiling for module '%s%s'. no tile layout fits",
+             dt_dev_pixelpipe_type_to_str(piece->pipe->type),
+             self->op, dt_iop_get_instance_id(self));
+    goto error;
+  }
+
   /* calculate effective tile size */
   const int tile_wd = width - 2 * overlap > 0 ? width - 2 * overlap : 1;
   const int tile_ht = height - 2 * overlap > 0 ? height - 2 * overlap : 1;
@@ -767,7 +857,9 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
       for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
 
       /* call process() of module */
+      const double tile_start = dt_trace_enabled() ? dt_get_wtime() : 0.0;
       self->process(self, piece, input, output, &iroi, &oroi);
+      if(dt_trace_enabled()) _tiling_trace_tile(self, DT_TRACE_CPU, tx, ty, tile_start);
 
       /* aggregate resulting processed_maximum */
       /* TODO: check if there really can be differences between tiles and take
@@ -1117,7 +1209,9 @@ static void _default_process_tiling_roi(dt_iop_module_t *self,
       for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
 
       /* call process() of module */
+      const double tile_start = dt_trace_enabled() ? dt_get_wtime() : 0.0;
       self->process(self, piece, input, output, &iroi_full, &oroi_full);
+      if(dt_trace_enabled()) _tiling_trace_tile(self, DT_TRACE_CPU, tx, ty, tile_start);
 
       /* aggregate resulting processed_maximum */
       /* TODO: check if there really can be differences between tiles and take
@@ -1312,6 +1406,414 @@ float dt_tiling_estimate_clmem(dt_develop_tiling_t *tiling,
   return (float)tiles_x * tiles_y * singlebuffer * factor;
 }
 
+/* state shared by all devices processing the tiles of one module */
+typedef struct _tiling_split_t
+{
+  dt_iop_module_t *self;
+  dt_dev_pixelpipe_iop_t *piece;
+  const void *ivoid;
+  void *ovoid;
+  const dt_iop_roi_t *roi_in;
+  const dt_iop_roi_t *roi_out;
+  int in_bpp, out_bpp;
+  int width, height, overlap;
+  int tile_wd, tile_ht;
+  int tiles_x, tiles_y;
+  gint next; // next tile to be processed
+  gint err;  // first error reported by any device
+  dt_pthread_mutex_t lock;               // serializes the calls into the module
+  dt_aligned_pixel_t processed_maximum; // as found before the first tile
+} _tiling_split_t;
+
+typedef struct _tiling_split_worker_t
+{
+  _tiling_split_t *split;
+  int devid;
+  pthread_t thread;
+  gboolean started;
+} _tiling_split_worker_t;
+
+static cl_int _tiling_split_tile(_tiling_split_worker_t *w,
+                                 const size_t tx,
+                                 const size_t ty)
+{
+  _tiling_split_t *s = w->split;
+  const int devid = w->devid;
+  const int ipitch = s->roi_in->width * s->in_bpp;
+  const int opitch = s->roi_out->width * s->out_bpp;
+
+  const size_t wd = tx * s->tile_wd + s->width > s->roi_in->width
+    ? s->roi_in->width - tx * s->tile_wd : s->width;
+  const size_t ht = ty * s->tile_ht + s->height > s->roi_in->height
+    ? s->roi_in->height - ty * s->tile_ht : s->height;
+
+  /* no need to process (end)tiles that are smaller than the total overlap area */
+  if((wd <= 2 * s->overlap && tx > 0) || (ht <= 2 * s->overlap && ty > 0))
+    return CL_SUCCESS;
+
+  size_t origin[] = { 0, 0, 0 };
+  size_t region[] = { wd, ht, 1 };
+  dt_iop_roi_t iroi = { s->roi_in->x + tx * s->tile_wd, s->roi_in->y + ty * s->tile_ht,
+                        wd, ht, s->roi_in->scale };
+  dt_iop_roi_t oroi = { s->roi_out->x + tx * s->tile_wd, s->roi_out->y + ty * s->tile_ht,
+                        wd, ht, s->roi_out->scale };
+  const size_t ioffs = (ty * s->tile_ht) * ipitch + (tx * s->tile_wd) * s->in_bpp;
+  size_t ooffs = (ty * s->tile_ht) * opitch + (tx * s->tile_wd) * s->out_bpp;
+
+  dt_print(DT_DEBUG_TILING,
+           "[default_process_tiling_cl_split] [%s] tile (%zu,%zu) size %zux%zu on device %i",
+           dt_dev_pixelpipe_type_to_str(s->piece->pipe->type), tx, ty, wd, ht, devid);
+
+  double tile_start = 0.0;
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem input = dt_opencl_alloc_device(devid, wd, ht, s->in_bpp);
+  cl_mem output = dt_opencl_alloc_device(devid, wd, ht, s->out_bpp);
+  if(input == NULL || output == NULL) goto finish;
+
+  err = dt_opencl_write_host_to_device_raw(devid, (char *)s->ivoid + ioffs, input,
+                                           origin, region, ipitch, CL_TRUE);
+  if(err != CL_SUCCESS) goto finish;
+
+  /* the module and its piece are shared by all devices, only one of them may be
+     inside process_cl() at a time. The pipe runs on this device for the call. */
+  dt_pthread_mutex_lock(&s->lock);
+  dt_dev_pixelpipe_t *pipe = s->piece->pipe;
+  const int pipe_devid = pipe->devid;
+  pipe->devid = devid;
+  for_four_channels(k) pipe->dsc.processed_maximum[k] = s->processed_maximum[k];
+  tile_start = dt_trace_enabled() ? dt_get_wtime() : 0.0;
+  err = s->self->process_cl(s->self, s->piece, input, output, &iroi, &oroi);
+  if(dt_trace_enabled()) _tiling_trace_tile(s->self, devid, tx, ty, tile_start);
+  pipe->devid = pipe_devid;
+  dt_pthread_mutex_unlock(&s->lock);
+  if(err != CL_SUCCESS) goto finish;
+
+  /* only copy back the "good" part of the tile */
+  if(tx > 0)
+  {
+    origin[0] += s->overlap;
+    region[0] -= s->overlap;
+    ooffs += (size_t)s->overlap * s->out_bpp;
+  }
+  if(ty > 0)
+  {
+    origin[1] += s->overlap;
+    region[1] -= s->overlap;
+    ooffs += (size_t)s->overlap * opitch;
+  }
+  err = dt_opencl_read_host_from_device_raw(devid, (char *)s->ovoid + ooffs, output,
+                                            origin, region, opitch, CL_TRUE);
+
+finish:
+  dt_opencl_release_mem_object(input);
+  dt_opencl_release_mem_object(output);
+  dt_opencl_finish(devid);
+  return err;
+}
+
+static void *_tiling_split_worker(void *data)
+{
+  _tiling_split_worker_t *w = data;
+  _tiling_split_t *s = w->split;
+  const int tiles = s->tiles_x * s->tiles_y;
+
+  while(g_atomic_int_get(&s->err) == CL_SUCCESS)
+  {
+    const int t = g_atomic_int_add(&s->next, 1);
+    if(t >= tiles) break;
+
+    const cl_int err = _tiling_split_tile(w, t % s->tiles_x, t / s->tiles_x);
+    if(err != CL_SUCCESS)
+      g_atomic_int_compare_and_exchange(&s->err, CL_SUCCESS, err);
+  }
+  return NULL;
+}
+
+/* hand the tiles of a single module out to all currently idle devices.
+   The devices fetch tiles until all are done, uploads and downloads overlap
+   while the calls into the module are serialized.
+   returns FALSE if no other device was available. */
+static gboolean _default_process_tiling_cl_split(_tiling_split_t *split,
+                                                 dt_dev_pixelpipe_iop_t *piece,
+                                                 const size_t required,
+                                                 cl_int *err)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  const int devid = piece->pipe->devid;
+  const int max_bpp = MAX(split->in_bpp, split->out_bpp);
+
+  _tiling_split_worker_t *workers = calloc(cl->num_devs, sizeof(_tiling_split_worker_t));
+  if(!workers) return FALSE;
+
+  int num = 0;
+  for(int dev = -1; dev < cl->num_devs; dev++)
+  {
+    // the pipe's device always takes part and comes first
+    const int d = dev < 0 ? devid : dev;
+    if(dev >= 0
+       && (d == devid
+           || cl->dev[d].max_image_width < split->width
+           || cl->dev[d].max_image_height < split->height
+           || dt_opencl_get_device_memalloc(d) < (size_t)split->width * split->height * max_bpp
+           || dt_opencl_get_device_available(d) < required
+           || !dt_opencl_trylock_device(d)))
+      continue;
+
+    _tiling_split_worker_t *w = &workers[num++];
+    w->split = split;
+    w->devid = d;
+  }
+
+  if(num < 2)
+  {
+    free(workers);
+    return FALSE;
+  }
+
+  split->piece = piece;
+  for_four_channels(k) split->processed_maximum[k] = piece->pipe->dsc.processed_maximum[k];
+  dt_pthread_mutex_init(&split->lock, NULL);
+  piece->pipe->tiling = TRUE;
+
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_TILING,
+                "process *split* ptp", piece->pipe, piece->module, devid,
+                split->roi_in, split->roi_out,
+                "%dx%d tiles on %d devices", split->tiles_x, split->tiles_y, num);
+
+  for(int i = 1; i < num; i++)
+    workers[i].started =
+      !dt_pthread_create(&workers[i].thread, _tiling_split_worker, &workers[i]);
+
+  _tiling_split_worker(&workers[0]);
+
+  for(int i = 1; i < num; i++)
+  {
+    if(workers[i].started)
+      pthread_join(workers[i].thread, NULL);
+    else // could not start the thread, process remaining tiles here
+      _tiling_split_worker(&workers[i]);
+    dt_opencl_unlock_device(workers[i].devid);
+  }
+
+  piece->pipe->tiling = FALSE;
+  dt_pthread_mutex_destroy(&split->lock);
+  *err = g_atomic_int_get(&split->err);
+  if(*err != CL_SUCCESS)
+    for_four_channels(k) piece->pipe->dsc.processed_maximum[k] = split->processed_maximum[k];
+
+  free(workers);
+  return TRUE;
+}
+
+/* one of the two buffer sets used for overlapping transfers */
+typedef struct _tiling_async_slot_t
+{
+  cl_mem pinned_input, pinned_output;
+  void *input_buffer, *output_buffer;
+  cl_mem input, output;
+  size_t tx, ty, wd, ht;
+  cl_event event;
+} _tiling_async_slot_t;
+
+static void _tiling_async_release(_tiling_async_slot_t *slot)
+{
+  dt_opencl_release_mem_object(slot->input);
+  dt_opencl_release_mem_object(slot->output);
+  slot->input = slot->output = NULL;
+}
+
+/* download a processed tile via the transfer queue, the kernel must have finished */
+static cl_int _tiling_async_download(const _tiling_split_t *s,
+                                     const int devid,
+                                     _tiling_async_slot_t *slot)
+{
+  const size_t origin[] = { 0, 0, 0 };
+  const size_t region[] = { slot->wd, slot->ht, 1 };
+  return dt_opencl_transfer_async(devid, slot->output_buffer, slot->output, origin, region,
+                                  slot->wd * s->out_bpp, FALSE, &slot->event);
+}
+
+/* wait for the download and copy the "good" part of the tile to the output image */
+static cl_int _tiling_async_store(const _tiling_split_t *s,
+                                  const int devid,
+                                  _tiling_async_slot_t *slot)
+{
+  const cl_int err = dt_opencl_wait_event(devid, slot->event);
+  slot->event = NULL;
+  if(err != CL_SUCCESS) return err;
+
+  const int opitch = s->roi_out->width * s->out_bpp;
+  size_t origin[] = { 0, 0, 0 };
+  size_t region[] = { slot->wd, slot->ht, 1 };
+  size_t ooffs = (slot->ty * s->tile_ht) * opitch + (slot->tx * s->tile_wd) * s->out_bpp;
+  if(slot->tx > 0)
+  {
+    origin[0] += s->overlap;
+    region[0] -= s->overlap;
+    ooffs += (size_t)s->overlap * s->out_bpp;
+  }
+  if(slot->ty > 0)
+  {
+    origin[1] += s->overlap;
+    region[1] -= s->overlap;
+    ooffs += (size_t)s->overlap * opitch;
+  }
+
+  for(size_t j = 0; j < region[1]; j++)
+    memcpy((char *)s->ovoid + ooffs + j * opitch,
+           (char *)slot->output_buffer + ((j + origin[1]) * slot->wd + origin[0]) * s->out_bpp,
+           (size_t)region[0] * s->out_bpp);
+
+  _tiling_async_release(slot);
+  return CL_SUCCESS;
+}
+
+/* pinned double buffering with a separate transfer queue: while the
+   kernel of one tile runs in the main queue, the next tile is uploaded
+   and the previous one downloaded.
+   returns FALSE if the pinned buffers could not be set up. */
+static gboolean _default_process_tiling_cl_async(_tiling_split_t *s,
+                                                 dt_dev_pixelpipe_iop_t *piece,
+                                                 cl_int *err)
+{
+  const int devid = piece->pipe->devid;
+  const int ipitch = s->roi_in->width * s->in_bpp;
+  const size_t insize = (size_t)s->width * s->height * s->in_bpp;
+  const size_t outsize = (size_t)s->width * s->height * s->out_bpp;
+
+  _tiling_async_slot_t slots[2] = { { 0 } };
+  gboolean ok = TRUE;
+  for(int i = 0; i < 2 && ok; i++)
+  {
+    _tiling_async_slot_t *slot = &slots[i];
+    slot->pinned_input = dt_opencl_alloc_device_buffer_with_flags
+      (devid, insize, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR);
+    slot->pinned_output = dt_opencl_alloc_device_buffer_with_flags
+      (devid, outsize, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR);
+    if(slot->pinned_input)
+      slot->input_buffer = dt_opencl_map_buffer(devid, slot->pinned_input, CL_TRUE,
+                                                CL_MAP_WRITE, 0, insize);
+    if(slot->pinned_output)
+      slot->output_buffer = dt_opencl_map_buffer(devid, slot->pinned_output, CL_TRUE,
+                                                 CL_MAP_READ, 0, outsize);
+    ok = slot->input_buffer && slot->output_buffer;
+  }
+
+  if(ok)
+  {
+    dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_TILING,
+                  "process *tiled* async", piece->pipe, piece->module, devid,
+                  s->roi_in, s->roi_out, "%dx%d tiles, size=%dx%d",
+                  s->tiles_x, s->tiles_y, s->tile_wd, s->tile_ht);
+
+    dt_aligned_pixel_t processed_maximum_saved;
+    for_four_channels(k) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
+    piece->pipe->tiling = TRUE;
+    *err = CL_SUCCESS;
+
+    _tiling_async_slot_t *prev = NULL;
+    int cur = 0;
+    for(int t = 0; t < s->tiles_x * s->tiles_y && *err == CL_SUCCESS; t++)
+    {
+      const size_t tx = t % s->tiles_x;
+      const size_t ty = t / s->tiles_x;
+      const size_t wd = tx * s->tile_wd + s->width > s->roi_in->width
+        ? s->roi_in->width - tx * s->tile_wd : s->width;
+      const size_t ht = ty * s->tile_ht + s->height > s->roi_in->height
+        ? s->roi_in->height - ty * s->tile_ht : s->height;
+
+      /* no need to process (end)tiles that are smaller than the total overlap area */
+      if((wd <= 2 * s->overlap && tx > 0) || (ht <= 2 * s->overlap && ty > 0)) continue;
+
+      _tiling_async_slot_t *slot = &slots[cur];
+      slot->tx = tx;
+      slot->ty = ty;
+      slot->wd = wd;
+      slot->ht = ht;
+      slot->input = dt_opencl_alloc_device(devid, wd, ht, s->in_bpp);
+      slot->output = dt_opencl_alloc_device(devid, wd, ht, s->out_bpp);
+      if(slot->input == NULL || slot->output == NULL)
+      {
+        *err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+        break;
+      }
+
+      /* upload this tile while the kernel of the previous one is running */
+      const size_t ioffs = (ty * s->tile_ht) * ipitch + (tx * s->tile_wd) * s->in_bpp;
+      DT_OMP_FOR()
+      for(size_t j = 0; j < ht; j++)
+        memcpy((char *)slot->input_buffer + j * wd * s->in_bpp,
+               (char *)s->ivoid + ioffs + j * ipitch, (size_t)wd * s->in_bpp);
+
+      const size_t origin[] = { 0, 0, 0 };
+      const size_t region[] = { wd, ht, 1 };
+      cl_event upload = NULL;
+      *err = dt_opencl_transfer_async(devid, slot->input_buffer, slot->input, origin, region,
+                                      wd * s->in_bpp, TRUE, &upload);
+      if(*err == CL_SUCCESS) *err = dt_opencl_wait_event(devid, upload);
+      if(*err != CL_SUCCESS) break;
+
+      /* the previous kernel has to be done before its download */
+      if(prev)
+      {
+        if(!dt_opencl_finish(devid))
+          *err = DT_OPENCL_PROCESS_CL;
+        else
+          *err = _tiling_async_download(s, devid, prev);
+        if(*err != CL_SUCCESS) break;
+      }
+
+      dt_iop_roi_t iroi = { s->roi_in->x + tx * s->tile_wd, s->roi_in->y + ty * s->tile_ht,
+                            wd, ht, s->roi_in->scale };
+      dt_iop_roi_t oroi = { s->roi_out->x + tx * s->tile_wd, s->roi_out->y + ty * s->tile_ht,
+                            wd, ht, s->roi_out->scale };
+      for_four_channels(k) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
+      const double tile_start = dt_trace_enabled() ? dt_get_wtime() : 0.0;
+      *err = s->self->process_cl(s->self, piece, slot->input, slot->output, &iroi, &oroi);
+      if(dt_trace_enabled()) _tiling_trace_tile(s->self, devid, tx, ty, tile_start);
+      if(*err == CL_SUCCESS) *err = dt_opencl_flush(devid);
+      if(*err != CL_SUCCESS) break;
+
+      /* store the previous tile while this kernel is running */
+      if(prev)
+      {
+        *err = _tiling_async_store(s, devid, prev);
+        if(*err != CL_SUCCESS) break;
+      }
+
+      prev = slot;
+      cur ^= 1;
+    }
+
+    if(*err == CL_SUCCESS && prev)
+    {
+      if(!dt_opencl_finish(devid))
+        *err = DT_OPENCL_PROCESS_CL;
+      else
+        *err = _tiling_async_download(s, devid, prev);
+      if(*err == CL_SUCCESS)
+        *err = _tiling_async_store(s, devid, prev);
+    }
+
+    if(*err != CL_SUCCESS)
+      for_four_channels(k) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
+    piece->pipe->tiling = FALSE;
+  }
+
+  dt_opencl_finish(devid);
+  for(int i = 0; i < 2; i++)
+  {
+    _tiling_async_slot_t *slot = &slots[i];
+    if(slot->event) dt_opencl_wait_event(devid, slot->event);
+    _tiling_async_release(slot);
+    if(slot->input_buffer) dt_opencl_unmap_mem_object(devid, slot->pinned_input, slot->input_buffer);
+    if(slot->output_buffer) dt_opencl_unmap_mem_object(devid, slot->pinned_output, slot->output_buffer);
+    dt_opencl_release_mem_object(slot->pinned_input);
+    dt_opencl_release_mem_object(slot->pinned_output);
+  }
+  return ok;
+}
+
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
 static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
                                           dt_dev_pixelpipe_iop_t *piece,
@@ -1347,9 +1849,14 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
 
   /* shall we use pinned memory transfers? */
   gboolean use_pinned_memory = dt_opencl_use_pinned_memory(devid);
-  const int pinned_buffer_overhead = use_pinned_memory ? 2 : 0; // add two additional pinned memory buffers
-                                                                // which seemingly get allocated not only on
-                                                                // host but also on device (why???)
+  /* overlap transfers and kernels via double buffering, this requires
+     two more pinned buffers and device tiles */
+  const gboolean use_async = use_pinned_memory
+    && dt_opencl_has_transfer_queue(devid)
+    && dt_conf_get_bool("opencl_async_tiling");
+  // add two additional pinned memory buffers which seemingly get
+  // allocated not only on host but also on device (why???)
+  const int pinned_buffer_overhead = use_async ? 6 : use_pinned_memory ? 2 : 0;
   // avoid problems when pinned buffer size gets too close to max_mem_alloc size
   const float pinned_buffer_slack = use_pinned_memory ? 0.85f : 1.0f;
   const float available = (float)dt_opencl_get_device_available(devid);
@@ -1357,40 +1864,8 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
   const float singlebuffer = fminf(fmaxf((available - tiling.overhead) / factor, 0.0f),
                                   pinned_buffer_slack * (float)(dt_opencl_get_device_memalloc(devid)));
   const float maxbuf = fmaxf(tiling.maxbuf_cl, 1.0f);
-  int width = MIN(roi_in->width, darktable.opencl->dev[devid].max_image_width);
-  int height = MIN(roi_in->height, darktable.opencl->dev[devid].max_image_height);
-
-  /* shrink tile size in case it would exceed singlebuffer size */
-  if((float)width * height * max_bpp * maxbuf > singlebuffer)
-  {
-    const float scale = singlebuffer / ((float)width * height * max_bpp * maxbuf);
-
-    if(width < height && scale >= 0.333f)
-    {
-      height = floorf(height * scale);
-    }
-    else if(height <= width && scale >= 0.333f)
-    {
-      width = floorf(width * scale);
-    }
-    else
-    {
-      width = floorf(width * sqrtf(scale));
-      height = floorf(height * sqrtf(scale));
-    }
-    dt_print(DT_DEBUG_TILING | DT_DEBUG_VERBOSE,
-             "[default_process_tiling_cl_ptp] [%s] buffer exceeds singlebuffer, corrected to %dx%d",
-             dt_dev_pixelpipe_type_to_str(piece->pipe->type), width, height);
-  }
-
-  /* make sure we have a reasonably effective tile dimension. if not try square tiles */
-  if(3 * tiling.overlap > width || 3 * tiling.overlap > height)
-  {
-    width = height = floorf(sqrtf((float)width * height));
-    dt_print(DT_DEBUG_TILING | DT_DEBUG_VERBOSE,
-             "[default_process_tiling_cl_ptp] [%s] use squares because of overlap, corrected to %dx%d",
-             dt_dev_pixelpipe_type_to_str(piece->pipe->type), width, height);
-  }
+  const int max_width = darktable.opencl->dev[devid].max_image_width;
+  const int max_height = darktable.opencl->dev[devid].max_image_height;
 
   /* Alignment rules: we need to make sure that alignment requirements of module are fulfilled.
      Modules will report alignment requirements via xalign and yalign within tiling_callback().
@@ -1409,14 +1884,29 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
 
   assert(xyalign != 0 && walign != 0 && halign != 0);
 
-  /* properly align tile width and height by making them smaller if needed */
-  if(width < roi_in->width) width = (width / walign) * walign;
-  if(height < roi_in->height) height = (height / halign) * halign;
-
-  /* also make sure that overlap follows alignment rules by making it wider when needed */
+  /* make sure that overlap follows alignment rules by making it wider when needed */
   const int overlap = tiling.overlap % xyalign != 0 ? (tiling.overlap / xyalign + 1) * xyalign
                                                     : tiling.overlap;
 
+  /* exports may share the tiles between all idle devices, plan for all of them */
+  const gboolean may_split = (piece->pipe->type & DT_DEV_PIXELPIPE_EXPORT)
+                             && darktable.opencl->num_devs > 1
+                             && dt_conf_get_bool("opencl_split_frame");
+
+  /* choose the tile dimensions within the singlebuffer size */
+  int width = MIN(roi_in->width, max_width);
+  int height = MIN(roi_in->height, max_height);
+  if(!_tiling_plan_ptp(roi_in->width, roi_in->height, max_width, max_height,
+                       singlebuffer / ((float)max_bpp * maxbuf), overlap, walign, halign,
+                       may_split ? darktable.opencl->num_devs : 1,
+                       &width, &height))
+  {
+    dt_print(DT_DEBUG_TILING,
+             "[default_process_tiling_cl_ptp] [%s] aborted tiling for module '%s%s'. no tile layout fits",
+             dt_dev_pixelpipe_type_to_str(piece->pipe->type),
+             self->op, dt_iop_get_instance_id(self));
+    return DT_OPENCL_PROCESS_CL;
+  }
 
   /* calculate effective tile size */
   const int tile_wd = width - 2 * overlap > 0 ? width - 2 * overlap : 1;
@@ -1438,6 +1928,51 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
     return DT_OPENCL_PROCESS_CL;
   }
 
+  /* exports may share the tiles between all idle devices */
+  if(tiles_x * tiles_y > 1 && may_split)
+  {
+    _tiling_split_t split = { .self = self, .ivoid = ivoid, .ovoid = ovoid,
+                              .roi_in = roi_in, .roi_out = roi_out,
+                              .in_bpp = in_bpp, .out_bpp = out_bpp,
+                              .width = width, .height = height, .overlap = overlap,
+                              .tile_wd = tile_wd, .tile_ht = tile_ht,
+                              .tiles_x = tiles_x, .tiles_y = tiles_y,
+                              .next = 0, .err = CL_SUCCESS };
+    cl_int split_err = CL_SUCCESS;
+    const size_t required = (size_t)width * height * max_bpp * factor + tiling.overhead;
+    if(_default_process_tiling_cl_split(&split, piece, required, &split_err))
+    {
+      if(split_err != CL_SUCCESS)
+        dt_print(DT_DEBUG_TILING | DT_DEBUG_OPENCL,
+                 "[default_process_tiling_cl_split] [%s] couldn't run process_cl() for "
+                 "module '%s%s' in tiling mode: %s",
+                 dt_dev_pixelpipe_type_to_str(piece->pipe->type), self->op,
+                 dt_iop_get_instance_id(self), cl_errstr(split_err));
+      return split_err;
+    }
+  }
+
+  if(use_async)
+  {
+    _tiling_split_t async = { .self = self, .ivoid = ivoid, .ovoid = ovoid,
+                              .roi_in = roi_in, .roi_out = roi_out,
+                              .in_bpp = in_bpp, .out_bpp = out_bpp,
+                              .width = width, .height = height, .overlap = overlap,
+                              .tile_wd = tile_wd, .tile_ht = tile_ht,
+                              .tiles_x = tiles_x, .tiles_y = tiles_y };
+    cl_int async_err = CL_SUCCESS;
+    if(_default_process_tiling_cl_async(&async, piece, &async_err))
+    {
+      if(async_err != CL_SUCCESS)
+        dt_print(DT_DEBUG_TILING | DT_DEBUG_OPENCL,
+                 "[default_process_tiling_cl_async] [%s] couldn't run process_cl() for "
+                 "module '%s%s' in tiling mode: %s",
+                 dt_dev_pixelpipe_type_to_str(piece->pipe->type), self->op,
+                 dt_iop_get_instance_id(self), cl_errstr(async_err));
+      return async_err;
+    }
+  }
+
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_TILING,
                         "process *tiled* ptp", piece->pipe, piece->module, devid, roi_in, roi_out,
                         "%dx%d tiles%s, size=%dx%d",
@@ -1578,7 +2113,9 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
       for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
 
       /* call process_cl of module */
+      const double tile_start = dt_trace_enabled() ? dt_get_wtime() : 0.0;
       err = self->process_cl(self, piece, input, output, &iroi, &oroi);
+      if(dt_trace_enabled()) _tiling_trace_tile(self, devid, tx, ty, tile_start);
       if(err != CL_SUCCESS)
         goto error;
 
@@ -2051,7 +2588,9 @@ static int _default_process_tiling_cl_roi(dt_iop_module_t *self,
       for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
 
       /* call process_cl of module */
+      const double tile_start = dt_trace_enabled() ? dt_get_wtime() : 0.0;
       err = self->process_cl(self, piece, input, output, &iroi_full, &oroi_full);
+      if(dt_trace_enabled()) _tiling_trace_tile(self, devid, tx, ty, tile_start);
       if(err != CL_SUCCESS)
         goto error;
 
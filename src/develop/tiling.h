@@ -74,6 +74,18 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
 gboolean dt_tiling_piece_fits_host_memory(const struct dt_dev_pixelpipe_iop_t *piece, const size_t width, const size_t height, const unsigned bpp,
                                      const float factor, const size_t overhead);
 
+/** plan the tiles of a tile group: consecutive modules with roi_in == roi_out that run tile by
+    tile through the whole group. The tile overlap covers the overlap of all modules, the tile
+    size fits the largest memory requirement. Returns FALSE if no tile layout fits. */
+gboolean dt_tiling_plan_group(const struct dt_dev_pixelpipe_t *pipe,
+                              const struct dt_develop_tiling_t *tilings,
+                              const int count,
+                              const dt_iop_roi_t *const roi,
+                              const int bpp,
+                              int *width,
+                              int *height,
+                              int *overlap);
+
 float dt_tiling_estimate_cpumem(struct dt_develop_tiling_t *tiling, struct dt_dev_pixelpipe_iop_t *piece,
                                         const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                                         const int max_bpp);
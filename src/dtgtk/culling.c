@@ -22,8 +22,10 @@
 #include "dtgtk/culling.h"
 #include "common/collection.h"
 #include "common/debug.h"
+#include "common/mipmap_cache.h"
 #include "common/selection.h"
 #include "control/control.h"
+#include "control/jobs/image_jobs.h"
 #include "gui/gtk.h"
 #include "views/view.h"
 
@@ -1142,26 +1144,18 @@ void dt_culling_init(dt_culling_t *table,
   table->offset_imgid = first_id;
 }
 
-static void _thumbs_prefetch(dt_culling_t *table)
+// queue the loads of the images after/before rowid, n at most
+static void _thumbs_prefetch_side(dt_culling_t *table,
+                                  const int rowid,
+                                  const int dir,
+                                  const int n,
+                                  const dt_mipmap_size_t mip)
 {
-  if(!table->list) return;
-
-  // get the mip level by using the max image size actually shown
-  int maxw = 0;
-  int maxh = 0;
-  for(GList *l = table->list; l; l = g_list_next(l))
-  {
-    dt_thumbnail_t *th = l->data;
-    maxw = MAX(maxw, th->width);
-    maxh = MAX(maxh, th->height);
-  }
-  dt_mipmap_size_t mip =
-    dt_mipmap_cache_get_matching_size(maxw, maxh);
+  if(n <= 0) return;
 
-  // prefetch next image
+  const char *cmp = dir > 0 ? ">" : "<";
+  const char *order = dir > 0 ? "" : " DESC";
   gchar *query;
-  sqlite3_stmt *stmt;
-  dt_thumbnail_t *last = g_list_last(table->list)->data;
   if(table->navigate_inside_selection)
   {
     // clang-format off
@@ -1169,10 +1163,10 @@ static void _thumbs_prefetch(dt_culling_t *table)
       ("SELECT m.imgid"
        " FROM memory.collected_images AS m, main.selected_images AS s"
        " WHERE m.imgid = s.imgid"
-       "   AND m.rowid > %d"
-       " ORDER BY m.rowid "
-       " LIMIT 1",
-       last->rowid);
+       "   AND m.rowid %s %d"
+       " ORDER BY m.rowid%s"
+       " LIMIT %d",
+       cmp, rowid, order, n);
     // clang-format on
   }
   else
@@ -1180,58 +1174,77 @@ static void _thumbs_prefetch(dt_culling_t *table)
     // clang-format off
     query = g_strdup_printf
       ("SELECT m.imgid"
-       " FROM memory.collected_images AS m "
-       " WHERE m.rowid > %d"
-       " ORDER BY m.rowid "
-       " LIMIT 1",
-       last->rowid);
+       " FROM memory.collected_images AS m"
+       " WHERE m.rowid %s %d"
+       " ORDER BY m.rowid%s"
+       " LIMIT %d",
+       cmp, rowid, order, n);
     // clang-format on
   }
+
+  sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  // nearest first, the queue is run in order
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     const dt_imgid_t id = sqlite3_column_int(stmt, 0);
     if(dt_is_valid_imgid(id))
-      dt_mipmap_cache_get(NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+      dt_control_add_job(DT_JOB_QUEUE_SYSTEM_BG, dt_image_prefetch_job_create(id, mip));
   }
   sqlite3_finalize(stmt);
   g_free(query);
+}
 
-  // prefetch previous image
-  dt_thumbnail_t *prev = (table->list)->data;
-  if(table->navigate_inside_selection)
+// load the next and previous images at display size in the background, the
+// ones in the direction we are moving first. as many as the preference asks
+// for, as long as they take at most half of the thumbnail cache.
+static void _thumbs_prefetch(dt_culling_t *table)
+{
+  if(!table->list) return;
+
+  // get the mip level by using the max image size actually shown
+  int maxw = 0;
+  int maxh = 0;
+  for(GList *l = table->list; l; l = g_list_next(l))
   {
-    // clang-format off
-    query = g_strdup_printf
-      ("SELECT m.imgid"
-       " FROM memory.collected_images AS m, main.selected_images AS s"
-       " WHERE m.imgid = s.imgid"
-       "   AND m.rowid < %d"
-       " ORDER BY m.rowid DESC "
-       " LIMIT 1",
-       prev->rowid);
-    // clang-format on
+    dt_thumbnail_t *th = l->data;
+    maxw = MAX(maxw, th->width);
+    maxh = MAX(maxh, th->height);
   }
-  else
+  const dt_mipmap_size_t mip =
+    dt_mipmap_cache_get_matching_size(maxw * darktable.gui->ppd, maxh * darktable.gui->ppd);
+
+  const int dir = table->offset < table->prefetch_offset ? -1 : 1;
+  if(table->prefetch_offset && dir != table->prefetch_dir)
+    // the user reversed, what is queued behind us is of no use any more
+    dt_image_prefetch_cancel();
+  table->prefetch_dir = dir;
+  table->prefetch_offset = table->offset;
+
+  int ahead = dt_conf_get_int("plugins/lighttable/preview/prefetch_images");
+  const dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(mip < DT_MIPMAP_F && cache->buffer_size[mip])
   {
-    // clang-format off
-    query = g_strdup_printf
-      ("SELECT m.imgid"
-       " FROM memory.collected_images AS m"
-       " WHERE m.rowid < %d"
-       " ORDER BY m.rowid DESC "
-       " LIMIT 1",
-       prev->rowid);
-    // clang-format on
+    const size_t budget = cache->mip_thumbs.cache.cost_quota / 2;
+    const int fits = budget / cache->buffer_size[mip] - table->thumbs_count;
+    ahead = MIN(ahead, MAX(fits, 2) / 2);
   }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  if(ahead <= 0) return;
+
+  const dt_thumbnail_t *first = table->list->data;
+  const dt_thumbnail_t *last = g_list_last(table->list)->data;
+  // the other way round we keep a little less, we might still turn
+  const int behind = MAX(1, ahead / 2);
+  if(dir > 0)
   {
-    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
-    if(dt_is_valid_imgid(id))
-      dt_mipmap_cache_get(NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+    _thumbs_prefetch_side(table, last->rowid, 1, ahead, mip);
+    _thumbs_prefetch_side(table, first->rowid, -1, behind, mip);
+  }
+  else
+  {
+    _thumbs_prefetch_side(table, first->rowid, -1, ahead, mip);
+    _thumbs_prefetch_side(table, last->rowid, 1, behind, mip);
   }
-  sqlite3_finalize(stmt);
 }
 
 static gboolean _thumbs_recreate_list_at(dt_culling_t *table,
@@ -52,6 +52,10 @@ typedef struct dt_culling_t
   int offset;
   dt_imgid_t offset_imgid;
 
+  // prefetch of the neighbours
+  int prefetch_offset; // offset of the last prefetch
+  int prefetch_dir;    // 1 toward the end of the collection, -1 toward the start
+
   int thumbs_count;            // last nb of thumb to display
   int view_width, view_height; // last main widget size
   GdkRectangle thumbs_area;    // coordinate of all the currently loaded thumbs area
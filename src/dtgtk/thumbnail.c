@@ -719,8 +719,8 @@ static gboolean _event_image_draw(GtkWidget *widget,
         {
           cairo_save(cr2);
           cairo_scale(cr2, 1.0f/scale, 1.0f/scale);
-          dt_focuspeaking(cr2, img_width, img_height,
-                          cairo_image_surface_get_data(thumb->img_surf));
+          dt_view_focuspeaking(cr2, img_width, img_height,
+                               cairo_image_surface_get_data(thumb->img_surf));
           cairo_restore(cr2);
         }
         cairo_surface_destroy(tmp_surface);
@@ -729,9 +729,18 @@ static gboolean _event_image_draw(GtkWidget *widget,
       dt_free_align(rgbbuf);
       thumb->img_surf_preview = TRUE;
     }
+    else if(thumb->img_surf_cached
+            && thumb->img_surf
+            && thumb->img_box_w == image_w
+            && thumb->img_box_h == image_h)
+    {
+      // the thumbtable handed back the surface this image had in a recycled widget
+      thumb->img_surf_preview = FALSE;
+    }
     else
     {
       cairo_surface_t *img_surf = NULL;
+      if(thumb->img_surf_cached) dt_thumbnail_surface_destroy(thumb);
       if(thumb->zoomable)
       {
         if(thumb->zoom > 1.0f)
@@ -820,7 +829,7 @@ static gboolean _event_image_draw(GtkWidget *widget,
       dt_image_full_path(thumb->imgid, path, sizeof(path), &from_cache);
       if(!dt_imageio_large_thumbnail(path, &full_res_thumb,
                                      &full_res_thumb_wd, &full_res_thumb_ht,
-                                     &color_space))
+                                     &color_space, 0, 0))
       {
         // we look for focus areas
         dt_focus_cluster_t full_res_focus[49];
@@ -843,10 +852,13 @@ static gboolean _event_image_draw(GtkWidget *widget,
 
 
     // here we are sure to have the right imagesurface
+    thumb->img_surf_cached = FALSE;
     if(res == DT_VIEW_SURFACE_OK)
     {
       thumb->img_surf_dirty = FALSE;
       thumb->busy = FALSE;
+      thumb->img_box_w = image_w;
+      thumb->img_box_h = image_h;
     }
 
     // and we can also set the zooming level if needed
@@ -2364,6 +2376,7 @@ void dt_thumbnail_surface_destroy(dt_thumbnail_t *thumb)
     cairo_surface_destroy(thumb->img_surf);
   thumb->img_surf = NULL;
   thumb->img_surf_dirty = TRUE;
+  thumb->img_surf_cached = FALSE;
 }
 
 void dt_thumbnail_set_selection(dt_thumbnail_t *thumb,
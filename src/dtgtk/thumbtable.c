@@ -28,6 +28,7 @@
 #include "common/selection.h"
 #include "common/undo.h"
 #include "control/control.h"
+#include "control/jobs/image_jobs.h"
 #include "gui/accelerators.h"
 #include "gui/drag_and_drop.h"
 #include "views/view.h"
@@ -229,32 +230,28 @@ static dt_thumbnail_t *_thumb_get_under_mouse(dt_thumbtable_t *table)
 static dt_imgid_t _thumb_get_imgid(int rowid)
 {
   dt_imgid_t id = NO_IMGID;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf
-    ("SELECT imgid FROM memory.collected_images WHERE rowid=%d", rowid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db, "SELECT imgid FROM memory.collected_images WHERE rowid = ?1");
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rowid);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
     id = sqlite3_column_int(stmt, 0);
   }
-  g_free(query);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
   return id;
 }
 // get rowid from imgid
 static int _thumb_get_rowid(dt_imgid_t imgid)
 {
   int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf
-    ("SELECT rowid FROM memory.collected_images WHERE imgid=%d", imgid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db, "SELECT rowid FROM memory.collected_images WHERE imgid = ?1");
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
     id = sqlite3_column_int(stmt, 0);
   }
-  g_free(query);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
   return id;
 }
 
@@ -420,6 +417,7 @@ static gboolean _compute_sizes(dt_thumbtable_t *table, gboolean force)
   // if the thumb size has changed, we need to set overlays, etc... correctly
   if(table->thumb_size != old_size)
   {
+    _surf_cache_clear(table, NO_IMGID);
     _thumbs_update_overlays_mode(table);
   }
   return ret;
@@ -487,6 +485,84 @@ static gboolean _thumbtable_update_scrollbars(dt_thumbtable_t *table)
 
 // remove all unneeded thumbnails from the list and the widget
 // unneeded == completely hidden
+typedef struct _thumb_surf_t
+{
+  cairo_surface_t *surf;
+  int box_w, box_h;
+} _thumb_surf_t;
+
+static void _surf_free(gpointer data)
+{
+  _thumb_surf_t *ts = data;
+  cairo_surface_destroy(ts->surf);
+  g_free(ts);
+}
+
+// drop the cached surface of imgid, or of all images for NO_IMGID
+static void _surf_cache_clear(dt_thumbtable_t *table,
+                              const dt_imgid_t imgid)
+{
+  if(!table->surf_cache) return;
+
+  if(!dt_is_valid_imgid(imgid))
+  {
+    g_hash_table_remove_all(table->surf_cache);
+    g_queue_clear(table->surf_lru);
+  }
+  else if(g_hash_table_remove(table->surf_cache, GINT_TO_POINTER(imgid)))
+    g_queue_remove(table->surf_lru, GINT_TO_POINTER(imgid));
+}
+
+// keep the final surface of a thumbnail leaving the view. two screens of
+// thumbnails are kept, enough to scroll back and forth without creating
+// the surfaces from the mipmaps again.
+static void _surf_cache_store(dt_thumbtable_t *table,
+                              dt_thumbnail_t *thumb)
+{
+  if(!thumb->img_surf
+     || thumb->img_surf_dirty
+     || thumb->img_surf_preview
+     || thumb->zoomable
+     || thumb->display_focus
+     || cairo_surface_get_reference_count(thumb->img_surf) < 1)
+    return;
+
+  if(!table->surf_cache)
+  {
+    table->surf_cache = g_hash_table_new_full(NULL, NULL, NULL, _surf_free);
+    table->surf_lru = g_queue_new();
+  }
+
+  _surf_cache_clear(table, thumb->imgid);
+  _thumb_surf_t *ts = g_malloc(sizeof(_thumb_surf_t));
+  ts->surf = cairo_surface_reference(thumb->img_surf);
+  ts->box_w = thumb->img_box_w;
+  ts->box_h = thumb->img_box_h;
+  g_hash_table_insert(table->surf_cache, GINT_TO_POINTER(thumb->imgid), ts);
+  g_queue_push_tail(table->surf_lru, GINT_TO_POINTER(thumb->imgid));
+
+  const guint max_surfs = MAX(64, 2 * table->thumbs_per_row * table->rows);
+  while(g_queue_get_length(table->surf_lru) > max_surfs)
+    g_hash_table_remove(table->surf_cache, g_queue_pop_head(table->surf_lru));
+}
+
+// give the cached surface of the thumbnail image back to it
+static void _surf_cache_restore(dt_thumbtable_t *table,
+                                dt_thumbnail_t *thumb)
+{
+  if(!table->surf_cache || thumb->zoomable) return;
+
+  _thumb_surf_t *ts = g_hash_table_lookup(table->surf_cache, GINT_TO_POINTER(thumb->imgid));
+  if(!ts) return;
+
+  dt_thumbnail_surface_destroy(thumb);
+  thumb->img_surf = cairo_surface_reference(ts->surf);
+  thumb->img_box_w = ts->box_w;
+  thumb->img_box_h = ts->box_h;
+  thumb->img_surf_cached = TRUE;
+  _surf_cache_clear(table, thumb->imgid);
+}
+
 static int _thumbs_remove_unneeded(dt_thumbtable_t *table,
                                    GList **th_invalid)
 {
@@ -497,6 +573,7 @@ static int _thumbs_remove_unneeded(dt_thumbtable_t *table,
   for(const GList *l = *th_invalid; l; l = g_list_next(l))
   {
     dt_thumbnail_t *th = l->data;
+    _surf_cache_store(table, th);
     gtk_container_remove(GTK_CONTAINER(gtk_widget_get_parent(th->w_main)), th->w_main);
     dt_thumbnail_destroy(th);
     changed++;
@@ -533,6 +610,7 @@ static void _thumb_move_or_create(dt_thumbtable_t *table,
     }
     thumb->x = posx;
     thumb->y = posy;
+    _surf_cache_restore(table, thumb);
     if(top)
       table->list = g_list_prepend(table->list, thumb);
     else
@@ -548,6 +626,7 @@ static void _thumb_move_or_create(dt_thumbtable_t *table,
   {
     // let's reuse a now unaffected widget
     dt_thumbnail_t *thumb = (*th_invalid)->data;
+    _surf_cache_store(table, thumb);
     thumb->imgid = imgid;
     thumb->rowid = rowid;
     thumb->x = posx;
@@ -555,6 +634,7 @@ static void _thumb_move_or_create(dt_thumbtable_t *table,
     dt_thumbnail_reload_infos(thumb);
     dt_thumbnail_surface_destroy(thumb);
     thumb->img_surf_preview = FALSE;
+    _surf_cache_restore(table, thumb);
     gtk_layout_move(GTK_LAYOUT(table->widget), thumb->w_main, thumb->x, thumb->y);
     *th_invalid = g_list_delete_link(*th_invalid, *th_invalid);
     // insert the thumb at the right place in the table->list
@@ -690,6 +770,74 @@ static int _thumbs_load_needed(dt_thumbtable_t *table,
   return changed;
 }
 
+// queue the thumbnails of the next screens in the scroll direction, so
+// they are in the cache when they come into view. the faster the
+// scroll, the further ahead we look, up to DT_THUMBTABLE_PREFETCH_SCREENS.
+#define DT_THUMBTABLE_PREFETCH_SCREENS 4
+
+static void _prefetch_ahead(dt_thumbtable_t *table,
+                            const int move)
+{
+  if(!table->list
+     || (table->mode != DT_THUMBTABLE_MODE_FILEMANAGER
+         && table->mode != DT_THUMBTABLE_MODE_FILMSTRIP))
+    return;
+
+  // content moving up or left means we go toward the end of the collection
+  const int dir = move < 0 ? 1 : -1;
+  if(dir != table->prefetch_dir)
+  {
+    // the user reversed, what is queued behind us is of no use any more
+    if(table->prefetch_dir) dt_image_prefetch_cancel();
+    table->prefetch_dir = dir;
+    table->prefetch_rowid = 0;
+    table->prefetch_speed = 0.0f;
+  }
+
+  // smoothed speed in thumbnails per second, reset after a pause
+  const gint64 now = g_get_monotonic_time();
+  const float dt = (now - table->prefetch_time) * 1e-6f;
+  table->prefetch_time = now;
+  const float speed = abs(move) * table->thumbs_per_row / (float)table->thumb_size / MAX(dt, 0.001f);
+  table->prefetch_speed = dt > 0.5f ? 0.0f : 0.7f * table->prefetch_speed + 0.3f * speed;
+
+  // one second of scroll ahead, at least one screen
+  const int screen = table->thumbs_per_row * table->rows;
+  const int ahead = CLAMP((int)table->prefetch_speed, screen, DT_THUMBTABLE_PREFETCH_SCREENS * screen);
+
+  const dt_thumbnail_t *edge = dir > 0 ? g_list_last(table->list)->data : table->list->data;
+  int from = edge->rowid;
+  if(table->prefetch_rowid)
+    from = dir > 0 ? MAX(from, table->prefetch_rowid) : MIN(from, table->prefetch_rowid);
+  const int to = edge->rowid + dir * ahead;
+  if((to - from) * dir <= 0) return;
+
+  int w = 0, h = 0;
+  gtk_widget_get_size_request(edge->w_image_box, &w, &h);
+  if(w <= 0 || h <= 0) return;
+  const dt_mipmap_size_t mip =
+    dt_mipmap_cache_get_matching_size(w * darktable.gui->ppd, h * darktable.gui->ppd);
+
+  // nearest first, the queue is run in order
+  sqlite3_stmt *stmt;
+  // clang-format off
+  gchar *query = dir > 0
+    ? g_strdup_printf("SELECT rowid, imgid FROM memory.collected_images"
+                      " WHERE rowid>%d AND rowid<=%d ORDER BY rowid", from, to)
+    : g_strdup_printf("SELECT rowid, imgid FROM memory.collected_images"
+                      " WHERE rowid<%d AND rowid>=%d ORDER BY rowid DESC", from, to);
+  // clang-format on
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    table->prefetch_rowid = sqlite3_column_int(stmt, 0);
+    dt_control_add_job(DT_JOB_QUEUE_SYSTEM_BG,
+                       dt_image_prefetch_job_create(sqlite3_column_int(stmt, 1), mip));
+  }
+  g_free(query);
+  sqlite3_finalize(stmt);
+}
+
 // move all thumbs from the table.
 // if clamp, we verify that the move is allowed (collection bounds, etc...)
 static gboolean _move(dt_thumbtable_t *table,
@@ -831,6 +979,10 @@ static gboolean _move(dt_thumbtable_t *table,
   // update scrollbars
   _thumbtable_update_scrollbars(table);
 
+  // the loads queued for thumbnails scrolled away are dropped
+  dt_image_thumbnail_jobs_supersede();
+  _prefetch_ahead(table, table->mode == DT_THUMBTABLE_MODE_FILMSTRIP ? posx : posy);
+
   return TRUE;
 }
 
@@ -1758,6 +1910,7 @@ static void _dt_pref_change_callback(gpointer instance, dt_thumbtable_t *table)
   dt_stop_backthumbs_crawler(FALSE);
   // adjust the act_on algo class if needed
   dt_act_on_set_class(table->widget);
+  _surf_cache_clear(table, NO_IMGID);
 
   dt_get_sysresource_level();
   dt_opencl_update_settings();
@@ -1783,6 +1936,7 @@ static void _dt_profile_change_callback(gpointer instance,
   if(!table)
     return;
 
+  _surf_cache_clear(table, NO_IMGID);
   for(const GList *l = table->list; l; l = g_list_next(l))
   {
     dt_thumbnail_t *th = l->data;
@@ -1790,6 +1944,17 @@ static void _dt_profile_change_callback(gpointer instance,
   }
 }
 
+static void _dt_mipmaps_updated_callback(gpointer instance,
+                                         const dt_imgid_t imgid,
+                                         dt_thumbtable_t *table)
+{
+  if(!table)
+    return;
+
+  // the cached surface is outdated, the visible thumbnails reload on their own
+  _surf_cache_clear(table, imgid);
+}
+
 // this is called each time the list of active images change
 static void _dt_active_images_callback(gpointer instance, dt_thumbtable_t *table)
 {
@@ -2482,6 +2647,7 @@ dt_thumbtable_t *dt_thumbtable_new()
   DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_ACTIVE_IMAGES_CHANGE, _dt_active_images_callback, table);
   DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_CONTROL_PROFILE_USER_CHANGED, _dt_profile_change_callback, table);
   DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_PREFERENCES_CHANGE, _dt_pref_change_callback, table);
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, _dt_mipmaps_updated_callback, table);
   gtk_widget_show(table->widget);
 
   g_object_ref(table->widget);
@@ -2525,6 +2691,8 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table,
 
     const double start = dt_get_debug_wtime();
     table->dragging = FALSE;
+    // the layout changed, the prefetch starts again from the new edges
+    table->prefetch_rowid = 0;
     sqlite3_stmt *stmt;
     dt_print(DT_DEBUG_LIGHTTABLE,
              "reload thumbs from db. force=%d w=%d h=%d zoom=%d rows=%d size=%d"
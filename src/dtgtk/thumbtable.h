@@ -106,6 +106,17 @@ typedef struct dt_thumbtable_t
   guint scroll_timeout_id;
   float scroll_value;
 
+  // prefetch of the thumbnails ahead of the scroll
+  int prefetch_dir;        // 1 toward the end of the collection, -1 toward the start
+  int prefetch_rowid;      // furthest rowid already queued in that direction
+  float prefetch_speed;    // thumbnails per second
+  gint64 prefetch_time;    // of the last move
+
+  // image surfaces of thumbnails scrolled out of view, handed back when the
+  // image comes into view again
+  GHashTable *surf_cache;  // imgid -> surface
+  GQueue *surf_lru;        // imgids, least recently stored first
+
   // darkroom selection from filmstrip (support for single & double click)
   guint sel_single_cb;
   dt_imgid_t to_selid;
@@ -17,6 +17,7 @@
 */
 
 #include <glib.h>    // for g_mkdir_with_parents, _
+#include <glib/gstdio.h> // for g_fopen, g_unlink
 #include <gtk/gtk.h> // for gtk_init_check
 #include <libintl.h> // for bind_textdomain_codeset, etc
 #include <limits.h>  // for PATH_MAX
@@ -31,6 +32,7 @@
 #include "common/darktable.h"    // for darktable, darktable_t, dt_cleanup, etc
 #include "common/database.h"     // for dt_database_get
 #include "common/debug.h"        // for DT_DEBUG_SQLITE3_PREPARE_V2
+#include "common/dtpthread.h"    // for dt_pthread_create, dt_pthread_mutex_t
 #include "common/mipmap_cache.h" // for dt_mipmap_size_t, etc
 #include "common/file_location.h"
 #include "common/history.h"      // for dt_history_hash_set_mipmap
@@ -44,11 +46,130 @@
 #include "win/main_wrapper.h"
 #endif
 
-static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip, const dt_imgid_t min_imgid, const int32_t max_imgid)
+// work shared by the generator threads
+typedef struct _generate_t
+{
+  GArray *imgids;
+  dt_mipmap_size_t min_mip, max_mip;
+  uint32_t mips;            // bit mask of the levels to generate
+  dt_pthread_mutex_t lock;
+  size_t next;              // next image to hand out
+  size_t done;              // images finished
+  size_t skipped;           // images with current thumbnails
+  guint8 *finished;
+  size_t checkpoint;        // images with lower index are all finished
+  char checkpoint_file[PATH_MAX];
+} _generate_t;
+
+// the disk thumbnails of an edited image are outdated if its history
+// changed since they were written
+static gboolean _thumbnails_outdated(const dt_imgid_t imgid)
+{
+  sqlite3_stmt *stmt;
+  gboolean outdated = FALSE;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT 1 FROM main.history_hash"
+                              " WHERE imgid = ?1 AND current_hash IS NOT NULL"
+                              "   AND (mipmap_hash IS NULL OR mipmap_hash != current_hash)",
+                              -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  if(sqlite3_step(stmt) == SQLITE_ROW) outdated = TRUE;
+  sqlite3_finalize(stmt);
+  return outdated;
+}
+
+// returns TRUE if anything had to be generated
+static gboolean _generate_image(const _generate_t *gen, const dt_imgid_t imgid)
+{
+  if(_thumbnails_outdated(imgid))
+    dt_mipmap_cache_remove(imgid);
+
+  gboolean generated = FALSE;
+  for(int k = gen->max_mip; k >= gen->min_mip && k >= 0; k--)
+  {
+    if(!(gen->mips & (1u << k))) continue;
+    // if a valid thumbnail is already on disc - do nothing
+    if(dt_mipmap_cache_has_disk_thumbnail(imgid, k)) continue;
+
+    // else, generate thumbnail and store in mipmap cache.
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
+    dt_mipmap_cache_release(&buf);
+    generated = TRUE;
+  }
+
+  if(generated)
+  {
+    // and immediately write thumbs to disc and remove from mipmap cache.
+    dt_mipmap_cache_evict(imgid);
+    // thumbnail in sync with image
+    dt_history_hash_set_mipmap(imgid);
+  }
+  return generated;
+}
+
+static void _write_checkpoint(const _generate_t *gen)
+{
+  if(!gen->checkpoint) return;
+  FILE *f = g_fopen(gen->checkpoint_file, "w");
+  if(!f) return;
+  fprintf(f, "%d\n", g_array_index(gen->imgids, dt_imgid_t, gen->checkpoint - 1));
+  fclose(f);
+}
+
+static dt_imgid_t _read_checkpoint(const char *filename)
+{
+  dt_imgid_t imgid = NO_IMGID;
+  FILE *f = g_fopen(filename, "r");
+  if(!f) return imgid;
+  if(fscanf(f, "%d", &imgid) != 1) imgid = NO_IMGID;
+  fclose(f);
+  return imgid;
+}
+
+static void *_generate_worker(void *data)
+{
+  _generate_t *gen = data;
+  const size_t count = gen->imgids->len;
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&gen->lock);
+    const size_t i = gen->next++;
+    dt_pthread_mutex_unlock(&gen->lock);
+    if(i >= count) break;
+
+    const dt_imgid_t imgid = g_array_index(gen->imgids, dt_imgid_t, i);
+    const gboolean generated = _generate_image(gen, imgid);
+
+    dt_pthread_mutex_lock(&gen->lock);
+    gen->finished[i] = TRUE;
+    gen->done++;
+    if(!generated) gen->skipped++;
+    fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d)%s\n", gen->done, count,
+            100.0 * gen->done / (float)count, imgid, generated ? "" : " up to date");
+    // the checkpoint is the end of the leading run of finished images
+    const size_t old_checkpoint = gen->checkpoint;
+    while(gen->checkpoint < count && gen->finished[gen->checkpoint]) gen->checkpoint++;
+    if(gen->checkpoint / 100 != old_checkpoint / 100) _write_checkpoint(gen);
+    dt_pthread_mutex_unlock(&gen->lock);
+  }
+  return NULL;
+}
+
+static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip,
+                                    const dt_mipmap_size_t max_mip,
+                                    const uint32_t mips,
+                                    dt_imgid_t min_imgid,
+                                    const int32_t max_imgid,
+                                    const int threads,
+                                    const gboolean resume)
 {
   fprintf(stderr, _("creating cache directories\n"));
   for(dt_mipmap_size_t k = min_mip; k <= max_mip; k++)
   {
+    if(!(mips & (1u << k))) continue;
     char dirname[PATH_MAX] = { 0 };
     snprintf(dirname, sizeof(dirname), "%s.d/%d", darktable.mipmap_cache->cachedir, k);
 
@@ -60,67 +181,66 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // some progress counter
-  sqlite3_stmt *stmt;
-  size_t image_count = 0, counter = 0;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    image_count = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-  }
-  else
-  {
-    return 1;
-  }
+  _generate_t gen = { .min_mip = min_mip, .max_mip = max_mip, .mips = mips };
+  snprintf(gen.checkpoint_file, sizeof(gen.checkpoint_file),
+           "%s.d/generate-cache.checkpoint", darktable.mipmap_cache->cachedir);
 
-  if(!image_count)
+  if(resume)
   {
-    fprintf(stderr, _("warning: no images are matching the requested image id range\n"));
-    if(min_imgid > max_imgid)
+    const dt_imgid_t last = _read_checkpoint(gen.checkpoint_file);
+    if(dt_is_valid_imgid(last) && last >= min_imgid)
     {
-      fprintf(stderr, _("warning: did you want to swap these boundaries?\n"));
+      fprintf(stderr, _("resuming after image id %d\n"), last);
+      min_imgid = last + 1;
     }
   }
 
   // go through all images:
+  sqlite3_stmt *stmt;
+  gen.imgids = g_array_new(FALSE, FALSE, sizeof(dt_imgid_t));
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT id, filename FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
+                              "SELECT id FROM main.images WHERE id >= ?1 AND id <= ?2 ORDER BY id",
+                              -1, &stmt, 0);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
-    const char *imgfilename = (const char*)sqlite3_column_text(stmt, 1);
-
-    counter++;
-    fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d, file=%s)\n", counter, image_count, 100.0 * counter / (float)image_count, imgid, imgfilename);
+    g_array_append_val(gen.imgids, imgid);
+  }
+  sqlite3_finalize(stmt);
 
-    for(int k = max_mip; k >= min_mip && k >= 0; k--)
+  const size_t image_count = gen.imgids->len;
+  if(!image_count)
+  {
+    fprintf(stderr, _("warning: no images are matching the requested image id range\n"));
+    if(min_imgid > max_imgid)
     {
-      char filename[PATH_MAX] = { 0 };
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
+      fprintf(stderr, _("warning: did you want to swap these boundaries?\n"));
+    }
+  }
 
-      // if a valid thumbnail file is already on disc - do nothing
-      if(dt_util_test_image_file(filename)) continue;
+  gen.finished = g_malloc0(MAX(image_count, 1));
+  dt_pthread_mutex_init(&gen.lock, NULL);
 
-      // else, generate thumbnail and store in mipmap cache.
-      dt_mipmap_buffer_t buf;
-      dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
-      dt_mipmap_cache_release(&buf);
-    }
+  const int nthreads = CLAMP(threads, 1, MAX((int)image_count, 1));
+  pthread_t *workers = g_new(pthread_t, nthreads);
+  int started = 0;
+  for(int t = 0; t < nthreads; t++)
+    if(!dt_pthread_create(&workers[started], _generate_worker, &gen)) started++;
+  // the main thread helps if no thread could be started
+  if(!started) _generate_worker(&gen);
+  for(int t = 0; t < started; t++)
+    dt_pthread_join(workers[t]);
+  g_free(workers);
 
-    // and immediately write thumbs to disc and remove from mipmap cache.
-    dt_mipmap_cache_evict(imgid);
-    // thumbnail in sync with image
-    dt_history_hash_set_mipmap(imgid);
-  }
+  dt_pthread_mutex_destroy(&gen.lock);
+  g_free(gen.finished);
+  g_array_free(gen.imgids, TRUE);
 
-  sqlite3_finalize(stmt);
-  fprintf(stderr, "done\n");
+  // everything has been done, the next run starts from scratch
+  g_unlink(gen.checkpoint_file);
+  fprintf(stderr, "done, %zu of %zu images were up to date\n", gen.skipped, image_count);
 
   return 0;
 }
@@ -130,14 +250,20 @@ static void usage(const char *progname)
   fprintf(stderr,
           "usage: %s [-h, --help; --version]\n"
           "  [--min-mip <0-8> (default = 0)] [-m, --max-mip <0-8> (default = 2)]\n"
+          "  [--mips <list of 0-8, e.g. 2,5>]\n"
           "  [--min-imgid <N>] [--max-imgid <N>]\n"
+          "  [-j, --threads <N> (default = 2)] [--resume]\n"
           "  [--core <darktable options>]\n"
           "\n"
           "When multiple mipmap sizes are requested, the biggest one is computed\n"
-          "while the rest are quickly downsampled.\n"
+          "while the rest are quickly downsampled. --mips generates only the listed\n"
+          "sizes instead of all between --min-mip and --max-mip.\n"
           "\n"
           "The --min-imgid and --max-imgid specify the range of internal image ID\n"
-          "numbers to work on.\n",
+          "numbers to work on.\n"
+          "\n"
+          "Images with up to date thumbnails on disk are skipped. The progress is\n"
+          "saved while running, --resume continues an interrupted run from there.\n",
           progname);
 }
 
@@ -163,6 +289,9 @@ int main(int argc, char *arg[])
   dt_mipmap_size_t max_mip = DT_MIPMAP_2;
   dt_imgid_t min_imgid = NO_IMGID;
   int32_t max_imgid = INT32_MAX;
+  uint32_t mips = 0;
+  int threads = 2;
+  gboolean resume = FALSE;
 
   int k;
   for(k = 1; k < argc; k++)
@@ -188,6 +317,23 @@ int main(int argc, char *arg[])
       k++;
       min_mip = (dt_mipmap_size_t)MIN(MAX(atoi(arg[k]), DT_MIPMAP_0), DT_MIPMAP_8);
     }
+    else if(!strcmp(arg[k], "--mips") && argc > k + 1)
+    {
+      k++;
+      gchar **levels = g_strsplit(arg[k], ",", -1);
+      for(gchar **l = levels; *l; l++)
+        if(**l) mips |= 1u << MIN(MAX(atoi(*l), DT_MIPMAP_0), DT_MIPMAP_8);
+      g_strfreev(levels);
+    }
+    else if((!strcmp(arg[k], "-j") || !strcmp(arg[k], "--threads")) && argc > k + 1)
+    {
+      k++;
+      threads = MAX(atoi(arg[k]), 1);
+    }
+    else if(!strcmp(arg[k], "--resume"))
+    {
+      resume = TRUE;
+    }
     else if(!strcmp(arg[k], "--min-imgid") && argc > k + 1)
     {
       k++;
@@ -214,6 +360,21 @@ int main(int argc, char *arg[])
   for(; k < argc; k++) m_arg[m_argc++] = arg[k];
   m_arg[m_argc] = NULL;
 
+  // an explicit list of levels decides the range
+  if(mips)
+  {
+    min_mip = DT_MIPMAP_8;
+    max_mip = DT_MIPMAP_0;
+    for(dt_mipmap_size_t l = DT_MIPMAP_0; l <= DT_MIPMAP_8; l++)
+      if(mips & (1u << l))
+      {
+        min_mip = MIN(min_mip, l);
+        max_mip = MAX(max_mip, l);
+      }
+  }
+  else
+    mips = ~0u;
+
   // init dt without gui:
   if(dt_init(m_argc, m_arg, FALSE, TRUE, NULL, NULL)) // NULL applicationdir = auto-detect
   {
@@ -251,7 +412,7 @@ int main(int argc, char *arg[])
 
   fprintf(stderr, _("creating complete lighttable thumbnail cache\n"));
 
-  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid))
+  if(generate_thumbnail_cache(min_mip, max_mip, mips, min_imgid, max_imgid, threads, resume))
   {
     free(m_arg);
     exit(EXIT_FAILURE);
@@ -34,7 +34,6 @@
 #include <avif/avif.h>
 
 #define AVIF_MIN_TILE_SIZE 512
-#define AVIF_MAX_TILE_SIZE 3072
 #define AVIF_DEFAULT_TILE_SIZE AVIF_MIN_TILE_SIZE * 2
 
 DT_MODULE(2)
@@ -121,28 +120,6 @@ static const char *avif_get_compression_string(enum avif_compression_type_e comp
   }
 }
 
-/* Lookup table for tiling choices */
-static int floor_log2(int i)
-{
-  static const int floor_log2_table[] =
-    /* 0   1,  2,  3,  4,  5,  6,  7,  8,  9 */
-    {  0,  0,  2,  2,  4,  4,  4,  4,  8,  8,
-       8,  8,  8,  8,  8,  8, 16, 16, 16, 16,
-      16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
-      16, 16, 32, 32, 32, 32, 32, 32, 32, 32,
-      32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
-      32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
-      32, 32, 32, 32 };
-    /* 0   1,  2,  3,  4,  5,  6,  7,  8,  9 */
-
-  if(i >= 64)
-  {
-    return 64;
-  }
-
-  return floor_log2_table[i];
-}
-
 void init(dt_imageio_module_format_t *self)
 {
   const char *codecName = avifCodecName(AVIF_CODEC_CHOICE_AUTO,
@@ -603,46 +580,44 @@ int write_image(struct dt_imageio_module_data_t *data,
       break;
   }
 
+  // the AV1 encoders use threads for rows even without tiles
+  encoder->maxThreads = dt_get_num_threads();
+
   /*
    * Tiling reduces the image quality but it has a negligible impact on
    * still images.
    *
-   * The minimum size for a tile is 512x512. We use a default tile size of
-   * 1024x1024.
+   * The minimum size for a tile is 512x512. We use tiles of at least
+   * 1024x1024 and split the image until there is a tile per thread,
+   * always halving the longer tile side.
    */
   switch(d->tiling)
   {
     case AVIF_TILING_ON:
     {
-      size_t width_tile_size  = AVIF_DEFAULT_TILE_SIZE;
-      size_t height_tile_size = AVIF_DEFAULT_TILE_SIZE;
-      size_t max_threads;
+      int cols_log2 = 0;
+      int rows_log2 = 0;
 
-      if(width >= 6144)
+      // AV1 allows up to 64 tile columns and rows
+      while((1 << (cols_log2 + rows_log2)) < encoder->maxThreads)
       {
-        width_tile_size = AVIF_MIN_TILE_SIZE * 4;
-      }
-      else if(width >= 8192) {
-        width_tile_size = AVIF_MAX_TILE_SIZE;
-      }
-      if(height >= 6144)
-      {
-        height_tile_size = AVIF_MIN_TILE_SIZE * 4;
-      }
-      else if(height >= 8192) {
-        height_tile_size = AVIF_MAX_TILE_SIZE;
+        const size_t tile_width = width >> cols_log2;
+        const size_t tile_height = height >> rows_log2;
+        const gboolean split_cols = cols_log2 < 6
+                                    && tile_width / 2 >= AVIF_DEFAULT_TILE_SIZE;
+        const gboolean split_rows = rows_log2 < 6
+                                    && tile_height / 2 >= AVIF_DEFAULT_TILE_SIZE;
+
+        if(split_cols && (tile_width >= tile_height || !split_rows))
+          cols_log2++;
+        else if(split_rows)
+          rows_log2++;
+        else
+          break;
       }
 
-      encoder->tileColsLog2 = floor_log2(width / width_tile_size) / 2;
-      encoder->tileRowsLog2 = floor_log2(height / height_tile_size) / 2;
-
-      /*
-       * This should be set to the final number of tiles, based on
-       * encoder->tileColsLog2 and encoder->tileRowsLog2.
-       */
-      max_threads = (1 << encoder->tileRowsLog2) * (1 << encoder->tileColsLog2);
-
-      encoder->maxThreads = MIN(max_threads, dt_get_num_threads());
+      encoder->tileColsLog2 = cols_log2;
+      encoder->tileRowsLog2 = rows_log2;
     }
     case AVIF_TILING_OFF:
       break;
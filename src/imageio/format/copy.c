@@ -49,7 +49,7 @@ int write_image(dt_imageio_module_data_t *data, const char *filename, const void
 
   if(!strcmp(sourcefile, targetfile)) goto END;
 
-  dt_copy_file(sourcefile, targetfile);
+  if(!dt_copy_file(sourcefile, targetfile)) goto END;
 
   // we got a copy of the file, now write the xmp data
   xmpfile = g_strconcat(targetfile, ".xmp", NULL);
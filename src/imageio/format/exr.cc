@@ -44,6 +44,10 @@ G_BEGIN_DECLS
 
 DT_MODULE(5)
 
+// scanlines converted to half per OutputFile::writePixels() call, a
+// multiple of the largest compression block (DWAB, 256 lines)
+#define EXR_HALF_BAND_ROWS ((size_t)256)
+
 enum dt_imageio_exr_compression_t
 {
   NO_COMPRESSION = 0,     // no compression
@@ -243,38 +247,16 @@ icc_end:
   }
   else
   {
+    // the half RGB conversion only needs a band of scanlines at a time,
+    // the R/G/B slices are pointed at it band by band when writing below
     const size_t width = exr->global.width;
-    const size_t height = exr->global.height;
-    stride = 3 * sizeof(unsigned short);
-    out_image = dt_alloc_aligned(stride * width * height);
+    const size_t rows = MIN(EXR_HALF_BAND_ROWS, (size_t)exr->global.height);
+    out_image = dt_alloc_aligned(3 * sizeof(unsigned short) * width * rows);
     if(out_image == NULL)
     {
       dt_print(DT_DEBUG_ALWAYS, "[exr export] error allocating image conversion buffer");
       return 1;
     }
-
-    DT_OMP_FOR(collapse(2))
-    for(size_t y = 0; y < height; y++)
-    {
-      for(size_t x = 0; x < width; x++)
-      {
-        const float *in_pixel = (const float *)in_tmp + 4 * ((y * width) + x);
-        unsigned short *out_pixel = (unsigned short *)out_image + 3 * ((y * width) + x);
-
-        out_pixel[0] = half(in_pixel[0]).bits();
-        out_pixel[1] = half(in_pixel[1]).bits();
-        out_pixel[2] = half(in_pixel[2]).bits();
-      }
-    }
-
-    data.insert("R", Imf::Slice(pixel_type, (char *)out_image, stride,
-                                stride * exr->global.width));
-
-    data.insert("G", Imf::Slice(pixel_type, (char *)((unsigned short *)out_image + 1), stride,
-                                stride * exr->global.width));
-
-    data.insert("B", Imf::Slice(pixel_type, (char *)((unsigned short *)out_image + 2), stride,
-                                stride * exr->global.width));
   }
 
   // add masks as additional channels
@@ -354,8 +336,47 @@ icc_end:
   // write out to file
   Imf::OutputFile file(filename, header);
 
-  file.setFrameBuffer(data);
-  file.writePixels(exr->global.height);
+  if(pixel_type == Imf::PixelType::FLOAT)
+  {
+    file.setFrameBuffer(data);
+    file.writePixels(exr->global.height);
+  }
+  else
+  {
+    const size_t width = exr->global.width;
+    const size_t height = exr->global.height;
+    const size_t half_stride = 3 * sizeof(unsigned short);
+
+    for(size_t y0 = 0; y0 < height; y0 += EXR_HALF_BAND_ROWS)
+    {
+      const size_t rows = MIN(EXR_HALF_BAND_ROWS, height - y0);
+
+      DT_OMP_FOR(collapse(2))
+      for(size_t y = 0; y < rows; y++)
+      {
+        for(size_t x = 0; x < width; x++)
+        {
+          const float *in_pixel = (const float *)in_tmp + 4 * (((y0 + y) * width) + x);
+          unsigned short *out_pixel = (unsigned short *)out_image + 3 * ((y * width) + x);
+
+          out_pixel[0] = half(in_pixel[0]).bits();
+          out_pixel[1] = half(in_pixel[1]).bits();
+          out_pixel[2] = half(in_pixel[2]).bits();
+        }
+      }
+
+      // slices address absolute scanlines, so shift the base back by y0 rows
+      char *base = (char *)out_image - y0 * half_stride * width;
+      data.insert("R", Imf::Slice(pixel_type, base, half_stride, half_stride * width));
+      data.insert("G", Imf::Slice(pixel_type, base + sizeof(unsigned short), half_stride,
+                                  half_stride * width));
+      data.insert("B", Imf::Slice(pixel_type, base + 2 * sizeof(unsigned short), half_stride,
+                                  half_stride * width));
+
+      file.setFrameBuffer(data);
+      file.writePixels(rows);
+    }
+  }
 
   // clean up
   dt_free_align(out_image);
@@ -168,6 +168,282 @@ static void write_icc_profile(j_compress_ptr cinfo,
 #undef MAX_SEQ_NO
 
 
+// compression parameters shared by the serial and the strip encoders,
+// image size and input format must be set already
+static void _set_compress_params(j_compress_ptr cinfo,
+                                 const int quality,
+                                 const int subsample,
+                                 const int resolution)
+{
+  jpeg_set_defaults(cinfo);
+  jpeg_set_quality(cinfo, quality, TRUE);
+
+  if(quality > 90) cinfo->comp_info[0].v_samp_factor = 1;
+  if(quality > 92) cinfo->comp_info[0].h_samp_factor = 1;
+  if(quality > 95) cinfo->dct_method = JDCT_FLOAT;
+  if(quality < 50) cinfo->dct_method = JDCT_IFAST;
+  if(quality < 80) cinfo->smoothing_factor = 20;
+  if(quality < 60) cinfo->smoothing_factor = 40;
+  if(quality < 40) cinfo->smoothing_factor = 60;
+  cinfo->optimize_coding = 1;
+
+  // Common part for all subsampling formulas:
+  cinfo->comp_info[1].h_samp_factor = 1;
+  cinfo->comp_info[1].v_samp_factor = 1;
+  cinfo->comp_info[2].h_samp_factor = 1;
+  cinfo->comp_info[2].v_samp_factor = 1;
+
+  switch(subsample)
+  {
+    case 1: // 1x1 1x1 1x1 (4:4:4) : No chroma subsampling
+    {
+      cinfo->comp_info[0].h_samp_factor = 1;
+      cinfo->comp_info[0].v_samp_factor = 1;
+      break;
+    }
+    case 2: // 1x2 1x1 1x1 (4:4:0) : Color sampling rate halved vertically
+    {
+      cinfo->comp_info[0].h_samp_factor = 1;
+      cinfo->comp_info[0].v_samp_factor = 2;
+      break;
+    }
+    case 3: // 2x1 1x1 1x1 (4:2:2) : Color sampling rate halved horizontally
+    {
+      cinfo->comp_info[0].h_samp_factor = 2;
+      cinfo->comp_info[0].v_samp_factor = 1;
+      break;
+    }
+    case 4: // 2x2 1x1 1x1 (4:2:0) : Color sampling rate halved horizontally and vertically
+    {
+      cinfo->comp_info[0].h_samp_factor = 2;
+      cinfo->comp_info[0].v_samp_factor = 2;
+      break;
+    }
+  }
+
+  cinfo->density_unit = 1;
+  cinfo->X_density = resolution;
+  cinfo->Y_density = resolution;
+}
+
+static void _write_rows(j_compress_ptr cinfo,
+                        const uint8_t *in,
+                        uint8_t *row)
+{
+  while(cinfo->next_scanline < cinfo->image_height)
+  {
+    JSAMPROW tmp[1];
+    const uint8_t *buf = in + (size_t)cinfo->next_scanline * cinfo->image_width * 4;
+    for(JDIMENSION i = 0; i < cinfo->image_width; i++)
+      for(int k = 0; k < 3; k++) row[3 * i + k] = buf[4 * i + k];
+    tmp[0] = row;
+    jpeg_write_scanlines(cinfo, tmp, 1);
+  }
+}
+
+/*
+ * Large images are compressed in horizontal strips of whole MCU rows on
+ * all cores. Every strip is a complete JPEG of its own using the standard
+ * Huffman tables, so they all share the very same tables. The output is
+ * the header of the first strip, with the full image height and a restart
+ * interval of one strip, followed by the entropy-coded segments of all
+ * strips separated by RSTn markers: a decoder resets its DC predictors at
+ * every marker just like a fresh encoder starts from zero.
+ */
+
+#if JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED)
+#define HAVE_JPEG_MEM_DEST
+
+#define PARALLEL_MIN_PIXELS (8 * 1024 * 1024)
+
+typedef struct _jpeg_strip_t
+{
+  unsigned char *data;
+  unsigned long size;
+} _jpeg_strip_t;
+
+static gboolean _compress_strip(const uint8_t *in,
+                                const int width,
+                                const int height,
+                                const int quality,
+                                const int subsample,
+                                const int resolution,
+                                const JOCTET *icc,
+                                const unsigned int icc_len,
+                                _jpeg_strip_t *strip)
+{
+  uint8_t *row = dt_alloc_align_uint8(3 * width);
+  if(!row) return TRUE;
+
+  struct jpeg_compress_struct cinfo;
+  struct dt_imageio_jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
+  if(setjmp(jerr.setjmp_buffer))
+  {
+    jpeg_destroy_compress(&cinfo);
+    dt_free_align(row);
+    return TRUE;
+  }
+  jpeg_create_compress(&cinfo);
+  jpeg_mem_dest(&cinfo, &strip->data, &strip->size);
+
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  _set_compress_params(&cinfo, quality, subsample, resolution);
+  cinfo.optimize_coding = 0;
+
+  jpeg_start_compress(&cinfo, TRUE);
+  if(icc) write_icc_profile(&cinfo, icc, icc_len);
+  _write_rows(&cinfo, in, row);
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  dt_free_align(row);
+  return FALSE;
+}
+
+// offset of the entropy-coded data, 0 if there is none. Also finds the
+// SOF and SOS segments.
+static size_t _strip_scan_start(const _jpeg_strip_t *strip,
+                                size_t *sof,
+                                size_t *sos)
+{
+  const unsigned char *d = strip->data;
+  size_t pos = 2;
+  while(pos + 4 <= strip->size && d[pos] == 0xFF)
+  {
+    const int marker = d[pos + 1];
+    const size_t len = (d[pos + 2] << 8) | d[pos + 3];
+    if(marker == 0xC0 || marker == 0xC1) *sof = pos;
+    if(marker == 0xDA)
+    {
+      *sos = pos;
+      return pos + 2 + len;
+    }
+    pos += 2 + len;
+  }
+  return 0;
+}
+
+static gboolean _write_strips(FILE *f,
+                              const _jpeg_strip_t *strips,
+                              const int nstrips,
+                              const int height,
+                              const unsigned int restart_interval)
+{
+  for(int k = 0; k < nstrips; k++)
+    if(strips[k].size < 4 || strips[k].data[strips[k].size - 1] != 0xD9)
+      return TRUE;
+
+  size_t sof = 0, sos = 0;
+  if(!_strip_scan_start(&strips[0], &sof, &sos) || !sof || sof > sos) return TRUE;
+  const unsigned char *d = strips[0].data;
+
+  const unsigned char sof_height[2] = { height >> 8, height & 0xff };
+  const unsigned char dri[6] = { 0xFF, 0xDD, 0x00, 0x04,
+                                 restart_interval >> 8, restart_interval & 0xff };
+  gboolean error = fwrite(d, 1, sof + 5, f) != sof + 5
+    || fwrite(sof_height, 1, 2, f) != 2
+    || fwrite(d + sof + 7, 1, sos - sof - 7, f) != sos - sof - 7
+    || fwrite(dri, 1, 6, f) != 6
+    || fwrite(d + sos, 1, strips[0].size - 2 - sos, f) != strips[0].size - 2 - sos;
+
+  for(int k = 1; k < nstrips && !error; k++)
+  {
+    size_t k_sof = 0, k_sos = 0;
+    const size_t begin = _strip_scan_start(&strips[k], &k_sof, &k_sos);
+    const unsigned char rst[2] = { 0xFF, 0xD0 + ((k - 1) & 7) };
+    error = !begin
+      || fwrite(rst, 1, 2, f) != 2
+      || fwrite(strips[k].data + begin, 1, strips[k].size - 2 - begin, f)
+         != strips[k].size - 2 - begin;
+  }
+
+  const unsigned char eoi[2] = { 0xFF, 0xD9 };
+  return error || fwrite(eoi, 1, 2, f) != 2;
+}
+
+// returns -1 if the image isn't split, the caller compresses it serially
+static int _write_parallel(const char *filename,
+                           const uint8_t *in,
+                           const int width,
+                           const int height,
+                           const int quality,
+                           const int subsample,
+                           const int resolution,
+                           const JOCTET *icc,
+                           const unsigned int icc_len)
+{
+  if(dt_get_num_threads() < 2
+     || (size_t)width * height < PARALLEL_MIN_PIXELS
+     || !dt_conf_get_bool("plugins/imageio/format/jpeg/parallel"))
+    return -1;
+
+  // the luma sampling factors give the MCU size
+  struct jpeg_compress_struct cinfo;
+  struct dt_imageio_jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
+  if(setjmp(jerr.setjmp_buffer))
+  {
+    jpeg_destroy_compress(&cinfo);
+    return -1;
+  }
+  jpeg_create_compress(&cinfo);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  _set_compress_params(&cinfo, quality, subsample, resolution);
+  const int mcu_width = 8 * cinfo.comp_info[0].h_samp_factor;
+  const int mcu_height = 8 * cinfo.comp_info[0].v_samp_factor;
+  jpeg_destroy_compress(&cinfo);
+
+  // a restart interval is 16 bits of MCUs, and a few strips per thread
+  // keep the cores busy until the end
+  const int mcus_per_row = (width + mcu_width - 1) / mcu_width;
+  const int mcu_rows = (height + mcu_height - 1) / mcu_height;
+  const int max_strip_rows = 65535 / mcus_per_row;
+  const int want_strip_rows = (mcu_rows + 4 * dt_get_num_threads() - 1) / (4 * dt_get_num_threads());
+  const int strip_mcu_rows = MIN(max_strip_rows, want_strip_rows);
+  if(strip_mcu_rows < 1) return -1;
+  const int strip_height = strip_mcu_rows * mcu_height;
+  const int nstrips = (height + strip_height - 1) / strip_height;
+  if(nstrips < 2) return -1;
+
+  _jpeg_strip_t *strips = g_new0(_jpeg_strip_t, nstrips);
+  int failed = 0;
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic) reduction(| : failed))
+  for(int k = 0; k < nstrips; k++)
+  {
+    const int y0 = k * strip_height;
+    failed |= _compress_strip(in + (size_t)4 * y0 * width, width,
+                              MIN(strip_height, height - y0),
+                              quality, subsample, resolution,
+                              k == 0 ? icc : NULL, icc_len, &strips[k]);
+  }
+
+  if(!failed)
+  {
+    FILE *f = g_fopen(filename, "wb");
+    failed = !f || _write_strips(f, strips, nstrips, height,
+                                 (unsigned int)strip_mcu_rows * mcus_per_row);
+    if(f) failed |= fclose(f) != 0;
+  }
+
+  for(int k = 0; k < nstrips; k++) free(strips[k].data);
+  g_free(strips);
+
+  dt_print(DT_DEBUG_IMAGEIO, "[jpeg write] %dx%d in %d strips%s",
+           width, height, nstrips, failed ? " failed" : "");
+  return failed ? 1 : 0;
+}
+
+#undef PARALLEL_MIN_PIXELS
+#endif // JPEG_LIB_VERSION >= 80 || MEM_SRCDST_SUPPORTED
+
 int write_image(dt_imageio_module_data_t *jpg_tmp,
                 const char *filename,
                 const void *in_tmp,
@@ -182,6 +458,30 @@ int write_image(dt_imageio_module_data_t *jpg_tmp,
 {
   dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
   const uint8_t *in = (const uint8_t *)in_tmp;
+  const int subsample = dt_conf_get_int("plugins/imageio/format/jpeg/subsample");
+  const int resolution = dt_conf_get_int("metadata/resolution");
+
+  cmsHPROFILE out_profile =
+    dt_colorspaces_get_output_profile(imgid, over_type, over_filename)->profile;
+  uint32_t len = 0;
+  cmsSaveProfileToMem(out_profile, NULL, &len);
+  unsigned char *icc = len > 0 ? malloc(sizeof(unsigned char) * len) : NULL;
+  if(icc) cmsSaveProfileToMem(out_profile, icc, &len);
+
+#ifdef HAVE_JPEG_MEM_DEST
+  const int parallel = _write_parallel(filename, in, jpg->global.width, jpg->global.height,
+                                       jpg->quality, subsample, resolution, icc, len);
+#else
+  const int parallel = -1;
+#endif
+  if(parallel >= 0)
+  {
+    free(icc);
+    if(parallel) return 1;
+    if(exif) dt_exif_write_blob(exif, exif_len, filename, 1);
+    return 0;
+  }
+
   struct dt_imageio_jpeg_error_mgr jerr;
 
   jpg->cinfo.err = jpeg_std_error(&jerr.pub);
@@ -189,101 +489,35 @@ int write_image(dt_imageio_module_data_t *jpg_tmp,
   if(setjmp(jerr.setjmp_buffer))
   {
     jpeg_destroy_compress(&(jpg->cinfo));
+    free(icc);
     return 1;
   }
   jpeg_create_compress(&(jpg->cinfo));
   FILE *f = g_fopen(filename, "wb");
-  if(!f) return 1;
+  if(!f)
+  {
+    free(icc);
+    return 1;
+  }
   jpeg_stdio_dest(&(jpg->cinfo), f);
 
   jpg->cinfo.image_width = jpg->global.width;
   jpg->cinfo.image_height = jpg->global.height;
   jpg->cinfo.input_components = 3;
   jpg->cinfo.in_color_space = JCS_RGB;
-  jpeg_set_defaults(&(jpg->cinfo));
-  jpeg_set_quality(&(jpg->cinfo), jpg->quality, TRUE);
-
-  if(jpg->quality > 90) jpg->cinfo.comp_info[0].v_samp_factor = 1;
-  if(jpg->quality > 92) jpg->cinfo.comp_info[0].h_samp_factor = 1;
-  if(jpg->quality > 95) jpg->cinfo.dct_method = JDCT_FLOAT;
-  if(jpg->quality < 50) jpg->cinfo.dct_method = JDCT_IFAST;
-  if(jpg->quality < 80) jpg->cinfo.smoothing_factor = 20;
-  if(jpg->quality < 60) jpg->cinfo.smoothing_factor = 40;
-  if(jpg->quality < 40) jpg->cinfo.smoothing_factor = 60;
-  jpg->cinfo.optimize_coding = 1;
-
-  // Common part for all subsampling formulas:
-  jpg->cinfo.comp_info[1].h_samp_factor = 1;
-  jpg->cinfo.comp_info[1].v_samp_factor = 1;
-  jpg->cinfo.comp_info[2].h_samp_factor = 1;
-  jpg->cinfo.comp_info[2].v_samp_factor = 1;
-
-  const int subsample = dt_conf_get_int("plugins/imageio/format/jpeg/subsample");
-  switch(subsample)
-  {
-    case 1: // 1x1 1x1 1x1 (4:4:4) : No chroma subsampling
-    {
-      jpg->cinfo.comp_info[0].h_samp_factor = 1;
-      jpg->cinfo.comp_info[0].v_samp_factor = 1;
-      break;
-    }
-    case 2: // 1x2 1x1 1x1 (4:4:0) : Color sampling rate halved vertically
-    {
-      jpg->cinfo.comp_info[0].h_samp_factor = 1;
-      jpg->cinfo.comp_info[0].v_samp_factor = 2;
-      break;
-    }
-    case 3: // 2x1 1x1 1x1 (4:2:2) : Color sampling rate halved horizontally
-    {
-      jpg->cinfo.comp_info[0].h_samp_factor = 2;
-      jpg->cinfo.comp_info[0].v_samp_factor = 1;
-      break;
-    }
-    case 4: // 2x2 1x1 1x1 (4:2:0) : Color sampling rate halved horizontally and vertically
-    {
-      jpg->cinfo.comp_info[0].h_samp_factor = 2;
-      jpg->cinfo.comp_info[0].v_samp_factor = 2;
-      break;
-    }
-  }
-
-  const int resolution = dt_conf_get_int("metadata/resolution");
-  jpg->cinfo.density_unit = 1;
-  jpg->cinfo.X_density = resolution;
-  jpg->cinfo.Y_density = resolution;
+  _set_compress_params(&(jpg->cinfo), jpg->quality, subsample, resolution);
 
   jpeg_start_compress(&(jpg->cinfo), TRUE);
 
-  cmsHPROFILE out_profile =
-    dt_colorspaces_get_output_profile(imgid, over_type, over_filename)->profile;
-  uint32_t len = 0;
-  cmsSaveProfileToMem(out_profile, NULL, &len);
-  if(len > 0)
-  {
-    unsigned char *buf = malloc(sizeof(unsigned char) * len);
-    if(buf)
-    {
-      cmsSaveProfileToMem(out_profile, buf, &len);
-      write_icc_profile(&(jpg->cinfo), buf, len);
-      free(buf);
-    }
-  }
+  if(icc) write_icc_profile(&(jpg->cinfo), icc, len);
 
   uint8_t *row = dt_alloc_align_uint8(3 * jpg->global.width);
-  const uint8_t *buf;
-  while(row && jpg->cinfo.next_scanline < jpg->cinfo.image_height)
-  {
-    JSAMPROW tmp[1];
-    buf = in + (size_t)jpg->cinfo.next_scanline * jpg->cinfo.image_width * 4;
-    for(int i = 0; i < jpg->global.width; i++)
-      for(int k = 0; k < 3; k++) row[3 * i + k] = buf[4 * i + k];
-    tmp[0] = row;
-    jpeg_write_scanlines(&(jpg->cinfo), tmp, 1);
-  }
+  if(row) _write_rows(&(jpg->cinfo), in, row);
   jpeg_finish_compress(&(jpg->cinfo));
   dt_free_align(row);
   jpeg_destroy_compress(&(jpg->cinfo));
   fclose(f);
+  free(icc);
 
   if(exif) dt_exif_write_blob(exif, exif_len, filename, 1);
 
@@ -21,6 +21,7 @@
 #include "common/darktable.h"
 #include "common/exif.h"
 #include "control/conf.h"
+#include "control/control.h"
 #include "imageio/imageio_common.h"
 #include "imageio/format/imageio_format_api.h"
 
@@ -104,6 +105,72 @@ int bpp(dt_imageio_module_data_t *data)
   return 32; /* always request float */
 }
 
+#if JPEGXL_NUMERIC_VERSION >= JPEGXL_COMPUTE_NUMERIC_VERSION(0, 10, 0)
+#define HAVE_JXL_CHUNKED_FRAME
+// libjxl pulls the frame rectangle by rectangle from this source, so the
+// RGBx pipe output is repacked one group at a time instead of as a
+// second full-size RGB float buffer.
+typedef struct _jxl_chunk_source_t
+{
+  const float *in;
+  size_t width;
+} _jxl_chunk_source_t;
+
+static void _chunk_pixel_format(void *opaque, JxlPixelFormat *pixel_format)
+{
+  *pixel_format = (JxlPixelFormat){ 3, JXL_TYPE_FLOAT, JXL_NATIVE_ENDIAN, 0 };
+}
+
+// may be called concurrently from the encoder threads
+static const void *_chunk_color_data(void *opaque,
+                                     const size_t xpos,
+                                     const size_t ypos,
+                                     const size_t xsize,
+                                     const size_t ysize,
+                                     size_t *row_offset)
+{
+  const _jxl_chunk_source_t *src = (const _jxl_chunk_source_t *)opaque;
+  float *rect = g_try_malloc(xsize * ysize * 3 * sizeof(float));
+  if(!rect) return NULL;
+
+  for(size_t y = 0; y < ysize; y++)
+  {
+    const float *in_row = src->in + 4 * ((ypos + y) * src->width + xpos);
+    float *out_row = rect + 3 * y * xsize;
+    for(size_t x = 0; x < xsize; x++)
+    {
+      out_row[3 * x + 0] = in_row[4 * x + 0];
+      out_row[3 * x + 1] = in_row[4 * x + 1];
+      out_row[3 * x + 2] = in_row[4 * x + 2];
+    }
+  }
+
+  *row_offset = 3 * xsize * sizeof(float);
+  return rect;
+}
+
+static void _chunk_extra_format(void *opaque, const size_t ec_index, JxlPixelFormat *pixel_format)
+{
+  // we never declare extra channels
+}
+
+static const void *_chunk_extra_data(void *opaque,
+                                     const size_t ec_index,
+                                     const size_t xpos,
+                                     const size_t ypos,
+                                     const size_t xsize,
+                                     const size_t ysize,
+                                     size_t *row_offset)
+{
+  return NULL;
+}
+
+static void _chunk_release(void *opaque, const void *buf)
+{
+  g_free((void *)buf);
+}
+#endif
+
 int write_image(struct dt_imageio_module_data_t *data,
                 const char *filename,
                 const void *in_tmp,
@@ -150,7 +217,12 @@ int write_image(struct dt_imageio_module_data_t *data,
 
   JxlEncoder *encoder = JxlEncoderCreate(NULL);
 
-  const uint32_t num_threads = JxlResizableParallelRunnerSuggestThreads(width, height);
+  // libjxl only looks at the image size, concurrent exports share our cores
+  const int exports = darktable.control
+    ? MAX(1, dt_atomic_get_int(&darktable.control->export_scheduled))
+    : 1;
+  const uint32_t num_threads = MAX(1, MIN(JxlResizableParallelRunnerSuggestThreads(width, height),
+                                          (uint32_t)(dt_get_num_threads() / exports)));
   void *runner = JxlResizableParallelRunnerCreate(NULL);
   if(!runner) JXL_FAIL("could not create resizable parallel runner");
   JxlResizableParallelRunnerSetThreads(runner, num_threads);
@@ -197,6 +269,14 @@ int write_image(struct dt_imageio_module_data_t *data,
 
   LIBJXL_ASSERT(JxlEncoderFrameSettingsSetOption(frame_settings, JXL_ENC_FRAME_SETTING_EFFORT, params->effort));
 
+#ifdef HAVE_JXL_CHUNKED_FRAME
+  // up to effort 7 the encoder works group by group anyway, so streaming
+  // the chunked input keeps the memory bounded at next to no cost in size.
+  // higher efforts optimise over the whole frame and keep buffering it.
+  if(params->effort <= 7)
+    LIBJXL_ASSERT(JxlEncoderFrameSettingsSetOption(frame_settings, JXL_ENC_FRAME_SETTING_BUFFERING, 2));
+#endif
+
   LIBJXL_ASSERT(
       JxlEncoderFrameSettingsSetOption(frame_settings, JXL_ENC_FRAME_SETTING_DECODING_SPEED, params->tier));
 
@@ -338,6 +418,18 @@ int write_image(struct dt_imageio_module_data_t *data,
     }
   }
 
+#ifdef HAVE_JXL_CHUNKED_FRAME
+  _jxl_chunk_source_t chunk_source = { .in = (const float *)in_tmp, .width = width };
+  const JxlChunkedFrameInputSource chunked_input =
+    { .opaque = &chunk_source,
+      .get_color_channels_pixel_format = _chunk_pixel_format,
+      .get_color_channel_data_at = _chunk_color_data,
+      .get_extra_channel_pixel_format = _chunk_extra_format,
+      .get_extra_channel_data_at = _chunk_extra_data,
+      .release_buffer = _chunk_release };
+
+  LIBJXL_ASSERT(JxlEncoderAddChunkedFrame(frame_settings, JXL_TRUE, chunked_input));
+#else
   JxlPixelFormat pixel_format = { 3, JXL_TYPE_FLOAT, JXL_NATIVE_ENDIAN, 0 };
 
   // Fix pixel stride
@@ -361,6 +453,7 @@ int write_image(struct dt_imageio_module_data_t *data,
   }
 
   LIBJXL_ASSERT(JxlEncoderAddImageFrame(frame_settings, &pixel_format, pixels, pixels_size));
+#endif
 
   // No more image frames nor metadata boxes to add
   JxlEncoderCloseInput(encoder);
@@ -134,6 +134,283 @@ cleanup:
 }
 #endif
 
+// images with fewer pixels are left to the serial libpng compressor
+#define PNG_PARALLEL_MIN_PIXELS (4 * 1024 * 1024)
+// amount of filtered scanline data deflated as one independent strip
+#define PNG_STRIP_BYTES (1 << 20)
+// deflate window, primed from the tail of the previous strip
+#define PNG_WINDOW_BYTES (1 << 15)
+
+typedef struct _png_strip_t
+{
+  uint8_t *out;
+  size_t out_len;
+  size_t raw_len;
+  uLong adler;
+} _png_strip_t;
+
+// pack one RGBx scanline into big endian RGB as stored in the file
+static void _pack_row(const void *ivoid,
+                      const int width,
+                      const int bpp,
+                      const int y,
+                      uint8_t *row)
+{
+  if(bpp > 8)
+  {
+    const uint16_t *in = (const uint16_t *)ivoid + (size_t)4 * y * width;
+    for(int x = 0; x < width; x++)
+      for(int c = 0; c < 3; c++)
+      {
+        const uint16_t v = in[4 * x + c];
+        row[6 * x + 2 * c] = v >> 8;
+        row[6 * x + 2 * c + 1] = v & 0xff;
+      }
+  }
+  else
+  {
+    const uint8_t *in = (const uint8_t *)ivoid + (size_t)4 * y * width;
+    for(int x = 0; x < width; x++)
+      for(int c = 0; c < 3; c++)
+        row[3 * x + c] = in[4 * x + c];
+  }
+}
+
+static inline int _paeth(const int a, const int b, const int c)
+{
+  const int p = a + b - c;
+  const int pa = abs(p - a);
+  const int pb = abs(p - b);
+  const int pc = abs(p - c);
+  if(pa <= pb && pa <= pc) return a;
+  return pb <= pc ? b : c;
+}
+
+static inline uint8_t _filter_byte(const int type,
+                                   const uint8_t *row,
+                                   const uint8_t *prev,
+                                   const size_t i,
+                                   const size_t pixel_bytes)
+{
+  const int a = i >= pixel_bytes ? row[i - pixel_bytes] : 0;
+  const int b = prev ? prev[i] : 0;
+  const int c = prev && i >= pixel_bytes ? prev[i - pixel_bytes] : 0;
+  switch(type)
+  {
+    case PNG_FILTER_VALUE_SUB:
+      return row[i] - a;
+    case PNG_FILTER_VALUE_UP:
+      return row[i] - b;
+    case PNG_FILTER_VALUE_AVG:
+      return row[i] - ((a + b) >> 1);
+    case PNG_FILTER_VALUE_PAETH:
+      return row[i] - _paeth(a, b, c);
+    default:
+      return row[i];
+  }
+}
+
+// filter a packed scanline into out[0..len], out[0] being the filter
+// type. like libpng we pick the filter with the smallest sum of absolute
+// signed residuals, the fast tier always uses sub.
+static void _filter_row(const uint8_t *row,
+                        const uint8_t *prev,
+                        const size_t len,
+                        const size_t pixel_bytes,
+                        const gboolean fast,
+                        uint8_t *out)
+{
+  int best = PNG_FILTER_VALUE_SUB;
+  if(!fast)
+  {
+    size_t best_sum = SIZE_MAX;
+    for(int type = PNG_FILTER_VALUE_NONE; type < PNG_FILTER_VALUE_LAST; type++)
+    {
+      size_t sum = 0;
+      for(size_t i = 0; i < len && sum < best_sum; i++)
+      {
+        const uint8_t v = _filter_byte(type, row, prev, i, pixel_bytes);
+        sum += v < 128 ? v : 256 - v;
+      }
+      if(sum < best_sum)
+      {
+        best_sum = sum;
+        best = type;
+      }
+    }
+  }
+
+  out[0] = best;
+  for(size_t i = 0; i < len; i++)
+    out[i + 1] = _filter_byte(best, row, prev, i, pixel_bytes);
+}
+
+// filter scanlines y0..y1-1 into out, each one prefixed by its filter type
+static void _filter_rows(const void *ivoid,
+                         const int width,
+                         const int bpp,
+                         const int y0,
+                         const int y1,
+                         const gboolean fast,
+                         uint8_t *row,
+                         uint8_t *prev,
+                         uint8_t *out)
+{
+  const size_t pixel_bytes = bpp > 8 ? 6 : 3;
+  const size_t len = pixel_bytes * width;
+  if(y0 > 0) _pack_row(ivoid, width, bpp, y0 - 1, prev);
+
+  for(int y = y0; y < y1; y++)
+  {
+    _pack_row(ivoid, width, bpp, y, row);
+    _filter_row(row, y > 0 ? prev : NULL, len, pixel_bytes, fast, out + (y - y0) * (len + 1));
+    uint8_t *tmp = prev;
+    prev = row;
+    row = tmp;
+  }
+}
+
+// deflate one strip as a raw deflate segment ending on a byte boundary,
+// so that all strips concatenate into a single zlib stream. the first
+// strip leaves room for the zlib header, the last one for the adler32.
+static int _compress_strip(const void *ivoid,
+                           const int width,
+                           const int height,
+                           const int bpp,
+                           const int strip_rows,
+                           const int k,
+                           const int level,
+                           const gboolean fast,
+                           _png_strip_t *strip)
+{
+  const size_t len = (size_t)(bpp > 8 ? 6 : 3) * width;
+  const int y0 = k * strip_rows;
+  const int y1 = MIN(y0 + strip_rows, height);
+  const gboolean last = y1 == height;
+  const int dict_rows = y0 > 0 ? MIN(strip_rows, (int)(PNG_WINDOW_BYTES / (len + 1)) + 1) : 0;
+
+  uint8_t *rows = g_try_malloc(2 * len);
+  uint8_t *filtered = g_try_malloc((size_t)(dict_rows + y1 - y0) * (len + 1));
+  if(!rows || !filtered)
+  {
+    g_free(rows);
+    g_free(filtered);
+    return 1;
+  }
+
+  // the filter choice is deterministic, so re-filtering the tail of the
+  // previous strip reproduces exactly the bytes its deflater saw
+  _filter_rows(ivoid, width, bpp, y0 - dict_rows, y1, fast, rows, rows + len, filtered);
+  const size_t dict_len = (size_t)dict_rows * (len + 1);
+  const uint8_t *data = filtered + dict_len;
+  strip->raw_len = (size_t)(y1 - y0) * (len + 1);
+  strip->adler = adler32(adler32(0L, Z_NULL, 0), data, strip->raw_len);
+
+  int err = 1;
+  z_stream zs = { 0 };
+  if(deflateInit2(&zs, level, Z_DEFLATED, -15, 8, fast ? Z_RLE : Z_DEFAULT_STRATEGY) != Z_OK)
+    goto end;
+
+  if(dict_len > 0)
+  {
+    const size_t window = MIN(dict_len, PNG_WINDOW_BYTES);
+    deflateSetDictionary(&zs, data - window, window);
+  }
+
+  const size_t head = k == 0 ? 2 : 0;
+  const size_t bound = deflateBound(&zs, strip->raw_len) + 16;
+  strip->out = g_try_malloc(head + bound + 4);
+  if(!strip->out)
+  {
+    deflateEnd(&zs);
+    goto end;
+  }
+
+  zs.next_in = (Bytef *)data;
+  zs.avail_in = strip->raw_len;
+  zs.next_out = strip->out + head;
+  zs.avail_out = bound;
+  const int ret = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+  if(ret == (last ? Z_STREAM_END : Z_OK) && zs.avail_in == 0)
+  {
+    strip->out_len = head + bound - zs.avail_out;
+    err = 0;
+  }
+  deflateEnd(&zs);
+
+end:
+  g_free(rows);
+  g_free(filtered);
+  return err;
+}
+
+// write the IDAT stream from strips deflated in parallel, pigz style.
+// returns -1 when the image is left to libpng, 1 on error.
+static int _write_idat_parallel(png_structp png_ptr,
+                                const void *ivoid,
+                                const int width,
+                                const int height,
+                                const int bpp,
+                                const int level,
+                                const gboolean fast)
+{
+  if(dt_get_num_threads() < 2
+     || (size_t)width * height < PNG_PARALLEL_MIN_PIXELS
+     || !dt_conf_get_bool("plugins/imageio/format/png/parallel"))
+    return -1;
+
+  const size_t len = (size_t)(bpp > 8 ? 6 : 3) * width;
+  const int strip_rows = MAX(1, PNG_STRIP_BYTES / (len + 1));
+  const int nstrips = (height + strip_rows - 1) / strip_rows;
+  if(nstrips < 2) return -1;
+
+  // compress a few strips per thread at a time so that only a batch of
+  // compressed data is held in memory before it is written out in order
+  const int batch = 2 * dt_get_num_threads();
+  _png_strip_t *strips = g_new0(_png_strip_t, batch);
+
+  // zlib header: deflate with 32K window, FLEVEL from the compression level
+  const int flevel = level < 2 || fast ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+  const unsigned int header = (0x78 << 8) | (flevel << 6);
+  uLong adler = adler32(0L, Z_NULL, 0);
+
+  int failed = 0;
+  for(int k0 = 0; k0 < nstrips && !failed; k0 += batch)
+  {
+    const int count = MIN(batch, nstrips - k0);
+    DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic) reduction(| : failed))
+    for(int k = 0; k < count; k++)
+      failed |= _compress_strip(ivoid, width, height, bpp, strip_rows, k0 + k, level, fast, &strips[k]);
+
+    for(int k = 0; k < count && !failed; k++)
+    {
+      _png_strip_t *strip = &strips[k];
+      if(k0 + k == 0)
+      {
+        const unsigned int h = header + (31 - header % 31) % 31;
+        strip->out[0] = h >> 8;
+        strip->out[1] = h & 0xff;
+      }
+      adler = adler32_combine(adler, strip->adler, strip->raw_len);
+      if(k0 + k == nstrips - 1)
+      {
+        for(int i = 0; i < 4; i++)
+          strip->out[strip->out_len++] = (adler >> (24 - 8 * i)) & 0xff;
+      }
+      png_write_chunk(png_ptr, (png_const_bytep)"IDAT", strip->out, strip->out_len);
+    }
+
+    for(int k = 0; k < count; k++)
+    {
+      g_free(strips[k].out);
+      strips[k].out = NULL;
+    }
+  }
+
+  g_free(strips);
+  return failed ? 1 : 0;
+}
+
 int write_image(dt_imageio_module_data_t *p_tmp,
                 const char *filename,
                 const void *ivoid,
@@ -180,9 +457,15 @@ int write_image(dt_imageio_module_data_t *p_tmp,
 
   png_init_io(png_ptr, f);
 
-  png_set_compression_level(png_ptr, p->compression);
+  // the fast tier trades file size for speed on intermediate files:
+  // one cheap filter and run-length matches only
+  const gboolean fast = dt_conf_get_bool("plugins/imageio/format/png/fast");
+  const int level = fast ? MIN(p->compression, 1) : p->compression;
+
+  png_set_compression_level(png_ptr, level);
   png_set_compression_mem_level(png_ptr, 8);
-  png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
+  png_set_compression_strategy(png_ptr, fast ? Z_RLE : Z_DEFAULT_STRATEGY);
+  if(fast) png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
   png_set_compression_window_bits(png_ptr, 15);
   png_set_compression_method(png_ptr, 8);
   png_set_compression_buffer_size(png_ptr, 8192);
@@ -308,6 +591,18 @@ int write_image(dt_imageio_module_data_t *p_tmp,
   }
 #endif
 
+  const int parallel = _write_idat_parallel(png_ptr, ivoid, width, height, p->bpp, level, fast);
+  if(parallel >= 0)
+  {
+    // the IDAT stream is already complete, only IEND is missing.
+    // all other chunks were written before the image data.
+    if(!parallel) png_write_chunk(png_ptr, (png_const_bytep)"IEND", NULL, 0);
+    else dt_print(DT_DEBUG_ALWAYS, "[png] parallel compression failed writing %s", filename);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(f);
+    return parallel;
+  }
+
   /*
    * Get rid of filler (OR ALPHA) bytes, pack XRGB/RGBX/ARGB/RGBA into
    * RGB (4 channels -> 3 channels). The second parameter is not used.
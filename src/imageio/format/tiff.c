@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <tiffio.h>
+#include <zlib.h>
 #ifdef HAVE_IMATH
 #include "Imath/half.h"
 #endif
@@ -41,7 +42,7 @@
 // but at least GIMP can't open TIFF files where not all layers have the same format.
 #define MASKS_USE_SAME_FORMAT
 
-DT_MODULE(4)
+DT_MODULE(5)
 
 typedef struct dt_imageio_tiff_t
 {
@@ -51,6 +52,7 @@ typedef struct dt_imageio_tiff_t
   int compress;
   int compresslevel;
   int shortfile;
+  int pyramid;
   TIFF *handle;
 } dt_imageio_tiff_t;
 
@@ -61,8 +63,302 @@ typedef struct dt_imageio_tiff_gui_t
   GtkWidget *compress;
   GtkWidget *compresslevel;
   GtkWidget *shortfiles;
+  GtkWidget *pyramid;
 } dt_imageio_tiff_gui_t;
 
+// tile edge of the tiled pyramid layout, and the number of tiles packed
+// and compressed per thread before they are written out in order
+#define TIFF_TILE_SIZE 256
+#define TIFF_TILE_BATCH 4
+
+typedef struct _tiff_tile_t
+{
+  uint8_t *data;
+  size_t len;
+} _tiff_tile_t;
+
+static void _set_compression(TIFF *tif, const dt_imageio_tiff_t *d)
+{
+  // http://partners.adobe.com/public/developer/en/tiff/TIFFphotoshop.pdf (dated 2002)
+  // "A proprietary ZIP/Flate compression code (0x80b2) has been used by some"
+  // "software vendors. This code should be considered obsolete. We recommend"
+  // "that TIFF implementations recognize and read the obsolete code but only"
+  // "write the official compression code (0x0008)."
+  // http://www.awaresystems.be/imaging/tiff/tifftags/compression.html
+  // http://www.awaresystems.be/imaging/tiff/tifftags/predictor.html
+  if(d->compress == 1)
+  {
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
+  }
+  else if(d->compress == 2)
+  {
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    if(d->bpp == 32 || (d->bpp == 16 && d->pixelformat))
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
+    else
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
+  }
+}
+
+static void _set_sample_fields(TIFF *tif, const dt_imageio_tiff_t *d, const uint16_t layers)
+{
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, layers);
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
+  TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT,
+               d->bpp == 32 || (d->bpp == 16 && d->pixelformat) ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
+  if(layers == 3)
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+  else
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+}
+
+// size of one channel of the RGBx buffer handed to write_image()
+static inline size_t _in_sample_size(const dt_imageio_tiff_t *d)
+{
+  return d->bpp == 32 || (d->bpp == 16 && d->pixelformat) ? sizeof(float) : d->bpp / 8;
+}
+
+// number of overview levels until the image fits into a single tile
+static int _overview_levels(int width, int height)
+{
+  int levels = 0;
+  while(MAX(width, height) > TIFF_TILE_SIZE)
+  {
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+    levels++;
+  }
+  return levels;
+}
+
+// 2x2 box filter the RGBx buffer down to the next overview level
+static void *_halve(const dt_imageio_tiff_t *d,
+                    const void *in,
+                    const int width,
+                    const int height,
+                    int *out_width,
+                    int *out_height)
+{
+  const int ow = (width + 1) / 2;
+  const int oh = (height + 1) / 2;
+  const size_t sample = _in_sample_size(d);
+  void *out = dt_alloc_aligned((size_t)4 * ow * oh * sample);
+  if(!out) return NULL;
+
+  DT_OMP_FOR()
+  for(int y = 0; y < oh; y++)
+  {
+    const size_t r0 = (size_t)2 * y * width;
+    const size_t r1 = (size_t)MIN(2 * y + 1, height - 1) * width;
+    for(int x = 0; x < ow; x++)
+    {
+      const size_t c0 = 2 * x;
+      const size_t c1 = MIN(2 * x + 1, width - 1);
+      const size_t i00 = 4 * (r0 + c0), i01 = 4 * (r0 + c1);
+      const size_t i10 = 4 * (r1 + c0), i11 = 4 * (r1 + c1);
+      const size_t o = 4 * ((size_t)y * ow + x);
+      for(int c = 0; c < 4; c++)
+      {
+        if(sample == sizeof(float))
+        {
+          const float *i = (const float *)in;
+          ((float *)out)[o + c] = 0.25f * (i[i00 + c] + i[i01 + c] + i[i10 + c] + i[i11 + c]);
+        }
+        else if(sample == sizeof(uint16_t))
+        {
+          const uint16_t *i = (const uint16_t *)in;
+          ((uint16_t *)out)[o + c] = (i[i00 + c] + i[i01 + c] + i[i10 + c] + i[i11 + c] + 2) / 4;
+        }
+        else
+        {
+          const uint8_t *i = (const uint8_t *)in;
+          ((uint8_t *)out)[o + c] = (i[i00 + c] + i[i01 + c] + i[i10 + c] + i[i11 + c] + 2) / 4;
+        }
+      }
+    }
+  }
+
+  *out_width = ow;
+  *out_height = oh;
+  return out;
+}
+
+// pack the tile at x0/y0 into file samples, zero padded at the right
+// and bottom image borders
+static void _pack_tile(const dt_imageio_tiff_t *d,
+                       const void *in,
+                       const int width,
+                       const int height,
+                       const uint16_t layers,
+                       const int x0,
+                       const int y0,
+                       uint8_t *out)
+{
+  const size_t tile_row = (size_t)TIFF_TILE_SIZE * layers * d->bpp / 8;
+  memset(out, 0, tile_row * TIFF_TILE_SIZE);
+  const int tw = MIN(TIFF_TILE_SIZE, width - x0);
+  const int th = MIN(TIFF_TILE_SIZE, height - y0);
+
+  for(int y = 0; y < th; y++)
+  {
+    const size_t offset = (size_t)4 * ((size_t)(y0 + y) * width + x0);
+    uint8_t *row = out + y * tile_row;
+    if(d->bpp == 32)
+    {
+      const float *i = (const float *)in + offset;
+      for(int x = 0; x < tw; x++)
+        memcpy((float *)row + x * layers, i + 4 * x, sizeof(float) * layers);
+    }
+#ifdef HAVE_IMATH
+    else if(d->bpp == 16 && d->pixelformat)
+    {
+      const float *i = (const float *)in + offset;
+      for(int x = 0; x < tw; x++)
+        for(int l = 0; l < layers; l++)
+          ((uint16_t *)row)[x * layers + l] = imath_float_to_half(i[4 * x + l]);
+    }
+#endif
+    else if(d->bpp == 16)
+    {
+      const uint16_t *i = (const uint16_t *)in + offset;
+      for(int x = 0; x < tw; x++)
+        memcpy((uint16_t *)row + x * layers, i + 4 * x, sizeof(uint16_t) * layers);
+    }
+    else
+    {
+      const uint8_t *i = (const uint8_t *)in + offset;
+      for(int x = 0; x < tw; x++)
+        memcpy(row + x * layers, i + 4 * x, layers);
+    }
+  }
+}
+
+// apply the TIFF predictor to one tile row, the same way libtiff's
+// horDiff and fpDiff do it before deflating
+static void _predict_row(const dt_imageio_tiff_t *d, uint8_t *row, const uint16_t layers)
+{
+  const size_t n = (size_t)TIFF_TILE_SIZE * layers;
+  if(d->bpp == 32 || (d->bpp == 16 && d->pixelformat))
+  {
+    // floating point: split into byte planes, most significant first,
+    // then difference the bytes
+    const size_t bps = d->bpp / 8;
+    uint8_t tmp[TIFF_TILE_SIZE * 3 * sizeof(float)];
+    memcpy(tmp, row, n * bps);
+    for(size_t c = 0; c < n; c++)
+      for(size_t b = 0; b < bps; b++)
+        row[(bps - b - 1) * n + c] = tmp[bps * c + b];
+    for(size_t i = n * bps - 1; i >= layers; i--)
+      row[i] -= row[i - layers];
+  }
+  else if(d->bpp == 16)
+  {
+    uint16_t *r = (uint16_t *)row;
+    for(size_t i = n - 1; i >= layers; i--)
+      r[i] -= r[i - layers];
+  }
+  else
+  {
+    for(size_t i = n - 1; i >= layers; i--)
+      row[i] -= row[i - layers];
+  }
+}
+
+// pack and, if requested, compress one tile into a buffer ready for
+// TIFFWriteRawTile(). on big endian hosts the packed samples are left to
+// TIFFWriteEncodedTile() so that libtiff swaps them.
+static int _encode_tile(const dt_imageio_tiff_t *d,
+                        const void *in,
+                        const int width,
+                        const int height,
+                        const uint16_t layers,
+                        const int x0,
+                        const int y0,
+                        _tiff_tile_t *tile)
+{
+  const size_t tile_row = (size_t)TIFF_TILE_SIZE * layers * d->bpp / 8;
+  const size_t tile_bytes = tile_row * TIFF_TILE_SIZE;
+  uint8_t *packed = g_try_malloc(tile_bytes);
+  if(!packed) return 1;
+  _pack_tile(d, in, width, height, layers, x0, y0, packed);
+
+  if(d->compress == 0 || G_BYTE_ORDER != G_LITTLE_ENDIAN)
+  {
+    tile->data = packed;
+    tile->len = tile_bytes;
+    return 0;
+  }
+
+  if(d->compress == 2)
+    for(int y = 0; y < TIFF_TILE_SIZE; y++)
+      _predict_row(d, packed + y * tile_row, layers);
+
+  uLongf len = compressBound(tile_bytes);
+  tile->data = g_try_malloc(len);
+  const int err = !tile->data || compress2(tile->data, &len, packed, tile_bytes, d->compresslevel) != Z_OK;
+  g_free(packed);
+  if(err)
+  {
+    g_free(tile->data);
+    tile->data = NULL;
+    return 1;
+  }
+  tile->len = len;
+  return 0;
+}
+
+// write the current directory's image as tiles, compressing batches of
+// tiles in parallel and writing them in tile order
+static int _write_tiles(TIFF *tif,
+                        const dt_imageio_tiff_t *d,
+                        const void *in,
+                        const int width,
+                        const int height,
+                        const uint16_t layers)
+{
+  TIFFSetField(tif, TIFFTAG_TILEWIDTH, TIFF_TILE_SIZE);
+  TIFFSetField(tif, TIFFTAG_TILELENGTH, TIFF_TILE_SIZE);
+
+  const int tiles_x = (width + TIFF_TILE_SIZE - 1) / TIFF_TILE_SIZE;
+  const int tiles_y = (height + TIFF_TILE_SIZE - 1) / TIFF_TILE_SIZE;
+  const int ntiles = tiles_x * tiles_y;
+  const int batch = TIFF_TILE_BATCH * dt_get_num_threads();
+  _tiff_tile_t *tiles = g_new0(_tiff_tile_t, batch);
+
+  int err = 0;
+  for(int t0 = 0; t0 < ntiles && !err; t0 += batch)
+  {
+    const int count = MIN(batch, ntiles - t0);
+    DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic) reduction(| : err))
+    for(int k = 0; k < count; k++)
+    {
+      const int t = t0 + k;
+      err |= _encode_tile(d, in, width, height, layers,
+                          (t % tiles_x) * TIFF_TILE_SIZE, (t / tiles_x) * TIFF_TILE_SIZE, &tiles[k]);
+    }
+
+    for(int k = 0; k < count && !err; k++)
+    {
+      const tmsize_t written = G_BYTE_ORDER == G_LITTLE_ENDIAN
+        ? TIFFWriteRawTile(tif, t0 + k, tiles[k].data, tiles[k].len)
+        : TIFFWriteEncodedTile(tif, t0 + k, tiles[k].data, tiles[k].len);
+      if(written == -1) err = 1;
+    }
+
+    for(int k = 0; k < count; k++)
+    {
+      g_free(tiles[k].data);
+      tiles[k].data = NULL;
+    }
+  }
+
+  g_free(tiles);
+  return err;
+}
+
 
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
@@ -77,6 +373,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   TIFF *tif = NULL;
 
   void *rowdata = NULL;
+  void *overview = NULL;
 
   gboolean free_mask = FALSE;
   float *raster_mask = NULL;
@@ -130,28 +427,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
 
   TIFFSetField(tif, TIFFTAG_DOCUMENTNAME, filename);
 
-  // http://partners.adobe.com/public/developer/en/tiff/TIFFphotoshop.pdf (dated 2002)
-  // "A proprietary ZIP/Flate compression code (0x80b2) has been used by some"
-  // "software vendors. This code should be considered obsolete. We recommend"
-  // "that TIFF implementations recognize and read the obsolete code but only"
-  // "write the official compression code (0x0008)."
-  // http://www.awaresystems.be/imaging/tiff/tifftags/compression.html
-  // http://www.awaresystems.be/imaging/tiff/tifftags/predictor.html
-  if(d->compress == 1)
-  {
-    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-    TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-  }
-  else if(d->compress == 2)
-  {
-    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-    if(d->bpp == 32 || (d->bpp == 16 && d->pixelformat))
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
-    else
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-  }
+  _set_compression(tif, d);
 
   if(profile != NULL)
   {
@@ -227,20 +503,14 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   if(d->shortfile && layers == 3)
     dt_print(DT_DEBUG_IMAGEIO, "[tiff export] '%s' is not a B&W image, not exporting as grayscale\n", filename);
 
-  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, layers);
-  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
-  TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT,
-               d->bpp == 32 || (d->bpp == 16 && d->pixelformat) ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
+  _set_sample_fields(tif, d, layers);
   TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, (uint32_t)d->global.width);
   TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->global.height);
-  if(layers == 3)
-    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-  else
-    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
 
   TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
   TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
+  if(!d->pyramid)
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
 
   const int resolution = dt_conf_get_int("metadata/resolution");
   TIFFSetField(tif, TIFFTAG_XRESOLUTION, (float)resolution);
@@ -254,7 +524,15 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     goto exit;
   }
 
-  if(d->bpp == 32)
+  if(d->pyramid)
+  {
+    if(_write_tiles(tif, d, in_void, d->global.width, d->global.height, layers))
+    {
+      rc = 1;
+      goto exit;
+    }
+  }
+  else if(d->bpp == 32)
   {
     for(int y = 0; y < d->global.height; y++)
     {
@@ -349,8 +627,10 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   }
 
   // exiv2 doesn't support multi page tiffs. so we have to write in two steps. :-(
+  // the reduced resolution overviews of the tiled layout come first, then the masks
 
-  if(rc == 0 && n_pages > 1)
+  const int n_overviews = d->pyramid ? _overview_levels(d->global.width, d->global.height) : 0;
+  if(rc == 0 && (n_pages > 1 || n_overviews > 0))
   {
 #ifdef _WIN32
     tif = TIFFOpenW(wfilename, "al");
@@ -364,6 +644,38 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
       goto exit;
     }
 
+    const void *level = in_void;
+    int level_w = d->global.width, level_h = d->global.height;
+    for(int l = 1; l <= n_overviews; l++)
+    {
+      void *next = _halve(d, level, level_w, level_h, &level_w, &level_h);
+      dt_free_align(overview);
+      overview = next;
+      level = next;
+      if(!next)
+      {
+        rc = 1;
+        goto exit;
+      }
+
+      TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE);
+      _set_compression(tif, d);
+      _set_sample_fields(tif, d, layers);
+      TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, (uint32_t)level_w);
+      TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)level_h);
+      TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+      TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+
+      if(_write_tiles(tif, d, level, level_w, level_h, layers))
+      {
+        rc = 1;
+        goto exit;
+      }
+
+      if(l < n_overviews || n_pages > 1)
+        TIFFWriteDirectory(tif);
+    }
+
     // add masks
     float missing_raster_mask[8 * 8] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
                                          0.0, 0.0, 1.0, 1.0, 1.0, 1.0, 0.0, 0.0,
@@ -375,7 +687,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
                                          0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
     static const size_t missing_raster_mask_w = 8, missing_raster_mask_h = 8;
     uint16_t page = 1;
-    for(GList *iter = pipe->nodes; iter; iter = g_list_next(iter))
+    for(GList *iter = n_pages > 1 ? pipe->nodes : NULL; iter; iter = g_list_next(iter))
     {
       dt_dev_pixelpipe_iop_t *piece = iter->data;
 
@@ -408,21 +720,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
         else
           TIFFSetField(tif, TIFFTAG_PAGENAME, piece->module->name());
 
-        if(d->compress == 1)
-        {
-          TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-          TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
-          TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-        }
-        else if(d->compress == 2)
-        {
-          TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-          if(d->bpp == 32 || (d->bpp == 16 && d->pixelformat))
-            TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
-          else
-            TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
-          TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-        }
+        _set_compression(tif, d);
 
         TIFFSetField(tif, TIFFTAG_XRESOLUTION, (float)resolution);
         TIFFSetField(tif, TIFFTAG_YRESOLUTION, (float)resolution);
@@ -434,14 +732,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
         TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
 
 #ifdef MASKS_USE_SAME_FORMAT
-        TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, layers);
-        TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
-        TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT,
-                     d->bpp == 32 || (d->bpp == 16 && d->pixelformat) ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
-        if(layers == 3)
-          TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-        else
-          TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+        _set_sample_fields(tif, d, layers);
         TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
 
         if(w != d->global.width)
@@ -576,6 +867,7 @@ exit:
   profile = NULL;
   free(rowdata);
   rowdata = NULL;
+  dt_free_align(overview);
 #ifdef _WIN32
   g_free(wfilename);
 #endif
@@ -714,20 +1006,46 @@ void *legacy_params(dt_imageio_module_format_t *self,
     return n;
   }
 
+  else if(old_version == 4)
+  {
+    typedef struct dt_imageio_tiff_v5_t
+    {
+      dt_imageio_module_data_t global;
+      int bpp;
+      int pixelformat;
+      int compress;
+      int compresslevel;
+      int shortfile;
+      int pyramid;
+      TIFF *handle;
+    } dt_imageio_tiff_v5_t;
+
+    const dt_imageio_tiff_v4_t *o = (dt_imageio_tiff_v4_t *)old_params;
+    dt_imageio_tiff_v5_t *n = calloc(1, sizeof(dt_imageio_tiff_v5_t));
+
+    memcpy(n, o, sizeof(dt_imageio_tiff_v4_t) - sizeof(TIFF *));
+    n->pyramid = 0;
+    n->handle = o->handle;
+
+    *new_version = 5;
+    *new_size = sizeof(dt_imageio_tiff_v5_t) - sizeof(TIFF *);
+    return n;
+  }
+
   // incremental update supported:
   /*
-  typedef struct dt_imageio_tiff_v5_t
+  typedef struct dt_imageio_tiff_v6_t
   {
     ...
-  } dt_imageio_tiff_v5_t;
+  } dt_imageio_tiff_v6_t;
 
-  if(old_version == 4)
+  if(old_version == 5)
   {
-    // let's update from 4 to 5
+    // let's update from 5 to 6
 
     ...
-    *new_size = sizeof(dt_imageio_tiff_v5_t) - sizeof(TIFF *);
-    *new_version = 5;
+    *new_size = sizeof(dt_imageio_tiff_v6_t) - sizeof(TIFF *);
+    *new_version = 6;
     return n;
   }
   */
@@ -749,6 +1067,7 @@ void *get_params(dt_imageio_module_format_t *self)
   d->compress = dt_conf_get_int("plugins/imageio/format/tiff/compress");
   d->compresslevel = dt_conf_get_int("plugins/imageio/format/tiff/compresslevel");
   d->shortfile = dt_conf_get_bool("plugins/imageio/format/tiff/shortfile");
+  d->pyramid = dt_conf_get_bool("plugins/imageio/format/tiff/pyramid");
 
   return d;
 }
@@ -769,6 +1088,7 @@ int set_params(dt_imageio_module_format_t *self, const void *params, const int s
   dt_bauhaus_combobox_set(g->compress, d->compress);
   dt_bauhaus_slider_set(g->compresslevel, d->compresslevel);
   dt_bauhaus_combobox_set(g->shortfiles, d->shortfile);
+  dt_bauhaus_combobox_set(g->pyramid, d->pyramid);
 
   return 0;
 }
@@ -835,6 +1155,12 @@ static void shortfile_combobox_changed(GtkWidget *widget, gpointer user_data)
   dt_conf_set_bool("plugins/imageio/format/tiff/shortfile", mode);
 }
 
+static void pyramid_combobox_changed(GtkWidget *widget, gpointer user_data)
+{
+  const int pyramid = dt_bauhaus_combobox_get(widget);
+  dt_conf_set_bool("plugins/imageio/format/tiff/pyramid", pyramid);
+}
+
 static void compress_combobox_changed(GtkWidget *widget, dt_imageio_tiff_gui_t *gui)
 {
   const int compress = dt_bauhaus_combobox_get(widget);
@@ -875,6 +1201,7 @@ void gui_init(dt_imageio_module_format_t *self)
   const int compress = dt_conf_get_int("plugins/imageio/format/tiff/compress");
   const int compresslevel = dt_conf_get_int("plugins/imageio/format/tiff/compresslevel");
   const int shortmode = dt_conf_get_bool("plugins/imageio/format/tiff/shortfile");
+  const int pyramid = dt_conf_get_bool("plugins/imageio/format/tiff/pyramid");
 
   // Bit depth combo box
   DT_BAUHAUS_COMBOBOX_NEW_FULL(gui->bpp, self, NULL, N_("bit depth"), NULL,
@@ -922,7 +1249,16 @@ void gui_init(dt_imageio_module_format_t *self)
   dt_bauhaus_combobox_set_default(gui->shortfiles,
                                   dt_confgen_get_bool("plugins/imageio/format/tiff/shortfile", DT_DEFAULT));
 
-  self->widget = dt_gui_vbox(gui->bpp, gui->pixelformat, gui->compress, gui->compresslevel, gui->shortfiles);
+  // layout combo box
+  DT_BAUHAUS_COMBOBOX_NEW_FULL(gui->pyramid, self, NULL, N_("layout"),
+                               _("tiles with reduced resolution overviews let viewers open\n"
+                                 "huge images without reading the whole file"), pyramid,
+                               pyramid_combobox_changed, self, N_("strips"), N_("tiled pyramid"));
+  dt_bauhaus_combobox_set_default(gui->pyramid,
+                                  dt_confgen_get_bool("plugins/imageio/format/tiff/pyramid", DT_DEFAULT));
+
+  self->widget = dt_gui_vbox(gui->bpp, gui->pixelformat, gui->compress, gui->compresslevel, gui->shortfiles,
+                             gui->pyramid);
 }
 
 void gui_cleanup(dt_imageio_module_format_t *self)
@@ -946,6 +1282,7 @@ void gui_reset(dt_imageio_module_format_t *self)
   dt_bauhaus_slider_set(gui->compresslevel,
                         dt_confgen_get_int("plugins/imageio/format/tiff/compresslevel", DT_DEFAULT));
   dt_bauhaus_combobox_set(gui->shortfiles, dt_confgen_get_bool("plugins/imageio/format/tiff/shortfile", DT_DEFAULT));
+  dt_bauhaus_combobox_set(gui->pyramid, dt_confgen_get_bool("plugins/imageio/format/tiff/pyramid", DT_DEFAULT));
 }
 
 int flags(dt_imageio_module_data_t *data)
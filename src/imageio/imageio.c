@@ -21,14 +21,20 @@
 #include "common/darktable.h"
 #include "common/debug.h"
 #include "common/exif.h"
+#include "common/file_location.h"
 #include "common/image_cache.h"
+#include "common/metadata.h"
+#include "common/metrics.h"
 #include "common/mipmap_cache.h"
 #include "common/styles.h"
+#include "common/tags.h"
+#include "common/trace.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "develop/blend.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
+#include "develop/imageop_math.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_module.h"
 
@@ -84,6 +90,9 @@
 
 #include <assert.h>
 #include <glib/gstdio.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 #include <inttypes.h>
 #include <math.h>
 #include <stdio.h>
@@ -611,6 +620,34 @@ static dt_imageio_retval_t _open_by_magic_number(dt_image_t *img, const char *fi
   return DT_IMAGEIO_UNRECOGNIZED;
 }
 
+GMappedFile *dt_imageio_map_file(const char *filename)
+{
+  if(!dt_conf_get_bool("raw_loader_mmap")) return NULL;
+
+  // reuse the mapping of the metadata readers, e.g. right after import
+  GMappedFile *map = dt_exif_get_mapped_file(filename);
+  GError *error = NULL;
+  if(!map) map = g_mapped_file_new(filename, FALSE, &error);
+  if(!map)
+  {
+    dt_print(DT_DEBUG_IMAGEIO, "[dt_imageio_map_file] can't map `%s': %s",
+             filename, error->message);
+    g_error_free(error);
+    return NULL;
+  }
+  if(g_mapped_file_get_length(map) == 0)
+  {
+    g_mapped_file_unref(map);
+    return NULL;
+  }
+#ifndef _WIN32
+  // the decoders read the file front to back exactly once
+  madvise(g_mapped_file_get_contents(map), g_mapped_file_get_length(map),
+          MADV_SEQUENTIAL | MADV_WILLNEED);
+#endif
+  return map;
+}
+
 gboolean dt_imageio_is_raw_by_extension(const char *extension)
 {
   const char *ext = g_str_has_prefix(extension, ".") ? extension + 1 : extension;
@@ -656,7 +693,9 @@ gboolean dt_imageio_large_thumbnail(const char *filename,
                                     uint8_t **buffer,
                                     int32_t *width,
                                     int32_t *height,
-                                    dt_colorspaces_color_profile_type_t *color_space)
+                                    dt_colorspaces_color_profile_type_t *color_space,
+                                    const int min_width,
+                                    const int min_height)
 {
   int res = TRUE;
 
@@ -674,8 +713,10 @@ gboolean dt_imageio_large_thumbnail(const char *filename,
     dt_imageio_jpeg_t jpg;
     if(dt_imageio_jpeg_decompress_header(buf, bufsize, &jpg))
       goto error;
+    if(min_width > 0 && min_height > 0)
+      dt_imageio_jpeg_set_scale(&jpg, min_width, min_height);
 
-    *buffer = dt_alloc_align_uint8(4 * jpg.width * jpg.height);
+    *buffer = dt_alloc_align_uint8((size_t)4 * jpg.width * jpg.height);
     if(!*buffer) goto error;
 
     *width = jpg.width;
@@ -828,8 +869,9 @@ gboolean dt_imageio_has_mono_preview(const char *filename)
   int32_t thumb_width = 0, thumb_height = 0;
   gboolean mono = FALSE;
 
+  // a small version is enough to tell
   if(dt_imageio_large_thumbnail(filename, &tmp, &thumb_width,
-                                &thumb_height, &color_space))
+                                &thumb_height, &color_space, 128, 128))
     goto cleanup;
   if((thumb_width < 32) || (thumb_height < 32) || (tmp == NULL))
     goto cleanup;
@@ -1040,6 +1082,239 @@ static double _get_pipescale(dt_dev_pixelpipe_t *pipe,
   return fmin(scalex, scaley);
 }
 
+// hash of everything that defines an exported file: the module chain of the
+// pipe, the source file, the output size and the format and metadata settings.
+// The imgid is left out so the hash stays valid for a re-imported image.
+// dt_hash() values are not stable between versions, hashing the darktable
+// version makes the entries of another version never match.
+static dt_hash_t _export_hash(const dt_dev_pixelpipe_t *pipe,
+                              const dt_imageio_module_format_t *format,
+                              const dt_imageio_module_data_t *format_params,
+                              const int width,
+                              const int height,
+                              const double scale,
+                              const gboolean hq_process,
+                              const gboolean copy_metadata,
+                              const gboolean export_masks,
+                              const dt_colorspaces_color_profile_type_t icc_type,
+                              const gchar *icc_filename,
+                              const dt_iop_color_intent_t icc_intent,
+                              const dt_export_metadata_t *metadata)
+{
+  dt_hash_t hash = DT_INITHASH;
+  for(const GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = nodes->data;
+    if(piece->enabled)
+      hash = dt_hash(hash, &piece->hash, sizeof(piece->hash));
+  }
+
+  char pathname[PATH_MAX] = { 0 };
+  gboolean from_cache = FALSE;
+  dt_image_full_path(pipe->image.id, pathname, sizeof(pathname), &from_cache);
+  GStatBuf st;
+  const gboolean found = !g_stat(pathname, &st);
+  const int64_t fileinfo[2] = { found ? st.st_size : 0, found ? st.st_mtime : 0 };
+  hash = dt_hash(hash, pathname, strlen(pathname));
+  hash = dt_hash(hash, fileinfo, sizeof(fileinfo));
+
+  const int settings[8] = { width, height, hq_process, copy_metadata, export_masks,
+                            icc_type, icc_intent, metadata ? metadata->flags : 0 };
+  hash = dt_hash(hash, settings, sizeof(settings));
+  hash = dt_hash(hash, &scale, sizeof(scale));
+  if(icc_filename) hash = dt_hash(hash, icc_filename, strlen(icc_filename));
+  hash = dt_hash(hash, darktable_package_version, strlen(darktable_package_version));
+
+  // the format parameters past the common header, width and height in the
+  // header are left from the previous export
+  hash = dt_hash(hash, format->plugin_name, strlen(format->plugin_name));
+  hash = dt_hash(hash, format_params->style, strlen(format_params->style));
+  hash = dt_hash(hash, &format_params->style_append, sizeof(format_params->style_append));
+  const size_t params_size = format->params_size((dt_imageio_module_format_t *)format);
+  if(params_size > sizeof(dt_imageio_module_data_t))
+    hash = dt_hash(hash, (const char *)format_params + sizeof(dt_imageio_module_data_t),
+                   params_size - sizeof(dt_imageio_module_data_t));
+
+  if(copy_metadata)
+  {
+    if(metadata)
+      for(const GList *iter = metadata->list; iter; iter = g_list_next(iter))
+        hash = dt_hash(hash, iter->data, strlen(iter->data));
+
+    GList *tags = dt_tag_get_list(pipe->image.id);
+    for(const GList *iter = tags; iter; iter = g_list_next(iter))
+      hash = dt_hash(hash, iter->data, strlen(iter->data));
+    g_list_free_full(tags, g_free);
+
+    GList *meta = dt_metadata_get_list_id(pipe->image.id);
+    for(const GList *iter = meta; iter; iter = g_list_next(iter))
+      hash = dt_hash(hash, iter->data, strlen(iter->data));
+    g_list_free_full(meta, g_free);
+  }
+  return hash;
+}
+
+// the manifest entry of an exported file in the cache dir
+static gchar *_export_hash_path(const char *filename)
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  gchar *dir = g_build_filename(cachedir, "export_hashes", NULL);
+  if(g_mkdir_with_parents(dir, 0750))
+  {
+    g_free(dir);
+    return NULL;
+  }
+
+  // named by a stable checksum so an update doesn't orphan the entries
+  gchar *absolute = g_canonicalize_filename(filename, NULL);
+  gchar *name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, absolute, -1);
+  g_free(absolute);
+  gchar *path = g_build_filename(dir, name, NULL);
+  g_free(name);
+  g_free(dir);
+  return path;
+}
+
+// TRUE if filename exists unmodified since it was written with hash
+static gboolean _export_hash_matches(const gchar *path,
+                                     const char *filename,
+                                     const dt_hash_t hash)
+{
+  GStatBuf st;
+  gchar *content = NULL;
+  if(!path || g_stat(filename, &st) || !g_file_get_contents(path, &content, NULL, NULL))
+    return FALSE;
+
+  uint64_t stored = 0;
+  int64_t size = -1, mtime = -1;
+  const gboolean valid =
+    sscanf(content, "%" SCNx64 " %" SCNd64 " %" SCNd64, &stored, &size, &mtime) == 3;
+  g_free(content);
+  return valid && stored == hash && size == st.st_size && mtime == st.st_mtime;
+}
+
+static void _export_hash_write(const gchar *path,
+                               const char *filename,
+                               const dt_hash_t hash)
+{
+  GStatBuf st;
+  if(!path || g_stat(filename, &st)) return;
+
+  gchar *content = g_strdup_printf("%016" PRIx64 " %" PRId64 " %" PRId64 "\n",
+                                   hash, (int64_t)st.st_size, (int64_t)st.st_mtime);
+  g_file_set_contents(path, content, -1, NULL);
+  g_free(content);
+}
+
+/* Thumbnails of raw images don't need the full sensor resolution. If the
+   wanted size allows it the mosaic is binned to twice that size keeping
+   the CFA layout, the same way as for the preview pipe input, and the
+   thumbnail pipe processes the smaller mosaic. Returns NULL if the full
+   buffer has to be used.
+*/
+static void *_reduced_raw_input(const dt_image_t *img,
+                                const dt_mipmap_buffer_t *buf,
+                                const int max_width,
+                                const int max_height,
+                                int *width,
+                                int *height,
+                                float *iscale)
+{
+  const uint32_t filters = img->buf_dsc.filters;
+  if(!filters || max_width <= 0 || max_height <= 0 || img->buf_dsc.channels != 1
+     || !dt_conf_get_bool("plugins/lighttable/thumbnail_reduced_raw"))
+    return NULL;
+
+  const dt_iop_roi_t roi_in = { 0, 0, buf->width, buf->height, 1.0f };
+  dt_iop_roi_t roi_out = { 0, 0, 0, 0, 1.0f };
+  roi_out.scale = fminf(2.0f * max_width / buf->width, 2.0f * max_height / buf->height);
+  // the binning covers whole CFA blocks
+  if(roi_out.scale > (filters == 9u ? 1.0f / 3.0f : 0.5f))
+    return NULL;
+  roi_out.width = roi_out.scale * roi_in.width;
+  roi_out.height = roi_out.scale * roi_in.height;
+  if(roi_out.width < 1 || roi_out.height < 1)
+    return NULL;
+
+  const gboolean is_float = img->buf_dsc.datatype == TYPE_FLOAT;
+  void *out = dt_alloc_aligned((size_t)roi_out.width * roi_out.height
+                               * (is_float ? sizeof(float) : sizeof(uint16_t)));
+  if(!out) return NULL;
+
+  if(filters != 9u && is_float)
+    dt_iop_clip_and_zoom_mosaic_half_size_f(out, (const float *)buf->buf, &roi_out, &roi_in,
+                                            roi_out.width, roi_in.width, filters);
+  else if(filters != 9u)
+    dt_iop_clip_and_zoom_mosaic_half_size(out, (const uint16_t *)buf->buf, &roi_out, &roi_in,
+                                          roi_out.width, roi_in.width, filters);
+  else if(is_float)
+    dt_iop_clip_and_zoom_mosaic_third_size_xtrans_f(out, (const float *)buf->buf, &roi_out, &roi_in,
+                                                    roi_out.width, roi_in.width, img->buf_dsc.xtrans);
+  else
+    dt_iop_clip_and_zoom_mosaic_third_size_xtrans(out, (const uint16_t *)buf->buf, &roi_out, &roi_in,
+                                                  roi_out.width, roi_in.width, img->buf_dsc.xtrans);
+
+  dt_print_pipe(DT_DEBUG_IMAGEIO | DT_DEBUG_PIPE,
+                "reduced raw input", NULL, NULL, DT_DEVICE_CPU, &roi_in, &roi_out);
+  *width = roi_out.width;
+  *height = roi_out.height;
+  *iscale = (float)buf->width / (float)roi_out.width;
+  return out;
+}
+
+// the float pipe output is converted in place. the first pixels are done
+// serially, after that each range only overwrites input consumed by the
+// previous ones, so the range can be converted in parallel and grows by
+// the ratio of input to output pixel size.
+#define DT_EXPORT_CONVERT_SERIAL 4096
+
+static void _export_float_to_8(uint8_t *const buf,
+                               const size_t npixels,
+                               const gboolean swap)
+{
+  const float *const in = (const float *)buf;
+  const int c0 = swap ? 2 : 0;
+  const int c2 = 2 - c0;
+  for(size_t start = 0, end = MIN(npixels, DT_EXPORT_CONVERT_SERIAL);
+      start < npixels;
+      start = end, end = MIN(npixels, 4 * end))
+  {
+    DT_OMP_FOR(if(start > 0))
+    for(size_t k = start; k < end; k++)
+    {
+      const uint8_t r = roundf(CLAMP(in[4 * k + c0] * 0xff, 0, 0xff));
+      const uint8_t g = roundf(CLAMP(in[4 * k + 1] * 0xff, 0, 0xff));
+      const uint8_t b = roundf(CLAMP(in[4 * k + c2] * 0xff, 0, 0xff));
+      buf[4 * k + 0] = r;
+      buf[4 * k + 1] = g;
+      buf[4 * k + 2] = b;
+    }
+  }
+}
+
+static void _export_float_to_16(uint8_t *const buf,
+                                const size_t npixels)
+{
+  const float *const in = (const float *)buf;
+  uint16_t *const buf16 = (uint16_t *)buf;
+  for(size_t start = 0, end = MIN(npixels, DT_EXPORT_CONVERT_SERIAL);
+      start < npixels;
+      start = end, end = MIN(npixels, 2 * end))
+  {
+    DT_OMP_FOR(if(start > 0))
+    for(size_t k = start; k < end; k++)
+    {
+      const uint16_t r = roundf(CLAMP(in[4 * k + 0] * 0xffff, 0, 0xffff));
+      const uint16_t g = roundf(CLAMP(in[4 * k + 1] * 0xffff, 0, 0xffff));
+      const uint16_t b = roundf(CLAMP(in[4 * k + 2] * 0xffff, 0, 0xffff));
+      buf16[4 * k + 0] = r;
+      buf16[4 * k + 1] = g;
+      buf16[4 * k + 2] = b;
+    }
+  }
+}
+
 // internal function: to avoid exif blob reading + 8-bit byteorder
 // flag + high-quality override
 gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
@@ -1066,6 +1341,9 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
                                       dt_export_metadata_t *metadata,
                                       const int history_end)
 {
+  gchar *hash_path = NULL;
+  dt_hash_t export_hash = DT_INVALID_HASH;
+  void *reduced = NULL;
   dt_develop_t dev;
   dt_dev_init(&dev, FALSE);
   dt_dev_load_image(&dev, imgid);
@@ -1101,6 +1379,17 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   const int wd = img->width;
   const int ht = img->height;
 
+  int input_width = buf.width;
+  int input_height = buf.height;
+  float input_iscale = buf.iscale;
+  reduced = thumbnail_export
+    ? _reduced_raw_input(img, &buf, format_params->max_width, format_params->max_height,
+                         &input_width, &input_height, &input_iscale)
+    : NULL;
+  // the pipe reads from the binned copy, don't pin the full frame in the
+  // cache while it is processed
+  if(reduced) dt_mipmap_cache_release(&buf);
+
   dt_times_t start;
   dt_get_perf_times(&start);
   dt_dev_pixelpipe_t pipe;
@@ -1123,7 +1412,7 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   //  If a style is to be applied during export, add the iop params into the history
   if(use_style)
   {
-    GList *style_items = dt_styles_get_item_list(format_params->style, FALSE, -1, TRUE);
+    GList *style_items = dt_styles_get_compiled_item_list(format_params->style, &dev);
     if(!style_items)
     {
       dt_print(DT_DEBUG_ALWAYS,
@@ -1189,8 +1478,8 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   dt_ioppr_resync_modules_order(&dev);
 
   dt_dev_pixelpipe_set_icc(&pipe, icc_type, icc_filename, icc_intent);
-  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf,
-                             buf.width, buf.height, buf.iscale);
+  dt_dev_pixelpipe_set_input(&pipe, &dev, reduced ? (float *)reduced : (float *)buf.buf,
+                             input_width, input_height, input_iscale);
   dt_dev_pixelpipe_create_nodes(&pipe, &dev);
   dt_dev_pixelpipe_synch_all(&pipe, &dev);
 
@@ -1307,9 +1596,34 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
            dt_check_gimpmode("file") ? " GIMP" : "");
 
   const int bpp = format->bpp(format_params);
+  const gboolean hq_process = high_quality_processing || scale > 1.0f;
+
+  // re-exports to the same file can be skipped if nothing changed since
+  if(!thumbnail_export
+     && !filter
+     && dt_conf_get_bool("plugins/imageio/skip_unchanged")
+     && strcmp(format->mime(format_params), "memory"))
+  {
+    export_hash = _export_hash(&pipe, format, format_params,
+                               processed_width, processed_height, scale, hq_process,
+                               copy_metadata, export_masks, icc_type, icc_filename, icc_intent,
+                               metadata);
+    hash_path = _export_hash_path(filename);
+    if(_export_hash_matches(hash_path, filename, export_hash))
+    {
+      dt_print(DT_DEBUG_ALWAYS,
+               "[dt_imageio_export_with_flags] skipping unchanged `%s'", filename);
+      g_free(hash_path);
+      dt_dev_pixelpipe_cleanup(&pipe);
+      dt_dev_cleanup(&dev);
+      dt_mipmap_cache_release(&buf);
+      dt_free_align(reduced);
+      dt_set_backthumb_time(5.0);
+      return FALSE;
+    }
+  }
 
   dt_get_perf_times(&start);
-  const gboolean hq_process = high_quality_processing || scale > 1.0f;
   if(hq_process)
   {
     /*
@@ -1359,6 +1673,11 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
                   ? "[dev_process_thumbnail] pixel pipeline processing"
                   : "[dev_process_export] pixel pipeline processing");
 
+  // the input is not read anymore once the pipe is done, make the full
+  // frame evictable before the output conversion and the format writer
+  // allocate their own buffers
+  dt_mipmap_cache_release(&buf);
+
   uint8_t *outbuf = pipe.backbuf;
   if(outbuf == NULL)
   {
@@ -1368,70 +1687,28 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   }
 
   // downconversion to low-precision formats:
+  const size_t npixels = (size_t)processed_width * processed_height;
   if(bpp == 8)
   {
-    if(display_byteorder)
+    if(hq_process)
+      _export_float_to_8(outbuf, npixels, display_byteorder);
+    else if(!display_byteorder)
     {
-      if(hq_process)
+      // processing output was 8-bit already, just flip byte order
+      uint8_t *const buf8 = pipe.backbuf;
+      DT_OMP_FOR()
+      for(size_t k = 0; k < npixels; k++)
       {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = roundf(CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff));
-          const uint8_t g = roundf(CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff));
-          const uint8_t b = roundf(CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff));
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      // else processing output was 8-bit already, and no need to swap order
-    }
-    else // need to flip
-    {
-      // ldr output: char
-      if(hq_process)
-      {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = roundf(CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff));
-          const uint8_t g = roundf(CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff));
-          const uint8_t b = roundf(CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff));
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      else
-      { // !display_byteorder, need to swap:
-        uint8_t *const buf8 = pipe.backbuf;
-        DT_OMP_FOR()
-        // just flip byte order
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          uint8_t tmp = buf8[4 * k + 0];
-          buf8[4 * k + 0] = buf8[4 * k + 2];
-          buf8[4 * k + 2] = tmp;
-        }
+        uint8_t tmp = buf8[4 * k + 0];
+        buf8[4 * k + 0] = buf8[4 * k + 2];
+        buf8[4 * k + 2] = tmp;
       }
     }
   }
   else if(bpp == 16)
   {
     // uint16_t per color channel
-    float *buff = (float *)outbuf;
-    uint16_t *buf16 = (uint16_t *)outbuf;
-    for(int y = 0; y < processed_height; y++)
-      for(int x = 0; x < processed_width; x++)
-      {
-        // convert in place
-        const size_t k = (size_t)processed_width * y + x;
-        for(int i = 0; i < 3; i++)
-          buf16[4 * k + i] = roundf(CLAMP(buff[4 * k + i] * 0xffff, 0, 0xffff));
-      }
+    _export_float_to_16(outbuf, npixels);
   }
   // else output float, no further harm done to the pixels :)
 
@@ -1460,6 +1737,7 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
     md_flags_set = metadata ? (metadata->flags & meta_all) == meta_all : FALSE;
   }
 
+  const double encode_start = dt_get_wtime();
   if(!ignore_exif && md_flags_set)
   {
     uint8_t *exif_profile = NULL; // Exif data should be 65536 bytes
@@ -1489,6 +1767,13 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
                               &pipe, export_masks)) != 0;
   }
 
+  if(dt_trace_enabled())
+  {
+    char detail[48];
+    snprintf(detail, sizeof(detail), "ID=%d, %dx%d", imgid, processed_width, processed_height);
+    dt_trace_span("io", format->mime(NULL), DT_TRACE_CPU, encode_start, dt_get_wtime(), detail);
+  }
+
   if(res)
     goto error;
 
@@ -1500,9 +1785,17 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
     // no need to cancel the export if this fail
   }
 
+  if(hash_path)
+  {
+    _export_hash_write(hash_path, filename, export_hash);
+    g_free(hash_path);
+    hash_path = NULL;
+  }
+
   dt_dev_pixelpipe_cleanup(&pipe);
   dt_dev_cleanup(&dev);
   dt_mipmap_cache_release(&buf);
+  dt_free_align(reduced);
 
   if(!thumbnail_export && strcmp(format->mime(format_params), "memory")
     && !(format->flags(format_params) & FORMAT_FLAGS_NO_TMPFILE))
@@ -1534,17 +1827,25 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   }
 
   if(!thumbnail_export)
+  {
+    dt_metrics_inc(DT_METRIC_IMAGES_EXPORTED);
     dt_set_backthumb_time(5.0);
+  }
   return FALSE; // success
 
 error:
   dt_dev_pixelpipe_cleanup(&pipe);
 error_early:
+  g_free(hash_path);
   dt_dev_cleanup(&dev);
   dt_mipmap_cache_release(&buf);
+  dt_free_align(reduced);
 
   if(!thumbnail_export)
+  {
+    dt_metrics_inc(DT_METRIC_EXPORT_ERRORS);
     dt_set_backthumb_time(5.0);
+  }
   return TRUE;
 }
 
@@ -1600,13 +1901,14 @@ dt_imageio_retval_t dt_imageio_open(dt_image_t *img,
                                     const char *filename,
                                     dt_mipmap_buffer_t *buf)
 {
-  /* Check for buffer-based loading first */
-  // TODO: Temporary hack - buffer check added directly to dt_imageio_open()
-  // Consider: separate dt_imageio_open_from_buffer() dispatcher or loader plugin system
-  if(img->raw_buffer && img->raw_buffer_size > 0)
+  /* the file content might be held in memory, the caller owns a
+   * reference to it for the time of the call */
+  if(img->raw_buffer)
   {
-    dt_print(DT_DEBUG_PIPE, "[dt_imageio_open] using buffer-based loading (%zu bytes)", img->raw_buffer_size);
-    return dt_imageio_open_rawspeed_from_buffer(img, img->raw_buffer, img->raw_buffer_size, buf);
+    gsize size = 0;
+    const uint8_t *data = g_bytes_get_data(img->raw_buffer, &size);
+    dt_print(DT_DEBUG_PIPE, "[dt_imageio_open] using buffer-based loading (%zu bytes)", size);
+    return dt_imageio_open_rawspeed_from_buffer(img, data, size, buf);
   }
 
   /* first of all, check if file exists, don't bother to test loading
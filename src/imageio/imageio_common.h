@@ -66,6 +66,10 @@ gboolean dt_imageio_has_mono_preview(const char *filename);
 void dt_imageio_set_hdr_tag(dt_image_t *img);
 // Update the tag for b&w workflow
 void dt_imageio_update_monochrome_workflow_tag(int32_t id, int mask);
+// map a raw file read-only for decoding in place, NULL if disabled by
+// raw_loader_mmap (the default) or not possible. Truncating the file while
+// it is mapped raises SIGBUS. Release with g_mapped_file_unref().
+GMappedFile *dt_imageio_map_file(const char *filename);
 // opens the file using pfm, hdr, exr.
 dt_imageio_retval_t dt_imageio_open_hdr(dt_image_t *img,
                                         const char *filename,
@@ -156,11 +160,15 @@ void dt_imageio_flip_buffers_ui8_to_float(float *out,
                                           const dt_image_orientation_t orientation);
 
 // allocate buffer and return 0 on success along with largest jpg thumbnail from raw.
+// a jpeg is decoded at a reduced scale still covering min_width x min_height,
+// pass 0 for both to get the full thumbnail.
 gboolean dt_imageio_large_thumbnail(const char *filename,
                                uint8_t **buffer,
                                int32_t *width,
                                int32_t *height,
-                               dt_colorspaces_color_profile_type_t *color_space);
+                               dt_colorspaces_color_profile_type_t *color_space,
+                               const int min_width,
+                               const int min_height);
 
 // lookup maker and model, dispatch lookup to rawspeed or libraw
 gboolean dt_imageio_lookup_makermodel(const char *maker,
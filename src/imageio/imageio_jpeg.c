@@ -154,7 +154,7 @@ int dt_imageio_jpeg_decompress_header(const void *in, size_t length, dt_imageio_
 static int decompress_jsc(dt_imageio_jpeg_t *jpg, uint8_t *out)
 {
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), &tmp, 1) != 1)
     {
@@ -173,14 +173,14 @@ static int decompress_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
   if(!row_pointer[0])
     return 1;
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), row_pointer, 1) != 1)
     {
       dt_free_align(row_pointer[0]);
       return 1;
     }
-    for(unsigned int i = 0; i < jpg->dinfo.image_width; i++)
+    for(unsigned int i = 0; i < jpg->dinfo.output_width; i++)
     {
       for(int k = 0; k < 3; k++) tmp[4 * i + k] = row_pointer[0][3 * i + k];
     }
@@ -617,7 +617,7 @@ int dt_imageio_jpeg_read_header(const char *filename, dt_imageio_jpeg_t *jpg)
 static int read_jsc(dt_imageio_jpeg_t *jpg, uint8_t *out)
 {
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), &tmp, 1) != 1)
     {
@@ -636,7 +636,7 @@ static int read_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
   if(!row_pointer[0])
     return 1;
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), row_pointer, 1) != 1)
     {
@@ -645,7 +645,7 @@ static int read_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
       fclose(jpg->f);
       return 1;
     }
-    for(unsigned int i = 0; i < jpg->dinfo.image_width; i++)
+    for(unsigned int i = 0; i < jpg->dinfo.output_width; i++)
       for(int k = 0; k < 3; k++) tmp[4 * i + k] = row_pointer[0][3 * i + k];
     tmp += 4 * jpg->width;
   }
@@ -653,6 +653,212 @@ static int read_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
   return 0;
 }
 
+void dt_imageio_jpeg_set_scale(dt_imageio_jpeg_t *jpg,
+                               const int width,
+                               const int height)
+{
+  // libjpeg scales in the DCT domain for free by 1/2, 1/4 and 1/8
+  int denom = 1;
+  while(denom < 8
+        && (int)jpg->dinfo.image_width / (2 * denom) >= width
+        && (int)jpg->dinfo.image_height / (2 * denom) >= height)
+    denom *= 2;
+  jpg->dinfo.scale_num = 1;
+  jpg->dinfo.scale_denom = denom;
+  jpeg_calc_output_dimensions(&(jpg->dinfo));
+  jpg->width = jpg->dinfo.output_width;
+  jpg->height = jpg->dinfo.output_height;
+}
+
+#ifdef JCS_EXTENSIONS
+/* Large baseline JPEGs with a restart marker at the end of every few MCU
+   rows are decoded in parallel. The entropy coded data is cut at the
+   restart markers into bands, each band is decoded as a JPEG of its own
+   made of the original headers with a patched height. Bands overlap by
+   one restart interval so the chroma upsampling at the cuts sees the same
+   rows as in a sequential decode.
+*/
+#define JPEG_PARALLEL_MIN_PIXELS (16 * 1024 * 1024)
+
+typedef struct _jpeg_restart_t
+{
+  const uint8_t *data;
+  size_t header;       // bytes up to the entropy coded data
+  size_t sof_height;   // offset of the frame height
+  size_t *segment;     // start of the restart intervals, plus the EOI offset
+  int intervals;
+  int rows;            // pixel rows per restart interval
+} _jpeg_restart_t;
+
+static gboolean _jpeg_find_restarts(const uint8_t *data,
+                                    const size_t size,
+                                    const int height,
+                                    _jpeg_restart_t *rs)
+{
+  // walk the marker segments up to the start of scan
+  size_t pos = 2;
+  rs->sof_height = 0;
+  while(pos + 4 <= size && data[pos] == 0xFF)
+  {
+    const uint8_t marker = data[pos + 1];
+    const size_t len = (data[pos + 2] << 8) | data[pos + 3];
+    if(marker == 0xC0 || marker == 0xC1)
+      rs->sof_height = pos + 5;
+    pos += 2 + len;
+    if(marker == 0xDA) break;
+  }
+  if(!rs->sof_height || pos >= size) return FALSE;
+  rs->header = pos;
+
+  const int intervals = (height + rs->rows - 1) / rs->rows;
+  rs->segment = g_new(size_t, intervals + 1);
+  rs->segment[0] = pos;
+  int n = 1;
+  while(pos + 1 < size)
+  {
+    if(data[pos] != 0xFF) { pos++; continue; }
+    const uint8_t next = data[pos + 1];
+    if(next == 0x00) pos += 2;                 // stuffed byte
+    else if(next == 0xFF) pos++;               // fill byte
+    else if(next >= 0xD0 && next <= 0xD7)
+    {
+      if(n > intervals - 1) break;
+      rs->segment[n++] = pos + 2;
+      pos += 2;
+    }
+    else if(next == 0xD9)
+    {
+      rs->segment[n] = pos + 2;
+      break;
+    }
+    else break;                                // another scan or garbage
+  }
+  if(n != intervals || pos + 1 >= size || data[pos + 1] != 0xD9)
+  {
+    g_free(rs->segment);
+    return FALSE;
+  }
+  rs->intervals = intervals;
+  return TRUE;
+}
+
+// decode restart intervals [first, last) and keep the rows from skip on
+static int _jpeg_decode_band(const _jpeg_restart_t *rs,
+                             const int width,
+                             const int height,
+                             const int first,
+                             const int last,
+                             const int skip,
+                             const int keep,
+                             uint8_t *out)
+{
+  const int y0 = first * rs->rows;
+  const int band_height = MIN(height - y0, (last - first) * rs->rows);
+
+  // headers, the intervals with renumbered restart markers and an EOI
+  size_t size = rs->header + 2;
+  for(int k = first; k < last; k++)
+    size += rs->segment[k + 1] - rs->segment[k];
+  uint8_t *band = g_malloc(size);
+  memcpy(band, rs->data, rs->header);
+  band[rs->sof_height] = band_height >> 8;
+  band[rs->sof_height + 1] = band_height & 0xFF;
+  size_t pos = rs->header;
+  for(int k = first; k < last; k++)
+  {
+    // every segment but the last one ends with its restart marker
+    const size_t len = rs->segment[k + 1] - rs->segment[k] - 2;
+    memcpy(band + pos, rs->data + rs->segment[k], len);
+    pos += len;
+    band[pos++] = 0xFF;
+    band[pos++] = k + 1 < last ? 0xD0 + ((k - first) & 7) : 0xD9;
+  }
+
+  dt_imageio_jpeg_t jpg;
+  struct dt_imageio_jpeg_error_mgr jerr;
+  if(dt_imageio_jpeg_decompress_header(band, pos, &jpg))
+  {
+    g_free(band);
+    return 1;
+  }
+  uint8_t *row = dt_alloc_align_uint8((size_t)4 * width);
+  jpg.dinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
+  if(setjmp(jerr.setjmp_buffer))
+  {
+    jpeg_destroy_decompress(&(jpg.dinfo));
+    dt_free_align(row);
+    g_free(band);
+    return 1;
+  }
+  jpg.dinfo.out_color_space = JCS_EXT_RGBX;
+  jpg.dinfo.out_color_components = 4;
+  (void)jpeg_start_decompress(&(jpg.dinfo));
+
+  int err = !row;
+  while(!err && jpg.dinfo.output_scanline < (JDIMENSION)(skip + keep))
+  {
+    const int y = jpg.dinfo.output_scanline;
+    uint8_t *dst = y >= skip ? out + (size_t)4 * width * (y - skip) : row;
+    err = jpeg_read_scanlines(&(jpg.dinfo), &dst, 1) != 1;
+  }
+  // the following rows of the band are only context
+  jpeg_abort_decompress(&(jpg.dinfo));
+  jpeg_destroy_decompress(&(jpg.dinfo));
+  dt_free_align(row);
+  g_free(band);
+  return err;
+}
+
+static int _jpeg_read_parallel(const char *filename, dt_imageio_jpeg_t *jpg, uint8_t *out)
+{
+  const struct jpeg_decompress_struct *d = &(jpg->dinfo);
+  const int width = d->image_width;
+  const int height = d->image_height;
+  if(d->progressive_mode || !d->restart_interval || d->scale_denom != 1
+     || (size_t)width * height < JPEG_PARALLEL_MIN_PIXELS || dt_get_num_threads() < 2)
+    return 1;
+
+  // restart intervals must cover whole MCU rows
+  const int mcu_width = 8 * d->max_h_samp_factor;
+  const int mcus_per_row = (width + mcu_width - 1) / mcu_width;
+  if(d->restart_interval % mcus_per_row) return 1;
+
+  GMappedFile *map = g_mapped_file_new(filename, FALSE, NULL);
+  if(!map) return 1;
+
+  _jpeg_restart_t rs = { .data = (const uint8_t *)g_mapped_file_get_contents(map) };
+  rs.rows = (d->restart_interval / mcus_per_row) * 8 * d->max_v_samp_factor;
+  if(!_jpeg_find_restarts(rs.data, g_mapped_file_get_length(map), height, &rs))
+  {
+    g_mapped_file_unref(map);
+    return 1;
+  }
+
+  const int nbands = MIN(rs.intervals, 4 * dt_get_num_threads());
+  int failed = 0;
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic) reduction(+ : failed))
+  for(int b = 0; b < nbands; b++)
+  {
+    const int i0 = b * rs.intervals / nbands;
+    const int i1 = (b + 1) * rs.intervals / nbands;
+    const int first = MAX(0, i0 - 1);
+    const int last = MIN(rs.intervals, i1 + 1);
+    const int keep = MIN(height, i1 * rs.rows) - i0 * rs.rows;
+    failed += _jpeg_decode_band(&rs, width, height, first, last, (i0 - first) * rs.rows, keep,
+                                out + (size_t)4 * width * i0 * rs.rows);
+  }
+
+  g_free(rs.segment);
+  g_mapped_file_unref(map);
+  if(failed) return 1;
+
+  jpeg_destroy_decompress(&(jpg->dinfo));
+  fclose(jpg->f);
+  return 0;
+}
+#endif
+
 int dt_imageio_jpeg_read(dt_imageio_jpeg_t *jpg, uint8_t *out)
 {
   struct dt_imageio_jpeg_error_mgr jerr;
@@ -763,13 +969,17 @@ dt_imageio_retval_t dt_imageio_open_jpeg(dt_image_t *img,
 
   img->width = jpg.width;
   img->height = jpg.height;
-  uint8_t *tmp = dt_alloc_align_uint8(4 * jpg.width * jpg.height);
+  uint8_t *tmp = dt_alloc_align_uint8((size_t)4 * jpg.width * jpg.height);
   if(!tmp)
   {
     return DT_IMAGEIO_LOAD_FAILED;
   }
 
+#ifdef JCS_EXTENSIONS
+  if(_jpeg_read_parallel(filename, &jpg, tmp) && dt_imageio_jpeg_read(&jpg, tmp))
+#else
   if(dt_imageio_jpeg_read(&jpg, tmp))
+#endif
   {
     dt_free_align(tmp);
     return DT_IMAGEIO_FILE_CORRUPTED;
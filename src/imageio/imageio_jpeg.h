@@ -62,6 +62,9 @@ int dt_imageio_jpeg_write_with_icc_profile(const char *filename, const uint8_t *
                                            dt_imgid_t imgid);
 /** read jpeg header from file, leave file descriptor open until jpeg_read is called. */
 int dt_imageio_jpeg_read_header(const char *filename, dt_imageio_jpeg_t *jpg);
+/** let jpeg_read decode at the smallest DCT scale still covering width x height,
+    updates width/height in jpg struct. */
+void dt_imageio_jpeg_set_scale(dt_imageio_jpeg_t *jpg, const int width, const int height);
 /** reads the jpeg to the (sufficiently allocated) buffer, closes file. */
 int dt_imageio_jpeg_read(dt_imageio_jpeg_t *jpg, uint8_t *out);
 /** reads the color profile attached to the jpeg, closes file. */
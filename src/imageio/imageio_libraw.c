@@ -395,20 +395,37 @@ dt_imageio_retval_t dt_imageio_open_libraw(dt_image_t *img,
   if(!raw)
     return DT_IMAGEIO_LOAD_FAILED;
 
+  // LibRaw reads the mapped file in place, it must stay mapped until
+  // the raw data has been unpacked
+  GMappedFile *map = dt_imageio_map_file(filename);
+  if(map)
+    libraw_err = libraw_open_buffer(raw, g_mapped_file_get_contents(map),
+                                    g_mapped_file_get_length(map));
+  else
+  {
 #if defined(_WIN32) && (defined(UNICODE) || defined(_UNICODE))
-  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
-  libraw_err = libraw_open_wfile(raw, wfilename);
-  g_free(wfilename);
+    wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
+    libraw_err = libraw_open_wfile(raw, wfilename);
+    g_free(wfilename);
 #else
-  libraw_err = libraw_open_file(raw, filename);
+    libraw_err = libraw_open_file(raw, filename);
 #endif
+  }
   if(libraw_err != LIBRAW_SUCCESS)
     goto error;
 
+  // with the OpenMP build the CRX planes of CR3 files are decoded in
+  // parallel, using darktable's OpenMP thread count
+  const double unpack_start = dt_get_wtime();
   libraw_err = libraw_unpack(raw);
   if(libraw_err != LIBRAW_SUCCESS)
     goto error;
 
+  dt_print(DT_DEBUG_PERF,
+           "[libraw_open] unpacked `%s' %dx%d in %.3f secs with %d threads",
+           img->filename, raw->rawdata.sizes.raw_width, raw->rawdata.sizes.raw_height,
+           dt_get_wtime() - unpack_start, dt_get_num_threads());
+
   // Bad method to detect if camera is fully supported by LibRaw,
   // but seems to be the best available. LibRaw crx decoder can actually
   // decode the raw data, but internal metadata like wb_coeffs, crops etc.
@@ -573,6 +590,7 @@ error:
     }
   }
   libraw_close(raw);
+  if(map) g_mapped_file_unref(map);
   return err;
 }
 #endif
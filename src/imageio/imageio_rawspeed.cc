@@ -182,13 +182,32 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img,
   snprintf(filen, sizeof(filen), "%s", filename);
   FileReader f(filen);
 
+  // decode from the mapped file if possible, saves reading it into a copy
+  std::unique_ptr<GMappedFile, decltype(&g_mapped_file_unref)>
+    map(dt_imageio_map_file(filename), &g_mapped_file_unref);
+
   try
   {
     dt_rawspeed_load_meta();
 
-    dt_pthread_mutex_lock(&darktable.readFile_mutex);
-    auto [storage, storageBuf] = f.readFile();
-    dt_pthread_mutex_unlock(&darktable.readFile_mutex);
+    decltype(f.readFile().first) storage;
+    const uint8_t *data = nullptr;
+    Buffer::size_type size = 0;
+    if(map)
+    {
+      data = (const uint8_t *)g_mapped_file_get_contents(map.get());
+      size = static_cast<Buffer::size_type>(g_mapped_file_get_length(map.get()));
+    }
+    else
+    {
+      dt_pthread_mutex_lock(&darktable.readFile_mutex);
+      auto [fileStorage, fileBuf] = f.readFile();
+      dt_pthread_mutex_unlock(&darktable.readFile_mutex);
+      storage = std::move(fileStorage);
+      data = fileBuf.begin();
+      size = fileBuf.getSize();
+    }
+    Buffer storageBuf(data, size);
 
     RawParser t(storageBuf);
     std::unique_ptr<RawDecoder> d = t.getDecoder(meta);
@@ -252,6 +271,7 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img,
     /* free auto pointers on spot */
     d.reset();
     storage.reset();
+    map.reset();
 
     // Grab the WB
     if(r->metadata.wbCoeffs) {
@@ -35,6 +35,9 @@
 
 #define LAB_CONVERSION_PROFILE DT_COLORSPACE_LIN_REC2020
 
+// decoded size from which strips are read on all cores
+#define TIFF_PARALLEL_MIN_BYTES (16 << 20)
+
 typedef struct tiff_t
 {
   TIFF *tiff;
@@ -85,142 +88,222 @@ static inline float _half_to_float(uint16_t h)
 }
 #endif
 
-static inline int _read_chunky_8(tiff_t *t, uint16_t photometric)
+// convert one run of npixels chunky samples to the 4-channel float mip buffer
+
+static void _convert_8(const tiff_t *t,
+                       const void *input,
+                       float *out,
+                       const uint32_t npixels,
+                       const uint16_t photometric)
 {
   const gboolean need_invert = (photometric == PHOTOMETRIC_MINISWHITE);
+  const uint8_t *in = (const uint8_t *)input;
 
-  for(uint32_t row = 0; row < t->height; row++)
+  for(uint32_t i = 0; i < npixels; i++, in += t->spp, out += 4)
   {
-    uint8_t *in = ((uint8_t *)t->buf);
-    float *out = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
+    /* set rgb to first sample from scanline */
+    out[0] = need_invert
+             ? 1.0f - ((float)in[0]) * (1.0f / 255.0f)
+             :        ((float)in[0]) * (1.0f / 255.0f);
 
-    /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) return -1;
-
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
+    if(t->spp < 3)  // mono, maybe plus alpha channel
     {
-      /* set rgb to first sample from scanline */
-      out[0] = need_invert
-               ? 1.0f - ((float)in[0]) * (1.0f / 255.0f)
-               :        ((float)in[0]) * (1.0f / 255.0f);
-
-      if(t->spp < 3)  // mono, maybe plus alpha channel
-      {
-        out[1] = out[2] = out[0];
-      }
-      else
-      {
-        out[1] = ((float)in[1]) * (1.0f / 255.0f);
-        out[2] = ((float)in[2]) * (1.0f / 255.0f);
-      }
-
-      out[3] = 0;
+      out[1] = out[2] = out[0];
+    }
+    else
+    {
+      out[1] = ((float)in[1]) * (1.0f / 255.0f);
+      out[2] = ((float)in[2]) * (1.0f / 255.0f);
     }
-  }
 
-  return 1;
+    out[3] = 0;
+  }
 }
 
-static inline int _read_chunky_16(tiff_t *t)
+static void _convert_16(const tiff_t *t,
+                        const void *input,
+                        float *out,
+                        const uint32_t npixels,
+                        const uint16_t photometric)
 {
-  for(uint32_t row = 0; row < t->height; row++)
-  {
-    uint16_t *in = ((uint16_t *)t->buf);
-    float *out = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
+  const uint16_t *in = (const uint16_t *)input;
 
-    /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) return -1;
+  for(uint32_t i = 0; i < npixels; i++, in += t->spp, out += 4)
+  {
+    out[0] = ((float)in[0]) * (1.0f / 65535.0f);
 
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
+    if(t->spp < 3)  // mono, maybe plus alpha channel
     {
-      out[0] = ((float)in[0]) * (1.0f / 65535.0f);
-
-      if(t->spp < 3)  // mono, maybe plus alpha channel
-      {
-        out[1] = out[2] = out[0];
-      }
-      else
-      {
-        out[1] = ((float)in[1]) * (1.0f / 65535.0f);
-        out[2] = ((float)in[2]) * (1.0f / 65535.0f);
-      }
-
-      out[3] = 0;
+      out[1] = out[2] = out[0];
+    }
+    else
+    {
+      out[1] = ((float)in[1]) * (1.0f / 65535.0f);
+      out[2] = ((float)in[2]) * (1.0f / 65535.0f);
     }
-  }
 
-  return 1;
+    out[3] = 0;
+  }
 }
 
-static inline int _read_chunky_h(tiff_t *t)
+static void _convert_h(const tiff_t *t,
+                       const void *input,
+                       float *out,
+                       const uint32_t npixels,
+                       const uint16_t photometric)
 {
-  for(uint32_t row = 0; row < t->height; row++)
-  {
-    uint16_t *in = ((uint16_t *)t->buf);
-    float *out = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
-
-    /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) return -1;
+  const uint16_t *in = (const uint16_t *)input;
 
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
-    {
+  for(uint32_t i = 0; i < npixels; i++, in += t->spp, out += 4)
+  {
 #ifdef HAVE_IMATH
-      out[0] = imath_half_to_float(in[0]);
+    out[0] = imath_half_to_float(in[0]);
 #else
-      out[0] = _half_to_float(in[0]);
+    out[0] = _half_to_float(in[0]);
 #endif
 
-      if(t->spp < 3)  // mono, maybe plus alpha channel
-      {
-        out[1] = out[2] = out[0];
-      }
-      else
-      {
+    if(t->spp < 3)  // mono, maybe plus alpha channel
+    {
+      out[1] = out[2] = out[0];
+    }
+    else
+    {
 #ifdef HAVE_IMATH
-        out[1] = imath_half_to_float(in[1]);
-        out[2] = imath_half_to_float(in[2]);
+      out[1] = imath_half_to_float(in[1]);
+      out[2] = imath_half_to_float(in[2]);
 #else
-        out[1] = _half_to_float(in[1]);
-        out[2] = _half_to_float(in[2]);
+      out[1] = _half_to_float(in[1]);
+      out[2] = _half_to_float(in[2]);
 #endif
-      }
-
-      out[3] = 0;
     }
+
+    out[3] = 0;
   }
+}
 
-  return 1;
+static void _convert_f(const tiff_t *t,
+                       const void *input,
+                       float *out,
+                       const uint32_t npixels,
+                       const uint16_t photometric)
+{
+  const float *in = (const float *)input;
+
+  for(uint32_t i = 0; i < npixels; i++, in += t->spp, out += 4)
+  {
+    out[0] = in[0];
+
+    if(t->spp < 3)  // mono, maybe plus alpha channel
+    {
+      out[1] = out[2] = out[0];
+    }
+    else
+    {
+      out[1] = in[1];
+      out[2] = in[2];
+    }
+
+    out[3] = 0;
+  }
 }
 
-static inline int _read_chunky_f(tiff_t *t)
+typedef void (*_tiff_convert_t)(const tiff_t *t,
+                                const void *input,
+                                float *out,
+                                const uint32_t npixels,
+                                const uint16_t photometric);
+
+static int _read_chunky(tiff_t *t,
+                        const _tiff_convert_t convert,
+                        const uint16_t photometric)
 {
   for(uint32_t row = 0; row < t->height; row++)
   {
-    float *in = ((float *)t->buf);
     float *out = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
 
     /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) return -1;
+    if(TIFFReadScanline(t->tiff, t->buf, row, 0) == -1) return -1;
 
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
-    {
-      out[0] = in[0];
+    convert(t, t->buf, out, t->width, photometric);
+  }
 
-      if(t->spp < 3)  // mono, maybe plus alpha channel
-      {
-        out[1] = out[2] = out[0];
-      }
-      else
+  return 1;
+}
+
+static TIFF *_open_tiff(const char *filename)
+{
+#ifdef _WIN32
+  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
+  TIFF *tiff = TIFFOpenW(wfilename, "rb");
+  g_free(wfilename);
+  return tiff;
+#else
+  return TIFFOpen(filename, "rb");
+#endif
+}
+
+// Decode strips or tiles on all cores. A TIFF handle must not be shared
+// between threads, so every thread opens the file on its own and runs
+// the decompression and predictor of the chunks it is handed.
+static int _read_chunks_parallel(tiff_t *t,
+                                 const char *filename,
+                                 const _tiff_convert_t convert,
+                                 const uint16_t photometric)
+{
+  const gboolean tiled = TIFFIsTiled(t->tiff);
+  uint32_t chunk_width = t->width;
+  uint32_t chunk_height = 0;
+  if(tiled)
+  {
+    TIFFGetField(t->tiff, TIFFTAG_TILEWIDTH, &chunk_width);
+    TIFFGetField(t->tiff, TIFFTAG_TILELENGTH, &chunk_height);
+  }
+  else
+    TIFFGetFieldDefaulted(t->tiff, TIFFTAG_ROWSPERSTRIP, &chunk_height);
+  chunk_height = MIN(chunk_height, t->height);
+  if(chunk_width == 0 || chunk_height == 0) return -1;
+
+  const uint32_t nchunks = tiled ? TIFFNumberOfTiles(t->tiff) : TIFFNumberOfStrips(t->tiff);
+  const tmsize_t chunk_size = tiled ? TIFFTileSize(t->tiff) : TIFFStripSize(t->tiff);
+  const tmsize_t row_size = tiled ? TIFFTileRowSize(t->tiff) : (tmsize_t)t->scanlinesize;
+  const uint32_t across = (t->width + chunk_width - 1) / chunk_width;
+
+  int failed = 0;
+  DT_OMP_PRAGMA(parallel reduction(| : failed))
+  {
+    TIFF *tiff = _open_tiff(filename);
+    tdata_t buf = tiff ? _TIFFmalloc(chunk_size) : NULL;
+    if(!buf) failed = 1;
+
+    DT_OMP_PRAGMA(for schedule(dynamic))
+    for(uint32_t c = 0; c < nchunks; c++)
+    {
+      const uint32_t x0 = (c % across) * chunk_width;
+      const uint32_t y0 = (c / across) * chunk_height;
+      if(!buf || y0 >= t->height) continue;
+
+      const uint32_t w = MIN(chunk_width, t->width - x0);
+      const uint32_t h = MIN(chunk_height, t->height - y0);
+      const tmsize_t got = tiled
+        ? TIFFReadEncodedTile(tiff, c, buf, chunk_size)
+        : TIFFReadEncodedStrip(tiff, c, buf, chunk_size);
+      if(got < row_size * h)
       {
-        out[1] = in[1];
-        out[2] = in[2];
+        failed = 1;
+        continue;
       }
 
-      out[3] = 0;
+      for(uint32_t r = 0; r < h; r++)
+        convert(t, (uint8_t *)buf + r * row_size,
+                t->mipbuf + (size_t)4 * ((size_t)(y0 + r) * t->width + x0),
+                w, photometric);
     }
+
+    if(buf) _TIFFfree(buf);
+    if(tiff) TIFFClose(tiff);
   }
 
-  return 1;
+  return failed ? -1 : 1;
 }
 
 static inline int _read_chunky_8_Lab(tiff_t *t, uint16_t photometric)
@@ -386,30 +469,10 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img,
 
   t.image = img;
 
-#ifdef _WIN32
-  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
-  t.tiff = TIFFOpenW(wfilename, "rb");
-  g_free(wfilename);
-#else
-  t.tiff = TIFFOpen(filename, "rb");
-#endif
+  t.tiff = _open_tiff(filename);
 
   if(t.tiff == NULL) return DT_IMAGEIO_LOAD_FAILED;
 
-  // This loader does not implement reading of tiled files, so we explicitly
-  // offload them to the fallback (Graphics/Image)Magic loader ASAP instead
-  // of going as far as trying to read the scanline and exiting the loader
-  // due to TIFFReadScanline failure.
-  if(TIFFIsTiled(t.tiff))
-  {
-    dt_print(DT_DEBUG_ALWAYS,
-             "[tiff_open] hand over to fallback loader: "
-             "tiled TIFF is not supported in '%s'",
-             filename);
-    TIFFClose(t.tiff);
-    return DT_IMAGEIO_LOAD_FAILED;
-  }
-
   TIFFGetField(t.tiff, TIFFTAG_IMAGEWIDTH, &t.width);
   TIFFGetField(t.tiff, TIFFTAG_IMAGELENGTH, &t.height);
   TIFFGetField(t.tiff, TIFFTAG_BITSPERSAMPLE, &t.bpp);
@@ -424,6 +487,24 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img,
   if(t.sampleformat == SAMPLEFORMAT_VOID)
     t.sampleformat = SAMPLEFORMAT_UINT;
 
+  const gboolean is_lab = photometric == PHOTOMETRIC_CIELAB || photometric == PHOTOMETRIC_ICCLAB;
+  const gboolean tiled = TIFFIsTiled(t.tiff);
+
+  // Tiles are only read by the parallel chunk reader which has no Lab
+  // conversion, so we explicitly offload them to the fallback
+  // (Graphics/Image)Magic loader ASAP instead of going as far as trying
+  // to read the scanline and exiting the loader due to TIFFReadScanline
+  // failure.
+  if(tiled && is_lab)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[tiff_open] hand over to fallback loader: "
+             "tiled Lab TIFF is not supported in '%s'",
+             filename);
+    TIFFClose(t.tiff);
+    return DT_IMAGEIO_LOAD_FAILED;
+  }
+
   if(photometric == PHOTOMETRIC_SEPARATED)
   {
     dt_print(DT_DEBUG_ALWAYS,
@@ -519,35 +600,24 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img,
 
   int ok = 1;
   dt_imageio_retval_t ret = DT_IMAGEIO_LOAD_FAILED;
+  _tiff_convert_t convert = NULL;
 
-  if((photometric == PHOTOMETRIC_CIELAB || photometric == PHOTOMETRIC_ICCLAB)
-     && t.bpp == 8
-     && t.sampleformat == SAMPLEFORMAT_UINT)
+  if(is_lab && t.bpp == 8 && t.sampleformat == SAMPLEFORMAT_UINT)
   {
     ok = _read_chunky_8_Lab(&t, photometric);
   }
-  else if((photometric == PHOTOMETRIC_CIELAB || photometric == PHOTOMETRIC_ICCLAB)
-          && t.bpp == 16
-          && t.sampleformat == SAMPLEFORMAT_UINT)
+  else if(is_lab && t.bpp == 16 && t.sampleformat == SAMPLEFORMAT_UINT)
   {
     ok = _read_chunky_16_Lab(&t, photometric);
   }
-  else if(t.bpp == 8 && t.sampleformat == SAMPLEFORMAT_UINT)
-  {
-    ok = _read_chunky_8(&t, photometric);
-  }
-  else if(t.bpp == 16 && t.sampleformat == SAMPLEFORMAT_UINT)
-  {
-    ok = _read_chunky_16(&t);
-  }
-  else if(t.bpp == 16 && t.sampleformat == SAMPLEFORMAT_IEEEFP)
-  {
-    ok = _read_chunky_h(&t);
-  }
-  else if(t.bpp == 32 && t.sampleformat == SAMPLEFORMAT_IEEEFP)
-  {
-    ok = _read_chunky_f(&t);
-  }
+  else if(!is_lab && t.bpp == 8 && t.sampleformat == SAMPLEFORMAT_UINT)
+    convert = _convert_8;
+  else if(!is_lab && t.bpp == 16 && t.sampleformat == SAMPLEFORMAT_UINT)
+    convert = _convert_16;
+  else if(!is_lab && t.bpp == 16 && t.sampleformat == SAMPLEFORMAT_IEEEFP)
+    convert = _convert_h;
+  else if(!is_lab && t.bpp == 32 && t.sampleformat == SAMPLEFORMAT_IEEEFP)
+    convert = _convert_f;
   else
   {
     dt_print(DT_DEBUG_ALWAYS,
@@ -558,6 +628,20 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img,
     ret = DT_IMAGEIO_UNSUPPORTED_FORMAT;
   }
 
+  if(convert)
+  {
+    // large multi-strip files and all tiled ones are decoded in parallel,
+    // small ones are not worth opening the file once per thread
+    const gboolean parallel =
+      tiled
+      || (dt_get_num_threads() > 1
+          && TIFFNumberOfStrips(t.tiff) > 1
+          && (size_t)t.scanlinesize * t.height >= TIFF_PARALLEL_MIN_BYTES);
+    ok = parallel
+      ? _read_chunks_parallel(&t, filename, convert, photometric)
+      : _read_chunky(&t, convert, photometric);
+  }
+
   _TIFFfree(t.buf);
   TIFFClose(t.tiff);
 
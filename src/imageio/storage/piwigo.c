@@ -140,10 +140,32 @@ typedef struct dt_storage_piwigo_params_t
   int64_t parent_album_id;
   char *album;
   gboolean new_album;
-  gchar *tags;
   dt_variables_params_t *vp;
+
+  // uploads run on their own connections while the next images are
+  // exported. at most twice as many as there are connections are queued.
+  GThreadPool *uploads;
+  GAsyncQueue *idle_api;
+  int max_pending;
+  int pending;
+  gboolean upload_failed;
+  dt_pthread_mutex_t upload_mutex;
+  pthread_cond_t upload_cond;
 } dt_storage_piwigo_params_t;
 
+// one exported file waiting for its upload
+typedef struct _piwigo_upload_t
+{
+  gchar *fname;    // file in the tmp directory, removed after the upload
+  gchar *filename; // name of the image on the server, for conflict checks
+  gchar *author;
+  gchar *caption;
+  gchar *description;
+  gchar *tags;
+  int num;
+  int total;
+} _piwigo_upload_t;
+
 void *legacy_params(dt_imageio_module_storage_t *self,
                     const void *const old_params,
                     const size_t old_params_size,
@@ -843,16 +865,15 @@ static gboolean _piwigo_api_create_new_album(dt_storage_piwigo_params_t *p)
   return TRUE;
 }
 
-static int _piwigo_api_get_image_id(dt_storage_piwigo_params_t *p,
-                                    dt_image_t *img,
-                                    dt_imageio_module_format_t *format,
-                                    dt_imageio_module_data_t *fdata,
+static int _piwigo_api_get_image_id(_piwigo_api_context_t *api,
+                                    const int64_t album,
+                                    const char *filename,
                                     const int page)
 {
   GList *args = NULL;
   char album_id[10];
   char page_string[10];
-  snprintf(album_id, sizeof(album_id), "%d", (int) p->album_id);
+  snprintf(album_id, sizeof(album_id), "%d", (int)album);
   snprintf(page_string, sizeof(page_string), "%d", page);
 
   args = _piwigo_query_add_arguments(args, "method", "pwg.categories.getImages");
@@ -860,17 +881,15 @@ static int _piwigo_api_get_image_id(dt_storage_piwigo_params_t *p,
   args = _piwigo_query_add_arguments(args, "per_page", "100");
   args = _piwigo_query_add_arguments(args, "page", page_string);
 
-  _piwigo_api_post(p->api, args, NULL, TRUE);
+  _piwigo_api_post(api, args, NULL, TRUE);
 
   g_list_free(args);
 
-  char *filename = _get_filename(img, format, fdata);
-
-  if(p->api->response
-     && !p->api->error_occured
-     && json_object_has_member(p->api->response, "result"))
+  if(api->response
+     && !api->error_occured
+     && json_object_has_member(api->response, "result"))
   {
-    JsonNode *result_node = json_object_get_member(p->api->response, "result");
+    JsonNode *result_node = json_object_get_member(api->response, "result");
 
     if(result_node != NULL
        && json_node_get_node_type(result_node) == JSON_NODE_OBJECT)
@@ -899,24 +918,21 @@ static int _piwigo_api_get_image_id(dt_storage_piwigo_params_t *p,
                 if(strcmp(filename,
                           json_object_get_string_member(existing_image, "file")) == 0)
                 {
-                  g_free(filename);
                   return json_object_get_int_member(existing_image, "id");
                 }
               }
             }
-            g_free(filename);
-            return _piwigo_api_get_image_id(p, img, format, fdata, page+1);
+            return _piwigo_api_get_image_id(api, album, filename, page+1);
           }
         }
       }
     }
   }
 
-  g_free(filename);
   return -1;
 }
 
-static gboolean _piwigo_api_set_info(dt_storage_piwigo_params_t *p,
+static gboolean _piwigo_api_set_info(_piwigo_api_context_t *api,
                                      gchar *author,
                                      gchar *caption,
                                      gchar *description,
@@ -939,18 +955,20 @@ static gboolean _piwigo_api_set_info(dt_storage_piwigo_params_t *p,
   if(description && strlen(description)>0)
     args = _piwigo_query_add_arguments(args, "comment", description);
 
-  _piwigo_api_post(p->api, args, NULL, TRUE);
+  _piwigo_api_post(api, args, NULL, TRUE);
 
   g_list_free(args);
 
-  return !p->api->error_occured;
+  return !api->error_occured;
 }
 
-static gboolean _piwigo_api_upload_photo(dt_storage_piwigo_params_t *p,
+static gboolean _piwigo_api_upload_photo(_piwigo_api_context_t *api,
+                                         const dt_storage_piwigo_params_t *p,
                                          gchar *fname,
                                          gchar *author,
                                          gchar *caption,
                                          gchar *description,
+                                         gchar *tags,
                                          const int pwg_image_id)
 {
   GList *args = NULL;
@@ -978,17 +996,124 @@ static gboolean _piwigo_api_upload_photo(dt_storage_piwigo_params_t *p,
   if(description && strlen(description)>0)
     args = _piwigo_query_add_arguments(args, "comment", description);
 
-  if(p->tags && strlen(p->tags)>0)
-    args = _piwigo_query_add_arguments(args, "tags", p->tags);
+  if(tags && strlen(tags)>0)
+    args = _piwigo_query_add_arguments(args, "tags", tags);
 
   if(pwg_image_id >= 0)
     args = _piwigo_query_add_arguments(args, "image_id", pwg_image_id_string);
 
-  _piwigo_api_post(p->api, args, fname, FALSE);
+  _piwigo_api_post(api, args, fname, FALSE);
 
   g_list_free(args);
 
-  return !p->api->error_occured;
+  return !api->error_occured;
+}
+
+static void _piwigo_upload_free(_piwigo_upload_t *u)
+{
+  g_free(u->fname);
+  g_free(u->filename);
+  g_free(u->author);
+  g_free(u->caption);
+  g_free(u->description);
+  g_free(u->tags);
+  g_free(u);
+}
+
+// take an idle connection, or log in one more with the credentials of
+// the export
+static _piwigo_api_context_t *_piwigo_upload_api(dt_storage_piwigo_params_t *p)
+{
+  _piwigo_api_context_t *api = g_async_queue_try_pop(p->idle_api);
+  if(api) return api;
+
+  api = _piwigo_ctx_init();
+  api->server = g_strdup(p->api->server);
+  api->username = g_strdup(p->api->username);
+  api->password = g_strdup(p->api->password);
+  _piwigo_api_authenticate(api);
+  return api;
+}
+
+// thread pool worker: resolve conflicts and upload one exported file
+static void _piwigo_upload_run(gpointer data, gpointer user_data)
+{
+  _piwigo_upload_t *u = (_piwigo_upload_t *)data;
+  dt_storage_piwigo_params_t *p = (dt_storage_piwigo_params_t *)user_data;
+  _piwigo_api_context_t *api = _piwigo_upload_api(p);
+
+  gboolean status = TRUE;
+  gboolean skipped = FALSE;
+  int pwg_image_id = -1;
+
+  if(p->preset_data.conflict_action != DT_PIWIGO_CONFLICT_NOTHING)
+    pwg_image_id = _piwigo_api_get_image_id(api, p->album_id, u->filename, 0);
+
+  if(pwg_image_id >= 0 && p->preset_data.conflict_action == DT_PIWIGO_CONFLICT_METADATA)
+  {
+    status = _piwigo_api_set_info(api, u->author, u->caption, u->description, pwg_image_id);
+    if(!status)
+    {
+      dt_print(DT_DEBUG_ALWAYS,
+               "[imageio_storage_piwigo] could not update to Piwigo!");
+      dt_control_log(_("could not update to Piwigo!"));
+    }
+  }
+  else if(pwg_image_id >= 0 && p->preset_data.conflict_action == DT_PIWIGO_CONFLICT_SKIP)
+  {
+    skipped = TRUE;
+  }
+  else
+  {
+    status = _piwigo_api_upload_photo(api, p, u->fname, u->author, u->caption,
+                                      u->description, u->tags, pwg_image_id);
+    if(!status)
+    {
+      dt_print(DT_DEBUG_ALWAYS,
+               "[imageio_storage_piwigo] could not upload to Piwigo!");
+      dt_control_log(_("could not upload to Piwigo!"));
+    }
+  }
+
+  g_async_queue_push(p->idle_api, api);
+
+  // And remove from filesystem..
+  g_unlink(u->fname);
+
+  if(skipped)
+  {
+    dt_control_log(_("%d/%d skipped (already exists)"), u->num, u->total);
+  }
+  else if(status)
+  {
+    dt_control_log
+      (ngettext("%d/%d exported to Piwigo webalbum",
+                "%d/%d exported to Piwigo webalbum", u->num),
+       u->num, u->total);
+  }
+
+  dt_pthread_mutex_lock(&p->upload_mutex);
+  if(!status) p->upload_failed = TRUE;
+  p->pending--;
+  pthread_cond_signal(&p->upload_cond);
+  dt_pthread_mutex_unlock(&p->upload_mutex);
+
+  _piwigo_upload_free(u);
+}
+
+// wait for the queued uploads and log out their connections
+static void _piwigo_uploads_finish(dt_storage_piwigo_params_t *p)
+{
+  if(!p->uploads) return;
+
+  g_thread_pool_free(p->uploads, FALSE, TRUE);
+  p->uploads = NULL;
+
+  _piwigo_api_context_t *api;
+  while((api = g_async_queue_try_pop(p->idle_api)))
+    _piwigo_ctx_destroy(&api);
+  g_async_queue_unref(p->idle_api);
+  p->idle_api = NULL;
 }
 
 // Login button pressed...
@@ -1259,6 +1384,7 @@ static gboolean _finalize_store(gpointer user_data)
 void finalize_store(struct dt_imageio_module_storage_t *self,
                     dt_imageio_module_data_t *data)
 {
+  _piwigo_uploads_finish((dt_storage_piwigo_params_t *)data);
   g_main_context_invoke(NULL, _finalize_store, self->gui_data);
 }
 
@@ -1291,7 +1417,6 @@ int store(dt_imageio_module_storage_t *self,
   }
 
   gint result = 0;
-  gint skipped = 0;
 
   // Let's upload image...
 
@@ -1302,6 +1427,8 @@ int store(dt_imageio_module_storage_t *self,
   dt_image_t *img = dt_image_cache_get(imgid, 'r');
 
   char *filename = _get_filename(img, format, fdata);
+  // the conflict check looks for the plain image name on the server
+  char *server_filename = g_strdup(filename);
 
   if(*(p->preset_data.filename_pattern))
   {
@@ -1364,97 +1491,83 @@ int store(dt_imageio_module_storage_t *self,
              "[imageio_storage_piwigo] could not export to file: `%s'!",
              fname);
     dt_control_log(_("could not export to file `%s'!"), fname);
-    result = 1;
-    goto cleanup;
+    g_unlink(fname);
+    g_free(fname);
+    g_free(server_filename);
+    g_free(caption);
+    g_free(description);
+    g_free(author);
+    return 1;
   }
+
+  gchar *tags = NULL;
+  gboolean status = TRUE;
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
   {
-    gboolean status = TRUE;
-
     if(metadata->flags & DT_META_TAG)
     {
       GList *tags_list = dt_tag_get_list_export(imgid, metadata->flags);
-      p->tags = dt_util_glist_to_str(",", tags_list);
+      tags = dt_util_glist_to_str(",", tags_list);
       g_list_free_full(tags_list, g_free);
     }
 
+    // the album has to exist before the first upload is queued
     if(p->new_album)
     {
       status = _piwigo_api_create_new_album(p);
-      if(!status) dt_control_log(_("cannot create a new Piwigo album!"));
-    }
-
-    if(status)
-    {
-      int pwg_image_id = -1;
-
-      if(p->preset_data.conflict_action != DT_PIWIGO_CONFLICT_NOTHING)
-      {
-        pwg_image_id = _piwigo_api_get_image_id(p, img, format, fdata, 0);
-      }
-
-      if(pwg_image_id >= 0 && p->preset_data.conflict_action == DT_PIWIGO_CONFLICT_METADATA)
-      {
-        status = _piwigo_api_set_info(p, author, caption, description, pwg_image_id);
-        if(!status)
-        {
-          dt_print(DT_DEBUG_ALWAYS,
-                   "[imageio_storage_piwigo] could not update to Piwigo!");
-          dt_control_log(_("could not update to Piwigo!"));
-          result = 1;
-        }
-      }
-      else if(pwg_image_id >= 0 && p->preset_data.conflict_action == DT_PIWIGO_CONFLICT_SKIP)
-      {
-        skipped = 1;
-      }
+      if(!status)
+        dt_control_log(_("cannot create a new Piwigo album!"));
       else
       {
-        status = _piwigo_api_upload_photo(p, fname, author, caption,
-                                          description, pwg_image_id);
-        if(!status)
-        {
-          dt_print(DT_DEBUG_ALWAYS,
-                   "[imageio_storage_piwigo] could not upload to Piwigo!");
-          dt_control_log(_("could not upload to Piwigo!"));
-          result = 1;
-        }
-        else if(p->new_album)
-        {
-          // we do not want to create more albums when multiple upload
-          p->new_album = FALSE;
-          _piwigo_refresh_albums(ui, p->album);
-        }
+        // we do not want to create more albums when multiple upload
+        p->new_album = FALSE;
+        _piwigo_refresh_albums(ui, p->album);
       }
     }
-    if(p->tags)
+
+    if(status && !p->uploads)
     {
-      g_free(p->tags);
-      p->tags = NULL;
+      const int connections = dt_conf_get_int("plugins/imageio/storage/export/piwigo/connections");
+      p->max_pending = 2 * connections;
+      p->idle_api = g_async_queue_new();
+      p->uploads = g_thread_pool_new(_piwigo_upload_run, p, connections, FALSE, NULL);
     }
   }
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
-cleanup:
-
-  // And remove from filesystem..
-  g_unlink(fname);
-  g_free(caption);
-  g_free(description);
-  g_free(author);
-
-  if(skipped)
+  _piwigo_upload_t *u = g_malloc0(sizeof(_piwigo_upload_t));
+  u->fname = fname;
+  u->filename = server_filename;
+  u->author = author;
+  u->caption = caption;
+  u->description = description;
+  u->tags = tags;
+  u->num = num;
+  u->total = total;
+
+  if(!status)
   {
-    dt_control_log(_("%d/%d skipped (already exists)"), num, total);
+    g_unlink(fname);
+    _piwigo_upload_free(u);
+    return 1;
   }
-  else if(!result && !skipped)
+
+  // keep the number of exported files waiting in the tmp directory bounded
+  dt_pthread_mutex_lock(&p->upload_mutex);
+  while(p->pending >= p->max_pending && !p->upload_failed)
+    dt_pthread_cond_wait(&p->upload_cond, &p->upload_mutex);
+  result = p->upload_failed;
+  if(!result) p->pending++;
+  dt_pthread_mutex_unlock(&p->upload_mutex);
+
+  if(result)
   {
-    // this makes sense only if the export was successful
-    dt_control_log
-      (ngettext("%d/%d exported to Piwigo webalbum",
-                "%d/%d exported to Piwigo webalbum", num),
-       num, total);
+    g_unlink(fname);
+    _piwigo_upload_free(u);
   }
+  else
+    g_thread_pool_push(p->uploads, u, NULL);
+
   return result;
 }
 
@@ -1510,6 +1623,9 @@ void *get_params(dt_imageio_module_storage_t *self)
   p->vp = NULL;
   dt_variables_params_init(&p->vp);
 
+  dt_pthread_mutex_init(&p->upload_mutex, NULL);
+  pthread_cond_init(&p->upload_cond, NULL);
+
   if(ui->api && ui->api->authenticated == TRUE)
   {
     // create a new context for the import. set username/password to
@@ -1525,7 +1641,6 @@ void *get_params(dt_imageio_module_storage_t *self)
     int index = dt_bauhaus_combobox_get(ui->album_list);
 
     p->album_id = 0;
-    p->tags = NULL;
 
     if(index >= 0)
     {
@@ -1642,8 +1757,10 @@ void free_params(dt_imageio_module_storage_t *self,
 
   if(p)
   {
+    _piwigo_uploads_finish(p);
+    dt_pthread_mutex_destroy(&p->upload_mutex);
+    pthread_cond_destroy(&p->upload_cond);
     g_free(p->album);
-    g_free(p->tags);
     dt_variables_params_destroy(p->vp);
     _piwigo_ctx_destroy(&p->api);
     free(p);
@@ -0,0 +1,608 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/curl_tools.h"
+#include "common/darktable.h"
+#include "common/image.h"
+#include "common/utility.h"
+#include "common/variables.h"
+#include "control/conf.h"
+#include "control/control.h"
+#include "gui/accelerators.h"
+#include "gui/gtk.h"
+#include "gui/gtkentry.h"
+#include "imageio/imageio_common.h"
+#include "imageio/imageio_module.h"
+#include "imageio/storage/imageio_storage_api.h"
+#include <curl/curl.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+DT_MODULE(1)
+
+// the request signing is done by libcurl
+#if LIBCURL_VERSION_NUM >= 0x074b00
+#define HAVE_CURL_AWS_SIGV4
+#endif
+
+#ifdef _WIN32
+#define fseeko _fseeki64
+#endif
+
+// S3 requires at least 5 MiB for all parts but the last one
+#define S3_MIN_PART_SIZE (5 * 1024 * 1024)
+
+// gui data
+typedef struct s3_t
+{
+  GtkEntry *endpoint;
+  GtkEntry *region;
+  GtkEntry *bucket;
+  GtkEntry *key;
+} s3_t;
+
+// saved params. the credentials are not part of them, they are taken
+// from AWS_ACCESS_KEY_ID and AWS_SECRET_ACCESS_KEY at export time.
+typedef struct dt_imageio_s3_t
+{
+  char endpoint[DT_MAX_PATH_FOR_PARAMS];
+  char region[64];
+  char bucket[256];
+  char key[DT_MAX_PATH_FOR_PARAMS];
+  dt_variables_params_t *vp;
+} dt_imageio_s3_t;
+
+// the object one export is uploaded to
+typedef struct _s3_target_t
+{
+  gchar *url;
+  gchar *sigv4;
+  gchar *userpwd;
+} _s3_target_t;
+
+// a byte range of the exported file sent in one request
+typedef struct _s3_part_t
+{
+  FILE *f;
+  CURL *curl;
+  int64_t size;
+  int64_t sent;
+  int number;
+  char etag[128];
+} _s3_part_t;
+
+const char *name(const struct dt_imageio_module_storage_t *self)
+{
+  return _("S3 object storage");
+}
+
+static void _entry_changed_callback(GtkEntry *entry,
+                                    gpointer user_data)
+{
+  dt_conf_set_string((const char *)user_data, gtk_entry_get_text(entry));
+}
+
+static GtkEntry *_entry_new(dt_imageio_module_storage_t *self,
+                            const char *label,
+                            const char *key,
+                            const char *tooltip)
+{
+  GtkWidget *entry = dt_action_entry_new(DT_ACTION(self), label,
+                                         G_CALLBACK(_entry_changed_callback), (gpointer)key,
+                                         tooltip, dt_conf_get_string_const(key));
+  gtk_editable_set_position(GTK_EDITABLE(entry), -1);
+  return GTK_ENTRY(entry);
+}
+
+void gui_init(dt_imageio_module_storage_t *self)
+{
+  s3_t *d = malloc(sizeof(s3_t));
+  self->gui_data = (void *)d;
+
+  d->endpoint = _entry_new(self, N_("endpoint"), "plugins/imageio/storage/s3/endpoint",
+                           _("URL of the S3 compatible service, e.g. https://s3.eu-west-1.amazonaws.com\n"
+                             "credentials are read from AWS_ACCESS_KEY_ID and AWS_SECRET_ACCESS_KEY"));
+  d->region = _entry_new(self, N_("region"), "plugins/imageio/storage/s3/region",
+                         _("region used to sign the requests"));
+  d->bucket = _entry_new(self, N_("bucket"), "plugins/imageio/storage/s3/bucket",
+                         _("bucket the images are uploaded to"));
+  d->key = _entry_new(self, N_("key"), "plugins/imageio/storage/s3/key",
+                      _("object key of the exported images, without extension\n"
+                        "type '$(' to activate the completion and see the list of variables"));
+  dt_gtkentry_setup_variables_completion(d->key);
+
+  self->widget = dt_gui_vbox
+    (dt_gui_hbox(dt_ui_label_new(_("endpoint")), d->endpoint),
+     dt_gui_hbox(dt_ui_label_new(_("region")), d->region),
+     dt_gui_hbox(dt_ui_label_new(_("bucket")), d->bucket),
+     dt_gui_hbox(dt_ui_label_new(_("key")), d->key));
+}
+
+void gui_cleanup(dt_imageio_module_storage_t *self)
+{
+  free(self->gui_data);
+}
+
+void gui_reset(dt_imageio_module_storage_t *self)
+{
+  s3_t *d = self->gui_data;
+  gtk_entry_set_text(d->endpoint, dt_confgen_get("plugins/imageio/storage/s3/endpoint", DT_DEFAULT));
+  gtk_entry_set_text(d->region, dt_confgen_get("plugins/imageio/storage/s3/region", DT_DEFAULT));
+  gtk_entry_set_text(d->bucket, dt_confgen_get("plugins/imageio/storage/s3/bucket", DT_DEFAULT));
+  gtk_entry_set_text(d->key, dt_confgen_get("plugins/imageio/storage/s3/key", DT_DEFAULT));
+}
+
+#ifdef HAVE_CURL_AWS_SIGV4
+static size_t _s3_read_part(char *buf,
+                            const size_t size,
+                            const size_t nitems,
+                            void *data)
+{
+  _s3_part_t *part = (_s3_part_t *)data;
+  const size_t n = MIN(size * nitems, (size_t)(part->size - part->sent));
+  if(n == 0) return 0;
+  const size_t r = fread(buf, 1, n, part->f);
+  if(r == 0) return CURL_READFUNC_ABORT;
+  part->sent += r;
+  return r;
+}
+
+static size_t _s3_read_header(char *buf,
+                              const size_t size,
+                              const size_t nitems,
+                              void *data)
+{
+  _s3_part_t *part = (_s3_part_t *)data;
+  const size_t len = size * nitems;
+  if(len > 5 && !g_ascii_strncasecmp(buf, "etag:", 5))
+  {
+    gchar *value = g_strndup(buf + 5, len - 5);
+    g_strlcpy(part->etag, g_strstrip(value), sizeof(part->etag));
+    g_free(value);
+  }
+  return len;
+}
+
+static size_t _s3_write_response(void *ptr,
+                                 const size_t size,
+                                 const size_t nmemb,
+                                 void *data)
+{
+  g_string_append_len((GString *)data, ptr, size * nmemb);
+  return size * nmemb;
+}
+
+// a signed request on the target object, the query selects the S3 operation
+static CURL *_s3_request(const _s3_target_t *t,
+                         const char *query,
+                         GString *response,
+                         struct curl_slist *headers)
+{
+  CURL *curl = curl_easy_init();
+  if(!curl) return NULL;
+  dt_curl_init(curl, FALSE);
+
+  gchar *url = g_strconcat(t->url, query, NULL);
+  curl_easy_setopt(curl, CURLOPT_URL, url);
+  g_free(url);
+  curl_easy_setopt(curl, CURLOPT_AWS_SIGV4, t->sigv4);
+  curl_easy_setopt(curl, CURLOPT_USERPWD, t->userpwd);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  if(response)
+  {
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _s3_write_response);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+  }
+  return curl;
+}
+
+static gboolean _s3_succeeded(CURL *curl,
+                              const CURLcode res)
+{
+  long code = 0;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+  return res == CURLE_OK && code / 100 == 2;
+}
+
+// set up the upload of one part, or of the whole file for small objects
+static CURL *_s3_part_request(const _s3_target_t *t,
+                              const char *query,
+                              struct curl_slist *headers,
+                              const char *filename,
+                              const int64_t offset,
+                              _s3_part_t *part)
+{
+  part->f = g_fopen(filename, "rb");
+  if(!part->f) return NULL;
+  if(offset && fseeko(part->f, offset, SEEK_SET))
+  {
+    fclose(part->f);
+    part->f = NULL;
+    return NULL;
+  }
+
+  CURL *curl = _s3_request(t, query, NULL, headers);
+  if(!curl)
+  {
+    fclose(part->f);
+    part->f = NULL;
+    return NULL;
+  }
+  curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+  curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, (curl_off_t)part->size);
+  curl_easy_setopt(curl, CURLOPT_READFUNCTION, _s3_read_part);
+  curl_easy_setopt(curl, CURLOPT_READDATA, part);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, _s3_read_header);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, part);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, part);
+  return curl;
+}
+
+static gchar *_s3_xml_value(const char *xml,
+                            const char *tag)
+{
+  gchar *open = g_strdup_printf("<%s>", tag);
+  gchar *close = g_strdup_printf("</%s>", tag);
+  const char *start = strstr(xml, open);
+  const char *end = start ? strstr(start, close) : NULL;
+  gchar *value = end ? g_strndup(start + strlen(open), end - start - strlen(open)) : NULL;
+  g_free(open);
+  g_free(close);
+  return value;
+}
+
+static gboolean _s3_upload_multipart(const _s3_target_t *t,
+                                     struct curl_slist *headers,
+                                     const char *filename,
+                                     const int64_t size,
+                                     const int64_t part_size,
+                                     const int connections)
+{
+  // start the upload
+  GString *response = g_string_new(NULL);
+  CURL *curl = _s3_request(t, "?uploads", response, headers);
+  if(!curl)
+  {
+    g_string_free(response, TRUE);
+    return FALSE;
+  }
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "");
+  const gboolean started = _s3_succeeded(curl, curl_easy_perform(curl));
+  curl_easy_cleanup(curl);
+  gchar *upload_id = started ? _s3_xml_value(response->str, "UploadId") : NULL;
+  g_string_free(response, TRUE);
+  if(!upload_id)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[imageio_storage_s3] could not start multipart upload of `%s'", t->url);
+    return FALSE;
+  }
+  gchar *escaped_id = g_uri_escape_string(upload_id, NULL, FALSE);
+  g_free(upload_id);
+
+  // send the parts over several connections at once
+  const int nparts = (size + part_size - 1) / part_size;
+  _s3_part_t *parts = g_new0(_s3_part_t, nparts);
+  CURLM *multi = curl_multi_init();
+  int next = 0, active = 0;
+  gboolean failed = FALSE;
+
+  while(!failed && (next < nparts || active > 0))
+  {
+    while(!failed && active < connections && next < nparts)
+    {
+      _s3_part_t *part = &parts[next];
+      part->number = next + 1;
+      part->size = MIN(part_size, size - next * part_size);
+      gchar *query = g_strdup_printf("?partNumber=%d&uploadId=%s", part->number, escaped_id);
+      part->curl = _s3_part_request(t, query, headers, filename, next * part_size, part);
+      g_free(query);
+      if(part->curl)
+      {
+        curl_multi_add_handle(multi, part->curl);
+        active++;
+        next++;
+      }
+      else
+        failed = TRUE;
+    }
+
+    int running = 0;
+    curl_multi_perform(multi, &running);
+
+    CURLMsg *msg;
+    int left;
+    while((msg = curl_multi_info_read(multi, &left)))
+    {
+      if(msg->msg != CURLMSG_DONE) continue;
+      _s3_part_t *part = NULL;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&part);
+      if(!_s3_succeeded(msg->easy_handle, msg->data.result) || !*part->etag)
+        failed = TRUE;
+      curl_multi_remove_handle(multi, part->curl);
+      curl_easy_cleanup(part->curl);
+      fclose(part->f);
+      part->curl = NULL;
+      part->f = NULL;
+      active--;
+    }
+
+    if(running) curl_multi_poll(multi, NULL, 0, 1000, NULL);
+  }
+
+  // drop the transfers still running after a failure
+  for(int k = 0; k < nparts; k++)
+  {
+    if(!parts[k].curl) continue;
+    curl_multi_remove_handle(multi, parts[k].curl);
+    curl_easy_cleanup(parts[k].curl);
+    fclose(parts[k].f);
+  }
+  curl_multi_cleanup(multi);
+
+  // complete or abort the upload
+  gchar *query = g_strdup_printf("?uploadId=%s", escaped_id);
+  g_free(escaped_id);
+  response = g_string_new(NULL);
+  curl = _s3_request(t, query, response, headers);
+  g_free(query);
+  gboolean ok = FALSE;
+  if(curl && !failed)
+  {
+    GString *xml = g_string_new("<CompleteMultipartUpload>");
+    for(int k = 0; k < nparts; k++)
+      g_string_append_printf(xml, "<Part><PartNumber>%d</PartNumber><ETag>%s</ETag></Part>",
+                             parts[k].number, parts[k].etag);
+    g_string_append(xml, "</CompleteMultipartUpload>");
+    curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, xml->str);
+    g_string_free(xml, TRUE);
+    // a failing completion can still be reported with status 200
+    ok = _s3_succeeded(curl, curl_easy_perform(curl)) && !strstr(response->str, "<Error>");
+  }
+  if(curl && !ok)
+  {
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_perform(curl);
+  }
+  if(curl) curl_easy_cleanup(curl);
+  g_string_free(response, TRUE);
+  g_free(parts);
+  return ok;
+}
+
+static gboolean _s3_upload(const _s3_target_t *t,
+                           const char *filename)
+{
+  GStatBuf st;
+  if(g_stat(filename, &st)) return FALSE;
+
+  // the body is streamed from the file, so it is not part of the signature
+  struct curl_slist *headers = curl_slist_append(NULL, "x-amz-content-sha256: UNSIGNED-PAYLOAD");
+
+  const int64_t part_size = MAX((int64_t)S3_MIN_PART_SIZE,
+                                (int64_t)dt_conf_get_int("plugins/imageio/storage/s3/part_size") * 1024 * 1024);
+  const int connections = MAX(1, dt_conf_get_int("plugins/imageio/storage/s3/connections"));
+
+  gboolean ok = FALSE;
+  if(st.st_size > part_size)
+    ok = _s3_upload_multipart(t, headers, filename, st.st_size, part_size, connections);
+  else
+  {
+    _s3_part_t part = { .size = st.st_size };
+    CURL *curl = _s3_part_request(t, "", headers, filename, 0, &part);
+    if(curl)
+    {
+      ok = _s3_succeeded(curl, curl_easy_perform(curl));
+      curl_easy_cleanup(curl);
+      fclose(part.f);
+    }
+  }
+
+  curl_slist_free_all(headers);
+  return ok;
+}
+#endif // HAVE_CURL_AWS_SIGV4
+
+int store(dt_imageio_module_storage_t *self,
+          dt_imageio_module_data_t *sdata,
+          const dt_imgid_t imgid,
+          dt_imageio_module_format_t *format,
+          dt_imageio_module_data_t *fdata,
+          const int num,
+          const int total,
+          const gboolean high_quality,
+          const gboolean upscale,
+          const gboolean is_scaling,
+          const double scale_factor,
+          const gboolean export_masks,
+          dt_colorspaces_color_profile_type_t icc_type,
+          const gchar *icc_filename,
+          dt_iop_color_intent_t icc_intent,
+          dt_export_metadata_t *metadata)
+{
+#ifndef HAVE_CURL_AWS_SIGV4
+  dt_control_log(_("S3 upload needs libcurl 7.75 or newer"));
+  return 1;
+#else
+  dt_imageio_s3_t *d = (dt_imageio_s3_t *)sdata;
+
+  const char *access_key = g_getenv("AWS_ACCESS_KEY_ID");
+  const char *secret_key = g_getenv("AWS_SECRET_ACCESS_KEY");
+  if(!access_key || !secret_key || !*d->endpoint || !*d->bucket)
+  {
+    dt_control_log(_("S3 endpoint, bucket or credentials are missing"));
+    return 1;
+  }
+
+  char input_dir[PATH_MAX] = { 0 };
+  dt_image_full_path(imgid, input_dir, sizeof(input_dir), NULL);
+  dt_variables_set_max_width_height(d->vp, fdata->max_width, fdata->max_height);
+  dt_variables_set_upscale(d->vp, upscale);
+
+  char pattern[DT_MAX_PATH_FOR_PARAMS];
+  g_strlcpy(pattern, *d->key ? d->key : "$(FILE_NAME)", sizeof(pattern));
+
+  // we're potentially called in parallel. have sequence number synchronized:
+  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+  // avoid braindead export which is bound to overwrite at random:
+  if(total > 1 && !g_strrstr(pattern, "$"))
+    g_strlcat(pattern, "_$(SEQUENCE)", sizeof(pattern));
+  d->vp->filename = input_dir;
+  d->vp->jobcode = "export";
+  d->vp->imgid = imgid;
+  d->vp->sequence = num;
+  gchar *expanded = dt_variables_expand(d->vp, pattern, TRUE);
+  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+
+  const char *ext = format->extension(fdata);
+  const char *key = expanded;
+  while(*key == '/') key++;
+  gchar *object = g_strdup_printf("%s.%s", key, ext);
+  g_free(expanded);
+
+  // the format modules write files, so the encoded image goes through
+  // the tmp directory on its way to the bucket. the name is unique as
+  // concurrent export jobs may upload the same image.
+  gchar *tmpname = g_strdup_printf("s3-%d-XXXXXX.%s", imgid, ext);
+  gchar *filename = g_build_filename(darktable.tmpdir, tmpname, NULL);
+  g_free(tmpname);
+  const int fd = g_mkstemp(filename);
+  if(fd < 0)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[imageio_storage_s3] could not create temporary file: `%s'!",
+             filename);
+    dt_control_log(_("could not export to file `%s'!"), filename);
+    g_free(filename);
+    g_free(object);
+    return 1;
+  }
+  g_close(fd, NULL);
+
+  int result = 0;
+  if(dt_imageio_export(imgid, filename, format, fdata, high_quality,
+                       upscale, is_scaling, scale_factor,
+                       TRUE, export_masks, icc_type,
+                       icc_filename, icc_intent, self, sdata,
+                       num, total, metadata) != 0)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[imageio_storage_s3] could not export to file: `%s'!",
+             filename);
+    dt_control_log(_("could not export to file `%s'!"), filename);
+    result = 1;
+  }
+  else
+  {
+    gchar *endpoint = g_strdup(d->endpoint);
+    const size_t len = strlen(endpoint);
+    if(len && endpoint[len - 1] == '/') endpoint[len - 1] = '\0';
+    gchar *escaped = g_uri_escape_string(object, "/", FALSE);
+
+    _s3_target_t target;
+    target.url = g_strdup_printf("%s/%s/%s", endpoint, d->bucket, escaped);
+    target.sigv4 = g_strdup_printf("aws:amz:%s:s3", *d->region ? d->region : "us-east-1");
+    target.userpwd = g_strdup_printf("%s:%s", access_key, secret_key);
+    g_free(endpoint);
+    g_free(escaped);
+
+    if(_s3_upload(&target, filename))
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[export_job] uploaded to `%s'", target.url);
+      dt_control_log(ngettext("%d/%d uploaded to `%s'", "%d/%d uploaded to `%s'", num),
+                     num, total, object);
+    }
+    else
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[imageio_storage_s3] could not upload `%s'!", target.url);
+      dt_control_log(_("could not upload `%s'!"), object);
+      result = 1;
+    }
+
+    g_free(target.url);
+    g_free(target.sigv4);
+    g_free(target.userpwd);
+  }
+
+  g_unlink(filename);
+  g_free(filename);
+  g_free(object);
+  return result;
+#endif
+}
+
+size_t params_size(dt_imageio_module_storage_t *self)
+{
+  return sizeof(dt_imageio_s3_t) - sizeof(void *);
+}
+
+void init(dt_imageio_module_storage_t *self)
+{
+}
+
+void *get_params(dt_imageio_module_storage_t *self)
+{
+  dt_imageio_s3_t *d = calloc(1, sizeof(dt_imageio_s3_t));
+
+  g_strlcpy(d->endpoint, dt_conf_get_string_const("plugins/imageio/storage/s3/endpoint"),
+            sizeof(d->endpoint));
+  g_strlcpy(d->region, dt_conf_get_string_const("plugins/imageio/storage/s3/region"),
+            sizeof(d->region));
+  g_strlcpy(d->bucket, dt_conf_get_string_const("plugins/imageio/storage/s3/bucket"),
+            sizeof(d->bucket));
+  g_strlcpy(d->key, dt_conf_get_string_const("plugins/imageio/storage/s3/key"),
+            sizeof(d->key));
+
+  d->vp = NULL;
+  dt_variables_params_init(&d->vp);
+
+  return d;
+}
+
+void free_params(dt_imageio_module_storage_t *self,
+                 dt_imageio_module_data_t *params)
+{
+  if(!params) return;
+  dt_imageio_s3_t *d = (dt_imageio_s3_t *)params;
+  dt_variables_params_destroy(d->vp);
+  free(params);
+}
+
+int set_params(dt_imageio_module_storage_t *self,
+               const void *params,
+               const int size)
+{
+  const dt_imageio_s3_t *d = (dt_imageio_s3_t *)params;
+  s3_t *g = self->gui_data;
+
+  if(size != self->params_size(self)) return 1;
+
+  gtk_entry_set_text(g->endpoint, d->endpoint);
+  gtk_entry_set_text(g->region, d->region);
+  gtk_entry_set_text(g->bucket, d->bucket);
+  gtk_entry_set_text(g->key, d->key);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
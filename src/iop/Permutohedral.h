@@ -37,6 +37,7 @@ DAMAGE.
 
 #include <algorithm>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -289,6 +290,7 @@ public:
         }
         // need to create an entry. Store the given key.
         keys[filled] = key;
+        values[filled] = Value(0);
         entries[h].keyIdx = filled;
         return filled++;
       }
@@ -388,6 +390,14 @@ public:
     total_alloc = capacity * sizeof(Entry) + maxFill() * sizeof(Key) + maxFill() * sizeof(Value);
   }
 
+  /* drop the value vectors once they have been moved elsewhere, keys and index stay usable for lookups */
+  void releaseValues()
+  {
+    delete[] values;
+    values = nullptr;
+    total_alloc -= maxFill() * sizeof(Value);
+  }
+
 private:
   // Private struct for the hash table entries.
   struct Entry
@@ -429,6 +439,13 @@ public:
    */
   PermutohedralLattice(size_t nData_, size_t nThreads_ = 1, size_t grid_points = ~0L) : nData(nData_), nThreads(nThreads_)
   {
+    shards = nullptr;
+    nShards = 0;
+    shardBase = nullptr;
+    nVertices = 0;
+    values = nullptr;
+    ownValues = false;
+
     // Allocate storage for various arrays
     float *scaleFactorTmp = new float[D];
     int *canonicalTmp = new int[(D + 1) * (D + 1)];
@@ -485,6 +502,9 @@ public:
     delete[] replay;
     delete[] canonical;
     delete[] hashTables;
+    delete[] shardBase;
+    if(ownValues) delete[] values;
+    delete[] shards;
   }
 
   PermutohedralLattice &operator=(const PermutohedralLattice &) = delete;
@@ -513,8 +533,9 @@ public:
      while (round_up < 2*hash_entries) round_up <<= 1;
      // we need to store not only the Key, Value, and Entry arrays, we
      // also need an additional copy of the Value array while blurring
-     // and storage for the remapping array while merging
-     size_t mergesize = hash_entries * 2 * (sizeof(Value)+sizeof(Key)) + round_up * sizeof(int);
+     // and storage for the sorting and remapping arrays while merging
+     size_t mergesize = hash_entries * (2 * (sizeof(Value)+sizeof(Key)) + sizeof(uint64_t) + sizeof(int))
+                        + 2 * round_up * sizeof(int);
      size_t blursize = hash_entries * (2*sizeof(Value)+sizeof(Key)) + (hash_entries+round_up) * sizeof(int);
      return MAX(mergesize, blursize);
   }
@@ -628,67 +649,138 @@ public:
     }
   }
 
-  /* Merge the multiple threads' hash tables into the totals. */
+  /* Merge the multiple threads' hash tables into the totals.
+   *
+   * The merged lattice is split into shards by key hash, each of them built by a single thread
+   * from the matching entries of all per-thread tables. Entries are visited in table order, so
+   * the sums are the same as when merging everything into one table serially.
+   */
   void merge_splat_threads()
   {
-    if(nThreads <= 1) return;
-
-    /* Because growing the hash table is expensive, we want to avoid having to do it multiple times.
-     * Only a small percentage of entries in the individual hash tables have the same key, so we
-     * won't waste much space if we simply grow the destination table enough to hold the sum of the
-     * entries in the individual tables
-     */
-    size_t alloc_entries = hashTables[0].maxFill();
-    size_t total_bytes = 0;
-    size_t total_grows = hashTables[0].auto_grow;
-    size_t init_bytes = hashTables[0].init_alloc;
-    size_t total_entries = hashTables[0].size();
-    for(size_t i = 1; i < nThreads; i++)
-    {
-       alloc_entries += hashTables[i].maxFill();
-       total_entries += hashTables[i].size();
-       init_bytes += hashTables[i].init_alloc;
-       total_bytes += hashTables[i].total_alloc;
-       total_grows += hashTables[i].auto_grow;
-    }
-    hashTables[0].growExact(total_entries);
-    total_bytes += hashTables[0].total_alloc;
-    /* Merge the multiple hash tables into one, creating an offset remap table. */
+    if(nThreads <= 1)
+    {
+      // the only table is the lattice
+      shards = hashTables;
+      hashTables = nullptr;
+      nShards = 1;
+      shardBase = new size_t[1];
+      shardBase[0] = 0;
+      nVertices = shards[0].size();
+      values = shards[0].getValues();
+      ownValues = false;
+      return;
+    }
+
+    nShards = 4 * nThreads;
+    const size_t nBins = nThreads * nShards;
+
+    // count the entries of each table per shard, then lay them out shard by shard
+    size_t *binStart = new size_t[nBins]();
+    DT_OMP_FOR()
+    for(size_t t = 0; t < nThreads; t++)
+    {
+      const Key *keys = hashTables[t].getKeys();
+      for(size_t j = 0; j < hashTables[t].size(); j++)
+        binStart[t * nShards + shardOf(keys[j].hash)]++;
+    }
+
+    size_t *shardStart = new size_t[nShards + 1];
+    size_t total_entries = 0;
+    for(size_t s = 0; s < nShards; s++)
+    {
+      shardStart[s] = total_entries;
+      for(size_t t = 0; t < nThreads; t++)
+      {
+        const size_t count = binStart[t * nShards + s];
+        binStart[t * nShards + s] = total_entries;
+        total_entries += count;
+      }
+    }
+    shardStart[nShards] = total_entries;
+
+    uint64_t *order = new uint64_t[total_entries];
+    DT_OMP_FOR()
+    for(size_t t = 0; t < nThreads; t++)
+    {
+      const Key *keys = hashTables[t].getKeys();
+      size_t *pos = binStart + t * nShards;
+      for(size_t j = 0; j < hashTables[t].size(); j++)
+        order[pos[shardOf(keys[j].hash)]++] = ((uint64_t)t << 32) | j;
+    }
+    delete[] binStart;
+
     int **offset_remap = new int *[nThreads];
     size_t remap_bytes = 0;
-    for(size_t i = 1; i < nThreads; i++)
-    {
-      const Key *oldKeys = hashTables[i].getKeys();
-      const Value *oldVals = hashTables[i].getValues();
-      const size_t filled = hashTables[i].size();
-      offset_remap[i] = new int[filled];
-      remap_bytes += filled * sizeof(int);
-      for(size_t j = 0; j < filled; j++)
+    for(size_t t = 0; t < nThreads; t++)
+    {
+      offset_remap[t] = new int[hashTables[t].size()];
+      remap_bytes += hashTables[t].size() * sizeof(int);
+    }
+
+    // build the shards, each one sized for all its candidate entries so that it never grows
+    shards = new HashTable[nShards];
+    DT_OMP_FOR()
+    for(size_t s = 0; s < nShards; s++)
+    {
+      shards[s].setSize(shardStart[s + 1] - shardStart[s]);
+      for(size_t n = shardStart[s]; n < shardStart[s + 1]; n++)
       {
-        Value *val = hashTables[0].lookup(oldKeys[j], true);
-        val->add(oldVals[j]);
-        offset_remap[i][j] = val - hashTables[0].getValues();
+        const size_t t = order[n] >> 32;
+        const size_t j = order[n] & 0xffffffffu;
+        Value *val = shards[s].lookup(hashTables[t].getKeys()[j], true);
+        val->add(hashTables[t].getValues()[j]);
+        offset_remap[t][j] = val - shards[s].getValues();
       }
     }
+    delete[] order;
+    delete[] shardStart;
+
+    shardBase = new size_t[nShards];
+    size_t total_bytes = 0;
+    for(size_t s = 0; s < nShards; s++)
+    {
+      shardBase[s] = nVertices;
+      nVertices += shards[s].size();
+      total_bytes += shards[s].total_alloc;
+    }
+
+    // turn the offsets within a shard into vertex indices
+    DT_OMP_FOR()
+    for(size_t t = 0; t < nThreads; t++)
+    {
+      const Key *keys = hashTables[t].getKeys();
+      for(size_t j = 0; j < hashTables[t].size(); j++)
+        offset_remap[t][j] += shardBase[shardOf(keys[j].hash)];
+    }
+
     dt_print(DT_DEBUG_MEMORY,
-      "[permutohedral] hash tables %lu bytes (%lu initially), %lu entries, [permutohedral] tables grew %lu times, "
-      "replay using %lu bytes for %lu pixels, [permutohedral] fill factor %f%%, remap using %lu bytes",
-      total_bytes, init_bytes, total_entries, total_grows,
-      (sizeof(ReplayEntry)*nData), nData, (float)100.0f * total_entries / alloc_entries, remap_bytes);
+      "[permutohedral] %lu shards using %lu bytes, %lu entries merged into %lu vertices, "
+      "replay using %lu bytes for %lu pixels, remap using %lu bytes",
+      nShards, total_bytes, total_entries, nVertices,
+      (sizeof(ReplayEntry)*nData), nData, remap_bytes);
 
     /* Rewrite the offsets in the replay structure from the above generated table. */
     DT_OMP_FOR(if(nData >= 100000))
     for(size_t i = 0; i < nData; i++)
     {
-      if(replay[i].table > 0)
-      {
-        for(int dim = 0; dim <= D; dim++)
-          replay[i].offset[dim] = offset_remap[replay[i].table][replay[i].offset[dim]];
-      }
+      for(int dim = 0; dim <= D; dim++)
+        replay[i].offset[dim] = offset_remap[replay[i].table][replay[i].offset[dim]];
     }
 
-    for(size_t i = 1; i < nThreads; i++) delete[] offset_remap[i];
+    for(size_t t = 0; t < nThreads; t++) delete[] offset_remap[t];
     delete[] offset_remap;
+    delete[] hashTables;
+    hashTables = nullptr;
+
+    // gather the values into one array indexed by vertex
+    values = new Value[nVertices];
+    ownValues = true;
+    DT_OMP_FOR()
+    for(size_t s = 0; s < nShards; s++)
+    {
+      std::copy(shards[s].getValues(), shards[s].getValues() + shards[s].size(), values + shardBase[s]);
+      shards[s].releaseValues();
+    }
   }
 
   /* Performs slicing out of position vectors. Note that the barycentric weights and the simplex
@@ -697,7 +789,7 @@ public:
    */
   void slice(float *col, size_t replay_index) const
   {
-    const Value *base = hashTables[0].getValues();
+    const Value *base = values;
     Value::clear(col);
     ReplayEntry &r = replay[replay_index];
     for(int i = 0; i <= D; i++)
@@ -710,48 +802,52 @@ public:
   void blur() const
   {
     // Prepare arrays
-    Value *newValue = new Value[hashTables[0].size()];
-    Value *oldValue = hashTables[0].getValues();
-    const Value *hashTableBase = oldValue;
-    const Key *keyBase = hashTables[0].getKeys();
+    Value *newValue = new Value[nVertices];
+    Value *oldValue = values;
     const Value zero{ 0 };
     const Value *const zeroPtr = &zero;
 
     dt_print(DT_DEBUG_MEMORY,
       "[permutohedral] blur using %lu bytes for newValue",
-      (sizeof(Value)*hashTables[0].size()));
+      (sizeof(Value)*nVertices));
 
     // For each of d+1 axes,
     for(int j = 0; j <= D; j++)
     {
       DT_OMP_FOR()
-      // For each vertex in the lattice,
-      for(size_t i = 0; i < hashTables[0].size(); i++) // blur point i in dimension j
+      // For each shard of the lattice,
+      for(size_t s = 0; s < nShards; s++)
       {
-        const Key &key = keyBase[i]; // keys to current vertex
-        // construct keys to the neighbors along the given axis.
-        Key neighbor1(key, j, +1);
-        Key neighbor2(key, j, -1);
+        const Key *keyBase = shards[s].getKeys();
+        const size_t first = shardBase[s];
+        // for each of its vertices
+        for(size_t i = 0; i < shards[s].size(); i++) // blur point i in dimension j
+        {
+          const Key &key = keyBase[i]; // keys to current vertex
+          // construct keys to the neighbors along the given axis.
+          Key neighbor1(key, j, +1);
+          Key neighbor2(key, j, -1);
 
-        const Value *oldVal = oldValue + i;
+          const Value *oldVal = oldValue + first + i;
 
-        const Value *vm1 = hashTables[0].lookup(neighbor1, false); // look up first neighbor
-        vm1 = vm1 ? vm1 - hashTableBase + oldValue : zeroPtr;
+          const Value *vm1 = lookupVertex(neighbor1); // look up first neighbor
+          vm1 = vm1 ? vm1 - values + oldValue : zeroPtr;
 
-        const Value *vp1 = hashTables[0].lookup(neighbor2, false); // look up second neighbor
-        vp1 = vp1 ? vp1 - hashTableBase + oldValue : zeroPtr;
+          const Value *vp1 = lookupVertex(neighbor2); // look up second neighbor
+          vp1 = vp1 ? vp1 - values + oldValue : zeroPtr;
 
-        // Mix values of the three vertices
-        newValue[i].mix(vm1, oldVal, vp1);
+          // Mix values of the three vertices
+          newValue[first + i].mix(vm1, oldVal, vp1);
+        }
       }
       std::swap(newValue, oldValue);
       // the freshest data is now in oldValue, and newValue is ready to be written over
     }
 
     // depending where we ended up, we may have to copy data
-    if(oldValue != hashTableBase)
+    if(oldValue != values)
     {
-      std::copy(oldValue, oldValue + hashTables[0].size(), hashTables[0].getValues());
+      std::copy(oldValue, oldValue + nVertices, values);
       delete[] oldValue;
     }
     else
@@ -760,6 +856,21 @@ public:
     }
   }
 
+private:
+  /* the shard holding a key, taken from the high bits as the low ones pick the bucket in the shard */
+  size_t shardOf(const unsigned hash) const
+  {
+    return (size_t)(((uint64_t)(hash * 2654435769u) * nShards) >> 32);
+  }
+
+  /* the vertex with the given key in the merged lattice, or nullptr */
+  Value *lookupVertex(const Key &key) const
+  {
+    const size_t s = nShards > 1 ? shardOf(key.hash) : 0;
+    const int offset = shards[s].lookupOffset(key, false);
+    return (offset < 0) ? nullptr : values + shardBase[s] + offset;
+  }
+
 private:
   size_t nData;
   size_t nThreads;
@@ -776,7 +887,15 @@ private:
     float weight[D + 1];
   } * replay;
 
-  HashTable *hashTables;
+  HashTable *hashTables; // one per splatting thread, until merged
+
+  // the merged lattice
+  HashTable *shards;
+  size_t nShards;
+  size_t *shardBase; // vertex index of the first entry of each shard
+  size_t nVertices;
+  Value *values;     // indexed by vertex
+  bool ownValues;
 };
 
 // clang-format off
@@ -66,6 +66,8 @@
 #define LSD_DENSITY_TH 0.7                  // LSD: minimal density of region points in rectangle
 #define LSD_N_BINS 1024                     // LSD: number of bins in pseudo-ordering of gradient modulus
 #define LSD_GAMMA 0.45                      // gamma correction to apply on raw images prior to line detection
+#define LSD_TILE_HEIGHT 256                 // LSD: minimal height of the strips detected in parallel
+#define LSD_TILE_OVERLAP 32                 // LSD: overlap of the strips, so lines crossing their borders are found
 #define RANSAC_RUNS 400                     // how many iterations to run in ransac
 #define RANSAC_EPSILON 2                    // starting value for ransac epsilon (in -log10 units)
 #define RANSAC_EPSILON_STEP 1               // step size of epsilon optimization (log10 units)
@@ -347,6 +349,19 @@ typedef struct dt_iop_ashift_cropfit_params_t
   float DT_ALIGNED_ARRAY edges[4][3];
 } dt_iop_ashift_cropfit_params_t;
 
+// the lines detected last, reused as long as structure detection is asked for
+// on the same preview input with the same enhancements
+typedef struct dt_iop_ashift_structure_t
+{
+  dt_hash_t hash;
+  dt_iop_ashift_line_t *lines;
+  int lines_count;
+  int vertical_count;
+  int horizontal_count;
+  float vertical_weight;
+  float horizontal_weight;
+} dt_iop_ashift_structure_t;
+
 typedef struct dt_iop_ashift_gui_data_t
 {
   GtkWidget *rotation;
@@ -404,6 +419,7 @@ typedef struct dt_iop_ashift_gui_data_t
   dt_hash_t lines_hash;
   dt_hash_t grid_hash;
   dt_hash_t buf_hash;
+  dt_iop_ashift_structure_t detected;
   dt_iop_ashift_fitaxis_t lastfit;
   float lastx;
   float lasty;
@@ -1471,6 +1487,81 @@ static void gamma_correct(const float *const in,
   }
 }
 
+// run LSD in parallel on overlapping horizontal strips of the image. each line
+// segment is kept by the strip holding its center. the result has the layout
+// of LineSegmentDetection(), the strips only depend on the image size so the
+// detected lines don't change with the number of threads
+static double *_lsd_tiled(int *lines_count,
+                          double *greyscale,
+                          const int width,
+                          const int height)
+{
+  const int tiles = MAX(height / LSD_TILE_HEIGHT, 1);
+  double **tile_lines = calloc(tiles, sizeof(double *));
+  int *tile_count = calloc(tiles, sizeof(int));
+  double *lines = NULL;
+  *lines_count = 0;
+  if(!tile_lines || !tile_count) goto finish;
+
+  DT_OMP_FOR(schedule(dynamic))
+  for(int t = 0; t < tiles; t++)
+  {
+    const int top = t * height / tiles;
+    const int bottom = (t + 1) * height / tiles;
+    const int y0 = MAX(0, top - LSD_TILE_OVERLAP);
+    const int y1 = MIN(height, bottom + LSD_TILE_OVERLAP);
+
+    int count = 0;
+    double *tl = LineSegmentDetection(&count, greyscale + (size_t)y0 * width, width, y1 - y0,
+                                      width, height,
+                                      LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
+                                      LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                      LSD_N_BINS, NULL, NULL, NULL);
+    int kept = 0;
+    for(int n = 0; n < count; n++)
+    {
+      double *l = tl + 7 * n;
+      l[1] += y0;
+      l[3] += y0;
+      const double cx = 0.5 * (l[0] + l[2]);
+      const double cy = 0.5 * (l[1] + l[3]);
+      if((t > 0 && cy < top) || (t < tiles - 1 && cy >= bottom)) continue;
+      // clip to the strip so that the parts of a line found by neighbouring strips don't overlap
+      for(int e = 0; e < 4; e += 2)
+      {
+        const double limit = (t > 0 && l[e + 1] < top) ? top
+                           : (t < tiles - 1 && l[e + 1] > bottom) ? bottom : l[e + 1];
+        if(limit == l[e + 1]) continue;
+        const double f = (limit - cy) / (l[e + 1] - cy);
+        l[e] = cx + f * (l[e] - cx);
+        l[e + 1] = limit;
+      }
+      memmove(tl + 7 * kept, l, sizeof(double) * 7);
+      kept++;
+    }
+    tile_lines[t] = tl;
+    tile_count[t] = kept;
+  }
+
+  int total = 0;
+  for(int t = 0; t < tiles; t++) total += tile_count[t];
+  lines = total > 0 ? malloc(sizeof(double) * 7 * total) : NULL;
+  if(lines)
+  {
+    for(int t = 0; t < tiles; t++)
+    {
+      memcpy(lines + 7 * *lines_count, tile_lines[t], sizeof(double) * 7 * tile_count[t]);
+      *lines_count += tile_count[t];
+    }
+  }
+
+finish:
+  for(int t = 0; tile_lines && t < tiles; t++) free(tile_lines[t]);
+  free(tile_lines);
+  free(tile_count);
+  return lines;
+}
+
 // do actual line_detection based on LSD algorithm and return results according
 // to this module's conventions
 static gboolean line_detect(float *in,
@@ -1527,10 +1618,7 @@ static gboolean line_detect(float *in,
   // it returns structural details as vector 'double lines[7 * lines_count]'
   int lines_count;
 
-  lsd_lines = LineSegmentDetection(&lines_count, greyscale, width, height,
-                                   LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
-                                   LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
-                                   LSD_N_BINS, NULL, NULL, NULL);
+  lsd_lines = _lsd_tiled(&lines_count, greyscale, width, height);
 
   // we count the lines that we really want to use
   int lct = 0;
@@ -1678,6 +1766,7 @@ static int _get_structure(dt_iop_module_t *self,
   int x_off = 0;
   int y_off = 0;
   float scale = 0.0f;
+  dt_hash_t hash = DT_INVALID_HASH;
 
   dt_iop_gui_enter_critical_section(self);
   // read buffer data if they are available
@@ -1688,6 +1777,8 @@ static int _get_structure(dt_iop_module_t *self,
     x_off = g->buf_x_off;
     y_off = g->buf_y_off;
     scale = g->buf_scale;
+    if(g->buf_hash != DT_INVALID_HASH)
+      hash = dt_hash(g->buf_hash, &enhance, sizeof(enhance));
 
     // create a temporary buffer to hold image data
     buffer = dt_alloc_align_float((size_t)4 * width * height);
@@ -1712,11 +1803,39 @@ static int _get_structure(dt_iop_module_t *self,
   float vertical_weight;
   float horizontal_weight;
 
-  // get new structural data
-  if(!line_detect(buffer, width, height, x_off, y_off, scale, &lines, &lines_count,
-                  &vertical_count, &horizontal_count, &vertical_weight, &horizontal_weight,
-                  enhance, dt_image_is_raw(&self->dev->image_storage)))
-    goto error;
+  dt_iop_ashift_structure_t *const detected = &g->detected;
+  if(hash != DT_INVALID_HASH && hash == detected->hash)
+  {
+    // same input as last time, start again from the lines detected then
+    lines = malloc(sizeof(dt_iop_ashift_line_t) * detected->lines_count);
+    if(lines == NULL) goto error;
+    memcpy(lines, detected->lines, sizeof(dt_iop_ashift_line_t) * detected->lines_count);
+    lines_count = detected->lines_count;
+    vertical_count = detected->vertical_count;
+    horizontal_count = detected->horizontal_count;
+    vertical_weight = detected->vertical_weight;
+    horizontal_weight = detected->horizontal_weight;
+  }
+  else
+  {
+    // get new structural data
+    if(!line_detect(buffer, width, height, x_off, y_off, scale, &lines, &lines_count,
+                    &vertical_count, &horizontal_count, &vertical_weight, &horizontal_weight,
+                    enhance, dt_image_is_raw(&self->dev->image_storage)))
+      goto error;
+
+    // keep an untouched copy, outlier removal and the user change the line types
+    free(detected->lines);
+    detected->lines = malloc(sizeof(dt_iop_ashift_line_t) * lines_count);
+    detected->hash = detected->lines ? hash : DT_INVALID_HASH;
+    if(detected->lines)
+      memcpy(detected->lines, lines, sizeof(dt_iop_ashift_line_t) * lines_count);
+    detected->lines_count = lines_count;
+    detected->vertical_count = vertical_count;
+    detected->horizontal_count = horizontal_count;
+    detected->vertical_weight = vertical_weight;
+    detected->horizontal_weight = horizontal_weight;
+  }
 
   // save new structural data
   g->lines_in_width = width;
@@ -5728,6 +5847,9 @@ void reload_defaults(dt_iop_module_t *self)
     free(g->lines);
     g->lines = NULL;
     g->lines_count =0;
+    free(g->detected.lines);
+    g->detected.lines = NULL;
+    g->detected.hash = DT_INVALID_HASH;
     g->horizontal_count = 0;
     g->vertical_count = 0;
     g->grid_hash = DT_INVALID_HASH;
@@ -5932,6 +6054,8 @@ void gui_init(dt_iop_module_t *self)
   g->fitting = 0;
   g->lines = NULL;
   g->lines_count = 0;
+  g->detected.lines = NULL;
+  g->detected.hash = DT_INVALID_HASH;
   g->vertical_count = 0;
   g->horizontal_count = 0;
   g->lines_version = 0;
@@ -6157,6 +6281,7 @@ void gui_cleanup(dt_iop_module_t *self)
 
   const dt_iop_ashift_gui_data_t *g = self->gui_data;
   if(g->lines) free(g->lines);
+  free(g->detected.lines);
   dt_free_align(g->buf);
   if(g->points) free(g->points);
   if(g->points_idx) free(g->points_idx);
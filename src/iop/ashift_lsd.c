@@ -1066,12 +1066,18 @@ static double log_gamma_windschitl(const double x)
 
 // clang-format on
 
-static double *inv = NULL; /* table to keep computed inverse values */
+static double *inv = NULL; /* table of inverse values */
 
+// the table is filled once here so that it is read-only while
+// LineSegmentDetection() runs on several tiles in parallel
 __attribute__((constructor)) static void invConstructor()
 {
   if(inv) return;
   inv = malloc(sizeof(double) * TABSIZE);
+  if(!inv) return;
+  inv[0] = 0.0;
+  for(int i = 1; i < TABSIZE; i++)
+    inv[i] = 1.0 / (double) i;
 }
 
 __attribute__((destructor)) static void invDestructor()
@@ -1176,13 +1182,11 @@ static double nfa(const int n, const int k, const double p, const double logNT)
            term_i / term_i-1 = (n-i+1)/i * p/(1-p)
          and
            term_i = term_i-1 * (n-i+1)/i * p/(1-p).
-         1/i is stored in a table as they are computed,
+         1/i is stored in a table,
          because divisions are expensive.
          p/(1-p) is computed only once and stored in 'p_term'.
        */
-      bin_term = (double) (n-i+1) * ( i<TABSIZE ?
-                   ( inv[i]!=0.0 ? inv[i] : ( inv[i] = 1.0 / (double) i ) ) :
-                   1.0 / (double) i );
+      bin_term = (double) (n-i+1) * ( i<TABSIZE && inv ? inv[i] : 1.0 / (double) i );
 
       mult_term = bin_term * p_term;
       term *= mult_term;
@@ -2077,10 +2081,15 @@ static int refine( struct point * reg, int * reg_size, const image_double modgra
 
 /*----------------------------------------------------------------------------*/
 /** LSD full interface.
+
+    NT_X and NT_Y are the size of the image the number of tests is based
+    on. This is the full image when img is a tile of it, so that all
+    tiles use the same detection threshold.
  */
 static
 double * LineSegmentDetection( int * n_out,
                                double * img, const int X, const int Y,
+                               const int NT_X, const int NT_Y,
                                const double scale, const double sigma_scale, const double quant,
                                const double ang_th, const double log_eps, const double density_th,
                                const int n_bins,
@@ -2148,7 +2157,7 @@ double * LineSegmentDetection( int * n_out,
      whose logarithm value is
        log10(11) + 5/2 * (log10(X) + log10(Y)).
   */
-  logNT = 5.0 * ( log10( (double) xsize ) + log10( (double) ysize ) ) / 2.0
+  logNT = 5.0 * ( log10( ceil( NT_X * scale ) ) + log10( ceil( NT_Y * scale ) ) ) / 2.0
           + log10(11.0);
   min_reg_size = (int) (-logNT/log10(p)); /* minimal number of points in region
                                              that can give a meaningful event */
@@ -55,7 +55,15 @@ typedef struct dt_iop_bilat_params_t
   float midtone; // $MIN: 0.001 $MAX: 1.0 $DEFAULT: 0.5 $DESCRIPTION: "midtone range"
 } dt_iop_bilat_params_t;
 
-typedef dt_iop_bilat_params_t dt_iop_bilat_data_t;
+typedef struct dt_iop_bilat_data_t
+{
+  dt_iop_bilat_mode_t mode;
+  float sigma_r;
+  float sigma_s;
+  float detail;
+  float midtone;
+  local_laplacian_pyramid_t pyramid; // input pyramid of the screen pipes
+} dt_iop_bilat_data_t;
 
 typedef struct dt_iop_bilat_gui_data_t
 {
@@ -301,7 +309,11 @@ void commit_params(dt_iop_module_t *self,
 {
   dt_iop_bilat_params_t *p = (dt_iop_bilat_params_t *)p1;
   dt_iop_bilat_data_t *d = piece->data;
-  *d = *p;
+  d->mode = p->mode;
+  d->sigma_r = p->sigma_r;
+  d->sigma_s = p->sigma_s;
+  d->detail = p->detail;
+  d->midtone = p->midtone;
 
 #ifdef HAVE_OPENCL
   if(d->mode == s_mode_bilateral)
@@ -325,6 +337,8 @@ void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_bilat_data_t *d = piece->data;
+  local_laplacian_pyramid_free(&d->pyramid);
   free(piece->data);
   piece->data = NULL;
 }
@@ -364,8 +378,13 @@ void process(dt_iop_module_t *self,
   }
   else // s_mode_local_laplacian
   {
+    // dragging a slider reruns the screen pipes on the same input, keep its pyramid
+    const gboolean cache = piece->pipe->type & DT_DEV_PIXELPIPE_SCREEN;
+    if(!cache) local_laplacian_pyramid_free(&d->pyramid);
     local_laplacian(i, o, roi_in->width, roi_in->height,
-                    d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+                    d->midtone, d->sigma_s, d->sigma_r, d->detail, 0,
+                    cache ? &d->pyramid : NULL,
+                    cache ? dt_dev_pixelpipe_piece_hash(piece, roi_in, FALSE) : DT_INVALID_HASH);
   }
 }
 
@@ -20,6 +20,7 @@
 
 #include "bauhaus/bauhaus.h"
 #include "common/imagebuf.h"
+#include "common/opencl.h"
 #include "control/control.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
@@ -67,6 +68,16 @@ typedef struct dt_iop_bilateral_data_t
   float sigma[5];
 } dt_iop_bilateral_data_t;
 
+typedef struct dt_iop_bilateral_global_data_t
+{
+  int kernel_init;
+  int kernel_keys;
+  int kernel_splat;
+  int kernel_blur;
+  int kernel_slice;
+  int kernel_direct;
+} dt_iop_bilateral_global_data_t;
+
 const char *name()
 {
   return _("surface blur");
@@ -294,6 +305,146 @@ void process(dt_iop_module_t *self,
   }
 }
 
+#ifdef HAVE_OPENCL
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_bilateral_data_t *data = (dt_iop_bilateral_data_t *)piece->data;
+  const dt_iop_bilateral_global_data_t *gd = (dt_iop_bilateral_global_data_t *)self->global_data;
+  const int devid = piece->pipe->devid;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const size_t npixels = (size_t)width * height;
+
+  float sigma[5];
+  _compute_sigmas(sigma, data, roi_in->scale, piece->iscale);
+  const int prad = (int)(3.0f * fmaxf(sigma[0], sigma[1]) + 1.0f);
+  const int rad = MIN(prad, MIN(width, height) - 2 * prad);
+  const gboolean thumb = piece->pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL;
+  // the entry indices of the lattice have to fit into an int
+  if(npixels > INT_MAX / 6) return DT_OPENCL_PROCESS_CL;
+
+  if(fmaxf(sigma[0], sigma[1]) < 0.1f || rad < 1 || (rad <= MAX_DIRECT_STAMP_RADIUS && thumb))
+  {
+    size_t origin[] = { 0, 0, 0 };
+    size_t region[] = { (size_t)width, (size_t)height, 1 };
+    return dt_opencl_enqueue_copy_image(devid, dev_in, dev_out, origin, origin, region);
+  }
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+  if(rad <= MAX_DIRECT_STAMP_RADIUS)
+  {
+    const int wd = 2 * rad + 1;
+    float mat[2 * (MAX_DIRECT_STAMP_RADIUS + 1) * 2 * (MAX_DIRECT_STAMP_RADIUS + 1)];
+    float weight = 0.0f;
+    for(int k = 0; k < wd * wd; k++)
+    {
+      const int l = k / wd - rad;
+      const int i = k % wd - rad;
+      weight += mat[k] = expf(-(l * l + i * i) / (2.f * sigma[0] * sigma[0]));
+    }
+    for(int k = 0; k < wd * wd; k++) mat[k] /= weight;
+
+    const dt_aligned_pixel_t isig2col = { 1.0f / (2.0f * sigma[2] * sigma[2]),
+                                          1.0f / (2.0f * sigma[3] * sigma[3]),
+                                          1.0f / (2.0f * sigma[4] * sigma[4]),
+                                          0.0f };
+    cl_mem dev_m = (cl_mem)dt_opencl_copy_host_to_device_constant(devid, sizeof(float) * wd * wd, mat);
+    if(dev_m == NULL) return err;
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_direct, width, height,
+                                           CLARG(dev_in), CLARG(dev_out), CLARG(width), CLARG(height),
+                                           CLARG(rad), CLARG(dev_m), CLARG(isig2col));
+    dt_opencl_release_mem_object(dev_m);
+    return err;
+  }
+
+  for(int k = 0; k < 5; k++) sigma[k] = 1.0f / sigma[k];
+
+  // size the hash table for the expected number of lattice points at half load,
+  // it can't grow on the device so we leave it to the CPU if it fills up
+  const size_t grid_points =
+    (height*sigma[0]) * (width*sigma[1]) * sigma[2] * sigma[3] * sigma[4];
+  const size_t entries = PermutohedralLattice<5, 4>::estimatedHashEntries(grid_points, npixels);
+  size_t tablesize = 1;
+  while(tablesize < 2 * entries) tablesize <<= 1;
+  if(tablesize > INT_MAX) return DT_OPENCL_PROCESS_CL;
+  const int size = tablesize;
+  const unsigned int mask = tablesize - 1;
+  int table_full = 0;
+
+  cl_mem dev_keys = NULL, dev_weights = NULL, dev_slots = NULL, dev_table = NULL;
+  cl_mem dev_values = NULL, dev_tmp = NULL, dev_error = NULL;
+
+  dev_keys = (cl_mem)dt_opencl_alloc_device_buffer(devid, sizeof(short) * 6 * 5 * npixels);
+  dev_weights = (cl_mem)dt_opencl_alloc_device_buffer(devid, sizeof(float) * 6 * npixels);
+  dev_slots = (cl_mem)dt_opencl_alloc_device_buffer(devid, sizeof(int) * 6 * npixels);
+  dev_table = (cl_mem)dt_opencl_alloc_device_buffer(devid, sizeof(int) * tablesize);
+  dev_values = (cl_mem)dt_opencl_alloc_device_buffer(devid, sizeof(float) * 4 * tablesize);
+  dev_tmp = (cl_mem)dt_opencl_alloc_device_buffer(devid, sizeof(float) * 4 * tablesize);
+  dev_error = (cl_mem)dt_opencl_alloc_device_buffer(devid, sizeof(int));
+  if(!dev_keys || !dev_weights || !dev_slots || !dev_table || !dev_values || !dev_tmp || !dev_error)
+    goto error;
+
+  err = dt_opencl_write_buffer_to_device(devid, &table_full, dev_error, 0, sizeof(int), CL_TRUE);
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_enqueue_kernel_1d_args(devid, gd->kernel_init, tablesize,
+                                         CLARG(dev_table), CLARG(dev_values), CLARG(size));
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_keys, width, height,
+                                         CLARG(dev_in), CLARG(dev_keys), CLARG(dev_weights),
+                                         CLARG(width), CLARG(height), CLARG(sigma[0]), CLARG(sigma[1]),
+                                         CLARG(sigma[2]), CLARG(sigma[3]), CLARG(sigma[4]));
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_splat, width, height,
+                                         CLARG(dev_in), CLARG(dev_keys), CLARG(dev_weights),
+                                         CLARG(dev_table), CLARG(dev_slots), CLARG(dev_values),
+                                         CLARG(width), CLARG(height), CLARG(mask), CLARG(dev_error));
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_read_buffer_from_device(devid, &table_full, dev_error, 0, sizeof(int), CL_TRUE);
+  if(err != CL_SUCCESS) goto error;
+  if(table_full)
+  {
+    dt_print(DT_DEBUG_OPENCL,
+             "[bilateral process_cl] lattice exceeds the hash table of %lu entries", tablesize);
+    err = DT_OPENCL_PROCESS_CL;
+    goto error;
+  }
+
+  // blur along each of the d+1 axes, ending up in dev_values again
+  for(int axis = 0; axis <= 5; axis++)
+  {
+    err = dt_opencl_enqueue_kernel_1d_args(devid, gd->kernel_blur, tablesize,
+                                           CLARG(dev_table), CLARG(dev_keys), CLARG(dev_values),
+                                           CLARG(dev_tmp), CLARG(size), CLARG(mask), CLARG(axis));
+    if(err != CL_SUCCESS) goto error;
+    std::swap(dev_values, dev_tmp);
+  }
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_slice, width, height,
+                                         CLARG(dev_out), CLARG(dev_weights), CLARG(dev_slots),
+                                         CLARG(dev_values), CLARG(width), CLARG(height));
+
+error:
+  dt_opencl_release_mem_object(dev_keys);
+  dt_opencl_release_mem_object(dev_weights);
+  dt_opencl_release_mem_object(dev_slots);
+  dt_opencl_release_mem_object(dev_table);
+  dt_opencl_release_mem_object(dev_values);
+  dt_opencl_release_mem_object(dev_tmp);
+  dt_opencl_release_mem_object(dev_error);
+  return err;
+}
+#endif
+
 void commit_params(dt_iop_module_t *self,
                    dt_iop_params_t *p1,
                    dt_dev_pixelpipe_t *pipe,
@@ -306,6 +457,11 @@ void commit_params(dt_iop_module_t *self,
   d->sigma[2] = p->red;
   d->sigma[3] = p->green;
   d->sigma[4] = p->blue;
+
+#ifdef HAVE_OPENCL
+  // the device lattice is built with atomics
+  piece->process_cl_ready = (piece->process_cl_ready && !dt_opencl_avoid_atomics(pipe->devid));
+#endif
 }
 
 void init_pipe(dt_iop_module_t *self,
@@ -335,7 +491,10 @@ void tiling_callback(dt_iop_module_t *self,
   const int prad = (int)(3.0f * fmaxf(sigma[0], sigma[1]) + 1.0f);
   const int rad = MIN(prad, MIN(roi_out->width, roi_out->height) - 2 * prad);
   if(rad <= MAX_DIRECT_STAMP_RADIUS)
+  {
     tiling->factor = 2.0f;  // direct stamp, no intermediate buffers used
+    tiling->factor_cl = 2.0f;
+  }
   else
   {
     // permutohedral needs LOTS of memory
@@ -349,6 +508,13 @@ void tiling_callback(dt_iop_module_t *self,
     size_t hash_bytes = PermutohedralLattice<5, 4>::estimatedBytes(grid_points, npixels);
     tiling->factor += (hash_bytes / (16.0f*npixels));
 
+    // the device lattice keeps keys, weights and slots of the 6 simplex vertices of
+    // each pixel (108 bytes) and a hash table at half load with two value arrays
+    const size_t entries = PermutohedralLattice<5, 4>::estimatedHashEntries(grid_points, npixels);
+    size_t tablesize = 1;
+    while(tablesize < 2 * entries) tablesize <<= 1;
+    tiling->factor_cl = 2.0f + 108.0f / 16.0f + tablesize * 36.0f / (16.0f * npixels);
+
     dt_print(DT_DEBUG_MEMORY,
              "[bilateral tiling requirements] "
              "tiling factor=%f, npixels=%lu, estimated hashbytes=%lu",
@@ -359,6 +525,34 @@ void tiling_callback(dt_iop_module_t *self,
   tiling->xalign = 1;
   tiling->yalign = 1;
   tiling->maxbuf = 1.0f;
+  tiling->maxbuf_cl = 1.0f;
+}
+
+void init_global(dt_iop_module_so_t *self)
+{
+  const int program = 44; // permutohedral.cl, from programs.conf
+  dt_iop_bilateral_global_data_t *gd =
+    (dt_iop_bilateral_global_data_t *)malloc(sizeof(dt_iop_bilateral_global_data_t));
+  self->data = gd;
+  gd->kernel_init = dt_opencl_create_kernel(program, "permutohedral_init");
+  gd->kernel_keys = dt_opencl_create_kernel(program, "permutohedral_keys");
+  gd->kernel_splat = dt_opencl_create_kernel(program, "permutohedral_splat");
+  gd->kernel_blur = dt_opencl_create_kernel(program, "permutohedral_blur");
+  gd->kernel_slice = dt_opencl_create_kernel(program, "permutohedral_slice");
+  gd->kernel_direct = dt_opencl_create_kernel(program, "bilateral_direct");
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_bilateral_global_data_t *gd = (dt_iop_bilateral_global_data_t *)self->data;
+  dt_opencl_free_kernel(gd->kernel_init);
+  dt_opencl_free_kernel(gd->kernel_keys);
+  dt_opencl_free_kernel(gd->kernel_splat);
+  dt_opencl_free_kernel(gd->kernel_blur);
+  dt_opencl_free_kernel(gd->kernel_slice);
+  dt_opencl_free_kernel(gd->kernel_direct);
+  free(self->data);
+  self->data = NULL;
 }
 
 void gui_init(dt_iop_module_t *self)
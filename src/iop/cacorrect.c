@@ -25,9 +25,11 @@
 #include "common/darktable.h"
 #include "common/imagebuf.h"
 #include "common/gaussian.h"
+#include "common/opencl.h"
 #include "develop/imageop.h"
 #include "develop/imageop_gui.h"
 #include "develop/imageop_math.h"
+#include "develop/tiling.h"
 #include "gui/accelerators.h"
 #include "gui/gtk.h"
 #include "iop/iop_api.h"
@@ -68,6 +70,18 @@ typedef struct dt_iop_cacorrect_data_t
   uint32_t iterations;
 } dt_iop_cacorrect_data_t;
 
+typedef struct dt_iop_cacorrect_global_data_t
+{
+  int kernel_cacorrect_populate;
+  int kernel_cacorrect_write_output;
+  int kernel_cacorrect_green;
+  int kernel_cacorrect_filters;
+  int kernel_cacorrect_blocks;
+  int kernel_cacorrect_correct;
+  int kernel_cacorrect_avoidshift_factors;
+  int kernel_cacorrect_avoidshift_apply;
+} dt_iop_cacorrect_global_data_t;
+
 // this returns a translatable name
 const char *name()
 {
@@ -245,6 +259,212 @@ static gboolean _LinEqSolve(ssize_t nDim, double *pfMatr, double *pfVect, double
 // end of linear equation solver
 //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 
+#define caautostrength 4.0f
+#define ts 128    // multiple of 16 for aligned buffers
+#define tsh (ts / 2)
+#define v1 (ts)
+#define v2 (2 * ts)
+#define v3 (3 * ts)
+#define v4 (4 * ts)
+#define border 8
+#define border2 (2 * border)
+#define borderh (border / 2)
+
+// robust polynomial fit of the per tile CA shifts, shared by the cpu and OpenCL code paths.
+// blockave, blocksqave and blockdenom hold the sums over all tiles with a usable shift.
+static gboolean _fit_blockshifts(float *blockwt,
+                                 float (*blockshifts)[2][2],
+                                 const int vert_tiles,
+                                 const int horiz_tiles,
+                                 float blockave[2][2],
+                                 float blocksqave[2][2],
+                                 float blockdenom[2][2],
+                                 int *fitord,
+                                 int *fitpar,
+                                 double fitparams[2][2][16])
+{
+  gboolean processpasstwo = TRUE;
+  float blockvar[2][2];
+  int polyord = *fitord;
+  int numpar = *fitpar;
+
+  for(int dir = 0; dir < 2; dir++)
+  {
+    for(int c = 0; c < 2; c++)
+    {
+      if(blockdenom[dir][c])
+        blockvar[dir][c] = blocksqave[dir][c] / blockdenom[dir][c] - sqrf(blockave[dir][c] / blockdenom[dir][c]);
+      else
+      {
+        processpasstwo = FALSE;
+        dt_print(DT_DEBUG_PIPE, "[cacorrect] blockdenom vanishes");
+        break;
+      }
+    }
+  }
+  // now prepare for CA correction pass
+  // first, fill border blocks of blockshift array
+  if(processpasstwo)
+  {
+    for(int vblock = 1; vblock < vert_tiles - 1; vblock++)
+    { // left and right sides
+      for(int c = 0; c < 2; c++)
+      {
+        for(int i = 0; i < 2; i++)
+        {
+          blockshifts[vblock * horiz_tiles][c][i] = blockshifts[(vblock)*horiz_tiles + 2][c][i];
+          blockshifts[vblock * horiz_tiles + horiz_tiles - 1][c][i] = blockshifts[(vblock)*horiz_tiles + horiz_tiles - 3][c][i];
+        }
+      }
+    }
+    for(int hblock = 0; hblock < horiz_tiles; hblock++)
+    { // top and bottom sides
+      for(int c = 0; c < 2; c++)
+      {
+        for(int i = 0; i < 2; i++)
+        {
+          blockshifts[hblock][c][i] = blockshifts[2 * horiz_tiles + hblock][c][i];
+          blockshifts[(vert_tiles - 1) * horiz_tiles + hblock][c][i] = blockshifts[(vert_tiles - 3) * horiz_tiles + hblock][c][i];
+        }
+      }
+    }
+    // end of filling border pixels of blockshift array
+    // initialize fit arrays
+    double polymat[2][2][256];
+    double shiftmat[2][2][16];
+
+    for(int i = 0; i < 256; i++)
+      polymat[0][0][i] = polymat[0][1][i] = polymat[1][0][i] = polymat[1][1][i] = 0;
+
+    for(int i = 0; i < 16; i++)
+      shiftmat[0][0][i] = shiftmat[0][1][i] = shiftmat[1][0][i] = shiftmat[1][1][i] = 0;
+
+    int numblox[2] = { 0, 0 };
+
+    for(int vblock = 1; vblock < vert_tiles - 1; vblock++)
+    {
+      for(int hblock = 1; hblock < horiz_tiles - 1; hblock++)
+      {
+        // block 3x3 median of blockshifts for robustness
+        for(int c = 0; c < 2; c++)
+        {
+          float bstemp[2];
+          for(int dir = 0; dir < 2; dir++)
+          {
+            const float p[9]  __attribute__((aligned(16))) =
+                  { blockshifts[(vblock - 1) * horiz_tiles + hblock - 1][c][dir],
+                    blockshifts[(vblock - 1) * horiz_tiles + hblock    ][c][dir],
+                    blockshifts[(vblock - 1) * horiz_tiles + hblock + 1][c][dir],
+                    blockshifts[(vblock)     * horiz_tiles + hblock - 1][c][dir],
+                    blockshifts[(vblock)     * horiz_tiles + hblock    ][c][dir],
+                    blockshifts[(vblock)     * horiz_tiles + hblock + 1][c][dir],
+                    blockshifts[(vblock + 1) * horiz_tiles + hblock - 1][c][dir],
+                    blockshifts[(vblock + 1) * horiz_tiles + hblock    ][c][dir],
+                    blockshifts[(vblock + 1) * horiz_tiles + hblock + 1][c][dir] };
+            bstemp[dir] = median9f(p);
+          }
+            // now prepare coefficient matrix; use only data points within caautostrength/2 std devs of zero
+          if(sqrf(bstemp[0]) > caautostrength * blockvar[0][c] || sqrf(bstemp[1]) > caautostrength * blockvar[1][c])
+            continue;
+
+          numblox[c]++;
+          double powVblockInit = 1.0;
+          for(int i = 0; i < polyord; i++)
+          {
+            double powHblockInit = 1.0;
+            for(int j = 0; j < polyord; j++)
+            {
+              double powVblock = powVblockInit;
+              for(int m = 0; m < polyord; m++)
+              {
+                double powHblock = powHblockInit;
+                for(int n = 0; n < polyord; n++)
+                {
+                  double inc = powVblock * powHblock * blockwt[vblock * horiz_tiles + hblock];
+                  size_t idx = numpar * (polyord * i + j) + (polyord * m + n);
+                  polymat[c][0][idx] += inc;
+                  polymat[c][1][idx] += inc;
+                  powHblock *= hblock;
+                }
+                powVblock *= vblock;
+              }
+              double blkinc = powVblockInit * powHblockInit * blockwt[vblock * horiz_tiles + hblock];
+              shiftmat[c][0][(polyord * i + j)] += blkinc * bstemp[0];
+              shiftmat[c][1][(polyord * i + j)] += blkinc * bstemp[1];
+              powHblockInit *= hblock;
+            }
+            powVblockInit *= vblock;
+          }   // monomials
+        }     // c
+      }       // blocks
+    }
+
+    numblox[1] = MIN(numblox[0], numblox[1]);
+    // if too few data points, restrict the order of the fit to linear
+    if(numblox[1] < 32)
+    {
+      polyord = 2;
+      numpar = 4;
+
+      if(numblox[1] < 10)
+      {
+        dt_print(DT_DEBUG_PIPE, "[cacorrect] restrict fit to linear, numblox = %d ", numblox[1]);
+        processpasstwo = FALSE;
+      }
+    }
+
+    if(processpasstwo)
+    {
+      // fit parameters to blockshifts
+      for(int c = 0; c < 2; c++)
+        for(int dir = 0; dir < 2; dir++)
+        {
+          if(!_LinEqSolve(numpar, polymat[c][dir], shiftmat[c][dir], fitparams[c][dir]))
+          {
+            dt_print(DT_DEBUG_PIPE,
+                   "[cacorrect] can't solve linear equations for colour %d direction %d", c, dir);
+            processpasstwo = FALSE;
+          }
+        }
+    }
+  }
+  // fitparams[polyord*i+j] gives the coefficients of (vblock^i hblock^j) in a polynomial fit for i,j<=4
+
+  *fitord = polyord;
+  *fitpar = numpar;
+  return processpasstwo;
+}
+
+// CA shift of a block from the polynomial fit, as lblockshifts[colour][dir]
+static void _eval_blockshifts(double fitparams[2][2][16],
+                              const int polyord,
+                              const int vblock,
+                              const int hblock,
+                              float lblockshifts[2][2])
+{
+  lblockshifts[0][0] = lblockshifts[0][1] = 0;
+  lblockshifts[1][0] = lblockshifts[1][1] = 0;
+  float powVblock = 1.0f;
+  for(int i = 0; i < polyord; i++)
+  {
+    float powHblock = powVblock;
+    for(int j = 0; j < polyord; j++)
+    {
+      lblockshifts[0][0] += powHblock * fitparams[0][0][polyord * i + j];
+      lblockshifts[0][1] += powHblock * fitparams[0][1][polyord * i + j];
+      lblockshifts[1][0] += powHblock * fitparams[1][0][polyord * i + j];
+      lblockshifts[1][1] += powHblock * fitparams[1][1][polyord * i + j];
+      powHblock *= hblock;
+    }
+    powVblock *= vblock;
+  }
+  const float bslim = 3.99f; // max allowed CA shift
+  lblockshifts[0][0] = CLAMPF(lblockshifts[0][0], -bslim, bslim);
+  lblockshifts[0][1] = CLAMPF(lblockshifts[0][1], -bslim, bslim);
+  lblockshifts[1][0] = CLAMPF(lblockshifts[1][0], -bslim, bslim);
+  lblockshifts[1][1] = CLAMPF(lblockshifts[1][1], -bslim, bslim);
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -300,16 +520,6 @@ void process(dt_iop_module_t *self,
 
   const float *const in = out;
 
-  #define caautostrength 4.0f
-  #define ts 128    // multiple of 16 for aligned buffers
-  #define tsh (ts / 2)
-  #define v1 (ts)
-  #define v2 (2 * ts)
-  #define v3 (3 * ts)
-  #define v4 (4 * ts)
-  #define border 8
-  #define border2 (2 * border)
-  #define borderh (border / 2)
 
   // multithreaded and partly vectorized by Ingo Weyrich
 
@@ -360,7 +570,6 @@ void process(dt_iop_module_t *self,
   float blockave[2][2] = { { 0, 0 }, { 0, 0 } };
   float blocksqave[2][2] = { { 0, 0 }, { 0, 0 } };
   float blockdenom[2][2] = { { 0, 0 }, { 0, 0 } };
-  float blockvar[2][2];
   // order of 2d polynomial fit (polyord), and numpar=polyord^2
   int polyord = 4;
   int numpar = 16;
@@ -689,147 +898,9 @@ void process(dt_iop_module_t *self,
 
       DT_OMP_PRAGMA(single)
       {
-        for(int dir = 0; dir < 2; dir++)
-        {
-          for(int c = 0; c < 2; c++)
-          {
-            if(blockdenom[dir][c])
-              blockvar[dir][c] = blocksqave[dir][c] / blockdenom[dir][c] - sqrf(blockave[dir][c] / blockdenom[dir][c]);
-            else
-            {
-              processpasstwo = FALSE;
-              dt_print(DT_DEBUG_PIPE, "[cacorrect] blockdenom vanishes");
-              break;
-            }
-          }
-        }
-        // now prepare for CA correction pass
-        // first, fill border blocks of blockshift array
-        if(processpasstwo)
-        {
-          for(int vblock = 1; vblock < vert_tiles - 1; vblock++)
-          { // left and right sides
-            for(int c = 0; c < 2; c++)
-            {
-              for(int i = 0; i < 2; i++)
-              {
-                blockshifts[vblock * horiz_tiles][c][i] = blockshifts[(vblock)*horiz_tiles + 2][c][i];
-                blockshifts[vblock * horiz_tiles + horiz_tiles - 1][c][i] = blockshifts[(vblock)*horiz_tiles + horiz_tiles - 3][c][i];
-              }
-            }
-          }
-          for(int hblock = 0; hblock < horiz_tiles; hblock++)
-          { // top and bottom sides
-            for(int c = 0; c < 2; c++)
-            {
-              for(int i = 0; i < 2; i++)
-              {
-                blockshifts[hblock][c][i] = blockshifts[2 * horiz_tiles + hblock][c][i];
-                blockshifts[(vert_tiles - 1) * horiz_tiles + hblock][c][i] = blockshifts[(vert_tiles - 3) * horiz_tiles + hblock][c][i];
-              }
-            }
-          }
-          // end of filling border pixels of blockshift array
-          // initialize fit arrays
-          double polymat[2][2][256];
-          double shiftmat[2][2][16];
-
-          for(int i = 0; i < 256; i++)
-            polymat[0][0][i] = polymat[0][1][i] = polymat[1][0][i] = polymat[1][1][i] = 0;
-
-          for(int i = 0; i < 16; i++)
-            shiftmat[0][0][i] = shiftmat[0][1][i] = shiftmat[1][0][i] = shiftmat[1][1][i] = 0;
-
-          int numblox[2] = { 0, 0 };
-
-          for(int vblock = 1; vblock < vert_tiles - 1; vblock++)
-          {
-            for(int hblock = 1; hblock < horiz_tiles - 1; hblock++)
-            {
-              // block 3x3 median of blockshifts for robustness
-              for(int c = 0; c < 2; c++)
-              {
-                float bstemp[2];
-                for(int dir = 0; dir < 2; dir++)
-                {
-                  const float p[9]  __attribute__((aligned(16))) =
-                        { blockshifts[(vblock - 1) * horiz_tiles + hblock - 1][c][dir],
-                          blockshifts[(vblock - 1) * horiz_tiles + hblock    ][c][dir],
-                          blockshifts[(vblock - 1) * horiz_tiles + hblock + 1][c][dir],
-                          blockshifts[(vblock)     * horiz_tiles + hblock - 1][c][dir],
-                          blockshifts[(vblock)     * horiz_tiles + hblock    ][c][dir],
-                          blockshifts[(vblock)     * horiz_tiles + hblock + 1][c][dir],
-                          blockshifts[(vblock + 1) * horiz_tiles + hblock - 1][c][dir],
-                          blockshifts[(vblock + 1) * horiz_tiles + hblock    ][c][dir],
-                          blockshifts[(vblock + 1) * horiz_tiles + hblock + 1][c][dir] };
-                  bstemp[dir] = median9f(p);
-                }
-                  // now prepare coefficient matrix; use only data points within caautostrength/2 std devs of zero
-                if(sqrf(bstemp[0]) > caautostrength * blockvar[0][c] || sqrf(bstemp[1]) > caautostrength * blockvar[1][c])
-                  continue;
-
-                numblox[c]++;
-                double powVblockInit = 1.0;
-                for(int i = 0; i < polyord; i++)
-                {
-                  double powHblockInit = 1.0;
-                  for(int j = 0; j < polyord; j++)
-                  {
-                    double powVblock = powVblockInit;
-                    for(int m = 0; m < polyord; m++)
-                    {
-                      double powHblock = powHblockInit;
-                      for(int n = 0; n < polyord; n++)
-                      {
-                        double inc = powVblock * powHblock * blockwt[vblock * horiz_tiles + hblock];
-                        size_t idx = numpar * (polyord * i + j) + (polyord * m + n);
-                        polymat[c][0][idx] += inc;
-                        polymat[c][1][idx] += inc;
-                        powHblock *= hblock;
-                      }
-                      powVblock *= vblock;
-                    }
-                    double blkinc = powVblockInit * powHblockInit * blockwt[vblock * horiz_tiles + hblock];
-                    shiftmat[c][0][(polyord * i + j)] += blkinc * bstemp[0];
-                    shiftmat[c][1][(polyord * i + j)] += blkinc * bstemp[1];
-                    powHblockInit *= hblock;
-                  }
-                  powVblockInit *= vblock;
-                }   // monomials
-              }     // c
-            }       // blocks
-          }
-
-          numblox[1] = MIN(numblox[0], numblox[1]);
-          // if too few data points, restrict the order of the fit to linear
-          if(numblox[1] < 32)
-          {
-            polyord = 2;
-            numpar = 4;
-
-            if(numblox[1] < 10)
-            {
-              dt_print(DT_DEBUG_PIPE, "[cacorrect] restrict fit to linear, numblox = %d ", numblox[1]);
-              processpasstwo = FALSE;
-            }
-          }
-
-          if(processpasstwo)
-          {
-            // fit parameters to blockshifts
-            for(int c = 0; c < 2; c++)
-              for(int dir = 0; dir < 2; dir++)
-              {
-                if(!_LinEqSolve(numpar, polymat[c][dir], shiftmat[c][dir], fitparams[c][dir]))
-                {
-                  dt_print(DT_DEBUG_PIPE,
-                         "[cacorrect] can't solve linear equations for colour %d direction %d", c, dir);
-                  processpasstwo = FALSE;
-                }
-              }
-          }
-        }
-        // fitparams[polyord*i+j] gives the coefficients of (vblock^i hblock^j) in a polynomial fit for i,j<=4
+        processpasstwo = _fit_blockshifts(blockwt, blockshifts, vert_tiles, horiz_tiles,
+                                          blockave, blocksqave, blockdenom,
+                                          &polyord, &numpar, fitparams);
       }
       // end of initialization for CA correction pass
       // only executed if cared and cablue are zero
@@ -961,31 +1032,8 @@ void process(dt_iop_module_t *self,
                 }
             }
             // end of border fill
-            {
-              // CA auto correction; use CA diagnostic pass to set shift parameters
-              lblockshifts[0][0] = lblockshifts[0][1] = 0;
-              lblockshifts[1][0] = lblockshifts[1][1] = 0;
-              float powVblock = 1.0f;
-              for(int i = 0; i < polyord; i++)
-              {
-                float powHblock = powVblock;
-                for(int j = 0; j < polyord; j++)
-                {
-                  // printf("i= %d j= %d polycoeff= %f ",i,j,fitparams[0][0][polyord*i+j]);
-                  lblockshifts[0][0] += powHblock * fitparams[0][0][polyord * i + j];
-                  lblockshifts[0][1] += powHblock * fitparams[0][1][polyord * i + j];
-                  lblockshifts[1][0] += powHblock * fitparams[1][0][polyord * i + j];
-                  lblockshifts[1][1] += powHblock * fitparams[1][1][polyord * i + j];
-                  powHblock *= hblock;
-                }
-                powVblock *= vblock;
-              }
-              const float bslim = 3.99f; // max allowed CA shift
-              lblockshifts[0][0] = CLAMPF(lblockshifts[0][0], -bslim, bslim);
-              lblockshifts[0][1] = CLAMPF(lblockshifts[0][1], -bslim, bslim);
-              lblockshifts[1][0] = CLAMPF(lblockshifts[1][0], -bslim, bslim);
-              lblockshifts[1][1] = CLAMPF(lblockshifts[1][1], -bslim, bslim);
-            } // end of setting CA shift parameters
+            // CA auto correction; use CA diagnostic pass to set shift parameters
+            _eval_blockshifts(fitparams, polyord, vblock, hblock, lblockshifts);
 
             for(int c = 0; c < 3; c += 2)
             {
@@ -1215,6 +1263,265 @@ DT_OMP_PRAGMA(barrier)
 /*==================================================================================
  * end raw therapee code
  *==================================================================================*/
+
+#ifdef HAVE_OPENCL
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_cacorrect_data_t *d = piece->data;
+  dt_iop_cacorrect_global_data_t *gd = self->global_data;
+
+  const int devid = piece->pipe->devid;
+  const uint32_t filters = piece->pipe->dsc.filters;
+  const gboolean run_fast = piece->pipe->type & DT_DEV_PIXELPIPE_FAST;
+  // see process(), no colorshift avoiding for the preview
+  const gboolean avoidshift = d->avoidshift && !(piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW);
+  const int iterations = d->iterations;
+
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+  const int h_width = (width + 1) / 2;
+  const int h_height = (height + 1) / 2;
+  const size_t bsize = sizeof(float) * width * height;
+  const size_t h_bsize = sizeof(float) * h_width * height;
+  const size_t q_bsize = sizeof(float) * h_width * h_height;
+
+  // the tiles of process() without their overlap, the kernels work on these blocks
+  const int blocks_v = (height + border + ts - border2 - 1) / (ts - border2);
+  const int blocks_h = (width + border + ts - border2 - 1) / (ts - border2);
+  const int nblocks = blocks_v * blocks_h;
+
+  // the tile arrays of process() including the padding rows and columns
+  const int vz1 = (height + border2) % (ts - border2) == 0 ? 1 : 0;
+  const int hz1 = (width + border2) % (ts - border2) == 0 ? 1 : 0;
+  const int vert_tiles = ceilf((float)(height + border2) / (ts - border2) + 2 + vz1);
+  const int horiz_tiles = ceilf((float)(width + border2) / (ts - border2) + 2 + hz1);
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem dev_raw = NULL;
+  cl_mem dev_tmp = NULL;
+  cl_mem dev_green = NULL;
+  cl_mem dev_oldraw = NULL;
+  cl_mem dev_red = NULL;
+  cl_mem dev_blue = NULL;
+  cl_mem dev_blockwt = NULL;
+  cl_mem dev_blockshifts = NULL;
+  cl_mem dev_shifts = NULL;
+  cl_mem dev_filter[6] = { NULL };
+  dt_gaussian_cl_t *red = NULL;
+  dt_gaussian_cl_t *blue = NULL;
+
+  float *blockwt = dt_calloc_align_float(5 * vert_tiles * horiz_tiles);
+  float *bwt = dt_alloc_align_float(nblocks);
+  float *bshifts = dt_alloc_align_float(4 * nblocks);
+  float *lshifts = dt_alloc_align_float(4 * nblocks);
+  if(!blockwt || !bwt || !bshifts || !lshifts) goto finish;
+
+  float (*blockshifts)[2][2] = (float(*)[2][2])(blockwt + vert_tiles * horiz_tiles);
+
+  const float scaler = dt_iop_get_processed_maximum(piece);
+  const float iscaler = 1.0f / scaler;
+
+  dev_raw = dt_opencl_alloc_device_buffer(devid, bsize);
+  if(dev_raw == NULL) goto finish;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_cacorrect_populate, width, height,
+          CLARG(dev_in), CLARG(dev_raw), CLARG(width), CLARG(height), CLARG(iscaler));
+  if(err != CL_SUCCESS) goto finish;
+
+  if(run_fast) goto writeout;
+
+  err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  dev_tmp = dt_opencl_alloc_device_buffer(devid, bsize);
+  dev_green = dt_opencl_alloc_device_buffer(devid, bsize);
+  dev_blockwt = dt_opencl_alloc_device_buffer(devid, sizeof(float) * nblocks);
+  dev_blockshifts = dt_opencl_alloc_device_buffer(devid, sizeof(float) * 4 * nblocks);
+  dev_shifts = dt_opencl_alloc_device_buffer(devid, sizeof(float) * 4 * nblocks);
+  if(!dev_tmp || !dev_green || !dev_blockwt || !dev_blockshifts || !dev_shifts) goto finish;
+  for(int k = 0; k < 6; k++)
+  {
+    dev_filter[k] = dt_opencl_alloc_device_buffer(devid, h_bsize);
+    if(dev_filter[k] == NULL) goto finish;
+  }
+
+  if(avoidshift)
+  {
+    dev_oldraw = dt_opencl_alloc_device_buffer(devid, bsize);
+    if(dev_oldraw == NULL) goto finish;
+    // keep raw values before ca correction
+    err = dt_opencl_enqueue_copy_buffer_to_buffer(devid, dev_raw, dev_oldraw, 0, 0, bsize);
+    if(err != CL_SUCCESS) goto finish;
+  }
+
+  gboolean processpasstwo = TRUE;
+  double fitparams[2][2][16];
+  int polyord = 4;
+  int numpar = 16;
+
+  for(int it = 0; it < iterations && processpasstwo; it++)
+  {
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_cacorrect_green, width, height,
+            CLARG(dev_raw), CLARG(dev_green), CLARG(width), CLARG(height), CLARG(filters));
+    if(err != CL_SUCCESS) goto finish;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_cacorrect_filters, width, height,
+            CLARG(dev_raw), CLARG(dev_green),
+            CLARG(dev_filter[0]), CLARG(dev_filter[1]), CLARG(dev_filter[2]),
+            CLARG(dev_filter[3]), CLARG(dev_filter[4]), CLARG(dev_filter[5]),
+            CLARG(width), CLARG(height), CLARG(filters));
+    if(err != CL_SUCCESS) goto finish;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_cacorrect_blocks, blocks_h, blocks_v,
+            CLARG(dev_raw), CLARG(dev_green),
+            CLARG(dev_filter[0]), CLARG(dev_filter[1]), CLARG(dev_filter[2]),
+            CLARG(dev_filter[3]), CLARG(dev_filter[4]), CLARG(dev_filter[5]),
+            CLARG(dev_blockwt), CLARG(dev_blockshifts),
+            CLARG(width), CLARG(height), CLARG(filters), CLARG(blocks_h), CLARG(blocks_v));
+    if(err != CL_SUCCESS) goto finish;
+
+    err = dt_opencl_read_buffer_from_device(devid, bwt, dev_blockwt, 0, sizeof(float) * nblocks, CL_TRUE);
+    if(err != CL_SUCCESS) goto finish;
+    err = dt_opencl_read_buffer_from_device(devid, bshifts, dev_blockshifts, 0, sizeof(float) * 4 * nblocks, CL_TRUE);
+    if(err != CL_SUCCESS) goto finish;
+
+    // the fit is small and sequential, do it on the host like process() does
+    float blockave[2][2] = { { 0, 0 }, { 0, 0 } };
+    float blocksqave[2][2] = { { 0, 0 }, { 0, 0 } };
+    float blockdenom[2][2] = { { 0, 0 }, { 0, 0 } };
+    for(int by = 0; by < blocks_v; by++)
+    {
+      for(int bx = 0; bx < blocks_h; bx++)
+      {
+        const int b = by * blocks_h + bx;
+        const int tile = (by + 1) * horiz_tiles + bx + 1;
+        blockwt[tile] = bwt[b];
+        for(int c = 0; c < 2; c++)
+        {
+          for(int dir = 0; dir < 2; dir++)
+          {
+            const float shift = bshifts[4 * b + 2 * c + dir];
+            if(fabsf(shift) < 2.0f)
+            {
+              blockave[dir][c] += shift;
+              blocksqave[dir][c] += sqrf(shift);
+              blockdenom[dir][c] += 1;
+            }
+            blockshifts[tile][c][dir] = shift;
+          }
+        }
+      }
+    }
+
+    processpasstwo = _fit_blockshifts(blockwt, blockshifts, vert_tiles, horiz_tiles,
+                                      blockave, blocksqave, blockdenom,
+                                      &polyord, &numpar, fitparams);
+    if(!processpasstwo) break;
+
+    for(int by = 0; by < blocks_v; by++)
+    {
+      for(int bx = 0; bx < blocks_h; bx++)
+      {
+        float lblockshifts[2][2];
+        _eval_blockshifts(fitparams, polyord, by + 1, bx + 1, lblockshifts);
+        memcpy(lshifts + 4 * (by * blocks_h + bx), lblockshifts, sizeof(lblockshifts));
+      }
+    }
+    err = dt_opencl_write_buffer_to_device(devid, lshifts, dev_shifts, 0, sizeof(float) * 4 * nblocks, CL_TRUE);
+    if(err != CL_SUCCESS) goto finish;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_cacorrect_correct, width, height,
+            CLARG(dev_raw), CLARG(dev_green), CLARG(dev_tmp), CLARG(dev_shifts),
+            CLARG(width), CLARG(height), CLARG(filters), CLARG(blocks_h));
+    if(err != CL_SUCCESS) goto finish;
+
+    cl_mem swap = dev_raw;
+    dev_raw = dev_tmp;
+    dev_tmp = swap;
+  }
+
+  if(avoidshift && processpasstwo)
+  {
+    err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    dev_red = dt_opencl_alloc_device_buffer(devid, q_bsize);
+    dev_blue = dt_opencl_alloc_device_buffer(devid, q_bsize);
+    if(dev_red == NULL || dev_blue == NULL) goto finish;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_cacorrect_avoidshift_factors, h_width, h_height,
+            CLARG(dev_oldraw), CLARG(dev_raw), CLARG(dev_red), CLARG(dev_blue),
+            CLARG(width), CLARG(height), CLARG(filters));
+    if(err != CL_SUCCESS) goto finish;
+
+    // blur correction factors
+    float valmax[] = { 10.0f };
+    float valmin[] = { 0.1f };
+    err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    red = dt_gaussian_init_cl(devid, h_width, h_height, 1, valmax, valmin, 30.0f, 0);
+    blue = dt_gaussian_init_cl(devid, h_width, h_height, 1, valmax, valmin, 30.0f, 0);
+    if(red == NULL || blue == NULL) goto finish;
+
+    err = dt_gaussian_blur_cl_buffer(red, dev_red, dev_red);
+    if(err != CL_SUCCESS) goto finish;
+    err = dt_gaussian_blur_cl_buffer(blue, dev_blue, dev_blue);
+    if(err != CL_SUCCESS) goto finish;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_cacorrect_avoidshift_apply, width, height,
+            CLARG(dev_raw), CLARG(dev_red), CLARG(dev_blue),
+            CLARG(width), CLARG(height), CLARG(filters));
+    if(err != CL_SUCCESS) goto finish;
+  }
+
+writeout:
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_cacorrect_write_output, roi_out->width, roi_out->height,
+          CLARG(dev_raw), CLARG(dev_out), CLARG(width), CLARG(height),
+          CLARG(roi_out->width), CLARG(roi_out->height), CLARG(roi_out->x), CLARG(roi_out->y),
+          CLARG(scaler));
+
+finish:
+  if(red) dt_gaussian_free_cl(red);
+  if(blue) dt_gaussian_free_cl(blue);
+  dt_opencl_release_mem_object(dev_raw);
+  dt_opencl_release_mem_object(dev_tmp);
+  dt_opencl_release_mem_object(dev_green);
+  dt_opencl_release_mem_object(dev_oldraw);
+  dt_opencl_release_mem_object(dev_red);
+  dt_opencl_release_mem_object(dev_blue);
+  dt_opencl_release_mem_object(dev_blockwt);
+  dt_opencl_release_mem_object(dev_blockshifts);
+  dt_opencl_release_mem_object(dev_shifts);
+  for(int k = 0; k < 6; k++)
+    dt_opencl_release_mem_object(dev_filter[k]);
+  dt_free_align(blockwt);
+  dt_free_align(bwt);
+  dt_free_align(bshifts);
+  dt_free_align(lshifts);
+  return err;
+}
+#endif
+
+void tiling_callback(dt_iop_module_t *self,
+                     dt_dev_pixelpipe_iop_t *piece,
+                     const dt_iop_roi_t *roi_in,
+                     const dt_iop_roi_t *roi_out,
+                     dt_develop_tiling_t *tiling)
+{
+  dt_iop_cacorrect_data_t *d = piece->data;
+
+  // cpu: in, out plus the full size out, Gtmp and RawDataTmp buffers
+  // OpenCL: in, out plus raw, tmp and green buffers and six half width filter planes
+  // colorshift avoiding adds the uncorrected raw data and two quarter size factor planes
+  tiling->factor = 4.5f + (d->avoidshift ? 1.0f : 0.0f);
+  tiling->factor_cl = 8.0f + (d->avoidshift ? 2.0f : 0.0f);
+  tiling->maxbuf = 1.0f;
+  tiling->maxbuf_cl = 1.0f;
+  tiling->overhead = 0;
+  tiling->overlap = 0;
+  tiling->xalign = 2;
+  tiling->yalign = 2;
+}
 void modify_roi_out(dt_iop_module_t *self,
                     dt_dev_pixelpipe_iop_t *piece,
                     dt_iop_roi_t *roi_out,
@@ -1281,6 +1588,36 @@ void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelp
   piece->data = NULL;
 }
 
+void init_global(dt_iop_module_so_t *self)
+{
+  const int program = 40; // cacorrect.cl, from programs.conf
+  dt_iop_cacorrect_global_data_t *gd = malloc(sizeof(dt_iop_cacorrect_global_data_t));
+  self->data = gd;
+  gd->kernel_cacorrect_populate = dt_opencl_create_kernel(program, "cacorrect_populate");
+  gd->kernel_cacorrect_write_output = dt_opencl_create_kernel(program, "cacorrect_write_output");
+  gd->kernel_cacorrect_green = dt_opencl_create_kernel(program, "cacorrect_green");
+  gd->kernel_cacorrect_filters = dt_opencl_create_kernel(program, "cacorrect_filters");
+  gd->kernel_cacorrect_blocks = dt_opencl_create_kernel(program, "cacorrect_blocks");
+  gd->kernel_cacorrect_correct = dt_opencl_create_kernel(program, "cacorrect_correct");
+  gd->kernel_cacorrect_avoidshift_factors = dt_opencl_create_kernel(program, "cacorrect_avoidshift_factors");
+  gd->kernel_cacorrect_avoidshift_apply = dt_opencl_create_kernel(program, "cacorrect_avoidshift_apply");
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_cacorrect_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_cacorrect_populate);
+  dt_opencl_free_kernel(gd->kernel_cacorrect_write_output);
+  dt_opencl_free_kernel(gd->kernel_cacorrect_green);
+  dt_opencl_free_kernel(gd->kernel_cacorrect_filters);
+  dt_opencl_free_kernel(gd->kernel_cacorrect_blocks);
+  dt_opencl_free_kernel(gd->kernel_cacorrect_correct);
+  dt_opencl_free_kernel(gd->kernel_cacorrect_avoidshift_factors);
+  dt_opencl_free_kernel(gd->kernel_cacorrect_avoidshift_apply);
+  free(self->data);
+  self->data = NULL;
+}
+
 void gui_update(dt_iop_module_t *self)
 {
   dt_iop_cacorrect_gui_data_t *g = self->gui_data;
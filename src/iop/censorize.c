@@ -106,28 +106,20 @@ dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
 static inline void make_noise(float *const output,
                               const float noise,
                               const size_t width,
-                              const size_t height)
+                              const size_t height,
+                              const dt_iop_roi_t *const roi)
 {
   DT_OMP_FOR(collapse(2))
   for(size_t i = 0; i < height; i++)
     for(size_t j = 0; j < width; j++)
     {
-      // Init random number generator
-      uint32_t DT_ALIGNED_ARRAY state[4] = { splitmix32(j + 1),
-                                             splitmix32((j + 1) * (i + 3)),
-                                             splitmix32(1337),
-                                             splitmix32(666) };
-      xoshiro128plus(state);
-      xoshiro128plus(state);
-      xoshiro128plus(state);
-      xoshiro128plus(state);
-
       const size_t index = (i * width + j) * 4;
       float *const restrict pix_out = DT_IS_ALIGNED_PIXEL(output + index);
       const float norm = pix_out[1];
 
-      // create statistical noise
-      const float epsilon = gaussian_noise(norm, noise * norm, i % 2 || j % 2, state) / norm;
+      // create statistical noise, seeded by the absolute pixel coordinates
+      const float epsilon = dt_noise_generator(DT_NOISE_GAUSSIAN, roi->x + j, roi->y + i, 1337,
+                                               norm, noise * norm) / norm;
 
       // add noise to output
       for(size_t c = 0; c < 3; c++) pix_out[c] = fmaxf(pix_out[c] * epsilon, 0.f);
@@ -254,7 +246,7 @@ void process(dt_iop_module_t *self,
     output = out;
 
     if(noise != 0.f)
-      make_noise(output, noise, width, height);
+      make_noise(output, noise, width, height, roi_in);
 
     dt_gaussian_t *g = dt_gaussian_init(width, height, ch, RGBmax, RGBmin, sigma_2, 0);
     if(!g) return;
@@ -268,7 +260,7 @@ void process(dt_iop_module_t *self,
   }
 
   if(noise != 0.f)
-    make_noise(output, noise, width, height);
+    make_noise(output, noise, width, height, roi_in);
 
   dt_free_align(temp);
 }
@@ -40,6 +40,7 @@
 
 #include "bauhaus/bauhaus.h"
 #include "chart/common.h"
+#include "develop/analysis.h"
 #include "develop/imageop_gui.h"
 #include "dtgtk/drawingarea.h"
 #include "common/chromatic_adaptation.h"
@@ -2175,12 +2176,30 @@ void process(dt_iop_module_t *self,
       if(piece->pipe->type & DT_DEV_PIXELPIPE_FULL)
       {
         // detection on full image only
+        // the pipe is rerun after the detection, don't detect twice on the same input
+        dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi_in, FALSE);
+        hash = dt_hash(hash, &data->illuminant_type, sizeof(data->illuminant_type));
+        hash = dt_hash(hash, RGB_to_XYZ, sizeof(dt_colormatrix_t));
+        float xy[2];
+        const gboolean cached = dt_dev_analysis_get(hash, xy, sizeof(xy));
+
         dt_iop_gui_enter_critical_section(self);
-        // compute "AI" white balance.  We can use our output buffer
-        // as scratch space since we will be overwriting it afterwards
-        // anyway
-        _auto_detect_WB(in, out, data->illuminant_type, roi_in->width, roi_in->height,
-                        ch, RGB_to_XYZ, g->XYZ);
+        if(cached)
+        {
+          g->XYZ[0] = xy[0];
+          g->XYZ[1] = xy[1];
+        }
+        else
+        {
+          // compute "AI" white balance.  We can use our output buffer
+          // as scratch space since we will be overwriting it afterwards
+          // anyway
+          _auto_detect_WB(in, out, data->illuminant_type, roi_in->width, roi_in->height,
+                          ch, RGB_to_XYZ, g->XYZ);
+          xy[0] = g->XYZ[0];
+          xy[1] = g->XYZ[1];
+          dt_dev_analysis_set(hash, xy, sizeof(xy));
+        }
         dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, self->iop_order);
         dt_iop_gui_leave_critical_section(self);
       }
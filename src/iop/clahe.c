@@ -19,11 +19,14 @@
 #include "bauhaus/bauhaus.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
+#include "common/imagebuf.h"
 #include "common/math.h"
+#include "common/opencl.h"
 #include "control/control.h"
 #include "common/dttypes.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
+#include "develop/tiling.h"
 #include "dtgtk/resetlabel.h"
 #include "gui/gtk.h"
 #include "iop/iop_api.h"
@@ -55,6 +58,15 @@ typedef struct dt_iop_rlce_data_t
   double slope;
 } dt_iop_rlce_data_t;
 
+typedef struct dt_iop_rlce_global_data_t
+{
+  int kernel_clahe_zero;
+  int kernel_clahe_bins;
+  int kernel_clahe_histogram;
+  int kernel_clahe_mapping;
+  int kernel_clahe_apply;
+} dt_iop_rlce_global_data_t;
+
 
 const char *name()
 {
@@ -83,6 +95,106 @@ dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
   return IOP_CS_RGB;
 }
 
+#define BINS (256)
+
+// distance of the tile centers, also bounding the memory used for the mappings
+static inline int _tile_step(const int rad)
+{
+  return MAX(rad, 8);
+}
+
+static inline int _tile_center(const int t, const int step, const int size)
+{
+  return MIN(t * step, size - 1);
+}
+
+static inline int _tile_count(const int step, const int size)
+{
+  return (size - 1 + step - 1) / step + 1;
+}
+
+/* clip the histogram of a window of n pixels, redistribute the clipped
+   entries and turn it into the contrast-limited mapping of each bin */
+static void _tile_mapping(int *const restrict hist,
+                          const int n,
+                          const float slope,
+                          float *const restrict map)
+{
+  const int limit = (int)(slope * n / BINS + 0.5f);
+
+  int ce = 0, ceb = 0;
+  do
+  {
+    ceb = ce;
+    ce = 0;
+    for(int b = 0; b <= BINS; b++)
+    {
+      const int d = hist[b] - limit;
+      if(d > 0)
+      {
+        ce += d;
+        hist[b] = limit;
+      }
+    }
+
+    const int d = (ce / (float)(BINS + 1));
+    const int m = ce % (BINS + 1);
+    for(int b = 0; b <= BINS; b++) hist[b] += d;
+
+    if(m != 0)
+    {
+      const int s = BINS / (float)m;
+      for(int b = 0; b <= BINS; b += s) ++hist[b];
+    }
+  } while(ce != ceb);
+
+  /* build cdf of clipped histogram */
+  int hMin = BINS;
+  for(int b = 0; b < hMin; b++)
+    if(hist[b] != 0) hMin = b;
+
+  int cdfMax = 0;
+  for(int b = hMin; b <= BINS; b++)
+    cdfMax += hist[b];
+
+  const int cdfMin = hist[hMin];
+  const float norm = cdfMax > cdfMin ? 1.0f / (cdfMax - cdfMin) : 0.0f;
+
+  int cdf = 0;
+  for(int b = 0; b <= BINS; b++)
+  {
+    if(b >= hMin) cdf += hist[b];
+    map[b] = b < hMin ? 0.0f : (cdf - cdfMin) * norm;
+  }
+}
+
+void tiling_callback(dt_iop_module_t *self,
+                     dt_dev_pixelpipe_iop_t *piece,
+                     const dt_iop_roi_t *roi_in,
+                     const dt_iop_roi_t *roi_out,
+                     dt_develop_tiling_t *tiling)
+{
+  dt_iop_rlce_data_t *data = piece->data;
+  const int rad = data->radius * roi_in->scale / piece->iscale;
+  const int step = _tile_step(rad);
+
+  // the bins of all pixels plus histogram and mapping of every tile
+  const float tiles = 2.0f * (BINS + 1) * sizeof(float) / ((float)step * step);
+  tiling->factor = 2.0f + (sizeof(uint16_t) + tiles) / (4.0f * sizeof(float));
+  tiling->factor_cl = 2.0f + (sizeof(int) + tiles) / (4.0f * sizeof(float));
+  tiling->maxbuf = 1.0f;
+  tiling->maxbuf_cl = 1.0f;
+  tiling->overhead = 0;
+  tiling->overlap = 0;
+  tiling->xalign = 1;
+  tiling->yalign = 1;
+}
+
+/* contrast limited adaptive histogram equalization of the HSL lightness:
+   the clipped histogram of the (2 * rad + 1)^2 window around each tile
+   center gives a mapping of the lightness there, each pixel gets the
+   bilinear interpolation of the mappings of the four surrounding tile
+   centers. */
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -92,162 +204,164 @@ void process(dt_iop_module_t *self,
 {
   dt_iop_rlce_data_t *data = piece->data;
   const int ch = piece->colors;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
 
-  // PASS1: Get a luminance map of image...
-  float *luminance = malloc(sizeof(float) * ((size_t)roi_out->width * roi_out->height));
+  // Params
+  const int rad = data->radius * roi_in->scale / piece->iscale;
+  const float slope = data->slope;
 
+  const int step = _tile_step(rad);
+  const int ntx = _tile_count(step, width);
+  const int nty = _tile_count(step, height);
+
+  uint16_t *const restrict bins = dt_alloc_align_type(uint16_t, (size_t)width * height);
+  float *const restrict maps = dt_alloc_align_float((size_t)ntx * nty * (BINS + 1));
+  if(!bins || !maps)
+  {
+    dt_iop_image_copy_by_size(ovoid, ivoid, width, height, ch);
+    dt_free_align(bins);
+    dt_free_align(maps);
+    return;
+  }
+
+  // PASS1: Get a luminance map of image...
   DT_OMP_FOR()
-  for(int j = 0; j < roi_out->height; j++)
+  for(int j = 0; j < height; j++)
   {
-    float *in = (float *)ivoid + (size_t)j * roi_out->width * ch;
-    float *lm = luminance + (size_t)j * roi_out->width;
-    for(int i = 0; i < roi_out->width; i++)
+    const float *in = (const float *)ivoid + (size_t)j * width * ch;
+    uint16_t *lm = bins + (size_t)j * width;
+    for(int i = 0; i < width; i++)
     {
       const float pmax = CLIP(max3f(in)); // Max value in RGB set
       const float pmin = CLIP(min3f(in)); // Min value in RGB set
-      *lm = (pmax + pmin) / 2.f;    // Pixel luminosity
+      *lm = ROUND_POSISTIVE((pmax + pmin) / 2.f * (float)BINS); // Pixel luminosity
       in += ch;
       lm++;
     }
   }
 
+  // PASS2: contrast limited mapping at each tile center
+  DT_OMP_FOR(collapse(2))
+  for(int ty = 0; ty < nty; ty++)
+    for(int tx = 0; tx < ntx; tx++)
+    {
+      const int cx = _tile_center(tx, step, width);
+      const int cy = _tile_center(ty, step, height);
+      const int xMin = MAX(0, cx - rad);
+      const int xMax = MIN(width, cx + rad + 1);
+      const int yMin = MAX(0, cy - rad);
+      const int yMax = MIN(height, cy + rad + 1);
+
+      int hist[BINS + 1] = { 0 };
+      for(int yi = yMin; yi < yMax; yi++)
+        for(int xi = xMin; xi < xMax; xi++)
+          ++hist[bins[(size_t)yi * width + xi]];
+
+      _tile_mapping(hist, (xMax - xMin) * (yMax - yMin), slope,
+                    maps + ((size_t)ty * ntx + tx) * (BINS + 1));
+    }
 
-  // Params
-  const int rad = data->radius * roi_in->scale / piece->iscale;
-
-#define BINS (256)
-
-  const float slope = data->slope;
-
-  size_t destbuf_size;
-  float *const restrict dest_buf = dt_alloc_perthread_float(roi_out->width, &destbuf_size);
-
-// CLAHE
+  // PASS3: interpolate the new lightness and apply it
   DT_OMP_FOR()
-  for(int j = 0; j < roi_out->height; j++)
+  for(int j = 0; j < height; j++)
   {
-    const int yMin = fmax(0, j - rad);
-    const int yMax = fmin(roi_in->height, j + rad + 1);
-    const int h = yMax - yMin;
-
-    const int xMin0 = fmax(0, 0 - rad);
-    const int xMax0 = fmin(roi_in->width - 1, rad);
-
-    int hist[BINS + 1];
-    int clippedhist[BINS + 1];
-
-    float *dest = dt_get_perthread(dest_buf, destbuf_size);
-
-    /* initially fill histogram */
-    memset(hist, 0, sizeof(int) * (BINS + 1));
-    for(int yi = yMin; yi < yMax; ++yi)
-      for(int xi = xMin0; xi < xMax0; ++xi)
-        ++hist[ROUND_POSISTIVE(luminance[(size_t)yi * roi_in->width + xi] * (float)BINS)];
-
-    // Destination row
-    memset(dest, 0, sizeof(float) * roi_out->width);
-    float *ld = dest;
-
-    for(int i = 0; i < roi_out->width; i++)
+    const int ty0 = j / step;
+    const int ty1 = MIN(ty0 + 1, nty - 1);
+    const int cy0 = _tile_center(ty0, step, height);
+    const int cy1 = _tile_center(ty1, step, height);
+    const float fy = cy1 > cy0 ? (float)(j - cy0) / (cy1 - cy0) : 0.0f;
+
+    const float *in = (const float *)ivoid + (size_t)j * width * ch;
+    float *out = (float *)ovoid + (size_t)j * width * ch;
+    for(int i = 0; i < width; i++)
     {
+      const int tx0 = i / step;
+      const int tx1 = MIN(tx0 + 1, ntx - 1);
+      const int cx0 = _tile_center(tx0, step, width);
+      const int cx1 = _tile_center(tx1, step, width);
+      const float fx = cx1 > cx0 ? (float)(i - cx0) / (cx1 - cx0) : 0.0f;
+
+      const int v = bins[(size_t)j * width + i];
+      const float *m = maps + v;
+      const float l0 = (1.0f - fx) * m[((size_t)ty0 * ntx + tx0) * (BINS + 1)]
+                              + fx * m[((size_t)ty0 * ntx + tx1) * (BINS + 1)];
+      const float l1 = (1.0f - fx) * m[((size_t)ty1 * ntx + tx0) * (BINS + 1)]
+                              + fx * m[((size_t)ty1 * ntx + tx1) * (BINS + 1)];
 
-      int v = ROUND_POSISTIVE(luminance[(size_t)j * roi_in->width + i] * (float)BINS);
-
-      const int xMin = fmax(0, i - rad);
-      const int xMax = i + rad + 1;
-      const int w = fmin(roi_in->width, xMax) - xMin;
-      const int n = h * w;
-
-      const int limit = (int)(slope * n / BINS + 0.5f);
-
-      /* remove left behind values from histogram */
-      if(xMin > 0)
-      {
-        const int xMin1 = xMin - 1;
-        for(int yi = yMin; yi < yMax; ++yi)
-          --hist[ROUND_POSISTIVE
-                 (luminance[(size_t)yi * roi_in->width + xMin1] * (float)BINS)];
-      }
-
-      /* add newly included values to histogram */
-      if(xMax <= roi_in->width)
-      {
-        const int xMax1 = xMax - 1;
-        for(int yi = yMin; yi < yMax; ++yi)
-          ++hist[ROUND_POSISTIVE
-                 (luminance[(size_t)yi * roi_in->width + xMax1] * (float)BINS)];
-      }
-
-      /* clip histogram and redistribute clipped entries */
-      memcpy(clippedhist, hist, sizeof(int) * (BINS + 1));
-      int ce = 0, ceb = 0;
-      do
-      {
-        ceb = ce;
-        ce = 0;
-        for(int b = 0; b <= BINS; b++)
-        {
-          const int d = clippedhist[b] - limit;
-          if(d > 0)
-          {
-            ce += d;
-            clippedhist[b] = limit;
-          }
-        }
-
-        const int d = (ce / (float)(BINS + 1));
-        const int m = ce % (BINS + 1);
-        for(int b = 0; b <= BINS; b++) clippedhist[b] += d;
-
-        if(m != 0)
-        {
-          const int s = BINS / (float)m;
-          for(int b = 0; b <= BINS; b += s) ++clippedhist[b];
-        }
-      } while(ce != ceb);
-
-      /* build cdf of clipped histogram */
-      unsigned int hMin = BINS;
-      for(int b = 0; b < hMin; b++)
-        if(clippedhist[b] != 0) hMin = b;
-
-      int cdf = 0;
-      for(int b = hMin; b <= v; b++)
-        cdf += clippedhist[b];
-
-      int cdfMax = cdf;
-      for(int b = v + 1; b <= BINS; b++)
-        cdfMax += clippedhist[b];
-
-      const int cdfMin = clippedhist[hMin];
-
-      *ld = (cdf - cdfMin) / (float)(cdfMax - cdfMin);
-
-      ld++;
-    }
-
-    // Apply row
-    float *in = ((float *)ivoid) + (size_t)j * roi_out->width * ch;
-    float *out = ((float *)ovoid) + (size_t)j * roi_out->width * ch;
-    for(int r = 0; r < roi_out->width; r++)
-    {
       float H, S, L;
       rgb2hsl(in, &H, &S, &L);
-      // hsl2rgb(out,H,S,( L / dest[r] ) * (L-lsmin) + lsmin );
-      hsl2rgb(out, H, S, dest[r]);
+      hsl2rgb(out, H, S, (1.0f - fy) * l0 + fy * l1);
       out += ch;
       in += ch;
-      ld++;
     }
   }
 
-  dt_free_align(dest_buf);
+  dt_free_align(bins);
+  dt_free_align(maps);
+}
 
-  // Cleanup
-  free(luminance);
+#ifdef HAVE_OPENCL
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_rlce_data_t *data = piece->data;
+  const dt_iop_rlce_global_data_t *gd = self->global_data;
+  const int devid = piece->pipe->devid;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
 
-#undef BINS
+  const int rad = data->radius * roi_in->scale / piece->iscale;
+  const float slope = data->slope;
+
+  const int step = _tile_step(rad);
+  const int ntx = _tile_count(step, width);
+  const int nty = _tile_count(step, height);
+  const int ntiles = ntx * nty;
+  const int nhist = ntiles * (BINS + 1);
+  const size_t tilesize = sizeof(float) * nhist;
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem dev_bins = dt_opencl_alloc_device_buffer(devid, sizeof(int) * width * height);
+  cl_mem dev_hist = dt_opencl_alloc_device_buffer(devid, tilesize);
+  cl_mem dev_maps = dt_opencl_alloc_device_buffer(devid, tilesize);
+  if(!dev_bins || !dev_hist || !dev_maps) goto error;
+
+  err = dt_opencl_enqueue_kernel_1d_args(devid, gd->kernel_clahe_zero, nhist,
+                                         CLARG(dev_hist), CLARG(nhist));
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_clahe_bins, width, height,
+                                         CLARG(dev_in), CLARG(dev_bins), CLARG(width), CLARG(height));
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_clahe_histogram, width, height,
+                                         CLARG(dev_bins), CLARG(dev_hist), CLARG(width), CLARG(height),
+                                         CLARG(rad), CLARG(step), CLARG(ntx), CLARG(nty));
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_clahe_mapping, ntx, nty,
+                                         CLARG(dev_hist), CLARG(dev_maps), CLARG(width), CLARG(height),
+                                         CLARG(rad), CLARG(step), CLARG(ntx), CLARG(nty), CLARG(slope));
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_clahe_apply, width, height,
+                                         CLARG(dev_in), CLARG(dev_out), CLARG(dev_bins), CLARG(dev_maps),
+                                         CLARG(width), CLARG(height), CLARG(step), CLARG(ntx), CLARG(nty));
+
+error:
+  dt_opencl_release_mem_object(dev_bins);
+  dt_opencl_release_mem_object(dev_hist);
+  dt_opencl_release_mem_object(dev_maps);
+  return err;
 }
+#endif
+
+#undef BINS
 
 static void radius_callback(GtkWidget *slider,
                             dt_iop_module_t *self)
@@ -279,6 +393,10 @@ void commit_params(dt_iop_module_t *self,
 
   d->radius = p->radius;
   d->slope = p->slope;
+
+#ifdef HAVE_OPENCL
+  piece->process_cl_ready = (piece->process_cl_ready && !dt_opencl_avoid_atomics(pipe->devid));
+#endif
 }
 
 void init_pipe(dt_iop_module_t *self,
@@ -296,6 +414,30 @@ void cleanup_pipe(dt_iop_module_t *self,
   piece->data = NULL;
 }
 
+void init_global(dt_iop_module_so_t *self)
+{
+  const int program = 45; // clahe.cl, from programs.conf
+  dt_iop_rlce_global_data_t *gd = malloc(sizeof(dt_iop_rlce_global_data_t));
+  self->data = gd;
+  gd->kernel_clahe_zero = dt_opencl_create_kernel(program, "clahe_zero");
+  gd->kernel_clahe_bins = dt_opencl_create_kernel(program, "clahe_bins");
+  gd->kernel_clahe_histogram = dt_opencl_create_kernel(program, "clahe_histogram");
+  gd->kernel_clahe_mapping = dt_opencl_create_kernel(program, "clahe_mapping");
+  gd->kernel_clahe_apply = dt_opencl_create_kernel(program, "clahe_apply");
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_rlce_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_clahe_zero);
+  dt_opencl_free_kernel(gd->kernel_clahe_bins);
+  dt_opencl_free_kernel(gd->kernel_clahe_histogram);
+  dt_opencl_free_kernel(gd->kernel_clahe_mapping);
+  dt_opencl_free_kernel(gd->kernel_clahe_apply);
+  free(self->data);
+  self->data = NULL;
+}
+
 void gui_update(dt_iop_module_t *self)
 {
   dt_iop_rlce_gui_data_t *g = self->gui_data;
@@ -54,6 +54,8 @@
 #define DT_IOP_COLOR_ICC_LEN 512
 
 #define LUT_SAMPLES 0x10000
+// nodes per axis of the table replacing the lcms2 transform of profiles without a matrix
+#define CLUT_SIZE 33
 
 DT_MODULE_INTROSPECTION(7, dt_iop_colorin_params_t)
 
@@ -91,6 +93,7 @@ typedef struct dt_iop_colorin_global_data_t
 {
   int kernel_colorin_unbound;
   int kernel_colorin_clipping;
+  int kernel_colorin_clut;
 } dt_iop_colorin_global_data_t;
 
 typedef struct dt_iop_colorin_data_t
@@ -101,6 +104,7 @@ typedef struct dt_iop_colorin_data_t
   cmsHTRANSFORM *xform_cam_Lab;
   cmsHTRANSFORM *xform_cam_nrgb;
   cmsHTRANSFORM *xform_nrgb_Lab;
+  float *clut; // CLUT_SIZE^3 camera RGB -> XYZ samples of the lcms2 transforms, or NULL
   float lut[3][LUT_SAMPLES];
   dt_colormatrix_t cmatrix;
   dt_colormatrix_t nmatrix;
@@ -478,6 +482,7 @@ void init_global(dt_iop_module_so_t *self)
   self->data = gd;
   gd->kernel_colorin_unbound = dt_opencl_create_kernel(program, "colorin_unbound");
   gd->kernel_colorin_clipping = dt_opencl_create_kernel(program, "colorin_clipping");
+  gd->kernel_colorin_clut = dt_opencl_create_kernel(program, "colorin_clut");
 }
 
 void cleanup_global(dt_iop_module_so_t *self)
@@ -485,6 +490,7 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_iop_colorin_global_data_t *gd = self->data;
   dt_opencl_free_kernel(gd->kernel_colorin_unbound);
   dt_opencl_free_kernel(gd->kernel_colorin_clipping);
+  dt_opencl_free_kernel(gd->kernel_colorin_clut);
   free(self->data);
   self->data = NULL;
 }
@@ -673,6 +679,26 @@ int process_cl(dt_iop_module_t *self,
       pipe->dsc.temperature.coeffs[1], coeffs[1],
       pipe->dsc.temperature.coeffs[2], coeffs[2]);
 
+  if(d->clut)
+  {
+    cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    const int size = CLUT_SIZE;
+    cl_mem dev_clut = NULL;
+    cl_mem dev_corr = dt_opencl_copy_host_to_device_constant(devid, sizeof(float) * 4, coeffs);
+    if(dev_corr == NULL) goto clut_error;
+    dev_clut = dt_opencl_copy_host_to_device_constant
+      (devid, sizeof(float) * 4 * CLUT_SIZE * CLUT_SIZE * CLUT_SIZE, d->clut);
+    if(dev_clut == NULL) goto clut_error;
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_colorin_clut, width, height,
+                                           CLARG(dev_in), CLARG(dev_out),
+                                           CLARG(width), CLARG(height),
+                                           CLARG(dev_clut), CLARG(size), CLARG(dev_corr));
+clut_error:
+    dt_opencl_release_mem_object(dev_clut);
+    dt_opencl_release_mem_object(dev_corr);
+    return err;
+  }
+
   cl_mem dev_m = NULL, dev_l = NULL, dev_r = NULL;
   cl_mem dev_g = NULL, dev_b = NULL, dev_coeffs = NULL;
   cl_mem dev_corr = NULL;
@@ -1095,6 +1121,27 @@ static void process_cmatrix(dt_iop_module_t *self,
   }
 }
 
+static void _lcms2_transform(const dt_iop_colorin_data_t *const d,
+                             const float *const in,
+                             float *const out,
+                             const size_t npixels)
+{
+  // convert to (L,a/L,b/L) to be able to change L without changing saturation.
+  if(!d->nrgb)
+  {
+    cmsDoTransform(d->xform_cam_Lab, in, out, npixels);
+  }
+  else
+  {
+    cmsDoTransform(d->xform_cam_nrgb, in, out, npixels);
+
+    for(size_t j = 0; j < npixels; j++)
+      dt_vector_clip(&out[4*j]);
+
+    cmsDoTransform(d->xform_nrgb_Lab, out, out, npixels);
+  }
+}
+
 // legacy processing (IOP versions 1 and 2, 2014 and earlier)
 static void process_lcms2_bm(dt_iop_module_t *self,
                              dt_dev_pixelpipe_iop_t *piece,
@@ -1119,20 +1166,7 @@ static void process_lcms2_bm(dt_iop_module_t *self,
       _apply_blue_mapping(in + 4*j, out + 4*j);
     }
 
-    // convert to (L,a/L,b/L) to be able to change L without changing saturation.
-    if(!d->nrgb)
-    {
-      cmsDoTransform(d->xform_cam_Lab, out, out, width);
-    }
-    else
-    {
-      cmsDoTransform(d->xform_cam_nrgb, out, out, width);
-
-      for(int j = 0; j < width; j++)
-        dt_vector_clip(&out[4*j]);
-
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, width);
-    }
+    _lcms2_transform(d, out, out, width);
   }
 }
 
@@ -1165,20 +1199,97 @@ static void process_lcms2_proper(dt_iop_module_t *self,
     }
 
     float *out = (float *)ovoid + (size_t)4 * k * width;
+    _lcms2_transform(d, in, out, width);
+  }
+  dt_free_align(scratchlines);
+}
 
-    // convert to (L,a/L,b/L) to be able to change L without changing saturation.
-    if(!d->nrgb)
+static inline gboolean _clut_covers(const dt_aligned_pixel_t pixel)
+{
+  return pixel[0] >= 0.0f && pixel[0] <= 1.0f
+      && pixel[1] >= 0.0f && pixel[1] <= 1.0f
+      && pixel[2] >= 0.0f && pixel[2] <= 1.0f;
+}
+
+// tetrahedral interpolation in the camera RGB -> XYZ table
+static inline void _clut_lookup(const float *const restrict clut,
+                                const dt_aligned_pixel_t pixel,
+                                dt_aligned_pixel_t XYZ)
+{
+  const size_t stride[3] = { 4, 4 * CLUT_SIZE, 4 * CLUT_SIZE * CLUT_SIZE };
+  float f[3];
+  size_t base = 0;
+  for_each_channel(c)
+  {
+    const float v = CLAMPF(pixel[c], 0.0f, 1.0f) * (CLUT_SIZE - 1);
+    const int i = MIN((int)v, CLUT_SIZE - 2);
+    f[c] = v - i;
+    base += i * stride[c];
+  }
+
+  // walk from the lower to the upper corner along the axes sorted by falling fraction
+  int a = 0, b = 1, c = 2;
+  if(f[a] < f[b]) { const int t = a; a = b; b = t; }
+  if(f[b] < f[c]) { const int t = b; b = c; c = t; }
+  if(f[a] < f[b]) { const int t = a; a = b; b = t; }
+
+  const float *const c0 = clut + base;
+  const float *const c1 = c0 + stride[a];
+  const float *const c2 = c1 + stride[b];
+  const float *const c3 = c2 + stride[c];
+  for_each_channel(k)
+    XYZ[k] = (1.0f - f[a]) * c0[k] + (f[a] - f[b]) * c1[k] + (f[b] - f[c]) * c2[k] + f[c] * c3[k];
+}
+
+// table lookup replacing process_lcms2_proper(), pixels outside of the
+// sampled cube still go through lcms2 to keep them unclipped
+static void process_clut(dt_iop_module_t *self,
+                         dt_dev_pixelpipe_iop_t *piece,
+                         const void *const ivoid,
+                         void *const ovoid,
+                         const dt_iop_roi_t *const roi_in,
+                         const dt_iop_roi_t *const roi_out,
+                         const dt_aligned_pixel_t corr)
+{
+  const dt_iop_colorin_data_t *const d = piece->data;
+  const size_t height = roi_out->height;
+  const size_t width = roi_out->width;
+  size_t padded_size;
+  float *const restrict scratchlines = dt_alloc_perthread_float(4 * width, &padded_size);
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < height; k++)
+  {
+    const float *const restrict in = (const float *)ivoid + (size_t)4 * k * width;
+    float *const restrict out = (float *)ovoid + (size_t)4 * k * width;
+    float *const restrict outside = dt_get_perthread(scratchlines, padded_size);
+
+    size_t noutside = 0;
+    for(size_t j = 0; j < width; j++)
     {
-      cmsDoTransform(d->xform_cam_Lab, in, out, width);
+      dt_aligned_pixel_t pixel, XYZ;
+      dt_vector_mul(pixel, &in[4*j], corr);
+      if(_clut_covers(pixel))
+      {
+        _clut_lookup(d->clut, pixel, XYZ);
+        dt_XYZ_to_Lab(XYZ, &out[4*j]);
+        out[4*j+3] = pixel[3];
+      }
+      else
+        copy_pixel(&outside[4 * noutside++], pixel);
     }
-    else
-    {
-      cmsDoTransform(d->xform_cam_nrgb, in, out, width);
-
-      for(int j = 0; j < width; j++)
-        dt_vector_clip(&out[4*j]);
 
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, width);
+    if(noutside)
+    {
+      _lcms2_transform(d, outside, outside, noutside);
+      size_t n = 0;
+      for(size_t j = 0; j < width; j++)
+      {
+        dt_aligned_pixel_t pixel;
+        dt_vector_mul(pixel, &in[4*j], corr);
+        if(!_clut_covers(pixel))
+          copy_pixel(&out[4*j], &outside[4 * n++]);
+      }
     }
   }
   dt_free_align(scratchlines);
@@ -1238,6 +1349,10 @@ void process(dt_iop_module_t *self,
     {
       process_lcms2_bm(self, piece, ivoid, ovoid, roi_in, roi_out);
     }
+    else if(d->clut)
+    {
+      process_clut(self, piece, ivoid, ovoid, roi_in, roi_out, coeffs);
+    }
     else
     {
       process_lcms2_proper(self, piece, ivoid, ovoid, roi_in, roi_out, coeffs);
@@ -1245,6 +1360,40 @@ void process(dt_iop_module_t *self,
   }
 }
 
+// sample the lcms2 transforms on a regular grid over the camera RGB cube.
+// the table holds XYZ rather than Lab as it interpolates much better near black.
+static float *_build_clut(const dt_iop_colorin_data_t *const d)
+{
+  const size_t plane = (size_t)CLUT_SIZE * CLUT_SIZE;
+  float *const clut = dt_alloc_align_float(4 * plane * CLUT_SIZE);
+  if(!clut) return NULL;
+
+  DT_OMP_FOR()
+  for(size_t b = 0; b < CLUT_SIZE; b++)
+  {
+    float *const node = clut + 4 * plane * b;
+    for(size_t g = 0; g < CLUT_SIZE; g++)
+      for(size_t r = 0; r < CLUT_SIZE; r++)
+      {
+        float *const px = node + 4 * (g * CLUT_SIZE + r);
+        px[0] = (float)r / (CLUT_SIZE - 1);
+        px[1] = (float)g / (CLUT_SIZE - 1);
+        px[2] = (float)b / (CLUT_SIZE - 1);
+        px[3] = 0.0f;
+      }
+
+    _lcms2_transform(d, node, node, plane);
+
+    for(size_t k = 0; k < plane; k++)
+    {
+      dt_aligned_pixel_t XYZ;
+      dt_Lab_to_XYZ(node + 4 * k, XYZ);
+      copy_pixel(node + 4 * k, XYZ);
+    }
+  }
+  return clut;
+}
+
 void commit_params(dt_iop_module_t *self,
                    dt_iop_params_t *p1,
                    dt_dev_pixelpipe_t *pipe,
@@ -1309,6 +1458,8 @@ void commit_params(dt_iop_module_t *self,
     cmsDeleteTransform(d->xform_nrgb_Lab);
     d->xform_nrgb_Lab = NULL;
   }
+  dt_free_align(d->clut);
+  d->clut = NULL;
 
   dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
   dt_mark_colormatrix_invalid(&d->nmatrix[0][0]);
@@ -1534,6 +1685,16 @@ void commit_params(dt_iop_module_t *self,
     }
   }
 
+  // profiles without a usable matrix: replace the per-pixel lcms2 calls by
+  // a table lookup, this also makes them available to OpenCL
+  if(d->xform_cam_Lab
+     && cmsGetColorSpace(d->input) == cmsSigRgbData
+     && !(d->blue_mapping && dt_image_is_matrix_correction_supported(&pipe->image)))
+  {
+    d->clut = _build_clut(d);
+    if(d->clut) piece->process_cl_ready = TRUE;
+  }
+
   d->nonlinearlut = FALSE;
 
   // now try to initialize unbounded mode:
@@ -1576,6 +1737,7 @@ void init_pipe(dt_iop_module_t *self,
   d->xform_cam_Lab = NULL;
   d->xform_cam_nrgb = NULL;
   d->xform_nrgb_Lab = NULL;
+  d->clut = NULL;
 }
 
 void cleanup_pipe(dt_iop_module_t *self,
@@ -1599,6 +1761,7 @@ void cleanup_pipe(dt_iop_module_t *self,
     cmsDeleteTransform(d->xform_nrgb_Lab);
     d->xform_nrgb_Lab = NULL;
   }
+  dt_free_align(d->clut);
 
   free(piece->data);
   piece->data = NULL;
@@ -120,6 +120,11 @@ typedef struct dt_iop_colorzones_data_t
   int curve_type[DT_IOP_COLORZONES_MAX_CHANNELS];  // curve style (e.g. CUBIC_SPLINE)
   dt_iop_colorzones_channel_t channel;
   float lut[3][DT_IOP_COLORZONES_LUT_RES];
+  // the curves baked into the final transform: the lightness multiplier
+  // and the chroma scaled rotation of the hue shift
+  float lut_L[DT_IOP_COLORZONES_LUT_RES];
+  float lut_cos[DT_IOP_COLORZONES_LUT_RES];
+  float lut_sin[DT_IOP_COLORZONES_LUT_RES];
   int mode;
 } dt_iop_colorzones_data_t;
 
@@ -512,7 +517,7 @@ void process_v1(dt_iop_module_t *self,
     }
     select = CLAMP(select, 0.f, 1.f);
 
-    LCh[0] *= powf(2.0f, 4.0f * (lookup(d->lut[0], select) - .5f));
+    LCh[0] *= lookup(d->lut_L, select);
     LCh[1] *= 2.f * lookup(d->lut[1], select);
     LCh[2] += lookup(d->lut[2], select) - .5f;
 
@@ -531,39 +536,52 @@ void process_v3(dt_iop_module_t *self,
 {
   const dt_iop_colorzones_data_t *d = piece->data;
   const int ch = piece->colors;
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+
+  /* the hue shift is applied as a rotation of (a, b):
+       cos(2pi(h + hm)) * C = a * cos(2pi hm) - b * sin(2pi hm)
+       sin(2pi(h + hm)) * C = a * sin(2pi hm) + b * cos(2pi hm)
+     so selecting by lightness or chroma only needs the baked luts */
+  if(d->channel != DT_IOP_COLORZONES_h)
+  {
+    const gboolean by_L = d->channel == DT_IOP_COLORZONES_L;
+    DT_OMP_FOR()
+    for(size_t k = 0; k < npixels; k++)
+    {
+      const float *in = (const float *)ivoid + ch * k;
+      float *out = (float *)ovoid + ch * k;
+      const float a = in[1], b = in[2];
+      const float select = by_L ? fminf(1.0f, in[0] / 100.0f)
+                                : fminf(1.0f, sqrtf(b * b + a * a) / 128.0f);
+      const float rc = lookup(d->lut_cos, select);
+      const float rs = lookup(d->lut_sin, select);
+      out[0] = in[0] * lookup(d->lut_L, select);
+      out[1] = a * rc - b * rs;
+      out[2] = a * rs + b * rc;
+      out[3] = in[3];
+    }
+    return;
+  }
+
   DT_OMP_FOR()
-  for(size_t k = 0; k < (size_t)roi_out->width * roi_out->height; k++)
+  for(size_t k = 0; k < npixels; k++)
   {
-    float *in = (float *)ivoid + ch * k;
+    const float *in = (const float *)ivoid + ch * k;
     float *out = (float *)ovoid + ch * k;
     const float a = in[1], b = in[2];
-    const float h = fmodf(atan2f(b, a) + 2.0f * M_PI_F, 2.0f * M_PI_F) / (2.0f * M_PI_F);
+    const float select = fmodf(atan2f(b, a) + 2.0f * M_PI_F, 2.0f * M_PI_F) / (2.0f * M_PI_F);
     const float C = sqrtf(b * b + a * a);
-    float select = 0.0f;
-    float blend = 0.0f;
-    switch(d->channel)
-    {
-      case DT_IOP_COLORZONES_L:
-        select = fminf(1.0f, in[0] / 100.0f);
-        break;
-      case DT_IOP_COLORZONES_C:
-        select = fminf(1.0f, C / 128.0f);
-        break;
-      default:
-      case DT_IOP_COLORZONES_h:
-        select = h;
-        blend = powf(1.0f - C / 128.0f, 2.0f);
-        break;
-    }
+    float blend = sqf(1.0f - C / 128.0f);
     const float Lm = (blend * .5f + (1.0f - blend) * lookup(d->lut[0], select)) - .5f;
     const float hm = (blend * .5f + (1.0f - blend) * lookup(d->lut[2], select)) - .5f;
     blend *= blend; // saturation isn't as prone to artifacts:
     // const float Cm = 2.0 * (blend*.5f + (1.0f-blend)*lookup(d->lut[1], select));
     const float Cm = 2.0f * lookup(d->lut[1], select);
-    const float L = in[0] * powf(2.0f, 4.0f * Lm);
-    out[0] = L;
-    out[1] = cosf(2.0f * M_PI_F * (h + hm)) * Cm * C;
-    out[2] = sinf(2.0f * M_PI_F * (h + hm)) * Cm * C;
+    const float rc = cosf(2.0f * M_PI_F * hm) * Cm;
+    const float rs = sinf(2.0f * M_PI_F * hm) * Cm;
+    out[0] = in[0] * exp2f(4.0f * Lm);
+    out[1] = a * rc - b * rs;
+    out[2] = a * rs + b * rc;
     out[3] = in[3];
   }
 }
@@ -2898,6 +2916,17 @@ void commit_params(dt_iop_module_t *self,
                                    p->channel == DT_IOP_COLORZONES_h);
     }
   }
+
+  // bake the transcendental part of the transform, see process_v1() and process_v3()
+  DT_OMP_FOR()
+  for(int k = 0; k < DT_IOP_COLORZONES_LUT_RES; k++)
+  {
+    const float Cm = 2.0f * d->lut[1][k];
+    const float hm = d->lut[2][k] - .5f;
+    d->lut_L[k] = exp2f(4.0f * (d->lut[0][k] - .5f));
+    d->lut_cos[k] = cosf(2.0f * M_PI_F * hm) * Cm;
+    d->lut_sin[k] = sinf(2.0f * M_PI_F * hm) * Cm;
+  }
 }
 
 void init_pipe(dt_iop_module_t *self,
@@ -201,6 +201,7 @@ typedef struct dt_iop_demosaic_global_data_t
   int kernel_ppg_green;
   int kernel_ppg_redblue;
   int kernel_zoom_half_size;
+  int kernel_zoom_half_size_raw;
   int kernel_border_interpolate;
   int kernel_color_smoothing;
   int kernel_zoom_passthrough_monochrome;
@@ -267,6 +268,15 @@ typedef struct dt_iop_demosaic_data_t
   int cs_iter;
   float cs_center;
   gboolean cs_enabled;
+  // capture sharpening sigma index map, kept while roi and parameters don't change
+  unsigned char *cs_gauss_idx;
+  dt_hash_t cs_gauss_hash;
+#ifdef HAVE_OPENCL
+  cl_mem cs_dev_gauss_idx;
+  cl_mem cs_dev_gcoeffs;
+  int cs_devid;
+  dt_hash_t cs_dev_hash;
+#endif
 } dt_iop_demosaic_data_t;
 
 static gboolean _get_thumb_quality(const int width, const int height)
@@ -295,6 +305,17 @@ static gboolean _demosaic_full(const dt_dev_pixelpipe_iop_t *const piece,
   if(piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
     return roi_out->scale > (piece->pipe->dsc.filters == 9u ? 0.667f : 0.5f);
 
+  // downscaled exports, opt-in: if every output pixel covers at least one full CFA period
+  // the box filtered zoom is as sharp as demosaic + finalscale and doesn't alias.
+  // high quality exports always request scale 1 here, capture sharpening needs full resolution.
+  if(piece->pipe->type & DT_DEV_PIXELPIPE_EXPORT)
+  {
+    const dt_iop_demosaic_data_t *d = piece->data;
+    if(d->cs_enabled || !dt_conf_get_bool("plugins/darkroom/demosaic/fast_export"))
+      return TRUE;
+    return roi_out->scale > (piece->pipe->dsc.filters == 9u ? 0.334f : 0.5f);
+  }
+
   return TRUE;
 }
 
@@ -905,6 +926,23 @@ void process(dt_iop_module_t *self,
   }
 }
 
+// only the approximate half size zoom of bayer sensors can finish a fused raw run
+gboolean raw_pointwise(dt_iop_module_t *self,
+                       dt_dev_pixelpipe_iop_t *piece,
+                       dt_iop_raw_pointwise_t *op,
+                       const dt_iop_roi_t *const roi_in,
+                       const dt_iop_roi_t *const roi_out)
+{
+  const dt_image_t *img = &self->dev->image_storage;
+  const dt_iop_demosaic_data_t *d = piece->data;
+  const int method = d->demosaicing_method & ~DT_DEMOSAIC_DUAL;
+
+  return piece->pipe->image.buf_dsc.filters != 9u
+    && method != DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME
+    && !_demosaic_full(piece, img, roi_out)
+    && roi_in->x == 0 && roi_in->y == 0;
+}
+
 #ifdef HAVE_OPENCL
 int process_cl(dt_iop_module_t *self,
                dt_dev_pixelpipe_iop_t *const piece,
@@ -1235,6 +1273,47 @@ finish:
 #undef MIN_TILE_ROWS
 
 
+#ifdef HAVE_OPENCL
+int process_raw_fused_cl(dt_iop_module_t *self,
+                         dt_dev_pixelpipe_iop_t *piece,
+                         cl_mem dev_in,
+                         cl_mem dev_out,
+                         const dt_iop_roi_t *const roi_in,
+                         const dt_iop_roi_t *const roi_out,
+                         const dt_iop_raw_pointwise_t *const op)
+{
+  dt_dev_pixelpipe_t *const pipe = piece->pipe;
+  const dt_iop_demosaic_global_data_t *gd = self->global_data;
+  const int devid = pipe->devid;
+  const uint32_t filters = dt_rawspeed_crop_dcraw_filters(pipe->dsc.filters, roi_in->x, roi_in->y);
+  const int uint16 = op->uint16;
+
+  dt_dev_clear_scharr_mask(pipe);
+  dt_print_pipe(DT_DEBUG_PIPE, "demosaic fused raw zoom", pipe, self, devid, roi_in, roi_out);
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem dev_sub = dt_opencl_copy_host_to_device_constant(devid, sizeof(op->sub), (void *)op->sub);
+  cl_mem dev_div = dt_opencl_copy_host_to_device_constant(devid, sizeof(op->div), (void *)op->div);
+  cl_mem dev_mul = dt_opencl_copy_host_to_device_constant(devid, sizeof(op->mul), (void *)op->mul);
+  cl_mem dev_clip = dt_opencl_copy_host_to_device_constant(devid, sizeof(op->clip), (void *)op->clip);
+  if(dev_sub && dev_div && dev_mul && dev_clip)
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_zoom_half_size_raw,
+                                           roi_out->width, roi_out->height,
+                                           CLARG(dev_in), CLARG(dev_out),
+                                           CLARG(roi_out->width), CLARG(roi_out->height),
+                                           CLARG(roi_in->width), CLARG(roi_in->height),
+                                           CLARG(roi_out->scale), CLARG(filters),
+                                           CLARG(uint16), CLARG(op->crop_x), CLARG(op->crop_y),
+                                           CLARG(dev_sub), CLARG(dev_div),
+                                           CLARG(dev_mul), CLARG(dev_clip));
+  dt_opencl_release_mem_object(dev_sub);
+  dt_opencl_release_mem_object(dev_div);
+  dt_opencl_release_mem_object(dev_mul);
+  dt_opencl_release_mem_object(dev_clip);
+  return err;
+}
+#endif
+
 void init_global(dt_iop_module_so_t *self)
 {
   const int program = 0; // from programs.conf
@@ -1242,6 +1321,7 @@ void init_global(dt_iop_module_so_t *self)
   self->data = gd;
 
   gd->kernel_zoom_half_size = dt_opencl_create_kernel(program, "clip_and_zoom_demosaic_half_size");
+  gd->kernel_zoom_half_size_raw = dt_opencl_create_kernel(program, "clip_and_zoom_demosaic_half_size_raw");
   gd->kernel_ppg_green = dt_opencl_create_kernel(program, "ppg_demosaic_green");
   gd->kernel_green_eq_lavg = dt_opencl_create_kernel(program, "green_equilibration_lavg");
   gd->kernel_green_eq_favg_reduce_first = dt_opencl_create_kernel(program, "green_equilibration_favg_reduce_first");
@@ -1319,6 +1399,7 @@ void cleanup_global(dt_iop_module_so_t *self)
 {
   dt_iop_demosaic_global_data_t *gd = self->data;
   dt_opencl_free_kernel(gd->kernel_zoom_half_size);
+  dt_opencl_free_kernel(gd->kernel_zoom_half_size_raw);
   dt_opencl_free_kernel(gd->kernel_ppg_green);
   dt_opencl_free_kernel(gd->kernel_pre_median);
   dt_opencl_free_kernel(gd->kernel_green_eq_lavg);
@@ -1481,11 +1562,12 @@ void commit_params(dt_iop_module_t *self,
 
 void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = malloc(sizeof(dt_iop_demosaic_data_t));
+  piece->data = calloc(1, sizeof(dt_iop_demosaic_data_t));
 }
 
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  _capture_free_cached(piece->data);
   free(piece->data);
   piece->data = NULL;
 }
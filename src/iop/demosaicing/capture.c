@@ -139,6 +139,44 @@ static unsigned char *_cs_precalc_gauss_idx(dt_iop_module_t *self,
   return table;
 }
 
+// the index map doesn't depend on the image data, keep it in the pipe's
+// data and only recalculate it when the roi or the parameters change
+static const unsigned char *_cs_gauss_idx(dt_iop_module_t *self,
+                                          dt_dev_pixelpipe_iop_t *const piece,
+                                          const int width,
+                                          const int height,
+                                          const int dx,
+                                          const int dy)
+{
+  dt_iop_demosaic_data_t *d = piece->data;
+  const dt_image_t *img = &self->dev->image_storage;
+  const int geometry[6] = { width, height, dx, dy, img->p_width, img->p_height };
+  const float shape[3] = { d->cs_radius, d->cs_boost, d->cs_center };
+  dt_hash_t hash = dt_hash(DT_INITHASH, geometry, sizeof(geometry));
+  hash = dt_hash(hash, shape, sizeof(shape));
+
+  if(d->cs_gauss_idx && d->cs_gauss_hash == hash)
+    return d->cs_gauss_idx;
+
+  dt_free_align(d->cs_gauss_idx);
+  d->cs_gauss_idx = _cs_precalc_gauss_idx(self, width, height, dx, dy, d->cs_radius, d->cs_boost, d->cs_center);
+  d->cs_gauss_hash = hash;
+  return d->cs_gauss_idx;
+}
+
+static void _capture_free_cached(dt_iop_demosaic_data_t *d)
+{
+  if(!d) return;
+  dt_free_align(d->cs_gauss_idx);
+  d->cs_gauss_idx = NULL;
+#ifdef HAVE_OPENCL
+  dt_opencl_release_mem_object(d->cs_dev_gauss_idx);
+  dt_opencl_release_mem_object(d->cs_dev_gcoeffs);
+  d->cs_dev_gauss_idx = NULL;
+  d->cs_dev_gcoeffs = NULL;
+#endif
+}
+
 #define RAWEPS 0.005f
 #define lowerLimit 0.01f
 #define upperLimit 0.9f
@@ -849,7 +887,7 @@ static void _capture_sharpen(dt_iop_module_t *self,
                                        wbon ? CAPTURE_CFACLIP * dsc->temperature.coeffs[1] : CAPTURE_CFACLIP,
                                        wbon ? CAPTURE_CFACLIP * dsc->temperature.coeffs[2] : CAPTURE_CFACLIP,
                                        0.0f };
-  unsigned char *gauss_idx = NULL;
+  const unsigned char *gauss_idx = NULL;
   gboolean error = TRUE;
 
   float *luminance = dt_iop_image_alloc(width, height, 1);
@@ -889,7 +927,7 @@ static void _capture_sharpen(dt_iop_module_t *self,
     goto finalize;
   }
 
-  gauss_idx = _cs_precalc_gauss_idx(self, width, height, dx, dy, d->cs_radius, d->cs_boost, d->cs_center);
+  gauss_idx = _cs_gauss_idx(self, piece, width, height, dx, dy);
   if(!gauss_idx) goto finalize;
 
   if(show_sigma_mask)
@@ -925,7 +963,6 @@ static void _capture_sharpen(dt_iop_module_t *self,
     dt_print_pipe(DT_DEBUG_ALWAYS, "capture sharpen failed", pipe, self, DT_DEVICE_CPU, NULL, NULL,
       "unable to allocate memory");
 
-  dt_free_align(gauss_idx);
   dt_free_align(tmp2);
   dt_free_align(tmp1);
   dt_free_align(luminance);
@@ -984,7 +1021,7 @@ static int _capture_sharpen_cl(dt_iop_module_t *self,
   const int bsize = sizeof(float) * pixels;
   const int devid = piece->pipe->devid;
 
-  const dt_iop_demosaic_data_t *const d = piece->data;
+  dt_iop_demosaic_data_t *const d = piece->data;
   dt_iop_demosaic_global_data_t *const gd = self->global_data;
 
   if(pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL)
@@ -1043,13 +1080,23 @@ static int _capture_sharpen_cl(dt_iop_module_t *self,
     goto finish;
   }
 
-  unsigned char *f_gauss_idx = _cs_precalc_gauss_idx(self, width, height, dx, dy, d->cs_radius, d->cs_boost, d->cs_center);
+  // the index map and kernels stay on the device for the next runs
+  const unsigned char *f_gauss_idx = _cs_gauss_idx(self, piece, width, height, dx, dy);
+  if(f_gauss_idx
+     && (!d->cs_dev_gauss_idx || !d->cs_dev_gcoeffs || d->cs_devid != devid || d->cs_dev_hash != d->cs_gauss_hash))
+  {
+    dt_opencl_release_mem_object(d->cs_dev_gauss_idx);
+    dt_opencl_release_mem_object(d->cs_dev_gcoeffs);
+    d->cs_dev_gcoeffs = dt_opencl_copy_host_to_device_constant(devid, sizeof(float) * (UCHAR_MAX+1) * CAPTURE_KERNEL_ALIGN, gd->gauss_coeffs);
+    d->cs_dev_gauss_idx = dt_opencl_copy_host_to_device_constant(devid, sizeof(unsigned char) * height * width, f_gauss_idx);
+    d->cs_devid = devid;
+    d->cs_dev_hash = d->cs_gauss_hash;
+  }
   if(f_gauss_idx)
   {
-    gcoeffs = dt_opencl_copy_host_to_device_constant(devid, sizeof(float) * (UCHAR_MAX+1) * CAPTURE_KERNEL_ALIGN, gd->gauss_coeffs);
-    gauss_idx = dt_opencl_copy_host_to_device_constant(devid, sizeof(unsigned char) * height * width, f_gauss_idx);
+    gcoeffs = d->cs_dev_gcoeffs;
+    gauss_idx = d->cs_dev_gauss_idx;
   }
-  dt_free_align(f_gauss_idx);
 
   err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
   if(!gcoeffs || !gauss_idx) goto finish;
@@ -1085,8 +1132,6 @@ static int _capture_sharpen_cl(dt_iop_module_t *self,
       pipe, self, devid, NULL, NULL,
       "Error: %s", cl_errstr(err));
 
-  dt_opencl_release_mem_object(gauss_idx);
-  dt_opencl_release_mem_object(gcoeffs);
   dt_opencl_release_mem_object(blendmask);
   dt_opencl_release_mem_object(dev_rgb);
   dt_opencl_release_mem_object(tmp2);
@@ -27,6 +27,106 @@ static float _slider2contrast(const float slider)
   return 0.005f * powf(slider, 1.1f);
 }
 
+// The low detail demosaic is only done where the blend mask doesn't
+// fully select the high detail one, in bands of rows cropped to the
+// columns needing it. Band starts are multiples of both the Bayer and
+// X-Trans pattern periods, the margin keeps band borders out of sight.
+#define DUAL_BAND 48
+#define DUAL_MARGIN 24
+// above this the low detail part of a pixel is far below visibility
+#define DUAL_HIGH_ONLY 0.999f
+
+static void _dual_blend_low(float *const restrict high_data,
+                            const float *const restrict raw_data,
+                            const float *const restrict mask,
+                            const int width,
+                            const int height,
+                            const uint32_t filters,
+                            const uint8_t (*const xtrans)[6])
+{
+  const int bands = (height + DUAL_BAND - 1) / DUAL_BAND;
+  int *xmin = dt_alloc_align_int(bands);
+  int *xmax = dt_alloc_align_int(bands);
+  if(!xmin || !xmax)
+  {
+    dt_free_align(xmin);
+    dt_free_align(xmax);
+    return;
+  }
+
+  // columns of each band where the low detail demosaic contributes
+  DT_OMP_FOR()
+  for(int band = 0; band < bands; band++)
+  {
+    int lo = width;
+    int hi = -1;
+    for(int row = band * DUAL_BAND; row < MIN(height, (band + 1) * DUAL_BAND); row++)
+    {
+      const float *m = mask + (size_t)row * width;
+      for(int col = 0; col < lo; col++)
+        if(m[col] < DUAL_HIGH_ONLY) { lo = col; break; }
+      for(int col = width - 1; col > hi; col--)
+        if(m[col] < DUAL_HIGH_ONLY) { hi = col; break; }
+    }
+    xmin[band] = lo;
+    xmax[band] = hi;
+  }
+
+  for(int band = 0; band < bands;)
+  {
+    if(xmax[band] < 0)
+    {
+      band++;
+      continue;
+    }
+    // join the following bands needing it too
+    int lo = xmin[band];
+    int hi = xmax[band];
+    int last = band;
+    while(last + 1 < bands && xmax[last + 1] >= 0)
+    {
+      last++;
+      lo = MIN(lo, xmin[last]);
+      hi = MAX(hi, xmax[last]);
+    }
+
+    const int y0 = band * DUAL_BAND;
+    const int y1 = MIN(height, (last + 1) * DUAL_BAND);
+    const int ty = MAX(0, y0 - DUAL_MARGIN);
+    const int tx = MAX(0, lo - DUAL_MARGIN) / DUAL_MARGIN * DUAL_MARGIN;
+    const int th = MIN(height, y1 + DUAL_MARGIN) - ty;
+    const int tw = MIN(width, hi + 1 + DUAL_MARGIN) - tx;
+
+    float *raw = dt_iop_image_alloc(tw, th, 1);
+    float *vng_image = dt_iop_image_alloc(tw, th, 4);
+    if(raw && vng_image)
+    {
+      DT_OMP_FOR()
+      for(int row = 0; row < th; row++)
+        memcpy(raw + (size_t)row * tw, raw_data + (size_t)(row + ty) * width + tx,
+               sizeof(float) * tw);
+
+      vng_interpolate(vng_image, raw, tw, th, filters, xtrans, TRUE);
+      color_smoothing(vng_image, tw, th, DT_DEMOSAIC_SMOOTH_2);
+
+      DT_OMP_FOR(collapse(2))
+      for(int row = y0; row < y1; row++)
+        for(int col = lo; col <= hi; col++)
+        {
+          const size_t idx = (size_t)row * width + col;
+          const float *vng = vng_image + 4 * ((size_t)(row - ty) * tw + col - tx);
+          for(int c = 0; c < 3; c++)
+            high_data[idx * 4 + c] = interpolatef(mask[idx], high_data[idx * 4 + c], vng[c]);
+        }
+    }
+    dt_free_align(raw);
+    dt_free_align(vng_image);
+    band = last + 1;
+  }
+  dt_free_align(xmin);
+  dt_free_align(xmax);
+}
+
 static void dual_demosaic(dt_dev_pixelpipe_iop_t *piece,
                           float *const restrict high_data,
                           const float *const restrict raw_data,
@@ -65,22 +165,11 @@ static void dual_demosaic(dt_dev_pixelpipe_iop_t *piece,
   }
   else
   {
-    float *vng_image = dt_iop_image_alloc(width, height, 4);
-    if(vng_image)
-    {
-      vng_interpolate(vng_image, raw_data, width, height, filters, xtrans, TRUE);
-      color_smoothing(vng_image, width, height, DT_DEMOSAIC_SMOOTH_2);
-
-      DT_OMP_FOR_SIMD(aligned(mask, vng_image : 64))
-      for(size_t idx = 0; idx < msize; idx++)
-      {
-        const size_t oidx = idx * 4;
-        for(int c = 0; c < 3; c++)
-          high_data[oidx + c] = interpolatef(mask[idx], high_data[oidx + c], vng_image[oidx + c]);
-        high_data[oidx + 3] = 0.0f;
-      }
-      dt_free_align(vng_image);
-    }
+    _dual_blend_low(high_data, raw_data, mask, width, height, filters, xtrans);
+
+    DT_OMP_FOR()
+    for(size_t idx = 0; idx < msize; idx++)
+      high_data[idx * 4 + 3] = 0.0f;
   }
   dt_free_align(mask);
   dt_free_align(tmp);
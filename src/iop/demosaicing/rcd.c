@@ -301,6 +301,7 @@ static void demosaic_box3(float *const restrict out,
 }
 
 DT_OMP_DECLARE_SIMD(aligned(in, out : 64))
+__DT_CLONE_TARGETS__
 static void rcd_demosaic(float *const restrict out,
                          const float *const restrict in,
                          const int width,
@@ -530,8 +531,8 @@ static void rcd_demosaic(float *const restrict out,
 
             for(int c = 0; c <= 2; c += 2)
             {
-              const float SNabs = fabs(rgb[c][indx - w1] - rgb[c][indx + w1]);
-              const float EWabs = fabs(rgb[c][indx -  1] - rgb[c][indx +  1]);
+              const float SNabs = fabsf(rgb[c][indx - w1] - rgb[c][indx + w1]);
+              const float EWabs = fabsf(rgb[c][indx -  1] - rgb[c][indx +  1]);
 
               // Cardinal gradients
               const float N_Grad = N1 + SNabs + fabsf(rgb[c][indx - w1] - rgb[c][indx - w3]);
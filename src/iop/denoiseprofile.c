@@ -51,6 +51,10 @@
 //   tiling
 #define NUM_BUCKETS 4
 
+// share of the weight of all searched patches which, once gathered by every
+// pixel of a slice, lets the fast search of non-local means stop early there
+#define NLMEANS_FAST_EARLY_EXIT 0.5f
+
 #define DT_IOP_DENOISE_PROFILE_INSET DT_PIXEL_APPLY_DPI(5)
 #define DT_IOP_DENOISE_PROFILE_RES 64
 #define DT_IOP_DENOISE_PROFILE_V8_BANDS 5
@@ -92,7 +96,7 @@ typedef enum dt_iop_denoiseprofile_channel_t
 
 // this is the version of the modules parameters,
 // and includes version information about compile-time dt
-DT_MODULE_INTROSPECTION(12, dt_iop_denoiseprofile_params_t)
+DT_MODULE_INTROSPECTION(13, dt_iop_denoiseprofile_params_t)
 
 typedef struct dt_iop_denoiseprofile_params_t
 {
@@ -124,6 +128,7 @@ typedef struct dt_iop_denoiseprofile_params_t
   dt_iop_denoiseprofile_wavelet_mode_t wavelet_color_mode; /* switch between RGB and Y0U0V0 modes.
                                                               $DEFAULT: MODE_Y0U0V0 $DESCRIPTION: "color mode"*/
   gboolean compensate_hilite_pres; // $DEFAULT: TRUE $DESCRIPTION: "compensate highlight preservation"
+  gboolean fast_search; // $DEFAULT: FALSE $DESCRIPTION: "fast search"
 } dt_iop_denoiseprofile_params_t;
 
 typedef struct dt_iop_denoiseprofile_gui_data_t
@@ -138,6 +143,7 @@ typedef struct dt_iop_denoiseprofile_gui_data_t
   GtkWidget *bias;
   GtkWidget *scattering;
   GtkWidget *central_pixel_weight;
+  GtkWidget *fast_search;
   GtkWidget *overshooting;
   GtkWidget *wavelet_color_mode;
   dt_noiseprofile_t interpolated; // don't use name, maker or model, they may point to garbage
@@ -190,6 +196,7 @@ typedef struct dt_iop_denoiseprofile_data_t
   gboolean fix_anscombe_and_nlmeans_norm; // backward compatibility options
   gboolean use_new_vst;                   // backward compatibility options
   dt_iop_denoiseprofile_wavelet_mode_t wavelet_color_mode; // switch between RGB and Y0U0V0 modes.
+  gboolean fast_search;                   // search fewer patches with non-local means
 } dt_iop_denoiseprofile_data_t;
 
 typedef struct dt_iop_denoiseprofile_global_data_t
@@ -734,6 +741,28 @@ int legacy_params(dt_iop_module_t *self,
     gboolean compensate_hilite_pres;
   } dt_iop_denoiseprofile_params_v12_t;
 
+  typedef struct dt_iop_denoiseprofile_params_v13_t
+  {
+    float radius;
+    float nbhood;
+    float strength;
+    float shadows;
+    float bias;
+    float scattering;
+    float central_pixel_weight;
+    float overshooting;
+    float a[3], b[3];
+    dt_iop_denoiseprofile_mode_t mode;
+    float x[DT_DENOISE_PROFILE_NONE][DT_IOP_DENOISE_PROFILE_BANDS];
+    float y[DT_DENOISE_PROFILE_NONE][DT_IOP_DENOISE_PROFILE_BANDS];
+    gboolean wb_adaptive_anscombe;
+    gboolean fix_anscombe_and_nlmeans_norm;
+    gboolean use_new_vst;
+    dt_iop_denoiseprofile_wavelet_mode_t wavelet_color_mode;
+    gboolean compensate_hilite_pres;
+    gboolean fast_search;
+  } dt_iop_denoiseprofile_params_v13_t;
+
   if(old_version < 11)
   {
     *new_params = (dt_iop_denoiseprofile_params_v11_t *)
@@ -764,6 +793,21 @@ int legacy_params(dt_iop_module_t *self,
     *new_version = 12;
     return 0;
   }
+  if(old_version == 12)
+  {
+    const dt_iop_denoiseprofile_params_v12_t *o = (dt_iop_denoiseprofile_params_v12_t *)old_params;
+    dt_iop_denoiseprofile_params_v13_t *n = malloc(sizeof(dt_iop_denoiseprofile_params_v13_t));
+
+    // layout is the same except for the addition of a new field
+    memset(n, 0, sizeof(dt_iop_denoiseprofile_params_v13_t));
+    memcpy(n, o, sizeof(dt_iop_denoiseprofile_params_v12_t));
+    n->fast_search = FALSE;
+
+    *new_params = n;
+    *new_params_size = sizeof(dt_iop_denoiseprofile_params_v13_t);
+    *new_version = 13;
+    return 0;
+  }
 
   return 1;
 }
@@ -804,7 +848,15 @@ void init_presets(dt_iop_module_so_t *self)
     p.x[DT_DENOISE_PROFILE_Y0][b] = b / (DT_IOP_DENOISE_PROFILE_BANDS - 1.0f);
     p.y[DT_DENOISE_PROFILE_Y0][b] = 0.0f;
   }
-  dt_gui_presets_add_generic(_("wavelets: chroma only"), self->op, 12, &p,
+  dt_gui_presets_add_generic(_("wavelets: chroma only"), self->op, 13, &p,
+                             sizeof(p), TRUE, DEVELOP_BLEND_CS_RGB_SCENE);
+
+  // non-local means with the automatic settings and the fast search
+  p.mode = MODE_NLMEANS_AUTO;
+  p.strength = 1.0f;
+  p.shadows = 1.0f;
+  p.fast_search = TRUE;
+  dt_gui_presets_add_generic(_("non-local means: fast"), self->op, 13, &p,
                              sizeof(p), TRUE, DEVELOP_BLEND_CS_RGB_SCENE);
 }
 
@@ -1821,9 +1873,16 @@ static void process_nlmeans(dt_iop_module_t *self,
                                       .sharpness = norm,
                                       .patch_radius = P,
                                       .search_radius = K,
-                                      .decimate = 0,
+                                      .decimate = d->fast_search,
+                                      .early_exit = d->fast_search ? NLMEANS_FAST_EARLY_EXIT : 0.0f,
                                       .norm = norm2 };
-  nlmeans_denoise(in, ovoid, roi_in, roi_out, &params);
+  dt_times_t start = { 0 };
+  dt_get_perf_times(&start);
+  const float compared = nlmeans_denoise(in, ovoid, roi_in, roi_out, &params);
+  if(d->fast_search)
+    dt_show_times_f(&start, "[denoiseprofile]",
+                    "fast non-local means, %.1f%% of the patches compared, estimated speedup %.1fx",
+                    100.0f * compared, 1.0f / fmaxf(compared, 1e-3f));
 
   dt_free_align(in);
   nlmeans_backtransform(d,ovoid,roi_in,scale,compensate_p,wb,aa,bb,p);
@@ -2041,7 +2100,7 @@ static int process_nlmeans_cl(dt_iop_module_t *self,
         .sharpness = norm,
         .patch_radius = P,
         .search_radius = K,
-        .decimate = 0,
+        .decimate = d->fast_search,
         .norm = norm2,
         .pipetype = piece->pipe->type,
         .kernel_init = gd->kernel_denoiseprofile_init,
@@ -2199,6 +2258,9 @@ static int process_nlmeans_cl(dt_iop_module_t *self,
                              * scattering / 6.0 + ki_index);
       int q[2] = { i, j };
 
+      // the fast search skips every other patch in a checkerboard pattern
+      if(d->fast_search && ((kj_index + ki_index) & 1)) continue;
+
       cl_mem dev_U4 = buckets[bucket_next(&state, NUM_BUCKETS)];
       dt_opencl_set_kernel_args(devid, gd->kernel_denoiseprofile_dist, 0,
                                 CLARG(dev_tmp), CLARG(dev_U4),
@@ -3125,6 +3187,7 @@ void commit_params(dt_iop_module_t *self,
   d->wb_adaptive_anscombe = p->wb_adaptive_anscombe;
   d->fix_anscombe_and_nlmeans_norm = p->fix_anscombe_and_nlmeans_norm;
   d->use_new_vst = p->use_new_vst;
+  d->fast_search = p->fast_search;
 }
 
 void init_pipe(dt_iop_module_t *self,
@@ -3288,6 +3351,7 @@ void gui_update(dt_iop_module_t *self)
   gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(g->wb_adaptive_anscombe),
                                p->wb_adaptive_anscombe);
   gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(g->compensate_hilite_pres), p->compensate_hilite_pres);
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(g->fast_search), p->fast_search);
   gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(g->fix_anscombe_and_nlmeans_norm),
                                p->fix_anscombe_and_nlmeans_norm);
   gtk_widget_set_visible(g->fix_anscombe_and_nlmeans_norm,
@@ -3762,6 +3826,7 @@ void gui_init(dt_iop_module_t *self)
   dt_bauhaus_slider_set_soft_max(g->scattering, 1.0f);
   g->central_pixel_weight = dt_bauhaus_slider_from_params(self, "central_pixel_weight");
   dt_bauhaus_slider_set_soft_max(g->central_pixel_weight, 1.0f);
+  g->fast_search = dt_bauhaus_toggle_from_params(self, "fast_search");
 
   g->box_wavelets = self->widget = dt_gui_vbox();
 
@@ -3931,6 +3996,11 @@ void gui_init(dt_iop_module_t *self)
                                 "of the patch in the patch comparison.\n"
                                 "useful to recover details when patch size\n"
                                 "is quite big."));
+  gtk_widget_set_tooltip_text(g->fast_search,
+                              _("compare only half of the patches of the neighborhood\n"
+                                "and stop searching early in flat areas.\n"
+                                "much faster at high ISO, with slightly less\n"
+                                "noise reduction in smooth areas."));
   gtk_widget_set_tooltip_text(g->strength, _("finetune denoising strength"));
   gtk_widget_set_tooltip_text(g->overshooting,
                               _("controls the way parameters are autoset.\n"
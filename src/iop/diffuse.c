@@ -43,7 +43,7 @@
 #include "gui/presets.h"
 #include "iop/iop_api.h"
 
-DT_MODULE_INTROSPECTION(2, dt_iop_diffuse_params_t)
+DT_MODULE_INTROSPECTION(3, dt_iop_diffuse_params_t)
 
 #define MAX_NUM_SCALES 10
 typedef struct dt_iop_diffuse_params_t
@@ -70,6 +70,9 @@ typedef struct dt_iop_diffuse_params_t
   // v2
   int radius_center;        // $MIN: 0    $MAX: 1024 $DEFAULT: 0  $DESCRIPTION: "central radius"
 
+  // v3
+  float tolerance;          // $MIN: 0.   $MAX: 0.1  $DEFAULT: 0. $DESCRIPTION: "convergence tolerance"
+
   // new versions add params mandatorily at the end, so we can memcpy old parameters at the beginning
 
 } dt_iop_diffuse_params_t;
@@ -77,7 +80,7 @@ typedef struct dt_iop_diffuse_params_t
 
 typedef struct dt_iop_diffuse_gui_data_t
 {
-  GtkWidget *iterations, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
+  GtkWidget *iterations, *tolerance, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
       *anisotropy_first, *anisotropy_second, *anisotropy_third, *anisotropy_fourth, *regularization_first, *variance_threshold;
 } dt_iop_diffuse_gui_data_t;
 
@@ -90,6 +93,7 @@ typedef struct dt_iop_diffuse_global_data_t
   int kernel_diffuse_build_mask;
   int kernel_diffuse_inpaint_mask;
   int kernel_diffuse_pde;
+  int kernel_diffuse_residual;
 } dt_iop_diffuse_global_data_t;
 
 
@@ -229,6 +233,22 @@ int legacy_params(dt_iop_module_t *self,
     *new_version = 2;
     return 0;
   }
+  if(old_version == 2)
+  {
+    const dt_iop_diffuse_params_v2_t *o = (dt_iop_diffuse_params_v2_t *)old_params;
+    dt_iop_diffuse_params_t *n = malloc(sizeof(dt_iop_diffuse_params_t));
+
+    // copy common parameters
+    memcpy(n, o, sizeof(dt_iop_diffuse_params_v2_t));
+
+    // init only new parameters
+    n->tolerance = 0.f;
+
+    *new_params = n;
+    *new_params_size = sizeof(dt_iop_diffuse_params_t);
+    *new_version = 3;
+    return 0;
+  }
   return 1;
 }
 
@@ -1308,7 +1328,8 @@ static inline void inpaint_mask(float *const restrict inpainted,
                                 const float *const restrict original,
                                 const uint8_t *const restrict mask,
                                 const size_t width,
-                                const size_t height)
+                                const size_t height,
+                                const dt_iop_roi_t *const roi)
 {
   // init the reconstruction with noise inside the masked areas
   DT_OMP_FOR()
@@ -1316,19 +1337,15 @@ static inline void inpaint_mask(float *const restrict inpainted,
   {
     if(mask[k / 4])
     {
-      const uint32_t i = k / width;
-      const uint32_t j = k - i;
-      uint32_t DT_ALIGNED_ARRAY state[4]
-          = { splitmix32(j + 1), splitmix32((uint64_t)(j + 1) * (i + 3)),
-              splitmix32(1337), splitmix32(666) };
-      xoshiro128plus(state);
-      xoshiro128plus(state);
-      xoshiro128plus(state);
-      xoshiro128plus(state);
-
-      for_four_channels(c, aligned(inpainted, original, state:64))
-        inpainted[k + c] = fabsf(gaussian_noise(original[k + c],
-                                                original[k + c], i % 2 || j % 2, state));
+      // seed the noise by the absolute pixel coordinates so tiles match
+      const uint32_t i = k / 4 / width;
+      const uint32_t j = k / 4 - (size_t)i * width;
+      dt_aligned_pixel_t noise;
+      dt_noise_generator_simd(DT_NOISE_GAUSSIAN, roi->x + j, roi->y + i, 1337,
+                              original + k, original + k, noise);
+
+      for_four_channels(c, aligned(inpainted, noise:64))
+        inpainted[k + c] = fabsf(noise[c]);
     }
     else
     {
@@ -1338,6 +1355,26 @@ static inline void inpaint_mask(float *const restrict inpainted,
   }
 }
 
+// relative L1 change of one iteration, used to stop early once the diffusion has converged
+static inline float _iteration_residual(const float *const restrict before,
+                                        const float *const restrict after,
+                                        const size_t width,
+                                        const size_t height)
+{
+  double diff = 0.;
+  double norm = 0.;
+  DT_OMP_FOR(reduction(+ : diff, norm))
+  for(size_t k = 0; k < width * height * 4; k += 4)
+  {
+    for(size_t c = 0; c < 3; c++)
+    {
+      diff += fabsf(after[k + c] - before[k + c]);
+      norm += fabsf(before[k + c]);
+    }
+  }
+  return (float)(diff / fmax(norm, 1e-6));
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const restrict ivoid,
@@ -1410,7 +1447,7 @@ void process(dt_iop_module_t *self,
     build_mask(in, mask, data->threshold, roi_out->width, roi_out->height);
 
     // init the inpainting area with noise
-    inpaint_mask(temp1, in, mask, roi_out->width, roi_out->height);
+    inpaint_mask(temp1, in, mask, roi_out->width, roi_out->height, roi_out);
 
     in = temp1;
   }
@@ -1439,6 +1476,15 @@ void process(dt_iop_module_t *self,
     wavelets_process(temp_in, temp_out, mask,
                      roi_out->width, roi_out->height,
                      data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
+
+    // stop once an iteration barely changes the image anymore,
+    // not when tiling as tiles would stop at different iterations
+    if(data->tolerance > 0.f && !piece->pipe->tiling && it < iterations - 1
+       && _iteration_residual(temp_in, temp_out, width, height) < data->tolerance)
+    {
+      dt_iop_image_copy_by_size(out, temp_out, width, height, 4);
+      break;
+    }
   }
 
 finish:
@@ -1606,6 +1652,38 @@ static inline cl_int wavelets_process_cl(const int devid,
   return err;
 }
 
+// the convergence check needs a host sync, so the OpenCL path only runs it every few iterations
+#define DIFFUSE_CL_CHECK_INTERVAL 8
+
+static inline cl_int _iteration_residual_cl(const int devid,
+                                            const dt_iop_diffuse_global_data_t *const gd,
+                                            cl_mem before,
+                                            cl_mem after,
+                                            cl_mem dev_rows,
+                                            float *const rows,
+                                            const int width,
+                                            const int height,
+                                            float *const residual)
+{
+  cl_int err = dt_opencl_enqueue_kernel_1d_args(devid, gd->kernel_diffuse_residual, height,
+                                                CLARG(before), CLARG(after), CLARG(dev_rows),
+                                                CLARG(width), CLARG(height));
+  if(err != CL_SUCCESS) return err;
+
+  err = dt_opencl_read_buffer_from_device(devid, rows, dev_rows, 0, sizeof(float) * 2 * height, CL_TRUE);
+  if(err != CL_SUCCESS) return err;
+
+  double diff = 0.;
+  double norm = 0.;
+  for(int y = 0; y < height; y++)
+  {
+    diff += rows[2 * y];
+    norm += rows[2 * y + 1];
+  }
+  *residual = (float)(diff / fmax(norm, 1e-6));
+  return CL_SUCCESS;
+}
+
 int process_cl(dt_iop_module_t *self,
                dt_dev_pixelpipe_iop_t *piece,
                cl_mem dev_in,
@@ -1646,6 +1724,13 @@ int process_cl(dt_iop_module_t *self,
   cl_mem LF_even = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(float) * 4);
   cl_mem LF_odd = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(float) * 4);
 
+  // per row sums of the convergence check
+  const gboolean check_convergence = data->tolerance > 0.f && !piece->pipe->tiling
+                                     && data->iterations > DIFFUSE_CL_CHECK_INTERVAL;
+  cl_mem dev_rows = check_convergence ? dt_opencl_alloc_device_buffer(devid, sizeof(float) * 2 * height) : NULL;
+  float *rows = check_convergence ? dt_alloc_align_float((size_t)2 * height) : NULL;
+  if(check_convergence && (!dev_rows || !rows)) out_of_memory = TRUE;
+
   const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
   const float final_radius = (data->radius + data->radius_center) * 2.f / scale;
 
@@ -1683,7 +1768,8 @@ int process_cl(dt_iop_module_t *self,
     // init the inpainting area with noise
     dt_opencl_set_kernel_args(devid, gd->kernel_diffuse_inpaint_mask, 0,
                               CLARG(temp1), CLARG(in), CLARG(mask),
-                              CLARG(roi_out->width), CLARG(roi_out->height));
+                              CLARG(roi_out->width), CLARG(roi_out->height),
+                              CLARG(roi_out->x), CLARG(roi_out->y));
     err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_diffuse_inpaint_mask, sizes);
     if(err != CL_SUCCESS) goto error;
 
@@ -1713,9 +1799,26 @@ int process_cl(dt_iop_module_t *self,
     err = wavelets_process_cl(devid, temp_in, temp_out, mask, sizes,
                               width, height, data, gd, final_radius,
                               scale, scales, has_mask, HF, LF_odd, LF_even);
+    if(err != CL_SUCCESS) goto error;
+
+    // stop once an iteration barely changes the image anymore
+    if(check_convergence && it < iterations - 1 && (it + 1) % DIFFUSE_CL_CHECK_INTERVAL == 0)
+    {
+      float residual = 0.f;
+      err = _iteration_residual_cl(devid, gd, temp_in, temp_out, dev_rows, rows, width, height, &residual);
+      if(err != CL_SUCCESS) goto error;
+
+      if(residual < data->tolerance)
+      {
+        err = dt_opencl_enqueue_copy_image(devid, temp_out, dev_out, origin, origin, region);
+        break;
+      }
+    }
   }
 
 error:
+  dt_opencl_release_mem_object(dev_rows);
+  dt_free_align(rows);
   dt_opencl_release_mem_object(temp1);
   dt_opencl_release_mem_object(temp2);
   dt_opencl_release_mem_object(mask);
@@ -1735,6 +1838,7 @@ void init_global(dt_iop_module_so_t *self)
   gd->kernel_diffuse_build_mask = dt_opencl_create_kernel(program, "build_mask");
   gd->kernel_diffuse_inpaint_mask = dt_opencl_create_kernel(program, "inpaint_mask");
   gd->kernel_diffuse_pde = dt_opencl_create_kernel(program, "diffuse_pde");
+  gd->kernel_diffuse_residual = dt_opencl_create_kernel(program, "diffuse_residual");
 
   const int wavelets = 35; // bspline.cl, from programs.conf
   gd->kernel_filmic_bspline_horizontal =
@@ -1752,6 +1856,7 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_diffuse_build_mask);
   dt_opencl_free_kernel(gd->kernel_diffuse_inpaint_mask);
   dt_opencl_free_kernel(gd->kernel_diffuse_pde);
+  dt_opencl_free_kernel(gd->kernel_diffuse_residual);
 
   dt_opencl_free_kernel(gd->kernel_filmic_bspline_vertical);
   dt_opencl_free_kernel(gd->kernel_filmic_bspline_horizontal);
@@ -1777,6 +1882,17 @@ void gui_init(dt_iop_module_t *self)
        "if you plan on sharpening or inpainting, \n"
        "more iterations help reconstruction."));
 
+  g->tolerance = dt_bauhaus_slider_from_params(self, "tolerance");
+  dt_bauhaus_slider_set_soft_range(g->tolerance, 0., 0.01);
+  dt_bauhaus_slider_set_digits(g->tolerance, 3);
+  dt_bauhaus_slider_set_format(g->tolerance, "%");
+  gtk_widget_set_tooltip_text
+    (g->tolerance,
+     _("stop iterating once an iteration changes the image\n"
+       "by less than this fraction on average.\n"
+       "this speeds up presets with many iterations.\n"
+       "zero always runs all the iterations."));
+
   g->radius_center = dt_bauhaus_slider_from_params(self, "radius_center");
   dt_bauhaus_slider_set_soft_range(g->radius_center, 0., 512.);
   dt_bauhaus_slider_set_format(g->radius_center, _(" px"));
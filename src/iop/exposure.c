@@ -23,6 +23,8 @@
 #include <string.h>
 
 #include "bauhaus/bauhaus.h"
+#include "common/database.h"
+#include "common/debug.h"
 #include "common/histogram.h"
 #include "common/image_cache.h"
 #include "common/mipmap_cache.h"
@@ -63,6 +65,10 @@ typedef enum dt_spot_mode_t
 // 65536 possible values.
 #define DEFLICKER_BINS_COUNT (UINT16_MAX + 1)
 
+// the deflicker statistics of an image are the raw values at each
+// 1/DEFLICKER_QUANTILES of its histogram, stored in the library
+#define DEFLICKER_QUANTILES 1000
+
 typedef struct dt_iop_exposure_params_t
 {
   dt_iop_exposure_mode_t mode;      // $DEFAULT: EXPOSURE_MODE_MANUAL
@@ -82,8 +88,7 @@ typedef struct dt_iop_exposure_gui_data_t
   GtkWidget *exposure;
   GtkWidget *deflicker_percentile;
   GtkWidget *deflicker_target_level;
-  uint32_t *deflicker_histogram; // used to cache histogram of source file
-  dt_dev_histogram_stats_t deflicker_histogram_stats;
+  uint16_t *deflicker_quantiles; // used to cache the deflicker statistics of source file
   GtkLabel *deflicker_used_EC;
   GtkWidget *compensate_exposure_bias;
   GtkWidget *compensate_hilite_preserv;
@@ -140,7 +145,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_SUPPORTS_BLENDING;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_HALF_FLOAT;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -371,23 +376,62 @@ void reload_defaults(dt_iop_module_t *self)
   d->compensate_hilite_pres = dt_iop_is_first_instance(self->dev->iop, self);
 }
 
-static void _deflicker_prepare_histogram(dt_iop_module_t *self,
-                                         uint32_t **histogram,
-                                         dt_dev_histogram_stats_t *histogram_stats)
+static uint16_t *_deflicker_load_quantiles(const dt_imgid_t imgid)
+{
+  uint16_t *quantiles = NULL;
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "SELECT quantiles"
+     " FROM main.deflicker_stats"
+     " WHERE imgid = ?1",
+     -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+
+  if(sqlite3_step(stmt) == SQLITE_ROW
+     && sqlite3_column_bytes(stmt, 0) == (int)((DEFLICKER_QUANTILES + 1) * sizeof(uint16_t)))
+  {
+    quantiles = g_new(uint16_t, DEFLICKER_QUANTILES + 1);
+    memcpy(quantiles, sqlite3_column_blob(stmt, 0), (DEFLICKER_QUANTILES + 1) * sizeof(uint16_t));
+  }
+  sqlite3_finalize(stmt);
+
+  return quantiles;
+}
+
+static void _deflicker_store_quantiles(const dt_imgid_t imgid,
+                                       const uint16_t *const quantiles)
 {
-  const dt_image_t *img = dt_image_cache_get(self->dev->image_storage.id, 'r');
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "INSERT OR REPLACE INTO main.deflicker_stats (imgid, quantiles)"
+     " VALUES (?1, ?2)",
+     -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 2, quantiles,
+                             (DEFLICKER_QUANTILES + 1) * sizeof(uint16_t), SQLITE_TRANSIENT);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+static uint16_t *_deflicker_compute_quantiles(const dt_imgid_t imgid)
+{
+  const dt_image_t *img = dt_image_cache_get(imgid, 'r');
+  if(!img) return NULL;
   dt_image_t image = *img;
   dt_image_cache_read_release(img);
 
-  if(!img || image.buf_dsc.channels != 1 || image.buf_dsc.datatype != TYPE_UINT16) return;
+  if(image.buf_dsc.channels != 1 || image.buf_dsc.datatype != TYPE_UINT16) return NULL;
 
   dt_mipmap_buffer_t buf;
-  dt_mipmap_cache_get(&buf, self->dev->image_storage.id, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  dt_mipmap_cache_get(&buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
   if(!buf.buf)
   {
     dt_control_log(_("failed to get raw buffer from image `%s'"), image.filename);
     dt_mipmap_cache_release(&buf);
-    return;
+    return NULL;
   }
 
   dt_dev_histogram_collection_params_t histogram_params = { 0 };
@@ -404,15 +448,49 @@ static void _deflicker_prepare_histogram(dt_iop_module_t *self,
   histogram_params.roi = &histogram_roi;
   histogram_params.bins_count = DEFLICKER_BINS_COUNT;
 
-  dt_histogram_helper(&histogram_params, histogram_stats, IOP_CS_RAW, IOP_CS_NONE,
-                      buf.buf, histogram, NULL, FALSE, NULL);
+  uint32_t *histogram = NULL;
+  dt_dev_histogram_stats_t histogram_stats;
+  dt_histogram_helper(&histogram_params, &histogram_stats, IOP_CS_RAW, IOP_CS_NONE,
+                      buf.buf, &histogram, NULL, FALSE, NULL);
 
   dt_mipmap_cache_release(&buf);
+
+  if(histogram == NULL) return NULL;
+
+  // raw value of the first bin where the cumulated count reaches each
+  // quantile, a threshold never reached gives 0
+  uint16_t *quantiles = g_new(uint16_t, DEFLICKER_QUANTILES + 1);
+  size_t n = 0;
+  size_t raw = 0;
+  for(size_t q = 0; q <= DEFLICKER_QUANTILES; q++)
+  {
+    const double thr = (double)histogram_stats.pixels * (double)q / (double)DEFLICKER_QUANTILES;
+    while(raw < histogram_stats.bins_count && (double)(n + histogram[raw]) < thr)
+      n += histogram[raw++];
+    quantiles[q] = raw < histogram_stats.bins_count ? raw : 0;
+  }
+
+  dt_free_align(histogram);
+
+  _deflicker_store_quantiles(imgid, quantiles);
+  dt_print(DT_DEBUG_PIPE, "[exposure] stored deflicker statistics of image %d", imgid);
+  return quantiles;
+}
+
+// the statistics only depend on the raw data, so they are computed
+// once per image and then read back from the library
+static uint16_t *_deflicker_get_quantiles(dt_iop_module_t *self)
+{
+  const dt_imgid_t imgid = self->dev->image_storage.id;
+  uint16_t *quantiles = _deflicker_load_quantiles(imgid);
+  if(quantiles == NULL)
+    quantiles = _deflicker_compute_quantiles(imgid);
+  return quantiles;
 }
 
 /* input: 0 - 65535 (valid range: from black level to white level) */
 /* output: -16 ... 0 */
-static double _raw_to_ev(const uint32_t raw,
+static double _raw_to_ev(const double raw,
                          const uint32_t black_level,
                          const uint32_t white_level)
 {
@@ -420,7 +498,7 @@ static double _raw_to_ev(const uint32_t raw,
 
   // we are working on data without black clipping,
   // so we can get values which are lower than the black level !!!
-  const int64_t raw_val = MAX((int64_t)raw - (int64_t)black_level, 1);
+  const double raw_val = MAX(raw - (double)black_level, 1.0);
 
   const double raw_ev = -log2(raw_max) + log2(raw_val);
 
@@ -430,31 +508,19 @@ static double _raw_to_ev(const uint32_t raw,
 static void _compute_correction(dt_iop_module_t *self,
                                 dt_iop_exposure_params_t *p,
                                 dt_dev_pixelpipe_t *pipe,
-                                const uint32_t *const histogram,
-                                const dt_dev_histogram_stats_t *const histogram_stats,
+                                const uint16_t *const quantiles,
                                 float *correction)
 {
   *correction = EXPOSURE_CORRECTION_UNDEFINED;
 
-  if(histogram == NULL) return;
-
-  const double thr
-      = CLAMP(((double)histogram_stats->pixels * (double)p->deflicker_percentile
-               / (double)100.0), 0.0, (double)histogram_stats->pixels);
-
-  size_t n = 0;
-  uint32_t raw = 0;
-
-  for(size_t i = 0; i < histogram_stats->bins_count; i++)
-  {
-    n += histogram[i];
+  if(quantiles == NULL) return;
 
-    if((double)n >= thr)
-    {
-      raw = i;
-      break;
-    }
-  }
+  // interpolate between the stored quantiles around the percentile
+  const double pos = CLAMP((double)p->deflicker_percentile * DEFLICKER_QUANTILES / 100.0,
+                           0.0, (double)DEFLICKER_QUANTILES);
+  const size_t q = MIN((size_t)pos, DEFLICKER_QUANTILES - 1);
+  const double frac = pos - (double)q;
+  const double raw = (1.0 - frac) * quantiles[q] + frac * quantiles[q + 1];
 
   const double ev
       = _raw_to_ev(raw, (uint32_t)pipe->dsc.rawprepare.raw_black_level,
@@ -478,19 +544,15 @@ static void _process_common_setup(dt_iop_module_t *self,
   {
     if(g)
     {
-      // histogram is precomputed and cached
+      // statistics are cached by the gui
       _compute_correction(self, &d->params, piece->pipe,
-                          g->deflicker_histogram, &g->deflicker_histogram_stats,
-                          &exposure);
+                          g->deflicker_quantiles, &exposure);
     }
     else
     {
-      uint32_t *histogram = NULL;
-      dt_dev_histogram_stats_t histogram_stats;
-      _deflicker_prepare_histogram(self, &histogram, &histogram_stats);
-      _compute_correction(self, &d->params, piece->pipe, histogram,
-                          &histogram_stats, &exposure);
-      dt_free_align(histogram);
+      uint16_t *quantiles = _deflicker_get_quantiles(self);
+      _compute_correction(self, &d->params, piece->pipe, quantiles, &exposure);
+      g_free(quantiles);
     }
 
     // second, show computed correction in UI.
@@ -717,8 +779,8 @@ void gui_update(dt_iop_module_t *self)
 
   dt_iop_gui_leave_critical_section(self);
 
-  dt_free_align(g->deflicker_histogram);
-  g->deflicker_histogram = NULL;
+  g_free(g->deflicker_quantiles);
+  g->deflicker_quantiles = NULL;
 
   gtk_label_set_text(g->deflicker_used_EC, "");
   dt_iop_gui_enter_critical_section(self);
@@ -730,8 +792,7 @@ void gui_update(dt_iop_module_t *self)
     case EXPOSURE_MODE_DEFLICKER:
       _autoexp_disable(self);
       gtk_stack_set_visible_child_name(GTK_STACK(g->mode_stack), "deflicker");
-      _deflicker_prepare_histogram(self, &g->deflicker_histogram,
-                                   &g->deflicker_histogram_stats);
+      g->deflicker_quantiles = _deflicker_get_quantiles(self);
       break;
     case EXPOSURE_MODE_MANUAL:
     default:
@@ -982,8 +1043,8 @@ void gui_changed(dt_iop_module_t *self,
 
   if(w == g->mode)
   {
-    dt_free_align(g->deflicker_histogram);
-    g->deflicker_histogram = NULL;
+    g_free(g->deflicker_quantiles);
+    g->deflicker_quantiles = NULL;
 
     switch(p->mode)
     {
@@ -999,8 +1060,7 @@ void gui_changed(dt_iop_module_t *self,
           break;
         }
         gtk_stack_set_visible_child_name(GTK_STACK(g->mode_stack), "deflicker");
-        _deflicker_prepare_histogram(self, &g->deflicker_histogram,
-                                     &g->deflicker_histogram_stats);
+        g->deflicker_quantiles = _deflicker_get_quantiles(self);
         break;
       case EXPOSURE_MODE_MANUAL:
       default:
@@ -1185,7 +1245,7 @@ void gui_init(dt_iop_module_t *self)
 {
   dt_iop_exposure_gui_data_t *g = IOP_GUI_ALLOC(exposure);
 
-  g->deflicker_histogram = NULL;
+  g->deflicker_quantiles = NULL;
 
   g->mode_stack = GTK_STACK(gtk_stack_new());
   gtk_stack_set_homogeneous(GTK_STACK(g->mode_stack),FALSE);
@@ -1343,8 +1403,8 @@ void gui_cleanup(dt_iop_module_t *self)
   if(darktable.develop->proxy.exposure.module == self)
     darktable.develop->proxy.exposure.module = NULL;
 
-  dt_free_align(g->deflicker_histogram);
-  g->deflicker_histogram = NULL;
+  g_free(g->deflicker_quantiles);
+  g->deflicker_quantiles = NULL;
 
   g_idle_remove_by_data(self);
 }
@@ -312,6 +312,7 @@ typedef struct dt_iop_filmicrgb_data_t
   struct dt_iop_filmic_rgb_spline_t spline DT_ALIGNED_ARRAY;
   dt_noise_distribution_t noise_distribution;
   gboolean enable_highlight_reconstruction;
+  gboolean spline_poly4; // toe and shoulder are both 4th order polynomials, see filmic_v5()
 } dt_iop_filmicrgb_data_t;
 
 
@@ -1079,11 +1080,12 @@ static inline gint mask_clipped_pixels(const float *const restrict in, float *co
 }
 
 
-DT_OMP_DECLARE_SIMD(aligned(in, mask, inpainted:64) uniform(width, height, noise_level, noise_distribution, threshold))
+DT_OMP_DECLARE_SIMD(aligned(in, mask, inpainted:64) uniform(width, height, noise_level, noise_distribution, threshold, roi))
 inline static void inpaint_noise(const float *const in, const float *const mask,
                                  float *const inpainted, const float noise_level, const float threshold,
                                  const dt_noise_distribution_t noise_distribution,
-                                 const size_t width, const size_t height)
+                                 const size_t width, const size_t height,
+                                 const dt_iop_roi_t *const roi)
 {
   // add statistical noise in highlights to fill-in texture
   // this creates "particules" in highlights, that will help the implicit partial derivative equation
@@ -1093,14 +1095,6 @@ inline static void inpaint_noise(const float *const in, const float *const mask,
   for(size_t i = 0; i < height; i++)
     for(size_t j = 0; j < width; j++)
     {
-      // Init random number generator
-      uint32_t DT_ALIGNED_ARRAY state[4]
-        = { splitmix32(j + 1), splitmix32((j + 1) * (i + 3)), splitmix32(1337), splitmix32(666) };
-      xoshiro128plus(state);
-      xoshiro128plus(state);
-      xoshiro128plus(state);
-      xoshiro128plus(state);
-
       // get the mask value in [0 ; 1]
       const size_t idx = i * width + j;
       const size_t index = idx * 4;
@@ -1108,13 +1102,12 @@ inline static void inpaint_noise(const float *const in, const float *const mask,
       const float *const restrict pix_in = DT_IS_ALIGNED_PIXEL(in + index);
       dt_aligned_pixel_t noise = { 0.f };
       dt_aligned_pixel_t sigma = { 0.f };
-      const int DT_ALIGNED_ARRAY flip[4] = { TRUE, FALSE, TRUE, FALSE };
 
       for_each_channel(c,aligned(pix_in))
         sigma[c] = pix_in[c] * noise_level / threshold;
 
-      // create statistical noise
-      dt_noise_generator_simd(noise_distribution, pix_in, sigma, flip, state, noise);
+      // create statistical noise, seeded by the absolute pixel coordinates
+      dt_noise_generator_simd(noise_distribution, roi->x + j, roi->y + i, 1337, pix_in, sigma, noise);
 
       // add noise to input
       dt_aligned_pixel_t pix_out;
@@ -1783,7 +1776,7 @@ static int filmic_v4_prepare_matrices(dt_colormatrix_t input_matrix_trans,
 }
 
 DT_OMP_DECLARE_SIMD(
-  uniform(work_profile, data, spline, norm_min, norm_max, display_black, display_white, type)
+  uniform(work_profile, data, spline, curve, norm_min, norm_max, display_black, display_white, type)
   aligned(pix_in, pix_out:16))
 static inline void norm_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
                                         dt_aligned_pixel_t pix_out,
@@ -1791,6 +1784,7 @@ static inline void norm_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
                                         const dt_iop_order_iccprofile_info_t *const work_profile,
                                         const dt_iop_filmicrgb_data_t *const data,
                                         const dt_iop_filmic_rgb_spline_t spline,
+                                        const dt_iop_filmicrgb_curve_type_t curve[2],
                                         const float norm_min,
                                         const float norm_max,
                                         const float display_black,
@@ -1813,7 +1807,7 @@ static inline void norm_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
   // Filmic S curve on the max RGB
   // Apply the transfer function of the display
   norm = powf(CLAMP(filmic_spline(norm, spline.M1, spline.M2, spline.M3, spline.M4, spline.M5,
-                                        spline.latitude_min, spline.latitude_max, spline.type),
+                                        spline.latitude_min, spline.latitude_max, curve),
                     display_black,
                     display_white),
               data->output_power);
@@ -1823,11 +1817,12 @@ static inline void norm_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
     pix_out[c] = ratios[c] * norm;
 }
 
-DT_OMP_DECLARE_SIMD(uniform(data, spline, display_black, display_white) aligned(pix_in, pix_out:16))
+DT_OMP_DECLARE_SIMD(uniform(data, spline, curve, display_black, display_white) aligned(pix_in, pix_out:16))
 static inline void RGB_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
                                        dt_aligned_pixel_t pix_out,
                                        const dt_iop_filmicrgb_data_t *const data,
                                        const dt_iop_filmic_rgb_spline_t spline,
+                                       const dt_iop_filmicrgb_curve_type_t curve[2],
                                        const float display_black,
                                        const float display_white)
 {
@@ -1837,7 +1832,7 @@ static inline void RGB_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
   for(size_t c = 0; c < 3; c++)
   {
     mapped[c] = filmic_spline(mapped[c], spline.M1, spline.M2, spline.M3, spline.M4, spline.M5,
-                              spline.latitude_min, spline.latitude_max, spline.type);
+                              spline.latitude_min, spline.latitude_max, curve);
   }
   for_each_channel(c,aligned(mapped))
   {
@@ -1876,27 +1871,60 @@ static inline void filmic_chroma_v4(const float *const restrict in,
   const float norm_min = exp_tonemapping_v2(0.f, data->grey_source, data->black_source, data->dynamic_range);
   const float norm_max = exp_tonemapping_v2(1.f, data->grey_source, data->black_source, data->dynamic_range);
 
-  DT_OMP_FOR()
-  for(size_t k = 0; k < 4 * height * width; k += 4)
-  {
-    const float *const restrict pix_in = in + k;
-    dt_aligned_pixel_t pix_out;
-    norm_tone_mapping_v4(pix_in, pix_out, variant, work_profile, data, spline,
-                         norm_min, norm_max, display_black, display_white);
-
-    // Save Ych in Kirk/Filmlight Yrg
-    dt_aligned_pixel_t Ych_original = { 0.f };
-    RGB_to_Ych(pix_in, input_matrix_trans, Ych_original);
-
-    // Get final Ych in Kirk/Filmlight Yrg
-    dt_aligned_pixel_t Ych_final = { 0.f };
-    RGB_to_Ych(pix_out, input_matrix_trans, Ych_final);
+  // instance the loop for each norm so get_pixel_norm() is resolved at compile time
+#define FILMIC_CHROMA_V4_LOOP(norm)                                                                 \
+  DT_OMP_FOR()                                                                                      \
+  for(size_t k = 0; k < 4 * height * width; k += 4)                                                 \
+  {                                                                                                 \
+    const float *const restrict pix_in = in + k;                                                    \
+    dt_aligned_pixel_t pix_out;                                                                     \
+    norm_tone_mapping_v4(pix_in, pix_out, norm, work_profile, data, spline, spline.type,            \
+                         norm_min, norm_max, display_black, display_white);                         \
+                                                                                                    \
+    /* Save Ych in Kirk/Filmlight Yrg */                                                            \
+    dt_aligned_pixel_t Ych_original = { 0.f };                                                      \
+    RGB_to_Ych(pix_in, input_matrix_trans, Ych_original);                                           \
+                                                                                                    \
+    /* Get final Ych in Kirk/Filmlight Yrg */                                                       \
+    dt_aligned_pixel_t Ych_final = { 0.f };                                                         \
+    RGB_to_Ych(pix_out, input_matrix_trans, Ych_final);                                             \
+                                                                                                    \
+    gamut_mapping(Ych_final, Ych_original, pix_out, input_matrix_trans, output_matrix,              \
+                  output_matrix_trans, export_input_matrix_trans, export_output_matrix,             \
+                  export_output_matrix_trans, display_black, display_white, data->saturation,       \
+                  use_output_profile);                                                              \
+    copy_pixel_nontemporal(out + k, pix_out);                                                       \
+  }
 
-    gamut_mapping(Ych_final, Ych_original, pix_out, input_matrix_trans, output_matrix, output_matrix_trans,
-                  export_input_matrix_trans, export_output_matrix, export_output_matrix_trans,
-                  display_black, display_white, data->saturation, use_output_profile);
-    copy_pixel_nontemporal(out + k, pix_out);
+  switch(variant)
+  {
+    case DT_FILMIC_METHOD_MAX_RGB:
+    {
+      FILMIC_CHROMA_V4_LOOP(DT_FILMIC_METHOD_MAX_RGB)
+      break;
+    }
+    case DT_FILMIC_METHOD_LUMINANCE:
+    {
+      FILMIC_CHROMA_V4_LOOP(DT_FILMIC_METHOD_LUMINANCE)
+      break;
+    }
+    case DT_FILMIC_METHOD_POWER_NORM:
+    {
+      FILMIC_CHROMA_V4_LOOP(DT_FILMIC_METHOD_POWER_NORM)
+      break;
+    }
+    case DT_FILMIC_METHOD_EUCLIDEAN_NORM_V2:
+    {
+      FILMIC_CHROMA_V4_LOOP(DT_FILMIC_METHOD_EUCLIDEAN_NORM_V2)
+      break;
+    }
+    default:
+    {
+      FILMIC_CHROMA_V4_LOOP(variant)
+      break;
+    }
   }
+#undef FILMIC_CHROMA_V4_LOOP
   dt_omploop_sfence();	// ensure that nontemporal writes complete before we attempt to read output
 }
 
@@ -1933,7 +1961,7 @@ static inline void filmic_split_v4(const float *const restrict in,
     const float *const restrict pix_in = in + k;
     dt_aligned_pixel_t pix_out;
 
-    RGB_tone_mapping_v4(pix_in, pix_out, data, spline, display_black, display_white);
+    RGB_tone_mapping_v4(pix_in, pix_out, data, spline, spline.type, display_black, display_white);
 
     // Save Ych in Kirk/Filmlight Yrg
     dt_aligned_pixel_t Ych_original = { 0.f };
@@ -1954,6 +1982,9 @@ static inline void filmic_split_v4(const float *const restrict in,
 }
 
 
+// the default curve, both ends 4th order polynomials
+static const dt_iop_filmicrgb_curve_type_t _spline_poly4[2] = { DT_FILMIC_CURVE_POLY_4, DT_FILMIC_CURVE_POLY_4 };
+
 static inline void filmic_v5(const float *const restrict in, float *const restrict out,
                                     const dt_iop_order_iccprofile_info_t *const work_profile,
                                     const dt_iop_order_iccprofile_info_t *const export_profile,
@@ -1979,38 +2010,56 @@ static inline void filmic_v5(const float *const restrict in, float *const restri
   const float norm_min = exp_tonemapping_v2(0.f, data->grey_source, data->black_source, data->dynamic_range);
   const float norm_max = exp_tonemapping_v2(1.f, data->grey_source, data->black_source, data->dynamic_range);
 
-  DT_OMP_FOR()
-  for(size_t k = 0; k < height * width * 4; k += 4)
-  {
-    const float *const restrict pix_in = in + k;
-
-    dt_aligned_pixel_t max_rgb = { 0.f };
-    dt_aligned_pixel_t naive_rgb = { 0.f };
-
-    RGB_tone_mapping_v4(pix_in, naive_rgb, data, spline, display_black, display_white);
-    norm_tone_mapping_v4(pix_in, max_rgb, DT_FILMIC_METHOD_MAX_RGB, work_profile, data,
-                         spline, norm_min, norm_max, display_black, display_white);
-
-    // Mix max RGB with naive RGB
-    dt_aligned_pixel_t pix_out;
-    for_each_channel(c, aligned(pix_out, max_rgb, naive_rgb))
-      pix_out[c] = (0.5f - data->saturation) * naive_rgb[c] + (0.5f + data->saturation) * max_rgb[c];
-
-    // Save Ych in Kirk/Filmlight Yrg
-    dt_aligned_pixel_t Ych_original = { 0.f };
-    RGB_to_Ych(pix_in, input_matrix_trans, Ych_original);
-
-    // Get final Ych in Kirk/Filmlight Yrg
-    dt_aligned_pixel_t Ych_final = { 0.f };
-    RGB_to_Ych(pix_out, input_matrix_trans, Ych_final);
-
-    Ych_final[1] = fminf(Ych_original[1], Ych_final[1]);
+  // instance the loop for the default curve and for both output profile cases, so the
+  // spline type tests and the output profile branch of gamut_mapping() are resolved at
+  // compile time. Any other spline goes through the generic instance.
+#define FILMIC_V5_LOOP(curve, output_profile)                                                       \
+  DT_OMP_FOR()                                                                                      \
+  for(size_t k = 0; k < height * width * 4; k += 4)                                                 \
+  {                                                                                                 \
+    const float *const restrict pix_in = in + k;                                                    \
+                                                                                                    \
+    dt_aligned_pixel_t max_rgb = { 0.f };                                                           \
+    dt_aligned_pixel_t naive_rgb = { 0.f };                                                         \
+                                                                                                    \
+    RGB_tone_mapping_v4(pix_in, naive_rgb, data, spline, curve, display_black, display_white);      \
+    norm_tone_mapping_v4(pix_in, max_rgb, DT_FILMIC_METHOD_MAX_RGB, work_profile, data,             \
+                         spline, curve, norm_min, norm_max, display_black, display_white);          \
+                                                                                                    \
+    /* Mix max RGB with naive RGB */                                                                \
+    dt_aligned_pixel_t pix_out;                                                                     \
+    for_each_channel(c, aligned(pix_out, max_rgb, naive_rgb))                                       \
+      pix_out[c] = (0.5f - data->saturation) * naive_rgb[c] + (0.5f + data->saturation) * max_rgb[c]; \
+                                                                                                    \
+    /* Save Ych in Kirk/Filmlight Yrg */                                                            \
+    dt_aligned_pixel_t Ych_original = { 0.f };                                                      \
+    RGB_to_Ych(pix_in, input_matrix_trans, Ych_original);                                           \
+                                                                                                    \
+    /* Get final Ych in Kirk/Filmlight Yrg */                                                       \
+    dt_aligned_pixel_t Ych_final = { 0.f };                                                         \
+    RGB_to_Ych(pix_out, input_matrix_trans, Ych_final);                                             \
+                                                                                                    \
+    Ych_final[1] = fminf(Ych_original[1], Ych_final[1]);                                            \
+                                                                                                    \
+    gamut_mapping(Ych_final, Ych_original, pix_out, input_matrix_trans, output_matrix,              \
+                  output_matrix_trans, export_input_matrix_trans, export_output_matrix,             \
+                  export_output_matrix_trans, display_black, display_white, 0.0f, output_profile);  \
+    copy_pixel_nontemporal(out + k, pix_out);                                                       \
+  }
 
-    gamut_mapping(Ych_final, Ych_original, pix_out, input_matrix_trans, output_matrix, output_matrix_trans,
-                  export_input_matrix_trans, export_output_matrix, export_output_matrix_trans,
-                  display_black, display_white, 0.0f, use_output_profile);
-    copy_pixel_nontemporal(out + k, pix_out);
+  if(data->spline_poly4 && use_output_profile)
+  {
+    FILMIC_V5_LOOP(_spline_poly4, TRUE)
+  }
+  else if(data->spline_poly4)
+  {
+    FILMIC_V5_LOOP(_spline_poly4, FALSE)
+  }
+  else
+  {
+    FILMIC_V5_LOOP(spline.type, use_output_profile)
   }
+#undef FILMIC_V5_LOOP
   dt_omploop_sfence();	// ensure that nontemporal writes complete before we attempt to read output
 }
 
@@ -2155,7 +2204,7 @@ void process(dt_iop_module_t *self,
     if(inpainted)
     {
       inpaint_noise(in, mask, inpainted, data->noise_level / scale, data->reconstruct_threshold,
-                    data->noise_distribution, roi_out->width, roi_out->height);
+                    data->noise_distribution, roi_out->width, roi_out->height, roi_out);
 
       // diffuse particles with wavelets reconstruction
       // PASS 1 on RGB channels
@@ -2486,7 +2535,8 @@ int process_cl(dt_iop_module_t *self,
     const float noise_level = d->noise_level / scale;
     inpainted = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(float) * 4);
     dt_opencl_set_kernel_args(devid, gd->kernel_filmic_inpaint_noise, 0, CLARG(in), CLARG(mask), CLARG(inpainted),
-      CLARG(width), CLARG(height), CLARG(noise_level), CLARG(d->reconstruct_threshold), CLARG(d->noise_distribution));
+      CLARG(width), CLARG(height), CLARG(noise_level), CLARG(d->reconstruct_threshold), CLARG(d->noise_distribution),
+      CLARG(roi_out->x), CLARG(roi_out->y));
     err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_filmic_inpaint_noise, sizes);
     if(err != CL_SUCCESS) goto error;
 
@@ -3099,6 +3149,8 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
 
   // compute the curves and their LUT
   dt_iop_filmic_rgb_compute_spline(p, &d->spline);
+  d->spline_poly4 = d->spline.type[0] == DT_FILMIC_CURVE_POLY_4
+                    && d->spline.type[1] == DT_FILMIC_CURVE_POLY_4;
 
   if(p->version >= DT_FILMIC_COLORSCIENCE_V4)
     d->saturation = p->saturation / 100.0f;
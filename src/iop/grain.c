@@ -22,6 +22,7 @@
 
 #include "bauhaus/bauhaus.h"
 #include "common/math.h"
+#include "common/opencl.h"
 #include "control/control.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
@@ -48,6 +49,9 @@
 #define GRAIN_LUT_DELTA_MIN 0.0001
 #define GRAIN_LUT_PAPER_GAMMA 1.0
 
+// the simplex noise repeats after 768 units along x and y
+#define GRAIN_NOISE_PERIOD 768.0
+
 DT_MODULE_INTROSPECTION(2, dt_iop_grain_params_t)
 
 
@@ -82,8 +86,15 @@ typedef struct dt_iop_grain_data_t
   float strength;
   float midtones_bias;
   float grain_lut[GRAIN_LUT_SIZE * GRAIN_LUT_SIZE];
+  float *noise;         // noise of the last roi of screen pipes
+  dt_hash_t noise_hash;
 } dt_iop_grain_data_t;
 
+typedef struct dt_iop_grain_global_data_t
+{
+  int kernel_grain;
+} dt_iop_grain_global_data_t;
+
 
 int legacy_params(dt_iop_module_t *self,
                   const void *const old_params,
@@ -313,17 +324,17 @@ static double _simplex_noise(double xin, double yin, double zin)
   return 32.0 * (n0 + n1 + n2 + n3);
 }
 
+// parametrization of octaves to match power spectrum of real grain scans
+static const double octave_f[] = {0.4910, 0.9441, 1.7280};
+static const double octave_a[] = {0.2340, 0.7850, 1.2150};
+
 static double _simplex_2d_noise(double x, double y, double z)
 {
   double total = 0;
 
-  // parametrization of octaves to match power spectrum of real grain scans
-  static const double f[] = {0.4910, 0.9441, 1.7280};
-  static const double a[] = {0.2340, 0.7850, 1.2150};
-
   for(uint32_t octave = 0; octave < 3; octave++)
   {
-    total += (_simplex_noise(x * f[octave] / z, y * f[octave] / z, octave) * a[octave]);
+    total += (_simplex_noise(x * octave_f[octave] / z, y * octave_f[octave] / z, octave) * octave_a[octave]);
   }
   return total;
 }
@@ -427,6 +438,98 @@ static unsigned int _hash_string(char *str)
   return hash;
 }
 
+typedef struct dt_iop_grain_sampling_t
+{
+  double wd;         // shorter side of the full image, the noise is normalized to it
+  double zoom;
+  double scale;
+  double filtermul;  // filter width in normalized coordinates
+  double hash;       // per image offset along x
+  int filter;
+} dt_iop_grain_sampling_t;
+
+static void _get_sampling(dt_iop_grain_sampling_t *smp,
+                          const dt_iop_grain_data_t *data,
+                          dt_dev_pixelpipe_iop_t *piece,
+                          const dt_iop_roi_t *const roi_out)
+{
+  const gboolean fastmode = piece->pipe->type & DT_DEV_PIXELPIPE_FAST;
+  smp->hash = _hash_string(piece->pipe->image.filename) % (int)fmax(roi_out->width * 0.3, 1.0);
+  smp->wd = fminf(piece->buf_in.width, piece->buf_in.height);
+  // double zoom=1.0+(8*(data->scale/100.0));
+  smp->zoom = (1.0 + 8 * data->scale / 100) / 800.0;
+  // in fastpipe mode, skip the downsampling for zoomed-out views
+  smp->filter = !fastmode && fabsf(roi_out->scale - 1.0f) > 0.01f;
+  // filter width depends on world space (i.e. reverse wd norm and roi->scale, as well as buffer input to
+  // pixelpipe iscale)
+  smp->filtermul = piece->iscale / (roi_out->scale * smp->wd);
+  smp->scale = roi_out->scale;
+}
+
+static float _pixel_noise(const dt_iop_grain_sampling_t *smp, const double wx, const double wy)
+{
+  // calculate x, y in a resolution independent way:
+  // wx,wy: worldspace in full image pixel coords
+  // x, y: normalized to shorter side of image, so with pixel aspect = 1.
+  const double x = wx / smp->wd;
+  const double y = wy / smp->wd;
+  const float fib1 = 34.0f, fib2 = 21.0f;
+  const float fib1div2 = fib1 / fib2;
+  const double fib2inv = 1.0 / fib2;
+
+  float noise = 0.0;
+  if(smp->filter)
+  {
+    // if zoomed out a lot, use rank-1 lattice downsampling
+    for(int l = 0; l < fib2; l++)
+    {
+      float px = l / fib2, py = l * fib1div2;
+      py -= (int)py;
+      float dx = px * smp->filtermul, dy = py * smp->filtermul;
+      noise += fib2inv * _simplex_2d_noise(x + dx + smp->hash, y + dy, smp->zoom);
+    }
+  }
+  else
+  {
+    noise = _simplex_2d_noise(x + smp->hash, y, smp->zoom);
+  }
+  return noise;
+}
+
+/* The noise doesn't depend on the image data, so the screen pipes keep the noise of the
+   last roi and only blend it on repeated runs. */
+static const float *_get_noise(dt_dev_pixelpipe_iop_t *piece,
+                               const dt_iop_grain_sampling_t *smp,
+                               const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_grain_data_t *data = piece->data;
+  if(!(piece->pipe->type & DT_DEV_PIXELPIPE_SCREEN) || piece->pipe->tiling)
+    return NULL;
+
+  const int roi[4] = { roi_out->x, roi_out->y, roi_out->width, roi_out->height };
+  dt_hash_t hash = dt_hash(DT_INITHASH, smp, sizeof(dt_iop_grain_sampling_t));
+  hash = dt_hash(hash, roi, sizeof(roi));
+  if(data->noise && data->noise_hash == hash)
+    return data->noise;
+
+  dt_free_align(data->noise);
+  data->noise_hash = DT_INVALID_HASH;
+  data->noise = dt_alloc_align_float((size_t)roi_out->width * roi_out->height);
+  if(!data->noise) return NULL;
+
+  float *const noise = data->noise;
+  DT_OMP_FOR()
+  for(int j = 0; j < roi_out->height; j++)
+  {
+    const double wy = (roi_out->y + j) / smp->scale;
+    for(int i = 0; i < roi_out->width; i++)
+      noise[(size_t)j * roi_out->width + i] = _pixel_noise(smp, (roi_out->x + i) / smp->scale, wy);
+  }
+
+  data->noise_hash = hash;
+  return data->noise;
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -440,56 +543,26 @@ void process(dt_iop_module_t *self,
 
   dt_iop_grain_data_t *data = piece->data;
 
-  unsigned int hash = _hash_string(piece->pipe->image.filename) % (int)fmax(roi_out->width * 0.3, 1.0);
+  dt_iop_grain_sampling_t smp;
+  memset(&smp, 0, sizeof(smp));
+  _get_sampling(&smp, data, piece, roi_out);
+  const float *const cached = _get_noise(piece, &smp, roi_out);
 
-  const gboolean fastmode = piece->pipe->type & DT_DEV_PIXELPIPE_FAST;
   // Apply grain to image
   const float strength = (data->strength / 100.0f);
-  // double zoom=1.0+(8*(data->scale/100.0));
-  const double wd = fminf(piece->buf_in.width, piece->buf_in.height);
-  const double zoom = (1.0 + 8 * data->scale / 100) / 800.0;
-  // in fastpipe mode, skip the downsampling for zoomed-out views
-  const int filter = !fastmode && fabsf(roi_out->scale - 1.0f) > 0.01f;
-  // filter width depends on world space (i.e. reverse wd norm and roi->scale, as well as buffer input to
-  // pixelpipe iscale)
-  const double filtermul = piece->iscale / (roi_out->scale * wd);
-  const float fib1 = 34.0f, fib2 = 21.0f;
-  const float fib1div2 = fib1 / fib2;
-  const double scale = roi_out->scale;	// is only used in double expressions, so avoid conversion
-  const double fib2inv = 1.0 / fib2;
 
   DT_OMP_FOR()
   for(int j = 0; j < roi_out->height; j++)
   {
     float *in = ((float *)ivoid) + (size_t)4 * roi_out->width * j;
     float *out = ((float *)ovoid) + (size_t)4 * roi_out->width * j;
-    const double wy = (roi_out->y + j) / scale;
-    const double y = wy / wd;
-    // y: normalized to shorter side of image, so with pixel aspect = 1.
+    const double wy = (roi_out->y + j) / smp.scale;
 
     for(int i = 0; i < roi_out->width; i++)
     {
-      // calculate x, y in a resolution independent way:
-      // wx,wy: worldspace in full image pixel coords:
-      const double wx = (roi_out->x + i) / scale;
-      // x: normalized to shorter side of image, so with pixel aspect = 1.
-      const double x = wx / wd;
-      float noise = 0.0;
-      if(filter)
-      {
-        // if zoomed out a lot, use rank-1 lattice downsampling
-        for(int l = 0; l < fib2; l++)
-        {
-          float px = l / fib2, py = l * fib1div2;
-          py -= (int)py;
-          float dx = px * filtermul, dy = py * filtermul;
-          noise += fib2inv * _simplex_2d_noise(x + dx + hash, y + dy, zoom);
-        }
-      }
-      else
-      {
-        noise = _simplex_2d_noise(x + hash, y, zoom);
-      }
+      const float noise = cached
+        ? cached[(size_t)j * roi_out->width + i]
+        : _pixel_noise(&smp, (roi_out->x + i) / smp.scale, wy);
 
       out[0] = in[0] + dt_lut_lookup_2d_1c(data->grain_lut, (noise * strength) * GRAIN_LIGHTNESS_STRENGTH_SCALE, in[0] / 100.0f);
       out[1] = in[1];
@@ -501,6 +574,55 @@ void process(dt_iop_module_t *self,
   }
 }
 
+#ifdef HAVE_OPENCL
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_grain_data_t *data = piece->data;
+  dt_iop_grain_global_data_t *gd = self->global_data;
+
+  const int devid = piece->pipe->devid;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+
+  dt_iop_grain_sampling_t smp;
+  memset(&smp, 0, sizeof(smp));
+  _get_sampling(&smp, data, piece, roi_out);
+
+  /* single precision isn't enough for the noise coordinates of a full image, so the origin
+     of each octave is reduced to one period of the noise here */
+  dt_aligned_pixel_t origin_x = { 0.0f }, origin_y = { 0.0f }, step = { 0.0f }, filter_step = { 0.0f };
+  for(int octave = 0; octave < 3; octave++)
+  {
+    const double f = octave_f[octave] / smp.zoom;
+    const double ox = fmod((roi_out->x / smp.scale / smp.wd + smp.hash) * f, GRAIN_NOISE_PERIOD);
+    const double oy = fmod(roi_out->y / smp.scale / smp.wd * f, GRAIN_NOISE_PERIOD);
+    origin_x[octave] = ox < 0.0 ? ox + GRAIN_NOISE_PERIOD : ox;
+    origin_y[octave] = oy < 0.0 ? oy + GRAIN_NOISE_PERIOD : oy;
+    step[octave] = f / (smp.scale * smp.wd);
+    filter_step[octave] = f * smp.filtermul;
+  }
+  const float strength = data->strength / 100.0f;
+
+  cl_int err = DT_OPENCL_DEFAULT_ERROR;
+  cl_mem dev_lut = dt_opencl_copy_host_to_device_constant(devid, sizeof(data->grain_lut), data->grain_lut);
+  if(dev_lut == NULL) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_grain, width, height,
+          CLARG(dev_in), CLARG(dev_out), CLARG(width), CLARG(height), CLARG(dev_lut),
+          CLARG(strength), CLARG(origin_x), CLARG(origin_y), CLARG(step), CLARG(filter_step),
+          CLARG(smp.filter));
+
+error:
+  dt_opencl_release_mem_object(dev_lut);
+  return err;
+}
+#endif
+
 void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe,
                    dt_dev_pixelpipe_iop_t *piece)
 {
@@ -522,6 +644,8 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
 
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_grain_data_t *d = piece->data;
+  dt_free_align(d->noise);
   free(piece->data);
   piece->data = NULL;
 }
@@ -529,6 +653,19 @@ void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelp
 void init_global(dt_iop_module_so_t *self)
 {
   _simplex_noise_init();
+
+  const int program = 46; // grain.cl, from programs.conf
+  dt_iop_grain_global_data_t *gd = malloc(sizeof(dt_iop_grain_global_data_t));
+  self->data = gd;
+  gd->kernel_grain = dt_opencl_create_kernel(program, "grain");
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_grain_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_grain);
+  free(self->data);
+  self->data = NULL;
 }
 
 void gui_init(dt_iop_module_t *self)
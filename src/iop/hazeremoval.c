@@ -69,9 +69,14 @@ typedef struct dt_iop_hazeremoval_params_t
   gboolean adaptive; // $DEFAULT: TRUE
 } dt_iop_hazeremoval_params_t;
 
-// types  dt_iop_hazeremoval_params_t and dt_iop_hazeremoval_data_t are
-// equal, thus no commit_params function needs to be implemented
-typedef dt_iop_hazeremoval_params_t dt_iop_hazeremoval_data_t;
+typedef struct dt_iop_hazeremoval_data_t
+{
+  float strength;
+  float distance;
+  gboolean compatibility_mode;
+  gboolean adaptive;
+  dt_guided_filter_plan_t plan; // guide statistics of the screen pipes
+} dt_iop_hazeremoval_data_t;
 
 typedef struct dt_iop_hazeremoval_gui_data_t
 {
@@ -133,6 +138,20 @@ dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
 }
 
 
+void commit_params(dt_iop_module_t *self,
+                   dt_iop_params_t *p1,
+                   dt_dev_pixelpipe_t *pipe,
+                   dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_hazeremoval_params_t *p = (dt_iop_hazeremoval_params_t *)p1;
+  dt_iop_hazeremoval_data_t *d = piece->data;
+  d->strength = p->strength;
+  d->distance = p->distance;
+  d->compatibility_mode = p->compatibility_mode;
+  d->adaptive = p->adaptive;
+}
+
+
 void init_pipe(dt_iop_module_t *self,
                dt_dev_pixelpipe_t *pipe,
                dt_dev_pixelpipe_iop_t *piece)
@@ -145,6 +164,8 @@ void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_hazeremoval_data_t *d = piece->data;
+  dt_guided_filter_plan_free(&d->plan);
   free(piece->data);
   piece->data = NULL;
 }
@@ -568,7 +589,7 @@ void process(dt_iop_module_t *self,
                                          ivoid, ovoid, roi_in, roi_out))
     return;
   dt_iop_hazeremoval_gui_data_t *const g = self->gui_data;
-  dt_iop_hazeremoval_params_t *d = piece->data;
+  dt_iop_hazeremoval_data_t *d = piece->data;
 
   const int width = roi_in->width;
   const int height = roi_in->height;
@@ -668,9 +689,17 @@ void process(dt_iop_module_t *self,
   // refine the transition map
   dt_box_min(trans_map.data, trans_map.height, trans_map.width, 1, w1);
   gray_image trans_map_filtered = new_gray_image(width, height);
-  // apply guided filter with no clipping
-  guided_filter(img_in.data, trans_map.data, trans_map_filtered.data,
-                width, height, 4, w2, eps, 1.f, -FLT_MAX, FLT_MAX);
+  // apply guided filter with no clipping. the guide is the input, so dragging a slider
+  // of the screen pipes can keep its statistics
+  const gboolean keep_plan = piece->pipe->type & DT_DEV_PIXELPIPE_SCREEN;
+  if(!keep_plan) dt_guided_filter_plan_free(&d->plan);
+  if(keep_plan)
+    guided_filter_planned(&d->plan, dt_dev_pixelpipe_piece_hash(piece, roi_in, FALSE),
+                          img_in.data, trans_map.data, trans_map_filtered.data,
+                          width, height, 4, w2, eps, 1.f, -FLT_MAX, FLT_MAX);
+  else
+    guided_filter(img_in.data, trans_map.data, trans_map_filtered.data,
+                  width, height, 4, w2, eps, 1.f, -FLT_MAX, FLT_MAX);
 
   // finally, calculate the haze-free image, minimum allowed value for transition map
   const float t_min = CLAMP(expf(-distance * distance_max), 1.0f / 1024.0f, 1.0f);
@@ -827,7 +856,8 @@ void tiling_callback(dt_iop_module_t *self,
                      const dt_iop_roi_t *roi_out,
                      dt_develop_tiling_t *tiling)
 {
-  tiling->factor = 2.5f;  // in + out + two single-channel temp buffers
+  // in + out + two single-channel temp buffers, plus the guided filter plan of the screen pipes
+  tiling->factor = (piece->pipe->type & DT_DEV_PIXELPIPE_SCREEN) ? 5.75f : 2.5f;
   tiling->factor_cl = 5.0f;
   tiling->maxbuf = 1.0f;
   tiling->maxbuf_cl = 1.0f;
@@ -845,7 +875,7 @@ int process_cl(dt_iop_module_t *self,
                const dt_iop_roi_t *const roi_out)
 {
   dt_iop_hazeremoval_gui_data_t *const g = (dt_iop_hazeremoval_gui_data_t*)self->gui_data;
-  dt_iop_hazeremoval_params_t *d = piece->data;
+  dt_iop_hazeremoval_data_t *d = piece->data;
 
   const int devid = piece->pipe->devid;
   const int width = roi_in->width;
@@ -825,6 +825,41 @@ static void process_visualize(dt_dev_pixelpipe_iop_t *piece,
   }
 }
 
+gboolean raw_pointwise(dt_iop_module_t *self,
+                       dt_dev_pixelpipe_iop_t *piece,
+                       dt_iop_raw_pointwise_t *op,
+                       const dt_iop_roi_t *const roi_in,
+                       const dt_iop_roi_t *const roi_out)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  const dt_iop_highlights_data_t *d = piece->data;
+  const uint32_t filters = pipe->image.buf_dsc.filters;
+
+  if(!filters || filters == 9u
+     || d->mode != DT_IOP_HIGHLIGHTS_CLIP
+     || pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE
+     || dt_iop_piece_is_raster_mask_used(piece, BLEND_RASTER_ID))
+    return FALSE;
+
+  if(!op) return TRUE;
+  if(!op->prepared) return FALSE;
+
+  // same clipping as process_cl() in clip mode
+  const float clip = d->clip * dt_iop_get_processed_minimum(piece);
+  const dt_dev_chroma_t *chr = &self->dev->chroma;
+  dt_aligned_pixel_t clips = { clip, clip, clip, clip };
+  if(chr->late_correction)
+    for_each_channel(c)
+      clips[c] *= chr->as_shot[c] / chr->D65coeffs[c];
+  for_four_channels(c)
+    op->clip[c] = MIN(op->clip[c], clips[c]);
+
+  dt_iop_piece_clear_raster(piece, NULL);
+  const float m = dt_iop_get_processed_maximum(piece);
+  for_three_channels(k) pipe->dsc.processed_maximum[k] = m;
+  return TRUE;
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -339,21 +339,13 @@ static inline void guide_laplacians(const float *const restrict high_freq,
       // Last step of RGB reconstruct : add noise
       if((scale & LAST_SCALE) && salt && alpha > 0.f)
       {
-        // Init random number generator
-        uint32_t DT_ALIGNED_ARRAY state[4] = { splitmix32(j + 1), splitmix32((j + 1) * (i + 3)), splitmix32(1337), splitmix32(666) };
-        xoshiro128plus(state);
-        xoshiro128plus(state);
-        xoshiro128plus(state);
-        xoshiro128plus(state);
-
         dt_aligned_pixel_t noise = { 0.f };
         dt_aligned_pixel_t sigma = { 0.20f };
-        const int DT_ALIGNED_ARRAY flip[4] = { TRUE, FALSE, TRUE, FALSE };
 
         for_each_channel(c,aligned(out, sigma)) sigma[c] = out[index + c] * noise_level;
 
         // create statistical noise
-        dt_noise_generator_simd(DT_NOISE_POISSONIAN, out + index, sigma, flip, state, noise);
+        dt_noise_generator_simd(DT_NOISE_POISSONIAN, j, i, 1337, out + index, sigma, noise);
 
         // Save the noisy interpolated image
         for_each_channel(c,aligned(out, noise: 64))
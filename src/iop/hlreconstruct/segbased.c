@@ -394,11 +394,6 @@ static void _add_poisson_noise(float *lum,
   const int xmax = MIN(seg->xmax[id]+1, seg->width - seg->border);
   const int ymin = MAX(seg->ymin[id], seg->border);
   const int ymax = MIN(seg->ymax[id]+1, seg->height - seg->border);
-  uint32_t DT_ALIGNED_ARRAY state[4] = { splitmix32(ymin), splitmix32(xmin), splitmix32(1337), splitmix32(666) };
-  xoshiro128plus(state);
-  xoshiro128plus(state);
-  xoshiro128plus(state);
-  xoshiro128plus(state);
   for(int row = ymin; row < ymax; row++)
   {
     for(int col = xmin; col < xmax; col++)
@@ -406,7 +401,8 @@ static void _add_poisson_noise(float *lum,
       const size_t v = (size_t)row * seg->width + col;
       if(seg->data[v] == id)
       {
-        const float pnoise = poisson_noise(lum[v] * noise_level, noise_level, col & 1, state);
+        const float pnoise = dt_noise_generator(DT_NOISE_POISSONIAN, col, row, 1337,
+                                                lum[v] * noise_level, noise_level);
         lum[v] += pnoise;
       }
     }
@@ -577,18 +573,8 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
   for(int p = 0; p < HL_RGB_PLANES; p++)
     dt_segments_combine(&isegments[p], d->combine);
 
-  if(dt_get_num_threads() >= HL_RGB_PLANES)
-  {
-    DT_OMP_PRAGMA(parallel num_threads(HL_RGB_PLANES))
-    {
-      dt_segmentize_plane(&isegments[dt_get_thread_num()]);
-    }
-  }
-  else
-  {
-    for(int p = 0; p < HL_RGB_PLANES; p++)
-      dt_segmentize_plane(&isegments[p]);
-  }
+  for(int p = 0; p < HL_RGB_PLANES; p++)
+    dt_segmentize_plane(&isegments[p]);
 
   for(int p = 0; p < HL_RGB_PLANES; p++)
     _calc_plane_candidates(plane[p], refavg[p], &isegments[p], cube_coeffs[p], d->candidating);
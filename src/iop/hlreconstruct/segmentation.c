@@ -21,20 +21,15 @@
 
    Morphological closing operation supporting radius up to 8, tuned for performance
 
-   The segmentation algorithm uses a modified floodfill, while floddfilling it
-   - also takes keeps track of the surrounding rectangle of every segment and
+   The segmentation algorithm uses a parallel connected component labelling of runs, it
+   - also keeps track of the surrounding rectangle of every segment and
    - marks the segment border locations.
 
    Hanno Schwalm 2022/05
 */
 
 #define DT_SEG_ID_MASK 0x40000
-
-typedef struct dt_pos_t
-{
-  int xpos;
-  int ypos;
-} dt_pos_t;
+#define DT_SEG_MIN_STRIP 32 // minimum height of the strips labelled in parallel
 
 typedef struct dt_iop_segmentation_t
 {
@@ -54,26 +49,6 @@ typedef struct dt_iop_segmentation_t
   int height;
 } dt_iop_segmentation_t;
 
-typedef struct dt_ff_stack_t
-{
-  int pos;
-  int size;
-  dt_pos_t *el;
-} dt_ff_stack_t;
-
-static inline void _push_stack(int xpos, int ypos, dt_ff_stack_t *stack)
-{
-  const int i = stack->pos;
-  if(i >= stack->size - 1)
-  {
-    dt_print(DT_DEBUG_ALWAYS, "[segmentation stack overflow] %i", stack->size);
-    return;
-  }
-  stack->el[i].xpos = xpos;
-  stack->el[i].ypos = ypos;
-  stack->pos++;
-}
-
 static inline void _clear_segment_slot(dt_iop_segmentation_t *seg, uint32_t id)
 {
   if(id > seg->slots-1)
@@ -83,15 +58,6 @@ static inline void _clear_segment_slot(dt_iop_segmentation_t *seg, uint32_t id)
   seg->val1[id] = seg->val2[id] = 0.0f;
 }
 
-static inline dt_pos_t * _pop_stack(dt_ff_stack_t *stack)
-{
-  if(stack->pos > 0)
-    stack->pos--;
-  else
-    dt_print(DT_DEBUG_ALWAYS, "[segmentation stack underflow]");
-  return &stack->el[stack->pos];
-}
-
 static inline uint32_t _get_segment_id(dt_iop_segmentation_t *seg, const size_t loc)
 {
   if(loc >= (size_t)(seg->width * (seg->height-seg->border)))
@@ -316,270 +282,354 @@ static inline void _intimage_borderfill(uint32_t *d,
   }
 }
 
-static gboolean _floodfill_segmentize(int yin,
-                                      int xin,
-                                      dt_iop_segmentation_t *seg,
-                                      const int w,
-                                      const int h,
-                                      const int id,
-                                      dt_ff_stack_t *stack)
+/* The segmentation works on horizontal runs of locations. The plane is split into strips,
+   the runs of each strip are found and connected (4-connectivity) in parallel, afterwards
+   the strips are merged along their borders. Connected runs are tracked by a union-find
+   with the first run as root so segments are numbered in raster order no matter how many
+   strips we have.
+*/
+typedef struct dt_seg_run_t
 {
-  if(id >= seg->slots - 2) return FALSE;
+  int row;
+  int start;  // first and last column
+  int end;
+  int parent; // index of the parent run or the negated size for a root, finally the segment id
+} dt_seg_run_t;
 
-  const int border = seg->border;
-  uint32_t *d = seg->data;
-  int xp = 0;
-  int yp = 0;
-  size_t rp = 0;
-  int min_x = xin;
-  int max_x = xin;
-  int min_y = yin;
-  int max_y = yin;
-  int cnt = 0;
-  stack->pos = 0;
-  _clear_segment_slot(seg, id);
-
-  _push_stack(xin, yin, stack);
-  while(stack->pos)
+typedef struct dt_seg_strip_t
+{
+  dt_seg_run_t *run;
+  int count;
+  int alloc;
+  int first;  // index of the first run in the merged list
+  int id;     // first segment id
+  int *mark;  // marked border locations
+  int marks;
+  int mark_alloc;
+} dt_seg_strip_t;
+
+static inline int _run_find(dt_seg_run_t *run, int i)
+{
+  while(run[i].parent >= 0)
   {
-    dt_pos_t *coord = _pop_stack(stack);
-    const int x = coord->xpos;
-    const int y = coord->ypos;
-    if(d[y*w+x] == 1)
-    {
-      int yUp = y - 1, yDown = y + 1;
-      gboolean lastXUp = FALSE, lastXDown = FALSE, firstXUp = FALSE, firstXDown = FALSE;
-      d[y*w+x] = id;
-      cnt++;
-      if(yUp >= border && d[yUp*w+x] == 1)
-      {
-        _push_stack(x, yUp, stack); firstXUp = lastXUp = TRUE;
-      }
-      else
-      {
-        xp = x;
-        yp = yUp;
-        rp = yp*w + xp;
-        if(xp > border+1 && d[rp] == 0)
-        {
-          min_x = MIN(min_x, xp);
-          max_x = MAX(max_x, xp);
-          min_y = MIN(min_y, yp);
-          max_y = MAX(max_y, yp);
-          d[rp] = DT_SEG_ID_MASK | id;
-        }
-      }
+    const int p = run[i].parent;
+    if(run[p].parent >= 0) run[i].parent = run[p].parent;
+    i = p;
+  }
+  return i;
+}
 
-      if(yDown < h-border && d[yDown*w+x] == 1)
-      {
-        _push_stack(x, yDown, stack); firstXDown = lastXDown = TRUE;
-      }
-      else
-      {
-        xp = x;
-        yp = yDown;
-        rp = yp*w + xp;
-        if(yp < h-border-2 && d[rp] == 0)
-        {
-          min_x = MIN(min_x, xp);
-          max_x = MAX(max_x, xp);
-          min_y = MIN(min_y, yp);
-          max_y = MAX(max_y, yp);
-          d[rp] = DT_SEG_ID_MASK | id;
-        }
-      }
+static inline int _run_root(const dt_seg_run_t *run, int i)
+{
+  while(run[i].parent >= 0)
+    i = run[i].parent;
+  return i;
+}
 
-      int xr = x + 1;
-      while(xr < w-border && d[y*w+xr] == 1)
-      {
-        d[y*w+xr] = id;
-        cnt++;
-        if(yUp >= border && d[yUp*w + xr] == 1)
-        {
-          if(!lastXUp) { _push_stack(xr, yUp, stack); lastXUp = TRUE; }
-        }
-        else
-        {
-          xp = xr;
-          yp = yUp;
-          rp = yp*w + xp;
-          if(yp > border+1 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXUp = FALSE;
-        }
-
-        if(yDown < h-border && d[yDown*w+xr] == 1)
-        {
-          if(!lastXDown) { _push_stack(xr, yDown, stack); lastXDown = TRUE; }
-        }
-        else
-        {
-          xp = xr;
-          yp = yDown;
-          rp = yp*w + xp;
-          if(yp < h-border-2 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXDown = FALSE;
-        }
-        xr++;
-      }
+static inline void _run_union(dt_seg_run_t *run, const int a, const int b)
+{
+  const int ra = _run_find(run, a);
+  const int rb = _run_find(run, b);
+  if(ra == rb) return;
+
+  const int root = MIN(ra, rb);
+  const int other = MAX(ra, rb);
+  run[root].parent += run[other].parent;
+  run[other].parent = root;
+}
 
-      xp = xr;
-      yp = y;
-      rp = yp*w + xp;
-      if(xp < w-border-2 && d[rp] == 0)
-      {
-        min_x = MIN(min_x, xp);
-        max_x = MAX(max_x, xp);
-        min_y = MIN(min_y, yp);
-        max_y = MAX(max_y, yp);
-        d[rp] = DT_SEG_ID_MASK | id;
-      }
+// connect the runs first..end-1 of a row to the overlapping runs of the row above
+static inline void _connect_runs(dt_seg_run_t *run,
+                                 int above,
+                                 const int above_end,
+                                 const int first,
+                                 const int end)
+{
+  for(int i = first; i < end; i++)
+  {
+    while(above < above_end && run[above].end < run[i].start)
+      above++;
+    for(int k = above; k < above_end && run[k].start <= run[i].end; k++)
+      _run_union(run, k, i);
+  }
+}
 
-      int xl = x - 1;
-      lastXUp = firstXUp;
-      lastXDown = firstXDown;
-      while(xl >= border && d[y*w+xl] == 1)
-      {
-        d[y*w+xl] = id;
-        cnt++;
-        if(yUp >= border && d[yUp*w+xl] == 1)
-        {
-          if(!lastXUp) { _push_stack(xl, yUp, stack); lastXUp = TRUE; }
-        }
-        else
-        {
-          xp = xl;
-          yp = yUp;
-          rp = yp*w + xp;
-          if(yp > border+1 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXUp = FALSE;
-        }
-
-        if(yDown < h-border && d[yDown*w+xl] == 1)
-        {
-          if(!lastXDown) { _push_stack(xl, yDown, stack); lastXDown = TRUE; }
-        }
-        else
-        {
-          xp = xl;
-          yp = yDown;
-          rp = yp*w + xp;
-          if(yp < h-border-2 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXDown = FALSE;
-        }
-        xl--;
-      }
+// returns TRUE in case of errors
+static gboolean _find_runs(const dt_iop_segmentation_t *seg,
+                           dt_seg_strip_t *strip,
+                           int *rowrun,
+                           const int top,
+                           const int bottom)
+{
+  const int width = seg->width;
+  const int border = seg->border;
 
-      d[y*w+x] = id;
+  for(int row = top; row < bottom; row++)
+  {
+    const int first = rowrun[row] = strip->count;
+    const uint32_t *line = seg->data + (size_t)row * width;
+    for(int col = border; col < width - border; col++)
+    {
+      if(line[col] != 1) continue;
 
-      xp = xl;
-      yp = y;
-      rp = yp*w + xp;
-      if(xp > border+1 && d[rp] == 0)
+      if(strip->count == strip->alloc)
       {
-        min_x = MIN(min_x, xp);
-        max_x = MAX(max_x, xp);
-        min_y = MIN(min_y, yp);
-        max_y = MAX(max_y, yp);
-        d[rp] = DT_SEG_ID_MASK | id;
+        strip->alloc = MAX(256, 2 * strip->alloc);
+        dt_seg_run_t *run = realloc(strip->run, sizeof(dt_seg_run_t) * strip->alloc);
+        if(!run) return TRUE;
+        strip->run = run;
       }
+      const int start = col;
+      while(col < width - border && line[col] == 1) col++;
+      strip->run[strip->count++] = (dt_seg_run_t){ row, start, col - 1, start - col };
     }
+    if(row > top)
+      _connect_runs(strip->run, rowrun[row-1], first, first, strip->count);
   }
+  return FALSE;
+}
 
-  const gboolean success = cnt > 3;
-  if(!success) // To avoid oversegmentizing we only use segments with a minimum size of 4
+// an unsegmented location next to segments gets the lowest of their ids
+static inline gboolean _mark_border(uint32_t *d, dt_seg_strip_t *strip, const size_t loc, const uint32_t id)
+{
+  if(d[loc] == 0)
   {
-    // data in too In any case we want to revert border markings too
-    for(int row = min_y; row <= max_y; row++)
+    if(strip->marks == strip->mark_alloc)
     {
-      for(int col = min_x; col <= max_x; col++)
-      {
-        size_t loc = (size_t)w*row + col;
-        if(d[loc] == id)
-          d[loc] = 1;
-        else if(d[loc] == (id | DT_SEG_ID_MASK))
-          d[loc] = 0;
-      }
+      strip->mark_alloc = MAX(256, 2 * strip->mark_alloc);
+      int *mark = realloc(strip->mark, sizeof(int) * strip->mark_alloc);
+      if(!mark) return TRUE;
+      strip->mark = mark;
     }
+    strip->mark[strip->marks++] = loc;
+    d[loc] = DT_SEG_ID_MASK | id;
   }
-  else
+  else if((d[loc] & DT_SEG_ID_MASK) && (d[loc] & (DT_SEG_ID_MASK-1)) > id)
+    d[loc] = DT_SEG_ID_MASK | id;
+  return FALSE;
+}
+
+// mark the locations next to the runs first..end-1 of a neighbouring row not covered by the runs of this row
+static gboolean _mark_row(uint32_t *d,
+                          dt_seg_strip_t *strip,
+                          const size_t line,
+                          const dt_seg_run_t *run,
+                          const int first,
+                          const int end,
+                          int own,
+                          const int own_end)
+{
+  gboolean failed = FALSE;
+  for(int i = first; i < end; i++)
   {
-    seg->size[id] = cnt;
-    seg->xmin[id] = min_x;
-    seg->xmax[id] = max_x;
-    seg->ymin[id] = min_y;
-    seg->ymax[id] = max_y;
-
-    seg->nr += 1;
-    _clear_segment_slot(seg, id+1);
+    if(run[i].parent < 2) continue;
+    int col = run[i].start;
+    while(col <= run[i].end)
+    {
+      while(own < own_end && run[own].end < col) own++;
+      const gboolean covered = own < own_end && run[own].start <= run[i].end;
+      const int gap_end = covered ? run[own].start - 1 : run[i].end;
+      for(; col <= gap_end; col++)
+        failed |= _mark_border(d, strip, line + col, run[i].parent);
+      if(!covered) break;
+      col = run[own].end + 1;
+    }
   }
-
-  return success;
+  return failed;
 }
 
 // User interface
 void dt_segmentize_plane(dt_iop_segmentation_t *seg)
 {
-  dt_ff_stack_t stack;
   const int width = seg->width;
   const int height = seg->height;
-  stack.size = (size_t)width * height / 32;
-  stack.el = dt_alloc_align_type(dt_pos_t, stack.size);
-  if(!stack.el)
+  const int border = seg->border;
+  uint32_t *d = seg->data;
+
+  const int rows = height - 2 * border;
+  const int nstrips = MAX(1, MIN(dt_get_num_threads(), rows / DT_SEG_MIN_STRIP));
+  const int strip_height = (rows + nstrips - 1) / nstrips;
+
+  dt_seg_strip_t *strip = dt_calloc_align_type(dt_seg_strip_t, nstrips);
+  int *rowrun = dt_alloc_align_int(height + 1);
+  dt_seg_run_t *run = NULL;
+  int nruns = 0;
+  gboolean done = FALSE;
+  if(!strip || !rowrun) goto error;
+
+  gboolean failed = FALSE;
+  DT_OMP_FOR(reduction(| : failed))
+  for(int s = 0; s < nstrips; s++)
   {
-    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] can't allocate segmentation stack");
-    return;
+    const int top = MIN(height - border, border + s * strip_height);
+    const int bottom = MIN(height - border, top + strip_height);
+    failed |= _find_runs(seg, &strip[s], rowrun, top, bottom);
   }
-  const int border = seg->border;
-  int id = 2;
-  for(int row = border; row < height - border; row++)
+  if(failed) goto error;
+
+  for(int s = 0; s < nstrips; s++)
   {
-    for(int col = border; col < width - border; col++)
+    strip[s].first = nruns;
+    nruns += strip[s].count;
+  }
+
+  run = dt_alloc_align_type(dt_seg_run_t, MAX(1, nruns));
+  if(!run) goto error;
+
+  // merge the strips into one list of runs in raster order and connect them along the strip borders
+  DT_OMP_FOR()
+  for(int s = 0; s < nstrips; s++)
+  {
+    const int first = strip[s].first;
+    for(int i = 0; i < strip[s].count; i++)
     {
-      if(id >= (seg->slots - 2))
-        goto finish;
-      if(seg->data[(size_t)width * row + col] == 1)
-      {
-        if(_floodfill_segmentize(row, col, seg, width, height, id, &stack))
-          id++;
-      }
+      run[first + i] = strip[s].run[i];
+      if(run[first + i].parent >= 0) run[first + i].parent += first;
     }
+    const int top = MIN(height - border, border + s * strip_height);
+    const int bottom = MIN(height - border, top + strip_height);
+    for(int row = top; row < bottom; row++)
+      rowrun[row] += first;
   }
+  rowrun[height - border] = nruns;
 
-  finish:
+  for(int s = 1; s < nstrips; s++)
+  {
+    const int row = border + s * strip_height;
+    if(row < height - border)
+      _connect_runs(run, rowrun[row-1], rowrun[row], rowrun[row], rowrun[row+1]);
+  }
 
-  if(id >= (seg->slots - 2))
+  /* number the segments in raster order. To avoid oversegmentizing we only use segments
+     with a minimum size of 4, the locations of smaller ones stay at 1 */
+  DT_OMP_FOR()
+  for(int s = 0; s < nstrips; s++)
+  {
+    int cnt = 0;
+    for(int i = strip[s].first; i < strip[s].first + strip[s].count; i++)
+      if(run[i].parent < -3) cnt++;
+    strip[s].id = cnt;
+  }
+
+  const int limit = seg->slots - 2;
+  int nr = 2;
+  for(int s = 0; s < nstrips; s++)
+  {
+    const int cnt = strip[s].id;
+    strip[s].id = nr;
+    nr += cnt;
+  }
+  if(nr >= limit)
     dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] %ix%i number of segments exceeds maximum=%i",
              (int)width, (int)height, seg->slots);
 
-  dt_free_align(stack.el);
+  DT_OMP_FOR()
+  for(int s = 0; s < nstrips; s++)
+  {
+    int id = strip[s].id;
+    for(int i = strip[s].first; i < strip[s].first + strip[s].count; i++)
+    {
+      if(run[i].parent < 0)
+        run[i].parent = (run[i].parent < -3 && id < limit) ? -(id++) : -1;
+    }
+  }
+
+  // write the segment ids, the strip copies of the runs keep them until all roots are resolved
+  DT_OMP_FOR()
+  for(int s = 0; s < nstrips; s++)
+  {
+    for(int i = 0; i < strip[s].count; i++)
+    {
+      const dt_seg_run_t *r = &run[strip[s].first + i];
+      const int id = -run[_run_root(run, strip[s].first + i)].parent;
+      strip[s].run[i].parent = id;
+      uint32_t *line = d + (size_t)r->row * width;
+      for(int col = r->start; col <= r->end; col++)
+        line[col] = id;
+    }
+  }
+
+  DT_OMP_FOR()
+  for(int s = 0; s < nstrips; s++)
+  {
+    for(int i = 0; i < strip[s].count; i++)
+      run[strip[s].first + i].parent = strip[s].run[i].parent;
+  }
+
+  // mark the segment borders, each strip only writes to its own rows
+  DT_OMP_FOR(reduction(| : failed))
+  for(int s = 0; s < nstrips; s++)
+  {
+    const int top = MIN(height - border, border + s * strip_height);
+    const int bottom = MIN(height - border, top + strip_height);
+    for(int row = top; row < bottom; row++)
+    {
+      const size_t line = (size_t)row * width;
+      if(row > border && row < height - border - 2)
+        failed |= _mark_row(d, &strip[s], line, run, rowrun[row-1], rowrun[row], rowrun[row], rowrun[row+1]);
+      if(row > border + 1 && row < height - border - 1)
+        failed |= _mark_row(d, &strip[s], line, run, rowrun[row+1], rowrun[row+2], rowrun[row], rowrun[row+1]);
+      for(int i = rowrun[row]; i < rowrun[row+1]; i++)
+      {
+        if(run[i].parent < 2) continue;
+        if(run[i].start - 1 > border + 1)
+          failed |= _mark_border(d, &strip[s], line + run[i].start - 1, run[i].parent);
+        if(run[i].end + 1 < width - border - 2)
+          failed |= _mark_border(d, &strip[s], line + run[i].end + 1, run[i].parent);
+      }
+    }
+  }
+  if(failed) goto error;
+
+  nr = MIN(nr, limit);
+  for(int id = 2; id < nr; id++)
+  {
+    _clear_segment_slot(seg, id);
+    seg->xmin[id] = seg->ymin[id] = INT_MAX;
+    seg->xmax[id] = seg->ymax[id] = INT_MIN;
+  }
+  _clear_segment_slot(seg, nr);
+
+  // size and surrounding rectangle of every segment including its marked border
+  for(int i = 0; i < nruns; i++)
+  {
+    const int id = run[i].parent;
+    if(id < 2) continue;
+
+    seg->size[id] += run[i].end - run[i].start + 1;
+    seg->xmin[id] = MIN(seg->xmin[id], run[i].start);
+    seg->xmax[id] = MAX(seg->xmax[id], run[i].end);
+    seg->ymin[id] = MIN(seg->ymin[id], run[i].row);
+    seg->ymax[id] = MAX(seg->ymax[id], run[i].row);
+  }
+  for(int s = 0; s < nstrips; s++)
+  {
+    for(int i = 0; i < strip[s].marks; i++)
+    {
+      const int loc = strip[s].mark[i];
+      const int id = d[loc] & (DT_SEG_ID_MASK-1);
+      const int row = loc / width;
+      const int col = loc - row * width;
+      seg->xmin[id] = MIN(seg->xmin[id], col);
+      seg->xmax[id] = MAX(seg->xmax[id], col);
+      seg->ymin[id] = MIN(seg->ymin[id], row);
+      seg->ymax[id] = MAX(seg->ymax[id], row);
+    }
+  }
+  seg->nr = nr;
+  done = TRUE;
+
+  error:
+  if(!done)
+    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] can't allocate segmentation data");
+  for(int s = 0; strip && s < nstrips; s++)
+  {
+    free(strip[s].run);
+    free(strip[s].mark);
+  }
+  dt_free_align(strip);
+  dt_free_align(rowrun);
+  dt_free_align(run);
 }
 
 void dt_segments_combine(dt_iop_segmentation_t *seg, const int radius)
@@ -18,10 +18,12 @@
 
 #include "bauhaus/bauhaus.h"
 #include "common/imagebuf.h"
+#include "common/opencl.h"
 #include "control/control.h"
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
+#include "develop/tiling.h"
 #include "dtgtk/resetlabel.h"
 #include "gui/accelerators.h"
 #include "gui/gtk.h"
@@ -60,6 +62,20 @@ typedef struct dt_iop_hotpixels_data_t
   gboolean pure_monochrome;
 } dt_iop_hotpixels_data_t;
 
+typedef struct dt_iop_hotpixels_global_data_t
+{
+  int kernel_hotpixels_detect;
+  int kernel_hotpixels_write_output;
+} dt_iop_hotpixels_global_data_t;
+
+// keep in sync with data/kernels/hotpixels.cl
+typedef enum dt_iop_hotpixels_mode_t
+{
+  DT_HOTPIXELS_BAYER = 0,
+  DT_HOTPIXELS_XTRANS = 1,
+  DT_HOTPIXELS_MONOCHROME = 2
+} dt_iop_hotpixels_mode_t;
+
 
 const char *name()
 {
@@ -203,9 +219,9 @@ static int process_monochrome(const dt_iop_hotpixels_data_t *data,
           if(markfixed)
           {
             for(int i = -1; i >= -10 && i >= -col; i -= 1)
-              for(int c = 0; c < planes; c++) out[4*i + c] = *in;
+              for(int c = 0; c < planes; c++) out[planes*i + c] = *in;
             for(int i = 1; i <= 10 && i < width - col; i++)
-              for(int c = 0; c < planes; c++) out[4*i + c] = *in;
+              for(int c = 0; c < planes; c++) out[planes*i + c] = *in;
           }
         }
       }
@@ -214,14 +230,12 @@ static int process_monochrome(const dt_iop_hotpixels_data_t *data,
   return fixed;
 }
 
-/* X-Trans sensor equivalent of process_bayer(). */
-static int process_xtrans(const dt_iop_hotpixels_data_t *data,
-                          const void *const ivoid, void *const ovoid,
-                          const dt_iop_roi_t *const roi_out, const uint8_t (*const xtrans)[6])
+/* for each cell of sensor array, pre-calculate, a list of the x/y
+ * offsets of the four radially nearest pixels of the same color */
+static void _xtrans_offsets(int offsets[6][6][4][2],
+                            const dt_iop_roi_t *const roi_out,
+                            const uint8_t (*const xtrans)[6])
 {
-  // for each cell of sensor array, pre-calculate, a list of the x/y
-  // offsets of the four radially nearest pixels of the same color
-  int offsets[6][6][4][2];
   // increasing offsets from pixel to find nearest like-colored pixels
   const int search[20][2] = { { -1, 0 },
                               { 1, 0 },
@@ -259,6 +273,15 @@ static int process_xtrans(const dt_iop_hotpixels_data_t *data,
       }
     }
   }
+}
+
+/* X-Trans sensor equivalent of process_bayer(). */
+static int process_xtrans(const dt_iop_hotpixels_data_t *data,
+                          const void *const ivoid, void *const ovoid,
+                          const dt_iop_roi_t *const roi_out, const uint8_t (*const xtrans)[6])
+{
+  int offsets[6][6][4][2];
+  _xtrans_offsets(offsets, roi_out, xtrans);
 
   const float threshold = data->threshold;
   const float multiplier = data->multiplier;
@@ -352,6 +375,111 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   }
 }
 
+void tiling_callback(dt_iop_module_t *self,
+                     dt_dev_pixelpipe_iop_t *piece,
+                     const dt_iop_roi_t *roi_in,
+                     const dt_iop_roi_t *roi_out,
+                     dt_develop_tiling_t *tiling)
+{
+  // in, out and the map of the fixed pixels on the GPU
+  const dt_iop_hotpixels_data_t *data = piece->data;
+  tiling->factor = 2.0f;
+  tiling->factor_cl = data->pure_monochrome ? 2.25f : 3.0f;
+  tiling->maxbuf = 1.0f;
+  tiling->maxbuf_cl = 1.0f;
+  tiling->overhead = 0;
+  tiling->overlap = 2;
+  tiling->xalign = 1;
+  tiling->yalign = 1;
+}
+
+#ifdef HAVE_OPENCL
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_hotpixels_gui_data_t *g = self->gui_data;
+  const dt_iop_hotpixels_data_t *data = piece->data;
+  const dt_iop_hotpixels_global_data_t *gd = self->global_data;
+
+  const int devid = piece->pipe->devid;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const gboolean xtrans = piece->pipe->dsc.filters == 9u;
+  const int mode = data->monochrome || data->pure_monochrome
+    ? DT_HOTPIXELS_MONOCHROME
+    : (xtrans ? DT_HOTPIXELS_XTRANS : DT_HOTPIXELS_BAYER);
+  const float threshold = data->threshold;
+  const float multiplier = data->multiplier;
+  const int min_neighbours = data->permissive ? 3 : 4;
+  const int markfixed = data->markfixed;
+  const int rx = roi_out->x;
+  const int ry = roi_out->y;
+
+  int offsets[6][6][4][2] = { { { { 0 } } } };
+  if(mode == DT_HOTPIXELS_XTRANS)
+    _xtrans_offsets(offsets, roi_out, (const uint8_t(*const)[6])piece->pipe->dsc.xtrans);
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  int fixed = 0;
+  cl_mem dev_offsets = dt_opencl_copy_host_to_device_constant(devid, sizeof(offsets), offsets);
+  cl_mem dev_xtrans = dt_opencl_copy_host_to_device_constant(devid, sizeof(piece->pipe->dsc.xtrans),
+                                                             piece->pipe->dsc.xtrans);
+  cl_mem dev_count = dt_opencl_alloc_device_buffer(devid, sizeof(int));
+  cl_mem dev_fixed = dt_opencl_alloc_device_buffer(devid, sizeof(float) * width * height);
+  if(!dev_offsets || !dev_xtrans || !dev_count || !dev_fixed) goto finish;
+
+  err = dt_opencl_write_buffer_to_device(devid, &fixed, dev_count, 0, sizeof(int), CL_TRUE);
+  if(err != CL_SUCCESS) goto finish;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_hotpixels_detect, width, height,
+          CLARG(dev_in), CLARG(dev_fixed), CLARG(dev_count), CLARG(width), CLARG(height),
+          CLARG(mode), CLARG(threshold), CLARG(multiplier), CLARG(min_neighbours),
+          CLARG(dev_offsets));
+  if(err != CL_SUCCESS) goto finish;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_hotpixels_write_output, width, height,
+          CLARG(dev_in), CLARG(dev_out), CLARG(dev_fixed), CLARG(width), CLARG(height),
+          CLARG(mode), CLARG(markfixed), CLARG(rx), CLARG(ry), CLARG(dev_xtrans));
+  if(err != CL_SUCCESS) goto finish;
+
+  if(g != NULL && self->dev->gui_attached && (piece->pipe->type & DT_DEV_PIXELPIPE_FULL))
+  {
+    err = dt_opencl_read_buffer_from_device(devid, &fixed, dev_count, 0, sizeof(int), CL_TRUE);
+    if(err != CL_SUCCESS) goto finish;
+    g->pixels_fixed = fixed;
+  }
+
+finish:
+  dt_opencl_release_mem_object(dev_offsets);
+  dt_opencl_release_mem_object(dev_xtrans);
+  dt_opencl_release_mem_object(dev_count);
+  dt_opencl_release_mem_object(dev_fixed);
+  return err;
+}
+#endif
+
+void init_global(dt_iop_module_so_t *self)
+{
+  const int program = 43; // hotpixels.cl, from programs.conf
+  dt_iop_hotpixels_global_data_t *gd = malloc(sizeof(dt_iop_hotpixels_global_data_t));
+  self->data = gd;
+  gd->kernel_hotpixels_detect = dt_opencl_create_kernel(program, "hotpixels_detect");
+  gd->kernel_hotpixels_write_output = dt_opencl_create_kernel(program, "hotpixels_write_output");
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_hotpixels_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_hotpixels_detect);
+  dt_opencl_free_kernel(gd->kernel_hotpixels_write_output);
+  free(self->data);
+  self->data = NULL;
+}
+
 void reload_defaults(dt_iop_module_t *self)
 {
   const dt_image_t *img = &self->dev->image_storage;
@@ -43,6 +43,7 @@ struct dt_dev_pixelpipe_iop_t;
 struct dt_iop_roi_t;
 struct dt_develop_tiling_t;
 struct dt_iop_buffer_dsc_t;
+struct dt_iop_raw_pointwise_t;
 struct _GtkWidget;
 
 #ifndef DT_IOP_PARAMS_T
@@ -289,8 +290,28 @@ DEFAULT(int, process_tiling_cl, struct dt_iop_module_t *self,
                                 const struct dt_iop_roi_t *const roi_in,
                                 const struct dt_iop_roi_t *const roi_out,
                                 const int bpp);
+/** finish a fused run of raw_pointwise() modules, dev_in is the unprocessed
+ *  raw mosaic and roi_in the mosaic as the module would get it. */
+OPTIONAL(int, process_raw_fused_cl, struct dt_iop_module_t *self,
+                                    struct dt_dev_pixelpipe_iop_t *piece,
+                                    cl_mem dev_in,
+                                    cl_mem dev_out,
+                                    const struct dt_iop_roi_t *const roi_in,
+                                    const struct dt_iop_roi_t *const roi_out,
+                                    const struct dt_iop_raw_pointwise_t *const op);
 #endif
 
+/** describe the module's effect on a bayer mosaic as part of op instead of
+ *  processing it, updating pipe->dsc like process() would. With op == NULL
+ *  only tell whether the current parameters can be described this way.
+ *  A module providing process_raw_fused_cl() only tells if it can finish
+ *  the fused run. */
+OPTIONAL(gboolean, raw_pointwise, struct dt_iop_module_t *self,
+                                  struct dt_dev_pixelpipe_iop_t *piece,
+                                  struct dt_iop_raw_pointwise_t *op,
+                                  const struct dt_iop_roi_t *const roi_in,
+                                  const struct dt_iop_roi_t *const roi_out);
+
 /** this functions are used for distort iop
  * points is an array of float {x1,y1,x2,y2,...}
  * size is 2*points_count */
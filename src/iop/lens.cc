@@ -223,6 +223,16 @@ typedef struct dt_iop_lens_data_t
   gboolean do_nan_checks;
   gboolean tca_override;
   lfLensCalibTCA custom_tca;
+  dt_hash_t lf_hash;
+
+  /* cached Lensfun coordinates of the last roi, see _get_distortion_map() */
+  float *distmap;
+  dt_hash_t distmap_hash;
+#ifdef HAVE_OPENCL
+  cl_mem dev_distmap;
+  int distmap_devid;
+  dt_hash_t dev_distmap_hash;
+#endif
 
   /* embedded metadata data */
   float cor_dist_ft;
@@ -280,7 +290,7 @@ int operation_tags()
 int flags()
 {
   return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_TILING_FULL_ROI
-    | IOP_FLAGS_UNSAFE_COPY | IOP_FLAGS_GUIDES_WIDGET;
+    | IOP_FLAGS_UNSAFE_COPY | IOP_FLAGS_GUIDES_WIDGET | IOP_FLAGS_GLOBAL_DEFAULTS;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -1041,6 +1051,55 @@ static float _get_autoscale_lf(dt_iop_module_t *self,
   return scale;
 }
 
+/* The subpixel coordinates only depend on the correction parameters and
+ * the roi, so for the screen pipes they are computed once and kept in the
+ * piece data. Repeated runs of the pipe then only do the gather. Returns
+ * NULL if the map is not cached, the caller computes the coordinates row
+ * by row then. */
+static const float *_get_distortion_map(dt_dev_pixelpipe_iop_t *piece,
+                                        const lfModifier *modifier,
+                                        const dt_hash_t hash,
+                                        const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_lens_data_t *d = (dt_iop_lens_data_t *)piece->data;
+
+  // tiles have different rois on each run and exports run once
+  if(!(piece->pipe->type & DT_DEV_PIXELPIPE_SCREEN) || piece->pipe->tiling)
+    return NULL;
+
+  if(d->distmap && d->distmap_hash == hash)
+    return d->distmap;
+
+  dt_free_align(d->distmap);
+  d->distmap_hash = DT_INVALID_HASH;
+
+  const int width = roi_out->width;
+  d->distmap = dt_alloc_align_float((size_t)width * roi_out->height * 2 * 3);
+  if(!d->distmap) return NULL;
+
+  float *const map = d->distmap;
+  DT_OMP_FOR(shared(modifier))
+  for(int y = 0; y < roi_out->height; y++)
+    modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, width, 1,
+                                              map + (size_t)y * width * 2 * 3);
+
+  d->distmap_hash = hash;
+  return d->distmap;
+}
+
+static dt_hash_t _distortion_map_hash(const dt_iop_lens_data_t *d,
+                                      const float orig_w,
+                                      const float orig_h,
+                                      const int used_lf_mask,
+                                      const dt_iop_roi_t *const roi_out)
+{
+  const int roi[4] = { roi_out->x, roi_out->y, roi_out->width, roi_out->height };
+  dt_hash_t hash = dt_hash(d->lf_hash, roi, sizeof(roi));
+  hash = dt_hash(hash, &orig_w, sizeof(orig_w));
+  hash = dt_hash(hash, &orig_h, sizeof(orig_h));
+  return dt_hash(hash, &used_lf_mask, sizeof(used_lf_mask));
+}
+
 static void _process_lf(dt_iop_module_t *self,
                         dt_dev_pixelpipe_iop_t *piece,
                         const void *const ivoid,
@@ -1093,18 +1152,30 @@ static void _process_lf(dt_iop_module_t *self,
                    | LF_MODIFY_GEOMETRY
                    | LF_MODIFY_SCALE))
     {
+      const float *const map =
+        _get_distortion_map(piece, modifier,
+                            _distortion_map_hash(d, orig_w, orig_h, used_lf_mask, roi_out),
+                            roi_out);
+
       // acquire temp memory for distorted pixel coords
       const size_t bufsize = (size_t)roi_out->width * 2 * 3;
 
       size_t padded_bufsize;
-      float *const buf = dt_alloc_perthread_float(bufsize, &padded_bufsize);
+      float *const buf = map ? NULL : dt_alloc_perthread_float(bufsize, &padded_bufsize);
 
-      DT_OMP_FOR(dt_omp_sharedconst(buf) shared(modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(buf, map) shared(modifier))
       for(int y = 0; y < roi_out->height; y++)
       {
-        float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                                  roi_out->width, 1, bufptr);
+        const float *bufptr;
+        if(map)
+          bufptr = map + (size_t)y * bufsize;
+        else
+        {
+          float *rowptr = (float*)dt_get_perthread(buf, padded_bufsize);
+          modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
+                                                    roi_out->width, 1, rowptr);
+          bufptr = rowptr;
+        }
 
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
@@ -1204,19 +1275,31 @@ static void _process_lf(dt_iop_module_t *self,
                    | LF_MODIFY_GEOMETRY
                    | LF_MODIFY_SCALE))
     {
+      const float *const map =
+        _get_distortion_map(piece, modifier,
+                            _distortion_map_hash(d, orig_w, orig_h, used_lf_mask, roi_out),
+                            roi_out);
+
       // acquire temp memory for distorted pixel coords
       const size_t buf2size = (size_t)roi_out->width * 2 * 3;
       size_t padded_buf2size;
-      float *const buf2 = dt_alloc_perthread_float(buf2size, &padded_buf2size);
+      float *const buf2 = map ? NULL : dt_alloc_perthread_float(buf2size, &padded_buf2size);
 
-      DT_OMP_FOR(dt_omp_sharedconst(buf2) shared(buf, modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(buf2, map) shared(buf, modifier))
       for(int y = 0; y < roi_out->height; y++)
       {
-        float *buf2ptr = (float*)dt_get_perthread(buf2, padded_buf2size);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width,
-                                                  1, buf2ptr);
+        const float *buf2ptr;
+        if(map)
+          buf2ptr = map + (size_t)y * buf2size;
+        else
+        {
+          float *rowptr = (float*)dt_get_perthread(buf2, padded_buf2size);
+          modifier->ApplySubpixelGeometryDistortion(roi_out->x,
+                                                    roi_out->y + y,
+                                                    roi_out->width,
+                                                    1, rowptr);
+          buf2ptr = rowptr;
+        }
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
         for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
@@ -1278,6 +1361,41 @@ static void _process_lf(dt_iop_module_t *self,
 }
 
 #ifdef HAVE_OPENCL
+/* device copy of the cached coordinates, kept as long as the host map is
+ * valid and the pipe runs on the same device */
+static cl_mem _get_dev_distortion_map(dt_dev_pixelpipe_iop_t *piece,
+                                      const lfModifier *modifier,
+                                      const int devid,
+                                      const size_t size,
+                                      const dt_hash_t hash,
+                                      const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_lens_data_t *d = (dt_iop_lens_data_t *)piece->data;
+
+  const float *map = _get_distortion_map(piece, modifier, hash, roi_out);
+  if(map == NULL) return NULL;
+
+  if(d->dev_distmap && d->distmap_devid == devid && d->dev_distmap_hash == hash)
+    return d->dev_distmap;
+
+  dt_opencl_release_mem_object(d->dev_distmap);
+  d->dev_distmap_hash = DT_INVALID_HASH;
+  d->dev_distmap = (cl_mem)dt_opencl_alloc_device_buffer(devid, size);
+  if(d->dev_distmap == NULL) return NULL;
+
+  if(dt_opencl_write_buffer_to_device(devid, (void *)map, d->dev_distmap,
+                                      0, size, CL_TRUE) != CL_SUCCESS)
+  {
+    dt_opencl_release_mem_object(d->dev_distmap);
+    d->dev_distmap = NULL;
+    return NULL;
+  }
+
+  d->distmap_devid = devid;
+  d->dev_distmap_hash = hash;
+  return d->dev_distmap;
+}
+
 static int _process_cl_lf(dt_iop_module_t *self,
                           dt_dev_pixelpipe_iop_t *piece,
                           cl_mem dev_in, cl_mem dev_out,
@@ -1376,26 +1494,34 @@ static int _process_cl_lf(dt_iop_module_t *self,
                    | LF_MODIFY_GEOMETRY
                    | LF_MODIFY_SCALE))
     {
-      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier))
-      for(int y = 0; y < roi_out->height; y++)
+      cl_mem dev_map = _get_dev_distortion_map(piece, modifier, devid, tmpbufsize,
+                                               _distortion_map_hash(d, orig_w, orig_h,
+                                                                    used_lf_mask, roi_out),
+                                               roi_out);
+      if(dev_map == NULL)
       {
-        float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
-      }
+        DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier))
+        for(int y = 0; y < roi_out->height; y++)
+        {
+          float *pi = tmpbuf + (size_t)y * tmpbufwidth;
+          modifier->ApplySubpixelGeometryDistortion(roi_out->x,
+                                                    roi_out->y + y,
+                                                    roi_out->width, 1, pi);
+        }
 
-      err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
-                                             dev_tmpbuf, 0,
-                                             tmpbufsize, CL_TRUE);
-      if(err != CL_SUCCESS) goto error;
+        err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
+                                               dev_tmpbuf, 0,
+                                               tmpbufsize, CL_TRUE);
+        if(err != CL_SUCCESS) goto error;
+        dev_map = dev_tmpbuf;
+      }
 
       err = dt_opencl_enqueue_kernel_2d_args(devid, ldkernel, owidth, oheight,
          CLARG(dev_in), CLARG(dev_tmp),
          CLARG(owidth), CLARG(oheight),
          CLARG(iwidth), CLARG(iheight),
          CLARG(roi_in_x), CLARG(roi_in_y),
-         CLARG(dev_tmpbuf), CLARG((d->do_nan_checks)));
+         CLARG(dev_map), CLARG((d->do_nan_checks)));
       if(err != CL_SUCCESS) goto error;
     }
     else
@@ -1487,19 +1613,27 @@ static int _process_cl_lf(dt_iop_module_t *self,
                    | LF_MODIFY_GEOMETRY
                    | LF_MODIFY_SCALE))
     {
-      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier))
-      for(int y = 0; y < roi_out->height; y++)
+      cl_mem dev_map = _get_dev_distortion_map(piece, modifier, devid, tmpbufsize,
+                                               _distortion_map_hash(d, orig_w, orig_h,
+                                                                    used_lf_mask, roi_out),
+                                               roi_out);
+      if(dev_map == NULL)
       {
-        float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
-      }
+        DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier))
+        for(int y = 0; y < roi_out->height; y++)
+        {
+          float *pi = tmpbuf + (size_t)y * tmpbufwidth;
+          modifier->ApplySubpixelGeometryDistortion(roi_out->x,
+                                                    roi_out->y + y,
+                                                    roi_out->width, 1, pi);
+        }
 
-      err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
-                                             dev_tmpbuf, 0,
-                                             tmpbufsize, CL_TRUE);
-      if(err != CL_SUCCESS) goto error;
+        err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
+                                               dev_tmpbuf, 0,
+                                               tmpbufsize, CL_TRUE);
+        if(err != CL_SUCCESS) goto error;
+        dev_map = dev_tmpbuf;
+      }
 
       err = dt_opencl_enqueue_kernel_2d_args
         (devid, ldkernel, owidth, oheight,
@@ -1507,7 +1641,7 @@ static int _process_cl_lf(dt_iop_module_t *self,
          CLARG(owidth), CLARG(oheight),
          CLARG(iwidth), CLARG(iheight),
          CLARG(roi_in_x), CLARG(roi_in_y),
-         CLARG(dev_tmpbuf), CLARG((d->do_nan_checks)));
+         CLARG(dev_map), CLARG((d->do_nan_checks)));
     }
     else
     {
@@ -1883,6 +2017,7 @@ static void _commit_params_lf(dt_iop_module_t *self,
   d->target_geom = _lenstype_to_lensfun_lenstype(p->target_geom);
   d->do_nan_checks = TRUE;
   d->tca_override = p->tca_override;
+  d->lf_hash = dt_hash(DT_INITHASH, p, sizeof(dt_iop_lens_params_t));
 
   /*
    * there are certain situations when Lensfun can return NAN coordinated.
@@ -3320,6 +3455,10 @@ void cleanup_pipe(dt_iop_module_t *self,
     delete d->lens;
     d->lens = NULL;
   }
+  dt_free_align(d->distmap);
+#ifdef HAVE_OPENCL
+  dt_opencl_release_mem_object(d->dev_distmap);
+#endif
 
   free(piece->data);
   piece->data = NULL;
@@ -258,8 +258,23 @@ typedef struct
 typedef struct
 {
   int warp_kernel;
+  int map_kernel;
 } dt_iop_liquify_global_data_t;
 
+// the rasterized warps of one path segment
+typedef struct dt_liquify_field_t
+{
+  dt_hash_t hash;                  ///< of the warps rasterized into field
+  cairo_rectangle_int_t extent;
+  float complex *field;
+} dt_liquify_field_t;
+
+typedef struct dt_iop_liquify_data_t
+{
+  dt_iop_liquify_params_t params;
+  dt_liquify_field_t fields[MAX_NODES]; ///< kept between runs, see _build_cached_distortion_map()
+} dt_iop_liquify_data_t;
+
 typedef struct
 {
   int node_index; // last node index inserted
@@ -757,6 +772,9 @@ static void interpolate_cubic_bezier(const float complex p0,
   *buf = p3;
 }
 
+static GList *interpolate_node(dt_iop_liquify_params_t *p,
+                               const dt_liquify_path_data_t *data,
+                               GList *l);
 static GList *interpolate_paths(dt_iop_liquify_params_t *p);
 
 /*
@@ -1173,6 +1191,26 @@ static float complex *create_global_distortion_map(const cairo_rectangle_int_t *
   return map;
 }
 
+// the warps of all paths in piece coordinates that are at least partly in roi
+
+static GSList *_get_warps_in_roi(const dt_iop_module_t *self,
+                                 const dt_dev_pixelpipe_iop_t *piece,
+                                 const float scale,
+                                 const dt_iop_roi_t *roi,
+                                 cairo_rectangle_int_t *map_extent,
+                                 GList **interpolated)
+{
+  // copy params
+  dt_iop_liquify_params_t copy_params;
+  const dt_iop_liquify_data_t *d = piece->data;
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
+
+  distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params);
+
+  *interpolated = interpolate_paths(&copy_params);
+  return _get_map_extent(roi, *interpolated, map_extent);
+}
+
 static void _build_global_distortion_map(const dt_iop_module_t *self,
                                          const dt_dev_pixelpipe_iop_t *piece,
                                          const float scale,
@@ -1181,14 +1219,9 @@ static void _build_global_distortion_map(const dt_iop_module_t *self,
                                          const gboolean inverted,
                                          float complex **map)
 {
-  // copy params
-  dt_iop_liquify_params_t copy_params;
-  memcpy(&copy_params, piece->data, sizeof(dt_iop_liquify_params_t));
-
-  distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params);
-
-  GList *interpolated = interpolate_paths(&copy_params);
-  GSList *interpolated_in_roi = _get_map_extent(roi, interpolated, map_extent);
+  GList *interpolated = NULL;
+  GSList *interpolated_in_roi = _get_warps_in_roi(self, piece, scale, roi,
+                                                  map_extent, &interpolated);
 
   if(map)
     *map = create_global_distortion_map(map_extent, interpolated_in_roi, inverted);
@@ -1197,6 +1230,153 @@ static void _build_global_distortion_map(const dt_iop_module_t *self,
   g_list_free_full(interpolated, free);
 }
 
+static void _free_fields(dt_liquify_field_t *fields)
+{
+  for(int k = 0; k < MAX_NODES; k++)
+  {
+    dt_free_align(fields[k].field);
+    fields[k].field = NULL;
+  }
+}
+
+static void _add_field(float complex *map,
+                       const cairo_rectangle_int_t *map_extent,
+                       const dt_liquify_field_t *f)
+{
+  DT_OMP_FOR()
+  for(int y = 0; y < f->extent.height; y++)
+  {
+    const float complex *const restrict src = f->field + (size_t)y * f->extent.width;
+    float complex *const restrict dest = map
+      + (size_t)(y + f->extent.y - map_extent->y) * map_extent->width
+      + f->extent.x - map_extent->x;
+    for(int x = 0; x < f->extent.width; x++)
+      dest[x] += src[x];
+  }
+}
+
+/*
+  Same as _build_global_distortion_map() for the forward map, but the
+  warps of each path segment are rasterized into their own field that is
+  kept in the pipe piece.  The map is the sum of all stamps, so the
+  fields of segments that didn't change since the last run are just
+  added up again and only edited segments are rasterized.
+*/
+
+static float complex *_build_cached_distortion_map(const dt_iop_module_t *self,
+                                                   dt_dev_pixelpipe_iop_t *piece,
+                                                   const float scale,
+                                                   const dt_iop_roi_t *roi,
+                                                   cairo_rectangle_int_t *map_extent)
+{
+  dt_iop_liquify_data_t *d = piece->data;
+  dt_iop_liquify_params_t copy_params;
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
+
+  distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params);
+
+  dt_liquify_field_t fields[MAX_NODES] = { { 0 } };
+  GList *interpolated[MAX_NODES] = { NULL };
+  GSList *in_roi[MAX_NODES] = { NULL };
+  cairo_region_t *map_region = cairo_region_create();
+  int count = 0;
+
+  for(int k = 0; k < MAX_NODES; k++)
+  {
+    const dt_liquify_path_data_t *data = &copy_params.nodes[k];
+    if(data->header.type == DT_LIQUIFY_PATH_INVALIDATED)
+      break;
+
+    interpolated[count] = g_list_reverse(interpolate_node(&copy_params, data, NULL));
+    dt_liquify_field_t *f = &fields[count];
+    in_roi[count] = _get_map_extent(roi, interpolated[count], &f->extent);
+    if(!in_roi[count])
+    {
+      g_list_free_full(interpolated[count], free);
+      interpolated[count] = NULL;
+      continue;
+    }
+
+    // a stamp is centered on the rounded warp point, so allow for one
+    // more pixel than compute_round_stamp_extent() gives
+    f->extent.x--;
+    f->extent.y--;
+    f->extent.width += 2;
+    f->extent.height += 2;
+
+    f->hash = DT_INITHASH;
+    for(const GSList *i = in_roi[count]; i; i = g_slist_next(i))
+      f->hash = dt_hash(f->hash, i->data, sizeof(dt_liquify_warp_t));
+
+    cairo_region_union_rectangle(map_region, &f->extent);
+    count++;
+  }
+
+  cairo_region_get_extents(map_region, map_extent);
+  cairo_region_destroy(map_region);
+
+  const size_t mapsize = (size_t)map_extent->width * map_extent->height;
+  float complex *map = mapsize ? dt_calloc_align_type(float complex, mapsize) : NULL;
+
+  // don't let the cache grow out of bounds with lots of huge warps
+  size_t budget = dt_get_available_mem() / 8;
+
+  for(int k = 0; k < count && map; k++)
+  {
+    dt_liquify_field_t *f = &fields[k];
+    const size_t size = (size_t)f->extent.width * f->extent.height;
+
+    for(int j = 0; j < MAX_NODES && !f->field; j++)
+    {
+      dt_liquify_field_t *old = &d->fields[j];
+      if(old->field && old->hash == f->hash
+         && !memcmp(&old->extent, &f->extent, sizeof(cairo_rectangle_int_t)))
+      {
+        f->field = old->field;
+        old->field = NULL;
+      }
+    }
+
+    if(!f->field)
+    {
+      f->field = dt_calloc_align_type(float complex, size);
+      if(!f->field)
+      {
+        // no memory for caching, rasterize into the map directly
+        for(const GSList *i = in_roi[k]; i; i = g_slist_next(i))
+          apply_round_stamp(i->data, map, map_extent);
+        continue;
+      }
+      for(const GSList *i = in_roi[k]; i; i = g_slist_next(i))
+        apply_round_stamp(i->data, f->field, &f->extent);
+    }
+
+    _add_field(map, map_extent, f);
+
+    const size_t bytes = size * sizeof(float complex);
+    if(bytes <= budget)
+      budget -= bytes;
+    else
+    {
+      dt_free_align(f->field);
+      f->field = NULL;
+    }
+  }
+
+  // drop the fields of changed or deleted segments and keep the current ones
+  _free_fields(d->fields);
+  memcpy(d->fields, fields, sizeof(fields));
+  if(!map) _free_fields(d->fields);
+
+  for(int k = 0; k < count; k++)
+  {
+    g_slist_free(in_roi[k]);
+    g_list_free_full(interpolated[k], free);
+  }
+
+  return map;
+}
+
 void modify_roi_in(dt_iop_module_t *self,
                    dt_dev_pixelpipe_iop_t *piece,
                    const dt_iop_roi_t *roi_out,
@@ -1401,9 +1581,8 @@ void process(dt_iop_module_t *self,
 
   // 2. build the distortion map
   cairo_rectangle_int_t map_extent;
-  float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
+  float complex *map = _build_cached_distortion_map(self, piece, roi_in->scale,
+                                                    roi_out, &map_extent);
   if(map == NULL)
     return;
 
@@ -1454,7 +1633,7 @@ static cl_int_t _apply_global_distortion_map_cl(const dt_iop_module_t *self,
                                                 const cl_mem_t dev_out,
                                                 const dt_iop_roi_t *roi_in,
                                                 const dt_iop_roi_t *roi_out,
-                                                const float complex *map,
+                                                const cl_mem_t dev_map,
                                                 const cairo_rectangle_int_t *map_extent)
 {
   cl_int_t err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
@@ -1503,9 +1682,6 @@ static cl_int_t _apply_global_distortion_map_cl(const dt_iop_module_t *self,
   const cl_mem_t dev_roi_out = dt_opencl_copy_host_to_device_constant
     (devid, sizeof(dt_iop_roi_t), (void *) roi_out);
 
-  const cl_mem_t dev_map = dt_opencl_copy_host_to_device_constant
-    (devid, sizeof(float complex) * map_extent->width * map_extent->height, (void *) map);
-
   const cl_mem_t dev_map_extent = dt_opencl_copy_host_to_device_constant
     (devid, sizeof(cairo_rectangle_int_t), (void *) map_extent);
 
@@ -1517,7 +1693,6 @@ static cl_int_t _apply_global_distortion_map_cl(const dt_iop_module_t *self,
 
   if(dev_roi_in == NULL
      || dev_roi_out == NULL
-     || dev_map == NULL
      || dev_map_extent == NULL
      || dev_kdesc == NULL
      || dev_kernel == NULL)
@@ -1535,7 +1710,6 @@ error:
   dt_opencl_release_mem_object(dev_kernel);
   dt_opencl_release_mem_object(dev_kdesc);
   dt_opencl_release_mem_object(dev_map_extent);
-  dt_opencl_release_mem_object(dev_map);
   dt_opencl_release_mem_object(dev_roi_out);
   dt_opencl_release_mem_object(dev_roi_in);
   if(k) free(k);
@@ -1543,6 +1717,153 @@ error:
   return err;
 }
 
+// must match liquify.cl
+#define LIQUIFY_TILE 64
+
+// a warp as rasterized by liquify_map() in liquify.cl, see apply_round_stamp()
+typedef struct
+{
+  float strength_x, strength_y; ///< linear warps
+  float abs_strength;           ///< radial warps, negative for shrinking
+  int x, y;                     ///< the stamp center
+  int iradius;
+  int type;
+  int lut;                      ///< offset of the lookup table
+  int table_size;
+} dt_liquify_cl_warp_t;
+
+/*
+  Rasterizes the warps into a distortion map on the device.  The map is
+  split into tiles and every map pixel sums up the stamps of the warps
+  touching its tile, in the same order as create_global_distortion_map().
+*/
+
+static cl_int_t _build_global_distortion_map_cl(const dt_iop_module_t *self,
+                                                const dt_dev_pixelpipe_iop_t *piece,
+                                                const GSList *warps,
+                                                const cairo_rectangle_int_t *map_extent,
+                                                cl_mem_t *dev_map)
+{
+  cl_int_t err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+  const dt_iop_liquify_global_data_t *gd = self->global_data;
+  const int devid = piece->pipe->devid;
+
+  const int width = map_extent->width;
+  const int height = map_extent->height;
+  const int tiles_x = (width + LIQUIFY_TILE - 1) / LIQUIFY_TILE;
+  const int tiles_y = (height + LIQUIFY_TILE - 1) / LIQUIFY_TILE;
+  const int nwarps = g_slist_length((GSList *)warps);
+
+  dt_liquify_cl_warp_t *cl_warps = calloc(nwarps, sizeof(dt_liquify_cl_warp_t));
+  int *tile_start = calloc((size_t)tiles_x * tiles_y + 1, sizeof(int));
+  int *tile_fill = calloc((size_t)tiles_x * tiles_y, sizeof(int));
+  int *tile_warps = NULL;
+  float *lut = NULL;
+  cl_mem_t dev_warps = NULL;
+  cl_mem_t dev_lut = NULL;
+  cl_mem_t dev_tile_start = NULL;
+  cl_mem_t dev_tile_warps = NULL;
+
+  *dev_map = dt_opencl_alloc_device_buffer(devid, sizeof(float complex) * width * height);
+  if(!cl_warps || !tile_start || !tile_fill || *dev_map == NULL) goto error;
+
+  // the warp parameters exactly as in apply_round_stamp()
+  size_t lut_size = 0;
+  int n = 0;
+  for(const GSList *i = warps; i; i = g_slist_next(i), n++)
+  {
+    const dt_liquify_warp_t *warp = i->data;
+    dt_liquify_cl_warp_t *w = &cl_warps[n];
+    float complex strength = 0.5f * (warp->strength - warp->point);
+    strength = (warp->status & DT_LIQUIFY_STATUS_INTERPOLATED) ?
+      (strength * STAMP_RELOCATION) : strength;
+    w->strength_x = crealf(strength);
+    w->strength_y = cimagf(strength);
+    w->abs_strength
+      = cabsf(strength) * (warp->type == DT_LIQUIFY_WARP_TYPE_RADIAL_SHRINK ? -1.0f : 1.0f);
+    w->x = round(crealf(warp->point));
+    w->y = round(cimagf(warp->point));
+    w->iradius = round(cabsf(warp->radius - warp->point));
+    w->type = warp->type;
+    w->lut = lut_size;
+    w->table_size = w->iradius * LOOKUP_OVERSAMPLE;
+    lut_size += w->table_size + 1;
+
+    const int x0 = MAX(0, w->x - w->iradius - map_extent->x) / LIQUIFY_TILE;
+    const int x1 = MIN(width - 1, w->x + w->iradius - map_extent->x) / LIQUIFY_TILE;
+    const int y0 = MAX(0, w->y - w->iradius - map_extent->y) / LIQUIFY_TILE;
+    const int y1 = MIN(height - 1, w->y + w->iradius - map_extent->y) / LIQUIFY_TILE;
+    for(int ty = y0; ty <= y1; ty++)
+      for(int tx = x0; tx <= x1; tx++)
+        tile_start[ty * tiles_x + tx + 1]++;
+  }
+
+  for(int t = 0; t < tiles_x * tiles_y; t++)
+    tile_start[t + 1] += tile_start[t];
+
+  lut = dt_alloc_align_float(MAX(1, lut_size));
+  tile_warps = malloc(sizeof(int) * MAX(1, tile_start[tiles_x * tiles_y]));
+  if(!lut || !tile_warps) goto error;
+
+  n = 0;
+  for(const GSList *i = warps; i; i = g_slist_next(i), n++)
+  {
+    const dt_liquify_warp_t *warp = i->data;
+    const dt_liquify_cl_warp_t *w = &cl_warps[n];
+    float *table = build_lookup_table(w->table_size, warp->control1, warp->control2);
+    if(!table) goto error;
+    memcpy(lut + w->lut, table, sizeof(float) * (w->table_size + 1));
+    dt_free_align(table);
+
+    const int x0 = MAX(0, w->x - w->iradius - map_extent->x) / LIQUIFY_TILE;
+    const int x1 = MIN(width - 1, w->x + w->iradius - map_extent->x) / LIQUIFY_TILE;
+    const int y0 = MAX(0, w->y - w->iradius - map_extent->y) / LIQUIFY_TILE;
+    const int y1 = MIN(height - 1, w->y + w->iradius - map_extent->y) / LIQUIFY_TILE;
+    for(int ty = y0; ty <= y1; ty++)
+      for(int tx = x0; tx <= x1; tx++)
+      {
+        const int t = ty * tiles_x + tx;
+        tile_warps[tile_start[t] + tile_fill[t]++] = n;
+      }
+  }
+
+  dev_warps = dt_opencl_copy_host_to_device_constant
+    (devid, sizeof(dt_liquify_cl_warp_t) * MAX(1, nwarps), cl_warps);
+  dev_lut = dt_opencl_copy_host_to_device_constant
+    (devid, sizeof(float) * MAX(1, lut_size), lut);
+  dev_tile_start = dt_opencl_copy_host_to_device_constant
+    (devid, sizeof(int) * (tiles_x * tiles_y + 1), tile_start);
+  dev_tile_warps = dt_opencl_copy_host_to_device_constant
+    (devid, sizeof(int) * MAX(1, tile_start[tiles_x * tiles_y]), tile_warps);
+  if(dev_warps == NULL || dev_lut == NULL || dev_tile_start == NULL || dev_tile_warps == NULL)
+    goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->map_kernel, width, height,
+                                         CLARG(*dev_map), CLARG(map_extent->x), CLARG(map_extent->y),
+                                         CLARG(width), CLARG(height), CLARG(dev_warps),
+                                         CLARG(dev_lut), CLARG(dev_tile_start),
+                                         CLARG(dev_tile_warps), CLARG(tiles_x));
+
+error:
+  dt_opencl_release_mem_object(dev_tile_warps);
+  dt_opencl_release_mem_object(dev_tile_start);
+  dt_opencl_release_mem_object(dev_lut);
+  dt_opencl_release_mem_object(dev_warps);
+  if(err != CL_SUCCESS)
+  {
+    dt_opencl_release_mem_object(*dev_map);
+    *dev_map = NULL;
+  }
+  dt_free_align(lut);
+  free(tile_warps);
+  free(tile_fill);
+  free(tile_start);
+  free(cl_warps);
+
+  return err;
+}
+
 int process_cl(dt_iop_module_t *self,
                 dt_dev_pixelpipe_iop_t *piece,
                 const cl_mem_t dev_in,
@@ -1566,23 +1887,61 @@ int process_cl(dt_iop_module_t *self,
 
   // 2. build the distortion map
   cairo_rectangle_int_t map_extent;
-  float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
+  GList *interpolated = NULL;
+  GSList *in_roi = _get_warps_in_roi(self, piece, roi_in->scale,
+                                     roi_out, &map_extent, &interpolated);
 
-  if(map == NULL)
-    return CL_SUCCESS;
+  // a stamp is centered on the rounded warp point, see _build_cached_distortion_map()
+  map_extent.x--;
+  map_extent.y--;
+  map_extent.width += 2;
+  map_extent.height += 2;
 
   // 3. apply the map
-  if(map_extent.width != 0 && map_extent.height != 0)
-    err = _apply_global_distortion_map_cl(self, piece, dev_in,
-                                          dev_out, roi_in, roi_out, map, &map_extent);
-  dt_free_align((void *) map);
+  if(in_roi)
+  {
+    cl_mem_t dev_map = NULL;
+    err = _build_global_distortion_map_cl(self, piece, in_roi, &map_extent, &dev_map);
+    if(err == CL_SUCCESS)
+      err = _apply_global_distortion_map_cl(self, piece, dev_in,
+                                            dev_out, roi_in, roi_out, dev_map, &map_extent);
+    dt_opencl_release_mem_object(dev_map);
+  }
+
+  g_slist_free(in_roi);
+  g_list_free_full(interpolated, free);
   return err;
 }
 
 #endif
 
+void commit_params(dt_iop_module_t *self,
+                   dt_iop_params_t *p1,
+                   dt_dev_pixelpipe_t *pipe,
+                   dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_liquify_data_t *d = piece->data;
+  // the rasterized fields are validated by the hash of their warps
+  memcpy(&d->params, p1, sizeof(dt_iop_liquify_params_t));
+}
+
+void init_pipe(dt_iop_module_t *self,
+               dt_dev_pixelpipe_t *pipe,
+               dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = calloc(1, sizeof(dt_iop_liquify_data_t));
+}
+
+void cleanup_pipe(dt_iop_module_t *self,
+                  dt_dev_pixelpipe_t *pipe,
+                  dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_liquify_data_t *d = piece->data;
+  _free_fields(d->fields);
+  free(piece->data);
+  piece->data = NULL;
+}
+
 void init_global(dt_iop_module_so_t *self)
 {
   // called once at startup
@@ -1590,6 +1949,7 @@ void init_global(dt_iop_module_so_t *self)
   dt_iop_liquify_global_data_t *gd =  malloc(sizeof(dt_iop_liquify_global_data_t));
   self->data = gd;
   gd->warp_kernel = dt_opencl_create_kernel(program, "warp_kernel");
+  gd->map_kernel = dt_opencl_create_kernel(program, "liquify_map");
 }
 
 void cleanup_global(dt_iop_module_so_t *self)
@@ -1597,6 +1957,7 @@ void cleanup_global(dt_iop_module_so_t *self)
   // called once at shutdown
   const dt_iop_liquify_global_data_t *gd = self->data;
   dt_opencl_free_kernel(gd->warp_kernel);
+  dt_opencl_free_kernel(gd->map_kernel);
   free(self->data);
   self->data = NULL;
 }
@@ -1716,80 +2077,90 @@ static void update_warp_count(const dt_iop_module_t *self)
     gtk_label_set_text(g->label, str);
 }
 
-static GList *interpolate_paths(dt_iop_liquify_params_t *p)
-{
-  GList *l = NULL;
-  for(int k=0; k<MAX_NODES; k++)
-  {
-    const dt_liquify_path_data_t *data = &p->nodes[k];
-    if(data->header.type == DT_LIQUIFY_PATH_INVALIDATED)
-      break;
+// prepend the warps of the path segment ending at node data to l, so
+// l is built in reverse order
 
-    const float complex *p2 = &data->warp.point;
-    const dt_liquify_warp_t *warp2 = &data->warp;
+static GList *interpolate_node(dt_iop_liquify_params_t *p,
+                               const dt_liquify_path_data_t *data,
+                               GList *l)
+{
+  const float complex *p2 = &data->warp.point;
+  const dt_liquify_warp_t *warp2 = &data->warp;
 
-    if(data->header.type == DT_LIQUIFY_PATH_MOVE_TO_V1)
+  if(data->header.type == DT_LIQUIFY_PATH_MOVE_TO_V1)
+  {
+    if(data->header.next == -1)
     {
-      if(data->header.next == -1)
-      {
-        dt_liquify_warp_t *w = malloc(sizeof(dt_liquify_warp_t));
-        *w = *warp2;
-        l = g_list_append(l, w);
-      }
-      continue;
+      dt_liquify_warp_t *w = malloc(sizeof(dt_liquify_warp_t));
+      *w = *warp2;
+      l = g_list_prepend(l, w);
     }
+    return l;
+  }
 
-    const dt_liquify_path_data_t *prev = node_prev(p, data);
-    const dt_liquify_warp_t *warp1 = &prev->warp;
-    const float complex *p1 = &prev->warp.point;
-    if(data->header.type == DT_LIQUIFY_PATH_LINE_TO_V1)
+  const dt_liquify_path_data_t *prev = node_prev(p, data);
+  const dt_liquify_warp_t *warp1 = &prev->warp;
+  const float complex *p1 = &prev->warp.point;
+  if(data->header.type == DT_LIQUIFY_PATH_LINE_TO_V1)
+  {
+    const float total_length = cabsf(*p1 - *p2);
+    float arc_length = 0.0f;
+    while(arc_length < total_length)
     {
-      const float total_length = cabsf(*p1 - *p2);
-      float arc_length = 0.0f;
-      while(arc_length < total_length)
-      {
-        dt_liquify_warp_t *w = malloc(sizeof(dt_liquify_warp_t));
-        const float t = arc_length / total_length;
-        const float complex pt = cmix(*p1, *p2, t);
-        mix_warps(w, warp1, warp2, pt, t);
-        w->status = DT_LIQUIFY_STATUS_INTERPOLATED;
-        arc_length += cabsf(w->radius - w->point) * STAMP_RELOCATION;
-        l = g_list_append(l, w);
-      }
-      continue;
+      dt_liquify_warp_t *w = malloc(sizeof(dt_liquify_warp_t));
+      const float t = arc_length / total_length;
+      const float complex pt = cmix(*p1, *p2, t);
+      mix_warps(w, warp1, warp2, pt, t);
+      w->status = DT_LIQUIFY_STATUS_INTERPOLATED;
+      arc_length += cabsf(w->radius - w->point) * STAMP_RELOCATION;
+      l = g_list_prepend(l, w);
     }
+    return l;
+  }
 
-    if(data->header.type == DT_LIQUIFY_PATH_CURVE_TO_V1)
+  if(data->header.type == DT_LIQUIFY_PATH_CURVE_TO_V1)
+  {
+    float complex *buffer = malloc(sizeof(float complex) * INTERPOLATION_POINTS);
+    interpolate_cubic_bezier(*p1,
+                             data->node.ctrl1,
+                             data->node.ctrl2,
+                             *p2,
+                             buffer,
+                             INTERPOLATION_POINTS);
+    const float total_length = get_arc_length(buffer, INTERPOLATION_POINTS);
+    float arc_length = 0.0f;
+    restart_cookie_t restart = { 1, 0.0 };
+
+    while(arc_length < total_length)
     {
-      float complex *buffer = malloc(sizeof(float complex) * INTERPOLATION_POINTS);
-      interpolate_cubic_bezier(*p1,
-                                data->node.ctrl1,
-                                data->node.ctrl2,
-                                *p2,
-                                buffer,
-                                INTERPOLATION_POINTS);
-      const float total_length = get_arc_length(buffer, INTERPOLATION_POINTS);
-      float arc_length = 0.0f;
-      restart_cookie_t restart = { 1, 0.0 };
-
-      while(arc_length < total_length)
-      {
-        dt_liquify_warp_t *w = malloc(sizeof(dt_liquify_warp_t));
-        const float t = arc_length / total_length;
-        const float complex pt =
-          point_at_arc_length(buffer, INTERPOLATION_POINTS, arc_length, &restart);
-        mix_warps(w, warp1, warp2, pt, t);
-        w->status = DT_LIQUIFY_STATUS_INTERPOLATED;
-        arc_length += cabsf(w->radius - w->point) * STAMP_RELOCATION;
-        l = g_list_append(l, w);
-      }
-      free((void *) buffer);
-      continue;
+      dt_liquify_warp_t *w = malloc(sizeof(dt_liquify_warp_t));
+      const float t = arc_length / total_length;
+      const float complex pt =
+        point_at_arc_length(buffer, INTERPOLATION_POINTS, arc_length, &restart);
+      mix_warps(w, warp1, warp2, pt, t);
+      w->status = DT_LIQUIFY_STATUS_INTERPOLATED;
+      arc_length += cabsf(w->radius - w->point) * STAMP_RELOCATION;
+      l = g_list_prepend(l, w);
     }
+    free((void *) buffer);
+    return l;
   }
   return l;
 }
 
+static GList *interpolate_paths(dt_iop_liquify_params_t *p)
+{
+  GList *l = NULL;
+  for(int k=0; k<MAX_NODES; k++)
+  {
+    const dt_liquify_path_data_t *data = &p->nodes[k];
+    if(data->header.type == DT_LIQUIFY_PATH_INVALIDATED)
+      break;
+    l = interpolate_node(p, data, l);
+  }
+  return g_list_reverse(l);
+}
+
 #define FG_COLOR     set_source_rgba(cr, fg_color)
 #define BG_COLOR     set_source_rgba(cr, bg_color)
 #define VERYTHINLINE set_line_width (cr, scale / 2.0f, DT_LIQUIFY_UI_WIDTH_THINLINE)
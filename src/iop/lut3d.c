@@ -30,6 +30,7 @@
 #include "imageio/imageio_png.h"
 #include "iop/iop_api.h"
 
+#include <glib/gstdio.h>
 #include <gtk/gtk.h>
 #include <libgen.h>
 #include <png.h>
@@ -48,6 +49,8 @@ DT_MODULE_INTROSPECTION(3, dt_iop_lut3d_params_t)
 #define DT_IOP_LUT3D_MAX_LUTNAME 128
 #define DT_IOP_LUT3D_CLUT_LEVEL 48
 #define DT_IOP_LUT3D_MAX_KEYPOINTS 2048
+// number of LUTs kept in memory once no pipe uses them anymore
+#define DT_IOP_LUT3D_CACHE_SIZE 4
 
 typedef enum dt_iop_lut3d_colorspace_t
 {
@@ -99,9 +102,19 @@ typedef enum dt_lut3d_cols_t
 
 const char invalid_filepath_prefix[] = "INVALID >> ";
 
+// a parsed LUT, shared by all pipes using the same LUT file
+typedef struct dt_iop_lut3d_cached_t
+{
+  dt_hash_t hash; // of the full path and modification time of the file, or of the compressed LUT
+  float *clut;    // cube lut pointer
+  uint16_t level; // cube_size
+  int users;      // number of pipes using it
+} dt_iop_lut3d_cached_t;
+
 typedef struct dt_iop_lut3d_data_t
 {
   dt_iop_lut3d_params_t params;
+  dt_iop_lut3d_cached_t *cached;
   float *clut;  // cube lut pointer
   uint16_t level; // cube_size
 } dt_iop_lut3d_data_t;
@@ -112,6 +125,8 @@ typedef struct dt_iop_lut3d_global_data_t
   int kernel_lut3d_trilinear;
   int kernel_lut3d_pyramid;
   int kernel_lut3d_none;
+  dt_pthread_mutex_t lock; // protects the LUT cache
+  GList *luts;             // dt_iop_lut3d_cached_t, most recently used first
 } dt_iop_lut3d_global_data_t;
 
 #ifdef HAVE_GMIC
@@ -1136,6 +1151,8 @@ void init_global(dt_iop_module_so_t *self)
   gd->kernel_lut3d_trilinear = dt_opencl_create_kernel(program, "lut3d_trilinear");
   gd->kernel_lut3d_pyramid = dt_opencl_create_kernel(program, "lut3d_pyramid");
   gd->kernel_lut3d_none = dt_opencl_create_kernel(program, "lut3d_none");
+  dt_pthread_mutex_init(&gd->lock, NULL);
+  gd->luts = NULL;
 
 #ifdef HAVE_GMIC
   // make sure the cache dir exists
@@ -1146,6 +1163,13 @@ void init_global(dt_iop_module_so_t *self)
 #endif // HAVE_GMIC
 }
 
+static void _free_cached_clut(gpointer data)
+{
+  dt_iop_lut3d_cached_t *cached = data;
+  dt_free_align(cached->clut);
+  free(cached);
+}
+
 void cleanup_global(dt_iop_module_so_t *self)
 {
   dt_iop_lut3d_global_data_t *gd = self->data;
@@ -1153,6 +1177,8 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_lut3d_trilinear);
   dt_opencl_free_kernel(gd->kernel_lut3d_pyramid);
   dt_opencl_free_kernel(gd->kernel_lut3d_none);
+  g_list_free_full(gd->luts, _free_cached_clut);
+  dt_pthread_mutex_destroy(&gd->lock);
   free(self->data);
   self->data = NULL;
 }
@@ -1195,6 +1221,103 @@ static int _calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
   return level;
 }
 
+// identify the LUT source: the file and its modification time, so an edited
+// file gets parsed again, or the compressed LUT stored in the params
+static dt_hash_t _clut_hash(const dt_iop_lut3d_params_t *const p)
+{
+  dt_hash_t hash = DT_INITHASH;
+#ifdef HAVE_GMIC
+  if(p->nb_keypoints && p->filepath[0])
+  {
+    hash = dt_hash(hash, p->lutname, strlen(p->lutname));
+    hash = dt_hash(hash, &p->nb_keypoints, sizeof(p->nb_keypoints));
+    return dt_hash(hash, p->c_clut, sizeof(p->c_clut));
+  }
+#endif // HAVE_GMIC
+  gchar *lutfolder = dt_conf_get_string("plugins/darkroom/lut3d/def_path");
+  char *fullpath = g_build_filename(lutfolder, p->filepath, NULL);
+  hash = dt_hash(hash, fullpath, strlen(fullpath));
+  GStatBuf st;
+  if(!g_stat(fullpath, &st))
+  {
+    const gint64 stamp[2] = { st.st_mtime, st.st_size };
+    hash = dt_hash(hash, stamp, sizeof(stamp));
+  }
+  g_free(fullpath);
+  g_free(lutfolder);
+  return hash;
+}
+
+// drop the least recently used LUTs no pipe needs anymore, with the lock held
+static void _trim_clut_cache(dt_iop_lut3d_global_data_t *gd)
+{
+  int kept = 0;
+  for(GList *l = gd->luts; l;)
+  {
+    GList *next = g_list_next(l);
+    dt_iop_lut3d_cached_t *cached = l->data;
+    if(cached->users == 0 && ++kept > DT_IOP_LUT3D_CACHE_SIZE)
+    {
+      _free_cached_clut(cached);
+      gd->luts = g_list_delete_link(gd->luts, l);
+    }
+    l = next;
+  }
+}
+
+// get the parsed LUT for the params, reading the file only if no pipe has done that before
+static dt_iop_lut3d_cached_t *_acquire_clut(dt_iop_lut3d_global_data_t *gd,
+                                            dt_iop_lut3d_params_t *const p)
+{
+  const dt_hash_t hash = _clut_hash(p);
+
+  dt_pthread_mutex_lock(&gd->lock);
+  for(GList *l = gd->luts; l; l = g_list_next(l))
+  {
+    dt_iop_lut3d_cached_t *cached = l->data;
+    if(cached->hash == hash)
+    {
+      cached->users++;
+      gd->luts = g_list_remove_link(gd->luts, l);
+      gd->luts = g_list_concat(l, gd->luts);
+      dt_pthread_mutex_unlock(&gd->lock);
+      return cached;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->lock);
+
+  // parse without holding the lock, other pipes may be processing meanwhile
+  float *clut = NULL;
+  const uint16_t level = _calculate_clut(p, &clut);
+  if(!level)
+  {
+    dt_free_align(clut);
+    return NULL;
+  }
+
+  dt_iop_lut3d_cached_t *cached = malloc(sizeof(dt_iop_lut3d_cached_t));
+  cached->hash = hash;
+  cached->clut = clut;
+  cached->level = level;
+  cached->users = 1;
+
+  dt_pthread_mutex_lock(&gd->lock);
+  gd->luts = g_list_prepend(gd->luts, cached);
+  _trim_clut_cache(gd);
+  dt_pthread_mutex_unlock(&gd->lock);
+  return cached;
+}
+
+static void _release_clut(dt_iop_lut3d_global_data_t *gd,
+                          dt_iop_lut3d_cached_t *cached)
+{
+  if(!cached) return;
+  dt_pthread_mutex_lock(&gd->lock);
+  cached->users--;
+  _trim_clut_cache(gd);
+  dt_pthread_mutex_unlock(&gd->lock);
+}
+
 #ifdef HAVE_GMIC
 static gboolean _list_match_string(GtkTreeModel *model,
                                    GtkTreePath *path,
@@ -1367,16 +1490,18 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
 {
   dt_iop_lut3d_params_t *p = (dt_iop_lut3d_params_t *)p1;
   dt_iop_lut3d_data_t *d = piece->data;
+  dt_iop_lut3d_global_data_t *gd = self->global_data;
 
-  if(strcmp(p->filepath, d->params.filepath) != 0 || strcmp(p->lutname, d->params.lutname) != 0 )
-  { // new clut file
-    if(d->clut)
-    { // reset current clut if any
-      dt_free_align(d->clut);
-      d->clut = NULL;
-      d->level = 0;
-    }
-    d->level = _calculate_clut(p, &d->clut);
+  // without gui the global data is only set up for enabled pieces
+  if(!gd) return;
+
+  if(strcmp(p->filepath, d->params.filepath) != 0 || strcmp(p->lutname, d->params.lutname) != 0
+     || (d->cached && d->cached->hash != _clut_hash(p)))
+  { // new or modified clut file
+    _release_clut(gd, d->cached);
+    d->cached = _acquire_clut(gd, p);
+    d->clut = d->cached ? d->cached->clut : NULL;
+    d->level = d->cached ? d->cached->level : 0;
   }
   memcpy(&d->params, p, sizeof(dt_iop_lut3d_params_t));
 }
@@ -1386,6 +1511,7 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
   piece->data = malloc(sizeof(dt_iop_lut3d_data_t));
   dt_iop_lut3d_data_t *d = piece->data;
   memcpy(&d->params, self->default_params, sizeof(dt_iop_lut3d_params_t));
+  d->cached = NULL;
   d->clut = NULL;
   d->level = 0;
   d->params.filepath[0] = '\0';
@@ -1394,8 +1520,8 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_lut3d_data_t *d = piece->data;;
-  if(d->clut)
-    dt_free_align(d->clut);
+  _release_clut(self->global_data, d->cached);
+  d->cached = NULL;
   d->clut = NULL;
   d->level = 0;
   free(piece->data);
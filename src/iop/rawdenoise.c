@@ -20,11 +20,13 @@
 #include "common/darktable.h"
 #include "common/imagebuf.h"
 #include "common/dwt.h"
+#include "common/opencl.h"
 #include "control/control.h"
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
 #include "develop/openmp_maths.h"
+#include "develop/tiling.h"
 #include "dtgtk/drawingarea.h"
 #include "gui/accelerators.h"
 #include "gui/gtk.h"
@@ -84,6 +86,10 @@ typedef struct dt_iop_rawdenoise_data_t
 
 typedef struct dt_iop_rawdenoise_global_data_t
 {
+  int kernel_rawdenoise_bayer_extract;
+  int kernel_rawdenoise_bayer_restore;
+  int kernel_rawdenoise_xtrans_extract;
+  int kernel_rawdenoise_xtrans_restore;
 } dt_iop_rawdenoise_global_data_t;
 
 int legacy_params(dt_iop_module_t *self,
@@ -486,6 +492,158 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   }
 }
 
+void tiling_callback(dt_iop_module_t *self,
+                     dt_dev_pixelpipe_iop_t *piece,
+                     const dt_iop_roi_t *roi_in,
+                     const dt_iop_roi_t *roi_out,
+                     dt_develop_tiling_t *tiling)
+{
+  // the channel being denoised plus the dwt details and intermediate buffers,
+  // a quarter of the image for Bayer sensors and the full image for X-Trans
+  const gboolean xtrans = piece->pipe->dsc.filters == 9u;
+  tiling->factor = 2.0f + (xtrans ? 3.0f : 0.75f);
+  tiling->factor_cl = tiling->factor;
+  tiling->maxbuf = 1.0f;
+  tiling->maxbuf_cl = 1.0f;
+  tiling->overhead = 0;
+  tiling->overlap = 0;
+  tiling->xalign = 1;
+  tiling->yalign = 1;
+}
+
+#ifdef HAVE_OPENCL
+static cl_int _wavelet_denoise_cl(const int devid,
+                                  const dt_iop_rawdenoise_global_data_t *const gd,
+                                  cl_mem dev_in,
+                                  cl_mem dev_out,
+                                  const dt_iop_roi_t *const roi,
+                                  const dt_iop_rawdenoise_data_t *const data,
+                                  const uint32_t filters)
+{
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  const size_t size = (size_t)(roi->width / 2 + 1) * (roi->height / 2 + 1);
+  cl_mem fimg = dt_opencl_alloc_device_buffer(devid, sizeof(float) * size);
+  if(!fimg) return err;
+
+  for(int c = 0; c < 4; c++) /* denoise R,G1,B,G3 individually */
+  {
+    const int color = FC(c % 2, c / 2, filters);
+    float noise[DT_IOP_RAWDENOISE_BANDS];
+    compute_channel_noise(noise, color, data);
+
+    // adjust for odd width and height
+    const int halfwidth = roi->width / 2 + (roi->width & (~(c >> 1)) & 1);
+    const int halfheight = roi->height / 2 + (roi->height & (~c) & 1);
+    const int rowoff = c & 1;
+    const int coloff = (c & 2) >> 1;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_rawdenoise_bayer_extract, halfwidth, halfheight,
+            CLARG(dev_in), CLARG(fimg), CLARG(halfwidth), CLARG(halfheight), CLARG(rowoff), CLARG(coloff));
+    if(err != CL_SUCCESS) goto error;
+
+    err = dwt_denoise_cl(devid, fimg, halfwidth, halfheight, DT_IOP_RAWDENOISE_BANDS, noise);
+    if(err != CL_SUCCESS) goto error;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_rawdenoise_bayer_restore, halfwidth, halfheight,
+            CLARG(fimg), CLARG(dev_out), CLARG(halfwidth), CLARG(halfheight), CLARG(rowoff), CLARG(coloff));
+    if(err != CL_SUCCESS) goto error;
+  }
+
+error:
+  dt_opencl_release_mem_object(fimg);
+  return err;
+}
+
+static cl_int _wavelet_denoise_xtrans_cl(const int devid,
+                                         const dt_iop_rawdenoise_global_data_t *const gd,
+                                         cl_mem dev_in,
+                                         cl_mem dev_out,
+                                         const dt_iop_roi_t *const roi,
+                                         const dt_iop_rawdenoise_data_t *const data,
+                                         void *xtrans)
+{
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  const int width = roi->width;
+  const int height = roi->height;
+  const int rx = roi->x;
+  const int ry = roi->y;
+  cl_mem fimg = dt_opencl_alloc_device_buffer(devid, sizeof(float) * width * height);
+  cl_mem dev_xtrans = dt_opencl_copy_host_to_device_constant(devid, sizeof(uint8_t) * 6 * 6, xtrans);
+  if(!fimg || !dev_xtrans) goto error;
+
+  for(int c = 0; c < 3; c++)
+  {
+    float noise[DT_IOP_RAWDENOISE_BANDS];
+    compute_channel_noise(noise, c, data);
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_rawdenoise_xtrans_extract, width, height,
+            CLARG(dev_in), CLARG(fimg), CLARG(width), CLARG(height), CLARG(c),
+            CLARG(rx), CLARG(ry), CLARG(dev_xtrans));
+    if(err != CL_SUCCESS) goto error;
+
+    err = dwt_denoise_cl(devid, fimg, width, height, DT_IOP_RAWDENOISE_BANDS, noise);
+    if(err != CL_SUCCESS) goto error;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_rawdenoise_xtrans_restore, width, height,
+            CLARG(fimg), CLARG(dev_out), CLARG(width), CLARG(height), CLARG(c),
+            CLARG(rx), CLARG(ry), CLARG(dev_xtrans));
+    if(err != CL_SUCCESS) goto error;
+  }
+
+error:
+  dt_opencl_release_mem_object(fimg);
+  dt_opencl_release_mem_object(dev_xtrans);
+  return err;
+}
+
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_rawdenoise_data_t *const d = piece->data;
+  const dt_iop_rawdenoise_global_data_t *const gd = self->global_data;
+  const int devid = piece->pipe->devid;
+
+  if(!(d->threshold > 0.0f))
+  {
+    size_t origin[] = { 0, 0, 0 };
+    size_t region[] = { roi_in->width, roi_in->height, 1 };
+    return dt_opencl_enqueue_copy_image(devid, dev_in, dev_out, origin, origin, region);
+  }
+
+  const uint32_t filters = piece->pipe->dsc.filters;
+  if(filters != 9u)
+    return _wavelet_denoise_cl(devid, gd, dev_in, dev_out, roi_in, d, filters);
+  else
+    return _wavelet_denoise_xtrans_cl(devid, gd, dev_in, dev_out, roi_in, d, piece->pipe->dsc.xtrans);
+}
+#endif
+
+void init_global(dt_iop_module_so_t *self)
+{
+  const int program = 42; // rawdenoise.cl, from programs.conf
+  dt_iop_rawdenoise_global_data_t *gd = malloc(sizeof(dt_iop_rawdenoise_global_data_t));
+  self->data = gd;
+  gd->kernel_rawdenoise_bayer_extract = dt_opencl_create_kernel(program, "rawdenoise_bayer_extract");
+  gd->kernel_rawdenoise_bayer_restore = dt_opencl_create_kernel(program, "rawdenoise_bayer_restore");
+  gd->kernel_rawdenoise_xtrans_extract = dt_opencl_create_kernel(program, "rawdenoise_xtrans_extract");
+  gd->kernel_rawdenoise_xtrans_restore = dt_opencl_create_kernel(program, "rawdenoise_xtrans_restore");
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_rawdenoise_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_rawdenoise_bayer_extract);
+  dt_opencl_free_kernel(gd->kernel_rawdenoise_bayer_restore);
+  dt_opencl_free_kernel(gd->kernel_rawdenoise_xtrans_extract);
+  dt_opencl_free_kernel(gd->kernel_rawdenoise_xtrans_restore);
+  free(self->data);
+  self->data = NULL;
+}
+
 void init(dt_iop_module_t *self)
 {
   dt_iop_default_init(self);
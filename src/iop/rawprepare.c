@@ -566,6 +566,46 @@ finish:
 }
 #endif
 
+gboolean raw_pointwise(dt_iop_module_t *self,
+                       dt_dev_pixelpipe_iop_t *piece,
+                       dt_iop_raw_pointwise_t *op,
+                       const dt_iop_roi_t *const roi_in,
+                       const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_rawprepare_data_t *d = piece->data;
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  const uint32_t filters = pipe->image.buf_dsc.filters;
+
+  if(!filters || filters == 9u
+     || d->apply_gainmaps
+     || !dt_image_is_raw(&pipe->image)
+     || roi_out->x != 0 || roi_out->y != 0)
+    return FALSE;
+
+  if(!op) return TRUE;
+
+  if(piece->dsc_in.channels != 1
+     || (piece->dsc_in.datatype != TYPE_UINT16 && piece->dsc_in.datatype != TYPE_FLOAT))
+    return FALSE;
+
+  const int csx = _compute_proper_crop(piece, roi_in, d->left);
+  const int csy = _compute_proper_crop(piece, roi_in, d->top);
+
+  op->prepared = TRUE;
+  op->uint16 = piece->dsc_in.datatype == TYPE_UINT16;
+  op->crop_x = csx;
+  op->crop_y = csy;
+  for(int k = 0; k < 4; k++)
+  {
+    op->sub[k] = d->sub[k];
+    op->div[k] = d->div[k];
+  }
+
+  pipe->dsc.filters = dt_rawspeed_crop_dcraw_filters(self->dev->image_storage.buf_dsc.filters, csx, csy);
+  for(int k = 0; k < 4; k++) pipe->dsc.processed_maximum[k] = 1.0f;
+  return TRUE;
+}
+
 static int _image_is_normalized(const dt_image_t *const image)
 {
   // if raw with floating-point data, if not 1 or legacy magic whitelevel, then it needs normalization
@@ -93,6 +93,9 @@ typedef struct retouch_user_data_t
   int display_scale;
   gboolean mask_display;
   gboolean suppress_mask;
+  gboolean use_cache;
+  dt_hash_t hash;        // of the image after processing scale 0
+  dt_hash_t merged_hash; // of the merged scales processed so far
 } retouch_user_data_t;
 
 typedef struct dt_iop_retouch_params_t
@@ -171,7 +174,19 @@ typedef struct dt_iop_retouch_gui_data_t
   GtkWidget *sl_mask_opacity; // draw mask opacity
 } dt_iop_retouch_gui_data_t;
 
-typedef struct dt_iop_retouch_params_t dt_iop_retouch_data_t;
+// a wavelet scale after processing its forms, kept between runs of the full pipe
+typedef struct dt_iop_retouch_scale_cache_t
+{
+  dt_hash_t hash; // of the scale before processing and of its forms
+  size_t size;
+  float *layer;
+} dt_iop_retouch_scale_cache_t;
+
+typedef struct dt_iop_retouch_data_t
+{
+  dt_iop_retouch_params_t params;
+  dt_iop_retouch_scale_cache_t cache[RETOUCH_NO_SCALES];
+} dt_iop_retouch_data_t;
 
 typedef struct dt_iop_retouch_global_data_t
 {
@@ -2274,17 +2289,39 @@ void tiling_callback(dt_iop_module_t *self,
   tiling->yalign = 1;
 }
 
+static void rt_free_scale_cache(dt_iop_retouch_data_t *d)
+{
+  for(int k = 0; k < RETOUCH_NO_SCALES; k++)
+  {
+    dt_free_align(d->cache[k].layer);
+    d->cache[k].layer = NULL;
+    d->cache[k].size = 0;
+    d->cache[k].hash = 0;
+  }
+}
+
+void commit_params(dt_iop_module_t *self,
+                   dt_iop_params_t *p1,
+                   dt_dev_pixelpipe_t *pipe,
+                   dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_retouch_data_t *d = piece->data;
+  // the cached scales are validated by their hash
+  memcpy(&d->params, p1, sizeof(dt_iop_retouch_params_t));
+}
+
 void init_pipe(dt_iop_module_t *self,
                dt_dev_pixelpipe_t *pipe,
                dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = malloc(sizeof(dt_iop_retouch_data_t));
+  piece->data = calloc(1, sizeof(dt_iop_retouch_data_t));
 }
 
 void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  rt_free_scale_cache(piece->data);
   free(piece->data);
   piece->data = NULL;
 }
@@ -2725,7 +2762,7 @@ static void rt_compute_roi_in(dt_iop_module_t *self,
                               int *_roix,
                               int *_roiy)
 {
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_params_t *p = &((dt_iop_retouch_data_t *)piece->data)->params;
   dt_develop_blend_params_t *bp = piece->blendop_data;
 
   int roir = *_roir;
@@ -2841,7 +2878,7 @@ static void rt_extend_roi_in_from_source_clones(dt_iop_module_t *self,
                                                 int *_roix,
                                                 int *_roiy)
 {
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_params_t *p = &((dt_iop_retouch_data_t *)piece->data)->params;
   dt_develop_blend_params_t *bp = piece->blendop_data;
 
   int roir = *_roir;
@@ -2940,7 +2977,7 @@ static void rt_extend_roi_in_for_clone(dt_iop_module_t *self,
                                        int *_roix,
                                        int *_roiy)
 {
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_params_t *p = &((dt_iop_retouch_data_t *)piece->data)->params;
   dt_develop_blend_params_t *bp = piece->blendop_data;
 
   int roir = *_roir;
@@ -3565,6 +3602,34 @@ cleanup:
   dt_free_align(img_dest);
 }
 
+// hash all forms of scale and count them
+static dt_hash_t rt_forms_hash(dt_dev_pixelpipe_iop_t *piece,
+                               const dt_iop_retouch_params_t *p,
+                               const int scale,
+                               dt_hash_t hash,
+                               int *count)
+{
+  const dt_develop_blend_params_t *bp = piece->blendop_data;
+  const dt_masks_form_t *grp = dt_masks_get_from_id_ext(piece->pipe->forms, bp->mask_id);
+  *count = 0;
+  if(!grp || !(grp->type & DT_MASKS_GROUP)) return hash;
+
+  hash = dt_hash(hash, &p->max_heal_iter, sizeof(p->max_heal_iter));
+  for(const GList *forms = grp->points; forms; forms = g_list_next(forms))
+  {
+    const dt_masks_point_group_t *grpt = forms->data;
+    if(grpt == NULL) continue;
+    const int index = rt_get_index_from_formid(p, grpt->formid);
+    if(index == -1 || p->rt_forms[index].scale != scale) continue;
+
+    hash = dt_hash(hash, &grpt->opacity, sizeof(grpt->opacity));
+    hash = dt_hash(hash, &p->rt_forms[index], sizeof(dt_iop_retouch_form_data_t));
+    hash = dt_masks_group_hash(hash, dt_masks_get_from_id_ext(piece->pipe->forms, grpt->formid));
+    (*count)++;
+  }
+  return hash;
+}
+
 static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int scale1)
 {
   int scale = scale1;
@@ -3583,7 +3648,7 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
   if(scale > wt_p->scales + 1) return;
 
   dt_develop_blend_params_t *bp = piece->blendop_data;
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_params_t *p = &((dt_iop_retouch_data_t *)piece->data)->params;
   dt_iop_roi_t *roi_layer = &usr_d->roi;
   const gboolean mask_display = usr_d->mask_display && (scale == usr_d->display_scale);
 
@@ -3598,6 +3663,39 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
     scale = p->num_scales + 1;
   }
 
+  // The detail scales and the residual only depend on the image after
+  // processing scale 0, the merged scales also on the ones merged
+  // before.  So a scale whose forms didn't change can be taken from the
+  // cache.
+  const gboolean merged = wt_p->merge_from_scale > 0
+                          && scale1 >= wt_p->merge_from_scale
+                          && scale1 <= wt_p->scales;
+  dt_hash_t hash = merged ? usr_d->merged_hash : usr_d->hash;
+  int nforms = 0;
+  hash = dt_hash(hash, &scale, sizeof(scale));
+  if(!usr_d->suppress_mask)
+    hash = rt_forms_hash(piece, p, scale, hash, &nforms);
+  if(scale1 == 0)
+    usr_d->hash = usr_d->merged_hash = hash;
+  else if(merged)
+    usr_d->merged_hash = hash;
+
+  dt_iop_retouch_data_t *d = piece->data;
+  dt_iop_retouch_scale_cache_t *cache = &d->cache[scale];
+  const size_t size = (size_t)wt_p->ch * wt_p->width * wt_p->height;
+  const gboolean use_cache = usr_d->use_cache && nforms > 0;
+  if(!use_cache && cache->layer)
+  {
+    dt_free_align(cache->layer);
+    cache->layer = NULL;
+    cache->size = 0;
+  }
+  if(use_cache && cache->layer && cache->size == size && cache->hash == hash)
+  {
+    dt_iop_image_copy(layer, cache->layer, size);
+    return;
+  }
+
   // iterate through all forms
   if(!usr_d->suppress_mask)
   {
@@ -3757,6 +3855,21 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
       }
     }
   }
+
+  if(use_cache)
+  {
+    if(cache->size != size)
+    {
+      dt_free_align(cache->layer);
+      cache->layer = dt_alloc_align_float(size);
+      cache->size = cache->layer ? size : 0;
+    }
+    if(cache->layer)
+    {
+      dt_iop_image_copy(cache->layer, layer, size);
+      cache->hash = hash;
+    }
+  }
 }
 
 void process(dt_iop_module_t *self,
@@ -3771,7 +3884,7 @@ void process(dt_iop_module_t *self,
                                         ivoid, ovoid, roi_in, roi_out))
     return;
 
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_params_t *p = &((dt_iop_retouch_data_t *)piece->data)->params;
   dt_iop_retouch_gui_data_t *g = self->gui_data;
 
   float *in_retouch = NULL;
@@ -3829,6 +3942,22 @@ void process(dt_iop_module_t *self,
     usr_data.mask_display = TRUE;
   }
 
+  // the full pipe is rerun for each edit, keep its processed scales.
+  // the hash of the scales starts with everything defining the input to scale 0
+  usr_data.use_cache = (piece->pipe->type & DT_DEV_PIXELPIPE_FULL) != 0;
+  if(usr_data.use_cache)
+  {
+    dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi_in, FALSE);
+    hash = dt_hash(hash, roi_in, sizeof(dt_iop_roi_t));
+    hash = dt_hash(hash, &dwt_p->scales, sizeof(dwt_p->scales));
+    hash = dt_hash(hash, &dwt_p->return_layer, sizeof(dwt_p->return_layer));
+    hash = dt_hash(hash, &dwt_p->merge_from_scale, sizeof(dwt_p->merge_from_scale));
+    hash = dt_hash(hash, &dwt_p->preview_scale, sizeof(dwt_p->preview_scale));
+    hash = dt_hash(hash, &usr_data.mask_display, sizeof(usr_data.mask_display));
+    hash = dt_hash(hash, &usr_data.display_scale, sizeof(usr_data.display_scale));
+    usr_data.hash = hash;
+  }
+
   if(piece->pipe->type & DT_DEV_PIXELPIPE_FULL)
   {
     // check if the image support this number of scales
@@ -4366,7 +4495,7 @@ static cl_int rt_process_forms_cl(cl_mem dev_layer,
   if(scale > wt_p->scales + 1) return err;
 
   dt_develop_blend_params_t *bp = piece->blendop_data;
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_params_t *p = &((dt_iop_retouch_data_t *)piece->data)->params;
   dt_iop_retouch_global_data_t *gd = self->global_data;
   const int devid = piece->pipe->devid;
   dt_iop_roi_t *roi_layer = &usr_d->roi;
@@ -4577,7 +4706,7 @@ int process_cl(dt_iop_module_t *self,
                const dt_iop_roi_t *const roi_in,
                const dt_iop_roi_t *const roi_out)
 {
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_params_t *p = &((dt_iop_retouch_data_t *)piece->data)->params;
   dt_iop_retouch_global_data_t *gd = self->global_data;
   dt_iop_retouch_gui_data_t *g = self->gui_data;
 
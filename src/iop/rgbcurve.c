@@ -125,7 +125,8 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_POINTWISE
+    | IOP_FLAGS_HALF_FLOAT;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -1864,6 +1865,14 @@ cleanup:
 }
 #endif
 
+static inline float _curve_lookup(const float *const table,
+                                  const float *const coeffs,
+                                  const float xm,
+                                  const float x)
+{
+  return (x < xm) ? table[CLAMP((int)(x * 0x10000ul), 0, 0xffff)] : dt_iop_eval_exp(coeffs, x);
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -1896,47 +1905,46 @@ void process(dt_iop_module_t *self,
   const _curve_table_ptr restrict table = d->table;
   const _coeffs_table_ptr restrict unbounded_coeffs = d->unbounded_coeffs;
 
-  DT_OMP_FOR()
-  for(int y = 0; y < 4*npixels; y += 4)
+  // one loop per mode so the per-pixel work is only the table look-ups
+  if(autoscale == DT_S_SCALE_MANUAL_RGB)
   {
-    if(autoscale == DT_S_SCALE_MANUAL_RGB)
+    DT_OMP_FOR()
+    for(size_t y = 0; y < 4 * npixels; y += 4)
     {
-      out[y+0] = (in[y+0] < xm_L) ? table[DT_IOP_RGBCURVE_R][CLAMP((int)(in[y+0] * 0x10000ul), 0, 0xffff)]
-                                  : dt_iop_eval_exp(unbounded_coeffs[DT_IOP_RGBCURVE_R], in[y+0]);
-      out[y+1] = (in[y+1] < xm_g) ? table[DT_IOP_RGBCURVE_G][CLAMP((int)(in[y+1] * 0x10000ul), 0, 0xffff)]
-                                  : dt_iop_eval_exp(unbounded_coeffs[DT_IOP_RGBCURVE_G], in[y+1]);
-      out[y+2] = (in[y+2] < xm_b) ? table[DT_IOP_RGBCURVE_B][CLAMP((int)(in[y+2] * 0x10000ul), 0, 0xffff)]
-                                  : dt_iop_eval_exp(unbounded_coeffs[DT_IOP_RGBCURVE_B], in[y+2]);
+      out[y+0] = _curve_lookup(table[DT_IOP_RGBCURVE_R], unbounded_coeffs[DT_IOP_RGBCURVE_R], xm_L, in[y+0]);
+      out[y+1] = _curve_lookup(table[DT_IOP_RGBCURVE_G], unbounded_coeffs[DT_IOP_RGBCURVE_G], xm_g, in[y+1]);
+      out[y+2] = _curve_lookup(table[DT_IOP_RGBCURVE_B], unbounded_coeffs[DT_IOP_RGBCURVE_B], xm_b, in[y+2]);
+      out[y+3] = in[y+3];
     }
-    else if(autoscale == DT_S_SCALE_AUTOMATIC_RGB)
+  }
+  else if(autoscale == DT_S_SCALE_AUTOMATIC_RGB && d->params.preserve_colors == DT_RGB_NORM_NONE)
+  {
+    DT_OMP_FOR()
+    for(size_t y = 0; y < 4 * npixels; y += 4)
     {
-      if(d->params.preserve_colors == DT_RGB_NORM_NONE)
-      {
-        for(int c = 0; c < 3; c++)
-        {
-          out[y+c] = (in[y+c] < xm_L)
-            ? table[DT_IOP_RGBCURVE_R][CLAMP((int)(in[y+c] * 0x10000ul), 0, 0xffff)]
-            : dt_iop_eval_exp(unbounded_coeffs[DT_IOP_RGBCURVE_R], in[y+c]);
-        }
-      }
-      else
+      for(int c = 0; c < 3; c++)
+        out[y+c] = _curve_lookup(table[DT_IOP_RGBCURVE_R], unbounded_coeffs[DT_IOP_RGBCURVE_R], xm_L, in[y+c]);
+      out[y+3] = in[y+3];
+    }
+  }
+  else
+  {
+    const dt_iop_rgb_norms_t preserve_colors = d->params.preserve_colors;
+    DT_OMP_FOR()
+    for(size_t y = 0; y < 4 * npixels; y += 4)
+    {
+      float ratio = 1.f;
+      const float lum = dt_rgb_norm(in + y, preserve_colors, work_profile);
+      if(lum > 0.f)
       {
-        float ratio = 1.f;
-        const float lum = dt_rgb_norm(in + y, d->params.preserve_colors, work_profile);
-        if(lum > 0.f)
-        {
-          const float curve_lum = (lum < xm_L)
-            ? table[DT_IOP_RGBCURVE_R][CLAMP((int)(lum * 0x10000ul), 0, 0xffff)]
-            : dt_iop_eval_exp(unbounded_coeffs[DT_IOP_RGBCURVE_R], lum);
-          ratio = curve_lum / lum;
-        }
-        for(size_t c = 0; c < 3; c++)
-        {
-          out[y+c] = (ratio * in[y+c]);
-        }
+        const float curve_lum = _curve_lookup(table[DT_IOP_RGBCURVE_R],
+                                              unbounded_coeffs[DT_IOP_RGBCURVE_R], xm_L, lum);
+        ratio = curve_lum / lum;
       }
+      for(size_t c = 0; c < 3; c++)
+        out[y+c] = (ratio * in[y+c]);
+      out[y+3] = in[y+3];
     }
-    out[y+3] = in[y+3];
   }
 }
 
@@ -529,6 +529,27 @@ static inline void _publish_chroma(dt_dev_pixelpipe_iop_t *piece)
   chr->late_correction = (d->preset == DT_IOP_TEMP_D65_LATE);
 }
 
+gboolean raw_pointwise(dt_iop_module_t *self,
+                       dt_dev_pixelpipe_iop_t *piece,
+                       dt_iop_raw_pointwise_t *op,
+                       const dt_iop_roi_t *const roi_in,
+                       const dt_iop_roi_t *const roi_out)
+{
+  const uint32_t filters = piece->pipe->image.buf_dsc.filters;
+  if(!filters || filters == 9u) return FALSE;
+  if(!op) return TRUE;
+  if(!op->prepared) return FALSE;
+
+  const dt_iop_temperature_data_t *const d = piece->data;
+  for_four_channels(c)
+  {
+    op->mul[c] *= d->coeffs[c];
+    op->clip[c] *= d->coeffs[c];
+  }
+  _publish_chroma(piece);
+  return TRUE;
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
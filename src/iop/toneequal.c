@@ -107,6 +107,7 @@
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
+#include "develop/tiling.h"
 #include "dtgtk/drawingarea.h"
 #include "dtgtk/expander.h"
 #include "gui/accelerators.h"
@@ -204,7 +205,20 @@ typedef struct dt_iop_toneequalizer_data_t
 
 typedef struct dt_iop_toneequalizer_global_data_t
 {
-  // TODO: put OpenCL kernels here at some point
+  int kernel_luminance_mask;
+  int kernel_downsample;
+  int kernel_quantize;
+  int kernel_pack;
+  int kernel_box_mean_x;
+  int kernel_box_mean_y;
+  int kernel_gf_ab;
+  int kernel_gf_blend;
+  int kernel_gf_final;
+  int kernel_minmax_rows;
+  int kernel_eigf_variance;
+  int kernel_eigf_blend;
+  int kernel_apply;
+  int kernel_display_mask;
 } dt_iop_toneequalizer_global_data_t;
 
 
@@ -987,6 +1001,136 @@ static inline void display_luminance_mask(const float *const restrict in,
 }
 
 
+// The luminance mask only depends on the upstream pipe and on the mask
+// extraction parameters, hash these only so editing the curve or the
+// smoothing reuses the cached mask.
+static dt_hash_t _luminance_mask_hash(dt_dev_pixelpipe_iop_t *piece,
+                                      const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_toneequalizer_data_t *const d = piece->data;
+
+  dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi_out, FALSE);
+  hash = dt_hash(hash, &d->method, sizeof(d->method));
+  hash = dt_hash(hash, &d->details, sizeof(d->details));
+  hash = dt_hash(hash, &d->radius, sizeof(d->radius));
+  hash = dt_hash(hash, &d->iterations, sizeof(d->iterations));
+  hash = dt_hash(hash, &d->feathering, sizeof(d->feathering));
+  hash = dt_hash(hash, &d->quantization, sizeof(d->quantization));
+  hash = dt_hash(hash, &d->contrast_boost, sizeof(d->contrast_boost));
+  hash = dt_hash(hash, &d->exposure_boost, sizeof(d->exposure_boost));
+  hash = dt_hash(hash, &d->scale, sizeof(d->scale));
+  return hash;
+}
+
+// Get the cached luminance buffer of the full and preview pipes,
+// NULL if this pipe doesn't cache its mask.
+static float *_luminance_cache_buffer(dt_iop_module_t *self,
+                                      dt_dev_pixelpipe_iop_t *piece,
+                                      const size_t width,
+                                      const size_t height)
+{
+  dt_iop_toneequalizer_gui_data_t *const g = self->gui_data;
+  const size_t num_elem = width * height;
+
+  if(!self->dev->gui_attached || !g) return NULL;
+
+  // If the module instance has changed order in the pipe, invalidate the caches
+  if(g->pipe_order != piece->module->iop_order)
+  {
+    dt_iop_gui_enter_critical_section(self);
+    g->ui_preview_hash = DT_INVALID_HASH;
+    g->thumb_preview_hash = DT_INVALID_HASH;
+    g->pipe_order = piece->module->iop_order;
+    g->luminance_valid = FALSE;
+    g->histogram_valid = FALSE;
+    dt_iop_gui_leave_critical_section(self);
+  }
+
+  float *luminance = NULL;
+  if(piece->pipe->type & DT_DEV_PIXELPIPE_FULL)
+  {
+    // For DT_DEV_PIXELPIPE_FULL, we cache the luminance mask for performance
+    // but it's not accessed from GUI
+    // no need for threads lock since no other function is writing/reading that buffer
+
+    // Re-allocate a new buffer if the full preview size has changed
+    if(g->full_preview_buf_width != width || g->full_preview_buf_height != height)
+    {
+      dt_free_align(g->full_preview_buf);
+      g->full_preview_buf = dt_alloc_align_float(num_elem);
+      g->full_preview_buf_width = width;
+      g->full_preview_buf_height = height;
+    }
+
+    luminance = g->full_preview_buf;
+  }
+  else if(piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
+  {
+    // For DT_DEV_PIXELPIPE_PREVIEW, we need to cache it too to
+    // compute the full image stats upon user request in GUI threads
+    // locks are required since GUI reads and writes on that buffer.
+
+    // Re-allocate a new buffer if the thumb preview size has changed
+    dt_iop_gui_enter_critical_section(self);
+    if(g->thumb_preview_buf_width != width || g->thumb_preview_buf_height != height)
+    {
+      dt_free_align(g->thumb_preview_buf);
+      g->thumb_preview_buf = dt_alloc_align_float(num_elem);
+      g->thumb_preview_buf_width = width;
+      g->thumb_preview_buf_height = height;
+      g->luminance_valid = FALSE;
+    }
+
+    luminance = g->thumb_preview_buf;
+
+    dt_iop_gui_leave_critical_section(self);
+  }
+
+  return luminance;
+}
+
+// TRUE if the cached luminance mask of this pipe is up to date for hash
+static gboolean _luminance_cache_valid(dt_iop_module_t *self,
+                                       dt_dev_pixelpipe_iop_t *piece,
+                                       const dt_hash_t hash)
+{
+  dt_iop_toneequalizer_gui_data_t *const g = self->gui_data;
+
+  dt_hash_t saved_hash = DT_INVALID_HASH;
+  if(piece->pipe->type & DT_DEV_PIXELPIPE_FULL)
+    hash_set_get(&g->ui_preview_hash, &saved_hash, &self->gui_lock);
+  else if(piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
+    hash_set_get(&g->thumb_preview_hash, &saved_hash, &self->gui_lock);
+  else
+    return FALSE;
+
+  dt_iop_gui_enter_critical_section(self);
+  const gboolean luminance_valid = g->luminance_valid;
+  dt_iop_gui_leave_critical_section(self);
+
+  return hash == saved_hash && luminance_valid;
+}
+
+// Record that the cached luminance mask has been recomputed for hash.
+// For the preview pipe the caller holds the gui lock while writing the buffer.
+static void _luminance_cache_stored(dt_iop_module_t *self,
+                                    dt_dev_pixelpipe_iop_t *piece,
+                                    const dt_hash_t hash)
+{
+  dt_iop_toneequalizer_gui_data_t *const g = self->gui_data;
+
+  if(piece->pipe->type & DT_DEV_PIXELPIPE_FULL)
+  {
+    hash_set_get(&hash, &g->ui_preview_hash, &self->gui_lock);
+  }
+  else if(piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
+  {
+    g->thumb_preview_hash = hash;
+    g->histogram_valid = FALSE;
+    g->luminance_valid = TRUE;
+  }
+}
+
 __DT_CLONE_TARGETS__
 static
 void toneeq_process(dt_iop_module_t *self,
@@ -1001,14 +1145,13 @@ void toneeq_process(dt_iop_module_t *self,
 
   const float *const restrict in = (float *const)ivoid;
   float *const restrict out = (float *const)ovoid;
-  float *restrict luminance = NULL;
 
   const size_t width = roi_in->width;
   const size_t height = roi_in->height;
   const size_t num_elem = width * height;
 
-  // Get the hash of the upstream pipe to track changes
-  const dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi_out, TRUE);
+  // Get the hash of the upstream pipe and mask parameters to track changes
+  const dt_hash_t hash = _luminance_mask_hash(piece, roi_out);
 
   // Sanity checks
   if(width < 1 || height < 1) return;
@@ -1016,162 +1159,433 @@ void toneeq_process(dt_iop_module_t *self,
     return; // input should be at least as large as output
   if(piece->colors != 4) return;  // we need RGB signal
 
-  // Init the luminance masks buffers
-  gboolean cached = FALSE;
+  // Init the luminance masks buffers, full and preview pipes cache them,
+  // other pipes just allocate a local temp buffer
+  float *restrict luminance = _luminance_cache_buffer(self, piece, width, height);
+  const gboolean cached = luminance != NULL;
+  if(!cached) luminance = dt_alloc_align_float(num_elem);
+
+  // Check if the luminance buffer exists
+  if(!luminance)
+  {
+    dt_control_log(_("tone equalizer failed to allocate memory, check your RAM settings"));
+    return;
+  }
 
-  if(self->dev->gui_attached)
+  // Compute the luminance mask
+  if(!cached)
+  {
+    // no caching path : compute no matter what
+    compute_luminance_mask(in, luminance, width, height, d);
+  }
+  else if(!_luminance_cache_valid(self, piece, hash))
   {
-    // If the module instance has changed order in the pipe, invalidate the caches
-    if(g->pipe_order != piece->module->iop_order)
+    /* compute only if upstream pipe state or mask parameters have changed */
+    const gboolean preview = piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW;
+    if(preview) dt_iop_gui_enter_critical_section(self);
+    compute_luminance_mask(in, luminance, width, height, d);
+    _luminance_cache_stored(self, piece, hash);
+    if(preview)
     {
-      dt_iop_gui_enter_critical_section(self);
-      g->ui_preview_hash = DT_INVALID_HASH;
-      g->thumb_preview_hash = DT_INVALID_HASH;
-      g->pipe_order = piece->module->iop_order;
-      g->luminance_valid = FALSE;
-      g->histogram_valid = FALSE;
       dt_iop_gui_leave_critical_section(self);
+      dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, self->iop_order);
     }
+  }
 
-    if(piece->pipe->type & DT_DEV_PIXELPIPE_FULL)
-    {
-      // For DT_DEV_PIXELPIPE_FULL, we cache the luminance mask for performance
-      // but it's not accessed from GUI
-      // no need for threads lock since no other function is writing/reading that buffer
+  // Display output
+  if(self->dev->gui_attached && (piece->pipe->type & DT_DEV_PIXELPIPE_FULL) && g->mask_display)
+  {
+    display_luminance_mask(in, luminance, out, roi_in, roi_out);
+    piece->pipe->mask_display = DT_DEV_PIXELPIPE_DISPLAY_PASSTHRU;
+  }
+  else
+    apply_toneequalizer(in, luminance, out, roi_in, roi_out, d);
 
-      // Re-allocate a new buffer if the full preview size has changed
-      if(g->full_preview_buf_width != width || g->full_preview_buf_height != height)
-      {
-        dt_free_align(g->full_preview_buf);
-        g->full_preview_buf = dt_alloc_align_float(num_elem);
-        g->full_preview_buf_width = width;
-        g->full_preview_buf_height = height;
-      }
+  if(!cached) dt_free_align(luminance);
+}
+
+void process(dt_iop_module_t *self,
+             dt_dev_pixelpipe_iop_t *piece,
+             const void *const restrict ivoid,
+             void *const restrict ovoid,
+             const dt_iop_roi_t *const roi_in,
+             const dt_iop_roi_t *const roi_out)
+{
+  toneeq_process(self, piece, ivoid, ovoid, roi_in, roi_out);
+}
 
-      luminance = g->full_preview_buf;
-      cached = TRUE;
+#ifdef HAVE_OPENCL
+// box mean of a 4 channels buffer in place, rows then columns, see dt_box_mean()
+static cl_int _box_mean_cl(const int devid,
+                           const dt_iop_toneequalizer_global_data_t *const gd,
+                           cl_mem buf,
+                           cl_mem tmp,
+                           const int width,
+                           const int height,
+                           const int radius)
+{
+  cl_int err = dt_opencl_enqueue_kernel_1d_args(devid, gd->kernel_box_mean_x, height,
+          CLARG(buf), CLARG(tmp), CLARG(width), CLARG(height), CLARG(radius));
+  if(err != CL_SUCCESS) return err;
+
+  return dt_opencl_enqueue_kernel_1d_args(devid, gd->kernel_box_mean_y, width,
+          CLARG(tmp), CLARG(buf), CLARG(width), CLARG(height), CLARG(radius));
+}
+
+// GPU port of fast_surface_blur() in common/fast_guided_filter.h
+static cl_int _fast_surface_blur_cl(const int devid,
+                                    const dt_iop_toneequalizer_global_data_t *const gd,
+                                    cl_mem image,
+                                    const int width,
+                                    const int height,
+                                    const int radius,
+                                    const float feathering,
+                                    const int iterations,
+                                    const gboolean geomean,
+                                    const float quantization,
+                                    const float quantize_min,
+                                    const float quantize_max)
+{
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+  const float scaling = 4.0f;
+  const int ds_radius = (radius < 4) ? 1 : radius / scaling;
+  const int ds_width = width / scaling;
+  const int ds_height = height / scaling;
+  const int blend = geomean;
+
+  if(ds_width < 1 || ds_height < 1) return CL_SUCCESS;
+
+  const size_t ds_size = (size_t)ds_width * ds_height * sizeof(float);
+  cl_mem ds_image = dt_opencl_alloc_device_buffer(devid, ds_size);
+  cl_mem ds_mask = dt_opencl_alloc_device_buffer(devid, ds_size);
+  cl_mem moments = dt_opencl_alloc_device_buffer(devid, 4 * ds_size);
+  cl_mem ab = dt_opencl_alloc_device_buffer(devid, 4 * ds_size);
+  if(!ds_image || !ds_mask || !moments || !ab) goto finish;
+
+  // Downsample the image for speed-up
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_downsample, ds_width, ds_height,
+          CLARG(image), CLARG(ds_image), CLARG(width), CLARG(height),
+          CLARG(ds_width), CLARG(ds_height));
+  if(err != CL_SUCCESS) goto finish;
+
+  const int eigf = 0;
+  for(int i = 0; i < iterations; ++i)
+  {
+    // (Re)build the mask from the quantized image to help guiding
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_quantize, ds_width, ds_height,
+            CLARG(ds_image), CLARG(ds_mask), CLARG(ds_width), CLARG(ds_height),
+            CLARG(quantization), CLARG(quantize_min), CLARG(quantize_max));
+    if(err != CL_SUCCESS) goto finish;
+
+    // patch-wise variance analyse, the quantized image guides the image
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_pack, ds_width, ds_height,
+            CLARG(ds_mask), CLARG(ds_image), CLARG(moments), CLARG(ds_width), CLARG(ds_height),
+            CLARG(eigf));
+    if(err != CL_SUCCESS) goto finish;
+
+    err = _box_mean_cl(devid, gd, moments, ab, ds_width, ds_height, ds_radius);
+    if(err != CL_SUCCESS) goto finish;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_gf_ab, ds_width, ds_height,
+            CLARG(moments), CLARG(ab), CLARG(ds_width), CLARG(ds_height), CLARG(feathering));
+    if(err != CL_SUCCESS) goto finish;
+
+    // patch-wise average of the a and b parameters
+    err = _box_mean_cl(devid, gd, ab, moments, ds_width, ds_height, ds_radius);
+    if(err != CL_SUCCESS) goto finish;
+
+    if(i != iterations - 1)
+    {
+      err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_gf_blend, ds_width, ds_height,
+              CLARG(ds_image), CLARG(ab), CLARG(ds_width), CLARG(ds_height));
+      if(err != CL_SUCCESS) goto finish;
     }
-    else if(piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
+  }
+
+  // Upsample a and b, and blend the guided image
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_gf_final, width, height,
+          CLARG(image), CLARG(ab), CLARG(width), CLARG(height),
+          CLARG(ds_width), CLARG(ds_height), CLARG(blend));
+
+finish:
+  dt_opencl_release_mem_object(ds_image);
+  dt_opencl_release_mem_object(ds_mask);
+  dt_opencl_release_mem_object(moments);
+  dt_opencl_release_mem_object(ab);
+  return err;
+}
+
+// GPU port of fast_eigf_surface_blur() in common/eigf.h. Without
+// quantization the mask is the image itself, the 4 channels analysis
+// then gives the same result as the specialized 2 channels one.
+static cl_int _fast_eigf_surface_blur_cl(const int devid,
+                                         const dt_iop_toneequalizer_global_data_t *const gd,
+                                         cl_mem image,
+                                         const int width,
+                                         const int height,
+                                         const float sigma,
+                                         const float feathering,
+                                         const int iterations,
+                                         const gboolean geomean,
+                                         const float quantization,
+                                         const float quantize_min,
+                                         const float quantize_max)
+{
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+  const float scaling = fmaxf(fminf(sigma, 4.0f), 1.0f);
+  const float ds_sigma = fmaxf(sigma / scaling, 1.0f);
+  const int ds_width = width / scaling;
+  const int ds_height = height / scaling;
+  const gboolean quantized = quantization != 0.0f;
+
+  if(ds_width < 1 || ds_height < 1) return CL_SUCCESS;
+
+  const size_t ds_size = (size_t)ds_width * ds_height * sizeof(float);
+  float *rowmin = dt_alloc_align_float((size_t)4 * ds_height);
+  float *rowmax = dt_alloc_align_float((size_t)4 * ds_height);
+  cl_mem mask = quantized
+    ? dt_opencl_alloc_device_buffer(devid, (size_t)width * height * sizeof(float))
+    : image;
+  cl_mem ds_image = dt_opencl_alloc_device_buffer(devid, ds_size);
+  cl_mem ds_mask = quantized ? dt_opencl_alloc_device_buffer(devid, ds_size) : ds_image;
+  cl_mem moments = dt_opencl_alloc_device_buffer(devid, 4 * ds_size);
+  cl_mem dev_rowmin = dt_opencl_alloc_device_buffer(devid, 4 * sizeof(float) * ds_height);
+  cl_mem dev_rowmax = dt_opencl_alloc_device_buffer(devid, 4 * sizeof(float) * ds_height);
+  dt_gaussian_cl_t *g = NULL;
+  if(!rowmin || !rowmax || !mask || !ds_image || !ds_mask || !moments || !dev_rowmin || !dev_rowmax)
+    goto finish;
+
+  const int eigf = 1;
+  for(int i = 0; i < iterations; i++)
+  {
+    // blend linear for all intermediate images, use filter for last iteration
+    const int blend = (i == iterations - 1) ? geomean : FALSE;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_downsample, ds_width, ds_height,
+            CLARG(image), CLARG(ds_image), CLARG(width), CLARG(height),
+            CLARG(ds_width), CLARG(ds_height));
+    if(err != CL_SUCCESS) goto finish;
+
+    if(quantized)
     {
-      // For DT_DEV_PIXELPIPE_PREVIEW, we need to cache it too to
-      // compute the full image stats upon user request in GUI threads
-      // locks are required since GUI reads and writes on that buffer.
+      // (Re)build the mask from the quantized image to help guiding
+      err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_quantize, width, height,
+              CLARG(image), CLARG(mask), CLARG(width), CLARG(height),
+              CLARG(quantization), CLARG(quantize_min), CLARG(quantize_max));
+      if(err != CL_SUCCESS) goto finish;
+
+      err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_downsample, ds_width, ds_height,
+              CLARG(mask), CLARG(ds_mask), CLARG(width), CLARG(height),
+              CLARG(ds_width), CLARG(ds_height));
+      if(err != CL_SUCCESS) goto finish;
+    }
 
-      // Re-allocate a new buffer if the thumb preview size has changed
-      dt_iop_gui_enter_critical_section(self);
-      if(g->thumb_preview_buf_width != width || g->thumb_preview_buf_height != height)
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_pack, ds_width, ds_height,
+            CLARG(ds_mask), CLARG(ds_image), CLARG(moments), CLARG(ds_width), CLARG(ds_height),
+            CLARG(eigf));
+    if(err != CL_SUCCESS) goto finish;
+
+    // the gaussian needs the bounds of each channel
+    err = dt_opencl_enqueue_kernel_1d_args(devid, gd->kernel_minmax_rows, ds_height,
+            CLARG(moments), CLARG(dev_rowmin), CLARG(dev_rowmax), CLARG(ds_width), CLARG(ds_height));
+    if(err != CL_SUCCESS) goto finish;
+
+    err = dt_opencl_read_buffer_from_device(devid, rowmin, dev_rowmin, 0,
+                                            4 * sizeof(float) * ds_height, CL_TRUE);
+    if(err != CL_SUCCESS) goto finish;
+    err = dt_opencl_read_buffer_from_device(devid, rowmax, dev_rowmax, 0,
+                                            4 * sizeof(float) * ds_height, CL_TRUE);
+    if(err != CL_SUCCESS) goto finish;
+
+    dt_aligned_pixel_t min = { 10000000.0f, 10000000.0f, 10000000.0f, 10000000.0f };
+    dt_aligned_pixel_t max = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for(int row = 0; row < ds_height; row++)
+      for_four_channels(c)
       {
-        dt_free_align(g->thumb_preview_buf);
-        g->thumb_preview_buf = dt_alloc_align_float(num_elem);
-        g->thumb_preview_buf_width = width;
-        g->thumb_preview_buf_height = height;
-        g->luminance_valid = FALSE;
+        min[c] = MIN(min[c], rowmin[4 * row + c]);
+        max[c] = MAX(max[c], rowmax[4 * row + c]);
       }
 
-      luminance = g->thumb_preview_buf;
-      cached = TRUE;
+    err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    g = dt_gaussian_init_cl(devid, ds_width, ds_height, 4, max, min, ds_sigma, 0);
+    if(!g) goto finish;
+    err = dt_gaussian_blur_cl_buffer(g, moments, moments);
+    dt_gaussian_free_cl(g);
+    g = NULL;
+    if(err != CL_SUCCESS) goto finish;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_eigf_variance, ds_width, ds_height,
+            CLARG(moments), CLARG(ds_width), CLARG(ds_height));
+    if(err != CL_SUCCESS) goto finish;
+
+    // Upsample the variances and averages, and blend the guided image
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_eigf_blend, width, height,
+            CLARG(image), CLARG(mask), CLARG(moments), CLARG(width), CLARG(height),
+            CLARG(ds_width), CLARG(ds_height), CLARG(feathering), CLARG(blend));
+    if(err != CL_SUCCESS) goto finish;
+  }
+
+finish:
+  if(quantized)
+  {
+    dt_opencl_release_mem_object(mask);
+    dt_opencl_release_mem_object(ds_mask);
+  }
+  dt_opencl_release_mem_object(ds_image);
+  dt_opencl_release_mem_object(moments);
+  dt_opencl_release_mem_object(dev_rowmin);
+  dt_opencl_release_mem_object(dev_rowmax);
+  dt_free_align(rowmin);
+  dt_free_align(rowmax);
+  return err;
+}
+
+// same as compute_luminance_mask()
+static cl_int _compute_luminance_mask_cl(const int devid,
+                                         const dt_iop_toneequalizer_global_data_t *const gd,
+                                         cl_mem dev_in,
+                                         cl_mem luminance,
+                                         const int width,
+                                         const int height,
+                                         const dt_iop_toneequalizer_data_t *const d)
+{
+  const gboolean contrast = d->details == DT_TONEEQ_GUIDED || d->details == DT_TONEEQ_EIGF;
+  const int method = d->method;
+  const float exposure_boost = d->exposure_boost;
+  const float fulcrum = contrast ? CONTRAST_FULCRUM : 0.0f;
+  const float contrast_boost = contrast ? d->contrast_boost : 1.0f;
+
+  const cl_int err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_luminance_mask, width, height,
+          CLARG(dev_in), CLARG(luminance), CLARG(width), CLARG(height),
+          CLARG(method), CLARG(exposure_boost), CLARG(fulcrum), CLARG(contrast_boost));
+  if(err != CL_SUCCESS) return err;
 
-      dt_iop_gui_leave_critical_section(self);
-    }
-    else // just to please GCC
-    {
-      luminance = dt_alloc_align_float(num_elem);
-    }
-
-  }
-  else
+  switch(d->details)
   {
-    // no interactive editing/caching : just allocate a local temp buffer
-    luminance = dt_alloc_align_float(num_elem);
-  }
+    case(DT_TONEEQ_AVG_GUIDED):
+    case(DT_TONEEQ_GUIDED):
+      return _fast_surface_blur_cl(devid, gd, luminance, width, height, d->radius, d->feathering,
+                                   d->iterations, d->details == DT_TONEEQ_AVG_GUIDED,
+                                   d->quantization, exp2f(-14.0f), 4.0f);
 
-  // Check if the luminance buffer exists
-  if(!luminance)
-  {
-    dt_control_log(_("tone equalizer failed to allocate memory, check your RAM settings"));
-    return;
+    case(DT_TONEEQ_AVG_EIGF):
+    case(DT_TONEEQ_EIGF):
+      return _fast_eigf_surface_blur_cl(devid, gd, luminance, width, height, d->radius, d->feathering,
+                                        d->iterations, d->details == DT_TONEEQ_AVG_EIGF,
+                                        d->quantization, exp2f(-14.0f), 4.0f);
+
+    default:
+      return CL_SUCCESS;
   }
+}
 
-  // Compute the luminance mask
-  if(cached)
-  {
-    // caching path : store the luminance mask for GUI access
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_toneequalizer_data_t *const d = piece->data;
+  const dt_iop_toneequalizer_global_data_t *const gd = self->global_data;
+  dt_iop_toneequalizer_gui_data_t *const g = self->gui_data;
 
-    if(piece->pipe->type & DT_DEV_PIXELPIPE_FULL)
-    {
-      dt_hash_t saved_hash;
-      hash_set_get(&g->ui_preview_hash, &saved_hash, &self->gui_lock);
+  const int devid = piece->pipe->devid;
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+  const size_t lum_size = (size_t)width * height * sizeof(float);
 
-      dt_iop_gui_enter_critical_section(self);
-      const gboolean luminance_valid = g->luminance_valid;
-      dt_iop_gui_leave_critical_section(self);
+  if(width < 1 || height < 1
+     || roi_in->width < roi_out->width || roi_in->height < roi_out->height
+     || piece->colors != 4)
+    return DT_OPENCL_PROCESS_CL;
 
-      if(hash != saved_hash || !luminance_valid)
-      {
-        /* compute only if upstream pipe state has changed */
-        compute_luminance_mask(in, luminance, width, height, d);
-        hash_set_get(&hash, &g->ui_preview_hash, &self->gui_lock);
-      }
-    }
-    else if(piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
-    {
-      dt_hash_t saved_hash;
-      hash_set_get(&g->thumb_preview_hash, &saved_hash, &self->gui_lock);
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem factors = NULL;
 
-      dt_iop_gui_enter_critical_section(self);
-      const gboolean luminance_valid = g->luminance_valid;
-      dt_iop_gui_leave_critical_section(self);
+  const dt_hash_t hash = _luminance_mask_hash(piece, roi_out);
+  float *const cache = _luminance_cache_buffer(self, piece, width, height);
+  cl_mem luminance = dt_opencl_alloc_device_buffer(devid, lum_size);
+  if(!luminance) goto error;
 
-      if(saved_hash != hash || !luminance_valid)
-      {
-        /* compute only if upstream pipe state has changed */
-        dt_iop_gui_enter_critical_section(self);
-        g->thumb_preview_hash = hash;
-        g->histogram_valid = FALSE;
-        compute_luminance_mask(in, luminance, width, height, d);
-        g->luminance_valid = TRUE;
-        dt_iop_gui_leave_critical_section(self);
-        dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, self->iop_order);
-      }
-    }
-    else // make it dummy-proof
-    {
-      compute_luminance_mask(in, luminance, width, height, d);
-    }
+  if(cache && _luminance_cache_valid(self, piece, hash))
+  {
+    // reuse the mask computed by a previous run of this pipe
+    const gboolean preview = piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW;
+    if(preview) dt_iop_gui_enter_critical_section(self);
+    err = dt_opencl_write_buffer_to_device(devid, cache, luminance, 0, lum_size, CL_TRUE);
+    if(preview) dt_iop_gui_leave_critical_section(self);
+    if(err != CL_SUCCESS) goto error;
   }
   else
   {
-    // no caching path : compute no matter what
-    compute_luminance_mask(in, luminance, width, height, d);
-  }
+    err = _compute_luminance_mask_cl(devid, gd, dev_in, luminance, width, height, d);
+    if(err != CL_SUCCESS) goto error;
 
-  // Display output
-  if(self->dev->gui_attached && (piece->pipe->type & DT_DEV_PIXELPIPE_FULL))
-  {
-    if(g->mask_display)
+    if(cache)
     {
-      display_luminance_mask(in, luminance, out, roi_in, roi_out);
-      piece->pipe->mask_display = DT_DEV_PIXELPIPE_DISPLAY_PASSTHRU;
+      // keep a host copy for the GUI and the next runs of this pipe
+      const gboolean preview = piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW;
+      if(preview) dt_iop_gui_enter_critical_section(self);
+      err = dt_opencl_read_buffer_from_device(devid, cache, luminance, 0, lum_size, CL_TRUE);
+      if(err == CL_SUCCESS) _luminance_cache_stored(self, piece, hash);
+      if(preview) dt_iop_gui_leave_critical_section(self);
+      if(err != CL_SUCCESS) goto error;
+      if(preview) dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, self->iop_order);
     }
-    else
-      apply_toneequalizer(in, luminance, out, roi_in, roi_out, d);
+  }
+
+  if(self->dev->gui_attached && (piece->pipe->type & DT_DEV_PIXELPIPE_FULL) && g && g->mask_display)
+  {
+    const int offset_x = (roi_in->x < roi_out->x) ? -roi_in->x + roi_out->x : 0;
+    const int offset_y = (roi_in->y < roi_out->y) ? -roi_in->y + roi_out->y : 0;
+    const int out_width = MIN(roi_in->width, roi_out->width);
+    const int out_height = MIN(roi_in->height, roi_out->height);
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_display_mask, out_width, out_height,
+            CLARG(dev_in), CLARG(dev_out), CLARG(luminance), CLARG(width),
+            CLARG(out_width), CLARG(out_height), CLARG(offset_x), CLARG(offset_y));
+    if(err != CL_SUCCESS) goto error;
+    piece->pipe->mask_display = DT_DEV_PIXELPIPE_DISPLAY_PASSTHRU;
   }
   else
   {
-    apply_toneequalizer(in, luminance, out, roi_in, roi_out, d);
+    // the correction LUT is too large for constant memory, evaluate the
+    // radial-basis function directly as the non-LUT CPU version does
+    err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    factors = dt_opencl_copy_host_to_device_constant(devid, sizeof(d->factors), (void *)d->factors);
+    if(!factors) goto error;
+
+    const float gauss_denom = gaussian_denom(d->smoothing);
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_apply, width, height,
+            CLARG(dev_in), CLARG(dev_out), CLARG(luminance), CLARG(factors),
+            CLARG(width), CLARG(height), CLARG(gauss_denom));
   }
 
-  if(!cached) dt_free_align(luminance);
+error:
+  dt_opencl_release_mem_object(luminance);
+  dt_opencl_release_mem_object(factors);
+  return err;
 }
+#endif // HAVE_OPENCL
 
-void process(dt_iop_module_t *self,
-             dt_dev_pixelpipe_iop_t *piece,
-             const void *const restrict ivoid,
-             void *const restrict ovoid,
-             const dt_iop_roi_t *const roi_in,
-             const dt_iop_roi_t *const roi_out)
+void tiling_callback(dt_iop_module_t *self,
+                     dt_dev_pixelpipe_iop_t *piece,
+                     const dt_iop_roi_t *roi_in,
+                     const dt_iop_roi_t *roi_out,
+                     dt_develop_tiling_t *tiling)
 {
-  toneeq_process(self, piece, ivoid, ovoid, roi_in, roi_out);
+  // in, out, the luminance mask, and the full resolution mask and
+  // a/b or variance buffers of the filters
+  tiling->factor = 2.5f;
+  tiling->factor_cl = 3.0f;
+  tiling->maxbuf = 1.0f;
+  tiling->maxbuf_cl = 1.0f;
+  tiling->overhead = 0;
+  tiling->overlap = 0;
+  tiling->xalign = 1;
+  tiling->yalign = 1;
 }
 
 
@@ -1565,14 +1979,44 @@ static inline gboolean update_curve_lut(dt_iop_module_t *self)
 
 void init_global(dt_iop_module_so_t *self)
 {
+  const int program = 41; // toneequal.cl, from programs.conf
   dt_iop_toneequalizer_global_data_t *gd = malloc(sizeof(dt_iop_toneequalizer_global_data_t));
 
   self->data = gd;
+  gd->kernel_luminance_mask = dt_opencl_create_kernel(program, "toneeq_luminance_mask");
+  gd->kernel_downsample = dt_opencl_create_kernel(program, "toneeq_downsample");
+  gd->kernel_quantize = dt_opencl_create_kernel(program, "toneeq_quantize");
+  gd->kernel_pack = dt_opencl_create_kernel(program, "toneeq_pack");
+  gd->kernel_box_mean_x = dt_opencl_create_kernel(program, "toneeq_box_mean_x");
+  gd->kernel_box_mean_y = dt_opencl_create_kernel(program, "toneeq_box_mean_y");
+  gd->kernel_gf_ab = dt_opencl_create_kernel(program, "toneeq_gf_ab");
+  gd->kernel_gf_blend = dt_opencl_create_kernel(program, "toneeq_gf_blend");
+  gd->kernel_gf_final = dt_opencl_create_kernel(program, "toneeq_gf_final");
+  gd->kernel_minmax_rows = dt_opencl_create_kernel(program, "toneeq_minmax_rows");
+  gd->kernel_eigf_variance = dt_opencl_create_kernel(program, "toneeq_eigf_variance");
+  gd->kernel_eigf_blend = dt_opencl_create_kernel(program, "toneeq_eigf_blend");
+  gd->kernel_apply = dt_opencl_create_kernel(program, "toneeq_apply");
+  gd->kernel_display_mask = dt_opencl_create_kernel(program, "toneeq_display_mask");
 }
 
 
 void cleanup_global(dt_iop_module_so_t *self)
 {
+  dt_iop_toneequalizer_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_luminance_mask);
+  dt_opencl_free_kernel(gd->kernel_downsample);
+  dt_opencl_free_kernel(gd->kernel_quantize);
+  dt_opencl_free_kernel(gd->kernel_pack);
+  dt_opencl_free_kernel(gd->kernel_box_mean_x);
+  dt_opencl_free_kernel(gd->kernel_box_mean_y);
+  dt_opencl_free_kernel(gd->kernel_gf_ab);
+  dt_opencl_free_kernel(gd->kernel_gf_blend);
+  dt_opencl_free_kernel(gd->kernel_gf_final);
+  dt_opencl_free_kernel(gd->kernel_minmax_rows);
+  dt_opencl_free_kernel(gd->kernel_eigf_variance);
+  dt_opencl_free_kernel(gd->kernel_eigf_blend);
+  dt_opencl_free_kernel(gd->kernel_apply);
+  dt_opencl_free_kernel(gd->kernel_display_mask);
   free(self->data);
   self->data = NULL;
 }
@@ -127,6 +127,17 @@ typedef struct dt_iop_watermark_data_t
   char font[64];
 } dt_iop_watermark_data_t;
 
+/* the last rasterized svg watermark, shared by all pipes so batch exports with the same
+   expanded svg document render it only once. protected by darktable.plugin_threadsafe. */
+typedef struct dt_iop_watermark_global_data_t
+{
+  dt_hash_t svg_hash;   // hash of the expanded svg document
+  RsvgDimensionData dimension;
+  float scale;
+  int width, height, stride;
+  guint8 *image;
+} dt_iop_watermark_global_data_t;
+
 typedef struct dt_iop_watermark_gui_data_t
 {
   GtkWidget *watermarks;                             // watermark
@@ -572,6 +583,7 @@ void process(dt_iop_module_t *self,
              const dt_iop_roi_t *const roi_out)
 {
   dt_iop_watermark_data_t *data = piece->data;
+  dt_iop_watermark_global_data_t *gd = self->global_data;
   float *in = (float *)ivoid;
   float *out = (float *)ovoid;
   const int ch = piece->colors;
@@ -620,6 +632,7 @@ void process(dt_iop_module_t *self,
 
   /* Load svg if not loaded */
   gchar *svgdoc = NULL;
+  dt_hash_t svg_hash = DT_INVALID_HASH;
   if(type == DT_WTM_SVG)
   {
     svgdoc = _watermark_get_svgdoc(self, data, &piece->pipe->image, filename);
@@ -628,6 +641,7 @@ void process(dt_iop_module_t *self,
       dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
       return;
     }
+    svg_hash = dt_hash(DT_INITHASH, svgdoc, strlen(svgdoc));
   }
 
   /* setup stride for performance */
@@ -635,6 +649,7 @@ void process(dt_iop_module_t *self,
   if(stride == -1)
   {
     dt_print(DT_DEBUG_ALWAYS, "[watermark] cairo stride error");
+    g_free(svgdoc);
     dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
     return;
   }
@@ -645,6 +660,7 @@ void process(dt_iop_module_t *self,
   {
     dt_print(DT_DEBUG_ALWAYS, "[watermark] out of memory, could not allocate %d*%d",
              roi_out->height, stride);
+    g_free(svgdoc);
     dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
     return;
   }
@@ -655,6 +671,7 @@ void process(dt_iop_module_t *self,
     dt_print(DT_DEBUG_ALWAYS, "[watermark] cairo surface error: %s",
              cairo_status_to_string(cairo_surface_status(surface)));
     g_free(image);
+    g_free(svgdoc);
     dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
     return;
   }
@@ -662,13 +679,18 @@ void process(dt_iop_module_t *self,
   // rsvg (or some part of cairo which is used underneath) isn't thread safe, for example when handling fonts
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
 
+  // the same expanded document as the cached raster doesn't need to be parsed again
+  // unless it has to be rendered at another scale
+  const gboolean svg_cached = type == DT_WTM_SVG && gd->image && gd->svg_hash == svg_hash;
+
   RsvgHandle *svg = NULL;
-  if(type == DT_WTM_SVG)
+  if(type == DT_WTM_SVG && !svg_cached)
   {
     /* create the rsvghandle from parsed svg data */
     GError *error = NULL;
     svg = rsvg_handle_new_from_data((const guint8 *)svgdoc, strlen(svgdoc), &error);
     g_free(svgdoc);
+    svgdoc = NULL;
     if(!svg || error)
     {
       cairo_surface_destroy(surface);
@@ -690,7 +712,7 @@ void process(dt_iop_module_t *self,
   switch(type)
   {
     case DT_WTM_SVG:
-      dimension = dt_get_svg_dimension(svg);
+      dimension = svg_cached ? gd->dimension : dt_get_svg_dimension(svg);
       break;
     case DT_WTM_PNG:
       // load png into surface 2
@@ -874,6 +896,7 @@ void process(dt_iop_module_t *self,
 
   float svg_offset_x = 0;
   float svg_offset_y = 0;
+  gboolean svg_render = FALSE;
   if(type == DT_WTM_SVG)
   {
     /* the svg_offsets allow safe text boxes as they might render out of the dimensions */
@@ -884,12 +907,40 @@ void process(dt_iop_module_t *self,
     const int watermark_height = (int)((dimension.height * scale) + 3* svg_offset_y) ;
 
     const int stride_two = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, watermark_width);
+    const gboolean raster_cached = svg_cached && gd->scale == scale
+                                   && gd->width == watermark_width && gd->height == watermark_height
+                                   && gd->stride == stride_two;
+
+    // cached document at another scale, now we need the parsed svg
+    if(!raster_cached && !svg)
+    {
+      GError *error = NULL;
+      svg = rsvg_handle_new_from_data((const guint8 *)svgdoc, strlen(svgdoc), &error);
+      if(!svg || error)
+      {
+        cairo_surface_destroy(surface);
+        g_free(image);
+        g_free(svgdoc);
+        dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
+        dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+        dt_print(DT_DEBUG_ALWAYS, "[watermark] error processing svg file: %s",
+                 error ? error->message : "unknown error");
+        if(error) g_error_free(error);
+        return;
+      }
+    }
+    g_free(svgdoc);
+    svgdoc = NULL;
+
     image_two = g_try_malloc0_n(watermark_height, stride_two);
+    if(image_two && raster_cached)
+      memcpy(image_two, gd->image, (size_t)watermark_height * stride_two);
+    svg_render = !raster_cached;
     if(!image_two)
     {
       dt_print(DT_DEBUG_ALWAYS, "[watermark] out of memory, could not allocate %d*%d",
                watermark_height, stride_two);
-      g_object_unref(svg);
+      g_clear_object(&svg);
       g_free(image);
       dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
       dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
@@ -902,7 +953,7 @@ void process(dt_iop_module_t *self,
       dt_print(DT_DEBUG_ALWAYS, "[watermark] cairo surface 2 error: %s",
                cairo_status_to_string(cairo_surface_status(surface_two)));
       cairo_surface_destroy(surface);
-      g_object_unref(svg);
+      g_clear_object(&svg);
       g_free(image);
       g_free(image_two);
       dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
@@ -962,9 +1013,12 @@ void process(dt_iop_module_t *self,
   switch(type)
   {
     case DT_WTM_SVG:
-      cairo_scale(cr_two, scale, scale);
-      /* render svg into surface*/
-      dt_render_svg(svg, cr_two, dimension.width, dimension.height, 0, 0);
+      if(svg_render)
+      {
+        cairo_scale(cr_two, scale, scale);
+        /* render svg into surface*/
+        dt_render_svg(svg, cr_two, dimension.width, dimension.height, 0, 0);
+      }
       break;
     case DT_WTM_PNG:
       cairo_scale(cr, scale, scale);
@@ -972,6 +1026,22 @@ void process(dt_iop_module_t *self,
   }
   cairo_surface_flush(surface_two);
 
+  // keep the rendered watermark for the next image
+  if(svg_render)
+  {
+    const int height_two = cairo_image_surface_get_height(surface_two);
+    const int stride_two = cairo_image_surface_get_stride(surface_two);
+    g_free(gd->image);
+    gd->image = g_try_malloc_n(height_two, stride_two);
+    if(gd->image) memcpy(gd->image, image_two, (size_t)height_two * stride_two);
+    gd->svg_hash = svg_hash;
+    gd->dimension = dimension;
+    gd->scale = scale;
+    gd->width = cairo_image_surface_get_width(surface_two);
+    gd->height = height_two;
+    gd->stride = stride_two;
+  }
+
   // paint the watermark
   cairo_set_source_surface(cr, surface_two, -svg_offset_x, -svg_offset_y);
   cairo_paint(cr);
@@ -1009,7 +1079,7 @@ void process(dt_iop_module_t *self,
   if(type == DT_WTM_SVG)
   {
     g_free(image_two);
-    g_object_unref(svg);
+    g_clear_object(&svg);
   }
 
 }
@@ -1233,6 +1303,19 @@ void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelp
   piece->data = NULL;
 }
 
+void init_global(dt_iop_module_so_t *self)
+{
+  self->data = calloc(1, sizeof(dt_iop_watermark_global_data_t));
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_watermark_global_data_t *gd = self->data;
+  g_free(gd->image);
+  free(self->data);
+  self->data = NULL;
+}
+
 
 void gui_update(dt_iop_module_t *self)
 {
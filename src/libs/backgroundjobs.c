@@ -34,6 +34,13 @@ DT_MODULE(1)
 typedef struct dt_lib_backgroundjob_element_t
 {
   GtkWidget *widget, *label, *progressbar, *hbox;
+
+  // updates from the jobs wait here for the gui thread, coalesced into
+  // one pending idle call
+  GMutex update_mutex;
+  double value;
+  gchar *message;
+  gboolean update_pending;
 } dt_lib_backgroundjob_element_t;
 
 /* proxy functions */
@@ -153,6 +160,7 @@ static void *_lib_backgroundjobs_added(dt_lib_module_t *self, gboolean has_progr
     free(instance);
     return NULL;
   }
+  g_mutex_init(&instance->update_mutex);
 
   instance->widget = gtk_event_box_new();
 
@@ -206,6 +214,8 @@ static gboolean _destroyed_gui_thread(gpointer user_data)
     gtk_widget_hide(params->self->widget);
 
   // free data
+  g_mutex_clear(&params->instance->update_mutex);
+  g_free(params->instance->message);
   free(params->instance);
   free(params);
   return FALSE;
@@ -261,63 +271,59 @@ static void _lib_backgroundjobs_cancellable(dt_lib_module_t *self, dt_lib_backgr
   g_main_context_invoke(NULL, _cancellable_gui_thread, params);
 }
 
-typedef struct _update_gui_thread_t
-{
-  dt_lib_backgroundjob_element_t *instance;
-  double value;
-} _update_gui_thread_t;
-
 static gboolean _update_gui_thread(gpointer user_data)
 {
-  _update_gui_thread_t *params = (_update_gui_thread_t *)user_data;
+  dt_lib_backgroundjob_element_t *instance = (dt_lib_backgroundjob_element_t *)user_data;
 
-  gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(params->instance->progressbar), CLAMP(params->value, 0, 1.0));
+  g_mutex_lock(&instance->update_mutex);
+  const double value = instance->value;
+  gchar *message = instance->message;
+  instance->message = NULL;
+  instance->update_pending = FALSE;
+  g_mutex_unlock(&instance->update_mutex);
 
-  free(params);
+  if(instance->progressbar)
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(instance->progressbar), CLAMP(value, 0, 1.0));
+  if(message)
+    gtk_label_set_text(GTK_LABEL(instance->label), message);
+
+  g_free(message);
   return FALSE;
 }
 
-static void _lib_backgroundjobs_updated(dt_lib_module_t *self, dt_lib_backgroundjob_element_t *instance,
-                                        double value)
+// the gui shows the latest state, intermediate updates of a busy job
+// that arrive before the gui thread got to it are dropped
+static void _queue_update(dt_lib_backgroundjob_element_t *instance,
+                          const double *value,
+                          const char *message)
 {
   // update the progress bar
-  if(!dt_control_running()) return;
+  if(!dt_control_running() || !instance) return;
 
-  _update_gui_thread_t *params = malloc(sizeof(_update_gui_thread_t));
-  if(!params) return;
-  params->instance = instance;
-  params->value = value;
-  g_main_context_invoke(NULL, _update_gui_thread, params);
-}
+  g_mutex_lock(&instance->update_mutex);
+  if(value) instance->value = *value;
+  if(message)
+  {
+    g_free(instance->message);
+    instance->message = g_strdup(message);
+  }
+  const gboolean queue = !instance->update_pending;
+  instance->update_pending = TRUE;
+  g_mutex_unlock(&instance->update_mutex);
 
-typedef struct _update_label_gui_thread_t
-{
-  dt_lib_backgroundjob_element_t *instance;
-  char *message;
-} _update_label_gui_thread_t;
+  if(queue) g_main_context_invoke(NULL, _update_gui_thread, instance);
+}
 
-static gboolean _update_message_gui_thread(gpointer user_data)
+static void _lib_backgroundjobs_updated(dt_lib_module_t *self, dt_lib_backgroundjob_element_t *instance,
+                                        double value)
 {
-  _update_label_gui_thread_t *params = (_update_label_gui_thread_t *)user_data;
-
-  gtk_label_set_text(GTK_LABEL(params->instance->label), params->message);
-
-  g_free(params->message);
-  free(params);
-  return FALSE;
+  _queue_update(instance, &value, NULL);
 }
 
 static void _lib_backgroundjobs_message_updated(dt_lib_module_t *self, dt_lib_backgroundjob_element_t *instance,
                                                 const char *message)
 {
-  // update the progress bar
-  if(!dt_control_running()) return;
-
-  _update_label_gui_thread_t *params = malloc(sizeof(_update_label_gui_thread_t));
-  if(!params) return;
-  params->instance = instance;
-  params->message = g_strdup(message);
-  g_main_context_invoke(NULL, _update_message_gui_thread, params);
+  _queue_update(instance, NULL, message ? message : "");
 }
 
 // clang-format off
@@ -94,8 +94,8 @@ static void _aperture_widget_init(dt_lib_filtering_rule_t *rule, const dt_collec
   char query[1024] = { 0 };
   // clang-format off
   g_snprintf(query, sizeof(query),
-             "SELECT MIN(aperture), MAX(aperture)"
-             " FROM main.images");
+             "SELECT (SELECT MIN(aperture) FROM main.images),"
+             "       (SELECT MAX(aperture) FROM main.images)");
   // clang-format on
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
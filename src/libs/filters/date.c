@@ -101,10 +101,9 @@ static void _date_widget_init(dt_lib_filtering_rule_t *rule, const dt_collection
   char query[1024] = { 0 };
   // clang-format off
   g_snprintf(query, sizeof(query),
-             "SELECT MIN(%s), MAX(%s)"
-             " FROM main.images"
-             " WHERE %s IS NOT NULL",
-             colname, colname, colname);
+             "SELECT (SELECT MIN(%s) FROM main.images WHERE %s IS NOT NULL),"
+             "       (SELECT MAX(%s) FROM main.images WHERE %s IS NOT NULL)",
+             colname, colname, colname, colname);
   // clang-format on
   g_free(colname);
   sqlite3_stmt *stmt;
@@ -113,8 +113,8 @@ static void _iso_widget_init(dt_lib_filtering_rule_t *rule, const dt_collection_
   char query[1024] = { 0 };
   // clang-format off
   g_snprintf(query, sizeof(query),
-             "SELECT MIN(iso), MAX(iso)"
-             " FROM main.images");
+             "SELECT (SELECT MIN(iso) FROM main.images),"
+             "       (SELECT MAX(iso) FROM main.images)");
   // clang-format on
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
@@ -764,7 +764,13 @@ static void _lib_histogram_process_vectorscope
   // histogram profile PCS (always D50)?
   //
   // FIXME: pre-allocate? -- use the same buffer as for waveform?
-  dt_atomic_int *const restrict binned = (dt_atomic_int*)dt_calloc_align_int(diam_px * diam_px);
+  //
+  // each thread counts into its own bins, most pixels land on a few
+  // bins near the center and atomics on a shared array would contend
+  size_t bin_pad;
+  uint32_t *const restrict partial_binned =
+    dt_calloc_perthread((size_t)diam_px * diam_px, sizeof(uint32_t), &bin_pad);
+  if(!partial_binned) return;
   // FIXME: move verbosed interleaved comments into a method note at
   // the start, as the code itself is succinct and clear
   //
@@ -788,8 +794,10 @@ static void _lib_histogram_process_vectorscope
   // and scan, or do an optimized search (1/2, 1/2, 1/2, etc.) --
   // would also find point sample pixel this way
 
-  DT_OMP_FOR(collapse(2))
+  DT_OMP_FOR()
   for(size_t y=0; y<sample_max_y; y+=2)
+  {
+    uint32_t *const restrict binned = dt_get_perthread(partial_binned, bin_pad);
     for(size_t x=0; x<sample_max_x; x+=2)
     {
       // FIXME: There are unnecessary color math hops. Right now the
@@ -833,8 +841,9 @@ static void _lib_histogram_process_vectorscope
 
       // clip any out-of-scale values, so there aren't light edges
       if(out_x >= 0 && out_x <= diam_px-1 && out_y >= 0 && out_y <= diam_px-1)
-        dt_atomic_add_int(binned + out_y * diam_px + out_x, 1);
+        binned[out_y * diam_px + out_x]++;
     }
+  }
 
   dt_aligned_pixel_t RGB = {0.f}, chromaticity;
   const dt_lib_colorpicker_statistic_t statistic =
@@ -904,17 +913,20 @@ static void _lib_histogram_process_vectorscope
   const float gain = 1.f / 30.f;
   const float scale = gain * (diam_px * diam_px) / (sample_width * sample_height);
 
-  // loop appears to be too small to benefit w/OpenMP
-  // FIXME: is this still true?
+  // summing up the per-thread bins makes it worth to parallelize
+  const size_t nthreads = dt_get_num_threads();
+  DT_OMP_FOR()
   for(size_t out_y = 0; out_y < diam_px; out_y++)
     for(size_t out_x = 0; out_x < diam_px; out_x++)
     {
-      const int count = binned[out_y * diam_px + out_x];
+      uint32_t count = 0;
+      for(size_t n = 0; n < nthreads; n++)
+        count += dt_get_bythread(partial_binned, bin_pad, n)[out_y * diam_px + out_x];
       const float intensity = lut[(int)(MIN(1.f, scale * count) * lutmax)];
       graph[out_y * out_stride + out_x] = intensity * 255.0f;
     }
 
-  dt_free_align(binned);
+  dt_free_align(partial_binned);
 }
 
 static void dt_lib_histogram_process
@@ -1019,8 +1031,17 @@ static void dt_lib_histogram_process
 
   const dt_iop_order_iccprofile_info_t *profile_info_out = !profile_info_to ? fallback : profile_info_to;
 
-  dt_ioppr_transform_image_colorspace_rgb(input, img_display, width, height,
-                                            profile_info_from, profile_info_out, "final histogram");
+  // only the rows the scopes look at need the conversion, the
+  // vectorscope falls back to the whole image for a point sample
+  const dt_lib_histogram_scope_type_t scope_type = d->scope_type;
+  const int sample_height = height - roi.crop_bottom - roi.crop_y;
+  const gboolean point = width - roi.crop_right - roi.crop_x <= 1 && sample_height <= 1;
+  const gboolean whole = scope_type == DT_LIB_HISTOGRAM_SCOPE_VECTORSCOPE && point;
+  const int row0 = whole ? 0 : MIN(roi.crop_y, height - 1);
+  const int rows = whole ? height : MIN(MAX(1, sample_height), height - row0);
+  const size_t offset = (size_t)4 * width * row0;
+  dt_ioppr_transform_image_colorspace_rgb(input + offset, img_display + offset, width, rows,
+                                          profile_info_from, profile_info_out, "final histogram");
   dt_pthread_mutex_lock(&d->lock);
   switch(d->scope_type)
   {
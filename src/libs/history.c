@@ -646,6 +646,30 @@ static void _history_undo_data_free(gpointer data)
   free(data);
 }
 
+// approximate memory held by an undo snapshot, used to bound the undo list
+static size_t _history_undo_data_size(const dt_undo_history_t *hist)
+{
+  size_t size = sizeof(dt_undo_history_t)
+    + g_list_length(hist->iop_order_list) * sizeof(dt_iop_order_entry_t);
+
+  for(const GList *h = hist->history; h; h = g_list_next(h))
+  {
+    const dt_dev_history_item_t *item = h->data;
+    size += sizeof(dt_dev_history_item_t) + sizeof(dt_develop_blend_params_t);
+    if(item->module) size += item->module->params_size;
+
+    for(const GList *f = item->forms; f; f = g_list_next(f))
+    {
+      const dt_masks_form_t *form = f->data;
+      const size_t point_size = form->functions
+        ? form->functions->point_struct_size
+        : sizeof(dt_masks_point_group_t);
+      size += sizeof(dt_masks_form_t) + g_list_length(form->points) * point_size;
+    }
+  }
+  return size;
+}
+
 static void _lib_history_module_remove_callback(gpointer instance,
                                                 dt_iop_module_t *module,
                                                 gpointer user_data)
@@ -681,8 +705,9 @@ static void _lib_history_will_change_callback(gpointer instance,
       hist->request_mask_display = DT_DEV_PIXELPIPE_DISPLAY_NONE;
     }
 
-    dt_undo_record(darktable.undo, self, DT_UNDO_HISTORY, (dt_undo_data_t)hist,
-                   _pop_undo, _history_undo_data_free);
+    dt_undo_record_sized(darktable.undo, self, DT_UNDO_HISTORY, (dt_undo_data_t)hist,
+                         _history_undo_data_size(hist),
+                         _pop_undo, _history_undo_data_free);
   }
 }
 
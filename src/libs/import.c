@@ -2121,6 +2121,9 @@ static void _import_from_dialog_new(dt_lib_module_t* self)
   gtk_widget_set_hexpand(gtk_grid_get_child_at(grid, col++, line++), TRUE);
   g_signal_connect(G_OBJECT(ignore_nonraws), "toggled",
                    G_CALLBACK(_ignore_nonraws_toggled), self);
+  col = 0;
+  dt_gui_preferences_bool(grid, "ui_last/import_skip_duplicates", col++, line, TRUE);
+  gtk_widget_set_hexpand(gtk_grid_get_child_at(grid, col++, line++), TRUE);
   gtk_box_pack_start(GTK_BOX(rbox), GTK_WIDGET(grid), FALSE, FALSE, 8);
 
   // files list
@@ -2497,6 +2500,7 @@ const struct
   int type;
 } _pref[] = {
   {"ui_last/import_ignore_nonraws",     "ignore_nonraws",     DT_BOOL},
+  {"ui_last/import_skip_duplicates",    "skip_duplicates",    DT_BOOL},
   {"ui_last/import_apply_metadata",     "apply_metadata",     DT_BOOL},
   {"ui_last/import_recursive",          "recursive",          DT_BOOL},
   {"ui_last/ignore_exif_rating",        "ignore_exif_rating", DT_BOOL},
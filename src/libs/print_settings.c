@@ -436,61 +436,38 @@ static int _export_image(dt_job_t *job, dt_image_box *img)
   return 0;
 }
 
-static void _create_pdf(dt_job_t *job,
-                        dt_images_box imgs,
-                        const float width,
-                        const float height)
+// write the exported image of box into the pdf and release its buffer, so that
+// only one image of the page is held in memory at a time
+static dt_pdf_image_t *_add_pdf_image(dt_job_t *job,
+                                      dt_pdf_t *pdf,
+                                      dt_image_box *box)
 {
   dt_lib_print_job_t *params = dt_control_job_get_params(job);
 
-  const float page_width  = dt_pdf_mm_to_point(width);
-  const float page_height = dt_pdf_mm_to_point(height);
+  const int resolution = params->prt.printer.resolution;
   const int icc_id = 0;
 
-  dt_pdf_image_t *pdf_image[MAX_IMAGE_PER_PAGE];
-
-  // create the PDF page
-  dt_pdf_t *pdf = dt_pdf_start(params->pdf_filename, page_width, page_height,
-                               params->prt.printer.resolution,
-                               DT_PDF_STREAM_ENCODER_FLATE);
-
 /*
   // ??? should a profile be embedded here?
   if(*printer_profile)
     icc_id = dt_pdf_add_icc(pdf, printer_profile);
 */
-  int32_t count = 0;
-
-  for(int k=0; k<imgs.count; k++)
-  {
-    const int resolution = params->prt.printer.resolution;
-    const dt_image_box *box = &imgs.box[k];
+  dt_pdf_image_t *pdf_image =
+    dt_pdf_add_image(pdf, (uint8_t *)box->buf, box->exp_width, box->exp_height,
+                     8, icc_id, 0.0);
 
-    if(dt_is_valid_imgid(box->imgid))
-    {
-      pdf_image[count] =
-        dt_pdf_add_image(pdf, (uint8_t *)box->buf, box->exp_width, box->exp_height,
-                         8, icc_id, 0.0);
-
-      //  PDF bounding-box has origin on bottom-left
-      pdf_image[count]->bb_x      = dt_pdf_pixel_to_point(box->print.x, resolution);
-      pdf_image[count]->bb_y      = dt_pdf_pixel_to_point(box->print.y, resolution);
-      pdf_image[count]->bb_width  = dt_pdf_pixel_to_point(box->print.width, resolution);
-      pdf_image[count]->bb_height = dt_pdf_pixel_to_point(box->print.height, resolution);
-      count++;
-    }
-  }
+  free(box->buf);
+  box->buf = NULL;
 
-  params->pdf_page = dt_pdf_add_page(pdf, pdf_image, count);
-  dt_pdf_finish(pdf, &params->pdf_page, 1);
-
-  // now releases all the buf
-  for(int k=0; k<imgs.count; k++)
+  if(pdf_image)
   {
-    dt_image_box *box = &imgs.box[k];
-    g_free(box->buf);
-    box->buf = NULL;
+    //  PDF bounding-box has origin on bottom-left
+    pdf_image->bb_x      = dt_pdf_pixel_to_point(box->print.x, resolution);
+    pdf_image->bb_y      = dt_pdf_pixel_to_point(box->print.y, resolution);
+    pdf_image->bb_width  = dt_pdf_pixel_to_point(box->print.width, resolution);
+    pdf_image->bb_height = dt_pdf_pixel_to_point(box->print.height, resolution);
   }
+  return pdf_image;
 }
 
 void _fill_box_values(dt_lib_print_settings_t *ps)
@@ -557,26 +534,6 @@ static int _print_job_run(dt_job_t *job)
 {
   dt_lib_print_job_t *params = dt_control_job_get_params(job);
 
-  // get first image on a box, needed as print leader
-
-  dt_imgid_t imgid = NO_IMGID;
-
-  // compute the needed size for picture for the given printer resolution
-
-  for(int k=0; k<params->imgs.count; k++)
-  {
-    if(dt_is_valid_imgid(params->imgs.box[k].imgid))
-    {
-      if(!dt_is_valid_imgid(imgid)) imgid = params->imgs.box[k].imgid;
-      if(_export_and_setup_pos(job, &params->imgs.box[k], k))
-        return 1;
-    }
-  }
-
-  if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
-    return 0;
-  dt_control_job_set_progress(job, 0.9);
-
   dt_loc_get_tmp_dir(params->pdf_filename, sizeof(params->pdf_filename));
   g_strlcat(params->pdf_filename, "/pf.XXXXXX.pdf", sizeof(params->pdf_filename));
 
@@ -592,7 +549,57 @@ static int _print_job_run(dt_job_t *job)
   float width, height;
   _get_page_dimension(&params->prt, &width, &height);
 
-  _create_pdf(job, params->imgs, width, height);
+  // create the PDF page, each image is written as soon as it is exported
+  dt_pdf_t *pdf = dt_pdf_start(params->pdf_filename,
+                               dt_pdf_mm_to_point(width), dt_pdf_mm_to_point(height),
+                               params->prt.printer.resolution,
+                               DT_PDF_STREAM_ENCODER_FLATE);
+  if(!pdf)
+  {
+    dt_control_log(_("failed to create temporary PDF for printing"));
+    dt_print(DT_DEBUG_ALWAYS, "failed to create temporary PDF for printing");
+    return 1;
+  }
+
+  // get first image on a box, needed as print leader
+
+  dt_imgid_t imgid = NO_IMGID;
+  dt_pdf_image_t *pdf_image[MAX_IMAGE_PER_PAGE];
+  int32_t count = 0;
+
+  // compute the needed size for picture for the given printer resolution
+
+  for(int k=0; k<params->imgs.count; k++)
+  {
+    dt_image_box *box = &params->imgs.box[k];
+    if(dt_is_valid_imgid(box->imgid))
+    {
+      if(!dt_is_valid_imgid(imgid)) imgid = box->imgid;
+      if(_export_and_setup_pos(job, box, k))
+      {
+        for(int i=0; i<count; i++)
+          free(pdf_image[i]);
+        dt_pdf_finish(pdf, NULL, 0);
+        return 1;
+      }
+      pdf_image[count] = _add_pdf_image(job, pdf, box);
+      if(pdf_image[count]) count++;
+    }
+    if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
+    {
+      for(int i=0; i<count; i++)
+        free(pdf_image[i]);
+      dt_pdf_finish(pdf, NULL, 0);
+      return 0;
+    }
+  }
+  dt_control_job_set_progress(job, 0.9);
+
+  params->pdf_page = dt_pdf_add_page(pdf, pdf_image, count);
+  dt_pdf_finish(pdf, &params->pdf_page, params->pdf_page ? 1 : 0);
+
+  for(int k=0; k<count; k++)
+    free(pdf_image[k]);
 
   if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED) return 0;
   dt_control_job_set_progress(job, 0.95);
@@ -39,6 +39,19 @@ DT_MODULE(1)
 // undo/redo support.
 #define SNAPSHOT_ID_OFFSET 0xFFFFFF00
 
+// number of previously rendered views kept per snapshot
+#define SNAPSHOT_VIEWS 2
+
+/* a rendered view of a snapshot */
+typedef struct dt_lib_snapshot_view_t
+{
+  dt_view_context_t ctx;
+  uint8_t *buf;
+  float scale;
+  size_t width, height;
+  dt_dev_zoom_pos_t zoom_pos;
+} dt_lib_snapshot_view_t;
+
 /* a snapshot */
 typedef struct dt_lib_snapshot_t
 {
@@ -55,10 +68,13 @@ typedef struct dt_lib_snapshot_t
   dt_imgid_t imgid;
   uint32_t history_end;
   uint32_t id;
+  dt_view_context_t buf_ctx; // view the buffer below was rendered for
   uint8_t *buf;
   float scale;
   size_t width, height;
   dt_dev_zoom_pos_t zoom_pos;
+  // earlier renders, going back to one of these views needs no pipe run
+  dt_lib_snapshot_view_t views[SNAPSHOT_VIEWS];
 } dt_lib_snapshot_t;
 
 typedef struct dt_lib_snapshots_t
@@ -179,6 +195,55 @@ static gboolean _snap_expose_again(gpointer user_data)
   return FALSE;
 }
 
+static void _snapshot_view_swap(dt_lib_snapshot_t *snap, dt_lib_snapshot_view_t *view)
+{
+  dt_lib_snapshot_view_t shown = { snap->buf_ctx, snap->buf, snap->scale,
+                                   snap->width, snap->height };
+  memcpy(shown.zoom_pos, snap->zoom_pos, sizeof(dt_dev_zoom_pos_t));
+  snap->buf_ctx = view->ctx;
+  snap->buf = view->buf;
+  snap->scale = view->scale;
+  snap->width = view->width;
+  snap->height = view->height;
+  memcpy(snap->zoom_pos, view->zoom_pos, sizeof(dt_dev_zoom_pos_t));
+  *view = shown;
+}
+
+/* keep the shown buffer as the most recent view, dropping the oldest one */
+static void _snapshot_view_keep(dt_lib_snapshot_t *snap)
+{
+  dt_free_align(snap->views[SNAPSHOT_VIEWS - 1].buf);
+  memmove(&snap->views[1], &snap->views[0],
+          sizeof(dt_lib_snapshot_view_t) * (SNAPSHOT_VIEWS - 1));
+  snap->views[0].buf = NULL;
+  if(snap->buf) _snapshot_view_swap(snap, &snap->views[0]);
+}
+
+/* show an earlier render of this view if there is one */
+static gboolean _snapshot_view_restore(dt_lib_snapshot_t *snap,
+                                       const dt_view_context_t ctx)
+{
+  for(int k = 0; k < SNAPSHOT_VIEWS; k++)
+  {
+    if(snap->views[k].buf && snap->views[k].ctx == ctx)
+    {
+      _snapshot_view_swap(snap, &snap->views[k]);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static void _snapshot_views_clear(dt_lib_snapshot_t *snap)
+{
+  for(int k = 0; k < SNAPSHOT_VIEWS; k++)
+  {
+    dt_free_align(snap->views[k].buf);
+    snap->views[k].buf = NULL;
+  }
+  snap->buf_ctx = 0;
+}
+
 /* check if (x,y) closer to rotation sym than area_size. Set the size of area s
    and the center of the sym (rx, ry). Return TRUE if (x,y) in sym area. */
 static inline gboolean _get_rotation_area(dt_lib_module_t *self,
@@ -231,15 +296,18 @@ void gui_post_expose(dt_lib_module_t *self,
     // if a new snapshot is needed, do this now
     if(d->snap_requested && snap->ctx == ctx)
     {
-      dt_free_align(snap->buf);
-      snap->buf = NULL;
-
-      // export image with proper size
-      dt_dev_image(snap->imgid, width, height,
-                   snap->history_end,
-                   &snap->buf, &snap->scale,
-                   &snap->width, &snap->height, snap->zoom_pos,
-                   snap->id, NULL, DT_DEVICE_NONE, FALSE);
+      if(!snap->buf || snap->buf_ctx != ctx)
+      {
+        _snapshot_view_keep(snap);
+
+        // export image with proper size
+        dt_dev_image(snap->imgid, width, height,
+                     snap->history_end,
+                     &snap->buf, &snap->scale,
+                     &snap->width, &snap->height, snap->zoom_pos,
+                     snap->id, NULL, DT_DEVICE_NONE, FALSE);
+        snap->buf_ctx = ctx;
+      }
       d->snap_requested = FALSE;
       d->expose_again_timeout_id = 0;
     }
@@ -257,12 +325,19 @@ void gui_post_expose(dt_lib_module_t *self,
       //    with the navigation module
 
       snap->ctx = ctx;
-      if(!d->panning && dev->darkroom_mouse_in_center_area)
-        d->snap_requested = TRUE;
       if(d->expose_again_timeout_id != 0)
         g_source_remove(d->expose_again_timeout_id);
+      d->expose_again_timeout_id = 0;
 
-      d->expose_again_timeout_id = g_timeout_add(150, _snap_expose_again, d);
+      // this view was rendered before, show it again right away
+      if(_snapshot_view_restore(snap, ctx))
+        d->snap_requested = FALSE;
+      else
+      {
+        if(!d->panning && dev->darkroom_mouse_in_center_area)
+          d->snap_requested = TRUE;
+        d->expose_again_timeout_id = g_timeout_add(150, _snap_expose_again, d);
+      }
     }
 
     float pzx, pzy, zoom_scale;
@@ -627,6 +702,7 @@ static void _clear_snapshot_entry(dt_lib_snapshot_t *s)
 
   g_free(s->module);
   g_free(s->label);
+  _snapshot_views_clear(s);
   dt_free_align(s->buf);
   s->module = NULL;
   s->label = NULL;
@@ -668,6 +744,10 @@ static void _signal_profile_changed(gpointer instance,
   {
     dt_lib_snapshots_t *d = self->data;
 
+    // the earlier renders used the old profile
+    for(uint32_t k = 0; k < MAX_SNAPSHOT; k++)
+      _snapshot_views_clear(&d->snapshot[k]);
+
     if(d->selected >= 0)
       d->snap_requested = TRUE;
 
@@ -688,6 +768,12 @@ static void _remove_snapshot_entry(dt_lib_module_t *self, const uint32_t index)
     memcpy(&d->snapshot[k], &d->snapshot[k+1], sizeof(dt_lib_snapshot_t));
   }
 
+  //  The buffers of the last entry are now owned by the one before
+  dt_lib_snapshot_t *last = &d->snapshot[MAX_SNAPSHOT-1];
+  last->buf = NULL;
+  for(int k = 0; k < SNAPSHOT_VIEWS; k++)
+    last->views[k].buf = NULL;
+
   //  And finally clear last entry
   _clear_snapshot_entry(&d->snapshot[MAX_SNAPSHOT-1]);
   //  And dedup widgets by initializing the last entry
@@ -141,12 +141,8 @@ static int generate_cache(lua_State *L)
 
   for(int k = max; k >= min && k >= 0; k--)
   {
-    char filename[PATH_MAX] = { 0 };
-    snprintf(filename, sizeof(filename),
-             "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
-
-    // if a valid thumbnail file is already on disc - do nothing
-    if(dt_util_test_image_file(filename)) continue;
+    // if a valid thumbnail is already on disc - do nothing
+    if(dt_mipmap_cache_has_disk_thumbnail(imgid, k)) continue;
     // else, generate thumbnail and store in mipmap cache.
     dt_mipmap_buffer_t buf;
     dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
@@ -159,6 +155,112 @@ static int generate_cache(lua_State *L)
 }
 
 
+/***********************************************************************
+  read-only pixels of a mipmap, copied once out of the cache
+ **********************************************************************/
+
+typedef struct dt_lua_image_pixels_t
+{
+  int32_t width, height;
+  gboolean is_float; // DT_MIPMAP_F, else 8-bit rgba
+  void *data;        // 4 channels per pixel
+} dt_lua_image_pixels_t;
+
+static int get_pixels(lua_State *L)
+{
+  dt_lua_image_t imgid = NO_IMGID;
+  luaA_to(L, dt_lua_image_t, &imgid, 1);
+  const int size = luaL_checkinteger(L, 2);
+  if(size < DT_MIPMAP_0 || size > DT_MIPMAP_F)
+    return luaL_error(L, "invalid mipmap size %d, expected %d to %d",
+                      size, DT_MIPMAP_0, DT_MIPMAP_F);
+
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(&buf, imgid, size, DT_MIPMAP_BLOCKING, 'r');
+  if(!buf.buf || buf.width <= 0 || buf.height <= 0)
+  {
+    dt_mipmap_cache_release(&buf);
+    lua_pushnil(L);
+    return 1;
+  }
+
+  dt_lua_image_pixels_t pixels;
+  pixels.width = buf.width;
+  pixels.height = buf.height;
+  pixels.is_float = size == DT_MIPMAP_F;
+  const size_t bytes = (size_t)buf.width * buf.height * 4
+    * (pixels.is_float ? sizeof(float) : sizeof(uint8_t));
+  pixels.data = g_malloc(bytes);
+  memcpy(pixels.data, buf.buf, bytes);
+  dt_mipmap_cache_release(&buf);
+
+  luaA_push(L, dt_lua_image_pixels_t, &pixels);
+  return 1;
+}
+
+static int pixels_width_member(lua_State *L)
+{
+  dt_lua_image_pixels_t pixels;
+  luaA_to(L, dt_lua_image_pixels_t, &pixels, 1);
+  lua_pushinteger(L, pixels.width);
+  return 1;
+}
+
+static int pixels_height_member(lua_State *L)
+{
+  dt_lua_image_pixels_t pixels;
+  luaA_to(L, dt_lua_image_pixels_t, &pixels, 1);
+  lua_pushinteger(L, pixels.height);
+  return 1;
+}
+
+static int pixels_is_float_member(lua_State *L)
+{
+  dt_lua_image_pixels_t pixels;
+  luaA_to(L, dt_lua_image_pixels_t, &pixels, 1);
+  lua_pushboolean(L, pixels.is_float);
+  return 1;
+}
+
+// returns r, g, b, a of the pixel at x, y (from 0), 8-bit values scaled to [0,1]
+static int pixels_get_pixel(lua_State *L)
+{
+  dt_lua_image_pixels_t pixels;
+  luaA_to(L, dt_lua_image_pixels_t, &pixels, 1);
+  const int x = luaL_checkinteger(L, 2);
+  const int y = luaL_checkinteger(L, 3);
+  if(x < 0 || y < 0 || x >= pixels.width || y >= pixels.height)
+    return luaL_error(L, "pixel %d, %d is outside of %dx%d", x, y, pixels.width, pixels.height);
+
+  const size_t k = ((size_t)y * pixels.width + x) * 4;
+  for(int c = 0; c < 4; c++)
+  {
+    if(pixels.is_float)
+      lua_pushnumber(L, ((const float *)pixels.data)[k + c]);
+    else
+      lua_pushnumber(L, ((const uint8_t *)pixels.data)[k + c] / 255.0);
+  }
+  return 4;
+}
+
+static int pixels_gc(lua_State *L)
+{
+  dt_lua_image_pixels_t pixels;
+  luaA_to(L, dt_lua_image_pixels_t, &pixels, -1);
+  g_free(pixels.data);
+  return 0;
+}
+
+static int pixels_tostring(lua_State *L)
+{
+  dt_lua_image_pixels_t pixels;
+  luaA_to(L, dt_lua_image_pixels_t, &pixels, 1);
+  lua_pushfstring(L, "%dx%d %s", pixels.width, pixels.height,
+                  pixels.is_float ? "float" : "8-bit");
+  return 1;
+}
+
+
 static int path_member(lua_State *L)
 {
   const dt_image_t *my_image = checkreadimage(L, 1);
@@ -681,9 +783,28 @@ int dt_lua_init_image(lua_State *L)
   lua_pushcfunction(L, apply_sidecar);
   lua_pushcclosure(L, dt_lua_type_member_common, 1);
   dt_lua_type_register_const(L, dt_lua_image_t, "apply_sidecar");
+  lua_pushcfunction(L, get_pixels);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const(L, dt_lua_image_t, "get_pixels");
   lua_pushcfunction(L, image_tostring);
   dt_lua_type_setmetafield(L,dt_lua_image_t,"__tostring");
 
+  // pixels returned by get_pixels
+  dt_lua_init_type(L, dt_lua_image_pixels_t);
+  lua_pushcfunction(L, pixels_width_member);
+  dt_lua_type_register_const(L, dt_lua_image_pixels_t, "width");
+  lua_pushcfunction(L, pixels_height_member);
+  dt_lua_type_register_const(L, dt_lua_image_pixels_t, "height");
+  lua_pushcfunction(L, pixels_is_float_member);
+  dt_lua_type_register_const(L, dt_lua_image_pixels_t, "is_float");
+  lua_pushcfunction(L, pixels_get_pixel);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const(L, dt_lua_image_pixels_t, "get_pixel");
+  lua_pushcfunction(L, pixels_gc);
+  dt_lua_type_setmetafield(L,dt_lua_image_pixels_t,"__gc");
+  lua_pushcfunction(L, pixels_tostring);
+  dt_lua_type_setmetafield(L,dt_lua_image_pixels_t,"__tostring");
+
   return 0;
 }
 
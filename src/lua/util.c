@@ -1,6 +1,6 @@
 /*
    This file is part of darktable,
-   Copyright (C) 2024 darktable developers.
+   Copyright (C) 2024-2025 darktable developers.
 
    darktable is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
@@ -16,6 +16,7 @@
    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "lua/preferences.h"
+#include "common/mipmap_cache.h"
 #include "lua/call.h"
 #include "lua/events.h"
 #include <glib.h>
@@ -39,6 +40,28 @@ static int message(lua_State *L)
   return 0;
 }
 
+// mipmap cache counters of this run, by level name
+static int mipmap_stats(lua_State *L)
+{
+  lua_newtable(L);
+  for(dt_mipmap_size_t k = DT_MIPMAP_0; k < DT_MIPMAP_NONE; k++)
+  {
+    dt_mipmap_cache_stats_t stats;
+    dt_mipmap_cache_get_stats(k, &stats);
+    lua_newtable(L);
+    lua_pushinteger(L, stats.hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, stats.misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushinteger(L, stats.evictions);
+    lua_setfield(L, -2, "evictions");
+    lua_pushinteger(L, stats.fetch_ms);
+    lua_setfield(L, -2, "fetch_ms");
+    lua_setfield(L, -2, dt_mipmap_cache_level_name(k));
+  }
+  return 1;
+}
+
 
 int dt_lua_init_util(lua_State *L)
 {
@@ -47,6 +70,8 @@ int dt_lua_init_util(lua_State *L)
 
   lua_pushcfunction(L, message);
   lua_setfield(L, -2, "message");
+  lua_pushcfunction(L, mipmap_stats);
+  lua_setfield(L, -2, "mipmap_stats");
 
   lua_pop(L, 1);
 
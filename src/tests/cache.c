@@ -1,6 +1,6 @@
 /*
     This file is part of darktable,
-    Copyright (C) 2011-2023 darktable developers.
+    Copyright (C) 2011-2025 darktable developers.
 
     darktable is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -16,15 +16,11 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+// test of the sharded LRU cache and a benchmark of its lock contention.
+// usage: darktable-test-cache [threads]
 
-#define DT_UNIT_TEST
-// define dt alloc_aligned, so we don't need to include the rest of dt:
-#define dt_alloc_aligned(A, B) malloc(B)
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-
-// unit test for the concurrent hopscotch hashmap and the LRU cache built on top of it.
 #include "common/cache.h"
-#include "common/cache.c"
+#include "common/darktable.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -33,103 +29,134 @@
 #include <omp.h>
 #endif
 
-int32_t alloc_dummy(void *data, const uint32_t key, int32_t *cost, void **buf)
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+static void _alloc_dummy(void *data, dt_cache_entry_t *entry)
+{
+  entry->cost = 1;
+  entry->data_size = sizeof(uint32_t);
+  entry->data = malloc(sizeof(uint32_t));
+  *(uint32_t *)entry->data = entry->key;
+}
+
+static void _cleanup_dummy(void *data, dt_cache_entry_t *entry)
 {
-  *cost = 1; // also the default
-  *buf = (void *)(long int)key;
-  // request write lock for our buffer?
-  return 0;
+  free(entry->data);
 }
 
-int main(int argc, char *arg[])
+static int _count_entries(dt_cache_t *cache)
+{
+  int count = 0;
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+  {
+    const int size = g_hash_table_size(cache->shard[k].hashtable);
+    const int lru = g_queue_get_length(&cache->shard[k].lru);
+    if(size != lru) return -1;
+    count += size;
+  }
+  return count;
+}
+
+static int _test_insert(const int threads, const size_t quota, const int n)
 {
   dt_cache_t cache;
-  // dt_cache_init(&cache, 110000, 16, 64, 100000);
-  // really hammer it, make quota insanely low:
-  dt_cache_init(&cache, 110000, 16, 64, 100);
-  dt_cache_set_allocate_callback(&cache, alloc_dummy, NULL);
+  dt_cache_init(&cache, 0, quota);
+  dt_cache_set_allocate_callback(&cache, _alloc_dummy, NULL);
+  dt_cache_set_cleanup_callback(&cache, _cleanup_dummy, NULL);
 
+  int failed = 0;
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(guided) shared(cache, stderr) num_threads(16)
+#pragma omp parallel for schedule(guided) shared(cache) reduction(+ : failed) num_threads(threads)
 #endif
-  for(int k = 0; k < 100000; k++)
+  for(int k = 0; k < n; k++)
   {
-    void *data = (void *)(long int)k;
-    const int size = 0; // dt_cache_size(&cache);
-    const int con1 = dt_cache_contains(&cache, k);
-    const int val1 = (int)(long int)dt_cache_read_get(&cache, k);
-    const int val2 = (int)(long int)dt_cache_read_get(&cache, k);
-    // fprintf(stderr, "\rinserted number %d, size %d, value %d - %d, contains %d - %d", k, size, val1, val2,
-    // con1, con2);
-    const int con2 = dt_cache_contains(&cache, k);
-    assert(con1 == 0);
-    assert(con2 == 1);
-    assert(val2 == k);
-    dt_cache_read_release(&cache, k);
-    dt_cache_read_release(&cache, k);
+    dt_cache_entry_t *entry = dt_cache_get(&cache, k, 'w');
+    if(*(uint32_t *)entry->data != (uint32_t)k) failed++;
+    dt_cache_release(&cache, entry);
+    entry = dt_cache_get(&cache, k, 'r');
+    if(*(uint32_t *)entry->data != (uint32_t)k) failed++;
+    dt_cache_release(&cache, entry);
   }
-  dt_cache_print_locked(&cache);
-  // fprintf(stderr, "\n");
-  fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
-
-  const int size = dt_cache_size(&cache);
-  const int lru_cnt = lru_check_consistency(&cache);
-  const int lru_cnt_r = lru_check_consistency_reverse(&cache);
-  // fprintf(stderr, "lru list contains %d|%d/%d entries\n", lru_cnt, lru_cnt_r, size);
-  assert(size == lru_cnt);
-  assert(lru_cnt_r == lru_cnt);
-  fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n", size);
 
+  const int count = _count_entries(&cache);
+  if(count < 0 || dt_cache_cost(&cache) != (size_t)count) failed++;
+  fprintf(stderr, "[%s] inserting %d entries with quota %zu, %d left\n",
+          failed ? "FAILED" : "passed", n, quota, count);
   dt_cache_cleanup(&cache);
+  return failed;
+}
 
+// an entry costly to regenerate outlives a cheap one of the same age
+static int _test_weight(const size_t quota)
+{
+  dt_cache_t cache;
+  dt_cache_init(&cache, 0, quota);
+  dt_cache_set_allocate_callback(&cache, _alloc_dummy, NULL);
+  dt_cache_set_cleanup_callback(&cache, _cleanup_dummy, NULL);
+
+  dt_cache_entry_t *entry = dt_cache_get(&cache, 0, 'w');
+  entry->weight = 2;
+  dt_cache_release(&cache, entry);
+  dt_cache_release(&cache, dt_cache_get(&cache, 1, 'r'));
+
+  // fill up until the cheap one is gone
+  uint32_t k = 2;
+  while(dt_cache_contains(&cache, 1) && k < 4 * quota)
+    dt_cache_release(&cache, dt_cache_get(&cache, k++, 'r'));
+
+  const int failed = dt_cache_contains(&cache, 1) || !dt_cache_contains(&cache, 0);
+  fprintf(stderr, "[%s] weighted entry kept after %u insertions\n",
+          failed ? "FAILED" : "passed", k - 2);
+  dt_cache_cleanup(&cache);
+  return failed;
+}
 
+// all threads read from a working set that fits the cache, which is what
+// thumbnails and exports do with the image cache
+static void _bench_contention(const int threads, const int n)
+{
+  const uint32_t working_set = 1024;
+  dt_cache_t cache;
+  dt_cache_init(&cache, 0, 2 * working_set);
+  dt_cache_set_allocate_callback(&cache, _alloc_dummy, NULL);
+  dt_cache_set_cleanup_callback(&cache, _cleanup_dummy, NULL);
 
-  {
-    // now a harder case: a cache with only one entry and a lot of threads fighting over it:
-    dt_cache_t cache2;
-    // really hammer it, make quota insanely low:
-    // capacity 1 num threads 1 cache line size 64 ignored, quota 2 (80% => 1)
-    dt_cache_init(&cache2, 1, 1, 64, 2);
-    dt_cache_set_allocate_callback(&cache2, alloc_dummy, NULL);
-
+  const double start = dt_get_wtime();
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(guided) shared(cache2, stderr) num_threads(16)
+#pragma omp parallel for schedule(static) shared(cache) num_threads(threads)
 #endif
-    for(int k = 0; k < 100000; k++)
-    {
-      void *data = (void *)(long int)k;
-      const int size = 0; // dt_cache_size(&cache);
-      const int con1 = dt_cache_contains(&cache2, k);
-      const int val1 = (int)(long int)dt_cache_read_get(&cache2, k);
-      const int val2 = (int)(long int)dt_cache_read_get(&cache2, k);
-      // fprintf(stderr, "\rinserted number %d, size %d, value %d - %d, contains %d - %d", k, size, val1,
-      // val2, con1, con2);
-      const int con2 = dt_cache_contains(&cache2, k);
-      assert(con1 == 0);
-      assert(con2 == 1);
-      assert(val2 == k);
-      dt_cache_read_release(&cache2, k);
-      dt_cache_read_release(&cache2, k);
-    }
-    dt_cache_print_locked(&cache2);
-    // fprintf(stderr, "\n");
-    fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
-
-    const int size = dt_cache_size(&cache2);
-    const int lru_cnt = lru_check_consistency(&cache2);
-    const int lru_cnt_r = lru_check_consistency_reverse(&cache2);
-    // fprintf(stderr, "lru list contains %d|%d/%d entries\n", lru_cnt, lru_cnt_r, size);
-    assert(size == lru_cnt);
-    assert(lru_cnt_r == lru_cnt);
-    fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n", size);
-    dt_cache_cleanup(&cache2);
+  for(int k = 0; k < n; k++)
+  {
+    const uint32_t key = (k * 7919u) % working_set;
+    dt_cache_entry_t *entry = dt_cache_get(&cache, key, 'r');
+    dt_cache_release(&cache, entry);
   }
+  const double elapsed = dt_get_wtime() - start;
 
-  exit(0);
+  fprintf(stderr, "[bench] %d threads, %d lookups in %.3fs (%.2f M/s)\n",
+          threads, n, elapsed, n / elapsed * 1e-6);
+  dt_cache_cleanup(&cache);
 }
+
+int main(int argc, char *argv[])
+{
+  const int threads = argc > 1 ? atoi(argv[1]) : 16;
+
+  int failed = _test_insert(threads, 100, 100000);
+  // a cache with only one entry and a lot of threads fighting over it
+  failed += _test_insert(threads, 2, 100000);
+  failed += _test_weight(100);
+
+  for(int t = 1; t <= threads; t *= 2)
+    _bench_contention(t, 4000000);
+
+  return failed ? 1 : 0;
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
 // clang-format on
-
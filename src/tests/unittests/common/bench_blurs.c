@@ -0,0 +1,215 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka micro-benchmarks for the blurs in common/box_filters.c and
+ * common/gaussian.c over OpenMP thread counts.
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+#include "../util/bench.h"
+
+#include "common/darktable.h"
+#include "common/box_filters.h"
+#include "common/gaussian.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// the rgb space test image of width BENCH_WIDTH is BENCH_WIDTH^2 pixels high:
+#define BENCH_WIDTH 64
+
+#define BENCH_RADIUS 8
+#define BENCH_SIGMA 8.0f
+
+typedef struct bench_buffers_t
+{
+  int width;
+  int height;
+  float *in;
+  float *out;
+  dt_gaussian_t *gauss;
+} bench_buffers_t;
+
+static bench_buffers_t buffers;
+
+
+/*
+ * KERNELS
+ */
+
+static void kernel_box_mean(void *data)
+{
+  const bench_buffers_t *const b = data;
+  // the box filter works in place, start from the same input every time
+  memcpy(b->out, b->in, sizeof(float) * 4 * b->width * b->height);
+  dt_box_mean(b->out, b->height, b->width, 4, BENCH_RADIUS, 1);
+}
+
+static void kernel_box_mean_kahan(void *data)
+{
+  const bench_buffers_t *const b = data;
+  memcpy(b->out, b->in, sizeof(float) * 4 * b->width * b->height);
+  dt_box_mean(b->out, b->height, b->width, 4 | BOXFILTER_KAHAN_SUM,
+              BENCH_RADIUS, 1);
+}
+
+// the min/max filters only take one channel, run them on the channels side by side
+static void kernel_box_max(void *data)
+{
+  const bench_buffers_t *const b = data;
+  memcpy(b->out, b->in, sizeof(float) * 4 * b->width * b->height);
+  dt_box_max(b->out, b->height, 4 * b->width, 1, BENCH_RADIUS);
+}
+
+static void kernel_box_min(void *data)
+{
+  const bench_buffers_t *const b = data;
+  memcpy(b->out, b->in, sizeof(float) * 4 * b->width * b->height);
+  dt_box_min(b->out, b->height, 4 * b->width, 1, BENCH_RADIUS);
+}
+
+static void kernel_gaussian(void *data)
+{
+  const bench_buffers_t *const b = data;
+  dt_gaussian_blur_4c(b->gauss, b->in, b->out);
+}
+
+
+/*
+ * SETUP
+ */
+
+static int setup(void **state)
+{
+  // the blurs run on all threads dt_get_num_threads() allows for
+  darktable.num_openmp_threads = bench_max_threads();
+
+  Testimg *ti = testimg_gen_rgb_space(BENCH_WIDTH);
+  buffers.width = ti->width;
+  buffers.height = ti->height;
+  const size_t nfloats = (size_t)4 * ti->width * ti->height;
+  buffers.in = dt_alloc_align_float(nfloats);
+  buffers.out = dt_alloc_align_float(nfloats);
+  if(buffers.in) memcpy(buffers.in, ti->pixels, sizeof(float) * nfloats);
+  testimg_free(ti);
+
+  const dt_aligned_pixel_t max = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_aligned_pixel_t min = { 0.0f, 0.0f, 0.0f, 0.0f };
+  buffers.gauss = dt_gaussian_init(buffers.width, buffers.height, 4, max, min,
+                                   BENCH_SIGMA, DT_IOP_GAUSSIAN_ZERO);
+  return (buffers.in && buffers.out && buffers.gauss) ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+  dt_gaussian_free(buffers.gauss);
+  dt_free_align(buffers.in);
+  dt_free_align(buffers.out);
+  return 0;
+}
+
+static void assert_blurred(void)
+{
+  // a blur of values in [0; 1] stays in [0; 1]
+  const size_t nfloats = (size_t)4 * buffers.width * buffers.height;
+  for(size_t k = 0; k < nfloats; k++)
+  {
+    assert_true(buffers.out[k] >= -1e-4f);
+    assert_true(buffers.out[k] <= 1.0f + 1e-4f);
+  }
+}
+
+
+/*
+ * BENCHMARK FUNCTIONS
+ */
+
+static void bench_box_mean(void **state)
+{
+  const size_t npixels = (size_t)buffers.width * buffers.height;
+  TR_STEP("measure box mean with radius %d", BENCH_RADIUS);
+  for_bench_threads(n)
+    bench_run("dt_box_mean", kernel_box_mean, &buffers, npixels);
+  assert_blurred();
+
+  TR_STEP("measure box mean with Kahan summation");
+  for_bench_threads(n)
+    bench_run("dt_box_mean (Kahan)", kernel_box_mean_kahan, &buffers, npixels);
+  assert_blurred();
+}
+
+static void bench_box_max(void **state)
+{
+  const size_t npixels = (size_t)buffers.width * buffers.height;
+  TR_STEP("measure box max with radius %d", BENCH_RADIUS);
+  for_bench_threads(n)
+    bench_run("dt_box_max", kernel_box_max, &buffers, npixels);
+  assert_blurred();
+
+  TR_STEP("measure box min with radius %d", BENCH_RADIUS);
+  for_bench_threads(n)
+    bench_run("dt_box_min", kernel_box_min, &buffers, npixels);
+  assert_blurred();
+}
+
+static void bench_gaussian(void **state)
+{
+  const size_t npixels = (size_t)buffers.width * buffers.height;
+  TR_STEP("measure gaussian blur with sigma %.1f", BENCH_SIGMA);
+  for_bench_threads(n)
+    bench_run("dt_gaussian_blur_4c", kernel_gaussian, &buffers, npixels);
+  assert_blurred();
+}
+
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(bench_box_mean),
+    cmocka_unit_test(bench_box_max),
+    cmocka_unit_test(bench_gaussian)
+  };
+
+  return cmocka_run_group_tests(tests, setup, teardown);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
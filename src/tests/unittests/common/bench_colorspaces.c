@@ -0,0 +1,249 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka micro-benchmarks for the colorspace conversions in
+ * common/colorspaces_inline_conversions.h, comparing the scalar and the SSE2
+ * code paths over OpenMP thread counts.
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+#include "../util/bench.h"
+
+#include "common/darktable.h"
+#include "common/colorspaces_inline_conversions.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// width of the rgb space test image, giving BENCH_WIDTH^3 pixels:
+#define BENCH_WIDTH 100
+
+// tolerance between the scalar and the SSE2 Lab values (L is in [0; 100]):
+#define E_LAB 5e-2f
+
+typedef struct bench_buffers_t
+{
+  size_t npixels;
+  float *in;
+  float *out;
+} bench_buffers_t;
+
+static bench_buffers_t buffers;
+
+
+/*
+ * KERNELS
+ */
+
+static void kernel_XYZ_to_Lab(void *data)
+{
+  const bench_buffers_t *const b = data;
+  const float *const in = b->in;
+  float *const out = b->out;
+  const size_t npixels = b->npixels;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+    dt_XYZ_to_Lab(in + 4 * k, out + 4 * k);
+}
+
+static void kernel_Lab_to_XYZ(void *data)
+{
+  const bench_buffers_t *const b = data;
+  const float *const in = b->in;
+  float *const out = b->out;
+  const size_t npixels = b->npixels;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+    dt_Lab_to_XYZ(in + 4 * k, out + 4 * k);
+}
+
+static void kernel_XYZ_to_prophotorgb(void *data)
+{
+  const bench_buffers_t *const b = data;
+  const float *const in = b->in;
+  float *const out = b->out;
+  const size_t npixels = b->npixels;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+    dt_XYZ_to_prophotorgb(in + 4 * k, out + 4 * k);
+}
+
+#ifdef __SSE2__
+static void kernel_XYZ_to_Lab_sse2(void *data)
+{
+  const bench_buffers_t *const b = data;
+  const float *const in = b->in;
+  float *const out = b->out;
+  const size_t npixels = b->npixels;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+    _mm_store_ps(out + 4 * k, dt_XYZ_to_Lab_sse2(_mm_load_ps(in + 4 * k)));
+}
+
+static void kernel_Lab_to_XYZ_sse2(void *data)
+{
+  const bench_buffers_t *const b = data;
+  const float *const in = b->in;
+  float *const out = b->out;
+  const size_t npixels = b->npixels;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+    _mm_store_ps(out + 4 * k, dt_Lab_to_XYZ_sse2(_mm_load_ps(in + 4 * k)));
+}
+
+static void kernel_XYZ_to_prophotorgb_sse2(void *data)
+{
+  const bench_buffers_t *const b = data;
+  const float *const in = b->in;
+  float *const out = b->out;
+  const size_t npixels = b->npixels;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+    _mm_store_ps(out + 4 * k,
+                 dt_XYZ_to_prophotoRGB_sse2(_mm_load_ps(in + 4 * k)));
+}
+#endif
+
+
+/*
+ * SETUP
+ */
+
+static int setup(void **state)
+{
+  // the conversions run on all threads dt_get_num_threads() allows for
+  darktable.num_openmp_threads = bench_max_threads();
+
+  Testimg *ti = testimg_gen_rgb_space(BENCH_WIDTH);
+  buffers.npixels = (size_t)ti->width * ti->height;
+  buffers.in = dt_alloc_align_float(4 * buffers.npixels);
+  buffers.out = dt_alloc_align_float(4 * buffers.npixels);
+  memcpy(buffers.in, ti->pixels, sizeof(float) * 4 * buffers.npixels);
+  testimg_free(ti);
+  return (buffers.in && buffers.out) ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+  dt_free_align(buffers.in);
+  dt_free_align(buffers.out);
+  return 0;
+}
+
+
+/*
+ * BENCHMARK FUNCTIONS
+ */
+
+static void bench_XYZ_to_Lab(void **state)
+{
+  TR_STEP("measure XYZ to Lab");
+  for_bench_threads(n)
+    bench_run("dt_XYZ_to_Lab", kernel_XYZ_to_Lab, &buffers, buffers.npixels);
+#ifdef __SSE2__
+  float *scalar = dt_alloc_align_float(4 * buffers.npixels);
+  memcpy(scalar, buffers.out, sizeof(float) * 4 * buffers.npixels);
+  for_bench_threads(n)
+    bench_run("dt_XYZ_to_Lab_sse2", kernel_XYZ_to_Lab_sse2, &buffers,
+      buffers.npixels);
+
+  TR_STEP("verify the SSE2 code path matches the scalar one");
+  for(size_t k = 0; k < 4 * buffers.npixels; k++)
+    if(k % 4 != 3) assert_float_equal(buffers.out[k], scalar[k], E_LAB);
+  dt_free_align(scalar);
+#endif
+}
+
+static void bench_Lab_to_XYZ(void **state)
+{
+  TR_STEP("measure Lab to XYZ");
+  // scale the rgb space to a plausible Lab range: L in [0; 100], a/b in
+  // [-64; 64]
+  for(size_t k = 0; k < buffers.npixels; k++)
+  {
+    float *const p = buffers.in + 4 * k;
+    p[0] *= 100.0f;
+    p[1] = 128.0f * p[1] - 64.0f;
+    p[2] = 128.0f * p[2] - 64.0f;
+  }
+  for_bench_threads(n)
+    bench_run("dt_Lab_to_XYZ", kernel_Lab_to_XYZ, &buffers, buffers.npixels);
+#ifdef __SSE2__
+  for_bench_threads(n)
+    bench_run("dt_Lab_to_XYZ_sse2", kernel_Lab_to_XYZ_sse2, &buffers,
+      buffers.npixels);
+#endif
+  for(size_t k = 0; k < buffers.npixels; k++)
+  {
+    float *const p = buffers.in + 4 * k;
+    p[0] /= 100.0f;
+    p[1] = (p[1] + 64.0f) / 128.0f;
+    p[2] = (p[2] + 64.0f) / 128.0f;
+  }
+}
+
+static void bench_XYZ_to_prophotorgb(void **state)
+{
+  TR_STEP("measure XYZ to ProPhoto RGB");
+  for_bench_threads(n)
+    bench_run("dt_XYZ_to_prophotorgb", kernel_XYZ_to_prophotorgb, &buffers,
+      buffers.npixels);
+#ifdef __SSE2__
+  for_bench_threads(n)
+    bench_run("dt_XYZ_to_prophotoRGB_sse2", kernel_XYZ_to_prophotorgb_sse2,
+      &buffers, buffers.npixels);
+#endif
+}
+
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(bench_XYZ_to_Lab),
+    cmocka_unit_test(bench_Lab_to_XYZ),
+    cmocka_unit_test(bench_XYZ_to_prophotorgb)
+  };
+
+  return cmocka_run_group_tests(tests, setup, teardown);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,90 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "tracing.h"
+#include "bench.h"
+
+// thread count set by bench_set_threads(), reported with the results:
+static int _threads = 1;
+
+static double _now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+double bench_run(const char *name, bench_kernel_t kernel, void *data,
+  const size_t pixels)
+{
+  // warm up caches and let the allocator settle
+  kernel(data);
+
+  double best = 0.0;
+  double spent = 0.0;
+  int runs = 0;
+  while(spent < BENCH_MIN_SECONDS || runs < 3)
+  {
+    const double start = _now();
+    kernel(data);
+    const double took = _now() - start;
+    if(runs == 0 || took < best) best = took;
+    spent += took;
+    runs++;
+  }
+
+  const double mpix = best > 0.0 ? 1e-6 * pixels / best : 0.0;
+  TR_NOTE("%-32s %2d threads: %9.2f Mpix/s (best of %d runs)",
+    name, _threads, mpix, runs);
+  return mpix;
+}
+
+int bench_max_threads(void)
+{
+#ifdef _OPENMP
+  return omp_get_num_procs();
+#else
+  return 1;
+#endif
+}
+
+void bench_set_threads(const int threads)
+{
+  _threads = threads;
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+}
+
+int bench_next_threads(const int n)
+{
+  const int max = bench_max_threads();
+  if(n >= max) return max + 1;
+  return 2 * n < max ? 2 * n : max;
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,56 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * Timing helpers for the kernel micro-benchmarks (bench_<suite-name>.c) to be
+ * used with cmocka.
+ *
+ * Please see ../README.md for more detailed documentation.
+ */
+
+#include <stddef.h>
+
+// minimum time in seconds a kernel is repeated for:
+#define BENCH_MIN_SECONDS 0.5
+
+// a kernel processes the data it is handed once:
+typedef void (*bench_kernel_t)(void *data);
+
+// run a kernel repeatedly for at least BENCH_MIN_SECONDS (after one warm-up
+// run), print and return the megapixels per second of the fastest run:
+double bench_run(const char *name, bench_kernel_t kernel, void *data,
+  const size_t pixels);
+
+// number of OpenMP threads available (1 without OpenMP):
+int bench_max_threads(void);
+
+// set the number of OpenMP threads used by the next runs:
+void bench_set_threads(const int threads);
+
+// next thread count after n: doubles up to bench_max_threads()
+int bench_next_threads(const int n);
+
+// iterate over thread counts 1, 2, 4, ... and bench_max_threads(), setting
+// each one before the loop body runs:
+#define for_bench_threads(n) \
+  for (int n = 1; n <= bench_max_threads() && (bench_set_threads(n), 1); \
+       n = bench_next_threads(n))
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -1316,6 +1316,30 @@ static gboolean _dev_load_requested_image(gpointer user_data)
   return G_SOURCE_REMOVE;
 }
 
+// prerender the image diff places after imgid in the collection, the
+// most likely next one when culling
+static void _dev_prerender_neighbour(const dt_imgid_t imgid, const int diff)
+{
+  dt_imgid_t next_id = NO_IMGID;
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT imgid"
+                              " FROM memory.collected_images"
+                              " WHERE rowid=(SELECT rowid"
+                              "              FROM memory.collected_images"
+                              "              WHERE imgid=?1)+?2",
+                              -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, diff);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+    next_id = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  dt_dev_prerender_image(next_id);
+}
+
 static void _view_darkroom_filmstrip_activate_callback(gpointer instance,
                                                        const dt_imgid_t imgid,
                                                        const dt_view_t *self)
@@ -1330,6 +1354,7 @@ static void _view_darkroom_filmstrip_activate_callback(gpointer instance,
     dt_thumbtable_set_offset_image(dt_ui_thumbtable(darktable.gui->ui), imgid, TRUE);
     // force redraw
     dt_control_queue_redraw();
+    _dev_prerender_neighbour(imgid, 1);
   }
 }
 
@@ -1402,6 +1427,9 @@ static void _dev_jump_image(dt_develop_t *dev, int diff, gboolean by_key)
 
   // if it's a change by key_press, we set mouse_over to the active image
   if(by_key) dt_control_set_mouse_over_id(new_id);
+
+  // culling usually continues in the same direction
+  _dev_prerender_neighbour(new_id, diff);
 }
 
 static void zoom_key_accel(dt_action_t *action)
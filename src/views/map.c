@@ -1458,37 +1458,37 @@ static void _view_map_changed_callback_delayed(const gpointer user_data)
     DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 3, lib->bbox.lat1);
     DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 4, lib->bbox.lat2);
 
-    // count the images
+    /* make the image list in one pass, growing the array as needed */
+    dt_times_t start;
+    dt_get_perf_times(&start);
     int img_count = 0;
-    while(sqlite3_step(lib->main_query) == SQLITE_ROW)
+    int allocated = MAX(lib->nb_points, 64);
+    g_free(lib->points);
+    lib->points = g_new(dt_geo_position_t, allocated);
+    while(sqlite3_step(lib->main_query) == SQLITE_ROW && all_good)
     {
-      img_count++;
+      if(img_count == allocated)
+      {
+        allocated *= 2;
+        lib->points = g_renew(dt_geo_position_t, lib->points, allocated);
+      }
+      dt_geo_position_t *pos = &lib->points[img_count++];
+      pos->imgid = sqlite3_column_int(lib->main_query, 0);
+      pos->x = deg2rad(sqlite3_column_double(lib->main_query, 1));
+      pos->y = deg2rad(sqlite3_column_double(lib->main_query, 2));
+      pos->cluster_id = UNCLASSIFIED;
     }
+    dt_show_times(&start, "[map] retrieve image geolocations");
 
-    if(lib->points)
+    if(!img_count)
+    {
       g_free(lib->points);
-    lib->points = NULL;
+      lib->points = NULL;
+    }
     lib->nb_points = img_count;
-    if(img_count > 0)
-      lib->points = (dt_geo_position_t *)calloc(img_count, sizeof(dt_geo_position_t));
     dt_geo_position_t *p = lib->points;
     if(p)
     {
-      DT_DEBUG_SQLITE3_RESET(lib->main_query);
-      /* make the image list */
-      dt_times_t start;
-      dt_get_perf_times(&start);
-      int i = 0;
-      while(sqlite3_step(lib->main_query) == SQLITE_ROW && all_good && i < img_count)
-      {
-        p[i].imgid = sqlite3_column_int(lib->main_query, 0);
-        p[i].x = deg2rad(sqlite3_column_double(lib->main_query, 1));
-        p[i].y = deg2rad(sqlite3_column_double(lib->main_query, 2));
-        p[i].cluster_id = UNCLASSIFIED;
-        i++;
-      }
-      dt_show_times(&start, "[map] retrieve image geolocations");
-
       const float epsilon_factor = dt_conf_get_int("plugins/map/epsilon_factor");
       const int min_images = dt_conf_get_int("plugins/map/min_images_per_group");
       // zoom varies from 0 (156412 m/pixel) to 20 (0.149 m/pixel)
@@ -1507,7 +1507,7 @@ static void _view_map_changed_callback_delayed(const gpointer user_data)
       gboolean *processed = calloc(num_clusters+1,sizeof(gboolean));
       GList *sel_imgs = dt_act_on_get_images(FALSE, FALSE, FALSE);
       int group = -1;
-      for(i = 0; i< img_count; i++)
+      for(int i = 0; i < img_count; i++)
       {
         if(p[i].cluster_id == NOISE)
         {
@@ -3180,16 +3180,28 @@ static void _view_map_build_main_query(dt_map_t *lib)
   if(lib->main_query) sqlite3_finalize(lib->main_query);
 
   lib->filter_images_drawn = dt_conf_get_bool("plugins/map/filter_images_drawn");
+  const char *images = lib->filter_images_drawn
+    ? "main.images i INNER JOIN memory.collected_images c ON i.id = c.imgid"
+    : "main.images i";
   // clang-format off
-  geo_query =
-    g_strdup_printf("SELECT * FROM"
-                    " (SELECT id, longitude, latitude "
-                    "   FROM %s WHERE longitude >= ?1 AND longitude <= ?2"
-                    "           AND latitude <= ?3 AND latitude >= ?4 "
-                    "           AND longitude NOT NULL AND latitude NOT NULL)",
-                    lib->filter_images_drawn
-                    ? "main.images i INNER JOIN memory.collected_images c ON i.id = c.imgid"
-                    : "main.images");
+  if(dt_database_has_geo_index(darktable.db))
+    // the r*tree finds the candidates in the box, its rounded
+    // coordinates are then checked against the exact ones
+    geo_query =
+      g_strdup_printf("SELECT i.id, i.longitude, i.latitude"
+                      " FROM main.images_geo g INNER JOIN %s ON i.id = g.id"
+                      " WHERE g.max_lon >= ?1 AND g.min_lon <= ?2"
+                      "   AND g.min_lat <= ?3 AND g.max_lat >= ?4"
+                      "   AND i.longitude >= ?1 AND i.longitude <= ?2"
+                      "   AND i.latitude <= ?3 AND i.latitude >= ?4",
+                      images);
+  else
+    geo_query =
+      g_strdup_printf("SELECT i.id, i.longitude, i.latitude"
+                      " FROM %s WHERE i.longitude >= ?1 AND i.longitude <= ?2"
+                      "           AND i.latitude <= ?3 AND i.latitude >= ?4"
+                      "           AND i.longitude NOT NULL AND i.latitude NOT NULL",
+                      images);
   // clang-format on
 
   /* prepare the main query statement */
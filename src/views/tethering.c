@@ -88,6 +88,10 @@ typedef struct dt_capture_t
   double live_view_zoom_cursor_x, live_view_zoom_cursor_y;
 
   gboolean busy;
+
+  /** The image and profile the histogram was last computed for */
+  dt_imgid_t histogram_id;
+  dt_colorspaces_color_profile_type_t histogram_type;
 } dt_capture_t;
 
 /* signal handler for filmstrip image switching */
@@ -305,20 +309,14 @@ static void _expose_tethered_mode(dt_view_t *self,
         // FIXME: add OpenMP
         for(size_t p = 0; p < (size_t)4 * pw * ph; p += 4)
         {
-          uint32_t DT_ALIGNED_ARRAY state[4]
-              = { splitmix32(p + 1),
-                  splitmix32((p + 1) * (p + 3)),
-                  splitmix32(1337),
-                  splitmix32(666) };
-
-          xoshiro128plus(state);
-          xoshiro128plus(state);
-          xoshiro128plus(state);
-          xoshiro128plus(state);
-
-          for(int k = 0; k < 3; k++)
-            tmp_f[p + k] =
-              dt_noise_generator(DT_NOISE_UNIFORM, p_buf[p + k], 0.5f, 0, state) / 255.0f;
+          const size_t k = p / 4;
+          const dt_aligned_pixel_t mu = { p_buf[p], p_buf[p + 1], p_buf[p + 2], 0.f };
+          const dt_aligned_pixel_t sigma = { 0.5f, 0.5f, 0.5f, 0.f };
+          dt_aligned_pixel_t noise;
+          dt_noise_generator_simd(DT_NOISE_UNIFORM, k % pw, k / pw, 1337, mu, sigma, noise);
+
+          for(int c = 0; c < 3; c++)
+            tmp_f[p + c] = noise[c] / 255.0f;
         }
 
         // We need to do special cases for work/export colorspace
@@ -356,6 +354,7 @@ static void _expose_tethered_mode(dt_view_t *self,
                                                srgb_profile, profile_to);
         dt_control_queue_redraw_widget(darktable.lib->proxy.histogram.module->widget);
         dt_free_align(tmp_f);
+        lib->histogram_id = NO_IMGID;
       }
     }
     dt_pthread_mutex_unlock(&cam->live_view_buffer_mutex);
@@ -388,65 +387,72 @@ static void _expose_tethered_mode(dt_view_t *self,
       lib->busy = FALSE;
     }
 
-    // update the histogram
-    dt_imageio_module_format_t format;
-    _tethering_format_t dat;
-    format.bpp = _tethering_bpp;
-    format.write_image = _tethering_write_image;
-    format.levels = _tethering_levels;
-    format.mime = _tethering_mime;
-    // FIXME: is this reasonable resolution? does it match what pixelpipe preview pipe does?
-    dat.head.max_width = darktable.mipmap_cache->max_width[DT_MIPMAP_F];
-    dat.head.max_height = darktable.mipmap_cache->max_height[DT_MIPMAP_F];
-    dat.head.style[0] = '\0';
-
-    dt_colorspaces_color_profile_type_t histogram_type = DT_COLORSPACE_NONE;
-    const char *histogram_filename = NULL;
-    if(darktable.color_profiles->histogram_type == DT_COLORSPACE_WORK)
-    {
-      const dt_colorspaces_color_profile_t *work_profile =
-        dt_colorspaces_get_work_profile(lib->image_id);
-      histogram_type = work_profile->type;
-      histogram_filename = work_profile->filename;
-    }
-    else if(darktable.color_profiles->histogram_type == DT_COLORSPACE_EXPORT)
-    {
-      const dt_colorspaces_color_profile_t *export_profile =
-        dt_colorspaces_get_output_profile(lib->image_id, DT_COLORSPACE_NONE, NULL);
-      histogram_type = export_profile->type;
-      histogram_filename = export_profile->filename;
-    }
-    else
+    // update the histogram, it only depends on the image and the
+    // histogram profile so it is not exported again on every expose
+    if(lib->histogram_id != lib->image_id
+       || lib->histogram_type != darktable.color_profiles->histogram_type)
     {
-      // special cases above as this can't handle work/export profile
-      // when not in darkroom view
-      dt_ioppr_get_histogram_profile_type(&histogram_type, &histogram_filename);
-    }
+      dt_imageio_module_format_t format;
+      _tethering_format_t dat;
+      format.bpp = _tethering_bpp;
+      format.write_image = _tethering_write_image;
+      format.levels = _tethering_levels;
+      format.mime = _tethering_mime;
+      // FIXME: is this reasonable resolution? does it match what pixelpipe preview pipe does?
+      dat.head.max_width = darktable.mipmap_cache->max_width[DT_MIPMAP_F];
+      dat.head.max_height = darktable.mipmap_cache->max_height[DT_MIPMAP_F];
+      dat.head.style[0] = '\0';
+
+      dt_colorspaces_color_profile_type_t histogram_type = DT_COLORSPACE_NONE;
+      const char *histogram_filename = NULL;
+      if(darktable.color_profiles->histogram_type == DT_COLORSPACE_WORK)
+      {
+        const dt_colorspaces_color_profile_t *work_profile =
+          dt_colorspaces_get_work_profile(lib->image_id);
+        histogram_type = work_profile->type;
+        histogram_filename = work_profile->filename;
+      }
+      else if(darktable.color_profiles->histogram_type == DT_COLORSPACE_EXPORT)
+      {
+        const dt_colorspaces_color_profile_t *export_profile =
+          dt_colorspaces_get_output_profile(lib->image_id, DT_COLORSPACE_NONE, NULL);
+        histogram_type = export_profile->type;
+        histogram_filename = export_profile->filename;
+      }
+      else
+      {
+        // special cases above as this can't handle work/export profile
+        // when not in darkroom view
+        dt_ioppr_get_histogram_profile_type(&histogram_type, &histogram_filename);
+      }
 
-    // this uses the export rather than thumbnail pipe -- slower, but
-    // as we're not competing with the full pixelpipe, it's a
-    // reasonable trade-off for a histogram which matches that in
-    // darkroom view
+      // this uses the export rather than thumbnail pipe -- slower, but
+      // as we're not competing with the full pixelpipe, it's a
+      // reasonable trade-off for a histogram which matches that in
+      // darkroom view
 
-    // FIXME: instead export image in work profile, then pass that to
-    // histogram process as well as converting to display profile for
-    // output, eliminating dt_view_image_get_surface() above
+      // FIXME: instead export image in work profile, then pass that to
+      // histogram process as well as converting to display profile for
+      // output, eliminating dt_view_image_get_surface() above
 
-    if(!dt_imageio_export_with_flags(lib->image_id, "unused",
-                                     &format, (dt_imageio_module_data_t *)&dat, TRUE,
-                                     FALSE, FALSE, FALSE, FALSE, 1.0, FALSE, NULL,
-                                     FALSE, FALSE, histogram_type, histogram_filename,
-                                     DT_INTENT_PERCEPTUAL, NULL, NULL, 1, 1, NULL, -1))
-    {
-      const dt_iop_order_iccprofile_info_t *const histogram_profile =
-        dt_ioppr_add_profile_info_to_list(darktable.develop, histogram_type,
-                                          histogram_filename,
-                                          DT_INTENT_RELATIVE_COLORIMETRIC);
-      darktable.lib->proxy.histogram.process(darktable.lib->proxy.histogram.module,
-                                             dat.buf, dat.head.width, dat.head.height,
-                                             histogram_profile, histogram_profile);
-      dt_control_queue_redraw_widget(darktable.lib->proxy.histogram.module->widget);
-      free(dat.buf);
+      if(!dt_imageio_export_with_flags(lib->image_id, "unused",
+                                       &format, (dt_imageio_module_data_t *)&dat, TRUE,
+                                       FALSE, FALSE, FALSE, FALSE, 1.0, FALSE, NULL,
+                                       FALSE, FALSE, histogram_type, histogram_filename,
+                                       DT_INTENT_PERCEPTUAL, NULL, NULL, 1, 1, NULL, -1))
+      {
+        const dt_iop_order_iccprofile_info_t *const histogram_profile =
+          dt_ioppr_add_profile_info_to_list(darktable.develop, histogram_type,
+                                            histogram_filename,
+                                            DT_INTENT_RELATIVE_COLORIMETRIC);
+        darktable.lib->proxy.histogram.process(darktable.lib->proxy.histogram.module,
+                                               dat.buf, dat.head.width, dat.head.height,
+                                               histogram_profile, histogram_profile);
+        dt_control_queue_redraw_widget(darktable.lib->proxy.histogram.module->widget);
+        free(dat.buf);
+        lib->histogram_id = lib->image_id;
+        lib->histogram_type = darktable.color_profiles->histogram_type;
+      }
     }
   }
   else // not in live view, no image selected
@@ -455,6 +461,7 @@ static void _expose_tethered_mode(dt_view_t *self,
     darktable.lib->proxy.histogram.process(darktable.lib->proxy.histogram.module,
                                            NULL, 0, 0, NULL, NULL);
     dt_control_queue_redraw_widget(darktable.lib->proxy.histogram.module->widget);
+    lib->histogram_id = NO_IMGID;
   }
 }
 
@@ -505,6 +512,7 @@ static void _capture_mipmaps_updated_signal_callback(gpointer instance,
   struct dt_capture_t *lib = self->data;
 
   lib->image_id = imgid;
+  lib->histogram_id = NO_IMGID;
   dt_view_active_images_reset(FALSE);
   dt_view_active_images_add(lib->image_id, TRUE);
   dt_thumbtable_full_redraw(dt_ui_thumbtable(darktable.gui->ui), TRUE);
@@ -560,6 +568,7 @@ void enter(dt_view_t *self)
 
   // no active image when entering the tethering view
   lib->image_over = DT_VIEW_DESERT;
+  lib->histogram_id = NO_IMGID;
   GSList *l = dt_view_active_images_get();
   lib->image_id = l ? GPOINTER_TO_INT(l->data) : -1;
 
@@ -100,6 +100,22 @@ void dt_view_manager_gui_init(dt_view_manager_t *vm)
   }
 }
 
+// overlays of the last few images drawn with focus peaking, so redraws of
+// an unchanged buffer (mouse moves, culling with several images) only pay
+// for hashing it. only used from the gui thread.
+#define DT_VIEW_FOCUSPEAKING_CACHE 4
+
+typedef struct dt_view_focuspeaking_t
+{
+  dt_hash_t hash;
+  int width, height;
+  uint64_t used;
+  uint8_t *overlay;
+} dt_view_focuspeaking_t;
+
+static dt_view_focuspeaking_t _focuspeaking_cache[DT_VIEW_FOCUSPEAKING_CACHE] = { { 0 } };
+static uint64_t _focuspeaking_clock = 0;
+
 void dt_view_manager_cleanup(dt_view_manager_t *vm)
 {
   for(GList *iter = vm->views;
@@ -109,6 +125,12 @@ void dt_view_manager_cleanup(dt_view_manager_t *vm)
 
   g_list_free_full(vm->views, free);
   vm->views = NULL;
+
+  for(int k = 0; k < DT_VIEW_FOCUSPEAKING_CACHE; k++)
+  {
+    dt_free_align(_focuspeaking_cache[k].overlay);
+    _focuspeaking_cache[k].overlay = NULL;
+  }
 }
 
 const dt_view_t *dt_view_manager_get_current_view(const dt_view_manager_t *vm)
@@ -709,6 +731,69 @@ void dt_view_set_scrollbar(dt_view_t *view,
   dt_ui_update_scrollbars(darktable.gui->ui);
 }
 
+static dt_hash_t _focuspeaking_hash(const uint8_t *const image,
+                                    const int width,
+                                    const int height)
+{
+  const size_t row_bytes = (size_t)width * 4;
+  dt_hash_t hash = 0;
+  DT_OMP_FOR(reduction(^:hash))
+  for(int row = 0; row < height; row++)
+  {
+    const uint8_t *in = image + row * row_bytes;
+    uint64_t h = 0xcbf29ce484222325ull ^ (uint64_t)row;
+    size_t k = 0;
+    for(; k + sizeof(uint64_t) <= row_bytes; k += sizeof(uint64_t))
+    {
+      uint64_t word;
+      memcpy(&word, in + k, sizeof(word));
+      h = (h ^ word) * 0x100000001b3ull;
+    }
+    for(; k < row_bytes; k++)
+      h = (h ^ in[k]) * 0x100000001b3ull;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    hash ^= h ^ (h >> 32);
+  }
+  return hash ^ ((dt_hash_t)width << 32 | (uint32_t)height);
+}
+
+void dt_view_focuspeaking(cairo_t *cr,
+                          const int width,
+                          const int height,
+                          uint8_t *const image)
+{
+  if(width < 1 || height < 1) return;
+
+  const dt_hash_t hash = _focuspeaking_hash(image, width, height);
+
+  dt_view_focuspeaking_t *entry = NULL;
+  dt_view_focuspeaking_t *oldest = &_focuspeaking_cache[0];
+  for(int k = 0; k < DT_VIEW_FOCUSPEAKING_CACHE; k++)
+  {
+    dt_view_focuspeaking_t *e = &_focuspeaking_cache[k];
+    if(e->overlay && e->hash == hash && e->width == width && e->height == height)
+    {
+      entry = e;
+      break;
+    }
+    if(e->used < oldest->used) oldest = e;
+  }
+
+  if(!entry)
+  {
+    entry = oldest;
+    dt_free_align(entry->overlay);
+    entry->overlay = dt_focuspeaking_overlay(width, height, image);
+    entry->hash = hash;
+    entry->width = width;
+    entry->height = height;
+  }
+  entry->used = ++_focuspeaking_clock;
+
+  dt_focuspeaking_draw(cr, width, height, entry->overlay);
+}
+
 dt_view_surface_value_t dt_view_image_get_surface(const dt_imgid_t imgid,
                                                   const int32_t width,
                                                   const int32_t height,
@@ -870,7 +955,7 @@ dt_view_surface_value_t dt_view_image_get_surface(const dt_imgid_t imgid,
        data to be processed, this is more data but correct.
     */
     if(darktable.gui->show_focus_peaking && mip == buf.size)
-      dt_focuspeaking(cr, buf_wd, buf_ht, rgbbuf);
+      dt_view_focuspeaking(cr, buf_wd, buf_ht, rgbbuf);
 
     cairo_surface_destroy(tmp_surface);
     cairo_destroy(cr);
@@ -1813,9 +1898,13 @@ void dt_view_paint_surface(cairo_t *cr,
          || floor(maxh / 2 / back_scale) - 1 > MIN(- trans_y, trans_y + buf_height))
      && (port == &dev->full || port == &dev->preview2))
   {
-    port->pipe->changed |= DT_DEV_PIPE_ZOOMED;
-    if(port->pipe->status == DT_DEV_PIXELPIPE_VALID)
-      port->pipe->status = DT_DEV_PIXELPIPE_DIRTY;
+    // a coarse backbuf is refined anyway, so don't ask for another run
+    if(!port->pipe->coarse)
+    {
+      port->pipe->changed |= DT_DEV_PIPE_ZOOMED;
+      if(port->pipe->status == DT_DEV_PIXELPIPE_VALID)
+        port->pipe->status = DT_DEV_PIXELPIPE_DIRTY;
+    }
 
     // draw preview
     const float wd = processed_width * pp->processed_width / MAX(1, dev->full.pipe->processed_width);
@@ -1869,8 +1958,8 @@ void dt_view_paint_surface(cairo_t *cr,
     if(darktable.gui->show_focus_peaking
       && window != DT_WINDOW_SLIDESHOW)
     {
-      dt_focuspeaking(cr, buf_width, buf_height,
-                      cairo_image_surface_get_data(surface));
+      dt_view_focuspeaking(cr, buf_width, buf_height,
+                           cairo_image_surface_get_data(surface));
     }
     cairo_surface_destroy(surface);
   }
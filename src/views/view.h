@@ -653,6 +653,13 @@ void dt_view_paint_pixbuf(cairo_t *cr,
                           const size_t processed_height,
                           const dt_window_t window);
 
+/** draw the focus-peaking overlay of an 8-bit image, reusing the overlay
+    when the same image content was drawn recently */
+void dt_view_focuspeaking(cairo_t *cr,
+                          const int width,
+                          const int height,
+                          uint8_t *const image);
+
 cairo_surface_t *dt_view_create_surface(uint8_t *buffer,
                                         const size_t processed_width,
                                         const size_t processed_height);